@@ -18,7 +18,14 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
+#ifdef WITH_AF_XDP
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <xdp/xsk.h>	/* install libxdp-devel */
+#endif
 #include "arrow_ipc.h"
 
 #if 1
@@ -66,6 +73,8 @@ static bool				enable_direct_io = false;
 static bool				only_headers = false;
 static bool				composite_options = false;
 static int				print_stat_interval = -1;
+static bool				capture_by_xdp = false;
+static int				segment_interval = -1;		/* seconds */
 
 /*
  * definition of output Arrow files
@@ -73,6 +82,8 @@ static int				print_stat_interval = -1;
 typedef struct
 {
 	int					refcnt;
+	time_t				open_time;
+	char			   *final_filename;	/* renamed to, on close */
 	SQLtable			table;
 } arrowFileDesc;
 #define PCAP_SCHEMA_MAX_NFIELDS		50
@@ -119,18 +130,32 @@ static pcapFileDesc	   *pcap_file_desc_array = NULL;
 static volatile int		pcap_file_desc_selector = 0;
 static int				pcap_file_desc_nums = 0;
 
-/* capture statistics */
-static uint64_t			stat_raw_packet_length = 0;
-static uint64_t			stat_ip4_packet_count = 0;
-static uint64_t			stat_ip6_packet_count = 0;
-static uint64_t			stat_tcp_packet_count = 0;
-static uint64_t			stat_udp_packet_count = 0;
-static uint64_t			stat_icmp_packet_count = 0;
+/*
+ * capture statistics
+ *
+ * Each worker thread has its own counters on the individual cache line,
+ * to avoid cache-line bouncing by atomic operations per packet.
+ * pcap_print_stat() sums up them.
+ */
+typedef struct
+{
+	uint64_t	raw_packet_length;
+	uint64_t	ip4_packet_count;
+	uint64_t	ip6_packet_count;
+	uint64_t	tcp_packet_count;
+	uint64_t	udp_packet_count;
+	uint64_t	icmp_packet_count;
+	uint64_t	chunk_write_count;	/* # of chunks written out */
+	uint64_t	chunk_write_usec;	/* time of write (backpressure) */
+} __attribute__((aligned(64))) pcapWorkerStat;
+
+static pcapWorkerStat  *pcap_worker_stats = NULL;
 
 /* other static variables */
 static long				PAGESIZE;
 static long				NCPUS;
 static __thread long	worker_id = -1;
+static __thread pcapWorkerStat *worker_stat = NULL;
 static volatile bool	do_shutdown = false;
 #ifndef PAGE_ALIGN
 #define PAGE_ALIGN(x)	(((uint64_t)(x) + PAGESIZE - 1) & ~(PAGESIZE - 1))
@@ -209,6 +234,18 @@ atomicAdd64(uint64_t *addr, uint64_t value)
 	return __atomic_fetch_add(addr, value, __ATOMIC_SEQ_CST);
 }
 
+/*
+ * statAdd64 - increment the counter of the worker itself
+ *
+ * Only the owner thread updates the counter, so it needs no locked
+ * instruction; the store is atomic for the concurrent readers.
+ */
+static inline void
+statAdd64(uint64_t *addr, uint64_t value)
+{
+	__atomic_store_n(addr, *addr + value, __ATOMIC_RELAXED);
+}
+
 /*
  * SIGINT handler
  */
@@ -1380,6 +1417,7 @@ arrowOpenOutputFile(void)
 	time_t		tv = time(NULL);
 	struct tm	tm;
 	char	   *path, *pos;
+	char	   *temp = NULL;
 	int			off, sz = 256;
 	int			retry_count = 0;
 	int			fdesc;
@@ -1454,28 +1492,54 @@ retry:
 			path[off++] = '\0';
 	} while (off >= sz);
 
+	/*
+	 * With --segment-interval, the file is built under the temporary name,
+	 * then renamed to the final name once its footer is written. So,
+	 * readers (like arrow_fdw) never see incomplete segments.
+	 */
+	if (segment_interval > 0)
+	{
+		if (!force_overwrite && access(path, F_OK) == 0)
+		{
+			retry_count++;
+			goto retry;
+		}
+		temp = palloc(strlen(path) + 10);
+		sprintf(temp, "%s.partial", path);
+	}
+
 	/* open file */
 	flags = O_RDWR | O_CREAT;
 	if (!force_overwrite)
 		flags |= O_EXCL;
 
-	fdesc = open(path, flags, 0644);
+	fdesc = open(temp ? temp : path, flags, 0644);
 	if (fdesc < 0)
 	{
 		if (errno == EEXIST)
 		{
+			if (temp)
+				pfree(temp);
+			temp = NULL;
 			retry_count++;
 			goto retry;
 		}
-		Elog("failed to open('%s'): %m", path);
+		Elog("failed to open('%s'): %m", temp ? temp : path);
 	}
 
 	/* Setup arrowFileDesc */
 	outfd = palloc0(offsetof(arrowFileDesc,
 							 table.columns[PCAP_SCHEMA_MAX_NFIELDS]));
 	outfd->refcnt = 0;
+	outfd->open_time = tv;
 	outfd->table.fdesc = fdesc;
-	outfd->table.filename = pstrdup(path);
+	if (temp)
+	{
+		outfd->final_filename = pstrdup(path);
+		outfd->table.filename = temp;
+	}
+	else
+		outfd->table.filename = pstrdup(path);
 	arrowPcapSchemaInit(&outfd->table);
 
 	/* Write Header */
@@ -1523,6 +1587,27 @@ arrowCloseOutputFile(arrowFileDesc *outfd)
 		writeArrowFooter(&outfd->table);
 	}
 	close(outfd->table.fdesc);
+
+	/* publish the segment by the final name */
+	if (outfd->final_filename &&
+		outfd->table.numRecordBatches > 0 &&
+		rename(outfd->table.filename, outfd->final_filename) != 0)
+		Elog("failed on rename('%s', '%s'): %m",
+			 outfd->table.filename,
+			 outfd->final_filename);
+}
+
+/*
+ * arrowSegmentIsExpired
+ *
+ * It checks whether the output file / chunk-buffer opened at the 'since'
+ * should be written out, by --segment-interval.
+ */
+static inline bool
+arrowSegmentIsExpired(time_t since)
+{
+	return (segment_interval > 0 &&
+			time(NULL) >= since + segment_interval);
 }
 
 /*
@@ -1590,7 +1675,9 @@ arrowChunkWriteOut(SQLtable *chunk)
 	size_t		length;
 	int			f_index;
 	bool		close_file = false;
+	struct timespec tv1, tv2;
 
+	clock_gettime(CLOCK_MONOTONIC, &tv1);
 	/*
 	 * writeArrowXXXX() routines setup iov array if table->fdesc < 0.
 	 */
@@ -1601,13 +1688,21 @@ arrowChunkWriteOut(SQLtable *chunk)
 
 	/*
 	 * attach file descriptor
+	 *
+	 * Each worker writes to the file of its own affinity, so the lock is
+	 * not contended if --parallel-write is equal to the number of threads.
 	 */
-	f_index = atomicAdd64(&arrow_file_desc_selector, 1) % arrow_file_desc_nums;
+	if (worker_id >= 0)
+		f_index = worker_id % arrow_file_desc_nums;
+	else
+		f_index = atomicAdd64(&arrow_file_desc_selector, 1) % arrow_file_desc_nums;
 	pthreadMutexLock(&arrow_file_desc_locks[f_index]);
 	for (;;)
 	{
 		outfd = arrow_file_desc_array[f_index];
-		if (outfd->table.f_pos < output_filesize_limit)
+		if (outfd->table.f_pos < output_filesize_limit &&
+			(outfd->table.numRecordBatches == 0 ||
+			 !arrowSegmentIsExpired(outfd->open_time)))
 		{
 			/* Ok, [base ... base + usage) is reserved */
 			chunk->fdesc    = outfd->table.fdesc;
@@ -1679,6 +1774,16 @@ arrowChunkWriteOut(SQLtable *chunk)
 	chunk->fdesc = -1;
 	chunk->filename = NULL;
 	chunk->f_pos = 0;
+
+	/* time of the write-out; the worker cannot capture packets */
+	clock_gettime(CLOCK_MONOTONIC, &tv2);
+	if (worker_stat)
+	{
+		statAdd64(&worker_stat->chunk_write_count, 1);
+		statAdd64(&worker_stat->chunk_write_usec,
+				  (tv2.tv_sec  - tv1.tv_sec) * 1000000L +
+				  (tv2.tv_nsec - tv1.tv_nsec) / 1000L);
+	}
 }
 
 /*
@@ -1842,12 +1947,12 @@ __execCaptureOnePacket(SQLtable *chunk,
 	if (!pos)
 		goto fillup_by_null;
 	if (print_stat_interval > 0)
-		atomicAdd64(&stat_raw_packet_length, hdr->len);
+		statAdd64(&worker_stat->raw_packet_length, hdr->len);
 
 	if (ether_type == 0x0800)		/* IPv4 */
 	{
 		if (print_stat_interval > 0)
-			atomicAdd64(&stat_ip4_packet_count, 1);
+			statAdd64(&worker_stat->ip4_packet_count, 1);
 		if ((protocol_mask & __PCAP_PROTO__IPv4) == 0)
 			goto fillup_by_null;
 		next = handlePacketIPv4Header(chunk, pos, end - pos, &proto);
@@ -1859,7 +1964,7 @@ __execCaptureOnePacket(SQLtable *chunk,
 	else if (ether_type == 0x86dd)	/* IPv6 */
 	{
 		if (print_stat_interval > 0)
-			atomicAdd64(&stat_ip6_packet_count, 1);
+			statAdd64(&worker_stat->ip6_packet_count, 1);
 		if ((protocol_mask & __PCAP_PROTO__IPv6) == 0)
 			goto fillup_by_null;
 		next = handlePacketIPv6Header(chunk, pos, end - pos, &proto);
@@ -1880,7 +1985,7 @@ __execCaptureOnePacket(SQLtable *chunk,
 		if (proto == 0x06)
 		{
 			if (print_stat_interval > 0)
-				atomicAdd64(&stat_tcp_packet_count, 1);
+				statAdd64(&worker_stat->tcp_packet_count, 1);
 			next = handlePacketTcpHeader(chunk, pos, end - pos, proto,
 										 &src_port, &dst_port);
 			if (next)
@@ -1898,7 +2003,7 @@ __execCaptureOnePacket(SQLtable *chunk,
 		if (proto == 0x11)
 		{
 			if (print_stat_interval > 0)
-				atomicAdd64(&stat_udp_packet_count, 1);
+				statAdd64(&worker_stat->udp_packet_count, 1);
 			next = handlePacketUdpHeader(chunk, pos, end - pos, proto,
 										 &src_port, &dst_port);
 			if (next)
@@ -1916,7 +2021,7 @@ __execCaptureOnePacket(SQLtable *chunk,
 		if (proto == 0x01)
 		{
 			if (print_stat_interval > 0)
-				atomicAdd64(&stat_icmp_packet_count, 1);
+				statAdd64(&worker_stat->icmp_packet_count, 1);
 			next = handlePacketIcmpHeader(chunk, pos, end - pos, proto);
 			if (next)
 				pos = next;
@@ -1952,29 +2057,386 @@ fillup_by_null:
 	chunk->nitems++;
 }
 
+/*
+ * Batched capture path
+ *
+ * Most of packets are IPv4 + TCP/UDP without options, so their header
+ * fields are at the fixed offsets. The batched path extracts the fields
+ * of the consecutive such packets column-by-column, without per-value
+ * function calls and branches. Other packets take the scalar path;
+ * __execCaptureOnePacket().
+ */
+#define CAPTURE_BATCH_SZ		64
+
+static inline bool
+__isFastPathPacket(const struct pfring_pkthdr *hdr, const u_char *pos)
+{
+	uint8_t		proto;
+
+	if ((protocol_mask & __PCAP_PROTO__IPv4) == 0 ||
+		hdr->caplen < 14 + 20 + 8)
+		return false;
+	/* IPv4 without options */
+	if (pos[12] != 0x08 || pos[13] != 0x00 || pos[14] != 0x45)
+		return false;
+	proto = pos[14 + 9];
+	if (proto == 0x06)
+	{
+		/* TCP without options */
+		return ((protocol_mask & __PCAP_PROTO__TCP) != 0 &&
+				hdr->caplen >= 14 + 20 + 20 &&
+				(pos[14 + 20 + 12] & 0xf0) == 0x50);
+	}
+	if (proto == 0x11)
+		return ((protocol_mask & __PCAP_PROTO__UDP) != 0);
+	return false;
+}
+
+/*
+ * __fastPutInlineValues - put values of inline fixed-width column
+ *
+ * addrs[k] points the value in the same manner as put_value callback,
+ * or NULL.
+ */
+static void
+__fastPutInlineValues(SQLtable *chunk, int cindex,
+					  const u_char **addrs, int nrows)
+{
+	SQLfield   *column;
+	size_t		base;
+	uint8_t	   *nullmap;
+	char	   *dst;
+	int			width;
+	bool		bswap = false;
+	int			k;
+
+	if (cindex < 0)
+		return;
+	column = &chunk->columns[cindex];
+	if (column->put_value == put_uint8_value)
+		width = sizeof(uint8_t);
+	else if (column->put_value == put_uint16_value)
+		width = sizeof(uint16_t);
+	else if (column->put_value == put_uint16_value_bswap)
+	{
+		width = sizeof(uint16_t);
+		bswap = true;
+	}
+	else if (column->put_value == put_uint32_value_bswap)
+	{
+		width = sizeof(uint32_t);
+		bswap = true;
+	}
+	else if (column->put_value == put_fixed_size_binary_macaddr_value)
+		width = MACADDR_LEN;
+	else if (column->put_value == put_fixed_size_binary_ip4addr_value)
+		width = IP4ADDR_LEN;
+	else if (column->put_value == put_fixed_size_binary_ip6addr_value)
+		width = IP6ADDR_LEN;
+	else
+	{
+		/* elsewhere, use the scalar path (only NULLs come here) */
+		for (k=0; k < nrows; k++)
+		{
+			Assert(!addrs[k]);
+			sql_field_put_value(column, NULL, 0);
+		}
+		return;
+	}
+
+	base = column->nitems;
+	sql_buffer_expand(&column->values, column->values.usage + width * nrows);
+	sql_buffer_expand(&column->nullmap, (base + nrows + 7) / 8);
+	nullmap = (uint8_t *)column->nullmap.data;
+	dst = column->values.data + column->values.usage;
+	for (k=0; k < nrows; k++, dst += width)
+	{
+		size_t		index = base + k;
+		const u_char *addr = addrs[k];
+
+		if (!addr)
+		{
+			column->nullcount++;
+			nullmap[index >> 3] &= ~(1 << (index & 7));
+			memset(dst, 0, width);
+			continue;
+		}
+		nullmap[index >> 3] |= (1 << (index & 7));
+		switch (width)
+		{
+			case sizeof(uint8_t):
+				*((uint8_t *)dst) = *addr;
+				break;
+			case sizeof(uint16_t):
+				if (bswap)
+					*((uint16_t *)dst) = __ntoh16(*((uint16_t *)addr));
+				else
+					*((uint16_t *)dst) = *((uint16_t *)addr);
+				break;
+			case sizeof(uint32_t):
+				if (bswap)
+					*((uint32_t *)dst) = __ntoh32(*((uint32_t *)addr));
+				else
+					*((uint32_t *)dst) = *((uint32_t *)addr);
+				break;
+			default:
+				memcpy(dst, addr, width);
+				break;
+		}
+	}
+	column->values.usage += width * nrows;
+	if (column->nullmap.usage < (base + nrows + 7) / 8)
+		column->nullmap.usage = (base + nrows + 7) / 8;
+	column->nitems += nrows;
+	column->__curr_usage__ = __buffer_usage_inline_type(column);
+}
+
+static inline void
+__fastPutNullValues(SQLtable *chunk, int cindex, int nrows)
+{
+	const u_char *addrs[CAPTURE_BATCH_SZ];
+
+	if (cindex >= 0)
+	{
+		memset(addrs, 0, sizeof(const u_char *) * nrows);
+		__fastPutInlineValues(chunk, cindex, addrs, nrows);
+	}
+}
+
+static inline void
+__fastPutPacketValues(SQLtable *chunk, int cindex,
+					  const u_char **pkts, int offset,
+					  const bool *valids, int nrows)
+{
+	const u_char *addrs[CAPTURE_BATCH_SZ];
+	int		k;
+
+	if (cindex >= 0)
+	{
+		for (k=0; k < nrows; k++)
+			addrs[k] = (!valids || valids[k] ? pkts[k] + offset : NULL);
+		__fastPutInlineValues(chunk, cindex, addrs, nrows);
+	}
+}
+
+static inline void
+__fastPutHostValues(SQLtable *chunk, int cindex,
+					const void *values, size_t unitsz,
+					const bool *valids, int nrows)
+{
+	const u_char *addrs[CAPTURE_BATCH_SZ];
+	int		k;
+
+	if (cindex >= 0)
+	{
+		for (k=0; k < nrows; k++)
+			addrs[k] = (!valids || valids[k]
+						? (const u_char *)values + unitsz * k : NULL);
+		__fastPutInlineValues(chunk, cindex, addrs, nrows);
+	}
+}
+
+/*
+ * __execCaptureFastRun - IPv4 + TCP/UDP packets without options
+ *
+ * It writes the same values as __execCaptureOnePacket() does.
+ */
+static void
+__execCaptureFastRun(SQLtable *chunk,
+					 const struct pfring_pkthdr *hdrs,
+					 const u_char **pkts, int nrows)
+{
+	uint16_t	ether_types[CAPTURE_BATCH_SZ];
+	uint16_t	tcp_flags[CAPTURE_BATCH_SZ];
+	int			protos[CAPTURE_BATCH_SZ];
+	int			src_ports[CAPTURE_BATCH_SZ];
+	int			dst_ports[CAPTURE_BATCH_SZ];
+	bool		is_tcp[CAPTURE_BATCH_SZ];
+	bool		is_udp[CAPTURE_BATCH_SZ];
+	uint64_t	raw_packet_length = 0;
+	int			ntcp = 0;
+	size_t		usage = 0;
+	int			j, k;
+
+	for (k=0; k < nrows; k++)
+	{
+		const u_char *pos = pkts[k];
+
+		ether_types[k] = 0x0800;
+		protos[k] = pos[14 + 9];
+		is_tcp[k] = (protos[k] == 0x06);
+		is_udp[k] = (protos[k] == 0x11);
+		tcp_flags[k] = __ntoh16(*((uint16_t *)(pos + 14 + 20 + 12))) & 0x0fff;
+		src_ports[k] = __ntoh16(*((uint16_t *)(pos + 14 + 20)));
+		dst_ports[k] = __ntoh16(*((uint16_t *)(pos + 14 + 22)));
+		raw_packet_length += hdrs[k].len;
+		ntcp += is_tcp[k];
+	}
+
+	/* timestamp */
+	if (arrow_cindex__timestamp >= 0)
+	{
+		SQLfield   *column = &chunk->columns[arrow_cindex__timestamp];
+
+		for (k=0; k < nrows; k++)
+			sql_field_put_value(column, (const char *)&hdrs[k].ts,
+								sizeof(struct timeval));
+	}
+	/* raw ethernet */
+	__fastPutPacketValues(chunk, arrow_cindex__dst_mac, pkts, 0, NULL, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__src_mac, pkts, 6, NULL, nrows);
+	__fastPutHostValues(chunk, arrow_cindex__ether_type,
+						ether_types, sizeof(uint16_t), NULL, nrows);
+	/* IPv4 */
+	__fastPutPacketValues(chunk, arrow_cindex__tos,         pkts, 15, NULL, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__ip_length,   pkts, 16, NULL, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__identifier,  pkts, 18, NULL, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__fragment,    pkts, 20, NULL, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__ttl,         pkts, 22, NULL, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__ip_checksum, pkts, 24, NULL, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__src_addr,    pkts, 26, NULL, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__dst_addr,    pkts, 30, NULL, nrows);
+	__fastPutNullValues(chunk, arrow_cindex__ip_options, nrows);
+	/* IPv6 */
+	__fastPutNullValues(chunk, arrow_cindex__traffic_class, nrows);
+	__fastPutNullValues(chunk, arrow_cindex__flow_label,    nrows);
+	__fastPutNullValues(chunk, arrow_cindex__hop_limit,     nrows);
+	__fastPutNullValues(chunk, arrow_cindex__src_addr6,     nrows);
+	__fastPutNullValues(chunk, arrow_cindex__dst_addr6,     nrows);
+	__fastPutNullValues(chunk, arrow_cindex__ip6_options,   nrows);
+	/* TCP */
+	__fastPutPacketValues(chunk, arrow_cindex__seq_nr,    pkts, 38, is_tcp, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__ack_nr,    pkts, 42, is_tcp, nrows);
+	__fastPutHostValues(chunk, arrow_cindex__tcp_flags,
+						tcp_flags, sizeof(uint16_t), is_tcp, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__window_sz,    pkts, 48, is_tcp, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__tcp_checksum, pkts, 50, is_tcp, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__urgent_ptr,   pkts, 52, is_tcp, nrows);
+	__fastPutNullValues(chunk, arrow_cindex__tcp_options, nrows);
+	/* UDP */
+	__fastPutPacketValues(chunk, arrow_cindex__udp_length,   pkts, 38, is_udp, nrows);
+	__fastPutPacketValues(chunk, arrow_cindex__udp_checksum, pkts, 40, is_udp, nrows);
+	/* ICMP */
+	__fastPutNullValues(chunk, arrow_cindex__icmp_type,     nrows);
+	__fastPutNullValues(chunk, arrow_cindex__icmp_code,     nrows);
+	__fastPutNullValues(chunk, arrow_cindex__icmp_checksum, nrows);
+	/* misc fields */
+	__fastPutHostValues(chunk, arrow_cindex__protocol,
+						protos, sizeof(int), NULL, nrows);
+	__fastPutHostValues(chunk, arrow_cindex__src_port,
+						src_ports, sizeof(int), NULL, nrows);
+	__fastPutHostValues(chunk, arrow_cindex__dst_port,
+						dst_ports, sizeof(int), NULL, nrows);
+	/* payload */
+	if (!only_headers && arrow_cindex__payload >= 0)
+	{
+		SQLfield   *column = &chunk->columns[arrow_cindex__payload];
+
+		for (k=0; k < nrows; k++)
+		{
+			int		head_sz = 14 + 20 + (is_tcp[k] ? 20 : 8);
+			int		sz = hdrs[k].caplen - head_sz;
+
+			if (sz > 0)
+				sql_field_put_value(column, (const char *)pkts[k] + head_sz, sz);
+			else
+				sql_field_put_value(column, NULL, 0);
+		}
+	}
+	chunk->nitems += nrows;
+
+	/* total buffer usage; every column got the values above */
+	for (j=0; j < chunk->nfields; j++)
+		usage += chunk->columns[j].__curr_usage__;
+	chunk->usage = usage;
+
+	if (print_stat_interval > 0)
+	{
+		statAdd64(&worker_stat->raw_packet_length, raw_packet_length);
+		statAdd64(&worker_stat->ip4_packet_count, nrows);
+		statAdd64(&worker_stat->tcp_packet_count, ntcp);
+		statAdd64(&worker_stat->udp_packet_count, nrows - ntcp);
+	}
+}
+
+/*
+ * __execCaptureBatchPackets
+ */
+static void
+__execCaptureBatchPackets(SQLtable *chunk,
+						  struct pfring_pkthdr *hdrs,
+						  const u_char **pkts, int npkts)
+{
+	int		i = 0, j;
+
+	while (i < npkts)
+	{
+		for (j=i; j < npkts && __isFastPathPacket(&hdrs[j], pkts[j]); j++);
+		if (j > i)
+		{
+			__execCaptureFastRun(chunk, hdrs + i, pkts + i, j - i);
+			i = j;
+		}
+		else
+		{
+			__execCaptureOnePacket(chunk, &hdrs[i], pkts[i]);
+			i++;
+		}
+	}
+}
+
 /*
  * execCapturePackets
  */
 static int
 execCapturePackets(pfring *pd, SQLtable *chunk)
 {
-	struct pfring_pkthdr hdr;
-	u_char		__buffer[65536];
-	u_char	   *buffer = __buffer;
+	static __thread u_char *__buffer = NULL;
+	struct pfring_pkthdr hdrs[CAPTURE_BATCH_SZ];
+	const u_char *pkts[CAPTURE_BATCH_SZ];
+	int			npkts = 0;
+	time_t		since;
 	int			rv;
 
+	/* per-worker buffer to receive a batch of packets */
+	if (!__buffer)
+	{
+		__buffer = palloc(65536 * CAPTURE_BATCH_SZ);
+		if (!__buffer)
+			Elog("out of memory");
+	}
 	sql_table_clear(chunk);
+	since = time(NULL);
 
 	while (!do_shutdown)
 	{
-		rv = pfring_recv(pd, &buffer, sizeof(__buffer), &hdr, 1);
+		u_char	   *buffer = __buffer + 65536 * npkts;
+
+		/*
+		 * don't block on recv as long as pending packets exist, and also
+		 * when --segment-interval has to flush the chunk on idle traffic
+		 */
+		rv = pfring_recv(pd, &buffer, 65536, &hdrs[npkts],
+						 npkts == 0 && segment_interval <= 0);
 		if (rv > 0)
+			pkts[npkts++] = buffer;
+		if (npkts > 0 && (rv <= 0 || npkts == CAPTURE_BATCH_SZ))
+		{
+			__execCaptureBatchPackets(chunk, hdrs, pkts, npkts);
+			npkts = 0;
+			if (chunk->usage >= record_batch_threshold ||
+				arrowSegmentIsExpired(since))
+				return 1;	/* write out the buffer */
+		}
+		else if (rv <= 0 && segment_interval > 0)
 		{
-			__execCaptureOnePacket(chunk, &hdr, buffer);
-			if (chunk->usage >= record_batch_threshold)
+			if (chunk->nitems > 0 && arrowSegmentIsExpired(since))
 				return 1;	/* write out the buffer */
+			pfring_poll(pd, 100);
 		}
 	}
+	if (npkts > 0)
+		__execCaptureBatchPackets(chunk, hdrs, pkts, npkts);
 	/* interrupted, thus chunk-buffer is partially filled up */
 	return 0;
 }
@@ -2027,6 +2489,7 @@ pfring_worker_main(void *__arg)
 
 	/* assign worker-id of this thread */
 	worker_id = (long)__arg;
+	worker_stat = &pcap_worker_stats[worker_id];
 	chunk = arrow_chunks_array[worker_id];
 
 	while (!do_shutdown)
@@ -2073,6 +2536,7 @@ pcap_file_worker_main(void *__arg)
 	
 	/* assign worker-id of this thread */
 	worker_id = (long)__arg;
+	worker_stat = &pcap_worker_stats[worker_id];
 	chunk = arrow_chunks_array[worker_id];
 
 	for (i = worker_id;
@@ -2081,6 +2545,7 @@ pcap_file_worker_main(void *__arg)
 	{
 		pcapFileDesc   *pfdesc = &pcap_file_desc_array[i];
 		const u_char   *buffer;
+		time_t			since = time(NULL);
 
 		pfdesc->pcap_handle =
 			pcap_fopen_offline_with_tstamp_precision(pfdesc->pcap_filp,
@@ -2103,10 +2568,12 @@ pcap_file_worker_main(void *__arg)
 			__hdr.caplen = hdr.caplen;
 			__hdr.len = hdr.len;
 			__execCaptureOnePacket(chunk, &__hdr, buffer);
-			if (chunk->usage >= record_batch_threshold)
+			if (chunk->usage >= record_batch_threshold ||
+				arrowSegmentIsExpired(since))
 			{
 				arrowChunkWriteOut(chunk);
 				sql_table_clear(chunk);
+				since = time(NULL);
 			}
 		}
 		/* close */
@@ -2115,6 +2582,204 @@ pcap_file_worker_main(void *__arg)
 	return final_merge_pending_chunks(chunk);
 }
 
+#ifdef WITH_AF_XDP
+/*
+ * AF_XDP capture mode
+ *
+ * Each queue of the network device is bound to an XDP socket with its own
+ * UMEM area. The received frames are decoded by __execCaptureBatchPackets()
+ * on the UMEM directly, then returned to the fill ring.
+ */
+#define XDP_NUM_FRAMES			XSK_RING_PROD__DEFAULT_NUM_DESCS
+#define XDP_RX_BATCH_SZ			CAPTURE_BATCH_SZ
+
+typedef struct
+{
+	pthread_mutex_t		lock;		/* only one worker consumes the rings */
+	int					queue_id;
+	void			   *umem_area;
+	struct xsk_umem	   *umem;
+	struct xsk_ring_prod fq;
+	struct xsk_ring_cons cq;
+	struct xsk_ring_cons rx;
+	struct xsk_socket  *xsk;
+	uint64_t			recv_count;
+} xdpSocketDesc;
+
+static xdpSocketDesc   *xdp_socket_array = NULL;
+static uint64_t			xdp_socket_selector = 0;
+
+static void
+init_xdp_input(void)
+{
+	size_t		frame_sz = XSK_UMEM__DEFAULT_FRAME_SIZE;
+	size_t		umem_sz = frame_sz * XDP_NUM_FRAMES;
+	int			i, k, rv;
+
+	xdp_socket_array = palloc0(sizeof(xdpSocketDesc) * pfring_desc_nums);
+	for (i=0; i < pfring_desc_nums; i++)
+	{
+		xdpSocketDesc *xd = &xdp_socket_array[i];
+		struct xsk_socket_config xcfg;
+		uint32_t	index;
+
+		pthreadMutexInit(&xd->lock);
+		xd->queue_id = i;
+		xd->umem_area = mmap(NULL, umem_sz,
+							 PROT_READ | PROT_WRITE,
+							 MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+							 -1, 0);
+		if (xd->umem_area == MAP_FAILED)
+			Elog("failed on mmap(2) for UMEM: %m");
+		rv = xsk_umem__create(&xd->umem, xd->umem_area, umem_sz,
+							  &xd->fq, &xd->cq, NULL);
+		if (rv)
+			Elog("failed on xsk_umem__create: %s", strerror(-rv));
+
+		memset(&xcfg, 0, sizeof(xcfg));
+		xcfg.rx_size = XSK_RING_CONS__DEFAULT_NUM_DESCS;
+		xcfg.tx_size = 0;
+		xcfg.bind_flags = XDP_ZEROCOPY;
+		rv = xsk_socket__create(&xd->xsk, input_devname, xd->queue_id,
+								xd->umem, &xd->rx, NULL, &xcfg);
+		if (rv)
+		{
+			/* fallback to the copy mode, if driver has no zero-copy */
+			xcfg.bind_flags = XDP_COPY;
+			rv = xsk_socket__create(&xd->xsk, input_devname, xd->queue_id,
+									xd->umem, &xd->rx, NULL, &xcfg);
+			if (rv)
+				Elog("failed on xsk_socket__create('%s', queue=%d): %s",
+					 input_devname, xd->queue_id, strerror(-rv));
+		}
+
+		/* populate the fill ring by all the frames */
+		if (xsk_ring_prod__reserve(&xd->fq, XDP_NUM_FRAMES,
+								   &index) != XDP_NUM_FRAMES)
+			Elog("failed on xsk_ring_prod__reserve");
+		for (k=0; k < XDP_NUM_FRAMES; k++)
+			*xsk_ring_prod__fill_addr(&xd->fq, index + k) = k * frame_sz;
+		xsk_ring_prod__submit(&xd->fq, XDP_NUM_FRAMES);
+	}
+}
+
+static void
+xdp_socket_stats(xdpSocketDesc *xd, pfring_stat *stat)
+{
+	struct xdp_statistics xstat;
+	socklen_t	optlen = sizeof(xstat);
+
+	memset(stat, 0, sizeof(pfring_stat));
+	stat->recv = atomicRead64(&xd->recv_count);
+	if (getsockopt(xsk_socket__fd(xd->xsk), SOL_XDP, XDP_STATISTICS,
+				   &xstat, &optlen) == 0)
+		stat->drop = (xstat.rx_dropped +
+					  xstat.rx_ring_full +
+					  xstat.rx_fill_ring_empty_descs);
+}
+
+/*
+ * execCaptureXdpPackets
+ */
+static int
+execCaptureXdpPackets(xdpSocketDesc *xd, SQLtable *chunk)
+{
+	struct pfring_pkthdr hdrs[XDP_RX_BATCH_SZ];
+	const u_char *pkts[XDP_RX_BATCH_SZ];
+	struct timeval tv;
+	time_t		since;
+	struct pollfd pfd;
+
+	sql_table_clear(chunk);
+	since = time(NULL);
+
+	memset(&pfd, 0, sizeof(pfd));
+	pfd.fd = xsk_socket__fd(xd->xsk);
+	pfd.events = POLLIN;
+	while (!do_shutdown)
+	{
+		uint32_t	idx_rx, idx_fq;
+		uint32_t	i, nrecv;
+
+		nrecv = xsk_ring_cons__peek(&xd->rx, XDP_RX_BATCH_SZ, &idx_rx);
+		if (nrecv == 0)
+		{
+			if (chunk->nitems > 0 && arrowSegmentIsExpired(since))
+				return 1;	/* write out the buffer */
+			/* wait for the next packets, but checks do_shutdown */
+			if (poll(&pfd, 1, 50) < 0 && errno != EINTR)
+				Elog("failed on poll(2): %m");
+			continue;
+		}
+		/* all the frames are either in fill ring or rx ring, so it fits */
+		if (xsk_ring_prod__reserve(&xd->fq, nrecv, &idx_fq) != nrecv)
+			Elog("failed on xsk_ring_prod__reserve");
+		gettimeofday(&tv, NULL);
+		for (i=0; i < nrecv; i++)
+		{
+			const struct xdp_desc *desc
+				= xsk_ring_cons__rx_desc(&xd->rx, idx_rx + i);
+
+			hdrs[i].ts = tv;
+			hdrs[i].caplen = desc->len;
+			hdrs[i].len = desc->len;
+			pkts[i] = xsk_umem__get_data(xd->umem_area, desc->addr);
+		}
+		__execCaptureBatchPackets(chunk, hdrs, pkts, nrecv);
+		/* ok, the frames are consumed, so return them to the fill ring */
+		for (i=0; i < nrecv; i++)
+		{
+			const struct xdp_desc *desc
+				= xsk_ring_cons__rx_desc(&xd->rx, idx_rx + i);
+
+			*xsk_ring_prod__fill_addr(&xd->fq, idx_fq + i)
+				= xsk_umem__extract_addr(desc->addr);
+		}
+		xsk_ring_prod__submit(&xd->fq, nrecv);
+		xsk_ring_cons__release(&xd->rx, nrecv);
+		atomicAdd64(&xd->recv_count, nrecv);
+
+		if (chunk->usage >= record_batch_threshold ||
+			arrowSegmentIsExpired(since))
+			return 1;	/* write out the buffer */
+	}
+	/* interrupted, thus chunk-buffer is partially filled up */
+	return 0;
+}
+
+/*
+ * xdp_worker_main
+ */
+static void *
+xdp_worker_main(void *__arg)
+{
+	SQLtable   *chunk;
+
+	/* assign worker-id of this thread */
+	worker_id = (long)__arg;
+	worker_stat = &pcap_worker_stats[worker_id];
+	chunk = arrow_chunks_array[worker_id];
+
+	while (!do_shutdown)
+	{
+		xdpSocketDesc *xd;
+		int		index;
+		int		status;
+
+		index = atomicAdd64(&xdp_socket_selector, 1) % pfring_desc_nums;
+		xd = &xdp_socket_array[index];
+
+		pthreadMutexLock(&xd->lock);
+		status = execCaptureXdpPackets(xd, chunk);
+		pthreadMutexUnlock(&xd->lock);
+
+		if (status > 0)
+			arrowChunkWriteOut(chunk);
+	}
+	return final_merge_pending_chunks(chunk);
+}
+#endif	/* WITH_AF_XDP */
+
 /*
  * usage
  */
@@ -2127,6 +2792,10 @@ usage(int status)
 		  "  -i|--input=DEVICE\n"
 		  "       specifies a network device to capture packet.\n"
 		  "     --num-queues=N_QUEUE : num of PF-RING queues.\n"
+#ifdef WITH_AF_XDP
+		  "     --af-xdp : captures by AF_XDP sockets, instead of PF-RING\n"
+		  "       (N_QUEUE is number of the device queues to bind)\n"
+#endif
 		  "  -o|--output=<output file; with format>\n"
 		  "       filename format can contains:"
 		  "         %i : interface name\n"
@@ -2143,8 +2812,13 @@ usage(int status)
 		  "     --only-headers: disables capture of payload\n"
 		  "     --parallel-write=N_FILES\n"
 		  "       opens multiple output files simultaneously (default: 1)\n"
+		  "       N_FILES = N_THREADS gives each worker its own output file\n"
 		  "     --chunk-size=SIZE : size of record batch (default: 128MB)\n"
 		  "     --direct-io : enables O_DIRECT for write-i/o\n"
+		  "     --segment-interval=SECONDS\n"
+		  "       closes the output file every SECONDS, to publish them\n"
+		  "       for arrow_fdw with short latency. Files under writing\n"
+		  "       have '.partial' suffix. (default: none)\n"
 		  "  -l|--limit=LIMIT : (default: no limit)\n"
 		  "  -p|--protocol=PROTO\n"
 		  "       PROTO is a comma separated string contains\n"
@@ -2186,6 +2860,10 @@ parse_options(int argc, char *argv[])
 		{"num-queues",     required_argument, NULL, 1004},
 		{"parallel-write", required_argument, NULL, 1005},
 		{"composite-options", no_argument,    NULL, 1006},
+#ifdef WITH_AF_XDP
+		{"af-xdp",         no_argument,       NULL, 1007},
+#endif
+		{"segment-interval", required_argument, NULL, 1008},
 		{"help",           no_argument,       NULL, 'h'},
 		{NULL, 0, NULL, 0}
 	};
@@ -2322,6 +3000,16 @@ parse_options(int argc, char *argv[])
 				composite_options = true;
 				break;
 
+			case 1007:	/* --af-xdp */
+				capture_by_xdp = true;
+				break;
+
+			case 1008:	/* --segment-interval */
+				segment_interval = strtol(optarg, &pos, 10);
+				if (*pos != '\0' || segment_interval < 1)
+					Elog("invalid --segment-interval argument: %s", optarg);
+				break;
+
 			default:
 				usage(code == 'h' ? 0 : 1);
 				break;
@@ -2401,6 +3089,8 @@ parse_options(int argc, char *argv[])
 			num_threads = 2 * NCPUS;
 		if (num_pcap_threads < 0)
 			num_pcap_threads = 6 * pfring_desc_nums;
+		if (capture_by_xdp && bpf_filter_rule)
+			Elog("-r|--rule cannot be used with --af-xdp");
 	}
 	else
 	{
@@ -2412,7 +3102,25 @@ parse_options(int argc, char *argv[])
 			Elog("--num-queues cannot be used with PCAP input files");
 		if (print_stat_interval > 0)
 			Elog("-s|--stat should be used with -i|--input=DEV option");
+		if (capture_by_xdp)
+			Elog("--af-xdp should be used with -i|--input=DEV option");
+	}
+}
+
+/*
+ * capture_queue_stats - statistics of the capture queue
+ */
+static void
+capture_queue_stats(int index, pfring_stat *stat)
+{
+#ifdef WITH_AF_XDP
+	if (capture_by_xdp)
+	{
+		xdp_socket_stats(&xdp_socket_array[index], stat);
+		return;
 	}
+#endif
+	pfring_stats(pfring_desc_array[index], stat);
 }
 
 static void
@@ -2426,12 +3134,12 @@ pcap_print_stat(bool is_final_call)
 	static uint64_t last_udp_packet_count = 0;
 	static uint64_t last_icmp_packet_count = 0;
 	static pfring_stat last_pfring_stat = {0,0,0};
-	uint64_t curr_raw_packet_length = atomicRead64(&stat_raw_packet_length);
-	uint64_t curr_ip4_packet_count = atomicRead64(&stat_ip4_packet_count);
-	uint64_t curr_ip6_packet_count = atomicRead64(&stat_ip6_packet_count);
-	uint64_t curr_tcp_packet_count = atomicRead64(&stat_tcp_packet_count);
-	uint64_t curr_udp_packet_count = atomicRead64(&stat_udp_packet_count);
-	uint64_t curr_icmp_packet_count = atomicRead64(&stat_icmp_packet_count);
+	uint64_t curr_raw_packet_length = 0;
+	uint64_t curr_ip4_packet_count = 0;
+	uint64_t curr_ip6_packet_count = 0;
+	uint64_t curr_tcp_packet_count = 0;
+	uint64_t curr_udp_packet_count = 0;
+	uint64_t curr_icmp_packet_count = 0;
 	uint64_t diff_raw_packet_length;
 	pfring_stat	curr_pfring_stat, temp;
 	char		linebuf[1024];
@@ -2441,10 +3149,21 @@ pcap_print_stat(bool is_final_call)
 	int			i;
 
 	localtime_r(&t, &tm);
-	pfring_stats(pfring_desc_array[0], &curr_pfring_stat);
+	for (i=0; i < num_threads; i++)
+	{
+		pcapWorkerStat *ws = &pcap_worker_stats[i];
+
+		curr_raw_packet_length += atomicRead64(&ws->raw_packet_length);
+		curr_ip4_packet_count  += atomicRead64(&ws->ip4_packet_count);
+		curr_ip6_packet_count  += atomicRead64(&ws->ip6_packet_count);
+		curr_tcp_packet_count  += atomicRead64(&ws->tcp_packet_count);
+		curr_udp_packet_count  += atomicRead64(&ws->udp_packet_count);
+		curr_icmp_packet_count += atomicRead64(&ws->icmp_packet_count);
+	}
+	capture_queue_stats(0, &curr_pfring_stat);
 	for (i=1; i < pfring_desc_nums; i++)
 	{
-		pfring_stats(pfring_desc_array[i], &temp);
+		capture_queue_stats(i, &temp);
 		curr_pfring_stat.recv += temp.recv;
 		curr_pfring_stat.drop += temp.drop;
 	}
@@ -2468,6 +3187,22 @@ pcap_print_stat(bool is_final_call)
 			printf("UDP packets: %lu\n", curr_udp_packet_count);
 		if ((protocol_mask & __PCAP_PROTO__ICMP) != 0)
 			printf("ICMP packets: %lu\n", curr_icmp_packet_count);
+		/* drops per queue, and backpressure per worker */
+		for (i=0; i < pfring_desc_nums; i++)
+		{
+			capture_queue_stats(i, &temp);
+			printf("Queue[%d]: recv=%lu drop=%lu\n",
+				   i, temp.recv, temp.drop);
+		}
+		for (i=0; i < num_threads; i++)
+		{
+			pcapWorkerStat *ws = &pcap_worker_stats[i];
+
+			printf("Worker[%d]: chunks=%lu write-wait=%.3fs\n",
+				   i,
+				   atomicRead64(&ws->chunk_write_count),
+				   (double)atomicRead64(&ws->chunk_write_usec) / 1000000.0);
+		}
 		return;
 	}
 	
@@ -2609,6 +3344,12 @@ int main(int argc, char *argv[])
 
 	/* parse command line options */
 	parse_options(argc, argv);
+	/* per-worker statistics */
+	pcap_worker_stats = aligned_alloc(sizeof(pcapWorkerStat),
+									  sizeof(pcapWorkerStat) * num_threads);
+	if (!pcap_worker_stats)
+		Elog("out of memory");
+	memset(pcap_worker_stats, 0, sizeof(pcapWorkerStat) * num_threads);
 	/* chunk-buffer pre-allocation */
 	arrow_chunks_array = palloc0(sizeof(SQLtable *) * num_threads);
 	for (i=0; i < num_threads; i++)
@@ -2623,7 +3364,14 @@ int main(int argc, char *argv[])
 	}
 
 	if (input_devname)
-		init_pfring_input();
+	{
+#ifdef WITH_AF_XDP
+		if (capture_by_xdp)
+			init_xdp_input();
+		else
+#endif
+			init_pfring_input();
+	}
 
 	/* open the output files, and related initialization */
 	arrow_file_desc_locks = palloc0(sizeof(pthread_mutex_t) * arrow_file_desc_nums);
@@ -2651,15 +3399,22 @@ int main(int argc, char *argv[])
 	workers = alloca(sizeof(pthread_t) * num_threads);
 	for (i=0; i < num_threads; i++)
 	{
-		rv = pthread_create(&workers[i], NULL,
-							input_devname ?
-							pfring_worker_main :
-							pcap_file_worker_main, (void *)i);
+		void	   *(*worker_main)(void *);
+
+		if (!input_devname)
+			worker_main = pcap_file_worker_main;
+#ifdef WITH_AF_XDP
+		else if (capture_by_xdp)
+			worker_main = xdp_worker_main;
+#endif
+		else
+			worker_main = pfring_worker_main;
+		rv = pthread_create(&workers[i], NULL, worker_main, (void *)i);
 		if (rv != 0)
 			Elog("failed on pthread_create: %s", strerror(rv));
 	}
 	/* print statistics */
-	if (pfring_desc_array && print_stat_interval > 0)
+	if (input_devname && print_stat_interval > 0)
 	{
 		sleep(print_stat_interval);
 		while (!do_shutdown)
@@ -8,6 +8,7 @@
  * it under the terms of the PostgreSQL License.
  */
 #include "sql2arrow.h"
+#include <endian.h>
 #include <limits.h>
 #include <libpq-fe.h>
 
@@ -50,6 +51,15 @@ typedef struct
 	PGresult   *res;
 	uint32_t	nitems;
 	uint32_t	index;
+	/* true, if transaction is already opened for the shared snapshot */
+	bool		in_xact;
+	/* if --copy is given */
+	bool		copy_mode;
+	bool		copy_header_done;
+	bool		copy_pending;	/* current row is not consumed yet */
+	char	   *copy_buf;		/* current row by PQgetCopyData */
+	int			copy_len;
+	int			copy_pos;		/* head of the field values in the row */
 	/* if --nestloop is given */
 	uint32_t	n_depth;
 	PGSTATE_NL	nestloop[1];
@@ -379,6 +389,122 @@ pgsql_move_next(PGSTATE *pgstate, uint32_t *rows_index)
 	}
 }
 
+/*
+ * pgsql_copy_move_next
+ *
+ * It fetches the next row of COPY ... TO STDOUT (FORMAT binary) into
+ * pgstate->copy_buf. The field values are decoded by the caller directly
+ * from the buffer, without PGresult.
+ */
+static bool
+pgsql_copy_move_next(PGSTATE *pgstate)
+{
+	PGconn	   *conn = pgstate->conn;
+	PGresult   *res;
+	char	   *buf;
+	int			len;
+	int			pos;
+	int16_t		nattrs;
+
+	for (;;)
+	{
+		if (pgstate->copy_buf)
+			PQfreemem(pgstate->copy_buf);
+		pgstate->copy_buf = NULL;
+		pgstate->copy_len = 0;
+		pgstate->copy_pos = 0;
+
+		len = PQgetCopyData(conn, &buf, 0);
+		if (len == -1)
+		{
+			/* end of the COPY */
+			while ((res = PQgetResult(conn)) != NULL)
+			{
+				if (PQresultStatus(res) != PGRES_COMMAND_OK)
+					Elog("SQL execution failed: %s",
+						 PQresultErrorMessage(res));
+				PQclear(res);
+			}
+			return false;
+		}
+		else if (len < 0)
+			Elog("failed on PQgetCopyData: %s", PQerrorMessage(conn));
+		pgstate->copy_buf = buf;
+		pgstate->copy_len = len;
+
+		pos = 0;
+		if (!pgstate->copy_header_done)
+		{
+			static const char copy_signature[11] = "PGCOPY\n\377\r\n\0";
+			uint32_t	extlen;
+
+			if (len < 19 || memcmp(buf, copy_signature, 11) != 0)
+				Elog("COPY binary signature is not recognized");
+			/* skip flags field, then header extension area */
+			extlen = be32toh(*((uint32_t *)(buf + 15)));
+			pos = 19 + extlen;
+			pgstate->copy_header_done = true;
+			if (pos == len)
+				continue;	/* header only */
+		}
+		if (pos + sizeof(int16_t) > len)
+			Elog("COPY binary row is corrupted");
+		nattrs = (int16_t)be16toh(*((uint16_t *)(buf + pos)));
+		if (nattrs < 0)
+			continue;		/* file trailer */
+		pgstate->copy_pos = pos;
+		return true;
+	}
+}
+
+/*
+ * pgsql_copy_fetch_results
+ */
+static bool
+pgsql_copy_fetch_results(PGSTATE *pgstate, SQLtable *table)
+{
+	const char *buf;
+	int			pos;
+	int			i, nattrs;
+	size_t		usage = 0;
+
+	if (pgstate->copy_pending)
+		pgstate->copy_pending = false;
+	else if (!pgsql_copy_move_next(pgstate))
+		return false;		/* end of the scan */
+
+	buf = pgstate->copy_buf;
+	pos = pgstate->copy_pos;
+	nattrs = (int16_t)be16toh(*((uint16_t *)(buf + pos)));
+	if (nattrs != table->nfields)
+		Elog("COPY binary row has unexpected number of fields (%d of %d)",
+			 nattrs, table->nfields);
+	pos += sizeof(int16_t);
+	for (i=0; i < nattrs; i++)
+	{
+		SQLfield   *column = &table->columns[i];
+		int32_t		sz;
+
+		if (pos + sizeof(int32_t) > pgstate->copy_len)
+			Elog("COPY binary row is corrupted");
+		sz = (int32_t)be32toh(*((uint32_t *)(buf + pos)));
+		pos += sizeof(int32_t);
+		if (sz < 0)
+			usage += sql_field_put_value(column, NULL, 0);
+		else
+		{
+			if (pos + sz > pgstate->copy_len)
+				Elog("COPY binary row is corrupted");
+			usage += sql_field_put_value(column, buf + pos, sz);
+			pos += sz;
+		}
+	}
+	table->usage = usage;
+	table->nitems++;
+
+	return true;
+}
+
 /*
  * pgsql_create_dictionary
  */
@@ -997,6 +1123,180 @@ sqldb_server_connect(const char *sqldb_hostname,
 	return pgstate;
 }
 
+/*
+ * sqldb_export_snapshot - begins a transaction and exports its snapshot
+ *
+ * The transaction must be kept until all the other connections import
+ * the snapshot, so it is closed with the connection.
+ */
+char *
+sqldb_export_snapshot(void *sqldb_state)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+	PGconn	   *conn = pgstate->conn;
+	PGresult   *res;
+	char	   *snapshot;
+
+	assert(!pgstate->in_xact);
+	res = PQexec(conn, "BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY");
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		Elog("unable to begin transaction: %s", PQresultErrorMessage(res));
+	PQclear(res);
+
+	res = PQexec(conn, "SELECT pg_catalog.pg_export_snapshot()");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK ||
+		PQntuples(res) != 1 ||
+		PQgetisnull(res, 0, 0))
+		Elog("failed on pg_export_snapshot(): %s",
+			 PQresultErrorMessage(res));
+	snapshot = pstrdup(PQgetvalue(res, 0, 0));
+	PQclear(res);
+
+	pgstate->in_xact = true;
+	return snapshot;
+}
+
+/*
+ * sqldb_import_snapshot - begins a transaction with the exported snapshot
+ */
+void
+sqldb_import_snapshot(void *sqldb_state, const char *snapshot)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+	PGconn	   *conn = pgstate->conn;
+	PGresult   *res;
+	char		query[200];
+
+	assert(!pgstate->in_xact);
+	res = PQexec(conn, "BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY");
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		Elog("unable to begin transaction: %s", PQresultErrorMessage(res));
+	PQclear(res);
+
+	snprintf(query, sizeof(query),
+			 "SET TRANSACTION SNAPSHOT '%s'", snapshot);
+	res = PQexec(conn, query);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		Elog("failed on import snapshot '%s': %s",
+			 snapshot, PQresultErrorMessage(res));
+	PQclear(res);
+
+	pgstate->in_xact = true;
+}
+
+/*
+ * sqldb_relation_nblocks - number of blocks of the relation
+ */
+int64_t
+sqldb_relation_nblocks(void *sqldb_state, const char *relname)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+	PGconn	   *conn = pgstate->conn;
+	PGresult   *res;
+	char	   *literal;
+	char	   *query;
+	int64_t		nblocks;
+
+	literal = PQescapeLiteral(conn, relname, strlen(relname));
+	if (!literal)
+		Elog("failed on PQescapeLiteral: %s", PQerrorMessage(conn));
+	query = palloc(strlen(literal) + 200);
+	sprintf(query,
+			"SELECT pg_catalog.pg_relation_size(%s::regclass)"
+			"     / pg_catalog.current_setting('block_size')::int",
+			literal);
+	PQfreemem(literal);
+
+	res = PQexec(conn, query);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK ||
+		PQntuples(res) != 1 ||
+		PQgetisnull(res, 0, 0))
+		Elog("failed on the query [%s]: %s",
+			 query, PQresultErrorMessage(res));
+	nblocks = atol(PQgetvalue(res, 0, 0));
+	PQclear(res);
+	pfree(query);
+
+	return nblocks;
+}
+
+/*
+ * sqldb_query_scalar - run a query that returns a single text value
+ *
+ * It returns NULL, if the query returns NULL.
+ */
+char *
+sqldb_query_scalar(void *sqldb_state, const char *query)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+	PGresult   *res;
+	char	   *value = NULL;
+
+	res = PQexec(pgstate->conn, query);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK ||
+		PQntuples(res) != 1 ||
+		PQnfields(res) != 1)
+		Elog("failed on the query [%s]: %s",
+			 query, PQresultErrorMessage(res));
+	if (!PQgetisnull(res, 0, 0))
+		value = pstrdup(PQgetvalue(res, 0, 0));
+	PQclear(res);
+
+	return value;
+}
+
+/*
+ * sqldb_enable_copy_mode - fetch results by COPY ... (FORMAT binary)
+ */
+void
+sqldb_enable_copy_mode(void *sqldb_state)
+{
+	PGSTATE	   *pgstate = sqldb_state;
+
+	if (pgstate->n_depth > 0)
+		Elog("COPY mode is not available with --inner-join/--outer-join");
+	pgstate->copy_mode = true;
+}
+
+/*
+ * pgsql_copy_begin_query
+ */
+static SQLtable *
+pgsql_copy_begin_query(PGSTATE *pgstate,
+					   const char *sqldb_command,
+					   ArrowFileInfo *af_info,
+					   SQLdictionary *dictionary_list)
+{
+	PGconn	   *conn = pgstate->conn;
+	PGresult   *res;
+	char	   *query;
+
+	/* describe the result type of the query, without execution */
+	res = PQprepare(conn, "", sqldb_command, 0, NULL);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		Elog("failed on PQprepare: %s", PQresultErrorMessage(res));
+	PQclear(res);
+	res = PQdescribePrepared(conn, "");
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		Elog("failed on PQdescribePrepared: %s", PQresultErrorMessage(res));
+	pgstate->res = res;
+
+	/* kick COPY TO STDOUT in binary format */
+	query = palloc(strlen(sqldb_command) + 1024);
+	sprintf(query, "COPY (%s) TO STDOUT (FORMAT binary)", sqldb_command);
+	res = PQexec(conn, query);
+	if (PQresultStatus(res) != PGRES_COPY_OUT)
+		Elog("unable to run COPY TO STDOUT: %s", PQresultErrorMessage(res));
+	PQclear(res);
+	pfree(query);
+
+	/* move to the first tuple */
+	if (!pgsql_copy_move_next(pgstate))
+		return NULL;
+	pgstate->copy_pending = true;
+	return pgsql_create_buffer(pgstate, af_info, dictionary_list);
+}
+
 /*
  * sqldb_begin_query
  */
@@ -1011,11 +1311,19 @@ sqldb_begin_query(void *sqldb_state,
 	PGresult   *res;
 	char	   *query;
 
-	/* begin read-only transaction */
-	res = PQexec(conn, "BEGIN READ ONLY");
-	if (PQresultStatus(res) != PGRES_COMMAND_OK)
-		Elog("unable to begin transaction: %s", PQresultErrorMessage(res));
-	PQclear(res);
+	/* begin read-only transaction, unless snapshot is already shared */
+	if (!pgstate->in_xact)
+	{
+		res = PQexec(conn, "BEGIN READ ONLY");
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			Elog("unable to begin transaction: %s", PQresultErrorMessage(res));
+		PQclear(res);
+	}
+	if (pgstate->copy_mode)
+		return pgsql_copy_begin_query(pgstate,
+									  sqldb_command,
+									  af_info,
+									  dictionary_list);
 
 	/* declare cursor */
 	query = palloc(strlen(sqldb_command) + 1024);
@@ -1046,6 +1354,9 @@ sqldb_fetch_results(void *sqldb_state, SQLtable *table)
 	int			i, j, ncols;
 	size_t		usage = 0;
 
+	if (pgstate->copy_mode)
+		return pgsql_copy_fetch_results(pgstate, table);
+
 	rows_index = alloca(sizeof(uint32_t) * (pgstate->n_depth + 1));
 	if (!pgsql_move_next(pgstate, rows_index))
 		return false;		/* end of the scan */
@@ -1109,12 +1420,17 @@ sqldb_close_connection(void *sqldb_state)
 		if (nl->res)
 			PQclear(nl->res);
 	}
+	if (pgstate->copy_buf)
+		PQfreemem(pgstate->copy_buf);
 	/* close the cursor */
-	res = PQexec(conn, "CLOSE " CURSOR_NAME);
-	if (PQresultStatus(res) != PGRES_COMMAND_OK)
-		Elog("failed on close cursor '%s': %s", CURSOR_NAME,
-			 PQresultErrorMessage(res));
-	PQclear(res);
+	if (!pgstate->copy_mode)
+	{
+		res = PQexec(conn, "CLOSE " CURSOR_NAME);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			Elog("failed on close cursor '%s': %s", CURSOR_NAME,
+				 PQresultErrorMessage(res));
+		PQclear(res);
+	}
 	/* close the connection */
 	PQfinish(conn);
 }
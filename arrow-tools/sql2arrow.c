@@ -16,9 +16,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <strings.h>
+#include <pthread.h>
 
 /* command options */
 static char	   *sqldb_command = NULL;
+static char	   *sqldb_table_name = NULL;
 static char	   *output_filename = NULL;
 static char	   *append_filename = NULL;
 static size_t	batch_segment_sz = 0;
@@ -29,7 +31,19 @@ static char	   *sqldb_password = NULL;
 static char	   *sqldb_database = NULL;
 static char	   *dump_arrow_filename = NULL;
 static char	   *stat_embedded_columns = NULL;
+static char	   *bloom_embedded_columns = NULL;
+static char	   *sort_by_columns = NULL;
+static char	   *zorder_columns = NULL;
+#ifdef __PG2ARROW__
+static char	   *watermark_column = NULL;
+static char	   *watermark_lower = NULL;
+static char	   *watermark_upper = NULL;
+#endif	/* __PG2ARROW__ */
 static int		shows_progress = 0;
+static int		num_workers = 1;
+static bool		parallel_split_files = false;
+static bool		copy_binary_mode = false;
+static bool		pipeline_enabled = true;
 static userConfigOption *sqldb_session_configs = NULL;
 static nestLoopOption *sqldb_nestloop_options = NULL;
 
@@ -560,6 +574,70 @@ enable_embedded_stats(SQLtable *table)
 	}
 }
 
+static bool
+__enable_field_bloom(SQLfield *field)
+{
+	if (field->enumdict)
+		return false;
+	switch (field->arrow_type.node.tag)
+	{
+		case ArrowNodeTag__Int:
+		case ArrowNodeTag__Utf8:
+		case ArrowNodeTag__Binary:
+			field->bloom_enabled = true;
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
+
+static void
+enable_embedded_bloom(SQLtable *table)
+{
+	char	   *buffer;
+	char	   *name, *pos;
+	int			j;
+
+	/* disabled? */
+	if (!bloom_embedded_columns)
+		return;
+
+	/* elsewhere, enables bloom filter for each column specified */
+	buffer = alloca(strlen(bloom_embedded_columns) + 1);
+	strcpy(buffer, bloom_embedded_columns);
+	for (name = strtok_r(buffer, ",", &pos);
+		 name != NULL;
+		 name = strtok_r(NULL, ",", &pos))
+	{
+		bool	found = false;
+
+		name = __trim(name);
+		for (j=0; j < table->nfields; j++)
+		{
+			SQLfield   *field = &table->columns[j];
+
+			if (strcmp(field->field_name, name) == 0)
+			{
+				if (!__enable_field_bloom(field))
+					Elog("field [%s; %s] does not support bloom filter",
+						 name, field->arrow_type.node.tagName);
+				found = true;
+			}
+		}
+
+		if (!found)
+			Elog("field name [%s], specified by --bloom option, was not found",
+				 name);
+	}
+	/*
+	 * bloom filters are built in parallel at the end of record-batch,
+	 * unless parallel workers already consume the CPU cores.
+	 */
+	if (num_workers == 1)
+		table->num_finalize_threads = sysconf(_SC_NPROCESSORS_ONLN);
+}
+
 static void
 usage(void)
 {
@@ -585,6 +663,18 @@ usage(void)
 		  "  -S, --stat[=COLUMNS] embeds min/max statistics for each record batch\n"
 		  "                       COLUMNS is a comma-separated list of the target\n"
 		  "                       columns if partially enabled.\n"
+#ifdef __PG2ARROW__
+		  "      --bloom=COLUMNS  embeds bloom filter for each record batch\n"
+		  "                       COLUMNS is a comma-separated list of the target\n"
+		  "                       columns (integer, text or binary types).\n"
+		  "      --parallel=N     exports the query by N workers in parallel\n"
+		  "                       -t splits the table by ctid ranges, or -c command\n"
+		  "                       must contain $(WORKER_ID) and $(N_WORKERS) tokens.\n"
+		  "      --parallel-files writes out the results to N files, instead of\n"
+		  "                       the single file.\n"
+		  "      --copy           fetches the results by COPY (FORMAT binary)\n"
+		  "                       stream, instead of the cursor.\n"
+#endif
 		  "\n"
 		  "Arrow format options:\n"
 		  "  -s, --segment-size=SIZE size of record batch for each\n"
@@ -604,6 +694,13 @@ usage(void)
 		  "Other options:\n"
 		  "      --dump=FILENAME  dump information of arrow file\n"
 		  "      --progress       shows progress of the job\n"
+		  "      --no-pipeline    disables background write of record batches\n"
+		  "      --sort-by=COLUMNS sorts the results by COLUMNS (ORDER BY clause)\n"
+#ifdef __PG2ARROW__
+		  "      --z-order=COLUMNS sorts the results by Z-order of 2-4 COLUMNS\n"
+		  "      --watermark=COLUMN exports only the rows newer than the watermark\n"
+		  "                       of the --append file, by the monotonic COLUMN.\n"
+#endif
 		  "      --set=NAME:VALUE config option to set before SQL execution\n"
 		  "      --help           shows this message\n"
 		  "\n"
@@ -637,6 +734,18 @@ parse_options(int argc, char * const argv[])
 		{"set",          required_argument, NULL, 1003},
 		{"inner-join",   required_argument, NULL, 1004},
 		{"outer-join",   required_argument, NULL, 1005},
+#ifdef __PG2ARROW__
+		{"bloom",        required_argument, NULL, 1006},
+		{"parallel",     required_argument, NULL, 1007},
+		{"parallel-files", no_argument,     NULL, 1008},
+		{"copy",         no_argument,       NULL, 1009},
+#endif /* __PG2ARROW__ */
+		{"no-pipeline",  no_argument,       NULL, 1010},
+		{"sort-by",      required_argument, NULL, 1011},
+#ifdef __PG2ARROW__
+		{"z-order",      required_argument, NULL, 1012},
+		{"watermark",    required_argument, NULL, 1013},
+#endif /* __PG2ARROW__ */
 		{"stat",         optional_argument, NULL, 'S'},
 		{"help",         no_argument,       NULL, 9999},
 		{NULL, 0, NULL, 0},
@@ -687,6 +796,7 @@ parse_options(int argc, char * const argv[])
 				if (!sqldb_command)
 					Elog("out of memory");
 				sprintf(sqldb_command, "SELECT * FROM %s", optarg);
+				sqldb_table_name = optarg;
 				break;
 
 			case 'o':
@@ -774,6 +884,30 @@ parse_options(int argc, char * const argv[])
 				shows_progress = 1;
 				break;
 
+			case 1010:		/* --no-pipeline */
+				pipeline_enabled = false;
+				break;
+
+			case 1011:		/* --sort-by */
+				if (sort_by_columns)
+					Elog("--sort-by option was supplied twice");
+				sort_by_columns = optarg;
+				break;
+
+			case 1012:		/* --z-order */
+				if (zorder_columns)
+					Elog("--z-order option was supplied twice");
+				zorder_columns = optarg;
+				break;
+
+#ifdef __PG2ARROW__
+			case 1013:		/* --watermark */
+				if (watermark_column)
+					Elog("--watermark option was supplied twice");
+				watermark_column = optarg;
+				break;
+#endif	/* __PG2ARROW__ */
+
 			case 1003:		/* --set */
 				{
 					userConfigOption *conf;
@@ -811,6 +945,28 @@ parse_options(int argc, char * const argv[])
 				}
 				break;
 #endif	/* __PG2ARROW__ */
+			case 1006:		/* --bloom */
+				if (bloom_embedded_columns)
+					Elog("--bloom option was supplied twice");
+				bloom_embedded_columns = optarg;
+				break;
+			case 1007:		/* --parallel */
+				{
+					char   *end;
+
+					if (num_workers > 1)
+						Elog("--parallel option was supplied twice");
+					num_workers = strtol(optarg, &end, 10);
+					if (*end != '\0' || num_workers < 1 || num_workers > 256)
+						Elog("--parallel must take number of workers (1...256)");
+				}
+				break;
+			case 1008:		/* --parallel-files */
+				parallel_split_files = true;
+				break;
+			case 1009:		/* --copy */
+				copy_binary_mode = true;
+				break;
 			case 'S':		/* --stat */
 				{
 					if (stat_embedded_columns)
@@ -862,6 +1018,608 @@ parse_options(int argc, char * const argv[])
 		Elog("Neither -c nor -t options are supplied");
 	if (batch_segment_sz == 0)
 		batch_segment_sz = (1UL << 28);		/* 256MB in default */
+	if (num_workers > 1)
+	{
+		if (!sqldb_table_name && !strstr(sqldb_command, "$(WORKER_ID)"))
+			Elog("--parallel needs -t, or $(WORKER_ID) token in the -c command");
+		if (parallel_split_files && append_filename)
+			Elog("--parallel-files and --append are exclusive");
+	}
+	else if (parallel_split_files)
+		Elog("--parallel-files needs --parallel=N (N > 1)");
+	if (sort_by_columns && zorder_columns)
+		Elog("--sort-by and --z-order are exclusive");
+	if (copy_binary_mode && sqldb_nestloop_options)
+		Elog("--copy and --inner-join/--outer-join are exclusive");
+}
+
+#ifdef __PG2ARROW__
+/*
+ * Parallel export (--parallel=N)
+ *
+ * The source query is split into N portions; by ctid ranges if -t is given,
+ * or by $(WORKER_ID) and $(N_WORKERS) tokens in the -c command. Each worker
+ * thread runs its portion on its own connection under the snapshot exported
+ * by the leader connection, then writes out record batches to the shared
+ * result file, or to its own file if --parallel-files.
+ */
+typedef struct
+{
+	pthread_t	thread;
+	int			worker_id;
+	void	   *sqldb_state;
+	const char *command;
+	ArrowFileInfo *af_info;
+	SQLdictionary *sql_dict_list;
+	SQLtable   *table;
+} parallelWorker;
+
+static pthread_mutex_t	parallel_write_lock = PTHREAD_MUTEX_INITIALIZER;
+static loff_t			parallel_write_f_pos = 0;
+static parallelWorker  *parallel_workers = NULL;
+
+/*
+ * parallel_worker_command - query to be run by the worker
+ */
+static char *
+parallel_worker_command(void *sqldb_state, int worker_id)
+{
+	char	   *query;
+	char	   *dst;
+	const char *src;
+
+	if (sqldb_table_name)
+	{
+		static int64_t	nblocks = -1;
+		int64_t			unitsz;
+		int64_t			head, tail;
+
+		if (nblocks < 0)
+			nblocks = sqldb_relation_nblocks(sqldb_state, sqldb_table_name);
+		unitsz = (nblocks + num_workers - 1) / num_workers;
+		head = unitsz * worker_id;
+		tail = unitsz * (worker_id + 1);
+
+		query = palloc(strlen(sqldb_table_name) + 200);
+		if (worker_id == 0)
+			sprintf(query, "SELECT * FROM %s"
+					" WHERE ctid < '(%ld,0)'::tid",
+					sqldb_table_name, tail);
+		else if (worker_id == num_workers - 1)
+			sprintf(query, "SELECT * FROM %s"
+					" WHERE ctid >= '(%ld,0)'::tid",
+					sqldb_table_name, head);
+		else
+			sprintf(query, "SELECT * FROM %s"
+					" WHERE ctid >= '(%ld,0)'::tid"
+					"   AND ctid <  '(%ld,0)'::tid",
+					sqldb_table_name, head, tail);
+		return query;
+	}
+
+	/* replace $(WORKER_ID) and $(N_WORKERS) tokens */
+	query = palloc(strlen(sqldb_command) * 4 + 100);
+	for (src = sqldb_command, dst = query; *src != '\0'; )
+	{
+		if (strncmp(src, "$(WORKER_ID)", 12) == 0)
+		{
+			dst += sprintf(dst, "%d", worker_id);
+			src += 12;
+		}
+		else if (strncmp(src, "$(N_WORKERS)", 12) == 0)
+		{
+			dst += sprintf(dst, "%d", num_workers);
+			src += 12;
+		}
+		else
+			*dst++ = *src++;
+	}
+	*dst = '\0';
+
+	return query;
+}
+
+/*
+ * parallel_output_filename - result file of the worker, if --parallel-files
+ *
+ * It inserts the worker-id in front of the extension; "foo.arrow" becomes
+ * "foo.0.arrow" for example.
+ */
+static const char *
+parallel_output_filename(int worker_id)
+{
+	const char *ext;
+	char	   *fname;
+
+	if (!output_filename || !parallel_split_files)
+		return output_filename;
+	fname = palloc(strlen(output_filename) + 20);
+	ext = strrchr(output_filename, '.');
+	if (ext && !strchr(ext, '/') && ext != output_filename)
+	{
+		int		len = ext - output_filename;
+
+		sprintf(fname, "%.*s.%d%s", len, output_filename, worker_id, ext);
+	}
+	else
+		sprintf(fname, "%s.%d", output_filename, worker_id);
+	return fname;
+}
+
+/*
+ * parallel_write_record_batch
+ */
+static void
+parallel_write_record_batch(SQLtable *table)
+{
+	if (parallel_split_files)
+	{
+		writeArrowRecordBatch(table);
+		shows_record_batch_progress(table, table->nitems);
+	}
+	else
+	{
+		/* serialization of the writes to the shared result file */
+		pthread_mutex_lock(&parallel_write_lock);
+		table->f_pos = parallel_write_f_pos;
+		writeArrowRecordBatch(table);
+		parallel_write_f_pos = table->f_pos;
+		shows_record_batch_progress(table, table->nitems);
+		pthread_mutex_unlock(&parallel_write_lock);
+	}
+	sql_table_clear(table);
+}
+
+static void *
+parallel_worker_main(void *__priv)
+{
+	parallelWorker *pw = __priv;
+	SQLtable   *leader = parallel_workers[0].table;
+	SQLtable   *table = pw->table;
+
+	if (!table)
+	{
+		table = sqldb_begin_query(pw->sqldb_state,
+								  pw->command,
+								  pw->af_info,
+								  pw->sql_dict_list);
+		if (!table)
+			return NULL;
+		if (table->nfields != leader->nfields)
+			Elog("worker %d: number of columns mismatch (%d of %d)",
+				 pw->worker_id, table->nfields, leader->nfields);
+		table->segment_sz = batch_segment_sz;
+		enable_embedded_stats(table);
+		enable_embedded_bloom(table);
+		if (parallel_split_files)
+		{
+			table->customMetadata = leader->customMetadata;
+			table->numCustomMetadata = leader->numCustomMetadata;
+			setup_output_file(table, parallel_output_filename(pw->worker_id));
+			writeArrowDictionaryBatches(table);
+		}
+		else
+		{
+			table->fdesc = leader->fdesc;
+			table->filename = leader->filename;
+		}
+		pw->table = table;
+	}
+
+	while (sqldb_fetch_results(pw->sqldb_state, table))
+	{
+		if (table->usage > batch_segment_sz)
+			parallel_write_record_batch(table);
+	}
+	if (table->nitems > 0)
+		parallel_write_record_batch(table);
+	if (parallel_split_files)
+	{
+		writeArrowFooter(table);
+		close(table->fdesc);
+	}
+	return NULL;
+}
+
+/*
+ * parallel_merge_record_batches
+ *
+ * It merges the record batches written by the worker to the footer of the
+ * leader, with min/max statistics and bloom filters if any.
+ */
+static void
+parallel_merge_record_batches(SQLtable *leader, SQLtable *table)
+{
+	int		base = leader->numRecordBatches;
+	int		i, j;
+
+	for (i=0; i < table->numRecordBatches; i++)
+		sql_table_append_record_batch(leader, &table->recordBatches[i]);
+
+	for (j=0; j < table->nfields; j++)
+	{
+		SQLfield   *src = &table->columns[j];
+		SQLfield   *dst = &leader->columns[j];
+
+		while (src->stat_list)
+		{
+			SQLstat	   *item = src->stat_list;
+
+			src->stat_list = item->next;
+			item->rb_index += base;
+			item->next = dst->stat_list;
+			dst->stat_list = item;
+		}
+		while (src->bloom_list)
+		{
+			SQLbloom   *item = src->bloom_list;
+
+			src->bloom_list = item->next;
+			item->rb_index += base;
+			item->next = dst->bloom_list;
+			dst->bloom_list = item;
+		}
+	}
+}
+
+/*
+ * parallel_export_main
+ */
+static void
+parallel_export_main(SQLtable *leader,
+					 ArrowFileInfo *af_info)
+{
+	int		i;
+
+	parallel_workers[0].table = leader;
+	parallel_write_f_pos = leader->f_pos;
+	for (i=0; i < num_workers; i++)
+	{
+		parallelWorker *pw = &parallel_workers[i];
+
+		pw->af_info = af_info;
+		pw->sql_dict_list = leader->sql_dict_list;
+		if ((errno = pthread_create(&pw->thread, NULL,
+									parallel_worker_main, pw)) != 0)
+			Elog("failed on pthread_create: %m");
+	}
+	for (i=0; i < num_workers; i++)
+	{
+		if ((errno = pthread_join(parallel_workers[i].thread, NULL)) != 0)
+			Elog("failed on pthread_join: %m");
+	}
+
+	if (!parallel_split_files)
+	{
+		leader->f_pos = parallel_write_f_pos;
+		for (i=1; i < num_workers; i++)
+		{
+			if (parallel_workers[i].table)
+				parallel_merge_record_batches(leader, parallel_workers[i].table);
+		}
+	}
+}
+#endif	/* __PG2ARROW__ */
+
+/*
+ * Pipelined write of the record batches
+ *
+ * The main thread fetches the query results and builds up the file image
+ * of the record batch on the memory, then the writer thread writes it out
+ * to the result file in the background. So, the next fetch can run
+ * concurrently to the storage I/O.
+ */
+typedef struct pipelineImage
+{
+	struct pipelineImage *next;
+	off_t		f_pos;
+	size_t		length;
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} pipelineImage;
+
+#define PIPELINE_MAX_QUEUED		2
+
+static pthread_mutex_t	pipeline_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	pipeline_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t		pipeline_writer;
+static pipelineImage   *pipeline_head = NULL;
+static pipelineImage   *pipeline_tail = NULL;
+static int				pipeline_nqueued = 0;
+static bool				pipeline_done = false;
+
+static void *
+pipeline_alloc_image(size_t length, void *data)
+{
+	pipelineImage *image = palloc(offsetof(pipelineImage, data[length]));
+
+	image->next = NULL;
+	image->length = length;
+	*((pipelineImage **)data) = image;
+
+	return image->data;
+}
+
+static void *
+pipeline_writer_main(void *__priv)
+{
+	SQLtable   *table = __priv;
+
+	for (;;)
+	{
+		pipelineImage *image;
+		size_t		offset = 0;
+		ssize_t		nbytes;
+
+		pthread_mutex_lock(&pipeline_lock);
+		while (!pipeline_head && !pipeline_done)
+			pthread_cond_wait(&pipeline_cond, &pipeline_lock);
+		image = pipeline_head;
+		if (image)
+		{
+			pipeline_head = image->next;
+			if (!pipeline_head)
+				pipeline_tail = NULL;
+			pipeline_nqueued--;
+			pthread_cond_broadcast(&pipeline_cond);
+		}
+		pthread_mutex_unlock(&pipeline_lock);
+		if (!image)
+			break;		/* no more record batches */
+
+		while (offset < image->length)
+		{
+			nbytes = pwrite(table->fdesc,
+							image->data + offset,
+							image->length - offset,
+							image->f_pos + offset);
+			if (nbytes < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				Elog("failed on pwrite('%s'): %m", table->filename);
+			}
+			offset += nbytes;
+		}
+		pfree(image);
+	}
+	return NULL;
+}
+
+/*
+ * pipeline_write_record_batch
+ */
+static void
+pipeline_write_record_batch(SQLtable *table)
+{
+	pipelineImage *image = NULL;
+	off_t		f_pos = table->f_pos;
+
+	copyArrowRecordBatchImage(table, pipeline_alloc_image, &image);
+	image->f_pos = f_pos;
+	shows_record_batch_progress(table, table->nitems);
+	sql_table_clear(table);
+
+	pthread_mutex_lock(&pipeline_lock);
+	while (pipeline_nqueued >= PIPELINE_MAX_QUEUED)
+		pthread_cond_wait(&pipeline_cond, &pipeline_lock);
+	if (!pipeline_tail)
+		pipeline_head = image;
+	else
+		pipeline_tail->next = image;
+	pipeline_tail = image;
+	pipeline_nqueued++;
+	pthread_cond_broadcast(&pipeline_cond);
+	pthread_mutex_unlock(&pipeline_lock);
+}
+
+/*
+ * pipeline_export_main
+ */
+static void
+pipeline_export_main(void *sqldb_state, SQLtable *table)
+{
+	if ((errno = pthread_create(&pipeline_writer, NULL,
+								pipeline_writer_main, table)) != 0)
+		Elog("failed on pthread_create: %m");
+
+	while (sqldb_fetch_results(sqldb_state, table))
+	{
+		if (table->usage > batch_segment_sz)
+			pipeline_write_record_batch(table);
+	}
+	if (table->nitems > 0)
+		pipeline_write_record_batch(table);
+
+	/* wait for completion of the pending writes */
+	pthread_mutex_lock(&pipeline_lock);
+	pipeline_done = true;
+	pthread_cond_broadcast(&pipeline_cond);
+	pthread_mutex_unlock(&pipeline_lock);
+	if ((errno = pthread_join(pipeline_writer, NULL)) != 0)
+		Elog("failed on pthread_join: %m");
+}
+
+#ifdef __PG2ARROW__
+/*
+ * Incremental export by the watermark column
+ *
+ * --watermark=COLUMN exports only the rows newer than the high-water mark
+ * saved in the custom metadata of the --append file, then saves the new
+ * one. The upper bound is fixed prior to the export, so the rows inserted
+ * in the meantime are exported on the next run without duplication.
+ */
+static char *
+__quote_literal(const char *str)
+{
+	char	   *buf = palloc(2 * strlen(str) + 3);
+	char	   *pos = buf;
+
+	*pos++ = '\'';
+	for (; *str != '\0'; str++)
+	{
+		if (*str == '\'')
+			*pos++ = '\'';
+		*pos++ = *str;
+	}
+	*pos++ = '\'';
+	*pos = '\0';
+
+	return buf;
+}
+
+static const char *
+__lookup_custom_metadata(ArrowKeyValue *kv_array, int kv_nitems,
+						 const char *key)
+{
+	int		i;
+
+	for (i=0; i < kv_nitems; i++)
+	{
+		ArrowKeyValue *kv = &kv_array[i];
+
+		if (kv->_key_len == strlen(key) &&
+			strncmp(kv->key, key, kv->_key_len) == 0)
+			return (kv->value ? pstrdup(kv->value) : NULL);
+	}
+	return NULL;
+}
+
+static bool
+setup_watermark(void *sqldb_state, ArrowFileInfo *af_info)
+{
+	char	   *query;
+
+	if (af_info)
+	{
+		ArrowSchema *schema = &af_info->footer.schema;
+		const char *column;
+
+		column = __lookup_custom_metadata(schema->custom_metadata,
+										  schema->_num_custom_metadata,
+										  "watermark_column");
+		if (!column)
+			Elog("'%s' has no watermark, so --watermark may export duplicated rows",
+				 append_filename);
+		if (strcmp(column, watermark_column) != 0)
+			Elog("--watermark=%s mismatch to the watermark column '%s' of '%s'",
+				 watermark_column, column, append_filename);
+		watermark_lower = (char *)
+			__lookup_custom_metadata(schema->custom_metadata,
+									 schema->_num_custom_metadata,
+									 "watermark_value");
+	}
+
+	query = palloc(strlen(sqldb_command) + 2 * strlen(watermark_column) +
+				   (watermark_lower ? 2 * strlen(watermark_lower) : 0) + 200);
+	if (!watermark_lower)
+		sprintf(query, "SELECT max(__wm.%s)::text FROM (%s) __wm",
+				watermark_column, sqldb_command);
+	else
+		sprintf(query, "SELECT max(__wm.%s)::text FROM (%s) __wm"
+				" WHERE __wm.%s > %s",
+				watermark_column, sqldb_command,
+				watermark_column, __quote_literal(watermark_lower));
+	watermark_upper = sqldb_query_scalar(sqldb_state, query);
+	pfree(query);
+
+	return (watermark_upper != NULL);
+}
+
+static const char *
+watermark_query_command(const char *command)
+{
+	char	   *query;
+
+	if (!watermark_upper)
+		return command;
+	query = palloc(strlen(command) + 2 * strlen(watermark_column) +
+				   2 * strlen(watermark_upper) +
+				   (watermark_lower ? 2 * strlen(watermark_lower) : 0) + 200);
+	if (!watermark_lower)
+		sprintf(query, "SELECT * FROM (%s) __wm WHERE __wm.%s <= %s",
+				command,
+				watermark_column, __quote_literal(watermark_upper));
+	else
+		sprintf(query, "SELECT * FROM (%s) __wm WHERE __wm.%s > %s"
+				" AND __wm.%s <= %s",
+				command,
+				watermark_column, __quote_literal(watermark_lower),
+				watermark_column, __quote_literal(watermark_upper));
+	return query;
+}
+#endif	/* __PG2ARROW__ */
+
+/*
+ * sort_query_command
+ *
+ * It wraps up the query to deliver the results in the order of --sort-by,
+ * or --z-order. The sort shall run on the database server, so it works
+ * within the bounded memory (work_mem) regardless of the result size,
+ * and the record batches will have tight min/max ranges.
+ */
+#define ZORDER_MAX_COLUMNS		4
+
+static const char *
+sort_query_command(const char *command)
+{
+	char	   *query;
+	char	   *buffer;
+	char	   *name, *pos;
+	char	   *names[ZORDER_MAX_COLUMNS];
+	int			i, k, ncols = 0;
+	int			nbits;
+	size_t		len;
+
+	if (sort_by_columns)
+	{
+		query = palloc(strlen(command) + strlen(sort_by_columns) + 100);
+		sprintf(query, "SELECT * FROM (%s) __sort ORDER BY %s",
+				command, sort_by_columns);
+		return query;
+	}
+	if (!zorder_columns)
+		return command;
+
+	buffer = alloca(strlen(zorder_columns) + 1);
+	strcpy(buffer, zorder_columns);
+	for (name = strtok_r(buffer, ",", &pos);
+		 name != NULL;
+		 name = strtok_r(NULL, ",", &pos))
+	{
+		if (ncols >= ZORDER_MAX_COLUMNS)
+			Elog("--z-order takes up to %d columns", ZORDER_MAX_COLUMNS);
+		names[ncols++] = pstrdup(__trim(name));
+	}
+	if (ncols < 2)
+		Elog("--z-order needs two or more columns");
+	nbits = (ncols > 3 ? 62 / ncols : 16);
+
+	/*
+	 * Each column is normalized to [0 ... 2^nbits-1] by its rank, then
+	 * the bits are interleaved to the Z-order (Morton) key. The whole-row
+	 * reference (__q) keeps the columns of the original query as is.
+	 */
+	len = strlen(command) + 1000 + ncols * (200 + nbits * 80);
+	for (k=0; k < ncols; k++)
+		len += strlen(names[k]);
+	query = palloc(len);
+	pos = query;
+	pos += sprintf(pos, "SELECT (__zorder.__q).* FROM (SELECT __q");
+	for (k=0; k < ncols; k++)
+		pos += sprintf(pos, ", (pg_catalog.percent_rank() OVER"
+					   " (ORDER BY __q.%s) * %u)::bigint __z%d",
+					   names[k], (1U << nbits) - 1, k);
+	pos += sprintf(pos, " FROM (%s) __q) __zorder ORDER BY ", command);
+	for (i=0; i < nbits; i++)
+	{
+		for (k=0; k < ncols; k++)
+		{
+			pos += sprintf(pos, "%s(((__z%d >> %d) & 1) << %d)",
+						   (i == 0 && k == 0) ? "" : " + ",
+						   k, i, i * ncols + k);
+		}
+	}
+	return query;
 }
 
 /*
@@ -875,7 +1633,11 @@ int main(int argc, char * const argv[])
 	SQLtable	   *table;
 	ArrowKeyValue  *kv;
 	SQLdictionary  *sql_dict_list = NULL;
-	
+	const char	   *command = sqldb_command;
+#ifdef __PG2ARROW__
+	int				i;
+#endif
+
 	parse_options(argc, argv);
 
 	/* special case if --dump=FILENAME */
@@ -899,16 +1661,65 @@ int main(int argc, char * const argv[])
 		readArrowFileDesc(append_fdesc, &af_info);
 		sql_dict_list = loadArrowDictionaryBatches(append_fdesc, &af_info);
 	}
+#ifdef __PG2ARROW__
+	/* fix up the range of the incremental export, if --watermark */
+	if (watermark_column &&
+		!setup_watermark(sqldb_state, append_filename ? &af_info : NULL))
+	{
+		fprintf(stderr, "no rows newer than the watermark (%s) of '%s'\n",
+				watermark_lower, watermark_column);
+		return 0;
+	}
+	if (copy_binary_mode)
+		sqldb_enable_copy_mode(sqldb_state);
+	/* open connections of the parallel workers on the same snapshot */
+	if (num_workers > 1)
+	{
+		char	   *snapshot = sqldb_export_snapshot(sqldb_state);
+
+		parallel_workers = palloc0(sizeof(parallelWorker) * num_workers);
+		for (i=0; i < num_workers; i++)
+		{
+			parallelWorker *pw = &parallel_workers[i];
+
+			pw->worker_id = i;
+			if (i == 0)
+				pw->sqldb_state = sqldb_state;
+			else
+			{
+				pw->sqldb_state = sqldb_server_connect(sqldb_hostname,
+								       sqldb_port_num,
+								       sqldb_username,
+								       sqldb_password,
+								       sqldb_database,
+								       sqldb_session_configs,
+								       sqldb_nestloop_options);
+				sqldb_import_snapshot(pw->sqldb_state, snapshot);
+				if (copy_binary_mode)
+					sqldb_enable_copy_mode(pw->sqldb_state);
+			}
+			pw->command = sort_query_command(watermark_query_command(
+								parallel_worker_command(sqldb_state, i)));
+		}
+		command = parallel_workers[0].command;
+	}
+	else
+		command = sort_query_command(watermark_query_command(sqldb_command));
+#else
+	command = sort_query_command(sqldb_command);
+#endif	/* __PG2ARROW__ */
 	/* begin SQL command execution */
 	table = sqldb_begin_query(sqldb_state,
-							  sqldb_command,
+							  command,
 							  append_filename ? &af_info : NULL,
 							  sql_dict_list);
 	if (!table)
-		Elog("Empty results by the query: %s", sqldb_command);
+		Elog("Empty results by the query: %s", command);
 	table->segment_sz = batch_segment_sz;
 	/* enables embedded min/max statistics, if any */
 	enable_embedded_stats(table);
+	/* enables embedded bloom filters, if any */
+	enable_embedded_bloom(table);
 
 	/* save the SQL command as custom metadata */
 	kv = palloc0(sizeof(ArrowKeyValue));
@@ -919,10 +1730,36 @@ int main(int argc, char * const argv[])
 	kv->_value_len = strlen(sqldb_command);
 	table->customMetadata = kv;
 	table->numCustomMetadata = 1;
+#ifdef __PG2ARROW__
+	/* save the high-water mark for the next incremental export */
+	if (watermark_upper)
+	{
+		kv = palloc0(sizeof(ArrowKeyValue) * 3);
+		memcpy(&kv[0], table->customMetadata, sizeof(ArrowKeyValue));
+		initArrowNode(&kv[1], KeyValue);
+		kv[1].key = "watermark_column";
+		kv[1]._key_len = 16;
+		kv[1].value = watermark_column;
+		kv[1]._value_len = strlen(watermark_column);
+		initArrowNode(&kv[2], KeyValue);
+		kv[2].key = "watermark_value";
+		kv[2]._key_len = 15;
+		kv[2].value = watermark_upper;
+		kv[2]._value_len = strlen(watermark_upper);
+		table->customMetadata = kv;
+		table->numCustomMetadata = 3;
+	}
+#endif	/* __PG2ARROW__ */
 
 	/* open & setup result file */
 	if (!append_filename)
+	{
+#ifdef __PG2ARROW__
+		setup_output_file(table, parallel_output_filename(0));
+#else
 		setup_output_file(table, output_filename);
+#endif
+	}
 	else
 	{
 		table->fdesc = append_fdesc;
@@ -931,7 +1768,29 @@ int main(int argc, char * const argv[])
 	}
 	/* write out dictionary batch, if any */
 	writeArrowDictionaryBatches(table);
-	
+
+#ifdef __PG2ARROW__
+	if (num_workers > 1)
+	{
+		/* fetch and write result by the parallel workers */
+		parallel_export_main(table, append_filename ? &af_info : NULL);
+		for (i=1; i < num_workers; i++)
+			sqldb_close_connection(parallel_workers[i].sqldb_state);
+		if (parallel_split_files)
+		{
+			/* each worker already wrote out the footer and closed the file */
+			sqldb_close_connection(sqldb_state);
+			return 0;
+		}
+		goto write_footer;
+	}
+#endif	/* __PG2ARROW__ */
+	if (pipeline_enabled)
+	{
+		/* fetch and write result in the pipeline */
+		pipeline_export_main(sqldb_state, table);
+		goto write_footer;
+	}
 	/* main loop to fetch and write result */
 	while (sqldb_fetch_results(sqldb_state, table))
 	{
@@ -948,6 +1807,7 @@ int main(int argc, char * const argv[])
 		shows_record_batch_progress(table, table->nitems);
 		sql_table_clear(table);
 	}
+write_footer:
 	/* write out footer portion */
 	writeArrowFooter(table);
 
@@ -39,6 +39,20 @@ sqldb_fetch_results(void *sqldb_state, SQLtable *table);
 extern void
 sqldb_close_connection(void *sqldb_state);
 
+/* pg2arrow only; for COPY (FORMAT binary) mode */
+extern void
+sqldb_enable_copy_mode(void *sqldb_state);
+/* pg2arrow only; for --watermark */
+extern char *
+sqldb_query_scalar(void *sqldb_state, const char *query);
+/* pg2arrow only; for the parallel export */
+extern char *
+sqldb_export_snapshot(void *sqldb_state);
+extern void
+sqldb_import_snapshot(void *sqldb_state, const char *snapshot);
+extern int64_t
+sqldb_relation_nblocks(void *sqldb_state, const char *relname);
+
 /* misc functions */
 extern void	   *palloc(size_t sz);
 extern void	   *palloc0(size_t sz);
@@ -1480,6 +1480,8 @@ __arrowFileInitTable(VALUE arg)
 											   fields[j].field_name,
 											   fields[j].field_type,
 											   fields[j].stat_enabled);
+		if (fields[j].stat_enabled)
+			table->has_statistics = true;
 	}
 	table->numFieldNodes = table->nfields;
 	table->numBuffers = nbuffers;
@@ -1602,6 +1604,8 @@ __arrowFileParseParams(VALUE self,
 	VALUE		datum;
 	size_t		r_threshold = 240;
 	size_t		f_threshold = 10000;
+	long		flush_interval = 0;
+	VALUE		compaction = Qtrue;
 
 	if (hash == Qnil)
 		goto out;
@@ -1639,11 +1643,26 @@ __arrowFileParseParams(VALUE self,
 		if (f_threshold < 16 || f_threshold > 1048576)
 			Elog("filesize_threshold must be [16...1048576]");
 	}
+
+	datum = rb_hash_fetch(hash, rb_str_new_cstr("flush_interval"));
+	if (datum != Qnil)
+	{
+		flush_interval = NUM2LONG(datum);
+		if (flush_interval < 0 || flush_interval > 86400)
+			Elog("flush_interval must be [0...86400]");
+	}
+
+	datum = rb_hash_fetch(hash, rb_str_new_cstr("compaction"));
+	if (datum != Qnil)
+		compaction = (RTEST(datum) ? Qtrue : Qfalse);
 out:
 	rb_ivar_set(self, rb_intern("record_batch_threshold"),
 				LONG2NUM(r_threshold << 20));
 	rb_ivar_set(self, rb_intern("filesize_threshold"),
 				LONG2NUM(f_threshold << 20));
+	rb_ivar_set(self, rb_intern("flush_interval"),
+				LONG2NUM(flush_interval));
+	rb_ivar_set(self, rb_intern("compaction"), compaction);
 }
 
 static VALUE
@@ -1901,6 +1920,371 @@ retry_again:
 	table->fdesc = fdesc;
 }
 
+/*
+ * __arrowFileParseStatToken - parse a token of min_values/max_values
+ *
+ * All the write_ruby_XXX_stat handlers print integer values, so the tokens
+ * are restored on the i128 field; narrower fields of SQLstat__datum share
+ * the lower bits of the union.
+ */
+static bool
+__arrowFileParseStatToken(const char *tok, int len, SQLstat__datum *datum)
+{
+	int128_t	ival = 0;
+	bool		is_minus = false;
+	int			i = 0;
+
+	if (len == 4 && memcmp(tok, "null", 4) == 0)
+		return false;
+	if (i < len && tok[i] == '-')
+	{
+		is_minus = true;
+		i++;
+	}
+	if (i >= len)
+		return false;
+	for (; i < len; i++)
+	{
+		if (!isdigit(tok[i]))
+			return false;
+		ival = 10 * ival + (tok[i] - '0');
+	}
+	datum->i128 = (is_minus ? -ival : ival);
+	return true;
+}
+
+static const char *
+__arrowFileNextStatToken(const char *pos, const char *end, int *p_len)
+{
+	const char *tail;
+
+	if (pos >= end)
+		return NULL;
+	for (tail = pos; tail < end && *tail != ','; tail++);
+	*p_len = tail - pos;
+	return pos;
+}
+
+/*
+ * __arrowFileRestoreStats
+ *
+ * It restores min/max statistics of the record-batches already in the file,
+ * because the footer is rebuilt from the SQLstat items on every write.
+ */
+static void
+__arrowFileRestoreStats(SQLtable *table, ArrowFooter *footer, int nrestore)
+{
+	int		i, j, k;
+
+	for (j=0; j < table->nfields && j < footer->schema._num_fields; j++)
+	{
+		SQLfield   *column = &table->columns[j];
+		ArrowField *field = &footer->schema.fields[j];
+		const ArrowKeyValue *kv_min = NULL;
+		const ArrowKeyValue *kv_max = NULL;
+		const char *min_pos, *min_end;
+		const char *max_pos, *max_end;
+
+		if (!column->stat_enabled)
+			continue;
+		for (k=0; k < field->_num_custom_metadata; k++)
+		{
+			const ArrowKeyValue *kv = &field->custom_metadata[k];
+
+			if (kv->_key_len == 10 && memcmp(kv->key, "min_values", 10) == 0)
+				kv_min = kv;
+			else if (kv->_key_len == 10 && memcmp(kv->key, "max_values", 10) == 0)
+				kv_max = kv;
+		}
+		if (!kv_min || !kv_max)
+			continue;
+		min_pos = kv_min->value;
+		min_end = kv_min->value + kv_min->_value_len;
+		max_pos = kv_max->value;
+		max_end = kv_max->value + kv_max->_value_len;
+		for (i=0; i < nrestore; i++)
+		{
+			const char *min_tok, *max_tok;
+			int			min_len, max_len;
+			SQLstat	   *item;
+
+			min_tok = __arrowFileNextStatToken(min_pos, min_end, &min_len);
+			max_tok = __arrowFileNextStatToken(max_pos, max_end, &max_len);
+			if (!min_tok || !max_tok)
+				break;
+			min_pos = min_tok + min_len + 1;
+			max_pos = max_tok + max_len + 1;
+
+			item = palloc0(sizeof(SQLstat));
+			item->rb_index = i;
+			if (!__arrowFileParseStatToken(min_tok, min_len, &item->min) ||
+				!__arrowFileParseStatToken(max_tok, max_len, &item->max))
+			{
+				pfree(item);
+				continue;
+			}
+			item->is_valid = true;
+			item->next = column->stat_list;
+			column->stat_list = item;
+		}
+	}
+}
+
+/*
+ * __arrowFileRebuildStat - min/max statistics of the merged buffer
+ */
+static void
+__arrowFileRebuildStat(SQLfield *column)
+{
+	const uint8_t *nullmap = (const uint8_t *)column->nullmap.data;
+	long		i;
+
+#define __REBUILD_STAT(FIELD,TYPE)									\
+	for (i=0; i < column->nitems; i++)								\
+	{																\
+		if (nullmap[i>>3] & (1 << (i & 7)))							\
+			STAT_UPDATES(column,FIELD,((TYPE *)column->values.data)[i]); \
+	}
+
+	memset(&column->stat_datum, 0, sizeof(SQLstat));
+	switch (column->arrow_type.node.tag)
+	{
+		case ArrowNodeTag__Int:
+			switch (column->arrow_type.Int.bitWidth)
+			{
+				case 8:
+					if (column->arrow_type.Int.is_signed)
+						__REBUILD_STAT(i8, int8_t)
+					else
+						__REBUILD_STAT(u8, uint8_t)
+					break;
+				case 16:
+					if (column->arrow_type.Int.is_signed)
+						__REBUILD_STAT(i16, int16_t)
+					else
+						__REBUILD_STAT(u16, uint16_t)
+					break;
+				case 32:
+					if (column->arrow_type.Int.is_signed)
+						__REBUILD_STAT(i32, int32_t)
+					else
+						__REBUILD_STAT(u32, uint32_t)
+					break;
+				case 64:
+					if (column->arrow_type.Int.is_signed)
+						__REBUILD_STAT(i64, int64_t)
+					else
+						__REBUILD_STAT(u64, uint64_t)
+					break;
+			}
+			break;
+		case ArrowNodeTag__FloatingPoint:
+			if (column->arrow_type.FloatingPoint.precision == ArrowPrecision__Single)
+				__REBUILD_STAT(f32, float)
+			else if (column->arrow_type.FloatingPoint.precision == ArrowPrecision__Double)
+				__REBUILD_STAT(f64, double)
+			break;
+		case ArrowNodeTag__Decimal:
+			__REBUILD_STAT(i128, int128_t)
+			break;
+		default:
+			/* put_value handler does not track min/max statistics */
+			break;
+	}
+#undef __REBUILD_STAT
+}
+
+static inline bool
+__arrowBitmapIsSet(const char *bitmap, size_t index)
+{
+	return (bitmap[index >> 3] & (1 << (index & 7))) != 0;
+}
+
+static void
+__arrowBitmapAppend(SQLbuffer *buf, size_t base,
+					const char *bitmap, size_t nitems)
+{
+	size_t		i;
+
+	for (i=0; i < nitems; i++)
+	{
+		if (!bitmap || __arrowBitmapIsSet(bitmap, i))
+			sql_buffer_setbit(buf, base + i);
+		else
+			sql_buffer_clrbit(buf, base + i);
+	}
+}
+
+/*
+ * __arrowFileMergeLastRecordBatch
+ *
+ * If the last record-batch in the file is small enough, it is read back and
+ * merged in front of the current buffer, then overwritten by the merged one.
+ * So, repeated flushes of small chunks do not leave many small record-batches
+ * that arrow_fdw scans inefficiently.
+ */
+static bool
+__arrowFileMergeLastRecordBatch(VALUE self, SQLtable *table,
+								ArrowFileInfo *af_info)
+{
+	size_t		threshold;
+	size_t		usage = 0;
+	int			nitems = af_info->footer._num_recordBatches;
+	ArrowBlock *block;
+	ArrowRecordBatch *rbatch;
+	ArrowBuffer *b;
+	size_t		n0;
+	char	   *body;
+	mallocContext *mcxt_saved;
+	int			i, j, k;
+
+	if (!RTEST(rb_ivar_get(self, rb_intern("compaction"))) || nitems == 0)
+		return false;
+	threshold = NUM2LONG(rb_ivar_get(self, rb_intern("record_batch_threshold")));
+	for (j=0; j < table->nfields; j++)
+		usage += table->columns[j].__curr_usage__;
+	block = &af_info->footer.recordBatches[nitems - 1];
+	rbatch = &af_info->recordBatches[nitems - 1].body.recordBatch;
+	if (block->bodyLength + usage >= threshold ||
+		rbatch->compression != NULL ||
+		rbatch->_num_nodes != table->numFieldNodes ||
+		rbatch->_num_buffers != table->numBuffers ||
+		rbatch->length == 0)
+		return false;
+	n0 = rbatch->length;
+
+	/* validation of the buffers */
+	for (j=0, k=0; j < table->nfields; j++)
+	{
+		SQLfield   *column = &table->columns[j];
+		int			nbufs = (column->arrow_type.node.tag == ArrowNodeTag__Utf8 ? 3 : 2);
+
+		if (column->stat_enabled &&
+			column->arrow_type.node.tag == ArrowNodeTag__FloatingPoint &&
+			column->arrow_type.FloatingPoint.precision == ArrowPrecision__Half)
+			return false;	/* unable to rebuild the statistics */
+		if (rbatch->nodes[j].length != rbatch->length)
+			return false;
+		b = &rbatch->buffers[k];
+		for (i=0; i < nbufs; i++)
+		{
+			if (b[i].offset + b[i].length > block->bodyLength)
+				return false;
+		}
+		if (b[0].length > 0 && b[0].length < (n0 + 7) / 8)
+			return false;
+		if (column->arrow_type.node.tag == ArrowNodeTag__Bool
+			? b[1].length < (n0 + 7) / 8
+			: column->arrow_type.node.tag == ArrowNodeTag__Utf8
+			? b[1].length < sizeof(uint32_t) * (n0 + 1)
+			: b[1].length < (column->values.usage / column->nitems) * n0)
+			return false;
+		k += nbufs;
+	}
+
+	/* read the body of the last record-batch */
+	body = palloc(block->bodyLength);
+	if (pread(table->fdesc, body, block->bodyLength,
+			  block->offset + block->metaDataLength) != block->bodyLength)
+		Elog("failed on pread(2): %m");
+	for (j=0, k=0; j < table->nfields; j++)
+	{
+		SQLfield   *column = &table->columns[j];
+
+		b = &rbatch->buffers[k];
+		if (column->arrow_type.node.tag != ArrowNodeTag__Utf8)
+			k += 2;
+		else
+		{
+			if (((const uint32_t *)(body + b[1].offset))[n0] > b[2].length)
+			{
+				pfree(body);
+				return false;
+			}
+			k += 3;
+		}
+	}
+
+	/*
+	 * Merged buffers are put on the SQLtable, so they must be allocated
+	 * on the memory context of the table, not the temporary one.
+	 */
+	mcxt_saved = mallocContextSwitchTo(mallocContextOfChunk(table));
+	for (j=0, k=0; j < table->nfields; j++)
+	{
+		SQLfield   *column = &table->columns[j];
+		ArrowFieldNode *fnode = &rbatch->nodes[j];
+		size_t		n1 = column->nitems;
+		SQLbuffer	nullmap;
+		SQLbuffer	values;
+
+		b = &rbatch->buffers[k];
+		memset(&nullmap, 0, sizeof(SQLbuffer));
+		memset(&values, 0, sizeof(SQLbuffer));
+		/* nullmap; omitted if no nulls */
+		__arrowBitmapAppend(&nullmap, 0,
+							(b[0].length > 0 ? body + b[0].offset : NULL), n0);
+		__arrowBitmapAppend(&nullmap, n0, column->nullmap.data, n1);
+
+		switch (column->arrow_type.node.tag)
+		{
+			case ArrowNodeTag__Bool:
+				__arrowBitmapAppend(&values, 0, body + b[1].offset, n0);
+				__arrowBitmapAppend(&values, n0, column->values.data, n1);
+				k += 2;
+				break;
+			case ArrowNodeTag__Utf8:
+				{
+					const uint32_t *offsets0 = (const uint32_t *)(body + b[1].offset);
+					const uint32_t *offsets1 = (const uint32_t *)column->values.data;
+					uint32_t	extra_sz = offsets0[n0];
+					SQLbuffer	extra;
+
+					memset(&extra, 0, sizeof(SQLbuffer));
+					sql_buffer_append(&values, offsets0, sizeof(uint32_t) * (n0 + 1));
+					for (i=1; i <= n1; i++)
+					{
+						uint32_t	off = offsets1[i] + extra_sz;
+
+						sql_buffer_append(&values, &off, sizeof(uint32_t));
+					}
+					sql_buffer_append(&extra, body + b[2].offset, extra_sz);
+					if (column->extra.usage > 0)
+						sql_buffer_append(&extra, column->extra.data,
+										  column->extra.usage);
+					if (column->extra.data)
+						pfree(column->extra.data);
+					column->extra = extra;
+				}
+				k += 3;
+				break;
+			default:
+				{
+					size_t	unitsz = column->values.usage / n1;
+
+					sql_buffer_append(&values, body + b[1].offset, unitsz * n0);
+					sql_buffer_append(&values, column->values.data,
+									  column->values.usage);
+				}
+				k += 2;
+				break;
+		}
+		pfree(column->nullmap.data);
+		pfree(column->values.data);
+		column->nullmap = nullmap;
+		column->values = values;
+		column->nitems = n0 + n1;
+		column->nullcount += fnode->null_count;
+		if (column->stat_enabled)
+			__arrowFileRebuildStat(column);
+	}
+	table->nitems += n0;
+	mallocContextSwitchTo(mcxt_saved);
+	pfree(body);
+
+	return true;
+}
+
 static VALUE
 __arrowFileWriteRecordBatch(VALUE self)
 {
@@ -1926,11 +2310,13 @@ __arrowFileWriteRecordBatch(VALUE self)
 
 		column->customMetadata = NULL;
 		column->numCustomMetadata = 0;
+		column->stat_list = NULL;
 	}
 
 	if (stat_buf.st_size == 0)
 	{
 		/* case of an empty file */
+		table->f_pos = 0;
 		arrowFileWrite(table, "ARROW1\0\0", 8);
 		writeArrowSchema(table);
 	}
@@ -1947,27 +2333,37 @@ __arrowFileWriteRecordBatch(VALUE self)
 
 		/* restore RecordBatches already in the file */
 		nitems = af_info.footer._num_recordBatches;
+		if (__arrowFileMergeLastRecordBatch(self, table, &af_info))
+		{
+			/* the last record-batch shall be overwritten by the merged one */
+			nitems--;
+			offset = af_info.footer.recordBatches[nitems].offset;
+		}
+		else
+		{
+			/* move to the file offset in front of the Footer */
+			nbytes = sizeof(int32_t) + 6;	/* strlen("ARROW1") */
+			offset = stat_buf.st_size - nbytes;
+			if (pread(table->fdesc, buffer, nbytes, offset) != nbytes)
+				Elog("failed on pread(2): %m");
+			offset -= *((uint32_t *)buffer);
+		}
 		table->numRecordBatches = nitems;
-		table->recordBatches = palloc(sizeof(ArrowBlock) * nitems);
+		table->recordBatches = palloc(sizeof(ArrowBlock) * (nitems + 1));
 		memcpy(table->recordBatches,
 			   af_info.footer.recordBatches,
 			   sizeof(ArrowBlock) * nitems);
+		__arrowFileRestoreStats(table, &af_info.footer, nitems);
 
-		//TODO: if cleanup context, last chunk shall be
-		//      merged to the current buffer.
-
-		/* move to the file offset in front of the Footer */
-		nbytes = sizeof(int32_t) + 6;	/* strlen("ARROW1") */
-		offset = stat_buf.st_size - nbytes;
-		if (pread(table->fdesc, buffer, nbytes, offset) != nbytes)
-			Elog("failed on pread(2): %m");
-		offset -= *((uint32_t *)buffer);
 		if (lseek(table->fdesc, offset, SEEK_SET) < 0)
 			Elog("failed on lseek(2): %m");
 		table->f_pos = offset;
 	}
 	writeArrowRecordBatch(table);
 	writeArrowFooter(table);
+	/* the merged record-batch may be shorter than the former tail */
+	if (ftruncate(table->fdesc, table->f_pos) != 0)
+		Elog("failed on ftruncate(2): %m");
 
 	return Qtrue;
 }
@@ -2026,6 +2422,7 @@ __arrowFile__writeRow(VALUE __arg)
 	int			ts_column = -1;
 	VALUE		datum;
 	long		threshold;
+	long		flush_interval;
 	size_t		len;
 	int			j;
 
@@ -2037,9 +2434,14 @@ __arrowFile__writeRow(VALUE __arg)
 		tag_column = NUM2INT(datum);
 	datum = rb_ivar_get(self, rb_intern("record_batch_threshold"));
 	threshold = NUM2LONG(datum);
+	datum = rb_ivar_get(self, rb_intern("flush_interval"));
+	flush_interval = NUM2LONG(datum);
 
 	if (table->fdesc < 0)
 		arrowFileOpen(self, false);
+	/* remember when the first row of the buffer came */
+	if (table->nitems == 0 && flush_interval > 0)
+		rb_ivar_set(self, rb_intern("buffer_since"), LONG2NUM(time(NULL)));
 
 	for (j=0, len=0; j < table->nfields; j++)
 	{
@@ -2057,7 +2459,9 @@ __arrowFile__writeRow(VALUE __arg)
 	}
 	table->nitems++;
 
-	if (len >= threshold)
+	if (len >= threshold ||
+		(flush_interval > 0 &&
+		 time(NULL) >= NUM2LONG(rb_ivar_get(self, rb_intern("buffer_since"))) + flush_interval))
 	{
 		arrowFileWriteRecordBatch(self);
 		sql_table_clear(table);
@@ -6,6 +6,244 @@ CREATE FUNCTION pgstrom.gpucache_recovery(regclass)
   AS 'MODULE_PATHNAME','pgstrom_gpucache_recovery'
   LANGUAGE C CALLED ON NULL INPUT;
 
+CREATE FUNCTION pgstrom.gpucache_export_ipchandle(regclass)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_gpucache_export_ipchandle'
+  LANGUAGE C STRICT;
+
+CREATE TYPE pgstrom.__pgstrom_gpucache_stats_t AS (
+    database_oid        oid,
+    database_name       text,
+    table_oid           oid,
+    table_name          text,
+    shard_id            int,
+    redo_lag_bytes      bigint,
+    redo_lag_secs       float8,
+    redo_wait_count     bigint,
+    apply_count         bigint,
+    apply_total_ms      float8,
+    apply_max_ms        float8,
+    apply_latency_hist  bigint[],
+    compaction_count    bigint,
+    compaction_total_ms float8,
+    reader_wait_count   bigint,
+    reader_wait_ms      float8,
+    writer_wait_count   bigint,
+    writer_wait_ms      float8,
+    corrupted_count     bigint,
+    reload_count        bigint
+);
+CREATE FUNCTION pgstrom.__pgstrom_gpucache_stats()
+  RETURNS SETOF pgstrom.__pgstrom_gpucache_stats_t
+  AS 'MODULE_PATHNAME','pgstrom_gpucache_stats'
+  LANGUAGE C STRICT;
+
+CREATE VIEW pgstrom.gpucache_stats AS
+  SELECT * FROM pgstrom.__pgstrom_gpucache_stats();
+
+---
+--- GPU Program Builder Statistics
+---
+CREATE TYPE pgstrom.__pgstrom_program_build_stats_t AS (
+    priority            text,
+    queue_depth         int,
+    enqueue_count       bigint,
+    build_count         bigint,
+    cancel_count        bigint,
+    queue_wait_ms       float8,
+    build_total_ms      float8,
+    build_max_ms        float8,
+    build_time_hist     bigint[]
+);
+CREATE FUNCTION pgstrom.__pgstrom_program_build_stats()
+  RETURNS SETOF pgstrom.__pgstrom_program_build_stats_t
+  AS 'MODULE_PATHNAME','pgstrom_program_build_stats'
+  LANGUAGE C STRICT;
+
+CREATE VIEW pgstrom.program_build_stats AS
+  SELECT * FROM pgstrom.__pgstrom_program_build_stats();
+
+---
+--- GPU Task Scheduler
+---
+CREATE TYPE pgstrom.__pgstrom_gpu_task_scheduler_t AS (
+    pid                 int,
+    gpu_id              int,
+    priority            int,
+    fair_share          int,
+    active_sessions     int,
+    num_tasks           bigint,
+    queue_wait_ms       float8,
+    queue_wait_max_ms   float8
+);
+CREATE FUNCTION pgstrom.__pgstrom_gpu_task_scheduler()
+  RETURNS SETOF pgstrom.__pgstrom_gpu_task_scheduler_t
+  AS 'MODULE_PATHNAME','pgstrom_gpu_task_scheduler'
+  LANGUAGE C STRICT;
+
+CREATE VIEW pgstrom.gpu_task_scheduler AS
+  SELECT * FROM pgstrom.__pgstrom_gpu_task_scheduler();
+
+---
+--- GPU Cost Model Calibration
+---
+CREATE TYPE pgstrom.__pgstrom_gpu_cost_calibration_t AS (
+    gpu_id              int,
+    setup_samples       bigint,
+    setup_ms            float8,
+    exec_samples        bigint,
+    chunk_ms            float8,
+    row_us              float8,
+    setup_cost          float8,
+    dma_cost            float8,
+    operator_cost       float8,
+    parallel_saturation int
+);
+CREATE FUNCTION pgstrom.__pgstrom_gpu_cost_calibration()
+  RETURNS SETOF pgstrom.__pgstrom_gpu_cost_calibration_t
+  AS 'MODULE_PATHNAME','pgstrom_gpu_cost_calibration'
+  LANGUAGE C STRICT;
+
+CREATE VIEW pgstrom.gpu_cost_calibration AS
+  SELECT * FROM pgstrom.__pgstrom_gpu_cost_calibration();
+
+CREATE FUNCTION pgstrom.gpu_cost_calibration_reset()
+  RETURNS void
+  AS 'MODULE_PATHNAME','pgstrom_gpu_cost_calibration_reset'
+  LANGUAGE C STRICT;
+
+---
+--- GPU Device Statistics
+---
+CREATE TYPE pgstrom.__pgstrom_gpu_stat_t AS (
+    gpu_id              int,
+    gpu_name            text,
+    sm_util             int,
+    mem_util            int,
+    mem_total           bigint,
+    mem_used            bigint,
+    mem_normal          bigint,
+    mem_managed         bigint,
+    mem_iomap           bigint,
+    mem_budget          bigint,
+    active_contexts     int,
+    running_tasks       int,
+    queued_tasks        int,
+    pcie_tx_bytes_per_sec bigint,
+    pcie_rx_bytes_per_sec bigint,
+    jit_builds_pending  int,
+    jit_builds_running  int,
+    gpu_tasks           bigint,
+    cpu_fallbacks       bigint,
+    fallback_ratio      float8,
+    sampled_at          timestamptz
+);
+CREATE FUNCTION pgstrom.__pgstrom_gpu_stat()
+  RETURNS SETOF pgstrom.__pgstrom_gpu_stat_t
+  AS 'MODULE_PATHNAME','pgstrom_gpu_stat'
+  LANGUAGE C STRICT;
+
+CREATE VIEW pgstrom.pg_stat_gpu AS
+  SELECT * FROM pgstrom.__pgstrom_gpu_stat();
+
+-- Prometheus text exposition format of pgstrom.pg_stat_gpu
+CREATE FUNCTION pgstrom.pg_stat_gpu_prometheus()
+  RETURNS text
+  AS $$
+WITH v AS (
+  SELECT s.gpu_id, m.metric, m.kind, m.value
+    FROM pgstrom.pg_stat_gpu s,
+    LATERAL (VALUES
+      ('pgstrom_gpu_sm_utilization_percent',  'gauge',   s.sm_util::float8),
+      ('pgstrom_gpu_mem_utilization_percent', 'gauge',   s.mem_util::float8),
+      ('pgstrom_gpu_memory_total_bytes',      'gauge',   s.mem_total::float8),
+      ('pgstrom_gpu_memory_used_bytes',       'gauge',   s.mem_used::float8),
+      ('pgstrom_gpu_memory_normal_bytes',     'gauge',   s.mem_normal::float8),
+      ('pgstrom_gpu_memory_managed_bytes',    'gauge',   s.mem_managed::float8),
+      ('pgstrom_gpu_memory_iomap_bytes',      'gauge',   s.mem_iomap::float8),
+      ('pgstrom_gpu_memory_budget_bytes',     'gauge',   s.mem_budget::float8),
+      ('pgstrom_gpu_active_contexts',         'gauge',   s.active_contexts::float8),
+      ('pgstrom_gpu_running_tasks',           'gauge',   s.running_tasks::float8),
+      ('pgstrom_gpu_queued_tasks',            'gauge',   s.queued_tasks::float8),
+      ('pgstrom_gpu_pcie_tx_bytes_per_second','gauge',   s.pcie_tx_bytes_per_sec::float8),
+      ('pgstrom_gpu_pcie_rx_bytes_per_second','gauge',   s.pcie_rx_bytes_per_sec::float8),
+      ('pgstrom_jit_builds_pending',          'gauge',   s.jit_builds_pending::float8),
+      ('pgstrom_jit_builds_running',          'gauge',   s.jit_builds_running::float8),
+      ('pgstrom_gpu_tasks_total',             'counter', s.gpu_tasks::float8),
+      ('pgstrom_gpu_cpu_fallbacks_total',     'counter', s.cpu_fallbacks::float8)
+    ) m(metric, kind, value)
+   WHERE m.value IS NOT NULL
+)
+SELECT string_agg(line, E'\n' ORDER BY metric, ord, gpu_id) || E'\n'
+  FROM (SELECT metric, 0 AS ord, -1 AS gpu_id,
+               format('# TYPE %s %s', metric, kind) AS line
+          FROM v GROUP BY metric, kind
+        UNION ALL
+        SELECT metric, 1, gpu_id,
+               format('%s{gpu="%s"} %s', metric, gpu_id, value)
+          FROM v) t
+$$ LANGUAGE sql STABLE;
+
+-- Per-query accounting of the GPU resources
+CREATE TYPE pgstrom.__pgstrom_gpu_stat_statements_t AS (
+    userid              oid,
+    dbid                oid,
+    queryid             bigint,
+    gpu_nodes           bigint,
+    gpu_tasks           bigint,
+    kern_exec_time      float8,
+    dma_send_time       float8,
+    dma_recv_time       float8,
+    dma_send_bytes      bigint,
+    dma_recv_bytes      bigint,
+    nvme_read_bytes     bigint,
+    gpu_mem_peak        bigint,
+    jit_build_time      float8,
+    cpu_fallback_chunks bigint,
+    cpu_recheck_rows    bigint,
+    last_exec           timestamptz,
+    dealloc             bigint
+);
+CREATE FUNCTION pgstrom.__pgstrom_gpu_stat_statements()
+  RETURNS SETOF pgstrom.__pgstrom_gpu_stat_statements_t
+  AS 'MODULE_PATHNAME','pgstrom_gpu_stat_statements'
+  LANGUAGE C STRICT;
+
+CREATE VIEW pgstrom.gpu_stat_statements AS
+  SELECT * FROM pgstrom.__pgstrom_gpu_stat_statements();
+
+CREATE FUNCTION pgstrom.gpu_stat_statements_reset()
+  RETURNS void
+  AS 'MODULE_PATHNAME','pgstrom_gpu_stat_statements_reset'
+  LANGUAGE C STRICT;
+
+---
+--- Arrow_Fdw Functions
+---
+CREATE FUNCTION pgstrom.arrow_fdw_snapshots(regclass,
+                                            OUT filename text,
+                                            OUT snapshot int,
+                                            OUT footer_offset bigint,
+                                            OUT nitems bigint)
+  RETURNS SETOF record
+  AS 'MODULE_PATHNAME','pgstrom_arrow_fdw_snapshots'
+  LANGUAGE C STRICT;
+
+---
+--- Partial states exchange for multi-node GpuPreAgg
+---
+CREATE FUNCTION pgstrom.partial_export(text,     -- query
+                                       text)     -- filename
+  RETURNS bigint
+  AS 'MODULE_PATHNAME','pgstrom_partial_export'
+  LANGUAGE C STRICT VOLATILE;
+
+CREATE FUNCTION pgstrom.partial_merge_query(text,      -- filename
+                                            regclass)  -- relation
+  RETURNS text
+  AS 'MODULE_PATHNAME','pgstrom_partial_merge_query'
+  LANGUAGE C STRICT;
+
 ---
 --- Portable Shared Memory
 ---
@@ -14,6 +252,29 @@ CREATE FUNCTION pgstrom.shared_buffer_info()
   AS 'MODULE_PATHNAME','pgstrom_shared_buffer_info'
   LANGUAGE C STRICT;
 
+---
+--- Checksum functions (also run on GPU devices)
+---
+CREATE FUNCTION pgstrom.crc32(text)
+  RETURNS bigint
+  AS 'MODULE_PATHNAME','pgstrom_crc32'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION pgstrom.crc32(bytea)
+  RETURNS bigint
+  AS 'MODULE_PATHNAME','pgstrom_crc32'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION pgstrom.crc32c(text)
+  RETURNS bigint
+  AS 'MODULE_PATHNAME','pgstrom_crc32c'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION pgstrom.crc32c(bytea)
+  RETURNS bigint
+  AS 'MODULE_PATHNAME','pgstrom_crc32c'
+  LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+
 ---
 --- Hyper-Log-Log COUNT(distinct) support
 ---
@@ -154,6 +415,12 @@ CREATE FUNCTION pgstrom.hll_sketch_new(bigint)
   AS 'MODULE_PATHNAME','pgstrom_hll_sketch_new'
   LANGUAGE C STRICT PARALLEL SAFE;
 
+--- Makes a new HLL Sketch for hll_count(); GPU may compact it
+CREATE FUNCTION pgstrom.hll_count_new(bigint)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_hll_sketch_new'
+  LANGUAGE C STRICT PARALLEL SAFE;
+
 --- Merge two HLL Sketches
 CREATE FUNCTION pgstrom.hll_sketch_merge(bytea, bytea)
   RETURNS bytea
@@ -393,6 +660,87 @@ CREATE AGGREGATE pg_catalog.hll_combine(bytea)
   parallel = safe
 );
 
+---
+--- Quantile Sketch (approximate percentile) support
+---
+CREATE FUNCTION pgstrom.qsketch_new(float8)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_qsketch_new'
+  LANGUAGE C STRICT PARALLEL SAFE;
+
+CREATE FUNCTION pgstrom.qsketch_update(bytea, float8)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_qsketch_update'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+
+CREATE FUNCTION pgstrom.qsketch_merge(bytea, bytea)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_qsketch_merge'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+
+CREATE FUNCTION pg_catalog.quantile_sketch_percentile(bytea, float8)
+  RETURNS float8
+  AS 'MODULE_PATHNAME','pgstrom_qsketch_percentile'
+  LANGUAGE C STRICT PARALLEL SAFE;
+
+CREATE FUNCTION pg_catalog.quantile_sketch_percentile(bytea, float8[])
+  RETURNS float8[]
+  AS 'MODULE_PATHNAME','pgstrom_qsketch_percentile_multi'
+  LANGUAGE C STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE pg_catalog.quantile_sketch(float8)
+(
+  sfunc = pgstrom.qsketch_update,
+  stype = bytea,
+  parallel = safe
+);
+
+CREATE AGGREGATE pg_catalog.quantile_sketch_combine(bytea)
+(
+  sfunc = pgstrom.qsketch_merge,
+  stype = bytea,
+  parallel = safe
+);
+
+---
+--- Fixed-point accumulator for SUM/AVG(numeric)
+---
+CREATE FUNCTION pgstrom.nsum_new(numeric, int4)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_nsum_new'
+  LANGUAGE C STRICT PARALLEL SAFE;
+
+CREATE FUNCTION pgstrom.nsum_merge(bytea, bytea)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME','pgstrom_nsum_merge'
+  LANGUAGE C CALLED ON NULL INPUT PARALLEL SAFE;
+
+CREATE FUNCTION pgstrom.fsum_numeric_fixed_final(bytea)
+  RETURNS numeric
+  AS 'MODULE_PATHNAME','pgstrom_fsum_numeric_fixed_final'
+  LANGUAGE C STRICT PARALLEL SAFE;
+
+CREATE FUNCTION pgstrom.favg_numeric_fixed_final(bytea)
+  RETURNS numeric
+  AS 'MODULE_PATHNAME','pgstrom_favg_numeric_fixed_final'
+  LANGUAGE C STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE pgstrom.fsum_numeric_fixed(bytea)
+(
+  sfunc = pgstrom.nsum_merge,
+  stype = bytea,
+  finalfunc = pgstrom.fsum_numeric_fixed_final,
+  parallel = safe
+);
+
+CREATE AGGREGATE pgstrom.favg_numeric_fixed(bytea)
+(
+  sfunc = pgstrom.nsum_merge,
+  stype = bytea,
+  finalfunc = pgstrom.favg_numeric_fixed_final,
+  parallel = safe
+);
+
 ---
 --- Re-define of VARIANCE/STDDEV
 ---
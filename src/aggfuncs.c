@@ -11,6 +11,7 @@
  */
 #include "pg_strom.h"
 #include "cuda_numeric.h"
+#include "cuda_gpupreagg.h"
 
 /*
  * declarations
@@ -61,6 +62,15 @@ PG_FUNCTION_INFO_V1(pgstrom_hll_sketch_new);
 PG_FUNCTION_INFO_V1(pgstrom_hll_sketch_merge);
 PG_FUNCTION_INFO_V1(pgstrom_hll_count_final);
 PG_FUNCTION_INFO_V1(pgstrom_hll_sketch_histogram);
+PG_FUNCTION_INFO_V1(pgstrom_qsketch_new);
+PG_FUNCTION_INFO_V1(pgstrom_qsketch_update);
+PG_FUNCTION_INFO_V1(pgstrom_qsketch_merge);
+PG_FUNCTION_INFO_V1(pgstrom_qsketch_percentile);
+PG_FUNCTION_INFO_V1(pgstrom_qsketch_percentile_multi);
+PG_FUNCTION_INFO_V1(pgstrom_nsum_new);
+PG_FUNCTION_INFO_V1(pgstrom_nsum_merge);
+PG_FUNCTION_INFO_V1(pgstrom_fsum_numeric_fixed_final);
+PG_FUNCTION_INFO_V1(pgstrom_favg_numeric_fixed_final);
 
 /* utility to reference numeric[] */
 static inline Datum
@@ -1261,6 +1271,57 @@ pgstrom_hll_sketch_new(PG_FUNCTION_ARGS)
 	PG_RETURN_BYTEA_P(hll_state);
 }
 
+/*
+ * __pgstrom_hll_sketch_is_compact
+ *
+ * GPU may rewrite the HLL sketch of hll_count() to the sparse form with the
+ * estimated cardinality; see kern_hll_compact_sketch.
+ */
+static bool
+__pgstrom_hll_sketch_is_compact(bytea *hll_state)
+{
+	kern_hll_compact_sketch *hll_compact;
+
+	if (VARSIZE_ANY_EXHDR(hll_state) < (HLL_COMPACT_SKETCH_LENGTH(0) -
+										VARHDRSZ) ||
+		((uint8 *)VARDATA_ANY(hll_state))[0] != HLL_COMPACT_SKETCH_MAGIC)
+		return false;
+	hll_compact = (kern_hll_compact_sketch *)hll_state;
+	if (hll_compact->nbits < 1 || hll_compact->nbits > 24 ||
+		VARSIZE(hll_state) != HLL_COMPACT_SKETCH_LENGTH(hll_compact->nitems))
+		elog(ERROR, "HLL sketch looks corrupted");
+	return true;
+}
+
+/*
+ * __pgstrom_hll_sketch_expand
+ *
+ * It expands the sparse form of HLL sketch to the dense form.
+ */
+static bytea *
+__pgstrom_hll_sketch_expand(MemoryContext memcxt, bytea *hll_state)
+{
+	kern_hll_compact_sketch *hll_compact = (kern_hll_compact_sketch *)hll_state;
+	uint32		nrooms = (1U << hll_compact->nbits);
+	bytea	   *result;
+	uint8	   *hll_regs;
+	uint32		i;
+
+	result = MemoryContextAllocZero(memcxt, VARHDRSZ + nrooms);
+	SET_VARSIZE(result, VARHDRSZ + nrooms);
+	hll_regs = (uint8 *)VARDATA(result);
+	for (i=0; i < hll_compact->nitems; i++)
+	{
+		uint32	item = hll_compact->items[i];
+		uint32	index = (item >> 8);
+
+		if (index >= nrooms)
+			elog(ERROR, "HLL sketch looks corrupted");
+		hll_regs[index] = (item & 0xff);
+	}
+	return result;
+}
+
 /*
  * pgstrom_hll_sketch_merge
  */
@@ -1282,6 +1343,17 @@ pgstrom_hll_sketch_merge(PG_FUNCTION_ARGS)
 		if (PG_ARGISNULL(1))
 			PG_RETURN_NULL();
 		new_state = PG_GETARG_BYTEA_P(1);
+		if (__pgstrom_hll_sketch_is_compact(new_state))
+		{
+			/*
+			 * Keep the sparse form as is, then hll_count_final() can use
+			 * the cardinality estimated by GPU, if no other sketches are
+			 * merged to the group.
+			 */
+			hll_state = MemoryContextAlloc(aggcxt, VARSIZE(new_state));
+			memcpy(hll_state, new_state, VARSIZE(new_state));
+			PG_RETURN_POINTER(hll_state);
+		}
 		nrooms = VARSIZE_ANY_EXHDR(new_state);
 		if (nrooms < 1 || (nrooms & (nrooms - 1)) != 0)
 			elog(ERROR, "HLL sketch must have 2^N rooms (%u)", nrooms);
@@ -1292,15 +1364,37 @@ pgstrom_hll_sketch_merge(PG_FUNCTION_ARGS)
 	else
 	{
 		hll_state = PG_GETARG_BYTEA_P(0);
+		if (PG_ARGISNULL(1))
+			PG_RETURN_POINTER(hll_state);
+		if (__pgstrom_hll_sketch_is_compact(hll_state))
+			hll_state = __pgstrom_hll_sketch_expand(aggcxt, hll_state);
 		nrooms = VARSIZE_ANY_EXHDR(hll_state);
 		if (nrooms < 1 || (nrooms & (nrooms - 1)) != 0)
 			elog(ERROR, "HLL sketch must have 2^N rooms (%u)", nrooms);
-		if (!PG_ARGISNULL(1))
+		hll_regs = (uint8 *)VARDATA_ANY(hll_state);
+		new_state = PG_GETARG_BYTEA_P(1);
+		if (__pgstrom_hll_sketch_is_compact(new_state))
+		{
+			kern_hll_compact_sketch *hll_compact
+				= (kern_hll_compact_sketch *)new_state;
+
+			if ((1U << hll_compact->nbits) != nrooms)
+				elog(ERROR, "incompatible HLL sketch");
+			for (index=0; index < hll_compact->nitems; index++)
+			{
+				uint32	item = hll_compact->items[index];
+				uint32	i = (item >> 8);
+
+				if (i >= nrooms)
+					elog(ERROR, "HLL sketch looks corrupted");
+				if (hll_regs[i] < (item & 0xff))
+					hll_regs[i] = (item & 0xff);
+			}
+		}
+		else
 		{
-			new_state = PG_GETARG_BYTEA_P(1);
 			if (VARSIZE_ANY_EXHDR(hll_state) != VARSIZE_ANY_EXHDR(new_state))
 				elog(ERROR, "incompatible HLL sketch");
-			hll_regs = (uint8 *)VARDATA_ANY(hll_state);
 			new_regs = (uint8 *)VARDATA_ANY(new_state);
 			for (index=0; index < nrooms; index++)
 			{
@@ -1341,6 +1435,16 @@ pgstrom_hll_count_final(PG_FUNCTION_ARGS)
 	 * https://ja.wikiqube.net/wiki/HyperLogLog
 	 */
 	hll_state = PG_GETARG_BYTEA_P(0);
+	if (__pgstrom_hll_sketch_is_compact(hll_state))
+	{
+		/* already estimated by GPU */
+		kern_hll_compact_sketch *hll_compact
+			= (kern_hll_compact_sketch *)hll_state;
+		int64		gpu_estimate;
+
+		memcpy(&gpu_estimate, &hll_compact->estimate, sizeof(int64));
+		PG_RETURN_INT64(gpu_estimate);
+	}
 	nrooms = VARSIZE_ANY_EXHDR(hll_state);
 	if (nrooms < 1 || (nrooms & (nrooms - 1)) != 0)
 		elog(ERROR, "HLL sketch must have 2^N rooms (%u)", nrooms);
@@ -1377,6 +1481,9 @@ pgstrom_hll_sketch_histogram(PG_FUNCTION_ARGS)
 	int			max_hist = -1;
 	ArrayType  *result;
 
+	if (__pgstrom_hll_sketch_is_compact(hll_state))
+		hll_state = __pgstrom_hll_sketch_expand(CurrentMemoryContext,
+												hll_state);
 	nrooms = VARSIZE_ANY_EXHDR(hll_state);
 	if (nrooms < 1 || (nrooms & (nrooms - 1)) != 0)
 		elog(ERROR, "HLL sketch must have 2^N rooms (%u)", nrooms);
@@ -1405,3 +1512,404 @@ pgstrom_hll_sketch_histogram(PG_FUNCTION_ARGS)
 							 'i');
 	PG_RETURN_POINTER(result);
 }
+
+/*
+ * Quantile sketch support
+ */
+static kern_quantile_sketch *
+__pgstrom_qsketch_validate(bytea *state)
+{
+	kern_quantile_sketch *qsketch = (kern_quantile_sketch *)state;
+
+	if (VARSIZE(state) != QSKETCH_LENGTH ||
+		qsketch->nbuckets != QSKETCH_NBUCKETS)
+		elog(ERROR, "quantile sketch looks corrupted");
+	return qsketch;
+}
+
+static bytea *
+__pgstrom_qsketch_alloc(MemoryContext memcxt)
+{
+	kern_quantile_sketch *qsketch;
+
+	qsketch = MemoryContextAllocZero(memcxt, QSKETCH_LENGTH);
+	SET_VARSIZE(qsketch, QSKETCH_LENGTH);
+	qsketch->nbuckets = QSKETCH_NBUCKETS;
+
+	return (bytea *)qsketch;
+}
+
+/*
+ * pgstrom_qsketch_new
+ */
+Datum
+pgstrom_qsketch_new(PG_FUNCTION_ARGS)
+{
+	float8		fval = PG_GETARG_FLOAT8(0);
+	bytea	   *state = __pgstrom_qsketch_alloc(CurrentMemoryContext);
+	kern_quantile_sketch *qsketch = (kern_quantile_sketch *)state;
+
+	qsketch->counts[qsketch_bucket_index(fval)]++;
+
+	PG_RETURN_BYTEA_P(state);
+}
+
+/*
+ * pgstrom_qsketch_update
+ */
+Datum
+pgstrom_qsketch_update(PG_FUNCTION_ARGS)
+{
+	MemoryContext	aggcxt;
+	bytea		   *state;
+	kern_quantile_sketch *qsketch;
+
+	if (!AggCheckCallContext(fcinfo, &aggcxt))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+	}
+	if (PG_ARGISNULL(0))
+		state = __pgstrom_qsketch_alloc(aggcxt);
+	else
+		state = PG_GETARG_BYTEA_P(0);
+	qsketch = __pgstrom_qsketch_validate(state);
+	qsketch->counts[qsketch_bucket_index(PG_GETARG_FLOAT8(1))]++;
+
+	PG_RETURN_BYTEA_P(state);
+}
+
+/*
+ * pgstrom_qsketch_merge
+ */
+Datum
+pgstrom_qsketch_merge(PG_FUNCTION_ARGS)
+{
+	MemoryContext	aggcxt;
+	bytea		   *state;
+	kern_quantile_sketch *qsketch;
+	kern_quantile_sketch *new_sketch;
+	uint32			index;
+
+	if (!AggCheckCallContext(fcinfo, &aggcxt))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+	}
+	new_sketch = __pgstrom_qsketch_validate(PG_GETARG_BYTEA_P(1));
+	if (PG_ARGISNULL(0))
+	{
+		state = MemoryContextAlloc(aggcxt, QSKETCH_LENGTH);
+		memcpy(state, new_sketch, QSKETCH_LENGTH);
+	}
+	else
+	{
+		state = PG_GETARG_BYTEA_P(0);
+		qsketch = __pgstrom_qsketch_validate(state);
+		for (index=0; index < QSKETCH_NBUCKETS; index++)
+			qsketch->counts[index] += new_sketch->counts[index];
+	}
+	PG_RETURN_BYTEA_P(state);
+}
+
+/*
+ * __pgstrom_qsketch_estimate
+ *
+ * It walks on the cumulative counts of the buckets, then interpolates the
+ * value within the bucket that contains the rank to be estimated.
+ */
+static float8
+__pgstrom_qsketch_estimate(kern_quantile_sketch *qsketch,
+						   uint64 nitems, float8 fraction)
+{
+	float8		rank = fraction * (float8)(nitems - 1);
+	uint64		cumulative = 0;
+	uint32		index;
+
+	if (fraction < 0.0 || fraction > 1.0 || isnan(fraction))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("percentile value %g is not between 0 and 1",
+						fraction)));
+	for (index=0; index < QSKETCH_NBUCKETS; index++)
+	{
+		uint64		count = qsketch->counts[index];
+		uint32		k, sub;
+		int			expo;
+		float8		lower, upper, pos;
+
+		if (count == 0 || rank >= (float8)(cumulative + count))
+		{
+			cumulative += count;
+			continue;
+		}
+		if (index == QSKETCH_ZERO_BUCKET)
+			return 0.0;
+		if (index > QSKETCH_ZERO_BUCKET)
+			k = index - QSKETCH_ZERO_BUCKET - 1;
+		else
+			k = QSKETCH_ZERO_BUCKET - 1 - index;
+		expo = QSKETCH_MIN_EXPONENT + (k >> QSKETCH_SUBBUCKET_BITS);
+		sub = k & ((1U << QSKETCH_SUBBUCKET_BITS) - 1);
+		lower = ldexp(1.0 + (float8)(sub) /
+					  (float8)(1U << QSKETCH_SUBBUCKET_BITS), expo);
+		upper = ldexp(1.0 + (float8)(sub + 1) /
+					  (float8)(1U << QSKETCH_SUBBUCKET_BITS), expo);
+		pos = (rank - (float8)cumulative + 0.5) / (float8)count;
+		if (index > QSKETCH_ZERO_BUCKET)
+			return lower + (upper - lower) * pos;
+		return -upper + (upper - lower) * pos;
+	}
+	elog(ERROR, "Bug? quantile sketch has no bucket at the rank %g", rank);
+}
+
+static uint64
+__pgstrom_qsketch_nitems(kern_quantile_sketch *qsketch)
+{
+	uint64		nitems = 0;
+	uint32		index;
+
+	for (index=0; index < QSKETCH_NBUCKETS; index++)
+		nitems += qsketch->counts[index];
+	return nitems;
+}
+
+/*
+ * pgstrom_qsketch_percentile
+ */
+Datum
+pgstrom_qsketch_percentile(PG_FUNCTION_ARGS)
+{
+	kern_quantile_sketch *qsketch;
+	float8		fraction = PG_GETARG_FLOAT8(1);
+	uint64		nitems;
+
+	qsketch = __pgstrom_qsketch_validate(PG_GETARG_BYTEA_P(0));
+	nitems = __pgstrom_qsketch_nitems(qsketch);
+	if (nitems == 0)
+		PG_RETURN_NULL();
+	PG_RETURN_FLOAT8(__pgstrom_qsketch_estimate(qsketch, nitems, fraction));
+}
+
+/*
+ * pgstrom_qsketch_percentile_multi
+ */
+Datum
+pgstrom_qsketch_percentile_multi(PG_FUNCTION_ARGS)
+{
+	kern_quantile_sketch *qsketch;
+	ArrayType  *fractions = PG_GETARG_ARRAYTYPE_P(1);
+	ArrayType  *result;
+	Datum	   *values;
+	bool	   *isnull;
+	int			i, nitems;
+	uint64		count;
+
+	qsketch = __pgstrom_qsketch_validate(PG_GETARG_BYTEA_P(0));
+	count = __pgstrom_qsketch_nitems(qsketch);
+	if (count == 0)
+		PG_RETURN_NULL();
+	deconstruct_array(fractions,
+					  FLOAT8OID, sizeof(float8), FLOAT8PASSBYVAL, 'd',
+					  &values, &isnull, &nitems);
+	for (i=0; i < nitems; i++)
+	{
+		float8	fraction;
+
+		if (isnull[i])
+			continue;
+		fraction = DatumGetFloat8(values[i]);
+		values[i] = Float8GetDatum(__pgstrom_qsketch_estimate(qsketch,
+															  count,
+															  fraction));
+	}
+	result = construct_md_array(values,
+								isnull,
+								ARR_NDIM(fractions),
+								ARR_DIMS(fractions),
+								ARR_LBOUND(fractions),
+								FLOAT8OID,
+								sizeof(float8),
+								FLOAT8PASSBYVAL,
+								'd');
+	PG_RETURN_POINTER(result);
+}
+
+/*
+ * Fixed-point numeric accumulator support
+ */
+static kern_numeric_sum *
+__pgstrom_nsum_validate(bytea *state)
+{
+	kern_numeric_sum *nsum = (kern_numeric_sum *)state;
+
+	if (VARSIZE(state) != NSUM_LENGTH ||
+		nsum->scale < 0 || nsum->scale > NSUM_MAX_PRECISION)
+		elog(ERROR, "fixed-point numeric accumulator looks corrupted");
+	if (nsum->overflow)
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("numeric value is not representable by the fixed-point accumulator (scale %d)",
+						nsum->scale)));
+	return nsum;
+}
+
+static inline int128
+__pgstrom_nsum_get_value(kern_numeric_sum *nsum)
+{
+	return (int128)(((uint128)nsum->sum_hi << 64) | (uint128)nsum->sum_lo);
+}
+
+static inline void
+__pgstrom_nsum_set_value(kern_numeric_sum *nsum, int128 value)
+{
+	nsum->sum_lo = (cl_ulong)((uint128)value);
+	nsum->sum_hi = (cl_long)(value >> 64);
+}
+
+/*
+ * __pgstrom_nsum_to_numeric - it makes a numeric datum from the fixed-point
+ * value and its scale.
+ */
+static Datum
+__pgstrom_nsum_to_numeric(int128 value, int scale)
+{
+	char		buf[80];
+	char	   *pos = buf + sizeof(buf) - 1;
+	bool		is_negative = (value < 0);
+	uint128		uval = (is_negative ? -(uint128)value : (uint128)value);
+	int			ndigits = 0;
+
+	*pos = '\0';
+	do {
+		if (ndigits == scale && scale > 0)
+			*--pos = '.';
+		*--pos = '0' + (int)(uval % 10);
+		uval /= 10;
+		ndigits++;
+	} while (uval != 0 || ndigits <= scale);
+	if (is_negative)
+		*--pos = '-';
+
+	return DirectFunctionCall3(numeric_in,
+							   CStringGetDatum(pos),
+							   ObjectIdGetDatum(InvalidOid),
+							   Int32GetDatum(-1));
+}
+
+/*
+ * pgstrom_nsum_new
+ */
+Datum
+pgstrom_nsum_new(PG_FUNCTION_ARGS)
+{
+	Datum		datum = PG_GETARG_DATUM(0);
+	int32		scale = PG_GETARG_INT32(1);
+	kern_context kcxt;
+	kern_numeric_sum *nsum;
+	pg_numeric_t num;
+
+	if (scale < 0 || scale > NSUM_MAX_PRECISION)
+		elog(ERROR, "scale of the fixed-point accumulator is out of range: %d",
+			 scale);
+	memset(&kcxt, 0, sizeof(kcxt));
+	num = pg_numeric_from_varlena(&kcxt, (struct varlena *)datum);
+	if (kcxt.errcode != ERRCODE_STROM_SUCCESS ||
+		!nsum_rescale_value(&num, scale))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("numeric value %s is not representable by the fixed-point accumulator (scale %d)",
+						DatumGetCString(DirectFunctionCall1(numeric_out, datum)),
+						scale)));
+	nsum = palloc0(NSUM_LENGTH);
+	SET_VARSIZE(nsum, NSUM_LENGTH);
+	nsum->scale = scale;
+	nsum->nitems = 1;
+	__pgstrom_nsum_set_value(nsum, num.value.ival);
+
+	PG_RETURN_BYTEA_P(nsum);
+}
+
+/*
+ * pgstrom_nsum_merge
+ */
+Datum
+pgstrom_nsum_merge(PG_FUNCTION_ARGS)
+{
+	MemoryContext	aggcxt;
+	bytea		   *state;
+	kern_numeric_sum *nsum;
+	kern_numeric_sum *new_nsum;
+	int128			value;
+
+	if (!AggCheckCallContext(fcinfo, &aggcxt))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+	if (PG_ARGISNULL(1))
+	{
+		if (PG_ARGISNULL(0))
+			PG_RETURN_NULL();
+		PG_RETURN_DATUM(PG_GETARG_DATUM(0));
+	}
+	new_nsum = __pgstrom_nsum_validate(PG_GETARG_BYTEA_P(1));
+	if (PG_ARGISNULL(0))
+	{
+		state = MemoryContextAlloc(aggcxt, NSUM_LENGTH);
+		memcpy(state, new_nsum, NSUM_LENGTH);
+	}
+	else
+	{
+		state = PG_GETARG_BYTEA_P(0);
+		nsum = __pgstrom_nsum_validate(state);
+		if (nsum->scale != new_nsum->scale)
+			elog(ERROR, "Bug? fixed-point numeric accumulators have different scale (%d, %d)",
+				 nsum->scale, new_nsum->scale);
+		if (__builtin_add_overflow(__pgstrom_nsum_get_value(nsum),
+								   __pgstrom_nsum_get_value(new_nsum),
+								   &value))
+			ereport(ERROR,
+					(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+					 errmsg("sum of numeric is out of range of the fixed-point accumulator")));
+		__pgstrom_nsum_set_value(nsum, value);
+		nsum->nitems += new_nsum->nitems;
+	}
+	PG_RETURN_BYTEA_P(state);
+}
+
+/*
+ * pgstrom_fsum_numeric_fixed_final
+ */
+Datum
+pgstrom_fsum_numeric_fixed_final(PG_FUNCTION_ARGS)
+{
+	kern_numeric_sum *nsum = __pgstrom_nsum_validate(PG_GETARG_BYTEA_P(0));
+
+	if (nsum->nitems == 0)
+		PG_RETURN_NULL();
+	PG_RETURN_DATUM(__pgstrom_nsum_to_numeric(__pgstrom_nsum_get_value(nsum),
+											  nsum->scale));
+}
+
+/*
+ * pgstrom_favg_numeric_fixed_final
+ */
+Datum
+pgstrom_favg_numeric_fixed_final(PG_FUNCTION_ARGS)
+{
+	kern_numeric_sum *nsum = __pgstrom_nsum_validate(PG_GETARG_BYTEA_P(0));
+	Datum		sum;
+
+	if (nsum->nitems == 0)
+		PG_RETURN_NULL();
+	sum = __pgstrom_nsum_to_numeric(__pgstrom_nsum_get_value(nsum),
+									nsum->scale);
+	PG_RETURN_DATUM(DirectFunctionCall2(numeric_div,
+										sum,
+										DirectFunctionCall1(int8_numeric,
+											Int64GetDatum(nsum->nitems))));
+}
@@ -9,6 +9,8 @@
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the PostgreSQL License.
  */
+#include <dlfcn.h>
+#include <glob.h>
 #include "pg_strom.h"
 #include "arrow_defs.h"
 #include "arrow_ipc.h"
@@ -30,10 +32,28 @@ typedef struct RecordBatchFieldState
 	size_t		values_length;
 	off_t		extra_offset;
 	size_t		extra_length;
+	/* dictionary-encoded field, if dict_index_width > 0 */
+	int			dict_index_width;	/* width of the index values */
+	int			dict_unitsz;		/* width of values, or 0 if varlena */
+	int			dict_codec;			/* ArrowCompressionType, or -1 if none */
+	int64		dict_nitems;
+	int64		dict_null_count;
+	off_t		dict_nullmap_offset;	/* offset from the file head */
+	size_t		dict_nullmap_length;
+	off_t		dict_values_offset;		/* offset from the file head */
+	size_t		dict_values_length;
+	off_t		dict_extra_offset;		/* offset from the file head */
+	size_t		dict_extra_length;
+	/* column chunk of the parquet row-group, if rb_parquet */
+	ParquetChunkInfo pq_chunk;
 	/* min/max statistics */
 	SQLstat__datum stat_min;
 	SQLstat__datum stat_max;
 	bool		stat_isnull;
+	bool		stat_bloom;		/* true, if bloom filter is embedded */
+	/* hive-style partition column, never cached */
+	bool		part_column;	/* true, if virtual partition column */
+	char	   *part_value;		/* value on the path, or NULL */
 	/* sub-fields if any */
 	int			num_children;
 	struct RecordBatchFieldState *children;
@@ -48,6 +68,8 @@ typedef struct RecordBatchState
 	off_t		rb_offset;	/* offset from the head */
 	size_t		rb_length;	/* length of the entire RecordBatch */
 	int64		rb_nitems;	/* number of items */
+	int			rb_codec;	/* ArrowCompressionType, or -1 if none */
+	bool		rb_parquet;	/* true, if parquet row-group */
 	/* per column information */
 	int			ncols;
 	RecordBatchFieldState columns[FLEXIBLE_ARRAY_MEMBER];
@@ -68,6 +90,7 @@ typedef struct
 	dlist_node	chain;
 	dlist_node	lru_chain;
 	dlist_head	siblings;	/* if two or more record batches per file */
+	bool		stale;		/* true, if record-batches were appended */
 	/* key of RecordBatch metadata cache */
 	struct stat	stat_buf;
 	uint32		hash;
@@ -76,6 +99,8 @@ typedef struct
 	off_t		rb_offset;	/* offset from the head */
     size_t		rb_length;	/* length of the entire RecordBatch */
     int64		rb_nitems;	/* number of items */
+	int			rb_codec;	/* ArrowCompressionType, or -1 if none */
+	bool		rb_parquet;	/* true, if parquet row-group */
 	int			ncols;
 	int			nfields;	/* length of fstate[] array */
 	RecordBatchFieldState fstate[FLEXIBLE_ARRAY_MEMBER];
@@ -115,9 +140,106 @@ typedef struct
 	ExprState	   *eval_state;
 	Bitmapset	   *stat_attrs;
 	Bitmapset	   *load_attrs;
+	List		   *in_lists;	/* list of arrowStatsInList */
+	List		   *bloom_quals;	/* list of arrowStatsBloom */
 	ExprContext	   *econtext;
+	/* bloom filters of the current file, loaded on demand */
+	MemoryContext	bloom_mcxt;
+	dev_t			bloom_st_dev;
+	ino_t			bloom_st_ino;
+	off_t			bloom_st_size;
+	int				bloom_nrooms;	/* number of record-batches */
+	int				bloom_ncols;
+	ArrowField	   *bloom_fields;
+	SQLbloom	 ***bloom_filters;	/* [attnum-1][rb_index] */
 } arrowStatsHint;
 
+/*
+ * (VAR = ANY(ARRAY)) --> any element E satisfies (Min <= E && Max >= E)
+ */
+typedef struct
+{
+	AttrNumber		attnum;
+	Oid				collid;
+	Expr		   *array_expr;
+	ExprState	   *array_state;
+	int16			elem_len;
+	bool			elem_byval;
+	char			elem_align;
+	FmgrInfo		le_proc;	/* Min <= E */
+	FmgrInfo		ge_proc;	/* Max >= E */
+} arrowStatsInList;
+
+/*
+ * (VAR = ARG) or (VAR = ANY(ARRAY)) --> checks the bloom filter, if any
+ */
+typedef struct
+{
+	AttrNumber		attnum;
+	bool			is_array;
+	Expr		   *arg_expr;
+	ExprState	   *arg_state;
+	int16			elem_len;
+	bool			elem_byval;
+	char			elem_align;
+} arrowStatsBloom;
+
+/*
+ * aggregation answered by min/max statistics per record batch
+ */
+typedef struct
+{
+	int				kind;		/* one of ARROW_STATS_AGG__* */
+	AttrNumber		attnum;		/* column to be aggregated, or 0 */
+	FmgrInfo		cmp_proc;	/* btree comparator, if MIN/MAX */
+	Datum			value;		/* current MIN/MAX */
+	bool			isnull;
+	int64			nitems;		/* current NROWS */
+} arrowStatsAggItem;
+
+typedef struct
+{
+	ExprState	   *full_state;	/* quals are true on any rows, if true */
+	Bitmapset	   *qual_attrs;	/* columns referenced by the quals */
+	ExprContext	   *econtext;
+	uint32			nbatches;	/* # of record-batches aggregated */
+	int				nitems;
+	arrowStatsAggItem items[FLEXIBLE_ARRAY_MEMBER];
+} arrowStatsAgg;
+
+/*
+ * vectorized filter of the CPU scan on the fixed-width columns
+ */
+#define ARROW_VEC_QUAL__OPER		1	/* VAR <OPER> ARG */
+#define ARROW_VEC_QUAL__INLIST		2	/* VAR = ANY(ARRAY) */
+#define ARROW_VEC_QUAL__NULLTEST	3	/* VAR IS [NOT] NULL */
+#define ARROW_VEC_INLIST_MAX_NITEMS	32
+
+typedef struct
+{
+	int				kind;		/* one of ARROW_VEC_QUAL__* */
+	AttrNumber		attnum;
+	Oid				atttypid;
+	StrategyNumber	strategy;	/* btree strategy, if OPER */
+	bool			is_null;	/* IS NULL, if NULLTEST */
+	Oid				arg_type;	/* argument or element type */
+	Expr		   *arg_expr;
+	ExprState	   *arg_state;
+} arrowVecQual;
+
+typedef struct
+{
+	List		   *orig_quals;
+	List		   *vec_quals;	/* list of arrowVecQual */
+	ExprContext	   *econtext;
+	MemoryContext	mcontext;	/* memory context of the buffers below */
+	uint32			nrooms;
+	uint8		   *mask;		/* per-row result of the current batch */
+	uint8		   *temp;		/* working buffer for IN-list */
+	uint32		   *rows;		/* selection vector of the current batch */
+	uint64			nitems_removed;
+} arrowVecFilter;
+
 /*
  * MVCC state for the pending writes
  */
@@ -161,6 +283,57 @@ typedef struct
 	SQLtable	sql_table;
 } arrowWriteState;
 
+/*
+ * ArrowFdwSchedState - shared state of the record-batch scheduler
+ *
+ * On parallel scan, record-batches are sorted by the length to be read,
+ * then distributed to the participant processes (leader + workers) in
+ * the longest-processing-time-first manner. Every participant takes
+ * the record-batches from the head of its own range, and steals from
+ * the tail of the other ranges once its own range gets empty.
+ */
+typedef struct
+{
+	slock_t		lock;
+	uint32		base;		/* initial head of the range */
+	uint32		end;		/* initial tail of the range */
+	uint32		head;		/* next position to be taken by the owner */
+	uint32		tail;		/* next position to be stolen by others */
+	/* statistics of the owner process */
+	uint32		nloaded;	/* # of record-batches taken */
+	uint32		nstolen;	/* # of record-batches stolen from others */
+	uint64		load_bytes;	/* total length of the record-batches taken */
+} ArrowFdwSchedSlot;
+
+/*
+ * ArrowFdwSnapshotFile - number of record-batches the leader process saw
+ * at the query start. Workers never see the record-batches appended later.
+ */
+typedef struct
+{
+	dev_t		st_dev;
+	ino_t		st_ino;
+	uint32		nbatches;
+} ArrowFdwSnapshotFile;
+
+typedef struct
+{
+	uint32		nslots;		/* number of participant processes */
+	uint32		nitems;		/* number of record-batches */
+	uint32		nfiles;		/* number of files */
+	ArrowFdwSchedSlot slots[FLEXIBLE_ARRAY_MEMBER];
+	/* uint32 order[nitems] follows the slots[] */
+	/* ArrowFdwSnapshotFile files[nfiles] follows the order[] */
+} ArrowFdwSchedState;
+
+#define ARROW_SCHED_ORDER(sched)							\
+	((uint32 *)((char *)(sched) +							\
+				MAXALIGN(offsetof(ArrowFdwSchedState,		\
+								  slots[(sched)->nslots]))))
+#define ARROW_SCHED_FILES(sched)							\
+	((ArrowFdwSnapshotFile *)((char *)ARROW_SCHED_ORDER(sched) +	\
+							  MAXALIGN(sizeof(uint32) * (sched)->nitems)))
+
 /*
  * ArrowFdwState
  */
@@ -170,15 +343,32 @@ struct ArrowFdwState
 	List	   *gpuDirectFileDescList;	/* list of GPUDirectFileDesc */
 	List	   *fdescList;				/* list of File (buffered i/o) */
 	Bitmapset  *referenced;
+	bool		writable;			/* true, if writable foreign table */
+	Bitmapset  *stat_attrs;			/* columns with min/max statistics */
 	arrowStatsHint *stats_hint;
+	arrowStatsAgg  *stats_agg;		/* valid if GpuPreAgg by statistics */
+	arrowVecFilter *vec_filter;		/* valid if CPU scan */
 	pg_atomic_uint32   *rbatch_index;
 	pg_atomic_uint32	__rbatch_index_local;	/* if single process */
 	pg_atomic_uint32   *rbatch_nload;
 	pg_atomic_uint32	__rbatch_nload_local;	/* if single process */
 	pg_atomic_uint32   *rbatch_nskip;
 	pg_atomic_uint32	__rbatch_nskip_local;	/* if single process */
+	pg_atomic_uint32   *rbatch_nstats;
+	pg_atomic_uint32	__rbatch_nstats_local;	/* if single process */
+	Bitmapset  *rbatch_cached;		/* RecordBatches answered by the caller */
+	ArrowFdwIoStats	   *io_stats;
+	ArrowFdwIoStats		__io_stats_local;		/* if single process */
+	ArrowFdwSchedState *sched;		/* valid if parallel scan */
+	ArrowFdwSchedState *sched_local;/* copy of the statistics on shutdown */
+	int			sched_slot;			/* my slot on the sched->slots[] */
+	int			part_ncols;			/* number of partition columns */
+	uint32		part_nfiles;		/* number of files before pruning */
+	uint32		part_nskip;			/* number of pruned files */
+	uint32		prefetch_index;		/* next RecordBatch to be prefetched */
 	pgstrom_data_store *curr_pds;	/* current focused buffer */
 	cl_ulong	curr_index;			/* current index to row on KDS */
+	cl_ulong	curr_nrows;			/* number of rows to be fetched */
 	/* state of RecordBatches */
 	uint32		num_rbatches;
 	RecordBatchState *rbatches[FLEXIBLE_ARRAY_MEMBER];
@@ -191,9 +381,20 @@ static arrowMetadataState *arrow_metadata_state = NULL;
 static dlist_head		arrow_write_redo_list;
 static bool				arrow_fdw_enabled;				/* GUC */
 static bool				arrow_fdw_stats_hint_enabled;	/* GUC */
+static bool				arrow_fdw_stats_aggregate_enabled; /* GUC */
 static int				arrow_metadata_cache_size_kb;	/* GUC */
 static size_t			arrow_metadata_cache_size;
 static int				arrow_record_batch_size_kb;		/* GUC */
+static int				arrow_io_coalesce_gap_kb;		/* GUC */
+static int				arrow_prefetch_batches;			/* GUC */
+static char			   *arrow_metadata_cache_dir;		/* GUC */
+static int				arrow_snapshot_batches;			/* GUC */
+static bool				arrow_fdw_write_behind;			/* GUC */
+#if PG_VERSION_NUM >= 140000
+static int				arrow_insert_batch_size;		/* GUC */
+#endif
+static bool				arrow_fdw_mmap_enabled;			/* GUC */
+static bool				arrow_fdw_vec_filter_enabled;	/* GUC */
 
 /* ---------- static functions ---------- */
 static Oid		arrowTypeToPGTypeOid(ArrowField *field, int *typmod);
@@ -205,15 +406,27 @@ static List	   *__arrowFdwExtractFilesList(List *options_list,
 										   int *p_parallel_nworkers,
 										   bool *p_writable);
 static List	   *arrowFdwExtractFilesList(List *options_list);
+static int		arrowFdwPartitionColumns(TupleDesc tupdesc, List *filesList);
+static bool		arrowFdwPartitionQualIsPrunable(Node *qual, AttrNumber anum_min);
+static List	   *arrowFdwPrunePartitionFiles(TupleDesc tupdesc,
+											List *filesList,
+											int part_ncols,
+											List *quals);
+static RecordBatchState *arrowFdwSetupPartitionColumns(RecordBatchState *rb_state,
+													   TupleDesc tupdesc,
+													   const char *fname,
+													   int part_ncols);
+static List	   *__arrowLookupOrBuildMetadataCache(File fdesc,
+												  Bitmapset **p_stat_attrs,
+												  int snapshot_batches);
 static List	   *arrowLookupOrBuildMetadataCache(File fdesc, Bitmapset **p_stat_attrs);
+static void		arrowUnlinkMetadataCacheFile(dev_t st_dev, ino_t st_ino);
 static void		pg_datum_arrow_ref(kern_data_store *kds,
 								   kern_colmeta *cmeta,
 								   size_t index,
 								   Datum *p_datum,
 								   bool *p_isnull);
 /* routines for writable arrow_fdw foreign tables */
-static void	setupArrowSQLbufferSchema(SQLtable *table, TupleDesc tupdesc,
-									  ArrowFileInfo *af_info);
 static void setupArrowSQLbufferBatches(SQLtable *table,
 									   ArrowFileInfo *af_info);
 static loff_t createArrowWriteRedoLog(File filp, bool is_newfile);
@@ -225,6 +438,7 @@ Datum	pgstrom_arrow_fdw_validator(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_precheck_schema(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_truncate(PG_FUNCTION_ARGS);
 Datum	pgstrom_arrow_fdw_import_file(PG_FUNCTION_ARGS);
+Datum	pgstrom_arrow_fdw_snapshots(PG_FUNCTION_ARGS);
 
 /*
  * timespec_comp - compare timespec values
@@ -331,6 +545,7 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 {
 	ForeignTable   *ft = GetForeignTable(foreigntableid);
 	List		   *filesList;
+	List		   *sel_clauses = baserel->baserestrictinfo;
 	Size			filesSizeTotal = 0;
 	Bitmapset	   *referenced = NULL;
 	BlockNumber		npages = 0;
@@ -353,6 +568,35 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 	filesList = __arrowFdwExtractFilesList(ft->options,
 										   &parallel_nworkers,
 										   &writable);
+	/* hive-style partition pruning, prior to reading the footer */
+	if (!writable)
+	{
+		Relation	frel = table_open(foreigntableid, NoLock);
+		TupleDesc	tupdesc = RelationGetDescr(frel);
+		int			part_ncols;
+
+		part_ncols = arrowFdwPartitionColumns(tupdesc, filesList);
+		if (part_ncols > 0)
+		{
+			AttrNumber	anum_min = tupdesc->natts - part_ncols + 1;
+
+			filesList = arrowFdwPrunePartitionFiles(tupdesc,
+													filesList,
+													part_ncols,
+													baserel->baserestrictinfo);
+			/* pruned clauses are already reflected to ntuples */
+			sel_clauses = NIL;
+			foreach (lc, baserel->baserestrictinfo)
+			{
+				RestrictInfo   *rinfo = lfirst(lc);
+
+				if (!arrowFdwPartitionQualIsPrunable((Node *)rinfo->clause,
+													 anum_min))
+					sel_clauses = lappend(sel_clauses, rinfo);
+			}
+		}
+		table_close(frel, NoLock);
+	}
 	foreach (lc, filesList)
 	{
 		char	   *fname = strVal(lfirst(lc));
@@ -417,7 +661,7 @@ ArrowGetForeignRelSize(PlannerInfo *root,
 	baserel->tuples = ntuples;
 	baserel->rows = ntuples *
 		clauselist_selectivity(root,
-							   baserel->baserestrictinfo,
+							   sel_clauses,
 							   0,
 							   JOIN_INNER,
 							   NULL);
@@ -624,7 +868,8 @@ ArrowGetForeignPlan(PlannerInfo *root,
  *
  * If mapped Apache Arrow files have custome-metadata of "min_values" and
  * "max_values" at the Field, arrow_fdw deals with this comma separated
- * integer values as min/max value for each field, if any.
+ * integer values (or hex-encoded prefix for Utf8/Binary) as min/max value
+ * for each field, if any.
  * Once we can know min/max value of the field, we can skip record batches
  * that shall not match with WHERE-clause.
  *
@@ -646,6 +891,7 @@ typedef struct arrowFieldStatsBinary
 	bool   *isnull;
 	char   *min_values;
 	char   *max_values;
+	bool   *has_bloom;	/* true, if bloom filter is embedded */
 	int		nfields;	/* if List/Struct data type */
 	struct arrowFieldStatsBinary *subfields;
 } arrowFieldStatsBinary;
@@ -674,6 +920,8 @@ __releaseArrowFieldStatsBinary(arrowFieldStatsBinary *bstats)
 		pfree(bstats->min_values);
 	if (bstats->max_values)
 		pfree(bstats->max_values);
+	if (bstats->has_bloom)
+		pfree(bstats->has_bloom);
 }
 
 static void
@@ -717,6 +965,78 @@ __atoi128(const char *tok, bool *p_isnull)
 	return ival;
 }
 
+static inline int
+__hexval(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return c - 'A' + 10;
+}
+
+/*
+ * __parseStatsString
+ *
+ * It parses the hex-encoded byte-wise prefix of Utf8/Binary values, like
+ * '\x414243' or '\x414243...' if truncated, into SQLstat__datum.
+ */
+static bool
+__parseStatsString(const char *tok, SQLstat__datum *datum, bool *p_isnull)
+{
+	int			len = 0;
+
+	memset(datum, 0, sizeof(SQLstat__datum));
+	if (strcmp(tok, "null") == 0)
+	{
+		*p_isnull = true;
+		return true;
+	}
+	if (tok[0] != '\\' || tok[1] != 'x')
+		return false;
+	for (tok += 2; isxdigit(tok[0]) && isxdigit(tok[1]); tok += 2)
+	{
+		if (len >= SQLSTAT_STRING_PREFIX_LEN)
+			return false;
+		datum->str.data[len++] = (__hexval(tok[0]) << 4) | __hexval(tok[1]);
+	}
+	if (strcmp(tok, "...") == 0 && len == SQLSTAT_STRING_PREFIX_LEN)
+		datum->str.len = SQLSTAT_STRING_PREFIX_LEN + 1;
+	else if (*tok == '\0')
+		datum->str.len = len;
+	else
+		return false;
+	return true;
+}
+
+/*
+ * __boundStatsString
+ *
+ * A truncated prefix is a lower bound of the original value as is, however,
+ * it needs to be rounded up to the next prefix to be an upper bound.
+ * It returns false if no upper bound is representable within the prefix.
+ */
+static bool
+__boundStatsString(SQLstat__datum *datum, bool is_max)
+{
+	int			len;
+
+	if (datum->str.len <= SQLSTAT_STRING_PREFIX_LEN)
+		return true;
+	len = SQLSTAT_STRING_PREFIX_LEN;
+	if (is_max)
+	{
+		while (len > 0 && datum->str.data[len-1] == 0xff)
+			len--;
+		if (len == 0)
+			return false;
+		datum->str.data[len-1]++;
+	}
+	memset(datum->str.data + len, 0, SQLSTAT_STRING_PREFIX_LEN - len);
+	datum->str.len = len;
+	return true;
+}
+
 static bool
 __parseArrowFieldStatsBinary(arrowFieldStatsBinary *bstats,
 							 ArrowField *field,
@@ -729,6 +1049,8 @@ __parseArrowFieldStatsBinary(arrowFieldStatsBinary *bstats,
 	char	   *min_values = NULL;
 	char	   *max_values = NULL;
 	bool	   *isnull = NULL;
+	bool		is_string = false;
+	bool		is_valid = true;
 	char	   *tok1, *pos1;
 	char	   *tok2, *pos2;
 	uint32		index;
@@ -736,6 +1058,12 @@ __parseArrowFieldStatsBinary(arrowFieldStatsBinary *bstats,
 	/* determine the unitsz of datum */
 	switch (field->type.node.tag)
 	{
+		case ArrowNodeTag__Utf8:
+		case ArrowNodeTag__Binary:
+			unitsz = sizeof(SQLstat__datum);
+			is_string = true;
+			break;
+
 		case ArrowNodeTag__Int:
 			switch (field->type.Int.bitWidth)
 			{
@@ -840,19 +1168,49 @@ __parseArrowFieldStatsBinary(arrowFieldStatsBinary *bstats,
 		 tok2 = strtok_r(NULL, ",", &pos2), index++)
 	{
 		bool		__isnull = false;
-		int128_t	__min = __atoi128(__trim(tok1), &__isnull);
-		int128_t	__max = __atoi128(__trim(tok2), &__isnull);
 
-		if (__isnull)
-			isnull[index] = true;
+		if (is_string)
+		{
+			SQLstat__datum	__min;
+			SQLstat__datum	__max;
+
+			if (!__parseStatsString(__trim(tok1), &__min, &__isnull) ||
+				!__parseStatsString(__trim(tok2), &__max, &__isnull))
+			{
+				is_valid = false;
+				break;
+			}
+			if (__isnull)
+				isnull[index] = true;
+			else if (!__boundStatsString(&__min, false) ||
+					 !__boundStatsString(&__max, true))
+			{
+				/* no upper bound, so not usable for this field */
+				is_valid = false;
+				break;
+			}
+			else
+			{
+				memcpy(min_values + unitsz * index, &__min, unitsz);
+				memcpy(max_values + unitsz * index, &__max, unitsz);
+			}
+		}
 		else
 		{
-			memcpy(min_values + unitsz * index, &__min, unitsz);
-			memcpy(max_values + unitsz * index, &__max, unitsz);
+			int128_t	__min = __atoi128(__trim(tok1), &__isnull);
+			int128_t	__max = __atoi128(__trim(tok2), &__isnull);
+
+			if (__isnull)
+				isnull[index] = true;
+			else
+			{
+				memcpy(min_values + unitsz * index, &__min, unitsz);
+				memcpy(max_values + unitsz * index, &__max, unitsz);
+			}
 		}
 	}
 	/* sanity checks */
-	if (!tok1 && !tok2 && index == bstats->nrooms)
+	if (is_valid && !tok1 && !tok2 && index == bstats->nrooms)
 	{
 		bstats->unitsz = unitsz;
 		bstats->isnull = isnull;
@@ -928,6 +1286,55 @@ __buildArrowFieldStatsBinary(arrowFieldStatsBinary *bstats,
 	return retval;
 }
 
+/*
+ * __buildArrowFieldBloomBinary
+ *
+ * It checks which record-batches have bloom filter on the field. The bitmap
+ * itself is not kept in the metadata cache, but loaded on demand.
+ */
+static bool
+__buildArrowFieldBloomBinary(arrowFieldStatsBinary *bstats,
+							 ArrowField *field,
+							 uint32 numRecordBatches)
+{
+	const char *bloom_tokens = NULL;
+	char	   *buffer;
+	char	   *tok, *pos;
+	bool	   *has_bloom;
+	bool		found = false;
+	uint32		index;
+	int			k;
+
+	for (k=0; k < field->_num_custom_metadata; k++)
+	{
+		ArrowKeyValue *kv = &field->custom_metadata[k];
+
+		if (strcmp(kv->key, "bloom_filters") == 0)
+			bloom_tokens = kv->value;
+	}
+	if (!bloom_tokens)
+		return false;
+
+	buffer = pstrdup(bloom_tokens);
+	has_bloom = palloc0(sizeof(bool) * numRecordBatches);
+	for (tok = strtok_r(buffer, ",", &pos), index = 0;
+		 tok != NULL && index < numRecordBatches;
+		 tok = strtok_r(NULL, ",", &pos), index++)
+	{
+		if (strcmp(__trim(tok), "null") != 0)
+			has_bloom[index] = found = true;
+	}
+	pfree(buffer);
+	/* sanity checks */
+	if (!found || tok != NULL || index != numRecordBatches)
+	{
+		pfree(has_bloom);
+		return false;
+	}
+	bstats->has_bloom = has_bloom;
+	return true;
+}
+
 static arrowStatsBinary *
 buildArrowStatsBinary(const ArrowFooter *footer, Bitmapset **p_stat_attrs)
 {
@@ -949,6 +1356,10 @@ buildArrowStatsBinary(const ArrowFooter *footer, Bitmapset **p_stat_attrs)
 				*p_stat_attrs = bms_add_member(*p_stat_attrs, j+1);
 			found = true;
 		}
+		if (__buildArrowFieldBloomBinary(&arrow_bstats->columns[j],
+										 &footer->schema.fields[j],
+										 footer->_num_recordBatches))
+			found = true;
 	}
 	if (!found)
 	{
@@ -989,7 +1400,8 @@ __applyArrowFieldStatsBinary(RecordBatchFieldState *fstate,
 		memset(&fstate->stat_max, 0, sizeof(SQLstat__datum));
 		fstate->stat_isnull = true;
 	}
-	
+	fstate->stat_bloom = (bstats->has_bloom && bstats->has_bloom[rb_index]);
+
 	Assert(fstate->num_children == bstats->nfields);
 	for (j=0; j < fstate->num_children; j++)
 	{
@@ -1026,6 +1438,8 @@ __buildArrowFieldStatsList(ArrowField *field, uint32 numRecordBatches)
 	char	   *tok1, *pos1;
 	char	   *tok2, *pos2;
 	SQLstat	   *results = NULL;
+	bool		is_string = false;
+	bool		is_valid = true;
 	int			k, index;
 
 	for (k=0; k < field->_num_custom_metadata; k++)
@@ -1039,6 +1453,9 @@ __buildArrowFieldStatsList(ArrowField *field, uint32 numRecordBatches)
 	}
 	if (!min_tokens || !max_tokens)
 		return NULL;
+	if (field->type.node.tag == ArrowNodeTag__Utf8 ||
+		field->type.node.tag == ArrowNodeTag__Binary)
+		is_string = true;
 	min_buffer = alloca(strlen(min_tokens) + 1);
 	max_buffer = alloca(strlen(max_tokens) + 1);
 	strcpy(min_buffer, min_tokens);
@@ -1051,8 +1468,26 @@ __buildArrowFieldStatsList(ArrowField *field, uint32 numRecordBatches)
 		 tok2 = strtok_r(NULL, ",", &pos2), index++)
 	{
 		bool		__isnull = false;
-		int128_t	__min = __atoi128(__trim(tok1), &__isnull);
-		int128_t	__max = __atoi128(__trim(tok2), &__isnull);
+		SQLstat__datum __min;
+		SQLstat__datum __max;
+
+		if (is_string)
+		{
+			/* keep the truncated mark as is, for the writer */
+			if (!__parseStatsString(__trim(tok1), &__min, &__isnull) ||
+				!__parseStatsString(__trim(tok2), &__max, &__isnull))
+			{
+				is_valid = false;
+				break;
+			}
+		}
+		else
+		{
+			memset(&__min, 0, sizeof(SQLstat__datum));
+			memset(&__max, 0, sizeof(SQLstat__datum));
+			__min.i128 = __atoi128(__trim(tok1), &__isnull);
+			__max.i128 = __atoi128(__trim(tok2), &__isnull);
+		}
 
 		if (!__isnull)
 		{
@@ -1061,13 +1496,13 @@ __buildArrowFieldStatsList(ArrowField *field, uint32 numRecordBatches)
 			item->next = results;
 			item->rb_index = index;
 			item->is_valid = true;
-			item->min.i128 = __min;
-			item->max.i128 = __max;
+			item->min = __min;
+			item->max = __max;
 			results = item;
 		}
 	}
 	/* sanity checks */
-	if (!tok1 && !tok2 && index == numRecordBatches)
+	if (is_valid && !tok1 && !tok2 && index == numRecordBatches)
 		return results;
 	/* ah, error... */
 	while (results)
@@ -1080,11 +1515,132 @@ __buildArrowFieldStatsList(ArrowField *field, uint32 numRecordBatches)
 	return NULL;
 }
 
+/*
+ * __parseArrowBloomToken
+ *
+ * It parses a "NHASH:HEX-BITMAP" token of the "bloom_filters" custom-metadata
+ * into SQLbloom. It returns NULL, if "null" or invalid.
+ */
+static SQLbloom *
+__parseArrowBloomToken(const char *tok, int rb_index)
+{
+	SQLbloom   *bloom;
+	unsigned char *bitmap;
+	const char *pos;
+	size_t		len, i;
+	uint64		nbits;
+	int			nhash = 0;
+
+	for (pos = tok; isdigit(*pos) && nhash <= 64; pos++)
+		nhash = 10 * nhash + (*pos - '0');
+	if (pos == tok || *pos++ != ':' || nhash < 1 || nhash > 64)
+		return NULL;
+	len = strlen(pos);
+	nbits = 4 * len;
+	if (nbits < SQLBLOOM_MIN_NBITS ||
+		nbits > (1UL << 31) ||
+		(nbits & (nbits - 1)) != 0)
+		return NULL;
+
+	bloom = palloc0(offsetof(SQLbloom, bitmap[nbits / 64]));
+	bloom->rb_index = rb_index;
+	bloom->nhash = nhash;
+	bloom->nbits = nbits;
+	bitmap = (unsigned char *)bloom->bitmap;
+	for (i=0; i < len; i += 2)
+	{
+		if (!isxdigit(pos[i]) || !isxdigit(pos[i+1]))
+		{
+			pfree(bloom);
+			return NULL;
+		}
+		bitmap[i/2] = (__hexval(pos[i]) << 4) | __hexval(pos[i+1]);
+	}
+	return bloom;
+}
+
+/*
+ * __buildArrowFieldBloomList
+ *
+ * It reconstructs the list of SQLbloom from the custom-metadata of the field,
+ * to write back the bloom filters of the existing record-batches.
+ */
+static SQLbloom *
+__buildArrowFieldBloomList(ArrowField *field, uint32 numRecordBatches)
+{
+	const char *bloom_tokens = NULL;
+	char	   *buffer;
+	char	   *tok, *pos;
+	SQLbloom   *results = NULL;
+	int			k, index;
+
+	for (k=0; k < field->_num_custom_metadata; k++)
+	{
+		ArrowKeyValue *kv = &field->custom_metadata[k];
+
+		if (strcmp(kv->key, "bloom_filters") == 0)
+			bloom_tokens = kv->value;
+	}
+	if (!bloom_tokens)
+		return NULL;
+	buffer = pstrdup(bloom_tokens);
+	for (tok = strtok_r(buffer, ",", &pos), index = 0;
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",", &pos), index++)
+	{
+		SQLbloom   *item = __parseArrowBloomToken(__trim(tok), index);
+
+		if (item)
+		{
+			item->next = results;
+			results = item;
+		}
+	}
+	pfree(buffer);
+	/* sanity checks */
+	if (index == numRecordBatches)
+		return results;
+	/* ah, error... */
+	while (results)
+	{
+		SQLbloom   *next = results->next;
+
+		pfree(results);
+		results = next;
+	}
+	return NULL;
+}
+
 /*
  * execInitArrowStatsHint / execCheckArrowStatsHint / execEndArrowStatsHint
  *
  * ... are executor routines for min/max statistics.
  */
+static StrategyNumber
+__lookupArrowStatsStrategy(Oid opcode, Oid *p_opfamily)
+{
+	StrategyNumber strategy = InvalidStrategy;
+	CatCList   *catlist;
+	int			i;
+
+	catlist = SearchSysCacheList1(AMOPOPID, ObjectIdGetDatum(opcode));
+	for (i=0; i < catlist->n_members; i++)
+	{
+		HeapTuple	tuple = &catlist->members[i]->tuple;
+		Form_pg_amop amop = (Form_pg_amop) GETSTRUCT(tuple);
+
+		if (amop->amopmethod == BRIN_AM_OID)
+		{
+			*p_opfamily = amop->amopfamily;
+			strategy = amop->amopstrategy;
+			break;
+		}
+	}
+	ReleaseSysCacheList(catlist);
+
+	return strategy;
+}
+
 static bool
 __buildArrowStatsOper(arrowStatsHint *arange,
 					  ScanState *ss,
@@ -1097,9 +1653,7 @@ __buildArrowStatsOper(arrowStatsHint *arange,
 	Node	   *arg;
 	Expr	   *expr;
 	Oid			opfamily = InvalidOid;
-	StrategyNumber strategy = InvalidStrategy;
-	CatCList   *catlist;
-	int			i;
+	StrategyNumber strategy;
 
 	if (!reverse)
 	{
@@ -1121,22 +1675,11 @@ __buildArrowStatsOper(arrowStatsHint *arange,
 	if (contain_var_clause(arg) ||
 		contain_volatile_functions(arg))
 		return false;
+	/* min/max of Utf8 are byte-wise, so only "C" collation is valid */
+	if (OidIsValid(op->inputcollid) && !lc_collate_is_c(op->inputcollid))
+		return false;
 
-	catlist = SearchSysCacheList1(AMOPOPID, ObjectIdGetDatum(opcode));
-	for (i=0; i < catlist->n_members; i++)
-	{
-		HeapTuple	tuple = &catlist->members[i]->tuple;
-		Form_pg_amop amop = (Form_pg_amop) GETSTRUCT(tuple);
-
-		if (amop->amopmethod == BRIN_AM_OID)
-		{
-			opfamily = amop->amopfamily;
-			strategy = amop->amopstrategy;
-			break;
-		}
-	}
-	ReleaseSysCacheList(catlist);
-
+	strategy = __lookupArrowStatsStrategy(opcode, &opfamily);
 	if (strategy == BTLessStrategyNumber ||
 		strategy == BTLessEqualStrategyNumber)
 	{
@@ -1229,39 +1772,230 @@ __buildArrowStatsOper(arrowStatsHint *arange,
 	return true;
 }
 
-static arrowStatsHint *
-execInitArrowStatsHint(ScanState *ss,
-					   Bitmapset *stat_attrs,
-					   List *outer_quals)
+static bool
+__buildArrowStatsInList(arrowStatsHint *arange,
+						ScanState *ss,
+						ScalarArrayOpExpr *saop)
 {
-	Relation		relation = ss->ss_currentRelation;
-	TupleDesc		tupdesc = RelationGetDescr(relation);
-	ExprContext	   *econtext;
-	arrowStatsHint *result, temp;
-	Expr		   *eval_expr;
-	ListCell	   *lc;
+	Index		scanrelid = ((Scan *)ss->ps.plan)->scanrelid;
+	Var		   *var = linitial(saop->args);
+	Node	   *arg = lsecond(saop->args);
+	Oid			elemtype;
+	Oid			opfamily = InvalidOid;
+	Oid			opcode;
+	arrowStatsInList *ilist;
+	CatCList   *catlist;
+	int			i;
 
-	memset(&temp, 0, sizeof(arrowStatsHint));
-	temp.stat_attrs = stat_attrs;
-	foreach (lc, outer_quals)
+	/* Is it VAR = ANY(ARRAY) form? */
+	if (!saop->useOr || list_length(saop->args) != 2)
+		return false;
+	if (!IsA(var, Var) || var->varno != scanrelid)
+		return false;
+	if (!bms_is_member(var->varattno, arange->stat_attrs))
+		return false;
+	if (contain_var_clause(arg) ||
+		contain_volatile_functions(arg))
+		return false;
+	if (OidIsValid(saop->inputcollid) && !lc_collate_is_c(saop->inputcollid))
+		return false;
+	elemtype = get_base_element_type(exprType(arg));
+	if (!OidIsValid(elemtype))
+		return false;
+
+	catlist = SearchSysCacheList1(AMOPOPID, ObjectIdGetDatum(saop->opno));
+	for (i=0; i < catlist->n_members; i++)
+	{
+		HeapTuple	tuple = &catlist->members[i]->tuple;
+		Form_pg_amop amop = (Form_pg_amop) GETSTRUCT(tuple);
+
+		if (amop->amopmethod == BRIN_AM_OID &&
+			amop->amopstrategy == BTEqualStrategyNumber)
+		{
+			opfamily = amop->amopfamily;
+			break;
+		}
+	}
+	ReleaseSysCacheList(catlist);
+	if (!OidIsValid(opfamily))
+		return false;
+
+	ilist = palloc0(sizeof(arrowStatsInList));
+	ilist->attnum = var->varattno;
+	ilist->collid = saop->inputcollid;
+	ilist->array_expr = copyObject((Expr *)arg);
+	get_typlenbyvalalign(elemtype,
+						 &ilist->elem_len,
+						 &ilist->elem_byval,
+						 &ilist->elem_align);
+	opcode = get_opfamily_member(opfamily, var->vartype, elemtype,
+								 BTLessEqualStrategyNumber);
+	if (!OidIsValid(opcode))
+		return false;
+	fmgr_info(get_opcode(opcode), &ilist->le_proc);
+	opcode = get_opfamily_member(opfamily, var->vartype, elemtype,
+								 BTGreaterEqualStrategyNumber);
+	if (!OidIsValid(opcode))
+		return false;
+	fmgr_info(get_opcode(opcode), &ilist->ge_proc);
+
+	arange->in_lists = lappend(arange->in_lists, ilist);
+	arange->load_attrs = bms_add_member(arange->load_attrs,
+										var->varattno);
+	return true;
+}
+
+static bool
+__buildArrowStatsBloom(arrowStatsHint *arange,
+					   ScanState *ss,
+					   Expr *expr)
+{
+	Index		scanrelid = ((Scan *)ss->ps.plan)->scanrelid;
+	Node	   *var;
+	Node	   *arg;
+	Oid			opno;
+	Oid			collid;
+	Oid			type_oid;
+	bool		is_array = false;
+	TypeCacheEntry *tcache;
+	arrowStatsBloom *sbloom;
+
+	if (IsA(expr, OpExpr))
+	{
+		OpExpr	   *op = (OpExpr *)expr;
+
+		if (list_length(op->args) != 2)
+			return false;
+		var = linitial(op->args);
+		arg = lsecond(op->args);
+		if (IsA(var, RelabelType))
+			var = (Node *)((RelabelType *)var)->arg;
+		if (!IsA(var, Var))
+		{
+			var = lsecond(op->args);
+			arg = linitial(op->args);
+			if (IsA(var, RelabelType))
+				var = (Node *)((RelabelType *)var)->arg;
+		}
+		type_oid = exprType(arg);
+		opno = op->opno;
+		collid = op->inputcollid;
+	}
+	else if (IsA(expr, ScalarArrayOpExpr))
+	{
+		ScalarArrayOpExpr *saop = (ScalarArrayOpExpr *)expr;
+
+		if (!saop->useOr || list_length(saop->args) != 2)
+			return false;
+		var = linitial(saop->args);
+		arg = lsecond(saop->args);
+		if (IsA(var, RelabelType))
+			var = (Node *)((RelabelType *)var)->arg;
+		type_oid = get_base_element_type(exprType(arg));
+		opno = saop->opno;
+		collid = saop->inputcollid;
+		is_array = true;
+	}
+	else
+		return false;
+
+	/* Is it VAR = ARG form on the supported types? */
+	if (!IsA(var, Var) || ((Var *)var)->varno != scanrelid)
+		return false;
+	if (contain_var_clause(arg) ||
+		contain_volatile_functions(arg))
+		return false;
+	switch (type_oid)
+	{
+		case INT1OID:
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case BYTEAOID:
+			break;
+		case TEXTOID:
+#if PG_VERSION_NUM >= 120000
+			/* bloom filter is built on the bytes of values */
+			if (!OidIsValid(collid) ||
+				!get_collation_isdeterministic(collid))
+				return false;
+#endif
+			break;
+		default:
+			return false;
+	}
+	tcache = lookup_type_cache(type_oid, TYPECACHE_EQ_OPR);
+	if (tcache->eq_opr != opno)
+		return false;
+
+	sbloom = palloc0(sizeof(arrowStatsBloom));
+	sbloom->attnum = ((Var *)var)->varattno;
+	sbloom->is_array = is_array;
+	sbloom->arg_expr = copyObject((Expr *)arg);
+	get_typlenbyvalalign(type_oid,
+						 &sbloom->elem_len,
+						 &sbloom->elem_byval,
+						 &sbloom->elem_align);
+	arange->bloom_quals = lappend(arange->bloom_quals, sbloom);
+
+	return true;
+}
+
+static arrowStatsHint *
+execInitArrowStatsHint(ScanState *ss,
+					   Bitmapset *stat_attrs,
+					   List *outer_quals)
+{
+	Relation		relation = ss->ss_currentRelation;
+	TupleDesc		tupdesc = RelationGetDescr(relation);
+	ExprContext	   *econtext;
+	arrowStatsHint *result, temp;
+	Expr		   *eval_expr;
+	ListCell	   *lc;
+
+	memset(&temp, 0, sizeof(arrowStatsHint));
+	temp.stat_attrs = stat_attrs;
+	foreach (lc, outer_quals)
 	{
 		OpExpr *op = lfirst(lc);
+		bool	found = false;
 
 		if (IsA(op, OpExpr) && list_length(op->args) == 2 &&
 			(__buildArrowStatsOper(&temp, ss, op, false) ||
 			 __buildArrowStatsOper(&temp, ss, op, true)))
-		{
+			found = true;
+		else if (IsA(op, ScalarArrayOpExpr) &&
+				 __buildArrowStatsInList(&temp, ss, (ScalarArrayOpExpr *)op))
+			found = true;
+		if (__buildArrowStatsBloom(&temp, ss, (Expr *)op))
+			found = true;
+		if (found)
 			temp.orig_quals = lappend(temp.orig_quals, copyObject(op));
-		}
 	}
 	if (!temp.orig_quals)
 		return NULL;
 
-	Assert(list_length(temp.eval_quals) > 0);
-	if (list_length(temp.eval_quals) == 1)
+	Assert(list_length(temp.eval_quals) > 0 ||
+		   temp.in_lists != NIL ||
+		   temp.bloom_quals != NIL);
+	if (list_length(temp.eval_quals) == 0)
+		eval_expr = NULL;
+	else if (list_length(temp.eval_quals) == 1)
 		eval_expr = linitial(temp.eval_quals);
 	else
 		eval_expr = make_andclause(temp.eval_quals);
+	foreach (lc, temp.in_lists)
+	{
+		arrowStatsInList *ilist = lfirst(lc);
+
+		ilist->array_state = ExecInitExpr(ilist->array_expr, &ss->ps);
+	}
+	foreach (lc, temp.bloom_quals)
+	{
+		arrowStatsBloom *sbloom = lfirst(lc);
+
+		sbloom->arg_state = ExecInitExpr(sbloom->arg_expr, &ss->ps);
+	}
 
 	econtext = CreateExprContext(ss->ps.state);
 	econtext->ecxt_innertuple = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
@@ -1270,10 +2004,16 @@ execInitArrowStatsHint(ScanState *ss,
 	result = palloc0(sizeof(arrowStatsHint));
 	result->orig_quals = temp.orig_quals;
 	result->eval_quals = temp.eval_quals;
-	result->eval_state = ExecInitExpr(eval_expr, &ss->ps);
+	result->eval_state = (eval_expr ? ExecInitExpr(eval_expr, &ss->ps) : NULL);
 	result->stat_attrs = bms_copy(stat_attrs);
 	result->load_attrs = temp.load_attrs;
+	result->in_lists   = temp.in_lists;
+	result->bloom_quals = temp.bloom_quals;
 	result->econtext   = econtext;
+	if (temp.bloom_quals != NIL)
+		result->bloom_mcxt = AllocSetContextCreate(CurrentMemoryContext,
+												   "arrow_fdw bloom filters",
+												   ALLOCSET_DEFAULT_SIZES);
 
 	return result;
 }
@@ -1375,6 +2115,20 @@ __fetchArrowStatsDatum(RecordBatchFieldState *fstate,
 					return false;
 			}
 			break;
+		case TEXTOID:
+		case BYTEAOID:
+			{
+				int			len = sval->str.len;
+				char	   *result;
+
+				Assert(len <= SQLSTAT_STRING_PREFIX_LEN);
+				result = palloc(VARHDRSZ + len);
+				SET_VARSIZE(result, VARHDRSZ + len);
+				memcpy(VARDATA(result), sval->str.data, len);
+
+				datum = PointerGetDatum(result);
+			}
+			break;
 		default:
 			return false;
 	}
@@ -1383,6 +2137,230 @@ __fetchArrowStatsDatum(RecordBatchFieldState *fstate,
 	return true;
 }
 
+static bool
+__execCheckArrowStatsInList(arrowStatsInList *ilist,
+							ExprContext *econtext,
+							Datum min_datum,
+							Datum max_datum)
+{
+	MemoryContext oldcxt;
+	ArrayType  *array;
+	Datum		datum;
+	Datum	   *elem_values;
+	bool	   *elem_isnull;
+	int			i, nitems;
+	bool		isnull;
+	bool		retval = false;
+
+	datum = ExecEvalExprSwitchContext(ilist->array_state, econtext, &isnull);
+	if (isnull)
+		return false;
+	oldcxt = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+	array = DatumGetArrayTypeP(datum);
+	deconstruct_array(array,
+					  ARR_ELEMTYPE(array),
+					  ilist->elem_len,
+					  ilist->elem_byval,
+					  ilist->elem_align,
+					  &elem_values,
+					  &elem_isnull,
+					  &nitems);
+	for (i=0; i < nitems; i++)
+	{
+		if (elem_isnull[i])
+			continue;
+		if (DatumGetBool(FunctionCall2Coll(&ilist->le_proc,
+										   ilist->collid,
+										   min_datum,
+										   elem_values[i])) &&
+			DatumGetBool(FunctionCall2Coll(&ilist->ge_proc,
+										   ilist->collid,
+										   max_datum,
+										   elem_values[i])))
+		{
+			retval = true;
+			break;
+		}
+	}
+	MemoryContextSwitchTo(oldcxt);
+
+	return retval;
+}
+
+/*
+ * __fetchArrowStatsBloom
+ *
+ * It returns the bloom filter of the record-batch, if any. The footer of the
+ * Arrow file is re-read on demand, because bitmaps are too large to keep
+ * them on the metadata cache.
+ */
+static SQLbloom *
+__fetchArrowStatsBloom(arrowStatsHint *stats_hint,
+					   RecordBatchState *rb_state,
+					   AttrNumber anum)
+{
+	SQLbloom  **filters;
+
+	if (!stats_hint->bloom_filters ||
+		stats_hint->bloom_st_dev  != rb_state->stat_buf.st_dev ||
+		stats_hint->bloom_st_ino  != rb_state->stat_buf.st_ino ||
+		stats_hint->bloom_st_size != rb_state->stat_buf.st_size)
+	{
+		MemoryContext oldcxt;
+		ArrowFileInfo af_info;
+
+		MemoryContextReset(stats_hint->bloom_mcxt);
+		stats_hint->bloom_filters = NULL;
+
+		oldcxt = MemoryContextSwitchTo(stats_hint->bloom_mcxt);
+		readArrowFileDesc(FileGetRawDesc(rb_state->fdesc), &af_info);
+		stats_hint->bloom_nrooms = af_info.footer._num_recordBatches;
+		stats_hint->bloom_ncols  = af_info.footer.schema._num_fields;
+		stats_hint->bloom_fields = af_info.footer.schema.fields;
+		stats_hint->bloom_filters = palloc0(sizeof(SQLbloom **) *
+											stats_hint->bloom_ncols);
+		MemoryContextSwitchTo(oldcxt);
+
+		stats_hint->bloom_st_dev  = rb_state->stat_buf.st_dev;
+		stats_hint->bloom_st_ino  = rb_state->stat_buf.st_ino;
+		stats_hint->bloom_st_size = rb_state->stat_buf.st_size;
+	}
+	if (anum < 1 || anum > stats_hint->bloom_ncols ||
+		rb_state->rb_index >= stats_hint->bloom_nrooms)
+		return NULL;
+
+	filters = stats_hint->bloom_filters[anum-1];
+	if (!filters)
+	{
+		MemoryContext oldcxt;
+		SQLbloom   *bloom_list;
+
+		oldcxt = MemoryContextSwitchTo(stats_hint->bloom_mcxt);
+		filters = palloc0(sizeof(SQLbloom *) * stats_hint->bloom_nrooms);
+		bloom_list = __buildArrowFieldBloomList(&stats_hint->bloom_fields[anum-1],
+												stats_hint->bloom_nrooms);
+		while (bloom_list)
+		{
+			filters[bloom_list->rb_index] = bloom_list;
+			bloom_list = bloom_list->next;
+		}
+		stats_hint->bloom_filters[anum-1] = filters;
+		MemoryContextSwitchTo(oldcxt);
+	}
+	return filters[rb_state->rb_index];
+}
+
+/*
+ * __checkArrowBloomDatum
+ *
+ * It returns false, if the datum is never contained in the record-batch.
+ */
+static bool
+__checkArrowBloomDatum(SQLbloom *bloom,
+					   RecordBatchFieldState *fstate,
+					   Datum datum)
+{
+	uint64		hash;
+
+	switch (fstate->atttypid)
+	{
+		case INT1OID:
+			{
+				int8	ival = (int8)DatumGetChar(datum);
+
+				hash = sql_bloom_hash(&ival, sizeof(int8));
+			}
+			break;
+		case INT2OID:
+			{
+				int16	ival = DatumGetInt16(datum);
+
+				hash = sql_bloom_hash(&ival, sizeof(int16));
+			}
+			break;
+		case INT4OID:
+			{
+				int32	ival = DatumGetInt32(datum);
+
+				hash = sql_bloom_hash(&ival, sizeof(int32));
+			}
+			break;
+		case INT8OID:
+			{
+				int64	ival = DatumGetInt64(datum);
+
+				hash = sql_bloom_hash(&ival, sizeof(int64));
+			}
+			break;
+		case TEXTOID:
+		case BYTEAOID:
+			{
+				struct varlena *vl = PG_DETOAST_DATUM_PACKED(datum);
+
+				hash = sql_bloom_hash(VARDATA_ANY(vl), VARSIZE_ANY_EXHDR(vl));
+			}
+			break;
+		default:
+			return true;	/* unable to determine */
+	}
+	return sql_bloom_check(bloom->bitmap, bloom->nbits, bloom->nhash, hash);
+}
+
+static bool
+__execCheckArrowStatsBloom(arrowStatsHint *stats_hint,
+						   arrowStatsBloom *sbloom,
+						   RecordBatchState *rb_state)
+{
+	ExprContext	   *econtext = stats_hint->econtext;
+	RecordBatchFieldState *fstate;
+	SQLbloom	   *bloom;
+	MemoryContext	oldcxt;
+	ArrayType	   *array;
+	Datum			datum;
+	Datum		   *elem_values;
+	bool		   *elem_isnull;
+	int				i, nitems;
+	bool			isnull;
+	bool			retval = false;
+
+	Assert(sbloom->attnum > 0 && sbloom->attnum <= rb_state->ncols);
+	fstate = &rb_state->columns[sbloom->attnum-1];
+	if (!fstate->stat_bloom)
+		return true;
+	bloom = __fetchArrowStatsBloom(stats_hint, rb_state, sbloom->attnum);
+	if (!bloom)
+		return true;
+
+	datum = ExecEvalExprSwitchContext(sbloom->arg_state, econtext, &isnull);
+	if (isnull)
+		return false;
+	if (!sbloom->is_array)
+		return __checkArrowBloomDatum(bloom, fstate, datum);
+
+	oldcxt = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+	array = DatumGetArrayTypeP(datum);
+	deconstruct_array(array,
+					  ARR_ELEMTYPE(array),
+					  sbloom->elem_len,
+					  sbloom->elem_byval,
+					  sbloom->elem_align,
+					  &elem_values,
+					  &elem_isnull,
+					  &nitems);
+	for (i=0; i < nitems; i++)
+	{
+		if (!elem_isnull[i] &&
+			__checkArrowBloomDatum(bloom, fstate, elem_values[i]))
+		{
+			retval = true;
+			break;
+		}
+	}
+	MemoryContextSwitchTo(oldcxt);
+
+	return retval;
+}
+
 static bool
 execCheckArrowStatsHint(arrowStatsHint *stats_hint,
 						RecordBatchState *rb_state)
@@ -1393,6 +2371,7 @@ execCheckArrowStatsHint(arrowStatsHint *stats_hint,
 	int				anum;
 	Datum			datum;
 	bool			isnull;
+	ListCell	   *lc;
 
 	/* load the min/max statistics */
 	ExecStoreAllNullTuple(min_values);
@@ -1421,13 +2400,32 @@ execCheckArrowStatsHint(arrowStatsHint *stats_hint,
 									&max_values->tts_isnull[anum-1]))
 			return false;
 	}
-	datum = ExecEvalExprSwitchContext(stats_hint->eval_state, econtext, &isnull);
+	foreach (lc, stats_hint->in_lists)
+	{
+		arrowStatsInList *ilist = lfirst(lc);
+		int			k = ilist->attnum - 1;
 
-//	elog(INFO, "file [%s] rb_index=%u datum=%lu isnull=%d",
-//		 FilePathName(rb_state->fdesc), rb_state->rb_index, datum, (int)isnull);
-	if (!isnull && DatumGetBool(datum))
-		return true;
-	return false;
+		if (!__execCheckArrowStatsInList(ilist, econtext,
+										 min_values->tts_values[k],
+										 max_values->tts_values[k]))
+			return false;
+	}
+	if (stats_hint->eval_state)
+	{
+		datum = ExecEvalExprSwitchContext(stats_hint->eval_state,
+										  econtext, &isnull);
+//		elog(INFO, "file [%s] rb_index=%u datum=%lu isnull=%d",
+//			 FilePathName(rb_state->fdesc), rb_state->rb_index, datum, (int)isnull);
+		if (isnull || !DatumGetBool(datum))
+			return false;
+	}
+	/* bloom filters are checked last, because it may read the footer */
+	foreach (lc, stats_hint->bloom_quals)
+	{
+		if (!__execCheckArrowStatsBloom(stats_hint, lfirst(lc), rb_state))
+			return false;
+	}
+	return true;
 }
 
 static void
@@ -1441,26 +2439,1016 @@ execEndArrowStatsHint(arrowStatsHint *stats_hint)
 	econtext->ecxt_outertuple = NULL;
 
 	FreeExprContext(econtext, true);
+	if (stats_hint->bloom_mcxt)
+		MemoryContextDelete(stats_hint->bloom_mcxt);
 }
 
 /*
- * Routines to setup record-batches
+ * ExecInitArrowStatsAgg / execAccumArrowStatsAgg / ExecFetchArrowStatsAgg
+ *
+ * ... are executor routines to answer the aggregation (MIN/MAX/COUNT) by
+ * the min/max statistics and the number of rows/nulls per record batch.
+ * If the statistics prove that all the rows in a record batch satisfy the
+ * scan quals, the record batch is aggregated without loading; only the
+ * record batches on the boundary of the quals are loaded and scanned.
  */
-typedef struct
+static bool
+__arrowStatsAggTypeIsExact(Oid type_oid)
 {
-	ArrowBuffer    *buffer_curr;
-	ArrowBuffer    *buffer_tail;
-	ArrowFieldNode *fnode_curr;
-	ArrowFieldNode *fnode_tail;
-} setupRecordBatchContext;
+	/*
+	 * min/max of floating-point may not follow the ordering of NaN by
+	 * PostgreSQL, and the ones of text/bytea are truncated prefixes.
+	 */
+	switch (type_oid)
+	{
+		case INT1OID:
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case DATEOID:
+		case TIMEOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
 
-static void
-assignArrowTypeOptions(ArrowTypeOptions *attopts, const ArrowType *atype)
+static bool
+__buildArrowStatsAggQual(ScanState *ss,
+						 Bitmapset *stat_attrs,
+						 OpExpr *op,
+						 bool reverse,
+						 List **p_full_quals,
+						 Bitmapset **p_qual_attrs)
 {
-	memset(attopts, 0, sizeof(ArrowTypeOptions));
-	switch (atype->node.tag)
-	{
-		case ArrowNodeTag__Decimal:
+	Index		scanrelid = ((Scan *)ss->ps.plan)->scanrelid;
+	Oid			opcode;
+	Var		   *var;
+	Node	   *arg;
+	Oid			opfamily = InvalidOid;
+	StrategyNumber strategy;
+	List	   *vnodes = NIL;
+	ListCell   *lc;
+
+	if (!reverse)
+	{
+		opcode = op->opno;
+		var = linitial(op->args);
+		arg = lsecond(op->args);
+	}
+	else
+	{
+		opcode = get_commutator(op->opno);
+		var = lsecond(op->args);
+		arg = linitial(op->args);
+	}
+	/* Is it VAR <OPER> ARG form? */
+	if (!IsA(var, Var) || var->varno != scanrelid)
+		return false;
+	if (!bms_is_member(var->varattno, stat_attrs) ||
+		!__arrowStatsAggTypeIsExact(var->vartype))
+		return false;
+	if (contain_var_clause(arg) ||
+		contain_volatile_functions(arg))
+		return false;
+
+	strategy = __lookupArrowStatsStrategy(opcode, &opfamily);
+	if (strategy == BTLessStrategyNumber ||
+		strategy == BTLessEqualStrategyNumber)
+	{
+		/* (VAR < ARG) --> (Max < ARG) */
+		/* (VAR <= ARG) --> (Max <= ARG) */
+		vnodes = list_make1_int(OUTER_VAR);
+	}
+	else if (strategy == BTGreaterEqualStrategyNumber ||
+			 strategy == BTGreaterStrategyNumber)
+	{
+		/* (VAR >= ARG) --> (Min >= ARG) */
+		/* (VAR > ARG) --> (Min > ARG) */
+		vnodes = list_make1_int(INNER_VAR);
+	}
+	else if (strategy == BTEqualStrategyNumber)
+	{
+		/* (VAR = ARG) --> (Min = ARG && Max = ARG) */
+		vnodes = list_make2_int(INNER_VAR, OUTER_VAR);
+	}
+	else
+		return false;
+
+	foreach (lc, vnodes)
+	{
+		Expr   *expr;
+
+		expr = make_opclause(opcode,
+							 op->opresulttype,
+							 op->opretset,
+							 (Expr *)makeVar(lfirst_int(lc),
+											 var->varattno,
+											 var->vartype,
+											 var->vartypmod,
+											 var->varcollid,
+											 0),
+							 (Expr *)copyObject(arg),
+							 op->opcollid,
+							 op->inputcollid);
+		set_opfuncid((OpExpr *)expr);
+		*p_full_quals = lappend(*p_full_quals, expr);
+	}
+	*p_qual_attrs = bms_add_member(*p_qual_attrs, var->varattno);
+	return true;
+}
+
+bool
+ExecInitArrowStatsAgg(ArrowFdwState *af_state,
+					  ScanState *ss,
+					  List *outer_quals,
+					  List *agg_kinds,
+					  List *agg_attnums)
+{
+	Relation		relation = ss->ss_currentRelation;
+	TupleDesc		tupdesc = RelationGetDescr(relation);
+	arrowStatsAgg  *stats_agg;
+	List		   *full_quals = NIL;
+	Bitmapset	   *qual_attrs = NULL;
+	ExprContext	   *econtext;
+	Expr		   *full_expr;
+	ListCell	   *lc1, *lc2;
+	int				i, nitems = list_length(agg_kinds);
+
+	Assert(nitems == list_length(agg_attnums));
+	if (!arrow_fdw_stats_aggregate_enabled || nitems == 0)
+		return false;
+	/* all the quals must be checked by the statistics */
+	foreach (lc1, outer_quals)
+	{
+		OpExpr *op = lfirst(lc1);
+
+		if (!IsA(op, OpExpr) || list_length(op->args) != 2)
+			return false;
+		if (!__buildArrowStatsAggQual(ss, af_state->stat_attrs, op, false,
+									  &full_quals, &qual_attrs) &&
+			!__buildArrowStatsAggQual(ss, af_state->stat_attrs, op, true,
+									  &full_quals, &qual_attrs))
+			return false;
+	}
+	/* all the aggregations must be answered by the statistics */
+	forboth (lc1, agg_kinds,
+			 lc2, agg_attnums)
+	{
+		int			kind = lfirst_int(lc1);
+		AttrNumber	attnum = lfirst_int(lc2);
+
+		if (attnum < 0 || attnum > tupdesc->natts)
+			return false;
+		if (kind == ARROW_STATS_AGG__MIN || kind == ARROW_STATS_AGG__MAX)
+		{
+			if (attnum == 0 ||
+				!bms_is_member(attnum, af_state->stat_attrs) ||
+				!__arrowStatsAggTypeIsExact(tupleDescAttr(tupdesc,
+														  attnum-1)->atttypid))
+				return false;
+		}
+		else if (kind != ARROW_STATS_AGG__NROWS)
+			return false;
+	}
+
+	stats_agg = palloc0(offsetof(arrowStatsAgg, items[nitems]));
+	i = 0;
+	forboth (lc1, agg_kinds,
+			 lc2, agg_attnums)
+	{
+		arrowStatsAggItem *item = &stats_agg->items[i++];
+
+		item->kind = lfirst_int(lc1);
+		item->attnum = lfirst_int(lc2);
+		if (item->kind != ARROW_STATS_AGG__NROWS)
+		{
+			Form_pg_attribute attr = tupleDescAttr(tupdesc, item->attnum-1);
+			TypeCacheEntry *tcache;
+
+			tcache = lookup_type_cache(attr->atttypid,
+									   TYPECACHE_CMP_PROC_FINFO);
+			if (!OidIsValid(tcache->cmp_proc_finfo.fn_oid))
+				return false;
+			fmgr_info_copy(&item->cmp_proc, &tcache->cmp_proc_finfo,
+						   CurrentMemoryContext);
+		}
+		item->isnull = true;
+	}
+	stats_agg->nitems = nitems;
+
+	if (full_quals == NIL)
+		full_expr = NULL;
+	else if (list_length(full_quals) == 1)
+		full_expr = linitial(full_quals);
+	else
+		full_expr = make_andclause(full_quals);
+	stats_agg->full_state = (full_expr ? ExecInitExpr(full_expr, &ss->ps) : NULL);
+	stats_agg->qual_attrs = qual_attrs;
+
+	econtext = CreateExprContext(ss->ps.state);
+	econtext->ecxt_innertuple = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+	econtext->ecxt_outertuple = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+	stats_agg->econtext = econtext;
+
+	af_state->stats_agg = stats_agg;
+
+	return true;
+}
+
+static bool
+execAccumArrowStatsAgg(arrowStatsAgg *stats_agg,
+					   RecordBatchState *rb_state)
+{
+	ExprContext	   *econtext = stats_agg->econtext;
+	TupleTableSlot *min_values = econtext->ecxt_innertuple;
+	TupleTableSlot *max_values = econtext->ecxt_outertuple;
+	RecordBatchFieldState *fstate;
+	Datum			datum;
+	bool			isnull;
+	int				i, anum;
+
+	/* NULLs of the parquet row-group are not known prior to the load */
+	if (rb_state->rb_parquet)
+		return false;
+
+	/* checks whether all the rows satisfy the quals */
+	ExecStoreAllNullTuple(min_values);
+	ExecStoreAllNullTuple(max_values);
+	for (anum = bms_next_member(stats_agg->qual_attrs, -1);
+		 anum >= 0;
+		 anum = bms_next_member(stats_agg->qual_attrs, anum))
+	{
+		Assert(anum > 0 && anum <= rb_state->ncols);
+		fstate = &rb_state->columns[anum-1];
+		if (fstate->part_column ||
+			fstate->stat_isnull ||
+			fstate->null_count > 0)
+			return false;
+		if (!__fetchArrowStatsDatum(fstate, &fstate->stat_min,
+									&min_values->tts_values[anum-1],
+									&min_values->tts_isnull[anum-1]) ||
+			!__fetchArrowStatsDatum(fstate, &fstate->stat_max,
+									&max_values->tts_values[anum-1],
+									&max_values->tts_isnull[anum-1]))
+			return false;
+	}
+	if (stats_agg->full_state)
+	{
+		datum = ExecEvalExprSwitchContext(stats_agg->full_state,
+										  econtext, &isnull);
+		if (isnull || !DatumGetBool(datum))
+			return false;
+	}
+	/* checks whether the statistics of the aggregated columns are valid */
+	for (i=0; i < stats_agg->nitems; i++)
+	{
+		arrowStatsAggItem *item = &stats_agg->items[i];
+
+		if (item->attnum == 0)
+			continue;
+		fstate = &rb_state->columns[item->attnum-1];
+		if (fstate->part_column)
+			return false;
+		if (item->kind != ARROW_STATS_AGG__NROWS &&
+			fstate->null_count < fstate->nitems &&
+			fstate->stat_isnull)
+			return false;
+	}
+
+	/* OK, aggregates the record-batch by the statistics */
+	for (i=0; i < stats_agg->nitems; i++)
+	{
+		arrowStatsAggItem *item = &stats_agg->items[i];
+
+		if (item->kind == ARROW_STATS_AGG__NROWS)
+		{
+			if (item->attnum == 0)
+				item->nitems += rb_state->rb_nitems;
+			else
+			{
+				fstate = &rb_state->columns[item->attnum-1];
+				item->nitems += (fstate->nitems - fstate->null_count);
+			}
+			continue;
+		}
+		fstate = &rb_state->columns[item->attnum-1];
+		if (fstate->null_count >= fstate->nitems)
+			continue;	/* all NULLs */
+		if (!__fetchArrowStatsDatum(fstate,
+									item->kind == ARROW_STATS_AGG__MIN
+									? &fstate->stat_min
+									: &fstate->stat_max,
+									&datum, &isnull))
+			elog(ERROR, "arrow_fdw: min/max statistics are not available");
+		if (item->isnull)
+		{
+			item->value = datum;
+			item->isnull = false;
+		}
+		else
+		{
+			int		comp = DatumGetInt32(FunctionCall2(&item->cmp_proc,
+													   datum,
+													   item->value));
+			if (item->kind == ARROW_STATS_AGG__MIN ? comp < 0 : comp > 0)
+				item->value = datum;
+		}
+	}
+	stats_agg->nbatches++;
+
+	return true;
+}
+
+bool
+ExecFetchArrowStatsAgg(ArrowFdwState *af_state, Datum *values, bool *isnull)
+{
+	arrowStatsAgg  *stats_agg = af_state->stats_agg;
+	int				i;
+
+	if (!stats_agg || stats_agg->nbatches == 0)
+		return false;
+	for (i=0; i < stats_agg->nitems; i++)
+	{
+		arrowStatsAggItem *item = &stats_agg->items[i];
+
+		if (item->kind == ARROW_STATS_AGG__NROWS)
+		{
+			values[i] = Int64GetDatum(item->nitems);
+			isnull[i] = false;
+		}
+		else
+		{
+			values[i] = item->value;
+			isnull[i] = item->isnull;
+		}
+	}
+	return true;
+}
+
+static void
+execResetArrowStatsAgg(arrowStatsAgg *stats_agg)
+{
+	int		i;
+
+	for (i=0; i < stats_agg->nitems; i++)
+	{
+		arrowStatsAggItem *item = &stats_agg->items[i];
+
+		item->value = 0;
+		item->isnull = true;
+		item->nitems = 0;
+	}
+	stats_agg->nbatches = 0;
+}
+
+static void
+execEndArrowStatsAgg(arrowStatsAgg *stats_agg)
+{
+	ExprContext	   *econtext = stats_agg->econtext;
+
+	ExecDropSingleTupleTableSlot(econtext->ecxt_innertuple);
+	ExecDropSingleTupleTableSlot(econtext->ecxt_outertuple);
+	econtext->ecxt_innertuple = NULL;
+	econtext->ecxt_outertuple = NULL;
+
+	FreeExprContext(econtext, true);
+}
+
+/*
+ * execInitArrowVecFilter / execArrowVecFilter / execEndArrowVecFilter
+ *
+ * ... are executor routines for the vectorized filter on CPU scan.
+ * Simple qualifiers on the fixed-width columns (comparison, BETWEEN,
+ * IN-list and NULL-test) are evaluated over the column arrays of the
+ * RecordBatch, to build a selection vector prior to the tuple formation.
+ * The qualifiers are still rechecked by the executor, so the filter only
+ * drops rows that never satisfy them.
+ */
+static bool
+__arrowVecFilterTypeIsSupported(Oid type_oid, bool *p_is_integer)
+{
+	switch (type_oid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+			*p_is_integer = true;
+			return true;
+		case FLOAT4OID:
+		case FLOAT8OID:
+			*p_is_integer = false;
+			return true;
+		default:
+			return false;
+	}
+}
+
+static StrategyNumber
+__lookupArrowVecStrategy(Oid opcode, Oid lefttype, Oid righttype)
+{
+	StrategyNumber strategy = InvalidStrategy;
+	CatCList   *catlist;
+	int			i;
+
+	catlist = SearchSysCacheList1(AMOPOPID, ObjectIdGetDatum(opcode));
+	for (i=0; i < catlist->n_members; i++)
+	{
+		HeapTuple	tuple = &catlist->members[i]->tuple;
+		Form_pg_amop amop = (Form_pg_amop) GETSTRUCT(tuple);
+
+		if (amop->amopmethod == BTREE_AM_OID &&
+			amop->amoplefttype == lefttype &&
+			amop->amoprighttype == righttype)
+		{
+			strategy = amop->amopstrategy;
+			break;
+		}
+	}
+	ReleaseSysCacheList(catlist);
+
+	return strategy;
+}
+
+static bool
+__checkArrowVecVar(ScanState *ss, Node *node, bool *p_is_integer)
+{
+	Index		scanrelid = ((Scan *)ss->ps.plan)->scanrelid;
+	Var		   *var = (Var *)node;
+
+	if (!IsA(var, Var) ||
+		var->varno != scanrelid ||
+		var->varlevelsup != 0 ||
+		var->varattno <= 0)
+		return false;
+	return __arrowVecFilterTypeIsSupported(var->vartype, p_is_integer);
+}
+
+static bool
+__checkArrowVecArg(Node *arg, Oid arg_type, bool is_integer)
+{
+	bool		__is_integer;
+
+	if (!__arrowVecFilterTypeIsSupported(arg_type, &__is_integer) ||
+		__is_integer != is_integer)
+		return false;
+	if (contain_var_clause(arg) ||
+		contain_volatile_functions(arg))
+		return false;
+	return true;
+}
+
+static arrowVecQual *
+__buildArrowVecOper(ScanState *ss, OpExpr *op)
+{
+	Var		   *var;
+	Node	   *arg;
+	Oid			arg_type;
+	bool		is_integer;
+	StrategyNumber strategy;
+	arrowVecQual *vqual;
+
+	if (list_length(op->args) != 2)
+		return NULL;
+	var = linitial(op->args);
+	arg = lsecond(op->args);
+	if (__checkArrowVecVar(ss, (Node *)var, &is_integer))
+	{
+		/* VAR <OPER> ARG */
+		arg_type = exprType(arg);
+		if (!__checkArrowVecArg(arg, arg_type, is_integer))
+			return NULL;
+		strategy = __lookupArrowVecStrategy(op->opno, var->vartype, arg_type);
+	}
+	else
+	{
+		/* ARG <OPER> VAR */
+		var = lsecond(op->args);
+		arg = linitial(op->args);
+		if (!__checkArrowVecVar(ss, (Node *)var, &is_integer))
+			return NULL;
+		arg_type = exprType(arg);
+		if (!__checkArrowVecArg(arg, arg_type, is_integer))
+			return NULL;
+		strategy = __lookupArrowVecStrategy(op->opno, arg_type, var->vartype);
+		switch (strategy)
+		{
+			case BTLessStrategyNumber:
+				strategy = BTGreaterStrategyNumber;
+				break;
+			case BTLessEqualStrategyNumber:
+				strategy = BTGreaterEqualStrategyNumber;
+				break;
+			case BTGreaterEqualStrategyNumber:
+				strategy = BTLessEqualStrategyNumber;
+				break;
+			case BTGreaterStrategyNumber:
+				strategy = BTLessStrategyNumber;
+				break;
+			default:
+				break;
+		}
+	}
+	if (strategy < BTLessStrategyNumber ||
+		strategy > BTGreaterStrategyNumber)
+		return NULL;
+
+	vqual = palloc0(sizeof(arrowVecQual));
+	vqual->kind     = ARROW_VEC_QUAL__OPER;
+	vqual->attnum   = var->varattno;
+	vqual->atttypid = var->vartype;
+	vqual->strategy = strategy;
+	vqual->arg_type = arg_type;
+	vqual->arg_expr = copyObject((Expr *)arg);
+	return vqual;
+}
+
+static arrowVecQual *
+__buildArrowVecInList(ScanState *ss, ScalarArrayOpExpr *saop)
+{
+	Var		   *var;
+	Node	   *arg;
+	Oid			elemtype;
+	bool		is_integer;
+	arrowVecQual *vqual;
+
+	/* Is it VAR = ANY(ARRAY) form? */
+	if (!saop->useOr || list_length(saop->args) != 2)
+		return NULL;
+	var = linitial(saop->args);
+	arg = lsecond(saop->args);
+	if (!__checkArrowVecVar(ss, (Node *)var, &is_integer))
+		return NULL;
+	elemtype = get_base_element_type(exprType(arg));
+	if (!OidIsValid(elemtype) ||
+		!__checkArrowVecArg(arg, elemtype, is_integer))
+		return NULL;
+	if (__lookupArrowVecStrategy(saop->opno,
+								 var->vartype,
+								 elemtype) != BTEqualStrategyNumber)
+		return NULL;
+
+	vqual = palloc0(sizeof(arrowVecQual));
+	vqual->kind     = ARROW_VEC_QUAL__INLIST;
+	vqual->attnum   = var->varattno;
+	vqual->atttypid = var->vartype;
+	vqual->arg_type = elemtype;
+	vqual->arg_expr = copyObject((Expr *)arg);
+	return vqual;
+}
+
+static arrowVecQual *
+__buildArrowVecNullTest(ScanState *ss, NullTest *nulltest)
+{
+	Index		scanrelid = ((Scan *)ss->ps.plan)->scanrelid;
+	Var		   *var = (Var *)nulltest->arg;
+	arrowVecQual *vqual;
+
+	if (nulltest->argisrow ||
+		!IsA(var, Var) ||
+		var->varno != scanrelid ||
+		var->varlevelsup != 0 ||
+		var->varattno <= 0)
+		return NULL;
+
+	vqual = palloc0(sizeof(arrowVecQual));
+	vqual->kind     = ARROW_VEC_QUAL__NULLTEST;
+	vqual->attnum   = var->varattno;
+	vqual->atttypid = var->vartype;
+	vqual->is_null  = (nulltest->nulltesttype == IS_NULL);
+	return vqual;
+}
+
+static arrowVecFilter *
+execInitArrowVecFilter(ScanState *ss, List *outer_quals)
+{
+	arrowVecFilter *vfilter;
+	List	   *orig_quals = NIL;
+	List	   *vec_quals = NIL;
+	ListCell   *lc;
+
+	foreach (lc, outer_quals)
+	{
+		Node	   *qual = lfirst(lc);
+		arrowVecQual *vqual = NULL;
+
+		if (IsA(qual, OpExpr))
+			vqual = __buildArrowVecOper(ss, (OpExpr *)qual);
+		else if (IsA(qual, ScalarArrayOpExpr))
+			vqual = __buildArrowVecInList(ss, (ScalarArrayOpExpr *)qual);
+		else if (IsA(qual, NullTest))
+			vqual = __buildArrowVecNullTest(ss, (NullTest *)qual);
+		if (!vqual)
+			continue;
+		if (vqual->arg_expr)
+			vqual->arg_state = ExecInitExpr(vqual->arg_expr, &ss->ps);
+		vec_quals = lappend(vec_quals, vqual);
+		orig_quals = lappend(orig_quals, copyObject(qual));
+	}
+	if (vec_quals == NIL)
+		return NULL;
+
+	vfilter = palloc0(sizeof(arrowVecFilter));
+	vfilter->orig_quals = orig_quals;
+	vfilter->vec_quals  = vec_quals;
+	vfilter->econtext   = CreateExprContext(ss->ps.state);
+	vfilter->mcontext   = CurrentMemoryContext;
+
+	return vfilter;
+}
+
+/*
+ * The loops below have no branches and no dependency between the rows,
+ * so compiler can vectorize them with SIMD instructions. The argument is
+ * narrowed to the width of the column, if possible, not to widen the
+ * column values in the loop.
+ */
+#define __VEC_FILTER_LOOP(DEST,OPER,TYPE,EXPR)				\
+	do {													\
+		const TYPE *__values = (const TYPE *)values;		\
+															\
+		for (i=0; i < nitems; i++)							\
+		{													\
+			TYPE	x = __values[i];						\
+															\
+			(DEST)[i] OPER (EXPR);							\
+		}													\
+	} while(0)
+
+#define __VEC_FILTER_COMPARE(TYPE,CVAL,NAN_CHECK)						\
+	do {																\
+		switch (strategy)												\
+		{																\
+			case BTLessStrategyNumber:									\
+				__VEC_FILTER_LOOP(mask, &=, TYPE, x < (CVAL));			\
+				break;													\
+			case BTLessEqualStrategyNumber:								\
+				__VEC_FILTER_LOOP(mask, &=, TYPE, x <= (CVAL));			\
+				break;													\
+			case BTEqualStrategyNumber:									\
+				__VEC_FILTER_LOOP(mask, &=, TYPE, x == (CVAL));			\
+				break;													\
+			case BTGreaterEqualStrategyNumber:							\
+				__VEC_FILTER_LOOP(mask, &=, TYPE, (x >= (CVAL)) | NAN_CHECK); \
+				break;													\
+			case BTGreaterStrategyNumber:								\
+				__VEC_FILTER_LOOP(mask, &=, TYPE, (x > (CVAL)) | NAN_CHECK); \
+				break;													\
+			default:													\
+				elog(ERROR, "Bug? unexpected strategy: %d", strategy);	\
+		}																\
+	} while(0)
+
+/*
+ * argument out of the range of column type, so results are uniform
+ */
+static void
+__execArrowVecCompareOutOfRange(uint8 *mask, uint32 nitems,
+								StrategyNumber strategy, bool overflow)
+{
+	bool		result;
+
+	if (overflow)
+		result = (strategy == BTLessStrategyNumber ||
+				  strategy == BTLessEqualStrategyNumber);
+	else
+		result = (strategy == BTGreaterEqualStrategyNumber ||
+				  strategy == BTGreaterStrategyNumber);
+	if (!result)
+		memset(mask, 0, nitems);
+}
+
+static void
+__execArrowVecCompareInt(uint8 *mask, const void *values, uint32 nitems,
+						 Oid atttypid, StrategyNumber strategy, int64 cval)
+{
+	uint32		i;
+
+	switch (atttypid)
+	{
+		case INT2OID:
+			if (cval < SHRT_MIN || cval > SHRT_MAX)
+				__execArrowVecCompareOutOfRange(mask, nitems, strategy,
+												cval > SHRT_MAX);
+			else
+				__VEC_FILTER_COMPARE(int16, (int16)cval, 0);
+			break;
+		case INT4OID:
+			if (cval < INT_MIN || cval > INT_MAX)
+				__execArrowVecCompareOutOfRange(mask, nitems, strategy,
+												cval > INT_MAX);
+			else
+				__VEC_FILTER_COMPARE(int32, (int32)cval, 0);
+			break;
+		case INT8OID:
+			__VEC_FILTER_COMPARE(int64, cval, 0);
+			break;
+		default:
+			elog(ERROR, "Bug? unexpected type: %u", atttypid);
+	}
+}
+
+/*
+ * NOTE: PostgreSQL considers NaN is larger than any other values, and NaN
+ * equals to NaN, unlike IEEE754. The caller never gives NaN as 'cval'.
+ */
+static void
+__execArrowVecCompareFloat(uint8 *mask, const void *values, uint32 nitems,
+						   Oid atttypid, StrategyNumber strategy, double cval)
+{
+	uint32		i;
+
+	switch (atttypid)
+	{
+		case FLOAT4OID:
+			if ((double)((float4)cval) == cval)
+				__VEC_FILTER_COMPARE(float4, (float4)cval, (x != x));
+			else
+				__VEC_FILTER_COMPARE(float4, cval, (x != x));
+			break;
+		case FLOAT8OID:
+			__VEC_FILTER_COMPARE(float8, cval, (x != x));
+			break;
+		default:
+			elog(ERROR, "Bug? unexpected type: %u", atttypid);
+	}
+}
+
+static void
+__execArrowVecInListInt(uint8 *temp, const void *values, uint32 nitems,
+						Oid atttypid, int64 cval)
+{
+	uint32		i;
+
+	switch (atttypid)
+	{
+		case INT2OID:
+			/* out of range values never match */
+			if (cval >= SHRT_MIN && cval <= SHRT_MAX)
+				__VEC_FILTER_LOOP(temp, |=, int16, x == (int16)cval);
+			break;
+		case INT4OID:
+			if (cval >= INT_MIN && cval <= INT_MAX)
+				__VEC_FILTER_LOOP(temp, |=, int32, x == (int32)cval);
+			break;
+		case INT8OID:
+			__VEC_FILTER_LOOP(temp, |=, int64, x == cval);
+			break;
+		default:
+			elog(ERROR, "Bug? unexpected type: %u", atttypid);
+	}
+}
+
+static void
+__execArrowVecInListFloat(uint8 *temp, const void *values, uint32 nitems,
+						  Oid atttypid, double cval)
+{
+	uint32		i;
+
+	switch (atttypid)
+	{
+		case FLOAT4OID:
+			if (isnan(cval))
+				__VEC_FILTER_LOOP(temp, |=, float4, x != x);
+			else if ((double)((float4)cval) == cval)
+				__VEC_FILTER_LOOP(temp, |=, float4, x == (float4)cval);
+			/* values not representable in float4 never match */
+			break;
+		case FLOAT8OID:
+			if (isnan(cval))
+				__VEC_FILTER_LOOP(temp, |=, float8, x != x);
+			else
+				__VEC_FILTER_LOOP(temp, |=, float8, x == cval);
+			break;
+		default:
+			elog(ERROR, "Bug? unexpected type: %u", atttypid);
+	}
+}
+#undef __VEC_FILTER_COMPARE
+#undef __VEC_FILTER_LOOP
+
+static void
+__execArrowVecNullmap(uint8 *mask, kern_data_store *kds,
+					  kern_colmeta *cmeta, uint32 nitems, bool is_null)
+{
+	const uint8 *nullmap;
+	uint32		i;
+
+	if (cmeta->nullmap_offset == 0)
+	{
+		/* no NULLs in this RecordBatch */
+		if (is_null)
+			memset(mask, 0, nitems);
+		return;
+	}
+	nullmap = (const uint8 *)kds + __kds_unpack(cmeta->nullmap_offset);
+	for (i=0; i < nitems; i++)
+		mask[i] &= (((nullmap[i>>3] >> (i & 7)) & 1) ^ (uint8)is_null);
+}
+
+static inline bool
+__fetchArrowVecDatum(Datum datum, Oid type_oid,
+					 int64 *p_ival, double *p_fval)
+{
+	switch (type_oid)
+	{
+		case INT2OID:
+			*p_ival = DatumGetInt16(datum);
+			break;
+		case INT4OID:
+			*p_ival = DatumGetInt32(datum);
+			break;
+		case INT8OID:
+			*p_ival = DatumGetInt64(datum);
+			break;
+		case FLOAT4OID:
+			*p_fval = DatumGetFloat4(datum);
+			break;
+		case FLOAT8OID:
+			*p_fval = DatumGetFloat8(datum);
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+static bool
+__execArrowVecQual(arrowVecFilter *vfilter,
+				   arrowVecQual *vqual,
+				   kern_data_store *kds,
+				   kern_colmeta *cmeta,
+				   const void *values)
+{
+	ExprContext *econtext = vfilter->econtext;
+	uint32		nitems = kds->nitems;
+	bool		is_integer = (vqual->atttypid == INT2OID ||
+							  vqual->atttypid == INT4OID ||
+							  vqual->atttypid == INT8OID);
+	Datum		datum;
+	bool		isnull;
+	int64		ival = 0;
+	double		fval = 0.0;
+
+	datum = ExecEvalExpr(vqual->arg_state, econtext, &isnull);
+	if (isnull)
+	{
+		/* comparison with NULL never be true */
+		memset(vfilter->mask, 0, nitems);
+		return true;
+	}
+
+	if (vqual->kind == ARROW_VEC_QUAL__OPER)
+	{
+		if (!__fetchArrowVecDatum(datum, vqual->arg_type, &ival, &fval))
+			return false;
+		if (is_integer)
+			__execArrowVecCompareInt(vfilter->mask, values, nitems,
+									 vqual->atttypid, vqual->strategy, ival);
+		else if (!isnan(fval))
+			__execArrowVecCompareFloat(vfilter->mask, values, nitems,
+									   vqual->atttypid, vqual->strategy, fval);
+		else
+			return false;
+	}
+	else
+	{
+		ArrayType  *array = DatumGetArrayTypeP(datum);
+		int16		elem_len;
+		bool		elem_byval;
+		char		elem_align;
+		Datum	   *elem_values;
+		bool	   *elem_isnull;
+		int			i, nelems;
+
+		Assert(vqual->kind == ARROW_VEC_QUAL__INLIST);
+		get_typlenbyvalalign(vqual->arg_type,
+							 &elem_len,
+							 &elem_byval,
+							 &elem_align);
+		deconstruct_array(array,
+						  vqual->arg_type,
+						  elem_len,
+						  elem_byval,
+						  elem_align,
+						  &elem_values,
+						  &elem_isnull,
+						  &nelems);
+		if (nelems > ARROW_VEC_INLIST_MAX_NITEMS)
+			return false;
+		memset(vfilter->temp, 0, nitems);
+		for (i=0; i < nelems; i++)
+		{
+			/* NULL element never matches */
+			if (elem_isnull[i])
+				continue;
+			if (!__fetchArrowVecDatum(elem_values[i], vqual->arg_type,
+									  &ival, &fval))
+				return false;
+			if (is_integer)
+				__execArrowVecInListInt(vfilter->temp, values, nitems,
+										vqual->atttypid, ival);
+			else
+				__execArrowVecInListFloat(vfilter->temp, values, nitems,
+										  vqual->atttypid, fval);
+		}
+		for (i=0; i < nitems; i++)
+			vfilter->mask[i] &= vfilter->temp[i];
+	}
+	/* comparison with NULL is never true */
+	__execArrowVecNullmap(vfilter->mask, kds, cmeta, nitems, false);
+	return true;
+}
+
+static uint32
+execArrowVecFilter(arrowVecFilter *vfilter, kern_data_store *kds)
+{
+	uint32		nitems = kds->nitems;
+	uint32		i, nrows;
+	ListCell   *lc;
+
+	if (nitems > vfilter->nrooms)
+	{
+		if (vfilter->mask)
+			pfree(vfilter->mask);
+		if (vfilter->rows)
+			pfree(vfilter->rows);
+		vfilter->mask = MemoryContextAllocHuge(vfilter->mcontext,
+											   2 * sizeof(uint8) * nitems);
+		vfilter->temp = vfilter->mask + nitems;
+		vfilter->rows = MemoryContextAllocHuge(vfilter->mcontext,
+											   sizeof(uint32) * nitems);
+		vfilter->nrooms = nitems;
+	}
+	memset(vfilter->mask, 1, nitems);
+	ResetExprContext(vfilter->econtext);
+
+	foreach (lc, vfilter->vec_quals)
+	{
+		arrowVecQual *vqual = lfirst(lc);
+		kern_colmeta *cmeta = &kds->colmeta[vqual->attnum - 1];
+		const void *values;
+		uint32		unitsz;
+
+		/* only plain arrays of the base type, as pg_datum_arrow_ref does */
+		if (vqual->attnum > kds->ncols ||
+			cmeta->atttypkind != TYPE_KIND__BASE)
+			continue;
+		if (vqual->kind == ARROW_VEC_QUAL__NULLTEST)
+		{
+			__execArrowVecNullmap(vfilter->mask, kds, cmeta,
+								  nitems, vqual->is_null);
+			continue;
+		}
+		if (cmeta->atttypid != vqual->atttypid)
+			continue;
+		unitsz = get_typlen(vqual->atttypid);
+		if ((size_t)unitsz * nitems > __kds_unpack(cmeta->values_length))
+			continue;
+		values = (const char *)kds + __kds_unpack(cmeta->values_offset);
+		(void) __execArrowVecQual(vfilter, vqual, kds, cmeta, values);
+	}
+
+	/* build the selection vector */
+	for (i=0, nrows=0; i < nitems; i++)
+	{
+		vfilter->rows[nrows] = i;
+		nrows += vfilter->mask[i];
+	}
+	vfilter->nitems_removed += (nitems - nrows);
+
+	return nrows;
+}
+
+static void
+execEndArrowVecFilter(arrowVecFilter *vfilter)
+{
+	FreeExprContext(vfilter->econtext, true);
+}
+
+/*
+ * Routines to setup record-batches
+ */
+typedef struct
+{
+	ArrowBuffer    *buffer_curr;
+	ArrowBuffer    *buffer_tail;
+	ArrowFieldNode *fnode_curr;
+	ArrowFieldNode *fnode_tail;
+	bool			compressed;	/* buffer length is compressed size */
+	ArrowFileInfo  *af_info;	/* for DictionaryBatch lookup */
+} setupRecordBatchContext;
+
+static void
+assignArrowTypeOptions(ArrowTypeOptions *attopts, const ArrowType *atype)
+{
+	memset(attopts, 0, sizeof(ArrowTypeOptions));
+	switch (atype->node.tag)
+	{
+		case ArrowNodeTag__Decimal:
 			if (atype->Decimal.precision < SHRT_MIN ||
 				atype->Decimal.precision > SHRT_MAX)
 				elog(ERROR, "Decimal precision is out of range");
@@ -1486,497 +3474,1585 @@ assignArrowTypeOptions(ArrowTypeOptions *attopts, const ArrowType *atype)
 			else
 				elog(ERROR, "unknown unit of Time");
 			break;
-		case ArrowNodeTag__Timestamp:
-			if (atype->Timestamp.unit == ArrowTimeUnit__Second ||
-				atype->Timestamp.unit == ArrowTimeUnit__MilliSecond ||
-				atype->Timestamp.unit == ArrowTimeUnit__MicroSecond ||
-				atype->Timestamp.unit == ArrowTimeUnit__NanoSecond)
-				attopts->timestamp.unit = atype->Timestamp.unit;
-			else
-				elog(ERROR, "unknown unit of Timestamp");
+		case ArrowNodeTag__Timestamp:
+			if (atype->Timestamp.unit == ArrowTimeUnit__Second ||
+				atype->Timestamp.unit == ArrowTimeUnit__MilliSecond ||
+				atype->Timestamp.unit == ArrowTimeUnit__MicroSecond ||
+				atype->Timestamp.unit == ArrowTimeUnit__NanoSecond)
+				attopts->timestamp.unit = atype->Timestamp.unit;
+			else
+				elog(ERROR, "unknown unit of Timestamp");
+			break;
+		case ArrowNodeTag__Interval:
+			if (atype->Interval.unit == ArrowIntervalUnit__Year_Month ||
+				atype->Interval.unit == ArrowIntervalUnit__Day_Time)
+				attopts->interval.unit = atype->Interval.unit;
+			else
+				elog(ERROR, "unknown unit of Interval");
+			break;
+		case ArrowNodeTag__FixedSizeBinary:
+			attopts->fixed_size_binary.byteWidth = atype->FixedSizeBinary.byteWidth;
+			break;
+		default:
+			/* no extra attributes */
+			break;
+	}
+}
+
+/*
+ * arrowBodyCompressionCodec
+ *
+ * Compressed RecordBatches are decompressed on loading, buffer by buffer.
+ * Only the BUFFER method with LZ4_FRAME or ZSTD is defined right now.
+ */
+static int
+arrowBodyCompressionCodec(ArrowBodyCompression *compress)
+{
+	if (!compress)
+		return -1;
+	if (compress->method != ArrowBodyCompressionMethod__BUFFER)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("arrow_fdw: unknown body compression method (%d)",
+						(int)compress->method)));
+	if (compress->codec != ArrowCompressionType__LZ4_FRAME &&
+		compress->codec != ArrowCompressionType__ZSTD)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("arrow_fdw: unknown compression codec (%d)",
+						(int)compress->codec)));
+	return (int)compress->codec;
+}
+
+/*
+ * setupRecordBatchDictionary
+ *
+ * A dictionary-encoded field has a nullmap and an array of indexes in the
+ * RecordBatch, and its values are kept in the DictionaryBatch with the
+ * same id. It is decoded to the regular layout on loading.
+ */
+static void
+setupRecordBatchDictionary(setupRecordBatchContext *con,
+						   RecordBatchFieldState *fstate,
+						   ArrowField *field,
+						   int depth)
+{
+	ArrowDictionaryEncoding *dict = field->dictionary;
+	ArrowFileInfo  *af_info = con->af_info;
+	ArrowDictionaryBatch *dbatch = NULL;
+	ArrowBlock	   *dblock = NULL;
+	ArrowRecordBatch *drb;
+	ArrowBuffer	   *buffer_curr;
+	off_t			d_offset;
+	bool			is_varlena = false;
+	int				i;
+
+	if (depth > 0)
+		elog(ERROR, "arrow_fdw: dictionary-encoded sub-field is not supported");
+	switch (field->type.node.tag)
+	{
+		case ArrowNodeTag__Utf8:
+		case ArrowNodeTag__Binary:
+			is_varlena = true;
+			break;
+		case ArrowNodeTag__Int:
+		case ArrowNodeTag__FloatingPoint:
+		case ArrowNodeTag__Decimal:
+		case ArrowNodeTag__Date:
+		case ArrowNodeTag__Time:
+		case ArrowNodeTag__Timestamp:
+		case ArrowNodeTag__Interval:
+		case ArrowNodeTag__FixedSizeBinary:
+			break;
+		default:
+			elog(ERROR, "arrow_fdw: dictionary-encoded %s is not supported",
+				 arrowNodeName(&field->type.node));
+	}
+	if (dict->indexType.bitWidth != 8 &&
+		dict->indexType.bitWidth != 16 &&
+		dict->indexType.bitWidth != 32 &&
+		dict->indexType.bitWidth != 64)
+		elog(ERROR, "arrow_fdw: unsupported dictionary index width (%d)",
+			 dict->indexType.bitWidth);
+
+	/* lookup the DictionaryBatch */
+	for (i=0; i < af_info->footer._num_dictionaries; i++)
+	{
+		ArrowDictionaryBatch *__dbatch
+			= &af_info->dictionaries[i].body.dictionaryBatch;
+
+		if (__dbatch->id != dict->id)
+			continue;
+		if (dbatch || __dbatch->isDelta)
+			elog(ERROR, "arrow_fdw: delta dictionary is not supported");
+		dbatch = __dbatch;
+		dblock = &af_info->footer.dictionaries[i];
+	}
+	if (!dbatch)
+		elog(ERROR, "arrow_fdw: DictionaryBatch (id=%ld) was not found",
+			 dict->id);
+	drb = &dbatch->data;
+	if (drb->_num_nodes != 1 ||
+		drb->_num_buffers != (is_varlena ? 3 : 2))
+		elog(ERROR, "arrow_fdw: DictionaryBatch (id=%ld) may have corruption",
+			 dict->id);
+	d_offset = dblock->offset + dblock->metaDataLength;
+	fstate->dict_codec = arrowBodyCompressionCodec(drb->compression);
+	fstate->dict_nitems = drb->nodes[0].length;
+	fstate->dict_null_count = drb->nodes[0].null_count;
+	if (fstate->dict_null_count > 0)
+	{
+		fstate->dict_nullmap_offset = d_offset + drb->buffers[0].offset;
+		fstate->dict_nullmap_length = drb->buffers[0].length;
+	}
+	fstate->dict_values_offset = d_offset + drb->buffers[1].offset;
+	fstate->dict_values_length = drb->buffers[1].length;
+	if (!is_varlena)
+		fstate->dict_unitsz = arrowFieldLength(field, 1);
+	else
+	{
+		fstate->dict_extra_offset = d_offset + drb->buffers[2].offset;
+		fstate->dict_extra_length = drb->buffers[2].length;
+	}
+
+	/* nullmap and indexes in the RecordBatch */
+	if (con->buffer_curr + 2 > con->buffer_tail)
+		elog(ERROR, "RecordBatch has less buffers than expected");
+	buffer_curr = con->buffer_curr++;
+	if (fstate->null_count > 0)
+	{
+		fstate->nullmap_offset = buffer_curr->offset;
+		fstate->nullmap_length = buffer_curr->length;
+		if (!con->compressed &&
+			fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+			elog(ERROR, "nullmap length is smaller than expected");
+		if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+			elog(ERROR, "nullmap is not aligned well");
+	}
+	buffer_curr = con->buffer_curr++;
+	fstate->dict_index_width = dict->indexType.bitWidth / BITS_PER_BYTE;
+	fstate->values_offset = buffer_curr->offset;
+	fstate->values_length = buffer_curr->length;
+	if (!con->compressed &&
+		fstate->values_length < fstate->dict_index_width * fstate->nitems)
+		elog(ERROR, "dictionary index array is smaller than expected");
+	if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+		elog(ERROR, "dictionary index array is not aligned well");
+}
+
+static void
+setupRecordBatchField(setupRecordBatchContext *con,
+					  RecordBatchFieldState *fstate,
+					  ArrowField  *field,
+					  int depth)
+{
+	ArrowBuffer	   *buffer_curr;
+	ArrowFieldNode *fnode;
+
+	if (con->fnode_curr >= con->fnode_tail)
+		elog(ERROR, "RecordBatch has less ArrowFieldNode than expected");
+	fnode = con->fnode_curr++;
+	fstate->atttypid   = arrowTypeToPGTypeOid(field, &fstate->atttypmod);
+	fstate->nitems     = fnode->length;
+	fstate->null_count = fnode->null_count;
+	fstate->stat_isnull = true;
+
+	if (field->dictionary)
+	{
+		setupRecordBatchDictionary(con, fstate, field, depth);
+		assignArrowTypeOptions(&fstate->attopts, &field->type);
+		return;
+	}
+
+	switch (field->type.node.tag)
+	{
+		case ArrowNodeTag__Int:
+		case ArrowNodeTag__FloatingPoint:
+		case ArrowNodeTag__Bool:
+		case ArrowNodeTag__Decimal:
+		case ArrowNodeTag__Date:
+		case ArrowNodeTag__Time:
+		case ArrowNodeTag__Timestamp:
+		case ArrowNodeTag__Interval:
+		case ArrowNodeTag__FixedSizeBinary:
+			/* fixed length values */
+			if (con->buffer_curr + 2 > con->buffer_tail)
+				elog(ERROR, "RecordBatch has less buffers than expected");
+			buffer_curr = con->buffer_curr++;
+			if (fstate->null_count > 0)
+			{
+				fstate->nullmap_offset = buffer_curr->offset;
+				fstate->nullmap_length = buffer_curr->length;
+				if (!con->compressed &&
+					fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+					elog(ERROR, "nullmap length is smaller than expected");
+				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+					elog(ERROR, "nullmap is not aligned well");
+			}
+			buffer_curr = con->buffer_curr++;
+			fstate->values_offset = buffer_curr->offset;
+			fstate->values_length = buffer_curr->length;
+			if (!con->compressed &&
+				fstate->values_length < arrowFieldLength(field,fstate->nitems))
+				elog(ERROR, "values array is smaller than expected");
+			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+				elog(ERROR, "values array is not aligned well");
+			break;
+
+		case ArrowNodeTag__List:
+			if (field->_num_children != 1)
+				elog(ERROR, "Bug? List of arrow type is corrupted");
+			/*
+			 * NOTE: PostgreSQL has no array-of-array type, so List of List
+			 * cannot be mapped to any SQL type. Elsewhere, List is available
+			 * at any depth, including List of Struct and List in Struct.
+			 */
+			if (field->children[0].type.node.tag == ArrowNodeTag__List)
+				elog(ERROR, "nested array type is not supported");
+			/* nullmap */
+			if (con->buffer_curr + 1 > con->buffer_tail)
+				elog(ERROR, "RecordBatch has less buffers than expected");
+			buffer_curr = con->buffer_curr++;
+			if (fstate->null_count > 0)
+			{
+				fstate->nullmap_offset = buffer_curr->offset;
+				fstate->nullmap_length = buffer_curr->length;
+				if (!con->compressed &&
+					fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+					elog(ERROR, "nullmap length is smaller than expected");
+				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+					elog(ERROR, "nullmap is not aligned well");
+			}
+			/* offset values */
+			buffer_curr = con->buffer_curr++;
+			fstate->values_offset = buffer_curr->offset;
+			fstate->values_length = buffer_curr->length;
+			if (!con->compressed &&
+				fstate->values_length < arrowFieldLength(field,fstate->nitems))
+				elog(ERROR, "offset array is smaller than expected");
+			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+				elog(ERROR, "offset array is not aligned well");
+			/* setup array element */
+			fstate->children = palloc0(sizeof(RecordBatchFieldState));
+			setupRecordBatchField(con,
+								  &fstate->children[0],
+								  &field->children[0],
+								  depth+1);
+			fstate->num_children = 1;
 			break;
-		case ArrowNodeTag__Interval:
-			if (atype->Interval.unit == ArrowIntervalUnit__Year_Month ||
-				atype->Interval.unit == ArrowIntervalUnit__Day_Time)
-				attopts->interval.unit = atype->Interval.unit;
-			else
-				elog(ERROR, "unknown unit of Interval");
+
+		case ArrowNodeTag__Utf8:
+		case ArrowNodeTag__Binary:
+			/* variable length values */
+			if (con->buffer_curr + 3 > con->buffer_tail)
+				elog(ERROR, "RecordBatch has less buffers than expected");
+			buffer_curr = con->buffer_curr++;
+			if (fstate->null_count > 0)
+			{
+				fstate->nullmap_offset = buffer_curr->offset;
+				fstate->nullmap_length = buffer_curr->length;
+				if (!con->compressed &&
+					fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+					elog(ERROR, "nullmap length is smaller than expected");
+				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+					elog(ERROR, "nullmap is not aligned well");
+			}
+
+			buffer_curr = con->buffer_curr++;
+			fstate->values_offset = buffer_curr->offset;
+			fstate->values_length = buffer_curr->length;
+			if (!con->compressed &&
+				fstate->values_length < arrowFieldLength(field,fstate->nitems))
+				elog(ERROR, "offset array is smaller than expected");
+			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+				elog(ERROR, "offset array is not aligned well (%lu %lu)", fstate->values_offset, fstate->values_length);
+
+			buffer_curr = con->buffer_curr++;
+			fstate->extra_offset = buffer_curr->offset;
+			fstate->extra_length = buffer_curr->length;
+			if ((fstate->extra_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+				elog(ERROR, "extra buffer is not aligned well");
 			break;
-		case ArrowNodeTag__FixedSizeBinary:
-			attopts->fixed_size_binary.byteWidth = atype->FixedSizeBinary.byteWidth;
+
+		case ArrowNodeTag__Struct:
+			/* only nullmap */
+			if (con->buffer_curr + 1 > con->buffer_tail)
+				elog(ERROR, "RecordBatch has less buffers than expected");
+			buffer_curr = con->buffer_curr++;
+			if (fstate->null_count > 0)
+			{
+				fstate->nullmap_offset = buffer_curr->offset;
+				fstate->nullmap_length = buffer_curr->length;
+				if (!con->compressed &&
+					fstate->nullmap_length < BITMAPLEN(fstate->nitems))
+					elog(ERROR, "nullmap length is smaller than expected");
+				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+					elog(ERROR, "nullmap is not aligned well");
+			}
+
+			if (field->_num_children > 0)
+			{
+				int		i;
+
+				fstate->children = palloc0(sizeof(RecordBatchFieldState) *
+									  field->_num_children);
+				for (i=0; i < field->_num_children; i++)
+				{
+					setupRecordBatchField(con,
+										  &fstate->children[i],
+										  &field->children[i],
+										  depth+1);
+				}
+			}
+			fstate->num_children = field->_num_children;
 			break;
 		default:
-			/* no extra attributes */
-			break;
+			elog(ERROR, "Bug? ArrowSchema contains unsupported types");
+	}
+	/* assign extra attributes (precision, unitsz, ...) */
+	assignArrowTypeOptions(&fstate->attopts, &field->type);
+}
+
+static RecordBatchState *
+makeRecordBatchState(ArrowFileInfo *af_info,
+					 ArrowSchema *schema,
+					 ArrowBlock *block,
+					 ArrowRecordBatch *rbatch)
+{
+	setupRecordBatchContext con;
+	RecordBatchState *result;
+	int			j, ncols = schema->_num_fields;
+
+	result = palloc0(offsetof(RecordBatchState, columns[ncols]));
+	result->ncols = ncols;
+	result->rb_offset = block->offset + block->metaDataLength;
+	result->rb_length = block->bodyLength;
+	result->rb_nitems = rbatch->length;
+	result->rb_codec  = arrowBodyCompressionCodec(rbatch->compression);
+
+	memset(&con, 0, sizeof(setupRecordBatchContext));
+	con.compressed  = (rbatch->compression != NULL);
+	con.af_info     = af_info;
+	con.buffer_curr = rbatch->buffers;
+	con.buffer_tail = rbatch->buffers + rbatch->_num_buffers;
+	con.fnode_curr  = rbatch->nodes;
+	con.fnode_tail  = rbatch->nodes + rbatch->_num_nodes;
+
+	for (j=0; j < ncols; j++)
+	{
+		RecordBatchFieldState *fstate = &result->columns[j];
+		ArrowField	   *field = &schema->fields[j];
+
+		setupRecordBatchField(&con, fstate, field, 0);
+	}
+	if (con.buffer_curr != con.buffer_tail ||
+		con.fnode_curr  != con.fnode_tail)
+		elog(ERROR, "arrow_fdw: RecordBatch may have corruption.");
+
+	return result;
+}
+
+/*
+ * makeRecordBatchStateFromParquet
+ *
+ * A row-group of parquet file is mapped to a virtual RecordBatch; its pages
+ * shall be decoded to the KDS_FORMAT_ARROW layout on the loading time.
+ */
+static RecordBatchState *
+makeRecordBatchStateFromParquet(ParquetFileInfo *pq_info,
+								ParquetRowGroup *rgroup,
+								Bitmapset **p_stat_attrs)
+{
+	RecordBatchState *result;
+	int			j, ncols = pq_info->schema._num_fields;
+
+	result = palloc0(offsetof(RecordBatchState, columns[ncols]));
+	result->ncols = ncols;
+	result->rb_offset = 0;
+	result->rb_length = rgroup->total_length;
+	result->rb_nitems = rgroup->num_rows;
+	result->rb_codec  = -1;
+	result->rb_parquet = true;
+
+	for (j=0; j < ncols; j++)
+	{
+		RecordBatchFieldState *fstate = &result->columns[j];
+		ParquetColumnChunk *pq_column = &rgroup->columns[j];
+		ArrowField	   *field = &pq_info->schema.fields[j];
+
+		fstate->atttypid = arrowTypeToPGTypeOid(field, &fstate->atttypmod);
+		fstate->nitems   = rgroup->num_rows;
+		/* NULLs are not known until the definition levels are decoded */
+		fstate->null_count = 0;
+		/* column chunk on behalf of the buffers, for cost estimation */
+		fstate->values_offset = pq_column->info.chunk_offset;
+		fstate->values_length = pq_column->info.chunk_length;
+		memcpy(&fstate->pq_chunk, &pq_column->info, sizeof(ParquetChunkInfo));
+		assignArrowTypeOptions(&fstate->attopts, &field->type);
+
+		fstate->stat_isnull = pq_column->stat_isnull;
+		if (!pq_column->stat_isnull)
+		{
+			memcpy(&fstate->stat_min, pq_column->stat_min,
+				   sizeof(SQLstat__datum));
+			memcpy(&fstate->stat_max, pq_column->stat_max,
+				   sizeof(SQLstat__datum));
+			if (p_stat_attrs)
+				*p_stat_attrs = bms_add_member(*p_stat_attrs, j+1);
+		}
+	}
+	return result;
+}
+
+/*
+ * ExecInitArrowFdw
+ */
+ArrowFdwState *
+ExecInitArrowFdw(ScanState *ss,
+				 GpuContext *gcontext,
+				 List *outer_quals,
+				 Bitmapset *outer_refs)
+{
+	Relation		relation = ss->ss_currentRelation;
+	TupleDesc		tupdesc = RelationGetDescr(relation);
+	ForeignTable   *ft = GetForeignTable(RelationGetRelid(relation));
+	List		   *filesList = NIL;
+	List		   *fdescList = NIL;
+	List		   *gpuDirectFileDescList = NIL;
+	Bitmapset	   *referenced = NULL;
+	Bitmapset	   *stat_attrs = NULL;
+	bool			whole_row_ref = false;
+	ArrowFdwState  *af_state;
+	List		   *rb_state_list = NIL;
+	ListCell	   *lc;
+	bool			writable;
+	int				part_ncols = 0;
+	int				part_nfiles;
+	int				i, num_rbatches;
+
+	Assert(RelationGetForm(relation)->relkind == RELKIND_FOREIGN_TABLE &&
+		   memcmp(GetFdwRoutineForRelation(relation, false),
+				  &pgstrom_arrow_fdw_routine, sizeof(FdwRoutine)) == 0);
+	/* expand 'referenced' if it has whole-row reference */
+	if (bms_is_member(-FirstLowInvalidHeapAttributeNumber, outer_refs))
+		whole_row_ref = true;
+	for (i=0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, i);
+		int		k = attr->attnum - FirstLowInvalidHeapAttributeNumber;
+
+		if (attr->attisdropped)
+			continue;
+		if (whole_row_ref || bms_is_member(k, outer_refs))
+			referenced = bms_add_member(referenced, k);
+	}
+
+	filesList = __arrowFdwExtractFilesList(ft->options,
+										   NULL,
+										   &writable);
+	part_nfiles = list_length(filesList);
+	if (!writable)
+	{
+		part_ncols = arrowFdwPartitionColumns(tupdesc, filesList);
+		filesList = arrowFdwPrunePartitionFiles(tupdesc,
+												filesList,
+												part_ncols,
+												outer_quals);
+	}
+	foreach (lc, filesList)
+	{
+		char	   *fname = strVal(lfirst(lc));
+		File		fdesc;
+		List	   *rb_cached = NIL;
+		ListCell   *cell;
+		GPUDirectFileDesc *dfile = NULL;
+
+		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
+		if (fdesc < 0)
+		{
+			if (writable && errno == ENOENT)
+				continue;
+			elog(ERROR, "failed to open '%s' on behalf of '%s'",
+				 fname, RelationGetRelationName(relation));
+		}
+		fdescList = lappend_int(fdescList, fdesc);
+
+		/*
+		 * Open file for GPUDirect I/O
+		 */
+		if (gcontext)
+		{
+			dfile = palloc0(sizeof(GPUDirectFileDesc));
+
+			gpuDirectFileDescOpen(dfile, fdesc);
+			if (!trackRawFileDesc(gcontext, dfile, __FILE__, __LINE__))
+			{
+				gpuDirectFileDescClose(dfile);
+				elog(ERROR, "out of memory");
+			}
+			gpuDirectFileDescList = lappend(gpuDirectFileDescList, dfile);
+		}
+
+		rb_cached = arrowLookupOrBuildMetadataCache(fdesc, &stat_attrs);
+		/* check schema compatibility */
+		foreach (cell, rb_cached)
+		{
+			RecordBatchState   *rb_state = lfirst(cell);
+
+			rb_state = arrowFdwSetupPartitionColumns(rb_state, tupdesc,
+													 fname, part_ncols);
+			lfirst(cell) = rb_state;
+			if (!arrowSchemaCompatibilityCheck(tupdesc, rb_state))
+				elog(ERROR, "arrow file '%s' on behalf of foreign table '%s' has incompatible schema definition",
+					 fname, RelationGetRelationName(relation));
+			/* GPUDirect I/O state, if any */
+			rb_state->dfile = dfile;
+		}
+		rb_state_list = list_concat(rb_state_list, rb_cached);
 	}
+	num_rbatches = list_length(rb_state_list);
+	af_state = palloc0(offsetof(ArrowFdwState, rbatches[num_rbatches]));
+	af_state->gcontext = gcontext;
+	af_state->gpuDirectFileDescList = gpuDirectFileDescList;
+	af_state->fdescList = fdescList;
+	af_state->referenced = referenced;
+	af_state->writable = writable;
+	af_state->stat_attrs = stat_attrs;
+	if (arrow_fdw_stats_hint_enabled)
+		af_state->stats_hint = execInitArrowStatsHint(ss, stat_attrs,
+													  outer_quals);
+	af_state->rbatch_index = &af_state->__rbatch_index_local;
+	af_state->rbatch_nload = &af_state->__rbatch_nload_local;
+	af_state->rbatch_nskip = &af_state->__rbatch_nskip_local;
+	af_state->rbatch_nstats = &af_state->__rbatch_nstats_local;
+	af_state->io_stats = &af_state->__io_stats_local;
+	af_state->part_ncols = part_ncols;
+	af_state->part_nfiles = part_nfiles;
+	af_state->part_nskip = part_nfiles - list_length(filesList);
+	pg_atomic_init_u64(&af_state->io_stats->nr_reads, 0);
+	pg_atomic_init_u64(&af_state->io_stats->read_bytes, 0);
+	pg_atomic_init_u64(&af_state->io_stats->used_bytes, 0);
+	i = 0;
+	foreach (lc, rb_state_list)
+		af_state->rbatches[i++] = (RecordBatchState *)lfirst(lc);
+	af_state->num_rbatches = num_rbatches;
+
+	return af_state;
 }
 
+/*
+ * ArrowBeginForeignScan
+ */
 static void
-setupRecordBatchField(setupRecordBatchContext *con,
-					  RecordBatchFieldState *fstate,
-					  ArrowField  *field,
-					  int depth)
+ArrowBeginForeignScan(ForeignScanState *node, int eflags)
 {
-	ArrowBuffer	   *buffer_curr;
-	ArrowFieldNode *fnode;
+	Relation		relation = node->ss.ss_currentRelation;
+	TupleDesc		tupdesc = RelationGetDescr(relation);
+	ForeignScan	   *fscan = (ForeignScan *) node->ss.ps.plan;
+	ArrowFdwState  *af_state;
+	ListCell	   *lc;
+	Bitmapset	   *referenced = NULL;
 
-	if (con->fnode_curr >= con->fnode_tail)
-		elog(ERROR, "RecordBatch has less ArrowFieldNode than expected");
-	fnode = con->fnode_curr++;
-	fstate->atttypid   = arrowTypeToPGTypeOid(field, &fstate->atttypmod);
-	fstate->nitems     = fnode->length;
-	fstate->null_count = fnode->null_count;
-	fstate->stat_isnull = true;
+	foreach (lc, fscan->fdw_private)
+	{
+		int		j = lfirst_int(lc);
 
-	switch (field->type.node.tag)
+		if (j >= 0 && j <= tupdesc->natts)
+			referenced = bms_add_member(referenced, j -
+										FirstLowInvalidHeapAttributeNumber);
+	}
+	af_state = ExecInitArrowFdw(&node->ss,
+								NULL,
+								fscan->scan.plan.qual,
+								referenced);
+	if (arrow_fdw_vec_filter_enabled)
+		af_state->vec_filter = execInitArrowVecFilter(&node->ss,
+													  fscan->scan.plan.qual);
+	node->fdw_state = af_state;
+}
+
+typedef struct
+{
+	off_t		rb_offset;
+	off_t		f_offset;
+	off_t		m_offset;
+	size_t		coalesce_gap;	/* arrow_fdw.io_coalesce_gap */
+	cl_int		io_index;
+	cl_int      depth;
+	strom_io_chunk ioc[FLEXIBLE_ARRAY_MEMBER];
+} arrowFdwSetupIOContext;
+
+/*
+ * arrowFdwSetupIOvectorField
+ */
+static void
+__setupIOvectorField(arrowFdwSetupIOContext *con,
+					 off_t chunk_offset,
+					 size_t chunk_length,
+					 cl_uint *p_cmeta_offset,
+					 cl_uint *p_cmeta_length)
+{
+	off_t		f_pos = con->rb_offset + chunk_offset;
+	size_t		__length = MAXALIGN(chunk_length);
+
+	Assert((con->m_offset & (MAXIMUM_ALIGNOF - 1)) == 0);
+
+	if (f_pos == con->f_offset)
 	{
-		case ArrowNodeTag__Int:
-		case ArrowNodeTag__FloatingPoint:
-		case ArrowNodeTag__Bool:
-		case ArrowNodeTag__Decimal:
-		case ArrowNodeTag__Date:
-		case ArrowNodeTag__Time:
-		case ArrowNodeTag__Timestamp:
-		case ArrowNodeTag__Interval:
-		case ArrowNodeTag__FixedSizeBinary:
-			/* fixed length values */
-			if (con->buffer_curr + 2 > con->buffer_tail)
-				elog(ERROR, "RecordBatch has less buffers than expected");
-			buffer_curr = con->buffer_curr++;
-			if (fstate->null_count > 0)
-			{
-				fstate->nullmap_offset = buffer_curr->offset;
-				fstate->nullmap_length = buffer_curr->length;
-				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
-					elog(ERROR, "nullmap length is smaller than expected");
-				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
-					elog(ERROR, "nullmap is not aligned well");
-			}
-			buffer_curr = con->buffer_curr++;
-			fstate->values_offset = buffer_curr->offset;
-			fstate->values_length = buffer_curr->length;
-			if (fstate->values_length < arrowFieldLength(field,fstate->nitems))
-				elog(ERROR, "values array is smaller than expected");
-			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
-				elog(ERROR, "values array is not aligned well");
-			break;
+		/* good, buffer is fully continuous */
+		*p_cmeta_offset = __kds_packed(con->m_offset);
+		*p_cmeta_length = __kds_packed(__length);
 
-		case ArrowNodeTag__List:
-			if (field->_num_children != 1)
-				elog(ERROR, "Bug? List of arrow type is corrupted");
-			if (depth > 0)
-				elog(ERROR, "nested array type is not supported");
-			/* nullmap */
-			if (con->buffer_curr + 1 > con->buffer_tail)
-				elog(ERROR, "RecordBatch has less buffers than expected");
-			buffer_curr = con->buffer_curr++;
-			if (fstate->null_count > 0)
-			{
-				fstate->nullmap_offset = buffer_curr->offset;
-				fstate->nullmap_length = buffer_curr->length;
-				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
-					elog(ERROR, "nullmap length is smaller than expected");
-				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
-					elog(ERROR, "nullmap is not aligned well");
-			}
-			/* offset values */
-			buffer_curr = con->buffer_curr++;
-			fstate->values_offset = buffer_curr->offset;
-			fstate->values_length = buffer_curr->length;
-			if (fstate->values_length < arrowFieldLength(field,fstate->nitems))
-				elog(ERROR, "offset array is smaller than expected");
-			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
-				elog(ERROR, "offset array is not aligned well");
-			/* setup array element */
-			fstate->children = palloc0(sizeof(RecordBatchFieldState));
-			setupRecordBatchField(con,
-								  &fstate->children[0],
-								  &field->children[0],
-								  depth+1);
-			fstate->num_children = 1;
-			break;
+		con->m_offset += __length;
+		con->f_offset += __length;
+	}
+	else if (f_pos > con->f_offset &&
+			 ((f_pos & ~PAGE_MASK) == (con->f_offset & ~PAGE_MASK) ||
+			  (f_pos - con->f_offset) <= con->coalesce_gap) &&
+			 ((f_pos - con->f_offset) & (MAXIMUM_ALIGNOF-1)) == 0)
+	{
+		/*
+		 * we can also consolidate the i/o of two chunks, if file position
+		 * of the next chunk (f_pos) and the current file tail position
+		 * (con->f_offset) locate within the same file page, or closer than
+		 * arrow_fdw.io_coalesce_gap, and if gap bytes on the file does not
+		 * break alignment. Gap bytes are read, but never referenced.
+		 */
+		size_t	__gap = (f_pos - con->f_offset);
 
-		case ArrowNodeTag__Utf8:
-		case ArrowNodeTag__Binary:
-			/* variable length values */
-			if (con->buffer_curr + 3 > con->buffer_tail)
-				elog(ERROR, "RecordBatch has less buffers than expected");
-			buffer_curr = con->buffer_curr++;
-			if (fstate->null_count > 0)
-			{
-				fstate->nullmap_offset = buffer_curr->offset;
-				fstate->nullmap_length = buffer_curr->length;
-				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
-					elog(ERROR, "nullmap length is smaller than expected");
-				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
-					elog(ERROR, "nullmap is not aligned well");
-			}
+		/* put gap bytes */
+		con->m_offset += __gap;
+		con->f_offset += __gap;
 
-			buffer_curr = con->buffer_curr++;
-			fstate->values_offset = buffer_curr->offset;
-			fstate->values_length = buffer_curr->length;
-			if (fstate->values_length < arrowFieldLength(field,fstate->nitems))
-				elog(ERROR, "offset array is smaller than expected");
-			if ((fstate->values_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
-				elog(ERROR, "offset array is not aligned well (%lu %lu)", fstate->values_offset, fstate->values_length);
+		*p_cmeta_offset = __kds_packed(con->m_offset);
+		*p_cmeta_length = __kds_packed(__length);
 
-			buffer_curr = con->buffer_curr++;
-			fstate->extra_offset = buffer_curr->offset;
-			fstate->extra_length = buffer_curr->length;
-			if ((fstate->extra_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
-				elog(ERROR, "extra buffer is not aligned well");
-			break;
+		con->m_offset += __length;
+		con->f_offset += __length;
+	}
+	else
+	{
+		/*
+		 * Elsewhere, we have no chance to consolidate this chunk to
+		 * the previous i/o-chunk. So, make a new i/o-chunk.
+		 */
+		off_t		f_base = TYPEALIGN_DOWN(PAGE_SIZE, f_pos);
+		off_t		f_tail;
+		off_t		shift = f_pos - f_base;
+		strom_io_chunk *ioc;
+
+		if (con->io_index < 0)
+			con->io_index = 0;	/* no previous i/o chunks */
+		else
+		{
+			ioc = &con->ioc[con->io_index++];
+
+			f_tail = TYPEALIGN(PAGE_SIZE, con->f_offset);
+			ioc->nr_pages = f_tail / PAGE_SIZE - ioc->fchunk_id;
+			con->m_offset += (f_tail - con->f_offset); //safety margin;
+		}
+		ioc = &con->ioc[con->io_index];
+		/* adjust position if con->m_offset is not aligned well */
+		if (con->m_offset + shift != MAXALIGN(con->m_offset + shift))
+			con->m_offset = MAXALIGN(con->m_offset + shift) - shift;
+		ioc->m_offset   = con->m_offset;
+		ioc->fchunk_id  = f_base / PAGE_SIZE;
+
+		*p_cmeta_offset = __kds_packed(con->m_offset + shift);
+		*p_cmeta_length = __kds_packed(__length);
+
+		con->m_offset  += shift + __length;
+		con->f_offset   = f_pos + __length;
+	}
+}
+
+static void
+arrowFdwSetupIOvectorField(arrowFdwSetupIOContext *con,
+						   RecordBatchFieldState *fstate,
+						   kern_data_store *kds,
+						   kern_colmeta *cmeta)
+{
+	//int		index = cmeta - kds->colmeta;
+
+	if (fstate->nullmap_length > 0)
+	{
+		Assert(fstate->null_count > 0);
+		__setupIOvectorField(con,
+							 fstate->nullmap_offset,
+							 fstate->nullmap_length,
+							 &cmeta->nullmap_offset,
+							 &cmeta->nullmap_length);
+		//elog(INFO, "D%d att[%d] nullmap=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->nullmap_offset, fstate->nullmap_length, con->m_offset, con->f_offset);
+	}
+	if (fstate->values_length > 0)
+	{
+		__setupIOvectorField(con,
+							 fstate->values_offset,
+							 fstate->values_length,
+							 &cmeta->values_offset,
+							 &cmeta->values_length);
+		//elog(INFO, "D%d att[%d] values=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->values_offset, fstate->values_length, con->m_offset, con->f_offset);
+	}
+	if (fstate->extra_length > 0)
+	{
+		__setupIOvectorField(con,
+							 fstate->extra_offset,
+							 fstate->extra_length,
+							 &cmeta->extra_offset,
+							 &cmeta->extra_length);
+		//elog(INFO, "D%d att[%d] extra=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->extra_offset, fstate->extra_length, con->m_offset, con->f_offset);
+	}
 
-		case ArrowNodeTag__Struct:
-			if (depth > 0)
-				elog(ERROR, "nested composite type is not supported");
-			/* only nullmap */
-			if (con->buffer_curr + 1 > con->buffer_tail)
-				elog(ERROR, "RecordBatch has less buffers than expected");
-			buffer_curr = con->buffer_curr++;
-			if (fstate->null_count > 0)
-			{
-				fstate->nullmap_offset = buffer_curr->offset;
-				fstate->nullmap_length = buffer_curr->length;
-				if (fstate->nullmap_length < BITMAPLEN(fstate->nitems))
-					elog(ERROR, "nullmap length is smaller than expected");
-				if ((fstate->nullmap_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
-					elog(ERROR, "nullmap is not aligned well");
-			}
+	/* nested sub-fields if composite types */
+	if (cmeta->atttypkind == TYPE_KIND__ARRAY ||
+		cmeta->atttypkind == TYPE_KIND__COMPOSITE)
+	{
+		kern_colmeta *subattr;
+		int		j;
 
-			if (field->_num_children > 0)
-			{
-				int		i;
+		Assert(fstate->num_children == cmeta->num_subattrs);
+		con->depth++;
+		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
+			 j < cmeta->num_subattrs;
+			 j++, subattr++)
+		{
+			RecordBatchFieldState *child = &fstate->children[j];
 
-				fstate->children = palloc0(sizeof(RecordBatchFieldState) *
-									  field->_num_children);
-				for (i=0; i < field->_num_children; i++)
-				{
-					setupRecordBatchField(con,
-										  &fstate->children[i],
-										  &field->children[i],
-										  depth+1);
-				}
-			}
-			fstate->num_children = field->_num_children;
-			break;
-		default:
-			elog(ERROR, "Bug? ArrowSchema contains unsupported types");
+			arrowFdwSetupIOvectorField(con, child, kds, subattr);
+		}
+		con->depth--;
 	}
-	/* assign extra attributes (precision, unitsz, ...) */
-	assignArrowTypeOptions(&fstate->attopts, &field->type);
 }
 
-static RecordBatchState *
-makeRecordBatchState(ArrowSchema *schema,
-					 ArrowBlock *block,
-					 ArrowRecordBatch *rbatch)
+/*
+ * arrowFdwSetupIOvector
+ */
+static strom_io_vector *
+arrowFdwSetupIOvector(kern_data_store *kds,
+					  RecordBatchState *rb_state,
+					  Bitmapset *referenced)
 {
-	setupRecordBatchContext con;
-	RecordBatchState *result;
-	int			j, ncols = schema->_num_fields;
-
-	/*
-	 * Right now, we have no support for compressed RecordBatches
-	 */
-	if (rbatch->compression)
-		ereport(ERROR,
-				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-				 errmsg("arrow_fdw: compressed record-batches are not supported")));
-	
-	result = palloc0(offsetof(RecordBatchState, columns[ncols]));
-	result->ncols = ncols;
-	result->rb_offset = block->offset + block->metaDataLength;
-	result->rb_length = block->bodyLength;
-	result->rb_nitems = rbatch->length;
+	arrowFdwSetupIOContext *con;
+	strom_io_vector *iovec = NULL;
+	int			j, nr_chunks = 0;
 
-	memset(&con, 0, sizeof(setupRecordBatchContext));
-	con.buffer_curr = rbatch->buffers;
-	con.buffer_tail = rbatch->buffers + rbatch->_num_buffers;
-	con.fnode_curr  = rbatch->nodes;
-	con.fnode_tail  = rbatch->nodes + rbatch->_num_nodes;
+	Assert(kds->nr_colmeta >= kds->ncols);
+	con = alloca(offsetof(arrowFdwSetupIOContext,
+						  ioc[3 * kds->nr_colmeta]));
+	con->rb_offset = rb_state->rb_offset;
+	con->f_offset  = ~0UL;	/* invalid offset */
+	con->m_offset  = TYPEALIGN(PAGE_SIZE, KERN_DATA_STORE_HEAD_LENGTH(kds));
+	con->coalesce_gap = (size_t)arrow_io_coalesce_gap_kb << 10;
+	con->io_index  = -1;
+	for (j=0; j < kds->ncols; j++)
+	{
+		RecordBatchFieldState *fstate = &rb_state->columns[j];
+		kern_colmeta *cmeta = &kds->colmeta[j];
+		int			attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
 
-	for (j=0; j < ncols; j++)
+		if (referenced && bms_is_member(attidx, referenced))
+			arrowFdwSetupIOvectorField(con, fstate, kds, cmeta);
+		else
+			cmeta->atttypkind = TYPE_KIND__NULL;	/* unreferenced */
+	}
+	if (con->io_index >= 0)
 	{
-		RecordBatchFieldState *fstate = &result->columns[j];
-		ArrowField	   *field = &schema->fields[j];
+		/* close the last I/O chunks */
+		strom_io_chunk *ioc = &con->ioc[con->io_index];
 
-		setupRecordBatchField(&con, fstate, field, 0);
+		ioc->nr_pages = (TYPEALIGN(PAGE_SIZE, con->f_offset) / PAGE_SIZE -
+						 ioc->fchunk_id);
+		con->m_offset = ioc->m_offset + PAGE_SIZE * ioc->nr_pages;
+		nr_chunks = con->io_index + 1;
 	}
-	if (con.buffer_curr != con.buffer_tail ||
-		con.fnode_curr  != con.fnode_tail)
-		elog(ERROR, "arrow_fdw: RecordBatch may have corruption.");
+	kds->length = con->m_offset;
 
-	return result;
+	iovec = palloc0(offsetof(strom_io_vector, ioc[nr_chunks]));
+	iovec->nr_chunks = nr_chunks;
+	if (nr_chunks > 0)
+		memcpy(iovec->ioc, con->ioc, sizeof(strom_io_chunk) * nr_chunks);
+	return iovec;
 }
 
 /*
- * ExecInitArrowFdw
+ * __dump_kds_and_iovec - just for debug
  */
-ArrowFdwState *
-ExecInitArrowFdw(ScanState *ss,
-				 GpuContext *gcontext,
-				 List *outer_quals,
-				 Bitmapset *outer_refs)
+static inline void
+__dump_kds_and_iovec(kern_data_store *kds, strom_io_vector *iovec)
 {
-	Relation		relation = ss->ss_currentRelation;
-	TupleDesc		tupdesc = RelationGetDescr(relation);
-	ForeignTable   *ft = GetForeignTable(RelationGetRelid(relation));
-	List		   *filesList = NIL;
-	List		   *fdescList = NIL;
-	List		   *gpuDirectFileDescList = NIL;
-	Bitmapset	   *referenced = NULL;
-	Bitmapset	   *stat_attrs = NULL;
-	bool			whole_row_ref = false;
-	ArrowFdwState  *af_state;
-	List		   *rb_state_list = NIL;
-	ListCell	   *lc;
-	bool			writable;
-	int				i, num_rbatches;
+#if 0
+	int		j;
 
-	Assert(RelationGetForm(relation)->relkind == RELKIND_FOREIGN_TABLE &&
-		   memcmp(GetFdwRoutineForRelation(relation, false),
-				  &pgstrom_arrow_fdw_routine, sizeof(FdwRoutine)) == 0);
-	/* expand 'referenced' if it has whole-row reference */
-	if (bms_is_member(-FirstLowInvalidHeapAttributeNumber, outer_refs))
-		whole_row_ref = true;
-	for (i=0; i < tupdesc->natts; i++)
+	elog(INFO, "nchunks = %d", iovec->nr_chunks);
+	for (j=0; j < iovec->nr_chunks; j++)
 	{
-		Form_pg_attribute attr = tupleDescAttr(tupdesc, i);
-		int		k = attr->attnum - FirstLowInvalidHeapAttributeNumber;
+		strom_io_chunk *ioc = &iovec->ioc[j];
 
-		if (attr->attisdropped)
-			continue;
-		if (whole_row_ref || bms_is_member(k, outer_refs))
-			referenced = bms_add_member(referenced, k);
+		elog(INFO, "io[%d] [ m_offset=%lu, f_read=%lu...%lu, nr_pages=%u}",
+			 j,
+			 ioc->m_offset,
+			 ioc->fchunk_id * PAGE_SIZE,
+			 (ioc->fchunk_id + ioc->nr_pages) * PAGE_SIZE,
+			 ioc->nr_pages);
 	}
 
-	filesList = __arrowFdwExtractFilesList(ft->options,
-										   NULL,
-										   &writable);
-	foreach (lc, filesList)
+	elog(INFO, "kds {length=%zu nitems=%u typeid=%u typmod=%u table_oid=%u}",
+		 kds->length, kds->nitems,
+		 kds->tdtypeid, kds->tdtypmod, kds->table_oid);
+	for (j=0; j < kds->nr_colmeta; j++)
 	{
-		char	   *fname = strVal(lfirst(lc));
-		File		fdesc;
-		List	   *rb_cached = NIL;
-		ListCell   *cell;
-		GPUDirectFileDesc *dfile = NULL;
+		kern_colmeta *cmeta = &kds->colmeta[j];
 
-		fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
-		if (fdesc < 0)
+		elog(INFO, "%ccol[%d] nullmap=%lu,%lu values=%lu,%lu extra=%lu,%lu",
+			 j < kds->ncols ? ' ' : '*', j,
+			 __kds_unpack(cmeta->nullmap_offset),
+			 __kds_unpack(cmeta->nullmap_length),
+			 __kds_unpack(cmeta->values_offset),
+			 __kds_unpack(cmeta->values_length),
+			 __kds_unpack(cmeta->extra_offset),
+			 __kds_unpack(cmeta->extra_length));
+
+	}
+#endif
+}
+
+/*
+ * Routines to decompress the body of compressed RecordBatches
+ *
+ * libzstd and liblz4 are opened on demand, so arrow_fdw has no build time
+ * dependency on them; only the users of compressed files need them.
+ * libsnappy and the LZ4 block format are used by the parquet files only.
+ */
+#define __LZ4F_VERSION		100
+
+static size_t	(*p_ZSTD_decompress)(void *dst, size_t dst_capacity,
+									 const void *src, size_t src_size) = NULL;
+static unsigned	(*p_ZSTD_isError)(size_t code) = NULL;
+static const char *(*p_ZSTD_getErrorName)(size_t code) = NULL;
+static size_t	(*p_LZ4F_createDecompressionContext)(void **p_dctx,
+													 unsigned version) = NULL;
+static size_t	(*p_LZ4F_freeDecompressionContext)(void *dctx) = NULL;
+static size_t	(*p_LZ4F_decompress)(void *dctx,
+									 void *dst, size_t *p_dst_size,
+									 const void *src, size_t *p_src_size,
+									 const void *options) = NULL;
+static unsigned	(*p_LZ4F_isError)(size_t code) = NULL;
+static const char *(*p_LZ4F_getErrorName)(size_t code) = NULL;
+static int		(*p_LZ4_decompress_safe)(const char *src, char *dst,
+										 int src_size, int dst_capacity) = NULL;
+static int		(*p_snappy_uncompress)(const char *src, size_t src_size,
+									   char *dst, size_t *p_dst_size) = NULL;
+
+static void *
+lookup_arrow_codec_function(void *handle, const char *func_name)
+{
+	void   *func_addr = dlsym(handle, func_name);
+
+	if (!func_addr)
+		elog(ERROR, "could not find compression codec symbol \"%s\" - %s",
+			 func_name, dlerror());
+	return func_addr;
+}
+
+#define LOOKUP_CODEC_FUNCTION(func_name)		\
+	p_##func_name = lookup_arrow_codec_function(handle, #func_name)
+
+static void
+arrowFdwLoadCodecLibrary(int codec)
+{
+	static void *zstd_handle = NULL;
+	static void *lz4_handle = NULL;
+	static void *snappy_handle = NULL;
+	void	   *handle;
+
+	if (codec == ArrowCompressionType__ZSTD)
+	{
+		if (zstd_handle)
+			return;
+		handle = dlopen("libzstd.so.1", RTLD_NOW | RTLD_LOCAL);
+		if (!handle)
 		{
-			if (writable && errno == ENOENT)
-				continue;
-			elog(ERROR, "failed to open '%s' on behalf of '%s'",
-				 fname, RelationGetRelationName(relation));
+			handle = dlopen("libzstd.so", RTLD_NOW | RTLD_LOCAL);
+			if (!handle)
+				elog(ERROR, "failed on open 'libzstd.so.1' and 'libzstd.so': %s",
+					 dlerror());
 		}
-		fdescList = lappend_int(fdescList, fdesc);
-
-		/*
-		 * Open file for GPUDirect I/O
-		 */
-		if (gcontext)
+		LOOKUP_CODEC_FUNCTION(ZSTD_decompress);
+		LOOKUP_CODEC_FUNCTION(ZSTD_isError);
+		LOOKUP_CODEC_FUNCTION(ZSTD_getErrorName);
+		zstd_handle = handle;
+	}
+	else if (codec == ArrowCompressionType__LZ4_FRAME ||
+			 codec == __ArrowCompressionType__LZ4_RAW)
+	{
+		if (lz4_handle)
+			return;
+		handle = dlopen("liblz4.so.1", RTLD_NOW | RTLD_LOCAL);
+		if (!handle)
 		{
-			dfile = palloc0(sizeof(GPUDirectFileDesc));
+			handle = dlopen("liblz4.so", RTLD_NOW | RTLD_LOCAL);
+			if (!handle)
+				elog(ERROR, "failed on open 'liblz4.so.1' and 'liblz4.so': %s",
+					 dlerror());
+		}
+		LOOKUP_CODEC_FUNCTION(LZ4F_createDecompressionContext);
+		LOOKUP_CODEC_FUNCTION(LZ4F_freeDecompressionContext);
+		LOOKUP_CODEC_FUNCTION(LZ4F_decompress);
+		LOOKUP_CODEC_FUNCTION(LZ4F_isError);
+		LOOKUP_CODEC_FUNCTION(LZ4F_getErrorName);
+		LOOKUP_CODEC_FUNCTION(LZ4_decompress_safe);
+		lz4_handle = handle;
+	}
+	else if (codec == __ArrowCompressionType__SNAPPY)
+	{
+		if (snappy_handle)
+			return;
+		handle = dlopen("libsnappy.so.1", RTLD_NOW | RTLD_LOCAL);
+		if (!handle)
+		{
+			handle = dlopen("libsnappy.so", RTLD_NOW | RTLD_LOCAL);
+			if (!handle)
+				elog(ERROR, "failed on open 'libsnappy.so.1' and 'libsnappy.so': %s",
+					 dlerror());
+		}
+		LOOKUP_CODEC_FUNCTION(snappy_uncompress);
+		snappy_handle = handle;
+	}
+	else
+		elog(ERROR, "arrow_fdw: unknown compression codec (%d)", codec);
+}
+
+void
+arrowFdwDecompressBuffer(int codec,
+						 char *dst, size_t dst_size,
+						 const char *src, size_t src_size)
+{
+	size_t		rv;
+
+	arrowFdwLoadCodecLibrary(codec);
+	if (codec == ArrowCompressionType__ZSTD)
+	{
+		rv = p_ZSTD_decompress(dst, dst_size, src, src_size);
+		if (p_ZSTD_isError(rv))
+			elog(ERROR, "failed on ZSTD_decompress: %s",
+				 p_ZSTD_getErrorName(rv));
+		if (rv != dst_size)
+			elog(ERROR, "arrow_fdw: ZSTD decompressed length mismatch (%zu of %zu)",
+				 rv, dst_size);
+	}
+	else if (codec == ArrowCompressionType__LZ4_FRAME)
+	{
+		void	   *dctx;
+		size_t		d_pos = 0;
+		size_t		s_pos = 0;
 
-			gpuDirectFileDescOpen(dfile, fdesc);
-			if (!trackRawFileDesc(gcontext, dfile, __FILE__, __LINE__))
+		rv = p_LZ4F_createDecompressionContext(&dctx, __LZ4F_VERSION);
+		if (p_LZ4F_isError(rv))
+			elog(ERROR, "failed on LZ4F_createDecompressionContext: %s",
+				 p_LZ4F_getErrorName(rv));
+		PG_TRY();
+		{
+			while (s_pos < src_size)
 			{
-				gpuDirectFileDescClose(dfile);
-				elog(ERROR, "out of memory");
+				size_t	d_len = dst_size - d_pos;
+				size_t	s_len = src_size - s_pos;
+
+				rv = p_LZ4F_decompress(dctx,
+									   dst + d_pos, &d_len,
+									   src + s_pos, &s_len,
+									   NULL);
+				if (p_LZ4F_isError(rv))
+					elog(ERROR, "failed on LZ4F_decompress: %s",
+						 p_LZ4F_getErrorName(rv));
+				if (d_len == 0 && s_len == 0)
+					elog(ERROR, "arrow_fdw: LZ4 frame is truncated");
+				d_pos += d_len;
+				s_pos += s_len;
 			}
-			gpuDirectFileDescList = lappend(gpuDirectFileDescList, dfile);
+			if (d_pos != dst_size)
+				elog(ERROR, "arrow_fdw: LZ4 decompressed length mismatch (%zu of %zu)",
+					 d_pos, dst_size);
 		}
-
-		rb_cached = arrowLookupOrBuildMetadataCache(fdesc, &stat_attrs);
-		/* check schema compatibility */
-		foreach (cell, rb_cached)
+		PG_CATCH();
 		{
-			RecordBatchState   *rb_state = lfirst(cell);
-
-			if (!arrowSchemaCompatibilityCheck(tupdesc, rb_state))
-				elog(ERROR, "arrow file '%s' on behalf of foreign table '%s' has incompatible schema definition",
-					 fname, RelationGetRelationName(relation));
-			/* GPUDirect I/O state, if any */
-			rb_state->dfile = dfile;
+			p_LZ4F_freeDecompressionContext(dctx);
+			PG_RE_THROW();
 		}
-		rb_state_list = list_concat(rb_state_list, rb_cached);
+		PG_END_TRY();
+		p_LZ4F_freeDecompressionContext(dctx);
 	}
-	num_rbatches = list_length(rb_state_list);
-	af_state = palloc0(offsetof(ArrowFdwState, rbatches[num_rbatches]));
-	af_state->gcontext = gcontext;
-	af_state->gpuDirectFileDescList = gpuDirectFileDescList;
-	af_state->fdescList = fdescList;
-	af_state->referenced = referenced;
-	if (arrow_fdw_stats_hint_enabled)
-		af_state->stats_hint = execInitArrowStatsHint(ss, stat_attrs,
-													  outer_quals);
-	af_state->rbatch_index = &af_state->__rbatch_index_local;
-	af_state->rbatch_nload = &af_state->__rbatch_nload_local;
-	af_state->rbatch_nskip = &af_state->__rbatch_nskip_local;
-	i = 0;
-	foreach (lc, rb_state_list)
-		af_state->rbatches[i++] = (RecordBatchState *)lfirst(lc);
-	af_state->num_rbatches = num_rbatches;
+	else if (codec == __ArrowCompressionType__LZ4_RAW)
+	{
+		int		nbytes;
 
-	return af_state;
+		if (src_size > INT_MAX || dst_size > INT_MAX)
+			elog(ERROR, "arrow_fdw: LZ4 block is too large");
+		nbytes = p_LZ4_decompress_safe(src, dst, src_size, dst_size);
+		if (nbytes < 0)
+			elog(ERROR, "failed on LZ4_decompress_safe: %d", nbytes);
+		if (nbytes != dst_size)
+			elog(ERROR, "arrow_fdw: LZ4 decompressed length mismatch (%d of %zu)",
+				 nbytes, dst_size);
+	}
+	else if (codec == __ArrowCompressionType__SNAPPY)
+	{
+		size_t	d_len = dst_size;
+		int		status;
+
+		status = p_snappy_uncompress(src, src_size, dst, &d_len);
+		if (status != 0)
+			elog(ERROR, "failed on snappy_uncompress: %d", status);
+		if (d_len != dst_size)
+			elog(ERROR, "arrow_fdw: Snappy decompressed length mismatch (%zu of %zu)",
+				 d_len, dst_size);
+	}
+	else
+		elog(ERROR, "arrow_fdw: unknown compression codec (%d)", codec);
 }
 
 /*
- * ArrowBeginForeignScan
+ * arrowFdwUpdateIoStats
+ *
+ * It accumulates the number of read requests and length of read, towards
+ * the length of the buffers actually referenced, for EXPLAIN ANALYZE.
  */
+static size_t
+__RecordBatchFieldUsage(RecordBatchFieldState *fstate)
+{
+	size_t	len;
+	int		j;
+
+	len = (fstate->nullmap_length +
+		   fstate->values_length +
+		   fstate->extra_length);
+	for (j=0; j < fstate->num_children; j++)
+		len += __RecordBatchFieldUsage(&fstate->children[j]);
+	return len;
+}
+
 static void
-ArrowBeginForeignScan(ForeignScanState *node, int eflags)
+arrowFdwUpdateIoStats(ArrowFdwIoStats *io_stats,
+					  RecordBatchState *rb_state,
+					  Bitmapset *referenced,
+					  uint64 nr_reads,
+					  uint64 read_bytes)
 {
-	Relation		relation = node->ss.ss_currentRelation;
-	TupleDesc		tupdesc = RelationGetDescr(relation);
-	ForeignScan	   *fscan = (ForeignScan *) node->ss.ps.plan;
-	ListCell	   *lc;
-	Bitmapset	   *referenced = NULL;
+	uint64		used_bytes = 0;
+	int			j;
 
-	foreach (lc, fscan->fdw_private)
+	if (!io_stats)
+		return;
+	for (j=0; j < rb_state->ncols; j++)
 	{
-		int		j = lfirst_int(lc);
+		int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
 
-		if (j >= 0 && j <= tupdesc->natts)
-			referenced = bms_add_member(referenced, j -
-										FirstLowInvalidHeapAttributeNumber);
+		if (referenced && bms_is_member(attidx, referenced))
+			used_bytes += __RecordBatchFieldUsage(&rb_state->columns[j]);
 	}
-	node->fdw_state = ExecInitArrowFdw(&node->ss,
-									   NULL,
-									   fscan->scan.plan.qual,
-									   referenced);
+	pg_atomic_fetch_add_u64(&io_stats->nr_reads, nr_reads);
+	pg_atomic_fetch_add_u64(&io_stats->read_bytes, read_bytes);
+	pg_atomic_fetch_add_u64(&io_stats->used_bytes, used_bytes);
 }
 
+/*
+ * arrowFdwSetupHostBuffer
+ *
+ * Compressed or dictionary-encoded RecordBatches, and parquet row-groups
+ * never match the layout of the KDS, so they are read by the filesystem
+ * and built on the host side.
+ * Each buffer of the compressed RecordBatch begins with int64 uncompressed
+ * length, or -1 if this buffer is not compressed actually.
+ */
+typedef struct
+{
+	off_t		f_pos;		/* file position of the buffer */
+	size_t		f_len;		/* length of the buffer on the file */
+	size_t		m_offset;	/* destination offset from the KDS head */
+	size_t		raw_len;	/* length of the uncompressed buffer */
+	bool		compressed;
+	char	   *image;		/* already built on the host memory, if any */
+} arrowFdwHostChunk;
+
 typedef struct
 {
+	int			fdesc;
+	int			codec;		/* ArrowCompressionType, or -1 if none */
+	bool		parquet;	/* true, if parquet row-group */
 	off_t		rb_offset;
-	off_t		f_offset;
-	off_t		m_offset;
-	cl_int		io_index;
-	cl_int      depth;
-	strom_io_chunk ioc[FLEXIBLE_ARRAY_MEMBER];
-} arrowFdwSetupIOContext;
+	size_t		m_offset;
+	uint64		nr_reads;	/* # of read requests, for statistics */
+	uint64		read_bytes;	/* length of read, for statistics */
+	int			nchunks;
+	arrowFdwHostChunk chunks[FLEXIBLE_ARRAY_MEMBER];
+} arrowFdwHostContext;
 
-/*
- * arrowFdwSetupIOvectorField
- */
 static void
-__setupIOvectorField(arrowFdwSetupIOContext *con,
-					 off_t chunk_offset,
-					 size_t chunk_length,
-					 cl_uint *p_cmeta_offset,
-					 cl_uint *p_cmeta_length)
+__lookupHostChunk(int fdesc, int codec,
+				  off_t f_pos, size_t f_len,
+				  arrowFdwHostChunk *hchunk)
 {
-	off_t		f_pos = con->rb_offset + chunk_offset;
-	size_t		__length = MAXALIGN(chunk_length);
-
-	Assert((con->m_offset & (MAXIMUM_ALIGNOF - 1)) == 0);
+	int64		raw_len;
 
-	if (f_pos == con->f_offset)
+	memset(hchunk, 0, sizeof(arrowFdwHostChunk));
+	if (codec < 0)
 	{
-		/* good, buffer is fully continuous */
-		*p_cmeta_offset = __kds_packed(con->m_offset);
-		*p_cmeta_length = __kds_packed(__length);
+		hchunk->f_pos = f_pos;
+		hchunk->f_len = f_len;
+		hchunk->raw_len = f_len;
+		hchunk->compressed = false;
+		return;
+	}
+	if (f_len < sizeof(int64))
+		elog(ERROR, "arrow_fdw: compressed buffer is too short");
+	if (__preadFile(fdesc, &raw_len, sizeof(int64),
+					f_pos) != sizeof(int64))
+		elog(ERROR, "failed on pread(2): %m");
+	hchunk->f_pos = f_pos + sizeof(int64);
+	hchunk->f_len = f_len - sizeof(int64);
+	if (raw_len == -1)
+	{
+		hchunk->raw_len = hchunk->f_len;
+		hchunk->compressed = false;
+	}
+	else if (raw_len >= 0)
+	{
+		hchunk->raw_len = raw_len;
+		hchunk->compressed = true;
+	}
+	else
+		elog(ERROR, "arrow_fdw: compressed buffer has corrupted length");
+}
 
-		con->m_offset += __length;
-		con->f_offset += __length;
+static void
+__readHostChunk(int fdesc, int codec,
+				arrowFdwHostChunk *hchunk, char *dest)
+{
+	CHECK_FOR_INTERRUPTS();
+	if (!hchunk->compressed)
+	{
+		if (__preadFile(fdesc, dest, hchunk->f_len,
+						hchunk->f_pos) != hchunk->f_len)
+			elog(ERROR, "failed on pread(2): %m");
 	}
-	else if (f_pos > con->f_offset &&
-			 (f_pos & ~PAGE_MASK) == (con->f_offset & ~PAGE_MASK) &&
-			 ((f_pos - con->f_offset) & (MAXIMUM_ALIGNOF-1)) == 0)
+	else
 	{
-		/*
-		 * we can also consolidate the i/o of two chunks, if file position
-		 * of the next chunk (f_pos) and the current file tail position
-		 * (con->f_offset) locate within the same file page, and if gap bytes
-		 * on the file does not break alignment.
-		 */
-		size_t	__gap = (f_pos - con->f_offset);
+		char   *zbuf = MemoryContextAllocHuge(CurrentMemoryContext,
+											  hchunk->f_len);
 
-		/* put gap bytes */
-		Assert(__gap < PAGE_SIZE);
-		con->m_offset += __gap;
-		con->f_offset += __gap;
+		if (__preadFile(fdesc, zbuf, hchunk->f_len,
+						hchunk->f_pos) != hchunk->f_len)
+			elog(ERROR, "failed on pread(2): %m");
+		arrowFdwDecompressBuffer(codec,
+								 dest, hchunk->raw_len,
+								 zbuf, hchunk->f_len);
+		pfree(zbuf);
+	}
+}
 
-		*p_cmeta_offset = __kds_packed(con->m_offset);
-		*p_cmeta_length = __kds_packed(__length);
+/*
+ * __arrowFdwReadBuffer - read a buffer onto the private host memory
+ */
+static char *
+__arrowFdwReadBuffer(int fdesc, int codec,
+					 off_t f_pos, size_t f_len, size_t *p_length)
+{
+	arrowFdwHostChunk hchunk;
+	char	   *buffer;
 
-		con->m_offset += __length;
-		con->f_offset += __length;
+	__lookupHostChunk(fdesc, codec, f_pos, f_len, &hchunk);
+	buffer = MemoryContextAllocHuge(CurrentMemoryContext,
+									MAXALIGN(hchunk.raw_len) + 1);
+	__readHostChunk(fdesc, codec, &hchunk, buffer);
+	*p_length = hchunk.raw_len;
+
+	return buffer;
+}
+
+static void
+__setupHostChunk(arrowFdwHostContext *con,
+				 arrowFdwHostChunk *hchunk,
+				 cl_uint *p_cmeta_offset,
+				 cl_uint *p_cmeta_length)
+{
+	hchunk->m_offset = con->m_offset;
+	*p_cmeta_offset = __kds_packed(con->m_offset);
+	*p_cmeta_length = __kds_packed(MAXALIGN(hchunk->raw_len));
+	con->m_offset += MAXALIGN(hchunk->raw_len);
+	con->nchunks++;
+}
+
+static void
+__setupHostField(arrowFdwHostContext *con,
+				 off_t chunk_offset,
+				 size_t chunk_length,
+				 cl_uint *p_cmeta_offset,
+				 cl_uint *p_cmeta_length)
+{
+	arrowFdwHostChunk *hchunk = &con->chunks[con->nchunks];
+
+	__lookupHostChunk(con->fdesc, con->codec,
+					  con->rb_offset + chunk_offset,
+					  chunk_length, hchunk);
+	__setupHostChunk(con, hchunk, p_cmeta_offset, p_cmeta_length);
+}
+
+static void
+__setupHostImage(arrowFdwHostContext *con,
+				 char *image, size_t length,
+				 cl_uint *p_cmeta_offset,
+				 cl_uint *p_cmeta_length)
+{
+	arrowFdwHostChunk *hchunk = &con->chunks[con->nchunks];
+
+	memset(hchunk, 0, sizeof(arrowFdwHostChunk));
+	hchunk->raw_len = length;
+	hchunk->image = image;
+	__setupHostChunk(con, hchunk, p_cmeta_offset, p_cmeta_length);
+}
+
+static inline int64
+__fetchDictionaryIndex(const char *indexes, int width, int64 i)
+{
+	switch (width)
+	{
+		case sizeof(int8):
+			return ((const int8 *)indexes)[i];
+		case sizeof(int16):
+			return ((const int16 *)indexes)[i];
+		case sizeof(int32):
+			return ((const int32 *)indexes)[i];
+		default:
+			return ((const int64 *)indexes)[i];
+	}
+}
+
+/*
+ * arrowFdwSetupHostDictionary
+ *
+ * It decodes the indexes of dictionary-encoded field with its dictionary,
+ * to the usual layout of the value type.
+ */
+static void
+arrowFdwSetupHostDictionary(arrowFdwHostContext *con,
+							RecordBatchFieldState *fstate,
+							kern_colmeta *cmeta)
+{
+	int64		nitems = fstate->nitems;
+	int64		d_nitems = fstate->dict_nitems;
+	int			width = fstate->dict_index_width;
+	int			unitsz = fstate->dict_unitsz;
+	uint8	   *nullmap = NULL;
+	char	   *indexes;
+	uint8	   *d_nullmap = NULL;
+	char	   *d_values;
+	char	   *d_extra = NULL;
+	size_t		len, d_extra_len = 0;
+	uint8	   *r_nullmap = NULL;
+	char	   *r_values;
+	char	   *r_extra = NULL;
+	size_t		r_values_len;
+	size_t		r_extra_len = 0;
+	int64		i, k;
+
+	/* read the nullmap and indexes from the RecordBatch */
+	if (fstate->nullmap_length > 0)
+	{
+		nullmap = (uint8 *)
+			__arrowFdwReadBuffer(con->fdesc, con->codec,
+								 con->rb_offset + fstate->nullmap_offset,
+								 fstate->nullmap_length, &len);
+		if (len < BITMAPLEN(nitems))
+			elog(ERROR, "nullmap length is smaller than expected");
+	}
+	indexes = __arrowFdwReadBuffer(con->fdesc, con->codec,
+								   con->rb_offset + fstate->values_offset,
+								   fstate->values_length, &len);
+	if (len < width * nitems)
+		elog(ERROR, "dictionary index array is smaller than expected");
+
+	/* read the dictionary from the DictionaryBatch */
+	if (fstate->dict_nullmap_length > 0)
+	{
+		d_nullmap = (uint8 *)
+			__arrowFdwReadBuffer(con->fdesc, fstate->dict_codec,
+								 fstate->dict_nullmap_offset,
+								 fstate->dict_nullmap_length, &len);
+		if (len < BITMAPLEN(d_nitems))
+			elog(ERROR, "dictionary nullmap is smaller than expected");
+	}
+	d_values = __arrowFdwReadBuffer(con->fdesc, fstate->dict_codec,
+									fstate->dict_values_offset,
+									fstate->dict_values_length, &len);
+	if (unitsz > 0)
+	{
+		if (len < unitsz * d_nitems)
+			elog(ERROR, "dictionary values array is smaller than expected");
+		r_values_len = unitsz * nitems;
 	}
 	else
 	{
-		/*
-		 * Elsewhere, we have no chance to consolidate this chunk to
-		 * the previous i/o-chunk. So, make a new i/o-chunk.
-		 */
-		off_t		f_base = TYPEALIGN_DOWN(PAGE_SIZE, f_pos);
-		off_t		f_tail;
-		off_t		shift = f_pos - f_base;
-		strom_io_chunk *ioc;
-
-		if (con->io_index < 0)
-			con->io_index = 0;	/* no previous i/o chunks */
+		if (len < sizeof(cl_uint) * (d_nitems + 1))
+			elog(ERROR, "dictionary offset array is smaller than expected");
+		if (fstate->dict_extra_length > 0)
+			d_extra = __arrowFdwReadBuffer(con->fdesc, fstate->dict_codec,
+										   fstate->dict_extra_offset,
+										   fstate->dict_extra_length,
+										   &d_extra_len);
+		r_values_len = sizeof(cl_uint) * (nitems + 1);
+	}
+
+	/* decode the indexes */
+	if (nullmap || d_nullmap)
+		r_nullmap = palloc0(BITMAPLEN(nitems));
+	r_values = MemoryContextAllocHuge(CurrentMemoryContext, r_values_len);
+	memset(r_values, 0, r_values_len);
+	for (i=0; i < nitems; i++)
+	{
+		if (unitsz == 0)
+			((cl_uint *)r_values)[i+1] = r_extra_len;
+		if (nullmap && (nullmap[i>>3] & (1<<(i&7))) == 0)
+			continue;
+		k = __fetchDictionaryIndex(indexes, width, i);
+		if (k < 0 || k >= d_nitems)
+			elog(ERROR, "arrow_fdw: dictionary index (%ld) is out of range",
+				 k);
+		if (d_nullmap && (d_nullmap[k>>3] & (1<<(k&7))) == 0)
+			continue;
+		if (r_nullmap)
+			r_nullmap[i>>3] |= (1<<(i&7));
+		if (unitsz > 0)
+			memcpy(r_values + unitsz * i, d_values + unitsz * k, unitsz);
 		else
 		{
-			ioc = &con->ioc[con->io_index++];
+			cl_uint	   *d_offset = (cl_uint *)d_values;
+
+			if (d_offset[k] > d_offset[k+1] ||
+				d_offset[k+1] > d_extra_len)
+				elog(ERROR, "arrow_fdw: dictionary may have corruption");
+			r_extra_len += d_offset[k+1] - d_offset[k];
+			if (r_extra_len > INT_MAX)
+				elog(ERROR, "arrow_fdw: decoded dictionary is too large");
+			((cl_uint *)r_values)[i+1] = r_extra_len;
+		}
+	}
+	if (unitsz == 0 && r_extra_len > 0)
+	{
+		cl_uint	   *d_offset = (cl_uint *)d_values;
+		cl_uint	   *r_offset = (cl_uint *)r_values;
 
-			f_tail = TYPEALIGN(PAGE_SIZE, con->f_offset);
-			ioc->nr_pages = f_tail / PAGE_SIZE - ioc->fchunk_id;
-			con->m_offset += (f_tail - con->f_offset); //safety margin;
+		r_extra = MemoryContextAllocHuge(CurrentMemoryContext, r_extra_len);
+		for (i=0; i < nitems; i++)
+		{
+			if (r_offset[i] == r_offset[i+1])
+				continue;
+			k = __fetchDictionaryIndex(indexes, width, i);
+			memcpy(r_extra + r_offset[i],
+				   d_extra + d_offset[k],
+				   r_offset[i+1] - r_offset[i]);
 		}
-		ioc = &con->ioc[con->io_index];
-		/* adjust position if con->m_offset is not aligned well */
-		if (con->m_offset + shift != MAXALIGN(con->m_offset + shift))
-			con->m_offset = MAXALIGN(con->m_offset + shift) - shift;
-		ioc->m_offset   = con->m_offset;
-		ioc->fchunk_id  = f_base / PAGE_SIZE;
+	}
 
-		*p_cmeta_offset = __kds_packed(con->m_offset + shift);
-		*p_cmeta_length = __kds_packed(__length);
+	if (r_nullmap)
+		__setupHostImage(con, (char *)r_nullmap, BITMAPLEN(nitems),
+						 &cmeta->nullmap_offset,
+						 &cmeta->nullmap_length);
+	__setupHostImage(con, r_values, r_values_len,
+					 &cmeta->values_offset,
+					 &cmeta->values_length);
+	if (r_extra)
+		__setupHostImage(con, r_extra, r_extra_len,
+						 &cmeta->extra_offset,
+						 &cmeta->extra_length);
+	if (nullmap)
+		pfree(nullmap);
+	pfree(indexes);
+	if (d_nullmap)
+		pfree(d_nullmap);
+	pfree(d_values);
+	if (d_extra)
+		pfree(d_extra);
+}
 
-		con->m_offset  += shift + __length;
-		con->f_offset   = f_pos + __length;
-	}
+/*
+ * arrowFdwSetupHostParquet
+ *
+ * It decodes the pages of a parquet column chunk to the arrow layout.
+ */
+static void
+arrowFdwSetupHostParquet(arrowFdwHostContext *con,
+						 RecordBatchFieldState *fstate,
+						 kern_colmeta *cmeta)
+{
+	char	   *nullmap;
+	char	   *values;
+	char	   *extra;
+	size_t		nullmap_len;
+	size_t		values_len;
+	size_t		extra_len;
+
+	parquetReadColumnChunk(con->fdesc,
+						   &fstate->pq_chunk,
+						   fstate->nitems,
+						   &nullmap, &nullmap_len,
+						   &values, &values_len,
+						   &extra, &extra_len);
+	con->nr_reads++;
+	con->read_bytes += fstate->pq_chunk.chunk_length;
+	if (nullmap)
+		__setupHostImage(con, nullmap, nullmap_len,
+						 &cmeta->nullmap_offset,
+						 &cmeta->nullmap_length);
+	__setupHostImage(con, values, values_len,
+					 &cmeta->values_offset,
+					 &cmeta->values_length);
+	if (extra)
+		__setupHostImage(con, extra, extra_len,
+						 &cmeta->extra_offset,
+						 &cmeta->extra_length);
 }
 
+/*
+ * arrowFdwSetupHostPartition
+ *
+ * It builds the arrow layout of the partition column; all the items have
+ * the value on the path.
+ */
 static void
-arrowFdwSetupIOvectorField(arrowFdwSetupIOContext *con,
+arrowFdwSetupHostPartition(arrowFdwHostContext *con,
 						   RecordBatchFieldState *fstate,
-						   kern_data_store *kds,
 						   kern_colmeta *cmeta)
 {
-	//int		index = cmeta - kds->colmeta;
+	int64		i, nitems = fstate->nitems;
+	char	   *values;
+	size_t		values_len;
+	Oid			typinput;
+	Oid			typioparam;
+	Datum		datum;
 
-	if (fstate->nullmap_length > 0)
+	if (!fstate->part_value)
+	{
+		/* all-null; values shall never be referenced */
+		__setupHostImage(con, palloc0(BITMAPLEN(nitems)), BITMAPLEN(nitems),
+						 &cmeta->nullmap_offset,
+						 &cmeta->nullmap_length);
+		values_len = (fstate->atttypid == TEXTOID
+					  ? sizeof(uint32) * (nitems + 1)
+					  : sizeof(int64) * nitems);
+		__setupHostImage(con, palloc0(values_len), values_len,
+						 &cmeta->values_offset,
+						 &cmeta->values_length);
+		return;
+	}
+	getTypeInputInfo(fstate->atttypid, &typinput, &typioparam);
+	datum = OidInputFunctionCall(typinput, fstate->part_value,
+								 typioparam, fstate->atttypmod);
+
+	switch (fstate->atttypid)
 	{
-		Assert(fstate->null_count > 0);
-		__setupIOvectorField(con,
-							 fstate->nullmap_offset,
-							 fstate->nullmap_length,
-							 &cmeta->nullmap_offset,
-							 &cmeta->nullmap_length);
-		//elog(INFO, "D%d att[%d] nullmap=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->nullmap_offset, fstate->nullmap_length, con->m_offset, con->f_offset);
+		case INT2OID:
+			values_len = sizeof(int16) * nitems;
+			values = MemoryContextAllocHuge(CurrentMemoryContext, values_len);
+			for (i=0; i < nitems; i++)
+				((int16 *)values)[i] = DatumGetInt16(datum);
+			break;
+		case INT4OID:
+			values_len = sizeof(int32) * nitems;
+			values = MemoryContextAllocHuge(CurrentMemoryContext, values_len);
+			for (i=0; i < nitems; i++)
+				((int32 *)values)[i] = DatumGetInt32(datum);
+			break;
+		case INT8OID:
+			values_len = sizeof(int64) * nitems;
+			values = MemoryContextAllocHuge(CurrentMemoryContext, values_len);
+			for (i=0; i < nitems; i++)
+				((int64 *)values)[i] = DatumGetInt64(datum);
+			break;
+		case DATEOID:
+			/* Arrow::Date[unit=Day] on UNIX epoch */
+			values_len = sizeof(int32) * nitems;
+			values = MemoryContextAllocHuge(CurrentMemoryContext, values_len);
+			for (i=0; i < nitems; i++)
+				((int32 *)values)[i] = (DatumGetDateADT(datum) +
+										(POSTGRES_EPOCH_JDATE -
+										 UNIX_EPOCH_JDATE));
+			break;
+		case TEXTOID:
+			{
+				text   *t = DatumGetTextPP(datum);
+				char   *extra;
+				size_t	len = VARSIZE_ANY_EXHDR(t);
+				size_t	extra_len = len * nitems;
+
+				if (extra_len > UINT_MAX)
+					elog(ERROR, "arrow_fdw: partition value is too large");
+				values_len = sizeof(uint32) * (nitems + 1);
+				values = MemoryContextAllocHuge(CurrentMemoryContext,
+												values_len);
+				for (i=0; i <= nitems; i++)
+					((uint32 *)values)[i] = len * i;
+				if (extra_len > 0)
+				{
+					extra = MemoryContextAllocHuge(CurrentMemoryContext,
+												   extra_len);
+					for (i=0; i < nitems; i++)
+						memcpy(extra + len * i, VARDATA_ANY(t), len);
+					__setupHostImage(con, extra, extra_len,
+									 &cmeta->extra_offset,
+									 &cmeta->extra_length);
+				}
+			}
+			break;
+		default:
+			elog(ERROR, "Bug? unexpected partition column type: %s",
+				 format_type_be(fstate->atttypid));
 	}
-	if (fstate->values_length > 0)
+	__setupHostImage(con, values, values_len,
+					 &cmeta->values_offset,
+					 &cmeta->values_length);
+}
+
+static void
+arrowFdwSetupHostField(arrowFdwHostContext *con,
+					   RecordBatchFieldState *fstate,
+					   kern_data_store *kds,
+					   kern_colmeta *cmeta)
+{
+	if (fstate->part_column)
 	{
-		__setupIOvectorField(con,
-							 fstate->values_offset,
-							 fstate->values_length,
-							 &cmeta->values_offset,
-							 &cmeta->values_length);
-		//elog(INFO, "D%d att[%d] values=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->values_offset, fstate->values_length, con->m_offset, con->f_offset);
+		arrowFdwSetupHostPartition(con, fstate, cmeta);
+		return;
+	}
+	if (con->parquet)
+	{
+		arrowFdwSetupHostParquet(con, fstate, cmeta);
+		return;
 	}
-	if (fstate->extra_length > 0)
+	if (fstate->dict_index_width > 0)
 	{
-		__setupIOvectorField(con,
-							 fstate->extra_offset,
-							 fstate->extra_length,
-							 &cmeta->extra_offset,
-							 &cmeta->extra_length);
-		//elog(INFO, "D%d att[%d] extra=%lu,%lu m_offset=%lu f_offset=%lu", con->depth, index, fstate->extra_offset, fstate->extra_length, con->m_offset, con->f_offset);
+		arrowFdwSetupHostDictionary(con, fstate, cmeta);
+		return;
+	}
+	if (fstate->nullmap_length > 0)
+	{
+		Assert(fstate->null_count > 0);
+		__setupHostField(con,
+						 fstate->nullmap_offset,
+						 fstate->nullmap_length,
+						 &cmeta->nullmap_offset,
+						 &cmeta->nullmap_length);
 	}
+	if (fstate->values_length > 0)
+		__setupHostField(con,
+						 fstate->values_offset,
+						 fstate->values_length,
+						 &cmeta->values_offset,
+						 &cmeta->values_length);
+	if (fstate->extra_length > 0)
+		__setupHostField(con,
+						 fstate->extra_offset,
+						 fstate->extra_length,
+						 &cmeta->extra_offset,
+						 &cmeta->extra_length);
 
 	/* nested sub-fields if composite types */
 	if (cmeta->atttypkind == TYPE_KIND__ARRAY ||
@@ -1986,38 +5062,43 @@ arrowFdwSetupIOvectorField(arrowFdwSetupIOContext *con,
 		int		j;
 
 		Assert(fstate->num_children == cmeta->num_subattrs);
-		con->depth++;
 		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
 			 j < cmeta->num_subattrs;
 			 j++, subattr++)
 		{
-			RecordBatchFieldState *child = &fstate->children[j];
-
-			arrowFdwSetupIOvectorField(con, child, kds, subattr);
+			arrowFdwSetupHostField(con, &fstate->children[j],
+								   kds, subattr);
 		}
-		con->depth--;
 	}
 }
 
 /*
- * arrowFdwSetupIOvector
+ * __arrowFdwLoadRecordBatchByHost
  */
-static strom_io_vector *
-arrowFdwSetupIOvector(kern_data_store *kds,
-					  RecordBatchState *rb_state,
-					  Bitmapset *referenced)
-{
-	arrowFdwSetupIOContext *con;
-	strom_io_vector *iovec = NULL;
-	int			j, nr_chunks = 0;
+static pgstrom_data_store *
+__arrowFdwLoadRecordBatchByHost(RecordBatchState *rb_state,
+								kern_data_store *kds,
+								Bitmapset *referenced,
+								GpuContext *gcontext,
+								MemoryContext mcontext,
+								ArrowFdwIoStats *io_stats)
+{
+	arrowFdwHostContext *con;
+	pgstrom_data_store *pds;
+	size_t		head_sz = KERN_DATA_STORE_HEAD_LENGTH(kds);
+	int			j;
+	CUresult	rc;
 
-	Assert(kds->nr_colmeta >= kds->ncols);
-	con = alloca(offsetof(arrowFdwSetupIOContext,
-						  ioc[3 * kds->nr_colmeta]));
+	con = palloc(offsetof(arrowFdwHostContext,
+						  chunks[3 * kds->nr_colmeta]));
+	con->fdesc     = FileGetRawDesc(rb_state->fdesc);
+	con->codec     = rb_state->rb_codec;
+	con->parquet   = rb_state->rb_parquet;
 	con->rb_offset = rb_state->rb_offset;
-	con->f_offset  = ~0UL;	/* invalid offset */
-	con->m_offset  = TYPEALIGN(PAGE_SIZE, KERN_DATA_STORE_HEAD_LENGTH(kds));
-	con->io_index  = -1;
+	con->m_offset  = TYPEALIGN(PAGE_SIZE, head_sz);
+	con->nr_reads  = 0;
+	con->read_bytes = 0;
+	con->nchunks   = 0;
 	for (j=0; j < kds->ncols; j++)
 	{
 		RecordBatchFieldState *fstate = &rb_state->columns[j];
@@ -2025,69 +5106,252 @@ arrowFdwSetupIOvector(kern_data_store *kds,
 		int			attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
 
 		if (referenced && bms_is_member(attidx, referenced))
-			arrowFdwSetupIOvectorField(con, fstate, kds, cmeta);
+			arrowFdwSetupHostField(con, fstate, kds, cmeta);
 		else
 			cmeta->atttypkind = TYPE_KIND__NULL;	/* unreferenced */
 	}
-	if (con->io_index >= 0)
+	kds->length = con->m_offset;
+
+	if (gcontext)
 	{
-		/* close the last I/O chunks */
-		strom_io_chunk *ioc = &con->ioc[con->io_index];
+		rc = gpuMemAllocManaged(gcontext,
+								(CUdeviceptr *)&pds,
+								offsetof(pgstrom_data_store,
+										 kds) + kds->length,
+								CU_MEM_ATTACH_GLOBAL);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	}
+	else
+	{
+		pds = MemoryContextAllocHuge(mcontext,
+									 offsetof(pgstrom_data_store,
+											  kds) + kds->length);
+	}
+	memset(pds, 0, offsetof(pgstrom_data_store, kds));
+	pds->gcontext = gcontext;
+	pg_atomic_init_u32(&pds->refcnt, 1);
+	pds->nblocks_uncached = 0;
+	pds->filedesc.rawfd = -1;
+	pds->iovec = NULL;
+	memcpy(&pds->kds, kds, head_sz);
 
-		ioc->nr_pages = (TYPEALIGN(PAGE_SIZE, con->f_offset) / PAGE_SIZE -
-						 ioc->fchunk_id);
-		con->m_offset = ioc->m_offset + PAGE_SIZE * ioc->nr_pages;
-		nr_chunks = con->io_index + 1;
+	for (j=0; j < con->nchunks; j++)
+	{
+		arrowFdwHostChunk *hchunk = &con->chunks[j];
+		char	   *dest = (char *)&pds->kds + hchunk->m_offset;
+
+		if (hchunk->image)
+		{
+			memcpy(dest, hchunk->image, hchunk->raw_len);
+			pfree(hchunk->image);
+		}
+		else
+		{
+			__readHostChunk(con->fdesc, con->codec, hchunk, dest);
+			con->nr_reads++;
+			con->read_bytes += hchunk->f_len;
+		}
+		/* clear the padding area */
+		memset(dest + hchunk->raw_len, 0,
+			   MAXALIGN(hchunk->raw_len) - hchunk->raw_len);
 	}
-	kds->length = con->m_offset;
+	arrowFdwUpdateIoStats(io_stats, rb_state, referenced,
+						  con->nr_reads, con->read_bytes);
+	pfree(con);
 
-	iovec = palloc0(offsetof(strom_io_vector, ioc[nr_chunks]));
-	iovec->nr_chunks = nr_chunks;
-	if (nr_chunks > 0)
-		memcpy(iovec->ioc, con->ioc, sizeof(strom_io_chunk) * nr_chunks);
-	return iovec;
+	return pds;
 }
 
 /*
- * __dump_kds_and_iovec - just for debug
+ * __arrowFdwLoadRecordBatchByMmap
+ *
+ * CPU scan on the uncompressed RecordBatch maps the file onto the tail of
+ * an anonymous region, next to the PDS/KDS header. Then, KDS refers the
+ * page cache directly, without memcpy and private memory consumption.
+ * It returns NULL, if buffer layout cannot be referenced as is.
  */
-static inline void
-__dump_kds_and_iovec(kern_data_store *kds, strom_io_vector *iovec)
+typedef struct
 {
-#if 0
-	int		j;
+	MemoryContextCallback cb;
+	void	   *mmap_addr;
+	size_t		mmap_length;
+} arrowFdwMmapHolder;
 
-	elog(INFO, "nchunks = %d", iovec->nr_chunks);
-	for (j=0; j < iovec->nr_chunks; j++)
+static void
+__arrowFdwMmapHolderCallback(void *arg)
+{
+	arrowFdwMmapHolder *holder = arg;
+
+	if (holder->mmap_addr)
 	{
-		strom_io_chunk *ioc = &iovec->ioc[j];
+		if (munmap(holder->mmap_addr, holder->mmap_length) != 0)
+			elog(WARNING, "failed on munmap: %m");
+		holder->mmap_addr = NULL;
+	}
+}
 
-		elog(INFO, "io[%d] [ m_offset=%lu, f_read=%lu...%lu, nr_pages=%u}",
-			 j,
-			 ioc->m_offset,
-			 ioc->fchunk_id * PAGE_SIZE,
-			 (ioc->fchunk_id + ioc->nr_pages) * PAGE_SIZE,
-			 ioc->nr_pages);
+void
+arrowFdwReleaseMmapPDS(pgstrom_data_store *pds)
+{
+	arrowFdwMmapHolder *holder = pds->mmap_holder;
+
+	Assert(holder->mmap_addr == (void *)pds);
+	__arrowFdwMmapHolderCallback(holder);
+}
+
+static bool
+__setupMmapField(off_t m_base,
+				 off_t chunk_offset,
+				 size_t chunk_length,
+				 cl_uint *p_cmeta_offset,
+				 cl_uint *p_cmeta_length)
+{
+	off_t		m_offset = m_base + chunk_offset;
+
+	if ((m_offset & (MAXIMUM_ALIGNOF - 1)) != 0)
+		return false;
+	*p_cmeta_offset = __kds_packed(m_offset);
+	*p_cmeta_length = __kds_packed(MAXALIGN(chunk_length));
+	return true;
+}
+
+static bool
+arrowFdwSetupMmapField(off_t m_base,
+					   RecordBatchFieldState *fstate,
+					   kern_data_store *kds,
+					   kern_colmeta *cmeta)
+{
+	if (fstate->nullmap_length > 0)
+	{
+		Assert(fstate->null_count > 0);
+		if (!__setupMmapField(m_base,
+							  fstate->nullmap_offset,
+							  fstate->nullmap_length,
+							  &cmeta->nullmap_offset,
+							  &cmeta->nullmap_length))
+			return false;
+	}
+	if (fstate->values_length > 0)
+	{
+		if (!__setupMmapField(m_base,
+							  fstate->values_offset,
+							  fstate->values_length,
+							  &cmeta->values_offset,
+							  &cmeta->values_length))
+			return false;
+	}
+	if (fstate->extra_length > 0)
+	{
+		if (!__setupMmapField(m_base,
+							  fstate->extra_offset,
+							  fstate->extra_length,
+							  &cmeta->extra_offset,
+							  &cmeta->extra_length))
+			return false;
 	}
 
-	elog(INFO, "kds {length=%zu nitems=%u typeid=%u typmod=%u table_oid=%u}",
-		 kds->length, kds->nitems,
-		 kds->tdtypeid, kds->tdtypmod, kds->table_oid);
-	for (j=0; j < kds->nr_colmeta; j++)
+	/* nested sub-fields if composite types */
+	if (cmeta->atttypkind == TYPE_KIND__ARRAY ||
+		cmeta->atttypkind == TYPE_KIND__COMPOSITE)
 	{
-		kern_colmeta *cmeta = &kds->colmeta[j];
+		kern_colmeta *subattr;
+		int		j;
 
-		elog(INFO, "%ccol[%d] nullmap=%lu,%lu values=%lu,%lu extra=%lu,%lu",
-			 j < kds->ncols ? ' ' : '*', j,
-			 __kds_unpack(cmeta->nullmap_offset),
-			 __kds_unpack(cmeta->nullmap_length),
-			 __kds_unpack(cmeta->values_offset),
-			 __kds_unpack(cmeta->values_length),
-			 __kds_unpack(cmeta->extra_offset),
-			 __kds_unpack(cmeta->extra_length));
+		Assert(fstate->num_children == cmeta->num_subattrs);
+		for (j=0, subattr = &kds->colmeta[cmeta->idx_subattrs];
+			 j < cmeta->num_subattrs;
+			 j++, subattr++)
+		{
+			if (!arrowFdwSetupMmapField(m_base, &fstate->children[j],
+										kds, subattr))
+				return false;
+		}
+	}
+	return true;
+}
+
+static pgstrom_data_store *
+__arrowFdwLoadRecordBatchByMmap(RecordBatchState *rb_state,
+								kern_data_store *kds,
+								Bitmapset *referenced,
+								MemoryContext mcontext,
+								ArrowFdwIoStats *io_stats)
+{
+	arrowFdwMmapHolder *holder;
+	pgstrom_data_store *pds;
+	size_t		head_sz = KERN_DATA_STORE_HEAD_LENGTH(kds);
+	size_t		head_len;
+	off_t		map_off;
+	size_t		map_len;
+	off_t		m_base;
+	char	   *addr;
+	int			j;
+
+	/*
+	 * The anonymous region consists of the PDS/KDS header, then, the file
+	 * range that contains the RecordBatch follows on the page boundary.
+	 */
+	head_len = TYPEALIGN(PAGE_SIZE, offsetof(pgstrom_data_store,
+											 kds) + head_sz);
+	map_off = TYPEALIGN_DOWN(PAGE_SIZE, rb_state->rb_offset);
+	map_len = TYPEALIGN(PAGE_SIZE, (rb_state->rb_offset +
+									rb_state->rb_length)) - map_off;
+	m_base = (head_len - offsetof(pgstrom_data_store, kds) +
+			  (rb_state->rb_offset - map_off));
+	kds->length = head_len - offsetof(pgstrom_data_store, kds) + map_len;
+	if (kds->length > KDS_OFFSET_MAX_SIZE)
+		return NULL;
+	for (j=0; j < kds->ncols; j++)
+	{
+		RecordBatchFieldState *fstate = &rb_state->columns[j];
+		kern_colmeta *cmeta = &kds->colmeta[j];
+		int			attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
 
+		if (referenced && bms_is_member(attidx, referenced))
+		{
+			if (!arrowFdwSetupMmapField(m_base, fstate, kds, cmeta))
+				return NULL;	/* misaligned buffer */
+		}
+		else
+			cmeta->atttypkind = TYPE_KIND__NULL;	/* unreferenced */
 	}
-#endif
+
+	/*
+	 * The holder is released with the memory context, if any errors prevent
+	 * PDS_release().
+	 */
+	holder = MemoryContextAllocZero(mcontext, sizeof(arrowFdwMmapHolder));
+	addr = mmap(NULL, head_len + map_len,
+				PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED)
+		elog(ERROR, "failed on mmap: %m");
+	holder->mmap_addr   = addr;
+	holder->mmap_length = head_len + map_len;
+	holder->cb.func     = __arrowFdwMmapHolderCallback;
+	holder->cb.arg      = holder;
+	MemoryContextRegisterResetCallback(mcontext, &holder->cb);
+
+	if (mmap(addr + head_len, map_len,
+			 PROT_READ,
+			 MAP_SHARED | MAP_FIXED,
+			 FileGetRawDesc(rb_state->fdesc),
+			 map_off) == MAP_FAILED)
+		elog(ERROR, "failed on mmap('%s'): %m",
+			 FilePathName(rb_state->fdesc));
+
+	/* anonymous mapping is already zero-cleared */
+	pds = (pgstrom_data_store *)addr;
+	pg_atomic_init_u32(&pds->refcnt, 1);
+	pds->filedesc.rawfd = -1;
+	pds->mmap_holder = holder;
+	memcpy(&pds->kds, kds, head_sz);
+
+	/* no explicit reads; pages are faulted in from the page cache */
+	arrowFdwUpdateIoStats(io_stats, rb_state, referenced, 0, 0);
+
+	return pds;
 }
 
 /*
@@ -2135,13 +5399,15 @@ __arrowFdwLoadRecordBatch(RecordBatchState *rb_state,
 						  Bitmapset *referenced,
 						  GpuContext *gcontext,
 						  MemoryContext mcontext,
-						  int optimal_gpu)
+						  int optimal_gpu,
+						  ArrowFdwIoStats *io_stats)
 {
 	TupleDesc			tupdesc = RelationGetDescr(relation);
 	pgstrom_data_store *pds;
 	kern_data_store	   *kds;
 	strom_io_vector	   *iovec;
 	size_t				head_sz;
+	int					j;
 	CUresult			rc;
 
 	/* setup KDS and I/O-vector */
@@ -2154,8 +5420,42 @@ __arrowFdwLoadRecordBatch(RecordBatchState *rb_state,
 	Assert(head_sz == KERN_DATA_STORE_HEAD_LENGTH(kds));
 	Assert(kds->ncols == rb_state->ncols);
 	__arrowFdwAssignTypeOptions(kds, 0, kds->ncols, rb_state->columns);
-	iovec = arrowFdwSetupIOvector(kds, rb_state, referenced);
+	if (rb_state->rb_codec >= 0 || rb_state->rb_parquet)
+		return __arrowFdwLoadRecordBatchByHost(rb_state, kds, referenced,
+											   gcontext, mcontext,
+											   io_stats);
+	for (j=0; j < rb_state->ncols; j++)
+	{
+		int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+
+		if ((rb_state->columns[j].dict_index_width > 0 ||
+			 rb_state->columns[j].part_column) &&
+			referenced && bms_is_member(attidx, referenced))
+			return __arrowFdwLoadRecordBatchByHost(rb_state, kds, referenced,
+												   gcontext, mcontext,
+												   io_stats);
+	}
+	/*
+	 * CPU scan refers the RecordBatch on the page cache as is
+	 */
+	if (!gcontext && arrow_fdw_mmap_enabled)
+	{
+		pds = __arrowFdwLoadRecordBatchByMmap(rb_state, kds, referenced,
+											  mcontext, io_stats);
+		if (pds)
+			return pds;
+	}
+		iovec = arrowFdwSetupIOvector(kds, rb_state, referenced);
 	__dump_kds_and_iovec(kds, iovec);
+	if (io_stats)
+	{
+		uint64	read_bytes = 0;
+
+		for (j=0; j < iovec->nr_chunks; j++)
+			read_bytes += (uint64)iovec->ioc[j].nr_pages * PAGE_SIZE;
+		arrowFdwUpdateIoStats(io_stats, rb_state, referenced,
+							  iovec->nr_chunks, read_bytes);
+	}
 
 	/*
 	 * If SSD-to-GPU Direct SQL is available on the arrow file, setup a small
@@ -2200,14 +5500,233 @@ __arrowFdwLoadRecordBatch(RecordBatchState *rb_state,
 		}
 		else
 		{
-			pds = MemoryContextAllocHuge(mcontext,
-										 offsetof(pgstrom_data_store,
-												  kds) + kds->length);
+			pds = MemoryContextAllocHuge(mcontext,
+										 offsetof(pgstrom_data_store,
+												  kds) + kds->length);
+		}
+		__PDS_fillup_arrow(pds, gcontext, kds, fdesc, iovec);
+	}
+	pfree(iovec);
+	return pds;
+}
+
+/*
+ * arrowFdwPrefetchRecordBatches
+ *
+ * It kicks asynchronous read-ahead of the referenced buffers on the next
+ * arrow_fdw.prefetch_batches RecordBatches. Adjacent ranges are coalesced
+ * across the RecordBatches, if gap is less than arrow_fdw.io_coalesce_gap.
+ * RecordBatches to be loaded by SSD-to-GPU Direct SQL are not prefetched,
+ * because it does not go through the page cache.
+ */
+typedef struct
+{
+	int			fdesc;
+	off_t		f_head;
+	off_t		f_tail;
+	size_t		coalesce_gap;
+} arrowFdwPrefetchContext;
+
+static void
+__prefetchFlush(arrowFdwPrefetchContext *con)
+{
+	if (con->fdesc >= 0 && con->f_head < con->f_tail)
+		(void) posix_fadvise(con->fdesc,
+							 con->f_head,
+							 con->f_tail - con->f_head,
+							 POSIX_FADV_WILLNEED);
+	con->fdesc = -1;
+	con->f_head = 0;
+	con->f_tail = 0;
+}
+
+static void
+__prefetchRange(arrowFdwPrefetchContext *con,
+				int fdesc, off_t f_pos, size_t length)
+{
+	if (length == 0)
+		return;
+	if (con->fdesc == fdesc &&
+		f_pos >= con->f_head &&
+		f_pos <= con->f_tail + con->coalesce_gap)
+	{
+		con->f_tail = Max(con->f_tail, f_pos + length);
+		return;
+	}
+	__prefetchFlush(con);
+	con->fdesc  = fdesc;
+	con->f_head = f_pos;
+	con->f_tail = f_pos + length;
+}
+
+static void
+__prefetchField(arrowFdwPrefetchContext *con,
+				int fdesc, off_t rb_offset,
+				RecordBatchFieldState *fstate)
+{
+	int		j;
+
+	__prefetchRange(con, fdesc, rb_offset + fstate->nullmap_offset,
+					fstate->nullmap_length);
+	__prefetchRange(con, fdesc, rb_offset + fstate->values_offset,
+					fstate->values_length);
+	__prefetchRange(con, fdesc, rb_offset + fstate->extra_offset,
+					fstate->extra_length);
+	for (j=0; j < fstate->num_children; j++)
+		__prefetchField(con, fdesc, rb_offset, &fstate->children[j]);
+}
+
+static void
+__arrowFdwPrefetchRecordBatch(arrowFdwPrefetchContext *con,
+							  ArrowFdwState *af_state,
+							  RecordBatchState *rb_state)
+{
+	int			fdesc = FileGetRawDesc(rb_state->fdesc);
+	int			j;
+
+	if (af_state->gcontext && rb_state->dfile)
+		return;
+	for (j=0; j < rb_state->ncols; j++)
+	{
+		int		attidx = j + 1 - FirstLowInvalidHeapAttributeNumber;
+
+		if (af_state->referenced &&
+			bms_is_member(attidx, af_state->referenced))
+			__prefetchField(con, fdesc, rb_state->rb_offset,
+							&rb_state->columns[j]);
+	}
+}
+
+static void
+arrowFdwPrefetchRecordBatches(ArrowFdwState *af_state, uint32 rb_index)
+{
+	ArrowFdwSchedState *sched = af_state->sched;
+	arrowFdwPrefetchContext con;
+	uint32		index;
+	uint32		tail;
+
+	if (arrow_prefetch_batches <= 0)
+		return;
+	memset(&con, 0, sizeof(arrowFdwPrefetchContext));
+	con.fdesc = -1;
+	con.coalesce_gap = (size_t)arrow_io_coalesce_gap_kb << 10;
+	if (sched)
+	{
+		/*
+		 * On parallel scan, the record-batches to be loaded next are
+		 * the head of my own range; prefetch_index is a position on
+		 * the order[] in this case.
+		 */
+		ArrowFdwSchedSlot *slot = &sched->slots[af_state->sched_slot];
+		uint32	   *order = ARROW_SCHED_ORDER(sched);
+
+		SpinLockAcquire(&slot->lock);
+		index = slot->head;
+		tail = slot->tail;
+		SpinLockRelease(&slot->lock);
+
+		tail = Min(index + arrow_prefetch_batches, tail);
+		index = Max(af_state->prefetch_index, index);
+		if (index >= tail)
+			return;
+		for (; index < tail; index++)
+			__arrowFdwPrefetchRecordBatch(&con, af_state,
+										  af_state->rbatches[order[index]]);
+		__prefetchFlush(&con);
+		af_state->prefetch_index = tail;
+		return;
+	}
+	tail = Min(rb_index + arrow_prefetch_batches,
+			   af_state->num_rbatches - 1);
+	index = Max(af_state->prefetch_index, rb_index + 1);
+	if (index > tail)
+		return;
+	for (; index <= tail; index++)
+		__arrowFdwPrefetchRecordBatch(&con, af_state,
+									  af_state->rbatches[index]);
+	__prefetchFlush(&con);
+	af_state->prefetch_index = tail + 1;
+}
+
+/*
+ * arrowFdwRecordBatchLoadSize - length of the referenced buffers
+ */
+static uint64
+arrowFdwRecordBatchLoadSize(ArrowFdwState *af_state,
+							RecordBatchState *rb_state)
+{
+	uint64		sz = 0;
+	int			j, k;
+
+	for (k = bms_next_member(af_state->referenced, -1);
+		 k >= 0;
+		 k = bms_next_member(af_state->referenced, k))
+	{
+		j = k + FirstLowInvalidHeapAttributeNumber - 1;
+		if (j >= 0 && j < rb_state->ncols)
+			sz += RecordBatchFieldLength(&rb_state->columns[j]);
+	}
+	return sz;
+}
+
+/*
+ * arrowFdwNextRecordBatchIndex
+ *
+ * It returns the index of the next record-batch to be loaded, or -1 if
+ * no more record-batches are left.
+ */
+static int64
+arrowFdwNextRecordBatchIndex(ArrowFdwState *af_state)
+{
+	ArrowFdwSchedState *sched = af_state->sched;
+	ArrowFdwSchedSlot *slot;
+	ArrowFdwSchedSlot *victim;
+	uint32		rb_index;
+	uint32		pos = UINT_MAX;
+	bool		stolen = false;
+	int			k;
+
+	if (!sched)
+	{
+		rb_index = pg_atomic_fetch_add_u32(af_state->rbatch_index, 1);
+		if (rb_index >= af_state->num_rbatches)
+			return -1;
+		return rb_index;
+	}
+	/* take the next one (the longest one) from my own range */
+	slot = &sched->slots[af_state->sched_slot];
+	SpinLockAcquire(&slot->lock);
+	if (slot->head < slot->tail)
+		pos = slot->head++;
+	SpinLockRelease(&slot->lock);
+
+	/* elsewhere, steal the shortest one from the other ranges */
+	for (k=1; pos == UINT_MAX && k < sched->nslots; k++)
+	{
+		victim = &sched->slots[(af_state->sched_slot + k) % sched->nslots];
+		SpinLockAcquire(&victim->lock);
+		if (victim->head < victim->tail)
+		{
+			pos = --victim->tail;
+			stolen = true;
 		}
-		__PDS_fillup_arrow(pds, gcontext, kds, fdesc, iovec);
+		SpinLockRelease(&victim->lock);
 	}
-	pfree(iovec);
-	return pds;
+	if (pos == UINT_MAX)
+		return -1;		/* no more RecordBatch to read */
+	rb_index = ARROW_SCHED_ORDER(sched)[pos];
+	Assert(rb_index < af_state->num_rbatches);
+
+	/* update statistics */
+	SpinLockAcquire(&slot->lock);
+	slot->nloaded++;
+	if (stolen)
+		slot->nstolen++;
+	slot->load_bytes += arrowFdwRecordBatchLoadSize(af_state,
+													af_state->rbatches[rb_index]);
+	SpinLockRelease(&slot->lock);
+
+	return rb_index;
 }
 
 static pgstrom_data_store *
@@ -2218,31 +5737,132 @@ arrowFdwLoadRecordBatch(ArrowFdwState *af_state,
 						int optimal_gpu)
 {
 	RecordBatchState *rb_state;
-	uint32		rb_index;
+	int64		rb_index;
 
 retry:
 	/* fetch next RecordBatch */
-	rb_index = pg_atomic_fetch_add_u32(af_state->rbatch_index, 1);
-	if (rb_index >= af_state->num_rbatches)
+	rb_index = arrowFdwNextRecordBatchIndex(af_state);
+	if (rb_index < 0)
 		return NULL;	/* no more RecordBatch to read */
 	rb_state = af_state->rbatches[rb_index];
 
-	if (af_state->stats_hint)
+	/* results are already cached by the caller */
+	if (bms_is_member(rb_index, af_state->rbatch_cached))
+		goto retry;
+	if (af_state->stats_hint &&
+		!execCheckArrowStatsHint(af_state->stats_hint, rb_state))
 	{
-		if (execCheckArrowStatsHint(af_state->stats_hint, rb_state))
-			pg_atomic_fetch_add_u32(af_state->rbatch_nload, 1);
-		else
-		{
-			pg_atomic_fetch_add_u32(af_state->rbatch_nskip, 1);
-			goto retry;
-		}
+		pg_atomic_fetch_add_u32(af_state->rbatch_nskip, 1);
+		goto retry;
 	}
+	/* aggregated by the statistics, without loading */
+	if (af_state->stats_agg &&
+		execAccumArrowStatsAgg(af_state->stats_agg, rb_state))
+	{
+		pg_atomic_fetch_add_u32(af_state->rbatch_nstats, 1);
+		goto retry;
+	}
+	if (af_state->stats_hint)
+		pg_atomic_fetch_add_u32(af_state->rbatch_nload, 1);
+	arrowFdwPrefetchRecordBatches(af_state, rb_index);
+
 	return __arrowFdwLoadRecordBatch(rb_state,
 									 relation,
 									 af_state->referenced,
 									 gcontext,
 									 estate->es_query_cxt,
-									 optimal_gpu);
+									 optimal_gpu,
+									 af_state->io_stats);
+}
+
+/*
+ * ExecArrowFdwBatchIds / ExecArrowFdwExcludeBatches
+ *
+ * ... are interfaces for the result cache of the caller (GpuPreAgg).
+ * ExecArrowFdwBatchIds returns the identifiers of the RecordBatches to be
+ * scanned, or NULL if the foreign table is writable, because the REDO log
+ * on transaction abort may truncate the file, then the same position may
+ * be reused by another RecordBatch. ExecArrowFdwExcludeBatches excludes
+ * the RecordBatches whose results are already cached by the caller, or
+ * returns false if any of them are no longer valid.
+ * It assumes the files are never updated except for the appends.
+ */
+ArrowFdwBatchId *
+ExecArrowFdwBatchIds(ArrowFdwState *af_state, uint32 *p_nbatches)
+{
+	ArrowFdwBatchId *batches;
+	uint32		i;
+
+	if (af_state->writable || af_state->sched)
+		return NULL;
+	batches = palloc0(sizeof(ArrowFdwBatchId) *
+					  Max(af_state->num_rbatches, 1));
+	for (i=0; i < af_state->num_rbatches; i++)
+	{
+		RecordBatchState *rb_state = af_state->rbatches[i];
+		ArrowFdwBatchId *bid = &batches[i];
+
+		bid->st_dev    = rb_state->stat_buf.st_dev;
+		bid->st_ino    = rb_state->stat_buf.st_ino;
+		bid->rb_index  = rb_state->rb_index;
+		bid->rb_offset = rb_state->rb_offset;
+		bid->rb_length = rb_state->rb_length;
+		bid->rb_nitems = rb_state->rb_nitems;
+	}
+	*p_nbatches = af_state->num_rbatches;
+
+	return batches;
+}
+
+bool
+ExecArrowFdwExcludeBatches(ArrowFdwState *af_state,
+						   const ArrowFdwBatchId *batches,
+						   uint32 nbatches)
+{
+	ArrowFdwBatchId *curr_batches;
+	uint32		curr_nbatches;
+	HASHCTL		hctl;
+	HTAB	   *htab;
+	Bitmapset  *rbatch_cached = NULL;
+	uint32		i;
+
+	curr_batches = ExecArrowFdwBatchIds(af_state, &curr_nbatches);
+	if (!curr_batches)
+		return false;
+	memset(&hctl, 0, sizeof(HASHCTL));
+	hctl.keysize = sizeof(ArrowFdwBatchId);
+	hctl.entrysize = sizeof(ArrowFdwBatchId) + sizeof(uint32);
+	hctl.hcxt = CurrentMemoryContext;
+	htab = hash_create("arrow_fdw batch ids",
+					   Max(curr_nbatches, 16),
+					   &hctl,
+					   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	for (i=0; i < curr_nbatches; i++)
+	{
+		char   *entry = hash_search(htab, &curr_batches[i],
+									HASH_ENTER, NULL);
+		*((uint32 *)(entry + sizeof(ArrowFdwBatchId))) = i;
+	}
+	for (i=0; i < nbatches; i++)
+	{
+		char   *entry = hash_search(htab, &batches[i],
+									HASH_FIND, NULL);
+		if (!entry)
+			break;
+		rbatch_cached = bms_add_member(rbatch_cached,
+									   *((uint32 *)(entry + sizeof(ArrowFdwBatchId))));
+	}
+	hash_destroy(htab);
+	pfree(curr_batches);
+
+	if (i < nbatches)
+	{
+		bms_free(rbatch_cached);
+		return false;
+	}
+	bms_free(af_state->rbatch_cached);
+	af_state->rbatch_cached = rbatch_cached;
+	return true;
 }
 
 /*
@@ -2274,9 +5894,10 @@ ArrowIterateForeignScan(ForeignScanState *node)
 	Relation		relation = node->ss.ss_currentRelation;
 	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
 	pgstrom_data_store *pds;
+	cl_ulong		index;
 
 	while ((pds = af_state->curr_pds) == NULL ||
-		   af_state->curr_index >= pds->kds.nitems)
+		   af_state->curr_index >= af_state->curr_nrows)
 	{
 		EState	   *estate = node->ss.ps.state;
 
@@ -2284,15 +5905,25 @@ ArrowIterateForeignScan(ForeignScanState *node)
 		if (pds)
 			PDS_release(pds);
 		af_state->curr_index = 0;
+		af_state->curr_nrows = 0;
 		af_state->curr_pds = arrowFdwLoadRecordBatch(af_state,
 													 relation,
 													 estate,
 													 NULL, -1);
 		if (!af_state->curr_pds)
 			return NULL;
+		/* build the selection vector, if vectorized filter is valid */
+		if (af_state->vec_filter)
+			af_state->curr_nrows = execArrowVecFilter(af_state->vec_filter,
+													  &af_state->curr_pds->kds);
+		else
+			af_state->curr_nrows = af_state->curr_pds->kds.nitems;
 	}
-	Assert(pds && af_state->curr_index < pds->kds.nitems);
-	if (KDS_fetch_tuple_arrow(slot, &pds->kds, af_state->curr_index++))
+	Assert(pds && af_state->curr_index < af_state->curr_nrows);
+	index = af_state->curr_index++;
+	if (af_state->vec_filter)
+		index = af_state->vec_filter->rows[index];
+	if (KDS_fetch_tuple_arrow(slot, &pds->kds, index))
 		return slot;
 	return NULL;
 }
@@ -2305,10 +5936,16 @@ ExecReScanArrowFdw(ArrowFdwState *af_state)
 {
 	/* rewind the current scan state */
 	pg_atomic_write_u32(af_state->rbatch_index, 0);
+	af_state->prefetch_index = 0;
 	if (af_state->curr_pds)
 		PDS_release(af_state->curr_pds);
 	af_state->curr_pds = NULL;
 	af_state->curr_index = 0;
+	af_state->curr_nrows = 0;
+	if (af_state->stats_agg)
+		execResetArrowStatsAgg(af_state->stats_agg);
+	bms_free(af_state->rbatch_cached);
+	af_state->rbatch_cached = NULL;
 }
 
 static void
@@ -2336,6 +5973,10 @@ ExecEndArrowFdw(ArrowFdwState *af_state)
 	}
 	if (af_state->stats_hint)
 		execEndArrowStatsHint(af_state->stats_hint);
+	if (af_state->stats_agg)
+		execEndArrowStatsAgg(af_state->stats_agg);
+	if (af_state->vec_filter)
+		execEndArrowVecFilter(af_state->vec_filter);
 }
 
 static void
@@ -2380,6 +6021,24 @@ ExplainArrowFdw(ArrowFdwState *af_state,
 	}
 	ExplainPropertyText("referenced", buf.data, es);
 
+	/* shows hive-style partition pruning if any */
+	if (af_state->part_ncols > 0)
+	{
+		resetStringInfo(&buf);
+		for (j = tupdesc->natts - af_state->part_ncols; j < tupdesc->natts; j++)
+		{
+			Form_pg_attribute	attr = tupleDescAttr(tupdesc, j);
+
+			if (buf.len > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfoString(&buf, quote_identifier(NameStr(attr->attname)));
+		}
+		appendStringInfo(&buf, "  [files: %u, pruned: %u]",
+						 af_state->part_nfiles,
+						 af_state->part_nskip);
+		ExplainPropertyText("Partition-Keys", buf.data, es);
+	}
+
 	/* shows stats hint if any */
 	if (af_state->stats_hint)
 	{
@@ -2426,6 +6085,134 @@ ExplainArrowFdw(ArrowFdwState *af_state,
 		ExplainPropertyText("Stats-Hint", buf.data, es);
 	}
 
+	/* shows aggregation by the statistics if any */
+	if (af_state->stats_agg)
+	{
+		arrowStatsAgg  *stats_agg = af_state->stats_agg;
+		int				i;
+
+		resetStringInfo(&buf);
+		for (i=0; i < stats_agg->nitems; i++)
+		{
+			arrowStatsAggItem *item = &stats_agg->items[i];
+			const char *attName = (item->attnum == 0 ? "*" :
+				quote_identifier(NameStr(tupleDescAttr(tupdesc,
+													   item->attnum-1)->attname)));
+			if (buf.len > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfo(&buf, "%s(%s)",
+							 item->kind == ARROW_STATS_AGG__MIN ? "min" :
+							 item->kind == ARROW_STATS_AGG__MAX ? "max" : "count",
+							 attName);
+		}
+		if (es->analyze)
+			appendStringInfo(&buf, "  [aggregated: %u]",
+							 pg_atomic_read_u32(af_state->rbatch_nstats));
+		ExplainPropertyText("Stats-Aggregate", buf.data, es);
+	}
+
+	/* shows vectorized filter if any */
+	if (af_state->vec_filter)
+	{
+		arrowVecFilter *vfilter = af_state->vec_filter;
+
+		resetStringInfo(&buf);
+		if (dcontext == NIL)
+		{
+			Bitmapset  *vec_attrs = NULL;
+			int			anum;
+
+			foreach (lc, vfilter->vec_quals)
+			{
+				arrowVecQual *vqual = lfirst(lc);
+
+				vec_attrs = bms_add_member(vec_attrs, vqual->attnum);
+			}
+			for (anum = bms_next_member(vec_attrs, -1);
+				 anum >= 0;
+				 anum = bms_next_member(vec_attrs, anum))
+			{
+				Form_pg_attribute attr = tupleDescAttr(tupdesc, anum-1);
+				const char *attName = NameStr(attr->attname);
+
+				if (buf.len > 0)
+					appendStringInfoString(&buf, ", ");
+				appendStringInfoString(&buf, quote_identifier(attName));
+			}
+		}
+		else
+		{
+			foreach (lc, vfilter->orig_quals)
+			{
+				Node   *qual = lfirst(lc);
+				char   *temp;
+
+				temp = deparse_expression(qual, dcontext, es->verbose, false);
+				if (buf.len > 0)
+					appendStringInfoString(&buf, ", ");
+				appendStringInfoString(&buf, temp);
+				pfree(temp);
+			}
+		}
+		/* statistics of the parallel workers are not collected */
+		if (es->analyze && !af_state->sched && !af_state->sched_local)
+			appendStringInfo(&buf, "  [removed: %lu]",
+							 vfilter->nitems_removed);
+		ExplainPropertyText("Vectorized-Filter", buf.data, es);
+	}
+
+	/* shows I/O statistics, if EXPLAIN ANALYZE */
+	if (es->analyze)
+	{
+		ArrowFdwIoStats *io_stats = af_state->io_stats;
+		uint64		nr_reads = pg_atomic_read_u64(&io_stats->nr_reads);
+		uint64		read_bytes = pg_atomic_read_u64(&io_stats->read_bytes);
+		uint64		used_bytes = pg_atomic_read_u64(&io_stats->used_bytes);
+
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			resetStringInfo(&buf);
+			appendStringInfo(&buf, "reads: %lu, read: %s, referenced: %s",
+							 nr_reads,
+							 format_bytesz(read_bytes),
+							 format_bytesz(used_bytes));
+			if (used_bytes > 0)
+				appendStringInfo(&buf, " (amplification: %.2f)",
+								 (double)read_bytes / (double)used_bytes);
+			ExplainPropertyText("I/O-Stats", buf.data, es);
+		}
+		else
+		{
+			ExplainPropertyInteger("I/O-Reads", NULL, nr_reads, es);
+			ExplainPropertyInteger("I/O-Read-Size", "bytes", read_bytes, es);
+			ExplainPropertyInteger("I/O-Referenced-Size", "bytes",
+								   used_bytes, es);
+		}
+	}
+
+	/* shows per-process load of the parallel scan, if EXPLAIN ANALYZE VERBOSE */
+	if (es->analyze && es->verbose)
+	{
+		ArrowFdwSchedState *sched = (af_state->sched
+									 ? af_state->sched
+									 : af_state->sched_local);
+		for (k=0; sched && k < sched->nslots; k++)
+		{
+			ArrowFdwSchedSlot *slot = &sched->slots[k];
+
+			if (k == 0)
+				snprintf(label, sizeof(label), "Load (leader)");
+			else
+				snprintf(label, sizeof(label), "Load (worker %d)", k-1);
+			resetStringInfo(&buf);
+			appendStringInfo(&buf, "batches: %u (stolen: %u), size: %s",
+							 slot->nloaded,
+							 slot->nstolen,
+							 format_bytesz(slot->load_bytes));
+			ExplainPropertyText(label, buf.data, es);
+		}
+	}
+
 	/* shows files on behalf of the foreign table */
 	foreach (lc, af_state->fdescList)
 	{
@@ -2534,11 +6321,40 @@ readArrowFile(const char *pathname, ArrowFileInfo *af_info, bool missing_ok)
 				(errcode_for_file_access(),
 				 errmsg("could not open file \"%s\": %m", pathname)));
 	}
-	readArrowFileDesc(FileGetRawDesc(filp), af_info);
+	if (parquetFileDescIsValid(FileGetRawDesc(filp)))
+	{
+		ParquetFileInfo	pq_info;
+
+		/* only schema definition is valid for parquet files */
+		readParquetFileDesc(FileGetRawDesc(filp), &pq_info);
+		memset(af_info, 0, sizeof(ArrowFileInfo));
+		memcpy(&af_info->stat_buf, &pq_info.stat_buf, sizeof(struct stat));
+		initArrowNode(&af_info->footer, Footer);
+		memcpy(&af_info->footer.schema, &pq_info.schema, sizeof(ArrowSchema));
+	}
+	else
+		readArrowFileDesc(FileGetRawDesc(filp), af_info);
 	FileClose(filp);
 	return true;
 }
 
+/*
+ * arrowFdwFileIsParquet
+ */
+static bool
+arrowFdwFileIsParquet(const char *pathname)
+{
+	File	filp = PathNameOpenFile(pathname, O_RDONLY | PG_BINARY);
+	bool	retval;
+
+	if (filp < 0)
+		return false;
+	retval = parquetFileDescIsValid(FileGetRawDesc(filp));
+	FileClose(filp);
+
+	return retval;
+}
+
 /*
  * RecordBatchAcquireSampleRows - random sampling
  */
@@ -2568,7 +6384,8 @@ RecordBatchAcquireSampleRows(Relation relation,
 									referenced,
 									NULL,
 									CurrentMemoryContext,
-									-1);
+									-1,
+									NULL);
 	values = alloca(sizeof(Datum) * tupdesc->natts);
 	isnull = alloca(sizeof(bool)  * tupdesc->natts);
 	for (count = 0; count < nsamples; count++)
@@ -2617,10 +6434,13 @@ ArrowAcquireSampleRows(Relation relation,
 	int64			count_nrows = 0;
 	int				nsamples_min = nrooms / 100;
 	int				nitems = 0;
+	int				part_ncols = 0;
 
 	filesList = __arrowFdwExtractFilesList(ft->options,
 										   NULL,
 										   &writable);
+	if (!writable)
+		part_ncols = arrowFdwPartitionColumns(tupdesc, filesList);
 	foreach (lc, filesList)
 	{
 		char	   *fname = strVal(lfirst(lc));
@@ -2643,6 +6463,8 @@ ArrowAcquireSampleRows(Relation relation,
 		{
 			RecordBatchState *rb_state = lfirst(cell);
 
+			rb_state = arrowFdwSetupPartitionColumns(rb_state, tupdesc,
+													 fname, part_ncols);
 			if (!arrowSchemaCompatibilityCheck(tupdesc, rb_state))
 				elog(ERROR, "arrow file '%s' on behalf of foreign table '%s' has incompatible schema definition",
 					 fname, RelationGetRelationName(relation));
@@ -2996,6 +6818,122 @@ pgstrom_arrow_fdw_import_file(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_import_file);
 
+/*
+ * pgstrom_arrow_fdw_snapshots
+ *
+ * It lists the snapshots available on the arrow files of the foreign table.
+ * Because arrow files are written in append-only manner, the first N
+ * record-batches of the file are a snapshot of the file when its footer
+ * was located at the end of the N-th record-batch.
+ */
+typedef struct
+{
+	const char *filename;
+	int			snapshot;		/* number of record-batches */
+	off_t		footer_offset;	/* offset of the footer on the snapshot */
+	int64		nitems;			/* number of rows on the snapshot */
+} arrowFdwSnapshotInfo;
+
+Datum
+pgstrom_arrow_fdw_snapshots(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	arrowFdwSnapshotInfo *sinfo;
+	List	   *sinfo_list;
+	Datum		values[4];
+	bool		isnull[4];
+	HeapTuple	tuple;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		Oid			frel_oid = PG_GETARG_OID(0);
+		Relation	frel;
+		ForeignTable *ft;
+		TupleDesc	tupdesc;
+		MemoryContext oldcxt;
+		List	   *filesList;
+		ListCell   *lc1, *lc2;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+		tupdesc = CreateTemplateTupleDesc(4);
+		TupleDescInitEntry(tupdesc, 1, "filename",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc, 2, "snapshot",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 3, "footer_offset",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 4, "nitems",
+						   INT8OID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+
+		frel = table_open(frel_oid, AccessShareLock);
+		if (!RelationIsArrowFdw(frel))
+			ereport(ERROR,
+					(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+					 errmsg("\"%s\" is not arrow_fdw foreign table",
+							RelationGetRelationName(frel))));
+		ft = GetForeignTable(frel_oid);
+		filesList = arrowFdwExtractFilesList(ft->options);
+		sinfo_list = NIL;
+		foreach (lc1, filesList)
+		{
+			const char *fname = strVal(lfirst(lc1));
+			File		fdesc;
+			List	   *rb_cached;
+			int64		nitems = 0;
+
+			fdesc = PathNameOpenFile(fname, O_RDONLY | PG_BINARY);
+			if (fdesc < 0)
+			{
+				if (errno == ENOENT)
+					continue;
+				elog(ERROR, "failed to open '%s' on behalf of '%s': %m",
+					 fname, RelationGetRelationName(frel));
+			}
+			/* snapshots are listed on the latest footer */
+			rb_cached = __arrowLookupOrBuildMetadataCache(fdesc, NULL, -1);
+			foreach (lc2, rb_cached)
+			{
+				RecordBatchState *rb_state = lfirst(lc2);
+
+				/* parquet files are not appendable */
+				if (rb_state->rb_parquet)
+					break;
+				nitems += rb_state->rb_nitems;
+				sinfo = palloc0(sizeof(arrowFdwSnapshotInfo));
+				sinfo->filename = fname;
+				sinfo->snapshot = rb_state->rb_index + 1;
+				sinfo->footer_offset = rb_state->rb_offset + rb_state->rb_length;
+				sinfo->nitems = nitems;
+				sinfo_list = lappend(sinfo_list, sinfo);
+			}
+			FileClose(fdesc);
+		}
+		table_close(frel, AccessShareLock);
+		fncxt->user_fctx = sinfo_list;
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	sinfo_list = (List *)fncxt->user_fctx;
+	if (sinfo_list == NIL)
+		SRF_RETURN_DONE(fncxt);
+	sinfo = linitial(sinfo_list);
+	fncxt->user_fctx = list_delete_first(sinfo_list);
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = CStringGetTextDatum(sinfo->filename);
+	values[1] = Int32GetDatum(sinfo->snapshot);
+	values[2] = Int64GetDatum(sinfo->footer_offset);
+	values[3] = Int64GetDatum(sinfo->nitems);
+
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_arrow_fdw_snapshots);
+
 /*
  * ArrowIsForeignScanParallelSafe
  */
@@ -3010,21 +6948,166 @@ ArrowIsForeignScanParallelSafe(PlannerInfo *root,
 /*
  * ArrowEstimateDSMForeignScan 
  */
+static inline Size
+__ExecEstimateDSMArrowFdwSched(ArrowFdwState *af_state,
+							   ParallelContext *pcxt)
+{
+	int			nslots = pcxt->nworkers + 1;
+
+	return (MAXALIGN(offsetof(ArrowFdwSchedState, slots[nslots])) +
+			MAXALIGN(sizeof(uint32) * af_state->num_rbatches) +
+			MAXALIGN(sizeof(ArrowFdwSnapshotFile) *
+					 list_length(af_state->fdescList)));
+}
+
+Size
+ExecEstimateDSMArrowFdw(ArrowFdwState *af_state, ParallelContext *pcxt)
+{
+	return __ExecEstimateDSMArrowFdwSched(af_state, pcxt);
+}
+
 static Size
 ArrowEstimateDSMForeignScan(ForeignScanState *node,
 							ParallelContext *pcxt)
 {
-	return MAXALIGN(sizeof(pg_atomic_uint32) * 3);
+	return (MAXALIGN(sizeof(pg_atomic_uint32) * 3) +
+			MAXALIGN(sizeof(ArrowFdwIoStats)) +
+			__ExecEstimateDSMArrowFdwSched((ArrowFdwState *)node->fdw_state,
+										   pcxt));
 }
 
 /*
  * ArrowInitializeDSMForeignScan
  */
+static int
+__compareRecordBatchLoadSize(const void *__a, const void *__b, void *arg)
+{
+	uint64	   *rb_sizes = arg;
+	uint32		a = *((const uint32 *)__a);
+	uint32		b = *((const uint32 *)__b);
+
+	/* larger one first, then in the original order */
+	if (rb_sizes[a] > rb_sizes[b])
+		return -1;
+	if (rb_sizes[a] < rb_sizes[b])
+		return 1;
+	return (a < b ? -1 : (a > b ? 1 : 0));
+}
+
+static void
+__ExecInitDSMArrowFdwSched(ArrowFdwState *af_state,
+						   ArrowFdwSchedState *sched,
+						   int nslots)
+{
+	uint32		nitems = af_state->num_rbatches;
+	uint32	   *order;
+	ArrowFdwSnapshotFile *files;
+	ListCell   *lc;
+	uint64	   *rb_sizes = palloc(sizeof(uint64) * (nitems + 1));
+	uint32	   *rb_sorted = palloc(sizeof(uint32) * (nitems + 1));
+	uint32	   *rb_owner = palloc(sizeof(uint32) * (nitems + 1));
+	uint64	   *slot_bytes = palloc0(sizeof(uint64) * nslots);
+	uint32	   *slot_pos = palloc0(sizeof(uint32) * nslots);
+	uint32		i, k, pos;
+
+	memset(sched, 0, offsetof(ArrowFdwSchedState, slots[nslots]));
+	sched->nslots = nslots;
+	sched->nitems = nitems;
+	sched->nfiles = list_length(af_state->fdescList);
+	order = ARROW_SCHED_ORDER(sched);
+	files = ARROW_SCHED_FILES(sched);
+
+	/* save the snapshot of the files at the query start */
+	k = 0;
+	foreach (lc, af_state->fdescList)
+	{
+		File		fdesc = (File)lfirst_int(lc);
+		struct stat	stat_buf;
+
+		if (fstat(FileGetRawDesc(fdesc), &stat_buf) != 0)
+			elog(ERROR, "failed on fstat('%s'): %m", FilePathName(fdesc));
+		files[k].st_dev = stat_buf.st_dev;
+		files[k].st_ino = stat_buf.st_ino;
+		files[k].nbatches = 0;
+		for (i=0; i < nitems; i++)
+		{
+			RecordBatchState *rb_state = af_state->rbatches[i];
+
+			if (rb_state->fdesc == fdesc)
+				files[k].nbatches = Max(files[k].nbatches,
+										(uint32)rb_state->rb_index + 1);
+		}
+		k++;
+	}
+
+	/* sort record-batches by the length to be loaded */
+	for (i=0; i < nitems; i++)
+	{
+		rb_sizes[i] = arrowFdwRecordBatchLoadSize(af_state,
+												  af_state->rbatches[i]);
+		rb_sorted[i] = i;
+	}
+	qsort_arg(rb_sorted, nitems, sizeof(uint32),
+			  __compareRecordBatchLoadSize, rb_sizes);
+
+	/*
+	 * assign the record-batches, longest first, to the least loaded
+	 * participant; the number of record-batches breaks the tie.
+	 */
+	for (i=0; i < nitems; i++)
+	{
+		uint32		index = rb_sorted[i];
+		uint32		best = 0;
+
+		for (k=1; k < nslots; k++)
+		{
+			if (slot_bytes[k] < slot_bytes[best] ||
+				(slot_bytes[k] == slot_bytes[best] &&
+				 slot_pos[k] < slot_pos[best]))
+				best = k;
+		}
+		rb_owner[index] = best;
+		slot_bytes[best] += rb_sizes[index];
+		slot_pos[best]++;
+	}
+
+	/* setup ranges of the participants on the order[] */
+	for (k=0, pos=0; k < nslots; k++)
+	{
+		ArrowFdwSchedSlot *slot = &sched->slots[k];
+
+		SpinLockInit(&slot->lock);
+		slot->base = slot->head = pos;
+		pos += slot_pos[k];
+		slot->end = slot->tail = pos;
+		slot_pos[k] = slot->base;
+	}
+	Assert(pos == nitems);
+	for (i=0; i < nitems; i++)
+	{
+		uint32		index = rb_sorted[i];
+
+		order[slot_pos[rb_owner[index]]++] = index;
+	}
+	pfree(rb_sizes);
+	pfree(rb_sorted);
+	pfree(rb_owner);
+	pfree(slot_bytes);
+	pfree(slot_pos);
+
+	af_state->sched = sched;
+	af_state->sched_slot = 0;		/* leader process */
+	af_state->prefetch_index = 0;
+}
+
 static inline void
 __ExecInitDSMArrowFdw(ArrowFdwState *af_state,
 					  pg_atomic_uint32 *rbatch_index,
 					  pg_atomic_uint32 *rbatch_nload,
-					  pg_atomic_uint32 *rbatch_nskip)
+					  pg_atomic_uint32 *rbatch_nskip,
+					  ArrowFdwIoStats *io_stats,
+					  ArrowFdwSchedState *sched,
+					  ParallelContext *pcxt)
 {
 	pg_atomic_init_u32(rbatch_index, 0);
 	af_state->rbatch_index = rbatch_index;
@@ -3032,15 +7115,29 @@ __ExecInitDSMArrowFdw(ArrowFdwState *af_state,
 	af_state->rbatch_nload = rbatch_nload;
 	pg_atomic_init_u32(rbatch_nskip, 0);
 	af_state->rbatch_nskip = rbatch_nskip;
+	pg_atomic_init_u64(&io_stats->nr_reads, 0);
+	pg_atomic_init_u64(&io_stats->read_bytes, 0);
+	pg_atomic_init_u64(&io_stats->used_bytes, 0);
+	af_state->io_stats = io_stats;
+	__ExecInitDSMArrowFdwSched(af_state, sched, pcxt->nworkers + 1);
 }
 
 void
-ExecInitDSMArrowFdw(ArrowFdwState *af_state, GpuTaskSharedState *gtss)
+ExecInitDSMArrowFdw(ArrowFdwState *af_state,
+					GpuTaskSharedState *gtss,
+					ParallelContext *pcxt)
 {
+	Assert(gtss->af_sched_offset > 0);
+	pg_atomic_init_u32(&gtss->af_rbatch_nstats, 0);
+	af_state->rbatch_nstats = &gtss->af_rbatch_nstats;
 	__ExecInitDSMArrowFdw(af_state,
 						  &gtss->af_rbatch_index,
 						  &gtss->af_rbatch_nload,
-						  &gtss->af_rbatch_nskip);
+						  &gtss->af_rbatch_nskip,
+						  &gtss->af_io_stats,
+						  (ArrowFdwSchedState *)((char *)gtss +
+												 gtss->af_sched_offset),
+						  pcxt);
 }
 
 static void
@@ -3049,11 +7146,16 @@ ArrowInitializeDSMForeignScan(ForeignScanState *node,
 							  void *coordinate)
 {
 	pg_atomic_uint32 *atomic_buffer = coordinate;
+	char	   *pos = (char *)coordinate + MAXALIGN(sizeof(pg_atomic_uint32) * 3);
 
 	__ExecInitDSMArrowFdw((ArrowFdwState *)node->fdw_state,
 						  atomic_buffer,
 						  atomic_buffer + 1,
-						  atomic_buffer + 2);
+						  atomic_buffer + 2,
+						  (ArrowFdwIoStats *)pos,
+						  (ArrowFdwSchedState *)(pos +
+									MAXALIGN(sizeof(ArrowFdwIoStats))),
+						  pcxt);
 }
 
 /*
@@ -3062,7 +7164,24 @@ ArrowInitializeDSMForeignScan(ForeignScanState *node,
 static void
 __ExecReInitDSMArrowFdw(ArrowFdwState *af_state)
 {
+	ArrowFdwSchedState *sched = af_state->sched;
+	uint32		k;
+
 	pg_atomic_write_u32(af_state->rbatch_index, 0);
+	if (sched)
+	{
+		for (k=0; k < sched->nslots; k++)
+		{
+			ArrowFdwSchedSlot *slot = &sched->slots[k];
+
+			slot->head = slot->base;
+			slot->tail = slot->end;
+			slot->nloaded = 0;
+			slot->nstolen = 0;
+			slot->load_bytes = 0;
+		}
+		af_state->prefetch_index = 0;
+	}
 }
 
 void
@@ -3087,21 +7206,60 @@ static inline void
 __ExecInitWorkerArrowFdw(ArrowFdwState *af_state,
 						 pg_atomic_uint32 *rbatch_index,
 						 pg_atomic_uint32 *rbatch_nload,
-						 pg_atomic_uint32 *rbatch_nskip)
+						 pg_atomic_uint32 *rbatch_nskip,
+						 ArrowFdwIoStats *io_stats,
+						 ArrowFdwSchedState *sched)
 {
+	ArrowFdwSnapshotFile *files = ARROW_SCHED_FILES(sched);
+	uint32		i, j, k;
+
 	af_state->rbatch_index = rbatch_index;
 	af_state->rbatch_nload = rbatch_nload;
 	af_state->rbatch_nskip = rbatch_nskip;
+	af_state->io_stats = io_stats;
+
+	/*
+	 * Drop the record-batches appended after the query start by the leader,
+	 * because the worker opened the files at its own start.
+	 */
+	for (i=0, j=0; i < af_state->num_rbatches; i++)
+	{
+		RecordBatchState *rb_state = af_state->rbatches[i];
+
+		for (k=0; k < sched->nfiles; k++)
+		{
+			if (files[k].st_dev == rb_state->stat_buf.st_dev &&
+				files[k].st_ino == rb_state->stat_buf.st_ino)
+				break;
+		}
+		if (k < sched->nfiles &&
+			(uint32)rb_state->rb_index < files[k].nbatches)
+			af_state->rbatches[j++] = rb_state;
+	}
+	af_state->num_rbatches = j;
+
+	if (sched->nitems != af_state->num_rbatches)
+		elog(ERROR, "arrow_fdw: number of record-batches mismatch (%u of leader, %u of worker)",
+			 sched->nitems, af_state->num_rbatches);
+	Assert(ParallelWorkerNumber + 1 < sched->nslots);
+	af_state->sched = sched;
+	af_state->sched_slot = ParallelWorkerNumber + 1;
+	af_state->prefetch_index = 0;
 }
 
 void
 ExecInitWorkerArrowFdw(ArrowFdwState *af_state,
 					   GpuTaskSharedState *gtss)
 {
+	Assert(gtss->af_sched_offset > 0);
+	af_state->rbatch_nstats = &gtss->af_rbatch_nstats;
 	__ExecInitWorkerArrowFdw(af_state,
 							 &gtss->af_rbatch_index,
 							 &gtss->af_rbatch_nload,
-							 &gtss->af_rbatch_nskip);
+							 &gtss->af_rbatch_nskip,
+							 &gtss->af_io_stats,
+							 (ArrowFdwSchedState *)((char *)gtss +
+													gtss->af_sched_offset));
 }
 
 static void
@@ -3110,11 +7268,15 @@ ArrowInitializeWorkerForeignScan(ForeignScanState *node,
 								 void *coordinate)
 {
 	pg_atomic_uint32 *atomic_buffer = coordinate;
+	char	   *pos = (char *)coordinate + MAXALIGN(sizeof(pg_atomic_uint32) * 3);
 
 	__ExecInitWorkerArrowFdw((ArrowFdwState *)node->fdw_state,
 							 atomic_buffer,
 							 atomic_buffer + 1,
-							 atomic_buffer + 2);
+							 atomic_buffer + 2,
+							 (ArrowFdwIoStats *)pos,
+							 (ArrowFdwSchedState *)(pos +
+									MAXALIGN(sizeof(ArrowFdwIoStats))));
 }
 
 /*
@@ -3136,6 +7298,34 @@ __ExecShutdownArrowFdw(ArrowFdwState *af_state)
 	temp = pg_atomic_read_u32(af_state->rbatch_nskip);
 	pg_atomic_write_u32(&af_state->__rbatch_nskip_local, temp);
 	af_state->rbatch_nskip = &af_state->__rbatch_nskip_local;
+
+	temp = pg_atomic_read_u32(af_state->rbatch_nstats);
+	pg_atomic_write_u32(&af_state->__rbatch_nstats_local, temp);
+	af_state->rbatch_nstats = &af_state->__rbatch_nstats_local;
+
+	if (af_state->io_stats != &af_state->__io_stats_local)
+	{
+		ArrowFdwIoStats *io_local = &af_state->__io_stats_local;
+
+		pg_atomic_write_u64(&io_local->nr_reads,
+							pg_atomic_read_u64(&af_state->io_stats->nr_reads));
+		pg_atomic_write_u64(&io_local->read_bytes,
+							pg_atomic_read_u64(&af_state->io_stats->read_bytes));
+		pg_atomic_write_u64(&io_local->used_bytes,
+							pg_atomic_read_u64(&af_state->io_stats->used_bytes));
+		af_state->io_stats = io_local;
+	}
+
+	if (af_state->sched)
+	{
+		ArrowFdwSchedState *sched = af_state->sched;
+		Size		sz = offsetof(ArrowFdwSchedState, slots[sched->nslots]);
+
+		/* keep the per-process statistics for EXPLAIN */
+		af_state->sched_local = palloc(sz);
+		memcpy(af_state->sched_local, sched, sz);
+		af_state->sched = NULL;
+	}
 }
 
 void
@@ -3196,6 +7386,7 @@ __ArrowBeginForeignModify(ResultRelInfo *rrinfo, int eflags)
 	SQLtable	   *table;
 	MetadataCacheKey key;
 	off_t			f_pos;
+	int				j;
 
 	Assert(list_length(filesList) == 1);
 	fname = strVal(linitial(filesList));
@@ -3204,8 +7395,21 @@ __ArrowBeginForeignModify(ResultRelInfo *rrinfo, int eflags)
 	filp = PathNameOpenFile(fname, O_RDWR | PG_BINARY);
 	if (filp >= 0)
 	{
+		if (parquetFileDescIsValid(FileGetRawDesc(filp)))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("arrow_fdw: parquet file \"%s\" is not writable",
+							fname)));
 		af_info = alloca(sizeof(ArrowFileInfo));
 		readArrowFileDesc(FileGetRawDesc(filp), af_info);
+		for (j=0; j < af_info->footer.schema._num_fields; j++)
+		{
+			if (af_info->footer.schema.fields[j].dictionary)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("arrow_fdw: unable to write \"%s\" with dictionary-encoded fields",
+								fname)));
+		}
 		f_pos = createArrowWriteRedoLog(filp, false);
 	}
 	else if (errno == ENOENT)
@@ -3261,7 +7465,33 @@ ArrowBeginForeignModify(ModifyTableState *mtstate,
 						int subplan_index,
 						int eflags)
 {
-	__ArrowBeginForeignModify(rrinfo, eflags);
+	__ArrowBeginForeignModify(rrinfo, eflags);
+}
+
+/*
+ * __arrowFieldPutDatum - put a datum on the SQLfield buffer, then returns
+ * the usage of the column.
+ */
+static inline size_t
+__arrowFieldPutDatum(SQLfield *column, Form_pg_attribute attr,
+					 Datum datum, bool isnull)
+{
+	if (isnull)
+		return sql_field_put_value(column, NULL, 0);
+	else if (attr->attbyval)
+	{
+		Assert(column->sql_type.pgsql.typbyval);
+		return sql_field_put_value(column, (char *)&datum, attr->attlen);
+	}
+	else if (attr->attlen == -1)
+	{
+		int		vl_len = VARSIZE_ANY_EXHDR(datum);
+		char   *vl_ptr = VARDATA_ANY(datum);
+
+		Assert(column->sql_type.pgsql.typlen == -1);
+		return sql_field_put_value(column, vl_ptr, vl_len);
+	}
+	elog(ERROR, "Bug? unsupported type format");
 }
 
 /*
@@ -3285,32 +7515,10 @@ ArrowExecForeignInsert(EState *estate,
 	oldcxt = MemoryContextSwitchTo(aw_state->memcxt);
 	for (j=0; j < tupdesc->natts; j++)
 	{
-		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
-		SQLfield   *column = &table->columns[j];
-		Datum		datum = slot->tts_values[j];
-		bool		isnull = slot->tts_isnull[j];
-
-		if (isnull)
-		{
-			usage += sql_field_put_value(column, NULL, 0);
-		}
-		else if (attr->attbyval)
-		{
-			Assert(column->sql_type.pgsql.typbyval);
-			usage += sql_field_put_value(column, (char *)&datum, attr->attlen);
-		}
-		else if (attr->attlen == -1)
-		{
-			int		vl_len = VARSIZE_ANY_EXHDR(datum);
-			char   *vl_ptr = VARDATA_ANY(datum);
-
-			Assert(column->sql_type.pgsql.typlen == -1);
-			usage += sql_field_put_value(column, vl_ptr, vl_len);
-		}
-		else
-		{
-			elog(ERROR, "Bug? unsupported type format");
-		}
+		usage += __arrowFieldPutDatum(&table->columns[j],
+									  tupleDescAttr(tupdesc, j),
+									  slot->tts_values[j],
+									  slot->tts_isnull[j]);
 	}
 	table->usage = usage;
 	table->nitems++;
@@ -3326,6 +7534,78 @@ ArrowExecForeignInsert(EState *estate,
 	return slot;
 }
 
+#if PG_VERSION_NUM >= 140000
+/*
+ * ArrowGetForeignModifyBatchSize
+ *
+ * RETURNING, WITH CHECK OPTION and row-level triggers need the rows
+ * one by one, so batch insert is not available for them.
+ */
+static int
+ArrowGetForeignModifyBatchSize(ResultRelInfo *rrinfo)
+{
+	if (rrinfo->ri_projectReturning != NULL ||
+		rrinfo->ri_WithCheckOptions != NIL ||
+		(rrinfo->ri_TrigDesc &&
+		 (rrinfo->ri_TrigDesc->trig_insert_before_row ||
+		  rrinfo->ri_TrigDesc->trig_insert_after_row)))
+		return 1;
+	return arrow_insert_batch_size;
+}
+
+/*
+ * ArrowExecForeignBatchInsert
+ *
+ * It puts a batch of rows on the SQLtable buffers column by column, instead
+ * of row by row. Each column has its own buffers (nullmap, values and extra),
+ * then put_value handler is called for a particular column consecutively.
+ * The buffer usage is checked for each batch, so a RecordBatch may exceed
+ * the arrow_fdw.record_batch_size by a batch at most.
+ */
+static TupleTableSlot **
+ArrowExecForeignBatchInsert(EState *estate,
+							ResultRelInfo *rrinfo,
+							TupleTableSlot **slots,
+							TupleTableSlot **planSlots,
+							int *numSlots)
+{
+	Relation		frel = rrinfo->ri_RelationDesc;
+	TupleDesc		tupdesc = RelationGetDescr(frel);
+	arrowWriteState *aw_state = rrinfo->ri_FdwState;
+	SQLtable	   *table = &aw_state->sql_table;
+	MemoryContext	oldcxt;
+	size_t			usage = 0;
+	int				nslots = *numSlots;
+	int				i, j;
+
+	for (i=0; i < nslots; i++)
+		slot_getallattrs(slots[i]);
+	oldcxt = MemoryContextSwitchTo(aw_state->memcxt);
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		SQLfield   *column = &table->columns[j];
+		size_t		column_usage = column->__curr_usage__;
+
+		for (i=0; i < nslots; i++)
+		{
+			column_usage = __arrowFieldPutDatum(column, attr,
+												slots[i]->tts_values[j],
+												slots[i]->tts_isnull[j]);
+		}
+		usage += column_usage;
+	}
+	table->usage = usage;
+	table->nitems += nslots;
+	MemoryContextSwitchTo(oldcxt);
+
+	if (usage > table->segment_sz)
+		writeOutArrowRecordBatch(aw_state, false);
+
+	return slots;
+}
+#endif
+
 /*
  * ArrowEndForeignModify
  */
@@ -3848,8 +8128,8 @@ arrowFieldLength(ArrowField *field, int64 nitems)
 					elog(ERROR, "Not a supported Interval unit");
 			}
 			break;
-		case ArrowNodeTag__Struct:	//to be supported later
-			length = 0;		/* only nullmap */
+		case ArrowNodeTag__Struct:
+			length = 0;		/* only nullmap; sub-fields have own buffers */
 			break;
 		case ArrowNodeTag__FixedSizeBinary:
 			length = (size_t)type->FixedSizeBinary.byteWidth * nitems;
@@ -4429,10 +8709,14 @@ pg_datum_arrow_ref(kern_data_store *kds,
 							   sub_isnull + j);
 		}
 		htup = heap_form_tuple(tupdesc, sub_values, sub_isnull);
-
+		/*
+		 * NOTE: datum must be a palloc'ed chunk by itself, because
+		 * pg_array_arrow_ref() releases the element datum once it is
+		 * copied to the array; in case of List of Struct.
+		 */
+		datum = heap_copy_tuple_as_datum(htup, tupdesc);
+		heap_freetuple(htup);
 		ReleaseTupleDesc(tupdesc);
-
-		datum = PointerGetDatum(htup->t_data);
 		isnull = false;
 	}
 	else if (cmeta->atttypkind != TYPE_KIND__NULL)
@@ -4538,6 +8822,76 @@ KDS_fetch_tuple_arrow(TupleTableSlot *slot,
 /*
  * arrowFdwExtractFilesList
  */
+static List *
+__arrowFdwAppendFilePath(List *filesList, const char *fname)
+{
+	glob_t		gl;
+	size_t		i;
+	int			rv;
+
+	/* a simple file path, if no wildcard characters */
+	if (!strpbrk(fname, "*?["))
+		return lappend(filesList, makeString(pstrdup(fname)));
+
+	rv = glob(fname, GLOB_ERR, NULL, &gl);
+	if (rv == GLOB_NOMATCH)
+		return filesList;
+	else if (rv != 0)
+		elog(ERROR, "arrow: failed on glob('%s'): %m", fname);
+	for (i=0; i < gl.gl_pathc; i++)
+		filesList = lappend(filesList, makeString(pstrdup(gl.gl_pathv[i])));
+	globfree(&gl);
+
+	return filesList;
+}
+
+static List *
+__arrowFdwScanDirectory(List *filesList,
+						const char *dir_path,
+						const char *dir_suffix)
+{
+	struct dirent *dentry;
+	struct stat	st_buf;
+	DIR		   *dir;
+	char	   *temp;
+
+	dir = AllocateDir(dir_path);
+	while ((dentry = ReadDir(dir, dir_path)) != NULL)
+	{
+		if (strcmp(dentry->d_name, ".") == 0 ||
+			strcmp(dentry->d_name, "..") == 0)
+			continue;
+		temp = psprintf("%s/%s", dir_path, dentry->d_name);
+		/* dive into the sub-directory, like hive-style partitions */
+		if (stat(temp, &st_buf) == 0 && S_ISDIR(st_buf.st_mode))
+		{
+			filesList = __arrowFdwScanDirectory(filesList, temp, dir_suffix);
+			pfree(temp);
+			continue;
+		}
+		if (dir_suffix)
+		{
+			int		dlen = strlen(dentry->d_name);
+			int		slen = strlen(dir_suffix);
+			int		diff;
+
+			if (dlen < 2 + slen)
+				goto skip;
+			diff = dlen - slen;
+			if (dentry->d_name[diff-1] != '.' ||
+				strcmp(dentry->d_name + diff, dir_suffix) != 0)
+				goto skip;
+		}
+		filesList = lappend(filesList, makeString(temp));
+		continue;
+	skip:
+		pfree(temp);
+	}
+	FreeDir(dir);
+
+	return filesList;
+}
+
 static List *
 __arrowFdwExtractFilesList(List *options_list,
 						   int *p_parallel_nworkers,
@@ -4557,8 +8911,8 @@ __arrowFdwExtractFilesList(List *options_list,
 		Assert(IsA(defel->arg, String));
 		if (strcmp(defel->defname, "file") == 0)
 		{
-			char   *temp = strVal(defel->arg);
-			filesList = lappend(filesList, makeString(pstrdup(temp)));
+			filesList = __arrowFdwAppendFilePath(filesList,
+												 strVal(defel->arg));
 		}
 		else if (strcmp(defel->defname, "files") == 0)
 		{
@@ -4574,7 +8928,7 @@ __arrowFdwExtractFilesList(List *options_list,
 				while (pos >= tok && isspace(*pos))
 					*pos-- = '\0';
 
-				filesList = lappend(filesList, makeString(pstrdup(tok)));
+				filesList = __arrowFdwAppendFilePath(filesList, tok);
 
 				temp = NULL;
 			}
@@ -4614,35 +8968,7 @@ __arrowFdwExtractFilesList(List *options_list,
 	}
 
 	if (dir_path)
-	{
-		struct dirent *dentry;
-		DIR	   *dir;
-		char   *temp;
-
-		dir = AllocateDir(dir_path);
-		while ((dentry = ReadDir(dir, dir_path)) != NULL)
-		{
-			if (strcmp(dentry->d_name, ".") == 0 ||
-				strcmp(dentry->d_name, "..") == 0)
-				continue;
-			if (dir_suffix)
-			{
-				int		dlen = strlen(dentry->d_name);
-				int		slen = strlen(dir_suffix);
-				int		diff;
-
-				if (dlen < 2 + slen)
-					continue;
-				diff = dlen - slen;
-				if (dentry->d_name[diff-1] != '.' ||
-					strcmp(dentry->d_name + diff, dir_suffix) != 0)
-					continue;
-			}
-			temp = psprintf("%s/%s", dir_path, dentry->d_name);
-			filesList = lappend(filesList, makeString(temp));
-		}
-		FreeDir(dir);
-	}
+		filesList = __arrowFdwScanDirectory(filesList, dir_path, dir_suffix);
 
 	if (filesList == NIL)
 		elog(ERROR, "no files are configured on behalf of the arrow_fdw foreign table");
@@ -4688,6 +9014,324 @@ arrowFdwExtractFilesList(List *options_list)
 	return __arrowFdwExtractFilesList(options_list, NULL, NULL);
 }
 
+/*
+ * Hive-style partition support
+ *
+ * When files are organized like '.../dt=2021-04-01/hour=12/xxx.arrow',
+ * the trailing columns of the foreign table whose names are the keys of
+ * the path segments are handled as virtual partition columns; that take
+ * the value on the path, not from the Arrow file.
+ * WHERE-clause that references only partition columns is evaluated for
+ * each file prior to opening, then the files that never match are
+ * pruned at both of the planning and the execution time.
+ */
+#define HIVE_DEFAULT_PARTITION		"__HIVE_DEFAULT_PARTITION__"
+
+static inline int
+__hexdigit(int c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/*
+ * __arrowFdwLookupPartitionValue
+ *
+ * It looks up the path segment of 'key=value' form, then returns
+ * the (unescaped) value. If a key appears multiple times, the deepest
+ * one is valid. *p_found shall be false, if no such segment.
+ */
+static char *
+__arrowFdwLookupPartitionValue(const char *fname, const char *key,
+							   bool *p_found)
+{
+	const char *seg = fname;
+	const char *tail = NULL;
+	const char *value = NULL;
+	size_t		keylen = strlen(key);
+	char	   *result;
+	int			i;
+
+	while (seg && *seg != '\0')
+	{
+		const char *next = strchr(seg, '/');
+
+		if (strncmp(seg, key, keylen) == 0 && seg[keylen] == '=')
+		{
+			value = seg + keylen + 1;
+			tail = (next ? next : seg + strlen(seg));
+		}
+		seg = (next ? next + 1 : NULL);
+	}
+	if (p_found)
+		*p_found = (value != NULL);
+	if (!value ||
+		(tail - value == sizeof(HIVE_DEFAULT_PARTITION) - 1 &&
+		 strncmp(value, HIVE_DEFAULT_PARTITION, tail - value) == 0))
+		return NULL;
+
+	/* unescape %XX sequence */
+	result = palloc(tail - value + 1);
+	for (i=0; value < tail; value++)
+	{
+		if (value[0] == '%' && value + 2 < tail &&
+			__hexdigit(value[1]) >= 0 &&
+			__hexdigit(value[2]) >= 0)
+		{
+			result[i++] = (__hexdigit(value[1]) << 4) | __hexdigit(value[2]);
+			value += 2;
+		}
+		else
+			result[i++] = *value;
+	}
+	result[i] = '\0';
+
+	return result;
+}
+
+/*
+ * arrowFdwPartitionColumns
+ *
+ * It returns number of the trailing columns being partition keys.
+ */
+static int
+arrowFdwPartitionColumns(TupleDesc tupdesc, List *filesList)
+{
+	int			j, part_ncols = 0;
+
+	for (j=tupdesc->natts-1; j >= 0; j--)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		ListCell   *lc;
+		bool		found = false;
+
+		if (attr->attisdropped)
+			break;
+		foreach (lc, filesList)
+		{
+			const char *fname = strVal(lfirst(lc));
+
+			if (!strchr(fname, '='))
+				continue;
+			__arrowFdwLookupPartitionValue(fname, NameStr(attr->attname),
+										   &found);
+			if (found)
+				break;
+		}
+		if (!found)
+			break;
+		part_ncols++;
+	}
+	return part_ncols;
+}
+
+/*
+ * arrowFdwPartitionQualIsPrunable
+ *
+ * A qualifier is available for file pruning, if it references only
+ * partition columns, and contains neither parameters, sub-plans nor
+ * volatile functions.
+ */
+static bool
+__arrowFdwPartitionQualWalker(Node *node, void *context)
+{
+	AttrNumber	anum_min = *((AttrNumber *)context);
+
+	if (!node)
+		return false;
+	if (IsA(node, Var))
+	{
+		Var	   *var = (Var *)node;
+
+		if (var->varlevelsup != 0 || var->varattno < anum_min)
+			return true;
+		return false;
+	}
+	if (IsA(node, Param) ||
+		IsA(node, SubPlan) ||
+		IsA(node, SubLink) ||
+		IsA(node, PlaceHolderVar))
+		return true;
+	return expression_tree_walker(node, __arrowFdwPartitionQualWalker,
+								  context);
+}
+
+static bool
+arrowFdwPartitionQualIsPrunable(Node *qual, AttrNumber anum_min)
+{
+	if (!contain_var_clause(qual) ||
+		contain_volatile_functions(qual))
+		return false;
+	return !__arrowFdwPartitionQualWalker(qual, &anum_min);
+}
+
+/*
+ * arrowFdwPrunePartitionFiles
+ */
+static List *
+arrowFdwPrunePartitionFiles(TupleDesc tupdesc,
+							List *filesList,
+							int part_ncols,
+							List *quals)
+{
+	AttrNumber	anum_min = tupdesc->natts - part_ncols + 1;
+	List	   *prunable = NIL;
+	List	   *result = NIL;
+	List	   *exprStates = NIL;
+	EState	   *estate;
+	ExprContext *econtext;
+	TupleTableSlot *slot;
+	MemoryContext oldcxt;
+	FmgrInfo   *finfo;
+	Oid		   *ioparams;
+	ListCell   *lc, *cell;
+	int			j;
+
+	if (part_ncols == 0)
+		return filesList;
+	foreach (lc, quals)
+	{
+		Node   *qual = lfirst(lc);
+
+		if (IsA(qual, RestrictInfo))
+			qual = (Node *)((RestrictInfo *)qual)->clause;
+		if (arrowFdwPartitionQualIsPrunable(qual, anum_min))
+			prunable = lappend(prunable, qual);
+	}
+	if (prunable == NIL)
+		return filesList;
+
+	estate = CreateExecutorState();
+	oldcxt = MemoryContextSwitchTo(estate->es_query_cxt);
+	foreach (lc, prunable)
+		exprStates = lappend(exprStates, ExecInitExpr(lfirst(lc), NULL));
+	finfo = palloc0(sizeof(FmgrInfo) * part_ncols);
+	ioparams = palloc0(sizeof(Oid) * part_ncols);
+	for (j=0; j < part_ncols; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, anum_min - 1 + j);
+		Oid		typinput;
+
+		getTypeInputInfo(attr->atttypid, &typinput, &ioparams[j]);
+		fmgr_info(typinput, &finfo[j]);
+	}
+	slot = MakeSingleTupleTableSlot(tupdesc, &TTSOpsVirtual);
+	MemoryContextSwitchTo(oldcxt);
+
+	econtext = GetPerTupleExprContext(estate);
+	econtext->ecxt_scantuple = slot;
+	foreach (lc, filesList)
+	{
+		const char *fname = strVal(lfirst(lc));
+		bool		matched = true;
+
+		ResetExprContext(econtext);
+		oldcxt = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+		ExecClearTuple(slot);
+		memset(slot->tts_isnull, true, sizeof(bool) * tupdesc->natts);
+		for (j=0; j < part_ncols; j++)
+		{
+			Form_pg_attribute attr = tupleDescAttr(tupdesc, anum_min - 1 + j);
+			char   *value;
+
+			value = __arrowFdwLookupPartitionValue(fname,
+												   NameStr(attr->attname),
+												   NULL);
+			if (value)
+			{
+				slot->tts_values[anum_min - 1 + j] =
+					InputFunctionCall(&finfo[j], value,
+									  ioparams[j],
+									  attr->atttypmod);
+				slot->tts_isnull[anum_min - 1 + j] = false;
+			}
+		}
+		ExecStoreVirtualTuple(slot);
+
+		foreach (cell, exprStates)
+		{
+			ExprState  *exprState = lfirst(cell);
+			Datum		datum;
+			bool		isnull;
+
+			datum = ExecEvalExpr(exprState, econtext, &isnull);
+			if (isnull || !DatumGetBool(datum))
+			{
+				matched = false;
+				break;
+			}
+		}
+		MemoryContextSwitchTo(oldcxt);
+
+		if (matched)
+			result = lappend(result, lfirst(lc));
+	}
+	ExecDropSingleTupleTableSlot(slot);
+	FreeExecutorState(estate);
+
+	return result;
+}
+
+/*
+ * arrowFdwSetupPartitionColumns
+ *
+ * It extends the RecordBatchState (built from the file) with the trailing
+ * partition columns, if the Arrow file does not contain them.
+ */
+static RecordBatchState *
+arrowFdwSetupPartitionColumns(RecordBatchState *rb_state,
+							  TupleDesc tupdesc,
+							  const char *fname,
+							  int part_ncols)
+{
+	RecordBatchState *result;
+	int			j;
+
+	if (part_ncols == 0 ||
+		rb_state->ncols + part_ncols != tupdesc->natts)
+		return rb_state;
+
+	result = palloc0(offsetof(RecordBatchState, columns[tupdesc->natts]));
+	memcpy(result, rb_state, offsetof(RecordBatchState,
+									  columns[rb_state->ncols]));
+	result->ncols = tupdesc->natts;
+	for (j = rb_state->ncols; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		RecordBatchFieldState *fstate = &result->columns[j];
+
+		switch (attr->atttypid)
+		{
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case TEXTOID:
+				break;
+			case DATEOID:
+				fstate->attopts.date.unit = ArrowDateUnit__Day;
+				break;
+			default:
+				elog(ERROR, "arrow_fdw: partition column \"%s\" has unsupported data type: %s",
+					 NameStr(attr->attname),
+					 format_type_be(attr->atttypid));
+		}
+		fstate->atttypid = attr->atttypid;
+		fstate->atttypmod = attr->atttypmod;
+		fstate->nitems = rb_state->rb_nitems;
+		fstate->part_column = true;
+		fstate->part_value =
+			__arrowFdwLookupPartitionValue(fname, NameStr(attr->attname),
+										   NULL);
+		fstate->null_count = (fstate->part_value ? 0 : fstate->nitems);
+	}
+	return result;
+}
+
 
 /*
  * validator of Arrow_Fdw
@@ -4702,13 +9346,21 @@ pgstrom_arrow_fdw_validator(PG_FUNCTION_ARGS)
 	{
 		List	   *filesList;
 		ListCell   *lc;
+		bool		writable;
 
-		filesList = arrowFdwExtractFilesList(options_list);
+		filesList = __arrowFdwExtractFilesList(options_list,
+											   NULL,
+											   &writable);
 		foreach (lc, filesList)
 		{
 			ArrowFileInfo	af_info;
 			const char	   *fname = strVal(lfirst(lc));
 
+			if (writable && arrowFdwFileIsParquet(fname))
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("arrow_fdw: parquet file \"%s\" is not writable",
+								fname)));
 			readArrowFile(fname, &af_info, true);
 		}
 	}
@@ -4754,6 +9406,7 @@ arrow_fdw_precheck_schema(Relation rel)
 	List		   *filesList;
 	ListCell	   *lc;
 	bool			writable;
+	int				part_ncols = 0;
 #if 0
 	int				j;
 
@@ -4773,6 +9426,8 @@ arrow_fdw_precheck_schema(Relation rel)
 	filesList = __arrowFdwExtractFilesList(ft->options,
 										   NULL,
 										   &writable);
+	if (!writable)
+		part_ncols = arrowFdwPartitionColumns(tupdesc, filesList);
 	foreach (lc, filesList)
 	{
 		const char *fname = strVal(lfirst(lc));
@@ -4789,11 +9444,13 @@ arrow_fdw_precheck_schema(Relation rel)
 				 fname, RelationGetRelationName(rel));
 		}
 		/* check schema compatibility */
-		rb_cached = arrowLookupOrBuildMetadataCache(filp, NULL);
+		rb_cached = __arrowLookupOrBuildMetadataCache(filp, NULL, -1);
 		foreach (cell, rb_cached)
 		{
 			RecordBatchState *rb_state = lfirst(cell);
 
+			rb_state = arrowFdwSetupPartitionColumns(rb_state, tupdesc,
+													 fname, part_ncols);
 			if (!arrowSchemaCompatibilityCheck(tupdesc, rb_state))
 				elog(ERROR, "arrow file '%s' on behalf of the foreign table '%s' has incompatible schema definition",
 					 fname, RelationGetRelationName(rel));
@@ -4904,24 +9561,51 @@ __arrowInvalidateMetadataCache(arrowMetadataCache *mcache, bool detach_lru)
 }
 
 static void
-arrowInvalidateMetadataCache(MetadataCacheKey *mkey, bool detach_lru)
+arrowInvalidateMetadataCache(MetadataCacheKey *mkey, bool detach_lru)
+{
+	dlist_mutable_iter miter;
+	int		index = mkey->hash % ARROW_METADATA_HASH_NSLOTS;
+
+	dlist_foreach_modify(miter, &arrow_metadata_state->hash_slots[index])
+	{
+		arrowMetadataCache *mcache
+			= dlist_container(arrowMetadataCache, chain, miter.cur);
+
+		if (mcache->stat_buf.st_dev == mkey->st_dev &&
+			mcache->stat_buf.st_ino == mkey->st_ino)
+		{
+			elog(DEBUG2, "arrow_fdw: metadata cache invalidation for the file (st_dev=%lu/st_ino=%lu)",
+				 mkey->st_dev, mkey->st_ino);
+			__arrowInvalidateMetadataCache(mcache, true);
+		}
+	}
+	arrowUnlinkMetadataCacheFile(mkey->st_dev, mkey->st_ino);
+}
+
+/*
+ * arrowMarkMetadataCacheStale
+ *
+ * NOTE: record-batches were appended to the file, so the metadata cache
+ * no longer reflects the latest footer, however, it is still valid for
+ * the snapshot reads (arrow_fdw.snapshot_batches) on the prefix.
+ * Caller must have lock_slots[] with EXCLUSIVE mode.
+ */
+static void
+arrowMarkMetadataCacheStale(MetadataCacheKey *mkey)
 {
-	dlist_mutable_iter miter;
+	dlist_iter	iter;
 	int		index = mkey->hash % ARROW_METADATA_HASH_NSLOTS;
 
-	dlist_foreach_modify(miter, &arrow_metadata_state->hash_slots[index])
+	dlist_foreach(iter, &arrow_metadata_state->hash_slots[index])
 	{
 		arrowMetadataCache *mcache
-			= dlist_container(arrowMetadataCache, chain, miter.cur);
+			= dlist_container(arrowMetadataCache, chain, iter.cur);
 
 		if (mcache->stat_buf.st_dev == mkey->st_dev &&
 			mcache->stat_buf.st_ino == mkey->st_ino)
-		{
-			elog(DEBUG2, "arrow_fdw: metadata cache invalidation for the file (st_dev=%lu/st_ino=%lu)",
-				 mkey->st_dev, mkey->st_ino);
-			__arrowInvalidateMetadataCache(mcache, true);
-		}
+			mcache->stale = true;
 	}
+	arrowUnlinkMetadataCacheFile(mkey->st_dev, mkey->st_ino);
 }
 
 /*
@@ -4986,6 +9670,8 @@ makeRecordBatchStateFromCache(arrowMetadataCache *mcache,
 	rbstate->rb_offset = mcache->rb_offset;
 	rbstate->rb_length = mcache->rb_length;
 	rbstate->rb_nitems = mcache->rb_nitems;
+	rbstate->rb_codec  = mcache->rb_codec;
+	rbstate->rb_parquet = mcache->rb_parquet;
 	rbstate->ncols = mcache->ncols;
 	copyMetadataFieldCache(rbstate->columns,
 						   rbstate->columns + mcache->nfields,
@@ -4997,6 +9683,9 @@ makeRecordBatchStateFromCache(arrowMetadataCache *mcache,
 
 /*
  * arrowReclaimMetadataCache
+ *
+ * NOTE: entries evicted from the shared memory are still kept on the
+ * on-disk metadata cache, if arrow_fdw.metadata_cache_dir is configured.
  */
 static void
 arrowReclaimMetadataCache(void)
@@ -5054,6 +9743,278 @@ arrowReclaimMetadataCache(void)
 	} while (consumed > arrow_metadata_cache_size);
 }
 
+/*
+ * On-disk metadata cache
+ *
+ * Once metadata of an arrow (or parquet) file is built, it is also written
+ * out to arrow_fdw.metadata_cache_dir, so the next backend after restart of
+ * the postmaster, or after eviction from the shared memory by LRU, can load
+ * it without parsing the file footer again. It is validated lazily towards
+ * the file status on the lookup time.
+ */
+#define ARROW_METADATA_FILE_MAGIC		"PGSTRARM"
+#define ARROW_METADATA_FILE_VERSION		2
+
+typedef struct
+{
+	char		magic[8];
+	uint32		version;
+	uint32		fstate_sz;	/* sizeof(RecordBatchFieldState) */
+	uint32		nitems;		/* number of RecordBatches */
+	dev_t		st_dev;
+	ino_t		st_ino;
+	off_t		st_size;
+	struct timespec st_mtim;
+	struct timespec st_ctim;
+} arrowMetadataFileHead;
+
+typedef struct
+{
+	int			rb_index;
+	off_t		rb_offset;
+	size_t		rb_length;
+	int64		rb_nitems;
+	int			rb_codec;
+	bool		rb_parquet;
+	int			ncols;
+	int			nfields;
+	/* children is index+1 in the fstate[] array, or 0 if nothing */
+	RecordBatchFieldState fstate[FLEXIBLE_ARRAY_MEMBER];
+} arrowMetadataFileItem;
+
+static bool
+arrowMetadataCacheFileName(char *fname, size_t len,
+						   dev_t st_dev, ino_t st_ino)
+{
+	if (!arrow_metadata_cache_dir || arrow_metadata_cache_dir[0] == '\0')
+		return false;
+	snprintf(fname, len, "%s/%lx-%lx.meta",
+			 arrow_metadata_cache_dir,
+			 (unsigned long)st_dev,
+			 (unsigned long)st_ino);
+	return true;
+}
+
+static void
+arrowUnlinkMetadataCacheFile(dev_t st_dev, ino_t st_ino)
+{
+	char		fname[MAXPGPATH];
+
+	if (arrowMetadataCacheFileName(fname, sizeof(fname), st_dev, st_ino) &&
+		unlink(fname) != 0 && errno != ENOENT)
+		elog(DEBUG1, "arrow_fdw: failed on unlink('%s'): %m", fname);
+}
+
+/*
+ * arrowWriteMetadataCacheFile
+ *
+ * It is a best-effort; any errors are not raised.
+ */
+static void
+arrowWriteMetadataCacheFile(List *rb_state_list, struct stat *stat_buf)
+{
+	arrowMetadataFileHead head;
+	StringInfoData buf;
+	char		fname[MAXPGPATH];
+	char		tname[MAXPGPATH];
+	ListCell   *lc;
+	int			fdesc;
+
+	if (!arrowMetadataCacheFileName(fname, sizeof(fname),
+									stat_buf->st_dev,
+									stat_buf->st_ino))
+		return;
+
+	memset(&head, 0, sizeof(arrowMetadataFileHead));
+	memcpy(head.magic, ARROW_METADATA_FILE_MAGIC, sizeof(head.magic));
+	head.version   = ARROW_METADATA_FILE_VERSION;
+	head.fstate_sz = sizeof(RecordBatchFieldState);
+	head.nitems    = list_length(rb_state_list);
+	head.st_dev    = stat_buf->st_dev;
+	head.st_ino    = stat_buf->st_ino;
+	head.st_size   = stat_buf->st_size;
+	head.st_mtim   = stat_buf->st_mtim;
+	head.st_ctim   = stat_buf->st_ctim;
+
+	initStringInfo(&buf);
+	appendBinaryStringInfo(&buf, (char *)&head, sizeof(arrowMetadataFileHead));
+	foreach (lc, rb_state_list)
+	{
+		RecordBatchState *rbstate = lfirst(lc);
+		arrowMetadataFileItem *item;
+		int			nfields = RecordBatchFieldCount(rbstate);
+		size_t		sz = MAXALIGN(offsetof(arrowMetadataFileItem,
+										   fstate[nfields]));
+		int			j;
+
+		item = palloc0(sz);
+		item->rb_index   = rbstate->rb_index;
+		item->rb_offset  = rbstate->rb_offset;
+		item->rb_length  = rbstate->rb_length;
+		item->rb_nitems  = rbstate->rb_nitems;
+		item->rb_codec   = rbstate->rb_codec;
+		item->rb_parquet = rbstate->rb_parquet;
+		item->ncols      = rbstate->ncols;
+		item->nfields    = copyMetadataFieldCache(item->fstate,
+												  item->fstate + nfields,
+												  rbstate->ncols,
+												  rbstate->columns,
+												  NULL);
+		Assert(item->nfields == nfields);
+		/* pointers to index */
+		for (j=0; j < nfields; j++)
+		{
+			RecordBatchFieldState *fstate = &item->fstate[j];
+
+			if (fstate->children)
+				fstate->children = (RecordBatchFieldState *)
+					((fstate->children - item->fstate) + 1);
+		}
+		appendBinaryStringInfo(&buf, (char *)item, sz);
+		pfree(item);
+	}
+
+	if (mkdir(arrow_metadata_cache_dir, pg_dir_create_mode) != 0 &&
+		errno != EEXIST)
+	{
+		elog(DEBUG1, "arrow_fdw: failed on mkdir('%s'): %m",
+			 arrow_metadata_cache_dir);
+		goto out;
+	}
+	snprintf(tname, sizeof(tname), "%s.%d.tmp", fname, MyProcPid);
+	fdesc = OpenTransientFile(tname, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (fdesc < 0)
+	{
+		elog(DEBUG1, "arrow_fdw: failed on open('%s'): %m", tname);
+		goto out;
+	}
+	if (__writeFile(fdesc, buf.data, buf.len) != buf.len)
+	{
+		elog(DEBUG1, "arrow_fdw: failed on write('%s'): %m", tname);
+		CloseTransientFile(fdesc);
+		unlink(tname);
+		goto out;
+	}
+	CloseTransientFile(fdesc);
+	if (rename(tname, fname) != 0)
+	{
+		elog(DEBUG1, "arrow_fdw: failed on rename('%s','%s'): %m",
+			 tname, fname);
+		unlink(tname);
+	}
+out:
+	pfree(buf.data);
+}
+
+/*
+ * arrowReadMetadataCacheFile
+ *
+ * It returns a list of RecordBatchState, if valid on-disk metadata cache
+ * exists. Obsoleted or broken ones are removed.
+ */
+static List *
+arrowReadMetadataCacheFile(File fdesc, struct stat *stat_buf,
+						   Bitmapset **p_stat_attrs)
+{
+	arrowMetadataFileHead *head;
+	char		fname[MAXPGPATH];
+	struct stat	meta_buf;
+	char	   *data = NULL;
+	char	   *pos, *end;
+	List	   *results = NIL;
+	int			meta_fd;
+	int			i, j;
+
+	if (!arrowMetadataCacheFileName(fname, sizeof(fname),
+									stat_buf->st_dev,
+									stat_buf->st_ino))
+		return NIL;
+	meta_fd = OpenTransientFile(fname, O_RDONLY | PG_BINARY);
+	if (meta_fd < 0)
+		return NIL;
+	if (fstat(meta_fd, &meta_buf) != 0 ||
+		meta_buf.st_size < sizeof(arrowMetadataFileHead))
+		goto invalid;
+	data = palloc(meta_buf.st_size);
+	if (__readFile(meta_fd, data, meta_buf.st_size) != meta_buf.st_size)
+		goto invalid;
+	head = (arrowMetadataFileHead *)data;
+	if (memcmp(head->magic, ARROW_METADATA_FILE_MAGIC,
+			   sizeof(head->magic)) != 0 ||
+		head->version != ARROW_METADATA_FILE_VERSION ||
+		head->fstate_sz != sizeof(RecordBatchFieldState) ||
+		head->st_dev != stat_buf->st_dev ||
+		head->st_ino != stat_buf->st_ino ||
+		head->st_size != stat_buf->st_size ||
+		timespec_comp(&head->st_mtim, &stat_buf->st_mtim) != 0 ||
+		timespec_comp(&head->st_ctim, &stat_buf->st_ctim) != 0)
+		goto invalid;
+
+	pos = data + sizeof(arrowMetadataFileHead);
+	end = data + meta_buf.st_size;
+	for (i=0; i < head->nitems; i++)
+	{
+		arrowMetadataFileItem *item = (arrowMetadataFileItem *)pos;
+		RecordBatchState *rbstate;
+		size_t		sz;
+
+		if (end - pos < offsetof(arrowMetadataFileItem, fstate))
+			goto invalid;
+		sz = MAXALIGN(offsetof(arrowMetadataFileItem,
+							   fstate[item->nfields]));
+		if (item->nfields < item->ncols || end - pos < sz)
+			goto invalid;
+		rbstate = palloc0(offsetof(RecordBatchState,
+								   columns[item->nfields]));
+		rbstate->fdesc      = fdesc;
+		memcpy(&rbstate->stat_buf, stat_buf, sizeof(struct stat));
+		rbstate->rb_index   = item->rb_index;
+		rbstate->rb_offset  = item->rb_offset;
+		rbstate->rb_length  = item->rb_length;
+		rbstate->rb_nitems  = item->rb_nitems;
+		rbstate->rb_codec   = item->rb_codec;
+		rbstate->rb_parquet = item->rb_parquet;
+		rbstate->ncols      = item->ncols;
+		memcpy(rbstate->columns, item->fstate,
+			   sizeof(RecordBatchFieldState) * item->nfields);
+		/* index to pointers */
+		for (j=0; j < item->nfields; j++)
+		{
+			RecordBatchFieldState *fstate = &rbstate->columns[j];
+			uintptr_t	index = (uintptr_t)fstate->children;
+
+			if (index == 0)
+				continue;
+			if (index > item->nfields ||
+				index - 1 + fstate->num_children > item->nfields)
+				goto invalid;
+			fstate->children = rbstate->columns + (index - 1);
+		}
+		for (j=0; j < item->ncols; j++)
+		{
+			if (p_stat_attrs && !rbstate->columns[j].stat_isnull)
+				*p_stat_attrs = bms_add_member(*p_stat_attrs, j+1);
+		}
+		results = lappend(results, rbstate);
+		pos += sz;
+	}
+	CloseTransientFile(meta_fd);
+	pfree(data);
+	elog(DEBUG2, "arrow_fdw: metadata cache of '%s' was loaded from '%s'",
+		 FilePathName(fdesc), fname);
+	return results;
+
+invalid:
+	CloseTransientFile(meta_fd);
+	if (data)
+		pfree(data);
+	list_free_deep(results);
+	elog(DEBUG2, "arrow_fdw: on-disk metadata cache '%s' is obsolete", fname);
+	if (unlink(fname) != 0 && errno != ENOENT)
+		elog(DEBUG1, "arrow_fdw: failed on unlink('%s'): %m", fname);
+	return NIL;
+}
+
 /*
  * __arrowBuildMetadataCache
  *
@@ -5104,6 +10065,8 @@ __arrowBuildMetadataCache(List *rb_state_list, uint32 hash)
         mtemp->rb_offset = rbstate->rb_offset;
         mtemp->rb_length = rbstate->rb_length;
         mtemp->rb_nitems = rbstate->rb_nitems;
+		mtemp->rb_codec  = rbstate->rb_codec;
+		mtemp->rb_parquet = rbstate->rb_parquet;
         mtemp->ncols     = rbstate->ncols;
 		mtemp->nfields   =
 			copyMetadataFieldCache(mtemp->fstate,
@@ -5153,11 +10116,41 @@ checkArrowRecordBatchIsVisible(RecordBatchState *rbstate,
 	return true;
 }
 
+/*
+ * __arrowMetadataCacheCoversSnapshot
+ *
+ * Arrow files are written in append-only manner, so the first N record-
+ * batches of the cached (but stale) entry are still valid, as long as the
+ * file is not shrunk.
+ */
+static bool
+__arrowMetadataCacheCoversSnapshot(arrowMetadataCache *mcache,
+								   struct stat *stat_buf,
+								   int snapshot_batches)
+{
+	dlist_iter	iter;
+	int			count = 1;
+
+	if (snapshot_batches < 0 ||
+		mcache->rb_parquet ||
+		stat_buf->st_size < mcache->stat_buf.st_size)
+		return false;
+	dlist_foreach(iter, &mcache->siblings)
+	{
+		if (count >= snapshot_batches)
+			break;
+		count++;
+	}
+	return (count >= snapshot_batches);
+}
+
 /*
  * arrowLookupOrBuildMetadataCache
  */
-List *
-arrowLookupOrBuildMetadataCache(File fdesc, Bitmapset **p_stat_attrs)
+static List *
+__arrowLookupOrBuildMetadataCache(File fdesc,
+								  Bitmapset **p_stat_attrs,
+								  int snapshot_batches)
 {
 	MetadataCacheKey key;
 	struct stat	stat_buf;
@@ -5189,10 +10182,13 @@ retry:
 			RecordBatchState *rbstate;
 
 			Assert(mcache->hash == key.hash);
-			if (timespec_comp(&mcache->stat_buf.st_mtim,
-							  &stat_buf.st_mtim) < 0 ||
-				timespec_comp(&mcache->stat_buf.st_ctim,
-							  &stat_buf.st_ctim) < 0)
+			if ((mcache->stale ||
+				 timespec_comp(&mcache->stat_buf.st_mtim,
+							   &stat_buf.st_mtim) < 0 ||
+				 timespec_comp(&mcache->stat_buf.st_ctim,
+							   &stat_buf.st_ctim) < 0) &&
+				!__arrowMetadataCacheCoversSnapshot(mcache, &stat_buf,
+													snapshot_batches))
 			{
 				char	buf1[80], buf2[80], buf3[80], buf4[80];
 				char   *tail;
@@ -5260,14 +10256,46 @@ retry:
 	else
 	{
 		ArrowFileInfo	af_info;
+		ParquetFileInfo	pq_info;
 		arrowMetadataCache *mcache;
 		arrowStatsBinary *arrow_bstats;
 		List		   *rb_state_any = NIL;
+		ListCell	   *lc;
+
+		/* try the on-disk metadata cache first */
+		rb_state_any = arrowReadMetadataCacheFile(fdesc, &stat_buf,
+												  p_stat_attrs);
+		if (rb_state_any != NIL)
+		{
+			foreach (lc, rb_state_any)
+			{
+				RecordBatchState *rb_state = lfirst(lc);
+
+				if (checkArrowRecordBatchIsVisible(rb_state, mvcc_slot))
+					results = lappend(results, rb_state);
+			}
+			goto build_cache;
+		}
 
+		if (parquetFileDescIsValid(FileGetRawDesc(fdesc)))
+		{
+			readParquetFileDesc(FileGetRawDesc(fdesc), &pq_info);
+			for (index = 0; index < pq_info.num_row_groups; index++)
+			{
+				RecordBatchState *rb_state;
+
+				rb_state = makeRecordBatchStateFromParquet(&pq_info,
+											&pq_info.row_groups[index],
+											p_stat_attrs);
+				rb_state->fdesc = fdesc;
+				memcpy(&rb_state->stat_buf, &stat_buf, sizeof(struct stat));
+				rb_state->rb_index = index;
+				results = lappend(results, rb_state);
+				rb_state_any = lappend(rb_state_any, rb_state);
+			}
+			goto write_cache;
+		}
 		readArrowFileDesc(FileGetRawDesc(fdesc), &af_info);
-		if (af_info.dictionaries != NULL)
-			elog(ERROR, "DictionaryBatch is not supported");
-		Assert(af_info.footer._num_dictionaries == 0);
 
 		if (af_info.recordBatches == NULL)
 			elog(DEBUG2, "arrow file '%s' contains no RecordBatch",
@@ -5282,7 +10310,8 @@ retry:
 			ArrowRecordBatch *rbatch
 			   = &af_info.recordBatches[index].body.recordBatch;
 
-			rb_state = makeRecordBatchState(&af_info.footer.schema,
+			rb_state = makeRecordBatchState(&af_info,
+											&af_info.footer.schema,
 											block, rbatch);
 			rb_state->fdesc = fdesc;
 			memcpy(&rb_state->stat_buf, &stat_buf, sizeof(struct stat));
@@ -5296,6 +10325,9 @@ retry:
 			rb_state_any = lappend(rb_state_any, rb_state);
 		}
 		releaseArrowStatsBinary(arrow_bstats);
+	write_cache:
+		arrowWriteMetadataCacheFile(rb_state_any, &stat_buf);
+	build_cache:
 		/* try to build a metadata cache for further references */
 		mcache = __arrowBuildMetadataCache(rb_state_any, key.hash);
 		if (mcache)
@@ -5317,6 +10349,31 @@ retry:
 	return results;
 }
 
+static List *
+arrowLookupOrBuildMetadataCache(File fdesc, Bitmapset **p_stat_attrs)
+{
+	List	   *rb_cached;
+	List	   *results = NIL;
+	ListCell   *lc;
+
+	rb_cached = __arrowLookupOrBuildMetadataCache(fdesc, p_stat_attrs,
+												  arrow_snapshot_batches);
+	if (arrow_snapshot_batches < 0)
+		return rb_cached;
+	/* only the first N record-batches are visible on the snapshot */
+	foreach (lc, rb_cached)
+	{
+		RecordBatchState *rb_state = lfirst(lc);
+
+		if (rb_state->rb_parquet ||
+			rb_state->rb_index < arrow_snapshot_batches)
+			results = lappend(results, rb_state);
+	}
+	list_free(rb_cached);
+
+	return results;
+}
+
 /*
  * lookup_type_extension_info
  */
@@ -5380,6 +10437,7 @@ __setupArrowSQLbufferField(SQLtable *table,
 	const char	   *extname;
 	const char	   *extschema;
 	SQLstat		   *stat_list;
+	int				k;
 
 	/* walk down to the base type, if domain */
 	for (;;)
@@ -5427,6 +10485,17 @@ __setupArrowSQLbufferField(SQLtable *table,
 			column->stat_enabled = true;
 			table->has_statistics = true;
 		}
+		/* also, bloom filters if any */
+		for (k=0; k < afield->_num_custom_metadata; k++)
+		{
+			if (strcmp(afield->custom_metadata[k].key, "bloom_filters") == 0)
+			{
+				column->bloom_list =
+					__buildArrowFieldBloomList(afield, table->numRecordBatches);
+				column->bloom_enabled = true;
+				break;
+			}
+		}
 	}
 	
 	if (OidIsValid(__type->typelem) && __type->typlen == -1)
@@ -5484,7 +10553,7 @@ __setupArrowSQLbufferField(SQLtable *table,
 	ReleaseSysCache(tup);
 }
 
-static void
+void
 setupArrowSQLbufferSchema(SQLtable *table, TupleDesc tupdesc,
 						  ArrowFileInfo *af_info)
 {
@@ -5663,6 +10732,210 @@ createArrowWriteRedoLog(File filp, bool is_newfile)
 	return redo->footer_offset;
 }
 
+/*
+ * Write-behind of record-batches
+ *
+ * When arrow_fdw.write_behind is enabled, the file image of record-batches
+ * is copied to the private buffer, then written out by the background
+ * thread of the backend, so INSERT can continue to buffer rows meanwhile.
+ * The queue is always drained prior to the footer write, and prior to
+ * the application of REDO logs on transaction abort; so REDO log still
+ * restores the original footer and the file length.
+ */
+typedef struct arrowWriteBehindChunk
+{
+	struct arrowWriteBehindChunk *next;
+	const char *fname;
+	int			fdesc;
+	off_t		f_pos;
+	size_t		length;
+	char		data[FLEXIBLE_ARRAY_MEMBER];
+} arrowWriteBehindChunk;
+
+#define ARROW_WRITE_BEHIND_DEPTH		2
+
+static struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t	cond;
+	bool		thread_is_running;
+	arrowWriteBehindChunk *head;	/* queue of chunks to be written */
+	arrowWriteBehindChunk *tail;
+	int			npending;			/* queued + in-progress chunks */
+	int			error_code;			/* errno of the failed write, if any */
+	char		error_fname[MAXPGPATH];
+} arrow_write_behind = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void *
+arrowWriteBehindMain(void *__arg)
+{
+	arrowWriteBehindChunk *chunk;
+	ssize_t		nbytes;
+	size_t		offset;
+	int			error_code;
+
+	pthread_mutex_lock(&arrow_write_behind.lock);
+	for (;;)
+	{
+		chunk = arrow_write_behind.head;
+		if (!chunk)
+		{
+			pthread_cond_wait(&arrow_write_behind.cond,
+							  &arrow_write_behind.lock);
+			continue;
+		}
+		arrow_write_behind.head = chunk->next;
+		if (!arrow_write_behind.head)
+			arrow_write_behind.tail = NULL;
+		pthread_mutex_unlock(&arrow_write_behind.lock);
+
+		/* write out the chunk */
+		offset = 0;
+		error_code = 0;
+		while (offset < chunk->length)
+		{
+			nbytes = pwrite(chunk->fdesc,
+							chunk->data + offset,
+							chunk->length - offset,
+							chunk->f_pos + offset);
+			if (nbytes > 0)
+				offset += nbytes;
+			else if (nbytes == 0)
+			{
+				error_code = ENOSPC;
+				break;
+			}
+			else if (errno != EINTR)
+			{
+				error_code = errno;
+				break;
+			}
+		}
+
+		pthread_mutex_lock(&arrow_write_behind.lock);
+		if (error_code != 0 && arrow_write_behind.error_code == 0)
+		{
+			arrow_write_behind.error_code = error_code;
+			strncpy(arrow_write_behind.error_fname, chunk->fname,
+					MAXPGPATH - 1);
+		}
+		arrow_write_behind.npending--;
+		free(chunk);
+		pthread_cond_broadcast(&arrow_write_behind.cond);
+	}
+	return NULL;
+}
+
+/*
+ * arrowWriteBehindWait - wait until the number of pending chunks gets less
+ * than or equal to 'nwaits'. It raises an error if any writes failed.
+ */
+static void
+arrowWriteBehindWait(int nwaits, bool report_error)
+{
+	int			error_code;
+	char		error_fname[MAXPGPATH];
+
+	if (!arrow_write_behind.thread_is_running)
+		return;
+	for (;;)
+	{
+		pthreadMutexLock(&arrow_write_behind.lock);
+		if (arrow_write_behind.npending <= nwaits)
+			break;
+		pthreadCondWaitTimeout(&arrow_write_behind.cond,
+							   &arrow_write_behind.lock, 100L);
+		pthreadMutexUnlock(&arrow_write_behind.lock);
+		if (report_error)
+			CHECK_FOR_INTERRUPTS();
+	}
+	error_code = arrow_write_behind.error_code;
+	strcpy(error_fname, arrow_write_behind.error_fname);
+	arrow_write_behind.error_code = 0;
+	pthreadMutexUnlock(&arrow_write_behind.lock);
+
+	if (error_code != 0)
+	{
+		errno = error_code;
+		ereport(report_error ? ERROR : WARNING,
+				(errcode_for_file_access(),
+				 errmsg("arrow_fdw: failed on write-behind of \"%s\": %m",
+						error_fname)));
+	}
+}
+
+static void *
+__arrowWriteBehindAllocImage(size_t length, void *data)
+{
+	arrowWriteBehindChunk **p_chunk = data;
+	arrowWriteBehindChunk *chunk;
+
+	chunk = malloc(offsetof(arrowWriteBehindChunk, data[length]));
+	if (!chunk)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory")));
+	chunk->next = NULL;
+	chunk->length = length;
+	*p_chunk = chunk;
+
+	return chunk->data;
+}
+
+static int
+arrowWriteBehindRecordBatch(SQLtable *table)
+{
+	arrowWriteBehindChunk *chunk = NULL;
+	off_t		f_pos = table->f_pos;
+	int			rb_index;
+
+	/* launch the background thread on the first call */
+	if (!arrow_write_behind.thread_is_running)
+	{
+		pthread_t	thread;
+
+		errno = pthread_create(&thread, NULL, arrowWriteBehindMain, NULL);
+		if (errno != 0)
+			elog(ERROR, "failed on pthread_create: %m");
+		pthread_detach(thread);
+		arrow_write_behind.thread_is_running = true;
+	}
+	/* no more chunks than the depth shall be kept */
+	arrowWriteBehindWait(ARROW_WRITE_BEHIND_DEPTH - 1, true);
+
+	PG_TRY();
+	{
+		rb_index = copyArrowRecordBatchImage(table,
+											 __arrowWriteBehindAllocImage,
+											 &chunk);
+	}
+	PG_CATCH();
+	{
+		if (chunk)
+			free(chunk);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	chunk->fname = table->filename;
+	chunk->fdesc = table->fdesc;
+	chunk->f_pos = f_pos;
+
+	pthreadMutexLock(&arrow_write_behind.lock);
+	if (!arrow_write_behind.tail)
+		arrow_write_behind.head = chunk;
+	else
+		arrow_write_behind.tail->next = chunk;
+	arrow_write_behind.tail = chunk;
+	arrow_write_behind.npending++;
+	pthreadCondBroadcast(&arrow_write_behind.cond);
+	pthreadMutexUnlock(&arrow_write_behind.lock);
+
+	return rb_index;
+}
+
 /*
  * writeOutArrowRecordBatch
  */
@@ -5694,7 +10967,10 @@ writeOutArrowRecordBatch(arrowWriteState *aw_state, bool with_footer)
 		}
 		if (table->nitems > 0)
 		{
-			mvcc->record_batch = writeArrowRecordBatch(table);
+			if (arrow_fdw_write_behind)
+				mvcc->record_batch = arrowWriteBehindRecordBatch(table);
+			else
+				mvcc->record_batch = writeArrowRecordBatch(table);
 			sql_table_clear(table);
 			dlist_push_tail(&arrow_metadata_state->mvcc_slots[index],
 							&mvcc->chain);
@@ -5706,7 +10982,11 @@ writeOutArrowRecordBatch(arrowWriteState *aw_state, bool with_footer)
 				 table->nitems);
 		}
 		if (with_footer)
+		{
+			/* footer must follow all the record-batches */
+			arrowWriteBehindWait(0, true);
 			writeArrowFooter(table);
+		}
 
 		/*
 		 * Invalidation of the metadata cache, if any
@@ -5715,8 +10995,10 @@ writeOutArrowRecordBatch(arrowWriteState *aw_state, bool with_footer)
 		 * if st_mtime of the file is newer than st_mtime of the mcache.
 		 * Linux kernel offers nanosecond precision in st_Xtime, but it never
 		 * guarantee the st_Xtime is recorded in nanosecond precision...
+		 * So, we mark the cache stale explicitly; it shall be invalidated
+		 * on the next reference unless the snapshot reads on the prefix.
 		 */
-		arrowInvalidateMetadataCache(&aw_state->key, true);
+		arrowMarkMetadataCacheStale(&aw_state->key);
 
 		LWLockRelease(&arrow_metadata_state->lock_slots[index]);
 	}
@@ -5761,6 +11043,11 @@ __arrowExecTruncateRelation(Relation frel)
 			 RelationGetRelationName(frel));
 	Assert(list_length(filesList) == 1);
 	path_name = strVal(linitial(filesList));
+	if (arrowFdwFileIsParquet(path_name))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("arrow_fdw: parquet file \"%s\" is not writable",
+						path_name)));
 	readArrowFile(path_name, &af_info, false);
 	if (stat(path_name, &stat_buf) != 0)
 		elog(ERROR, "failed on stat('%s'): %m", path_name);
@@ -6026,6 +11313,8 @@ __arrowFdwXactCallback(TransactionId curr_xid, bool is_commit)
 	if (curr_xid == InvalidTransactionId ||
 		dlist_is_empty(&arrow_write_redo_list))
 		return;
+	/* REDO log must be applied after the write-behind */
+	arrowWriteBehindWait(0, false);
 
 	memset(locked, 0, sizeof(locked));
 	dlist_foreach_modify(iter, &arrow_write_redo_list)
@@ -6158,6 +11447,10 @@ pgstrom_init_arrow_fdw(void)
 	r->PlanForeignModify			= ArrowPlanForeignModify;
 	r->BeginForeignModify			= ArrowBeginForeignModify;
 	r->ExecForeignInsert			= ArrowExecForeignInsert;
+#if PG_VERSION_NUM >= 140000
+	r->GetForeignModifyBatchSize	= ArrowGetForeignModifyBatchSize;
+	r->ExecForeignBatchInsert		= ArrowExecForeignBatchInsert;
+#endif
 	r->EndForeignModify				= ArrowEndForeignModify;
 #if PG_VERSION_NUM >= 110000
 	r->BeginForeignInsert			= ArrowBeginForeignInsert;
@@ -6187,6 +11480,17 @@ pgstrom_init_arrow_fdw(void)
 							 PGC_USERSET,
                              GUC_NOT_IN_SAMPLE,
                              NULL, NULL, NULL);
+	/*
+	 * Turn on/off aggregation by min/max statistics
+	 */
+	DefineCustomBoolVariable("arrow_fdw.stats_aggregate",
+							 "Enables GpuPreAgg to aggregate record-batches by min/max statistics",
+							 NULL,
+							 &arrow_fdw_stats_aggregate_enabled,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 	/*
 	 * Configurations for arrow_fdw metadata cache
 	 */
@@ -6215,6 +11519,89 @@ pgstrom_init_arrow_fdw(void)
 							PGC_USERSET,
 							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
 							NULL, NULL, NULL);
+	/*
+	 * Configurations for I/O coalescing and read-ahead
+	 */
+	DefineCustomIntVariable("arrow_fdw.io_coalesce_gap",
+							"maximum gap to coalesce reads of adjacent buffers",
+							NULL,
+							&arrow_io_coalesce_gap_kb,
+							64,			/* default: 64kB */
+							0,
+							16 * 1024,	/* max: 16MB */
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+	DefineCustomIntVariable("arrow_fdw.prefetch_batches",
+							"number of RecordBatches to be read ahead",
+							NULL,
+							&arrow_prefetch_batches,
+							2,
+							0,
+							64,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	DefineCustomStringVariable("arrow_fdw.metadata_cache_dir",
+							   "directory to save the metadata cache on the disk",
+							   "an empty string disables the on-disk metadata cache",
+							   &arrow_metadata_cache_dir,
+							   "pg_strom_arrow_metadata",
+							   PGC_SIGHUP,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+	DefineCustomBoolVariable("arrow_fdw.mmap_enabled",
+							 "Enables zero-copy CPU scan by mmap(2) of RecordBatches",
+							 NULL,
+							 &arrow_fdw_mmap_enabled,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	DefineCustomBoolVariable("arrow_fdw.vectorized_filter",
+							 "Enables vectorized filter on CPU scan of arrow_fdw",
+							 NULL,
+							 &arrow_fdw_vec_filter_enabled,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	DefineCustomBoolVariable("arrow_fdw.write_behind",
+							 "Enables write-behind of record-batches on INSERT",
+							 NULL,
+							 &arrow_fdw_write_behind,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+#if PG_VERSION_NUM >= 140000
+	/*
+	 * Number of rows per batch insert
+	 */
+	DefineCustomIntVariable("arrow_fdw.insert_batch_size",
+							"number of rows to be inserted at once",
+							"1 disables batch insert",
+							&arrow_insert_batch_size,
+							1000,
+							1,
+							INT_MAX,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+#endif
+	/*
+	 * Snapshot reads over append-only arrow files
+	 */
+	DefineCustomIntVariable("arrow_fdw.snapshot_batches",
+							"number of RecordBatches per file to be visible",
+							"-1 means the latest footer",
+							&arrow_snapshot_batches,
+							-1,
+							-1,
+							INT_MAX,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
 
 	/* shared memory size */
 	RequestAddinShmemSpace(MAXALIGN(sizeof(arrowMetadataState)));
@@ -69,6 +69,7 @@ typedef struct SQLfield			SQLfield;
 typedef struct SQLdictionary	SQLdictionary;
 typedef struct SQLstat			SQLstat;
 typedef union  SQLstat__datum	SQLstat__datum;
+typedef struct SQLbloom		SQLbloom;
 typedef union  SQLtype			SQLtype;
 typedef struct SQLtype__pgsql	SQLtype__pgsql;
 typedef struct SQLtype__mysql	SQLtype__mysql;
@@ -103,6 +104,8 @@ union SQLtype
 	SQLtype__mysql	mysql;
 };
 
+#define SQLSTAT_STRING_PREFIX_LEN		15
+
 union SQLstat__datum
 {
 	int8_t			i8;
@@ -116,6 +119,11 @@ union SQLstat__datum
 	int128_t		i128;
 	float			f32;
 	double			f64;
+	struct {
+		uint8_t		len;		/* length of the prefix, or
+								 * SQLSTAT_STRING_PREFIX_LEN+1 if truncated */
+		uint8_t		data[SQLSTAT_STRING_PREFIX_LEN];
+	} str;						/* byte-wise prefix of Utf8/Binary */
 };
 
 struct SQLstat
@@ -152,6 +160,10 @@ struct SQLfield
 	bool		stat_enabled;
 	SQLstat		stat_datum;
 	SQLstat	   *stat_list;
+	/* bloom filter per record-batch */
+	bool		bloom_enabled;
+	SQLbuffer	bloom_hashes;	/* hash values of the current record-batch */
+	SQLbloom   *bloom_list;
 	/* custom metadata(optional) */
 	ArrowKeyValue *customMetadata;
 	int			numCustomMetadata;
@@ -167,6 +179,81 @@ sql_field_put_value(SQLfield *column, const char *addr, int sz)
 #define FLEXIBLE_ARRAY_MEMBER
 #endif
 
+/*
+ * Bloom filter per record-batch
+ *
+ * The bitmap is built from the hash values of the Arrow native binary
+ * (little-endian integers, or bytes of Utf8/Binary), so the readers can
+ * check the values of query without reading the record-batch.
+ */
+#define SQLBLOOM_NHASH				7		/* number of hash functions */
+#define SQLBLOOM_BITS_PER_ITEM		10		/* about 1% false positive */
+#define SQLBLOOM_MIN_NBITS			64
+#define SQLBLOOM_MAX_NBITS			(1U << 20)
+
+struct SQLbloom
+{
+	SQLbloom	   *next;
+	int				rb_index;	/* record-batch index */
+	int				nhash;		/* number of hash functions */
+	uint32_t		nbits;		/* width of the bitmap (power of 2) */
+	uint64_t		bitmap[FLEXIBLE_ARRAY_MEMBER];
+};
+
+static inline uint64_t
+sql_bloom_hash(const void *addr, size_t sz)
+{
+	const unsigned char *pos = (const unsigned char *)addr;
+	uint64_t	hash = 0xcbf29ce484222325UL;	/* FNV-1a */
+	size_t		i;
+
+	for (i=0; i < sz; i++)
+	{
+		hash ^= pos[i];
+		hash *= 0x100000001b3UL;
+	}
+	/* final mix of murmur3 */
+	hash ^= (hash >> 33);
+	hash *= 0xff51afd7ed558ccdUL;
+	hash ^= (hash >> 33);
+	hash *= 0xc4ceb9fe1a85ec53UL;
+	hash ^= (hash >> 33);
+
+	return hash;
+}
+
+static inline void
+sql_bloom_add(uint64_t *bitmap, uint32_t nbits, int nhash, uint64_t hash)
+{
+	uint32_t	h1 = (uint32_t)(hash & 0xffffffffU);
+	uint32_t	h2 = (uint32_t)(hash >> 32) | 1U;
+	int			i;
+
+	for (i=0; i < nhash; i++)
+	{
+		uint32_t	k = (h1 + i * h2) & (nbits - 1);
+
+		bitmap[k >> 6] |= (1UL << (k & 63));
+	}
+}
+
+static inline bool
+sql_bloom_check(const uint64_t *bitmap, uint32_t nbits, int nhash, uint64_t hash)
+{
+	uint32_t	h1 = (uint32_t)(hash & 0xffffffffU);
+	uint32_t	h2 = (uint32_t)(hash >> 32) | 1U;
+	int			i;
+
+	for (i=0; i < nhash; i++)
+	{
+		uint32_t	k = (h1 + i * h2) & (nbits - 1);
+
+		if ((bitmap[k >> 6] & (1UL << (k & 63))) == 0)
+			return false;
+	}
+	return true;
+}
+
 struct SQLtable
 {
 	const char *filename;		/* output filename */
@@ -190,6 +277,8 @@ struct SQLtable
 	size_t		nitems;			/* number of items */
 	int			nfields;		/* number of attributes */
 	bool		has_statistics;	/* one or more columns enable min/max statistics */
+	int			num_finalize_threads; /* max threads to finalize record-batch;
+									   * only if palloc() is thread-safe */
 	SQLfield columns[FLEXIBLE_ARRAY_MEMBER];
 };
 
@@ -223,6 +312,10 @@ extern void		arrowFileWriteIOV(SQLtable *table);
 extern void		writeArrowSchema(SQLtable *table);
 extern void		writeArrowDictionaryBatches(SQLtable *table);
 extern int		writeArrowRecordBatch(SQLtable *table);
+extern int		copyArrowRecordBatchImage(SQLtable *table,
+										  void *(*alloc_image)(size_t length,
+															   void *data),
+										  void *data);
 extern void		writeArrowFooter(SQLtable *table);
 
 extern size_t	setupArrowRecordBatchIOV(SQLtable *table);
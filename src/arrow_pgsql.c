@@ -120,6 +120,39 @@ write_int128_stat(SQLfield *attr, char *buf, size_t len,
 	return snprintf(buf, len, "%s%s", (is_minus ? "-" : ""), pos);
 }
 
+/*
+ * Utf8/Binary min/max statistics are written as a hex-encoded byte-wise
+ * prefix, like '\x414243'. The trailing '...' means the original value
+ * is longer than the prefix.
+ */
+static int
+write_binary_stat(SQLfield *attr, char *buf, size_t len,
+				  const SQLstat__datum *datum)
+{
+	static const char hex[] = "0123456789abcdef";
+	char		temp[2 * SQLSTAT_STRING_PREFIX_LEN + 10];
+	char	   *pos = temp;
+	int			i, n = datum->str.len;
+
+	if (n > SQLSTAT_STRING_PREFIX_LEN)
+		n = SQLSTAT_STRING_PREFIX_LEN;
+	*pos++ = '\\';
+	*pos++ = 'x';
+	for (i=0; i < n; i++)
+	{
+		*pos++ = hex[(datum->str.data[i] >> 4) & 0x0f];
+		*pos++ = hex[datum->str.data[i] & 0x0f];
+	}
+	if (datum->str.len > SQLSTAT_STRING_PREFIX_LEN)
+	{
+		memcpy(pos, "...", 3);
+		pos += 3;
+	}
+	*pos = '\0';
+
+	return snprintf(buf, len, "%s", temp);
+}
+
 /* ----------------------------------------------------------------
  *
  * Put value handler for each data types
@@ -184,6 +217,17 @@ static inline uint64_t __fetch_64bit(const void *addr)
 		}													\
 	} while(0)
 
+#define BLOOM_UPDATES(COLUMN,ADDR,SZ)						\
+	do {													\
+		if ((COLUMN)->bloom_enabled)						\
+		{													\
+			uint64_t	__hash = sql_bloom_hash((ADDR),(SZ));	\
+															\
+			sql_buffer_append(&(COLUMN)->bloom_hashes,		\
+							  &__hash, sizeof(uint64_t));	\
+		}													\
+	} while(0)
+
 static size_t
 put_bool_value(SQLfield *column, const char *addr, int sz)
 {
@@ -239,6 +283,7 @@ put_int8_value(SQLfield *column, const char *addr, int sz)
 		sql_buffer_append(&column->values, &value, sizeof(int8_t));
 
 		STAT_UPDATES(column,i8,value);
+		BLOOM_UPDATES(column,&value,sizeof(value));
 	}
 	return __buffer_usage_inline_type(column);
 }
@@ -261,6 +306,7 @@ put_uint8_value(SQLfield *column, const char *addr, int sz)
 		sql_buffer_append(&column->values, &value, sizeof(uint8_t));
 
 		STAT_UPDATES(column,u8,value);
+		BLOOM_UPDATES(column,&value,sizeof(value));
 	}
 	return __buffer_usage_inline_type(column);
 }
@@ -281,6 +327,7 @@ put_int16_value(SQLfield *column, const char *addr, int sz)
 		sql_buffer_append(&column->values, &value, sz);
 
 		STAT_UPDATES(column,i16,value);
+		BLOOM_UPDATES(column,&value,sizeof(value));
 	}
 	return __buffer_usage_inline_type(column);
 }
@@ -303,6 +350,7 @@ put_uint16_value(SQLfield *column, const char *addr, int sz)
 		sql_buffer_append(&column->values, &value, sz);
 
 		STAT_UPDATES(column,u16,value);
+		BLOOM_UPDATES(column,&value,sizeof(value));
 	}
 	return __buffer_usage_inline_type(column);
 }
@@ -323,6 +371,7 @@ put_int32_value(SQLfield *column, const char *addr, int sz)
 		sql_buffer_append(&column->values, &value, sz);
 
 		STAT_UPDATES(column,i32,value);
+		BLOOM_UPDATES(column,&value,sizeof(value));
 	}
 	return __buffer_usage_inline_type(column);
 }
@@ -345,6 +394,7 @@ put_uint32_value(SQLfield *column, const char *addr, int sz)
 		sql_buffer_append(&column->values, &value, sz);
 
 		STAT_UPDATES(column,u32,value);
+		BLOOM_UPDATES(column,&value,sizeof(value));
 	}
 	return __buffer_usage_inline_type(column);
 }
@@ -365,6 +415,7 @@ put_int64_value(SQLfield *column, const char *addr, int sz)
 		sql_buffer_append(&column->values, &value, sz);
 		
 		STAT_UPDATES(column,i64,value);
+		BLOOM_UPDATES(column,&value,sizeof(value));
 	}
 	return __buffer_usage_inline_type(column);
 }
@@ -387,6 +438,7 @@ put_uint64_value(SQLfield *column, const char *addr, int sz)
 		sql_buffer_append(&column->values, &value, sz);
 		
 		STAT_UPDATES(column,u64,value);
+		BLOOM_UPDATES(column,&value,sizeof(value));
 	}
 	return __buffer_usage_inline_type(column);
 }
@@ -1016,6 +1068,52 @@ put_interval_value(SQLfield *sql_field, const char *addr, int sz)
 /*
  * Utf8, Binary
  */
+static inline int
+__compare_stat_string(const SQLstat__datum *a, const SQLstat__datum *b)
+{
+	int		alen = Min(a->str.len, SQLSTAT_STRING_PREFIX_LEN);
+	int		blen = Min(b->str.len, SQLSTAT_STRING_PREFIX_LEN);
+	int		rv;
+
+	rv = memcmp(a->str.data, b->str.data, Min(alen, blen));
+	if (rv != 0)
+		return rv;
+	/* truncated prefix is larger than the identical shorter one */
+	return (int)a->str.len - (int)b->str.len;
+}
+
+static void
+__stat_update_string(SQLfield *column, const char *addr, int sz)
+{
+	SQLstat__datum	temp;
+
+	memset(&temp, 0, sizeof(SQLstat__datum));
+	if (sz > SQLSTAT_STRING_PREFIX_LEN)
+	{
+		temp.str.len = SQLSTAT_STRING_PREFIX_LEN + 1;
+		memcpy(temp.str.data, addr, SQLSTAT_STRING_PREFIX_LEN);
+	}
+	else
+	{
+		temp.str.len = sz;
+		memcpy(temp.str.data, addr, sz);
+	}
+
+	if (!column->stat_datum.is_valid)
+	{
+		memcpy(&column->stat_datum.min, &temp, sizeof(SQLstat__datum));
+		memcpy(&column->stat_datum.max, &temp, sizeof(SQLstat__datum));
+		column->stat_datum.is_valid = true;
+	}
+	else
+	{
+		if (__compare_stat_string(&column->stat_datum.min, &temp) > 0)
+			memcpy(&column->stat_datum.min, &temp, sizeof(SQLstat__datum));
+		if (__compare_stat_string(&column->stat_datum.max, &temp) < 0)
+			memcpy(&column->stat_datum.max, &temp, sizeof(SQLstat__datum));
+	}
+}
+
 static size_t
 put_variable_value(SQLfield *column,
 				   const char *addr, int sz)
@@ -1037,6 +1135,9 @@ put_variable_value(SQLfield *column,
 		sql_buffer_append(&column->extra, addr, sz);
 		sql_buffer_append(&column->values,
 						  &column->extra.usage, sizeof(uint32_t));
+		if (column->stat_enabled)
+			__stat_update_string(column, addr, sz);
+		BLOOM_UPDATES(column,addr,sz);
 	}
 	return __buffer_usage_varlena_type(column);
 }
@@ -1480,6 +1581,7 @@ assignArrowTypeBinary(SQLfield *column, ArrowField *arrow_field)
 		Elog("attribute '%s' is not compatible", column->field_name);
 	initArrowNode(&column->arrow_type, Binary);
 	column->put_value = put_variable_value;
+	column->write_stat = write_binary_stat;
 	return 3;		/* nullmap + index + extra */
 }
 
@@ -1491,6 +1593,7 @@ assignArrowTypeUtf8(SQLfield *column, ArrowField *arrow_field)
 		Elog("attribute '%s' is not compatible", column->field_name);
 	initArrowNode(&column->arrow_type, Utf8);
 	column->put_value = put_variable_value;
+	column->write_stat = write_binary_stat;
 	return 3;		/* nullmap + index + extra */
 }
 
@@ -13,6 +13,9 @@
 #include "postgres.h"
 #endif
 #include <limits.h>
+#ifndef __PGSTROM_MODULE__
+#include <pthread.h>
+#endif
 #include "arrow_ipc.h"
 
 /* alignment macros, if not */
@@ -1137,6 +1140,66 @@ __setupArrowFieldStat(ArrowKeyValue *customMetadata,
 	}
 }
 
+static void
+__setupArrowFieldBloom(ArrowKeyValue *kv,
+					   SQLfield *column, int numRecordBatches)
+{
+	static const char hex[] = "0123456789abcdef";
+	SQLbloom  **bloom_values = alloca(sizeof(SQLbloom *) * numRecordBatches);
+	SQLbloom   *curr;
+	size_t		len = 0;
+	size_t		off = 0;
+	char	   *buf;
+	int			i, k;
+
+	memset(bloom_values, 0, sizeof(SQLbloom *) * numRecordBatches);
+	for (curr = column->bloom_list; curr; curr = curr->next)
+	{
+		int		rb_index = curr->rb_index;
+
+		if (rb_index < 0 || rb_index >= numRecordBatches)
+			Elog("bloom filter at [%s] is out of range (%d of %d)",
+				 column->field_name, rb_index, numRecordBatches);
+		if (bloom_values[rb_index])
+			Elog("duplicate bloom filter at [%s] rb_index=%d",
+				 column->field_name, rb_index);
+		bloom_values[rb_index] = curr;
+		len += curr->nbits / 4;
+	}
+	len += 20 * numRecordBatches + 1;
+	buf = palloc(len);
+
+	/* build a comma separated array of NHASH:HEX-BITMAP */
+	for (i=0; i < numRecordBatches; i++)
+	{
+		const unsigned char *bitmap;
+
+		if (i > 0)
+			buf[off++] = ',';
+		curr = bloom_values[i];
+		if (!curr)
+		{
+			off += snprintf(buf+off, len-off, "null");
+			continue;
+		}
+		off += snprintf(buf+off, len-off, "%d:", curr->nhash);
+		bitmap = (const unsigned char *)curr->bitmap;
+		for (k=0; k < curr->nbits / 8; k++)
+		{
+			buf[off++] = hex[(bitmap[k] >> 4) & 0x0f];
+			buf[off++] = hex[bitmap[k] & 0x0f];
+		}
+	}
+	assert(off < len);
+	buf[off] = '\0';
+
+	initArrowNode(kv, KeyValue);
+	kv->key = pstrdup("bloom_filters");
+	kv->_key_len = strlen(kv->key);
+	kv->value = buf;
+	kv->_value_len = off;
+}
+
 static void
 setupArrowField(ArrowField *field, SQLtable *table, SQLfield *column)
 {
@@ -1185,6 +1248,20 @@ setupArrowField(ArrowField *field, SQLtable *table, SQLfield *column)
 							  column, table->numRecordBatches);
 		numCustomMetadata += 2;
 	}
+	/* bloom filters */
+	if (column->bloom_enabled)
+	{
+		size_t		sz = sizeof(ArrowKeyValue) * (numCustomMetadata + 1);
+
+		if (!customMetadata)
+			customMetadata = palloc0(sz);
+		else
+			customMetadata = repalloc(customMetadata, sz);
+
+		__setupArrowFieldBloom(customMetadata + numCustomMetadata,
+							   column, table->numRecordBatches);
+		numCustomMetadata++;
+	}
 	/* custom metadata, if any */
 	field->_num_custom_metadata = numCustomMetadata;
 	field->custom_metadata = customMetadata;
@@ -1610,13 +1687,143 @@ __saveArrowRecordBatchStats(int rb_index, SQLfield *field)
 	}
 }
 
+static void
+__saveArrowRecordBatchBloom(int rb_index, SQLfield *field)
+{
+	const uint64_t *hashes = (const uint64_t *)field->bloom_hashes.data;
+	size_t		nitems = field->bloom_hashes.usage / sizeof(uint64_t);
+	uint32_t	nbits = SQLBLOOM_MIN_NBITS;
+	SQLbloom   *item;
+	size_t		i;
+
+	if (nitems == 0)
+		return;		/* no bloom filter for all-null record-batch */
+	while (nbits < nitems * SQLBLOOM_BITS_PER_ITEM &&
+		   nbits < SQLBLOOM_MAX_NBITS)
+		nbits <<= 1;
+	item = palloc0(offsetof(SQLbloom, bitmap[nbits / 64]));
+	item->rb_index = rb_index;
+	item->nhash = SQLBLOOM_NHASH;
+	item->nbits = nbits;
+	for (i=0; i < nitems; i++)
+		sql_bloom_add(item->bitmap, item->nbits, item->nhash, hashes[i]);
+	item->next = field->bloom_list;
+	field->bloom_list = item;
+
+	/* reset hash values */
+	field->bloom_hashes.usage = 0;
+}
+
+#ifndef __PGSTROM_MODULE__
+/*
+ * __saveArrowRecordBatchBloomParallel
+ *
+ * Construction of the bloom filters is the most expensive part of the
+ * finalization of record-batch, and it is independent for each column.
+ * So, we build them using multiple threads, if caller allows.
+ * Note that palloc() must be thread-safe (malloc) in this case.
+ */
+typedef struct
+{
+	SQLtable   *table;
+	int			rb_index;
+	int			next_field;		/* atomic */
+} bloomParallelState;
+
+static void *
+__saveArrowRecordBatchBloomWorker(void *__priv)
+{
+	bloomParallelState *bps = __priv;
+	SQLtable   *table = bps->table;
+	int			j;
+
+	while ((j = __atomic_fetch_add(&bps->next_field, 1,
+								   __ATOMIC_SEQ_CST)) < table->nfields)
+	{
+		SQLfield   *field = &table->columns[j];
+
+		if (field->bloom_enabled)
+			__saveArrowRecordBatchBloom(bps->rb_index, field);
+	}
+	return NULL;
+}
+
+static void
+__saveArrowRecordBatchBloomParallel(SQLtable *table, int rb_index,
+									int nthreads)
+{
+	bloomParallelState bps;
+	pthread_t  *threads = alloca(sizeof(pthread_t) * nthreads);
+	int			i, nlaunched = 0;
+
+	bps.table = table;
+	bps.rb_index = rb_index;
+	bps.next_field = 0;
+	/* the caller thread also works, so launch nthreads-1 workers */
+	for (i=1; i < nthreads; i++)
+	{
+		if (pthread_create(&threads[nlaunched], NULL,
+						   __saveArrowRecordBatchBloomWorker, &bps) != 0)
+			break;	/* remaining columns are processed by others */
+		nlaunched++;
+	}
+	__saveArrowRecordBatchBloomWorker(&bps);
+	for (i=0; i < nlaunched; i++)
+	{
+		if ((errno = pthread_join(threads[i], NULL)) != 0)
+			Elog("failed on pthread_join: %m");
+	}
+}
+#endif	/* !__PGSTROM_MODULE__ */
+
+static int
+__commitArrowRecordBatch(SQLtable *table, ArrowBlock *block)
+{
+	int			j, rb_index;
+	int			nblooms = 0;
+
+	rb_index = sql_table_append_record_batch(table, block);
+	if (table->has_statistics)
+	{
+		for (j=0; j < table->nfields; j++)
+		{
+			SQLfield   *field = &table->columns[j];
+
+			if (field->stat_enabled)
+				__saveArrowRecordBatchStats(rb_index, field);
+		}
+	}
+	for (j=0; j < table->nfields; j++)
+	{
+		if (table->columns[j].bloom_enabled)
+			nblooms++;
+	}
+#ifndef __PGSTROM_MODULE__
+	if (table->num_finalize_threads > 1 && nblooms > 1)
+	{
+		int		nthreads = table->num_finalize_threads;
+
+		__saveArrowRecordBatchBloomParallel(table, rb_index,
+											nthreads < nblooms ? nthreads : nblooms);
+		return rb_index;
+	}
+#endif
+	for (j=0; j < table->nfields; j++)
+	{
+		SQLfield   *field = &table->columns[j];
+
+		if (field->bloom_enabled)
+			__saveArrowRecordBatchBloom(rb_index, field);
+	}
+	return rb_index;
+}
+
 int
 writeArrowRecordBatch(SQLtable *table)
 {
 	ArrowBlock	block;
 	size_t		length;
 	size_t		meta_sz;
-	int			j, rb_index;
 
 	table->__iov_cnt = 0;				/* reset iov */
 	length = setupArrowRecordBatchIOV(table);
@@ -1630,18 +1837,49 @@ writeArrowRecordBatch(SQLtable *table)
 	block.bodyLength = length - meta_sz;
 
 	arrowFileWriteIOV(table);
-	rb_index = sql_table_append_record_batch(table, &block);
-	if (table->has_statistics)
-	{
-		for (j=0; j < table->nfields; j++)
-		{
-			SQLfield   *field = &table->columns[j];
+	return __commitArrowRecordBatch(table, &block);
+}
 
-			if (field->stat_enabled)
-				__saveArrowRecordBatchStats(rb_index, field);
-		}
+/*
+ * copyArrowRecordBatchImage
+ *
+ * It copies the file image of the record-batch onto the buffer allocated
+ * by the callback, instead of writing out. table->f_pos is advanced as if
+ * it were written, so caller is responsible to write out the image at the
+ * f_pos prior to the call.
+ */
+int
+copyArrowRecordBatchImage(SQLtable *table,
+						  void *(*alloc_image)(size_t length, void *data),
+						  void *data)
+{
+	ArrowBlock	block;
+	size_t		length;
+	size_t		meta_sz;
+	char	   *pos;
+	int			i;
+
+	table->__iov_cnt = 0;				/* reset iov */
+	length = setupArrowRecordBatchIOV(table);
+	assert(table->__iov_cnt > 0 &&
+		   table->__iov[0].iov_len <= length);
+	meta_sz = table->__iov[0].iov_len;	/* metadata chunk */
+
+	initArrowNode(&block, Block);
+	block.offset = table->f_pos;
+	block.metaDataLength = meta_sz;
+	block.bodyLength = length - meta_sz;
+
+	pos = alloc_image(length, data);
+	for (i=0; i < table->__iov_cnt; i++)
+	{
+		memcpy(pos, table->__iov[i].iov_base, table->__iov[i].iov_len);
+		pos += table->__iov[i].iov_len;
 	}
-	return rb_index;
+	table->__iov_cnt = 0;
+	table->f_pos += length;
+
+	return __commitArrowRecordBatch(table, &block);
 }
 
 /*
@@ -10,10 +10,13 @@
  * it under the terms of the PostgreSQL License.
  */
 #include "pg_strom.h"
+#include "cuda_jsonlib.h"
 #include "cuda_numeric.h"
 #include "cuda_postgis.h"
 
 static MemoryContext	devinfo_memcxt;
+static bool		pgstrom_jsonb_shredding;		/* GUC */
+static bool		pgstrom_enable_codegen_cse;		/* GUC */
 static dlist_head	devtype_info_slot[128];
 static dlist_head	devfunc_info_slot[1024];
 static dlist_head	devcast_info_slot[48];
@@ -50,6 +53,7 @@ static int	devcast_text2numeric_callback(codegen_context *context,
 /* known extension name */
 #define PGSTROM		"pg_strom"
 #define POSTGIS3	"postgis"
+#define TIMESCALEDB	"timescaledb"
 
 /*
  * Catalog of data types supported by device code
@@ -1135,10 +1139,37 @@ vlbuf_estimate_jsonb(codegen_context *context,
 	 * however, plain varlena must be less than the threshold of toasting.
 	 * If user altered storage option of jsonb column to 'main', it may be
 	 * increased to BLCKSZ, but unusual.
+	 * In addition, inline-compressed jsonb is expanded on the varlena buffer,
+	 * so we reserve the same amount once for the decompression. If the
+	 * buffer is exhausted on run-time, it falls back to CPU.
 	 */
+	if (!context->vlbuf_decompress)
+	{
+		context->extra_bufsz += MAXALIGN(TOAST_TUPLE_THRESHOLD);
+		context->vlbuf_decompress = true;
+	}
 	return TOAST_TUPLE_THRESHOLD;
 }
 
+static int
+vlbuf_estimate_digest(codegen_context *context,
+					  devfunc_info *dfunc,
+					  Expr **args, int *vl_width)
+{
+	int		len;
+
+	/* md5 returns hex-text, and sha2 returns raw bytea */
+	if (strcmp(dfunc->func_sqlname, "md5") == 0)
+		len = VARHDRSZ + 2 * 16;
+	else if (strcmp(dfunc->func_sqlname, "sha224") == 0)
+		len = VARHDRSZ + 28;
+	else
+		len = VARHDRSZ + 32;
+	context->extra_bufsz += MAXALIGN(len);
+
+	return len;
+}
+
 static int
 vlbuf_estimate__st_makepoint(codegen_context *context,
 							 devfunc_info *dfunc,
@@ -1187,6 +1218,12 @@ vlbuf_estimate__st_expand(codegen_context *context,
  *       collation configuration (none, and C-locale).
  * 'C' : this function uses its special callback to estimate the result
  *       width of varlena-buffer.
+ * 'K' : this function compares strings under the collation table, if
+ *       non-C collation is supplied.
+ * 'X' : 2nd argument is a constant regexp pattern compiled to DFA.
+ * 'i' : regexp pattern is case insensitive (with 'X')
+ * 'Z' : 1st argument is a constant time zone name translated to the
+ *       kern_tz_table.
  * 'p' : this function needs cuda_primitive.h
  * 's' : this function needs cuda_textlib.h
  * 't' : this function needs cuda_timelib.h
@@ -1747,6 +1784,27 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	{ NULL, "float8 sin(float8)",     5, "m/f:sin" },
 	{ NULL, "float8 tan(float8)",     5, "m/f:tan" },
 
+	/*
+	 * Hash and cryptographic functions
+	 */
+	{ NULL, "text md5(text)",
+	  100, "Cm/f:md5_text",
+	  vlbuf_estimate_digest },
+	{ NULL, "text md5(bytea)",
+	  100, "Cm/f:md5_bytea",
+	  vlbuf_estimate_digest },
+	{ NULL, "bytea sha224(bytea)",
+	  150, "Cm/f:sha224",
+	  vlbuf_estimate_digest },
+	{ NULL, "bytea sha256(bytea)",
+	  150, "Cm/f:sha256",
+	  vlbuf_estimate_digest },
+	{ NULL, "int4 hashtext(text)",       5, "Lm/f:hashtext" },
+	{ PGSTROM, "int8 crc32(text)",      20, "m/f:crc32_text" },
+	{ PGSTROM, "int8 crc32(bytea)",     20, "m/f:crc32_bytea" },
+	{ PGSTROM, "int8 crc32c(text)",     20, "m/f:crc32c_text" },
+	{ PGSTROM, "int8 crc32c(bytea)",    20, "m/f:crc32c_bytea" },
+
 	/*
 	 * Numeric functions
 	 * ------------------------- */
@@ -2005,6 +2063,34 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	{ NULL, "numeric extract(text,interval)",
 	  100, "t/f:extract_interval"},
 
+	/* AT TIME ZONE */
+	{ NULL, "timestamp timezone(text,timestamptz)",
+	  20, "tZ/f:timestamptz_zone" },
+	{ NULL, "timestamptz timezone(text,timestamp)",
+	  20, "tZ/f:timestamp_zone" },
+	/* date_trunc(), date_bin() */
+	{ NULL, "timestamp date_trunc(text,timestamp)",
+	  50, "t/f:timestamp_trunc" },
+	{ NULL, "timestamptz date_trunc(text,timestamptz)",
+	  50, "t/f:timestamptz_trunc" },
+	{ NULL, "timestamp date_bin(interval,timestamp,timestamp)",
+	  10, "t/f:timestamp_bin" },
+	{ NULL, "timestamptz date_bin(interval,timestamptz,timestamptz)",
+	  10, "t/f:timestamptz_bin" },
+	/* time_bucket() by TimescaleDB */
+	{ TIMESCALEDB, "timestamp time_bucket(interval,timestamp)",
+	  10, "t/f:time_bucket_timestamp" },
+	{ TIMESCALEDB, "timestamp time_bucket(interval,timestamp,timestamp)",
+	  10, "t/f:time_bucket_timestamp_origin" },
+	{ TIMESCALEDB, "timestamptz time_bucket(interval,timestamptz)",
+	  10, "t/f:time_bucket_timestamptz" },
+	{ TIMESCALEDB, "timestamptz time_bucket(interval,timestamptz,timestamptz)",
+	  10, "t/f:time_bucket_timestamptz_origin" },
+	{ TIMESCALEDB, "date time_bucket(interval,date)",
+	  10, "t/f:time_bucket_date" },
+	{ TIMESCALEDB, "date time_bucket(interval,date,date)",
+	  10, "t/f:time_bucket_date_origin" },
+
 	/* other time and data functions */
 	{ NULL, "timestamptz now()", 1, "t/f:now" },
 
@@ -2038,19 +2124,19 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	 */
 	{ NULL, "bool bpchareq(bpchar,bpchar)", 200, "s/f:bpchareq" },
 	{ NULL, "bool bpcharne(bpchar,bpchar)", 200, "s/f:bpcharne" },
-	{ NULL, "bool bpcharlt(bpchar,bpchar)", 200, "sL/f:bpcharlt" },
-	{ NULL, "bool bpcharle(bpchar,bpchar)", 200, "sL/f:bpcharle" },
-	{ NULL, "bool bpchargt(bpchar,bpchar)", 200, "sL/f:bpchargt" },
-	{ NULL, "bool bpcharge(bpchar,bpchar)", 200, "sL/f:bpcharge" },
-	{ NULL, "int4 bpcharcmp(bpchar,bpchar)",200, "sL/f:type_compare"},
+	{ NULL, "bool bpcharlt(bpchar,bpchar)", 200, "sLK/f:bpcharlt" },
+	{ NULL, "bool bpcharle(bpchar,bpchar)", 200, "sLK/f:bpcharle" },
+	{ NULL, "bool bpchargt(bpchar,bpchar)", 200, "sLK/f:bpchargt" },
+	{ NULL, "bool bpcharge(bpchar,bpchar)", 200, "sLK/f:bpcharge" },
+	{ NULL, "int4 bpcharcmp(bpchar,bpchar)",200, "sLK/f:type_compare"},
 	{ NULL, "int4 length(bpchar)",            2, "sL/f:bpcharlen"},
 	{ NULL, "bool texteq(text,text)",       200, "s/f:texteq" },
 	{ NULL, "bool textne(text,text)",       200, "s/f:textne" },
-	{ NULL, "bool text_lt(text,text)",      200, "sL/f:text_lt" },
-	{ NULL, "bool text_le(text,text)",      200, "sL/f:text_le" },
-	{ NULL, "bool text_gt(text,text)",      200, "sL/f:text_gt" },
-	{ NULL, "bool text_ge(text,text)",      200, "sL/f:text_ge" },
-	{ NULL, "int4 bttextcmp(text,text)",    200, "sL/f:type_compare" },
+	{ NULL, "bool text_lt(text,text)",      200, "sLK/f:text_lt" },
+	{ NULL, "bool text_le(text,text)",      200, "sLK/f:text_le" },
+	{ NULL, "bool text_gt(text,text)",      200, "sLK/f:text_gt" },
+	{ NULL, "bool text_ge(text,text)",      200, "sLK/f:text_ge" },
+	{ NULL, "int4 bttextcmp(text,text)",    200, "sLK/f:type_compare" },
 	/* LIKE operators */
 	{ NULL, "bool like(text,text)",           9999, "s/f:textlike" },
 	{ NULL, "bool textlike(text,text)",       9999, "s/f:textlike" },
@@ -2063,6 +2149,11 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	{ NULL, "bool bpchariclike(text,text)",   9999, "Ls/f:bpchariclike" },
 	{ NULL, "bool texticnlike(text,text)",    9999, "Ls/f:texticnlike" },
 	{ NULL, "bool bpcharicnlike(bpchar,text)",9999, "Ls/f:bpcharicnlike" },
+	/* regular expression match operators */
+	{ NULL, "bool textregexeq(text,text)",    999, "Xs/f:textregexeq" },
+	{ NULL, "bool textregexne(text,text)",    999, "Xs/f:textregexne" },
+	{ NULL, "bool texticregexeq(text,text)",  999, "LXis/f:texticregexeq" },
+	{ NULL, "bool texticregexne(text,text)",  999, "LXis/f:texticregexne" },
 	/* string operations */
 	{ NULL, "int4 length(text)", 2, "s/f:textlen" },
 	{ NULL, "text textcat(text,text)",
@@ -2117,6 +2208,18 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	{ NULL, "bool jsonb_exists(jsonb,text)",
 	  100, "j/f:jsonb_exists"
 	},
+	{ NULL, "bool jsonb_exists_any(jsonb,array)",
+	  500, "j/f:jsonb_exists_any"
+	},
+	{ NULL, "bool jsonb_exists_all(jsonb,array)",
+	  500, "j/f:jsonb_exists_all"
+	},
+	{ NULL, "bool jsonb_contains(jsonb,jsonb)",
+	  1000, "j/f:jsonb_contains"
+	},
+	{ NULL, "bool jsonb_contained(jsonb,jsonb)",
+	  1000, "j/f:jsonb_contained"
+	},
 	/*
 	 * int4range operators
 	 */
@@ -2373,6 +2476,16 @@ static devfunc_catalog_t devfunc_common_catalog[] = {
 	  999, "g/f:st_contains" },
 	{ POSTGIS3, "bool st_crosses(geometry,geometry)",
 	  999, "g/f:st_crosses" },
+	{ POSTGIS3, "bool st_intersects(geometry,geometry)",
+	  999, "g/f:st_intersects" },
+	{ POSTGIS3, "bool st_within(geometry,geometry)",
+	  999, "g/f:st_within" },
+	{ POSTGIS3, "float8 st_area(geometry)",
+	  50, "g/f:st_area" },
+	{ POSTGIS3, "float8 st_length(geometry)",
+	  50, "g/f:st_length" },
+	{ POSTGIS3, "float8 st_distancesphere(geometry,geometry)",
+	  50, "g/f:st_distancesphere" },
 	{ POSTGIS3, "bool geometry_overlaps(geometry,geometry)",
 	  10, "g/f:geometry_overlaps" },
 	{ POSTGIS3, "bool overlaps_2d(box2df,geometry)",
@@ -2442,6 +2555,10 @@ __construct_devfunc_info(const char *func_extension,
 	int				j;
 	bool			has_collation = false;
 	bool			has_callbacks = false;
+	bool			has_collation_table = false;
+	bool			has_regexp_dfa = false;
+	bool			has_regexp_icase = false;
+	bool			has_timezone_table = false;
 
 	/* fetch attribute */
 	end = strchr(func_template, '/');
@@ -2457,6 +2574,18 @@ __construct_devfunc_info(const char *func_extension,
 				case 'C':
 					has_callbacks = true;
 					break;
+				case 'K':
+					has_collation_table = true;
+					break;
+				case 'X':
+					has_regexp_dfa = true;
+					break;
+				case 'Z':
+					has_timezone_table = true;
+					break;
+				case 'i':
+					has_regexp_icase = true;
+					break;
 				case 'p':
 					flags |= DEVKERNEL_NEEDS_PRIMITIVE;
 					break;
@@ -2504,11 +2633,24 @@ __construct_devfunc_info(const char *func_extension,
 	if (has_collation)
 	{
 		if (OidIsValid(dfunc_collid) && !lc_collate_is_c(dfunc_collid))
-			dfunc->func_is_negative = true;
+		{
+			if (has_collation_table && pgstrom_collation_table(dfunc_collid))
+				dfunc->func_collation_table = true;
+			else
+				dfunc->func_is_negative = true;
+		}
+		dfunc->func_collid = dfunc_collid;
+	}
+	else if (has_regexp_dfa)
+	{
+		/* character classes of the regexp depend on LC_CTYPE */
 		dfunc->func_collid = dfunc_collid;
 	}
 	dfunc->func_is_strict = proc->proisstrict;
 	dfunc->func_flags = flags;
+	dfunc->func_regexp_dfa = has_regexp_dfa;
+	dfunc->func_regexp_icase = has_regexp_icase;
+	dfunc->func_timezone_table = has_timezone_table;
 	dfunc->func_args = dfunc_args;
 	dfunc->func_rettype = dfunc_rettype;
 	dfunc->func_sqlname = pstrdup(NameStr(proc->proname));
@@ -3270,6 +3412,9 @@ pgstrom_devtype_can_relabel(Oid src_type_oid,
  *                           PageHeaderData *i_page,
  *                           <left device type> arg1,
  *                           <right device type> arg2);
+ *
+ * If index_keytype is given, the index key is fetched as pg_<keytype>_t,
+ * instead of the device type of ivar_typname.
  */
 static struct {
 	const char	   *extname;
@@ -3279,7 +3424,34 @@ static struct {
 	const char	   *index_fname;
 	const char	   *ivar_typname;
 	const char	   *iarg_typname;
+	const char	   *index_keytype;
 } devindex_catalog[] = {
+	/* inet network containment operators (inet_ops) */
+	{ NULL, "inet << inet",
+	  "gist", RTSubStrategyNumber,
+	  "gist_inet_sub",
+	  "inet", "inet", "inet_gistkey",
+	},
+	{ NULL, "inet <<= inet",
+	  "gist", RTSubEqualStrategyNumber,
+	  "gist_inet_subeq",
+	  "inet", "inet", "inet_gistkey",
+	},
+	{ NULL, "inet >> inet",
+	  "gist", RTSuperStrategyNumber,
+	  "gist_inet_sup",
+	  "inet", "inet", "inet_gistkey",
+	},
+	{ NULL, "inet >>= inet",
+	  "gist", RTSuperEqualStrategyNumber,
+	  "gist_inet_supeq",
+	  "inet", "inet", "inet_gistkey",
+	},
+	{ NULL, "inet && inet",
+	  "gist", RTOverlapStrategyNumber,
+	  "gist_inet_overlap",
+	  "inet", "inet", "inet_gistkey",
+	},
 	/* geometry overlap operator */
 	{ POSTGIS3, "geometry && geometry",
 	  "gist", RTOverlapStrategyNumber,
@@ -3434,6 +3606,7 @@ pgstrom_devindex_lookup(Oid opcode, Oid opfamily)
 		dindex->index_fname = devindex_catalog[i].index_fname;
 		dindex->ivar_dtype = ivar_dtype;
 		dindex->iarg_dtype = iarg_dtype;
+		dindex->index_keytype = devindex_catalog[i].index_keytype;
 		break;
 	}
 
@@ -3501,6 +3674,194 @@ __appendStringInfoChar(StringInfo str, char c)
 		appendStringInfoChar(str, c);
 }
 
+/*
+ * Common sub-expression elimination
+ *
+ * If the same device sub-expression (like jsonb->>'key', date_trunc() or
+ * st_makepoint()) appears multiple times in the expressions evaluated by a
+ * device function (e.g, qualifiers or target-list of the projection), we
+ * replace them by a per-row variable, with lazy evaluation:
+ *
+ *   (CSE_N_valid ? CSE_N : (CSE_N_valid = true, CSE_N = <expression>))
+ *
+ * It evaluates the sub-expression at most once per row, and never if no
+ * code path references the variable (short-circuit of AND/OR, CASE WHEN),
+ * so it does not raise errors that are not raised without CSE.
+ * pgstrom_codegen_cse_setup() opens the scope of the device function with
+ * the expressions to be generated, then pgstrom_codegen_cse_declarations()
+ * writes out declarations of the variables referenced in the scope, and
+ * closes the scope.
+ */
+typedef struct
+{
+	List	   *exprs;		/* sub-expressions */
+	List	   *counts;		/* number of appearance for each */
+} codegen_cse_walker_context;
+
+static bool
+__contain_casetest_walker(Node *node, void *context)
+{
+	if (!node)
+		return false;
+	if (IsA(node, CaseTestExpr))
+		return true;
+	return expression_tree_walker(node, __contain_casetest_walker, context);
+}
+
+static bool
+__codegen_cse_walker(Node *node, codegen_cse_walker_context *cse)
+{
+	ListCell   *lc1, *lc2;
+
+	if (!node)
+		return false;
+	if (IsA(node, FuncExpr) || IsA(node, OpExpr))
+	{
+		forboth (lc1, cse->exprs,
+				 lc2, cse->counts)
+		{
+			if (equal(node, lfirst(lc1)))
+			{
+				lfirst_int(lc2)++;
+				break;
+			}
+		}
+		if (!lc1)
+		{
+			cse->exprs = lappend(cse->exprs, node);
+			cse->counts = lappend_int(cse->counts, 1);
+		}
+	}
+	return expression_tree_walker(node, __codegen_cse_walker, cse);
+}
+
+void
+pgstrom_codegen_cse_setup(codegen_context *context, List *exprs_list)
+{
+	codegen_cse_walker_context cse;
+	ListCell   *lc1, *lc2;
+
+	context->cse_exprs = NIL;
+	context->cse_refs = NULL;
+	if (!pgstrom_enable_codegen_cse)
+		return;
+
+	memset(&cse, 0, sizeof(codegen_cse_walker_context));
+	foreach (lc1, exprs_list)
+		__codegen_cse_walker(lfirst(lc1), &cse);
+	forboth (lc1, cse.exprs,
+			 lc2, cse.counts)
+	{
+		Node   *node = lfirst(lc1);
+
+		if (lfirst_int(lc2) < 2)
+			continue;
+		/*
+		 * Volatile functions must be evaluated for each reference, and
+		 * CaseTestExpr is different for each CASE expression.
+		 */
+		if (contain_volatile_functions(node) ||
+			__contain_casetest_walker(node, NULL))
+			continue;
+		if (!pgstrom_devtype_lookup(exprType(node)))
+			continue;
+		context->cse_exprs = lappend(context->cse_exprs, node);
+	}
+	list_free(cse.exprs);
+	list_free(cse.counts);
+}
+
+void
+pgstrom_codegen_cse_declarations(StringInfo buf, codegen_context *context)
+{
+	int		k = -1;
+
+	while ((k = bms_next_member(context->cse_refs, k)) >= 0)
+	{
+		Node   *node = list_nth(context->cse_exprs, k);
+		devtype_info *dtype = pgstrom_devtype_lookup(exprType(node));
+
+		Assert(dtype != NULL);
+		appendStringInfo(buf,
+						 "  pg_%s_t CSE_%d;\n"
+						 "  cl_bool CSE_%d_valid = false;\n",
+						 dtype->type_name, k, k);
+	}
+	/* end of the scope */
+	list_free(context->cse_exprs);
+	bms_free(context->cse_refs);
+	context->cse_exprs = NIL;
+	context->cse_refs = NULL;
+}
+
+static int
+codegen_cse_lookup(codegen_context *context, Node *node)
+{
+	ListCell   *lc;
+	int			cse_index = 0;
+
+	if (context->cse_exprs == NIL ||
+		node == context->cse_current ||
+		(!IsA(node, FuncExpr) && !IsA(node, OpExpr)))
+		return -1;
+	foreach (lc, context->cse_exprs)
+	{
+		if (equal(node, lfirst(lc)))
+			return cse_index;
+		cse_index++;
+	}
+	return -1;
+}
+
+static int
+codegen_cse_expression(codegen_context *context,
+					   StringInfo body,
+					   Node *node, int cse_index)
+{
+	Node	   *cse_current_saved = context->cse_current;
+	int			width;
+
+	context->cse_refs = bms_add_member(context->cse_refs, cse_index);
+	__appendStringInfo(body,
+					   "(CSE_%d_valid ? CSE_%d : "
+					   "(CSE_%d_valid = true, CSE_%d = ",
+					   cse_index, cse_index,
+					   cse_index, cse_index);
+	context->cse_current = node;
+	codegen_expression_walker(context, body, node, &width);
+	context->cse_current = cse_current_saved;
+	__appendStringInfo(body, "))");
+
+	return width;
+}
+
+/*
+ * codegen_cse_helper_arguments
+ *
+ * Expression by the inline helper function (__exprBoolOp_N and so on) takes
+ * the variables of common sub-expressions by reference, like Var-nodes.
+ */
+static void
+codegen_cse_helper_arguments(codegen_context *context,
+							 StringInfo body,
+							 Bitmapset *cse_refs_saved)
+{
+	int		k = -1;
+
+	while ((k = bms_next_member(context->cse_refs, k)) >= 0)
+	{
+		Node   *node = list_nth(context->cse_exprs, k);
+		devtype_info *dtype = pgstrom_devtype_lookup(exprType(node));
+
+		__appendStringInfo(&context->decl,
+						   ", pg_%s_t &CSE_%d, cl_bool &CSE_%d_valid",
+						   dtype->type_name, k, k);
+		__appendStringInfo(body,
+						   ", CSE_%d, CSE_%d_valid", k, k);
+	}
+	context->cse_refs = bms_union(cse_refs_saved, context->cse_refs);
+}
+
 static int
 codegen_const_expression(codegen_context *context,
 						 StringInfo body,
@@ -3652,19 +4013,450 @@ codegen_varnode_expression(codegen_context *context,
 	return width;
 }
 
+/*
+ * codegen_regexp_function_expression
+ *
+ * Regular expression match operators take a constant pattern only; it is
+ * compiled to DFA (kern_regexp_dfa) at the planning time, then delivered
+ * to the device code as a bytea parameter.
+ */
+static int
+codegen_regexp_function_expression(codegen_context *context,
+								   StringInfo body,
+								   devfunc_info *dfunc, List *args)
+{
+	devtype_info *dtype;
+	Node	   *expr;
+	Const	   *con;
+	bytea	   *dfa;
+	int			index;
+
+	Assert(list_length(args) == 2);
+	con = (Const *) lsecond(args);
+	if (!IsA(con, Const) || con->constisnull)
+		__ELog("regexp pattern must be a constant");
+	if (!pgstrom_devtype_lookup_and_track(BYTEAOID, context))
+		__ELog("type bytea is not device supported");
+	dfa = pgstrom_regexp_compile_dfa(DatumGetTextPP(con->constvalue),
+									 dfunc->func_regexp_icase,
+									 dfunc->func_collid);
+	context->used_params = lappend(context->used_params,
+								   makeConst(BYTEAOID,
+											 -1,
+											 InvalidOid,
+											 -1,
+											 PointerGetDatum(dfa),
+											 false,
+											 false));
+	index = list_length(context->used_params) - 1;
+
+	__appendStringInfo(body,
+					   "pgfn_%s(kcxt, ",
+					   dfunc->func_devname);
+	dtype = linitial(dfunc->func_args);
+	expr = linitial(args);
+	if (dtype->type_oid == exprType(expr))
+		codegen_expression_walker(context, body, expr, NULL);
+	else if (pgstrom_devtype_can_relabel(exprType(expr),
+										 dtype->type_oid))
+	{
+		__appendStringInfo(body, "to_%s(", dtype->type_name);
+		codegen_expression_walker(context, body, expr, NULL);
+		__appendStringInfoChar(body, ')');
+	}
+	else
+		__ELog("Bug? unsupported implicit type cast (%s)->(%s)",
+			   format_type_be(exprType(expr)),
+			   format_type_be(dtype->type_oid));
+	__appendStringInfo(body, ", pg_bytea_param(kcxt,%d))", index);
+
+	return sizeof(cl_bool);
+}
+
+/*
+ * codegen_timezone_function_expression
+ *
+ * timezone(text,...) takes a constant time zone name usually, so we build
+ * the transition table of the zone on the host side, then device code
+ * references it as a bytea parameter.
+ */
+static int
+codegen_timezone_function_expression(codegen_context *context,
+									 StringInfo body,
+									 devfunc_info *dfunc, List *args)
+{
+	devtype_info *dtype;
+	Node	   *expr;
+	Const	   *con;
+	char	   *tzname;
+	bytea	   *tztab;
+	int			index;
+
+	Assert(list_length(args) == 2);
+	con = (Const *) linitial(args);
+	if (!IsA(con, Const) || con->constisnull)
+		__ELog("time zone name must be a constant");
+	if (!pgstrom_devtype_lookup_and_track(BYTEAOID, context))
+		__ELog("type bytea is not device supported");
+	tzname = TextDatumGetCString(con->constvalue);
+	tztab = pgstrom_timezone_table(tzname);
+	if (!tztab)
+		__ELog("time zone \"%s\" is not device supported", tzname);
+	context->used_params = lappend(context->used_params,
+								   makeConst(BYTEAOID,
+											 -1,
+											 InvalidOid,
+											 -1,
+											 PointerGetDatum(tztab),
+											 false,
+											 false));
+	index = list_length(context->used_params) - 1;
+
+	__appendStringInfo(body,
+					   "pgfn_%s(kcxt, pg_bytea_param(kcxt,%d), ",
+					   dfunc->func_devname, index);
+	dtype = lsecond(dfunc->func_args);
+	expr = lsecond(args);
+	if (dtype->type_oid != exprType(expr))
+		__ELog("Bug? unsupported implicit type cast (%s)->(%s)",
+			   format_type_be(exprType(expr)),
+			   format_type_be(dtype->type_oid));
+	codegen_expression_walker(context, body, expr, NULL);
+	__appendStringInfoChar(body, ')');
+
+	return dfunc->func_rettype->type_length;
+}
+
+#if PG_VERSION_NUM >= 120000
+/*
+ * __compile_jsonpath_xxx
+ *
+ * It compiles a subset of the jsonpath (lax mode; accessors, filter with
+ * comparison between the current item and a literal) to kern_jsonpath
+ * bytecode. Any other constructs raise an error by __ELog(), then the
+ * expression shall be evaluated by CPU.
+ */
+static void __compile_jsonpath_steps(StringInfo buf, JsonPathItem *jsp,
+									 bool is_current, int depth);
+
+static inline int
+__jsonpath_emit_head(StringInfo buf, cl_uint opcode)
+{
+	int		pos = buf->len;
+	cl_uint	length = 0;
+
+	appendBinaryStringInfo(buf, (char *)&opcode, sizeof(cl_uint));
+	appendBinaryStringInfo(buf, (char *)&length, sizeof(cl_uint));
+	return pos;
+}
+
+static inline void
+__jsonpath_emit_word(StringInfo buf, cl_uint word)
+{
+	appendBinaryStringInfo(buf, (char *)&word, sizeof(cl_uint));
+}
+
+static inline void
+__jsonpath_emit_bytes(StringInfo buf, const char *data, int len)
+{
+	appendBinaryStringInfo(buf, data, len);
+	while (buf->len % sizeof(cl_uint) != 0)
+		appendStringInfoChar(buf, '\0');
+}
+
+static inline void
+__jsonpath_emit_tail(StringInfo buf, int pos)
+{
+	cl_uint	   *code = (cl_uint *)(buf->data + pos);
+
+	code[1] = (buf->len - pos) / sizeof(cl_uint);
+}
+
+static bool
+__compile_jsonpath_literal(StringInfo buf, JsonPathItem *jsp)
+{
+	int			pos;
+	char	   *str;
+	int32		len;
+	Numeric		num;
+
+	switch (jsp->type)
+	{
+		case jpiNull:
+			pos = __jsonpath_emit_head(buf, JSPC_LIT_NULL);
+			break;
+		case jpiBool:
+			pos = __jsonpath_emit_head(buf, JSPC_LIT_BOOL);
+			__jsonpath_emit_word(buf, jspGetBool(jsp) ? 1 : 0);
+			break;
+		case jpiString:
+			str = jspGetString(jsp, &len);
+			pos = __jsonpath_emit_head(buf, JSPC_LIT_STRING);
+			__jsonpath_emit_word(buf, len);
+			__jsonpath_emit_bytes(buf, str, len);
+			break;
+		case jpiNumeric:
+			num = jspGetNumeric(jsp);
+			pos = __jsonpath_emit_head(buf, JSPC_LIT_NUMERIC);
+			__jsonpath_emit_bytes(buf, (char *)num, VARSIZE(num));
+			break;
+		default:
+			return false;
+	}
+	__jsonpath_emit_tail(buf, pos);
+	return true;
+}
+
+static void
+__compile_jsonpath_predicate(StringInfo buf, JsonPathItem *jsp, int depth)
+{
+	JsonPathItem larg;
+	JsonPathItem rarg;
+	cl_uint		opcode;
+	cl_uint		cmpop;
+	int			pos;
+
+	if (depth > JSPC_MAX_DEPTH)
+		__ELog("jsonpath is too complicated");
+	switch (jsp->type)
+	{
+		case jpiAnd:
+		case jpiOr:
+			opcode = (jsp->type == jpiAnd ? JSPC_AND : JSPC_OR);
+			pos = __jsonpath_emit_head(buf, opcode);
+			jspGetLeftArg(jsp, &larg);
+			__compile_jsonpath_predicate(buf, &larg, depth + 1);
+			jspGetRightArg(jsp, &rarg);
+			__compile_jsonpath_predicate(buf, &rarg, depth + 1);
+			break;
+		case jpiNot:
+			pos = __jsonpath_emit_head(buf, JSPC_NOT);
+			jspGetArg(jsp, &larg);
+			__compile_jsonpath_predicate(buf, &larg, depth + 1);
+			break;
+		case jpiEqual:
+		case jpiNotEqual:
+		case jpiLess:
+		case jpiLessOrEqual:
+		case jpiGreater:
+		case jpiGreaterOrEqual:
+			switch (jsp->type)
+			{
+				case jpiEqual:			cmpop = JSPC_CMP_EQ; break;
+				case jpiNotEqual:		cmpop = JSPC_CMP_NE; break;
+				case jpiLess:			cmpop = JSPC_CMP_LT; break;
+				case jpiLessOrEqual:	cmpop = JSPC_CMP_LE; break;
+				case jpiGreater:		cmpop = JSPC_CMP_GT; break;
+				default:				cmpop = JSPC_CMP_GE; break;
+			}
+			jspGetLeftArg(jsp, &larg);
+			jspGetRightArg(jsp, &rarg);
+			pos = __jsonpath_emit_head(buf, JSPC_CMP);
+			__jsonpath_emit_word(buf, cmpop);
+			if (larg.type == jpiCurrent)
+			{
+				__jsonpath_emit_word(buf, 1);
+				__compile_jsonpath_steps(buf, &larg, true, depth + 1);
+				if (!__compile_jsonpath_literal(buf, &rarg))
+					__ELog("jsonpath comparison must be between @ and literal");
+			}
+			else if (rarg.type == jpiCurrent)
+			{
+				__jsonpath_emit_word(buf, 0);
+				__compile_jsonpath_steps(buf, &rarg, true, depth + 1);
+				if (!__compile_jsonpath_literal(buf, &larg))
+					__ELog("jsonpath comparison must be between @ and literal");
+			}
+			else
+				__ELog("jsonpath comparison must be between @ and literal");
+#if PG_VERSION_NUM < 130000
+			/* v12 compares strings under the default collation */
+			if (cmpop != JSPC_CMP_EQ && cmpop != JSPC_CMP_NE &&
+				(larg.type == jpiString || rarg.type == jpiString))
+				__ELog("jsonpath string ordering is not device supported");
+#endif
+			break;
+		default:
+			__ELog("jsonpath predicate (type=%d) is not device supported",
+				   (int)jsp->type);
+	}
+	__jsonpath_emit_tail(buf, pos);
+}
+
+static void
+__compile_jsonpath_steps(StringInfo buf, JsonPathItem *jsp,
+						 bool is_current, int depth)
+{
+	JsonPathItem item;
+	JsonPathItem next;
+	JsonPathItem from;
+	JsonPathItem to;
+	bool		has_next;
+	char	   *key;
+	int32		keylen;
+	Datum		index;
+	int			pos;
+
+	if (depth > JSPC_MAX_DEPTH)
+		__ELog("jsonpath is too complicated");
+	if (jsp->type != (is_current ? jpiCurrent : jpiRoot))
+		__ELog("jsonpath must begin with %s", is_current ? "@" : "$");
+
+	item = *jsp;
+	for (;;)
+	{
+		has_next = jspGetNext(&item, &next);
+		if (!has_next)
+			break;
+		switch (next.type)
+		{
+			case jpiKey:
+				key = jspGetString(&next, &keylen);
+				pos = __jsonpath_emit_head(buf, JSPC_KEY);
+				__jsonpath_emit_word(buf, keylen);
+				__jsonpath_emit_bytes(buf, key, keylen);
+				break;
+			case jpiIndexArray:
+				if (next.content.array.nelems != 1 ||
+					jspGetArraySubscript(&next, &from, &to, 0))
+					__ELog("jsonpath array subscript must be a single index");
+				if (from.type != jpiNumeric)
+					__ELog("jsonpath array subscript must be a numeric literal");
+				index = DirectFunctionCall2(numeric_trunc,
+											NumericGetDatum(jspGetNumeric(&from)),
+											Int32GetDatum(0));
+				index = DirectFunctionCall1(numeric_int4, index);
+				pos = __jsonpath_emit_head(buf, JSPC_INDEX);
+				__jsonpath_emit_word(buf, (cl_uint)DatumGetInt32(index));
+				break;
+			case jpiAnyArray:
+				pos = __jsonpath_emit_head(buf, JSPC_ANY_ARRAY);
+				break;
+			case jpiAnyKey:
+				pos = __jsonpath_emit_head(buf, JSPC_ANY_KEY);
+				break;
+			case jpiFilter:
+				pos = __jsonpath_emit_head(buf, JSPC_FILTER);
+				jspGetArg(&next, &from);
+				__compile_jsonpath_predicate(buf, &from, depth + 1);
+				break;
+			default:
+				__ELog("jsonpath item (type=%d) is not device supported",
+					   (int)next.type);
+		}
+		__jsonpath_emit_tail(buf, pos);
+		item = next;
+	}
+	pos = __jsonpath_emit_head(buf, JSPC_END);
+	__jsonpath_emit_tail(buf, pos);
+}
+
+static bytea *
+pgstrom_compile_jsonpath(JsonPath *jpath)
+{
+	JsonPathItem jsp;
+	StringInfoData buf;
+	kern_jsonpath *kjpath;
+
+	if ((jpath->header & JSONPATH_LAX) == 0)
+		__ELog("jsonpath in strict mode is not device supported");
+	initStringInfo(&buf);
+	enlargeStringInfo(&buf, offsetof(kern_jsonpath, code));
+	buf.len = offsetof(kern_jsonpath, code);
+	jspInit(&jsp, jpath);
+	__compile_jsonpath_steps(&buf, &jsp, false, 0);
+
+	kjpath = (kern_jsonpath *) buf.data;
+	SET_VARSIZE(kjpath, buf.len);
+	kjpath->magic = KERN_JSONPATH_MAGIC;
+	kjpath->nwords = (buf.len - offsetof(kern_jsonpath,
+										 code)) / sizeof(cl_uint);
+	return (bytea *) kjpath;
+}
+
+/*
+ * codegen_jsonpath_expression
+ *
+ * jsonb_path_exists() and jsonb @? jsonpath take a constant jsonpath only;
+ * it is compiled to kern_jsonpath at the planning time, then delivered to
+ * the device code as a bytea parameter.
+ */
+static int
+codegen_jsonpath_expression(codegen_context *context,
+							StringInfo body,
+							List *args)
+{
+	Node	   *expr;
+	Const	   *con;
+	bytea	   *kjpath;
+	int			index;
+
+	if (list_length(args) != 2 && list_length(args) != 4)
+		__ELog("unexpected number of arguments for jsonb_path_exists");
+	con = (Const *) lsecond(args);
+	if (!IsA(con, Const) || con->constisnull)
+		__ELog("jsonpath must be a constant");
+	if (list_length(args) == 4)
+	{
+		Const  *vars = (Const *) lthird(args);
+		Const  *silent = (Const *) lfourth(args);
+
+		if (!IsA(vars, Const) || vars->constisnull ||
+			!IsA(silent, Const) || silent->constisnull)
+			__ELog("jsonpath variables and silent flag must be constants");
+		if (!JB_ROOT_IS_OBJECT(DatumGetJsonbP(vars->constvalue)))
+			__ELog("jsonpath variables must be an object");
+	}
+	if (!pgstrom_devtype_lookup_and_track(JSONBOID, context))
+		__ELog("type jsonb is not device supported");
+	if (!pgstrom_devtype_lookup_and_track(BYTEAOID, context))
+		__ELog("type bytea is not device supported");
+	expr = linitial(args);
+	if (exprType(expr) != JSONBOID)
+		__ELog("jsonb_path_exists takes non-jsonb argument");
+	kjpath = pgstrom_compile_jsonpath(DatumGetJsonPathP(con->constvalue));
+	context->used_params = lappend(context->used_params,
+								   makeConst(BYTEAOID,
+											 -1,
+											 InvalidOid,
+											 -1,
+											 PointerGetDatum(kjpath),
+											 false,
+											 false));
+	index = list_length(context->used_params) - 1;
+
+	__appendStringInfo(body, "pgfn_jsonb_path_exists(kcxt, ");
+	codegen_expression_walker(context, body, expr, NULL);
+	__appendStringInfo(body, ", pg_bytea_param(kcxt,%d))", index);
+	context->extra_flags |= DEVKERNEL_NEEDS_JSONLIB;
+	context->devcost += 1000;
+
+	return sizeof(cl_bool);
+}
+#endif	/* PG_VERSION_NUM >= 120000 */
+
 static int
 codegen_function_expression(codegen_context *context,
 							StringInfo body,
 							devfunc_info *dfunc, List *args)
 {
 	ListCell *lc1, *lc2;
-	Expr  **fn_args = alloca(sizeof(Expr *) * list_length(args));
-	int	   *vl_width = alloca(sizeof(int) * list_length(args));
+	Expr  **fn_args;
+	int	   *vl_width;
 	int		index = 0;
 
+	if (dfunc->func_regexp_dfa)
+		return codegen_regexp_function_expression(context, body, dfunc, args);
+	if (dfunc->func_timezone_table)
+		return codegen_timezone_function_expression(context, body, dfunc, args);
+
+	fn_args = alloca(sizeof(Expr *) * list_length(args));
+	vl_width = alloca(sizeof(int) * list_length(args));
+
 	__appendStringInfo(body,
-					   "pgfn_%s(kcxt",
-					   dfunc->func_devname);
+					   "pgfn_%s%s(kcxt",
+					   dfunc->func_devname,
+					   dfunc->func_collation_table ? "_coll" : "");
 	forboth (lc1, dfunc->func_args,
 			 lc2, args)
 	{
@@ -3701,6 +4493,25 @@ codegen_function_expression(codegen_context *context,
 		}
 		fn_args[index++] = (Expr *)expr;
 	}
+	if (dfunc->func_collation_table)
+	{
+		/* collation table to compare strings under non-C collation */
+		bytea  *ctab = pgstrom_collation_table(dfunc->func_collid);
+
+		if (!ctab || !pgstrom_devtype_lookup_and_track(BYTEAOID, context))
+			__ELog("collation %u is not device supported",
+				   dfunc->func_collid);
+		context->used_params = lappend(context->used_params,
+									   makeConst(BYTEAOID,
+												 -1,
+												 InvalidOid,
+												 -1,
+												 PointerGetDatum(ctab),
+												 false,
+												 false));
+		__appendStringInfo(body, ", pg_bytea_param(kcxt,%d)",
+						   list_length(context->used_params) - 1);
+	}
 	__appendStringInfoChar(body, ')');
 	/* estimation of function result width */
 	return dfunc->devfunc_result_sz(context, dfunc, fn_args, vl_width);
@@ -3786,6 +4597,78 @@ codegen_booleantest_expression(codegen_context *context,
 	return sizeof(cl_bool);
 }
 
+/*
+ * __codegen_bool_is_cheap
+ *
+ * It checks whether the argument of AND/OR is a cheap and error-free
+ * predicate; a comparison of fixed-length values of the same type, or
+ * NullTest/BooleanTest on a Var. These are evaluated branch-free and
+ * combined with bitwise operations, because branches on them make warp
+ * divergence rather than saving the computing cycles.
+ */
+#define BOOLEXPR_CHEAP_DEVCOST		2
+
+static bool
+__codegen_bool_is_cheap_arg(Node *node, Oid type_oid)
+{
+	devtype_info *dtype;
+
+	if (!IsA(node, Var) && !IsA(node, Const) && !IsA(node, Param))
+		return false;
+	if (exprType(node) != type_oid)
+		return false;
+	dtype = pgstrom_devtype_lookup(type_oid);
+	return (dtype != NULL && dtype->type_length > 0);
+}
+
+static bool
+__codegen_bool_is_cheap(Node *node)
+{
+	Oid			func_oid;
+	Oid			func_collid;
+	List	   *func_args;
+	devfunc_info *dfunc;
+	ListCell   *lc;
+
+	if (IsA(node, NullTest))
+		return IsA(((NullTest *) node)->arg, Var);
+	if (IsA(node, BooleanTest))
+		return IsA(((BooleanTest *) node)->arg, Var);
+	if (IsA(node, OpExpr))
+	{
+		OpExpr	   *op = (OpExpr *) node;
+
+		if (op->opresulttype != BOOLOID)
+			return false;
+		func_oid = get_opcode(op->opno);
+		func_collid = op->inputcollid;
+		func_args = op->args;
+	}
+	else if (IsA(node, FuncExpr))
+	{
+		FuncExpr   *func = (FuncExpr *) node;
+
+		if (func->funcresulttype != BOOLOID)
+			return false;
+		func_oid = func->funcid;
+		func_collid = func->inputcollid;
+		func_args = func->args;
+	}
+	else
+		return false;
+
+	if (list_length(func_args) != 2)
+		return false;
+	foreach (lc, func_args)
+	{
+		if (!__codegen_bool_is_cheap_arg(lfirst(lc),
+										 exprType(linitial(func_args))))
+			return false;
+	}
+	dfunc = pgstrom_devfunc_lookup(func_oid, BOOLOID, func_args, func_collid);
+	return (dfunc != NULL && dfunc->func_devcost <= BOOLEXPR_CHEAP_DEVCOST);
+}
+
 static int
 codegen_bool_expression(codegen_context *context,
 						StringInfo body, BoolExpr *b)
@@ -3806,24 +4689,64 @@ codegen_bool_expression(codegen_context *context,
 	{
 		StringInfoData temp;
 		List	   *used_vars_saved;
+		List	   *cheap_args = NIL;
+		List	   *other_args = NIL;
+		Bitmapset  *cse_refs_saved;
 		ListCell   *lc;
 
 		initStringInfo(&temp);
 
 		used_vars_saved = context->used_vars;
 		context->used_vars = NIL;
+		cse_refs_saved = context->cse_refs;
+		context->cse_refs = NULL;
 		foreach (lc, b->args)
 		{
 			Node	   *node = lfirst(lc);
 
-			if (lc != list_head(b->args))
-				__appendStringInfo(&temp, "  has_null |= status.isnull;\n");
+			if (__codegen_bool_is_cheap(node))
+				cheap_args = lappend(cheap_args, node);
+			else
+				other_args = lappend(other_args, node);
+		}
+
+		/*
+		 * Cheap predicates are evaluated branch-free first, then we
+		 * short-circuit once if any of them decides the result. Expensive
+		 * sub-expressions are evaluated one by one with short-circuit.
+		 */
+		foreach (lc, cheap_args)
+		{
+			Node	   *node = lfirst(lc);
+
+			__appendStringInfo(&temp,
+							   "  status = ");
+			codegen_expression_walker(context, &temp, node, NULL);
+			__appendStringInfo(&temp, ";\n"
+							   "  has_null |= status.isnull;\n"
+							   "  decided |= (!status.isnull & %sstatus.value);\n",
+							   (b->boolop == AND_EXPR ? "!" : ""));
+		}
+		if (cheap_args != NIL)
+			__appendStringInfo(&temp,
+							   "  if (decided)\n"
+							   "  {\n"
+							   "    status.isnull = false;\n"
+							   "    status.value = %s;\n"
+							   "    return status;\n"
+							   "  }\n",
+							   (b->boolop == AND_EXPR ? "false" : "true"));
+		foreach (lc, other_args)
+		{
+			Node	   *node = lfirst(lc);
+
 			__appendStringInfo(&temp,
 							   "  status = ");
 			codegen_expression_walker(context, &temp, node, NULL);
 			__appendStringInfo(&temp, ";\n"
 							   "  if (PG_BOOL_%s(status))\n"
-							   "    return status;\n",
+							   "    return status;\n"
+							   "  has_null |= status.isnull;\n",
 							   (b->boolop == AND_EXPR ? "ISFALSE" : "ISTRUE"));
 		}
 		context->decl_count++;
@@ -3856,12 +4779,14 @@ codegen_bool_expression(codegen_context *context,
 			if (!list_member(used_vars_saved, var))
 				used_vars_saved = lappend(used_vars_saved, var);
 		}
+		codegen_cse_helper_arguments(context, body, cse_refs_saved);
 		__appendStringInfo(
 			&context->decl,
 			")\n"
 			"{\n"
 			"  pg_bool_t status __attribute__((unused));\n"
 			"  cl_bool   has_null = false;\n"
+			"  cl_bool   decided __attribute__((unused)) = false;\n"
 			"\n"
 			"%s"
 			"  status.isnull |= has_null;\n"
@@ -3871,6 +4796,8 @@ codegen_bool_expression(codegen_context *context,
 		__appendStringInfo(body, ")");
 		context->used_vars = used_vars_saved;
 
+		list_free(cheap_args);
+		list_free(other_args);
 		pfree(temp.data);
 	}
 	else
@@ -3889,6 +4816,7 @@ codegen_coalesce_expression(codegen_context *context,
 	devtype_info   *dtype;
 	StringInfoData	temp;
 	List		   *used_vars_saved;
+	Bitmapset	   *cse_refs_saved;
 	ListCell	   *lc;
 	int				maxlen = 0;
 
@@ -3900,6 +4828,8 @@ codegen_coalesce_expression(codegen_context *context,
 
 	used_vars_saved = context->used_vars;
 	context->used_vars = NIL;
+	cse_refs_saved = context->cse_refs;
+	context->cse_refs = NULL;
 	foreach (lc, coalesce->args)
 	{
 		Node   *expr = lfirst(lc);
@@ -3958,6 +4888,7 @@ codegen_coalesce_expression(codegen_context *context,
 		if (!list_member(used_vars_saved, var))
 			used_vars_saved = lappend(used_vars_saved, var);
 	}
+	codegen_cse_helper_arguments(context, body, cse_refs_saved);
 	__appendStringInfo(
 		&context->decl,
 		")\n"
@@ -3986,6 +4917,7 @@ codegen_minmax_expression(codegen_context *context,
 	devtype_info   *dtype;
 	devfunc_info   *dfunc;
 	List		   *used_vars_saved;
+	Bitmapset	   *cse_refs_saved;
 	ListCell	   *lc;
 	StringInfoData	temp;
 	int				maxlen = 0;
@@ -4000,11 +4932,15 @@ codegen_minmax_expression(codegen_context *context,
 	if (!dfunc)
 		__ELog("device type %s has no comparison operator",
 			   format_type_be(minmax->minmaxtype));
+	if (dfunc->func_collation_table)
+		__ELog("GREATEST/LEAST under non-C collation is not supported");
 	context->extra_flags |= dfunc->func_flags;
 	
 	initStringInfo(&temp);
 	used_vars_saved = context->used_vars;
 	context->used_vars = NIL;
+	cse_refs_saved = context->cse_refs;
+	context->cse_refs = NULL;
 	foreach (lc, minmax->args)
 	{
 		Node   *expr = lfirst(lc);
@@ -4074,6 +5010,7 @@ codegen_minmax_expression(codegen_context *context,
         if (!list_member(used_vars_saved, var))
             used_vars_saved = lappend(used_vars_saved, var);
     }
+	codegen_cse_helper_arguments(context, body, cse_refs_saved);
     __appendStringInfo(
         &context->decl,
         ")\n"
@@ -4124,6 +5061,73 @@ codegen_relabel_expression(codegen_context *context,
 	return width;
 }
 
+/*
+ * codegen_fieldselect_expression
+ *
+ * FieldSelect is supported only if source composite datum comes from
+ * Arrow::Struct column of Arrow_Fdw, because the device code references
+ * the sub-field directly from the columnar buffer. Composite datum in the
+ * heap format shall be evaluated by CPU.
+ */
+static bool
+__fieldselect_source_is_arrow(codegen_context *context, Node *node)
+{
+	PlannerInfo *root = context->root;
+	RelOptInfo *rel;
+	Var		   *var;
+
+	while (IsA(node, FieldSelect))
+		node = (Node *)((FieldSelect *) node)->arg;
+	if (!IsA(node, Var))
+		return false;
+	var = (Var *) node;
+	if (IS_SPECIAL_VARNO(var->varno))
+		return true;	/* already checked at the path construction */
+	if (!root || var->varno >= root->simple_rel_array_size)
+		return false;
+	rel = root->simple_rel_array[var->varno];
+
+	return (rel != NULL && baseRelIsArrowFdw(rel));
+}
+
+static int
+codegen_fieldselect_expression(codegen_context *context,
+							   StringInfo body,
+							   FieldSelect *fselect)
+{
+	devtype_info *ctype;
+	devtype_info *dtype;
+	Oid		ctype_oid = exprType((Node *)fselect->arg);
+	int		width;
+
+	if (!__fieldselect_source_is_arrow(context, (Node *)fselect->arg))
+		__ELog("FieldSelect on non-Arrow composite datum");
+
+	ctype = pgstrom_devtype_lookup_and_track(ctype_oid, context);
+	if (!ctype)
+		__ELog("type %s is not device supported",
+			   format_type_be(ctype_oid));
+	if (fselect->fieldnum < 1 || fselect->fieldnum > ctype->comp_nfields)
+		__ELog("FieldSelect (fieldnum=%d) is out of range",
+			   fselect->fieldnum);
+	dtype = pgstrom_devtype_lookup_and_track(fselect->resulttype, context);
+	if (!dtype)
+		__ELog("type %s is not device supported",
+			   format_type_be(fselect->resulttype));
+
+	__appendStringInfo(body, "pg_composite_field<pg_%s_t>(kcxt, ",
+					   dtype->type_name);
+	codegen_expression_walker(context, body, (Node *)fselect->arg, &width);
+	__appendStringInfo(body, ", %d)", fselect->fieldnum - 1);
+
+	if (dtype->type_length >= 0)
+		width = dtype->type_length;
+	else
+		width = type_maximum_size(fselect->resulttype,
+								  fselect->resulttypmod) - VARHDRSZ;
+	return width;
+}
+
 static int
 codegen_coerceviaio_expression(codegen_context *context,
 							   StringInfo body,
@@ -4180,6 +5184,7 @@ codegen_casewhen_expression(codegen_context *context,
 	StringInfoData	temp;
 	Node		   *defresult;
 	List		   *used_vars_saved;
+	Bitmapset	   *cse_refs_saved;
 	ListCell	   *lc;
 	Oid				type_oid;
 	int				width, maxlen = 0;
@@ -4205,6 +5210,8 @@ codegen_casewhen_expression(codegen_context *context,
 	initStringInfo(&temp);
 	used_vars_saved = context->used_vars;
 	context->used_vars = NIL;
+	cse_refs_saved = context->cse_refs;
+	context->cse_refs = NULL;
 	if (caseexpr->arg)
 	{
 		/* type compare function internally used */
@@ -4279,6 +5286,7 @@ codegen_casewhen_expression(codegen_context *context,
 		if (!list_member(used_vars_saved, var))
 			used_vars_saved = lappend(used_vars_saved, var);
 	}
+	codegen_cse_helper_arguments(context, body, cse_refs_saved);
 	__appendStringInfo(
 		&context->decl,
 		")\n"
@@ -4303,6 +5311,137 @@ codegen_casetest_expression(codegen_context *context,
 	return 0;
 }
 
+/*
+ * build_scalar_array_sorted
+ *
+ * It builds kern_sorted_array from the constant array of 'scalar = ANY(array)'
+ * if binary search is cheaper than the loop over the elements, or returns
+ * NULL. The elements must be integer or date/time types; their order as
+ * 64bit integer is identical to the order of the B-tree operator class.
+ */
+static int
+__scalar_array_sorted_comp(const void *__a, const void *__b)
+{
+	cl_long		a = *((const cl_long *)__a);
+	cl_long		b = *((const cl_long *)__b);
+
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return 0;
+}
+
+static kern_sorted_array *
+build_scalar_array_sorted(ScalarArrayOpExpr *opexpr,
+						  devfunc_info *dfunc,
+						  devtype_info *dtype_s,
+						  devtype_info *dtype_e,
+						  int *p_devcost)
+{
+	Const	   *con = lsecond(opexpr->args);
+	TypeCacheEntry *tcache;
+	ArrayType  *array;
+	Datum	   *elem_values;
+	bool	   *elem_isnull;
+	int			i, nelems;
+	int			linear_cost;
+	int			sorted_cost;
+	kern_sorted_array *sa;
+
+	if (!opexpr->useOr ||
+		!IsA(con, Const) ||
+		con->constisnull ||
+		dtype_s->type_oid != dtype_e->type_oid)
+		return NULL;
+	switch (dtype_e->type_oid)
+	{
+		case INT1OID:
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case DATEOID:
+		case TIMEOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			break;
+		default:
+			return NULL;
+	}
+	tcache = lookup_type_cache(dtype_e->type_oid, TYPECACHE_EQ_OPR);
+	if (tcache->eq_opr != opexpr->opno)
+		return NULL;
+
+	array = DatumGetArrayTypeP(con->constvalue);
+	if (ARR_ELEMTYPE(array) != dtype_e->type_oid)
+		return NULL;
+	nelems = ArrayGetNItems(ARR_NDIM(array), ARR_DIMS(array));
+	/*
+	 * Each step of the binary search fetches an element from the global
+	 * memory, so we assume it is twice expensive than the comparison.
+	 */
+	linear_cost = nelems * dfunc->func_devcost;
+	sorted_cost = 2 * (my_log2(nelems + 1) + 1);
+	if (sorted_cost >= linear_cost)
+		return NULL;
+
+	deconstruct_array(array,
+					  dtype_e->type_oid,
+					  dtype_e->type_length,
+					  dtype_e->type_byval,
+					  dtype_e->type_align,
+					  &elem_values, &elem_isnull, &nelems);
+	sa = palloc0(offsetof(kern_sorted_array, values[nelems]));
+	sa->magic = KERN_SORTED_ARRAY_MAGIC;
+	for (i=0; i < nelems; i++)
+	{
+		Datum		datum = elem_values[i];
+
+		if (elem_isnull[i])
+		{
+			sa->has_null = true;
+			continue;
+		}
+		switch (dtype_e->type_length)
+		{
+			case sizeof(int8):
+				sa->values[sa->nitems++] = (int8) DatumGetChar(datum);
+				break;
+			case sizeof(int16):
+				sa->values[sa->nitems++] = DatumGetInt16(datum);
+				break;
+			case sizeof(int32):
+				sa->values[sa->nitems++] = DatumGetInt32(datum);
+				break;
+			case sizeof(int64):
+				sa->values[sa->nitems++] = DatumGetInt64(datum);
+				break;
+			default:
+				elog(ERROR, "Bug? unexpected type length: %d",
+					 dtype_e->type_length);
+		}
+	}
+	pg_qsort(sa->values, sa->nitems, sizeof(cl_long),
+			 __scalar_array_sorted_comp);
+	/* remove duplications */
+	if (sa->nitems > 1)
+	{
+		cl_uint		j = 0;
+
+		for (i=1; i < sa->nitems; i++)
+		{
+			if (sa->values[i] != sa->values[j])
+				sa->values[++j] = sa->values[i];
+		}
+		sa->nitems = j + 1;
+	}
+	SET_VARSIZE(sa, offsetof(kern_sorted_array, values[sa->nitems]));
+
+	*p_devcost = sorted_cost;
+
+	return sa;
+}
+
 static int
 codegen_scalar_array_op_expression(codegen_context *context,
 								   StringInfo body,
@@ -4316,6 +5455,8 @@ codegen_scalar_array_op_expression(codegen_context *context,
 	Node	   *node_a;
 	HeapTuple	fn_tup;
 	oidvector  *fn_argtypes = alloca(offsetof(oidvector, values[2]));
+	kern_sorted_array *sarray;
+	int			sorted_cost;
 
 	Assert(list_length(opexpr->args) == 2);
 	node_s = linitial(opexpr->args);
@@ -4356,6 +5497,8 @@ codegen_scalar_array_op_expression(codegen_context *context,
 		if (!dfunc)
 			__ELog("function %s is not device supported",
 				   format_procedure(opexpr->opfuncid));
+		if (dfunc->func_collation_table)
+			__ELog("ScalarArrayOpExpr under non-C collation is not supported");
 		pgstrom_devfunc_track(context, dfunc);
 	}
 	PG_CATCH();
@@ -4366,6 +5509,28 @@ codegen_scalar_array_op_expression(codegen_context *context,
 	PG_END_TRY();
 	ReleaseSysCache(fn_tup);
 
+	sarray = build_scalar_array_sorted(opexpr, dfunc, dtype_s, dtype_e,
+									   &sorted_cost);
+	if (sarray)
+	{
+		int			index = list_length(context->used_params);
+
+		context->used_params = lappend(context->used_params,
+									   makeConst(BYTEAOID,
+												 -1,
+												 InvalidOid,
+												 -1,
+												 PointerGetDatum(sarray),
+												 false,
+												 false));
+		__appendStringInfo(body, "PG_SCALAR_ARRAY_SORTED_OP(kcxt, ");
+		codegen_expression_walker(context, body, node_s, NULL);
+		__appendStringInfo(body, ", pg_bytea_param(kcxt,%d))", index);
+		context->devcost += sorted_cost;
+
+		return sizeof(cl_bool);
+	}
+
 	__appendStringInfo(body,
 					   "PG_SCALAR_ARRAY_OP(kcxt, pgfn_%s, ",
 					   dfunc->func_devname);
@@ -4386,6 +5551,199 @@ codegen_scalar_array_op_expression(codegen_context *context,
 	return sizeof(cl_bool);
 }
 
+/*
+ * codegen_inline_sql_function
+ *
+ * It tries to expand the body of a SQL-language immutable function, that is
+ * not in the device function catalog, to the expression tree with the actual
+ * arguments, like inline_function() at the planner. Even if the planner did
+ * not inline the function (e.g, a STRICT function whose body is not strict),
+ * device code can run the expanded expression, because CPU fallback and CPU
+ * execution still evaluate the original function call.
+ * It returns NULL if the function body is not a simple expression.
+ */
+#define CODEGEN_INLINE_MAX_DEPTH	8
+
+static Node *
+__substitute_inline_arguments_mutator(Node *node, List *func_args)
+{
+	if (!node)
+		return NULL;
+	if (IsA(node, Param))
+	{
+		Param	   *param = (Param *) node;
+
+		if (param->paramkind == PARAM_EXTERN &&
+			param->paramid > 0 &&
+			param->paramid <= list_length(func_args))
+			return copyObject(list_nth(func_args, param->paramid - 1));
+	}
+	return expression_tree_mutator(node,
+								   __substitute_inline_arguments_mutator,
+								   func_args);
+}
+
+static Node *
+codegen_inline_sql_function(codegen_context *context,
+							Oid func_oid,
+							Oid func_rettype,
+							Oid func_collid,
+							List *func_args)
+{
+	HeapTuple	tup;
+	Form_pg_proc proc;
+	Datum		datum;
+	bool		isnull;
+	Query	   *query = NULL;
+	Node	   *expr = NULL;
+	int			i;
+	ListCell   *lc;
+
+	if (context->inline_depth >= CODEGEN_INLINE_MAX_DEPTH)
+		return NULL;
+
+	tup = SearchSysCache1(PROCOID, ObjectIdGetDatum(func_oid));
+	if (!HeapTupleIsValid(tup))
+		elog(ERROR, "cache lookup failed for function %u", func_oid);
+	proc = (Form_pg_proc) GETSTRUCT(tup);
+	if (proc->prolang != SQLlanguageId ||
+		proc->provolatile != PROVOLATILE_IMMUTABLE ||
+		proc->prosecdef ||
+		proc->proretset ||
+		proc->prorettype != func_rettype ||
+		proc->pronargs != list_length(func_args) ||
+		!heap_attisnull(tup, Anum_pg_proc_proconfig, NULL))
+		goto out;
+	/* no polymorphic or binary-compatible arguments */
+	i = 0;
+	foreach (lc, func_args)
+	{
+		Node	   *arg = lfirst(lc);
+
+		if (proc->proargtypes.values[i++] != exprType(arg) ||
+			contain_volatile_functions(arg))
+			goto out;
+	}
+
+#if PG_VERSION_NUM >= 140000
+	datum = SysCacheGetAttr(PROCOID, tup, Anum_pg_proc_prosqlbody, &isnull);
+	if (!isnull)
+	{
+		Node	   *n = stringToNode(TextDatumGetCString(datum));
+		List	   *querytree_list;
+
+		if (IsA(n, List))
+			querytree_list = linitial_node(List, castNode(List, n));
+		else
+			querytree_list = list_make1(n);
+		if (list_length(querytree_list) != 1)
+			goto out;
+		query = linitial(querytree_list);
+		AcquireRewriteLocks(query, true, false);
+	}
+	else
+#endif
+	{
+		char	   *src;
+		List	   *raw_parsetree_list;
+		SQLFunctionParseInfoPtr pinfo;
+		ParseState *pstate;
+
+		datum = SysCacheGetAttr(PROCOID, tup, Anum_pg_proc_prosrc, &isnull);
+		if (isnull)
+			elog(ERROR, "null prosrc for function %u", func_oid);
+		src = TextDatumGetCString(datum);
+		raw_parsetree_list = pg_parse_query(src);
+		if (list_length(raw_parsetree_list) != 1)
+			goto out;
+		pinfo = prepare_sql_fn_parse_info(tup, NULL, func_collid);
+		pstate = make_parsestate(NULL);
+		pstate->p_sourcetext = src;
+		sql_fn_parser_setup(pstate, pinfo);
+		query = transformTopLevelStmt(pstate, linitial(raw_parsetree_list));
+		free_parsestate(pstate);
+	}
+
+	/* only "SELECT <expression>" can be inlined */
+	if (!IsA(query, Query) ||
+		query->commandType != CMD_SELECT ||
+		query->hasAggs ||
+		query->hasWindowFuncs ||
+		query->hasTargetSRFs ||
+		query->hasSubLinks ||
+		query->cteList ||
+		query->rtable ||
+		query->jointree->fromlist ||
+		query->jointree->quals ||
+		query->groupClause ||
+		query->groupingSets ||
+		query->havingQual ||
+		query->windowClause ||
+		query->distinctClause ||
+		query->sortClause ||
+		query->limitOffset ||
+		query->limitCount ||
+		query->setOperations ||
+		list_length(query->targetList) != 1)
+		goto out;
+	expr = (Node *) ((TargetEntry *) linitial(query->targetList))->expr;
+	if (exprType(expr) != func_rettype ||
+		contain_mutable_functions(expr))
+	{
+		expr = NULL;
+		goto out;
+	}
+	expr = __substitute_inline_arguments_mutator(expr, func_args);
+
+	/*
+	 * STRICT function returns NULL if any of the arguments are NULL,
+	 * regardless of the function body.
+	 */
+	if (proc->proisstrict)
+	{
+		List	   *nulltests = NIL;
+
+		foreach (lc, func_args)
+		{
+			Node	   *arg = lfirst(lc);
+			NullTest   *ntest;
+
+			if (IsA(arg, Const) && !((Const *) arg)->constisnull)
+				continue;
+			ntest = makeNode(NullTest);
+			ntest->arg = (Expr *) copyObject(arg);
+			ntest->nulltesttype = IS_NULL;
+			ntest->argisrow = false;
+			ntest->location = -1;
+			nulltests = lappend(nulltests, ntest);
+		}
+		if (nulltests != NIL)
+		{
+			CaseExpr   *caseexpr = makeNode(CaseExpr);
+			CaseWhen   *casewhen = makeNode(CaseWhen);
+
+			casewhen->expr = (list_length(nulltests) == 1
+							  ? linitial(nulltests)
+							  : makeBoolExpr(OR_EXPR, nulltests, -1));
+			casewhen->result = (Expr *) makeNullConst(func_rettype,
+													  exprTypmod(expr),
+													  exprCollation(expr));
+			casewhen->location = -1;
+			caseexpr->casetype = func_rettype;
+			caseexpr->casecollid = exprCollation(expr);
+			caseexpr->arg = NULL;
+			caseexpr->args = list_make1(casewhen);
+			caseexpr->defresult = (Expr *) expr;
+			caseexpr->location = -1;
+			expr = (Node *) caseexpr;
+		}
+	}
+out:
+	ReleaseSysCache(tup);
+
+	return expr;
+}
+
 static void
 codegen_expression_walker(codegen_context *context,
 						  StringInfo body,
@@ -4393,6 +5751,7 @@ codegen_expression_walker(codegen_context *context,
 {
 	devfunc_info   *dfunc;
 	int				width = 0;
+	int				cse_index;
 	Node		   *__codegen_saved_node;
 
 	if (node == NULL)
@@ -4401,6 +5760,14 @@ codegen_expression_walker(codegen_context *context,
 	__codegen_saved_node   = __codegen_current_node;
 	__codegen_current_node = node;
 
+	/* common sub-expression, if any */
+	cse_index = codegen_cse_lookup(context, node);
+	if (cse_index >= 0)
+	{
+		width = codegen_cse_expression(context, body, node, cse_index);
+		goto out;
+	}
+
 	switch (nodeTag(node))
 	{
 		case T_Const:
@@ -4419,13 +5786,38 @@ codegen_expression_walker(codegen_context *context,
 			{
 				FuncExpr   *func = (FuncExpr *) node;
 
+#if PG_VERSION_NUM >= 120000
+				if (func->funcid == F_JSONB_PATH_EXISTS)
+				{
+					width = codegen_jsonpath_expression(context,
+														body,
+														func->args);
+					break;
+				}
+#endif
 				dfunc = pgstrom_devfunc_lookup(func->funcid,
 											   func->funcresulttype,
 											   func->args,
 											   func->inputcollid);
 				if (!dfunc)
+				{
+					Node   *inlined
+						= codegen_inline_sql_function(context,
+													  func->funcid,
+													  func->funcresulttype,
+													  func->inputcollid,
+													  func->args);
+					if (inlined)
+					{
+						context->inline_depth++;
+						codegen_expression_walker(context, body,
+												  inlined, &width);
+						context->inline_depth--;
+						break;
+					}
 					__ELog("function %s is not device supported",
 						   format_procedure(func->funcid));
+				}
 				pgstrom_devfunc_track(context, dfunc);
 				width = codegen_function_expression(context,
 													body,
@@ -4441,13 +5833,40 @@ codegen_expression_walker(codegen_context *context,
 				OpExpr	   *op = (OpExpr *) node;
 				Oid			func_oid = get_opcode(op->opno);
 
+#if PG_VERSION_NUM >= 120000
+				if (func_oid == F_JSONB_PATH_EXISTS_OPR)
+				{
+					width = codegen_jsonpath_expression(context,
+														body,
+														op->args);
+					break;
+				}
+#endif
 				dfunc = pgstrom_devfunc_lookup(func_oid,
 											   op->opresulttype,
 											   op->args,
 											   op->inputcollid);
 				if (!dfunc)
+				{
+					Node   *inlined = NULL;
+
+					if (IsA(node, OpExpr))
+						inlined = codegen_inline_sql_function(context,
+															  func_oid,
+															  op->opresulttype,
+															  op->inputcollid,
+															  op->args);
+					if (inlined)
+					{
+						context->inline_depth++;
+						codegen_expression_walker(context, body,
+												  inlined, &width);
+						context->inline_depth--;
+						break;
+					}
 					__ELog("function %s is not device supported",
 						   format_procedure(func_oid));
+				}
 				pgstrom_devfunc_track(context, dfunc);
 				width = codegen_function_expression(context,
 													body,
@@ -4493,6 +5912,11 @@ codegen_expression_walker(codegen_context *context,
 											   (RelabelType *) node);
 			break;
 
+		case T_FieldSelect:
+			width = codegen_fieldselect_expression(context, body,
+												   (FieldSelect *) node);
+			break;
+
 		case T_CoerceViaIO:
 			width = codegen_coerceviaio_expression(context,
 												   body,
@@ -4526,6 +5950,7 @@ codegen_expression_walker(codegen_context *context,
 			__ELog("Bug? unsupported expression: %s", nodeToString(node));
 			break;
 	}
+out:
 	if (p_width)
 		*p_width = width;
 	/* restore */
@@ -4883,6 +6308,128 @@ devindex_cache_invalidator(Datum arg, int cacheid, uint32 hashvalue)
 	}
 }
 
+/*
+ * pgstrom_rewrite_shredded_jsonb
+ *
+ * It replaces jsonb key references, like (payload->>'status') or
+ * (payload->>'amount')::numeric, in the supplied qualifiers by references
+ * to the stored generated columns that have identical expression; in
+ * Arrow files or GPU cache, these are usually plain fixed-width columns,
+ * so device code needs not to walk on the jsonb datum for each row.
+ */
+static bool
+__expression_has_jsonb_keyref(Node *node, void *context)
+{
+	Oid			func_oid;
+
+	if (!node)
+		return false;
+	if (IsA(node, FuncExpr) || IsA(node, OpExpr))
+	{
+		if (IsA(node, FuncExpr))
+			func_oid = ((FuncExpr *) node)->funcid;
+		else
+			func_oid = get_opcode(((OpExpr *) node)->opno);
+		switch (func_oid)
+		{
+			case F_JSONB_OBJECT_FIELD:
+			case F_JSONB_OBJECT_FIELD_TEXT:
+			case F_JSONB_ARRAY_ELEMENT:
+			case F_JSONB_ARRAY_ELEMENT_TEXT:
+				return true;
+			default:
+				break;
+		}
+	}
+	return expression_tree_walker(node, __expression_has_jsonb_keyref,
+								  context);
+}
+
+typedef struct
+{
+	List	   *shred_exprs;	/* generation expression */
+	List	   *shred_vars;		/* Var-node of the generated column */
+} rewrite_shredded_jsonb_context;
+
+static Node *
+__rewrite_shredded_jsonb_mutator(Node *node,
+								 rewrite_shredded_jsonb_context *con)
+{
+	ListCell   *lc1, *lc2;
+
+	if (!node)
+		return NULL;
+	forboth (lc1, con->shred_exprs,
+			 lc2, con->shred_vars)
+	{
+		if (equal(node, lfirst(lc1)))
+			return copyObject(lfirst(lc2));
+	}
+	return expression_tree_mutator(node, __rewrite_shredded_jsonb_mutator,
+								   con);
+}
+
+List *
+pgstrom_rewrite_shredded_jsonb(PlannerInfo *root,
+							   RelOptInfo *baserel,
+							   List *quals)
+{
+#if PG_VERSION_NUM >= 120000
+	rewrite_shredded_jsonb_context con;
+	RangeTblEntry *rte;
+	Relation	relation;
+	TupleDesc	tupdesc;
+	TupleConstr *constr;
+	int			i;
+
+	if (!pgstrom_jsonb_shredding ||
+		quals == NIL ||
+		!__expression_has_jsonb_keyref((Node *)quals, NULL))
+		return quals;
+
+	memset(&con, 0, sizeof(rewrite_shredded_jsonb_context));
+	rte = planner_rt_fetch(baserel->relid, root);
+	relation = table_open(rte->relid, NoLock);
+	tupdesc = RelationGetDescr(relation);
+	constr = tupdesc->constr;
+	if (constr && constr->has_generated_stored)
+	{
+		for (i=0; i < constr->num_defval; i++)
+		{
+			AttrDefault *defval = &constr->defval[i];
+			Form_pg_attribute attr = tupleDescAttr(tupdesc, defval->adnum - 1);
+			Node	   *expr;
+
+			if (attr->attisdropped ||
+				attr->attgenerated != ATTRIBUTE_GENERATED_STORED ||
+				!pgstrom_devtype_lookup(attr->atttypid))
+				continue;
+			expr = stringToNode(defval->adbin);
+			if (!__expression_has_jsonb_keyref(expr, NULL))
+				continue;
+			/* generation expression references the relation as varno=1 */
+			if (baserel->relid != 1)
+				ChangeVarNodes(expr, 1, baserel->relid, 0);
+			expr = eval_const_expressions(root, expr);
+
+			con.shred_exprs = lappend(con.shred_exprs, expr);
+			con.shred_vars = lappend(con.shred_vars,
+									 makeVar(baserel->relid,
+											 attr->attnum,
+											 attr->atttypid,
+											 attr->atttypmod,
+											 attr->attcollation,
+											 0));
+		}
+	}
+	table_close(relation, NoLock);
+
+	if (con.shred_exprs != NIL)
+		quals = (List *) __rewrite_shredded_jsonb_mutator((Node *)quals, &con);
+#endif
+	return quals;
+}
+
 void
 pgstrom_init_codegen_context(codegen_context *context,
 							 PlannerInfo *root,
@@ -4915,4 +6462,23 @@ pgstrom_init_codegen(void)
 	CacheRegisterSyscacheCallback(TYPEOID, devtype_cache_invalidator, 0);
 	CacheRegisterSyscacheCallback(CASTSOURCETARGET, devcast_cache_invalidator, 0);
 	CacheRegisterSyscacheCallback(AMOPOPID, devindex_cache_invalidator, 0);
+
+	/* pg_strom.jsonb_shredding */
+	DefineCustomBoolVariable("pg_strom.jsonb_shredding",
+							 "Enables to replace jsonb key references by the generated columns",
+							 NULL,
+							 &pgstrom_jsonb_shredding,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.enable_codegen_cse */
+	DefineCustomBoolVariable("pg_strom.enable_codegen_cse",
+							 "Enables common sub-expression elimination on the device code",
+							 NULL,
+							 &pgstrom_enable_codegen_cse,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 }
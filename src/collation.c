@@ -0,0 +1,240 @@
+/*
+ * collation.c
+ *
+ * Routines to build collation tables for text comparison on the device
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include "pg_strom.h"
+#include "catalog/pg_collation.h"
+#include "mb/pg_wchar.h"
+#include "cuda_textlib.h"
+#ifdef USE_ICU
+#include <unicode/ucoleitr.h>
+#include <unicode/uset.h>
+#endif
+
+/*
+ * Device code can compare strings under an ICU collation, if the collation
+ * elements of the characters are context free; no contractions, no numeric
+ * ordering, no French secondary ordering, no variable weighting. We build
+ * the table of collation elements for U+0000..U+00FF, then the strings that
+ * contain other characters are processed by the CPU fallback.
+ */
+typedef struct
+{
+	Oid			collid;			/* hash key */
+	bytea	   *table;			/* NULL, if not supported */
+} collation_table_entry;
+
+static HTAB	   *collation_table_htab = NULL;
+
+#ifdef USE_ICU
+/* see UCOL_CONTINUATION_MARKER in ucol_imp.h */
+#define __UCOL_CONTINUATION_MARKER		0xc0
+
+static bytea *
+__build_collation_table(pg_locale_t locale)
+{
+	UCollator  *ucol = locale->info.icu.ucol;
+	UErrorCode	status = U_ZERO_ERROR;
+	UColAttributeValue strength;
+	USet	   *contractions;
+	bool		unsupported[KERN_COLLATION_TABLE_NCHARS];
+	cl_ushort	weights[3][KERN_COLLATION_MAX_WEIGHTS];
+	int			nweights[3];
+	kern_collation_table *ctab;
+	StringInfoData buf;
+	int			i, j, count;
+
+	/* collation attributes that make collation elements context dependent */
+	strength = ucol_getAttribute(ucol, UCOL_STRENGTH, &status);
+	if (U_FAILURE(status) ||
+		strength > UCOL_TERTIARY ||
+		ucol_getAttribute(ucol, UCOL_FRENCH_COLLATION, &status) == UCOL_ON ||
+		ucol_getAttribute(ucol, UCOL_ALTERNATE_HANDLING, &status) == UCOL_SHIFTED ||
+		ucol_getAttribute(ucol, UCOL_CASE_FIRST, &status) != UCOL_OFF ||
+		ucol_getAttribute(ucol, UCOL_CASE_LEVEL, &status) == UCOL_ON ||
+		ucol_getAttribute(ucol, UCOL_NUMERIC_COLLATION, &status) == UCOL_ON ||
+		U_FAILURE(status))
+		return NULL;
+
+	/* characters that are part of contractions */
+	memset(unsupported, 0, sizeof(unsupported));
+	contractions = uset_openEmpty();
+	ucol_getContractionsAndExpansions(ucol, contractions, NULL, true, &status);
+	if (U_FAILURE(status))
+	{
+		uset_close(contractions);
+		return NULL;
+	}
+	count = uset_getItemCount(contractions);
+	for (i=0; i < count; i++)
+	{
+		UChar32		start, end;
+		UChar		str[256];
+		int32_t		len;
+
+		len = uset_getItem(contractions, i, &start, &end,
+						   str, lengthof(str), &status);
+		if (U_FAILURE(status))
+		{
+			uset_close(contractions);
+			return NULL;
+		}
+		if (len == 0)
+		{
+			for (j = start; j <= end && j < KERN_COLLATION_TABLE_NCHARS; j++)
+				unsupported[j] = true;
+		}
+		else
+		{
+			for (j=0; j < len; j++)
+			{
+				if (str[j] < KERN_COLLATION_TABLE_NCHARS)
+					unsupported[str[j]] = true;
+			}
+		}
+	}
+	uset_close(contractions);
+
+	/* collation elements of the characters */
+	initStringInfo(&buf);
+	enlargeStringInfo(&buf, offsetof(kern_collation_table, weights));
+	buf.len = offsetof(kern_collation_table, weights);
+	ctab = (kern_collation_table *) buf.data;
+	memset(ctab, 0, buf.len);
+	for (i=0; i < KERN_COLLATION_TABLE_NCHARS; i++)
+	{
+		UChar		uchar = i;
+		UCollationElements *elems;
+		int32_t		ce;
+		int			k;
+
+		if (unsupported[i])
+			goto skip;
+		elems = ucol_openElements(ucol, &uchar, 1, &status);
+		if (U_FAILURE(status))
+			goto error;
+		memset(nweights, 0, sizeof(nweights));
+		while ((ce = ucol_next(elems, &status)) != UCOL_NULLORDER)
+		{
+			uint32	w[3];
+
+			if (U_FAILURE(status))
+			{
+				ucol_closeElements(elems);
+				goto error;
+			}
+			w[0] = ucol_primaryOrder(ce);
+			if ((ce & __UCOL_CONTINUATION_MARKER) == __UCOL_CONTINUATION_MARKER)
+				w[1] = w[2] = 0;
+			else
+			{
+				w[1] = ucol_secondaryOrder(ce);
+				w[2] = ucol_tertiaryOrder(ce);
+			}
+			for (k=0; k < 3; k++)
+			{
+				if (w[k] == 0)
+					continue;
+				if (nweights[k] >= KERN_COLLATION_MAX_WEIGHTS)
+				{
+					unsupported[i] = true;
+					break;
+				}
+				weights[k][nweights[k]++] = w[k];
+			}
+		}
+		ucol_closeElements(elems);
+		if (unsupported[i])
+			goto skip;
+		/* buf.data may be moved */
+		ctab = (kern_collation_table *) buf.data;
+		ctab->chars[i].offset = (buf.len - offsetof(kern_collation_table,
+													weights)) / sizeof(cl_ushort);
+		for (k=0; k < 3; k++)
+		{
+			ctab->chars[i].nweights[k] = nweights[k];
+			appendBinaryStringInfo(&buf, (char *)weights[k],
+								   sizeof(cl_ushort) * nweights[k]);
+		}
+		continue;
+	skip:
+		ctab = (kern_collation_table *) buf.data;
+		ctab->chars[i].flags |= KERN_COLLATION_CHAR__UNSUPPORTED;
+	}
+	ctab = (kern_collation_table *) buf.data;
+	SET_VARSIZE(ctab, buf.len);
+	ctab->magic = KERN_COLLATION_TABLE_MAGIC;
+	ctab->nlevels = (strength == UCOL_PRIMARY ? 1 :
+					 strength == UCOL_SECONDARY ? 2 : 3);
+	ctab->nweights = (buf.len - offsetof(kern_collation_table,
+										 weights)) / sizeof(cl_ushort);
+	return (bytea *) ctab;
+
+error:
+	pfree(buf.data);
+	return NULL;
+}
+#endif	/* USE_ICU */
+
+/*
+ * pgstrom_collation_table
+ *
+ * It returns kern_collation_table in bytea form for the supplied collation,
+ * or NULL if device code cannot compare strings under the collation.
+ */
+bytea *
+pgstrom_collation_table(Oid collid)
+{
+	collation_table_entry *entry;
+	bool		found;
+
+	if (!collation_table_htab)
+	{
+		HASHCTL		hctl;
+
+		memset(&hctl, 0, sizeof(HASHCTL));
+		hctl.keysize = sizeof(Oid);
+		hctl.entrysize = sizeof(collation_table_entry);
+		hctl.hcxt = TopMemoryContext;
+		collation_table_htab = hash_create("collation table", 32, &hctl,
+										   HASH_ELEM | HASH_BLOBS |
+										   HASH_CONTEXT);
+	}
+	entry = hash_search(collation_table_htab, &collid, HASH_FIND, NULL);
+	if (!entry)
+	{
+		bytea	   *table = NULL;
+#ifdef USE_ICU
+		pg_locale_t	locale;
+
+		if (OidIsValid(collid) &&
+			collid != DEFAULT_COLLATION_OID &&
+			GetDatabaseEncoding() == PG_UTF8)
+		{
+			locale = pg_newlocale_from_collation(collid);
+			if (locale && locale->provider == COLLPROVIDER_ICU
+#if PG_VERSION_NUM >= 120000
+				&& locale->deterministic
+#endif
+				)
+			{
+				MemoryContext oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+
+				table = __build_collation_table(locale);
+				MemoryContextSwitchTo(oldcxt);
+			}
+		}
+#endif
+		entry = hash_search(collation_table_htab, &collid, HASH_ENTER, &found);
+		Assert(!found);
+		entry->table = table;
+	}
+	return entry->table;
+}
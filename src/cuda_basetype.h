@@ -326,15 +326,18 @@ pg_varlena_datum_extract(kern_context *kcxt, T &arg,
 		return false;
 	if (arg.length < 0)
 	{
-		if (VARATT_IS_COMPRESSED(arg.value) ||
-			VARATT_IS_EXTERNAL(arg.value))
-        {
-			STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,
-							   "compressed or external varlena on device");
-			return false;
-        }
-		*s = VARDATA_ANY(arg.value);
-		*len = VARSIZE_ANY_EXHDR(arg.value);
+		varlena	   *datum = (varlena *)arg.value;
+
+		if (VARATT_IS_COMPRESSED(datum) ||
+			VARATT_IS_EXTERNAL(datum))
+		{
+			/* inline-compressed datum is expanded on the device */
+			datum = pg_varlena_decompress(kcxt, datum);
+			if (!datum)
+				return false;
+		}
+		*s = VARDATA_ANY(datum);
+		*len = VARSIZE_ANY_EXHDR(datum);
 	}
 	else
 	{
@@ -1005,5 +1008,42 @@ DEVICE_FUNCTION(cl_uint)
 pg_composite_datum_length(kern_context *kcxt, Datum datum);
 DEVICE_FUNCTION(cl_uint)
 pg_composite_datum_write(kern_context *kcxt, char *dest, Datum datum);
+
+/*
+ * pg_composite_field - reference to a sub-field of Arrow::Struct (FieldSelect)
+ *
+ * @fieldnum is zero-origin. A composite datum in the PostgreSQL's heap
+ * format (@length < 0) is not deformed on the device, so it falls back
+ * to the CPU.
+ */
+template <typename T>
+DEVICE_INLINE(T)
+pg_composite_field(kern_context *kcxt, pg_composite_t comp, cl_uint fieldnum)
+{
+	T		result;
+
+	if (comp.isnull)
+		result.isnull = true;
+	else if (comp.length < 0)
+	{
+		result.isnull = true;
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,
+						   "heap-format composite datum on device");
+	}
+	else if (fieldnum >= comp.length)
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,
+					  "wrong code generation");
+	}
+	else
+	{
+		pg_datum_fetch_arrow(kcxt, result,
+							 comp.smeta + fieldnum,
+							 comp.value,
+							 comp.rowidx);
+	}
+	return result;
+}
 #endif /* __CUDACC__ */
 #endif /* CUDA_BASETYPE_H */
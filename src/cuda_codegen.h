@@ -30,6 +30,8 @@
 #define DEVKERNEL_NEEDS_GPUJOIN			0x00000002	/* GpuJoin */
 #define DEVKERNEL_NEEDS_GPUPREAGG		0x00000004	/* GpuPreAgg */
 #define DEVKERNEL_NEEDS_GPUSORT			0x00000008	/* GpuSort */
+#define DEVKERNEL_GPUSCAN_SIMPLE		0x00000010	/* precompiled GpuScan */
+#define DEVKERNEL_GPUSORT_RADIX			0x00000020	/* precompiled GpuSort */
 
 #define DEVKERNEL_NEEDS_PRIMITIVE		0x00000100
 #define DEVKERNEL_NEEDS_TIMELIB			0x00000200
@@ -105,6 +107,10 @@ typedef struct devfunc_info {
 	bool		func_is_strict;		/* True, if NULL strict function */
 	/* fields below are valid only if func_is_negative is false */
 	int32		func_flags;		/* Extra flags of this function */
+	bool		func_collation_table;	/* compare under non-C collation */
+	bool		func_regexp_dfa;	/* 2nd argument is a regexp compiled to DFA */
+	bool		func_regexp_icase;	/* case insensitive regexp */
+	bool		func_timezone_table;	/* 1st argument is a time zone name */
 	List	   *func_args;		/* argument types by devtype_info */
 	devtype_info *func_rettype;	/* result type by devtype_info */
 	const char *func_sqlname;	/* name of the function in SQL side */
@@ -149,6 +155,8 @@ typedef struct devindex_info {
 	const char	   *index_fname;	/* device index handler name */
 	devtype_info   *ivar_dtype;		/* device type of index'ed value */
 	devtype_info   *iarg_dtype;		/* device type of index argument for search */
+	const char	   *index_keytype;	/* device type of the index key, if it has
+									 * different format from ivar_dtype */
 	bool			index_is_negative;
 } devindex_info;
 
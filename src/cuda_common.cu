@@ -873,7 +873,7 @@ toast_raw_datum_size(kern_context *kcxt, varlena *attr)
 	else if (VARATT_IS_COMPRESSED(attr))
 	{
 		/* here, va_rawsize is just the payload size */
-		result = VARRAWSIZE_4B_C(attr) + VARHDRSZ;
+		result = (VARRAWSIZE_4B_C(attr) & VARLENA_EXTSIZE_MASK) + VARHDRSZ;
 	}
 	else if (VARATT_IS_SHORT(attr))
 	{
@@ -992,21 +992,109 @@ pglz_decompress(const char *source, cl_int slen,
 	return rawsize;
 }
 
+/*
+ * lz4_decompress - decompress a LZ4 block (compatible to LZ4_decompress_safe)
+ */
+DEVICE_FUNCTION(cl_int)
+lz4_decompress(const char *source, cl_int slen,
+			   char *dest, cl_int rawsize)
+{
+	const cl_uchar *sp = (const cl_uchar *) source;
+	const cl_uchar *srcend = sp + slen;
+	cl_uchar	   *dp = (cl_uchar *) dest;
+	cl_uchar	   *destend = dp + rawsize;
+
+	while (sp < srcend)
+	{
+		cl_uint		token = *sp++;
+		cl_uint		len = (token >> 4);
+		cl_uint		off;
+
+		/* literal length */
+		if (len == 15)
+		{
+			cl_uchar	c;
+
+			do {
+				if (sp >= srcend)
+					return -1;
+				c = *sp++;
+				len += c;
+			} while (c == 255);
+		}
+		if (sp + len > srcend || dp + len > destend)
+			return -1;
+		memcpy(dp, sp, len);
+		sp += len;
+		dp += len;
+		/* the last sequence has no match part */
+		if (sp >= srcend)
+			break;
+
+		/* match offset and length */
+		if (sp + 2 > srcend)
+			return -1;
+		off = (cl_uint)sp[0] | ((cl_uint)sp[1] << 8);
+		sp += 2;
+		if (off == 0 || off > (cl_uint)(dp - (cl_uchar *) dest))
+			return -1;
+		len = (token & 0x0f);
+		if (len == 15)
+		{
+			cl_uchar	c;
+
+			do {
+				if (sp >= srcend)
+					return -1;
+				c = *sp++;
+				len += c;
+			} while (c == 255);
+		}
+		len += 4;	/* MINMATCH */
+		if (dp + len > destend)
+			return -1;
+		/* copy areas may overlap, so byte-by-byte */
+		while (len--)
+		{
+			*dp = dp[-off];
+			dp++;
+		}
+	}
+	if (dp != destend)
+		return -1;
+	return rawsize;
+}
+
 DEVICE_FUNCTION(cl_bool)
 toast_decompress_datum(char *buffer, cl_uint buflen,
 					   const varlena *datum)
 {
 	cl_int		rawsize;
+	cl_int		retval;
 
 	assert(VARATT_IS_COMPRESSED(datum));
-	rawsize = TOAST_COMPRESS_RAWSIZE(datum);
+	rawsize = TOAST_COMPRESS_EXTSIZE(datum);
 	if (rawsize + VARHDRSZ > buflen)
 		return false;
 	SET_VARSIZE(buffer, rawsize + VARHDRSZ);
-	if (pglz_decompress(TOAST_COMPRESS_RAWDATA(datum),
-						VARSIZE(datum) - TOAST_COMPRESS_HDRSZ,
-						buffer + VARHDRSZ,
-						rawsize) < 0)
+	switch (TOAST_COMPRESS_METHOD(datum))
+	{
+		case TOAST_PGLZ_COMPRESSION_ID:
+			retval = pglz_decompress(TOAST_COMPRESS_RAWDATA(datum),
+									 VARSIZE(datum) - TOAST_COMPRESS_HDRSZ,
+									 buffer + VARHDRSZ,
+									 rawsize);
+			break;
+		case TOAST_LZ4_COMPRESSION_ID:
+			retval = lz4_decompress(TOAST_COMPRESS_RAWDATA(datum),
+									VARSIZE(datum) - TOAST_COMPRESS_HDRSZ,
+									buffer + VARHDRSZ,
+									rawsize);
+			break;
+		default:
+			return false;
+	}
+	if (retval < 0)
 	{
 		printf("GPU kernel: compressed varlena datum is corrupted\n");
 		return false;
@@ -1014,6 +1102,31 @@ toast_decompress_datum(char *buffer, cl_uint buflen,
 	return true;
 }
 
+/*
+ * pg_varlena_decompress
+ *
+ * It decompresses an inline-compressed varlena datum onto the varlena
+ * buffer of the kernel context. If no room to expand, or external datum,
+ * it requires CPU fallback as usual.
+ */
+DEVICE_FUNCTION(varlena *)
+pg_varlena_decompress(kern_context *kcxt, varlena *datum)
+{
+	char	   *buffer;
+	cl_uint		buflen;
+
+	if (VARATT_IS_COMPRESSED(datum))
+	{
+		buflen = TOAST_COMPRESS_EXTSIZE(datum) + VARHDRSZ;
+		buffer = (char *)kern_context_alloc(kcxt, buflen);
+		if (buffer && toast_decompress_datum(buffer, buflen, datum))
+			return (varlena *)buffer;
+	}
+	STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,
+					   "compressed or external varlena on device");
+	return NULL;
+}
+
 /*
  * kern_get_datum_xxx
  *
@@ -1751,6 +1864,66 @@ STROMCL_VARLENA_PGARRAY_TEMPLATE(bytea)
 STROMCL_VARLENA_PGARRAY_TEMPLATE(text)
 STROMCL_VARLENA_PGARRAY_TEMPLATE(bpchar)
 
+/*
+ * Arrow::List<Struct> to an array of composite type
+ */
+STATIC_FUNCTION(cl_uint)
+pg_composite_array_from_arrow(kern_context *kcxt,
+							  char *dest,
+							  kern_colmeta *cmeta,
+							  char *base,
+							  cl_uint start, cl_uint end)
+{
+	ArrayType  *res = (ArrayType *)dest;
+	cl_uint		nitems = end - start;
+	cl_uint		i, sz;
+	char	   *nullmap = NULL;
+	pg_composite_t temp;
+
+	Assert((cl_ulong)res == MAXALIGN(res));
+	Assert(start <= end);
+	if (cmeta->nullmap_offset == 0)
+		sz = ARR_OVERHEAD_NONULLS(1);
+	else
+		sz = ARR_OVERHEAD_WITHNULLS(1, nitems);
+
+	if (res)
+	{
+		res->ndim = 1;
+		res->dataoffset = (cmeta->nullmap_offset == 0 ? 0 : sz);
+		res->elemtype = cmeta->atttypid;
+		ARR_DIMS(res)[0] = nitems;
+		ARR_LBOUND(res)[0] = 1;
+
+		nullmap = ARR_NULLBITMAP(res);
+	}
+
+	for (i=0; i < nitems; i++)
+	{
+		pg_datum_fetch_arrow(kcxt, temp, cmeta, base, start+i);
+		if (temp.isnull)
+		{
+			if (nullmap)
+				nullmap[i>>3] &= ~(1<<(i&7));
+			else
+				Assert(!dest);
+		}
+		else
+		{
+			if (nullmap)
+				nullmap[i>>3] |= (1<<(i&7));
+			sz = TYPEALIGN(cmeta->attalign, sz);
+			if (dest)
+				sz += pg_composite_datum_write(kcxt, dest + sz,
+											   PointerGetDatum(&temp));
+			else
+				sz += pg_composite_datum_length(kcxt,
+												PointerGetDatum(&temp));
+		}
+	}
+	return sz;
+}
+
 /*
  * functions to write out Arrow::List<T> as an array of PostgreSQL
  *
@@ -1768,6 +1941,8 @@ __pg_array_from_arrow(kern_context *kcxt, char *dest, Datum datum)
 
 	assert(!array->isnull && array->length >= 0);
 	assert(start <= end);
+	if (smeta->atttypkind == TYPE_KIND__COMPOSITE)
+		return pg_composite_array_from_arrow(kcxt,dest,smeta,base,start,end);
 	switch (smeta->atttypid)
 	{
 		case PG_BOOLOID:
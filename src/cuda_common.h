@@ -702,9 +702,11 @@ typedef struct IndexAttributeBitMapData
 typedef cl_uint		TransactionId;
 #define InvalidTransactionId		((TransactionId) 0)
 #define FrozenTransactionId			((TransactionId) 2)
+#define FirstNormalTransactionId	((TransactionId) 3)
 #define InvalidCommandId			(~0U)
 #else
 #include "access/htup_details.h"
+#include "access/transam.h"
 #endif	/* __CUDACC__ */
 
 typedef struct
@@ -718,6 +720,110 @@ typedef struct
 	TransactionId values[FLEXIBLE_ARRAY_MEMBER];
 } xidvector;
 
+/*
+ * kern_mvcc_snapshot
+ *
+ * A compact form of the MVCC snapshot of the scan, to check visibility of
+ * the tuples on the heap blocks without PD_ALL_VISIBLE on the device side.
+ * values[] contains the commit-status bitmap of the transactions in the
+ * range of [xid_base, xmax), then the sorted array of the in-progress
+ * transactions (xip[] and subxip[]) at the snapshot.
+ * Transactions older than xid_base (relfrozenxid of the relation) are
+ * already frozen or committed/aborted with hint bits.
+ */
+typedef struct
+{
+	cl_uint		length;			/* total length of this structure */
+	TransactionId xid_base;		/* base of the commit-status bitmap */
+	TransactionId xmin;			/* snapshot->xmin */
+	TransactionId xmax;			/* snapshot->xmax */
+	cl_uint		nxip;			/* # of in-progress transactions */
+	cl_uint		nwords;			/* # of words of the bitmap */
+	cl_uint		values[FLEXIBLE_ARRAY_MEMBER];
+} kern_mvcc_snapshot;
+
+#define KERN_MVCC_SNAPSHOT_XIP(snap)	((snap)->values + (snap)->nwords)
+
+/*
+ * kern_mvcc_xid_is_visible
+ *
+ * It returns true, if the supplied transaction is committed and visible
+ * to the snapshot; like XidInMVCCSnapshot() and TransactionIdDidCommit().
+ */
+STATIC_INLINE(cl_bool)
+kern_mvcc_xid_is_visible(const kern_mvcc_snapshot *snap, TransactionId xid)
+{
+	const cl_uint *xip;
+	cl_uint		head, tail;
+	cl_uint		pos;
+
+	if (xid < FirstNormalTransactionId)
+		return (xid != InvalidTransactionId);
+	/* wrap-around aware comparison, as TransactionIdPrecedes() */
+	if ((cl_int)(xid - snap->xid_base) < 0)
+		return true;
+	if ((cl_int)(xid - snap->xmax) >= 0)
+		return false;
+	if ((cl_int)(xid - snap->xmin) >= 0)
+	{
+		xip = KERN_MVCC_SNAPSHOT_XIP(snap);
+		head = 0;
+		tail = snap->nxip;
+		while (head < tail)
+		{
+			cl_uint		curr = (head + tail) / 2;
+
+			if (xip[curr] == xid)
+				return false;
+			if ((cl_int)(xip[curr] - xid) < 0)
+				head = curr + 1;
+			else
+				tail = curr;
+		}
+	}
+	pos = xid - snap->xid_base;
+	return (snap->values[pos >> 5] & (1U << (pos & 31))) != 0;
+}
+
+/*
+ * kern_mvcc_check_visibility
+ *
+ * An equivalent of HeapTupleSatisfiesMVCC() for the tuples that are not
+ * inserted/deleted by the current transaction. It returns 1 if visible,
+ * 0 if invisible, or -1 if the tuple needs to be checked by CPU (MultiXact
+ * in xmax, or pre-9.0 VACUUM FULL).
+ */
+STATIC_INLINE(cl_int)
+kern_mvcc_check_visibility(const kern_mvcc_snapshot *snap,
+						   const HeapTupleHeaderData *htup)
+{
+	cl_ushort	infomask = htup->t_infomask;
+	TransactionId xmin = htup->t_choice.t_heap.t_xmin;
+	TransactionId xmax = htup->t_choice.t_heap.t_xmax;
+
+	if ((infomask & (HEAP_MOVED_OFF | HEAP_MOVED_IN)) != 0)
+		return -1;
+	/* check xmin */
+	if ((infomask & (HEAP_XMIN_COMMITTED |
+					 HEAP_XMIN_INVALID)) == HEAP_XMIN_INVALID)
+		return 0;		/* aborted inserter */
+	if ((infomask & HEAP_XMIN_INVALID) == 0 &&
+		!kern_mvcc_xid_is_visible(snap, xmin))
+		return 0;		/* inserter is not visible */
+	/* check xmax */
+	if ((infomask & HEAP_XMAX_INVALID) != 0 ||
+		xmax == InvalidTransactionId)
+		return 1;
+	if ((infomask & HEAP_XMAX_LOCK_ONLY) != 0 ||
+		(infomask & (HEAP_XMAX_IS_MULTI |
+					 HEAP_XMAX_EXCL_LOCK |
+					 HEAP_XMAX_KEYSHR_LOCK)) == HEAP_XMAX_EXCL_LOCK)
+		return 1;		/* locker only */
+	if ((infomask & HEAP_XMAX_IS_MULTI) != 0)
+		return -1;
+	return (kern_mvcc_xid_is_visible(snap, xmax) ? 0 : 1);
+}
+
 #ifdef __CUDACC__
 /* definitions at storage/itemid.h */
 typedef struct ItemIdData
@@ -1417,6 +1523,18 @@ typedef struct toast_compress_header
 	(((char *) (ptr)) + TOAST_COMPRESS_HDRSZ)
 #define TOAST_COMPRESS_SET_RAWSIZE(ptr, len)	\
 	(((toast_compress_header *) (ptr))->rawsize = (len))
+/*
+ * PG14 saves the compression method on the upper 2 bits of the rawsize;
+ * it is always zero (= pglz) on the older versions.
+ */
+#define VARLENA_EXTSIZE_BITS		30
+#define VARLENA_EXTSIZE_MASK		((1U << VARLENA_EXTSIZE_BITS) - 1)
+#define TOAST_PGLZ_COMPRESSION_ID	0
+#define TOAST_LZ4_COMPRESSION_ID	1
+#define TOAST_COMPRESS_EXTSIZE(ptr)				\
+	((cl_uint)TOAST_COMPRESS_RAWSIZE(ptr) & VARLENA_EXTSIZE_MASK)
+#define TOAST_COMPRESS_METHOD(ptr)				\
+	((cl_uint)TOAST_COMPRESS_RAWSIZE(ptr) >> VARLENA_EXTSIZE_BITS)
 
 /* basic varlena macros */
 #define VARATT_IS_4B(PTR) \
@@ -1755,9 +1873,14 @@ toast_raw_datum_size(kern_context *kcxt, varlena *attr);
 DEVICE_FUNCTION(cl_int)
 pglz_decompress(const char *source, cl_int slen,
 				char *dest, cl_int rawsize);
+DEVICE_FUNCTION(cl_int)
+lz4_decompress(const char *source, cl_int slen,
+			   char *dest, cl_int rawsize);
 DEVICE_FUNCTION(cl_bool)
 toast_decompress_datum(char *buffer, cl_uint buflen,
 					   const varlena *datum);
+DEVICE_FUNCTION(varlena *)
+pg_varlena_decompress(kern_context *kcxt, varlena *datum);
 /*
  * device functions to reference a particular datum in a tuple
  */
@@ -142,6 +142,32 @@ kern_gpucache_init_empty(kern_data_store *kds,
 	}
 }
 
+/*
+ * kern_gpucache_expand_rowmap
+ *
+ * It links the rowid newly added by expansion of the main buffer, from
+ * @old_nrooms to kds->nrooms, to the head of the freelist. The host code
+ * updates rowhash->freelist[] and rowhash->nrooms after this kernel.
+ */
+KERNEL_FUNCTION(void)
+kern_gpucache_expand_rowmap(kern_data_store *kds, cl_uint old_nrooms)
+{
+	DECL_ROWID_HASH_AND_MAP(kds);
+	cl_uint		index;
+	cl_uint		nrooms = kds->nrooms;
+
+	for (index = old_nrooms + get_global_id();
+		 index < nrooms;
+		 index += get_global_size())
+	{
+		if (index + KERN_GPUCACHE_FREE_WIDTH < nrooms)
+			rowmap[index] = index + KERN_GPUCACHE_FREE_WIDTH;
+		else
+			rowmap[index] = rowhash->freelist[(index - old_nrooms) %
+											  KERN_GPUCACHE_FREE_WIDTH];
+	}
+}
+
 /*
  * gpucache_ctid_hash
  */
@@ -407,7 +433,7 @@ gpucache_alloc_rowid(kern_context *kcxt,
 											 &i_log->rowid_found))
 					{
 						if (i_log->rowid == UINT_MAX)
-							STROM_EREPORT(kcxt, ERRCODE_INVALID_NAME,
+							STROM_EREPORT(kcxt, ERRCODE_STROM_DATASTORE_NOSPACE,
 										  "no more rowid allocatable");
 						try_again = false;
 					}
@@ -422,7 +448,7 @@ gpucache_alloc_rowid(kern_context *kcxt,
 											 &d_log->rowid_found))
 					{
 						if (d_log->rowid == UINT_MAX)
-							STROM_EREPORT(kcxt, ERRCODE_INVALID_NAME,
+							STROM_EREPORT(kcxt, ERRCODE_STROM_DATASTORE_NOSPACE,
 										  "no more rowid allocatable");
 						try_again = false;
 					}
@@ -437,7 +463,7 @@ gpucache_alloc_rowid(kern_context *kcxt,
 											 &x_log->rowid_found))
 					{
 						if (x_log->rowid == UINT_MAX)
-							STROM_EREPORT(kcxt, ERRCODE_INVALID_NAME,
+							STROM_EREPORT(kcxt, ERRCODE_STROM_DATASTORE_NOSPACE,
 										  "no more rowid allocatable");
 						try_again = false;
 					}
@@ -600,12 +626,131 @@ gpucache_apply_redo(kern_context *kcxt,
 	}
 }
 
+/*
+ * gpucache_setup_sort_keys
+ *
+ * It sets up the sort keys of INS/DEL log entries; (rowid << 32 | owner_id).
+ * Once sorted by kern_gpucache_sort_redo(), the last entry of the same rowid
+ * is the one with the largest owner_id, and adjacent threads update adjacent
+ * rows of the column arrays.
+ */
+STATIC_FUNCTION(void)
+gpucache_setup_sort_keys(kern_context *kcxt,
+						 kern_gpucache_redolog *redo,
+						 cl_ulong *sort_keys,
+						 cl_uint nkeys)
+{
+	cl_uint		owner_id;
+
+	for (owner_id = get_global_id();
+		 owner_id < nkeys;
+		 owner_id += get_global_size())
+	{
+		GCacheTxLogCommon *tx_log;
+		cl_ulong	key = ULONG_MAX;
+
+		if (owner_id < redo->nitems)
+		{
+			tx_log = (GCacheTxLogCommon *)
+				((char *)redo + __kds_unpack(redo->log_index[owner_id]));
+			if (tx_log->type == GCACHE_TX_LOG__INSERT)
+				key = ((cl_ulong)((GCacheTxLogInsert *)tx_log)->rowid << 32 |
+					   (cl_ulong)owner_id);
+			else if (tx_log->type == GCACHE_TX_LOG__DELETE)
+				key = ((cl_ulong)((GCacheTxLogDelete *)tx_log)->rowid << 32 |
+					   (cl_ulong)owner_id);
+		}
+		sort_keys[owner_id] = key;
+	}
+}
+
+/*
+ * gpucache_apply_redo_sorted
+ *
+ * It applies INS/DEL log entries in order of the sorted rowid; only the last
+ * entry for each rowid is applied.
+ */
+STATIC_FUNCTION(void)
+gpucache_apply_redo_sorted(kern_context *kcxt,
+						   kern_gpucache_redolog *redo,
+						   kern_data_store *kds,
+						   kern_data_extra *extra,
+						   cl_ulong *sort_keys,
+						   cl_uint nkeys)
+{
+	cl_uint		index;
+
+	for (index = get_global_id();
+		 index < nkeys;
+		 index += get_global_size())
+	{
+		GCacheTxLogCommon *tx_log;
+		GpuCacheSysattr *sysattr;
+		cl_ulong	key = sort_keys[index];
+		cl_uint		rowid = (cl_uint)(key >> 32);
+		cl_uint		owner_id = (cl_uint)(key & 0xffffffffU);
+
+		if (key == ULONG_MAX)
+			continue;
+		if (index + 1 < nkeys && (cl_uint)(sort_keys[index+1] >> 32) == rowid)
+			continue;	/* overwritten by the later log entry */
+		assert(rowid < kds->nrooms && owner_id < redo->nitems);
+		sysattr = kds_get_column_sysattr(kds, rowid);
+		tx_log = (GCacheTxLogCommon *)
+			((char *)redo + __kds_unpack(redo->log_index[owner_id]));
+		if (tx_log->type == GCACHE_TX_LOG__INSERT)
+		{
+			GCacheTxLogInsert *i_log = (GCacheTxLogInsert *)tx_log;
+
+			gpucache_apply_insert(kcxt, kds, extra, sysattr,
+								  rowid, &i_log->htup);
+		}
+		else
+		{
+			GCacheTxLogDelete *d_log = (GCacheTxLogDelete *)tx_log;
+
+			assert(tx_log->type == GCACHE_TX_LOG__DELETE);
+			sysattr->xmax = d_log->xid;
+		}
+	}
+}
+
+/*
+ * kern_gpucache_sort_redo
+ *
+ * A step of bitonic-sorting on the sort keys; host code launches this kernel
+ * for each (k,j) pair on the @nkeys (power of 2) keys.
+ */
+KERNEL_FUNCTION(void)
+kern_gpucache_sort_redo(cl_ulong *sort_keys,
+						cl_uint nkeys,
+						cl_uint k,
+						cl_uint j)
+{
+	cl_uint		i;
+
+	for (i = get_global_id(); i < nkeys / 2; i += get_global_size())
+	{
+		cl_uint		x = 2 * j * (i / j) + (i % j);
+		cl_uint		y = x + j;
+		cl_ulong	x_key = sort_keys[x];
+		cl_ulong	y_key = sort_keys[y];
+
+		if ((x & k) == 0 ? x_key > y_key : x_key < y_key)
+		{
+			sort_keys[x] = y_key;
+			sort_keys[y] = x_key;
+		}
+	}
+}
+
 /*
  * __gpucache_release_rowid
  */
 STATIC_FUNCTION(cl_bool)
 __gpucache_release_rowid(kern_data_store *kds,
-						 GCacheTxLogXact *x_log)
+						 ItemPointerData *t_ctid,
+						 cl_uint __rowid)
 {
 	DECL_ROWID_HASH_AND_MAP(kds);
 	GpuCacheSysattr *sysattr;
@@ -617,7 +762,7 @@ __gpucache_release_rowid(kern_data_store *kds,
 	volatile cl_uint *prev;
 
 	/* lock and lookup the hash-slot */
-	hindex = gpucache_ctid_hash(&x_log->ctid) % rowhash->nslots;
+	hindex = gpucache_ctid_hash(t_ctid) % rowhash->nslots;
 	if (atomicCAS(&rowhash->slots[hindex].lock,
 				  UINT_MAX,
 				  get_global_id()) != UINT_MAX)
@@ -629,9 +774,9 @@ __gpucache_release_rowid(kern_data_store *kds,
 	{
 		assert(rowid < rowhash->nrooms);
 		sysattr = kds_get_column_sysattr(kds, rowid);
-		if (ItemPointerEquals(&sysattr->ctid, &x_log->ctid))
+		if (ItemPointerEquals(&sysattr->ctid, t_ctid))
 		{
-			assert(rowid == x_log->rowid);
+			assert(rowid == __rowid);
 			/* detach rowid from the hash table */
 			next = __volatileRead(&rowmap[rowid]);
 			assert(next == UINT_MAX || next < rowhash->nrooms);
@@ -648,18 +793,18 @@ __gpucache_release_rowid(kern_data_store *kds,
 #ifdef PGSTROM_DEBUG_BUILD
 			printf("__gpucache: rowid=%u ctid=(%u,%u) released\n",
 				   rowid,
-				   (cl_uint)x_log->ctid.ip_blkid.bi_hi << 16 |
-				   (cl_uint)x_log->ctid.ip_blkid.bi_lo,
-				   (cl_uint)x_log->ctid.ip_posid);
+				   (cl_uint)t_ctid->ip_blkid.bi_hi << 16 |
+				   (cl_uint)t_ctid->ip_blkid.bi_lo,
+				   (cl_uint)t_ctid->ip_posid);
 #endif
 			goto out_unlock;
 		}
 	}
 	printf("__gpucache_release_rowid: rowid=%u ctid=(%u,%u) not found\n",
-		   x_log->rowid,
-		   (cl_uint)x_log->ctid.ip_blkid.bi_hi << 16 |
-		   (cl_uint)x_log->ctid.ip_blkid.bi_lo,
-		   (cl_uint)x_log->ctid.ip_posid);
+		   __rowid,
+		   (cl_uint)t_ctid->ip_blkid.bi_hi << 16 |
+		   (cl_uint)t_ctid->ip_blkid.bi_lo,
+		   (cl_uint)t_ctid->ip_posid);
 out_unlock:
 	__threadfence();
 	lval = atomicExch(&rowhash->slots[hindex].lock, UINT_MAX);
@@ -708,7 +853,8 @@ gpucache_apply_xact(kern_context *kcxt,
 					{
 						if (sysattr->owner_id == owner_id)
 						{
-							if (__gpucache_release_rowid(kds, x_log))
+							if (__gpucache_release_rowid(kds, &x_log->ctid,
+										     x_log->rowid))
 							{
 								sysattr->xmin = InvalidTransactionId;
 								sysattr->xmax = InvalidTransactionId;
@@ -756,9 +902,11 @@ KERNEL_FUNCTION(void)
 kern_gpucache_apply_redo(kern_gpucache_redolog *redo,
 						 kern_data_store *kds,
 						 kern_data_extra *extra,
+						 cl_ulong *sort_keys,
 						 int phase)
 {
 	kern_context kcxt;
+	cl_uint		nkeys = (1U << get_next_log2(redo->nitems));
 
 	/* bailout if any errors */
 	if (__syncthreads_count(redo->kerror.errcode) > 0)
@@ -774,10 +922,17 @@ kern_gpucache_apply_redo(kern_gpucache_redolog *redo,
 			gpucache_cleanup_owner(&kcxt, redo, kds);
 			break;
 		case 2:		/* assign the largest owner_id of INS/DEL log entries */
-			gpucache_setup_owner(&kcxt, redo, kds, true);
+			if (sort_keys)
+				gpucache_setup_sort_keys(&kcxt, redo, sort_keys, nkeys);
+			else
+				gpucache_setup_owner(&kcxt, redo, kds, true);
 			break;
 		case 3:		/* apply INS/DEL log entries */
-			gpucache_apply_redo(&kcxt, redo, kds, extra);
+			if (sort_keys)
+				gpucache_apply_redo_sorted(&kcxt, redo, kds, extra,
+										   sort_keys, nkeys);
+			else
+				gpucache_apply_redo(&kcxt, redo, kds, extra);
 			break;
 		case 4:		/* assign the largest owner_id of XACT log entries */
 			gpucache_setup_owner(&kcxt, redo, kds, false);
@@ -792,15 +947,54 @@ kern_gpucache_apply_redo(kern_gpucache_redolog *redo,
 	kern_writeback_error_status(&redo->kerror, &kcxt);
 }
 
+/*
+ * kern_gpucache_compaction
+ *
+ * It copies the varlena values in use to the new extra buffer. If @new_values
+ * is not NULL, the new offsets are written to this shadow array (nitems
+ * entries per varlena column), instead of the main buffer, so concurrent
+ * readers can continue to reference the old extra buffer during the copy.
+ * kern_gpucache_compaction_commit() applies them on the main buffer later.
+ *
+ * If @dict_slots is not NULL, it works as a dictionary of the varlena values
+ * already copied to the new extra buffer (open addressing by the hash value
+ * of the varlena image), then identical values share the same location.
+ * Values are never modified once written to the extra buffer, so it is safe
+ * to share them. Low-cardinality text columns consume much less device memory.
+ */
+#define GPUCACHE_DICT_MAX_PROBES		8
+
+/*
+ * gpucache_varlena_hash - FNV-1a hash of the varlena image
+ *
+ * Note that cuda_gcache.fatbin is built without relocatable device code,
+ * so pg_hash_any() in cuda_common.cu is not available here.
+ */
+STATIC_INLINE(cl_uint)
+gpucache_varlena_hash(const char *addr, cl_uint sz)
+{
+	cl_uint		hash = 0x811c9dc5U;
+
+	for (cl_uint i=0; i < sz; i++)
+	{
+		hash ^= (cl_uchar)addr[i];
+		hash *= 0x01000193U;
+	}
+	return hash;
+}
+
 KERNEL_FUNCTION(void)
 kern_gpucache_compaction(kern_data_store *kds,
 						 kern_data_extra *old_extra,
-						 kern_data_extra *new_extra)
+						 kern_data_extra *new_extra,
+						 cl_uint *new_values,
+						 cl_uint *dict_slots,
+						 cl_uint dict_nslots)
 {
-	
 	__shared__ cl_uint required;
 	__shared__ cl_ulong extra_base;
 	cl_uint		nloops;
+	cl_uint		vl_index = 0;
 
 	nloops = (kds->nitems + get_global_size() - 1) / get_global_size();
 	for (int j=0; j < kds->ncols; j++)
@@ -818,6 +1012,8 @@ kern_gpucache_compaction(kern_data_store *kds,
 			char	   *orig = NULL;
 			char	   *dest;
 			cl_uint		sz, l_off = 0;
+			cl_uint		dict_index = UINT_MAX;
+			cl_uint		dict_off = 0;
 
 			sysattr = kds_get_column_sysattr(kds, rowid);
 			if (rowid >= kds->nitems)
@@ -832,18 +1028,50 @@ kern_gpucache_compaction(kern_data_store *kds,
 				if ((nullmap[rowid>>5] & (1U << (rowid & 0x1f))) == 0)
 					isnull = true;
 			}
-			values = (cl_uint *)((char *)kds + __kds_unpack(cmeta->values_offset));
+			if (new_values)
+				values = new_values + (size_t)vl_index * kds->nitems;
+			else
+				values = (cl_uint *)((char *)kds + __kds_unpack(cmeta->values_offset));
 			/* copy the varlena to new extra buffer */
 			if (get_local_id() == 0)
 				required = 0;
 			__syncthreads();
 			if (!isnull)
 			{
-				orig = (char *)old_extra + __kds_unpack(values[rowid]);
+				cl_uint	   *curr_values = (cl_uint *)
+					((char *)kds + __kds_unpack(cmeta->values_offset));
+
+				orig = (char *)old_extra + __kds_unpack(curr_values[rowid]);
 				sz = VARSIZE_ANY(orig);
 				assert(orig > (char *)old_extra &&
 					   orig + sz <= (char *)old_extra + old_extra->length);
-				l_off = atomicAdd(&required, MAXALIGN(sz));
+				/* lookup the dictionary, unless estimation */
+				if (dict_slots && new_extra->length > 0)
+				{
+					cl_uint		hash = gpucache_varlena_hash(orig, sz);
+
+					for (int k=0; k < GPUCACHE_DICT_MAX_PROBES; k++)
+					{
+						cl_uint		i = (hash + k) % dict_nslots;
+						cl_uint		off = __volatileRead(&dict_slots[i]);
+						char	   *cand;
+
+						if (off == 0)
+						{
+							dict_index = i;
+							break;
+						}
+						cand = (char *)new_extra + __kds_unpack(off);
+						if (VARSIZE_ANY(cand) == sz &&
+							__memcmp(cand, orig, sz) == 0)
+						{
+							dict_off = off;
+							break;
+						}
+					}
+				}
+				if (dict_off == 0)
+					l_off = atomicAdd(&required, MAXALIGN(sz));
 			}
 			__syncthreads();
 			if (get_local_id() == 0)
@@ -855,15 +1083,198 @@ kern_gpucache_compaction(kern_data_store *kds,
 				if (rowid < kds->nitems)
 					values[rowid] = 0;
 			}
+			else if (dict_off != 0)
+			{
+				values[rowid] = dict_off;
+			}
 			else if (dest + sz <= (char *)new_extra + new_extra->length)
 			{
+				cl_uint		off = __kds_packed((char *)dest - (char *)new_extra);
+
 				memcpy(dest, orig, sz);
-				values[rowid] = __kds_packed((char *)dest - (char *)new_extra);
+				values[rowid] = off;
+				/* register the value; someone else may win, it is harmless */
+				if (dict_index != UINT_MAX)
+				{
+					__threadfence();
+					atomicCAS(&dict_slots[dict_index], 0, off);
+				}
 			}
 			else
 			{
 				assert(new_extra->length == 0);
 			}
 		}
+		vl_index++;
+	}
+}
+
+/*
+ * kern_gpucache_compaction_commit
+ *
+ * It writes back the new offsets built by kern_gpucache_compaction() on the
+ * shadow array to the main buffer. Caller must block the concurrent readers.
+ */
+KERNEL_FUNCTION(void)
+kern_gpucache_compaction_commit(kern_data_store *kds,
+								cl_uint *new_values)
+{
+	cl_uint		vl_index = 0;
+
+	for (int j=0; j < kds->ncols; j++)
+	{
+		kern_colmeta *cmeta = &kds->colmeta[j];
+		cl_uint	   *values;
+		cl_uint	   *shadow;
+
+		if (cmeta->attbyval || cmeta->attlen != -1)
+			continue;		/* not varlena */
+		values = (cl_uint *)((char *)kds + __kds_unpack(cmeta->values_offset));
+		shadow = new_values + (size_t)vl_index * kds->nitems;
+		for (cl_uint rowid = get_global_id();
+			 rowid < kds->nitems;
+			 rowid += get_global_size())
+		{
+			values[rowid] = shadow[rowid];
+		}
+		vl_index++;
+	}
+}
+
+/*
+ * kern_gpucache_build_colindex
+ *
+ * It (re-)builds the hash index on the column @colidx. Host code launches
+ * this kernel 4 times with @phase = 0..3; (0) init the header and slots,
+ * (1) count the number of rows per slot, (2) assign the range of rowids[]
+ * for each slot, then (3) write out the rowids.
+ */
+KERNEL_FUNCTION(void)
+kern_gpucache_build_colindex(kern_data_store *kds,
+							 cl_uint colidx,
+							 cl_uint nslots,
+							 cl_int phase)
+{
+	kern_gpucache_colindex *colindex = kds_get_gpucache_colindex(kds);
+	cl_uint	   *rowids = (cl_uint *)&colindex->slots[nslots];
+	kern_colmeta *cmeta = &kds->colmeta[colidx];
+	cl_uint		index;
+
+	assert(cmeta->attbyval && cmeta->attlen > 0 &&
+		   cmeta->attlen <= sizeof(cl_ulong));
+	if (phase == 0)
+	{
+		if (get_global_id() == 0)
+		{
+			colindex->magic  = KERN_GPUCACHE_COLINDEX_MAGIC;
+			colindex->colidx = colidx;
+			colindex->nslots = nslots;
+			colindex->nitems = 0;
+		}
+		for (index = get_global_id(); index < nslots; index += get_global_size())
+		{
+			colindex->slots[index].start = 0;
+			colindex->slots[index].count = 0;
+		}
+	}
+	else if (phase == 1 || phase == 3)
+	{
+		char	   *values = (char *)kds + __kds_unpack(cmeta->values_offset);
+		cl_uint	   *nullmap = NULL;
+
+		if (cmeta->nullmap_offset != 0)
+			nullmap = (cl_uint *)((char *)kds + __kds_unpack(cmeta->nullmap_offset));
+		for (index = get_global_id();
+			 index < kds->nitems;
+			 index += get_global_size())
+		{
+			GpuCacheSysattr *sysattr = kds_get_column_sysattr(kds, index);
+			cl_ulong	key = 0;
+			cl_uint		hindex;
+
+			if (sysattr->xmin == InvalidTransactionId ||
+				sysattr->xmax == FrozenTransactionId)
+				continue;		/* row is already removed */
+			if (nullmap && (nullmap[index>>5] & (1U << (index & 0x1f))) == 0)
+				continue;		/* NULL is never indexed */
+			memcpy(&key, values + (size_t)cmeta->attlen * index, cmeta->attlen);
+			hindex = gpucache_colindex_hash(key) % nslots;
+			if (phase == 1)
+				atomicAdd(&colindex->slots[hindex].count, 1);
+			else
+			{
+				cl_uint		pos = atomicSub(&colindex->slots[hindex].start, 1) - 1;
+
+				rowids[pos] = index;
+			}
+		}
+	}
+	else if (phase == 2)
+	{
+		for (index = get_global_id(); index < nslots; index += get_global_size())
+		{
+			cl_uint		count = colindex->slots[index].count;
+
+			if (count > 0)
+				colindex->slots[index].start
+					= atomicAdd(&colindex->nitems, count) + count;
+		}
+	}
+}
+
+/*
+ * kern_gpucache_evict_window
+ *
+ * It releases the committed rows whose value of the column @colidx is older
+ * than @threshold (or NULL), for the GPU cache configured with the
+ * 'cache_window' option. @threshold is a raw DateADT value if @attlen == 4,
+ * elsewhere, raw Timestamp(Tz) value.
+ */
+KERNEL_FUNCTION(void)
+kern_gpucache_evict_window(kern_data_store *kds,
+						   cl_uint colidx,
+						   cl_long threshold)
+{
+	kern_colmeta *cmeta = &kds->colmeta[colidx];
+	char	   *values = (char *)kds + __kds_unpack(cmeta->values_offset);
+	cl_uint	   *nullmap = NULL;
+	cl_uint		nloops;
+
+	assert(cmeta->attbyval && (cmeta->attlen == sizeof(cl_int) ||
+							   cmeta->attlen == sizeof(cl_long)));
+	if (cmeta->nullmap_offset != 0)
+		nullmap = (cl_uint *)((char *)kds + __kds_unpack(cmeta->nullmap_offset));
+	nloops = (kds->nitems + get_global_size() - 1) / get_global_size();
+	for (int loop=0; loop < nloops; loop++)
+	{
+		cl_uint		rowid = loop * get_global_size() + get_global_id();
+		GpuCacheSysattr *sysattr = NULL;
+		cl_bool		try_again = false;
+
+		if (rowid < kds->nitems)
+		{
+			sysattr = kds_get_column_sysattr(kds, rowid);
+			/* only committed and not deleted rows */
+			if (sysattr->xmin == FrozenTransactionId &&
+				sysattr->xmax == InvalidTransactionId)
+			{
+				if (nullmap && (nullmap[rowid>>5] & (1U << (rowid & 0x1f))) == 0)
+					try_again = true;
+				else if (cmeta->attlen == sizeof(cl_int))
+					try_again = (((cl_int *)values)[rowid] < threshold);
+				else
+					try_again = (((cl_long *)values)[rowid] < threshold);
+			}
+		}
+
+		do {
+			if (try_again &&
+				__gpucache_release_rowid(kds, &sysattr->ctid, rowid))
+			{
+				sysattr->xmin = InvalidTransactionId;
+				sysattr->xmax = InvalidTransactionId;
+				try_again = false;
+			}
+		} while (__syncthreads_count(try_again) != 0);
 	}
 }
@@ -16,6 +16,8 @@
 #define GCACHE_TX_LOG__INSERT		(GCACHE_TX_LOG__MAGIC | 'I')
 #define GCACHE_TX_LOG__DELETE		(GCACHE_TX_LOG__MAGIC | 'D')
 #define GCACHE_TX_LOG__XACT			(GCACHE_TX_LOG__MAGIC | 'X')
+/* fill up the tail of REDO log buffer; never sent to GPU */
+#define GCACHE_TX_LOG__PADDING		(GCACHE_TX_LOG__MAGIC | 'P')
 
 typedef struct {
 	cl_uint		type;
@@ -53,6 +55,28 @@ typedef struct {
 	ItemPointerData ctid;
 } GCacheTxLogXact;
 
+/*
+ * GpuCacheIpcHandle
+ *
+ * An identifier of the GPU cache returned by pgstrom.gpucache_export_ipchandle()
+ * in bytea form. External applications (like pystrom) open the main buffer
+ * using @main_mhandle, then reference the fixed-length columns with no copy.
+ * The main buffer is kept until the GPU cache is dropped or reloaded; it
+ * assigns a new @generation.
+ */
+#define GPUCACHE_IPC_HANDLE_MAGIC	0x47435049	/* "GCPI" */
+#define GPUCACHE_IPC_HANDLE_SIZE	64			/* = CU_IPC_HANDLE_SIZE */
+
+typedef struct {
+	cl_int		vl_len_;		/* varlena header (do not touch directly!) */
+	cl_uint		magic;			/* = GPUCACHE_IPC_HANDLE_MAGIC */
+	cl_int		device_id;		/* CUDA device ordinal of the GPU cache */
+	cl_uint		table_oid;		/* OID of the table */
+	cl_ulong	generation;		/* generation of the GPU cache */
+	cl_ulong	main_size;		/* length of the main buffer */
+	char		main_mhandle[GPUCACHE_IPC_HANDLE_SIZE];
+} GpuCacheIpcHandle;
+
 /*
  * GpuCacheSysattr
  *
@@ -234,6 +258,54 @@ typedef struct
 	 */
 } kern_gpucache_rowhash;
 
+/*
+ * kern_gpucache_colindex
+ *
+ * Device-resident hash index on a fixed-length column, configured by the
+ * 'index_column' option. It is located next to the rowid link list on the
+ * main buffer, and rebuilt by the bgworker after application of REDO logs.
+ * Rows whose key has the same hash value are stored contiguously from
+ * rowids[slots[hindex].start], so an equality lookup gives a list of
+ * candidate rows; scan re-checks the qualifiers on the candidates.
+ */
+#define KERN_GPUCACHE_COLINDEX_MAGIC	0xc01dca5eU
+typedef struct
+{
+	cl_uint		magic;		/* =KERN_GPUCACHE_COLINDEX_MAGIC */
+	cl_uint		colidx;		/* index of the indexed column */
+	cl_uint		nslots;
+	cl_uint		nitems;		/* # of indexed rows */
+	struct {
+		cl_uint	start;
+		cl_uint	count;
+	} slots[1];
+	/*
+	 * Note that:
+	 * ((cl_uint *)&colindex->slots[nslots]) is an array of rowid
+	 */
+} kern_gpucache_colindex;
+
+STATIC_INLINE(kern_gpucache_colindex *)
+kds_get_gpucache_colindex(kern_data_store *kds)
+{
+	kern_gpucache_rowhash *rowhash = (kern_gpucache_rowhash *)
+		((char *)kds + kds->length);
+	char	   *pos = ((char *)&rowhash->slots[kds->nslots] +
+					   sizeof(cl_uint) * kds->nrooms);
+	return (kern_gpucache_colindex *)MAXALIGN(pos);
+}
+
+/*
+ * gpucache_colindex_hash
+ *
+ * @key is the value of the indexed column; zero-extended to 64bit.
+ */
+STATIC_INLINE(cl_uint)
+gpucache_colindex_hash(cl_ulong key)
+{
+	return (cl_uint)((key * 0x9e3779b97f4a7c13UL) >> 32);
+}
+
 /*
  * kern_gpucache_redolog
  */
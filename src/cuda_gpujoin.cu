@@ -1019,6 +1019,13 @@ gpujoin_exec_hashjoin(kern_context *kcxt,
 
 		/* pick up next one if any */
 		khitem = KERN_HASH_NEXT_ITEM(kds_hash, khitem);
+		/*
+		 * If items with same hash value are adjacent, no more matched
+		 * items on the remaining hash chain.
+		 */
+		if (khitem && khitem->hash != hash_value &&
+			kmrels->chunks[depth-1].hash_grouped)
+			khitem = NULL;
 	}
 
 	while (khitem && khitem->hash != hash_value)
@@ -1050,12 +1057,32 @@ gpujoin_exec_hashjoin(kern_context *kcxt,
 		}
 		t_offset = __kds_packed((char *)&khitem->t.htup -
 								(char *)kds_hash);
+
+		if (KERN_MULTIRELS_SEMI_JOIN(kmrels, depth) ||
+			KERN_MULTIRELS_ANTI_JOIN(kmrels, depth))
+		{
+			/*
+			 * SEMI JOIN emits the outer row only at the first match, and
+			 * ANTI JOIN never emits the outer row once it matched. So, we
+			 * don't need to walk on the remaining hash-chain any more.
+			 * Inner row is never referenced by the later depth.
+			 */
+			if (joinquals_matched)
+			{
+				result = KERN_MULTIRELS_SEMI_JOIN(kmrels, depth);
+				khitem = NULL;
+				t_offset = UINT_MAX;
+			}
+			else
+				result = false;
+		}
 	}
-	else if (KERN_MULTIRELS_LEFT_OUTER_JOIN(kmrels, depth) &&
+	else if ((KERN_MULTIRELS_LEFT_OUTER_JOIN(kmrels, depth) ||
+			  KERN_MULTIRELS_ANTI_JOIN(kmrels, depth)) &&
 			 l_state[depth] != UINT_MAX &&
 			 !matched[depth])
 	{
-		/* No matched outer rows, but LEFT/FULL OUTER */
+		/* No matched outer rows, but LEFT/FULL OUTER or ANTI */
 		result = true;
 	}
 	else
@@ -1169,6 +1196,12 @@ gpujoin_prep_gistindex(kern_multirels *kmrels, int depth)
 
 /*
  * gpujoin_gist_getnext
+ *
+ * A warp walks on the GiST-index for an index-key. Threads in the warp
+ * evaluate the entries of a tree node in lockstep, warpSize entries at
+ * once, then dive into the deeper node as soon as any of them matched.
+ * It prevents the threads that get matched early from waiting for the
+ * others that scan the rest of the node unnecessarily.
  */
 STATIC_INLINE(ItemPointerData *)
 gpujoin_gist_getnext(kern_context *kcxt,
@@ -1182,8 +1215,10 @@ gpujoin_gist_getnext(kern_context *kcxt,
 	PageHeaderData *gist_page;
 	cl_char		   *vlpos_saved = kcxt->vlpos;
 	OffsetNumber	start;
+	OffsetNumber	base;
 	OffsetNumber	index;
 	OffsetNumber	maxoff;
+	cl_uint			mask;
 	ItemIdData	   *lpp = NULL;
 	IndexTupleData *itup = NULL;
 	cl_bool			rv = false;
@@ -1226,25 +1261,32 @@ restart:
 	else
 		maxoff = PageGetMaxOffsetNumber(gist_page);
 
+	/* 'start' is always (base + LaneId()), and 'base' is warp uniform */
+	base = start - LaneId();
+	assert(base == __shfl_sync(__activemask(), base, 0));
 	rv = false;
-	for (index=start; index <= maxoff; index += warpSize)
+	mask = 0;
+	for (; base <= maxoff; base += warpSize)
 	{
+		index = base + LaneId();
 		lpp = PageGetItemId(gist_page, index);
-		if (ItemIdIsDead(lpp))
-			continue;
-		itup = (IndexTupleData *) PageGetItem(gist_page, lpp);
+		if (index <= maxoff && !ItemIdIsDead(lpp))
+		{
+			itup = (IndexTupleData *) PageGetItem(gist_page, lpp);
 
-		kcxt->vlpos = vlpos_saved;		/* rewind */
-		rv = gpujoin_gist_index_quals(kcxt, depth,
-									  kds_gist, gist_page,
-									  itup, gist_keys);
-		if (rv)
+			kcxt->vlpos = vlpos_saved;		/* rewind */
+			rv = gpujoin_gist_index_quals(kcxt, depth,
+										  kds_gist, gist_page,
+										  itup, gist_keys);
+		}
+		mask = __ballot_sync(__activemask(), rv);
+		if (mask != 0)
 			break;
 	}
 	kcxt->vlpos = vlpos_saved;		/* rewind */
 
 	assert(__activemask() == ~0U);
-	if (__any_sync(__activemask(), rv))
+	if (mask != 0)
 	{
 		/* By here, one or more threads meet the matched entry */
 		if (!GistPageIsLeaf(gist_page))
@@ -1253,15 +1295,8 @@ restart:
 			BlockNumber		blkno_curr;
 			BlockNumber		blkno_next;
 			PageHeaderData *gist_next;
-			OffsetNumber	least_index = (rv ? index : UINT_MAX);
-			OffsetNumber	buddy_index;
+			OffsetNumber	least_index = base + __ffs(mask) - 1;
 
-			for (int mask=1; mask <= 16; mask *= 2)
-			{
-				buddy_index = __shfl_xor_sync(__activemask(), least_index, mask);
-				least_index = Min(least_index, buddy_index);
-			}
-			__syncwarp(~0U);
 			assert(least_index <= maxoff);
 
 			lpp = PageGetItemId(gist_page, least_index);
@@ -1278,24 +1313,16 @@ restart:
 			goto restart;
 		}
 
-		/* this is matched */
-		if (rv)
-		{
-			assert((char *)lpp >= (char *)gist_page &&
-				   (char *)lpp <  (char *)gist_page + BLCKSZ);
-			*p_item_offset = (cl_uint)((char *)lpp - (char *)kds_gist);
-
-			return &itup->t_tid;
-		}
-
 		/*
-		 * this is not matched - ensure the next call skips the main loop
-		 * above, we set next offset of the 'maxoff' onto the p_item_offset.
+		 * The next call resumes from the next warpSize entries, regardless
+		 * of whether this thread is matched or not, to keep the threads in
+		 * the warp on the same position.
 		 */
-		lpp = PageGetItemId(gist_page, maxoff+1);
+		assert((char *)lpp >= (char *)gist_page &&
+			   (char *)lpp <  (char *)gist_page + BLCKSZ);
 		*p_item_offset = (cl_uint)((char *)lpp - (char *)kds_gist);
 
-		return NULL;
+		return (rv ? &itup->t_tid : NULL);
 	}
 
 	/*
@@ -1319,8 +1346,139 @@ restart:
 	return NULL;
 }
 
+/*
+ * __gpujoin_grid_seek
+ *
+ * It returns the first item to be checked at or after @pos, and the end of
+ * the contiguous range that contains the item; a part of a row of the grid
+ * within [cx0...cx1], or the oversized items. Arguments are warp uniform.
+ */
+STATIC_INLINE(cl_uint)
+__gpujoin_grid_seek(kern_gpujoin_grid *grid, cl_uint pos,
+					cl_uint cx0, cl_uint cx1,
+					cl_uint cy0, cl_uint cy1,
+					cl_uint *p_tail)
+{
+	kern_gpujoin_grid_item *items = KERN_GPUJOIN_GRID_ITEMS(grid);
+	cl_uint		nx = grid->nx;
+	cl_uint		nregular = grid->cells[grid->nx * grid->ny];
+
+	while (pos < nregular)
+	{
+		cl_uint		cx = items[pos].cell % nx;
+		cl_uint		cy = items[pos].cell / nx;
+
+		if (cy > cy1)
+			break;
+		if (cy < cy0)
+			pos = grid->cells[cy0 * nx + cx0];
+		else if (cx < cx0)
+			pos = grid->cells[cy * nx + cx0];
+		else if (cx > cx1)
+		{
+			if (cy == cy1)
+				break;
+			pos = grid->cells[(cy + 1) * nx + cx0];
+		}
+		else
+		{
+			*p_tail = grid->cells[cy * nx + cx1 + 1];
+			return pos;
+		}
+	}
+	/* oversized items */
+	*p_tail = grid->nitems;
+	return Max(pos, nregular);
+}
+
+STATIC_INLINE(cl_uint)
+__gpujoin_grid_cell_index(cl_double pos, cl_double base, cl_double unit,
+						  cl_uint ncells)
+{
+	cl_double	index = floor((pos - base) / unit);
+
+	if (isnan(index) || index < 0.0)
+		return 0;
+	if (index >= (cl_double)ncells)
+		return ncells - 1;
+	return (cl_uint)index;
+}
+
+/*
+ * gpujoin_grid_getnext
+ *
+ * A warp walks on the grid-index for an index-key. Like gpujoin_gist_getnext,
+ * threads in the warp check warpSize items at once, then return as soon as
+ * any of them matched. *p_item_offset is 0 at the beginning, UINT_MAX at the
+ * end, or the index of the item to be checked next plus 1.
+ * It returns the offset of the matched inner tuple, or UINT_MAX.
+ */
+STATIC_FUNCTION(cl_uint)
+gpujoin_grid_getnext(kern_context *kcxt,
+					 kern_gpujoin_grid *grid,
+					 void *grid_keys,
+					 cl_uint *p_item_offset)
+{
+	kern_gpujoin_grid_key *key = (kern_gpujoin_grid_key *)grid_keys;
+	kern_gpujoin_grid_item *items = KERN_GPUJOIN_GRID_ITEMS(grid);
+	cl_uint		cx0, cx1, cy0, cy1;
+	cl_uint		pos, tail, index;
+	cl_uint		mask;
+	cl_uint		t_off = UINT_MAX;
+
+	if (*p_item_offset == UINT_MAX)
+		return UINT_MAX;
+	if (key->isnull)
+	{
+		*p_item_offset = UINT_MAX;
+		return UINT_MAX;
+	}
+	/* range of the cells; expanded by one cell */
+	cx0 = __gpujoin_grid_cell_index(key->xmin - grid->cell_w,
+									grid->base_x, grid->cell_w, grid->nx);
+	cx1 = __gpujoin_grid_cell_index(key->xmax + grid->cell_w,
+									grid->base_x, grid->cell_w, grid->nx);
+	cy0 = __gpujoin_grid_cell_index(key->ymin - grid->cell_h,
+									grid->base_y, grid->cell_h, grid->ny);
+	cy1 = __gpujoin_grid_cell_index(key->ymax + grid->cell_h,
+									grid->base_y, grid->cell_h, grid->ny);
+
+	pos = (*p_item_offset == 0 ? 0 : *p_item_offset - 1);
+	for (;;)
+	{
+		pos = __gpujoin_grid_seek(grid, pos, cx0, cx1, cy0, cy1, &tail);
+		if (pos >= grid->nitems)
+			break;
+		/* 'pos' and 'tail' are warp uniform */
+		assert(pos == __shfl_sync(__activemask(), pos, 0));
+		index = pos + LaneId();
+		if (index < tail)
+		{
+			kern_gpujoin_grid_item *gitem = &items[index];
+
+			if (gitem->xmin <= key->xmax &&
+				gitem->xmax >= key->xmin &&
+				gitem->ymin <= key->ymax &&
+				gitem->ymax >= key->ymin)
+				t_off = gitem->t_off;
+		}
+		mask = __ballot_sync(__activemask(), t_off != UINT_MAX);
+		pos = Min(pos + warpSize, tail);
+		if (mask != 0)
+		{
+			*p_item_offset = pos + 1;
+			return t_off;
+		}
+	}
+	*p_item_offset = UINT_MAX;
+
+	return UINT_MAX;
+}
+
 /*
  * gpujoin_exec_gistindex
+ *
+ * It also runs the grid-index, if no GiST index on the inner relation.
  */
 STATIC_FUNCTION(cl_int)
 gpujoin_exec_gistindex(kern_context *kcxt,
@@ -1336,6 +1494,7 @@ gpujoin_exec_gistindex(kern_context *kcxt,
 {
 	kern_data_store *kds_hash = KERN_MULTIRELS_INNER_KDS(kmrels, depth);
 	kern_data_store *kds_gist = KERN_MULTIRELS_GIST_INDEX(kmrels, depth);
+	kern_gpujoin_grid *grid = KERN_MULTIRELS_GRID_INDEX(kmrels, depth);
 	cl_bool		   *oj_map = KERN_MULTIRELS_OUTER_JOIN_MAP(kmrels, depth);
 	cl_uint		   *wr_stack;
 	cl_uint		   *temp_stack;
@@ -1346,7 +1505,8 @@ gpujoin_exec_gistindex(kern_context *kcxt,
 	void		   *gist_keys;
 	cl_char		   *vlpos_saved_1 = kcxt->vlpos;
 
-	assert(kds_hash->format == KDS_FORMAT_HASH);
+	assert((kds_gist != NULL && kds_hash->format == KDS_FORMAT_HASH) ||
+		   (grid != NULL && kds_hash->format == KDS_FORMAT_ROW));
 	assert(depth >= 1 && depth <= kgjoin->num_rels);
 
 	if (__syncthreads_count(l_state[depth] != UINT_MAX &&
@@ -1432,20 +1592,36 @@ reload:
 		do {
 			ItemPointerData *t_ctid;
 			cl_uint		mask;
-			cl_uint		t_off;
+			cl_uint		t_off = UINT_MAX;
 			cl_uint		l_next = l_state[depth];
 
-			t_ctid = gpujoin_gist_getnext(kcxt,
-										  kgjoin,
-										  depth,
-										  kds_gist,
-										  gist_keys,
-										  &l_next);
+			if (kds_gist)
+			{
+				t_ctid = gpujoin_gist_getnext(kcxt,
+											  kgjoin,
+											  depth,
+											  kds_gist,
+											  gist_keys,
+											  &l_next);
+				if (t_ctid)
+				{
+					assert(t_ctid->ip_posid == USHRT_MAX);
+					t_off = (((cl_uint)t_ctid->ip_blkid.bi_hi << 16) |
+							 ((cl_uint)t_ctid->ip_blkid.bi_lo));
+				}
+			}
+			else
+			{
+				t_off = gpujoin_grid_getnext(kcxt,
+											 grid,
+											 gist_keys,
+											 &l_next);
+			}
 			assert(__activemask() == ~0U);
 			if (__any_sync(__activemask(), kcxt->errcode != 0))
 				goto bailout;	/* error */
 			
-			mask = __ballot_sync(__activemask(), t_ctid != NULL);
+			mask = __ballot_sync(__activemask(), t_off != UINT_MAX);
 			count = __popc(mask);
 			if (LaneId() == 0)
 				temp_index = atomicAdd(&temp_pos[depth], count);
@@ -1456,11 +1632,8 @@ reload:
 				goto bailout;	/* urgent flush; cannot write out all the results */
 			temp_index += __popc(mask & ((1U << LaneId()) - 1));
 
-			if (t_ctid)
+			if (t_off != UINT_MAX)
 			{
-				assert(t_ctid->ip_posid == USHRT_MAX);
-				t_off = (((cl_uint)t_ctid->ip_blkid.bi_hi << 16) |
-						 ((cl_uint)t_ctid->ip_blkid.bi_lo));
 				assert(temp_index < GPUJOIN_PSEUDO_STACK_NROOMS);
 				temp_stack = __wr_stack_base +
 					(depth+1) * (GPUJOIN_PSEUDO_STACK_NROOMS + temp_index);
@@ -1690,9 +1863,10 @@ gpujoin_main(kern_context *kcxt,
 										  l_state,
 										  matched);
 		}
-		else if (kmrels->chunks[depth-1].gist_offset != 0)
+		else if (kmrels->chunks[depth-1].gist_offset != 0 ||
+				 kmrels->chunks[depth-1].grid_offset != 0)
 		{
-			/* GiST-INDEX */
+			/* GiST-INDEX or GRID-INDEX */
 			depth = gpujoin_exec_gistindex(kcxt,
 										   kgjoin,
 										   kmrels,
@@ -1743,30 +1917,26 @@ gpujoin_main(kern_context *kcxt,
 }
 
 /*
- * gpujoin_collocate_outer_join_map
+ * gpujoin_colocate_outer_join_map
  *
- * it merges the result of other GPU devices and CPU fallback
+ * it merges the outer join map of the peer GPU device to the local one
  */
 KERNEL_FUNCTION(void)
 gpujoin_colocate_outer_join_map(kern_multirels *kmrels,
-								cl_uint num_devices)
+								kern_multirels *kmrels_peer)
 {
 	size_t		nrooms = kmrels->ojmaps_length / sizeof(cl_uint);
-	cl_uint	   *ojmaps = (cl_uint *)((char *)kmrels + kmrels->kmrels_length);
-	cl_uint	   *destmap = ojmaps + kmrels->cuda_dindex * nrooms;
-	cl_uint		i, j, map;
+	cl_uint	   *ojmaps = (cl_uint *)
+		((char *)kmrels + kmrels->kmrels_length);
+	cl_uint	   *ojmaps_peer = (cl_uint *)
+		((char *)kmrels_peer + kmrels->kmrels_length);
+	size_t		i;
 
 	for (i = get_global_id();
 		 i < nrooms;
 		 i += get_global_size())
 	{
-		map = 0;
-		for (j = 0; j <= num_devices; j++)
-		{
-			map |= ojmaps[i];
-			ojmaps += nrooms;
-		}
-		destmap[i] = map;
+		ojmaps[i] |= ojmaps_peer[i];
 	}
 }
 
@@ -1881,9 +2051,10 @@ gpujoin_right_outer(kern_context *kcxt,
 										  l_state,
 										  matched);
 		}
-		else if (kmrels->chunks[depth-1].gist_offset)
+		else if (kmrels->chunks[depth-1].gist_offset ||
+				 kmrels->chunks[depth-1].grid_offset)
 		{
-			/* GiST-INDEX */
+			/* GiST-INDEX or GRID-INDEX */
 			depth = gpujoin_exec_gistindex(kcxt,
 										   kgjoin,
 										   kmrels,
@@ -12,6 +12,58 @@
  */
 #ifndef CUDA_GPUJOIN_H
 #define CUDA_GPUJOIN_H
+/*
+ * kern_gpujoin_grid - uniform grid on the bounding-box of inner geometries
+ *
+ * If the inner relation of a spatial join has no GiST index, GpuJoin builds
+ * a uniform grid on the host at the end of inner preload. Each item belongs
+ * to the cell that contains the center of its bounding-box, and items[] are
+ * sorted by the cell, so cells[i] is the first item of the i-th cell and
+ * cells[nx * ny] is the first oversized item; larger than a cell on either
+ * axis, or with unknown bounding-box. Because a regular item is not larger
+ * than a cell, an index-key has to check the cells that overlap with its
+ * bounding-box expanded by one cell, then all the oversized items.
+ */
+typedef struct
+{
+	cl_uint		t_off;			/* packed offset of HeapTupleHeader on KDS */
+	cl_uint		cell;			/* index of the cell, or UINT_MAX */
+	cl_float	xmin, xmax;		/* bounding-box of the item */
+	cl_float	ymin, ymax;
+} kern_gpujoin_grid_item;
+
+typedef struct
+{
+	cl_uint		nrooms;			/* capacity of items[] */
+	cl_uint		nitems;			/* number of items */
+	cl_uint		nx;				/* number of cells on X-axis */
+	cl_uint		ny;				/* number of cells on Y-axis */
+	cl_double	base_x;			/* left edge of the grid */
+	cl_double	base_y;			/* bottom edge of the grid */
+	cl_double	cell_w;			/* width of a cell */
+	cl_double	cell_h;			/* height of a cell */
+	cl_uint		cells[FLEXIBLE_ARRAY_MEMBER];	/* nx * ny + 1 items */
+} kern_gpujoin_grid;
+
+#define KERN_GPUJOIN_GRID_ITEMS(grid)									\
+	((kern_gpujoin_grid_item *)											\
+	 ((char *)(grid) + STROMALIGN(offsetof(kern_gpujoin_grid,			\
+										   cells[(grid)->nx *			\
+												 (grid)->ny + 1]))))
+
+/*
+ * kern_gpujoin_grid_key
+ *
+ * The first field of GpuJoinGiSTKeysDepth%u_t on the grid-index; bounding-
+ * box of the outer key already expanded by the distance, if any.
+ */
+typedef struct
+{
+	cl_bool		isnull;			/* true, if key never matches */
+	cl_float	xmin, xmax;
+	cl_float	ymin, ymax;
+} kern_gpujoin_grid_key;
+
 /*
  * definition of the inner relations structure. it can load multiple
  * kern_data_store or kern_hash_table.
@@ -27,10 +79,15 @@ typedef struct
 		cl_ulong	chunk_offset;	/* offset to KDS or Hash */
 		cl_ulong	ojmap_offset;	/* offset to outer-join map, if any */
 		cl_ulong	gist_offset;	/* offset to GiST-index pages, if any */
+		cl_ulong	grid_offset;	/* offset to grid-index, if any */
 		cl_bool		is_nestloop;	/* true, if NestLoop. */
 		cl_bool		left_outer;		/* true, if JOIN_LEFT or JOIN_FULL */
 		cl_bool		right_outer;	/* true, if JOIN_RIGHT or JOIN_FULL */
-		cl_char		__padding__[5];
+		cl_bool		hash_grouped;	/* true, if items with same hash value
+									 * are adjacent on the hash chain */
+		cl_bool		semi_join;		/* true, if JOIN_SEMI */
+		cl_bool		anti_join;		/* true, if JOIN_ANTI */
+		cl_char		__padding__[2];
 	} chunks[FLEXIBLE_ARRAY_MEMBER];
 } kern_multirels;
 
@@ -51,12 +108,24 @@ typedef struct
 	  ? NULL															\
 	  : (char *)(kmrels) + (kmrels)->chunks[(depth)-1].gist_offset))
 
+#define KERN_MULTIRELS_GRID_INDEX(kmrels, depth)						\
+	((kern_gpujoin_grid *)												\
+	 ((kmrels)->chunks[(depth)-1].grid_offset == 0						\
+	  ? NULL															\
+	  : (char *)(kmrels) + (kmrels)->chunks[(depth)-1].grid_offset))
+
 #define KERN_MULTIRELS_LEFT_OUTER_JOIN(kmrels, depth)	\
 	((kmrels)->chunks[(depth)-1].left_outer)
 
 #define KERN_MULTIRELS_RIGHT_OUTER_JOIN(kmrels, depth)	\
 	((kmrels)->chunks[(depth)-1].right_outer)
 
+#define KERN_MULTIRELS_SEMI_JOIN(kmrels, depth)			\
+	((kmrels)->chunks[(depth)-1].semi_join)
+
+#define KERN_MULTIRELS_ANTI_JOIN(kmrels, depth)			\
+	((kmrels)->chunks[(depth)-1].anti_join)
+
 /*
  * kern_gpujoin - control object of GpuJoin
  *
@@ -821,6 +821,11 @@ gpupreagg_init_final_hash(kern_global_hashslot *f_hash,
 		f_hash->lock = 0;
 		f_hash->usage = 0;
 		f_hash->nslots = f_hash_nslots;
+		f_hash->mig_state = 0;
+		f_hash->mig_clear_pos = 0;
+		f_hash->mig_clear_done = 0;
+		f_hash->mig_link_pos = 0;
+		f_hash->mig_link_done = 0;
 	}
 
 	for (size_t i = get_global_id(); i < f_hash_nslots; i += get_global_size())
@@ -1018,6 +1023,84 @@ gpupreagg_create_final_slot(kern_context *kcxt,
 	return dst_index;
 }
 
+/*
+ * __migrate_global_hash
+ *
+ * It rebuilds the global hash-slot after the expansion. Not only the block
+ * that expanded the hash-slot, but also the blocks waiting for the lock
+ * join the migration; each block claims a range of the hash-slot to clear,
+ * then a range of the hash-items to re-link, by atomic operations.
+ */
+STATIC_FUNCTION(void)
+__migrate_global_hash(kern_global_hashslot *f_hash)
+{
+	cl_uint		nslots = __volatileRead(&f_hash->nslots);
+	cl_uint		usage = __volatileRead(&f_hash->usage);
+	cl_uint		i;
+	__shared__ cl_uint base;
+
+	/* 1st phase - clear the hash-slot */
+	for (;;)
+	{
+		if (get_local_id() == 0)
+			base = atomicAdd(&f_hash->mig_clear_pos, get_local_size());
+		__syncthreads();
+		if (base >= nslots)
+			break;
+		i = base + get_local_id();
+		if (i < nslots)
+			f_hash->slots[i] = HASHITEM_EMPTY;
+		__threadfence();
+		__syncthreads();
+		if (get_local_id() == 0)
+			atomicAdd(&f_hash->mig_clear_done,
+					  Min(get_local_size(), nslots - base));
+	}
+	/* wait for completion of the 1st phase by other blocks */
+	if (get_local_id() == 0)
+	{
+		while (__volatileRead(&f_hash->mig_clear_done) < nslots)
+			/* spin */;
+	}
+	__syncthreads();
+
+	/* 2nd phase - re-link the hash-items */
+	for (;;)
+	{
+		preagg_hash_item *hitem = NULL;
+		cl_uint		hindex = UINT_MAX;
+		cl_uint		next;
+
+		if (get_local_id() == 0)
+			base = atomicAdd(&f_hash->mig_link_pos, get_local_size());
+		__syncthreads();
+		if (base >= usage)
+			break;
+		i = base + get_local_id();
+		if (i < usage)
+		{
+			hitem = GLOBAL_HASHSLOT_GETITEM(f_hash, i);
+			hindex = hitem->hash % nslots;
+		}
+
+		do {
+			if (hitem)
+			{
+				next = __volatileRead(&f_hash->slots[hindex]);
+				assert(next == HASHITEM_EMPTY || next < usage);
+				hitem->next = next;
+				if (atomicCAS(&f_hash->slots[hindex], next, i) == next)
+					hitem = NULL;
+			}
+		} while(__syncthreads_count(hitem != NULL) > 0);
+		__threadfence();
+		if (get_local_id() == 0)
+			atomicAdd(&f_hash->mig_link_done,
+					  Min(get_local_size(), usage - base));
+	}
+	__syncthreads();
+}
+
 /*
  * gpupreagg_expand_global_hash - expand size of the global hash slot on demand.
  * up to the f_hashlimit. It internally acquires shared lock of the final
@@ -1028,7 +1111,6 @@ STATIC_FUNCTION(cl_bool)
 __expand_global_hash(kern_context *kcxt, kern_global_hashslot *f_hash)
 {
 	cl_bool		expanded = false;
-	cl_uint		i, j;
 
 	/*
 	 * Expand the global hash-slot
@@ -1056,37 +1138,35 @@ __expand_global_hash(kern_context *kcxt, kern_global_hashslot *f_hash)
 	if (__syncthreads_count(expanded) == 0)
 		return false;		/* failed */
 
-	/* fix up the global hash-slot */
-	for (i = get_local_id(); i < f_hash->nslots; i += get_local_size())
+	/* open the migration for the other blocks waiting for the lock */
+	if (get_local_id() == 0)
 	{
-		f_hash->slots[i] = HASHITEM_EMPTY;
+		__threadfence();
+		atomicOr(&f_hash->mig_state, GLOBAL_HASHSLOT_MIGRATION_OPEN);
 	}
 	__syncthreads();
 
-	for (i = 0; i < f_hash->usage; i += get_local_size())
-	{
-		preagg_hash_item *hitem = NULL;
-		cl_uint		hindex = UINT_MAX;
-		cl_uint		next;
-
-		j = i + get_local_id();
-		if (j < f_hash->usage)
-		{
-			hitem = GLOBAL_HASHSLOT_GETITEM(f_hash, j);
-			hindex = hitem->hash % f_hash->nslots;
-		}
+	/* fix up the global hash-slot */
+	__migrate_global_hash(f_hash);
 
-		do {
-			if (hitem)
-			{
-				next = __volatileRead(&f_hash->slots[hindex]);
-				assert(next == HASHITEM_EMPTY || next < f_hash->usage);
-				hitem->next = next;
-				if (atomicCAS(&f_hash->slots[hindex], next, j) == next)
-					hitem = NULL;
-			}
-		} while(__syncthreads_count(hitem != NULL) > 0);
+	/* close the migration, then wait for the helper blocks to leave */
+	if (get_local_id() == 0)
+	{
+		cl_uint		usage = __volatileRead(&f_hash->usage);
+
+		while (__volatileRead(&f_hash->mig_link_done) < usage)
+			/* spin */;
+		atomicAnd(&f_hash->mig_state, ~GLOBAL_HASHSLOT_MIGRATION_OPEN);
+		while (__volatileRead(&f_hash->mig_state) != 0)
+			/* spin */;
+		f_hash->mig_clear_pos = 0;
+		f_hash->mig_clear_done = 0;
+		f_hash->mig_link_pos = 0;
+		f_hash->mig_link_done = 0;
+		__threadfence();
 	}
+	__syncthreads();
+
 	return true;
 }
 
@@ -1097,12 +1177,15 @@ gpupreagg_expand_global_hash(kern_context *kcxt,
 {
 	cl_bool		lock_wait = false;
 	cl_bool		expand_hash = false;
+	cl_bool		mig_helper;
 	cl_uint		old_lock;
 	cl_uint		new_lock;
 	cl_uint		curr_usage;
+	cl_uint		mig_state;
 
 	/* Get shared/exclusive lock on the final hash slot */
 	do {
+		mig_helper = false;
 		if (get_local_id() == 0)
 		{
 			curr_usage = __volatileRead(&f_hash->usage);
@@ -1110,7 +1193,19 @@ gpupreagg_expand_global_hash(kern_context *kcxt,
 
 			old_lock = __volatileRead(&f_hash->lock);
 			if ((old_lock & 0x0001) != 0)
-				lock_wait = true;	/* someone has exclusive lock */
+			{
+				/*
+				 * someone has exclusive lock; join the migration of the
+				 * hash-slot, if the expansion is in progress.
+				 */
+				lock_wait = true;
+				mig_state = __volatileRead(&f_hash->mig_state);
+				if ((mig_state & GLOBAL_HASHSLOT_MIGRATION_OPEN) != 0 &&
+					atomicCAS(&f_hash->mig_state,
+							  mig_state,
+							  mig_state + 1) == mig_state)
+					mig_helper = true;
+			}
 			else
 			{
 				if (expand_hash)
@@ -1126,6 +1221,12 @@ gpupreagg_expand_global_hash(kern_context *kcxt,
 					lock_wait = true;	/* Oops, conflict. Retry again. */
 			}
 		}
+		if (__syncthreads_count(mig_helper) > 0)
+		{
+			__migrate_global_hash(f_hash);
+			if (get_local_id() == 0)
+				atomicSub(&f_hash->mig_state, 1);
+		}
 	} while (__syncthreads_count(lock_wait) > 0);
 
 	if (__syncthreads_count(expand_hash) > 0)
@@ -1412,6 +1513,14 @@ found:
 
 /*
  * gpupreagg_group_reduction
+ *
+ * Each block tries to merge the items to the local hash-table first, then
+ * merges the rest to the global hash-table. If the local hash-table is full
+ * and most of items miss, the block switches to the global reduction only,
+ * because local reduction makes no sense for high-cardinality groups.
+ * Once the previous tasks reported many blocks switched to global reduction,
+ * the block makes the decision by the first batch (as a sample), without
+ * waiting for the local hash-table to get full.
  */
 DEVICE_FUNCTION(void)
 gpupreagg_groupby_reduction(kern_context *kcxt,
@@ -1426,9 +1535,11 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 							char	   *l_extras)			/* __shared__ */
 {
 	cl_bool		is_last_reduction = false;
+	cl_bool		is_first_batch = true;
 	cl_uint		l_nitems;
 	__shared__ preagg_local_hashtable l_htable;
 	__shared__ cl_uint	base;
+	__shared__ cl_bool	l_bypass;
 
 	/* skip if previous stage reported an error */
 	if (kgjoin_errorbuf &&
@@ -1450,6 +1561,7 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 	{
 		l_final_buffer_modified = false;
 		l_htable.nitems = 0;
+		l_bypass = false;
 	}
 	for (int i = get_local_id(); i < GPUPREAGG_LOCAL_HASH_NSLOTS; i += get_local_size())
 		l_htable.l_hslots[i] = HASHITEM_EMPTY;
@@ -1486,26 +1598,53 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 			return;		/* error */
 
 		/*
-		 * 1st path - try local reduction
+		 * 1st path - try local reduction, unless this block already gave up
 		 */
-		status = -1;
-		do {
-			if (status < 0 && index < kds_slot->nitems)
-				status = gpupreagg_local_reduction(kcxt,
-												   kds_slot,
-												   index,
-												   hash,
-												   &l_htable,
-												   l_hitems,
-												   l_dclass,
-												   l_values,
-												   l_extras);
-			else
-				status = 1;
+		if (l_bypass)
+			status = (index < kds_slot->nitems ? 0 : 1);
+		else
+		{
+			cl_uint		nitems_base = Min(l_htable.nitems,
+										  GPUPREAGG_LOCAL_HASH_NROOMS);
+			cl_uint		nvalids;
+			cl_uint		nmisses;
+			cl_uint		nnews;
 
-			if (__syncthreads_count(kcxt->errcode) > 0)
-				return;		/* error */
-		} while (__syncthreads_count(status < 0) > 0);
+			status = -1;
+			do {
+				if (status < 0 && index < kds_slot->nitems)
+					status = gpupreagg_local_reduction(kcxt,
+													   kds_slot,
+													   index,
+													   hash,
+													   &l_htable,
+													   l_hitems,
+													   l_dclass,
+													   l_values,
+													   l_extras);
+				else
+					status = 1;
+
+				if (__syncthreads_count(kcxt->errcode) > 0)
+					return;		/* error */
+			} while (__syncthreads_count(status < 0) > 0);
+
+			/* switch to the global reduction only, if local one is useless */
+			nvalids = __syncthreads_count(index < kds_slot->nitems);
+			nmisses = __syncthreads_count(status == 0);
+			nnews = (Min(l_htable.nitems,
+						 GPUPREAGG_LOCAL_HASH_NROOMS) - nitems_base);
+			if (get_local_id() == 0 &&
+				(4 * nmisses > 3 * nvalids ||
+				 (is_first_batch &&
+				  kgpreagg->local_bypass_hint &&
+				  2 * (nmisses + nnews) > nvalids)))
+			{
+				l_bypass = true;
+				atomicAdd(&kgpreagg->nr_local_bypass, 1);
+			}
+		}
+		is_first_batch = false;
 
 		/*
 		 * 2nd path - try global reduction
@@ -1591,6 +1730,99 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 		kgpreagg->final_buffer_modified = true;
 }
 
+/*
+ * gpupreagg_sorted_reduction
+ *
+ * Segmented reduction for the input stream already clustered by the grouping
+ * keys. Each block fetches a contiguous range of kds_slot, then a row that
+ * has different keys from the previous one becomes the head of a run.
+ * The head creates a new final slot, and the rest of rows in the run are
+ * merged to the slot of its head. No hash-table is needed at all.
+ * A run across the boundary of the ranges may be split into multiple
+ * partial results, however, it is harmless because CPU Agg merges them.
+ */
+DEVICE_FUNCTION(void)
+gpupreagg_sorted_reduction(kern_context *kcxt,
+						   kern_gpupreagg *kgpreagg,		/* in/out */
+						   kern_errorbuf *kgjoin_errorbuf,	/* in */
+						   kern_data_store *kds_slot,		/* in */
+						   kern_data_store *kds_final)		/* out */
+{
+	__shared__ cl_uint	base;
+	__shared__ cl_uint	l_run_index[MAXTHREADS_PER_BLOCK];
+
+	/* skip if previous stage reported an error */
+	if (kgjoin_errorbuf &&
+		__syncthreads_count(kgjoin_errorbuf->errcode) != 0)
+		return;
+	if (__syncthreads_count(kgpreagg->kerror.errcode) != 0)
+		return;
+
+	assert(kgpreagg->num_group_keys > 0);
+	assert(kds_slot->format == KDS_FORMAT_SLOT);
+	assert(kds_final->format == KDS_FORMAT_SLOT);
+	assert(get_local_size() <= MAXTHREADS_PER_BLOCK);
+	if (get_global_id() == 0)
+		kgpreagg->setup_slot_done = true;
+	if (get_local_id() == 0)
+		l_final_buffer_modified = false;
+	__syncthreads();
+
+	for (;;)
+	{
+		cl_uint		index;
+		cl_uint		run_id;
+		cl_bool		is_head = false;
+
+		/* fetch next items from the kds_slot */
+		if (get_local_id() == 0)
+			base = atomicAdd(&kgpreagg->read_slot_pos, get_local_size());
+		__syncthreads();
+		if (base >= kds_slot->nitems)
+			break;
+
+		/* is this row the head of a run? */
+		index = base + get_local_id();
+		if (index < kds_slot->nitems)
+			is_head = (get_local_id() == 0 ||
+					   !gpupreagg_keymatch(kcxt,
+										   kds_slot, index,
+										   kds_slot, index - 1));
+		if (__syncthreads_count(kcxt->errcode) > 0)
+			return;		/* error */
+
+		/* the head row allocates a final slot, and merges itself */
+		run_id = pgstromStairlikeBinaryCount(is_head, NULL);
+		if (is_head)
+			l_run_index[run_id] = gpupreagg_create_final_slot(kcxt,
+															  kds_final,
+															  kds_slot,
+															  index,
+															  NULL,
+															  NULL);
+		if (__syncthreads_count(kcxt->errcode) > 0)
+			return;		/* error */
+
+		/* the rest of rows are merged to the final slot of the head */
+		if (!is_head && index < kds_slot->nitems)
+		{
+			cl_uint		dst_index = l_run_index[run_id - 1];
+
+			assert(run_id > 0 && dst_index < kds_final->nitems);
+			gpupreagg_update_atomic(KERN_DATA_STORE_DCLASS(kds_final, dst_index),
+									KERN_DATA_STORE_VALUES(kds_final, dst_index),
+									GPUPREAGG_ACCUM_MAP_GLOBAL,
+									KERN_DATA_STORE_DCLASS(kds_slot, index),
+									KERN_DATA_STORE_VALUES(kds_slot, index),
+									GPUPREAGG_ACCUM_MAP_GLOBAL);
+		}
+		__syncthreads();
+	}
+	__syncthreads();
+	if (get_local_id() == 0 && l_final_buffer_modified)
+		kgpreagg->final_buffer_modified = true;
+}
+
 /*
  * aggcalc operations for hyper-log-log
  */
@@ -1771,3 +2003,395 @@ aggcalc_update_hll_sketch(cl_char *p_accum_dclass,
 		*p_accum_dclass = DATUM_CLASS__NORMAL;
 	}
 }
+
+/*
+ * gpupreagg_hll_compaction
+ *
+ * It rewrites the HLL sketches at the 'colidx' of kds_final to the sparse
+ * form with the estimated cardinality, if it is smaller than the dense one.
+ * A thread-block processes a sketch at once; the registers are loaded to
+ * the shared memory first, then written back to the same buffer.
+ */
+DEVICE_FUNCTION(void)
+gpupreagg_hll_compaction(kern_data_store *kds_final,
+						 cl_int colidx,
+						 cl_uint *l_hll_regs)
+{
+	cl_uint		nrooms = (1U << GPUPREAGG_HLL_REGISTER_BITS);
+	cl_uchar   *regs = (cl_uchar *)l_hll_regs;
+	__shared__ cl_uint	l_nitems;
+	__shared__ cl_double l_divider;
+	cl_uint		row_index;
+
+	assert(kds_final->format == KDS_FORMAT_SLOT &&
+		   colidx >= 0 && colidx < kds_final->ncols);
+	for (row_index = get_group_id();
+		 row_index < kds_final->nitems;
+		 row_index += get_num_groups())
+	{
+		cl_char	   *dclass = KERN_DATA_STORE_DCLASS(kds_final, row_index);
+		Datum	   *values = KERN_DATA_STORE_VALUES(kds_final, row_index);
+		varlena	   *hll_state;
+		cl_uint	   *hll_regs;
+		kern_hll_compact_sketch *hll_compact;
+		cl_uint		nitems = 0;
+		cl_uint		base;
+		cl_uint		index;
+		cl_double	divider = 0.0;
+
+		if (dclass[colidx] != DATUM_CLASS__NORMAL)
+			continue;
+		hll_state = (varlena *)DatumGetPointer(values[colidx]);
+		if (VARSIZE_EXHDR(hll_state) != nrooms ||
+			((cl_uchar *)VARDATA(hll_state))[0] == HLL_COMPACT_SKETCH_MAGIC)
+			continue;
+		hll_regs = (cl_uint *)VARDATA(hll_state);
+
+		/* load the registers, and count the number of non-zero registers */
+		if (get_local_id() == 0)
+		{
+			l_nitems = 0;
+			l_divider = 0.0;
+		}
+		__syncthreads();
+		for (index = get_local_id();
+			 index < nrooms / sizeof(cl_uint);
+			 index += get_local_size())
+			l_hll_regs[index] = __volatileRead(&hll_regs[index]);
+		__syncthreads();
+		for (index = get_local_id(); index < nrooms; index += get_local_size())
+		{
+			if (regs[index] != 0)
+			{
+				nitems++;
+				divider += 1.0 / (cl_double)(1UL << regs[index]);
+			}
+		}
+		if (nitems > 0)
+		{
+			atomicAdd(&l_nitems, nitems);
+			atomicAdd(&l_divider, divider);
+		}
+		__syncthreads();
+
+		/* no need to compact, if sparse form is not smaller */
+		if (HLL_COMPACT_SKETCH_LENGTH(l_nitems) >= VARSIZE(hll_state))
+		{
+			__syncthreads();
+			continue;
+		}
+		/* write back the items in the order of register index */
+		hll_compact = (kern_hll_compact_sketch *)hll_state;
+		nitems = 0;
+		for (base = 0, index = get_local_id();
+			 base < nrooms;
+			 base += get_local_size(), index += get_local_size())
+		{
+			cl_uint		value = (index < nrooms ? regs[index] : 0);
+			cl_uint		count;
+			cl_uint		offset;
+
+			offset = pgstromStairlikeBinaryCount(value != 0, &count);
+			if (value != 0)
+				hll_compact->items[nitems + offset] = ((index << 8) | value);
+			nitems += count;
+		}
+		nitems = l_nitems;
+		if (get_local_id() == 0)
+		{
+			cl_double	weight;
+
+			/* same as pgstrom_hll_count_final() */
+			divider = l_divider + (cl_double)(nrooms - nitems);
+			if (nrooms <= 16)
+				weight = 0.673;
+			else if (nrooms <= 32)
+				weight = 0.697;
+			else if (nrooms <= 64)
+				weight = 0.709;
+			else
+				weight = 0.7213 / (1.0 + 1.079 / (cl_double)nrooms);
+			hll_compact->magic = HLL_COMPACT_SKETCH_MAGIC;
+			hll_compact->nbits = GPUPREAGG_HLL_REGISTER_BITS;
+			hll_compact->__padding__1 = 0;
+			hll_compact->nitems = nitems;
+			hll_compact->__padding__2 = 0;
+			hll_compact->estimate = (cl_long)((weight *
+											   (cl_double)nrooms *
+											   (cl_double)nrooms) / divider);
+			SET_VARSIZE(hll_compact, HLL_COMPACT_SKETCH_LENGTH(nitems));
+		}
+		__syncthreads();
+	}
+}
+
+/*
+ * aggcalc operations for quantile sketch
+ */
+DEVICE_FUNCTION(void)
+aggcalc_init_qsketch(cl_char *p_accum_dclass,
+					 Datum   *p_accum_datum,
+					 char    *extra_pos)
+{
+	kern_quantile_sketch *qsketch = (kern_quantile_sketch *)extra_pos;
+
+	*p_accum_dclass = DATUM_CLASS__NULL;
+	memset(qsketch, 0, QSKETCH_LENGTH);
+	SET_VARSIZE(qsketch, QSKETCH_LENGTH);
+	qsketch->nbuckets = QSKETCH_NBUCKETS;
+	*p_accum_datum = PointerGetDatum(qsketch);
+}
+
+DEVICE_FUNCTION(void)
+aggcalc_shuffle_qsketch(cl_char *p_accum_dclass,
+						Datum   *p_accum_datum,
+						int      lane_id)
+{
+	kern_quantile_sketch *qsketch
+		= (kern_quantile_sketch *)DatumGetPointer(*p_accum_datum);
+	cl_char		my_dclass;
+	cl_char		buddy_dclass;
+	cl_uint		index;
+
+	assert(qsketch->nbuckets == QSKETCH_NBUCKETS);
+	assert(__activemask() == ~0U);
+	my_dclass = *p_accum_dclass;
+	buddy_dclass = __shfl_sync(__activemask(), my_dclass, lane_id);
+
+	for (index=0; index < QSKETCH_NBUCKETS; index++)
+	{
+		cl_ulong	buddy;
+
+		buddy = __shfl_sync(__activemask(), qsketch->counts[index], lane_id);
+		if (buddy_dclass != DATUM_CLASS__NULL)
+			qsketch->counts[index] += buddy;
+	}
+	if (buddy_dclass != DATUM_CLASS__NULL)
+		*p_accum_dclass = DATUM_CLASS__NORMAL;
+}
+
+DEVICE_FUNCTION(void)
+aggcalc_normal_qsketch(cl_char *p_accum_dclass,
+					   Datum   *p_accum_datum,
+					   cl_char  newval_dclass,
+					   Datum    newval_datum)	/* = float8 value */
+{
+	if (newval_dclass != DATUM_CLASS__NULL)
+	{
+		kern_quantile_sketch *qsketch
+			= (kern_quantile_sketch *)DatumGetPointer(*p_accum_datum);
+		cl_uint		index;
+
+		assert(newval_dclass == DATUM_CLASS__NORMAL);
+		index = qsketch_bucket_index(__longlong_as_double(newval_datum));
+		qsketch->counts[index]++;
+		*p_accum_dclass = DATUM_CLASS__NORMAL;
+	}
+}
+
+DEVICE_FUNCTION(void)
+aggcalc_merge_qsketch(cl_char *p_accum_dclass,
+					  Datum   *p_accum_datum,
+					  cl_char  newval_dclass,
+					  Datum    newval_datum)	/* = bytea sketch */
+{
+	if (newval_dclass != DATUM_CLASS__NULL)
+	{
+		kern_quantile_sketch *dst_sketch
+			= (kern_quantile_sketch *)DatumGetPointer(*p_accum_datum);
+		kern_quantile_sketch *new_sketch
+			= (kern_quantile_sketch *)DatumGetPointer(newval_datum);
+		cl_uint		index;
+
+		assert(newval_dclass == DATUM_CLASS__NORMAL);
+		assert(dst_sketch->nbuckets == QSKETCH_NBUCKETS &&
+			   new_sketch->nbuckets == QSKETCH_NBUCKETS);
+		for (index=0; index < QSKETCH_NBUCKETS; index++)
+		{
+			cl_ulong	count = __volatileRead(&new_sketch->counts[index]);
+
+			/* most of buckets are empty, so skip atomic operations */
+			if (count != 0)
+				atomicAdd(&dst_sketch->counts[index], count);
+		}
+		*p_accum_dclass = DATUM_CLASS__NORMAL;
+	}
+}
+
+DEVICE_FUNCTION(void)
+aggcalc_update_qsketch(cl_char *p_accum_dclass,
+					   Datum   *p_accum_datum,
+					   cl_char  newval_dclass,
+					   Datum    newval_datum)	/* = float8 value */
+{
+	if (newval_dclass != DATUM_CLASS__NULL)
+	{
+		kern_quantile_sketch *qsketch
+			= (kern_quantile_sketch *)DatumGetPointer(*p_accum_datum);
+		cl_uint		index;
+
+		assert(newval_dclass == DATUM_CLASS__NORMAL);
+		index = qsketch_bucket_index(__longlong_as_double(newval_datum));
+		atomicAdd(&qsketch->counts[index], (cl_ulong)1);
+		*p_accum_dclass = DATUM_CLASS__NORMAL;
+	}
+}
+
+/*
+ * aggcalc operations for fixed-point numeric sum
+ */
+DEVICE_FUNCTION(void)
+aggcalc_init_nsum(cl_char *p_accum_dclass,
+				  Datum   *p_accum_datum,
+				  char    *extra_pos,
+				  cl_int   scale)
+{
+	kern_numeric_sum *nsum = (kern_numeric_sum *)extra_pos;
+
+	*p_accum_dclass = DATUM_CLASS__NULL;
+	memset(nsum, 0, NSUM_LENGTH);
+	SET_VARSIZE(nsum, NSUM_LENGTH);
+	nsum->scale = scale;
+	*p_accum_datum = PointerGetDatum(nsum);
+}
+
+/*
+ * __nsum_fetch_value - fetch a numeric datum as a fixed-point value
+ */
+STATIC_FUNCTION(cl_bool)
+__nsum_fetch_value(kern_numeric_sum *nsum, Datum newval_datum,
+				   cl_ulong *p_lo, cl_long *p_hi)
+{
+	kern_context	kcxt;
+	pg_numeric_t	num;
+
+	memset(&kcxt, 0, sizeof(kern_context));
+	num = pg_numeric_from_varlena(&kcxt, (struct varlena *)
+								  DatumGetPointer(newval_datum));
+	if (kcxt.errcode != ERRCODE_STROM_SUCCESS || num.isnull ||
+		!nsum_rescale_value(&num, nsum->scale))
+		return false;
+#ifdef HAVE_INT128
+	*p_lo = (cl_ulong)(num.value.ival);
+	*p_hi = (cl_long)(num.value.ival >> 64);
+#else
+	*p_lo = num.value.lo;
+	*p_hi = num.value.hi;
+#endif
+	return true;
+}
+
+DEVICE_FUNCTION(void)
+aggcalc_shuffle_nsum(cl_char *p_accum_dclass,
+					 Datum   *p_accum_datum,
+					 int      lane_id)
+{
+	kern_numeric_sum *nsum
+		= (kern_numeric_sum *)DatumGetPointer(*p_accum_datum);
+	cl_char		buddy_dclass;
+	cl_uint		buddy_overflow;
+	cl_ulong	buddy_nitems;
+	cl_ulong	buddy_lo;
+	cl_long		buddy_hi;
+
+	buddy_dclass   = __shfl_sync(__activemask(), *p_accum_dclass, lane_id);
+	buddy_overflow = __shfl_sync(__activemask(), nsum->overflow, lane_id);
+	buddy_nitems   = __shfl_sync(__activemask(), nsum->nitems, lane_id);
+	buddy_lo       = __shfl_sync(__activemask(), nsum->sum_lo, lane_id);
+	buddy_hi       = __shfl_sync(__activemask(), nsum->sum_hi, lane_id);
+	if (buddy_dclass != DATUM_CLASS__NULL)
+	{
+		cl_ulong	lo = nsum->sum_lo + buddy_lo;
+
+		nsum->sum_hi  += buddy_hi + (lo < buddy_lo ? 1 : 0);
+		nsum->sum_lo   = lo;
+		nsum->nitems  += buddy_nitems;
+		nsum->overflow |= buddy_overflow;
+		*p_accum_dclass = DATUM_CLASS__NORMAL;
+	}
+}
+
+DEVICE_FUNCTION(void)
+aggcalc_normal_nsum(cl_char *p_accum_dclass,
+					Datum   *p_accum_datum,
+					cl_char  newval_dclass,
+					Datum    newval_datum)	/* = numeric value */
+{
+	if (newval_dclass != DATUM_CLASS__NULL)
+	{
+		kern_numeric_sum *nsum
+			= (kern_numeric_sum *)DatumGetPointer(*p_accum_datum);
+		cl_ulong	lo;
+		cl_long		hi;
+
+		assert(newval_dclass == DATUM_CLASS__NORMAL);
+		if (!__nsum_fetch_value(nsum, newval_datum, &lo, &hi))
+			nsum->overflow = 1;
+		else
+		{
+			lo += nsum->sum_lo;
+			nsum->sum_hi += hi + (lo < nsum->sum_lo ? 1 : 0);
+			nsum->sum_lo = lo;
+		}
+		nsum->nitems++;
+		*p_accum_dclass = DATUM_CLASS__NORMAL;
+	}
+}
+
+DEVICE_FUNCTION(void)
+aggcalc_merge_nsum(cl_char *p_accum_dclass,
+				   Datum   *p_accum_datum,
+				   cl_char  newval_dclass,
+				   Datum    newval_datum)	/* = bytea accumulator */
+{
+	if (newval_dclass != DATUM_CLASS__NULL)
+	{
+		kern_numeric_sum *dst_nsum
+			= (kern_numeric_sum *)DatumGetPointer(*p_accum_datum);
+		kern_numeric_sum *new_nsum
+			= (kern_numeric_sum *)DatumGetPointer(newval_datum);
+		cl_ulong	lo = __volatileRead(&new_nsum->sum_lo);
+		cl_long		hi = __volatileRead(&new_nsum->sum_hi);
+		cl_ulong	oldval;
+
+		assert(newval_dclass == DATUM_CLASS__NORMAL);
+		assert(dst_nsum->scale == new_nsum->scale);
+		oldval = atomicAdd(&dst_nsum->sum_lo, lo);
+		if (oldval + lo < oldval)
+			hi++;	/* carry */
+		atomicAdd((cl_ulong *)&dst_nsum->sum_hi, (cl_ulong)hi);
+		atomicAdd(&dst_nsum->nitems, __volatileRead(&new_nsum->nitems));
+		if (__volatileRead(&new_nsum->overflow) != 0)
+			atomicOr(&dst_nsum->overflow, 1U);
+		*p_accum_dclass = DATUM_CLASS__NORMAL;
+	}
+}
+
+DEVICE_FUNCTION(void)
+aggcalc_update_nsum(cl_char *p_accum_dclass,
+					Datum   *p_accum_datum,
+					cl_char  newval_dclass,
+					Datum    newval_datum)	/* = numeric value */
+{
+	if (newval_dclass != DATUM_CLASS__NULL)
+	{
+		kern_numeric_sum *nsum
+			= (kern_numeric_sum *)DatumGetPointer(*p_accum_datum);
+		cl_ulong	lo;
+		cl_long		hi;
+		cl_ulong	oldval;
+
+		assert(newval_dclass == DATUM_CLASS__NORMAL);
+		if (!__nsum_fetch_value(nsum, newval_datum, &lo, &hi))
+			atomicOr(&nsum->overflow, 1U);
+		else
+		{
+			oldval = atomicAdd(&nsum->sum_lo, lo);
+			if (oldval + lo < oldval)
+				hi++;	/* carry */
+			atomicAdd((cl_ulong *)&nsum->sum_hi, (cl_ulong)hi);
+		}
+		atomicAdd(&nsum->nitems, (cl_ulong)1);
+		*p_accum_dclass = DATUM_CLASS__NORMAL;
+	}
+}
@@ -31,6 +31,10 @@ struct kern_gpupreagg
 	cl_uint			nitems_filtered;	/* out: # of removed rows by quals */
 	cl_uint			num_groups;			/* out: # of new groups */
 	cl_uint			extra_usage;		/* out: size of new allocation */
+	/* -- adaptive local/global reduction -- */
+	cl_bool			local_bypass_hint;	/* in: local reduction looks useless */
+	cl_uint			nr_local_bypass;	/* out: # of blocks that skipped local
+										 * reduction */
 	/* -- debug counter -- */
 	cl_ulong		tv_stat_debug1;		/* out: debug counter 1 */
 	cl_ulong		tv_stat_debug2;		/* out: debug counter 2 */
@@ -109,13 +113,146 @@ typedef struct
 	cl_uint		lock;		/* shared/exclusive lock */
 	cl_uint		usage;		/* current usage of the hash item in the tail */
 	cl_uint		nslots;		/* current size of the hash slots */
+	/* -- cooperative migration during expansion -- */
+	cl_uint		mig_state;	/* OPEN flag + number of helper blocks */
+	cl_uint		mig_clear_pos;	/* next hash slot to be cleared */
+	cl_uint		mig_clear_done;	/* number of cleared hash slots */
+	cl_uint		mig_link_pos;	/* next hash item to be re-linked */
+	cl_uint		mig_link_done;	/* number of re-linked hash items */
 	cl_uint		slots[FLEXIBLE_ARRAY_MEMBER];
 } kern_global_hashslot;
 
+#define GLOBAL_HASHSLOT_MIGRATION_OPEN		0x80000000U
+
 #define GLOBAL_HASHSLOT_GETITEM(f_hash, index)							\
 	((preagg_hash_item *)((char *)(f_hash) + (f_hash)->length -			\
 						  sizeof(preagg_hash_item) * ((index) + 1)))
 
+/*
+ * kern_quantile_sketch
+ *
+ * A fixed length log-linear histogram for approximate quantiles, stored as
+ * a bytea datum. Absolute value of the input is bucketed by its binary
+ * exponent and the top QSKETCH_SUBBUCKET_BITS of the mantissa, so relative
+ * width of a bucket is at most 2^-QSKETCH_SUBBUCKET_BITS. Values less than
+ * 2^QSKETCH_MIN_EXPONENT are counted as zero, and values larger than
+ * 2^QSKETCH_MAX_EXPONENT (including Inf and NaN) go to the edge buckets.
+ * Buckets are ordered by the value; negative ones, zero, then positive ones.
+ */
+#define QSKETCH_SUBBUCKET_BITS		3
+#define QSKETCH_MIN_EXPONENT		(-24)
+#define QSKETCH_MAX_EXPONENT		40
+#define QSKETCH_NBUCKETS_PER_SIGN								\
+	((QSKETCH_MAX_EXPONENT - QSKETCH_MIN_EXPONENT) << QSKETCH_SUBBUCKET_BITS)
+#define QSKETCH_ZERO_BUCKET			QSKETCH_NBUCKETS_PER_SIGN
+#define QSKETCH_NBUCKETS			(2 * QSKETCH_NBUCKETS_PER_SIGN + 1)
+
+typedef struct
+{
+	cl_uint		vl_len_;	/* varlena header (do not touch directly) */
+	cl_uint		nbuckets;	/* = QSKETCH_NBUCKETS */
+	cl_ulong	counts[FLEXIBLE_ARRAY_MEMBER];
+} kern_quantile_sketch;
+
+#define QSKETCH_LENGTH		offsetof(kern_quantile_sketch, counts[QSKETCH_NBUCKETS])
+
+STATIC_INLINE(cl_uint)
+qsketch_bucket_index(cl_double fval)
+{
+	union {
+		cl_double	fval;
+		cl_ulong	ival;
+	}		u;
+	cl_int	expo;
+	cl_uint	index;
+
+	u.fval = fval;
+	expo = (cl_int)((u.ival >> 52) & 0x7ffU) - 1023;
+	if (expo < QSKETCH_MIN_EXPONENT)
+		return QSKETCH_ZERO_BUCKET;
+	if (expo >= QSKETCH_MAX_EXPONENT)
+		index = QSKETCH_NBUCKETS_PER_SIGN - 1;
+	else
+		index = (((cl_uint)(expo - QSKETCH_MIN_EXPONENT)
+				  << QSKETCH_SUBBUCKET_BITS) |
+				 ((cl_uint)(u.ival >> (52 - QSKETCH_SUBBUCKET_BITS)) &
+				  ((1U << QSKETCH_SUBBUCKET_BITS) - 1)));
+	if ((u.ival >> 63) != 0)
+		return QSKETCH_ZERO_BUCKET - 1 - index;
+	return QSKETCH_ZERO_BUCKET + 1 + index;
+}
+
+/*
+ * kern_hll_compact_sketch
+ *
+ * A sparse form of the HLL sketch with the cardinality estimated on the
+ * device. GpuPreAgg rewrites the registers of hll_count() in the final
+ * buffer to this form prior to the emission, if it is smaller than the
+ * dense form; that is an array of 2^N registers. Each item is a pair of
+ * register index and value, as (index << 8 | value).
+ * The first byte of the payload is HLL_COMPACT_SKETCH_MAGIC, because the
+ * register value of the dense form never exceeds 64.
+ */
+#define HLL_COMPACT_SKETCH_MAGIC	0xff
+
+typedef struct
+{
+	cl_uint		vl_len_;	/* varlena header (do not touch directly) */
+	cl_uchar	magic;		/* HLL_COMPACT_SKETCH_MAGIC */
+	cl_uchar	nbits;		/* number of register bits */
+	cl_ushort	__padding__1;
+	cl_uint		nitems;		/* number of non-zero registers */
+	cl_uint		__padding__2;
+	cl_long		estimate;	/* cardinality estimated on the device */
+	cl_uint		items[FLEXIBLE_ARRAY_MEMBER];
+} kern_hll_compact_sketch;
+
+#define HLL_COMPACT_SKETCH_LENGTH(nitems)						\
+	offsetof(kern_hll_compact_sketch, items[(nitems)])
+
+/*
+ * kern_numeric_sum
+ *
+ * A fixed-point accumulator for SUM/AVG of NUMERIC with bounded scale; like
+ * decimal128 of Apache Arrow. Every value is rescaled to the 'scale' given at
+ * the planning time, then added to the signed 128bit integer that consists
+ * of sum_lo and sum_hi, so atomic update is a pair of 64bit atomicAdd.
+ * If any value is not representable at the scale, 'overflow' is set and the
+ * final function raises an error, instead of wrong result.
+ */
+#define NSUM_MAX_PRECISION		28
+
+typedef struct
+{
+	cl_uint		vl_len_;	/* varlena header (do not touch directly) */
+	cl_int		scale;		/* scale of the fixed-point value */
+	cl_uint		overflow;	/* non-zero, if any value was not representable */
+	cl_uint		__padding__;
+	cl_ulong	nitems;		/* number of accumulated values */
+	cl_ulong	sum_lo;		/* lower 64bit of the sum */
+	cl_long		sum_hi;		/* upper 64bit of the sum */
+} kern_numeric_sum;
+
+#define NSUM_LENGTH			sizeof(kern_numeric_sum)
+
+/*
+ * nsum_rescale_value - it rescales the pg_numeric_t value to the supplied
+ * scale. false shall be returned if the value is not representable.
+ */
+STATIC_INLINE(cl_bool)
+nsum_rescale_value(pg_numeric_t *num, cl_int scale)
+{
+	if (num->weight > scale ||
+		scale - num->weight > 2 * NSUM_MAX_PRECISION)
+		return false;
+	while (num->weight < scale)
+	{
+		num->value = __Int128_mul(num->value, 10);
+		num->weight++;
+	}
+	return true;
+}
+
 #ifndef __CUDACC__
 /*
  * gpupreagg_reset_kernel_task - reset kern_gpupreagg status prior to resume
@@ -324,6 +461,16 @@ gpupreagg_groupby_reduction(kern_context *kcxt,
 							cl_char    *l_dclass,			/* __shared__ */
 							Datum      *l_values,			/* __shared__ */
 							char       *l_extras);			/* __shared__ */
+DEVICE_FUNCTION(void)
+gpupreagg_sorted_reduction(kern_context *kcxt,
+						   kern_gpupreagg *kgpreagg,		/* in/out */
+						   kern_errorbuf *kgjoin_errorbuf,	/* in */
+						   kern_data_store *kds_slot,		/* in */
+						   kern_data_store *kds_final);		/* shared out */
+DEVICE_FUNCTION(void)
+gpupreagg_hll_compaction(kern_data_store *kds_final,		/* in/out */
+						 cl_int colidx,
+						 cl_uint *l_hll_regs);				/* __shared__ */
 #endif /* __CUDACC__ */
 
 /* ----------------------------------------------------------------
@@ -852,6 +999,61 @@ aggcalc_update_hll_sketch(cl_char *p_accum_dclass,
 						  cl_char  newval_dclass,
 						  Datum    newval_datum);
 
+/*
+ * aggcalc operations for quantile sketch support
+ */
+DEVICE_FUNCTION(void)
+aggcalc_init_qsketch(cl_char *p_accum_dclass,
+					 Datum   *p_accum_datum,
+					 char    *extra_buffer);
+DEVICE_FUNCTION(void)
+aggcalc_shuffle_qsketch(cl_char *p_accum_dclass,
+						Datum   *p_accum_datum,
+						int      lane_id);
+DEVICE_FUNCTION(void)
+aggcalc_normal_qsketch(cl_char *p_accum_dclass,
+					   Datum   *p_accum_datum,
+					   cl_char  newval_dclass,
+					   Datum    newval_datum);
+DEVICE_FUNCTION(void)
+aggcalc_merge_qsketch(cl_char *p_accum_dclass,
+					  Datum   *p_accum_datum,
+					  cl_char  newval_dclass,
+					  Datum    newval_datum);
+DEVICE_FUNCTION(void)
+aggcalc_update_qsketch(cl_char *p_accum_dclass,
+					   Datum   *p_accum_datum,
+					   cl_char  newval_dclass,
+					   Datum    newval_datum);
+
+/*
+ * aggcalc operations for fixed-point numeric sum
+ */
+DEVICE_FUNCTION(void)
+aggcalc_init_nsum(cl_char *p_accum_dclass,
+				  Datum   *p_accum_datum,
+				  char    *extra_buffer,
+				  cl_int   scale);
+DEVICE_FUNCTION(void)
+aggcalc_shuffle_nsum(cl_char *p_accum_dclass,
+					 Datum   *p_accum_datum,
+					 int      lane_id);
+DEVICE_FUNCTION(void)
+aggcalc_normal_nsum(cl_char *p_accum_dclass,
+					Datum   *p_accum_datum,
+					cl_char  newval_dclass,
+					Datum    newval_datum);
+DEVICE_FUNCTION(void)
+aggcalc_merge_nsum(cl_char *p_accum_dclass,
+				   Datum   *p_accum_datum,
+				   cl_char  newval_dclass,
+				   Datum    newval_datum);
+DEVICE_FUNCTION(void)
+aggcalc_update_nsum(cl_char *p_accum_dclass,
+					Datum   *p_accum_datum,
+					cl_char  newval_dclass,
+					Datum    newval_datum);
+
 #endif	/* __CUDACC__ */
 
 #ifdef __CUDACC_RTC__
@@ -1000,6 +1202,36 @@ kern_gpupreagg_groupby_reduction(kern_gpupreagg *kgpreagg,
 	kern_writeback_error_status(&kgpreagg->kerror, &u.kcxt);
 }
 
+KERNEL_FUNCTION(void)
+kern_gpupreagg_sorted_reduction(kern_gpupreagg *kgpreagg,
+								kern_errorbuf *kgjoin_errorbuf,
+								kern_data_store *kds_slot,
+								kern_data_store *kds_final,
+								kern_global_hashslot *f_hash)
+{
+	kern_parambuf *kparams = KERN_GPUPREAGG_PARAMBUF(kgpreagg);
+	DECL_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	/* f_hash is not referenced, but same arguments as groupby reduction */
+	gpupreagg_sorted_reduction(&u.kcxt,
+							   kgpreagg,
+							   kgjoin_errorbuf,
+							   kds_slot,
+							   kds_final);
+	kern_writeback_error_status(&kgpreagg->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpupreagg_hll_compaction(kern_data_store *kds_final,
+							  cl_int colidx)
+{
+	__shared__ cl_uint	l_hll_regs[(1U << __GPUPREAGG_HLL_REGISTER_BITS) /
+								   sizeof(cl_uint)];
+
+	gpupreagg_hll_compaction(kds_final, colidx, l_hll_regs);
+}
+
 /* public variables */
 __device__ cl_int	GPUPREAGG_NUM_ACCUM_VALUES  = __GPUPREAGG_NUM_ACCUM_VALUES;
 __device__ cl_int	GPUPREAGG_ACCUM_EXTRA_BUFSZ = __GPUPREAGG_ACCUM_EXTRA_BUFSZ;
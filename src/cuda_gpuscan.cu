@@ -60,9 +60,13 @@ gpuscan_main_row(kern_context *kcxt,
 		cl_uint			usage_offset = 0;
 		cl_uint			usage_length = 0;
 		cl_uint			suspend_kernel = 0;
+		cl_bool			recheck = false;
 		cl_char		   *tup_dclass = NULL;
 		Datum		   *tup_values = NULL;
 
+		/* stop the scan, if enough rows are already qualified */
+		if (gpuscan_reached_limit(kgpuscan, kds_dst->nitems))
+			break;
 		/* rewind the varlena buffer */
 		kcxt->vlpos = kcxt->vlbuf;
 		/* Evalidation of the rows by WHERE-clause */
@@ -73,6 +77,14 @@ gpuscan_main_row(kern_context *kcxt,
 			rc = gpuscan_quals_eval(kcxt, kds_src,
 									&tupitem->htup.t_ctid,
 									&tupitem->htup);
+			if (rc && kgpuscan->bloom_nbits > 0)
+				rc = gpuscan_bloom_quals_eval(kcxt, kds_src,
+											  &tupitem->htup.t_ctid,
+											  &tupitem->htup);
+			/* row that raised CpuReCheck is rechecked by CPU later */
+			if (gpuscan_recheck_row(kcxt, __kds_packed((char *)&tupitem->htup -
+													   (char *)kds_src)))
+				rc = false;
 		}
 		/* bailout if any error */
 		if (__syncthreads_count(kcxt->errcode) > 0)
@@ -108,10 +120,20 @@ gpuscan_main_row(kern_context *kcxt,
 													  tup_dclass,
 													  tup_values);
 				}
+				if (gpuscan_recheck_row(kcxt, __kds_packed((char *)&tupitem->htup -
+														   (char *)kds_src)))
+				{
+					rc = false;
+					required = 0;
+					recheck = true;
+				}
 			}
 			/* bailout if any error */
 			if (__syncthreads_count(kcxt->errcode) > 0)
 				break;;
+			/* rows moved to the CPU recheck are not written back */
+			if (__syncthreads_count(recheck) > 0)
+				nitems_offset = pgstromStairlikeBinaryCount(rc, &nvalids);
 			/* allocation of the destination buffer */
 			usage_offset = pgstromStairlikeSum(__kds_packed(required),
 											   &usage_length);
@@ -242,6 +264,9 @@ gpuscan_main_block(kern_context *kcxt,
 		part_base = part_index * window_sz + get_group_id() * n_parts;
 		if (part_base >= kds_src->nitems)
 			break;
+		/* stop the scan, if enough rows are already qualified */
+		if (gpuscan_reached_limit(kgpuscan, kds_dst->nitems))
+			break;
 		part_id = get_local_id() / part_sz + part_base;
 		line_no = get_local_id() % part_sz + line_index * part_sz;
 
@@ -259,6 +284,7 @@ gpuscan_main_block(kern_context *kcxt,
 			cl_uint		usage_length = 0;
 			cl_uint		suspend_kernel = 0;
 			cl_bool		rc = false;
+			cl_bool		recheck = false;
 			cl_char	   *tup_dclass = NULL;
 			Datum	   *tup_values = NULL;
 
@@ -279,9 +305,11 @@ gpuscan_main_block(kern_context *kcxt,
 				{
 					ItemIdData *lpp = PageGetItemId(pg_page, line_no+1);
 					if (ItemIdIsNormal(lpp))
-						htup = PageGetItem(pg_page, lpp);
+						htup = gpuscan_mvcc_visible_tuple(kcxt, pg_page,
+														  PageGetItem(pg_page, lpp));
 					t_len = ItemIdGetLength(lpp);
 				}
+				gpuscan_zonemap_update(kcxt, kds_src, part_id, htup);
 			}
 
 			/* evaluation of the qualifiers */
@@ -291,7 +319,17 @@ gpuscan_main_block(kern_context *kcxt,
 										kds_src,
 										&t_self,
 										htup);
+				if (rc && kgpuscan->bloom_nbits > 0)
+					rc = gpuscan_bloom_quals_eval(kcxt,
+												  kds_src,
+												  &t_self,
+												  htup);
 			}
+			/* row that raised CpuReCheck is rechecked by CPU later */
+			if (thread_is_valid && part_id < kds_src->nitems &&
+				gpuscan_recheck_row(kcxt, GPUSCAN_BLOCK_RESULT_PACK(part_id,
+																	line_no)))
+				rc = false;
 			/* bailout if any error */
 			if (__syncthreads_count(kcxt->errcode) > 0)
 				goto out_nostat;
@@ -326,10 +364,21 @@ gpuscan_main_block(kern_context *kcxt,
 														  tup_dclass,
 														  tup_values);
 					}
+					if (gpuscan_recheck_row(kcxt,
+											GPUSCAN_BLOCK_RESULT_PACK(part_id,
+																	  line_no)))
+					{
+						rc = false;
+						required = 0;
+						recheck = true;
+					}
 				}
 				/* bailout if any error */
 				if (__syncthreads_count(kcxt->errcode) > 0)
 					goto out;
+				/* rows moved to the CPU recheck are not written back */
+				if (__syncthreads_count(recheck) > 0)
+					nitems_offset = pgstromStairlikeBinaryCount(rc, &nvalids);
 				/* allocation of the destination buffer */
 				usage_offset = pgstromStairlikeSum(__kds_packed(required),
 												   &usage_length);
@@ -417,6 +466,412 @@ out_nostat:
 	}
 }
 
+/*
+ * gpuscan_quals_row - GpuScan with selection-vector for KDS_FORMAT_ROW
+ *
+ * It evaluates the device qualifiers, then writes back the offset of the
+ * survived tuples to the gpuscanResultIndex, instead of the copy of tuples.
+ * Host side fetches the tuples from the source data store directly.
+ */
+DEVICE_FUNCTION(void)
+gpuscan_quals_row(kern_context *kcxt,
+				  kern_gpuscan *kgpuscan,
+				  kern_data_store *kds_src)
+{
+	gpuscanResultIndex *gs_results = KERN_GPUSCAN_RESULT_INDEX(kgpuscan);
+	cl_uint		src_index;
+	cl_uint		src_base;
+	cl_uint		total_nitems_in = 0;	/* stat */
+	cl_uint		total_nitems_out = 0;	/* stat */
+	__shared__ cl_uint	dst_nitems_base;
+
+	assert(kds_src->format == KDS_FORMAT_ROW);
+	/* quick bailout if any error happen on the prior kernel */
+	if (__syncthreads_count(kgpuscan->kerror.errcode) != 0)
+		return;
+
+	for (src_base = get_global_base();
+		 src_base < kds_src->nitems;
+		 src_base += get_global_size())
+	{
+		kern_tupitem   *tupitem = NULL;
+		cl_bool			rc = false;
+		cl_uint			nvalids;
+		cl_uint			nitems_offset;
+
+		/* stop the scan, if enough rows are already qualified */
+		if (gpuscan_reached_limit(kgpuscan, gs_results->nitems))
+			break;
+		/* rewind the varlena buffer */
+		kcxt->vlpos = kcxt->vlbuf;
+		/* Evaluation of the rows by WHERE-clause */
+		src_index = src_base + get_local_id();
+		if (src_index < kds_src->nitems)
+		{
+			tupitem = KERN_DATA_STORE_TUPITEM(kds_src, src_index);
+			rc = gpuscan_quals_eval(kcxt, kds_src,
+									&tupitem->htup.t_ctid,
+									&tupitem->htup);
+			if (rc && kgpuscan->bloom_nbits > 0)
+				rc = gpuscan_bloom_quals_eval(kcxt, kds_src,
+											  &tupitem->htup.t_ctid,
+											  &tupitem->htup);
+			/* row that raised CpuReCheck is rechecked by CPU later */
+			if (gpuscan_recheck_row(kcxt, __kds_packed((char *)&tupitem->htup -
+													   (char *)kds_src)))
+				rc = false;
+		}
+		/* bailout if any error */
+		if (__syncthreads_count(kcxt->errcode) > 0)
+			break;
+		/* write back the offset of the survived tuples */
+		nitems_offset = pgstromStairlikeBinaryCount(rc, &nvalids);
+		if (nvalids > 0)
+		{
+			if (get_local_id() == 0)
+				dst_nitems_base = atomicAdd(&gs_results->nitems, nvalids);
+			__syncthreads();
+			if (rc)
+			{
+				gs_results->results[dst_nitems_base + nitems_offset]
+					= __kds_packed((char *)&tupitem->htup -
+								   (char *)kds_src);
+			}
+		}
+		/* update statistics */
+		if (get_local_id() == 0)
+		{
+			total_nitems_in  += Min(kds_src->nitems - src_base,
+									get_local_size());
+			total_nitems_out += nvalids;
+		}
+		__syncthreads();
+	}
+	/* write back statistics */
+	if (get_local_id() == 0)
+	{
+		atomicAdd(&kgpuscan->nitems_in,  total_nitems_in);
+		atomicAdd(&kgpuscan->nitems_out, total_nitems_out);
+	}
+}
+
+/*
+ * gpuscan_quals_block - 1st phase of the late materialization
+ *
+ * It evaluates the device qualifiers on KDS_FORMAT_BLOCK, but deforms only
+ * the columns referenced by the qualifiers. Position of the survived tuples
+ * are written back to the gpuscanResultIndex, then the 2nd phase kernel
+ * (gpuscan_projection_block) makes projection of the selected rows only.
+ */
+DEVICE_FUNCTION(void)
+gpuscan_quals_block(kern_context *kcxt,
+					kern_gpuscan *kgpuscan,
+					kern_data_store *kds_src)
+{
+	gpuscanResultIndex *gs_results = KERN_GPUSCAN_RESULT_INDEX(kgpuscan);
+	cl_uint		part_sz;
+	cl_uint		n_parts;
+	cl_uint		window_sz;
+	cl_uint		part_base;
+	cl_uint		part_index;
+	cl_uint		total_nitems_in = 0;	/* stat */
+	cl_uint		total_nitems_out = 0;	/* stat */
+	cl_bool		thread_is_valid = false;
+	__shared__ cl_uint	dst_nitems_base;
+
+	assert(kds_src->format == KDS_FORMAT_BLOCK);
+	/* quick bailout if any error happen on the prior kernel */
+	if (__syncthreads_count(kgpuscan->kerror.errcode) != 0)
+		return;
+
+	part_sz = KERN_DATA_STORE_PARTSZ(kds_src);
+	n_parts = get_local_size() / part_sz;
+	if (get_global_id() == 0)
+		kgpuscan->part_sz = part_sz;
+	if (get_local_id() < part_sz * n_parts)
+		thread_is_valid = true;
+	window_sz = n_parts * get_num_groups();
+
+	for (part_index = 0; ; part_index++)
+	{
+		cl_uint		part_id;
+		cl_uint		line_no;
+		cl_uint		n_lines = 0;
+
+		part_base = part_index * window_sz + get_group_id() * n_parts;
+		if (part_base >= kds_src->nitems)
+			break;
+		/* stop the scan, if enough rows are already qualified */
+		if (gpuscan_reached_limit(kgpuscan, gs_results->nitems))
+			break;
+		part_id = get_local_id() / part_sz + part_base;
+		line_no = get_local_id() % part_sz;
+
+		do {
+			HeapTupleHeaderData *htup = NULL;
+			ItemPointerData t_self;
+			PageHeaderData *pg_page;
+			BlockNumber	block_nr;
+			cl_uint		nvalids;
+			cl_uint		nitems_real;
+			cl_uint		nitems_offset;
+			cl_bool		rc = false;
+
+			/* rewind the varlena buffer */
+			kcxt->vlpos = kcxt->vlbuf;
+
+			/* identify the block */
+			if (thread_is_valid && part_id < kds_src->nitems)
+			{
+				pg_page = KERN_DATA_STORE_BLOCK_PGPAGE(kds_src, part_id);
+				n_lines = PageGetMaxOffsetNumber(pg_page);
+				block_nr = KERN_DATA_STORE_BLOCK_BLCKNR(kds_src, part_id);
+				t_self.ip_blkid.bi_hi = block_nr >> 16;
+				t_self.ip_blkid.bi_lo = block_nr & 0xffff;
+				t_self.ip_posid = line_no + 1;
+
+				if (line_no < n_lines)
+				{
+					ItemIdData *lpp = PageGetItemId(pg_page, line_no+1);
+					if (ItemIdIsNormal(lpp))
+						htup = gpuscan_mvcc_visible_tuple(kcxt, pg_page,
+														  PageGetItem(pg_page, lpp));
+				}
+				gpuscan_zonemap_update(kcxt, kds_src, part_id, htup);
+			}
+
+			/* evaluation of the qualifiers */
+			if (htup)
+			{
+				rc = gpuscan_quals_eval(kcxt,
+										kds_src,
+										&t_self,
+										htup);
+				if (rc && kgpuscan->bloom_nbits > 0)
+					rc = gpuscan_bloom_quals_eval(kcxt,
+												  kds_src,
+												  &t_self,
+												  htup);
+			}
+			/* bailout if any error */
+			if (__syncthreads_count(kcxt->errcode) > 0)
+				goto out;
+
+			/* write back the position of the survived tuples */
+			nitems_offset = pgstromStairlikeBinaryCount(rc, &nvalids);
+			if (nvalids > 0)
+			{
+				if (get_local_id() == 0)
+					dst_nitems_base = atomicAdd(&gs_results->nitems, nvalids);
+				__syncthreads();
+				if (rc)
+				{
+					gs_results->results[dst_nitems_base + nitems_offset]
+						= GPUSCAN_BLOCK_RESULT_PACK(part_id, line_no);
+				}
+			}
+			/* update statistics */
+			nitems_real = __syncthreads_count(htup != NULL);
+			if (get_local_id() == 0)
+			{
+				total_nitems_in		+= nitems_real;
+				total_nitems_out	+= nvalids;
+			}
+			/* move to the next window of the line items, if any */
+			line_no += part_sz;
+		} while (__syncthreads_count(thread_is_valid &&
+									 line_no < n_lines) > 0);
+	}
+out:
+	/* update statistics */
+	if (get_local_id() == 0)
+	{
+		atomicAdd(&kgpuscan->nitems_in,  total_nitems_in);
+		atomicAdd(&kgpuscan->nitems_out, total_nitems_out);
+	}
+}
+
+/*
+ * gpuscan_projection_block - 2nd phase of the late materialization
+ *
+ * It walks on the gpuscanResultIndex built by the 1st phase, then deforms
+ * and projects the selected rows only. Because all the rows are already
+ * qualified, every thread in a CUDA block shall have a valid row to be
+ * written out, except for the tail of the result index.
+ */
+DEVICE_FUNCTION(void)
+gpuscan_projection_block(kern_context *kcxt,
+						 kern_gpuscan *kgpuscan,
+						 kern_data_store *kds_src,
+						 kern_data_store *kds_dst)
+{
+	gpuscanSuspendContext *my_suspend
+		= KERN_GPUSCAN_SUSPEND_CONTEXT(kgpuscan, get_group_id());
+	gpuscanResultIndex *gs_results = KERN_GPUSCAN_RESULT_INDEX(kgpuscan);
+	cl_uint		part_index = 0;
+	cl_uint		src_index;
+	cl_uint		src_base;
+	cl_uint		total_nitems_in = 0;	/* stat */
+	cl_uint		total_nitems_out = 0;	/* stat */
+	cl_uint		total_extra_size = 0;	/* stat */
+	__shared__ cl_uint	dst_nitems_base;
+	__shared__ cl_uint	dst_usage_base;
+
+	assert(kds_src->format == KDS_FORMAT_BLOCK);
+	assert(kds_dst->format == KDS_FORMAT_SLOT);
+	/* quick bailout if any error happen on the prior kernel */
+	if (__syncthreads_count(kgpuscan->kerror.errcode) != 0)
+		return;
+	/* resume kernel from the point where suspended, if any */
+	if (kgpuscan->resume_context)
+	{
+		assert(my_suspend != NULL);
+		part_index = my_suspend->part_index;
+	}
+
+	for (src_base = get_global_base() + part_index * get_global_size();
+		 src_base < gs_results->nitems;
+		 src_base += get_global_size(), part_index++)
+	{
+		HeapTupleHeaderData *htup = NULL;
+		ItemPointerData t_self;
+		cl_bool		rc = false;
+		cl_uint		nvalids;
+		cl_uint		required = 0;
+		cl_uint		nitems_offset;
+		cl_uint		usage_offset = 0;
+		cl_uint		usage_length = 0;
+		cl_uint		suspend_kernel = 0;
+		cl_char	   *tup_dclass = NULL;
+		Datum	   *tup_values = NULL;
+
+		/* rewind the varlena buffer */
+		kcxt->vlpos = kcxt->vlbuf;
+		/* fetch the tuple already qualified by the 1st phase */
+		src_index = src_base + get_local_id();
+		if (src_index < gs_results->nitems)
+		{
+			cl_uint		code = gs_results->results[src_index];
+			cl_uint		part_id = GPUSCAN_BLOCK_RESULT_PART_ID(code);
+			cl_uint		line_no = GPUSCAN_BLOCK_RESULT_LINE_NO(code);
+			PageHeaderData *pg_page;
+			BlockNumber	block_nr;
+			ItemIdData *lpp;
+
+			pg_page = KERN_DATA_STORE_BLOCK_PGPAGE(kds_src, part_id);
+			block_nr = KERN_DATA_STORE_BLOCK_BLCKNR(kds_src, part_id);
+			t_self.ip_blkid.bi_hi = block_nr >> 16;
+			t_self.ip_blkid.bi_lo = block_nr & 0xffff;
+			t_self.ip_posid = line_no + 1;
+			lpp = PageGetItemId(pg_page, line_no+1);
+			htup = PageGetItem(pg_page, lpp);
+			rc = true;
+		}
+		nitems_offset = pgstromStairlikeBinaryCount(rc, &nvalids);
+		if (nvalids == 0)
+			break;
+		/* extract the source tuple to the private slot */
+		if (rc)
+		{
+			tup_dclass = (cl_char *)
+				kern_context_alloc(kcxt, sizeof(cl_char) * kds_dst->ncols);
+			tup_values = (Datum *)
+				kern_context_alloc(kcxt, sizeof(Datum) * kds_dst->ncols);
+
+			if (!tup_dclass || !tup_values)
+			{
+				STROM_CPU_FALLBACK(kcxt, ERRCODE_OUT_OF_MEMORY,
+								   "out of memory");
+			}
+			else
+			{
+				gpuscan_projection_tuple(kcxt,
+										 kds_src,
+										 htup,
+										 &t_self,
+										 tup_dclass,
+										 tup_values);
+				required = kds_slot_compute_extra(kcxt,
+												  kds_dst,
+												  tup_dclass,
+												  tup_values);
+			}
+		}
+		/* bailout if any error */
+		if (__syncthreads_count(kcxt->errcode) > 0)
+			break;
+		/* allocation of the destination buffer */
+		usage_offset = pgstromStairlikeSum(__kds_packed(required),
+										   &usage_length);
+		if (get_local_id() == 0)
+		{
+			union {
+				struct {
+					cl_uint	nitems;
+					cl_uint	usage;
+				} i;
+				cl_ulong	v64;
+			} oldval, curval, newval;
+
+			curval.i.nitems	= kds_dst->nitems;
+			curval.i.usage	= kds_dst->usage;
+			do {
+				newval = oldval = curval;
+				newval.i.nitems += nvalids;
+				newval.i.usage  += usage_length;
+
+				if (KERN_DATA_STORE_SLOT_LENGTH(kds_dst, newval.i.nitems) +
+					__kds_unpack(newval.i.usage) > kds_dst->length)
+				{
+					atomicAdd(&kgpuscan->suspend_count, 1);
+					suspend_kernel = 1;
+					break;
+				}
+			} while ((curval.v64 = atomicCAS((cl_ulong *)&kds_dst->nitems,
+											 oldval.v64,
+											 newval.v64)) != oldval.v64);
+			dst_nitems_base = oldval.i.nitems;
+			dst_usage_base  = oldval.i.usage;
+		}
+		if (__syncthreads_count(suspend_kernel) > 0)
+			break;
+		/* store the result tuple on the destination buffer */
+		if (rc)
+		{
+			cl_uint	dst_index = dst_nitems_base + nitems_offset;
+			char   *dst_extra = ((char *)kds_dst + kds_dst->length -
+								 __kds_unpack(dst_usage_base +
+											  usage_offset) - required);
+			kds_slot_store_values(kcxt,
+								  kds_dst,
+								  dst_index,
+								  dst_extra,
+								  tup_dclass,
+								  tup_values);
+		}
+		/* update statistics */
+		if (get_local_id() == 0)
+		{
+			total_nitems_in  += nvalids;
+			total_nitems_out += nvalids;
+			total_extra_size += __kds_unpack(usage_length);
+		}
+	}
+	/* write back statistics */
+	if (get_local_id() == 0)
+	{
+		atomicAdd(&kgpuscan->nitems_in,  total_nitems_in);
+		atomicAdd(&kgpuscan->nitems_out, total_nitems_out);
+		atomicAdd(&kgpuscan->extra_size, total_extra_size);
+	}
+	/* suspend the current position (even if normal exit) */
+	if (my_suspend && get_local_id() == 0)
+	{
+		my_suspend->part_index = part_index;
+		my_suspend->line_index = 0;
+	}
+}
+
 /*
  * gpuscan_main_arrow - GpuScan logic for KDS_FORMAT_ARROW
  */
@@ -465,13 +920,20 @@ gpuscan_main_arrow(kern_context *kcxt,
 		cl_char		   *tup_dclass = NULL;
 		Datum		   *tup_values = NULL;
 
+		/* stop the scan, if enough rows are already qualified */
+		if (gpuscan_reached_limit(kgpuscan, kds_dst->nitems))
+			break;
 		/* rewind the varlena buffer */
 		kcxt->vlpos = kcxt->vlbuf;
 
 		/* Evalidation of the rows by WHERE-clause */
 		src_index = src_base + get_local_id();
 		if (src_index < kds_src->nitems)
+		{
 			rc = gpuscan_quals_eval_arrow(kcxt, kds_src, src_index);
+			if (rc && kgpuscan->bloom_nbits > 0)
+				rc = gpuscan_bloom_quals_eval_arrow(kcxt, kds_src, src_index);
+		}
 		else
 			rc = false;
 		/* bailout if any error */
@@ -602,6 +1064,8 @@ gpuscan_main_column(kern_context *kcxt,
 		= KERN_GPUSCAN_SUSPEND_CONTEXT(kgpuscan, get_group_id());
 	cl_uint		part_index = 0;
 	cl_uint		src_base;
+	cl_uint		nrows_scan = kds_src->nitems;
+	cl_uint	   *index_rowids = NULL;
 	cl_uint		total_nitems_in = 0;
 	cl_uint		total_nitems_out = 0;
 	cl_uint		total_extra_size = 0;
@@ -619,12 +1083,29 @@ gpuscan_main_column(kern_context *kcxt,
 		assert(my_suspend != NULL);
 		part_index = my_suspend->part_index;
 	}
+	/* candidate rows by the hash index of GPU cache, if any */
+	if (kgpuscan->gcache_index_enabled)
+	{
+		kern_gpucache_colindex *colindex = kds_get_gpucache_colindex(kds_src);
+
+		if (colindex->magic == KERN_GPUCACHE_COLINDEX_MAGIC &&
+			colindex->nslots > 0)
+		{
+			cl_uint		hindex = (gpucache_colindex_hash(kgpuscan->gcache_index_key) %
+								  colindex->nslots);
+			cl_uint	   *rowids = (cl_uint *)&colindex->slots[colindex->nslots];
+
+			index_rowids = rowids + colindex->slots[hindex].start;
+			nrows_scan = colindex->slots[hindex].count;
+		}
+	}
 
 	for (src_base = get_global_base() + part_index * get_global_size();
-		 src_base < kds_src->nitems;
+		 src_base < nrows_scan;
 		 src_base += get_global_size(), part_index++)
 	{
 		cl_uint		src_index = src_base + get_local_id();
+		cl_uint		row_index = UINT_MAX;
 		cl_bool		rc = false;
 		cl_uint		nvalids;
 		cl_uint		required = 0;
@@ -635,17 +1116,26 @@ gpuscan_main_column(kern_context *kcxt,
 		cl_char	   *tup_dclass = NULL;
 		Datum	   *tup_values = NULL;
 
+		/* stop the scan, if enough rows are already qualified */
+		if (gpuscan_reached_limit(kgpuscan, kds_dst->nitems))
+			break;
 		/* rewind the varlena buffer */
 		kcxt->vlpos = kcxt->vlbuf;
 		/* evaluation of the row using WHERE-clause */
-		if (src_index < kds_src->nitems)
+		if (src_index < nrows_scan)
 		{
-			if (kern_check_visibility_column(kcxt, kds_src, src_index))
+			row_index = (index_rowids ? index_rowids[src_index] : src_index);
+			if (kern_check_visibility_column(kcxt, kds_src, row_index))
 			{
 				rc = gpuscan_quals_eval_column(kcxt,
 											   kds_src,
 											   kds_extra,
-											   src_index);
+											   row_index);
+				if (rc && kgpuscan->bloom_nbits > 0)
+					rc = gpuscan_bloom_quals_eval_column(kcxt,
+														 kds_src,
+														 kds_extra,
+														 row_index);
 			}
 		}
 		/* bailout if any error */
@@ -666,7 +1156,7 @@ gpuscan_main_column(kern_context *kcxt,
 				gpuscan_projection_column(kcxt,
 										  kds_src,
 										  kds_extra,
-										  src_index,
+										  row_index,
 										  tup_dclass,
 										  tup_values);
 				required = kds_slot_compute_extra(kcxt,
@@ -730,7 +1220,7 @@ gpuscan_main_column(kern_context *kcxt,
 		/* update statistics */
 		if (get_local_id() == 0)
 		{
-			total_nitems_in  += Min(kds_src->nitems - src_base,
+			total_nitems_in  += Min(nrows_scan - src_base,
 									get_local_size());
 			total_nitems_out += nvalids;
 			total_extra_size += __kds_unpack(usage_length);
@@ -750,3 +1240,190 @@ gpuscan_main_column(kern_context *kcxt,
 		my_suspend->line_index = 0;
 	}
 }
+
+/*
+ * gpuscan_topn_keycomp - comparison of two rows by the top-N sort keys
+ */
+STATIC_INLINE(cl_int)
+__gpuscan_topn_compare_float(cl_double x, cl_double y)
+{
+	/* NaN is larger than any other values, as PostgreSQL doing */
+	if (isnan(x))
+		return (isnan(y) ? 0 : 1);
+	if (isnan(y))
+		return -1;
+	return (x < y ? -1 : (x > y ? 1 : 0));
+}
+
+STATIC_FUNCTION(cl_int)
+gpuscan_topn_keycomp(kern_gpuscan *kgpuscan,
+					 kern_data_store *kds_dst,
+					 cl_uint x_index,
+					 cl_uint y_index)
+{
+	Datum	   *x_values;
+	Datum	   *y_values;
+	cl_char	   *x_dclass;
+	cl_char	   *y_dclass;
+	cl_uint		i;
+
+	/* invalid index is always located on the tail */
+	if (x_index == GPUSCAN_TOPN_INVALID_INDEX)
+		return (y_index == GPUSCAN_TOPN_INVALID_INDEX ? 0 : 1);
+	if (y_index == GPUSCAN_TOPN_INVALID_INDEX)
+		return -1;
+
+	x_values = KERN_DATA_STORE_VALUES(kds_dst, x_index);
+	x_dclass = KERN_DATA_STORE_DCLASS(kds_dst, x_index);
+	y_values = KERN_DATA_STORE_VALUES(kds_dst, y_index);
+	y_dclass = KERN_DATA_STORE_DCLASS(kds_dst, y_index);
+	for (i=0; i < kgpuscan->topn_nkeys; i++)
+	{
+		gpuscanTopNKey *tkey = &kgpuscan->topn_keys[i];
+		Datum		x = x_values[tkey->colidx];
+		Datum		y = y_values[tkey->colidx];
+		cl_bool		x_isnull = (x_dclass[tkey->colidx] == DATUM_CLASS__NULL);
+		cl_bool		y_isnull = (y_dclass[tkey->colidx] == DATUM_CLASS__NULL);
+		cl_int		comp;
+
+		if (x_isnull || y_isnull)
+		{
+			if (x_isnull && y_isnull)
+				continue;
+			if (x_isnull)
+				return (tkey->nulls_first ? -1 : 1);
+			return (tkey->nulls_first ? 1 : -1);
+		}
+
+		switch (tkey->kind)
+		{
+			case GPUSCAN_TOPN_KEY__INT16:
+				comp = ((cl_short)x < (cl_short)y ? -1 :
+						(cl_short)x > (cl_short)y ? 1 : 0);
+				break;
+			case GPUSCAN_TOPN_KEY__INT32:
+				comp = ((cl_int)x < (cl_int)y ? -1 :
+						(cl_int)x > (cl_int)y ? 1 : 0);
+				break;
+			case GPUSCAN_TOPN_KEY__INT64:
+				comp = ((cl_long)x < (cl_long)y ? -1 :
+						(cl_long)x > (cl_long)y ? 1 : 0);
+				break;
+			case GPUSCAN_TOPN_KEY__FLOAT32:
+				comp = __gpuscan_topn_compare_float(__int_as_float((cl_int)x),
+													__int_as_float((cl_int)y));
+				break;
+			case GPUSCAN_TOPN_KEY__FLOAT64:
+				comp = __gpuscan_topn_compare_float(__longlong_as_double(x),
+													__longlong_as_double(y));
+				break;
+			default:
+				comp = 0;	/* should not happen */
+				break;
+		}
+		if (comp != 0)
+			return (tkey->descending ? -comp : comp);
+	}
+	return 0;
+}
+
+/*
+ * gpuscan_topn_slot
+ *
+ * It reduces the destination buffer (KDS_FORMAT_SLOT) to the top-N rows
+ * according to the sort keys. A single thread-block runs this logic; it
+ * keeps the current top-N rows on the first half of the tile on the shared
+ * memory, loads the next rows on the second half, then sorts the tile by
+ * bitonic-sorting. The rows are not sorted on the output, because Sort node
+ * on the host side makes the final merge anyway.
+ */
+DEVICE_FUNCTION(void)
+gpuscan_topn_slot(kern_context *kcxt,
+				  kern_gpuscan *kgpuscan,
+				  kern_data_store *kds_dst)
+{
+	cl_uint		nitems = kds_dst->nitems;
+	cl_uint		nrows = kgpuscan->topn_nrows;
+	cl_uint		base, i, j, k;
+	__shared__ cl_uint	topn_index[GPUSCAN_TOPN_TILE_SZ];
+	__shared__ Datum	temp_values[GPUSCAN_TOPN_MAX_NROWS];
+	__shared__ cl_char	temp_dclass[GPUSCAN_TOPN_MAX_NROWS];
+
+	assert(kds_dst->format == KDS_FORMAT_SLOT &&
+		   nrows > 0 && nrows <= GPUSCAN_TOPN_MAX_NROWS &&
+		   get_global_size() == get_local_size());
+	/* quick bailout if any error happen in the prior kernel */
+	if (__syncthreads_count(kgpuscan->kerror.errcode) != 0)
+		return;
+	/* nothing to do, if the buffer has no more than N rows */
+	if (nitems <= nrows)
+		return;
+
+	for (i = get_local_id(); i < GPUSCAN_TOPN_TILE_SZ; i += get_local_size())
+		topn_index[i] = GPUSCAN_TOPN_INVALID_INDEX;
+	for (base = 0; base < nitems; base += GPUSCAN_TOPN_TILE_SZ / 2)
+	{
+		/* load the next rows on the second half */
+		for (i = get_local_id();
+			 i < GPUSCAN_TOPN_TILE_SZ / 2;
+			 i += get_local_size())
+		{
+			topn_index[GPUSCAN_TOPN_TILE_SZ / 2 + i]
+				= (base + i < nitems ? base + i : GPUSCAN_TOPN_INVALID_INDEX);
+		}
+		__syncthreads();
+
+		/* bitonic-sorting of the tile */
+		for (k = 2; k <= GPUSCAN_TOPN_TILE_SZ; k *= 2)
+		{
+			for (j = k / 2; j > 0; j /= 2)
+			{
+				for (i = get_local_id();
+					 i < GPUSCAN_TOPN_TILE_SZ / 2;
+					 i += get_local_size())
+				{
+					cl_uint		x = 2 * j * (i / j) + (i % j);
+					cl_uint		y = x + j;
+					cl_uint		x_index = topn_index[x];
+					cl_uint		y_index = topn_index[y];
+					cl_int		comp;
+
+					comp = gpuscan_topn_keycomp(kgpuscan, kds_dst,
+												x_index, y_index);
+					if ((x & k) == 0 ? comp > 0 : comp < 0)
+					{
+						topn_index[x] = y_index;
+						topn_index[y] = x_index;
+					}
+				}
+				__syncthreads();
+			}
+		}
+	}
+
+	/*
+	 * Compaction of the destination buffer; the values are moved column
+	 * by column via the shared memory, because the source row may be
+	 * overwritten by another row. Note that the extra buffer referenced
+	 * by the indirect values is kept as is.
+	 */
+	for (j=0; j < kds_dst->ncols; j++)
+	{
+		for (i = get_local_id(); i < nrows; i += get_local_size())
+		{
+			cl_uint		row_index = topn_index[i];
+
+			temp_values[i] = KERN_DATA_STORE_VALUES(kds_dst, row_index)[j];
+			temp_dclass[i] = KERN_DATA_STORE_DCLASS(kds_dst, row_index)[j];
+		}
+		__syncthreads();
+		for (i = get_local_id(); i < nrows; i += get_local_size())
+		{
+			KERN_DATA_STORE_VALUES(kds_dst, i)[j] = temp_values[i];
+			KERN_DATA_STORE_DCLASS(kds_dst, i)[j] = temp_dclass[i];
+		}
+		__syncthreads();
+	}
+	if (get_local_id() == 0)
+		kds_dst->nitems = nrows;
+}
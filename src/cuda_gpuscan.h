@@ -11,6 +11,143 @@
  */
 #ifndef CUDA_GPUSCAN_H
 #define CUDA_GPUSCAN_H
+/*
+ * gpuscanTopNKey - a sort key of the device side top-N
+ *
+ * It references a fixed-length and pass-by-value column of the destination
+ * buffer (KDS_FORMAT_SLOT), so the comparison does not need any generated
+ * code.
+ */
+#define GPUSCAN_TOPN_KEY__INT16			1
+#define GPUSCAN_TOPN_KEY__INT32			2
+#define GPUSCAN_TOPN_KEY__INT64			3
+#define GPUSCAN_TOPN_KEY__FLOAT32		4
+#define GPUSCAN_TOPN_KEY__FLOAT64		5
+
+typedef struct
+{
+	cl_short	colidx;			/* column index of kds_dst */
+	cl_char		kind;			/* one of GPUSCAN_TOPN_KEY__* */
+	cl_bool		descending;		/* true, if DESC */
+	cl_bool		nulls_first;	/* true, if NULLS FIRST */
+} gpuscanTopNKey;
+
+#define GPUSCAN_TOPN_MAX_KEYS			8
+#define GPUSCAN_TOPN_TILE_SZ			1024
+#define GPUSCAN_TOPN_MAX_NROWS			(GPUSCAN_TOPN_TILE_SZ / 2)
+#define GPUSCAN_TOPN_INVALID_INDEX		(0xffffffffU)
+
+/*
+ * Max number of device qualifiers to be reordered adaptively
+ */
+#define GPUSCAN_MAX_ADAPTIVE_QUALS		8
+
+/*
+ * Bloom-filter pushed down from the parent GpuJoin
+ *
+ * The filter is built from the hash values of the inner hash table, and
+ * the scan kernel drops the rows which never match with the inner rows
+ * prior to write back. Each hash value sets GPUSCAN_BLOOM_NHASHES bits
+ * at the position derived by double-hashing; nbits is always power of 2.
+ */
+#define GPUSCAN_BLOOM_MAX_KEYS			8
+#define GPUSCAN_BLOOM_NHASHES			3
+#define GPUSCAN_BLOOM_BITPOS(hash,k,nbits)						\
+	(((cl_uint)(hash) +											\
+	  (cl_uint)(k) * ((((cl_uint)(hash) >> 17) |					\
+					   ((cl_uint)(hash) << 15)) | 1U)) &		\
+	 ((cl_uint)(nbits) - 1))
+
+/*
+ * Zone-map gathering
+ *
+ * GpuScan kernel on KDS_FORMAT_BLOCK accumulates min/max of the fixed-length
+ * integer columns (int2/int4/int8/date/time/timestamp) for each block, as
+ * a side effect of the scan. The buffer has 2 x zmap_ncols cl_long items
+ * (min and max) per block; host merges them into the zone-map on the shared
+ * memory for the later scans.
+ */
+#define GPUSCAN_ZONEMAP_MAX_COLS		4
+
+/*
+ * Row-level CPU recheck
+ *
+ * When a row raises CpuReCheck error (e.g, varlena buffer overflow or
+ * compressed datum), the kernel records the position of the row on the
+ * recheck buffer, then continues the scan; other rows are still processed
+ * by GPU, and host evaluates only the recorded rows by CPU. The position
+ * is the same form of gpuscanResultIndex. If the buffer is full, kernel
+ * reports the error as usual, then the whole chunk is processed by CPU.
+ */
+#define GPUSCAN_RECHECK_MAX_NROWS		4096
+
+/*
+ * gpuscanSimpleDesc - descriptor of the precompiled GpuScan kernel
+ *
+ * Simple scan qualifiers (comparison of a fixed-length integer, date/time
+ * or float2 column with a constant or a parameter, or IN-list of constants)
+ * and projection of the plain column references are evaluated by the
+ * precompiled kernel (cuda_gpuscan_simple.fatbin) according to this
+ * descriptor, instead of the code generated and built by NVRTC for each
+ * query. It is delivered
+ * as a bytea parameter of kparams; see kern_gpuscan->simple_pindex.
+ */
+#define GPUSCAN_SIMPLE_OP__EQ			1
+#define GPUSCAN_SIMPLE_OP__NE			2
+#define GPUSCAN_SIMPLE_OP__LT			3
+#define GPUSCAN_SIMPLE_OP__LE			4
+#define GPUSCAN_SIMPLE_OP__GT			5
+#define GPUSCAN_SIMPLE_OP__GE			6
+#define GPUSCAN_SIMPLE_OP__IN			7
+
+#define GPUSCAN_SIMPLE_MAX_QUALS		GPUSCAN_MAX_ADAPTIVE_QUALS
+#define GPUSCAN_SIMPLE_MAX_PROJS		64
+#define GPUSCAN_SIMPLE_MAX_ITEMS		256
+#define GPUSCAN_SIMPLE_VARLENA_BUFSZ	1024
+
+typedef struct
+{
+	cl_short	colidx;			/* column index of kds_src */
+	cl_char		collen;			/* width of the column; 1, 2, 4 or 8 */
+	cl_char		opcode;			/* one of GPUSCAN_SIMPLE_OP__* */
+	cl_short	pindex;			/* index of kparams, or -1 if constant */
+	cl_char		paramlen;		/* width of the parameter, if any */
+	cl_bool		is_float2;		/* column and argument are float2 */
+	cl_uint		nitems;			/* # of the constant items */
+	cl_uint		item_index;		/* head of the items; sorted if IN-list */
+} gpuscanSimpleQual;
+
+typedef struct
+{
+	cl_int		vl_len_;		/* varlena header (do not touch directly!) */
+	cl_ushort	nquals;			/* # of the qualifiers */
+	cl_ushort	nprojs;			/* # of the kds_dst columns */
+	gpuscanSimpleQual quals[GPUSCAN_SIMPLE_MAX_QUALS];
+	cl_short	projs[GPUSCAN_SIMPLE_MAX_PROJS];	/* source column index */
+	cl_long		items[FLEXIBLE_ARRAY_MEMBER];	/* widen to 64bit */
+} gpuscanSimpleDesc;
+
+/*
+ * gpuscan_simple_float2_key
+ *
+ * It maps the bit pattern of float2 (IEEE754 half) to the integer key that
+ * keeps the order of the floating point values, so the simple qualifiers
+ * on float2 column are evaluated as integer comparison. All the NaNs are
+ * equal and larger than any other values, and -0.0 equals to +0.0, as
+ * the float2 comparison operators doing.
+ */
+STATIC_INLINE(cl_long)
+gpuscan_simple_float2_key(cl_long value)
+{
+	cl_ushort	bits = (cl_ushort) value;
+
+	if ((bits & 0x7fff) > 0x7c00)
+		return 0x7c01;
+	if ((bits & 0x8000) != 0)
+		return -((cl_long)(bits & 0x7fff));
+	return (cl_long) bits;
+}
+
 /*
  * kern_gpuscan
  */
@@ -22,13 +159,43 @@ struct kern_gpuscan {
 	cl_uint			nitems_in;
 	cl_uint			nitems_out;
 	cl_uint			extra_size;
+	cl_uint			nrows_limit;		/* LIMIT hint, or 0 if unlimited */
+	/* top-N support */
+	cl_uint			topn_nrows;			/* N of top-N, or 0 if not used */
+	cl_uint			topn_nkeys;			/* # of the sort keys */
+	gpuscanTopNKey	topn_keys[GPUSCAN_TOPN_MAX_KEYS];
+	/* adaptive reordering of the device qualifiers */
+	cl_uint			nquals;				/* # of adaptive quals, or 0 */
+	cl_uchar		qual_order[GPUSCAN_MAX_ADAPTIVE_QUALS];
+	cl_uint			qual_nitems_in[GPUSCAN_MAX_ADAPTIVE_QUALS];
+	cl_uint			qual_nitems_out[GPUSCAN_MAX_ADAPTIVE_QUALS];
+	/* bloom-filter from the parent GpuJoin */
+	cl_ulong		bloom_bitmap;		/* device address of the bitmap */
+	cl_uint			bloom_nbits;		/* # of bits, or 0 if not used */
+	/* MVCC snapshot to check non-all-visible pages (only KDS_FORMAT_BLOCK) */
+	cl_ulong		mvcc_snapshot;		/* device address, or 0 if not used */
+	/* zone-map gathering (only KDS_FORMAT_BLOCK) */
+	cl_uint			zmap_ncols;			/* # of columns, or 0 if not used */
+	cl_short		zmap_colidx[GPUSCAN_ZONEMAP_MAX_COLS];
+	cl_char			zmap_collen[GPUSCAN_ZONEMAP_MAX_COLS];
+	cl_ulong		zmap_items;			/* device address of min/max items */
+	/* row-level CPU recheck (only KDS_FORMAT_ROW/BLOCK) */
+	cl_uint			recheck_nrooms;		/* capacity, or 0 if not used */
+	cl_uint			recheck_nitems;		/* # of the rows to be rechecked */
+	cl_ulong		recheck_items;		/* device address of the positions */
+	/* hash index of GPU cache (only KDS_FORMAT_COLUMN) */
+	cl_bool			gcache_index_enabled;
+	cl_ulong		gcache_index_key;	/* zero-extended key value */
+	/* descriptor of the precompiled kernel */
+	cl_int			simple_pindex;		/* index of kparams, or -1 */
 	/* suspend/resume support */
 	cl_uint			suspend_sz;			/* size of suspend context buffer */
 	cl_uint			suspend_count;		/* # of suspended workgroups */
 	cl_bool			resume_context;		/* true, if kernel should resume */
 	kern_parambuf	kparams;
 	/* <-- gpuscanSuspendContext --> */
-	/* <-- gpuscanResultIndex (if KDS_FORMAT_ROW with no projection) -->*/
+	/* <-- gpuscanResultIndex (if selection-vector mode, or
+	 *                         KDS_FORMAT_BLOCK with late materialization) -->*/
 };
 typedef struct kern_gpuscan		kern_gpuscan;
 
@@ -44,6 +211,21 @@ typedef struct
 	cl_uint		results[FLEXIBLE_ARRAY_MEMBER];
 } gpuscanResultIndex;
 
+/*
+ * NOTE: On the late materialization of KDS_FORMAT_BLOCK, the 1st phase
+ * kernel writes back the position of the tuples survived by the device
+ * qualifiers using the gpuscanResultIndex. Each item packs the index of
+ * the block in the KDS and the line-item number (0-origin).
+ * So, number of blocks per KDS must not exceed
+ * GPUSCAN_BLOCK_RESULT_MAX_NBLOCKS; it is bounded on the setup of
+ * NVMEScanState.
+ */
+#define GPUSCAN_BLOCK_RESULT_MAX_NBLOCKS	(1U << 16)
+#define GPUSCAN_BLOCK_RESULT_PACK(part_id,line_no)		\
+	(((cl_uint)(part_id) << 16) | ((cl_uint)(line_no) & 0xffffU))
+#define GPUSCAN_BLOCK_RESULT_PART_ID(code)		((cl_uint)(code) >> 16)
+#define GPUSCAN_BLOCK_RESULT_LINE_NO(code)		((cl_uint)(code) & 0xffffU)
+
 #define KERN_GPUSCAN_PARAMBUF(kgpuscan)			\
 	(&((kern_gpuscan *)(kgpuscan))->kparams)
 #define KERN_GPUSCAN_PARAMBUF_LENGTH(kgpuscan)	\
@@ -64,6 +246,179 @@ typedef struct
 	 KERN_GPUSCAN_PARAMBUF_LENGTH(kgpuscan))
 
 #ifdef __CUDACC__
+/*
+ * gpuscan_reached_limit
+ *
+ * It returns true, if number of the qualified rows already reached the
+ * LIMIT hint, thus no need to scan the remaining rows. All the threads in
+ * a thread-block shall get the same result.
+ */
+STATIC_INLINE(cl_bool)
+gpuscan_reached_limit(kern_gpuscan *kgpuscan, cl_uint nitems)
+{
+	if (kgpuscan->nrows_limit == 0)
+		return false;
+	return (__syncthreads_count(nitems >= kgpuscan->nrows_limit) > 0);
+}
+
+/*
+ * gpuscan_update_qual_stat
+ *
+ * It counts number of the rows evaluated by the device qualifier, and number
+ * of the rows survived, for the adaptive reordering. The generated code can
+ * reference kern_gpuscan via the kern_context, because kparams is always
+ * located on the kern_gpuscan. Counters are aggregated per warp to reduce
+ * atomic operations.
+ */
+#define KERN_GPUSCAN_FROM_CONTEXT(kcxt)					\
+	((kern_gpuscan *)((char *)(kcxt)->kparams -			\
+					  offsetof(kern_gpuscan, kparams)))
+
+STATIC_INLINE(void)
+gpuscan_update_qual_stat(kern_context *kcxt,
+						 cl_uint qual_index,
+						 cl_bool passed)
+{
+	kern_gpuscan *kgpuscan = KERN_GPUSCAN_FROM_CONTEXT(kcxt);
+	cl_uint		mask = __activemask();
+	cl_uint		pmask = __ballot_sync(mask, passed);
+
+	if (LaneId() == __ffs(mask) - 1)
+	{
+		atomicAdd(&kgpuscan->qual_nitems_in[qual_index], __popc(mask));
+		atomicAdd(&kgpuscan->qual_nitems_out[qual_index], __popc(pmask));
+	}
+}
+
+/*
+ * gpuscan_recheck_row
+ *
+ * It records the position of the row on the recheck buffer, and resets
+ * the error status of the thread, if the row raised CpuReCheck error.
+ * It returns true if the row shall be rechecked by CPU later; then, caller
+ * has to handle the row as if it is not qualified. Elsewhere, the error
+ * status remains as is.
+ */
+STATIC_INLINE(cl_bool)
+gpuscan_recheck_row(kern_context *kcxt, cl_uint code)
+{
+	kern_gpuscan *kgpuscan = KERN_GPUSCAN_FROM_CONTEXT(kcxt);
+	cl_uint	   *items = (cl_uint *)kgpuscan->recheck_items;
+	cl_uint		index;
+
+	if ((kcxt->errcode & ERRCODE_FLAGS_CPU_FALLBACK) == 0 ||
+		kgpuscan->recheck_nrooms == 0)
+		return false;
+	index = atomicAdd(&kgpuscan->recheck_nitems, 1);
+	if (index >= kgpuscan->recheck_nrooms)
+		return false;
+	items[index] = code;
+	kcxt->errcode = ERRCODE_STROM_SUCCESS;
+	return true;
+}
+
+/*
+ * gpuscan_bloom_filter_check
+ *
+ * It returns false, if the supplied hash value is never contained in the
+ * inner hash table of the parent GpuJoin.
+ */
+STATIC_INLINE(cl_bool)
+gpuscan_bloom_filter_check(kern_context *kcxt, cl_uint hash)
+{
+	kern_gpuscan *kgpuscan = KERN_GPUSCAN_FROM_CONTEXT(kcxt);
+	cl_uint	   *bitmap = (cl_uint *)kgpuscan->bloom_bitmap;
+	cl_uint		nbits = kgpuscan->bloom_nbits;
+	cl_uint		i, pos;
+
+	if (nbits == 0)
+		return true;
+	for (i=0; i < GPUSCAN_BLOOM_NHASHES; i++)
+	{
+		pos = GPUSCAN_BLOOM_BITPOS(hash, i, nbits);
+		if ((bitmap[pos >> 5] & (1U << (pos & 31))) == 0)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * gpuscan_mvcc_visible_tuple
+ *
+ * It checks visibility of the tuple on the heap block without PD_ALL_VISIBLE,
+ * using the MVCC snapshot of the scan. It returns NULL if the tuple is not
+ * visible, or CPU has to check the visibility instead.
+ */
+STATIC_INLINE(HeapTupleHeaderData *)
+gpuscan_mvcc_visible_tuple(kern_context *kcxt,
+						   PageHeaderData *pg_page,
+						   HeapTupleHeaderData *htup)
+{
+	kern_gpuscan *kgpuscan = KERN_GPUSCAN_FROM_CONTEXT(kcxt);
+	kern_mvcc_snapshot *snap = (kern_mvcc_snapshot *)kgpuscan->mvcc_snapshot;
+	cl_int		rv;
+
+	if (!htup || !snap || (pg_page->pd_flags & PD_ALL_VISIBLE) != 0)
+		return htup;
+	rv = kern_mvcc_check_visibility(snap, htup);
+	if (rv < 0)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+						   "tuple visibility needs CPU check");
+		return NULL;
+	}
+	return (rv > 0 ? htup : NULL);
+}
+
+/*
+ * gpuscan_zonemap_update
+ *
+ * It accumulates min/max of the zone-map columns of the visible tuple on
+ * the @part_id'th block.
+ */
+STATIC_INLINE(void)
+gpuscan_zonemap_update(kern_context *kcxt,
+					   kern_data_store *kds,
+					   cl_uint part_id,
+					   HeapTupleHeaderData *htup)
+{
+	kern_gpuscan *kgpuscan = KERN_GPUSCAN_FROM_CONTEXT(kcxt);
+	cl_long	   *items = (cl_long *)kgpuscan->zmap_items;
+	cl_uint		i, ncols = kgpuscan->zmap_ncols;
+
+	if (!htup || ncols == 0)
+		return;
+	items += 2 * ncols * part_id;
+	for (i=0; i < ncols; i++)
+	{
+		void	   *addr;
+		cl_long		key;
+
+		addr = kern_get_datum_tuple(kds->colmeta, htup,
+									kgpuscan->zmap_colidx[i]);
+		if (!addr)
+			continue;	/* NULL is not a part of the zone-map */
+		switch (kgpuscan->zmap_collen[i])
+		{
+			case sizeof(cl_char):
+				key = *((cl_char *)addr);
+				break;
+			case sizeof(cl_short):
+				key = *((cl_short *)addr);
+				break;
+			case sizeof(cl_int):
+				key = *((cl_int *)addr);
+				break;
+			default:
+				key = *((cl_long *)addr);
+				break;
+		}
+		if (key < items[2*i])
+			atomicMin(&items[2*i], key);
+		if (key > items[2*i+1])
+			atomicMax(&items[2*i+1], key);
+	}
+}
 
 /* to be generated from SQL */
 DEVICE_FUNCTION(cl_bool)
@@ -80,6 +435,20 @@ gpuscan_quals_eval_column(kern_context *kcxt,
 						  kern_data_store *kds,
 						  kern_data_extra *extra,
 						  cl_uint src_index);
+DEVICE_FUNCTION(cl_bool)
+gpuscan_bloom_quals_eval(kern_context *kcxt,
+						 kern_data_store *kds,
+						 ItemPointerData *t_self,
+						 HeapTupleHeaderData *htup);
+DEVICE_FUNCTION(cl_bool)
+gpuscan_bloom_quals_eval_arrow(kern_context *kcxt,
+							   kern_data_store *kds,
+							   cl_uint src_index);
+DEVICE_FUNCTION(cl_bool)
+gpuscan_bloom_quals_eval_column(kern_context *kcxt,
+								kern_data_store *kds,
+								kern_data_extra *extra,
+								cl_uint src_index);
 
 DEVICE_FUNCTION(void)
 gpuscan_projection_tuple(kern_context *kcxt,
@@ -117,6 +486,19 @@ gpuscan_main_block(kern_context *kcxt,
 				   kern_data_store *kds_dst,
 				   bool has_device_projection);
 DEVICE_FUNCTION(void)
+gpuscan_quals_row(kern_context *kcxt,
+				  kern_gpuscan *kgpuscan,
+				  kern_data_store *kds_src);
+DEVICE_FUNCTION(void)
+gpuscan_quals_block(kern_context *kcxt,
+					kern_gpuscan *kgpuscan,
+					kern_data_store *kds_src);
+DEVICE_FUNCTION(void)
+gpuscan_projection_block(kern_context *kcxt,
+						 kern_gpuscan *kgpuscan,
+						 kern_data_store *kds_src,
+						 kern_data_store *kds_dst);
+DEVICE_FUNCTION(void)
 gpuscan_main_arrow(kern_context *kcxt,
 				   kern_gpuscan *kgpuscan,
 				   kern_data_store *kds_src,
@@ -128,6 +510,10 @@ gpuscan_main_column(kern_context *kcxt,
                     kern_data_store *kds_src,
                     kern_data_extra *kds_extra,
                     kern_data_store *kds_dst);
+DEVICE_FUNCTION(void)
+gpuscan_topn_slot(kern_context *kcxt,
+				  kern_gpuscan *kgpuscan,
+				  kern_data_store *kds_dst);
 #endif	/* __CUDACC__ */
 #ifdef __CUDACC_RTC__
 /*
@@ -163,6 +549,48 @@ kern_gpuscan_main_block(kern_gpuscan *kgpuscan,
 	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
 }
 
+KERNEL_FUNCTION(void)
+kern_gpuscan_quals_row(kern_gpuscan *kgpuscan,
+					   kern_data_store *kds_src,
+					   kern_data_extra *__not_valid__,
+					   kern_data_store *__kds_dst_not_valid__)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_quals_row(&u.kcxt, kgpuscan, kds_src);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuscan_quals_block(kern_gpuscan *kgpuscan,
+						 kern_data_store *kds_src,
+						 kern_data_extra *__not_valid__,
+						 kern_data_store *__kds_dst_not_valid__)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_quals_block(&u.kcxt, kgpuscan, kds_src);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuscan_projection_block(kern_gpuscan *kgpuscan,
+							  kern_data_store *kds_src,
+							  kern_data_extra *__not_valid__,
+							  kern_data_store *kds_dst)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_projection_block(&u.kcxt, kgpuscan, kds_src, kds_dst);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
 KERNEL_FUNCTION(void)
 kern_gpuscan_main_arrow(kern_gpuscan *kgpuscan,
 						kern_data_store *kds_src,
@@ -196,5 +624,17 @@ kern_gpuscan_main_column(kern_gpuscan *kgpuscan,
 	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
 }
 
+KERNEL_FUNCTION(void)
+kern_gpuscan_topn_slot(kern_gpuscan *kgpuscan,
+					   kern_data_store *kds_dst)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_topn_slot(&u.kcxt, kgpuscan, kds_dst);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
 #endif	/* __CUDACC_RTC__ */
 #endif	/* CUDA_GPUSCAN_H */
@@ -0,0 +1,493 @@
+/*
+ * cuda_gpuscan_simple.cu
+ *
+ * Precompiled GpuScan kernel for simple scan qualifiers
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include "cuda_common.h"
+#include "cuda_gpuscan.h"
+#include "cuda_gcache.h"
+
+/*
+ * NOTE: This module replaces the code generated by gpuscan.c, so it is
+ * linked with cuda_gpuscan.fatbin and others without the PTX image
+ * built by NVRTC. The qualifiers and the projection are evaluated
+ * according to the gpuscanSimpleDesc delivered on the kparams.
+ */
+#define KERN_CONTEXT_VARLENA_BUFSZ		GPUSCAN_SIMPLE_VARLENA_BUFSZ
+#define KERN_CONTEXT_STACK_LIMIT		1024
+
+#define DECL_SIMPLE_KERNEL_CONTEXT(NAME)						\
+	union {														\
+		kern_context kcxt;										\
+		char __dummy__[offsetof(kern_context, vlbuf) +			\
+					   MAXALIGN(KERN_CONTEXT_VARLENA_BUFSZ)];	\
+	} NAME
+
+STATIC_INLINE(gpuscanSimpleDesc *)
+gpuscan_simple_desc(kern_context *kcxt)
+{
+	kern_gpuscan   *kgpuscan = KERN_GPUSCAN_FROM_CONTEXT(kcxt);
+
+	assert(kgpuscan->simple_pindex >= 0);
+	return (gpuscanSimpleDesc *)
+		kparam_get_value(kcxt->kparams, kgpuscan->simple_pindex);
+}
+
+STATIC_INLINE(cl_bool)
+gpuscan_simple_read_int(void *addr, cl_int width, cl_long *p_value)
+{
+	switch (width)
+	{
+		case sizeof(cl_char):
+			*p_value = *((cl_char *)addr);
+			break;
+		case sizeof(cl_short):
+			*p_value = *((cl_short *)addr);
+			break;
+		case sizeof(cl_int):
+			*p_value = *((cl_int *)addr);
+			break;
+		case sizeof(cl_long):
+			*p_value = *((cl_long *)addr);
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+/*
+ * gpuscan_simple_qual_eval
+ *
+ * It evaluates a simple qualifier on the datum at @addr. NULL is never
+ * qualified, like the strict operators.
+ */
+STATIC_FUNCTION(cl_bool)
+gpuscan_simple_qual_eval(kern_context *kcxt,
+						 gpuscanSimpleDesc *sdesc,
+						 gpuscanSimpleQual *squal,
+						 void *addr)
+{
+	cl_long	   *items = sdesc->items + squal->item_index;
+	cl_long		value;
+	cl_long		arg;
+
+	if (!addr)
+		return false;
+	if (!gpuscan_simple_read_int(addr, squal->collen, &value))
+	{
+		STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,
+					  "unexpected width of the column");
+		return false;
+	}
+	if (squal->is_float2)
+		value = gpuscan_simple_float2_key(value);
+
+	if (squal->opcode == GPUSCAN_SIMPLE_OP__IN)
+	{
+		cl_uint		head = 0;
+		cl_uint		tail = squal->nitems;
+		cl_uint		curr;
+
+		/* binary search on the sorted items */
+		while (head < tail)
+		{
+			curr = (head + tail) / 2;
+			if (items[curr] == value)
+				return true;
+			if (items[curr] < value)
+				head = curr + 1;
+			else
+				tail = curr;
+		}
+		return false;
+	}
+
+	if (squal->pindex < 0)
+	{
+		assert(squal->nitems == 1);
+		arg = items[0];
+	}
+	else
+	{
+		void   *pval = kparam_get_value(kcxt->kparams, squal->pindex);
+
+		if (!pval)
+			return false;
+		if (!gpuscan_simple_read_int(pval, squal->paramlen, &arg))
+		{
+			STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,
+						  "unexpected width of the parameter");
+			return false;
+		}
+		if (squal->is_float2)
+			arg = gpuscan_simple_float2_key(arg);
+	}
+
+	switch (squal->opcode)
+	{
+		case GPUSCAN_SIMPLE_OP__EQ:
+			return (value == arg);
+		case GPUSCAN_SIMPLE_OP__NE:
+			return (value != arg);
+		case GPUSCAN_SIMPLE_OP__LT:
+			return (value <  arg);
+		case GPUSCAN_SIMPLE_OP__LE:
+			return (value <= arg);
+		case GPUSCAN_SIMPLE_OP__GT:
+			return (value >  arg);
+		case GPUSCAN_SIMPLE_OP__GE:
+			return (value >= arg);
+		default:
+			STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,
+						  "unknown simple qualifier");
+			break;
+	}
+	return false;
+}
+
+/*
+ * __gpuscan_simple_quals_eval
+ *
+ * Either of @htup (KDS_FORMAT_ROW/BLOCK) or @kds+@row_index (KDS_FORMAT_COLUMN)
+ * is the source of the datum. The qualifiers are evaluated in the order of
+ * kgpuscan->qual_order[], if adaptive reordering is enabled.
+ */
+STATIC_FUNCTION(cl_bool)
+__gpuscan_simple_quals_eval(kern_context *kcxt,
+							kern_data_store *kds,
+							HeapTupleHeaderData *htup,
+							kern_data_extra *extra,
+							cl_uint row_index)
+{
+	kern_gpuscan   *kgpuscan = KERN_GPUSCAN_FROM_CONTEXT(kcxt);
+	gpuscanSimpleDesc *sdesc = gpuscan_simple_desc(kcxt);
+	gpuscanSimpleQual *squal;
+	cl_uint		i, qual_index;
+	cl_bool		status;
+	void	   *addr;
+
+	if (!sdesc)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,
+					  "simple GpuScan descriptor is missing");
+		return false;
+	}
+	for (i=0; i < sdesc->nquals; i++)
+	{
+		qual_index = (kgpuscan->nquals > 0 ? kgpuscan->qual_order[i] : i);
+		if (qual_index < sdesc->nquals)
+		{
+			squal = &sdesc->quals[qual_index];
+			if (kds->format == KDS_FORMAT_COLUMN)
+				addr = kern_get_datum_column(kds, extra,
+											 squal->colidx, row_index);
+			else if (htup)
+				addr = kern_get_datum_tuple(kds->colmeta, htup,
+											squal->colidx);
+			else
+				addr = NULL;
+			status = gpuscan_simple_qual_eval(kcxt, sdesc, squal, addr);
+		}
+		else
+			status = false;
+		if (kgpuscan->nquals > 0)
+			gpuscan_update_qual_stat(kcxt, qual_index, status);
+		if (!status)
+			return false;
+	}
+	return true;
+}
+
+DEVICE_FUNCTION(cl_bool)
+gpuscan_quals_eval(kern_context *kcxt,
+				   kern_data_store *kds,
+				   ItemPointerData *t_self,
+				   HeapTupleHeaderData *htup)
+{
+	return __gpuscan_simple_quals_eval(kcxt, kds, htup, NULL, 0);
+}
+
+DEVICE_FUNCTION(cl_bool)
+gpuscan_quals_eval_arrow(kern_context *kcxt,
+						 kern_data_store *kds,
+						 cl_uint src_index)
+{
+	STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,
+				  "simple GpuScan does not support Apache Arrow");
+	return false;
+}
+
+DEVICE_FUNCTION(cl_bool)
+gpuscan_quals_eval_column(kern_context *kcxt,
+						  kern_data_store *kds,
+						  kern_data_extra *extra,
+						  cl_uint src_index)
+{
+	return __gpuscan_simple_quals_eval(kcxt, kds, NULL, extra, src_index);
+}
+
+/*
+ * simple GpuScan never has bloom-filter from the parent GpuJoin
+ */
+DEVICE_FUNCTION(cl_bool)
+gpuscan_bloom_quals_eval(kern_context *kcxt,
+						 kern_data_store *kds,
+						 ItemPointerData *t_self,
+						 HeapTupleHeaderData *htup)
+{
+	return true;
+}
+
+DEVICE_FUNCTION(cl_bool)
+gpuscan_bloom_quals_eval_arrow(kern_context *kcxt,
+							   kern_data_store *kds,
+							   cl_uint src_index)
+{
+	return true;
+}
+
+DEVICE_FUNCTION(cl_bool)
+gpuscan_bloom_quals_eval_column(kern_context *kcxt,
+								kern_data_store *kds,
+								kern_data_extra *extra,
+								cl_uint src_index)
+{
+	return true;
+}
+
+/*
+ * gpuscan_simple_store_datum
+ */
+STATIC_INLINE(void)
+gpuscan_simple_store_datum(kern_colmeta *cmeta, void *addr,
+						   cl_char &dclass, Datum &value)
+{
+	if (!addr)
+		dclass = DATUM_CLASS__NULL;
+	else if (!cmeta->attbyval)
+	{
+		dclass = DATUM_CLASS__NORMAL;
+		value = PointerGetDatum(addr);
+	}
+	else
+	{
+		dclass = DATUM_CLASS__NORMAL;
+		switch (cmeta->attlen)
+		{
+			case sizeof(cl_char):
+				value = READ_INT8_PTR(addr);
+				break;
+			case sizeof(cl_short):
+				value = READ_INT16_PTR(addr);
+				break;
+			case sizeof(cl_int):
+				value = READ_INT32_PTR(addr);
+				break;
+			case sizeof(cl_long):
+				value = READ_INT64_PTR(addr);
+				break;
+			default:
+				dclass = DATUM_CLASS__NULL;
+				break;
+		}
+	}
+}
+
+DEVICE_FUNCTION(void)
+gpuscan_projection_tuple(kern_context *kcxt,
+						 kern_data_store *kds_src,
+						 HeapTupleHeaderData *htup,
+						 ItemPointerData *t_self,
+						 cl_char *tup_dclass,
+						 Datum *tup_values)
+{
+	gpuscanSimpleDesc *sdesc = gpuscan_simple_desc(kcxt);
+	cl_int		j, natts = 0;
+
+	if (!sdesc)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,
+					  "simple GpuScan descriptor is missing");
+		return;
+	}
+	for (j=0; j < sdesc->nprojs; j++)
+	{
+		tup_dclass[j] = DATUM_CLASS__NULL;
+		natts = Max(natts, sdesc->projs[j] + 1);
+	}
+	EXTRACT_HEAP_TUPLE_BEGIN(kds_src, htup, natts);
+	for (j=0; j < sdesc->nprojs; j++)
+	{
+		if (sdesc->projs[j] == __colidx)
+			gpuscan_simple_store_datum(&kds_src->colmeta[__colidx], addr,
+									   tup_dclass[j], tup_values[j]);
+	}
+	EXTRACT_HEAP_TUPLE_END();
+}
+
+DEVICE_FUNCTION(void)
+gpuscan_projection_arrow(kern_context *kcxt,
+						 kern_data_store *kds_src,
+						 size_t src_index,
+						 cl_char *tup_dclass,
+						 Datum *tup_values)
+{
+	STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,
+				  "simple GpuScan does not support Apache Arrow");
+}
+
+DEVICE_FUNCTION(void)
+gpuscan_projection_column(kern_context *kcxt,
+						  kern_data_store *kds_src,
+						  kern_data_extra *kds_extra,
+						  size_t src_index,
+						  cl_char *tup_dclass,
+						  Datum *tup_values)
+{
+	gpuscanSimpleDesc *sdesc = gpuscan_simple_desc(kcxt);
+	cl_int		j, colidx;
+	void	   *addr;
+
+	if (!sdesc)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_STROM_WRONG_CODE_GENERATION,
+					  "simple GpuScan descriptor is missing");
+		return;
+	}
+	for (j=0; j < sdesc->nprojs; j++)
+	{
+		colidx = sdesc->projs[j];
+		if (colidx < 0)
+		{
+			tup_dclass[j] = DATUM_CLASS__NULL;
+			continue;
+		}
+		addr = kern_get_datum_column(kds_src, kds_extra, colidx, src_index);
+		gpuscan_simple_store_datum(&kds_src->colmeta[colidx], addr,
+								   tup_dclass[j], tup_values[j]);
+	}
+}
+
+/*
+ * GPU kernel entrypoint - same as those in cuda_gpuscan.h for NVRTC
+ */
+KERNEL_FUNCTION(void)
+kern_gpuscan_main_row(kern_gpuscan *kgpuscan,
+					  kern_data_store *kds_src,
+					  kern_data_extra *__not_valid__,
+					  kern_data_store *kds_dst)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_SIMPLE_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_main_row(&u.kcxt, kgpuscan, kds_src, kds_dst, true);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuscan_main_block(kern_gpuscan *kgpuscan,
+						kern_data_store *kds_src,
+						kern_data_extra *__not_valid__,
+						kern_data_store *kds_dst)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_SIMPLE_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_main_block(&u.kcxt, kgpuscan, kds_src, kds_dst, true);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuscan_quals_row(kern_gpuscan *kgpuscan,
+					   kern_data_store *kds_src,
+					   kern_data_extra *__not_valid__,
+					   kern_data_store *__kds_dst_not_valid__)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_SIMPLE_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_quals_row(&u.kcxt, kgpuscan, kds_src);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuscan_quals_block(kern_gpuscan *kgpuscan,
+						 kern_data_store *kds_src,
+						 kern_data_extra *__not_valid__,
+						 kern_data_store *__kds_dst_not_valid__)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_SIMPLE_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_quals_block(&u.kcxt, kgpuscan, kds_src);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuscan_projection_block(kern_gpuscan *kgpuscan,
+							  kern_data_store *kds_src,
+							  kern_data_extra *__not_valid__,
+							  kern_data_store *kds_dst)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_SIMPLE_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_projection_block(&u.kcxt, kgpuscan, kds_src, kds_dst);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuscan_main_arrow(kern_gpuscan *kgpuscan,
+						kern_data_store *kds_src,
+						kern_data_extra *__not_valid__,
+						kern_data_store *kds_dst)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_SIMPLE_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_main_arrow(&u.kcxt, kgpuscan, kds_src, kds_dst, true);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuscan_main_column(kern_gpuscan *kgpuscan,
+						 kern_data_store *kds_src,
+						 kern_data_extra *kds_extra,
+						 kern_data_store *kds_dst)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_SIMPLE_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_main_column(&u.kcxt,
+						kgpuscan,
+						kds_src,
+						kds_extra,
+						kds_dst);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
+
+KERNEL_FUNCTION(void)
+kern_gpuscan_topn_slot(kern_gpuscan *kgpuscan,
+					   kern_data_store *kds_dst)
+{
+	kern_parambuf *kparams = KERN_GPUSCAN_PARAMBUF(kgpuscan);
+	DECL_SIMPLE_KERNEL_CONTEXT(u);
+
+	INIT_KERNEL_CONTEXT(&u.kcxt, kparams);
+	gpuscan_topn_slot(&u.kcxt, kgpuscan, kds_dst);
+	kern_writeback_error_status(&kgpuscan->kerror, &u.kcxt);
+}
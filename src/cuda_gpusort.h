@@ -39,6 +39,113 @@ typedef struct {
 #define BITONIC_MAX_LOCAL_SHIFT		12
 #define BITONIC_MAX_LOCAL_SZ		(1<<BITONIC_MAX_LOCAL_SHIFT)
 
+/*
+ * kern_gpusort_radix - LSD radix sort on the normalized keys
+ *
+ * The precompiled kernels (cuda_gpusort_radix.fatbin) sort a chunk of the
+ * GpuSort on the fixed-length and pass-by-value keys, so no generated code
+ * is needed. Each key is normalized to an unsigned integer whose byte-wise
+ * order is identical to the ORDER BY; signed integers flip the sign bit,
+ * floating-point values flip all the bits if negative or the sign bit
+ * elsewhere, and DESC inverts the bits. The last word of the row has one
+ * bit per key to sort NULLs (set, if the row goes later).
+ *
+ * Every radix pass consists of a histogram per tile, a global exclusive
+ * scan, then a stable scatter of the row index. A pass whose digits are
+ * all identical is skipped. Rows are never moved; the kernel permutes the
+ * row index only, then the host merges the chunks by the normalized keys.
+ */
+#define GPUSORT_KEY__INT16			1
+#define GPUSORT_KEY__INT32			2
+#define GPUSORT_KEY__INT64			3
+#define GPUSORT_KEY__FLOAT32		4
+#define GPUSORT_KEY__FLOAT64		5
+
+typedef struct
+{
+	cl_short	colidx;			/* column index of kds_src */
+	cl_char		kind;			/* one of GPUSORT_KEY__* */
+	cl_bool		descending;		/* true, if DESC */
+	cl_bool		nulls_first;	/* true, if NULLS FIRST */
+} gpusortRadixKey;
+
+#define GPUSORT_RADIX_MAX_KEYS		8
+#define GPUSORT_RADIX_BITS			8
+#define GPUSORT_RADIX_NBINS			(1U << GPUSORT_RADIX_BITS)
+#define GPUSORT_RADIX_BLOCKSZ		GPUSORT_RADIX_NBINS	/* 1 thread per bin */
+#define GPUSORT_RADIX_NWARPS		(GPUSORT_RADIX_BLOCKSZ / 32)
+#define GPUSORT_RADIX_TILESZ		4096
+#define GPUSORT_RADIX_NTILES(nitems)							\
+	(((nitems) + GPUSORT_RADIX_TILESZ - 1) / GPUSORT_RADIX_TILESZ)
+
+typedef struct
+{
+	cl_uint		nitems;			/* # of rows to be sorted */
+	cl_uint		ntiles;			/* = GPUSORT_RADIX_NTILES(nitems) */
+	cl_uint		nkeys;			/* # of the sort keys */
+	cl_uint		curr;			/* index[] that has the current order */
+	cl_bool		pass_skip;		/* true, if the last pass is skipped */
+	gpusortRadixKey keys[GPUSORT_RADIX_MAX_KEYS];
+	/* offset of the arrays below, from the head of this structure */
+	cl_ulong	keys_offset;	/* cl_ulong [nitems * (nkeys+1)] */
+	cl_ulong	index_offset[2];/* cl_uint [nitems] x2 */
+	cl_ulong	hist_offset;	/* cl_uint [NBINS * ntiles] */
+} kern_gpusort_radix;
+
+#define KERN_GPUSORT_RADIX_NWORDS(kradix)		((kradix)->nkeys + 1)
+#define KERN_GPUSORT_RADIX_KEYS(kradix)						\
+	((cl_ulong *)((char *)(kradix) + (kradix)->keys_offset))
+#define KERN_GPUSORT_RADIX_INDEX(kradix,i)					\
+	((cl_uint *)((char *)(kradix) + (kradix)->index_offset[(i)]))
+#define KERN_GPUSORT_RADIX_HIST(kradix)						\
+	((cl_uint *)((char *)(kradix) + (kradix)->hist_offset))
+/* index[] that has the result of the last pass */
+#define KERN_GPUSORT_RADIX_RESULT(kradix)					\
+	KERN_GPUSORT_RADIX_INDEX((kradix), ((kradix)->curr ^		\
+										((kradix)->pass_skip ? 0 : 1)))
+
+/*
+ * gpusort_radix_key_nbytes - width of the normalized key
+ */
+STATIC_INLINE(cl_int)
+gpusort_radix_key_nbytes(cl_int kind)
+{
+	switch (kind)
+	{
+		case GPUSORT_KEY__INT16:
+			return sizeof(cl_short);
+		case GPUSORT_KEY__INT32:
+		case GPUSORT_KEY__FLOAT32:
+			return sizeof(cl_int);
+		case GPUSORT_KEY__INT64:
+		case GPUSORT_KEY__FLOAT64:
+			return sizeof(cl_long);
+	}
+	return 0;
+}
+
+/*
+ * gpusort_radix_compare - comparison of the normalized keys on the host
+ */
+STATIC_INLINE(cl_int)
+gpusort_radix_compare(const cl_ulong *x, const cl_ulong *y, cl_uint nkeys)
+{
+	cl_ulong	x_nulls = x[nkeys];
+	cl_ulong	y_nulls = y[nkeys];
+	cl_uint		i;
+
+	for (i=0; i < nkeys; i++)
+	{
+		cl_ulong	mask = (1UL << i);
+
+		if ((x_nulls & mask) != (y_nulls & mask))
+			return ((x_nulls & mask) != 0 ? 1 : -1);
+		if (x[i] != y[i])
+			return (x[i] > y[i] ? 1 : -1);
+	}
+	return 0;
+}
+
 #ifdef __CUDACC__
 /*
  * gpusort_quals_eval - evaluation of device qualifier
@@ -0,0 +1,363 @@
+/*
+ * cuda_gpusort_radix.cu
+ *
+ * Precompiled radix sort kernels of GpuSort
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include "cuda_common.h"
+#include "cuda_gpusort.h"
+
+/*
+ * NOTE: This module is linked with cuda_common.fatbin without any PTX image
+ * built by NVRTC, like cuda_gpuscan_simple.fatbin. The sort keys are given
+ * by kern_gpusort_radix, and all the kernels except for the setup must be
+ * launched with GPUSORT_RADIX_BLOCKSZ threads per block.
+ */
+
+/*
+ * gpusort_radix_normalize
+ *
+ * It transforms a datum to the unsigned integer that has identical order
+ * to the btree comparison; NaN is greater than any other values, and the
+ * negative zero is equal to the positive zero.
+ */
+STATIC_INLINE(cl_ulong)
+gpusort_radix_normalize(gpusortRadixKey *rkey, cl_ulong value)
+{
+	cl_ulong	mask;
+
+	switch (rkey->kind)
+	{
+		case GPUSORT_KEY__INT16:
+			value = (value ^ 0x8000UL) & 0xffffUL;
+			mask = 0xffffUL;
+			break;
+		case GPUSORT_KEY__INT32:
+			value = (value ^ 0x80000000UL) & 0xffffffffUL;
+			mask = 0xffffffffUL;
+			break;
+		case GPUSORT_KEY__INT64:
+			value = (value ^ 0x8000000000000000UL);
+			mask = ~0UL;
+			break;
+		case GPUSORT_KEY__FLOAT32:
+			{
+				cl_float	fval = __int_as_float((cl_uint)value);
+
+				if (isnan(fval))
+					value = 0x7fc00000UL;
+				else if (fval == 0.0)
+					value = 0UL;
+				else
+					value &= 0xffffffffUL;
+				if ((value & 0x80000000UL) != 0)
+					value = (~value & 0xffffffffUL);
+				else
+					value |= 0x80000000UL;
+			}
+			mask = 0xffffffffUL;
+			break;
+		case GPUSORT_KEY__FLOAT64:
+			{
+				cl_double	fval = __longlong_as_double(value);
+
+				if (isnan(fval))
+					value = 0x7ff8000000000000UL;
+				else if (fval == 0.0)
+					value = 0UL;
+				if ((value & 0x8000000000000000UL) != 0)
+					value = ~value;
+				else
+					value |= 0x8000000000000000UL;
+			}
+			mask = ~0UL;
+			break;
+		default:
+			return 0UL;		/* should not happen */
+	}
+	return (rkey->descending ? (~value & mask) : value);
+}
+
+/*
+ * gpusort_radix_fetch_datum
+ *
+ * It fetches the datum of the key column; only KDS_FORMAT_ROW and
+ * KDS_FORMAT_SLOT are supported.
+ */
+STATIC_INLINE(cl_bool)
+gpusort_radix_fetch_datum(kern_data_store *kds_src,
+						  cl_uint row_index,
+						  gpusortRadixKey *rkey,
+						  cl_ulong *p_value)
+{
+	if (kds_src->format == KDS_FORMAT_SLOT)
+	{
+		Datum  *values = KERN_DATA_STORE_VALUES(kds_src, row_index);
+		cl_char *dclass = KERN_DATA_STORE_DCLASS(kds_src, row_index);
+
+		if (dclass[rkey->colidx] == DATUM_CLASS__NULL)
+			return false;
+		*p_value = values[rkey->colidx];
+	}
+	else
+	{
+		kern_tupitem   *tupitem = KERN_DATA_STORE_TUPITEM(kds_src, row_index);
+		void		   *addr;
+
+		if (!tupitem)
+			return false;
+		addr = kern_get_datum_tuple(kds_src->colmeta,
+									&tupitem->htup,
+									rkey->colidx);
+		if (!addr)
+			return false;
+		switch (gpusort_radix_key_nbytes(rkey->kind))
+		{
+			case sizeof(cl_short):
+				*p_value = *((cl_ushort *)addr);
+				break;
+			case sizeof(cl_int):
+				*p_value = *((cl_uint *)addr);
+				break;
+			default:
+				*p_value = *((cl_ulong *)addr);
+				break;
+		}
+	}
+	return true;
+}
+
+/*
+ * kern_gpusort_radix_setup
+ *
+ * It builds the normalized keys of the rows, and the initial row index.
+ */
+KERNEL_FUNCTION(void)
+kern_gpusort_radix_setup(kern_gpusort_radix *kradix,
+						 kern_data_store *kds_src)
+{
+	cl_ulong   *keys = KERN_GPUSORT_RADIX_KEYS(kradix);
+	cl_uint	   *index = KERN_GPUSORT_RADIX_INDEX(kradix, 0);
+	cl_uint		nwords = KERN_GPUSORT_RADIX_NWORDS(kradix);
+	cl_uint		row_index;
+	cl_uint		i;
+
+	for (row_index = get_global_id();
+		 row_index < kradix->nitems;
+		 row_index += get_global_size())
+	{
+		cl_ulong   *rkeys = keys + (size_t)row_index * nwords;
+		cl_ulong	nulls = 0;
+
+		for (i=0; i < kradix->nkeys; i++)
+		{
+			gpusortRadixKey *rkey = &kradix->keys[i];
+			cl_ulong	value;
+
+			if (gpusort_radix_fetch_datum(kds_src, row_index, rkey, &value))
+			{
+				rkeys[i] = gpusort_radix_normalize(rkey, value);
+				if (rkey->nulls_first)
+					nulls |= (1UL << i);
+			}
+			else
+			{
+				rkeys[i] = 0;
+				if (!rkey->nulls_first)
+					nulls |= (1UL << i);
+			}
+		}
+		rkeys[kradix->nkeys] = nulls;
+		index[row_index] = row_index;
+	}
+}
+
+/*
+ * kern_gpusort_radix_histogram
+ *
+ * It counts the digits of the current pass for each tile. The histogram is
+ * stored in digit-major order, so its exclusive scan gives the destination
+ * of the tile for each digit.
+ */
+KERNEL_FUNCTION(void)
+kern_gpusort_radix_histogram(kern_gpusort_radix *kradix,
+							 cl_uint word, cl_uint shift, cl_uint mask)
+{
+	cl_ulong   *keys = KERN_GPUSORT_RADIX_KEYS(kradix);
+	cl_uint	   *index = KERN_GPUSORT_RADIX_RESULT(kradix);
+	cl_uint	   *hist = KERN_GPUSORT_RADIX_HIST(kradix);
+	cl_uint		nwords = KERN_GPUSORT_RADIX_NWORDS(kradix);
+	cl_uint		base = get_group_id() * GPUSORT_RADIX_TILESZ;
+	cl_uint		tail = Min(base + GPUSORT_RADIX_TILESZ, kradix->nitems);
+	cl_uint		i;
+	__shared__ cl_uint s_hist[GPUSORT_RADIX_NBINS];
+
+	assert(get_local_size() == GPUSORT_RADIX_BLOCKSZ);
+	s_hist[get_local_id()] = 0;
+	__syncthreads();
+	for (i = base + get_local_id(); i < tail; i += get_local_size())
+	{
+		cl_ulong	key = keys[(size_t)index[i] * nwords + word];
+
+		atomicAdd(&s_hist[(key >> shift) & mask], 1U);
+	}
+	__syncthreads();
+	hist[get_local_id() * kradix->ntiles + get_group_id()]
+		= s_hist[get_local_id()];
+}
+
+/*
+ * kern_gpusort_radix_prefix
+ *
+ * It makes the exclusive scan of the histogram; must be launched with
+ * a single thread-block. If all the rows have identical digit, the pass
+ * shall be skipped.
+ */
+KERNEL_FUNCTION(void)
+kern_gpusort_radix_prefix(kern_gpusort_radix *kradix)
+{
+	cl_uint	   *hist = KERN_GPUSORT_RADIX_HIST(kradix);
+	cl_uint		nhist = GPUSORT_RADIX_NBINS * kradix->ntiles;
+	cl_uint		base = 0;
+	cl_uint		i, j;
+	__shared__ cl_uint s_curr;
+	__shared__ cl_bool s_skip;
+
+	/* index[] written by the last pass becomes the current order */
+	if (get_local_id() == 0)
+	{
+		s_curr = kradix->curr ^ (kradix->pass_skip ? 0 : 1);
+		s_skip = false;
+	}
+	__syncthreads();
+	for (i = get_local_id(); i < GPUSORT_RADIX_NBINS; i += get_local_size())
+	{
+		cl_uint		count = 0;
+
+		for (j=0; j < kradix->ntiles; j++)
+			count += hist[i * kradix->ntiles + j];
+		if (count == kradix->nitems)
+			s_skip = true;
+	}
+	__syncthreads();
+	if (get_local_id() == 0)
+	{
+		kradix->curr = s_curr;
+		kradix->pass_skip = s_skip;
+	}
+	if (s_skip)
+		return;
+
+	for (i=0; i < nhist; i += get_local_size())
+	{
+		cl_uint		k = i + get_local_id();
+		cl_uint		count = (k < nhist ? hist[k] : 0);
+		cl_uint		offset;
+		cl_uint		total;
+
+		offset = pgstromStairlikeSum(count, &total);
+		if (k < nhist)
+			hist[k] = base + offset;
+		base += total;
+	}
+}
+
+/*
+ * kern_gpusort_radix_scatter
+ *
+ * It moves the row index to the destination of the digit, with keeping
+ * the order of the rows that have identical digit. Each round processes
+ * GPUSORT_RADIX_BLOCKSZ rows; the rank within the warp is given by the
+ * peers that have the same digit, then the counts of the earlier warps
+ * are added.
+ */
+KERNEL_FUNCTION(void)
+kern_gpusort_radix_scatter(kern_gpusort_radix *kradix,
+						   cl_uint word, cl_uint shift, cl_uint mask)
+{
+	cl_ulong   *keys = KERN_GPUSORT_RADIX_KEYS(kradix);
+	cl_uint	   *index_src;
+	cl_uint	   *index_dst;
+	cl_uint	   *hist = KERN_GPUSORT_RADIX_HIST(kradix);
+	cl_uint		nwords = KERN_GPUSORT_RADIX_NWORDS(kradix);
+	cl_uint		base = get_group_id() * GPUSORT_RADIX_TILESZ;
+	cl_uint		tail = Min(base + GPUSORT_RADIX_TILESZ, kradix->nitems);
+	cl_uint		warp_id = get_local_id() / warpSize;
+	cl_uint		lane_id = get_local_id() % warpSize;
+	cl_uint		lanemask_lt = (1U << lane_id) - 1;
+	cl_uint		i, b, w;
+	__shared__ cl_uint s_base[GPUSORT_RADIX_NBINS];
+	__shared__ cl_uint s_total[GPUSORT_RADIX_NBINS];
+	__shared__ cl_uint s_warp_hist[GPUSORT_RADIX_NWARPS][GPUSORT_RADIX_NBINS];
+
+	assert(get_local_size() == GPUSORT_RADIX_BLOCKSZ);
+	if (kradix->pass_skip)
+		return;
+	index_src = KERN_GPUSORT_RADIX_INDEX(kradix, kradix->curr);
+	index_dst = KERN_GPUSORT_RADIX_INDEX(kradix, kradix->curr ^ 1);
+
+	s_base[get_local_id()] = hist[get_local_id() * kradix->ntiles +
+								  get_group_id()];
+	for (i=base; i < tail; i += GPUSORT_RADIX_BLOCKSZ)
+	{
+		cl_uint		k = i + get_local_id();
+		cl_uint		row_index = 0;
+		cl_uint		digit = 0;
+		cl_uint		peers;
+		cl_uint		valid;
+
+		for (w=0; w < GPUSORT_RADIX_NWARPS; w++)
+			s_warp_hist[w][get_local_id()] = 0;
+		__syncthreads();
+
+		if (k < tail)
+		{
+			row_index = index_src[k];
+			digit = (keys[(size_t)row_index * nwords + word] >> shift) & mask;
+		}
+		/* lanes in the warp that have the same digit */
+		valid = __ballot_sync(~0U, k < tail);
+		peers = valid;
+		for (b=0; b < GPUSORT_RADIX_BITS; b++)
+		{
+			cl_uint		bit = ((digit >> b) & 1);
+			cl_uint		vote = __ballot_sync(~0U, bit);
+
+			peers &= (bit ? vote : ~vote);
+		}
+		if (k < tail && (peers & lanemask_lt) == 0)
+			s_warp_hist[warp_id][digit] = __popc(peers);
+		__syncthreads();
+
+		/* exclusive scan of the digit over the warps */
+		{
+			cl_uint		count = 0;
+
+			for (w=0; w < GPUSORT_RADIX_NWARPS; w++)
+			{
+				cl_uint		temp = s_warp_hist[w][get_local_id()];
+
+				s_warp_hist[w][get_local_id()] = count;
+				count += temp;
+			}
+			s_total[get_local_id()] = count;
+		}
+		__syncthreads();
+
+		if (k < tail)
+		{
+			cl_uint		dest = (s_base[digit] +
+								s_warp_hist[warp_id][digit] +
+								__popc(peers & lanemask_lt));
+			index_dst[dest] = row_index;
+		}
+		__syncthreads();
+		s_base[get_local_id()] += s_total[get_local_id()];
+		__syncthreads();
+	}
+}
@@ -792,6 +792,125 @@ pgfn_jsonb_array_element_text(kern_context *kcxt,
 	return result;
 }
 
+/*
+ * jsonb_item - a reference to jsonb value; either scalar or container
+ */
+typedef struct
+{
+	cl_uint		jtype;		/* one of JENTRY_IS* */
+	char	   *data;		/* JsonbContainer, if JENTRY_ISCONTAINER */
+	cl_uint		len;
+} jsonb_item;
+
+STATIC_FUNCTION(void)
+fetchJsonbItemFromContainer(JsonbContainer *jc,		/* may not be aligned */
+							cl_int index, char *base, jsonb_item *item)
+{
+	JEntry		entry = __Fetch(&jc->children[index]);
+
+	item->jtype = (entry & JENTRY_TYPEMASK);
+	if (JBE_ISSTRING(entry))
+	{
+		item->data = base + getJsonbOffset(jc, index);
+		item->len  = getJsonbLength(jc, index);
+	}
+	else if (JBE_ISNUMERIC(entry) || JBE_ISCONTAINER(entry))
+	{
+		item->data = base + INTALIGN(getJsonbOffset(jc, index));
+		item->len  = getJsonbLength(jc, index);
+	}
+	else
+	{
+		item->data = NULL;
+		item->len  = 0;
+	}
+}
+
+STATIC_INLINE(void)
+fetchJsonbItemFromRoot(char *jdata, jsonb_item *item)
+{
+	JsonbContainer *jc = (JsonbContainer *)jdata;
+	cl_uint		jheader = __Fetch(&jc->header);
+
+	if (JsonContainerIsScalar(jheader))
+		fetchJsonbItemFromContainer(jc, 0, (char *)(jc->children + 1), item);
+	else
+	{
+		item->jtype = JENTRY_ISCONTAINER;
+		item->data  = jdata;
+		item->len   = 0;
+	}
+}
+
+/* header of the container, or 0 if scalar item */
+STATIC_INLINE(cl_uint)
+jsonbItemContainerHeader(const jsonb_item *item)
+{
+	if (item->jtype != JENTRY_ISCONTAINER)
+		return 0;
+	return __Fetch(&((JsonbContainer *)item->data)->header);
+}
+
+STATIC_FUNCTION(cl_int)
+compareJsonbNumericValue(kern_context *kcxt, char *data1, char *data2,
+						 cl_bool *p_isnull)
+{
+	pg_numeric_t	num1 = pg_numeric_from_varlena(kcxt, (varlena *)data1);
+	pg_numeric_t	num2 = pg_numeric_from_varlena(kcxt, (varlena *)data2);
+	pg_int4_t		rv;
+
+	rv = pgfn_type_compare(kcxt, num1, num2);
+	if (rv.isnull)
+		*p_isnull = true;
+	return rv.value;
+}
+
+STATIC_FUNCTION(cl_bool)
+equalsJsonbScalarValue(kern_context *kcxt, jsonb_item *item1, jsonb_item *item2)
+{
+	cl_bool		isnull = false;
+
+	if (item1->jtype != item2->jtype)
+		return false;
+	if (item1->jtype == JENTRY_ISSTRING)
+		return (item1->len == item2->len &&
+				__memcmp(item1->data, item2->data, item1->len) == 0);
+	if (item1->jtype == JENTRY_ISNUMERIC)
+		return (compareJsonbNumericValue(kcxt, item1->data,
+										 item2->data, &isnull) == 0 && !isnull);
+	/* null, true or false */
+	return true;
+}
+
+/*
+ * existsJsonbKeyInContainer - check the key of the object, or string
+ * element of the array, at the top-level of the container.
+ */
+STATIC_FUNCTION(cl_bool)
+existsJsonbKeyInContainer(JsonbContainer *jc, char *key, cl_int keylen)
+{
+	cl_uint		jheader = __Fetch(&jc->header);
+
+	if (JsonContainerIsObject(jheader))
+		return (findJsonbIndexFromObject(jc, key, keylen) >= 0);
+	if (JsonContainerIsArray(jheader))
+	{
+		cl_uint		j, count = JsonContainerSize(jheader);
+		char	   *base = (char *)(jc->children + count);
+
+		for (j=0; j < count; j++)
+		{
+			JEntry	entry = __Fetch(&jc->children[j]);
+
+			if (JBE_ISSTRING(entry) &&
+				getJsonbLength(jc, j) == keylen &&
+				__memcmp(base + getJsonbOffset(jc, j), key, keylen) == 0)
+				return true;
+		}
+	}
+	return false;
+}
+
 DEVICE_FUNCTION(pg_bool_t)
 pgfn_jsonb_exists(kern_context *kcxt,
 				  pg_jsonb_t arg1, pg_text_t arg2)
@@ -800,7 +919,6 @@ pgfn_jsonb_exists(kern_context *kcxt,
 	char	   *jdata;		/* jsonb */
 	char	   *kdata;		/* key text */
 	cl_int		jlen, klen;
-	cl_int		index;
 
 	if (!pg_varlena_datum_extract(kcxt, arg1, &jdata, &jlen) ||
 		!pg_varlena_datum_extract(kcxt, arg2, &kdata, &klen))
@@ -809,13 +927,641 @@ pgfn_jsonb_exists(kern_context *kcxt,
 	}
 	else
 	{
-		index = findJsonbIndexFromObject((JsonbContainer *)jdata,
-										 kdata, klen);
 		result.isnull = false;
-		result.value  = (index >= 0);
+		result.value  = existsJsonbKeyInContainer((JsonbContainer *)jdata,
+												  kdata, klen);
+	}
+	return result;
+}
+
+/*
+ * jsonb ?| text[] and jsonb ?& text[]
+ */
+STATIC_FUNCTION(pg_bool_t)
+__jsonb_exists_keys(kern_context *kcxt,
+					pg_jsonb_t arg1, pg_array_t arg2, cl_bool exists_any)
+{
+	pg_bool_t	result;
+	char	   *jdata;
+	cl_int		jlen;
+	char	   *base;
+	char	   *nullmap;
+	cl_uint		offset = 0;
+	cl_int		i, ndim, nitems = 1;
+
+	result.isnull = true;
+	if (!pg_varlena_datum_extract(kcxt, arg1, &jdata, &jlen) || arg2.isnull)
+		return result;
+	if (arg2.length >= 0)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+						   "jsonb ?| / ?& on Arrow::List is not supported");
+		return result;
+	}
+	ndim = ARR_NDIM(arg2.value);
+	for (i=0; i < ndim; i++)
+		nitems *= __Fetch(ARR_DIMS(arg2.value) + i);
+	if (ndim == 0)
+		nitems = 0;
+	base = ARR_DATA_PTR(arg2.value);
+	nullmap = ARR_NULLBITMAP(arg2.value);
+
+	result.isnull = false;
+	result.value = !exists_any;
+	for (i=0; i < nitems; i++)
+	{
+		char   *key;
+		cl_bool	found;
+
+		/* NULL elements of the keys are ignored */
+		if (nullmap && (nullmap[i >> 3] & (1 << (i & 7))) == 0)
+			continue;
+		key = base + offset;
+		offset = INTALIGN(offset + VARSIZE_ANY(key));
+
+		found = existsJsonbKeyInContainer((JsonbContainer *)jdata,
+										  VARDATA_ANY(key),
+										  VARSIZE_ANY_EXHDR(key));
+		if (exists_any && found)
+		{
+			result.value = true;
+			break;
+		}
+		if (!exists_any && !found)
+		{
+			result.value = false;
+			break;
+		}
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_jsonb_exists_any(kern_context *kcxt,
+					  pg_jsonb_t arg1, pg_array_t arg2)
+{
+	return __jsonb_exists_keys(kcxt, arg1, arg2, true);
+}
+
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_jsonb_exists_all(kern_context *kcxt,
+					  pg_jsonb_t arg1, pg_array_t arg2)
+{
+	return __jsonb_exists_keys(kcxt, arg1, arg2, false);
+}
+
+/*
+ * jsonb @> jsonb and jsonb <@ jsonb; logic is identical to JsonbDeepContains
+ */
+STATIC_FUNCTION(cl_bool)
+JsonbDeepContains(kern_context *kcxt,
+				  JsonbContainer *lhs, JsonbContainer *rhs, int depth)
+{
+	cl_uint		lheader = __Fetch(&lhs->header);
+	cl_uint		rheader = __Fetch(&rhs->header);
+	cl_uint		lcount = JsonContainerSize(lheader);
+	cl_uint		rcount = JsonContainerSize(rheader);
+	cl_uint		i, j;
+
+	if (depth > JSPC_MAX_DEPTH)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_RECURSION_TOO_DEEP,
+						   "jsonb is too deep");
+		return false;
+	}
+	if (JsonContainerIsObject(lheader) != JsonContainerIsObject(rheader))
+		return false;
+
+	if (JsonContainerIsObject(rheader))
+	{
+		char   *lbase = (char *)(lhs->children + 2 * lcount);
+		char   *rbase = (char *)(rhs->children + 2 * rcount);
+
+		if (rcount > lcount)
+			return false;
+		for (i=0; i < rcount; i++)
+		{
+			jsonb_item	lval;
+			jsonb_item	rval;
+			cl_int		index;
+
+			index = findJsonbIndexFromObject(lhs,
+											 rbase + getJsonbOffset(rhs, i),
+											 getJsonbLength(rhs, i));
+			if (index < 0)
+				return false;
+			fetchJsonbItemFromContainer(lhs, index + lcount, lbase, &lval);
+			fetchJsonbItemFromContainer(rhs, i + rcount, rbase, &rval);
+			if (rval.jtype != JENTRY_ISCONTAINER)
+			{
+				if (!equalsJsonbScalarValue(kcxt, &lval, &rval))
+					return false;
+			}
+			else if (lval.jtype != JENTRY_ISCONTAINER ||
+					 !JsonbDeepContains(kcxt,
+										(JsonbContainer *)lval.data,
+										(JsonbContainer *)rval.data,
+										depth + 1))
+				return false;
+		}
+	}
+	else
+	{
+		char   *lbase = (char *)(lhs->children + lcount);
+		char   *rbase = (char *)(rhs->children + rcount);
+
+		/* raw scalar never contains an array */
+		if (JsonContainerIsScalar(lheader) && !JsonContainerIsScalar(rheader))
+			return false;
+		for (i=0; i < rcount; i++)
+		{
+			jsonb_item	rval;
+			cl_bool		found = false;
+
+			fetchJsonbItemFromContainer(rhs, i, rbase, &rval);
+			for (j=0; !found && j < lcount; j++)
+			{
+				jsonb_item	lval;
+
+				fetchJsonbItemFromContainer(lhs, j, lbase, &lval);
+				if (rval.jtype != JENTRY_ISCONTAINER)
+					found = equalsJsonbScalarValue(kcxt, &lval, &rval);
+				else if (lval.jtype == JENTRY_ISCONTAINER)
+					found = JsonbDeepContains(kcxt,
+											  (JsonbContainer *)lval.data,
+											  (JsonbContainer *)rval.data,
+											  depth + 1);
+			}
+			if (!found)
+				return false;
+		}
+	}
+	return true;
+}
+
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_jsonb_contains(kern_context *kcxt,
+					pg_jsonb_t arg1, pg_jsonb_t arg2)
+{
+	pg_bool_t	result;
+	char	   *jdata1, *jdata2;
+	cl_int		jlen1, jlen2;
+
+	if (!pg_varlena_datum_extract(kcxt, arg1, &jdata1, &jlen1) ||
+		!pg_varlena_datum_extract(kcxt, arg2, &jdata2, &jlen2))
+	{
+		result.isnull = true;
+	}
+	else
+	{
+		result.isnull = false;
+		result.value = JsonbDeepContains(kcxt,
+										 (JsonbContainer *)jdata1,
+										 (JsonbContainer *)jdata2, 0);
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_jsonb_contained(kern_context *kcxt,
+					 pg_jsonb_t arg1, pg_jsonb_t arg2)
+{
+	return pgfn_jsonb_contains(kcxt, arg2, arg1);
+}
+
+/*
+ * jsonb_path_exists - interpreter of kern_jsonpath (lax mode)
+ */
+#define JSPC_FALSE		0
+#define JSPC_TRUE		1
+#define JSPC_UNKNOWN	(-1)
+
+typedef struct
+{
+	const cl_uint *literal;	/* NULL, if main path */
+	cl_uint		cmpop;
+	cl_bool		path_on_left;
+	cl_bool		found;
+	cl_bool		unknown;
+} jsonpath_sink;
+
+STATIC_FUNCTION(cl_int)
+jsonpath_compare_literal(kern_context *kcxt,
+						 jsonb_item *item, jsonpath_sink *sink)
+{
+	const cl_uint *lit = sink->literal;
+	cl_uint		ltype;
+	cl_bool		isnull = false;
+	cl_int		cmp;
+
+	switch (lit[0])
+	{
+		case JSPC_LIT_NULL:
+			ltype = JENTRY_ISNULL;
+			break;
+		case JSPC_LIT_BOOL:
+			ltype = (lit[2] ? JENTRY_ISBOOL_TRUE : JENTRY_ISBOOL_FALSE);
+			break;
+		case JSPC_LIT_STRING:
+			ltype = JENTRY_ISSTRING;
+			break;
+		case JSPC_LIT_NUMERIC:
+			ltype = JENTRY_ISNUMERIC;
+			break;
+		default:
+			STROM_EREPORT(kcxt, ERRCODE_DATA_CORRUPTED,
+						  "corrupted jsonpath bytecode");
+			return JSPC_UNKNOWN;
+	}
+	/* boolean is one type */
+	if ((item->jtype == JENTRY_ISBOOL_TRUE ||
+		 item->jtype == JENTRY_ISBOOL_FALSE) &&
+		(ltype == JENTRY_ISBOOL_TRUE ||
+		 ltype == JENTRY_ISBOOL_FALSE))
+	{
+		cl_bool	b1 = (item->jtype == JENTRY_ISBOOL_TRUE);
+		cl_bool	b2 = (ltype == JENTRY_ISBOOL_TRUE);
+
+		cmp = (b1 == b2 ? 0 : (b1 ? 1 : -1));
+	}
+	else if (item->jtype != ltype)
+	{
+		/* null is comparable to others only by equalities */
+		if (item->jtype == JENTRY_ISNULL || ltype == JENTRY_ISNULL)
+			return (sink->cmpop == JSPC_CMP_NE ? JSPC_TRUE : JSPC_FALSE);
+		return JSPC_UNKNOWN;
+	}
+	else if (ltype == JENTRY_ISNULL)
+		cmp = 0;
+	else if (ltype == JENTRY_ISSTRING)
+	{
+		const cl_uchar *s1 = (const cl_uchar *)item->data;
+		const cl_uchar *s2 = (const cl_uchar *)&lit[3];
+		cl_uint		len1 = item->len;
+		cl_uint		len2 = lit[2];
+		cl_uint		i, len = Min(len1, len2);
+
+		/* byte order of UTF-8 is identical to the codepoint order */
+		cmp = 0;
+		for (i=0; cmp == 0 && i < len; i++)
+		{
+			if (s1[i] != s2[i])
+				cmp = (s1[i] < s2[i] ? -1 : 1);
+		}
+		if (cmp == 0 && len1 != len2)
+			cmp = (len1 < len2 ? -1 : 1);
+	}
+	else
+	{
+		cmp = compareJsonbNumericValue(kcxt, item->data,
+									   (char *)&lit[2], &isnull);
+		if (isnull)
+			return JSPC_UNKNOWN;
+	}
+	if (!sink->path_on_left)
+		cmp = -cmp;
+
+	switch (sink->cmpop)
+	{
+		case JSPC_CMP_EQ:	return (cmp == 0 ? JSPC_TRUE : JSPC_FALSE);
+		case JSPC_CMP_NE:	return (cmp != 0 ? JSPC_TRUE : JSPC_FALSE);
+		case JSPC_CMP_LT:	return (cmp <  0 ? JSPC_TRUE : JSPC_FALSE);
+		case JSPC_CMP_LE:	return (cmp <= 0 ? JSPC_TRUE : JSPC_FALSE);
+		case JSPC_CMP_GT:	return (cmp >  0 ? JSPC_TRUE : JSPC_FALSE);
+		case JSPC_CMP_GE:	return (cmp >= 0 ? JSPC_TRUE : JSPC_FALSE);
+		default:
+			break;
+	}
+	STROM_EREPORT(kcxt, ERRCODE_DATA_CORRUPTED,
+				  "corrupted jsonpath bytecode");
+	return JSPC_UNKNOWN;
+}
+
+/*
+ * jsonpath_sink_item - it returns true if no more items are needed
+ */
+STATIC_FUNCTION(cl_bool)
+jsonpath_sink_item(kern_context *kcxt, jsonb_item *item, jsonpath_sink *sink)
+{
+	cl_uint		jheader = jsonbItemContainerHeader(item);
+	cl_int		rc;
+
+	if (!sink->literal)
+	{
+		sink->found = true;
+		return true;
+	}
+	/* lax mode unwraps arrays in the operand of comparison */
+	if (JsonContainerIsArray(jheader))
+	{
+		JsonbContainer *jc = (JsonbContainer *)item->data;
+		cl_uint		j, count = JsonContainerSize(jheader);
+		char	   *base = (char *)(jc->children + count);
+		jsonb_item	elem;
+
+		for (j=0; j < count; j++)
+		{
+			fetchJsonbItemFromContainer(jc, j, base, &elem);
+			rc = jsonpath_compare_literal(kcxt, &elem, sink);
+			if (rc == JSPC_TRUE)
+			{
+				sink->found = true;
+				return true;
+			}
+			else if (rc == JSPC_UNKNOWN)
+				sink->unknown = true;
+		}
+		return false;
+	}
+	rc = jsonpath_compare_literal(kcxt, item, sink);
+	if (rc == JSPC_TRUE)
+	{
+		sink->found = true;
+		return true;
+	}
+	else if (rc == JSPC_UNKNOWN)
+		sink->unknown = true;
+	return false;
+}
+
+STATIC_FUNCTION(cl_bool)
+jsonpath_exec_steps(kern_context *kcxt, const cl_uint *code,
+					jsonb_item *item, jsonpath_sink *sink, int depth);
+
+STATIC_FUNCTION(cl_int)
+jsonpath_exec_predicate(kern_context *kcxt, const cl_uint *code,
+						jsonb_item *item, int depth)
+{
+	cl_int		rv1, rv2;
+
+	if (depth > JSPC_MAX_DEPTH)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_RECURSION_TOO_DEEP,
+						   "jsonpath is too deep");
+		return JSPC_UNKNOWN;
+	}
+	switch (code[0])
+	{
+		case JSPC_AND:
+			rv1 = jsonpath_exec_predicate(kcxt, code + 2, item, depth + 1);
+			if (rv1 == JSPC_FALSE)
+				return JSPC_FALSE;
+			rv2 = jsonpath_exec_predicate(kcxt, code + 2 + code[3],
+										  item, depth + 1);
+			if (rv2 == JSPC_FALSE)
+				return JSPC_FALSE;
+			return (rv1 == JSPC_TRUE && rv2 == JSPC_TRUE
+					? JSPC_TRUE : JSPC_UNKNOWN);
+
+		case JSPC_OR:
+			rv1 = jsonpath_exec_predicate(kcxt, code + 2, item, depth + 1);
+			if (rv1 == JSPC_TRUE)
+				return JSPC_TRUE;
+			rv2 = jsonpath_exec_predicate(kcxt, code + 2 + code[3],
+										  item, depth + 1);
+			if (rv2 == JSPC_TRUE)
+				return JSPC_TRUE;
+			return (rv1 == JSPC_FALSE && rv2 == JSPC_FALSE
+					? JSPC_FALSE : JSPC_UNKNOWN);
+
+		case JSPC_NOT:
+			rv1 = jsonpath_exec_predicate(kcxt, code + 2, item, depth + 1);
+			if (rv1 == JSPC_UNKNOWN)
+				return JSPC_UNKNOWN;
+			return (rv1 == JSPC_TRUE ? JSPC_FALSE : JSPC_TRUE);
+
+		case JSPC_CMP:
+			{
+				jsonpath_sink sink;
+				const cl_uint *lit = code + 4;
+
+				/* literal follows the operand path */
+				while (lit[0] != JSPC_END)
+					lit += lit[1];
+				lit += lit[1];
+
+				memset(&sink, 0, sizeof(jsonpath_sink));
+				sink.literal = lit;
+				sink.cmpop = code[2];
+				sink.path_on_left = (code[3] != 0);
+				jsonpath_exec_steps(kcxt, code + 4, item, &sink, depth + 1);
+				if (sink.found)
+					return JSPC_TRUE;
+				return (sink.unknown ? JSPC_UNKNOWN : JSPC_FALSE);
+			}
+		default:
+			break;
+	}
+	STROM_EREPORT(kcxt, ERRCODE_DATA_CORRUPTED,
+				  "corrupted jsonpath bytecode");
+	return JSPC_UNKNOWN;
+}
+
+/*
+ * jsonpath_exec_steps - it returns true if no more items are needed
+ */
+STATIC_FUNCTION(cl_bool)
+jsonpath_exec_steps(kern_context *kcxt, const cl_uint *code,
+					jsonb_item *item, jsonpath_sink *sink, int depth)
+{
+	const cl_uint *next = code + code[1];
+	cl_uint		jheader = jsonbItemContainerHeader(item);
+	JsonbContainer *jc = (JsonbContainer *)item->data;
+	cl_uint		i, j, count = JsonContainerSize(jheader);
+	jsonb_item	child;
+	jsonb_item	elem;
+	cl_int		index;
+
+	if (depth > JSPC_MAX_DEPTH)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_RECURSION_TOO_DEEP,
+						   "jsonpath is too deep");
+		return true;
+	}
+	if (kcxt->errcode != ERRCODE_STROM_SUCCESS)
+		return true;
+
+	switch (code[0])
+	{
+		case JSPC_END:
+			return jsonpath_sink_item(kcxt, item, sink);
+
+		case JSPC_KEY:
+			if (JsonContainerIsObject(jheader))
+			{
+				index = findJsonbIndexFromObject(jc, (char *)&code[3],
+												 code[2]);
+				if (index < 0)
+					return false;
+				fetchJsonbItemFromContainer(jc, index + count,
+											(char *)(jc->children + 2 * count),
+											&child);
+				return jsonpath_exec_steps(kcxt, next, &child,
+										   sink, depth + 1);
+			}
+			else if (JsonContainerIsArray(jheader))
+			{
+				/* lax mode unwraps the array */
+				for (i=0; i < count; i++)
+				{
+					JsonbContainer *ec;
+					cl_uint		eheader;
+					cl_uint		ecount;
+
+					fetchJsonbItemFromContainer(jc, i,
+												(char *)(jc->children + count),
+												&elem);
+					eheader = jsonbItemContainerHeader(&elem);
+					if (!JsonContainerIsObject(eheader))
+						continue;
+					ec = (JsonbContainer *)elem.data;
+					ecount = JsonContainerSize(eheader);
+					index = findJsonbIndexFromObject(ec, (char *)&code[3],
+													 code[2]);
+					if (index < 0)
+						continue;
+					fetchJsonbItemFromContainer(ec, index + ecount,
+												(char *)(ec->children + 2 * ecount),
+												&child);
+					if (jsonpath_exec_steps(kcxt, next, &child,
+											sink, depth + 1))
+						return true;
+				}
+			}
+			return false;
+
+		case JSPC_INDEX:
+			index = (cl_int)code[2];
+			if (JsonContainerIsArray(jheader))
+			{
+				if (index < 0 || index >= count)
+					return false;
+				fetchJsonbItemFromContainer(jc, index,
+											(char *)(jc->children + count),
+											&child);
+				return jsonpath_exec_steps(kcxt, next, &child,
+										   sink, depth + 1);
+			}
+			/* lax mode wraps non-array item */
+			if (index == 0)
+				return jsonpath_exec_steps(kcxt, next, item, sink, depth + 1);
+			return false;
+
+		case JSPC_ANY_ARRAY:
+			if (JsonContainerIsArray(jheader))
+			{
+				for (i=0; i < count; i++)
+				{
+					fetchJsonbItemFromContainer(jc, i,
+												(char *)(jc->children + count),
+												&child);
+					if (jsonpath_exec_steps(kcxt, next, &child,
+											sink, depth + 1))
+						return true;
+				}
+				return false;
+			}
+			return jsonpath_exec_steps(kcxt, next, item, sink, depth + 1);
+
+		case JSPC_ANY_KEY:
+			for (i=0; i < (JsonContainerIsArray(jheader) ? count : 1); i++)
+			{
+				JsonbContainer *oc = jc;
+				cl_uint		oheader = jheader;
+				cl_uint		ocount;
+
+				if (JsonContainerIsArray(jheader))
+				{
+					/* lax mode unwraps the array */
+					fetchJsonbItemFromContainer(jc, i,
+												(char *)(jc->children + count),
+												&elem);
+					oheader = jsonbItemContainerHeader(&elem);
+					oc = (JsonbContainer *)elem.data;
+				}
+				if (!JsonContainerIsObject(oheader))
+					continue;
+				ocount = JsonContainerSize(oheader);
+				for (j=0; j < ocount; j++)
+				{
+					fetchJsonbItemFromContainer(oc, j + ocount,
+												(char *)(oc->children + 2 * ocount),
+												&child);
+					if (jsonpath_exec_steps(kcxt, next, &child,
+											sink, depth + 1))
+						return true;
+				}
+			}
+			return false;
+
+		case JSPC_FILTER:
+			if (JsonContainerIsArray(jheader))
+			{
+				/* lax mode unwraps the array */
+				for (i=0; i < count; i++)
+				{
+					fetchJsonbItemFromContainer(jc, i,
+												(char *)(jc->children + count),
+												&child);
+					if (jsonpath_exec_predicate(kcxt, code + 2, &child,
+												depth + 1) == JSPC_TRUE &&
+						jsonpath_exec_steps(kcxt, next, &child,
+											sink, depth + 1))
+						return true;
+				}
+				return false;
+			}
+			if (jsonpath_exec_predicate(kcxt, code + 2, item,
+										depth + 1) == JSPC_TRUE)
+				return jsonpath_exec_steps(kcxt, next, item, sink, depth + 1);
+			return false;
+
+		default:
+			break;
+	}
+	STROM_EREPORT(kcxt, ERRCODE_DATA_CORRUPTED,
+				  "corrupted jsonpath bytecode");
+	return true;
+}
+
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_jsonb_path_exists(kern_context *kcxt,
+					   pg_jsonb_t arg1, pg_bytea_t arg2)
+{
+	pg_bool_t	result;
+	char	   *jdata;
+	char	   *pdata;
+	cl_int		jlen, plen;
+
+	if (!pg_varlena_datum_extract(kcxt, arg1, &jdata, &jlen) ||
+		!pg_varlena_datum_extract(kcxt, arg2, &pdata, &plen))
+	{
+		result.isnull = true;
+	}
+	else
+	{
+		kern_jsonpath  *jpath = (kern_jsonpath *)(pdata - VARHDRSZ);
+		jsonpath_sink	sink;
+		jsonb_item		root;
+
+		if (jpath->magic != KERN_JSONPATH_MAGIC)
+		{
+			STROM_EREPORT(kcxt, ERRCODE_DATA_CORRUPTED,
+						  "corrupted jsonpath bytecode");
+			result.isnull = true;
+			return result;
+		}
+		memset(&sink, 0, sizeof(jsonpath_sink));
+		fetchJsonbItemFromRoot(jdata, &root);
+		jsonpath_exec_steps(kcxt, jpath->code, &root, &sink, 0);
+		result.isnull = false;
+		result.value  = sink.found;
 	}
 	return result;
 }
+#undef JSPC_FALSE
+#undef JSPC_TRUE
+#undef JSPC_UNKNOWN
 
 /*
  * Special shortcut for CoerceViaIO; fetch jsonb element as numeric values
@@ -22,6 +22,65 @@ STROMCL_EXTERNAL_COMP_HASH_TEMPLATE(jsonb)
 STROMCL_UNSUPPORTED_ARROW_TEMPLATE(jsonb)
 #endif	/* PG_JSONB_TYPE_DEFINED */
 
+/*
+ * kern_jsonpath
+ *
+ * A simple jsonpath expression (lax mode only) compiled to the bytecode by
+ * codegen.c, and delivered to jsonb_path_exists() on the device as a bytea
+ * parameter. Every node of the bytecode begins with the opcode and the
+ * length of the node in words; so, interpreter can skip any nodes.
+ *
+ * Path steps:
+ *   JSPC_END                         ... end of the path
+ *   JSPC_KEY, keylen, key[]          ... .key
+ *   JSPC_INDEX, index                ... [index]
+ *   JSPC_ANY_ARRAY                   ... [*]
+ *   JSPC_ANY_KEY                     ... .*
+ *   JSPC_FILTER, <predicate>         ... ? (predicate)
+ * Predicates:
+ *   JSPC_AND, <pred>, <pred>
+ *   JSPC_OR, <pred>, <pred>
+ *   JSPC_NOT, <pred>
+ *   JSPC_CMP, cmpop, path_on_left, <path steps from @>, <literal>
+ * Literals:
+ *   JSPC_LIT_NULL
+ *   JSPC_LIT_BOOL, value
+ *   JSPC_LIT_STRING, length, bytes[]
+ *   JSPC_LIT_NUMERIC, NumericData (varlena)
+ */
+#define KERN_JSONPATH_MAGIC		0x4a535041U		/* "JSPA" */
+
+#define JSPC_END				0
+#define JSPC_KEY				1
+#define JSPC_INDEX				2
+#define JSPC_ANY_ARRAY			3
+#define JSPC_ANY_KEY			4
+#define JSPC_FILTER				5
+#define JSPC_AND				10
+#define JSPC_OR					11
+#define JSPC_NOT				12
+#define JSPC_CMP				13
+#define JSPC_LIT_NULL			20
+#define JSPC_LIT_BOOL			21
+#define JSPC_LIT_STRING			22
+#define JSPC_LIT_NUMERIC		23
+
+#define JSPC_CMP_EQ				1
+#define JSPC_CMP_NE				2
+#define JSPC_CMP_LT				3
+#define JSPC_CMP_LE				4
+#define JSPC_CMP_GT				5
+#define JSPC_CMP_GE				6
+
+#define JSPC_MAX_DEPTH			32
+
+typedef struct {
+	cl_int		vl_len_;		/* varlena header (do not touch directly!) */
+	cl_uint		magic;			/* = KERN_JSONPATH_MAGIC */
+	cl_uint		nwords;			/* length of the code[] */
+	cl_uint		code[FLEXIBLE_ARRAY_MEMBER];
+} kern_jsonpath;
+
 #ifdef __CUDACC__
 /* jsonb operator functions  */
 DEVICE_FUNCTION(pg_jsonb_t)
@@ -39,6 +98,21 @@ pgfn_jsonb_array_element_text(kern_context *kcxt,
 DEVICE_FUNCTION(pg_bool_t)
 pgfn_jsonb_exists(kern_context *kcxt,
 				  pg_jsonb_t arg1, pg_text_t arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_jsonb_exists_any(kern_context *kcxt,
+					  pg_jsonb_t arg1, pg_array_t arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_jsonb_exists_all(kern_context *kcxt,
+					  pg_jsonb_t arg1, pg_array_t arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_jsonb_contains(kern_context *kcxt,
+					pg_jsonb_t arg1, pg_jsonb_t arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_jsonb_contained(kern_context *kcxt,
+					 pg_jsonb_t arg1, pg_jsonb_t arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_jsonb_path_exists(kern_context *kcxt,
+					   pg_jsonb_t arg1, pg_bytea_t arg2);
 /* special shortcut for CoerceViaIO; fetch jsonb element as numeric values */
 DEVICE_FUNCTION(pg_numeric_t)
 pgfn_jsonb_object_field_as_numeric(kern_context *kcxt,
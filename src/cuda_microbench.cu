@@ -0,0 +1,154 @@
+/*
+ * cuda_microbench.cu
+ *
+ * Kernel-level microbenchmark of the device function libraries
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include "cuda_common.h"
+#include "cuda_primitive.h"
+#include "cuda_microbench.h"
+
+/*
+ * NOTE: This module is not a part of the extension. It is built with the
+ * same rules as other device libraries, then linked with cuda_common,
+ * cuda_numeric, cuda_primitive, cuda_textlib and cuda_timelib by the
+ * utils/gpu_microbench command, to measure the throughput of pgfn_*
+ * functions without any code generation by NVRTC.
+ */
+#define KERN_CONTEXT_VARLENA_BUFSZ		1024
+#define KERN_CONTEXT_STACK_LIMIT		1024
+
+#define DECL_MICROBENCH_KERNEL_CONTEXT(NAME)					\
+	union {														\
+		kern_context kcxt;										\
+		char __dummy__[offsetof(kern_context, vlbuf) +			\
+					   MAXALIGN(KERN_CONTEXT_VARLENA_BUFSZ)];	\
+	} NAME
+
+/*
+ * microbench_datum_ref - fetch a datum regardless of the KDS format
+ */
+template <typename T>
+DEVICE_INLINE(void)
+microbench_datum_ref(kern_context *kcxt,
+					 T &result,
+					 kern_data_store *kds,
+					 kern_data_extra *extra,
+					 cl_uint colidx, cl_uint rowidx)
+{
+	if (kds->format == KDS_FORMAT_ARROW)
+		pg_datum_ref_arrow(kcxt, result, kds, colidx, rowidx);
+	else
+	{
+		void   *addr = kern_get_datum_column(kds, extra, colidx, rowidx);
+
+		pg_datum_ref(kcxt, result, addr);
+	}
+}
+
+/*
+ * microbench_result_valid - a result to be counted; boolean results are
+ * counted only if true, to track the selectivity of the operators.
+ */
+template <typename T>
+DEVICE_INLINE(cl_bool)
+microbench_result_valid(T result)
+{
+	return !result.isnull;
+}
+
+DEVICE_INLINE(cl_bool)
+microbench_result_valid(pg_bool_t result)
+{
+	return !result.isnull && result.value;
+}
+
+#define MICROBENCH_KERNEL_TEMPLATE(FNAME,FETCH_ARGS,CALL_ARGS)		\
+	KERNEL_FUNCTION(void)											\
+	kern_microbench_##FNAME(kern_microbench *kmbench,				\
+							kern_data_store *kds_src,				\
+							kern_data_extra *kds_extra)				\
+	{																\
+		kern_parambuf *kparams = KERN_MICROBENCH_PARAMBUF(kmbench);	\
+		cl_ulong	nvalids = 0;									\
+		cl_uint		rowidx;											\
+		DECL_MICROBENCH_KERNEL_CONTEXT(u);							\
+																	\
+		INIT_KERNEL_CONTEXT(&u.kcxt, kparams);						\
+		for (rowidx = get_global_id();								\
+			 rowidx < kds_src->nitems;								\
+			 rowidx += get_global_size())							\
+		{															\
+			FETCH_ARGS;												\
+			if (microbench_result_valid(pgfn_##FNAME CALL_ARGS))	\
+				nvalids++;											\
+			u.kcxt.vlpos = u.kcxt.vlbuf;							\
+			if (u.kcxt.errcode != ERRCODE_STROM_SUCCESS)			\
+				break;												\
+		}															\
+		atomicAdd(&kmbench->nvalids, nvalids);						\
+		kern_writeback_error_status(&kmbench->kerror, &u.kcxt);		\
+	}
+
+/* function with 1 column argument */
+#define MICROBENCH_FUNC1(FNAME,RTYPE,ATYPE1)						\
+	MICROBENCH_KERNEL_TEMPLATE(										\
+		FNAME,														\
+		pg_##ATYPE1##_t arg1;										\
+		microbench_datum_ref(&u.kcxt, arg1,							\
+							 kds_src, kds_extra, 0, rowidx),		\
+		(&u.kcxt, arg1))
+
+/* function with 2 column arguments */
+#define MICROBENCH_FUNC2(FNAME,RTYPE,ATYPE1,ATYPE2)					\
+	MICROBENCH_KERNEL_TEMPLATE(										\
+		FNAME,														\
+		pg_##ATYPE1##_t arg1;										\
+		pg_##ATYPE2##_t arg2;										\
+		microbench_datum_ref(&u.kcxt, arg1,							\
+							 kds_src, kds_extra, 0, rowidx);		\
+		microbench_datum_ref(&u.kcxt, arg2,							\
+							 kds_src, kds_extra, 1, rowidx),		\
+		(&u.kcxt, arg1, arg2))
+
+/* function with 1 column argument and 1 constant argument */
+#define MICROBENCH_FUNC2_CONST(FNAME,RTYPE,ATYPE1,ATYPE2)			\
+	MICROBENCH_KERNEL_TEMPLATE(										\
+		FNAME,														\
+		pg_##ATYPE1##_t arg1;										\
+		pg_##ATYPE2##_t arg2;										\
+		microbench_datum_ref(&u.kcxt, arg1,							\
+							 kds_src, kds_extra, 0, rowidx);		\
+		pg_datum_ref(&u.kcxt, arg2,									\
+					 kparam_get_value(kparams, 0)),					\
+		(&u.kcxt, arg1, arg2))
+
+/*
+ * List of the microbenchmark kernels
+ *
+ * NOTE: utils/gpu_microbench.c has the catalog of the kernels below,
+ * with data types of the arguments to generate synthetic inputs.
+ * Keep them in sync, if you add a new one.
+ */
+/* ---- cuda_primitive ---- */
+MICROBENCH_FUNC2(int4pl, int4, int4, int4)
+MICROBENCH_FUNC2(int8pl, int8, int8, int8)
+MICROBENCH_FUNC2(int8mul, int8, int8, int8)
+MICROBENCH_FUNC2(float8pl, float8, float8, float8)
+MICROBENCH_FUNC2(float8mul, float8, float8, float8)
+MICROBENCH_FUNC2(float8div, float8, float8, float8)
+/* ---- cuda_numeric ---- */
+MICROBENCH_FUNC2(numeric_add, numeric, numeric, numeric)
+MICROBENCH_FUNC2(numeric_mul, numeric, numeric, numeric)
+MICROBENCH_FUNC2(numeric_lt, bool, numeric, numeric)
+/* ---- cuda_textlib ---- */
+MICROBENCH_FUNC2(texteq, bool, text, text)
+MICROBENCH_FUNC2(text_lt, bool, text, text)
+MICROBENCH_FUNC2_CONST(textlike, bool, text, text)
+/* ---- cuda_timelib ---- */
+MICROBENCH_FUNC1(timestamp_date, date, timestamp)
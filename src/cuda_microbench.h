@@ -0,0 +1,45 @@
+/*
+ * cuda_microbench.h
+ *
+ * Definitions shared by the kernel-level microbenchmark of the device
+ * function libraries (cuda_microbench.cu) and its driver program
+ * (utils/gpu_microbench.c).
+ * --
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#ifndef CUDA_MICROBENCH_H
+#define CUDA_MICROBENCH_H
+
+/*
+ * kern_microbench
+ *
+ * Control structure of the microbenchmark kernels. Every kernel is
+ * declared as below, and walks on the kds_src (KDS_FORMAT_COLUMN or
+ * KDS_FORMAT_ARROW) with grid-stride loop.
+ *
+ *   KERNEL_FUNCTION(void)
+ *   kern_microbench_<function>(kern_microbench *kmbench,
+ *                              kern_data_store *kds_src,
+ *                              kern_data_extra *kds_extra);
+ *
+ * The first column is the 1st argument of the function, and the second
+ * column is the 2nd argument if any. The constant argument, if any, is
+ * delivered as the 1st parameter of the kparams.
+ */
+typedef struct
+{
+	kern_errorbuf	kerror;		/* error status of the kernel */
+	cl_ulong		nvalids;	/* number of non-null (or true) results */
+	kern_parambuf	kparams;	/* constant arguments, if any */
+} kern_microbench;
+
+#define KERN_MICROBENCH_PARAMBUF(kmbench)	(&(kmbench)->kparams)
+#define KERN_MICROBENCH_LENGTH(kmbench)						\
+	STROMALIGN(offsetof(kern_microbench, kparams) +			\
+			   (kmbench)->kparams.length)
+
+#endif	/* CUDA_MICROBENCH_H */
@@ -1642,6 +1642,165 @@ pgfn_inet_same_family(kern_context *kcxt, pg_inet_t arg1, pg_inet_t arg2)
 	return result;
 }
 
+/* ================================================================
+ *
+ * GiST Index Handlers (inet_ops)
+ *
+ * ================================================================
+ */
+DEVICE_FUNCTION(void)
+pg_datum_ref(kern_context *kcxt, pg_inet_gistkey_t &result, void *addr)
+{
+	memset(&result, 0, sizeof(pg_inet_gistkey_t));
+	if (!addr)
+		result.isnull = true;
+	else if (VARATT_IS_COMPRESSED(addr) || VARATT_IS_EXTERNAL(addr))
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_STROM_VARLENA_UNSUPPORTED,
+						   "compressed or external GiST inet key");
+		result.isnull = true;
+	}
+	else if (VARSIZE_ANY_EXHDR(addr) < offsetof(inet_gistkey_struct, ipaddr))
+	{
+		STROM_EREPORT(kcxt, ERRCODE_DATA_CORRUPTED,
+					  "corrupted GiST inet key");
+		result.isnull = true;
+	}
+	else
+	{
+		cl_uint		len = Min(VARSIZE_ANY_EXHDR(addr),
+							  sizeof(inet_gistkey_struct));
+		memcpy(&result.value, VARDATA_ANY(addr), len);
+		result.isnull = false;
+	}
+}
+
+/*
+ * __pgindex_gist_inet_consistent
+ *
+ * Equivalent to inet_gist_consistent() for the sub/sup-network and overlap
+ * strategies. It is exact on the leaf pages, so no recheck is needed.
+ */
+#define INET_GIST_SUB		1
+#define INET_GIST_SUBEQ		2
+#define INET_GIST_SUP		3
+#define INET_GIST_SUPEQ		4
+#define INET_GIST_OVERLAP	5
+
+STATIC_FUNCTION(cl_bool)
+__pgindex_gist_inet_consistent(PageHeaderData *i_page,
+							   const pg_inet_gistkey_t &i_var,
+							   const pg_inet_t &i_arg,
+							   int strategy)
+{
+	const inet_gistkey_struct *key = &i_var.value;
+	const inet_struct *query = &i_arg.value;
+	cl_bool		is_leaf = GistPageIsLeaf(i_page);
+	int			minbits;
+
+	if (i_var.isnull || i_arg.isnull)
+		return false;
+	/* mixture of address families; only in the internal pages */
+	if (key->family == 0)
+		return true;
+	/* different address families never match */
+	if (key->family != ip_family(query))
+		return false;
+	/*
+	 * Any children have ip_bits >= key->minbits, so we can skip the subtree
+	 * in some cases.
+	 */
+	switch (strategy)
+	{
+		case INET_GIST_SUB:
+			if (is_leaf && key->minbits <= ip_bits(query))
+				return false;
+			break;
+		case INET_GIST_SUBEQ:
+			if (is_leaf && key->minbits < ip_bits(query))
+				return false;
+			break;
+		case INET_GIST_SUP:
+			if (key->minbits >= ip_bits(query))
+				return false;
+			break;
+		case INET_GIST_SUPEQ:
+			if (key->minbits > ip_bits(query))
+				return false;
+			break;
+		default:
+			break;
+	}
+	/* compare the common prefix bits, up to the netmask of both */
+	minbits = Min(key->commonbits, key->minbits);
+	minbits = Min(minbits, ip_bits(query));
+
+	return (bitncmp(key->ipaddr, query->ipaddr, minbits) == 0);
+}
+
+#define PGINDEX_GIST_INET_TEMPLATE(NAME,STRATEGY)						\
+	DEVICE_FUNCTION(cl_bool)											\
+	pgindex_gist_inet_##NAME(kern_context *kcxt,						\
+							 PageHeaderData *i_page,					\
+							 const pg_inet_gistkey_t &i_var,			\
+							 const pg_inet_t &i_arg)					\
+	{																	\
+		return __pgindex_gist_inet_consistent(i_page, i_var, i_arg,		\
+											  STRATEGY);				\
+	}
+PGINDEX_GIST_INET_TEMPLATE(sub,     INET_GIST_SUB)
+PGINDEX_GIST_INET_TEMPLATE(subeq,   INET_GIST_SUBEQ)
+PGINDEX_GIST_INET_TEMPLATE(sup,     INET_GIST_SUP)
+PGINDEX_GIST_INET_TEMPLATE(supeq,   INET_GIST_SUPEQ)
+PGINDEX_GIST_INET_TEMPLATE(overlap, INET_GIST_OVERLAP)
+#undef PGINDEX_GIST_INET_TEMPLATE
+
+/*
+ * pgindex_grid_range_bbox
+ *
+ * It returns the interval of the addresses in the network as an 1D
+ * bounding-box of the grid-index on GpuJoin; rounded outward to float.
+ * IPv6 is mapped by the upper 64bits, on the same axis of IPv4. It is
+ * equivalent to __innerPreloadGridRangeBBox() on the host side.
+ */
+DEVICE_FUNCTION(cl_bool)
+pgindex_grid_range_bbox(kern_context *kcxt,
+						const pg_inet_t &arg,
+						cl_float *p_min, cl_float *p_max)
+{
+	const inet_struct *ip = &arg.value;
+	cl_int		nbits;
+	cl_int		i;
+
+	if (arg.isnull)
+		return false;
+	if (ip_family(ip) == PGSQL_AF_INET)
+	{
+		cl_uint		addr = 0;
+		cl_uint		mask;
+
+		for (i=0; i < 4; i++)
+			addr = (addr << 8) | ip->ipaddr[i];
+		nbits = Min(ip_bits(ip), 32);
+		mask = (nbits == 0 ? 0U : ~0U << (32 - nbits));
+		*p_min = __uint2float_rd(addr & mask);
+		*p_max = __uint2float_ru(addr | ~mask);
+	}
+	else
+	{
+		cl_ulong	addr = 0;
+		cl_ulong	mask;
+
+		for (i=0; i < 8; i++)
+			addr = (addr << 8) | ip->ipaddr[i];
+		nbits = Min(ip_bits(ip), 64);
+		mask = (nbits == 0 ? 0UL : ~0UL << (64 - nbits));
+		*p_min = __ull2float_rd(addr & mask);
+		*p_max = __ull2float_ru(addr | ~mask);
+	}
+	return true;
+}
+
 /*
  * Misc mathematic functions
  */
@@ -2067,3 +2226,399 @@ pgfn_tan(kern_context *kcxt, pg_float8_t arg1)
 	}
 	return result;
 }
+
+/*
+ * Hash and cryptographic functions
+ * ---------------------------------------------------------------- */
+static __device__ const cl_uint __md5_shifts[64] = {
+	7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,  7, 12, 17, 22,
+	5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,  5,  9, 14, 20,
+	4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,  4, 11, 16, 23,
+	6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21,  6, 10, 15, 21,
+};
+
+static __device__ const cl_uint __md5_consts[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+	0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+	0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+	0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+	0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+	0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+	0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+	0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+	0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static __device__ const cl_uint __sha256_consts[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTL32(x,n)		(((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR32(x,n)		(((x) >> (n)) | ((x) << (32 - (n))))
+
+/*
+ * __hash_fetch_block - fetch a 64-bytes block of the message with padding
+ *
+ * MD5 and SHA-2 share the same padding rule; 0x80 next to the message,
+ * zeros, then the message length in bits at the last 8 bytes of the final
+ * block, in little-endian for MD5 and big-endian for SHA-2.
+ */
+STATIC_FUNCTION(void)
+__hash_fetch_block(cl_uchar *block, const cl_uchar *data, cl_int len,
+				   cl_int nblocks, cl_int index, cl_bool is_big_endian)
+{
+	cl_int		base = 64 * index;
+	cl_ulong	nbits = 8 * (cl_ulong)len;
+	cl_int		i;
+
+	for (i=0; i < 64; i++)
+	{
+		cl_int	pos = base + i;
+
+		if (pos < len)
+			block[i] = data[pos];
+		else if (pos == len)
+			block[i] = 0x80;
+		else
+			block[i] = 0;
+	}
+	if (index == nblocks - 1)
+	{
+		for (i=0; i < 8; i++)
+		{
+			if (is_big_endian)
+				block[63 - i] = (cl_uchar)(nbits >> (8 * i));
+			else
+				block[56 + i] = (cl_uchar)(nbits >> (8 * i));
+		}
+	}
+}
+
+/*
+ * __md5_digest - compute 16-bytes MD5 digest of the message
+ */
+STATIC_FUNCTION(void)
+__md5_digest(const cl_uchar *data, cl_int len, cl_uchar *digest)
+{
+	cl_uint		h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+	cl_int		nblocks = (len + 8) / 64 + 1;
+	cl_int		index;
+	cl_int		i;
+
+	for (index=0; index < nblocks; index++)
+	{
+		cl_uchar	block[64];
+		cl_uint		m[16];
+		cl_uint		a = h[0];
+		cl_uint		b = h[1];
+		cl_uint		c = h[2];
+		cl_uint		d = h[3];
+
+		__hash_fetch_block(block, data, len, nblocks, index, false);
+		for (i=0; i < 16; i++)
+			m[i] = (((cl_uint)block[4*i])           |
+					((cl_uint)block[4*i+1] <<  8)   |
+					((cl_uint)block[4*i+2] << 16)   |
+					((cl_uint)block[4*i+3] << 24));
+		for (i=0; i < 64; i++)
+		{
+			cl_uint		f, g;
+
+			if (i < 16)
+			{
+				f = (b & c) | (~b & d);
+				g = i;
+			}
+			else if (i < 32)
+			{
+				f = (d & b) | (~d & c);
+				g = (5 * i + 1) % 16;
+			}
+			else if (i < 48)
+			{
+				f = b ^ c ^ d;
+				g = (3 * i + 5) % 16;
+			}
+			else
+			{
+				f = c ^ (b | ~d);
+				g = (7 * i) % 16;
+			}
+			f += a + __md5_consts[i] + m[g];
+			a = d;
+			d = c;
+			c = b;
+			b += ROTL32(f, __md5_shifts[i]);
+		}
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+	}
+	for (i=0; i < 16; i++)
+		digest[i] = (cl_uchar)(h[i / 4] >> (8 * (i % 4)));
+}
+
+/*
+ * __sha256_digest - compute SHA-256 (or SHA-224) digest of the message
+ */
+STATIC_FUNCTION(void)
+__sha256_digest(const cl_uchar *data, cl_int len,
+				cl_uchar *digest, cl_bool is_sha224)
+{
+	cl_uint		h[8];
+	cl_int		nblocks = (len + 8) / 64 + 1;
+	cl_int		index;
+	cl_int		i;
+
+	if (is_sha224)
+	{
+		h[0] = 0xc1059ed8;	h[1] = 0x367cd507;
+		h[2] = 0x3070dd17;	h[3] = 0xf70e5939;
+		h[4] = 0xffc00b31;	h[5] = 0x68581511;
+		h[6] = 0x64f98fa7;	h[7] = 0xbefa4fa4;
+	}
+	else
+	{
+		h[0] = 0x6a09e667;	h[1] = 0xbb67ae85;
+		h[2] = 0x3c6ef372;	h[3] = 0xa54ff53a;
+		h[4] = 0x510e527f;	h[5] = 0x9b05688c;
+		h[6] = 0x1f83d9ab;	h[7] = 0x5be0cd19;
+	}
+
+	for (index=0; index < nblocks; index++)
+	{
+		cl_uchar	block[64];
+		cl_uint		w[64];
+		cl_uint		v[8];
+
+		__hash_fetch_block(block, data, len, nblocks, index, true);
+		for (i=0; i < 16; i++)
+			w[i] = (((cl_uint)block[4*i]   << 24) |
+					((cl_uint)block[4*i+1] << 16) |
+					((cl_uint)block[4*i+2] <<  8) |
+					((cl_uint)block[4*i+3]));
+		for (i=16; i < 64; i++)
+		{
+			cl_uint		s0 = (ROTR32(w[i-15],  7) ^
+							  ROTR32(w[i-15], 18) ^ (w[i-15] >>  3));
+			cl_uint		s1 = (ROTR32(w[i-2],  17) ^
+							  ROTR32(w[i-2],  19) ^ (w[i-2]  >> 10));
+			w[i] = w[i-16] + s0 + w[i-7] + s1;
+		}
+		memcpy(v, h, sizeof(v));
+		for (i=0; i < 64; i++)
+		{
+			cl_uint		S1 = (ROTR32(v[4], 6) ^
+							  ROTR32(v[4], 11) ^ ROTR32(v[4], 25));
+			cl_uint		ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+			cl_uint		t1 = v[7] + S1 + ch + __sha256_consts[i] + w[i];
+			cl_uint		S0 = (ROTR32(v[0], 2) ^
+							  ROTR32(v[0], 13) ^ ROTR32(v[0], 22));
+			cl_uint		maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+			cl_uint		t2 = S0 + maj;
+
+			v[7] = v[6];
+			v[6] = v[5];
+			v[5] = v[4];
+			v[4] = v[3] + t1;
+			v[3] = v[2];
+			v[2] = v[1];
+			v[1] = v[0];
+			v[0] = t1 + t2;
+		}
+		for (i=0; i < 8; i++)
+			h[i] += v[i];
+	}
+	for (i=0; i < (is_sha224 ? 28 : 32); i++)
+		digest[i] = (cl_uchar)(h[i / 4] >> (8 * (3 - i % 4)));
+}
+
+/*
+ * __crc32_reflected - CRC-32 (polynomial 0x04c11db7) or CRC-32C
+ * (polynomial 0x1edc6f41) in the reflected form, as zlib and
+ * PostgreSQL's pg_crc32c.
+ */
+STATIC_FUNCTION(cl_uint)
+__crc32_reflected(const cl_uchar *data, cl_int len, cl_uint poly)
+{
+	cl_uint		crc = 0xffffffffU;
+	cl_int		i, j;
+
+	for (i=0; i < len; i++)
+	{
+		crc ^= data[i];
+		for (j=0; j < 8; j++)
+			crc = (crc >> 1) ^ (poly & (0U - (crc & 1)));
+	}
+	return crc ^ 0xffffffffU;
+}
+#undef ROTL32
+#undef ROTR32
+
+/*
+ * __hash_datum_hex - write out the digest in hexadecimal text form
+ */
+STATIC_FUNCTION(pg_text_t)
+__hash_datum_hex(kern_context *kcxt, const cl_uchar *digest, cl_int dlen)
+{
+	pg_text_t	result;
+	char	   *pos;
+	cl_int		i;
+
+	pos = (char *)kern_context_alloc(kcxt, VARHDRSZ + 2 * dlen);
+	if (!pos)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_OUT_OF_MEMORY,
+						   "out of memory");
+		result.isnull = true;
+		return result;
+	}
+	result.isnull = false;
+	result.value = pos;
+	result.length = -1;
+	SET_VARSIZE(pos, VARHDRSZ + 2 * dlen);
+	pos += VARHDRSZ;
+	for (i=0; i < dlen; i++)
+	{
+		cl_uchar	hi = (digest[i] >> 4) & 0x0f;
+		cl_uchar	lo = (digest[i] & 0x0f);
+
+		*pos++ = (hi < 10 ? '0' + hi : 'a' + hi - 10);
+		*pos++ = (lo < 10 ? '0' + lo : 'a' + lo - 10);
+	}
+	return result;
+}
+
+/*
+ * __hash_datum_bytea - write out the digest in bytea form
+ */
+STATIC_FUNCTION(pg_bytea_t)
+__hash_datum_bytea(kern_context *kcxt, const cl_uchar *digest, cl_int dlen)
+{
+	pg_bytea_t	result;
+	char	   *pos;
+
+	pos = (char *)kern_context_alloc(kcxt, VARHDRSZ + dlen);
+	if (!pos)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_OUT_OF_MEMORY,
+						   "out of memory");
+		result.isnull = true;
+		return result;
+	}
+	result.isnull = false;
+	result.value = pos;
+	result.length = -1;
+	SET_VARSIZE(pos, VARHDRSZ + dlen);
+	memcpy(pos + VARHDRSZ, digest, dlen);
+	return result;
+}
+
+#define PGFN_MD5_TEMPLATE(ARGTYPE)									\
+	DEVICE_FUNCTION(pg_text_t)										\
+	pgfn_md5_##ARGTYPE(kern_context *kcxt, pg_##ARGTYPE##_t arg1)	\
+	{																\
+		pg_text_t	result;											\
+		cl_uchar	digest[16];										\
+		char	   *s;												\
+		cl_int		len;											\
+																	\
+		if (!pg_varlena_datum_extract(kcxt, arg1, &s, &len))		\
+		{															\
+			result.isnull = true;									\
+			return result;											\
+		}															\
+		__md5_digest((cl_uchar *)s, len, digest);					\
+		return __hash_datum_hex(kcxt, digest, 16);					\
+	}
+PGFN_MD5_TEMPLATE(text)
+PGFN_MD5_TEMPLATE(bytea)
+#undef PGFN_MD5_TEMPLATE
+
+#define PGFN_SHA2_TEMPLATE(NAME,DLEN,IS_SHA224)						\
+	DEVICE_FUNCTION(pg_bytea_t)										\
+	pgfn_##NAME(kern_context *kcxt, pg_bytea_t arg1)				\
+	{																\
+		pg_bytea_t	result;											\
+		cl_uchar	digest[32];										\
+		char	   *s;												\
+		cl_int		len;											\
+																	\
+		if (!pg_varlena_datum_extract(kcxt, arg1, &s, &len))		\
+		{															\
+			result.isnull = true;									\
+			return result;											\
+		}															\
+		__sha256_digest((cl_uchar *)s, len, digest, IS_SHA224);		\
+		return __hash_datum_bytea(kcxt, digest, DLEN);				\
+	}
+PGFN_SHA2_TEMPLATE(sha224, 28, true)
+PGFN_SHA2_TEMPLATE(sha256, 32, false)
+#undef PGFN_SHA2_TEMPLATE
+
+/*
+ * hashtext - same as the host side under the C collation (or none); the
+ * non-C collations are rejected by the 'L' flag of the catalog.
+ */
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_hashtext(kern_context *kcxt, pg_text_t arg1)
+{
+	pg_int4_t	result;
+	char	   *s;
+	cl_int		len;
+
+	if (!pg_varlena_datum_extract(kcxt, arg1, &s, &len))
+		result.isnull = true;
+	else
+	{
+		result.isnull = false;
+		result.value = (cl_int)pg_hash_any((cl_uchar *)s, len);
+	}
+	return result;
+}
+
+#define PGFN_CRC32_TEMPLATE(NAME,ARGTYPE,POLY)						\
+	DEVICE_FUNCTION(pg_int8_t)										\
+	pgfn_##NAME##_##ARGTYPE(kern_context *kcxt, pg_##ARGTYPE##_t arg1) \
+	{																\
+		pg_int8_t	result;											\
+		char	   *s;												\
+		cl_int		len;											\
+																	\
+		if (!pg_varlena_datum_extract(kcxt, arg1, &s, &len))		\
+			result.isnull = true;									\
+		else														\
+		{															\
+			result.isnull = false;									\
+			result.value = __crc32_reflected((cl_uchar *)s, len, POLY); \
+		}															\
+		return result;												\
+	}
+PGFN_CRC32_TEMPLATE(crc32, text, 0xedb88320U)
+PGFN_CRC32_TEMPLATE(crc32, bytea, 0xedb88320U)
+PGFN_CRC32_TEMPLATE(crc32c, text, 0x82f63b78U)
+PGFN_CRC32_TEMPLATE(crc32c, bytea, 0x82f63b78U)
+#undef PGFN_CRC32_TEMPLATE
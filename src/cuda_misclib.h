@@ -274,6 +274,61 @@ DEVICE_FUNCTION(pg_int8_t)
 pgfn_inetmi(kern_context *kcxt, pg_inet_t arg1, pg_inet_t arg2);
 DEVICE_FUNCTION(pg_bool_t)
 pgfn_inet_same_family(kern_context *kcxt, pg_inet_t arg1, pg_inet_t arg2);
+#endif	/* __CUDACC__ */
+
+/*
+ * pg_inet_gistkey_t
+ *
+ * Index key of the GiST inet_ops (GistInetKey in network_gist.c). Unlike
+ * the inet datum, it has the minimum netmask length and number of common
+ * prefix bits of the values in the subtree, and zero family if the subtree
+ * contains both of IPv4 and IPv6.
+ */
+typedef struct
+{
+	cl_uchar	family;		/* PGSQL_AF_INET, PGSQL_AF_INET6, or zero */
+	cl_uchar	minbits;	/* minimum number of bits in netmask */
+	cl_uchar	commonbits;	/* number of common prefix bits */
+	cl_uchar	ipaddr[16];	/* up to 128 bits of common address */
+} inet_gistkey_struct;
+
+STROMCL_SIMPLE_DATATYPE_TEMPLATE(inet_gistkey,inet_gistkey_struct)
+
+#ifdef __CUDACC__
+DEVICE_FUNCTION(void)
+pg_datum_ref(kern_context *kcxt, pg_inet_gistkey_t &result, void *addr);
+/*
+ * GiST index handlers
+ */
+DEVICE_FUNCTION(cl_bool)
+pgindex_gist_inet_sub(kern_context *kcxt,
+					  PageHeaderData *i_page,
+					  const pg_inet_gistkey_t &i_var,
+					  const pg_inet_t &i_arg);
+DEVICE_FUNCTION(cl_bool)
+pgindex_gist_inet_subeq(kern_context *kcxt,
+						PageHeaderData *i_page,
+						const pg_inet_gistkey_t &i_var,
+						const pg_inet_t &i_arg);
+DEVICE_FUNCTION(cl_bool)
+pgindex_gist_inet_sup(kern_context *kcxt,
+					  PageHeaderData *i_page,
+					  const pg_inet_gistkey_t &i_var,
+					  const pg_inet_t &i_arg);
+DEVICE_FUNCTION(cl_bool)
+pgindex_gist_inet_supeq(kern_context *kcxt,
+						PageHeaderData *i_page,
+						const pg_inet_gistkey_t &i_var,
+						const pg_inet_t &i_arg);
+DEVICE_FUNCTION(cl_bool)
+pgindex_gist_inet_overlap(kern_context *kcxt,
+						  PageHeaderData *i_page,
+						  const pg_inet_gistkey_t &i_var,
+						  const pg_inet_t &i_arg);
+DEVICE_FUNCTION(cl_bool)
+pgindex_grid_range_bbox(kern_context *kcxt,
+						const pg_inet_t &arg,
+						cl_float *p_min, cl_float *p_max);
 
 /*
  * Misc mathematic functions
@@ -325,6 +380,27 @@ DEVICE_FUNCTION(pg_float8_t)
 pgfn_sin(kern_context *kcxt, pg_float8_t arg1);
 DEVICE_FUNCTION(pg_float8_t)
 pgfn_tan(kern_context *kcxt, pg_float8_t arg1);
+/*
+ * Hash and cryptographic functions
+ */
+DEVICE_FUNCTION(pg_text_t)
+pgfn_md5_text(kern_context *kcxt, pg_text_t arg1);
+DEVICE_FUNCTION(pg_text_t)
+pgfn_md5_bytea(kern_context *kcxt, pg_bytea_t arg1);
+DEVICE_FUNCTION(pg_bytea_t)
+pgfn_sha224(kern_context *kcxt, pg_bytea_t arg1);
+DEVICE_FUNCTION(pg_bytea_t)
+pgfn_sha256(kern_context *kcxt, pg_bytea_t arg1);
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_hashtext(kern_context *kcxt, pg_text_t arg1);
+DEVICE_FUNCTION(pg_int8_t)
+pgfn_crc32_text(kern_context *kcxt, pg_text_t arg1);
+DEVICE_FUNCTION(pg_int8_t)
+pgfn_crc32_bytea(kern_context *kcxt, pg_bytea_t arg1);
+DEVICE_FUNCTION(pg_int8_t)
+pgfn_crc32c_text(kern_context *kcxt, pg_text_t arg1);
+DEVICE_FUNCTION(pg_int8_t)
+pgfn_crc32c_bytea(kern_context *kcxt, pg_bytea_t arg1);
 
 #endif	/* __CUDACC__ */
 #endif	/* CUDA_MISCLIB_H */
@@ -135,6 +135,19 @@ pg_numeric_normalize(pg_numeric_t num)
 		{
 			num.weight = 0;
 		}
+		else if (num.value.hi == ((cl_long)num.value.lo >> 63))
+		{
+			/* fast path, if value fits in 64bit integer */
+			cl_long		ival = (cl_long)num.value.lo;
+
+			while (ival % 10 == 0)
+			{
+				ival /= 10;
+				num.weight--;
+			}
+			num.value.lo = ival;
+			num.value.hi = (ival >> 63);
+		}
 		else
 		{
 			Int128_t	temp;
@@ -142,6 +155,9 @@ pg_numeric_normalize(pg_numeric_t num)
 
 			for (;;)
 			{
+				/* odd value is never multiple of 10 */
+				if ((num.value.lo & 1) != 0)
+					break;
 				temp = __Int128_div(num.value, 10, &mod);
 				if (mod != 0)
 					break;
@@ -1013,6 +1029,72 @@ pg_numeric_to_cstring(kern_context *kcxt, varlena *numeric,
 	return (cl_int)(cp - buf);
 }
 
+/*
+ * __numeric_rescale
+ *
+ * It adjusts the weight of the numeric to the supplied (larger) one, by
+ * multiplication of 10^N at most 18 digits per step, instead of 10 for each
+ * digit. It returns false if the value overflows 128bit integer.
+ */
+static __device__ const cl_ulong __numeric_pow10[] = {
+	1UL,
+	10UL,
+	100UL,
+	1000UL,
+	10000UL,
+	100000UL,
+	1000000UL,
+	10000000UL,
+	100000000UL,
+	1000000000UL,
+	10000000000UL,
+	100000000000UL,
+	1000000000000UL,
+	10000000000000UL,
+	100000000000000UL,
+	1000000000000000UL,
+	10000000000000000UL,
+	100000000000000000UL,
+	1000000000000000000UL,
+};
+
+STATIC_FUNCTION(cl_bool)
+__numeric_rescale(pg_numeric_t *num, cl_int weight)
+{
+	cl_bool		is_negative;
+	Int128_t	x = num->value;
+
+	if (num->weight >= weight)
+		return true;
+	if (x.hi == 0 && x.lo == 0)
+	{
+		num->weight = weight;
+		return true;
+	}
+	is_negative = (__Int128_sign(x) < 0);
+	if (is_negative)
+		x = __Int128_inverse(x);
+	while (num->weight < weight)
+	{
+		cl_int		n = Min(weight - num->weight,
+							(cl_int)lengthof(__numeric_pow10) - 1);
+		cl_ulong	m = __numeric_pow10[n];
+		cl_ulong	hi, carry;
+
+		if (__umul64hi((cl_ulong)x.hi, m) != 0)
+			return false;
+		hi = (cl_ulong)x.hi * m;
+		carry = __umul64hi(x.lo, m);
+		if (hi + carry < hi || ((hi + carry) & (1UL<<63)) != 0)
+			return false;
+		x.lo = x.lo * m;
+		x.hi = hi + carry;
+		num->weight += n;
+	}
+	num->value = (is_negative ? __Int128_inverse(x) : x);
+	return true;
+}
+
 /*
  * Numeric operator functions
  */
@@ -1050,16 +1132,9 @@ pgfn_numeric_add(kern_context *kcxt,
 	result.isnull = arg1.isnull | arg2.isnull;
 	if (result.isnull)
 		return result;
-	while (arg1.weight > arg2.weight)
-	{
-		arg2.value = __Int128_mul(arg2.value, 10);
-		arg2.weight++;
-	}
-	while (arg1.weight < arg2.weight)
-	{
-		arg1.value = __Int128_mul(arg1.value, 10);
-		arg1.weight++;
-	}
+	if (!__numeric_rescale(&arg1, arg2.weight) ||
+		!__numeric_rescale(&arg2, arg1.weight))
+		goto overflow;
 	asm volatile("add.cc.u64     %0, %2, %3;\n"
 				 "addc.u64       %1, %4, %5;\n"
 				 : "=l" (result.value.lo),
@@ -1068,9 +1143,19 @@ pgfn_numeric_add(kern_context *kcxt,
 				   "l" (arg2.value.lo),
 				   "l" (arg1.value.hi),
 				   "l" (arg2.value.hi));
+	/* sign of the result is opposite to the operands on overflow */
+	if ((arg1.value.hi < 0) == (arg2.value.hi < 0) &&
+		(arg1.value.hi < 0) != (result.value.hi < 0))
+		goto overflow;
 	result.weight = arg1.weight;
 
 	return pg_numeric_normalize(result);
+
+overflow:
+	result.isnull = true;
+	STROM_CPU_FALLBACK(kcxt, ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE,
+					   "numeric value overflow");
+	return result;
 }
 
 DEVICE_FUNCTION(pg_numeric_t)
@@ -1139,17 +1224,19 @@ numeric_cmp(kern_context *kcxt, pg_numeric_t arg1, pg_numeric_t arg2)
 		return 1;
 	else if (sign1 < sign2)
 		return -1;
+	else if (sign1 == 0)
+		return 0;
 	/* ok, both of arg1 and arg2 is not zero, and have same sign */
-	while (arg1.weight > arg2.weight)
-	{
-		arg2.value = __Int128_mul(arg2.value, 10);
-		arg2.weight++;
-	}
-	while (arg1.weight < arg2.weight)
-	{
-		arg1.value = __Int128_mul(arg1.value, 10);
-		arg1.weight++;
-	}
+	if (arg1.weight == arg2.weight)
+		return __Int128_compare(arg1.value, arg2.value);
+	/*
+	 * If the value overflows on rescaling, its absolute value is larger
+	 * than the other one.
+	 */
+	if (!__numeric_rescale(&arg1, arg2.weight))
+		return sign1;
+	if (!__numeric_rescale(&arg2, arg1.weight))
+		return -sign1;
 	return __Int128_compare(arg1.value, arg2.value);
 }
 
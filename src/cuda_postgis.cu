@@ -1231,6 +1231,40 @@ pgindex_gist_box2df_contained(kern_context *kcxt,
 	return false;
 }
 
+/*
+ * Grid index handler
+ *
+ * It returns the bounding-box of the outer key, expanded by the distance,
+ * to look up the grid-index on the inner geometries. False means the key
+ * never matches; NULL, EMPTY or negative distance.
+ */
+DEVICE_FUNCTION(cl_bool)
+pgindex_grid_geometry_bbox(kern_context *kcxt,
+						   geom_bbox_2d *bbox,
+						   const pg_geometry_t &i_arg,
+						   const pg_float8_t &i_dist)
+{
+	if (i_arg.isnull || i_arg.nitems == 0 ||
+		i_dist.isnull || i_dist.value < 0.0)
+		return false;
+	if (!__geometry_get_bbox2d(kcxt, &i_arg, bbox))
+	{
+		/* unknown bounding-box; all the items are candidates */
+		bbox->xmin = -FLT_INFINITY;
+		bbox->xmax =  FLT_INFINITY;
+		bbox->ymin = -FLT_INFINITY;
+		bbox->ymax =  FLT_INFINITY;
+	}
+	else if (i_dist.value > 0.0)
+	{
+		bbox->xmin = __fsub_rd(bbox->xmin, __double2float_ru(i_dist.value));
+		bbox->xmax = __fadd_ru(bbox->xmax, __double2float_ru(i_dist.value));
+		bbox->ymin = __fsub_rd(bbox->ymin, __double2float_ru(i_dist.value));
+		bbox->ymax = __fadd_ru(bbox->ymax, __double2float_ru(i_dist.value));
+	}
+	return true;
+}
+
 /* ================================================================
  *
  * St_Distance(geometry,geometry)
@@ -6052,3 +6086,390 @@ pgfn_st_crosses(kern_context *kcxt,
 	}
 	return result;
 }
+
+/* ================================================================
+ *
+ * St_Intersects(geometry,geometry)
+ *
+ * ================================================================
+ */
+STATIC_FUNCTION(pg_bool_t)
+fast_geom_intersects_polygon_point(kern_context *kcxt,
+								   const pg_geometry_t *geom1,
+								   const pg_geometry_t *geom2)
+{
+	POINT2D		pt;
+	cl_int		status;
+	pg_bool_t	result;
+
+	assert((geom1->type == GEOM_POLYGONTYPE ||
+			geom1->type == GEOM_MULTIPOLYGONTYPE) &&
+		   (geom2->type == GEOM_POINTTYPE ||
+			geom2->type == GEOM_MULTIPOINTTYPE));
+	memset(&result, 0, sizeof(pg_bool_t));
+	if (geom2->type == GEOM_POINTTYPE)
+	{
+		__loadPoint2d(&pt, geom2->rawdata, 0);
+		if (geom1->type == GEOM_POLYGONTYPE)
+			status = __geom_point_in_polygon(geom1, &pt, kcxt);
+		else
+			status = __geom_point_in_multipolygon(geom1, &pt, kcxt);
+		if (status == PT_ERROR)
+			goto error;
+		result.value = (status != PT_OUTSIDE);
+	}
+	else
+	{
+		pg_geometry_t __geom;
+		const char *pos = NULL;
+
+		for (int i=0; i < geom2->nitems; i++)
+		{
+			pos = geometry_load_subitem(&__geom, geom2, pos, i);
+			if (!pos)
+				goto error;
+			if (__geom.nitems == 0)
+				continue;	/* skip empty point */
+			__loadPoint2d(&pt, __geom.rawdata, 0);
+			if (geom1->type == GEOM_POLYGONTYPE)
+				status = __geom_point_in_polygon(geom1, &pt, kcxt);
+			else
+				status = __geom_point_in_multipolygon(geom1, &pt, kcxt);
+			if (status == PT_ERROR)
+				goto error;
+			if (status != PT_OUTSIDE)
+			{
+				result.value = true;
+				break;
+			}
+		}
+	}
+	return result;
+error:
+	result.isnull = true;
+	return result;
+}
+
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_st_intersects(kern_context *kcxt,
+				   const pg_geometry_t &geom1,
+				   const pg_geometry_t &geom2)
+{
+	pg_bool_t	result;
+	cl_int		status;
+
+	memset(&result, 0, sizeof(pg_bool_t));
+	result.isnull = geom1.isnull | geom2.isnull;
+	if (result.isnull)
+		return result;
+
+	if (geometry_is_empty(&geom1) || geometry_is_empty(&geom2))
+		return result;
+
+	/*
+	 * shortcut-1: if bounding boxes are disjoint obviously,
+	 * we can return FALSE immediately.
+	 */
+	if (geom1.bbox && geom2.bbox)
+	{
+		geom_bbox_2d	bbox1, bbox2;
+
+		memcpy(&bbox1, &geom1.bbox->d2, sizeof(geom_bbox_2d));
+		memcpy(&bbox2, &geom2.bbox->d2, sizeof(geom_bbox_2d));
+
+		if (bbox1.xmax < bbox2.xmin ||
+			bbox1.xmin > bbox2.xmax ||
+			bbox1.ymax < bbox2.ymin ||
+			bbox1.ymin > bbox2.ymax)
+			return result;
+	}
+
+	/*
+	 * shortcut-2: if one is a polygon and the other is a point type,
+	 * call the fast point-in-polygon function.
+	 */
+	if ((geom1.type == GEOM_POLYGONTYPE ||
+		 geom1.type == GEOM_MULTIPOLYGONTYPE) &&
+		(geom2.type == GEOM_POINTTYPE ||
+		 geom2.type == GEOM_MULTIPOINTTYPE))
+		return fast_geom_intersects_polygon_point(kcxt, &geom1, &geom2);
+	if ((geom1.type == GEOM_POINTTYPE ||
+		 geom1.type == GEOM_MULTIPOINTTYPE) &&
+		(geom2.type == GEOM_POLYGONTYPE ||
+		 geom2.type == GEOM_MULTIPOLYGONTYPE))
+		return fast_geom_intersects_polygon_point(kcxt, &geom2, &geom1);
+
+	/* elsewhere, use st_relate and DE9-IM; not disjoint */
+	status = geom_relate_internal(kcxt, &geom1, &geom2);
+	if (status < 0)
+		result.isnull = true;
+	else
+	{
+		result.value = ((status & (IM__INTER_INTER_2D |
+								   IM__INTER_BOUND_2D |
+								   IM__BOUND_INTER_2D |
+								   IM__BOUND_BOUND_2D)) != 0);
+	}
+	return result;
+}
+
+/* ================================================================
+ *
+ * St_Within(geometry,geometry)
+ *
+ * ================================================================
+ */
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_st_within(kern_context *kcxt,
+			   const pg_geometry_t &geom1,
+			   const pg_geometry_t &geom2)
+{
+	/* st_within(A,B) is equivalent to st_contains(B,A) */
+	return pgfn_st_contains(kcxt, geom2, geom1);
+}
+
+/* ================================================================
+ *
+ * St_Area(geometry)
+ *
+ * ================================================================
+ */
+STATIC_FUNCTION(double)
+__geom_ring_signed_area(const pg_geometry_t *ring)
+{
+	/* see, ptarray_signed_area */
+	cl_uint		unitsz = sizeof(double) * GEOM_FLAGS_NDIMS(ring->flags);
+	POINT2D		p0, p1, p2;
+	double		x0, sum = 0.0;
+
+	if (ring->nitems < 3)
+		return 0.0;
+	__loadPoint2d(&p0, ring->rawdata, unitsz);
+	__loadPoint2d(&p1, ring->rawdata + unitsz, unitsz);
+	x0 = p0.x;
+	for (int i=2; i < ring->nitems; i++)
+	{
+		__loadPoint2d(&p2, ring->rawdata + unitsz * i, unitsz);
+		sum += (p1.x - x0) * (p0.y - p2.y);
+		p0 = p1;
+		p1 = p2;
+	}
+	return sum / 2.0;
+}
+
+STATIC_FUNCTION(cl_bool)
+geom_area_recursive(kern_context *kcxt,
+					const pg_geometry_t *geom, double *p_area)
+{
+	/* see, lwgeom_area */
+	switch (geom->type)
+	{
+		case GEOM_POLYGONTYPE:
+			{
+				pg_geometry_t ring;
+				const char *pos = NULL;
+				double		area = 0.0;
+
+				for (int i=0; i < geom->nitems; i++)
+				{
+					pos = geometry_load_subitem(&ring, geom, pos, i, kcxt);
+					if (!pos)
+						return false;
+					if (i == 0)
+						area += fabs(__geom_ring_signed_area(&ring));
+					else
+						area -= fabs(__geom_ring_signed_area(&ring));
+				}
+				*p_area += area;
+			}
+			return true;
+		case GEOM_TRIANGLETYPE:
+			*p_area += fabs(__geom_ring_signed_area(geom));
+			return true;
+		case GEOM_CURVEPOLYTYPE:
+			STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+							   "st_area on curve polygons");
+			return false;
+		default:
+			if (geometry_is_collection(geom))
+			{
+				pg_geometry_t __geom;
+				const char *pos = NULL;
+
+				for (int i=0; i < geom->nitems; i++)
+				{
+					pos = geometry_load_subitem(&__geom, geom, pos, i, kcxt);
+					if (!pos)
+						return false;
+					if (!geom_area_recursive(kcxt, &__geom, p_area))
+						return false;
+				}
+			}
+			/* elsewhere, no area */
+			return true;
+	}
+}
+
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_st_area(kern_context *kcxt, const pg_geometry_t &geom)
+{
+	pg_float8_t	result;
+
+	result.isnull = geom.isnull;
+	result.value = 0.0;
+	if (!result.isnull)
+	{
+		if (!geom_area_recursive(kcxt, &geom, &result.value))
+			result.isnull = true;
+	}
+	return result;
+}
+
+/* ================================================================
+ *
+ * St_Length(geometry)
+ *
+ * ================================================================
+ */
+STATIC_FUNCTION(cl_bool)
+geom_length2d_recursive(kern_context *kcxt,
+						const pg_geometry_t *geom, double *p_length)
+{
+	/* see, lwgeom_length_2d */
+	switch (geom->type)
+	{
+		case GEOM_LINETYPE:
+			{
+				/* see, ptarray_length_2d */
+				cl_uint		unitsz = sizeof(double) * GEOM_FLAGS_NDIMS(geom->flags);
+				POINT2D		p1, p2;
+				double		length = 0.0;
+
+				if (geom->nitems < 2)
+					return true;
+				__loadPoint2d(&p1, geom->rawdata, unitsz);
+				for (int i=1; i < geom->nitems; i++, p1 = p2)
+				{
+					__loadPoint2d(&p2, geom->rawdata + unitsz * i, unitsz);
+					length += hypot(p2.x - p1.x, p2.y - p1.y);
+				}
+				*p_length += length;
+			}
+			return true;
+		case GEOM_CIRCSTRINGTYPE:
+			STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+							   "st_length on circular strings");
+			return false;
+		default:
+			if (geometry_is_collection(geom))
+			{
+				pg_geometry_t __geom;
+				const char *pos = NULL;
+
+				for (int i=0; i < geom->nitems; i++)
+				{
+					pos = geometry_load_subitem(&__geom, geom, pos, i, kcxt);
+					if (!pos)
+						return false;
+					if (!geom_length2d_recursive(kcxt, &__geom, p_length))
+						return false;
+				}
+			}
+			/* elsewhere, no length (polygons have perimeter) */
+			return true;
+	}
+}
+
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_st_length(kern_context *kcxt, const pg_geometry_t &geom)
+{
+	pg_float8_t	result;
+
+	result.isnull = geom.isnull;
+	result.value = 0.0;
+	if (!result.isnull)
+	{
+		if (!geom_length2d_recursive(kcxt, &geom, &result.value))
+			result.isnull = true;
+	}
+	return result;
+}
+
+/* ================================================================
+ *
+ * St_DistanceSphere(geometry,geometry)
+ *
+ * ================================================================
+ */
+/* (2 * WGS84_MAJOR_AXIS + WGS84_MINOR_AXIS) / 3.0 */
+#define WGS84_SPHERE_RADIUS		6371008.771415059
+#define GEOM_PI					3.141592653589793115998
+#define GEOM_PI_2				(GEOM_PI / 2.0)
+
+STATIC_INLINE(double)
+__geom_latitude_radians_normalize(double lat)
+{
+	/* see, latitude_radians_normalize */
+	if (lat > 2.0 * GEOM_PI)
+		lat = remainder(lat, 2.0 * GEOM_PI);
+	if (lat < -2.0 * GEOM_PI)
+		lat = remainder(lat, -2.0 * GEOM_PI);
+	if (lat > GEOM_PI)
+		lat = GEOM_PI - lat;
+	if (lat < -GEOM_PI)
+		lat = -GEOM_PI - lat;
+	if (lat > GEOM_PI_2)
+		lat = GEOM_PI - lat;
+	if (lat < -GEOM_PI_2)
+		lat = -GEOM_PI - lat;
+	return lat;
+}
+
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_st_distancesphere(kern_context *kcxt,
+					   const pg_geometry_t &geom1,
+					   const pg_geometry_t &geom2)
+{
+	/* see, LWGEOM_distance_sphere and sphere_distance */
+	pg_float8_t	result;
+	POINT2D		p1, p2;
+	double		lat1, lat2, d_lon;
+	double		a1, a2;
+
+	result.isnull = geom1.isnull | geom2.isnull;
+	result.value = 0.0;
+	if (result.isnull)
+		return result;
+	if (geom1.srid != geom2.srid)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_INVALID_PARAMETER_VALUE,
+					  "Operation on mixed SRID geometries");
+		result.isnull = true;
+		return result;
+	}
+	if (geometry_is_empty(&geom1) || geometry_is_empty(&geom2))
+	{
+		result.isnull = true;
+		return result;
+	}
+	/* only point-to-point distance is supported on the device */
+	if (geom1.type != GEOM_POINTTYPE || geom2.type != GEOM_POINTTYPE)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+						   "st_distancesphere on non-point geometries");
+		result.isnull = true;
+		return result;
+	}
+	__loadPoint2d(&p1, geom1.rawdata, 0);
+	__loadPoint2d(&p2, geom2.rawdata, 0);
+	lat1 = __geom_latitude_radians_normalize(p1.y * GEOM_PI / 180.0);
+	lat2 = __geom_latitude_radians_normalize(p2.y * GEOM_PI / 180.0);
+	d_lon = (p2.x - p1.x) * GEOM_PI / 180.0;
+
+	a1 = cos(lat2) * sin(d_lon);
+	a2 = cos(lat1) * sin(lat2) - sin(lat1) * cos(lat2) * cos(d_lon);
+	result.value = WGS84_SPHERE_RADIUS *
+		atan2(sqrt(a1 * a1 + a2 * a2),
+			  sin(lat1) * sin(lat2) + cos(lat1) * cos(lat2) * cos(d_lon));
+	return result;
+}
@@ -262,6 +262,15 @@ pgindex_gist_box2df_contained(kern_context *kcxt,
 							  const pg_box2df_t &i_var,
 							  const pg_box2df_t &i_arg);
 
+/*
+ * Grid index handler
+ */
+DEVICE_FUNCTION(cl_bool)
+pgindex_grid_geometry_bbox(kern_context *kcxt,
+						   geom_bbox_2d *bbox,
+						   const pg_geometry_t &i_arg,
+						   const pg_float8_t &i_dist);
+
 /*
  * PostGIS functions
  */
@@ -303,6 +312,24 @@ DEVICE_FUNCTION(pg_bool_t)
 pgfn_st_crosses(kern_context *kcxt,
 				const pg_geometry_t &arg1,
 				const pg_geometry_t &arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_st_intersects(kern_context *kcxt,
+				   const pg_geometry_t &arg1,
+				   const pg_geometry_t &arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_st_within(kern_context *kcxt,
+			   const pg_geometry_t &arg1,
+			   const pg_geometry_t &arg2);
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_st_area(kern_context *kcxt,
+			 const pg_geometry_t &arg1);
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_st_length(kern_context *kcxt,
+			   const pg_geometry_t &arg1);
+DEVICE_FUNCTION(pg_float8_t)
+pgfn_st_distancesphere(kern_context *kcxt,
+					   const pg_geometry_t &arg1,
+					   const pg_geometry_t &arg2);
 
 #endif /* __CUDACC__ */
 
@@ -14,6 +14,31 @@
 #include "access/xact.h"
 #include "pgtime.h"
 #include "utils/pg_locale.h"
+#include "cuda_timelib.h"
+#include <utime.h>
+
+/*
+ * pgcache_autotune
+ *
+ * Status of the block size autotuning of a kernel function in the program,
+ * on a particular device. Each candidate is tried @pgstrom_autotune_trials
+ * times on the real chunks, then the fastest one per item is recorded to
+ * @best_block_sz; it shall be used for the later launches.
+ */
+#define PGCACHE_AUTOTUNE_NSLOTS		8
+#define PGCACHE_AUTOTUNE_NCANDS		4
+
+typedef struct
+{
+	pg_crc32		kern_hash;		/* hash of the kernel name; 0 if unused */
+	cl_int			cuda_dindex;
+	cl_int			ncands;
+	cl_int			best_block_sz;	/* 0, if autotuning is in-progress */
+	cl_int			block_sz[PGCACHE_AUTOTUNE_NCANDS];
+	cl_uint			ntrials[PGCACHE_AUTOTUNE_NCANDS];
+	uint64			nitems[PGCACHE_AUTOTUNE_NCANDS];
+	double			elapsed[PGCACHE_AUTOTUNE_NCANDS];	/* in ms */
+} pgcache_autotune;
 
 typedef struct
 {
@@ -25,6 +50,12 @@ typedef struct
 	dlist_node		hash_chain;
 	dlist_node		lru_chain;
 	dlist_node		build_chain;
+	int				build_prio;		/* PGCACHE_BUILD_PRIO__* */
+	bool			build_speculative; /* enqueued by prebuild */
+	TimestampTz		build_enqueued;	/* time when enqueued */
+	TimestampTz		build_finished;	/* time when build is completed */
+	uint64			build_usec;		/* elapsed time of the build */
+	pgcache_autotune autotune[PGCACHE_AUTOTUNE_NSLOTS];
 	/* fields below are never updated once entry is constructed */
 	ProgramId		program_id;
 	pg_crc32		crc;			/* hash value by extra_flags */
@@ -57,6 +88,38 @@ typedef struct
 #define WORDNUM(x)			((x) / BITS_PER_BITMAPWORD)
 #define BITNUM(x)			((x) % BITS_PER_BITMAPWORD)
 
+/*
+ * Priority classes of the build pending lists. Program builders pick up
+ * the entries from the higher class first, then FIFO order in a class.
+ * A speculative build is enqueued by the plan-time prebuild, and promoted
+ * once an executor requests the same program.
+ */
+#define PGCACHE_BUILD_PRIO__INTERACTIVE		0
+#define PGCACHE_BUILD_PRIO__BATCH			1
+#define PGCACHE_BUILD_PRIO__SPECULATIVE		2
+#define PGCACHE_BUILD_NUM_PRIOS				3
+
+/*
+ * pgcache_build_stats
+ *
+ * Statistics of the program builds for pgstrom.program_build_stats.
+ * The k-th bucket of @build_hist counts builds that took [2^k, 2^(k+1))
+ * milliseconds; the last one also counts longer ones.
+ */
+#define PGCACHE_BUILD_HIST_NBUCKETS			16
+
+typedef struct
+{
+	cl_uint		queue_depth;	/* # of entries in the build pending list */
+	uint64		enqueue_count;
+	uint64		build_count;
+	uint64		cancel_count;	/* # of builds nobody waits for any more */
+	uint64		queue_wait_usec;
+	uint64		build_usec;
+	uint64		build_max_usec;
+	uint64		build_hist[PGCACHE_BUILD_HIST_NBUCKETS];
+} pgcache_build_stats;
+
 typedef struct
 {
 	volatile slock_t lock;
@@ -64,7 +127,10 @@ typedef struct
 	dlist_head	pgid_slots[PGCACHE_HASH_SIZE];
 	dlist_head	hash_slots[PGCACHE_HASH_SIZE];
 	dlist_head	lru_list;
-	dlist_head	build_list;		/* build pending list */
+	/* build pending lists for each priority class */
+	dlist_head	build_list[PGCACHE_BUILD_NUM_PRIOS];
+	pgcache_build_stats build_stats[PGCACHE_BUILD_NUM_PRIOS];
+	cl_uint		num_builds_running;	/* # of NVRTC invocations in-progress */
 	size_t		program_cache_usage;
 } program_cache_head;
 
@@ -76,23 +142,64 @@ typedef struct
 	} builders[FLEXIBLE_ARRAY_MEMBER];
 } program_builder_state;
 
+/*
+ * program_cache_file_head
+ *
+ * Header of the on-disk program cache at pg_strom.program_cache_dir.
+ * kern_define, kern_source and the PTX image follow the header; each of
+ * them is terminated by '\0'. The version stamp invalidates the files
+ * built by other versions of PG-Strom, NVRTC or the device headers.
+ */
+#define PGCACHE_FILE_MAGIC			"PGSTROM_PTX_CACHE"
+#define PGCACHE_FILE_STAMP_LEN		160
+
+typedef struct
+{
+	char		magic[20];		/* = PGCACHE_FILE_MAGIC */
+	char		stamp[PGCACHE_FILE_STAMP_LEN];
+	int			target_cc;
+	cl_uint		extra_flags;
+	cl_uint		varlena_bufsz;
+	size_t		kern_deflen;
+	size_t		kern_srclen;
+	size_t		ptx_length;
+	pg_crc32	ptx_crc;
+} program_cache_file_head;
+
 /* ---- GUC variables ---- */
 static int		program_cache_size_kb;
+static char	   *program_cache_dir;
+static int		program_cache_dir_size_kb;
 static int		num_program_builders;
 static bool		pgstrom_debug_jit_compile_options;
+static bool		pgstrom_program_prebuild;
+static int		pgstrom_program_build_priority;
 static bool		pgstrom_debug_cuda_enable_coredump_on_exception;
 static int		pgstrom_extra_kernel_stack_size;
+static int		pgstrom_autotune_trials;
 
 /* ---- static variables ---- */
 static shmem_startup_hook_type shmem_startup_next;
 static program_cache_head *pgcache_head = NULL;
 static program_builder_state *pgbuilder_state = NULL;
 static bool		cuda_program_builder_got_signal = false;
+static const char *pgcache_build_prio_names[PGCACHE_BUILD_NUM_PRIOS] = {
+	"interactive",
+	"batch",
+	"speculative",
+};
+static const struct config_enum_entry pgstrom_program_build_priority_options[] = {
+	{"interactive",	PGCACHE_BUILD_PRIO__INTERACTIVE, false},
+	{"batch",		PGCACHE_BUILD_PRIO__BATCH, false},
+	{NULL, 0, false},
+};
 
 /* ---- forward declarations ---- */
 static void put_cuda_program_entry_nolock(program_cache_entry *entry);
 void cudaProgramBuilderMain(Datum arg);
 static void cudaProgramBuilderWakeUp(bool error_if_no_builders);
+Datum pgstrom_program_build_stats(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(pgstrom_program_build_stats);
 
 /*
  * lookup_cuda_program_entry_nolock - lookup a program_cache_entry by the
@@ -145,6 +252,110 @@ reclaim_cuda_program_entry_nolock(void)
 	}
 }
 
+/*
+ * pgcache_build_enqueue_nolock - links the entry to the build pending list
+ * of the supplied priority class
+ */
+static void
+pgcache_build_enqueue_nolock(program_cache_entry *entry, int build_prio)
+{
+	pgcache_build_stats *bstats = &pgcache_head->build_stats[build_prio];
+
+	Assert(build_prio >= 0 && build_prio < PGCACHE_BUILD_NUM_PRIOS);
+	Assert(!entry->build_chain.prev && !entry->build_chain.next);
+	entry->build_prio = build_prio;
+	entry->build_enqueued = GetCurrentTimestamp();
+	dlist_push_tail(&pgcache_head->build_list[build_prio],
+					&entry->build_chain);
+	bstats->queue_depth++;
+	bstats->enqueue_count++;
+}
+
+/*
+ * pgcache_build_remove_nolock - unlinks the entry from the build pending
+ * list; caller must ensure the entry is pending to build.
+ */
+static void
+pgcache_build_remove_nolock(program_cache_entry *entry)
+{
+	pgcache_build_stats *bstats = &pgcache_head->build_stats[entry->build_prio];
+	TimestampTz	now = GetCurrentTimestamp();
+
+	Assert(entry->build_chain.prev && entry->build_chain.next);
+	dlist_delete(&entry->build_chain);
+	memset(&entry->build_chain, 0, sizeof(dlist_node));
+	Assert(bstats->queue_depth > 0);
+	bstats->queue_depth--;
+	bstats->queue_wait_usec += Max(now - entry->build_enqueued, 0);
+}
+
+/*
+ * pgcache_build_dequeue_nolock - picks up a pending entry from the build
+ * list of the highest priority class, or NULL if nothing
+ */
+static program_cache_entry *
+pgcache_build_dequeue_nolock(void)
+{
+	program_cache_entry *entry;
+	dlist_node *dnode;
+	int			prio;
+
+	for (prio=0; prio < PGCACHE_BUILD_NUM_PRIOS; prio++)
+	{
+		if (dlist_is_empty(&pgcache_head->build_list[prio]))
+			continue;
+		dnode = dlist_head_node(&pgcache_head->build_list[prio]);
+		entry = dlist_container(program_cache_entry, build_chain, dnode);
+		pgcache_build_remove_nolock(entry);
+		return entry;
+	}
+	return NULL;
+}
+
+/*
+ * pgcache_build_move_nolock - moves the pending entry to the tail of
+ * another priority class, with keeping the time when it was enqueued
+ */
+static void
+pgcache_build_move_nolock(program_cache_entry *entry, int build_prio)
+{
+	Assert(entry->build_chain.prev && entry->build_chain.next);
+	if (entry->build_prio != build_prio)
+	{
+		dlist_delete(&entry->build_chain);
+		pgcache_head->build_stats[entry->build_prio].queue_depth--;
+		entry->build_prio = build_prio;
+		dlist_push_tail(&pgcache_head->build_list[build_prio],
+						&entry->build_chain);
+		pgcache_head->build_stats[build_prio].queue_depth++;
+	}
+}
+
+/*
+ * pgcache_build_stats_nolock - accounts a program build
+ */
+static void
+pgcache_build_stats_nolock(program_cache_entry *entry,
+						   int build_prio, TimestampTz tv_start)
+{
+	pgcache_build_stats *bstats = &pgcache_head->build_stats[build_prio];
+	uint64		usec = Max(GetCurrentTimestamp() - tv_start, 0);
+	int			k = (int)get_next_log2(usec / 1000 + 1) - 1;
+
+	k = Max(Min(k, PGCACHE_BUILD_HIST_NBUCKETS - 1), 0);
+	Assert(pgcache_head->num_builds_running > 0);
+	pgcache_head->num_builds_running--;
+	bstats->build_count++;
+	bstats->build_usec += usec;
+	bstats->build_max_usec = Max(bstats->build_max_usec, usec);
+	bstats->build_hist[k]++;
+	if (entry)
+	{
+		entry->build_finished = tv_start + usec;
+		entry->build_usec = usec;
+	}
+}
+
 /*
  * get_cuda_program_entry_nolock
  */
@@ -181,6 +392,33 @@ put_cuda_program_entry_nolock(program_cache_entry *entry)
 		pgcache_head->program_cache_usage -= entry->entry_sz;
 		pfree(entry);
 	}
+	else if (entry->refcnt == 1 &&
+			 entry->build_chain.prev != NULL &&
+			 entry->build_chain.next != NULL)
+	{
+		/*
+		 * All the requesters have gone (e.g, transaction abort) prior to
+		 * the program build. If it is originally a speculative build by
+		 * the prebuild, we move it back to the speculative class; other
+		 * builds are cancelled because nobody waits for them any more.
+		 * Note that an on-going build by NVRTC cannot be cancelled.
+		 */
+		if (entry->build_speculative)
+			pgcache_build_move_nolock(entry, PGCACHE_BUILD_PRIO__SPECULATIVE);
+		else
+		{
+			pgcache_build_remove_nolock(entry);
+			pgcache_head->build_stats[entry->build_prio].cancel_count++;
+			dlist_delete(&entry->pgid_chain);
+			dlist_delete(&entry->hash_chain);
+			if (entry->lru_chain.prev && entry->lru_chain.next)
+			{
+				dlist_delete(&entry->lru_chain);
+				pgcache_head->program_cache_usage -= entry->entry_sz;
+			}
+			pfree(entry);
+		}
+	}
 }
 
 /*
@@ -382,19 +620,24 @@ link_cuda_libraries(char *ptx_image,
 			{ "cuda_rangetype",	DEVKERNEL_NEEDS_RANGETYPE },
 			{ "cuda_postgis",	DEVKERNEL_NEEDS_POSTGIS },
 			{ "cuda_gpuscan",   DEVKERNEL_NEEDS_GPUSCAN },
+			{ "cuda_gpuscan_simple", DEVKERNEL_GPUSCAN_SIMPLE },
 			{ "cuda_gpujoin",   DEVKERNEL_NEEDS_GPUJOIN },
 			{ "cuda_gpupreagg", DEVKERNEL_NEEDS_GPUPREAGG },
 			{ "cuda_gpusort",   DEVKERNEL_NEEDS_GPUSORT },
+			{ "cuda_gpusort_radix", DEVKERNEL_GPUSORT_RADIX },
 			{ NULL, 0 },
 		};
 		cl_int		i;
 
-		/* add the base PTX image */
-		rc = cuLinkAddData(lstate, CU_JIT_INPUT_PTX,
-						   ptx_image, ptx_length,
-						   "pg-strom", 0, NULL, NULL);
-		if (rc != CUDA_SUCCESS)
-			elog(ERROR, "failed on cuLinkAddData: %s", errorText(rc));
+		/* add the base PTX image, if not precompiled kernel */
+		if (ptx_length > 0)
+		{
+			rc = cuLinkAddData(lstate, CU_JIT_INPUT_PTX,
+							   ptx_image, ptx_length,
+							   "pg-strom", 0, NULL, NULL);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on cuLinkAddData: %s", errorText(rc));
+		}
 
 		/* other libraries */
 		for (i=0; catalog[i].libname != NULL; i++)
@@ -506,6 +749,282 @@ writeout_temporary_file(char *tempfile, const char *suffix,
 	fclose(filp);
 }
 
+/*
+ * On-disk program cache
+ *
+ * PTX images built by NVRTC are also saved on the disk, so the run-time
+ * compilation is skipped after the restart, or once the entry is reclaimed
+ * from the shared program cache. Build failures are never saved.
+ * It is a best-effort; any errors are not raised.
+ */
+static const char *
+pgcache_file_version_stamp(void)
+{
+	static char	stamp[PGCACHE_FILE_STAMP_LEN] = "";
+
+	if (stamp[0] == '\0')
+	{
+		struct stat	stat_buf;
+		long		mtime = 0;
+
+		/* device headers may be replaced without version up */
+		if (stat(PGSHAREDIR "/pg_strom/cuda_common.h", &stat_buf) == 0)
+			mtime = stat_buf.st_mtime;
+		snprintf(stamp, sizeof(stamp), "%s:%s:cuda=%d:nvrtc=%d:%lx",
+				 PGSTROM_VERSION,
+				 PGSTROM_GITHASH,
+				 CUDA_VERSION,
+				 pgstrom_nvrtc_version(),
+				 mtime);
+	}
+	return stamp;
+}
+
+static bool
+pgcache_file_name(char *fname, size_t len, program_cache_entry *entry)
+{
+	if (!program_cache_dir || program_cache_dir[0] == '\0')
+		return false;
+	snprintf(fname, len, "%s/%08x-%d-%08x-%u.ptx",
+			 program_cache_dir,
+			 entry->crc,
+			 entry->target_cc,
+			 entry->extra_flags,
+			 entry->varlena_bufsz);
+	return true;
+}
+
+/*
+ * pgcache_file_lookup
+ *
+ * It returns the PTX image (malloc'ed) of the on-disk program cache that is
+ * equivalent to the @entry, or NULL if not found. Obsoleted or broken ones
+ * are removed.
+ */
+static char *
+pgcache_file_lookup(program_cache_entry *entry, size_t *p_ptx_length)
+{
+	program_cache_file_head *head;
+	char		fname[MAXPGPATH];
+	struct stat	stat_buf;
+	char	   *data = NULL;
+	char	   *pos;
+	char	   *ptx_image = NULL;
+	pg_crc32	ptx_crc;
+	int			fdesc;
+
+	if (!pgcache_file_name(fname, sizeof(fname), entry))
+		return NULL;
+	fdesc = OpenTransientFile(fname, O_RDONLY | PG_BINARY);
+	if (fdesc < 0)
+		return NULL;
+	if (fstat(fdesc, &stat_buf) != 0 ||
+		stat_buf.st_size < sizeof(program_cache_file_head))
+		goto invalid;
+	data = palloc(stat_buf.st_size);
+	if (__readFile(fdesc, data, stat_buf.st_size) != stat_buf.st_size)
+		goto invalid;
+	head = (program_cache_file_head *)data;
+	if (memcmp(head->magic, PGCACHE_FILE_MAGIC, sizeof(PGCACHE_FILE_MAGIC)) != 0 ||
+		strncmp(head->stamp, pgcache_file_version_stamp(),
+				PGCACHE_FILE_STAMP_LEN) != 0 ||
+		head->target_cc != entry->target_cc ||
+		head->extra_flags != entry->extra_flags ||
+		head->varlena_bufsz != entry->varlena_bufsz ||
+		head->kern_deflen != entry->kern_deflen ||
+		head->kern_srclen != entry->kern_srclen ||
+		stat_buf.st_size != (sizeof(program_cache_file_head) +
+							 head->kern_deflen + 1 +
+							 head->kern_srclen + 1 +
+							 head->ptx_length))
+		goto invalid;
+	pos = data + sizeof(program_cache_file_head);
+	if (memcmp(pos, entry->kern_define, entry->kern_deflen + 1) != 0)
+		goto collision;
+	pos += head->kern_deflen + 1;
+	if (memcmp(pos, entry->kern_source, entry->kern_srclen + 1) != 0)
+		goto collision;
+	pos += head->kern_srclen + 1;
+
+	INIT_LEGACY_CRC32(ptx_crc);
+	COMP_LEGACY_CRC32(ptx_crc, pos, head->ptx_length);
+	FIN_LEGACY_CRC32(ptx_crc);
+	if (head->ptx_length == 0 || ptx_crc != head->ptx_crc)
+		goto invalid;
+	ptx_image = malloc(head->ptx_length);
+	if (!ptx_image)
+		goto collision;
+	memcpy(ptx_image, pos, head->ptx_length);
+	*p_ptx_length = head->ptx_length;
+	CloseTransientFile(fdesc);
+	pfree(data);
+	/* update the mtime for LRU reclaim */
+	if (utime(fname, NULL) != 0)
+		elog(DEBUG1, "failed on utime('%s'): %m", fname);
+	elog(DEBUG2, "CUDA program was loaded from '%s'", fname);
+	return ptx_image;
+
+collision:
+	/* hash collision; other program shall overwrite the file */
+	CloseTransientFile(fdesc);
+	pfree(data);
+	return NULL;
+
+invalid:
+	CloseTransientFile(fdesc);
+	if (data)
+		pfree(data);
+	elog(DEBUG2, "on-disk program cache '%s' is obsolete", fname);
+	if (unlink(fname) != 0 && errno != ENOENT)
+		elog(DEBUG1, "failed on unlink('%s'): %m", fname);
+	return NULL;
+}
+
+/*
+ * pgcache_file_reclaim
+ *
+ * It removes the least recently used files if the on-disk program cache
+ * consumes more than pg_strom.program_cache_dir_size.
+ */
+typedef struct
+{
+	time_t		mtime;
+	off_t		size;
+	char		name[MAXPGPATH];
+} program_cache_file_item;
+
+static int
+pgcache_file_item_comp(const void *__a, const void *__b)
+{
+	const program_cache_file_item *a = __a;
+	const program_cache_file_item *b = __b;
+
+	if (a->mtime < b->mtime)
+		return -1;
+	if (a->mtime > b->mtime)
+		return 1;
+	return 0;
+}
+
+static void
+pgcache_file_reclaim(void)
+{
+	size_t		threshold = ((size_t)program_cache_dir_size_kb << 10);
+	size_t		total_sz = 0;
+	program_cache_file_item *items;
+	int			nitems = 0;
+	int			nrooms = 100;
+	DIR		   *dir;
+	struct dirent *dent;
+	int			i;
+
+	dir = AllocateDir(program_cache_dir);
+	if (!dir)
+		return;
+	items = palloc(sizeof(program_cache_file_item) * nrooms);
+	while ((dent = ReadDirExtended(dir, program_cache_dir, DEBUG1)) != NULL)
+	{
+		program_cache_file_item *item;
+		struct stat	stat_buf;
+		size_t		len = strlen(dent->d_name);
+
+		if (len < 4 || strcmp(dent->d_name + len - 4, ".ptx") != 0)
+			continue;
+		if (nitems == nrooms)
+		{
+			nrooms *= 2;
+			items = repalloc(items, sizeof(program_cache_file_item) * nrooms);
+		}
+		item = &items[nitems];
+		snprintf(item->name, MAXPGPATH, "%s/%s",
+				 program_cache_dir, dent->d_name);
+		if (stat(item->name, &stat_buf) != 0)
+			continue;
+		item->mtime = stat_buf.st_mtime;
+		item->size = stat_buf.st_size;
+		total_sz += stat_buf.st_size;
+		nitems++;
+	}
+	FreeDir(dir);
+
+	if (total_sz > threshold)
+	{
+		qsort(items, nitems, sizeof(program_cache_file_item),
+			  pgcache_file_item_comp);
+		for (i=0; i < nitems && total_sz > threshold; i++)
+		{
+			if (unlink(items[i].name) != 0)
+			{
+				if (errno != ENOENT)
+					elog(DEBUG1, "failed on unlink('%s'): %m", items[i].name);
+				continue;
+			}
+			total_sz -= items[i].size;
+		}
+	}
+	pfree(items);
+}
+
+/*
+ * pgcache_file_write
+ */
+static void
+pgcache_file_write(program_cache_entry *entry,
+				   const char *ptx_image, size_t ptx_length)
+{
+	program_cache_file_head head;
+	char		fname[MAXPGPATH];
+	char		tname[MAXPGPATH];
+	int			fdesc;
+
+	if (!pgcache_file_name(fname, sizeof(fname), entry))
+		return;
+	memset(&head, 0, sizeof(program_cache_file_head));
+	memcpy(head.magic, PGCACHE_FILE_MAGIC, sizeof(PGCACHE_FILE_MAGIC));
+	strncpy(head.stamp, pgcache_file_version_stamp(), PGCACHE_FILE_STAMP_LEN);
+	head.target_cc     = entry->target_cc;
+	head.extra_flags   = entry->extra_flags;
+	head.varlena_bufsz = entry->varlena_bufsz;
+	head.kern_deflen   = entry->kern_deflen;
+	head.kern_srclen   = entry->kern_srclen;
+	head.ptx_length    = ptx_length;
+	INIT_LEGACY_CRC32(head.ptx_crc);
+	COMP_LEGACY_CRC32(head.ptx_crc, ptx_image, ptx_length);
+	FIN_LEGACY_CRC32(head.ptx_crc);
+
+	if (mkdir(program_cache_dir, pg_dir_create_mode) != 0 &&
+		errno != EEXIST)
+	{
+		elog(DEBUG1, "failed on mkdir('%s'): %m", program_cache_dir);
+		return;
+	}
+	snprintf(tname, sizeof(tname), "%s.%d.tmp", fname, MyProcPid);
+	fdesc = OpenTransientFile(tname, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (fdesc < 0)
+	{
+		elog(DEBUG1, "failed on open('%s'): %m", tname);
+		return;
+	}
+	if (__writeFile(fdesc, &head, sizeof(program_cache_file_head)) != sizeof(program_cache_file_head) ||
+		__writeFile(fdesc, entry->kern_define, entry->kern_deflen + 1) != entry->kern_deflen + 1 ||
+		__writeFile(fdesc, entry->kern_source, entry->kern_srclen + 1) != entry->kern_srclen + 1 ||
+		__writeFile(fdesc, ptx_image, ptx_length) != ptx_length)
+	{
+		elog(DEBUG1, "failed on write('%s'): %m", tname);
+		CloseTransientFile(fdesc);
+		unlink(tname);
+		return;
+	}
+	CloseTransientFile(fdesc);
+	if (rename(tname, fname) != 0)
+	{
+		elog(DEBUG1, "failed on rename('%s','%s'): %m", tname, fname);
+		unlink(tname);
+		return;
+	}
+	pgcache_file_reclaim();
+}
+
 /*
  * pgstrom_cuda_source_string
  *
@@ -588,6 +1107,216 @@ pgstrom_cuda_binary_file(ProgramId program_id)
 	return pstrdup(tempfilepath);
 }
 
+/*
+ * pgstrom_program_build_count - # of pending/running program builds
+ */
+void
+pgstrom_program_build_count(int *p_pending, int *p_running)
+{
+	int			pending = 0;
+	int			i;
+
+	SpinLockAcquire(&pgcache_head->lock);
+	for (i=0; i < PGCACHE_BUILD_NUM_PRIOS; i++)
+		pending += pgcache_head->build_stats[i].queue_depth;
+	*p_running = pgcache_head->num_builds_running;
+	SpinLockRelease(&pgcache_head->lock);
+	*p_pending = pending;
+}
+
+/*
+ * pgstrom_cuda_program_build_usec
+ *
+ * It returns the time to build the program, if the build was completed
+ * after @since; usually, the start of the statement that requested it.
+ * A program already on the cache is free for the statement.
+ */
+uint64
+pgstrom_cuda_program_build_usec(ProgramId program_id, TimestampTz since)
+{
+	program_cache_entry *entry;
+	uint64		build_usec = 0;
+
+	if (program_id == INVALID_PROGRAM_ID)
+		return 0;
+	SpinLockAcquire(&pgcache_head->lock);
+	entry = lookup_cuda_program_entry_nolock(program_id);
+	if (entry && entry->build_finished >= since)
+		build_usec = entry->build_usec;
+	SpinLockRelease(&pgcache_head->lock);
+
+	return build_usec;
+}
+
+/*
+ * lookup_autotune_slot_nolock - lookup (or assign) the autotuning status of
+ * the kernel function on the device
+ */
+static pgcache_autotune *
+lookup_autotune_slot_nolock(program_cache_entry *entry,
+							pg_crc32 kern_hash,
+							int cuda_dindex,
+							bool create)
+{
+	pgcache_autotune *atune;
+	int			i;
+
+	for (i=0; i < PGCACHE_AUTOTUNE_NSLOTS; i++)
+	{
+		atune = &entry->autotune[i];
+		if (atune->kern_hash == 0)
+		{
+			if (!create)
+				break;
+			atune->kern_hash = kern_hash;
+			atune->cuda_dindex = cuda_dindex;
+			return atune;
+		}
+		if (atune->kern_hash == kern_hash &&
+			atune->cuda_dindex == cuda_dindex)
+			return atune;
+	}
+	return NULL;
+}
+
+static pg_crc32
+autotune_kern_hash(const char *kern_fname)
+{
+	pg_crc32	kern_hash;
+
+	INIT_LEGACY_CRC32(kern_hash);
+	COMP_LEGACY_CRC32(kern_hash, kern_fname, strlen(kern_fname));
+	FIN_LEGACY_CRC32(kern_hash);
+
+	return (kern_hash != 0 ? kern_hash : 1);
+}
+
+/*
+ * pgstrom_autotune_block_size
+ *
+ * It returns the block size to launch the kernel function of the program
+ * on the device. The first launches try the candidates in turn; i.e, the
+ * @max_block_sz by the occupancy calculation, and its 1/2, 1/4 and 1/8 in
+ * multiple of the warp size, because register-heavy kernels often run
+ * faster with smaller blocks. Then, the fastest one is returned.
+ * @p_trial is set to the index of the candidate being tried, or -1 if
+ * caller does not need to report the result.
+ * Note that it may be called by the GPU worker threads, so never raise
+ * an error here.
+ */
+int
+pgstrom_autotune_block_size(ProgramId program_id,
+							const char *kern_fname,
+							int cuda_dindex,
+							int max_block_sz,
+							int *p_trial)
+{
+	program_cache_entry *entry;
+	pgcache_autotune *atune;
+	pg_crc32	kern_hash;
+	int			warp_sz = Max(devAttrs[cuda_dindex].WARP_SIZE, 1);
+	int			block_sz = max_block_sz;
+	int			i, k;
+
+	*p_trial = -1;
+	if (pgstrom_autotune_trials <= 0 || max_block_sz < 2 * warp_sz)
+		return max_block_sz;
+	kern_hash = autotune_kern_hash(kern_fname);
+
+	SpinLockAcquire(&pgcache_head->lock);
+	entry = lookup_cuda_program_entry_nolock(program_id);
+	if (!entry)
+		goto out;
+	atune = lookup_autotune_slot_nolock(entry, kern_hash, cuda_dindex, true);
+	if (!atune)
+		goto out;
+	if (atune->ncands == 0)
+	{
+		/* setup the candidates */
+		for (i=0; i < PGCACHE_AUTOTUNE_NCANDS; i++)
+		{
+			int		sz = TYPEALIGN_DOWN(warp_sz, max_block_sz >> i);
+
+			if (sz < warp_sz ||
+				(atune->ncands > 0 && atune->block_sz[atune->ncands-1] == sz))
+				break;
+			atune->block_sz[atune->ncands++] = sz;
+		}
+	}
+	if (atune->best_block_sz > 0)
+		block_sz = atune->best_block_sz;
+	else if (atune->block_sz[0] != max_block_sz)
+	{
+		/* occupancy calculation was changed?, so retry autotuning */
+		memset(atune, 0, sizeof(pgcache_autotune));
+		atune->kern_hash = kern_hash;
+		atune->cuda_dindex = cuda_dindex;
+	}
+	else
+	{
+		/* the candidate with the least trials */
+		for (i=1, k=0; i < atune->ncands; i++)
+		{
+			if (atune->ntrials[i] < atune->ntrials[k])
+				k = i;
+		}
+		block_sz = atune->block_sz[k];
+		*p_trial = k;
+	}
+out:
+	SpinLockRelease(&pgcache_head->lock);
+
+	return block_sz;
+}
+
+/*
+ * pgstrom_autotune_report
+ *
+ * It reports the elapsed time of the kernel launched with the candidate
+ * block size by pgstrom_autotune_block_size. Once all the candidates are
+ * tried enough times, the fastest one is recorded to the program cache.
+ */
+void
+pgstrom_autotune_report(ProgramId program_id,
+						const char *kern_fname,
+						int cuda_dindex,
+						int trial,
+						size_t nitems,
+						float elapsed_ms)
+{
+	program_cache_entry *entry;
+	pgcache_autotune *atune;
+	pg_crc32	kern_hash;
+	int			i, k;
+
+	if (trial < 0 || nitems == 0 || elapsed_ms <= 0.0)
+		return;
+	kern_hash = autotune_kern_hash(kern_fname);
+
+	SpinLockAcquire(&pgcache_head->lock);
+	entry = lookup_cuda_program_entry_nolock(program_id);
+	if (!entry)
+		goto out;
+	atune = lookup_autotune_slot_nolock(entry, kern_hash, cuda_dindex, false);
+	if (!atune || atune->best_block_sz > 0 || trial >= atune->ncands)
+		goto out;
+	atune->ntrials[trial]++;
+	atune->nitems[trial] += nitems;
+	atune->elapsed[trial] += elapsed_ms;
+
+	for (i=0, k=0; i < atune->ncands; i++)
+	{
+		if (atune->ntrials[i] < pgstrom_autotune_trials)
+			goto out;
+		if (atune->elapsed[i] / (double)atune->nitems[i] <
+			atune->elapsed[k] / (double)atune->nitems[k])
+			k = i;
+	}
+	atune->best_block_sz = atune->block_sz[k];
+out:
+	SpinLockRelease(&pgcache_head->lock);
+}
+
 /*
  * build_cuda_program - an interface to run synchronous build process
  */
@@ -609,6 +1338,7 @@ build_cuda_program(program_cache_entry *src_entry)
 	int				hindex;
 	size_t			offset;
 	size_t			length;
+	bool			nvtx_pushed;
 
 	Assert(!src_entry->build_chain.prev && !src_entry->build_chain.next);
 
@@ -624,6 +1354,36 @@ build_cuda_program(program_cache_entry *src_entry)
 	{
 		char	gpu_arch_option[256];
 
+		/*
+		 * Precompiled GpuScan/GpuSort kernel (cuda_gpuscan_simple.fatbin
+		 * or cuda_gpusort_radix.fatbin) has no PTX image to be built; it
+		 * shall be linked with the libraries.
+		 */
+		if ((src_entry->extra_flags & (DEVKERNEL_GPUSCAN_SIMPLE |
+									   DEVKERNEL_GPUSORT_RADIX)) != 0)
+		{
+			ptx_image = strdup("");
+			build_log = strdup((src_entry->extra_flags &
+								DEVKERNEL_GPUSORT_RADIX) != 0
+							   ? "precompiled GpuSort kernel"
+							   : "precompiled GpuScan kernel");
+			if (!ptx_image || !build_log)
+				elog(ERROR, "out of memory");
+			log_length = strlen(build_log);
+			goto build_done;
+		}
+
+		/* equivalent PTX image may exist on the disk */
+		ptx_image = pgcache_file_lookup(src_entry, &ptx_length);
+		if (ptx_image)
+		{
+			build_log = strdup("loaded from the on-disk program cache");
+			if (!build_log)
+				elog(ERROR, "out of memory");
+			log_length = strlen(build_log);
+			goto build_done;
+		}
+
 		rc = nvrtcCreateProgram(&program,
 								source,
 								"pg-strom",
@@ -656,7 +1416,12 @@ build_cuda_program(program_cache_entry *src_entry)
 		/*
 		 * Kick runtime compiler
 		 */
+		nvtx_pushed = gpuTraceRangePush("build cuda program id=%ld flags=%08x",
+										(long)src_entry->program_id,
+										src_entry->extra_flags);
 		rc = nvrtcCompileProgram(program, opt_index, options);
+		if (nvtx_pushed)
+			gpuTraceRangePop();
 		if (rc == NVRTC_ERROR_COMPILATION)
 		{
 			writeout_temporary_file(tempfile, "gpu",
@@ -709,7 +1474,13 @@ build_cuda_program(program_cache_entry *src_entry)
 		if (rc != NVRTC_SUCCESS)
 			elog(ERROR, "failed on nvrtcDestroyProgram: %s",
 				   nvrtcGetErrorString(rc));
+		program = NULL;
 
+		/* save the PTX image for the next time */
+		if (ptx_image)
+			pgcache_file_write(src_entry, ptx_image, ptx_length);
+
+	build_done:
 		/*
 		 * Allocation of a new entry, to keep ptx_image/build_log
 		 */
@@ -819,7 +1590,161 @@ build_cuda_program(program_cache_entry *src_entry)
 		free(ptx_image);
 	free(source);
 
-	return bin_entry;
+	return bin_entry;
+}
+
+/*
+ * __pgstrom_cuda_program_target_cc
+ */
+static cl_int
+__pgstrom_cuda_program_target_cc(int dindex)
+{
+	cl_int		target_cc;
+	cl_int		nvrtc_version;
+
+	/* Target binary to build
+	 *
+	 * The target binary version shall be determined by CUDA_VERSION
+	 * when PG-Strom was built for, NVRTC_VERSION when PG-Strom loaded it
+	 * at the runtime, and device's computing-capability version.
+	 */
+	Assert(dindex >= 0 && dindex < numDevAttrs);
+	target_cc = (devAttrs[dindex].COMPUTE_CAPABILITY_MAJOR * 10 +
+				 devAttrs[dindex].COMPUTE_CAPABILITY_MINOR);
+
+	nvrtc_version = pgstrom_nvrtc_version();
+#if CUDA_VERSION >= 10010
+#if CUDA_VERSION >= 11010
+	if (nvrtc_version >= 11010 && target_cc >= 80)
+	{
+		/* CUDA 11.1 added CC8.0 (Ampere) support */
+		target_cc = 80;
+	}
+	else
+#endif
+	if (nvrtc_version >= 10010 && target_cc >= 75)
+	{
+		/* CUDA 10.1 added CC7.5 (Turing) support */
+		target_cc = 75;
+	}
+	else
+#endif
+	{
+		/*
+		 * CUDA 9.0 added CC6.0/6.1 (Pascal) and CC7.0 (Volta) support.
+		 * And, PG-Strom does not support older CUDA Toolkit any more.
+		 */
+		if (target_cc >= 70)
+			target_cc = 70;		/* any Volta */
+		else if (target_cc >= 61)
+			target_cc = 61;		/* Pascal except for GP100 */
+		else
+			target_cc = 60;
+	}
+	return target_cc;
+}
+
+/*
+ * __pgstrom_alloc_cuda_program_entry_nolock
+ *
+ * It allocates a new program cache entry, then links it to the hash, LRU
+ * and build-pending list of @build_prio. Caller must hold pgcache_head->lock.
+ */
+static program_cache_entry *
+__pgstrom_alloc_cuda_program_entry_nolock(pg_crc32 crc, int hindex,
+										  cl_int target_cc,
+										  cl_uint extra_flags,
+										  cl_uint varlena_bufsz,
+										  const char *kern_source,
+										  const char *kern_define,
+										  int refcnt,
+										  int build_prio)
+{
+	program_cache_entry *entry;
+	ProgramId	program_id;
+	Size		kern_srclen = strlen(kern_source);
+	Size		kern_deflen = strlen(kern_define);
+	Size		length;
+	Size		usage = 0;
+
+	length = (offsetof(program_cache_entry, data) +
+			  MAXALIGN(kern_srclen + 1) +
+			  MAXALIGN(kern_deflen + 1) +
+			  PGCACHE_MIN_ERRORMSG_BUFSIZE);
+	PG_TRY();
+	{
+		entry = MemoryContextAllocZero(TopSharedMemoryContext, length);
+	}
+	PG_CATCH();
+	{
+		SpinLockRelease(&pgcache_head->lock);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	/* find out a unique program_id */
+	do {
+		program_id = ++pgcache_head->last_program_id;
+	} while (lookup_cuda_program_entry_nolock(program_id) != NULL);
+
+	entry->entry_sz    = length;
+	entry->refcnt      = refcnt;
+	entry->magic       = PGCACHE_CHUNK_MAGIC;
+	entry->program_id  = program_id;
+	entry->crc         = crc;
+	entry->target_cc   = target_cc;
+	entry->extra_flags = extra_flags;
+	entry->kern_define = (char *)(entry->data + usage);
+	entry->kern_deflen = kern_deflen;
+	memcpy(entry->kern_define, kern_define, kern_deflen + 1);
+	usage += MAXALIGN(kern_deflen + 1);
+
+	entry->kern_source = (char *)(entry->data + usage);
+	entry->kern_srclen = kern_srclen;
+	memcpy(entry->kern_source, kern_source, kern_srclen + 1);
+	usage += MAXALIGN(kern_srclen + 1);
+
+	/*
+	 * An extra margin on the @varlena_bufsz might be valuable to avoid
+	 * unnecessary program rebuild if program contains device functions
+	 * that can return varlena datum. Because @varlena_bufsz estimation
+	 * can be affected by small changes in query;
+	 * e.g, substring(X from 0 for 3) will make different value from
+	 * the substring(X from 1 for 4), but code itself shall not be
+	 * changed. So, extra margin will help the case.
+	 * Literal constants are always delivered by kern_parambuf, so queries
+	 * that differ only in the constants generate identical source code,
+	 * however, the length of text literals still affects the estimation.
+	 * So, @varlena_bufsz is rounded up to the power of 2 (256 at least),
+	 * to share the program among them.
+	 */
+	if (varlena_bufsz == 0)
+		entry->varlena_bufsz = 0;
+	else if (varlena_bufsz + 36 <= KERN_CONTEXT_VARLENA_BUFSZ_LIMIT)
+		entry->varlena_bufsz = Min(Max(1U << get_next_log2(varlena_bufsz + 36),
+									   256),
+								   KERN_CONTEXT_VARLENA_BUFSZ_LIMIT);
+	else
+		entry->varlena_bufsz = MAXALIGN(varlena_bufsz + 36);
+
+	/* no cuda binary at this moment */
+	entry->ptx_image = NULL;
+	entry->ptx_length = 0;
+	/* remaining are for error message */
+	entry->error_msg = (char *)(entry->data + usage);
+
+	/* add an entry for program build in-progress */
+	dlist_push_head(&pgcache_head->pgid_slots[program_id % PGCACHE_HASH_SIZE],
+					&entry->pgid_chain);
+	dlist_push_head(&pgcache_head->hash_slots[hindex],
+					&entry->hash_chain);
+	dlist_push_head(&pgcache_head->lru_list,
+					&entry->lru_chain);
+	entry->build_speculative = (build_prio == PGCACHE_BUILD_PRIO__SPECULATIVE);
+	pgcache_build_enqueue_nolock(entry, build_prio);
+	pgcache_head->program_cache_usage += entry->entry_sz;
+
+	return entry;
 }
 
 /*
@@ -842,12 +1767,9 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 	ProgramId	program_id;
 	Size		kern_srclen = strlen(kern_source);
 	Size		kern_deflen = strlen(kern_define);
-	Size		length;
-	Size		usage = 0;
 	int			dindex = gcontext->cuda_dindex;
 	int			hindex;
 	cl_int		target_cc;
-	cl_int		nvrtc_version;
 	dlist_iter	iter;
 	pg_crc32	crc;
 
@@ -855,45 +1777,7 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 	if (pgstrom_debug_jit_compile_options)
 		extra_flags |= DEVKERNEL_BUILD_DEBUG_INFO;
 
-	/* Target binary to build
-	 *
-	 * The target binary version shall be determined by CUDA_VERSION
-	 * when PG-Strom was built for, NVRTC_VERSION when PG-Strom loaded it
-	 * at the runtime, and device's computing-capability version.
-	 */
-	Assert(dindex >= 0 && dindex < numDevAttrs);
-	target_cc = (devAttrs[dindex].COMPUTE_CAPABILITY_MAJOR * 10 +
-				 devAttrs[dindex].COMPUTE_CAPABILITY_MINOR);
-
-	nvrtc_version = pgstrom_nvrtc_version();
-#if CUDA_VERSION >= 10010
-#if CUDA_VERSION >= 11010
-	if (nvrtc_version >= 11010 && target_cc >= 80)
-	{
-		/* CUDA 11.1 added CC8.0 (Ampere) support */
-		target_cc = 80;
-	}
-	else
-#endif
-	if (nvrtc_version >= 10010 && target_cc >= 75)
-	{
-		/* CUDA 10.1 added CC7.5 (Turing) support */
-		target_cc = 75;
-	}
-	else
-#endif
-	{
-		/*
-		 * CUDA 9.0 added CC6.0/6.1 (Pascal) and CC7.0 (Volta) support.
-		 * And, PG-Strom does not support older CUDA Toolkit any more.
-		 */
-		if (target_cc >= 70)
-			target_cc = 70;		/* any Volta */
-		else if (target_cc >= 61)
-			target_cc = 61;		/* Pascal except for GP100 */
-		else
-			target_cc = 60;
-	}
+	target_cc = __pgstrom_cuda_program_target_cc(dindex);
 
 	/* makes a hash value */
 	INIT_LEGACY_CRC32(crc);
@@ -922,6 +1806,12 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 			get_cuda_program_entry_nolock(entry);
 			/* Move this entry to the head of LRU list */
 			dlist_move_head(&pgcache_head->lru_list, &entry->lru_chain);
+			/* Promote the pending build, if we have higher priority */
+			if (!entry->ptx_image &&
+				entry->build_chain.prev != NULL &&
+				entry->build_chain.next != NULL &&
+				entry->build_prio > pgstrom_program_build_priority)
+				pgcache_build_move_nolock(entry, pgstrom_program_build_priority);
 		retry_checks:
 			if (entry->ptx_image != NULL || !wait_for_build)
 			{
@@ -985,73 +1875,15 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 	 * Not found on the existing program cache.
 	 * So, create a new entry then kick NVRTC
 	 */
-	length = (offsetof(program_cache_entry, data) +
-			  MAXALIGN(kern_srclen + 1) +
-			  MAXALIGN(kern_deflen + 1) +
-			  PGCACHE_MIN_ERRORMSG_BUFSIZE);
-	PG_TRY();
-	{
-		entry = MemoryContextAllocZero(TopSharedMemoryContext, length);
-	}
-	PG_CATCH();
-	{
-		SpinLockRelease(&pgcache_head->lock);
-		PG_RE_THROW();
-	}
-	PG_END_TRY();
-
-	/* find out a unique program_id */
-	do {
-		program_id = ++pgcache_head->last_program_id;
-	} while (lookup_cuda_program_entry_nolock(program_id) != NULL);
-
-	entry->entry_sz    = length;
-	entry->refcnt      = 3;		/* caller + build */
-	entry->magic       = PGCACHE_CHUNK_MAGIC;
-	entry->program_id  = program_id;
-	entry->crc         = crc;
-	entry->target_cc   = target_cc;
-	entry->extra_flags = extra_flags;
-	entry->kern_define = (char *)(entry->data + usage);
-	entry->kern_deflen = kern_deflen;
-	memcpy(entry->kern_define, kern_define, kern_deflen + 1);
-	usage += MAXALIGN(kern_deflen + 1);
-
-	entry->kern_source = (char *)(entry->data + usage);
-	entry->kern_srclen = kern_srclen;
-	memcpy(entry->kern_source, kern_source, kern_srclen + 1);
-	usage += MAXALIGN(kern_srclen + 1);
-
-	/*
-	 * An extra margin on the @varlena_bufsz might be valuable to avoid
-	 * unnecessary program rebuild if program contains device functions
-	 * that can return varlena datum. Because @varlena_bufsz estimation
-	 * can be affected by small changes in query;
-	 * e.g, substring(X from 0 for 3) will make different value from
-	 * the substring(X from 1 for 4), but code itself shall not be
-	 * changed. So, extra margin will help the case.
-	 */
-	if (varlena_bufsz == 0)
-		entry->varlena_bufsz = 0;
-	else
-		entry->varlena_bufsz = MAXALIGN(varlena_bufsz + 36);
-
-	/* no cuda binary at this moment */
-	entry->ptx_image = NULL;
-	entry->ptx_length = 0;
-	/* remaining are for error message */
-	entry->error_msg = (char *)(entry->data + usage);
-
-	/* add an entry for program build in-progress */
-	dlist_push_head(&pgcache_head->pgid_slots[program_id % PGCACHE_HASH_SIZE],
-					&entry->pgid_chain);
-	dlist_push_head(&pgcache_head->hash_slots[hindex],
-					&entry->hash_chain);
-	dlist_push_head(&pgcache_head->lru_list,
-					&entry->lru_chain);
-	dlist_push_head(&pgcache_head->build_list,
-					&entry->build_chain);
-	pgcache_head->program_cache_usage += entry->entry_sz;
+	entry = __pgstrom_alloc_cuda_program_entry_nolock(crc, hindex,
+													   target_cc,
+													   extra_flags,
+													   varlena_bufsz,
+													   kern_source,
+													   kern_define,
+													   3,	/* caller + build */
+													   pgstrom_program_build_priority);
+	program_id = entry->program_id;
 
 	/* track this program entry by GpuContext */
 	if (!trackCudaProgram(gcontext, program_id,
@@ -1113,6 +1945,83 @@ __pgstrom_create_cuda_program(GpuContext *gcontext,
 	return program_id;
 }
 
+/*
+ * pgstrom_prebuild_cuda_program
+ *
+ * It enqueues a GPU program to the program builders at the plan time, to
+ * launch NVRTC prior to the query execution. It does not wait for the build,
+ * and does not track the entry by any GpuContext; the entry is kept on the
+ * program cache only, then pgstrom_create_cuda_program() at the executor
+ * initialization will pick it up, if not reclaimed yet.
+ */
+void
+pgstrom_prebuild_cuda_program(int cuda_dindex,
+							  cl_uint extra_flags,
+							  cl_uint varlena_bufsz,
+							  const char *kern_source,
+							  const char *kern_define)
+{
+	program_cache_entry	*entry;
+	int			hindex;
+	cl_int		target_cc;
+	dlist_iter	iter;
+	pg_crc32	crc;
+
+	if (!pgstrom_program_prebuild || numDevAttrs == 0)
+		return;
+	/* same device selection with AllocGpuContext, if no preference */
+	if (cuda_dindex < 0 || cuda_dindex >= numDevAttrs)
+		cuda_dindex = (IsParallelWorker()
+					   ? ParallelWorkerNumber
+					   : MyProc->pgprocno) % numDevAttrs;
+	/* build with debug option? */
+	if (pgstrom_debug_jit_compile_options)
+		extra_flags |= DEVKERNEL_BUILD_DEBUG_INFO;
+	target_cc = __pgstrom_cuda_program_target_cc(cuda_dindex);
+
+	/* makes a hash value */
+	INIT_LEGACY_CRC32(crc);
+	COMP_LEGACY_CRC32(crc, &target_cc, sizeof(cl_int));
+	COMP_LEGACY_CRC32(crc, &extra_flags, sizeof(int32));
+	COMP_LEGACY_CRC32(crc, kern_source, strlen(kern_source));
+	COMP_LEGACY_CRC32(crc, kern_define, strlen(kern_define));
+	FIN_LEGACY_CRC32(crc);
+
+	hindex = crc % PGCACHE_HASH_SIZE;
+	SpinLockAcquire(&pgcache_head->lock);
+	dlist_foreach (iter, &pgcache_head->hash_slots[hindex])
+	{
+		entry = dlist_container(program_cache_entry, hash_chain, iter.cur);
+
+		if (entry->crc == crc &&
+			entry->target_cc == target_cc &&
+			entry->extra_flags == extra_flags &&
+			strcmp(entry->kern_source, kern_source) == 0 &&
+			strcmp(entry->kern_define, kern_define) == 0 &&
+			entry->varlena_bufsz >= varlena_bufsz)
+		{
+			/* already built, or build in-progress */
+			SpinLockRelease(&pgcache_head->lock);
+			return;
+		}
+	}
+	/* only build holds the reference; LRU keeps the entry after that */
+	entry = __pgstrom_alloc_cuda_program_entry_nolock(crc, hindex,
+													  target_cc,
+													  extra_flags,
+													  varlena_bufsz,
+													  kern_source,
+													  kern_define,
+													  1,
+													  PGCACHE_BUILD_PRIO__SPECULATIVE);
+	elog(DEBUG1, "CUDA Program ID=%lu is enqueued for prebuild",
+		 entry->program_id);
+	reclaim_cuda_program_entry_nolock();
+	SpinLockRelease(&pgcache_head->lock);
+
+	cudaProgramBuilderWakeUp(false);
+}
+
 /*
  * pgstrom_put_cuda_program
  *
@@ -1483,6 +2392,98 @@ assign_timelib_session_info(StringInfo buf)
 	appendStringInfoChar(buf, '\n');
 }
 
+/*
+ * pgstrom_timezone_table
+ *
+ * It builds kern_tz_table in bytea form for the time zone name given to
+ * timezone(text,...), according to the manner of timestamptz_zone(); time
+ * zone abbreviation first, then the full time zone name. It returns NULL
+ * if the zone is not supported on the device (dynamic abbreviation, or
+ * unknown time zone).
+ */
+bytea *
+pgstrom_timezone_table(const char *tzname)
+{
+	char	   *lowzone;
+	int			type, val;
+	pg_tz	   *tzp;
+	const struct state *sp;
+	struct state *temp = NULL;
+	kern_tz_table *tztab;
+	size_t		ats_offset;
+	size_t		types_offset;
+	size_t		ttis_offset;
+	size_t		lsis_offset;
+	size_t		length;
+	int			i;
+
+	lowzone = downcase_truncate_identifier(tzname, strlen(tzname), false);
+	type = DecodeTimezoneAbbrev(0, lowzone, &val, &tzp);
+	if (type == TZ || type == DTZ)
+	{
+		/* fixed-offset abbreviation; one type without transitions */
+		temp = palloc0(sizeof(struct state));
+		temp->typecnt = 1;
+		temp->ttis[0].tt_gmtoff = val;
+		temp->ttis[0].tt_isdst = (type == DTZ);
+		sp = temp;
+	}
+	else if (type == DYNTZ)
+		return NULL;
+	else
+	{
+		tzp = pg_tzset(tzname);
+		if (!tzp)
+			return NULL;
+		sp = &((struct pg_tz *)tzp)->state;
+	}
+
+	ats_offset = MAXALIGN(sizeof(kern_tz_table));
+	types_offset = ats_offset + MAXALIGN(sizeof(cl_long) * sp->timecnt);
+	ttis_offset = types_offset + MAXALIGN(sizeof(cl_uchar) * sp->timecnt);
+	lsis_offset = ttis_offset + MAXALIGN(sizeof(tz_ttinfo) * sp->typecnt);
+	length = lsis_offset + MAXALIGN(sizeof(tz_lsinfo) * sp->leapcnt);
+
+	tztab = palloc0(length);
+	SET_VARSIZE(tztab, length);
+	tztab->magic = KERN_TZ_TABLE_MAGIC;
+	tztab->leapcnt = sp->leapcnt;
+	tztab->timecnt = sp->timecnt;
+	tztab->typecnt = sp->typecnt;
+	tztab->defaulttype = sp->defaulttype;
+	tztab->goback = sp->goback;
+	tztab->goahead = sp->goahead;
+	tztab->ats_offset = ats_offset;
+	tztab->types_offset = types_offset;
+	tztab->ttis_offset = ttis_offset;
+	tztab->lsis_offset = lsis_offset;
+	for (i=0; i < sp->timecnt; i++)
+	{
+		((cl_long *)((char *)tztab + ats_offset))[i] = sp->ats[i];
+		((cl_uchar *)((char *)tztab + types_offset))[i] = sp->types[i];
+	}
+	for (i=0; i < sp->typecnt; i++)
+	{
+		tz_ttinfo  *ttis = (tz_ttinfo *)((char *)tztab + ttis_offset) + i;
+
+		ttis->tt_gmtoff  = sp->ttis[i].tt_gmtoff;
+		ttis->tt_isdst   = sp->ttis[i].tt_isdst;
+		ttis->tt_abbrind = sp->ttis[i].tt_abbrind;
+		ttis->tt_ttisstd = sp->ttis[i].tt_ttisstd;
+		ttis->tt_ttisgmt = sp->ttis[i].tt_ttisgmt;
+	}
+	for (i=0; i < sp->leapcnt; i++)
+	{
+		tz_lsinfo  *lsis = (tz_lsinfo *)((char *)tztab + lsis_offset) + i;
+
+		lsis->ls_trans = sp->lsis[i].ls_trans;
+		lsis->ls_corr  = sp->lsis[i].ls_corr;
+	}
+	if (temp)
+		pfree(temp);
+	return (bytea *) tztab;
+}
+
 static void
 assign_misclib_session_info(StringInfo buf)
 {
@@ -1516,15 +2517,13 @@ assign_misclib_session_info(StringInfo buf)
 }
 
 /*
- * pgstrom_build_session_info
+ * pgstrom_build_common_session_info
  *
- * it build a session specific code. if extra_flags contains a particular
- * custom_scan node related GPU routine, GpuTaskState must be provided.
+ * it build a session specific code, not related to a particular custom_scan
+ * node. It is also available at the plan time, for program prebuild.
  */
 void
-pgstrom_build_session_info(StringInfo buf,
-						   GpuTaskState *gts,
-						   cl_uint extra_flags)
+pgstrom_build_common_session_info(StringInfo buf, cl_uint extra_flags)
 {
 	if ((extra_flags & DEVKERNEL_NEEDS_TIMELIB) != 0)
 		assign_timelib_session_info(buf);
@@ -1532,6 +2531,20 @@ pgstrom_build_session_info(StringInfo buf,
 		assign_textlib_session_info(buf);
 	if ((extra_flags & DEVKERNEL_NEEDS_MISCLIB) != 0)
 		assign_misclib_session_info(buf);
+}
+
+/*
+ * pgstrom_build_session_info
+ *
+ * it build a session specific code. if extra_flags contains a particular
+ * custom_scan node related GPU routine, GpuTaskState must be provided.
+ */
+void
+pgstrom_build_session_info(StringInfo buf,
+						   GpuTaskState *gts,
+						   cl_uint extra_flags)
+{
+	pgstrom_build_common_session_info(buf, extra_flags);
 
 	if ((extra_flags & DEVKERNEL_NEEDS_GPUSCAN) != 0)
 		assign_gpuscan_session_info(buf, gts);
@@ -1621,10 +2634,14 @@ retry_checks:
 		 * Note that (ptx_image==NULL && build_chain==NULL) means
 		 * CUDA program compilation is in-progress.
 		 */
-		dlist_delete(&entry->build_chain);
-		memset(&entry->build_chain, 0, sizeof(dlist_node));
+		int			build_prio = entry->build_prio;
+		TimestampTz	tv_start;
+
+		pgcache_build_remove_nolock(entry);
 		get_cuda_program_entry_nolock(entry);
+		pgcache_head->num_builds_running++;
 		SpinLockRelease(&pgcache_head->lock);
+		tv_start = GetCurrentTimestamp();
 		PG_TRY();
 		{
 			entry = build_cuda_program(entry);
@@ -1632,8 +2649,8 @@ retry_checks:
 		PG_CATCH();
 		{
 			SpinLockAcquire(&pgcache_head->lock);
-			dlist_push_tail(&pgcache_head->build_list,
-							&entry->build_chain);
+			pgcache_head->num_builds_running--;
+			pgcache_build_enqueue_nolock(entry, build_prio);
 			put_cuda_program_entry_nolock(entry);
 			SpinLockRelease(&pgcache_head->lock);
 			PG_RE_THROW();
@@ -1642,6 +2659,7 @@ retry_checks:
 
 		CHECK_FOR_INTERRUPTS();
 		SpinLockAcquire(&pgcache_head->lock);
+		pgcache_build_stats_nolock(entry, build_prio, tv_start);
 		put_cuda_program_entry_nolock(entry);
 		goto retry_checks;
 	}
@@ -1718,12 +2736,14 @@ cudaProgramBuilderMain(Datum arg)
 		while (!cuda_program_builder_got_signal)
 		{
 			program_cache_entry *entry;
-			dlist_node *dnode;
+			int			build_prio;
+			TimestampTz	tv_start;
 			int			ev;
 
 			/* Is there any pending CUDA program? */
 			SpinLockAcquire(&pgcache_head->lock);
-			if (dlist_is_empty(&pgcache_head->build_list))
+			entry = pgcache_build_dequeue_nolock();
+			if (!entry)
 			{
 				SpinLockRelease(&pgcache_head->lock);
 
@@ -1739,18 +2759,18 @@ cudaProgramBuilderMain(Datum arg)
 				CHECK_FOR_INTERRUPTS();
 				continue;
 			}
-			dnode = dlist_pop_head_node(&pgcache_head->build_list);
-			entry = dlist_container(program_cache_entry, build_chain, dnode);
-
 			/*
 			 * !ptx_image && build_chain==0 means program compilation is
 			 * in-progress. So, it avoid duplication of the program build.
 			 */
-			memset(&entry->build_chain, 0, sizeof(dlist_node));
 			Assert(!entry->ptx_image);	/* must be build in-progress */
+			build_prio = entry->build_prio;
 			get_cuda_program_entry_nolock(entry);
+			pgcache_head->num_builds_running++;
 			SpinLockRelease(&pgcache_head->lock);
 
+			tv_start = GetCurrentTimestamp();
+
 			PG_TRY();
 			{
 				entry = build_cuda_program(entry);
@@ -1764,14 +2784,17 @@ cudaProgramBuilderMain(Datum arg)
 				 * pending list, to be picked up by other workers.
 				 */
 				SpinLockAcquire(&pgcache_head->lock);
-				dlist_push_tail(&pgcache_head->build_list,
-								&entry->build_chain);
+				pgcache_head->num_builds_running--;
+				pgcache_build_enqueue_nolock(entry, build_prio);
 				put_cuda_program_entry_nolock(entry);
 				SpinLockRelease(&pgcache_head->lock);
 				PG_RE_THROW();
 			}
 			PG_END_TRY();
-			put_cuda_program_entry(entry);
+			SpinLockAcquire(&pgcache_head->lock);
+			pgcache_build_stats_nolock(entry, build_prio, tv_start);
+			put_cuda_program_entry_nolock(entry);
+			SpinLockRelease(&pgcache_head->lock);
 		}
 	}
 	PG_CATCH();
@@ -1805,6 +2828,85 @@ cudaProgramBuilderWakeUp(bool error_if_no_builders)
 		elog(ERROR, "PG-Strom: no active CUDA C program builder");
 }
 
+/*
+ * pgstrom_program_build_stats
+ */
+#define PROGRAM_BUILD_STATS_NATTS	9
+#ifndef INT8ARRAYOID
+#define INT8ARRAYOID		1016	/* see pg_type.h */
+#endif
+Datum
+pgstrom_program_build_stats(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	pgcache_build_stats *bstats;
+	Datum		values[PROGRAM_BUILD_STATS_NATTS];
+	bool		isnull[PROGRAM_BUILD_STATS_NATTS];
+	Datum		hist[PGCACHE_BUILD_HIST_NBUCKETS];
+	HeapTuple	tuple;
+	int			prio;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc	tupdesc;
+		MemoryContext oldcxt;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+		tupdesc = CreateTemplateTupleDesc(PROGRAM_BUILD_STATS_NATTS);
+		TupleDescInitEntry(tupdesc, 1, "priority",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc, 2, "queue_depth",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 3, "enqueue_count",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 4, "build_count",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 5, "cancel_count",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 6, "queue_wait_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 7, "build_total_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 8, "build_max_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 9, "build_time_hist",
+						   INT8ARRAYOID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+		/* take a snapshot of the statistics */
+		bstats = palloc(sizeof(pgcache_build_stats) * PGCACHE_BUILD_NUM_PRIOS);
+		SpinLockAcquire(&pgcache_head->lock);
+		memcpy(bstats, pgcache_head->build_stats,
+			   sizeof(pgcache_build_stats) * PGCACHE_BUILD_NUM_PRIOS);
+		SpinLockRelease(&pgcache_head->lock);
+		fncxt->user_fctx = bstats;
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	prio = fncxt->call_cntr;
+	if (prio >= PGCACHE_BUILD_NUM_PRIOS)
+		SRF_RETURN_DONE(fncxt);
+	bstats = (pgcache_build_stats *)fncxt->user_fctx + prio;
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = CStringGetTextDatum(pgcache_build_prio_names[prio]);
+	values[1] = Int32GetDatum(bstats->queue_depth);
+	values[2] = Int64GetDatum(bstats->enqueue_count);
+	values[3] = Int64GetDatum(bstats->build_count);
+	values[4] = Int64GetDatum(bstats->cancel_count);
+	values[5] = Float8GetDatum((double)bstats->queue_wait_usec / 1000.0);
+	values[6] = Float8GetDatum((double)bstats->build_usec / 1000.0);
+	values[7] = Float8GetDatum((double)bstats->build_max_usec / 1000.0);
+	for (int k=0; k < PGCACHE_BUILD_HIST_NBUCKETS; k++)
+		hist[k] = Int64GetDatum(bstats->build_hist[k]);
+	values[8] = PointerGetDatum(construct_array(hist, PGCACHE_BUILD_HIST_NBUCKETS,
+												INT8OID, sizeof(int64),
+												FLOAT8PASSBYVAL, 'd'));
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+
 /*
  * GUC assign handler of pg_strom.debug_cuda_enable_coredump_on_exception
  */
@@ -1849,7 +2951,8 @@ pgstrom_startup_cuda_program(void)
 		dlist_init(&pgcache_head->hash_slots[i]);
 	}
 	dlist_init(&pgcache_head->lru_list);
-	dlist_init(&pgcache_head->build_list);
+	for (i=0; i < PGCACHE_BUILD_NUM_PRIOS; i++)
+		dlist_init(&pgcache_head->build_list[i]);
 
 	/* initialize program builder state */
 	length = offsetof(program_builder_state,
@@ -1880,6 +2983,28 @@ pgstrom_init_cuda_program(void)
 							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
 							NULL, NULL, NULL);
 
+	/*
+	 * on-disk program cache
+	 */
+	DefineCustomStringVariable("pg_strom.program_cache_dir",
+							   "directory to save the built GPU programs on the disk",
+							   "an empty string disables the on-disk program cache",
+							   &program_cache_dir,
+							   "pg_strom_program_cache",
+							   PGC_SIGHUP,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+	DefineCustomIntVariable("pg_strom.program_cache_dir_size",
+							"max size of the on-disk program cache",
+							NULL,
+							&program_cache_dir_size_kb,
+							1024 * 1024,	/* 1GB */
+							16 * 1024,		/* 16MB */
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
 	/*
 	 * number of worker process to build CUDA program
 	 */
@@ -1894,6 +3019,31 @@ pgstrom_init_cuda_program(void)
 							GUC_NOT_IN_SAMPLE,
 							NULL, NULL, NULL);
 
+	/*
+	 * Enables build of GPU programs at the plan time
+	 */
+	DefineCustomBoolVariable("pg_strom.program_prebuild",
+							 "Enables to build GPU programs at the plan time",
+							 NULL,
+							 &pgstrom_program_prebuild,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/*
+	 * Priority class of the GPU program builds by this session
+	 */
+	DefineCustomEnumVariable("pg_strom.program_build_priority",
+							 "Priority class of GPU program builds",
+							 "interactive builds are picked up prior to batch builds",
+							 &pgstrom_program_build_priority,
+							 PGCACHE_BUILD_PRIO__INTERACTIVE,
+							 pgstrom_program_build_priority_options,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
 	/*
 	 * Enables debug option on GPU kernel build
 	 */
@@ -1916,6 +3066,19 @@ pgstrom_init_cuda_program(void)
 							 PGC_SUSET,
 							 GUC_NOT_IN_SAMPLE | GUC_SUPERUSER_ONLY,
 							 NULL, assign_cuda_enable_coredump_on_exception, NULL);	
+	/*
+	 * Autotuning of the kernel block size
+	 */
+	DefineCustomIntVariable("pg_strom.kernel_autotune_trials",
+							"number of trials per candidate on the block size autotuning",
+							"0 disables the autotuning",
+							&pgstrom_autotune_trials,
+							2,
+							0,
+							100,
+							PGC_SUSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
 	/*
 	 * Configure extra kernel stack for heavy CUDA programs
 	 */
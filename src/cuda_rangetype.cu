@@ -1066,3 +1066,60 @@ PG_RANGETYPE_FUNCTION_TEMPLATE(int8,int8range)
 PG_RANGETYPE_FUNCTION_TEMPLATE(timestamp,tsrange)
 PG_RANGETYPE_FUNCTION_TEMPLATE(timestamptz,tstzrange)
 PG_RANGETYPE_FUNCTION_TEMPLATE(date,daterange)
+
+/*
+ * pgindex_grid_range_bbox
+ *
+ * It returns the interval of the range (or element) as an 1D bounding-box
+ * of the grid-index on GpuJoin; rounded outward to float. Empty range has
+ * infinite bounding-box, because it is contained by any ranges. The bounds
+ * at the minimum or maximum value of the element type (like -infinity of
+ * timestamp) are also regarded as infinite.
+ */
+STATIC_INLINE(void)
+__range_grid_bbox(cl_long lval, cl_long uval, cl_long vmin, cl_long vmax,
+				  cl_float *p_min, cl_float *p_max)
+{
+	*p_min = (lval <= vmin ? -FLT_INFINITY : __ll2float_rd(lval));
+	*p_max = (uval >= vmax ?  FLT_INFINITY : __ll2float_ru(uval));
+}
+
+#define PG_RANGETYPE_GRID_BBOX_TEMPLATE(ELEMENT,RANGE,VMIN,VMAX)	\
+	DEVICE_FUNCTION(cl_bool)										\
+	pgindex_grid_range_bbox(kern_context *kcxt,						\
+							const pg_##RANGE##_t &arg,				\
+							cl_float *p_min, cl_float *p_max)		\
+	{																\
+		if (arg.isnull)												\
+			return false;											\
+		if (arg.value.empty)										\
+		{															\
+			*p_min = -FLT_INFINITY;									\
+			*p_max =  FLT_INFINITY;									\
+		}															\
+		else														\
+			__range_grid_bbox(arg.value.l.infinite					\
+							  ? (VMIN) : (cl_long)arg.value.l.val,	\
+							  arg.value.u.infinite					\
+							  ? (VMAX) : (cl_long)arg.value.u.val,	\
+							  (VMIN), (VMAX), p_min, p_max);		\
+		return true;												\
+	}																\
+	DEVICE_FUNCTION(cl_bool)										\
+	pgindex_grid_range_bbox(kern_context *kcxt,						\
+							const pg_##ELEMENT##_t &arg,			\
+							cl_float *p_min, cl_float *p_max)		\
+	{																\
+		if (arg.isnull)												\
+			return false;											\
+		__range_grid_bbox((cl_long)arg.value, (cl_long)arg.value,	\
+						  (VMIN), (VMAX), p_min, p_max);			\
+		return true;												\
+	}
+
+PG_RANGETYPE_GRID_BBOX_TEMPLATE(int4,int4range,INT_MIN,INT_MAX)
+PG_RANGETYPE_GRID_BBOX_TEMPLATE(int8,int8range,LONG_MIN,LONG_MAX)
+PG_RANGETYPE_GRID_BBOX_TEMPLATE(timestamp,tsrange,LONG_MIN,LONG_MAX)
+PG_RANGETYPE_GRID_BBOX_TEMPLATE(timestamptz,tstzrange,LONG_MIN,LONG_MAX)
+PG_RANGETYPE_GRID_BBOX_TEMPLATE(date,daterange,INT_MIN,INT_MAX)
+#undef PG_RANGETYPE_GRID_BBOX_TEMPLATE
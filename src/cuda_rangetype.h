@@ -173,7 +173,15 @@ PG_RANGETYPE_TEMPLATE(daterange,DateADT)
 	DEVICE_FUNCTION(pg_##RANGE##_t)								\
 	pgfn_##RANGE##_minus(kern_context *kcxt,					\
 						 const pg_##RANGE##_t &arg1,			\
-						 const pg_##RANGE##_t &arg2);
+						 const pg_##RANGE##_t &arg2);			\
+	DEVICE_FUNCTION(cl_bool)									\
+	pgindex_grid_range_bbox(kern_context *kcxt,					\
+							const pg_##RANGE##_t &arg,			\
+							cl_float *p_min, cl_float *p_max);	\
+	DEVICE_FUNCTION(cl_bool)									\
+	pgindex_grid_range_bbox(kern_context *kcxt,					\
+							const pg_##ELEMENT##_t &arg,		\
+							cl_float *p_min, cl_float *p_max);
 
 PG_RANGETYPE_DECLARATION_TEMPLATE(int4,int4range)
 PG_RANGETYPE_DECLARATION_TEMPLATE(int8,int8range)
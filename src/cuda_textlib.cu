@@ -383,6 +383,210 @@ pgfn_type_compare(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2)
 	return result;
 }
 
+/* ----------------------------------------------------------------
+ *
+ * Text comparison functions under non-C collation
+ *
+ * ----------------------------------------------------------------
+ */
+typedef struct
+{
+	const cl_uchar *s;
+	cl_int		len;
+	cl_int		pos;
+	const cl_ushort *w;		/* weights of the current character */
+	cl_int		nw;			/* # of remaining weights */
+} collation_iterator;
+
+/*
+ * collation_next_weight - it returns the next non-zero weight on the level,
+ * 0 at the end of string, or -1 if the character is not supported.
+ */
+STATIC_FUNCTION(cl_int)
+collation_next_weight(const kern_collation_table *ctab,
+					  collation_iterator *iter, cl_int level)
+{
+	while (iter->nw == 0)
+	{
+		cl_uint		c, code;
+		cl_int		k;
+
+		if (iter->pos >= iter->len)
+			return 0;
+		c = iter->s[iter->pos];
+		if (c < 0x80)
+		{
+			code = c;
+			iter->pos++;
+		}
+		else if ((c == 0xc2 || c == 0xc3) &&
+				 iter->pos + 1 < iter->len &&
+				 (iter->s[iter->pos + 1] & 0xc0) == 0x80)
+		{
+			code = ((c & 0x1f) << 6) | (iter->s[iter->pos + 1] & 0x3f);
+			iter->pos += 2;
+		}
+		else
+			return -1;
+		if ((ctab->chars[code].flags & KERN_COLLATION_CHAR__UNSUPPORTED) != 0)
+			return -1;
+		iter->w = ctab->weights + ctab->chars[code].offset;
+		for (k=0; k < level; k++)
+			iter->w += ctab->chars[code].nweights[k];
+		iter->nw = ctab->chars[code].nweights[level];
+	}
+	iter->nw--;
+	return *(iter->w++);
+}
+
+STATIC_FUNCTION(cl_int)
+collation_compare(kern_context *kcxt,
+				  const char *s1, cl_int len1,
+				  const char *s2, cl_int len2,
+				  pg_bytea_t arg, cl_bool *p_isnull)
+{
+	const kern_collation_table *ctab;
+	char	   *p;
+	cl_int		plen;
+	cl_int		i, len, level;
+
+	if (!pg_varlena_datum_extract(kcxt, arg, &p, &plen))
+	{
+		*p_isnull = true;
+		return 0;
+	}
+	ctab = (const kern_collation_table *)(p - VARHDRSZ);
+	if (ctab->magic != KERN_COLLATION_TABLE_MAGIC)
+	{
+		*p_isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_DATA_CORRUPTED,
+					  "collation table is corrupted");
+		return 0;
+	}
+
+	for (level=0; level < ctab->nlevels; level++)
+	{
+		collation_iterator iter1 = { (const cl_uchar *)s1, len1, 0, NULL, 0 };
+		collation_iterator iter2 = { (const cl_uchar *)s2, len2, 0, NULL, 0 };
+		cl_int		w1, w2;
+
+		do {
+			w1 = collation_next_weight(ctab, &iter1, level);
+			w2 = collation_next_weight(ctab, &iter2, level);
+			if (w1 < 0 || w2 < 0)
+			{
+				*p_isnull = true;
+				STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+								   "character is not in the collation table");
+				return 0;
+			}
+			if (w1 != w2)
+				return (w1 < w2 ? -1 : 1);
+		} while (w1 != 0);
+	}
+	/* tie-break by strcmp, as varstr_cmp() doing */
+	len = min(len1, len2);
+	for (i=0; i < len; i++)
+	{
+		cl_uchar	c1 = s1[i];
+		cl_uchar	c2 = s2[i];
+
+		if (c1 != c2)
+			return (c1 < c2 ? -1 : 1);
+	}
+	if (len1 != len2)
+		return (len1 > len2 ? 1 : -1);
+	return 0;
+}
+
+STATIC_FUNCTION(cl_int)
+bpchar_compare_coll(kern_context *kcxt,
+					pg_bpchar_t arg1, pg_bpchar_t arg2,
+					pg_bytea_t ctab, cl_bool *p_isnull)
+{
+	char	   *s1, *s2;
+	cl_int		len1, len2;
+
+	if (!pg_bpchar_datum_extract(kcxt, arg1, &s1, &len1) ||
+		!pg_bpchar_datum_extract(kcxt, arg2, &s2, &len2))
+	{
+		*p_isnull = true;
+		return 0;
+	}
+	return collation_compare(kcxt, s1, len1, s2, len2, ctab, p_isnull);
+}
+
+STATIC_FUNCTION(cl_int)
+text_compare_coll(kern_context *kcxt,
+				  pg_text_t arg1, pg_text_t arg2,
+				  pg_bytea_t ctab, cl_bool *p_isnull)
+{
+	char	   *s1, *s2;
+	cl_int		len1, len2;
+
+	if (!pg_varlena_datum_extract(kcxt, arg1, &s1, &len1) ||
+		!pg_varlena_datum_extract(kcxt, arg2, &s2, &len2))
+	{
+		*p_isnull = true;
+		return 0;
+	}
+	return collation_compare(kcxt, s1, len1, s2, len2, ctab, p_isnull);
+}
+
+#define PGFN_COMPARE_COLL_TEMPLATE(FNAME,TYPE,OPER)						\
+	DEVICE_FUNCTION(pg_bool_t)											\
+	pgfn_##FNAME##_coll(kern_context *kcxt,								\
+						pg_##TYPE##_t arg1, pg_##TYPE##_t arg2,			\
+						pg_bytea_t ctab)								\
+	{																	\
+		pg_bool_t	result;												\
+																		\
+		result.isnull = (arg1.isnull | arg2.isnull | ctab.isnull);		\
+		if (!result.isnull)												\
+		{																\
+			result.value = (cl_bool)									\
+				(TYPE##_compare_coll(kcxt, arg1, arg2, ctab,			\
+									 &result.isnull) OPER 0);			\
+		}																\
+		return result;													\
+	}
+
+PGFN_COMPARE_COLL_TEMPLATE(bpcharlt, bpchar, <)
+PGFN_COMPARE_COLL_TEMPLATE(bpcharle, bpchar, <=)
+PGFN_COMPARE_COLL_TEMPLATE(bpchargt, bpchar, >)
+PGFN_COMPARE_COLL_TEMPLATE(bpcharge, bpchar, >=)
+PGFN_COMPARE_COLL_TEMPLATE(text_lt, text, <)
+PGFN_COMPARE_COLL_TEMPLATE(text_le, text, <=)
+PGFN_COMPARE_COLL_TEMPLATE(text_gt, text, >)
+PGFN_COMPARE_COLL_TEMPLATE(text_ge, text, >=)
+#undef PGFN_COMPARE_COLL_TEMPLATE
+
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_type_compare_coll(kern_context *kcxt, pg_bpchar_t arg1, pg_bpchar_t arg2,
+					   pg_bytea_t ctab)
+{
+	pg_int4_t	result;
+
+	result.isnull = (arg1.isnull | arg2.isnull | ctab.isnull);
+	if (!result.isnull)
+		result.value = bpchar_compare_coll(kcxt, arg1, arg2, ctab,
+										   &result.isnull);
+	return result;
+}
+
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_type_compare_coll(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2,
+					   pg_bytea_t ctab)
+{
+	pg_int4_t	result;
+
+	result.isnull = (arg1.isnull | arg2.isnull | ctab.isnull);
+	if (!result.isnull)
+		result.value = text_compare_coll(kcxt, arg1, arg2, ctab,
+										 &result.isnull);
+	return result;
+}
+
 DEVICE_FUNCTION(pg_int4_t)
 pgfn_textlen(kern_context *kcxt, pg_text_t arg1)
 {
@@ -914,6 +1118,143 @@ GetCharLowerCase(cl_char c)
 GENERIC_MATCH_TEXT_TEMPLATE(GenericMatchText, GetCharNormal)
 GENERIC_MATCH_TEXT_TEMPLATE(GenericCaseMatchText, GetCharLowerCase)
 
+/*
+ * SimpleMatchText - fast path for the LIKE patterns that consist of literal
+ * segments separated by '%' only, like 'abc%', '%abc', '%abc%' or 'abc%xyz'.
+ * With no '_' in the pattern, leftmost search of the segments in order gives
+ * the same result as GenericMatchText, and the search of the unanchored
+ * segments scans 8 bytes at once for the first byte of the segment, using
+ * the SWAR (SIMD-within-a-register) technique. It is a significant benefit
+ * on long text values like URLs or log lines.
+ * Literal bytes must be ASCII, so they never match a part of multi-byte
+ * characters in the server encodings.
+ * It returns LIKE_NOT_SIMPLE if the pattern is not applicable.
+ */
+#define LIKE_NOT_SIMPLE			(-2)
+
+STATIC_INLINE(cl_bool)
+__like_bytes_equal(const char *a, const char *b, cl_int len)
+{
+	cl_int		i;
+
+	for (i=0; i < len; i++)
+	{
+		if (a[i] != b[i])
+			return false;
+	}
+	return true;
+}
+
+STATIC_FUNCTION(cl_int)
+__like_bytes_search(const char *t, cl_int tlen, const char *n, cl_int nlen)
+{
+	const cl_ulong	ones = 0x0101010101010101UL;
+	cl_uchar	c = (cl_uchar)n[0];
+	cl_ulong	cmask = ones * c;
+	cl_int		last = tlen - nlen;
+	cl_int		i = 0;
+
+	while (i <= last)
+	{
+		if ((((cl_ulong)(t + i)) & (sizeof(cl_ulong) - 1)) == 0 &&
+			i + sizeof(cl_ulong) <= last + 1)
+		{
+			cl_ulong	x = *((const cl_ulong *)(t + i)) ^ cmask;
+			cl_ulong	m = (x - ones) & ~x & 0x8080808080808080UL;
+
+			if (m == 0)
+			{
+				i += sizeof(cl_ulong);
+				continue;
+			}
+			/* the least flagged byte is exactly the first byte matched */
+			i += (__ffsll((long long)m) - 1) >> 3;
+		}
+		else if ((cl_uchar)t[i] != c)
+		{
+			i++;
+			continue;
+		}
+		if (__like_bytes_equal(t + i + 1, n + 1, nlen - 1))
+			return i;
+		i++;
+	}
+	return -1;
+}
+
+STATIC_FUNCTION(cl_int)
+SimpleMatchText(const char *t, cl_int tlen, const char *p, cl_int plen)
+{
+	cl_int		i, k;
+	cl_int		pos = 0;
+	cl_int		seg_head;
+	cl_int		seg_len;
+
+	for (i=0; i < plen; i++)
+	{
+		cl_uchar	c = (cl_uchar)p[i];
+
+		if (c == '_' || c == '\\' || (c & 0x80) != 0)
+			return LIKE_NOT_SIMPLE;
+	}
+	if (plen == 0)
+		return (tlen == 0 ? LIKE_TRUE : LIKE_FALSE);
+
+	i = 0;
+	while (i < plen)
+	{
+		while (i < plen && p[i] == '%')
+			i++;
+		seg_head = i;
+		while (i < plen && p[i] != '%')
+			i++;
+		seg_len = i - seg_head;
+		if (seg_len == 0)
+			break;
+
+		if (seg_head == 0 && i == plen)
+		{
+			/* no wildcard at all */
+			if (tlen != seg_len || !__like_bytes_equal(t, p, seg_len))
+				return LIKE_FALSE;
+			pos = tlen;
+		}
+		else if (seg_head == 0)
+		{
+			/* prefix segment */
+			if (tlen < seg_len || !__like_bytes_equal(t, p, seg_len))
+				return LIKE_FALSE;
+			pos = seg_len;
+		}
+		else if (i == plen)
+		{
+			/* suffix segment */
+			if (tlen - pos < seg_len ||
+				!__like_bytes_equal(t + tlen - seg_len, p + seg_head, seg_len))
+				return LIKE_FALSE;
+			pos = tlen;
+		}
+		else
+		{
+			k = __like_bytes_search(t + pos, tlen - pos, p + seg_head, seg_len);
+			if (k < 0)
+				return LIKE_FALSE;
+			pos += k + seg_len;
+		}
+	}
+	return LIKE_TRUE;
+}
+
+STATIC_INLINE(cl_int)
+MatchText(kern_context *kcxt, char *t, int tlen, char *p, int plen)
+{
+	cl_int		retcode = SimpleMatchText(t, tlen, p, plen);
+
+	if (retcode == LIKE_NOT_SIMPLE)
+		retcode = GenericMatchText(kcxt, t, tlen, p, plen, 0);
+	return retcode;
+}
+
 #undef GetCharNormal
 #undef GetCharLowerCase
 #undef NextByte
@@ -939,9 +1280,9 @@ pgfn_textlike(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2)
 			result.isnull = true;
 			return result;
 		}
-		result.value = (GenericMatchText(kcxt,
-										 s, slen,
-										 p, plen, 0) == LIKE_TRUE);
+		result.value = (MatchText(kcxt,
+								  s, slen,
+								  p, plen) == LIKE_TRUE);
 	}
 	return result;
 }
@@ -964,9 +1305,9 @@ pgfn_textnlike(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2)
 			result.isnull = true;
 			return result;
 		}
-		result.value = (GenericMatchText(kcxt,
-										 s, slen,
-										 p, plen, 0) != LIKE_TRUE);
+		result.value = (MatchText(kcxt,
+								  s, slen,
+								  p, plen) != LIKE_TRUE);
 	}
 	return result;
 }
@@ -989,9 +1330,9 @@ pgfn_bpcharlike(kern_context *kcxt, pg_bpchar_t arg1, pg_text_t arg2)
 			result.isnull = true;
 			return result;
 		}
-		result.value = (GenericMatchText(kcxt,
-										 s, slen,
-										 p, plen, 0) == LIKE_TRUE);
+		result.value = (MatchText(kcxt,
+								  s, slen,
+								  p, plen) == LIKE_TRUE);
 	}
 	return result;
 }
@@ -1014,9 +1355,9 @@ pgfn_bpcharnlike(kern_context *kcxt, pg_bpchar_t arg1, pg_text_t arg2)
 			result.isnull = true;
 			return result;
 		}
-		result.value = (GenericMatchText(kcxt,
-										 s, slen,
-										 p, plen, 0) != LIKE_TRUE);
+		result.value = (MatchText(kcxt,
+								  s, slen,
+								  p, plen) != LIKE_TRUE);
 	}
 	return result;
 }
@@ -1124,6 +1465,83 @@ pgfn_bpcharicnlike(kern_context *kcxt, pg_bpchar_t arg1, pg_text_t arg2)
 #undef LIKE_TRUE
 #undef LIKE_FALSE
 #undef LIKE_ABORT
+#undef LIKE_NOT_SIMPLE
+
+/*
+ * Regular expression match operators
+ *
+ * The pattern is already compiled to kern_regexp_dfa by the host code, so
+ * device code walks on the DFA transition table byte-by-byte. Case folding
+ * of the case insensitive operators is also built in the DFA.
+ */
+STATIC_FUNCTION(cl_bool)
+pg_regexp_dfa_exec(kern_context *kcxt,
+				   const char *s, cl_int slen,
+				   const char *p, cl_int plen)
+{
+	const kern_regexp_dfa *dfa = (const kern_regexp_dfa *)(p - VARHDRSZ);
+	const cl_uchar *accepts;
+	cl_uint		nclasses;
+	cl_uint		state = KERN_REGEXP_DFA_START;
+	cl_bool		anchored_end;
+	cl_int		i;
+
+	if (plen < offsetof(kern_regexp_dfa, trans) - VARHDRSZ ||
+		dfa->magic != KERN_REGEXP_DFA_MAGIC)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_DATA_CORRUPTED,
+					  "regexp DFA is corrupted");
+		return false;
+	}
+	nclasses = dfa->nclasses;
+	accepts = (const cl_uchar *)(dfa->trans + dfa->nstates * nclasses);
+	anchored_end = ((dfa->flags & KERN_REGEXP_DFA__ANCHORED_END) != 0);
+	if (!anchored_end && accepts[state])
+		return true;
+	for (i=0; i < slen; i++)
+	{
+		cl_uchar	c = (cl_uchar)s[i];
+
+		state = __ldg(&dfa->trans[state * nclasses + dfa->classmap[c]]);
+		if (state == KERN_REGEXP_DFA_DEAD)
+			return false;
+		if (!anchored_end && accepts[state])
+			return true;
+	}
+	return accepts[state] != 0;
+}
+
+#define PGFN_TEXT_REGEXP_TEMPLATE(FNAME,NEGATIVE)						\
+	DEVICE_FUNCTION(pg_bool_t)											\
+	pgfn_##FNAME(kern_context *kcxt, pg_text_t arg1, pg_bytea_t arg2)	\
+	{																	\
+		pg_bool_t	result;												\
+																		\
+		result.isnull = arg1.isnull | arg2.isnull;						\
+		if (!result.isnull)												\
+		{																\
+			char	   *s, *p;											\
+			cl_int		slen;											\
+			cl_int		plen;											\
+																		\
+			if (!pg_varlena_datum_extract(kcxt, arg1, &s, &slen) ||		\
+				!pg_varlena_datum_extract(kcxt, arg2, &p, &plen))		\
+			{															\
+				result.isnull = true;									\
+				return result;											\
+			}															\
+			result.value = (pg_regexp_dfa_exec(kcxt,					\
+											   s, slen,					\
+											   p, plen) != NEGATIVE);	\
+		}																\
+		return result;													\
+	}
+
+PGFN_TEXT_REGEXP_TEMPLATE(textregexeq, false)
+PGFN_TEXT_REGEXP_TEMPLATE(textregexne, true)
+PGFN_TEXT_REGEXP_TEMPLATE(texticregexeq, false)
+PGFN_TEXT_REGEXP_TEMPLATE(texticregexne, true)
+#undef PGFN_TEXT_REGEXP_TEMPLATE
 
 /*
  * Hyper-Log-Log Hash Functions
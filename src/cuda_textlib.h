@@ -11,6 +11,65 @@
  */
 #ifndef CUDA_TEXTLIB_H
 #define CUDA_TEXTLIB_H
+
+/*
+ * kern_regexp_dfa
+ *
+ * DFA of the regular expression pattern, compiled by regexp_dfa.c and
+ * delivered as bytea parameter. Input bytes are mapped to the equivalent
+ * classes by @classmap, then the next state is looked up from the @trans
+ * table of [nstates * nclasses]. State-0 is the dead state; no match is
+ * possible any more. Array of the accepting flags follows the @trans table.
+ * Unless KERN_REGEXP_DFA__ANCHORED_END, match is determined as soon as the
+ * state gets accepting.
+ */
+#define KERN_REGEXP_DFA_MAGIC			0x52454746U		/* "REGF" */
+#define KERN_REGEXP_DFA_DEAD			0
+#define KERN_REGEXP_DFA_START			1
+#define KERN_REGEXP_DFA__ANCHORED_END	0x0001
+
+typedef struct {
+	cl_int		vl_len_;		/* varlena header (do not touch directly!) */
+	cl_uint		magic;			/* = KERN_REGEXP_DFA_MAGIC */
+	cl_ushort	nstates;
+	cl_ushort	nclasses;
+	cl_uint		flags;			/* KERN_REGEXP_DFA__* */
+	cl_uchar	classmap[256];
+	cl_ushort	trans[FLEXIBLE_ARRAY_MEMBER];
+	/* cl_uchar accepts[nstates] follows */
+} kern_regexp_dfa;
+
+/*
+ * kern_collation_table
+ *
+ * Collation elements of the characters in U+0000..U+00FF for an ICU
+ * collation, built by collation.c and delivered as bytea parameter.
+ * Weights of each character are stored at weights[offset], as primary,
+ * secondary and tertiary weights in order; the ignorable (zero) weights
+ * are omitted. Strings are compared level by level on the sequence of the
+ * weights, then bytewise if they are equal on all the levels; like what
+ * varstr_cmp() does on the deterministic collations.
+ * Characters out of the table or KERN_COLLATION_CHAR__UNSUPPORTED (e.g.
+ * starter of the contractions) are processed by CPU fallback.
+ */
+#define KERN_COLLATION_TABLE_MAGIC		0x434f4c4cU		/* "COLL" */
+#define KERN_COLLATION_TABLE_NCHARS		256
+#define KERN_COLLATION_MAX_WEIGHTS		8	/* per level per character */
+#define KERN_COLLATION_CHAR__UNSUPPORTED	0x01
+
+typedef struct {
+	cl_int		vl_len_;		/* varlena header (do not touch directly!) */
+	cl_uint		magic;			/* = KERN_COLLATION_TABLE_MAGIC */
+	cl_uint		nlevels;		/* 1 (primary) ... 3 (tertiary) */
+	cl_uint		nweights;		/* length of the weights[] */
+	struct {
+		cl_ushort	offset;		/* index of the weights[] */
+		cl_uchar	nweights[3];	/* # of weights for each level */
+		cl_uchar	flags;		/* KERN_COLLATION_CHAR__* */
+	} chars[KERN_COLLATION_TABLE_NCHARS];
+	cl_ushort	weights[FLEXIBLE_ARRAY_MEMBER];
+} kern_collation_table;
+
 #ifdef __CUDACC__
 DEVICE_INLINE(cl_int)
 bpchar_truelen(const char *s, cl_int len)
@@ -57,6 +116,38 @@ pgfn_text_ge(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2);
 DEVICE_FUNCTION(pg_int4_t)
 pgfn_type_compare(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2);
 
+/* comparison under non-C collation */
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_bpcharlt_coll(kern_context *kcxt, pg_bpchar_t arg1, pg_bpchar_t arg2,
+				   pg_bytea_t ctab);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_bpcharle_coll(kern_context *kcxt, pg_bpchar_t arg1, pg_bpchar_t arg2,
+				   pg_bytea_t ctab);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_bpchargt_coll(kern_context *kcxt, pg_bpchar_t arg1, pg_bpchar_t arg2,
+				   pg_bytea_t ctab);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_bpcharge_coll(kern_context *kcxt, pg_bpchar_t arg1, pg_bpchar_t arg2,
+				   pg_bytea_t ctab);
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_type_compare_coll(kern_context *kcxt, pg_bpchar_t arg1, pg_bpchar_t arg2,
+					   pg_bytea_t ctab);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_text_lt_coll(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2,
+				  pg_bytea_t ctab);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_text_le_coll(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2,
+				  pg_bytea_t ctab);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_text_gt_coll(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2,
+				  pg_bytea_t ctab);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_text_ge_coll(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2,
+				  pg_bytea_t ctab);
+DEVICE_FUNCTION(pg_int4_t)
+pgfn_type_compare_coll(kern_context *kcxt, pg_text_t arg1, pg_text_t arg2,
+					   pg_bytea_t ctab);
+
 /* other primitive text functions */
 DEVICE_FUNCTION(pg_int4_t)
 pgfn_textlen(kern_context *kcxt, pg_text_t arg1);
@@ -115,6 +206,15 @@ DEVICE_FUNCTION(pg_bool_t)
 pgfn_bpchariclike(kern_context *kcxt, pg_bpchar_t arg1, pg_text_t arg2);
 DEVICE_FUNCTION(pg_bool_t)
 pgfn_bpcharicnlike(kern_context *kcxt, pg_bpchar_t arg1, pg_text_t arg2);
+/* regular expression match operators */
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_textregexeq(kern_context *kcxt, pg_text_t arg1, pg_bytea_t arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_textregexne(kern_context *kcxt, pg_text_t arg1, pg_bytea_t arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_texticregexeq(kern_context *kcxt, pg_text_t arg1, pg_bytea_t arg2);
+DEVICE_FUNCTION(pg_bool_t)
+pgfn_texticregexne(kern_context *kcxt, pg_text_t arg1, pg_bytea_t arg2);
 
 /*
  * Hyper-Log-Log Hash Functions
@@ -219,6 +219,27 @@ date2isoyear(int year, int mon, int mday)
 	return year;
 }
 
+STATIC_FUNCTION(int)
+isoweek2j(int year, int week)
+{
+	int			day0;
+	int			day4;
+
+	/* fourth day of current year */
+	day4 = date2j(year, 1, 4);
+
+	/* day0 == offset to first day of week (Monday) */
+	day0 = j2day(day4 - 1);
+
+	return ((week - 1) * 7) + (day4 - day0);
+}
+
+STATIC_FUNCTION(void)
+isoweek2date(int woy, int *year, int *mon, int *mday)
+{
+	j2date(isoweek2j(*year, woy), year, mon, mday);
+}
+
 STATIC_FUNCTION(Timestamp)
 dt2local(Timestamp dt, int tz)
 {
@@ -4054,6 +4075,612 @@ pgfn_extract_time(kern_context *kcxt,
 	return result;
 }
 
+/*
+ * timezone(text,timestamptz) / timezone(text,timestamp)
+ *
+ * The zone name is a constant argument, so it is translated to the
+ * kern_tz_table on the host side, then delivered as bytea parameter.
+ */
+STATIC_FUNCTION(cl_bool)
+setup_kern_tz_state(kern_context *kcxt, pg_bytea_t arg, tz_state *sp)
+{
+	kern_tz_table *tztab;
+	char	   *pos;
+	cl_int		len;
+
+	if (!pg_varlena_datum_extract(kcxt, arg, &pos, &len))
+		return false;
+	tztab = (kern_tz_table *)(pos - VARHDRSZ);
+	if (tztab->magic != KERN_TZ_TABLE_MAGIC)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_DATA_CORRUPTED,
+					  "timezone table is corrupted");
+		return false;
+	}
+	memset(sp, 0, sizeof(tz_state));
+	sp->leapcnt = tztab->leapcnt;
+	sp->timecnt = tztab->timecnt;
+	sp->typecnt = tztab->typecnt;
+	sp->goback  = tztab->goback;
+	sp->goahead = tztab->goahead;
+	sp->ats   = (cl_long *)((char *)tztab + tztab->ats_offset);
+	sp->types = (cl_uchar *)((char *)tztab + tztab->types_offset);
+	sp->ttis  = (tz_ttinfo *)((char *)tztab + tztab->ttis_offset);
+	sp->lsis  = (tz_lsinfo *)((char *)tztab + tztab->lsis_offset);
+	sp->defaulttype = tztab->defaulttype;
+
+	return true;
+}
+
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_timestamptz_zone(kern_context *kcxt,
+					  pg_bytea_t arg1, pg_timestamptz_t arg2)
+{
+	pg_timestamp_t result;
+	tz_state	sp;
+	struct pg_tm tm;
+	fsec_t		fsec;
+	int			tz;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (result.isnull)
+		return result;
+	if (TIMESTAMP_NOT_FINITE(arg2.value))
+	{
+		result.value = arg2.value;
+		return result;
+	}
+	if (!setup_kern_tz_state(kcxt, arg1, &sp))
+	{
+		result.isnull = true;
+		return result;
+	}
+	if (!timestamp2tm(arg2.value, &tz, &tm, &fsec, &sp) ||
+		!tm2timestamp(&tm, fsec, NULL, &result.value) ||
+		!IS_VALID_TIMESTAMP(result.value))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "timestamp out of range");
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_timestamp_zone(kern_context *kcxt,
+					pg_bytea_t arg1, pg_timestamp_t arg2)
+{
+	pg_timestamptz_t result;
+	tz_state	sp;
+	struct pg_tm tm;
+	fsec_t		fsec;
+	int			tz;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (result.isnull)
+		return result;
+	if (TIMESTAMP_NOT_FINITE(arg2.value))
+	{
+		result.value = arg2.value;
+		return result;
+	}
+	if (!setup_kern_tz_state(kcxt, arg1, &sp))
+	{
+		result.isnull = true;
+		return result;
+	}
+	if (!timestamp2tm(arg2.value, NULL, &tm, &fsec, NULL))
+		goto out_of_range;
+	tz = DetermineTimeZoneOffset(&tm, &sp);
+	if (!tm2timestamp(&tm, fsec, &tz, &result.value) ||
+		!IS_VALID_TIMESTAMP(result.value))
+		goto out_of_range;
+	return result;
+
+out_of_range:
+	result.isnull = true;
+	STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+				  "timestamp out of range");
+	return result;
+}
+
+/*
+ * date_trunc(text,timestamp) / date_trunc(text,timestamptz)
+ */
+STATIC_FUNCTION(cl_bool)
+timestamp_trunc_tm(cl_int unit, struct pg_tm *tm, fsec_t *fsec,
+				   cl_bool *p_redotz)
+{
+	cl_int		woy;
+
+	switch (unit)
+	{
+		case DTK_WEEK:
+			woy = date2isoweek(tm->tm_year, tm->tm_mon, tm->tm_mday);
+			/*
+			 * If it is week 52/53 and the month is January, then the
+			 * week must belong to the previous year. Also, some December
+			 * dates belong to the next year.
+			 */
+			if (woy >= 52 && tm->tm_mon == 1)
+				--tm->tm_year;
+			if (woy <= 1 && tm->tm_mon == MONTHS_PER_YEAR)
+				++tm->tm_year;
+			isoweek2date(woy, &tm->tm_year, &tm->tm_mon, &tm->tm_mday);
+			tm->tm_hour = 0;
+			tm->tm_min = 0;
+			tm->tm_sec = 0;
+			*fsec = 0;
+			*p_redotz = true;
+			break;
+		case DTK_MILLENNIUM:
+			/* see comments in timestamptz_trunc */
+			if (tm->tm_year > 0)
+				tm->tm_year = ((tm->tm_year + 999) / 1000) * 1000 - 999;
+			else
+				tm->tm_year = -((999 - (tm->tm_year - 1)) / 1000) * 1000 + 1;
+			/* FALL THRU */
+		case DTK_CENTURY:
+			if (tm->tm_year > 0)
+				tm->tm_year = ((tm->tm_year + 99) / 100) * 100 - 99;
+			else
+				tm->tm_year = -((99 - (tm->tm_year - 1)) / 100) * 100 + 1;
+			/* FALL THRU */
+		case DTK_DECADE:
+			if (unit != DTK_MILLENNIUM && unit != DTK_CENTURY)
+			{
+				if (tm->tm_year > 0)
+					tm->tm_year = (tm->tm_year / 10) * 10;
+				else
+					tm->tm_year = -((8 - (tm->tm_year - 1)) / 10) * 10;
+			}
+			/* FALL THRU */
+		case DTK_YEAR:
+			tm->tm_mon = 1;
+			/* FALL THRU */
+		case DTK_QUARTER:
+			tm->tm_mon = (3 * ((tm->tm_mon - 1) / 3)) + 1;
+			/* FALL THRU */
+		case DTK_MONTH:
+			tm->tm_mday = 1;
+			/* FALL THRU */
+		case DTK_DAY:
+			tm->tm_hour = 0;
+			*p_redotz = true;	/* for all cases >= DAY */
+			/* FALL THRU */
+		case DTK_HOUR:
+			tm->tm_min = 0;
+			/* FALL THRU */
+		case DTK_MINUTE:
+			tm->tm_sec = 0;
+			/* FALL THRU */
+		case DTK_SECOND:
+			*fsec = 0;
+			break;
+		case DTK_MILLISEC:
+			*fsec = (*fsec / 1000) * 1000;
+			break;
+		case DTK_MICROSEC:
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_timestamp_trunc(kern_context *kcxt, pg_text_t arg1, pg_timestamp_t arg2)
+{
+	pg_timestamp_t result;
+	struct pg_tm tm;
+	fsec_t		fsec;
+	char	   *s;
+	cl_int		slen;
+	cl_int		type, val;
+	cl_bool		redotz = false;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (result.isnull)
+		return result;
+	if (TIMESTAMP_NOT_FINITE(arg2.value))
+	{
+		result.value = arg2.value;
+		return result;
+	}
+	if (!pg_varlena_datum_extract(kcxt, arg1, &s, &slen) ||
+		!extract_decode_unit(s, slen, &type, &val) ||
+		type != UNITS)
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_INVALID_PARAMETER_VALUE,
+					  "timestamp units not recognized");
+		return result;
+	}
+	if (!timestamp2tm(arg2.value, NULL, &tm, &fsec, NULL))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "timestamp out of range");
+		return result;
+	}
+	if (!timestamp_trunc_tm(val, &tm, &fsec, &redotz))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+					  "timestamp units not supported");
+		return result;
+	}
+	if (!tm2timestamp(&tm, fsec, NULL, &result.value))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "timestamp out of range");
+	}
+	return result;
+}
+
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_timestamptz_trunc(kern_context *kcxt,
+					   pg_text_t arg1, pg_timestamptz_t arg2)
+{
+	pg_timestamptz_t result;
+	struct pg_tm tm;
+	fsec_t		fsec;
+	int			tz;
+	char	   *s;
+	cl_int		slen;
+	cl_int		type, val;
+	cl_bool		redotz = false;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (result.isnull)
+		return result;
+	if (TIMESTAMP_NOT_FINITE(arg2.value))
+	{
+		result.value = arg2.value;
+		return result;
+	}
+	if (!pg_varlena_datum_extract(kcxt, arg1, &s, &slen) ||
+		!extract_decode_unit(s, slen, &type, &val) ||
+		type != UNITS)
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_INVALID_PARAMETER_VALUE,
+					  "timestamp with time zone units not recognized");
+		return result;
+	}
+	if (!timestamp2tm(arg2.value, &tz, &tm, &fsec, NULL))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "timestamp out of range");
+		return result;
+	}
+	if (!timestamp_trunc_tm(val, &tm, &fsec, &redotz))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+					  "timestamp with time zone units not supported");
+		return result;
+	}
+	if (redotz)
+		tz = DetermineTimeZoneOffset(&tm, &session_timezone_state);
+	if (!tm2timestamp(&tm, fsec, &tz, &result.value))
+	{
+		result.isnull = true;
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "timestamp out of range");
+	}
+	return result;
+}
+
+/*
+ * interval2stride_usecs
+ *
+ * It returns the length of the interval in microseconds, for the bucketing
+ * functions; intervals that contain months or years are not supported.
+ */
+STATIC_FUNCTION(cl_bool)
+interval2stride_usecs(kern_context *kcxt, const Interval *stride,
+					  cl_long *p_stride_usecs)
+{
+	if (stride->month != 0)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+					  "timestamps cannot be binned into intervals containing months or years");
+		return false;
+	}
+	if (stride->day > LONG_MAX / USECS_PER_DAY ||
+		stride->day < LONG_MIN / USECS_PER_DAY ||
+		(stride->day > 0 &&
+		 stride->time > LONG_MAX - stride->day * USECS_PER_DAY) ||
+		(stride->day < 0 &&
+		 stride->time < LONG_MIN - stride->day * USECS_PER_DAY))
+	{
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "interval out of range");
+		return false;
+	}
+	*p_stride_usecs = stride->day * USECS_PER_DAY + stride->time;
+	if (*p_stride_usecs <= 0)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_INVALID_PARAMETER_VALUE,
+					  "stride must be greater than zero");
+		return false;
+	}
+	return true;
+}
+
+/*
+ * date_bin(interval,timestamp,timestamp) - timestamp_bin
+ * date_bin(interval,timestamptz,timestamptz) - timestamptz_bin
+ */
+STATIC_FUNCTION(cl_bool)
+__timestamp_bin(kern_context *kcxt, const Interval *stride,
+				Timestamp ts, Timestamp origin, Timestamp *result)
+{
+	cl_long		stride_usecs;
+	cl_long		tm_diff;
+	cl_long		tm_modulo;
+
+	if (TIMESTAMP_NOT_FINITE(ts))
+	{
+		*result = ts;
+		return true;
+	}
+	if (TIMESTAMP_NOT_FINITE(origin))
+	{
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "origin out of range");
+		return false;
+	}
+	if (!interval2stride_usecs(kcxt, stride, &stride_usecs))
+		return false;
+	if ((origin < 0 && ts > LONG_MAX + origin) ||
+		(origin > 0 && ts < LONG_MIN + origin))
+	{
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "interval out of range");
+		return false;
+	}
+	tm_diff = ts - origin;
+	/* these calculations cannot overflow */
+	tm_modulo = tm_diff % stride_usecs;
+	*result = origin + (tm_diff - tm_modulo);
+	/* round towards -infinity, not 0, if tm_diff is negative */
+	if (tm_modulo < 0)
+	{
+		if (*result < LONG_MIN + stride_usecs ||
+			!IS_VALID_TIMESTAMP(*result - stride_usecs))
+		{
+			STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+						  "timestamp out of range");
+			return false;
+		}
+		*result -= stride_usecs;
+	}
+	return true;
+}
+
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_timestamp_bin(kern_context *kcxt, pg_interval_t arg1,
+				   pg_timestamp_t arg2, pg_timestamp_t arg3)
+{
+	pg_timestamp_t result;
+
+	result.isnull = arg1.isnull | arg2.isnull | arg3.isnull;
+	if (!result.isnull &&
+		!__timestamp_bin(kcxt, &arg1.value,
+						 arg2.value, arg3.value, &result.value))
+		result.isnull = true;
+	return result;
+}
+
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_timestamptz_bin(kern_context *kcxt, pg_interval_t arg1,
+					 pg_timestamptz_t arg2, pg_timestamptz_t arg3)
+{
+	pg_timestamptz_t result;
+
+	result.isnull = arg1.isnull | arg2.isnull | arg3.isnull;
+	if (!result.isnull &&
+		!__timestamp_bin(kcxt, &arg1.value,
+						 arg2.value, arg3.value, &result.value))
+		result.isnull = true;
+	return result;
+}
+
+/*
+ * time_bucket (TimescaleDB)
+ *
+ * It is compatible to ts_timestamp_bucket() and others; buckets are aligned
+ * to the origin (2000-01-03, Monday, by the default), and values are rounded
+ * towards -infinity. Intervals that contain months or years are processed by
+ * the CPU fallback.
+ */
+#define TIME_BUCKET_DEFAULT_ORIGIN		(2 * USECS_PER_DAY)	/* 2000-01-03 */
+
+STATIC_FUNCTION(cl_bool)
+__time_bucket_timestamp(kern_context *kcxt, const Interval *bucket_width,
+						Timestamp ts, Timestamp origin, Timestamp *p_result)
+{
+	cl_long		period;
+	cl_long		offset;
+	cl_long		result;
+
+	if (TIMESTAMP_NOT_FINITE(ts))
+	{
+		*p_result = ts;
+		return true;
+	}
+	if (bucket_width->month != 0)
+	{
+		STROM_CPU_FALLBACK(kcxt, ERRCODE_FEATURE_NOT_SUPPORTED,
+						   "time_bucket by months or years");
+		return false;
+	}
+	if (bucket_width->day > LONG_MAX / USECS_PER_DAY ||
+		bucket_width->day < LONG_MIN / USECS_PER_DAY)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "interval out of range");
+		return false;
+	}
+	period = bucket_width->time + bucket_width->day * USECS_PER_DAY;
+	if (period <= 0)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_INVALID_PARAMETER_VALUE,
+					  "period must be greater than 0");
+		return false;
+	}
+	if (TIMESTAMP_NOT_FINITE(origin))
+	{
+		STROM_EREPORT(kcxt, ERRCODE_INVALID_PARAMETER_VALUE,
+					  "invalid origin value: infinity");
+		return false;
+	}
+	/* offset = origin % period */
+	offset = origin % period;
+	if ((offset > 0 && ts < LONG_MIN + offset) ||
+		(offset < 0 && ts > LONG_MAX + offset))
+	{
+		STROM_EREPORT(kcxt, ERRCODE_DATETIME_VALUE_OUT_OF_RANGE,
+					  "timestamp out of range");
+		return false;
+	}
+	ts -= offset;
+	/* result = floor(ts / period) * period */
+	result = ts / period;
+	if (ts % period < 0)
+		result = (result * period) - period;
+	else
+		result *= period;
+	*p_result = result + offset;
+
+	return true;
+}
+
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_time_bucket_timestamp(kern_context *kcxt,
+						   pg_interval_t arg1, pg_timestamp_t arg2)
+{
+	pg_timestamp_t result;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (!result.isnull &&
+		!__time_bucket_timestamp(kcxt, &arg1.value, arg2.value,
+								 TIME_BUCKET_DEFAULT_ORIGIN,
+								 &result.value))
+		result.isnull = true;
+	return result;
+}
+
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_time_bucket_timestamp_origin(kern_context *kcxt, pg_interval_t arg1,
+								  pg_timestamp_t arg2, pg_timestamp_t arg3)
+{
+	pg_timestamp_t result;
+
+	result.isnull = arg1.isnull | arg2.isnull | arg3.isnull;
+	if (!result.isnull &&
+		!__time_bucket_timestamp(kcxt, &arg1.value, arg2.value,
+								 arg3.value, &result.value))
+		result.isnull = true;
+	return result;
+}
+
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_time_bucket_timestamptz(kern_context *kcxt,
+							 pg_interval_t arg1, pg_timestamptz_t arg2)
+{
+	pg_timestamptz_t result;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (!result.isnull &&
+		!__time_bucket_timestamp(kcxt, &arg1.value, arg2.value,
+								 TIME_BUCKET_DEFAULT_ORIGIN,
+								 &result.value))
+		result.isnull = true;
+	return result;
+}
+
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_time_bucket_timestamptz_origin(kern_context *kcxt, pg_interval_t arg1,
+									pg_timestamptz_t arg2,
+									pg_timestamptz_t arg3)
+{
+	pg_timestamptz_t result;
+
+	result.isnull = arg1.isnull | arg2.isnull | arg3.isnull;
+	if (!result.isnull &&
+		!__time_bucket_timestamp(kcxt, &arg1.value, arg2.value,
+								 arg3.value, &result.value))
+		result.isnull = true;
+	return result;
+}
+
+STATIC_FUNCTION(cl_bool)
+__time_bucket_date(kern_context *kcxt, const Interval *bucket_width,
+				   DateADT date, DateADT origin, DateADT *p_result)
+{
+	Timestamp	ts;
+
+	if (DATE_NOT_FINITE(date))
+	{
+		*p_result = date;
+		return true;
+	}
+	if (DATE_NOT_FINITE(origin))
+	{
+		STROM_EREPORT(kcxt, ERRCODE_INVALID_PARAMETER_VALUE,
+					  "invalid origin value: infinity");
+		return false;
+	}
+	if (bucket_width->month == 0 &&
+		bucket_width->time + bucket_width->day * USECS_PER_DAY < USECS_PER_DAY)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_INVALID_PARAMETER_VALUE,
+					  "interval must not have sub-day precision");
+		return false;
+	}
+	if (!__time_bucket_timestamp(kcxt, bucket_width,
+								 (Timestamp)date * USECS_PER_DAY,
+								 (Timestamp)origin * USECS_PER_DAY, &ts))
+		return false;
+	/* timestamp_date() */
+	*p_result = (ts - (ts < 0 ? USECS_PER_DAY - 1 : 0)) / USECS_PER_DAY;
+	return true;
+}
+
+DEVICE_FUNCTION(pg_date_t)
+pgfn_time_bucket_date(kern_context *kcxt,
+					  pg_interval_t arg1, pg_date_t arg2)
+{
+	pg_date_t	result;
+
+	result.isnull = arg1.isnull | arg2.isnull;
+	if (!result.isnull &&
+		!__time_bucket_date(kcxt, &arg1.value, arg2.value,
+							TIME_BUCKET_DEFAULT_ORIGIN / USECS_PER_DAY,
+							&result.value))
+		result.isnull = true;
+	return result;
+}
+
+DEVICE_FUNCTION(pg_date_t)
+pgfn_time_bucket_date_origin(kern_context *kcxt, pg_interval_t arg1,
+							 pg_date_t arg2, pg_date_t arg3)
+{
+	pg_date_t	result;
+
+	result.isnull = arg1.isnull | arg2.isnull | arg3.isnull;
+	if (!result.isnull &&
+		!__time_bucket_date(kcxt, &arg1.value, arg2.value,
+							arg3.value, &result.value))
+		result.isnull = true;
+	return result;
+}
+
 /*
  * Hyper-Log-Log hash functions
  */
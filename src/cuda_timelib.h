@@ -11,6 +11,46 @@
  */
 #ifndef CUDA_TIMELIB_H
 #define CUDA_TIMELIB_H
+
+typedef struct {
+	cl_long		ls_trans; /* pg_time_t in original */
+	cl_long		ls_corr;
+} tz_lsinfo;
+typedef struct {
+	cl_int		tt_gmtoff;
+	cl_bool		tt_isdst;
+	cl_int		tt_abbrind;
+	cl_bool		tt_ttisstd;
+	cl_bool		tt_ttisgmt;
+} tz_ttinfo;
+
+/*
+ * kern_tz_table
+ *
+ * Transition table of the time zone given as a constant argument of the
+ * timezone(text,...) function, built by pgstrom_timezone_table() and
+ * delivered as bytea parameter. Device code sets up tz_state on the arrays
+ * at the offsets (from the head of kern_tz_table), then converts timestamps
+ * in the same way as the session time zone. A fixed-offset abbreviation
+ * is a table with one type and no transitions.
+ */
+#define KERN_TZ_TABLE_MAGIC		0x545a5442U		/* "TZTB" */
+
+typedef struct {
+	cl_int		vl_len_;		/* varlena header (do not touch directly!) */
+	cl_uint		magic;			/* = KERN_TZ_TABLE_MAGIC */
+	cl_int		leapcnt;
+	cl_int		timecnt;
+	cl_int		typecnt;
+	cl_int		defaulttype;
+	cl_bool		goback;
+	cl_bool		goahead;
+	cl_uint		ats_offset;		/* cl_long[timecnt] */
+	cl_uint		types_offset;	/* cl_uchar[timecnt] */
+	cl_uint		ttis_offset;	/* tz_ttinfo[typecnt] */
+	cl_uint		lsis_offset;	/* tz_lsinfo[leapcnt] */
+} kern_tz_table;
+
 #ifdef __CUDACC__
 /* definitions copied from date.h */
 typedef cl_int		DateADT;
@@ -179,17 +219,6 @@ interval_cmp_value(const Interval interval, cl_long *days, cl_long *fraction)
  * to be defined by session information
  */
 DEVICE_FUNCTION(Timestamp) SetEpochTimestamp(void);
-typedef struct {
-	cl_long		ls_trans; /* pg_time_t in original */
-	cl_long		ls_corr;
-} tz_lsinfo;
-typedef struct {
-	cl_int		tt_gmtoff;
-	cl_bool		tt_isdst;
-	cl_int		tt_abbrind;
-	cl_bool		tt_ttisstd;
-	cl_bool		tt_ttisgmt;
-} tz_ttinfo;
 typedef struct {
 	cl_int		leapcnt;
 	cl_int		timecnt;
@@ -560,6 +589,46 @@ pgfn_extract_timetz(kern_context *kcxt, pg_text_t arg1, pg_timetz_t arg2);
 DEVICE_FUNCTION(pg_numeric_t)
 pgfn_extract_time(kern_context *kcxt, pg_text_t arg1, pg_time_t arg2);
 
+/*
+ * AT TIME ZONE / date_trunc / date_bin / time_bucket
+ */
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_timestamptz_zone(kern_context *kcxt,
+					  pg_bytea_t arg1, pg_timestamptz_t arg2);
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_timestamp_zone(kern_context *kcxt,
+					pg_bytea_t arg1, pg_timestamp_t arg2);
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_timestamp_trunc(kern_context *kcxt, pg_text_t arg1, pg_timestamp_t arg2);
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_timestamptz_trunc(kern_context *kcxt,
+					   pg_text_t arg1, pg_timestamptz_t arg2);
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_timestamp_bin(kern_context *kcxt, pg_interval_t arg1,
+				   pg_timestamp_t arg2, pg_timestamp_t arg3);
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_timestamptz_bin(kern_context *kcxt, pg_interval_t arg1,
+					 pg_timestamptz_t arg2, pg_timestamptz_t arg3);
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_time_bucket_timestamp(kern_context *kcxt,
+						   pg_interval_t arg1, pg_timestamp_t arg2);
+DEVICE_FUNCTION(pg_timestamp_t)
+pgfn_time_bucket_timestamp_origin(kern_context *kcxt, pg_interval_t arg1,
+								  pg_timestamp_t arg2, pg_timestamp_t arg3);
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_time_bucket_timestamptz(kern_context *kcxt,
+							 pg_interval_t arg1, pg_timestamptz_t arg2);
+DEVICE_FUNCTION(pg_timestamptz_t)
+pgfn_time_bucket_timestamptz_origin(kern_context *kcxt, pg_interval_t arg1,
+									pg_timestamptz_t arg2,
+									pg_timestamptz_t arg3);
+DEVICE_FUNCTION(pg_date_t)
+pgfn_time_bucket_date(kern_context *kcxt,
+					  pg_interval_t arg1, pg_date_t arg2);
+DEVICE_FUNCTION(pg_date_t)
+pgfn_time_bucket_date_origin(kern_context *kcxt, pg_interval_t arg1,
+							 pg_date_t arg2, pg_date_t arg3);
+
 /*
  * Hyper-Log-Log hash functions
  */
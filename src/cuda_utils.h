@@ -11,6 +11,26 @@
  */
 #ifndef CUDA_UTILS_H
 #define CUDA_UTILS_H
+
+/*
+ * kern_sorted_array
+ *
+ * Sorted and de-duplicated elements of a constant array for
+ * 'scalar = ANY(array)', built by codegen.c and delivered as a bytea
+ * parameter. The elements are widened to 64bit integer, so only the
+ * integer and date/time types are supported.
+ */
+#define KERN_SORTED_ARRAY_MAGIC		0x53414f50U		/* "SAOP" */
+
+typedef struct
+{
+	cl_int		vl_len_;		/* varlena header (do not touch directly!) */
+	cl_uint		magic;			/* = KERN_SORTED_ARRAY_MAGIC */
+	cl_uint		nitems;			/* # of non-NULL distinct elements */
+	cl_bool		has_null;		/* true, if array contains NULL */
+	cl_long		values[FLEXIBLE_ARRAY_MEMBER];
+} kern_sorted_array;
+
 #ifdef __CUDACC__
 /*
  * NumSmx - reference to the %nsmid register
@@ -699,6 +719,60 @@ ArrayGetNItems(kern_context *kcxt, cl_int ndim, const cl_int *dims)
 	return ret;
 }
 
+/*
+ * PG_SCALAR_ARRAY_SORTED_OP
+ *
+ * 'scalar = ANY(array)' on the kern_sorted_array; binary search instead of
+ * the loop on the array elements.
+ */
+template <typename ScalarType>
+DEVICE_INLINE(pg_bool_t)
+PG_SCALAR_ARRAY_SORTED_OP(kern_context *kcxt,
+						  ScalarType scalar,
+						  pg_bytea_t sarray)
+{
+	kern_sorted_array *sa;
+	pg_bool_t	result;
+	cl_long		key;
+	cl_uint		head, tail, curr;
+	char	   *pos;
+	cl_int		len;
+
+	result.isnull = true;
+	result.value = false;
+	if (scalar.isnull ||
+		!pg_varlena_datum_extract(kcxt, sarray, &pos, &len))
+		return result;
+	sa = (kern_sorted_array *)(pos - VARHDRSZ);
+	if (sa->magic != KERN_SORTED_ARRAY_MAGIC)
+	{
+		STROM_EREPORT(kcxt, ERRCODE_DATA_CORRUPTED,
+					  "sorted array is corrupted");
+		return result;
+	}
+
+	key = (cl_long) scalar.value;
+	head = 0;
+	tail = sa->nitems;
+	while (head < tail)
+	{
+		curr = (head + tail) / 2;
+		if (sa->values[curr] == key)
+		{
+			result.isnull = false;
+			result.value = true;
+			return result;
+		}
+		if (sa->values[curr] < key)
+			head = curr + 1;
+		else
+			tail = curr;
+	}
+	/* not found; NULL if array contains NULL */
+	result.isnull = sa->has_null;
+	return result;
+}
+
 template <typename ScalarType, typename ElementType>
 DEVICE_INLINE(pg_bool_t)
 PG_SCALAR_ARRAY_OP(kern_context *kcxt,
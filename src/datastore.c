@@ -13,6 +13,7 @@
 #include "pg_strom.h"
 #include "cuda_numeric.h"
 #include "cuda_gcache.h"
+#include "cuda_gpuscan.h"
 
 /*
  * estimate_num_chunks
@@ -114,7 +115,6 @@ KDS_fetch_tuple_block(TupleTableSlot *slot,
 	{
 		block_nr = KERN_DATA_STORE_BLOCK_BLCKNR(kds, gts->curr_index);
 		hpage = KERN_DATA_STORE_BLOCK_PGPAGE(kds, gts->curr_index);
-		Assert(PageIsAllVisible(hpage));
 		max_lp_index = PageGetMaxOffsetNumber(hpage);
 		while (gts->curr_lp_index < max_lp_index)
 		{
@@ -130,6 +130,9 @@ KDS_fetch_tuple_block(TupleTableSlot *slot,
 			tuple->t_tableOid = (rel ? RelationGetRelid(rel) : InvalidOid);
 			tuple->t_data = (HeapTupleHeader)((char *)hpage +
 											  ItemIdGetOffset(lpp));
+			/* blocks by GPUDirect SQL may not be all-visible */
+			if (!pgstromMvccTupleIsVisible(gts, hpage, tuple->t_data))
+				continue;
 			ExecForceStoreHeapTuple(tuple, slot, false);
 			return true;
 		}
@@ -196,9 +199,9 @@ __KDS_clone(GpuContext *gcontext, kern_data_store *kds_old,
 /*
  * PDS_clone - makes an empty data store with same definition
  */
-pgstrom_data_store *
-__PDS_clone(pgstrom_data_store *pds_old,
-			const char *filename, int lineno)
+static pgstrom_data_store *
+__PDS_clone_common(pgstrom_data_store *pds_old, size_t bytesize,
+				   const char *filename, int lineno)
 {
 	pgstrom_data_store *pds_new;
 	CUdeviceptr	m_deviceptr;
@@ -207,7 +210,7 @@ __PDS_clone(pgstrom_data_store *pds_old,
 	rc = __gpuMemAllocManaged(pds_old->gcontext,
 							  &m_deviceptr,
 							  offsetof(pgstrom_data_store,
-									   kds) + pds_old->kds.length,
+									   kds) + bytesize,
 							  CU_MEM_ATTACH_GLOBAL,
 							  filename, lineno);
 	if (rc != CUDA_SUCCESS)
@@ -225,12 +228,36 @@ __PDS_clone(pgstrom_data_store *pds_old,
 		   &pds_old->kds,
 		   KERN_DATA_STORE_HEAD_LENGTH(&pds_old->kds));
 	/* make the data store empty */
+	pds_new->kds.length = bytesize;
 	pds_new->kds.usage = 0;
 	pds_new->kds.nitems = 0;
 
 	return pds_new;
 }
 
+pgstrom_data_store *
+__PDS_clone(pgstrom_data_store *pds_old,
+			const char *filename, int lineno)
+{
+	return __PDS_clone_common(pds_old, pds_old->kds.length,
+							  filename, lineno);
+}
+
+/*
+ * PDS_clone_row - makes an empty row-format data store with same definition,
+ * but different length
+ */
+pgstrom_data_store *
+__PDS_clone_row(pgstrom_data_store *pds_old, size_t bytesize,
+				const char *filename, int lineno)
+{
+	Assert(pds_old->kds.format == KDS_FORMAT_ROW);
+	bytesize = STROMALIGN_DOWN(bytesize);
+	Assert(bytesize >= KERN_DATA_STORE_HEAD_LENGTH(&pds_old->kds));
+
+	return __PDS_clone_common(pds_old, bytesize, filename, lineno);
+}
+
 /*
  * PDS_retain
  */
@@ -260,7 +287,17 @@ PDS_release(pgstrom_data_store *pds)
 	Assert(refcnt >= 0);
 	if (refcnt == 0)
 	{
-		if (pds->gcontext)
+		if (pds->chunk_ring)
+		{
+			/* back to the chunk-ring for recycle */
+			pgstromChunkRing *ring = pds->chunk_ring;
+
+			SpinLockAcquire(&ring->lock);
+			Assert(ring->nfree < ring->nbuffers);
+			ring->free_list[ring->nfree++] = pds;
+			SpinLockRelease(&ring->lock);
+		}
+		else if (pds->gcontext)
 		{
 			rc = gpuMemFree(gcontext, (CUdeviceptr) pds);
 			if (rc != CUDA_SUCCESS)
@@ -270,7 +307,10 @@ PDS_release(pgstrom_data_store *pds)
 		{
 			Assert(pds->kds.format == KDS_FORMAT_ARROW ||
 				   pds->kds.format == KDS_FORMAT_COLUMN);
-			pfree(pds);
+			if (pds->mmap_holder)
+				arrowFdwReleaseMmapPDS(pds);
+			else
+				pfree(pds);
 		}
 	}
 }
@@ -372,19 +412,31 @@ __init_kernel_column_metadata(kern_data_store *kds,
 		if (OidIsValid(typ->typelem) && typ->typlen == -1)
 		{
 			char		elem_name[NAMEDATALEN + 10];
+			int16		elem_len;
+			bool		elem_byval;
+			char		elem_align;
 
 			cmeta->atttypkind = TYPE_KIND__ARRAY;
 			cmeta->idx_subattrs = kds->nr_colmeta++;
 			cmeta->num_subattrs = 1;
 
+			/*
+			 * NOTE: element may be a composite type (List of Struct), so
+			 * its length/alignment must come from the element type itself,
+			 * not from the array type.
+			 */
+			get_typlenbyvalalign(typ->typelem,
+								 &elem_len,
+								 &elem_byval,
+								 &elem_align);
 			snprintf(elem_name, sizeof(elem_name), "__%s", attname);
 			__init_kernel_column_metadata(kds,
 										  cmeta->idx_subattrs,
 										  elem_name,
 										  1,				/* attnum */
-										  typ->typbyval,	/* attbyval */
-										  typ->typalign,	/* attalign */
-										  typ->typlen,		/* attlen */
+										  elem_byval,		/* attbyval */
+										  elem_align,		/* attalign */
+										  elem_len,			/* attlen */
 										  typ->typelem,		/* atttypid */
 										  -1,				/* atttypmod */
 										  NULL);			/* attcacheoff */
@@ -642,6 +694,22 @@ KDS_schemaIsCompatible(TupleDesc tupdesc, kern_data_store *kds)
 	return true;
 }
 
+static void
+PDS_setup_row(pgstrom_data_store *pds,
+			  GpuContext *gcontext,
+			  TupleDesc tupdesc,
+			  size_t bytesize)
+{
+	memset(pds, 0, offsetof(pgstrom_data_store, kds));
+	pds->gcontext = gcontext;
+	pg_atomic_init_u32(&pds->refcnt, 1);
+	init_kernel_data_store(&pds->kds, tupdesc, bytesize,
+						   KDS_FORMAT_ROW, INT_MAX);
+	pds->nblocks_uncached = 0;
+	pds->filedesc.rawfd = -1;
+	pds->iovec = NULL;
+}
+
 pgstrom_data_store *
 __PDS_create_row(GpuContext *gcontext,
 				 TupleDesc tupdesc,
@@ -664,14 +732,7 @@ __PDS_create_row(GpuContext *gcontext,
 	pds = (pgstrom_data_store *) m_deviceptr;
 
 	/* setup */
-	memset(pds, 0, offsetof(pgstrom_data_store, kds));
-	pds->gcontext = gcontext;
-	pg_atomic_init_u32(&pds->refcnt, 1);
-	init_kernel_data_store(&pds->kds, tupdesc, bytesize,
-						   KDS_FORMAT_ROW, INT_MAX);
-	pds->nblocks_uncached = 0;
-	pds->filedesc.rawfd = -1;
-	pds->iovec = NULL;
+	PDS_setup_row(pds, gcontext, tupdesc, bytesize);
 
 	return pds;
 }
@@ -758,6 +819,30 @@ __PDS_create_slot(GpuContext *gcontext,
 	return pds;
 }
 
+static void
+PDS_setup_block(pgstrom_data_store *pds,
+				GpuContext *gcontext,
+				TupleDesc tupdesc,
+				NVMEScanState *nvme_sstate)
+{
+	cl_uint		nrooms = nvme_sstate->nblocks_per_chunk;
+	size_t		length;
+
+	length = KDS_calculateHeadSize(tupdesc)
+		+ STROMALIGN(sizeof(BlockNumber) * nrooms)
+		+ BLCKSZ * nrooms;
+	memset(pds, 0, offsetof(pgstrom_data_store, kds));
+	pds->gcontext = gcontext;
+	pg_atomic_init_u32(&pds->refcnt, 1);
+	init_kernel_data_store(&pds->kds, tupdesc, length,
+						   KDS_FORMAT_BLOCK, nrooms);
+	pds->kds.nrows_per_block = nvme_sstate->nrows_per_block;
+	pds->nblocks_uncached = 0;
+	pds->filedesc.rawfd = -1;
+	pds->iovec = (strom_io_vector *)((char *)&pds->kds + length);
+	pds->iovec->nr_chunks = 0;
+}
+
 pgstrom_data_store *
 __PDS_create_block(GpuContext *gcontext,
 				   TupleDesc tupdesc,
@@ -770,6 +855,7 @@ __PDS_create_block(GpuContext *gcontext,
 	size_t		iovec_sz;
 	CUresult	rc;
 
+	Assert(nrooms <= GPUSCAN_BLOCK_RESULT_MAX_NBLOCKS);
 	length = KDS_calculateHeadSize(tupdesc)
 		+ STROMALIGN(sizeof(BlockNumber) * nrooms)
 		+ BLCKSZ * nrooms;
@@ -789,20 +875,143 @@ __PDS_create_block(GpuContext *gcontext,
 	if (rc != CUDA_SUCCESS)
 		werror("failed on gpuMemAllocHost: %s", errorText(rc));
 	/* setup */
-	memset(pds, 0, offsetof(pgstrom_data_store, kds));
-	pds->gcontext = gcontext;
-	pg_atomic_init_u32(&pds->refcnt, 1);
-	init_kernel_data_store(&pds->kds, tupdesc, length,
-						   KDS_FORMAT_BLOCK, nrooms);
-	pds->kds.nrows_per_block = nvme_sstate->nrows_per_block;
-	pds->nblocks_uncached = 0;
-	pds->filedesc.rawfd = -1;
-	pds->iovec = (strom_io_vector *)((char *)&pds->kds + length);
-	pds->iovec->nr_chunks = 0;
+	PDS_setup_block(pds, gcontext, tupdesc, nvme_sstate);
+
+	return pds;
+}
+
+/*
+ * PDS_create_chunk - makes a data store for a chunk of the heap-scan;
+ * KDS_FORMAT_BLOCK if NVMe-Strom is available, or KDS_FORMAT_ROW.
+ *
+ * Length of the chunk buffer is always pg_strom.chunk_size, so we can
+ * recycle the buffers once released, instead of allocation per chunk.
+ * The chunk-ring of GpuTaskState keeps up to pg_strom.max_async_tasks
+ * + 2 buffers; the running/ready tasks, the current task and the chunk
+ * under construction. If all the buffers are in use, a new buffer is
+ * allocated out of the ring, because the backend cannot wait for the
+ * release of the buffers held by the ready tasks.
+ */
+pgstrom_data_store *
+__PDS_create_chunk(GpuTaskState *gts,
+				   TupleDesc tupdesc,
+				   const char *filename, int lineno)
+{
+	pgstromChunkRing *ring = gts->chunk_ring;
+	pgstrom_data_store *pds = NULL;
+	bool		attach = false;
+
+	if (ring)
+	{
+		SpinLockAcquire(&ring->lock);
+		if (ring->nfree > 0)
+		{
+			pds = ring->free_list[--ring->nfree];
+			ring->nr_recycled++;
+		}
+		else if (ring->nbuffers < ring->nrooms)
+			attach = true;
+		else
+			ring->nr_overflow++;
+		SpinLockRelease(&ring->lock);
+	}
+
+	if (pds)
+	{
+		/* reinitialize the recycled buffer */
+		if (gts->nvme_sstate)
+			PDS_setup_block(pds, gts->gcontext, tupdesc, gts->nvme_sstate);
+		else
+			PDS_setup_row(pds, gts->gcontext, tupdesc,
+						  STROMALIGN_DOWN(pgstromChunkAdaptiveSize(gts)));
+		pds->chunk_ring = ring;
+	}
+	else
+	{
+		if (gts->nvme_sstate)
+			pds = __PDS_create_block(gts->gcontext,
+									 tupdesc,
+									 gts->nvme_sstate,
+									 filename, lineno);
+		else
+		{
+			pds = __PDS_create_row(gts->gcontext,
+								   tupdesc,
+								   pgstrom_chunk_size(),
+								   filename, lineno);
+			/* buffer is pg_strom.chunk_size to recycle, but partially used */
+			if (pgstromChunkAdaptiveSize(gts) < pgstrom_chunk_size())
+				PDS_setup_row(pds, gts->gcontext, tupdesc,
+							  STROMALIGN_DOWN(pgstromChunkAdaptiveSize(gts)));
+		}
+		if (attach)
+		{
+			pds->chunk_ring = ring;
+			SpinLockAcquire(&ring->lock);
+			ring->buffers[ring->nbuffers++] = pds;
+			SpinLockRelease(&ring->lock);
+		}
+	}
 
+	if (ring)
+	{
+		SpinLockAcquire(&ring->lock);
+		ring->max_usage = Max(ring->max_usage, ring->nbuffers - ring->nfree);
+		SpinLockRelease(&ring->lock);
+	}
 	return pds;
 }
 
+/*
+ * PDS_init_chunk_ring - construct a chunk-ring of the heap-scan
+ */
+void
+PDS_init_chunk_ring(GpuTaskState *gts)
+{
+	EState	   *estate = gts->css.ss.ps.state;
+	pgstromChunkRing *ring;
+	cl_int		nrooms = pgstrom_max_async_tasks + 2;
+
+	if (gts->chunk_ring)
+		return;
+	ring = MemoryContextAllocZero(estate->es_query_cxt,
+								  offsetof(pgstromChunkRing,
+										   buffers[2 * nrooms]));
+	SpinLockInit(&ring->lock);
+	ring->nrooms = nrooms;
+	ring->free_list = ring->buffers + nrooms;
+
+	gts->chunk_ring = ring;
+}
+
+/*
+ * PDS_end_chunk_ring - release the free buffers of the chunk-ring, and
+ * detach the buffers still in use; they shall be released as usual.
+ */
+void
+PDS_end_chunk_ring(GpuTaskState *gts)
+{
+	pgstromChunkRing *ring = gts->chunk_ring;
+	CUresult	rc;
+	int			i;
+
+	if (!ring)
+		return;
+	SpinLockAcquire(&ring->lock);
+	for (i=0; i < ring->nbuffers; i++)
+		ring->buffers[i]->chunk_ring = NULL;
+	SpinLockRelease(&ring->lock);
+
+	for (i=0; i < ring->nfree; i++)
+	{
+		rc = gpuMemFree(gts->gcontext, (CUdeviceptr) ring->free_list[i]);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuMemFree: %s", errorText(rc));
+	}
+	ring->nbuffers = 0;
+	ring->nfree = 0;
+}
+
 /*
  * debug support
  */
@@ -922,6 +1131,9 @@ PDS_init_heapscan_state(GpuTaskState *gts)
 	cl_uint			nchunks;
 	cl_uint			nblocks_per_chunk;
 
+	/* chunk buffers are recycled regardless of NVMe-Strom */
+	PDS_init_chunk_ring(gts);
+
 	/*
 	 * Check storage capability of NVMe-Strom
 	 */
@@ -955,6 +1167,9 @@ PDS_init_heapscan_state(GpuTaskState *gts)
 		   MAXALIGN(offsetof(strom_io_vector,
 							 ioc[nrooms_max])) > pgstrom_chunk_size())
 		nrooms_max--;
+	/* see GPUSCAN_BLOCK_RESULT_PACK; block index is packed in 16bits */
+	if (nrooms_max > GPUSCAN_BLOCK_RESULT_MAX_NBLOCKS)
+		nrooms_max = GPUSCAN_BLOCK_RESULT_MAX_NBLOCKS;
 	if (nrooms_max < 1)
 		return;
 
@@ -970,8 +1185,11 @@ PDS_init_heapscan_state(GpuTaskState *gts)
 	nvme_sstate->nblocks_per_chunk = nblocks_per_chunk;
 	nvme_sstate->curr_segno = InvalidBlockNumber;
 	nvme_sstate->curr_vmbuffer = InvalidBuffer;
+	nvme_sstate->cold_base = InvalidBlockNumber;
+	nvme_sstate->cold_nblocks = 0;
 	nvme_sstate->nr_segs = nr_segs;
 	nvme_sstate_open_files(gcontext, nvme_sstate, relation);
+	nvme_sstate->mvcc_snapshot = pgstromSetupMvccSnapshot(gts);
 
 	gts->nvme_sstate = nvme_sstate;
 }
@@ -986,6 +1204,9 @@ PDS_end_heapscan_state(GpuTaskState *gts)
 	NVMEScanState  *nvme_sstate = gts->nvme_sstate;
 	int				i;
 
+	/* release the chunk buffers, if any */
+	PDS_end_chunk_ring(gts);
+
 	if (nvme_sstate)
 	{
 		/* release visibility map, if any */
@@ -1000,6 +1221,9 @@ PDS_end_heapscan_state(GpuTaskState *gts)
 			untrackRawFileDesc(gcontext, &nvme_sstate->files[i]);
 			gpuDirectFileDescClose(&nvme_sstate->files[i]);
 		}
+		/* release MVCC snapshot, if any */
+		if (nvme_sstate->mvcc_snapshot)
+			gpuMemFree(gcontext, (CUdeviceptr)nvme_sstate->mvcc_snapshot);
 		pfree(nvme_sstate);
 		gts->nvme_sstate = NULL;
 	}
@@ -10,6 +10,7 @@
  * it under the terms of the PostgreSQL License.
  */
 #include <dlfcn.h>
+#include <mntent.h>
 #include "pg_strom.h"
 
 /* pg_strom.gpudirect_driver */
@@ -19,6 +20,8 @@
 
 static struct config_enum_entry pgstrom_gpudirect_driver_options[4];
 static int		__pgstrom_gpudirect_driver;			/* GUC */
+static char	   *pgstrom_gpudirect_netfs_types;		/* GUC */
+static bool		pgstrom_cufile_batch_io;			/* GUC */
 
 PG_FUNCTION_INFO_V1(pgstrom_license_query);
 
@@ -238,6 +241,222 @@ gpuDirectUnmapGpuMemory(CUdeviceptr m_segment,
 	return p_gpudirect_unmap_gpu_memory(m_segment, iomap_handle);
 }
 
+/*
+ * cuFile batch I/O API (CUDA 11.6 or later)
+ *
+ * The declarations below are compatible to cufile.h. libcufile.so is loaded
+ * dynamically, because it is available only on the platform where NVIDIA
+ * GPUDirect Storage is installed; the extra module already links it.
+ */
+#define CUFILE_LIBRARY_FILENAME		"libcufile.so.0"
+#define CUFILE_BATCH_MAX_ENTRIES	128
+#define CUFILE_BATCH_IO_UNITSZ		(16UL << 20)
+
+typedef void   *CUfileHandle_t;
+typedef void   *CUfileBatchHandle_t;
+typedef struct
+{
+	int			err;		/* CUfileOpError; 0 = CU_FILE_SUCCESS */
+	CUresult	cu_err;
+} CUfileError_t;
+typedef enum
+{
+	CUFILE_READ = 0,
+	CUFILE_WRITE = 1,
+} CUfileOpcode_t;
+typedef enum
+{
+	CUFILE_BATCH = 1,
+} CUfileBatchMode_t;
+typedef enum
+{
+	CUFILE_WAITING	= 0x0001,
+	CUFILE_PENDING	= 0x0002,
+	CUFILE_INVALID	= 0x0004,
+	CUFILE_CANCELED	= 0x0008,
+	CUFILE_COMPLETE	= 0x0010,
+	CUFILE_TIMEOUT	= 0x0020,
+	CUFILE_FAILED	= 0x0040,
+} CUfileStatus_t;
+typedef struct
+{
+	CUfileBatchMode_t mode;
+	union {
+		struct {
+			void	   *devPtr_base;
+			off_t		file_offset;
+			off_t		devPtr_offset;
+			size_t		size;
+		} batch;
+	} u;
+	CUfileHandle_t	fh;
+	CUfileOpcode_t	opcode;
+	void		   *cookie;
+} CUfileIOParams_t;
+typedef struct
+{
+	void		   *cookie;
+	CUfileStatus_t	status;
+	size_t			ret;
+} CUfileIOEvents_t;
+
+static CUfileError_t (*p_cuFileBatchIOSetUp)(
+	CUfileBatchHandle_t *batch_idp,
+	unsigned int nr) = NULL;
+static CUfileError_t (*p_cuFileBatchIOSubmit)(
+	CUfileBatchHandle_t batch_idp,
+	unsigned int nr,
+	CUfileIOParams_t *iocbp,
+	unsigned int flags) = NULL;
+static CUfileError_t (*p_cuFileBatchIOGetStatus)(
+	CUfileBatchHandle_t batch_idp,
+	unsigned int min_nr,
+	unsigned int *nr,
+	CUfileIOEvents_t *iocbp,
+	struct timespec *timeout) = NULL;
+static CUfileError_t (*p_cuFileBatchIOCancel)(
+	CUfileBatchHandle_t batch_idp) = NULL;
+static void (*p_cuFileBatchIODestroy)(
+	CUfileBatchHandle_t batch_idp) = NULL;
+
+/*
+ * __cufileBatchIOSubmitAndWait
+ *
+ * It submits the i/o requests at once, then waits for completion of all of
+ * them. It returns NULL on success, or error message.
+ */
+static const char *
+__cufileBatchIOSubmitAndWait(const GPUDirectFileDesc *gds_fdesc,
+							 CUfileBatchHandle_t batch_id,
+							 CUfileIOParams_t *params,
+							 CUfileIOEvents_t *events,
+							 unsigned int nr_params)
+{
+	CUfileError_t	rv;
+	CUresult		rc;
+	unsigned int	nr_done = 0;
+	unsigned int	i, nr;
+
+	rv = p_cuFileBatchIOSubmit(batch_id, nr_params, params, 0);
+	if (rv.err != 0)
+		return "failed on cuFileBatchIOSubmit";
+	while (nr_done < nr_params)
+	{
+		nr = nr_params - nr_done;
+		rv = p_cuFileBatchIOGetStatus(batch_id, 1, &nr, events, NULL);
+		if (rv.err != 0)
+		{
+			p_cuFileBatchIOCancel(batch_id);
+			return "failed on cuFileBatchIOGetStatus";
+		}
+		for (i=0; i < nr; i++)
+		{
+			CUfileIOParams_t *p = events[i].cookie;
+			ssize_t		ret = (ssize_t)events[i].ret;
+
+			if (events[i].status != CUFILE_COMPLETE || ret < 0)
+			{
+				p_cuFileBatchIOCancel(batch_id);
+				return "cuFile batch i/o request was not completed";
+			}
+			if ((size_t)ret == p->u.batch.size)
+				continue;
+			/*
+			 * Due to the page_sz alignment, we may try to read the file
+			 * over its tail, like the extra module's read path. Only the
+			 * last request may be short by less than PAGE_SIZE, and the
+			 * remaining area is cleared by zero.
+			 */
+			if ((size_t)ret > p->u.batch.size ||
+				p->u.batch.size - ret >= PAGE_SIZE ||
+				p->u.batch.file_offset + ret != gds_fdesc->bytesize)
+			{
+				p_cuFileBatchIOCancel(batch_id);
+				return "cuFile batch i/o request was short read";
+			}
+			rc = cuMemsetD8((CUdeviceptr)p->u.batch.devPtr_base +
+							p->u.batch.devPtr_offset + ret,
+							0, p->u.batch.size - ret);
+			if (rc != CUDA_SUCCESS)
+			{
+				p_cuFileBatchIOCancel(batch_id);
+				return "failed on cuMemsetD8 for the tail of file";
+			}
+		}
+		nr_done += nr;
+	}
+	return NULL;
+}
+
+/*
+ * __gpuDirectFileReadIOVBatch
+ *
+ * It reads the i/o vector using cuFile batch API, to keep all the chunks
+ * (like column chunks of a record-batch) in flight together. Large chunks
+ * are split into CUFILE_BATCH_IO_UNITSZ, so the striped drives can serve
+ * them concurrently. It returns false if batch i/o is not available, then
+ * caller falls back to the extra module.
+ */
+static bool
+__gpuDirectFileReadIOVBatch(const GPUDirectFileDesc *gds_fdesc,
+							CUdeviceptr m_segment,
+							off_t m_offset,
+							strom_io_vector *iovec)
+{
+	CUfileBatchHandle_t batch_id;
+	CUfileIOParams_t params[CUFILE_BATCH_MAX_ENTRIES];
+	CUfileIOEvents_t events[CUFILE_BATCH_MAX_ENTRIES];
+	CUfileError_t	rv;
+	const char	   *errmsg = NULL;
+	unsigned int	nr_params = 0;
+	unsigned int	i;
+
+	rv = p_cuFileBatchIOSetUp(&batch_id, CUFILE_BATCH_MAX_ENTRIES);
+	if (rv.err != 0)
+		return false;
+	for (i=0; !errmsg && i < iovec->nr_chunks; i++)
+	{
+		strom_io_chunk *ioc = &iovec->ioc[i];
+		off_t		f_pos = (off_t)ioc->fchunk_id * PAGE_SIZE;
+		off_t		d_pos = m_offset + ioc->m_offset;
+		size_t		remained = (size_t)ioc->nr_pages * PAGE_SIZE;
+
+		while (!errmsg && remained > 0)
+		{
+			CUfileIOParams_t *p = &params[nr_params++];
+			size_t		sz = Min(remained, CUFILE_BATCH_IO_UNITSZ);
+
+			memset(p, 0, sizeof(CUfileIOParams_t));
+			p->mode = CUFILE_BATCH;
+			p->u.batch.devPtr_base = (void *)m_segment;
+			p->u.batch.file_offset = f_pos;
+			p->u.batch.devPtr_offset = d_pos;
+			p->u.batch.size = sz;
+			p->fh = gds_fdesc->fhandle;
+			p->opcode = CUFILE_READ;
+			p->cookie = p;
+
+			f_pos += sz;
+			d_pos += sz;
+			remained -= sz;
+			if (nr_params == CUFILE_BATCH_MAX_ENTRIES)
+			{
+				errmsg = __cufileBatchIOSubmitAndWait(gds_fdesc, batch_id,
+													  params, events,
+													  nr_params);
+				nr_params = 0;
+			}
+		}
+	}
+	if (!errmsg && nr_params > 0)
+		errmsg = __cufileBatchIOSubmitAndWait(gds_fdesc, batch_id,
+											  params, events, nr_params);
+	p_cuFileBatchIODestroy(batch_id);
+	if (errmsg)
+		werror("failed on gpuDirectFileReadIOV: %s", errmsg);
+	return true;
+}
+
 /*
  * gpuDirectFileReadIOV
  */
@@ -256,6 +475,11 @@ gpuDirectFileReadIOV(const GPUDirectFileDesc *gds_fdesc,
 					 strom_io_vector *iovec)
 {
 	Assert(p_gpudirect_file_read_iov != NULL);
+	if (pgstrom_cufile_batch_io &&
+		p_cuFileBatchIOSetUp != NULL &&
+		iovec->nr_chunks > 1 &&
+		__gpuDirectFileReadIOVBatch(gds_fdesc, m_segment, m_offset, iovec))
+		return;
 	if (p_gpudirect_file_read_iov(gds_fdesc,
 								  m_segment,
 								  iomap_handle,
@@ -303,6 +527,77 @@ extraSysfsSetupDistanceMap(const char *manual_config)
 		heterodbExtraEreport(ERROR);
 }
 
+/*
+ * __fstypeIsGpuDirectNetFS
+ *
+ * It checks whether the filesystem type is listed on
+ * pg_strom.gpudirect_netfs_types.
+ */
+static bool
+__fstypeIsGpuDirectNetFS(const char *fstype)
+{
+	char   *buffer;
+	char   *tok, *pos;
+
+	if (!pgstrom_gpudirect_netfs_types)
+		return false;
+	buffer = alloca(strlen(pgstrom_gpudirect_netfs_types) + 1);
+	strcpy(buffer, pgstrom_gpudirect_netfs_types);
+	for (tok = strtok_r(buffer, ",", &pos);
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",", &pos))
+	{
+		tok = __trim(tok);
+		if (strcmp(tok, fstype) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * __fileIsOnGpuDirectNetFS
+ *
+ * It checks whether the file is located on the network filesystem that
+ * cuFile driver can read by GPUDirect Storage (like NFS over RDMA, Lustre,
+ * WekaFS and so on), according to the mount entry closest to the file.
+ */
+static bool
+__fileIsOnGpuDirectNetFS(int fdesc)
+{
+	char		fdpath[64];
+	char		pathname[MAXPGPATH];
+	ssize_t		len;
+	size_t		best_len = 0;
+	bool		retval = false;
+	FILE	   *filp;
+	struct mntent *mnt;
+
+	snprintf(fdpath, sizeof(fdpath), "/proc/self/fd/%d", fdesc);
+	len = readlink(fdpath, pathname, sizeof(pathname) - 1);
+	if (len <= 0)
+		return false;
+	pathname[len] = '\0';
+
+	filp = setmntent("/proc/self/mounts", "r");
+	if (!filp)
+		return false;
+	while ((mnt = getmntent(filp)) != NULL)
+	{
+		size_t	sz = strlen(mnt->mnt_dir);
+
+		if (sz < best_len ||
+			strncmp(pathname, mnt->mnt_dir, sz) != 0 ||
+			(sz > 1 && pathname[sz] != '/' && pathname[sz] != '\0'))
+			continue;
+		/* later entry overrides the earlier one on the same mount point */
+		best_len = sz;
+		retval = __fstypeIsGpuDirectNetFS(mnt->mnt_type);
+	}
+	endmntent(filp);
+
+	return retval;
+}
+
 /*
  * extraSysfsLookupOptimalGpu
  */
@@ -323,8 +618,21 @@ extraSysfsLookupOptimalGpu(int fdesc)
 	if (nitems < 0)
 		heterodbExtraEreport(ERROR);
 	if (nitems == 0)
+	{
+		/*
+		 * Files on the network filesystem have no PCIe-bus distance to GPUs
+		 * unless the distance map is manually configured. If cuFile driver
+		 * can read them over the NIC (GPUDirect Storage), any GPU is equally
+		 * close, so we pick up the nearest one in the NUMA distance.
+		 * nvme_strom driver supports only local NVMe-SSDs.
+		 */
+		if (__pgstrom_gpudirect_driver == GPUDIRECT_DRIVER_TYPE__CUFILE &&
+			__fileIsOnGpuDirectNetFS(fdesc))
+			return gpuNumaNearestDevice(NULL, numDevAttrs, MyProcPid);
 		return -1;
-	return optimal_gpus[0];
+	}
+	/* tie-break by the NUMA distance from the current CPU */
+	return gpuNumaNearestDevice(optimal_gpus, nitems, MyProcPid);
 }
 
 /*
@@ -371,6 +679,40 @@ lookup_gpudirect_function(void *handle, const char *prefix, const char *func_nam
 #define LOOKUP_GPUDIRECT_EXTRA_FUNCTION(prefix,func_name)	\
 	p_gpudirect_##func_name = lookup_gpudirect_function(handle, prefix, #func_name)
 
+/*
+ * setup_cufile_batch_functions
+ *
+ * cuFile batch API is optional; older libcufile.so does not have.
+ */
+static void
+setup_cufile_batch_functions(void)
+{
+	void   *handle;
+
+	handle = dlopen(CUFILE_LIBRARY_FILENAME, RTLD_NOW | RTLD_LOCAL);
+	if (!handle)
+		return;
+	p_cuFileBatchIOSetUp = dlsym(handle, "cuFileBatchIOSetUp");
+	p_cuFileBatchIOSubmit = dlsym(handle, "cuFileBatchIOSubmit");
+	p_cuFileBatchIOGetStatus = dlsym(handle, "cuFileBatchIOGetStatus");
+	p_cuFileBatchIOCancel = dlsym(handle, "cuFileBatchIOCancel");
+	p_cuFileBatchIODestroy = dlsym(handle, "cuFileBatchIODestroy");
+	if (!p_cuFileBatchIOSetUp ||
+		!p_cuFileBatchIOSubmit ||
+		!p_cuFileBatchIOGetStatus ||
+		!p_cuFileBatchIOCancel ||
+		!p_cuFileBatchIODestroy)
+	{
+		p_cuFileBatchIOSetUp = NULL;
+		p_cuFileBatchIOSubmit = NULL;
+		p_cuFileBatchIOGetStatus = NULL;
+		p_cuFileBatchIOCancel = NULL;
+		p_cuFileBatchIODestroy = NULL;
+		return;
+	}
+	elog(LOG, "cuFile batch I/O API is available");
+}
+
 /*
  * parse_heterodb_extra_module_info
  */
@@ -505,11 +847,33 @@ pgstrom_init_extra(void)
 								 PGC_POSTMASTER,
 								 GUC_NOT_IN_SAMPLE,
 								 NULL, NULL, NULL);
+		/* pg_strom.gpudirect_netfs_types */
+		DefineCustomStringVariable("pg_strom.gpudirect_netfs_types",
+								   "Network filesystem types that cuFile driver reads by GPUDirect Storage",
+								   NULL,
+								   &pgstrom_gpudirect_netfs_types,
+								   "nfs,nfs4,lustre,wekafs,gpfs,beegfs",
+								   PGC_SUSET,
+								   GUC_NOT_IN_SAMPLE,
+								   NULL, NULL, NULL);
 		if (__pgstrom_gpudirect_driver == GPUDIRECT_DRIVER_TYPE__CUFILE)
 			prefix = "cufile";
 		else if (__pgstrom_gpudirect_driver == GPUDIRECT_DRIVER_TYPE__NVME_STROM)
 			prefix = "nvme_strom";
 
+		if (__pgstrom_gpudirect_driver == GPUDIRECT_DRIVER_TYPE__CUFILE)
+		{
+			/* pg_strom.cufile_batch_io */
+			DefineCustomBoolVariable("pg_strom.cufile_batch_io",
+									 "Enables cuFile batch API to read multiple chunks at once",
+									 NULL,
+									 &pgstrom_cufile_batch_io,
+									 true,
+									 PGC_SUSET,
+									 GUC_NOT_IN_SAMPLE,
+									 NULL, NULL, NULL);
+			setup_cufile_batch_functions();
+		}
 		if (prefix)
 		{
 			LOOKUP_GPUDIRECT_EXTRA_FUNCTION(prefix, init_driver);
@@ -18,12 +18,15 @@
 #define GCACHE_BGWORKER_CMD__APPLY_REDO		'A'
 #define GCACHE_BGWORKER_CMD__COMPACTION		'C'
 #define GCACHE_BGWORKER_CMD__DROP_UNLOAD	'D'
+#define GCACHE_BGWORKER_CMD__CHECKPOINT		'K'
+#define GCACHE_BGWORKER_CMD__RESTORE		'R'
 typedef struct
 {
 	dlist_node  chain;
 	Oid         database_oid;
 	Oid         table_oid;
 	Datum		signature;
+	int			shard_id;
 	Latch      *backend;        /* MyLatch of the backend, if any */
 	int         command;        /* one of GCACHE_BGWORKER_CMD__* */
 	CUresult    retval;
@@ -34,6 +37,7 @@ typedef struct
  * GpuCacheSharedHead (shared structure; static)
  */
 #define GPUCACHE_SHARED_DESC_NSLOTS		37
+#define GPUCACHE_WAL_SYNC_NSLOTS		32
 typedef struct
 {
 	/* pg_strom.gpucache_auto_preload related */
@@ -42,9 +46,19 @@ typedef struct
 	/* hash slot for GpuCacheSharedState */
 	slock_t		gcache_sstate_lock;
 	dlist_head	gcache_sstate_slot[GPUCACHE_SHARED_DESC_NSLOTS];
+	pg_atomic_uint64 gcache_generation;	/* see gpuCacheContentsVersion */
 	/* database name for preloading */
 	int			preload_database_status;
 	char		preload_database_name[NAMEDATALEN];
+	/* WAL-sync workers (per database) */
+	slock_t		wal_sync_lock;
+	struct {
+		Oid			database_oid;	/* InvalidOid, if free slot */
+		pid_t		pid;
+		bool		is_ready;		/* all the xacts before @start_lsn done */
+		TimestampTz	launched_at;
+		XLogRecPtr	start_lsn;
+	} wal_sync[GPUCACHE_WAL_SYNC_NSLOTS];
 	/* IPC to GpuCache background workers */
 	slock_t		bgworker_cmd_lock;
 	dlist_head	bgworker_free_cmds;
@@ -57,8 +71,54 @@ typedef struct
 
 /*
  * GpuCacheSharedState (shared structure; dynamic portable)
+ *
+ * A table may be sharded across multiple GPUs by the block range of ctid.
+ * Each shard has its own GpuCacheSharedState with REDO log buffer and
+ * device memory, and the sibling shards are referenced via shard-0 that is
+ * the entry point for backends.
+ */
+#define GPUCACHE_MAX_SHARDS			16
+#define GPUCACHE_MAX_BUFFER_VERSIONS	8
+#define GPUCACHE_SHARD_NBLOCKS		1024	/* 8MB of heap per stripe */
+#define GPUCACHE_STAT_HIST_NBUCKETS	24		/* 1us ... 8s, in log2 */
+#define GPUCACHE_WINDOW_EVICT_INTERVAL	60000000L	/* 60s */
+
+typedef struct
+{
+	bool			in_use;
+	pg_atomic_uint32 nreaders;		/* # of readers that pin this version */
+	CUdeviceptr		main_devptr;	/* valid only bgworker */
+	CUdeviceptr		extra_devptr;	/* valid only bgworker */
+	CUipcMemHandle	main_mhandle;
+	CUipcMemHandle	extra_mhandle;
+} GpuCacheBufferVersion;
+
+/*
+ * GpuCacheStatistics
+ *
+ * Run-time statistics for pgstrom.gpucache_stats. The k-th bucket of
+ * @apply_hist counts REDO log applications that took [2^k, 2^(k+1))
+ * microseconds; the last one also counts longer ones.
  */
 typedef struct
+{
+	pg_atomic_uint64 redo_wait_count;	/* # of 1ms waits on REDO buffer full */
+	pg_atomic_uint64 apply_count;
+	pg_atomic_uint64 apply_usec;
+	pg_atomic_uint64 apply_max_usec;
+	pg_atomic_uint64 apply_hist[GPUCACHE_STAT_HIST_NBUCKETS];
+	pg_atomic_uint64 apply_timestamp;	/* last application */
+	pg_atomic_uint64 compaction_count;
+	pg_atomic_uint64 compaction_usec;
+	pg_atomic_uint64 reader_wait_count;
+	pg_atomic_uint64 reader_wait_usec;
+	pg_atomic_uint64 writer_wait_count;
+	pg_atomic_uint64 writer_wait_usec;
+	pg_atomic_uint64 corrupted_count;
+	pg_atomic_uint64 reload_count;
+} GpuCacheStatistics;
+
+typedef struct GpuCacheSharedState
 {
 	dlist_node		chain;
 	Oid				database_oid;
@@ -70,6 +130,15 @@ typedef struct
 	/* GPU memory store parameters */
 	int64			max_num_rows;
 	int32			cuda_dindex;
+	int32			shard_id;
+	int32			num_shards;
+	struct GpuCacheSharedState *shards[GPUCACHE_MAX_SHARDS];	/* shard-0 only */
+	char			sync_mode;		/* one of GPUCACHE_SYNC_MODE__* */
+	int32			index_colidx;	/* column of the hash index, or -1 */
+	int32			window_colidx;	/* column of the cache window, or -1 */
+	Oid				window_typid;
+	int64			window_usec;
+	TimestampTz		window_evicted;	/* last eviction; valid only bgworker */
 	size_t			redo_buffer_size;
 	size_t			gpu_sync_threshold;
 	int32			gpu_sync_interval;
@@ -84,16 +153,47 @@ typedef struct
 	CUdeviceptr		gpu_main_devptr;	/* valid only bgworker */
 	CUdeviceptr		gpu_extra_devptr;	/* valid only bgworker */
 
-	/* REDO buffer properties */
+	/*
+	 * Versions of the device buffers published to readers
+	 *
+	 * Readers map the current version of the buffers, then pin it until
+	 * the unmapping without holding @gpu_buffer_lock. BgWorker never updates
+	 * nor releases the buffers of the pinned version; it makes a private copy
+	 * of the main buffer before the update (copy-on-write), then publishes
+	 * the new version at the end of the operation. The retired versions are
+	 * released once all the readers unpin them.
+	 */
+	int32			gpu_curr_version;
+	GpuCacheBufferVersion gpu_versions[GPUCACHE_MAX_BUFFER_VERSIONS];
+
+	/*
+	 * REDO buffer properties
+	 *
+	 * Backends append REDO logs without locks. A writer reserves the space
+	 * by CAS on @redo_write_pos, copies the log, then publishes the log by
+	 * setting its @type at last. BgWorker (the only reader) consumes the logs
+	 * contiguously published from @redo_read_pos, then clears the area.
+	 * @redo_lock protects the reader side properties, and rewind of the buffer.
+	 */
 	slock_t			redo_lock;
-	uint64			redo_write_timestamp;
-	uint64			redo_write_nitems;
-	uint64			redo_write_pos;
+	pg_atomic_uint64 redo_write_timestamp;
+	pg_atomic_uint64 redo_write_nitems;
+	pg_atomic_uint64 redo_write_pos;
 	uint64			redo_read_nitems;
-	uint64			redo_read_pos;
-	uint64			redo_sync_pos;
+	pg_atomic_uint64 redo_read_pos;
+	pg_atomic_uint64 redo_sync_pos;
+	uint64			redo_generation; /* renewed on (re-)loading */
 	char		   *redo_buffer;
 
+	/* on-disk checkpoint properties (protected by redo_lock) */
+	bool			checkpoint_enabled;	/* false, if not a permanent table */
+	uint64			checkpoint_timestamp;
+	uint64			checkpoint_generation;
+	uint64			checkpoint_redo_pos;
+
+	/* run-time statistics */
+	GpuCacheStatistics stats;
+
 	/* schema definitions (KDS_FORMAT_COLUMN) */
 	size_t			kds_extra_sz;
 	kern_data_store	kds_head;
@@ -121,9 +221,40 @@ typedef struct
 	ItemPointerData	ctid;
 } PendingCtidItem;
 
+/*
+ * GpuCacheCheckpointHeader
+ *
+ * Header of the checkpoint file at pg_strom.gpucache_checkpoint_dir.
+ * The image of the main buffer (from @main_offset) and the used portion of
+ * the extra buffer (from @extra_offset) follow the header; both of them are
+ * aligned to PAGE_SIZE, to be loaded by GPUDirect SQL.
+ */
+#define GPUCACHE_CHECKPOINT_MAGIC		0x4b434347	/* "GCCK" */
+#define GPUCACHE_CHECKPOINT_VERSION		1
+#define GPUCACHE_CHECKPOINT_CHUNK_SZ	(32UL << 20)	/* 32MB */
+
+typedef struct
+{
+	uint32			magic;			/* = GPUCACHE_CHECKPOINT_MAGIC */
+	uint32			version;		/* = GPUCACHE_CHECKPOINT_VERSION */
+	Oid				database_oid;
+	Oid				table_oid;
+	Datum			signature;
+	XLogRecPtr		checkpoint_lsn;	/* WAL insert position at the checkpoint */
+	TransactionId	oldest_xid;		/* oldest running xid at the checkpoint */
+	TimestampTz		timestamp;
+	size_t			main_offset;
+	size_t			main_size;
+	size_t			extra_offset;
+	size_t			extra_size;		/* PAGE_ALIGN(usage) of the extra buffer */
+	size_t			extra_length;	/* length of the extra buffer */
+} GpuCacheCheckpointHeader;
+
 /* --- static variables --- */
 static char		   *pgstrom_gpucache_auto_preload;		/* GUC */
 static bool			enable_gpucache;					/* GUC */
+static char		   *gpucache_checkpoint_dir;			/* GUC */
+static int			gpucache_checkpoint_interval;		/* GUC */
 static GpuCacheSharedHead *gcache_shared_head = NULL;
 static HTAB		   *gcache_descriptors_htab = NULL;
 static HTAB		   *gcache_signatures_htab = NULL;
@@ -133,7 +264,12 @@ static object_access_hook_type object_access_next = NULL;
 static CUmodule		gcache_cuda_module = NULL;
 static CUfunction	gcache_kfunc_init_empty = NULL;
 static CUfunction	gcache_kfunc_apply_redo = NULL;
+static CUfunction	gcache_kfunc_sort_redo = NULL;
 static CUfunction	gcache_kfunc_compaction = NULL;
+static CUfunction	gcache_kfunc_compaction_commit = NULL;
+static CUfunction	gcache_kfunc_expand_rowmap = NULL;
+static CUfunction	gcache_kfunc_build_colindex = NULL;
+static CUfunction	gcache_kfunc_evict_window = NULL;
 
 /* --- function declarations --- */
 static bool		__gpuCacheAppendLog(GpuCacheDesc *gc_desc,
@@ -144,14 +280,116 @@ static CUresult gpuCacheInvokeApplyRedo(GpuCacheSharedState *gc_sstate,
 										bool is_async);
 static CUresult gpuCacheInvokeCompaction(GpuCacheSharedState *gc_sstate,
 										 bool is_async);
+static CUresult gpuCacheInvokeRestore(GpuCacheSharedState *gc_sstate);
 static CUresult gpuCacheInvokeDropUnload(GpuCacheSharedState *gc_sstate,
 										 bool is_async);
+static bool		gpuCacheWalSyncLaunch(Oid database_oid);
 void	gpuCacheStartupPreloader(Datum arg);
+void	gpuCacheWalSyncMain(Datum arg);
 PG_FUNCTION_INFO_V1(pgstrom_gpucache_sync_trigger);
 PG_FUNCTION_INFO_V1(pgstrom_gpucache_apply_redo);
 PG_FUNCTION_INFO_V1(pgstrom_gpucache_compaction);
 PG_FUNCTION_INFO_V1(pgstrom_gpucache_recovery);
 PG_FUNCTION_INFO_V1(pgstrom_gpucache_info);
+PG_FUNCTION_INFO_V1(pgstrom_gpucache_stats);
+PG_FUNCTION_INFO_V1(pgstrom_gpucache_export_ipchandle);
+
+/*
+ * Run-time statistics
+ */
+static void
+gpuCacheInitStatistics(GpuCacheStatistics *stats)
+{
+	pg_atomic_init_u64(&stats->redo_wait_count, 0);
+	pg_atomic_init_u64(&stats->apply_count, 0);
+	pg_atomic_init_u64(&stats->apply_usec, 0);
+	pg_atomic_init_u64(&stats->apply_max_usec, 0);
+	for (int k=0; k < GPUCACHE_STAT_HIST_NBUCKETS; k++)
+		pg_atomic_init_u64(&stats->apply_hist[k], 0);
+	pg_atomic_init_u64(&stats->apply_timestamp, 0);
+	pg_atomic_init_u64(&stats->compaction_count, 0);
+	pg_atomic_init_u64(&stats->compaction_usec, 0);
+	pg_atomic_init_u64(&stats->reader_wait_count, 0);
+	pg_atomic_init_u64(&stats->reader_wait_usec, 0);
+	pg_atomic_init_u64(&stats->writer_wait_count, 0);
+	pg_atomic_init_u64(&stats->writer_wait_usec, 0);
+	pg_atomic_init_u64(&stats->corrupted_count, 0);
+	pg_atomic_init_u64(&stats->reload_count, 0);
+}
+
+/* called by BgWorker only, so no need to concern about concurrent updates */
+static void
+gpuCacheStatApplyRedo(GpuCacheSharedState *gc_sstate, TimestampTz tv_start)
+{
+	GpuCacheStatistics *stats = &gc_sstate->stats;
+	TimestampTz	tv_end = GetCurrentTimestamp();
+	uint64		usec = Max(tv_end - tv_start, 0);
+	int			k = (int)get_next_log2(usec + 1) - 1;
+
+	k = Max(Min(k, GPUCACHE_STAT_HIST_NBUCKETS - 1), 0);
+	pg_atomic_fetch_add_u64(&stats->apply_count, 1);
+	pg_atomic_fetch_add_u64(&stats->apply_usec, usec);
+	if (usec > pg_atomic_read_u64(&stats->apply_max_usec))
+		pg_atomic_write_u64(&stats->apply_max_usec, usec);
+	pg_atomic_fetch_add_u64(&stats->apply_hist[k], 1);
+	pg_atomic_write_u64(&stats->apply_timestamp, tv_end);
+}
+
+static void
+gpuCacheStatCompaction(GpuCacheSharedState *gc_sstate, TimestampTz tv_start)
+{
+	GpuCacheStatistics *stats = &gc_sstate->stats;
+
+	pg_atomic_fetch_add_u64(&stats->compaction_count, 1);
+	pg_atomic_fetch_add_u64(&stats->compaction_usec,
+							Max(GetCurrentTimestamp() - tv_start, 0));
+}
+
+/*
+ * gpuCacheMarkCorrupted
+ */
+static inline void
+gpuCacheMarkCorrupted(GpuCacheSharedState *gc_sstate)
+{
+	pg_atomic_write_u32(&gc_sstate->gpu_buffer_corrupted, 1);
+	pg_atomic_fetch_add_u64(&gc_sstate->stats.corrupted_count, 1);
+}
+
+/*
+ * gpuCacheReadLock / gpuCacheWriteLock
+ *
+ * It acquires gpu_buffer_lock, and accumulates the wait time only if the
+ * lock is contended, so the fast path needs no system call.
+ */
+static void
+gpuCacheReadLock(GpuCacheSharedState *gc_sstate)
+{
+	GpuCacheStatistics *stats = &gc_sstate->stats;
+	TimestampTz	tv_start;
+
+	if (pthreadRWLockReadTryLock(&gc_sstate->gpu_buffer_lock))
+		return;
+	tv_start = GetCurrentTimestamp();
+	pthreadRWLockReadLock(&gc_sstate->gpu_buffer_lock);
+	pg_atomic_fetch_add_u64(&stats->reader_wait_count, 1);
+	pg_atomic_fetch_add_u64(&stats->reader_wait_usec,
+							Max(GetCurrentTimestamp() - tv_start, 0));
+}
+
+static void
+gpuCacheWriteLock(GpuCacheSharedState *gc_sstate)
+{
+	GpuCacheStatistics *stats = &gc_sstate->stats;
+	TimestampTz	tv_start;
+
+	if (pthreadRWLockWriteTryLock(&gc_sstate->gpu_buffer_lock))
+		return;
+	tv_start = GetCurrentTimestamp();
+	pthreadRWLockWriteLock(&gc_sstate->gpu_buffer_lock);
+	pg_atomic_fetch_add_u64(&stats->writer_wait_count, 1);
+	pg_atomic_fetch_add_u64(&stats->writer_wait_usec,
+							Max(GetCurrentTimestamp() - tv_start, 0));
+}
 
 /*
  * gpucache_sync_trigger_function_oid
@@ -194,7 +432,14 @@ gpucache_sync_trigger_function_oid(void)
 
 /*
  * parseSyncTriggerOptions
+ *
+ * 'sync_mode=wal' makes the WAL-sync worker replay the heap WAL records on
+ * the GPU cache, instead of the row trigger. Then, the trigger is usually
+ * enabled as REPLICA trigger; so it never fires on the normal sessions.
  */
+#define GPUCACHE_SYNC_MODE__TRIGGER		't'
+#define GPUCACHE_SYNC_MODE__WAL			'w'
+
 typedef struct
 {
 	Oid			tg_sync_row;
@@ -202,24 +447,36 @@ typedef struct
 	Oid			tg_sync_stmt;
 #endif
 	int			cuda_dindex;
+	int			num_shards;
+	char		sync_mode;
 	int32		gpu_sync_interval;
 	size_t		gpu_sync_threshold;
 	int64		max_num_rows;
 	size_t		redo_buffer_size;
+	NameData	index_column;	/* empty, if no column index */
+	NameData	window_column;	/* empty, if no cache window */
+	int64		window_usec;
 } GpuCacheOptions;
 
 static bool
 __parseSyncTriggerOptions(const char *__config, GpuCacheOptions *gc_options)
 {
 	int			cuda_dindex = 0;				/* default: GPU0 */
+	int			num_shards = 1;					/* default: no sharding */
+	char		sync_mode = GPUCACHE_SYNC_MODE__TRIGGER;
 	int			gpu_sync_interval = 5000000L;	/* default: 5sec = 5000000us */
 	ssize_t		gpu_sync_threshold = -1;		/* default: auto */
 	int64		max_num_rows = (10UL << 20);	/* default: 10M rows */
 	ssize_t		redo_buffer_size = (160UL << 20);	/* default: 160MB */
+	NameData	index_column;					/* default: no index */
+	NameData	window_column;					/* default: cache all rows */
+	int64		window_usec = 0;
 	char	   *config;
 	char	   *key, *value;
 	char	   *saved;
 
+	memset(&index_column, 0, sizeof(NameData));
+	memset(&window_column, 0, sizeof(NameData));
 	if (!__config)
 		goto out;
 	config = alloca(strlen(__config) + 1);
@@ -270,6 +527,45 @@ __parseSyncTriggerOptions(const char *__config, GpuCacheOptions *gc_options)
 				return false;
 			}
 		}
+		else if (strcmp(key, "num_shards") == 0)
+		{
+			char   *end;
+
+			num_shards = strtol(value, &end, 10);
+			if (*end != '\0')
+			{
+				elog(WARNING, "gpucache: invalid option [%s]=[%s]",
+					 key, value);
+				return false;
+			}
+			if (num_shards < 1 || num_shards > GPUCACHE_MAX_SHARDS)
+			{
+				elog(WARNING, "gpucache: num_shards (%d) out of range [1..%d]",
+					 num_shards, GPUCACHE_MAX_SHARDS);
+				return false;
+			}
+		}
+		else if (strcmp(key, "sync_mode") == 0)
+		{
+			if (strcmp(value, "trigger") == 0)
+				sync_mode = GPUCACHE_SYNC_MODE__TRIGGER;
+			else if (strcmp(value, "wal") == 0)
+			{
+				/* UPDATE log records full new tuple only if wal_level=logical */
+				if (!XLogLogicalInfoActive())
+				{
+					elog(WARNING, "gpucache: sync_mode=wal requires wal_level=logical");
+					return false;
+				}
+				sync_mode = GPUCACHE_SYNC_MODE__WAL;
+			}
+			else
+			{
+				elog(WARNING, "gpucache: invalid option [%s]=[%s]",
+					 key, value);
+				return false;
+			}
+		}
 		else if (strcmp(key, "max_num_rows") == 0)
 		{
 			char   *end;
@@ -343,6 +639,52 @@ __parseSyncTriggerOptions(const char *__config, GpuCacheOptions *gc_options)
 				return false;
 			}
 		}
+		else if (strcmp(key, "index_column") == 0)
+		{
+			if (strlen(value) >= NAMEDATALEN)
+			{
+				elog(WARNING, "gpucache: invalid option [%s]=[%s]",
+					 key, value);
+				return false;
+			}
+			namestrcpy(&index_column, value);
+		}
+		else if (strcmp(key, "cache_window_column") == 0)
+		{
+			if (strlen(value) >= NAMEDATALEN)
+			{
+				elog(WARNING, "gpucache: invalid option [%s]=[%s]",
+					 key, value);
+				return false;
+			}
+			namestrcpy(&window_column, value);
+		}
+		else if (strcmp(key, "cache_window") == 0)
+		{
+			char   *end;
+
+			window_usec = strtol(value, &end, 10);
+			if (strcasecmp(end, "d") == 0 || strcasecmp(end, "days") == 0)
+				window_usec *= USECS_PER_DAY;
+			else if (strcasecmp(end, "h") == 0 || strcasecmp(end, "hours") == 0)
+				window_usec *= USECS_PER_HOUR;
+			else if (strcasecmp(end, "m") == 0 || strcasecmp(end, "min") == 0)
+				window_usec *= USECS_PER_MINUTE;
+			else if (strcasecmp(end, "s") == 0 || *end == '\0')
+				window_usec *= USECS_PER_SEC;
+			else
+			{
+				elog(WARNING, "gpucache: invalid option [%s]=[%s]",
+					 key, value);
+				return false;
+			}
+			if (window_usec <= 0)
+			{
+				elog(WARNING, "gpucache: 'cache_window' must be positive [%s]",
+					 value);
+				return false;
+			}
+		}
 		else
 		{
 			elog(WARNING, "gpucache: unknown option [%s]=[%s]", key, value);
@@ -359,10 +701,20 @@ out:
 			return false;
 		}
 		gc_options->cuda_dindex       = cuda_dindex;
+		gc_options->num_shards        = num_shards;
+		gc_options->sync_mode         = sync_mode;
 		gc_options->gpu_sync_interval = gpu_sync_interval;
 		gc_options->gpu_sync_threshold = gpu_sync_threshold;
 		gc_options->max_num_rows      = max_num_rows;
 		gc_options->redo_buffer_size  = redo_buffer_size;
+		if ((NameStr(window_column)[0] != '\0') != (window_usec > 0))
+		{
+			elog(WARNING, "gpucache: 'cache_window_column' and 'cache_window' must be configured together");
+			return false;
+		}
+		gc_options->index_column      = index_column;
+		gc_options->window_column     = window_column;
+		gc_options->window_usec       = window_usec;
 	}
 	return true;
 }
@@ -424,7 +776,8 @@ __gpuCacheTableSignature(Relation rel, GpuCacheTableSignatureCache *entry)
 		Trigger *trig = &trigdesc->triggers[j];
 
 		if (trig->tgenabled != TRIGGER_FIRES_ON_ORIGIN &&
-			trig->tgenabled != TRIGGER_FIRES_ALWAYS)
+			trig->tgenabled != TRIGGER_FIRES_ALWAYS &&
+			trig->tgenabled != TRIGGER_FIRES_ON_REPLICA)
 			continue;
 
 		if (trig->tgtype == (TRIGGER_TYPE_ROW |
@@ -434,25 +787,36 @@ __gpuCacheTableSignature(Relation rel, GpuCacheTableSignatureCache *entry)
 							 TRIGGER_TYPE_UPDATE) &&
 			trig->tgfoid == gpucache_sync_trigger_function_oid())
 		{
-			if (OidIsValid(sig->gc_options.tg_sync_row))
-				goto no_gpu_cache;		/* should not call trigger twice per row */
-			if ((trig->tgnargs == 0 &&
-				 __parseSyncTriggerOptions(NULL,
-										   &sig->gc_options)) ||
-				(trig->tgnargs == 1 &&
-				 __parseSyncTriggerOptions(trig->tgargs[0],
-										   &sig->gc_options)))
+			GpuCacheOptions	__options;
+
+			memcpy(&__options, &sig->gc_options, sizeof(GpuCacheOptions));
+			if (trig->tgnargs == 0)
+			{
+				if (!__parseSyncTriggerOptions(NULL, &__options))
+					goto no_gpu_cache;
+			}
+			else if (trig->tgnargs == 1)
 			{
-				sig->gc_options.tg_sync_row = trig->tgoid;
+				if (!__parseSyncTriggerOptions(trig->tgargs[0], &__options))
+					goto no_gpu_cache;
 			}
 			else
 			{
 				goto no_gpu_cache;
 			}
+			/* REPLICA trigger makes sense only if sync_mode=wal */
+			if (trig->tgenabled == TRIGGER_FIRES_ON_REPLICA &&
+				__options.sync_mode != GPUCACHE_SYNC_MODE__WAL)
+				continue;
+			if (OidIsValid(sig->gc_options.tg_sync_row))
+				goto no_gpu_cache;		/* should not call trigger twice per row */
+			memcpy(&sig->gc_options, &__options, sizeof(GpuCacheOptions));
+			sig->gc_options.tg_sync_row = trig->tgoid;
 		}
 #if PG_VERSION_NUM < 130000
 		else if (trig->tgtype == (TRIGGER_TYPE_TRUNCATE |
 								  TRIGGER_TYPE_BEFORE) &&
+				 trig->tgenabled != TRIGGER_FIRES_ON_REPLICA &&
 				 trig->tgfoid == gpucache_sync_trigger_function_oid())
 		{
 			if (OidIsValid(sig->gc_options.tg_sync_stmt))
@@ -467,6 +831,10 @@ __gpuCacheTableSignature(Relation rel, GpuCacheTableSignatureCache *entry)
 	if (!OidIsValid(sig->gc_options.tg_sync_stmt))
 		goto no_gpu_cache;		/* no stmt sync trigger */
 #endif
+	/* unlogged / temporary tables write no WAL records */
+	if (sig->gc_options.sync_mode == GPUCACHE_SYNC_MODE__WAL &&
+		rd_rel->relpersistence != RELPERSISTENCE_PERMANENT)
+		goto no_gpu_cache;
 
 	/* pg_attribute related */
 	for (j=0; j < natts; j++)
@@ -561,7 +929,8 @@ __gpuCacheTableSignatureSnapshot(HeapTuple pg_class_tuple,
 		Form_pg_trigger pg_trig = (Form_pg_trigger) GETSTRUCT(tuple);
 
 		if (pg_trig->tgenabled != TRIGGER_FIRES_ON_ORIGIN &&
-			pg_trig->tgenabled != TRIGGER_FIRES_ALWAYS)
+			pg_trig->tgenabled != TRIGGER_FIRES_ALWAYS &&
+			pg_trig->tgenabled != TRIGGER_FIRES_ON_REPLICA)
 			continue;
 
 		if (pg_trig->tgtype == (TRIGGER_TYPE_ROW |
@@ -571,11 +940,12 @@ __gpuCacheTableSignatureSnapshot(HeapTuple pg_class_tuple,
 								TRIGGER_TYPE_UPDATE) &&
 			pg_trig->tgfoid == gpucache_sync_trigger_function_oid())
 		{
-			if (OidIsValid(sig->gc_options.tg_sync_row))
-				goto no_gpu_cache;
+			GpuCacheOptions	__options;
+
+			memcpy(&__options, &sig->gc_options, sizeof(GpuCacheOptions));
 			if (pg_trig->tgnargs == 0)
 			{
-				if (!__parseSyncTriggerOptions(NULL, &sig->gc_options))
+				if (!__parseSyncTriggerOptions(NULL, &__options))
 					goto no_gpu_cache;
 			}
 			else if (pg_trig->tgnargs == 1)
@@ -588,18 +958,26 @@ __gpuCacheTableSignatureSnapshot(HeapTuple pg_class_tuple,
 				if (isnull)
 					goto no_gpu_cache;
 				if (!__parseSyncTriggerOptions(VARDATA_ANY(datum),
-											   &sig->gc_options))
+											   &__options))
 					goto no_gpu_cache;
 			}
 			else
 			{
 				goto no_gpu_cache;
 			}
+			/* REPLICA trigger makes sense only if sync_mode=wal */
+			if (pg_trig->tgenabled == TRIGGER_FIRES_ON_REPLICA &&
+				__options.sync_mode != GPUCACHE_SYNC_MODE__WAL)
+				continue;
+			if (OidIsValid(sig->gc_options.tg_sync_row))
+				goto no_gpu_cache;
+			memcpy(&sig->gc_options, &__options, sizeof(GpuCacheOptions));
 			sig->gc_options.tg_sync_row = PgTriggerTupleGetOid(tuple);
 		}
 #if PG_VERSION_NUM < 130000
 		else if (pg_trig->tgtype == (TRIGGER_TYPE_TRUNCATE |
 									 TRIGGER_TYPE_BEFORE) &&
+				 pg_trig->tgenabled != TRIGGER_FIRES_ON_REPLICA &&
 				 pg_trig->tgfoid == gpucache_sync_trigger_function_oid())
 		{
 			if (OidIsValid(sig->gc_options.tg_sync_stmt))
@@ -614,6 +992,9 @@ __gpuCacheTableSignatureSnapshot(HeapTuple pg_class_tuple,
 	if (!OidIsValid(sig->gc_options.tg_sync_stmt))
 		goto no_gpu_cache;
 #endif
+	if (sig->gc_options.sync_mode == GPUCACHE_SYNC_MODE__WAL &&
+		pg_class->relpersistence != RELPERSISTENCE_PERMANENT)
+		goto no_gpu_cache;
 	systable_endscan(sscan);
 	table_close(srel, AccessShareLock);
 
@@ -695,20 +1076,281 @@ gpuCacheTableSignatureInvalidation(Oid table_oid)
 				&table_oid, HASH_REMOVE, NULL);
 }
 
+/*
+ * __gpuCacheIndexColumn
+ *
+ * It returns the attribute number of the 'index_column' option, or
+ * InvalidAttrNumber if not configured or not a supported data type.
+ */
+static AttrNumber
+__gpuCacheIndexColumn(TupleDesc tupdesc, GpuCacheOptions *gc_options)
+{
+	const char *attname = NameStr(gc_options->index_column);
+	int			j;
+
+	if (*attname == '\0')
+		return InvalidAttrNumber;
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+
+		if (attr->attisdropped ||
+			strcmp(NameStr(attr->attname), attname) != 0)
+			continue;
+		switch (attr->atttypid)
+		{
+			case INT2OID:
+			case INT4OID:
+			case INT8OID:
+			case OIDOID:
+			case DATEOID:
+			case TIMESTAMPOID:
+			case TIMESTAMPTZOID:
+				return attr->attnum;
+			default:
+				return InvalidAttrNumber;
+		}
+	}
+	return InvalidAttrNumber;
+}
+
+/*
+ * __gpuCacheWindowColumn
+ *
+ * It returns the attribute number of the 'cache_window_column' option, or
+ * InvalidAttrNumber if not configured or not a supported data type.
+ */
+static AttrNumber
+__gpuCacheWindowColumn(TupleDesc tupdesc, GpuCacheOptions *gc_options)
+{
+	const char *attname = NameStr(gc_options->window_column);
+	int			j;
+
+	if (*attname == '\0')
+		return InvalidAttrNumber;
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+
+		if (attr->attisdropped ||
+			strcmp(NameStr(attr->attname), attname) != 0)
+			continue;
+		if (attr->atttypid == DATEOID ||
+			attr->atttypid == TIMESTAMPOID ||
+			attr->atttypid == TIMESTAMPTZOID)
+			return attr->attnum;
+		return InvalidAttrNumber;
+	}
+	return InvalidAttrNumber;
+}
+
+/*
+ * __gpuCacheWindowThreshold
+ *
+ * It returns the raw value of the 'cache_window_column' (DateADT or
+ * Timestamp(Tz)); rows older than the value are out of the cache window
+ * at @now. DATE and TIMESTAMP values are compared regardless of the time
+ * zone, so the window is extended by one day for safety.
+ */
+static int64
+__gpuCacheWindowThreshold(Oid typid, int64 window_usec, TimestampTz now)
+{
+	int64		threshold = now - window_usec;
+
+	if (typid == TIMESTAMPTZOID)
+		return threshold;
+	threshold -= USECS_PER_DAY;
+	if (typid == DATEOID)
+		return threshold / USECS_PER_DAY;
+	return threshold;
+}
+
+/*
+ * gpuCacheTupleInWindow
+ *
+ * It checks whether the tuple is in the cache window, thus, it should be
+ * loaded to the GPU cache. Rows with NULL are never loaded.
+ */
+static bool
+gpuCacheTupleInWindow(GpuCacheSharedState *gc_sstate,
+					  HeapTuple tuple, TupleDesc tupdesc)
+{
+	Datum		datum;
+	bool		isnull;
+	int64		threshold;
+
+	if (gc_sstate->window_colidx < 0)
+		return true;
+	datum = heap_getattr(tuple, gc_sstate->window_colidx + 1,
+						 tupdesc, &isnull);
+	if (isnull)
+		return false;
+	threshold = __gpuCacheWindowThreshold(gc_sstate->window_typid,
+										  gc_sstate->window_usec,
+										  GetCurrentTimestamp());
+	if (gc_sstate->window_typid == DATEOID)
+		return (DatumGetDateADT(datum) >= threshold);
+	return (DatumGetInt64(datum) >= threshold);
+}
+
+/*
+ * __gpuCacheWindowBoundWalker
+ */
+static bool
+__gpuCacheWindowBoundWalker(Node *node, void *context)
+{
+	if (!node)
+		return false;
+	if (IsA(node, Var) || IsA(node, SubPlan) || IsA(node, SubLink))
+		return true;
+	if (IsA(node, Param))
+		return (((Param *)node)->paramkind != PARAM_EXTERN);
+	return expression_tree_walker(node, __gpuCacheWindowBoundWalker, context);
+}
+
+/*
+ * __gpuCacheWindowBoundExpr
+ *
+ * It looks up a qualifier in the form of (window_column >[=] BOUND) from
+ * @quals, then returns the BOUND expression, or NULL if not found.
+ * BOUND must be evaluable at the executor startup; it contains neither
+ * Vars, volatile functions nor PARAM_EXEC parameters.
+ */
+static Expr *
+__gpuCacheWindowBoundExpr(List *quals, AttrNumber attnum)
+{
+	ListCell   *lc;
+
+	foreach (lc, quals)
+	{
+		Expr	   *clause = lfirst(lc);
+		OpExpr	   *op;
+		Var		   *var;
+		Expr	   *arg;
+		Oid			opcode;
+		CatCList   *catlist;
+		int			i;
+		bool		found = false;
+
+		if (IsA(clause, RestrictInfo))
+			clause = ((RestrictInfo *)clause)->clause;
+		if (!IsA(clause, OpExpr))
+			continue;
+		op = (OpExpr *)clause;
+		if (list_length(op->args) != 2)
+			continue;
+		var = linitial(op->args);
+		arg = lsecond(op->args);
+		opcode = op->opno;
+		if (!IsA(var, Var))
+		{
+			/* BOUND <OPER> VAR form */
+			var = lsecond(op->args);
+			arg = linitial(op->args);
+			opcode = get_commutator(op->opno);
+		}
+		if (!IsA(var, Var) ||
+			var->varlevelsup != 0 ||
+			var->varattno != attnum ||
+			!OidIsValid(opcode))
+			continue;
+		if (__gpuCacheWindowBoundWalker((Node *)arg, NULL) ||
+			contain_volatile_functions((Node *)arg))
+			continue;
+		if (exprType((Node *)arg) != DATEOID &&
+			exprType((Node *)arg) != TIMESTAMPOID &&
+			exprType((Node *)arg) != TIMESTAMPTZOID)
+			continue;
+
+		catlist = SearchSysCacheList1(AMOPOPID, ObjectIdGetDatum(opcode));
+		for (i=0; i < catlist->n_members; i++)
+		{
+			HeapTuple	tuple = &catlist->members[i]->tuple;
+			Form_pg_amop amop = (Form_pg_amop) GETSTRUCT(tuple);
+
+			if (amop->amopmethod == BTREE_AM_OID &&
+				amop->amoplefttype == var->vartype &&
+				amop->amoprighttype == exprType((Node *)arg) &&
+				(amop->amopstrategy == BTGreaterStrategyNumber ||
+				 amop->amopstrategy == BTGreaterEqualStrategyNumber))
+			{
+				found = true;
+				break;
+			}
+		}
+		ReleaseSysCacheList(catlist);
+		if (found)
+			return arg;
+	}
+	return NULL;
+}
+
+/*
+ * gpuCacheWindowBoundIsValid
+ *
+ * It evaluates the BOUND expression of @quals on the executor startup, then
+ * checks whether all the rows that satisfy the qualifier are in the cache
+ * window. A TIMESTAMP or DATE bound is compared with the TIMESTAMPTZ column
+ * after the time zone conversion, so the window is shrunk by one day for
+ * safety.
+ */
+static bool
+gpuCacheWindowBoundIsValid(GpuCacheSharedState *gc_sstate,
+						   ScanState *ss, List *quals)
+{
+	ExprContext *econtext = ss->ps.ps_ExprContext;
+	ExprState  *estate;
+	Expr	   *bound;
+	Oid			bound_type;
+	Datum		datum;
+	bool		isnull;
+	int64		value;
+	int64		threshold;
+
+	if (gc_sstate->window_colidx < 0)
+		return true;
+	bound = __gpuCacheWindowBoundExpr(quals, gc_sstate->window_colidx + 1);
+	if (!bound || !econtext)
+		return false;
+	estate = ExecInitExpr(bound, &ss->ps);
+	datum = ExecEvalExprSwitchContext(estate, econtext, &isnull);
+	if (isnull)
+		return false;
+	bound_type = exprType((Node *)bound);
+	if (bound_type == DATEOID)
+	{
+		DateADT		dval = DatumGetDateADT(datum);
+
+		if (DATE_NOT_FINITE(dval))
+			return !DATE_IS_NOBEGIN(dval);
+		value = (int64)dval * USECS_PER_DAY;
+	}
+	else
+	{
+		value = DatumGetInt64(datum);
+		if (TIMESTAMP_NOT_FINITE(value))
+			return !TIMESTAMP_IS_NOBEGIN(value);
+	}
+	threshold = GetCurrentTimestamp() - gc_sstate->window_usec;
+	if (gc_sstate->window_typid == TIMESTAMPTZOID &&
+		bound_type != TIMESTAMPTZOID)
+		threshold += USECS_PER_DAY;
+	return (value >= threshold);
+}
+
 /*
  * baseRelHasGpuCache
  */
-bool
-baseRelHasGpuCache(PlannerInfo *root, RelOptInfo *baserel)
+static GpuCacheTableSignatureCache *
+__baseRelGpuCacheSignature(PlannerInfo *root, RelOptInfo *baserel)
 {
 	RangeTblEntry *rte = root->simple_rte_array[baserel->relid];
-	bool		retval = false;
+	GpuCacheTableSignatureCache *entry = NULL;
 
 	if (rte->rtekind == RTE_RELATION &&
 		(baserel->reloptkind == RELOPT_BASEREL ||
 		 baserel->reloptkind == RELOPT_OTHER_MEMBER_REL))
 	{
-		GpuCacheTableSignatureCache *entry;
 		Relation	rel;
 		bool		found;
 
@@ -731,25 +1373,91 @@ baseRelHasGpuCache(PlannerInfo *root, RelOptInfo *baserel)
 			PG_END_TRY();
 		}
 		Assert(entry->table_oid == rte->relid);
+	}
+	return entry;
+}
 
-		retval = (entry->signature != 0UL);
+bool
+baseRelHasGpuCache(PlannerInfo *root, RelOptInfo *baserel)
+{
+	GpuCacheTableSignatureCache *entry;
+
+	if (!enable_gpucache)
+		return false;
+	entry = __baseRelGpuCacheSignature(root, baserel);
+	if (!entry || entry->signature == 0UL)
+		return false;
+	/* partial GPU cache is valid only if the scan is in its window */
+	if (NameStr(entry->gc_options.window_column)[0] != '\0')
+	{
+		RangeTblEntry *rte = root->simple_rte_array[baserel->relid];
+		Relation	rel = table_open(rte->relid, NoLock);
+		AttrNumber	attnum;
+
+		attnum = __gpuCacheWindowColumn(RelationGetDescr(rel),
+										&entry->gc_options);
+		table_close(rel, NoLock);
+		if (attnum != InvalidAttrNumber &&
+			!__gpuCacheWindowBoundExpr(baserel->baserestrictinfo, attnum))
+			return false;
 	}
-	return (enable_gpucache ? retval : false);
+	return true;
 }
 
 /*
- * RelationHasGpuCache
+ * baseRelGpuCacheIndexAttnum
+ *
+ * It returns the attribute number of the column that has hash index
+ * on the GPU cache, if any.
  */
-bool
-RelationHasGpuCache(Relation rel)
+AttrNumber
+baseRelGpuCacheIndexAttnum(PlannerInfo *root, RelOptInfo *baserel)
 {
-	if (enable_gpucache)
-		return (gpuCacheTableSignature(rel,NULL) != 0UL);
-	return false;
+	GpuCacheTableSignatureCache *entry;
+	AttrNumber	attnum = InvalidAttrNumber;
+
+	if (!enable_gpucache)
+		return InvalidAttrNumber;
+	entry = __baseRelGpuCacheSignature(root, baserel);
+	if (entry != NULL && entry->signature != 0UL &&
+		NameStr(entry->gc_options.index_column)[0] != '\0')
+	{
+		RangeTblEntry *rte = root->simple_rte_array[baserel->relid];
+		Relation	rel = table_open(rte->relid, NoLock);
+
+		attnum = __gpuCacheIndexColumn(RelationGetDescr(rel),
+									   &entry->gc_options);
+		table_close(rel, NoLock);
+	}
+	return attnum;
 }
 
 /*
- * __hashSlotGpuCacheSharedState
+ * gpuCacheIndexAttnum
+ */
+AttrNumber
+gpuCacheIndexAttnum(pgstrom_data_store *pds)
+{
+	GpuCacheSharedState *gc_sstate = pds->gc_sstate;
+
+	if (!gc_sstate || gc_sstate->index_colidx < 0)
+		return InvalidAttrNumber;
+	return gc_sstate->index_colidx + 1;
+}
+
+/*
+ * RelationHasGpuCache
+ */
+bool
+RelationHasGpuCache(Relation rel)
+{
+	if (enable_gpucache)
+		return (gpuCacheTableSignature(rel,NULL) != 0UL);
+	return false;
+}
+
+/*
+ * __hashSlotGpuCacheSharedState
  */
 static inline dlist_head *
 __hashSlotGpuCacheSharedState(Oid database_oid,
@@ -781,7 +1489,8 @@ __hashSlotGpuCacheSharedState(Oid database_oid,
 static GpuCacheSharedState *
 lookupGpuCacheSharedState(Oid database_oid,
 						  Oid table_oid,
-						  Datum signature)
+						  Datum signature,
+						  int shard_id)
 {
 	GpuCacheSharedState *gc_sstate;
 	dlist_head	   *slot;
@@ -796,7 +1505,8 @@ lookupGpuCacheSharedState(Oid database_oid,
 									chain, iter.cur);
 		if (gc_sstate->database_oid == database_oid &&
 			gc_sstate->table_oid    == table_oid &&
-			gc_sstate->signature    == signature)
+			gc_sstate->signature    == signature &&
+			gc_sstate->shard_id     == shard_id)
 		{
 			return gc_sstate;
 		}
@@ -804,18 +1514,143 @@ lookupGpuCacheSharedState(Oid database_oid,
 	return NULL;
 }
 
+/*
+ * gpuCacheNumShards / gpuCacheShard
+ *
+ * Sibling shards are referenced only via shard-0, so any other shards
+ * behave like a GPU cache without sharding.
+ */
+static inline int
+gpuCacheNumShards(GpuCacheSharedState *gc_sstate)
+{
+	return (gc_sstate->shard_id == 0 ? gc_sstate->num_shards : 1);
+}
+
+static inline GpuCacheSharedState *
+gpuCacheShard(GpuCacheSharedState *gc_sstate, int k)
+{
+	Assert(k >= 0 && k < gpuCacheNumShards(gc_sstate));
+	return (k == 0 ? gc_sstate : gc_sstate->shards[k]);
+}
+
+/*
+ * gpuCacheShardByCtid
+ */
+static inline GpuCacheSharedState *
+gpuCacheShardByCtid(GpuCacheSharedState *gc_sstate, ItemPointer ctid)
+{
+	BlockNumber	blkno;
+	int			nshards = gpuCacheNumShards(gc_sstate);
+
+	if (nshards <= 1)
+		return gc_sstate;
+	blkno = ItemPointerGetBlockNumberNoCheck(ctid);
+	return gpuCacheShard(gc_sstate, (blkno / GPUCACHE_SHARD_NBLOCKS) % nshards);
+}
+
+/*
+ * gpuCacheIsCorrupted
+ */
+static bool
+gpuCacheIsCorrupted(GpuCacheSharedState *gc_sstate)
+{
+	int		k, nshards = gpuCacheNumShards(gc_sstate);
+
+	for (k=0; k < nshards; k++)
+	{
+		GpuCacheSharedState *gc_shard = gpuCacheShard(gc_sstate, k);
+
+		if (pg_atomic_read_u32(&gc_shard->gpu_buffer_corrupted) != 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * __gpuCacheClearRedoBuffer
+ *
+ * It clears the range of REDO log buffer, because zero @type means the log
+ * is not published yet for the reader.
+ */
+static void
+__gpuCacheClearRedoBuffer(GpuCacheSharedState *gc_sstate,
+						  uint64 head_pos, uint64 tail_pos)
+{
+	size_t		buffer_sz = gc_sstate->redo_buffer_size;
+	size_t		offset = head_pos % buffer_sz;
+	size_t		length = tail_pos - head_pos;
+
+	Assert(head_pos <= tail_pos);
+	if (length >= buffer_sz)
+		memset(gc_sstate->redo_buffer, 0, buffer_sz);
+	else if (offset + length <= buffer_sz)
+		memset(gc_sstate->redo_buffer + offset, 0, length);
+	else
+	{
+		memset(gc_sstate->redo_buffer + offset, 0, buffer_sz - offset);
+		memset(gc_sstate->redo_buffer, 0, length - (buffer_sz - offset));
+	}
+}
+
+/*
+ * __gpuCacheAdvanceRedoSyncPos
+ *
+ * It moves @redo_sync_pos forward to @sync_pos, if behind. It returns true
+ * if the caller actually moved it forward.
+ */
+static inline bool
+__gpuCacheAdvanceRedoSyncPos(GpuCacheSharedState *gc_sstate, uint64 sync_pos)
+{
+	uint64		curr_pos = pg_atomic_read_u64(&gc_sstate->redo_sync_pos);
+
+	while (curr_pos < sync_pos)
+	{
+		if (pg_atomic_compare_exchange_u64(&gc_sstate->redo_sync_pos,
+										   &curr_pos, sync_pos))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * gpuCacheAdvanceSyncPos
+ *
+ * It moves @redo_sync_pos forward to the current @redo_write_pos, then
+ * returns the @redo_write_pos to be applied. @p_advanced tells whether
+ * @redo_sync_pos was behind, if not NULL.
+ */
+static uint64
+gpuCacheAdvanceSyncPos(GpuCacheSharedState *gc_sstate, bool *p_advanced)
+{
+	uint64		write_pos = pg_atomic_read_u64(&gc_sstate->redo_write_pos);
+	bool		advanced;
+
+	advanced = __gpuCacheAdvanceRedoSyncPos(gc_sstate, write_pos);
+	if (p_advanced)
+		*p_advanced = advanced;
+	return write_pos;
+}
+
 /*
  * putGpuCacheSharedState
  */
 static void
 putGpuCacheSharedStateNoLock(GpuCacheSharedState *gc_sstate, bool drop_shared_state)
 {
+	int		k, nshards = gpuCacheNumShards(gc_sstate);
+
 	if (drop_shared_state)
-		gc_sstate->refcnt &= 0xfffffffeU;
+	{
+		for (k=0; k < nshards; k++)
+			gpuCacheShard(gc_sstate, k)->refcnt &= 0xfffffffeU;
+	}
 	Assert(gc_sstate->refcnt >= 2);
 	gc_sstate->refcnt -= 2;
 	if (gc_sstate->refcnt == 0)
 	{
+		/* shard-0 holds a reference to the sibling shards */
+		for (k=1; k < nshards; k++)
+			putGpuCacheSharedStateNoLock(gc_sstate->shards[k], false);
 		dlist_delete(&gc_sstate->chain);
 		if (gc_sstate->gpu_main_devptr != 0UL ||
 			gc_sstate->gpu_extra_devptr != 0UL)
@@ -844,6 +1679,7 @@ putGpuCacheSharedState(GpuCacheSharedState *gc_sstate, bool drop_shared_state)
  */
 static bool
 __gpuCacheInitLoadVisibilityCheck(HeapTuple tuple,
+								  bool wal_sync,
 								  TransactionId *gcache_xmin,
 								  TransactionId *gcache_xmax)
 {
@@ -915,8 +1751,17 @@ __gpuCacheInitLoadVisibilityCheck(HeapTuple tuple,
 			 * of the current initial-loading process, then it adds REDO log
 			 * entry of the new tuple.
 			 * So, initial-loading can ignore the tuples not responsible.
+			 *
+			 * On the other hands, WAL-sync worker may already consume the
+			 * INSERT record prior to the initial-loading (thus, the log
+			 * was rewound), but XACT log is written after the completion.
+			 * So, we load the tuple as uncommitted one of the inserter.
 			 */
-			return false;
+			if (!wal_sync)
+				return false;
+			*gcache_xmin = xmin;
+			*gcache_xmax = InvalidTransactionId;
+			return true;
 		}
 		else if (!TransactionIdDidCommit(xmin))
 		{
@@ -1122,21 +1967,30 @@ __makeFlattenHeapTuple(Relation rel, HeapTuple tuple)
 }
 
 /*
- * __execGpuCacheInitLoad
+ * __gpuCacheInitLoadSetup
+ *
+ * It renews the version of GPU cache contents, rewinds the REDO log buffer,
+ * and returns GpuCacheDesc of the current transaction to write INSERT logs.
  */
-static void
-__execGpuCacheInitLoad(GpuCacheSharedState *gc_sstate, Relation rel)
+static GpuCacheDesc *
+__gpuCacheInitLoadSetup(GpuCacheSharedState *gc_sstate)
 {
 	GpuCacheDesc	hkey;
 	GpuCacheDesc   *gc_desc;
-	TableScanDesc	scandesc;
-	HeapTuple		scantup;
-	size_t			item_sz = 2048;
-	GCacheTxLogInsert *item = palloc(item_sz);
 	bool			found = false;
+	int				k, nshards = gpuCacheNumShards(gc_sstate);
 
-	//elog(LOG, "run __execGpuCacheInitLoad on %s", RelationGetRelationName(rel));
 	Assert(gc_sstate->database_oid == MyDatabaseId);
+	/* contents are rebuilt, so the version shall be renewed */
+	for (k=0; k < nshards; k++)
+	{
+		GpuCacheSharedState *gc_shard = gpuCacheShard(gc_sstate, k);
+
+		SpinLockAcquire(&gc_shard->redo_lock);
+		gc_shard->redo_generation =
+			pg_atomic_add_fetch_u64(&gcache_shared_head->gcache_generation, 1);
+		SpinLockRelease(&gc_shard->redo_lock);
+	}
 	/* lookup GpuCacheDesc for initial-loading */
 	memset(&hkey, 0, sizeof(GpuCacheDesc));
 	hkey.database_oid = gc_sstate->database_oid;
@@ -1175,52 +2029,106 @@ __execGpuCacheInitLoad(GpuCacheSharedState *gc_sstate, Relation rel)
 	}
 
 	/* rewind the position of REDO log buffer */
-	SpinLockAcquire(&gc_sstate->redo_lock);
-	gc_sstate->redo_write_timestamp = 0;
-	gc_sstate->redo_write_nitems    = 0;
-	gc_sstate->redo_write_pos       = 0;
-	gc_sstate->redo_read_nitems     = 0;
-	gc_sstate->redo_read_pos        = 0;
-	gc_sstate->redo_sync_pos        = 0;
-	SpinLockRelease(&gc_sstate->redo_lock);
-
-	scandesc = table_beginscan(rel, SnapshotAny, 0, NULL);
-	while ((scantup = heap_getnext(scandesc, ForwardScanDirection)) != NULL)
+	for (k=0; k < nshards; k++)
 	{
-		TransactionId	gcache_xmin;
-		TransactionId	gcache_xmax;
-		HeapTuple		tuple;
-		size_t			sz;
+		GpuCacheSharedState *gc_shard = gpuCacheShard(gc_sstate, k);
+
+		SpinLockAcquire(&gc_shard->redo_lock);
+		__gpuCacheClearRedoBuffer(gc_shard,
+								  pg_atomic_read_u64(&gc_shard->redo_read_pos),
+								  pg_atomic_read_u64(&gc_shard->redo_write_pos));
+		pg_atomic_write_u64(&gc_shard->redo_write_timestamp, 0);
+		pg_atomic_write_u64(&gc_shard->redo_write_nitems, 0);
+		pg_atomic_write_u64(&gc_shard->redo_write_pos, 0);
+		gc_shard->redo_read_nitems = 0;
+		pg_atomic_write_u64(&gc_shard->redo_read_pos, 0);
+		pg_atomic_write_u64(&gc_shard->redo_sync_pos, 0);
+		SpinLockRelease(&gc_shard->redo_lock);
+	}
+	return gc_desc;
+}
 
-		if (!__gpuCacheInitLoadVisibilityCheck(scantup,
-											   &gcache_xmin,
-											   &gcache_xmax))
-			continue;
+/*
+ * __gpuCacheInitLoadTuple
+ *
+ * It writes an INSERT log of the tuple fetched by SnapshotAny, if visible.
+ * It returns false if REDO log buffer is no longer available.
+ */
+static bool
+__gpuCacheInitLoadTuple(GpuCacheDesc *gc_desc, Relation rel,
+						HeapTuple scantup,
+						GCacheTxLogInsert **p_item, size_t *p_item_sz)
+{
+	GCacheTxLogInsert *item = *p_item;
+	TransactionId	gcache_xmin;
+	TransactionId	gcache_xmax;
+	HeapTuple		tuple;
+	size_t			sz;
 
-		tuple = __makeFlattenHeapTuple(rel, scantup);
-		sz = MAXALIGN(offsetof(GCacheTxLogInsert, htup) + tuple->t_len);
-		if (sz > item_sz)
-		{
-			item_sz = 2 * sz;
-			item = repalloc(item, item_sz);
-		}
-		item->type = GCACHE_TX_LOG__INSERT;
-		item->length = sz;
-		item->rowid = UINT_MAX;
-		item->rowid_found = false;
-		memcpy(&item->htup, tuple->t_data, tuple->t_len);
-		HeapTupleHeaderSetXmin(&item->htup, gcache_xmin);
-		HeapTupleHeaderSetXmax(&item->htup, gcache_xmax);
-		HeapTupleHeaderSetCmin(&item->htup, InvalidCommandId);
-		if (!__gpuCacheAppendLog(gc_desc, (GCacheTxLogCommon *)item))
-			break;
+	if (!__gpuCacheInitLoadVisibilityCheck(scantup,
+										   (gc_desc->gc_sstate->sync_mode ==
+											GPUCACHE_SYNC_MODE__WAL),
+										   &gcache_xmin,
+										   &gcache_xmax))
+		return true;
 
-		if (TransactionIdIsNormal(gcache_xmin))
-			__gpuCacheInitLoadTrackCtid(gc_desc, gcache_xmin, 'I', &tuple->t_self);
-		if (TransactionIdIsNormal(gcache_xmax))
-			__gpuCacheInitLoadTrackCtid(gc_desc, gcache_xmax, 'D', &tuple->t_self);
+	tuple = __makeFlattenHeapTuple(rel, scantup);
+	if (!gpuCacheTupleInWindow(gc_desc->gc_sstate, tuple,
+							   RelationGetDescr(rel)))
+	{
 		if (tuple != scantup)
 			pfree(tuple);
+		return true;
+	}
+	sz = MAXALIGN(offsetof(GCacheTxLogInsert, htup) + tuple->t_len);
+	if (sz > *p_item_sz)
+	{
+		*p_item_sz = 2 * sz;
+		*p_item = item = repalloc(item, *p_item_sz);
+	}
+	item->type = GCACHE_TX_LOG__INSERT;
+	item->length = sz;
+	item->rowid = UINT_MAX;
+	item->rowid_found = false;
+	memcpy(&item->htup, tuple->t_data, tuple->t_len);
+	item->htup.t_ctid = scantup->t_self;
+	HeapTupleHeaderSetXmin(&item->htup, gcache_xmin);
+	HeapTupleHeaderSetXmax(&item->htup, gcache_xmax);
+	HeapTupleHeaderSetCmin(&item->htup, InvalidCommandId);
+	if (!__gpuCacheAppendLog(gc_desc, (GCacheTxLogCommon *)item))
+		return false;
+
+	/* XACT log of the concurrent inserter shall be written by WAL-sync */
+	if (TransactionIdIsNormal(gcache_xmin) &&
+		TransactionIdIsCurrentTransactionId(gcache_xmin))
+		__gpuCacheInitLoadTrackCtid(gc_desc, gcache_xmin, 'I', &tuple->t_self);
+	if (TransactionIdIsNormal(gcache_xmax))
+		__gpuCacheInitLoadTrackCtid(gc_desc, gcache_xmax, 'D', &tuple->t_self);
+	if (tuple != scantup)
+		pfree(tuple);
+	return true;
+}
+
+/*
+ * __execGpuCacheInitLoad
+ */
+static void
+__execGpuCacheInitLoad(GpuCacheSharedState *gc_sstate, Relation rel)
+{
+	GpuCacheDesc   *gc_desc;
+	TableScanDesc	scandesc;
+	HeapTuple		scantup;
+	size_t			item_sz = 2048;
+	GCacheTxLogInsert *item = palloc(item_sz);
+
+	//elog(LOG, "run __execGpuCacheInitLoad on %s", RelationGetRelationName(rel));
+	gc_desc = __gpuCacheInitLoadSetup(gc_sstate);
+
+	scandesc = table_beginscan(rel, SnapshotAny, 0, NULL);
+	while ((scantup = heap_getnext(scandesc, ForwardScanDirection)) != NULL)
+	{
+		if (!__gpuCacheInitLoadTuple(gc_desc, rel, scantup, &item, &item_sz))
+			break;
 		CHECK_FOR_INTERRUPTS();
 	}
 	table_endscan(scandesc);
@@ -1229,120 +2137,570 @@ __execGpuCacheInitLoad(GpuCacheSharedState *gc_sstate, Relation rel)
 }
 
 /*
- * __createGpuCacheSharedState
+ * gpuCacheCheckpointFileName
  */
-static GpuCacheSharedState *
-__createGpuCacheSharedState(Relation rel,
-							Datum signature,
-							GpuCacheOptions *gc_options)
+static bool
+gpuCacheCheckpointFileName(char *fname, size_t len,
+						   GpuCacheSharedState *gc_sstate)
 {
-	GpuCacheSharedState *gc_sstate;
-	TupleDesc		tupdesc = RelationGetDescr(rel);
-	kern_data_store *kds_head;
-	kern_colmeta   *cmeta;
-	uint32			nrooms;
-	size_t			sz, off;
-	size_t			extra_sz = 0;
-	int				j, unitsz;
-
-	/* allocation of GpuCacheSharedState */
-	off = (KDS_calculateHeadSize(tupdesc) +
-		   STROMALIGN(sizeof(kern_colmeta)));
-	sz = offsetof(GpuCacheSharedState, kds_head) + off;
-	gc_sstate = MemoryContextAlloc(TopSharedMemoryContext,
-								   MAXALIGN(sz) + gc_options->redo_buffer_size);
-	memset(gc_sstate, 0, sz);
-	gc_sstate->database_oid = MyDatabaseId;
-	gc_sstate->table_oid = RelationGetRelid(rel);
-	gc_sstate->signature = signature;
-	strncpy(gc_sstate->table_name, RelationGetRelationName(rel), NAMEDATALEN);
-	gc_sstate->refcnt = 3;
-	gc_sstate->initial_loading = -1;	/* not yet */
+	if (!gpucache_checkpoint_dir || gpucache_checkpoint_dir[0] == '\0')
+		return false;
+	snprintf(fname, len, "%s/gpucache_%u_%u_%lx.ckpt",
+			 gpucache_checkpoint_dir,
+			 gc_sstate->database_oid,
+			 gc_sstate->table_oid,
+			 (unsigned long)gc_sstate->signature);
+	return true;
+}
 
-	Assert(gc_options->max_num_rows < UINT_MAX);
-	gc_sstate->max_num_rows       = gc_options->max_num_rows;
-	gc_sstate->cuda_dindex        = gc_options->cuda_dindex;
-	gc_sstate->redo_buffer_size   = gc_options->redo_buffer_size;
-	gc_sstate->gpu_sync_threshold = gc_options->gpu_sync_threshold;
-	gc_sstate->gpu_sync_interval  = gc_options->gpu_sync_interval;
+/*
+ * gpuCacheMainBufferSize
+ */
+static inline uint32
+gpuCacheColIndexNSlots(uint32 nrooms)
+{
+	return Max(nrooms / 2, 4096);
+}
 
-	pthreadRWLockInit(&gc_sstate->gpu_buffer_lock);
-	pg_atomic_init_u32(&gc_sstate->gpu_buffer_corrupted, 0);
-	SpinLockInit(&gc_sstate->redo_lock);
-	gc_sstate->redo_buffer = (char *)gc_sstate + MAXALIGN(sz);
+static inline size_t
+__gpuCacheMainBufferSize(kern_data_store *kds_head, bool with_colindex)
+{
+	cl_uint		nrooms = kds_head->nrooms;
+	cl_uint		nslots = kds_head->nslots;
+	size_t		len;
 
-	/* init schema definition in KDS_FORMAT_COLUMN */
-	kds_head = &gc_sstate->kds_head;
-	nrooms = gc_options->max_num_rows;
-	init_kernel_data_store(kds_head,
-						   tupdesc,
-						   0,	/* to be set later */
-						   KDS_FORMAT_COLUMN,
-						   nrooms);
-	kds_head->nslots = Max(Min(1.5 * (double)nrooms, UINT_MAX), 40000);
-	kds_head->table_oid = RelationGetRelid(rel);
-	Assert(kds_head->nr_colmeta > tupdesc->natts);
-	for (j=0; j < tupdesc->natts; j++)
+	len = (PAGE_ALIGN(kds_head->length) +
+		   PAGE_ALIGN(offsetof(kern_gpucache_rowhash, slots[nslots])) +
+		   PAGE_ALIGN(sizeof(uint32) * nrooms));
+	if (with_colindex)
 	{
-		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
-
-		cmeta = &kds_head->colmeta[j];
-		if (!attr->attnotnull)
-		{
-			sz = MAXALIGN(BITMAPLEN(nrooms));
-			cmeta->nullmap_offset = __kds_packed(off);
-			cmeta->nullmap_length = __kds_packed(sz);
-			off += sz;
-		}
+		cl_uint		nslots_i = gpuCacheColIndexNSlots(nrooms);
 
-		if (attr->attlen > 0)
-		{
-			unitsz = att_align_nominal(attr->attlen,
-									   attr->attalign);
-			sz = MAXALIGN(unitsz * nrooms);
-			cmeta->values_offset = __kds_packed(off);
-			cmeta->values_length = __kds_packed(sz);
-			off += sz;
-		}
-		else if (attr->attlen == -1)
-		{
-			sz = MAXALIGN(sizeof(uint32) * nrooms);
-			cmeta->values_offset = __kds_packed(off);
-			cmeta->values_length = __kds_packed(sz);
-			off += sz;
-			unitsz = get_typavgwidth(attr->atttypid,
-									 attr->atttypmod);
-			extra_sz += MAXALIGN(unitsz) * nrooms;
-		}
-		else
-		{
-			pfree(gc_sstate);
-			elog(ERROR, "unexpected type length (%d) at %s.%s",
-				 attr->attlen,
-				 RelationGetRelationName(rel),
-				 NameStr(attr->attname));
-		}
+		len += PAGE_ALIGN(MAXIMUM_ALIGNOF +
+						  offsetof(kern_gpucache_colindex, slots[nslots_i]) +
+						  sizeof(uint32) * nrooms);
 	}
-	/* system column */
-	cmeta = &kds_head->colmeta[kds_head->nr_colmeta - 1];
-	sz = MAXALIGN(cmeta->attlen * nrooms);
-	cmeta->values_offset = __kds_packed(off);
-	cmeta->values_length = __kds_packed(sz);
-	off += sz;
+	return len;
+}
 
-	kds_head->length = off;
+static inline size_t
+gpuCacheMainBufferSize(GpuCacheSharedState *gc_sstate)
+{
+	return __gpuCacheMainBufferSize(&gc_sstate->kds_head,
+									gc_sstate->index_colidx >= 0);
+}
 
-	if (extra_sz > 0)
+/*
+ * gpuCacheCheckpointValidateHeader
+ */
+static bool
+gpuCacheCheckpointValidateHeader(GpuCacheSharedState *gc_sstate,
+								 GpuCacheCheckpointHeader *head)
+{
+	if (head->magic        != GPUCACHE_CHECKPOINT_MAGIC ||
+		head->version      != GPUCACHE_CHECKPOINT_VERSION ||
+		head->database_oid != gc_sstate->database_oid ||
+		head->table_oid    != gc_sstate->table_oid ||
+		head->signature    != gc_sstate->signature ||
+		head->main_offset  != PAGE_SIZE ||
+		head->main_size    != gpuCacheMainBufferSize(gc_sstate))
+		return false;
+	if (gc_sstate->kds_extra_sz == 0)
 	{
-		/* 25% margin */
-		extra_sz += extra_sz / 4;
-		extra_sz += offsetof(kern_data_extra, data);
+		if (head->extra_size != 0)
+			return false;
+	}
+	else if (head->extra_offset != head->main_offset + head->main_size ||
+			 head->extra_size == 0 ||
+			 head->extra_size != PAGE_ALIGN(head->extra_size) ||
+			 head->extra_size > PAGE_ALIGN(head->extra_length))
+		return false;
+
+	return true;
+}
+
+/*
+ * __gpuCacheRestoreTupleIsUnstable
+ *
+ * It checks whether the tuple was modified by the transactions in-progress
+ * at the checkpoint; its state in GPU cache may be different from the heap.
+ */
+static bool
+__gpuCacheRestoreTupleIsUnstable(HeapTupleHeader htup, TransactionId oldest_xid)
+{
+	TransactionId	xid;
+
+	if (!HeapTupleHeaderXminFrozen(htup))
+	{
+		xid = HeapTupleHeaderGetRawXmin(htup);
+		if (TransactionIdIsNormal(xid) &&
+			TransactionIdFollowsOrEquals(xid, oldest_xid))
+			return true;
+	}
+	if ((htup->t_infomask & HEAP_XMAX_INVALID) == 0)
+	{
+		if (htup->t_infomask & HEAP_XMAX_IS_MULTI)
+			return true;
+		xid = HeapTupleHeaderGetRawXmax(htup);
+		if (TransactionIdIsNormal(xid) &&
+			TransactionIdFollowsOrEquals(xid, oldest_xid))
+			return true;
+	}
+	return false;
+}
+
+#define RESTORE_BLOCK_IS_DIRTY(map,blkno)		\
+	(((map)[(blkno) / BITS_PER_BYTE] & (1 << ((blkno) % BITS_PER_BYTE))) != 0)
+#define RESTORE_BLOCK_SET_DIRTY(map,blkno)		\
+	((map)[(blkno) / BITS_PER_BYTE] |= (1 << ((blkno) % BITS_PER_BYTE)))
+
+/*
+ * __execGpuCacheRestore
+ *
+ * It tries to restore GPU cache from the checkpoint file, instead of the
+ * initial-loading. REDO log buffer lives only on the shared memory, so the
+ * changes after the checkpoint are detected by the LSN of heap pages.
+ * Blocks modified after the checkpoint, or having tuples that were touched
+ * by the transactions in-progress at the checkpoint, are re-synchronized by
+ * DELETE logs for the restored rows and INSERT logs for the visible tuples.
+ * It returns false if no valid checkpoint is available, then the caller
+ * shall run the initial-loading.
+ */
+static bool
+__execGpuCacheRestore(GpuCacheSharedState *gc_sstate, Relation rel)
+{
+	GpuCacheCheckpointHeader head;
+	kern_data_store *kds_head = &gc_sstate->kds_head;
+	kern_data_store *kds_ckpt = NULL;
+	kern_colmeta   *cmeta;
+	GpuCacheSysattr *sysattr_array = NULL;
+	GpuCacheDesc   *gc_desc;
+	BufferAccessStrategy strategy;
+	TableScanDesc	scandesc;
+	HeapTuple		scantup;
+	GCacheTxLogInsert *item;
+	size_t			item_sz = 2048;
+	bits8		   *dirty_map;
+	char			fname[MAXPGPATH];
+	size_t			head_sz;
+	size_t			sz;
+	BlockNumber		nblocks;
+	BlockNumber		blkno;
+	BlockNumber		ndirty = 0;
+	uint32			nitems = 0;
+	uint32			rowid;
+	uint64			sync_pos;
+	int				fdesc;
+	CUresult		rc;
+	bool			retval = false;
+
+	if (!gc_sstate->checkpoint_enabled ||
+		!gpuCacheCheckpointFileName(fname, sizeof(fname), gc_sstate))
+		return false;
+	fdesc = OpenTransientFile(fname, O_RDONLY | PG_BINARY);
+	if (fdesc < 0)
+	{
+		if (errno != ENOENT)
+			elog(LOG, "gpucache: failed on open('%s'): %m", fname);
+		return false;
+	}
+	/* check compatibility of the checkpoint */
+	head_sz = KERN_DATA_STORE_HEAD_LENGTH(kds_head);
+	kds_ckpt = palloc(head_sz);
+	if (__preadFile(fdesc, &head, sizeof(head), 0) != sizeof(head) ||
+		!gpuCacheCheckpointValidateHeader(gc_sstate, &head) ||
+		__preadFile(fdesc, kds_ckpt, head_sz, head.main_offset) != head_sz ||
+		kds_ckpt->length     != kds_head->length ||
+		kds_ckpt->nrooms     != kds_head->nrooms ||
+		kds_ckpt->nslots     != kds_head->nslots ||
+		kds_ckpt->ncols      != kds_head->ncols ||
+		kds_ckpt->nr_colmeta != kds_head->nr_colmeta ||
+		kds_ckpt->nitems      > kds_head->nrooms ||
+		memcmp(kds_ckpt->colmeta, kds_head->colmeta,
+			   sizeof(kern_colmeta) * kds_head->nr_colmeta) != 0)
+	{
+		elog(LOG, "gpucache: checkpoint file '%s' is not compatible to '%s', so ignored",
+			 fname, RelationGetRelationName(rel));
+		goto out;
+	}
+	if (head.checkpoint_lsn > GetXLogInsertRecPtr())
+	{
+		elog(LOG, "gpucache: checkpoint file '%s' is newer than WAL (%X/%X), so ignored",
+			 fname,
+			 (uint32)(head.checkpoint_lsn >> 32),
+			 (uint32)(head.checkpoint_lsn));
+		goto out;
+	}
+	/* system attributes of the rows in the checkpoint */
+	nitems = kds_ckpt->nitems;
+	cmeta = &kds_ckpt->colmeta[kds_ckpt->nr_colmeta - 1];
+	sz = sizeof(GpuCacheSysattr) * nitems;
+	sysattr_array = MemoryContextAllocHuge(CurrentMemoryContext, sz + 1);
+	if (__preadFile(fdesc, sysattr_array, sz,
+					head.main_offset +
+					__kds_unpack(cmeta->values_offset)) != sz)
+	{
+		elog(LOG, "gpucache: failed on read('%s'): %m", fname);
+		goto out;
+	}
+	CloseTransientFile(fdesc);
+	fdesc = -1;
+
+	/* load the checkpoint image onto the GPU device memory */
+	rc = gpuCacheInvokeRestore(gc_sstate);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: unable to restore '%s' from '%s': %s",
+			 RelationGetRelationName(rel), fname, errorText(rc));
+		goto out;
+	}
+
+	/*
+	 * By here, GPU device memory has the contents of the checkpoint.
+	 * Any errors shall revert GPU cache to the unloaded state.
+	 */
+	gc_desc = __gpuCacheInitLoadSetup(gc_sstate);
+	nblocks = RelationGetNumberOfBlocks(rel);
+	sz = (nblocks + BITS_PER_BYTE - 1) / BITS_PER_BYTE + 1;
+	dirty_map = MemoryContextAllocHuge(CurrentMemoryContext, sz);
+	memset(dirty_map, 0, sz);
+
+	/* blocks that have rows not frozen in the checkpoint */
+	for (rowid=0; rowid < nitems; rowid++)
+	{
+		GpuCacheSysattr *sysattr = &sysattr_array[rowid];
+
+		if (sysattr->xmin == InvalidTransactionId)
+			continue;	/* unused rowid */
+		blkno = ItemPointerGetBlockNumberNoCheck(&sysattr->ctid);
+		if (blkno < nblocks &&
+			(sysattr->xmin != FrozenTransactionId ||
+			 sysattr->xmax != InvalidTransactionId))
+			RESTORE_BLOCK_SET_DIRTY(dirty_map, blkno);
+	}
+
+	/* blocks that were modified after, or unstable at, the checkpoint */
+	strategy = GetAccessStrategy(BAS_BULKREAD);
+	for (blkno=0; blkno < nblocks; blkno++)
+	{
+		Buffer		buffer;
+		Page		page;
+		OffsetNumber lineoff;
+		OffsetNumber maxoff;
+
+		if (RESTORE_BLOCK_IS_DIRTY(dirty_map, blkno))
+			continue;
+		buffer = ReadBufferExtended(rel, MAIN_FORKNUM, blkno,
+									RBM_NORMAL, strategy);
+		LockBuffer(buffer, BUFFER_LOCK_SHARE);
+		page = BufferGetPage(buffer);
+		if (PageIsNew(page) || PageGetLSN(page) > head.checkpoint_lsn)
+			RESTORE_BLOCK_SET_DIRTY(dirty_map, blkno);
+		else
+		{
+			maxoff = PageGetMaxOffsetNumber(page);
+			for (lineoff = FirstOffsetNumber;
+				 lineoff <= maxoff;
+				 lineoff = OffsetNumberNext(lineoff))
+			{
+				ItemId		lpp = PageGetItemId(page, lineoff);
+
+				if (ItemIdIsNormal(lpp) &&
+					__gpuCacheRestoreTupleIsUnstable((HeapTupleHeader)
+													 PageGetItem(page, lpp),
+													 head.oldest_xid))
+				{
+					RESTORE_BLOCK_SET_DIRTY(dirty_map, blkno);
+					break;
+				}
+			}
+		}
+		UnlockReleaseBuffer(buffer);
+		CHECK_FOR_INTERRUPTS();
+	}
+	FreeAccessStrategy(strategy);
+
+	/* release the rows on the dirty (or truncated) blocks */
+	for (rowid=0; rowid < nitems; rowid++)
+	{
+		GpuCacheSysattr *sysattr = &sysattr_array[rowid];
+		GCacheTxLogDelete d_log;
+		GCacheTxLogXact	x_log;
+
+		if (sysattr->xmin == InvalidTransactionId)
+			continue;	/* unused rowid */
+		blkno = ItemPointerGetBlockNumberNoCheck(&sysattr->ctid);
+		if (blkno < nblocks && !RESTORE_BLOCK_IS_DIRTY(dirty_map, blkno))
+			continue;
+		d_log.type = GCACHE_TX_LOG__DELETE;
+		d_log.length = MAXALIGN(sizeof(GCacheTxLogDelete));
+		d_log.xid = GetCurrentTransactionId();
+		d_log.rowid = UINT_MAX;
+		d_log.rowid_found = false;
+		memcpy(&d_log.ctid, &sysattr->ctid, sizeof(ItemPointerData));
+		if (!__gpuCacheAppendLog(gc_desc, (GCacheTxLogCommon *)&d_log))
+			elog(ERROR, "gpucache: unable to write REDO log on '%s'",
+				 RelationGetRelationName(rel));
+
+		memset(&x_log, 0, sizeof(GCacheTxLogXact));
+		x_log.type = GCACHE_TX_LOG__XACT;
+		x_log.length = MAXALIGN(sizeof(GCacheTxLogXact));
+		x_log.rowid = UINT_MAX;
+		x_log.rowid_found = false;
+		x_log.tag = 'D';
+		memcpy(&x_log.ctid, &sysattr->ctid, sizeof(ItemPointerData));
+		if (!__gpuCacheAppendLog(gc_desc, (GCacheTxLogCommon *)&x_log))
+			elog(ERROR, "gpucache: unable to write REDO log on '%s'",
+				 RelationGetRelationName(rel));
+		CHECK_FOR_INTERRUPTS();
+	}
+	/* rows must be released prior to the INSERT logs on the same ctid */
+	sync_pos = gpuCacheAdvanceSyncPos(gc_sstate, NULL);
+	rc = gpuCacheInvokeApplyRedo(gc_sstate, sync_pos, false);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "gpucache: failed on apply REDO logs on '%s': %s",
+			 RelationGetRelationName(rel), errorText(rc));
+
+	/* reload the dirty blocks, like the initial-loading */
+	item = palloc(item_sz);
+	scandesc = table_beginscan_strat(rel, SnapshotAny, 0, NULL, true, false);
+	blkno = 0;
+	while (blkno < nblocks)
+	{
+		BlockNumber	start;
+
+		if (!RESTORE_BLOCK_IS_DIRTY(dirty_map, blkno))
+		{
+			blkno++;
+			continue;
+		}
+		for (start = blkno++;
+			 blkno < nblocks && RESTORE_BLOCK_IS_DIRTY(dirty_map, blkno);
+			 blkno++);
+		ndirty += (blkno - start);
+
+		table_rescan(scandesc, NULL);
+		heap_setscanlimits(scandesc, start, blkno - start);
+		while ((scantup = heap_getnext(scandesc, ForwardScanDirection)) != NULL)
+		{
+			if (!__gpuCacheInitLoadTuple(gc_desc, rel, scantup,
+										 &item, &item_sz))
+				elog(ERROR, "gpucache: unable to write REDO log on '%s'",
+					 RelationGetRelationName(rel));
+			CHECK_FOR_INTERRUPTS();
+		}
+	}
+	table_endscan(scandesc);
+	pfree(item);
+	pfree(dirty_map);
+
+	SpinLockAcquire(&gc_sstate->redo_lock);
+	gc_sstate->checkpoint_timestamp = GetCurrentTimestamp();
+	SpinLockRelease(&gc_sstate->redo_lock);
+
+	elog(LOG, "gpucache: restored '%s' from '%s' (nitems=%u, %u of %u blocks re-synchronized)",
+		 RelationGetRelationName(rel), fname, nitems, ndirty, nblocks);
+	retval = true;
+out:
+	if (fdesc >= 0)
+		CloseTransientFile(fdesc);
+	if (sysattr_array)
+		pfree(sysattr_array);
+	if (kds_ckpt)
+		pfree(kds_ckpt);
+	return retval;
+}
+
+/*
+ * __createGpuCacheSharedState
+ */
+static GpuCacheSharedState *
+__createGpuCacheSharedState(Relation rel,
+							Datum signature,
+							GpuCacheOptions *gc_options,
+							int shard_id)
+{
+	GpuCacheSharedState *gc_sstate;
+	TupleDesc		tupdesc = RelationGetDescr(rel);
+	kern_data_store *kds_head;
+	kern_colmeta   *cmeta;
+	uint32			nrooms;
+	size_t			sz, off;
+	size_t			extra_sz = 0;
+	int				j, unitsz;
+
+	/* allocation of GpuCacheSharedState */
+	off = (KDS_calculateHeadSize(tupdesc) +
+		   STROMALIGN(sizeof(kern_colmeta)));
+	sz = offsetof(GpuCacheSharedState, kds_head) + off;
+	gc_sstate = MemoryContextAlloc(TopSharedMemoryContext,
+								   MAXALIGN(sz) + gc_options->redo_buffer_size);
+	memset(gc_sstate, 0, sz);
+	gc_sstate->database_oid = MyDatabaseId;
+	gc_sstate->table_oid = RelationGetRelid(rel);
+	gc_sstate->signature = signature;
+	strncpy(gc_sstate->table_name, RelationGetRelationName(rel), NAMEDATALEN);
+	gc_sstate->refcnt = 3;
+	gc_sstate->initial_loading = -1;	/* not yet */
+
+	Assert(gc_options->max_num_rows < UINT_MAX);
+	gc_sstate->max_num_rows       = gc_options->max_num_rows;
+	/* shard-k is assigned to the k-th GPU next to the configured one */
+	gc_sstate->cuda_dindex        = ((gc_options->cuda_dindex + shard_id) %
+									 numDevAttrs);
+	gc_sstate->shard_id           = shard_id;
+	gc_sstate->num_shards         = gc_options->num_shards;
+	gc_sstate->sync_mode          = gc_options->sync_mode;
+	gc_sstate->index_colidx       = __gpuCacheIndexColumn(tupdesc, gc_options) - 1;
+	if (gc_sstate->index_colidx < 0 &&
+		NameStr(gc_options->index_column)[0] != '\0')
+		elog(WARNING, "gpucache: index_column '%s' of '%s' is not found or not a supported data type, so ignored",
+			 NameStr(gc_options->index_column),
+			 RelationGetRelationName(rel));
+	gc_sstate->window_colidx      = __gpuCacheWindowColumn(tupdesc, gc_options) - 1;
+	if (gc_sstate->window_colidx >= 0)
+	{
+		gc_sstate->window_typid   =
+			tupleDescAttr(tupdesc, gc_sstate->window_colidx)->atttypid;
+		gc_sstate->window_usec    = gc_options->window_usec;
+	}
+	else if (NameStr(gc_options->window_column)[0] != '\0')
+		elog(WARNING, "gpucache: cache_window_column '%s' of '%s' is not found or not a supported data type, so ignored",
+			 NameStr(gc_options->window_column),
+			 RelationGetRelationName(rel));
+	/* REDO log never split, so tail of the buffer must be MAXALIGN'ed */
+	gc_sstate->redo_buffer_size   = MAXALIGN_DOWN(gc_options->redo_buffer_size);
+	gc_sstate->gpu_sync_threshold = gc_options->gpu_sync_threshold;
+	gc_sstate->gpu_sync_interval  = gc_options->gpu_sync_interval;
+
+	pthreadRWLockInit(&gc_sstate->gpu_buffer_lock);
+	pg_atomic_init_u32(&gc_sstate->gpu_buffer_corrupted, 0);
+	gc_sstate->gpu_curr_version = 0;
+	for (j=0; j < GPUCACHE_MAX_BUFFER_VERSIONS; j++)
+	{
+		gc_sstate->gpu_versions[j].in_use = (j == 0);
+		pg_atomic_init_u32(&gc_sstate->gpu_versions[j].nreaders, 0);
+	}
+	gpuCacheInitStatistics(&gc_sstate->stats);
+	SpinLockInit(&gc_sstate->redo_lock);
+	pg_atomic_init_u64(&gc_sstate->redo_write_timestamp, 0);
+	pg_atomic_init_u64(&gc_sstate->redo_write_nitems, 0);
+	pg_atomic_init_u64(&gc_sstate->redo_write_pos, 0);
+	pg_atomic_init_u64(&gc_sstate->redo_read_pos, 0);
+	pg_atomic_init_u64(&gc_sstate->redo_sync_pos, 0);
+	gc_sstate->redo_generation =
+		pg_atomic_add_fetch_u64(&gcache_shared_head->gcache_generation, 1);
+	gc_sstate->redo_buffer = (char *)gc_sstate + MAXALIGN(sz);
+	/*
+	 * unlogged or temporary tables cannot validate the checkpoint by WAL,
+	 * and sharded GPU cache is not supported right now.
+	 */
+	gc_sstate->checkpoint_enabled =
+		(rel->rd_rel->relpersistence == RELPERSISTENCE_PERMANENT &&
+		 gc_options->num_shards == 1);
+	gc_sstate->checkpoint_timestamp = GetCurrentTimestamp();
+
+	/* init schema definition in KDS_FORMAT_COLUMN */
+	kds_head = &gc_sstate->kds_head;
+	nrooms = gc_options->max_num_rows;
+	init_kernel_data_store(kds_head,
+						   tupdesc,
+						   0,	/* to be set later */
+						   KDS_FORMAT_COLUMN,
+						   nrooms);
+	kds_head->nslots = Max(Min(1.5 * (double)nrooms, UINT_MAX), 40000);
+	kds_head->table_oid = RelationGetRelid(rel);
+	Assert(kds_head->nr_colmeta > tupdesc->natts);
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+
+		cmeta = &kds_head->colmeta[j];
+		if (!attr->attnotnull)
+		{
+			sz = MAXALIGN(BITMAPLEN(nrooms));
+			cmeta->nullmap_offset = __kds_packed(off);
+			cmeta->nullmap_length = __kds_packed(sz);
+			off += sz;
+		}
+
+		if (attr->attlen > 0)
+		{
+			unitsz = att_align_nominal(attr->attlen,
+									   attr->attalign);
+			sz = MAXALIGN(unitsz * nrooms);
+			cmeta->values_offset = __kds_packed(off);
+			cmeta->values_length = __kds_packed(sz);
+			off += sz;
+		}
+		else if (attr->attlen == -1)
+		{
+			sz = MAXALIGN(sizeof(uint32) * nrooms);
+			cmeta->values_offset = __kds_packed(off);
+			cmeta->values_length = __kds_packed(sz);
+			off += sz;
+			unitsz = get_typavgwidth(attr->atttypid,
+									 attr->atttypmod);
+			extra_sz += MAXALIGN(unitsz) * nrooms;
+		}
+		else
+		{
+			pfree(gc_sstate);
+			elog(ERROR, "unexpected type length (%d) at %s.%s",
+				 attr->attlen,
+				 RelationGetRelationName(rel),
+				 NameStr(attr->attname));
+		}
+	}
+	/* system column */
+	cmeta = &kds_head->colmeta[kds_head->nr_colmeta - 1];
+	sz = MAXALIGN(cmeta->attlen * nrooms);
+	cmeta->values_offset = __kds_packed(off);
+	cmeta->values_length = __kds_packed(sz);
+	off += sz;
+
+	kds_head->length = off;
+
+	if (extra_sz > 0)
+	{
+		/* 25% margin */
+		extra_sz += extra_sz / 4;
+		extra_sz += offsetof(kern_data_extra, data);
 	}
 	gc_sstate->kds_extra_sz = extra_sz;
 
 	return gc_sstate;
 }
 
+/*
+ * __gpuCacheInitialLoadingState / __gpuCacheSetInitialLoadingState
+ *
+ * Shards of a GPU cache are loaded at once, but BgWorker may reset the
+ * state of a particular shard when its GPU buffer got corrupted.
+ * Note that caller must hold gcache_sstate_lock.
+ */
+static int
+__gpuCacheInitialLoadingState(GpuCacheSharedState *gc_sstate)
+{
+	int		k, nshards = gpuCacheNumShards(gc_sstate);
+
+	for (k=1; k < nshards; k++)
+	{
+		if (gc_sstate->shards[k]->initial_loading < 0)
+			return -1;
+	}
+	return gc_sstate->initial_loading;
+}
+
+static void
+__gpuCacheSetInitialLoadingState(GpuCacheSharedState *gc_sstate, int state)
+{
+	int		k, nshards = gpuCacheNumShards(gc_sstate);
+
+	for (k=0; k < nshards; k++)
+		gpuCacheShard(gc_sstate, k)->initial_loading = state;
+}
+
 /*
  * __lookupGpuCacheSharedState
  */
@@ -1353,12 +2711,19 @@ __lookupGpuCacheSharedState(GpuCacheDesc *hkey,
 							bool try_recovery)
 {
 	GpuCacheSharedState *gc_sstate = NULL;
+	GpuCacheSharedState *shards[GPUCACHE_MAX_SHARDS];
 	Datum			hvalue;
 	int				hindex;
+	int				k, nshards;
 	dlist_head	   *slot;
 	dlist_iter		iter;
 	slock_t		   *lock;
 
+	/* WAL-sync worker must be ready prior to the initial-loading */
+	if (rel && gc_options->sync_mode == GPUCACHE_SYNC_MODE__WAL &&
+		!gpuCacheWalSyncLaunch(hkey->database_oid))
+		return NULL;
+
 	/* hash-lookup */
 	hvalue = hash_any((unsigned char *)hkey,
 					  offsetof(GpuCacheDesc, signature) + sizeof(Datum));
@@ -1373,7 +2738,8 @@ retry:
 
 		if (gc_sstate->database_oid == hkey->database_oid &&
 			gc_sstate->table_oid    == hkey->table_oid &&
-			gc_sstate->signature    == hkey->signature)
+			gc_sstate->signature    == hkey->signature &&
+			gc_sstate->shard_id     == 0)
 		{
 			if ((gc_sstate->refcnt & 1) == 0)
 			{
@@ -1395,7 +2761,7 @@ retry:
 				CHECK_FOR_INTERRUPTS();
 				goto retry;
 			}
-			if (rel && gc_sstate->initial_loading < 0)
+			if (rel && __gpuCacheInitialLoadingState(gc_sstate) < 0)
 			{
 				/*
 				 * negative 'initial_loading' means someone has never
@@ -1406,8 +2772,7 @@ retry:
 				 * kernel), or 'try_recovery' is set even if GPU buffer
 				 * is corrupted.
 				 */
-				if (pg_atomic_read_u32(&gc_sstate->gpu_buffer_corrupted) == 0 ||
-					try_recovery)
+				if (!gpuCacheIsCorrupted(gc_sstate) || try_recovery)
 				{
 					gc_sstate->refcnt += 2;
 					goto found_uninitialized;
@@ -1431,30 +2796,49 @@ retry:
 		return NULL;
 	}
 
-	/* Allocation of a new GpuCacheSharedState. */
+	/* Allocation of a new GpuCacheSharedState (for each shard) */
+	Assert(gc_options != NULL);
+	nshards = gc_options->num_shards;
+	memset(shards, 0, sizeof(shards));
 	PG_TRY();
 	{
-		Assert(gc_options != NULL);
-		gc_sstate = __createGpuCacheSharedState(rel,
-												hkey->signature,
-												gc_options);
+		for (k=0; k < nshards; k++)
+			shards[k] = __createGpuCacheSharedState(rel,
+													hkey->signature,
+													gc_options, k);
 	}
 	PG_CATCH();
 	{
 		SpinLockRelease(lock);
+		for (k=0; k < nshards; k++)
+		{
+			if (shards[k])
+				pfree(shards[k]);
+		}
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
 	/* move to the initial loading phase */
-	dlist_push_tail(slot, &gc_sstate->chain);
+	gc_sstate = shards[0];
+	for (k=0; k < nshards; k++)
+	{
+		gc_sstate->shards[k] = shards[k];
+		dlist_push_tail(slot, &shards[k]->chain);
+	}
 found_uninitialized:
-	gc_sstate->initial_loading = 1;
+	__gpuCacheSetInitialLoadingState(gc_sstate, 1);
 	SpinLockRelease(lock);
 
 	/* reset the corruption state */
-	pthreadRWLockWriteLock(&gc_sstate->gpu_buffer_lock);
-	pg_atomic_write_u32(&gc_sstate->gpu_buffer_corrupted, 0);
-	pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+	for (k=0; k < gpuCacheNumShards(gc_sstate); k++)
+	{
+		GpuCacheSharedState *gc_shard = gpuCacheShard(gc_sstate, k);
+
+		pthreadRWLockWriteLock(&gc_shard->gpu_buffer_lock);
+		pg_atomic_write_u32(&gc_shard->gpu_buffer_corrupted, 0);
+		pthreadRWLockUnlock(&gc_shard->gpu_buffer_lock);
+		pg_atomic_fetch_add_u64(&gc_shard->stats.reload_count, 1);
+	}
 
 	/*
 	 * Note that BgWorker may grab the GpuCacheSharedState that is
@@ -1463,21 +2847,22 @@ found_uninitialized:
 	 */
 	PG_TRY();
 	{
-		__execGpuCacheInitLoad(gc_sstate, rel);
+		if (!__execGpuCacheRestore(gc_sstate, rel))
+			__execGpuCacheInitLoad(gc_sstate, rel);
 	}
 	PG_CATCH();
 	{
 		/* revert the status to empty & unloaded */
 		gpuCacheInvokeDropUnload(gc_sstate, true);
 		SpinLockAcquire(lock);
-		gc_sstate->initial_loading = -1;	/* not yet loaded */
+		__gpuCacheSetInitialLoadingState(gc_sstate, -1);	/* not yet loaded */
 		SpinLockRelease(lock);
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
 	/* ok, all done */
 	SpinLockAcquire(lock);
-	gc_sstate->initial_loading = 0;		/* ready now */
+	__gpuCacheSetInitialLoadingState(gc_sstate, 0);		/* ready now */
 	SpinLockRelease(lock);
 
 	return gc_sstate;
@@ -1610,6 +2995,26 @@ releaseGpuCacheDesc(GpuCacheDesc *gc_desc, bool is_normal_commit)
 	hash_search(gcache_descriptors_htab, gc_desc, HASH_REMOVE, NULL);
 }
 
+/*
+ * __gpuCachePublishLog
+ *
+ * It writes a log item on the reserved space of REDO log buffer. @type is
+ * written at last, then the reader can consume the log item.
+ */
+static inline void
+__gpuCachePublishLog(char *dest, cl_uint type, cl_uint length,
+					 const char *data)
+{
+	GCacheTxLogCommon *tx_log = (GCacheTxLogCommon *)dest;
+
+	Assert(length >= offsetof(GCacheTxLogCommon, data));
+	tx_log->length = length;
+	if (data)
+		memcpy(tx_log->data, data, length - offsetof(GCacheTxLogCommon, data));
+	pg_write_barrier();
+	*((volatile cl_uint *)&tx_log->type) = type;
+}
+
 /*
  * __gpuCacheAppendLog
  */
@@ -1617,13 +3022,39 @@ static bool
 __gpuCacheAppendLog(GpuCacheDesc *gc_desc, GCacheTxLogCommon *tx_log)
 {
 	GpuCacheSharedState *gc_sstate = gc_desc->gc_sstate;
-	char	   *redo_buffer = gc_sstate->redo_buffer;
-	size_t		buffer_sz = gc_sstate->redo_buffer_size;
+	char	   *redo_buffer;
+	size_t		buffer_sz;
+	size_t		padding_sz;
 	uint64		offset;
+	uint64		write_pos;
+	uint64		read_pos;
 	uint64		sync_pos;
 	bool		append_done = false;
 
 	Assert(tx_log->length == MAXALIGN(tx_log->length));
+	/* REDO log shall be written to the shard that owns the ctid */
+	if (gpuCacheNumShards(gc_sstate) > 1)
+	{
+		ItemPointer	ctid;
+
+		switch (tx_log->type)
+		{
+			case GCACHE_TX_LOG__INSERT:
+				ctid = &((GCacheTxLogInsert *)tx_log)->htup.t_ctid;
+				break;
+			case GCACHE_TX_LOG__DELETE:
+				ctid = &((GCacheTxLogDelete *)tx_log)->ctid;
+				break;
+			case GCACHE_TX_LOG__XACT:
+				ctid = &((GCacheTxLogXact *)tx_log)->ctid;
+				break;
+			default:
+				elog(ERROR, "gpucache: unknown REDO log type (%08x)", tx_log->type);
+		}
+		gc_sstate = gpuCacheShardByCtid(gc_sstate, ctid);
+	}
+	redo_buffer = gc_sstate->redo_buffer;
+	buffer_sz = gc_sstate->redo_buffer_size;
 	for (;;)
 	{
 		/*
@@ -1633,51 +3064,64 @@ __gpuCacheAppendLog(GpuCacheDesc *gc_desc, GCacheTxLogCommon *tx_log)
 		if (pg_atomic_read_u32(&gc_sstate->gpu_buffer_corrupted))
 			return false;
 
-		SpinLockAcquire(&gc_sstate->redo_lock);
-		Assert(gc_sstate->redo_write_pos >= gc_sstate->redo_read_pos &&
-			   gc_sstate->redo_write_pos <= gc_sstate->redo_read_pos + buffer_sz &&
-			   gc_sstate->redo_sync_pos >= gc_sstate->redo_read_pos &&
-			   gc_sstate->redo_sync_pos <= gc_sstate->redo_write_pos);
-		offset = gc_sstate->redo_write_pos % buffer_sz;
-		/* rewind to the head */
-		if (offset + tx_log->length > buffer_sz)
+		/*
+		 * Reservation of the buffer space. If the log item is not fit to
+		 * the tail of the buffer, we also reserve the remaining area for
+		 * a padding log, then rewind to the head.
+		 */
+		write_pos = pg_atomic_read_u64(&gc_sstate->redo_write_pos);
+		for (;;)
 		{
-			size_t	sz = buffer_sz - offset;
-
+			read_pos = pg_atomic_read_u64(&gc_sstate->redo_read_pos);
+			Assert(write_pos >= read_pos &&
+				   write_pos <= read_pos + buffer_sz);
+			offset = write_pos % buffer_sz;
+			if (offset + tx_log->length > buffer_sz)
+				padding_sz = buffer_sz - offset;
+			else
+				padding_sz = 0;
 			/* oops, it looks overwrites... */
-			if (gc_sstate->redo_write_pos + sz > gc_sstate->redo_read_pos + buffer_sz)
-				goto skip;
-			/* fill-up by zero */
-			memset(redo_buffer + offset, 0, sz);
-			gc_sstate->redo_write_pos += sz;
-			offset = 0;
-		}
-		/* check overwrites */
-		if ((gc_sstate->redo_write_pos +
-			 tx_log->length) > gc_sstate->redo_read_pos + buffer_sz)
-			goto skip;
-
-		/* Ok, append the log item */
-		memcpy(redo_buffer + offset, tx_log, tx_log->length);
-		gc_sstate->redo_write_pos += tx_log->length;
-		gc_sstate->redo_write_nitems++;
-		gc_sstate->redo_write_timestamp = GetCurrentTimestamp();
-		append_done = true;
-	skip:
-		/* 25% of REDO buffer is in-use. Async kick of GPU kernel */
-		if (gc_sstate->redo_write_pos > (gc_sstate->redo_sync_pos +
-										 gc_sstate->gpu_sync_threshold))
-		{
-			sync_pos = gc_sstate->redo_sync_pos = gc_sstate->redo_write_pos;
-			SpinLockRelease(&gc_sstate->redo_lock);
-			gpuCacheInvokeApplyRedo(gc_sstate, sync_pos, true);
+			if (write_pos + padding_sz + tx_log->length > read_pos + buffer_sz)
+				break;
+			if (pg_atomic_compare_exchange_u64(&gc_sstate->redo_write_pos,
+											   &write_pos,
+											   write_pos + padding_sz +
+											   tx_log->length))
+			{
+				append_done = true;
+				break;
+			}
 		}
-		else
+
+		if (append_done)
 		{
-			SpinLockRelease(&gc_sstate->redo_lock);
+			/* Ok, write and publish the log item */
+			if (padding_sz > 0)
+			{
+				__gpuCachePublishLog(redo_buffer + offset,
+									 GCACHE_TX_LOG__PADDING,
+									 padding_sz, NULL);
+				offset = 0;
+			}
+			__gpuCachePublishLog(redo_buffer + offset,
+								 tx_log->type,
+								 tx_log->length,
+								 tx_log->data);
+			write_pos += padding_sz + tx_log->length;
+			pg_atomic_fetch_add_u64(&gc_sstate->redo_write_nitems, 1);
+			pg_atomic_write_u64(&gc_sstate->redo_write_timestamp,
+								GetCurrentTimestamp());
+		}
+		/* 25% of REDO buffer is in-use. Async kick of GPU kernel */
+		sync_pos = pg_atomic_read_u64(&gc_sstate->redo_sync_pos);
+		if (write_pos > sync_pos + gc_sstate->gpu_sync_threshold &&
+			__gpuCacheAdvanceRedoSyncPos(gc_sstate, write_pos))
+		{
+			gpuCacheInvokeApplyRedo(gc_sstate, write_pos, true);
 		}
 		if (append_done)
 			break;
+		pg_atomic_fetch_add_u64(&gc_sstate->stats.redo_wait_count, 1);
 		pg_usleep(1000L);	/* 1ms wait */
 	}
 	return true;
@@ -1709,7 +3153,8 @@ __gpuCacheInsertLog(HeapTuple tuple, GpuCacheDesc *gc_desc)
 	item->rowid = UINT_MAX;		/* to be set by kernel */
 	item->rowid_found = false;	/* to be set by kernel */
 	memcpy(&item->htup, tuple->t_data, tuple->t_len);
-	HeapTupleHeaderSetXmin(&item->htup, GetCurrentTransactionId());
+	item->htup.t_ctid = tuple->t_self;
+	HeapTupleHeaderSetXmin(&item->htup, gc_desc->xid);
 	HeapTupleHeaderSetXmax(&item->htup, InvalidTransactionId);
 	HeapTupleHeaderSetCmin(&item->htup, InvalidCommandId);
 
@@ -1736,7 +3181,7 @@ __gpuCacheDeleteLog(HeapTuple tuple, GpuCacheDesc *gc_desc)
 	/* DELETE Log */
 	item.type = GCACHE_TX_LOG__DELETE;
 	item.length = MAXALIGN(sizeof(GCacheTxLogDelete));
-	item.xid = GetCurrentTransactionId();
+	item.xid = gc_desc->xid;
 	item.rowid = UINT_MAX;		/* to be set by kernel */
 	item.rowid_found = false;	/* to be set by kernel */
 	memcpy(&item.ctid, &tuple->t_self, sizeof(ItemPointerData));
@@ -1788,12 +3233,19 @@ pgstrom_gpucache_sync_trigger(PG_FUNCTION_ARGS)
 
 	if (TRIGGER_FIRED_FOR_ROW(trigdata->tg_event))
 	{
+		TupleDesc		tupdesc = RelationGetDescr(trigdata->tg_relation);
 		GpuCacheDesc   *gc_desc;
+		GpuCacheOptions	gc_options;
 
 		if (!TRIGGER_FIRED_AFTER(trigdata->tg_event))
 			elog(ERROR, "%s: must be declared as AFTER ROW trigger",
 				 trigdata->tg_trigger->tgname);
 
+		/* WAL-sync worker shall replay the changes */
+		if (gpuCacheTableSignature(trigdata->tg_relation, &gc_options) != 0UL &&
+			gc_options.sync_mode == GPUCACHE_SYNC_MODE__WAL)
+			PG_RETURN_POINTER(trigdata->tg_trigtuple);
+
 		gc_desc = lookupGpuCacheDesc(trigdata->tg_relation);
 		if (!gc_desc)
 			elog(ERROR, "gpucache is not configured for %s",
@@ -1805,7 +3257,8 @@ pgstrom_gpucache_sync_trigger(PG_FUNCTION_ARGS)
 		{
 			tuple = __makeFlattenHeapTuple(trigdata->tg_relation,
 										   trigdata->tg_trigtuple);
-			__gpuCacheInsertLog(tuple, gc_desc);
+			if (gpuCacheTupleInWindow(gc_desc->gc_sstate, tuple, tupdesc))
+				__gpuCacheInsertLog(tuple, gc_desc);
 			if (tuple != trigdata->tg_trigtuple)
 				pfree(tuple);
 		}
@@ -1814,7 +3267,8 @@ pgstrom_gpucache_sync_trigger(PG_FUNCTION_ARGS)
 			tuple = __makeFlattenHeapTuple(trigdata->tg_relation,
 										   trigdata->tg_newtuple);
 			__gpuCacheDeleteLog(trigdata->tg_trigtuple, gc_desc);
-			__gpuCacheInsertLog(tuple, gc_desc);
+			if (gpuCacheTupleInWindow(gc_desc->gc_sstate, tuple, tupdesc))
+				__gpuCacheInsertLog(tuple, gc_desc);
 			if (tuple != trigdata->tg_newtuple)
 				pfree(tuple);
 		}
@@ -1874,12 +3328,17 @@ pgstrom_gpucache_apply_redo(PG_FUNCTION_ARGS)
 	{
 		GpuCacheSharedState *gc_sstate = gc_desc->gc_sstate;
 		uint64		sync_pos;
+		int			k, nshards = gpuCacheNumShards(gc_sstate);
 
-		SpinLockAcquire(&gc_sstate->redo_lock);
-		sync_pos = gc_sstate->redo_sync_pos = gc_sstate->redo_write_pos;
-		SpinLockRelease(&gc_sstate->redo_lock);
+		for (k=0; k < nshards; k++)
+		{
+			GpuCacheSharedState *gc_shard = gpuCacheShard(gc_sstate, k);
 
-		rc = gpuCacheInvokeApplyRedo(gc_sstate, sync_pos, false);
+			sync_pos = gpuCacheAdvanceSyncPos(gc_shard, NULL);
+			rc = gpuCacheInvokeApplyRedo(gc_shard, sync_pos, false);
+			if (rc != CUDA_SUCCESS)
+				break;
+		}
 	}
 	table_close(rel, RowExclusiveLock);
 
@@ -1901,7 +3360,15 @@ pgstrom_gpucache_compaction(PG_FUNCTION_ARGS)
 	gc_desc = lookupGpuCacheDesc(rel);
 	if (gc_desc)
 	{
-		rc = gpuCacheInvokeCompaction(gc_desc->gc_sstate, false);
+		GpuCacheSharedState *gc_sstate = gc_desc->gc_sstate;
+		int			k, nshards = gpuCacheNumShards(gc_sstate);
+
+		for (k=0; k < nshards; k++)
+		{
+			rc = gpuCacheInvokeCompaction(gpuCacheShard(gc_sstate, k), false);
+			if (rc != CUDA_SUCCESS)
+				break;
+		}
 	}
 	table_close(rel, AccessShareLock);
 
@@ -1941,6 +3408,83 @@ pgstrom_gpucache_recovery(PG_FUNCTION_ARGS)
 	PG_RETURN_INT32(retval);
 }
 
+/*
+ * pgstrom_gpucache_export_ipchandle
+ *
+ * It returns GpuCacheIpcHandle of the GPU cache on the supplied table, after
+ * the pending REDO logs are applied. External applications can reference
+ * the GPU cache without data copy, however, neither MVCC visibility nor
+ * access control are applied, so only superuser can run this function.
+ */
+Datum
+pgstrom_gpucache_export_ipchandle(PG_FUNCTION_ARGS)
+{
+	Oid			table_oid = PG_GETARG_OID(0);
+	Relation	rel;
+	GpuCacheDesc *gc_desc;
+	GpuCacheSharedState *gc_sstate;
+	GpuCacheIpcHandle *handle;
+	uint64		sync_pos;
+	CUresult	rc;
+
+	StaticAssertStmt(sizeof(CUipcMemHandle) == GPUCACHE_IPC_HANDLE_SIZE,
+					 "unexpected length of CUipcMemHandle");
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("only superuser can export IPC handle of GPU cache")));
+
+	rel = table_open(table_oid, RowExclusiveLock);
+	gc_desc = lookupGpuCacheDesc(rel);
+	if (!gc_desc)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("table \"%s\" has no GPU cache",
+						RelationGetRelationName(rel))));
+	gc_sstate = gc_desc->gc_sstate;
+	if (gpuCacheNumShards(gc_sstate) > 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("GPU cache of \"%s\" is sharded across %d GPUs, so unable to export IPC handle",
+						RelationGetRelationName(rel),
+						gpuCacheNumShards(gc_sstate))));
+	if (pg_atomic_read_u32(&gc_sstate->gpu_buffer_corrupted) != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("GPU cache of \"%s\" is corrupted",
+						RelationGetRelationName(rel)),
+				 errhint("try pgstrom.gpucache_recovery(regclass) after the fixup of table contents or configuration")));
+
+	/* apply pending REDO logs, to export the latest state */
+	sync_pos = gpuCacheAdvanceSyncPos(gc_sstate, NULL);
+
+	rc = gpuCacheInvokeApplyRedo(gc_sstate, sync_pos, false);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuCacheInvokeApplyRedo: %s", errorText(rc));
+
+	handle = palloc0(sizeof(GpuCacheIpcHandle));
+	SET_VARSIZE(handle, sizeof(GpuCacheIpcHandle));
+	handle->magic = GPUCACHE_IPC_HANDLE_MAGIC;
+	handle->device_id = devAttrs[gc_sstate->cuda_dindex].DEV_ID;
+	handle->table_oid = gc_sstate->table_oid;
+	pthreadRWLockReadLock(&gc_sstate->gpu_buffer_lock);
+	if (gc_sstate->gpu_main_devptr == 0UL)
+	{
+		pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+		elog(ERROR, "GPU cache of \"%s\" is not loaded yet",
+			 RelationGetRelationName(rel));
+	}
+	handle->generation = gc_sstate->redo_generation;
+	handle->main_size = gc_sstate->gpu_main_size;
+	memcpy(handle->main_mhandle, &gc_sstate->gpu_main_mhandle,
+		   sizeof(CUipcMemHandle));
+	pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+
+	table_close(rel, RowExclusiveLock);
+
+	PG_RETURN_BYTEA_P(handle);
+}
+
 /*
  * pgstrom_gpucache_info
  */
@@ -2058,26 +3602,32 @@ pgstrom_gpucache_info(PG_FUNCTION_ARGS)
 	values[6] = BoolGetDatum(pg_atomic_read_u32(&gc_sstate->gpu_buffer_corrupted) != 0);
 	values[7] = Int64GetDatum(gc_sstate->gpu_main_size);
 	values[8] = Int64GetDatum(gc_sstate->gpu_extra_size);
-	values[9] = TimestampGetDatum(gc_sstate->redo_write_timestamp);
-	values[10] = Int64GetDatum(gc_sstate->redo_write_nitems);
-	values[11] = Int64GetDatum(gc_sstate->redo_write_pos);
+	values[9] = TimestampGetDatum(pg_atomic_read_u64(&gc_sstate->redo_write_timestamp));
+	values[10] = Int64GetDatum(pg_atomic_read_u64(&gc_sstate->redo_write_nitems));
+	values[11] = Int64GetDatum(pg_atomic_read_u64(&gc_sstate->redo_write_pos));
 	values[12] = Int64GetDatum(gc_sstate->redo_read_nitems);
-	values[13] = Int64GetDatum(gc_sstate->redo_read_pos);
-	values[14] = Int64GetDatum(gc_sstate->redo_sync_pos);
+	values[13] = Int64GetDatum(pg_atomic_read_u64(&gc_sstate->redo_read_pos));
+	values[14] = Int64GetDatum(pg_atomic_read_u64(&gc_sstate->redo_sync_pos));
 
 	if (gc_sstate->cuda_dindex >= 0 &&
 		gc_sstate->cuda_dindex < numDevAttrs)
 	{
 		options = psprintf("gpu_device_id=%d,"
+						   "num_shards=%d,"
+						   "shard_id=%d,"
 						   "max_num_rows=%ld,"
 						   "redo_buffer_size=%zu,"
 						   "gpu_sync_interval=%d,"
-						   "gpu_sync_threshold=%zu",
+						   "gpu_sync_threshold=%zu%s",
 						   devAttrs[gc_sstate->cuda_dindex].DEV_ID,
+						   gc_sstate->num_shards,
+						   gc_sstate->shard_id,
 						   gc_sstate->max_num_rows,
 						   gc_sstate->redo_buffer_size,
 						   gc_sstate->gpu_sync_interval,
-						   gc_sstate->gpu_sync_threshold);
+						   gc_sstate->gpu_sync_threshold,
+						   (gc_sstate->sync_mode == GPUCACHE_SYNC_MODE__WAL
+							? ",sync_mode=wal" : ""));
 		values[15] = CStringGetTextDatum(options);
 	}
 	else
@@ -2088,6 +3638,133 @@ pgstrom_gpucache_info(PG_FUNCTION_ARGS)
 	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
 }
 
+/*
+ * pgstrom_gpucache_stats
+ */
+#define GPUCACHE_STATS_NATTS	20
+#ifndef INT8ARRAYOID
+#define INT8ARRAYOID		1016	/* see pg_type.h */
+#endif
+Datum
+pgstrom_gpucache_stats(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	GpuCacheSharedState *gc_sstate;
+	GpuCacheStatistics *stats;
+	List	   *info_list;
+	Datum		values[GPUCACHE_STATS_NATTS];
+	bool		isnull[GPUCACHE_STATS_NATTS];
+	Datum		hist[GPUCACHE_STAT_HIST_NBUCKETS];
+	HeapTuple	tuple;
+	uint64		write_pos;
+	uint64		read_pos;
+	uint64		apply_ts;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc	tupdesc;
+		MemoryContext oldcxt;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+		tupdesc = CreateTemplateTupleDesc(GPUCACHE_STATS_NATTS);
+		TupleDescInitEntry(tupdesc,  1, "database_oid",
+						   OIDOID, -1, 0);
+		TupleDescInitEntry(tupdesc,  2, "database_name",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc,  3, "table_oid",
+						   OIDOID, -1, 0);
+		TupleDescInitEntry(tupdesc,  4, "table_name",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc,  5, "shard_id",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  6, "redo_lag_bytes",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  7, "redo_lag_secs",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  8, "redo_wait_count",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  9, "apply_count",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 10, "apply_total_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 11, "apply_max_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 12, "apply_latency_hist",
+						   INT8ARRAYOID, -1, 0);
+		TupleDescInitEntry(tupdesc, 13, "compaction_count",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 14, "compaction_total_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 15, "reader_wait_count",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 16, "reader_wait_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 17, "writer_wait_count",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 18, "writer_wait_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 19, "corrupted_count",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 20, "reload_count",
+						   INT8OID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+		fncxt->user_fctx = __pgstrom_gpucache_info();
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	info_list = (List *)fncxt->user_fctx;
+	if (info_list == NIL)
+		SRF_RETURN_DONE(fncxt);
+	gc_sstate = linitial(info_list);
+	fncxt->user_fctx = list_delete_first(info_list);
+	stats = &gc_sstate->stats;
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = ObjectIdGetDatum(gc_sstate->database_oid);
+	values[1] = CStringGetTextDatum(get_database_name(gc_sstate->database_oid));
+	values[2] = ObjectIdGetDatum(gc_sstate->table_oid);
+	values[3] = CStringGetTextDatum(gc_sstate->table_name);
+	values[4] = Int32GetDatum(gc_sstate->shard_id);
+
+	/*
+	 * The lag in seconds is the time since the last application, as long
+	 * as any REDO logs are not applied yet.
+	 */
+	write_pos = pg_atomic_read_u64(&gc_sstate->redo_write_pos);
+	read_pos  = pg_atomic_read_u64(&gc_sstate->redo_read_pos);
+	apply_ts  = pg_atomic_read_u64(&stats->apply_timestamp);
+	values[5] = Int64GetDatum(write_pos > read_pos ? write_pos - read_pos : 0);
+	if (write_pos <= read_pos)
+		values[6] = Float8GetDatum(0.0);
+	else if (apply_ts == 0)
+		isnull[6] = true;
+	else
+		values[6] = Float8GetDatum((double)(GetCurrentTimestamp() -
+											(TimestampTz)apply_ts) / 1000000.0);
+	values[7] = Int64GetDatum(pg_atomic_read_u64(&stats->redo_wait_count));
+	values[8] = Int64GetDatum(pg_atomic_read_u64(&stats->apply_count));
+	values[9] = Float8GetDatum((double)pg_atomic_read_u64(&stats->apply_usec) / 1000.0);
+	values[10] = Float8GetDatum((double)pg_atomic_read_u64(&stats->apply_max_usec) / 1000.0);
+	for (int k=0; k < GPUCACHE_STAT_HIST_NBUCKETS; k++)
+		hist[k] = Int64GetDatum(pg_atomic_read_u64(&stats->apply_hist[k]));
+	values[11] = PointerGetDatum(construct_array(hist, GPUCACHE_STAT_HIST_NBUCKETS,
+												 INT8OID, sizeof(int64),
+												 FLOAT8PASSBYVAL, 'd'));
+	values[12] = Int64GetDatum(pg_atomic_read_u64(&stats->compaction_count));
+	values[13] = Float8GetDatum((double)pg_atomic_read_u64(&stats->compaction_usec) / 1000.0);
+	values[14] = Int64GetDatum(pg_atomic_read_u64(&stats->reader_wait_count));
+	values[15] = Float8GetDatum((double)pg_atomic_read_u64(&stats->reader_wait_usec) / 1000.0);
+	values[16] = Int64GetDatum(pg_atomic_read_u64(&stats->writer_wait_count));
+	values[17] = Float8GetDatum((double)pg_atomic_read_u64(&stats->writer_wait_usec) / 1000.0);
+	values[18] = Int64GetDatum(pg_atomic_read_u64(&stats->corrupted_count));
+	values[19] = Int64GetDatum(pg_atomic_read_u64(&stats->reload_count));
+
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+
 /* ---------------------------------------------------------------- *
  *
  * Executor callbacks
@@ -2135,7 +3812,8 @@ gpuCacheStateCleanup(ResourceReleasePhase phase,
 }
 
 GpuCacheState *
-ExecInitGpuCache(ScanState *ss, int eflags, Bitmapset *outer_refs)
+ExecInitGpuCache(ScanState *ss, int eflags,
+				 List *outer_quals, Bitmapset *outer_refs)
 {
 	Relation			relation = ss->ss_currentRelation;
 	Datum				signature;
@@ -2172,12 +3850,20 @@ ExecInitGpuCache(ScanState *ss, int eflags, Bitmapset *outer_refs)
 	hkey.table_oid    = RelationGetRelid(relation);
 	hkey.signature    = signature;
 	gc_sstate = __lookupGpuCacheSharedState(&hkey, relation, &gc_options, false);
-	if (!gc_sstate || pg_atomic_read_u32(&gc_sstate->gpu_buffer_corrupted))
+	if (!gc_sstate || gpuCacheIsCorrupted(gc_sstate))
 	{
 		if (gc_sstate)
 			putGpuCacheSharedState(gc_sstate, false);
 		return NULL;
 	}
+	/* partial GPU cache must hold all the rows to be scanned */
+	if (!gpuCacheWindowBoundIsValid(gc_sstate, ss, outer_quals))
+	{
+		elog(DEBUG2, "gpucache: scan on '%s' is out of the cache window",
+			 RelationGetRelationName(relation));
+		putGpuCacheSharedState(gc_sstate, false);
+		return NULL;
+	}
 	/* Setup GpuCacheState */
 	PG_TRY();
 	{
@@ -2208,27 +3894,31 @@ ExecScanChunkGpuCache(GpuTaskState *gts)
 {
 	EState		   *estate = gts->css.ss.ps.state;
 	GpuCacheState  *gcache_state = gts->gc_state;
-	pgstrom_data_store *pds = NULL;
+	int				nshards = gpuCacheNumShards(gcache_state->gc_sstate);
+	uint32			index;
 
-	if (pg_atomic_fetch_add_u32(gcache_state->gc_fetch_count, 1) == 0)
+	/*
+	 * Each shard of the GPU cache is processed as a PDS; the results are
+	 * merged on the host side as usual.
+	 */
+	while ((index = pg_atomic_fetch_add_u32(gcache_state->gc_fetch_count,
+											1)) < nshards)
 	{
-		GpuCacheSharedState *gc_sstate = gcache_state->gc_sstate;
+		GpuCacheSharedState *gc_sstate;
+		pgstrom_data_store *pds;
 		uint64		write_pos;
-		uint64		sync_pos = ULONG_MAX;
+		bool		needs_sync;
 		size_t		head_sz;
 
-		SpinLockAcquire(&gc_sstate->redo_lock);
-		write_pos = gc_sstate->redo_write_pos;
-		if (gc_sstate->redo_sync_pos < gc_sstate->redo_write_pos)
-			sync_pos = gc_sstate->redo_sync_pos = gc_sstate->redo_write_pos;
-		SpinLockRelease(&gc_sstate->redo_lock);
+		gc_sstate = gpuCacheShard(gcache_state->gc_sstate, index);
+		write_pos = gpuCacheAdvanceSyncPos(gc_sstate, &needs_sync);
 
-		/* Is the target table empty? */
+		/* Is the target table (or shard) empty? */
 		if (write_pos == 0)
-			return NULL;
+			continue;
 
 		/* Force to apply pending REDO logs, if any */
-		if (sync_pos != ULONG_MAX)
+		if (needs_sync)
 		{
 			/*
 			 * If REDO logs could not be applied correctly, we give up mapping
@@ -2237,8 +3927,15 @@ ExecScanChunkGpuCache(GpuTaskState *gts)
 			 * In this case, we try to build alternative PDS buffers using
 			 * PostgreSQL scan as usual.
 			 */
-			if (gpuCacheInvokeApplyRedo(gc_sstate, sync_pos, false) != CUDA_SUCCESS)
+			if (gpuCacheInvokeApplyRedo(gc_sstate, write_pos, false) != CUDA_SUCCESS)
 			{
+				/*
+				 * Once a PDS of the other shards is processed, we cannot
+				 * switch to the PostgreSQL scan without duplication.
+				 */
+				if (nshards > 1)
+					elog(ERROR, "gpucache: failed on apply REDO logs on '%s' (shard %d)",
+						 gc_sstate->table_name, gc_sstate->shard_id);
 				ExecEndGpuCache(gcache_state);
 				gts->gc_state = NULL;
 				return pgstromExecScanChunk(gts);
@@ -2250,9 +3947,67 @@ ExecScanChunkGpuCache(GpuTaskState *gts)
 									 offsetof(pgstrom_data_store, kds) + head_sz);
 		pg_atomic_init_u32(&pds->refcnt, 1);
 		pds->gc_sstate = gc_sstate;
+		/* kds_head may be updated by expansion of the main buffer */
+		pthreadRWLockReadLock(&gc_sstate->gpu_buffer_lock);
 		memcpy(&pds->kds, &gc_sstate->kds_head, head_sz);
+		pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+		return pds;
+	}
+	return NULL;
+}
+
+/*
+ * gpuCacheContentsVersion
+ *
+ * It returns a pair of the generation and the REDO log position that
+ * identifies the current contents of the GPU cache. Any modification on
+ * the table (including COMMIT/ABORT) appends REDO logs, so the same pair
+ * guarantees the same contents. It returns false if the current transaction
+ * has uncommitted modification on the table, because it is visible only
+ * to this backend.
+ */
+bool
+gpuCacheContentsVersion(GpuCacheState *gcache_state,
+						uint64 *p_generation,
+						uint64 *p_write_pos)
+{
+	GpuCacheSharedState *gc_sstate = gcache_state->gc_sstate;
+	HASH_SEQ_STATUS	hseq;
+	GpuCacheDesc   *gc_desc;
+	uint64			generation = 0;
+	uint64			write_pos = 0;
+	int				k, nshards = gpuCacheNumShards(gc_sstate);
+
+	if (gpuCacheIsCorrupted(gc_sstate))
+		return false;
+
+	hash_seq_init(&hseq, gcache_descriptors_htab);
+	while ((gc_desc = hash_seq_search(&hseq)) != NULL)
+	{
+		if (gc_desc->database_oid == gc_sstate->database_oid &&
+			gc_desc->table_oid    == gc_sstate->table_oid)
+		{
+			hash_seq_term(&hseq);
+			return false;
+		}
+	}
+	/*
+	 * generation and write_pos are never rewound in a generation, so the sum
+	 * of the shards also identifies the contents.
+	 */
+	for (k=0; k < nshards; k++)
+	{
+		GpuCacheSharedState *gc_shard = gpuCacheShard(gc_sstate, k);
+
+		SpinLockAcquire(&gc_shard->redo_lock);
+		generation += gc_shard->redo_generation;
+		write_pos  += pg_atomic_read_u64(&gc_shard->redo_write_pos);
+		SpinLockRelease(&gc_shard->redo_lock);
 	}
-	return pds;
+	*p_generation = generation;
+	*p_write_pos  = write_pos;
+
+	return true;
 }
 
 void
@@ -2309,14 +4064,20 @@ ExplainGpuCache(GpuCacheState *gcache_state,
 	size_t		gpu_main_size = 0UL;
 	size_t		gpu_extra_size = 0UL;
 
-	/* GPU memory usage */
+	/* GPU memory usage (total of the shards) */
 	if (gcache_state->gc_sstate)
 	{
 		GpuCacheSharedState *gc_sstate = gcache_state->gc_sstate;
+		int			k, nshards = gpuCacheNumShards(gc_sstate);
 
 		SpinLockAcquire(&gcache_shared_head->gcache_sstate_lock);
-		gpu_main_size = gc_sstate->gpu_main_size;
-		gpu_extra_size = gc_sstate->gpu_extra_size;
+		for (k=0; k < nshards; k++)
+		{
+			GpuCacheSharedState *gc_shard = gpuCacheShard(gc_sstate, k);
+
+			gpu_main_size  += gc_shard->gpu_main_size;
+			gpu_extra_size += gc_shard->gpu_extra_size;
+		}
 		SpinLockRelease(&gcache_shared_head->gcache_sstate_lock);
 	}
 
@@ -2326,11 +4087,19 @@ ExplainGpuCache(GpuCacheState *gcache_state,
 	{
 		if (!pgstrom_regression_test_mode)
 		{
-			sprintf(temp, "%s [max_num_rows: %ld, main: %s, extra: %s]",
-					devAttrs[gc_options->cuda_dindex].DEV_NAME,
-					gc_options->max_num_rows,
-					format_numeric(gpu_main_size),
-					format_numeric(gpu_extra_size));
+			if (gc_options->num_shards > 1)
+				sprintf(temp, "%s [shards: %d, max_num_rows: %ld, main: %s, extra: %s]",
+						devAttrs[gc_options->cuda_dindex].DEV_NAME,
+						gc_options->num_shards,
+						gc_options->max_num_rows,
+						format_numeric(gpu_main_size),
+						format_numeric(gpu_extra_size));
+			else
+				sprintf(temp, "%s [max_num_rows: %ld, main: %s, extra: %s]",
+						devAttrs[gc_options->cuda_dindex].DEV_NAME,
+						gc_options->max_num_rows,
+						format_numeric(gpu_main_size),
+						format_numeric(gpu_extra_size));
 			ExplainPropertyText("GPU Cache", temp, es);			
 		}
 		else if (!es->verbose)
@@ -2367,6 +4136,26 @@ ExplainGpuCache(GpuCacheState *gcache_state,
 					 gc_options->redo_buffer_size,
 					 gc_options->gpu_sync_interval,
 					 gc_options->gpu_sync_threshold);
+			if (gc_options->num_shards > 1)
+			{
+				size_t	len = strlen(temp);
+
+				snprintf(temp + len, sizeof(temp) - len,
+						 ",num_shards=%d", gc_options->num_shards);
+			}
+			if (gc_options->sync_mode == GPUCACHE_SYNC_MODE__WAL)
+			{
+				size_t	len = strlen(temp);
+
+				snprintf(temp + len, sizeof(temp) - len, ",sync_mode=wal");
+			}
+			if (NameStr(gc_options->index_column)[0] != '\0')
+			{
+				size_t	len = strlen(temp);
+
+				snprintf(temp + len, sizeof(temp) - len, ",index_column=%s",
+						 NameStr(gc_options->index_column));
+			}
 			ExplainPropertyText("GPU Cache Options", temp, es);
 		}
 		else
@@ -2381,6 +4170,14 @@ ExplainGpuCache(GpuCacheState *gcache_state,
 								   gc_options->gpu_sync_threshold, es);
 			ExplainPropertyInteger("GPU Cache Options:gpu_sync_interval", "s",
 								   gc_options->gpu_sync_interval, es);
+			if (gc_options->num_shards > 1)
+				ExplainPropertyInteger("GPU Cache Options:num_shards", NULL,
+									   gc_options->num_shards, es);
+			if (gc_options->sync_mode == GPUCACHE_SYNC_MODE__WAL)
+				ExplainPropertyText("GPU Cache Options:sync_mode", "wal", es);
+			if (NameStr(gc_options->index_column)[0] != '\0')
+				ExplainPropertyText("GPU Cache Options:index_column",
+									NameStr(gc_options->index_column), es);
 		}
 	}
 }
@@ -2392,24 +4189,28 @@ gpuCacheMapDeviceMemory(GpuContext *gcontext,
 	GpuCacheSharedState *gc_sstate = pds->gc_sstate;
 	CUdeviceptr	m_kds_main = 0UL;
 	CUdeviceptr	m_kds_extra = 0UL;
+	int			version;
 	CUresult	rc = CUDA_ERROR_NOT_MAPPED;
+	GpuCacheBufferVersion *gc_ver;
 
 	Assert(pds->kds.format == KDS_FORMAT_COLUMN);
-	pthreadRWLockReadLock(&gc_sstate->gpu_buffer_lock);
-	if (gc_sstate->gpu_main_devptr != 0UL)
+	gpuCacheReadLock(gc_sstate);
+	version = gc_sstate->gpu_curr_version;
+	gc_ver = &gc_sstate->gpu_versions[version];
+	if (gc_ver->main_devptr != 0UL)
 	{
 		rc = gpuIpcOpenMemHandle(gcontext,
 								 &m_kds_main,
-								 gc_sstate->gpu_main_mhandle,
+								 gc_ver->main_mhandle,
 								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
 		if (rc != CUDA_SUCCESS)
 			goto out_unlock;
 
-		if (gc_sstate->gpu_extra_devptr != 0UL)
+		if (gc_ver->extra_devptr != 0UL)
 		{
 			rc = gpuIpcOpenMemHandle(gcontext,
 									 &m_kds_extra,
-									 gc_sstate->gpu_extra_mhandle,
+									 gc_ver->extra_mhandle,
 									 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
 			if (rc != CUDA_SUCCESS)
 			{
@@ -2417,10 +4218,11 @@ gpuCacheMapDeviceMemory(GpuContext *gcontext,
 				goto out_unlock;
 			}
 		}
+		/* pin the version; BgWorker never releases it until unpinned */
+		pg_atomic_fetch_add_u32(&gc_ver->nreaders, 1);
+		pds->gc_version  = version;
 		pds->m_kds_main  = m_kds_main;
 		pds->m_kds_extra = m_kds_extra;
-
-		return CUDA_SUCCESS;
 	}
 out_unlock:
 	pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
@@ -2434,17 +4236,18 @@ gpuCacheUnmapDeviceMemory(GpuContext *gcontext,
 	GpuCacheSharedState *gc_sstate = pds->gc_sstate;
 
 	Assert(pds->kds.format == KDS_FORMAT_COLUMN);
-	if (pds->m_kds_main != 0UL)
-	{
-		gpuIpcCloseMemHandle(gcontext, pds->m_kds_main);
-		pds->m_kds_main = 0UL;
-	}
 	if (pds->m_kds_extra != 0UL)
 	{
 		gpuIpcCloseMemHandle(gcontext, pds->m_kds_extra);
 		pds->m_kds_extra = 0UL;
 	}
-	pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);	
+	if (pds->m_kds_main != 0UL)
+	{
+		gpuIpcCloseMemHandle(gcontext, pds->m_kds_main);
+		pds->m_kds_main = 0UL;
+		/* unpin the version */
+		pg_atomic_fetch_sub_u32(&gc_sstate->gpu_versions[pds->gc_version].nreaders, 1);
+	}
 }
 
 /*
@@ -2734,6 +4537,7 @@ static CUresult
 __gpuCacheInvokeBackgroundCommand(Oid database_oid,
 								  Oid table_oid,
 								  Datum signature,
+								  int shard_id,
 								  int cuda_dindex,
 								  bool is_async,
 								  int command,
@@ -2770,6 +4574,7 @@ __gpuCacheInvokeBackgroundCommand(Oid database_oid,
     cmd->database_oid = database_oid;
     cmd->table_oid = table_oid;
 	cmd->signature = signature;
+	cmd->shard_id = shard_id;
     cmd->backend = (is_async ? NULL : MyLatch);
     cmd->command = command;
     cmd->retval  = (CUresult) UINT_MAX;
@@ -2843,6 +4648,7 @@ gpuCacheInvokeApplyRedo(GpuCacheSharedState *gc_sstate,
 	return __gpuCacheInvokeBackgroundCommand(gc_sstate->database_oid,
 											 gc_sstate->table_oid,
 											 gc_sstate->signature,
+											 gc_sstate->shard_id,
 											 gc_sstate->cuda_dindex,
 											 is_async,
 											 GCACHE_BGWORKER_CMD__APPLY_REDO,
@@ -2858,6 +4664,7 @@ gpuCacheInvokeCompaction(GpuCacheSharedState *gc_sstate, bool is_async)
 	return __gpuCacheInvokeBackgroundCommand(gc_sstate->database_oid,
 											 gc_sstate->table_oid,
 											 gc_sstate->signature,
+											 gc_sstate->shard_id,
 											 gc_sstate->cuda_dindex,
 											 is_async,
 											 GCACHE_BGWORKER_CMD__COMPACTION,
@@ -2869,13 +4676,41 @@ gpuCacheInvokeCompaction(GpuCacheSharedState *gc_sstate, bool is_async)
  */
 static CUresult
 gpuCacheInvokeDropUnload(GpuCacheSharedState *gc_sstate, bool is_async)
+{
+	CUresult	rc, retval = CUDA_SUCCESS;
+	int			k, nshards = gpuCacheNumShards(gc_sstate);
+
+	for (k=0; k < nshards; k++)
+	{
+		GpuCacheSharedState *gc_shard = gpuCacheShard(gc_sstate, k);
+
+		rc = __gpuCacheInvokeBackgroundCommand(gc_shard->database_oid,
+											   gc_shard->table_oid,
+											   gc_shard->signature,
+											   gc_shard->shard_id,
+											   gc_shard->cuda_dindex,
+											   is_async,
+											   GCACHE_BGWORKER_CMD__DROP_UNLOAD,
+											   0);
+		if (rc != CUDA_SUCCESS && retval == CUDA_SUCCESS)
+			retval = rc;
+	}
+	return retval;
+}
+
+/*
+ * GCACHE_BGWORKER_CMD__RESTORE
+ */
+static CUresult
+gpuCacheInvokeRestore(GpuCacheSharedState *gc_sstate)
 {
 	return __gpuCacheInvokeBackgroundCommand(gc_sstate->database_oid,
 											 gc_sstate->table_oid,
 											 gc_sstate->signature,
+											 gc_sstate->shard_id,
 											 gc_sstate->cuda_dindex,
-											 is_async,
-											 GCACHE_BGWORKER_CMD__DROP_UNLOAD,
+											 false,
+											 GCACHE_BGWORKER_CMD__RESTORE,
 											 0);
 }
 
@@ -2926,12 +4761,42 @@ __gpuCacheLoadCudaModule(void)
 	if (rc != CUDA_SUCCESS)
 		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
 
+	rc = cuModuleGetFunction(&gcache_kfunc_sort_redo,
+							 cuda_module,
+							 "kern_gpucache_sort_redo");
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+
 	rc = cuModuleGetFunction(&gcache_kfunc_compaction,
 							 cuda_module,
 							 "kern_gpucache_compaction");
 	if (rc != CUDA_SUCCESS)
 		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
 
+	rc = cuModuleGetFunction(&gcache_kfunc_compaction_commit,
+							 cuda_module,
+							 "kern_gpucache_compaction_commit");
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+
+	rc = cuModuleGetFunction(&gcache_kfunc_expand_rowmap,
+							 cuda_module,
+							 "kern_gpucache_expand_rowmap");
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+
+	rc = cuModuleGetFunction(&gcache_kfunc_build_colindex,
+							 cuda_module,
+							 "kern_gpucache_build_colindex");
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+
+	rc = cuModuleGetFunction(&gcache_kfunc_evict_window,
+							 cuda_module,
+							 "kern_gpucache_evict_window");
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+
 	/* ok, all green */
 	gcache_cuda_module = cuda_module;
 
@@ -2947,51 +4812,441 @@ gpuCacheLoadCudaModule(void)
 }
 
 /*
- * gpuCacheAllocDeviceMemory
+ * gpuCacheBuildColIndex
+ *
+ * It (re-)builds the hash index on the main buffer @m_main, if configured.
+ * Caller must block concurrent readers of the main buffer.
  */
 static CUresult
-gpuCacheAllocDeviceMemory(GpuCacheSharedState *gc_sstate)
+gpuCacheBuildColIndex(GpuCacheSharedState *gc_sstate, CUdeviceptr m_main)
 {
-	CUdeviceptr		m_main = 0;
-	CUdeviceptr		m_extra = 0;
-	CUresult		rc;
-	int				grid_sz, block_sz;
-	void		   *kern_args[2];
-	cl_uint			nrooms = gc_sstate->kds_head.nrooms;
-	cl_uint			nslots = gc_sstate->kds_head.nslots;
-	size_t			main_sz = 0;
-	size_t			head_sz;
+	uint32		colidx;
+	uint32		nslots;
+	int			phase;
+	int			grid_sz, block_sz;
+	void	   *kern_args[4];
+	CUresult	rc;
 
-	if (gc_sstate->gpu_main_devptr != 0UL)
+	if (gc_sstate->index_colidx < 0 || m_main == 0UL)
 		return CUDA_SUCCESS;
+	colidx = gc_sstate->index_colidx;
+	nslots = gpuCacheColIndexNSlots(gc_sstate->kds_head.nrooms);
 
-	/* main portion of the device buffer */
-	main_sz = (PAGE_ALIGN(gc_sstate->kds_head.length) +
-			   PAGE_ALIGN(offsetof(kern_gpucache_rowhash, slots[nslots])) +
-			   PAGE_ALIGN(sizeof(uint32) * nrooms));
-	
-	rc = cuMemAlloc(&m_main, main_sz);
+	rc = __gpuOptimalBlockSize(&grid_sz,
+							   &block_sz,
+							   gcache_kfunc_build_colindex,
+							   gc_sstate->cuda_dindex,
+							   0, 0);
 	if (rc != CUDA_SUCCESS)
 	{
-		elog(LOG, "gpucache: failed on cuMemAlloc(%zu): %s",
-			 main_sz, errorText(rc));
-		goto error_0;
+		elog(LOG, "gpucache: failed on __gpuOptimalBlockSize: %s", errorText(rc));
+		return rc;
 	}
-
-	head_sz = KERN_DATA_STORE_HEAD_LENGTH(&gc_sstate->kds_head);
-	rc = cuMemcpyHtoD(m_main, &gc_sstate->kds_head, head_sz);
-	if (rc != CUDA_SUCCESS)
+	for (phase = 0; phase <= 3; phase++)
 	{
-		elog(LOG, "gpucache: failed on cuMemcpyHtoD: %s", errorText(rc));
-		goto error_1;
+		kern_args[0] = &m_main;
+		kern_args[1] = &colidx;
+		kern_args[2] = &nslots;
+		kern_args[3] = &phase;
+		rc = cuLaunchKernel(gcache_kfunc_build_colindex,
+							grid_sz, 1, 1,
+							block_sz, 1, 1,
+							0,
+							CU_STREAM_PER_THREAD,
+							kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(LOG, "gpucache: failed on cuLaunchKernel: %s", errorText(rc));
+			return rc;
+		}
 	}
-
-	rc = cuIpcGetMemHandle(&gc_sstate->gpu_main_mhandle, m_main);
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
 	if (rc != CUDA_SUCCESS)
-	{
-		elog(LOG, "gpucache: failed on cuIpcGetMemHandle: %s", errorText(rc));
-		goto error_1;
-	}
+		elog(LOG, "gpucache: failed on cuStreamSynchronize: %s", errorText(rc));
+	return rc;
+}
+
+/*
+ * gpuCacheWindowEvictIsDue
+ */
+static inline bool
+gpuCacheWindowEvictIsDue(GpuCacheSharedState *gc_sstate, TimestampTz now)
+{
+	return (gc_sstate->window_colidx >= 0 &&
+			now > gc_sstate->window_evicted + GPUCACHE_WINDOW_EVICT_INTERVAL);
+}
+
+/*
+ * gpuCacheBgWorkerEvictWindow
+ *
+ * It releases the rows that went out of the cache window, then rebuilds
+ * the hash index. Caller must make the main buffer private by
+ * gpuCacheBgWorkerPrepareUpdate() in advance.
+ */
+static CUresult
+gpuCacheBgWorkerEvictWindow(GpuCacheSharedState *gc_sstate, TimestampTz now)
+{
+	CUdeviceptr	m_main = gc_sstate->gpu_main_devptr;
+	uint32		colidx = gc_sstate->window_colidx;
+	int64		threshold;
+	int			grid_sz, block_sz;
+	void	   *kern_args[3];
+	CUresult	rc;
+
+	gc_sstate->window_evicted = now;
+	if (m_main == 0UL)
+		return CUDA_SUCCESS;
+	threshold = __gpuCacheWindowThreshold(gc_sstate->window_typid,
+										  gc_sstate->window_usec, now);
+	rc = __gpuOptimalBlockSize(&grid_sz,
+							   &block_sz,
+							   gcache_kfunc_evict_window,
+							   gc_sstate->cuda_dindex,
+							   0, 0);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on __gpuOptimalBlockSize: %s", errorText(rc));
+		return rc;
+	}
+	kern_args[0] = &m_main;
+	kern_args[1] = &colidx;
+	kern_args[2] = &threshold;
+	rc = cuLaunchKernel(gcache_kfunc_evict_window,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuLaunchKernel: %s", errorText(rc));
+		return rc;
+	}
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuStreamSynchronize: %s", errorText(rc));
+		return rc;
+	}
+	return gpuCacheBuildColIndex(gc_sstate, m_main);
+}
+
+/*
+ * Versions of the device buffers
+ *
+ * All the routines below are called by BgWorker with exclusive lock on
+ * gc_sstate->gpu_buffer_lock.
+ */
+static bool
+__gpuCacheBufferIsReferenced(GpuCacheSharedState *gc_sstate, CUdeviceptr m)
+{
+	if (m == gc_sstate->gpu_main_devptr ||
+		m == gc_sstate->gpu_extra_devptr)
+		return true;
+	for (int k=0; k < GPUCACHE_MAX_BUFFER_VERSIONS; k++)
+	{
+		GpuCacheBufferVersion *gc_ver = &gc_sstate->gpu_versions[k];
+
+		if (gc_ver->in_use &&
+			(gc_ver->main_devptr == m || gc_ver->extra_devptr == m))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * __gpuCacheBgWorkerRetireBuffer
+ *
+ * It releases the device buffer detached from the current working state,
+ * unless any published versions still reference it.
+ */
+static void
+__gpuCacheBgWorkerRetireBuffer(GpuCacheSharedState *gc_sstate, CUdeviceptr m)
+{
+	CUresult	rc;
+
+	if (m != 0UL && !__gpuCacheBufferIsReferenced(gc_sstate, m))
+	{
+		rc = cuMemFree(m);
+		if (rc != CUDA_SUCCESS)
+			elog(LOG, "gpucache: failed on cuMemFree: %s", errorText(rc));
+	}
+}
+
+static void
+__gpuCacheBgWorkerReleaseVersion(GpuCacheSharedState *gc_sstate, int version)
+{
+	GpuCacheBufferVersion *gc_ver = &gc_sstate->gpu_versions[version];
+	CUdeviceptr	m_main = gc_ver->main_devptr;
+	CUdeviceptr	m_extra = gc_ver->extra_devptr;
+
+	Assert(pg_atomic_read_u32(&gc_ver->nreaders) == 0);
+	gc_ver->in_use = false;
+	gc_ver->main_devptr = 0UL;
+	gc_ver->extra_devptr = 0UL;
+	memset(&gc_ver->main_mhandle, 0, sizeof(CUipcMemHandle));
+	memset(&gc_ver->extra_mhandle, 0, sizeof(CUipcMemHandle));
+
+	__gpuCacheBgWorkerRetireBuffer(gc_sstate, m_main);
+	__gpuCacheBgWorkerRetireBuffer(gc_sstate, m_extra);
+}
+
+/*
+ * gpuCacheBgWorkerReapVersions
+ *
+ * It releases the retired versions that are no longer pinned by readers.
+ */
+static void
+gpuCacheBgWorkerReapVersions(GpuCacheSharedState *gc_sstate)
+{
+	for (int k=0; k < GPUCACHE_MAX_BUFFER_VERSIONS; k++)
+	{
+		GpuCacheBufferVersion *gc_ver = &gc_sstate->gpu_versions[k];
+
+		if (k != gc_sstate->gpu_curr_version &&
+			gc_ver->in_use &&
+			pg_atomic_read_u32(&gc_ver->nreaders) == 0)
+			__gpuCacheBgWorkerReleaseVersion(gc_sstate, k);
+	}
+}
+
+/*
+ * gpuCacheHasRetiredVersions
+ *
+ * It checks whether the retired versions can be released. It does not
+ * acquire any locks, so the result is just a hint.
+ */
+static bool
+gpuCacheHasRetiredVersions(GpuCacheSharedState *gc_sstate)
+{
+	for (int k=0; k < GPUCACHE_MAX_BUFFER_VERSIONS; k++)
+	{
+		GpuCacheBufferVersion *gc_ver = &gc_sstate->gpu_versions[k];
+
+		if (k != gc_sstate->gpu_curr_version &&
+			gc_ver->in_use &&
+			pg_atomic_read_u32(&gc_ver->nreaders) == 0)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * __gpuCacheBgWorkerCopyMainBuffer
+ *
+ * It makes a private copy of the main buffer for the update; readers who
+ * pin the current version keep referencing the original one.
+ */
+static bool
+__gpuCacheBgWorkerCopyMainBuffer(GpuCacheSharedState *gc_sstate)
+{
+	CUdeviceptr	m_new_main = 0UL;
+	CUipcMemHandle new_mhandle;
+	CUresult	rc;
+
+	rc = cuMemAlloc(&m_new_main, gc_sstate->gpu_main_size);
+	if (rc != CUDA_SUCCESS)
+		goto error;
+	rc = cuMemcpyDtoD(m_new_main, gc_sstate->gpu_main_devptr,
+					  gc_sstate->gpu_main_size);
+	if (rc != CUDA_SUCCESS)
+		goto error;
+	rc = cuIpcGetMemHandle(&new_mhandle, m_new_main);
+	if (rc != CUDA_SUCCESS)
+		goto error;
+
+	gc_sstate->gpu_main_devptr = m_new_main;
+	memcpy(&gc_sstate->gpu_main_mhandle, &new_mhandle, sizeof(CUipcMemHandle));
+	/* exported IPC handles become stale */
+	SpinLockAcquire(&gc_sstate->redo_lock);
+	gc_sstate->redo_generation =
+		pg_atomic_add_fetch_u64(&gcache_shared_head->gcache_generation, 1);
+	SpinLockRelease(&gc_sstate->redo_lock);
+	return true;
+
+error:
+	elog(LOG, "gpucache: unable to make a private copy of the main buffer (%s:%lx), so wait for the readers: %s",
+		 gc_sstate->table_name,
+		 gc_sstate->signature,
+		 errorText(rc));
+	if (m_new_main != 0UL)
+		cuMemFree(m_new_main);
+	return false;
+}
+
+/*
+ * gpuCacheBgWorkerPrepareUpdate
+ *
+ * It must be called prior to the update of the device buffers. If readers
+ * pin the current version, it makes a private copy of the main buffer.
+ * Elsewhere, the update shall be applied in place, so caller must not
+ * release the exclusive lock until gpuCacheBgWorkerPublishVersion().
+ * If we have no free slot of the versions or no device memory for the copy,
+ * it waits for the readers to unpin the current version.
+ */
+static void
+gpuCacheBgWorkerPrepareUpdate(GpuCacheSharedState *gc_sstate)
+{
+	GpuCacheBufferVersion *gc_ver;
+
+	for (;;)
+	{
+		bool	has_free_slot = false;
+
+		gpuCacheBgWorkerReapVersions(gc_sstate);
+		gc_ver = &gc_sstate->gpu_versions[gc_sstate->gpu_curr_version];
+		if (gc_sstate->gpu_main_devptr == 0UL ||
+			gc_sstate->gpu_main_devptr != gc_ver->main_devptr)
+			break;		/* not published yet, or already private */
+		if (pg_atomic_read_u32(&gc_ver->nreaders) == 0)
+			break;		/* nobody references the current version */
+
+		for (int k=0; k < GPUCACHE_MAX_BUFFER_VERSIONS; k++)
+		{
+			if (!gc_sstate->gpu_versions[k].in_use)
+			{
+				has_free_slot = true;
+				break;
+			}
+		}
+		if (has_free_slot && __gpuCacheBgWorkerCopyMainBuffer(gc_sstate))
+			break;
+
+		pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+		pg_usleep(1000L);	/* 1ms */
+		pthreadRWLockWriteLock(&gc_sstate->gpu_buffer_lock);
+	}
+}
+
+/*
+ * gpuCacheBgWorkerPublishVersion
+ *
+ * It publishes the current working buffers to readers, as the new version.
+ */
+static void
+gpuCacheBgWorkerPublishVersion(GpuCacheSharedState *gc_sstate)
+{
+	GpuCacheBufferVersion *gc_ver;
+	int			version;
+
+	for (;;)
+	{
+		gpuCacheBgWorkerReapVersions(gc_sstate);
+		version = gc_sstate->gpu_curr_version;
+		gc_ver = &gc_sstate->gpu_versions[version];
+		if (gc_ver->main_devptr == gc_sstate->gpu_main_devptr &&
+			gc_ver->extra_devptr == gc_sstate->gpu_extra_devptr)
+			return;		/* already published */
+		if (pg_atomic_read_u32(&gc_ver->nreaders) == 0)
+		{
+			__gpuCacheBgWorkerReleaseVersion(gc_sstate, version);
+			break;
+		}
+		for (version=0; version < GPUCACHE_MAX_BUFFER_VERSIONS; version++)
+		{
+			if (!gc_sstate->gpu_versions[version].in_use)
+				break;
+		}
+		if (version < GPUCACHE_MAX_BUFFER_VERSIONS)
+			break;
+		/*
+		 * gpuCacheBgWorkerPrepareUpdate() already ensured a free slot, so
+		 * we should not reach here, but wait for the readers just in case.
+		 */
+		pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+		pg_usleep(1000L);	/* 1ms */
+		pthreadRWLockWriteLock(&gc_sstate->gpu_buffer_lock);
+	}
+	gc_ver = &gc_sstate->gpu_versions[version];
+	gc_ver->in_use = true;
+	gc_ver->main_devptr = gc_sstate->gpu_main_devptr;
+	gc_ver->extra_devptr = gc_sstate->gpu_extra_devptr;
+	memcpy(&gc_ver->main_mhandle, &gc_sstate->gpu_main_mhandle,
+		   sizeof(CUipcMemHandle));
+	memcpy(&gc_ver->extra_mhandle, &gc_sstate->gpu_extra_mhandle,
+		   sizeof(CUipcMemHandle));
+	gc_sstate->gpu_curr_version = version;
+}
+
+/*
+ * gpuCacheBgWorkerUnpublishAll
+ *
+ * It waits for all the readers to unpin, then releases all the versions.
+ * Caller shall release the working buffers by itself.
+ */
+static void
+gpuCacheBgWorkerUnpublishAll(GpuCacheSharedState *gc_sstate)
+{
+	int		version;
+
+	for (;;)
+	{
+		bool	pinned = false;
+
+		for (int k=0; k < GPUCACHE_MAX_BUFFER_VERSIONS; k++)
+		{
+			GpuCacheBufferVersion *gc_ver = &gc_sstate->gpu_versions[k];
+
+			if (gc_ver->in_use && pg_atomic_read_u32(&gc_ver->nreaders) > 0)
+				pinned = true;
+		}
+		if (!pinned)
+			break;
+		pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+		pg_usleep(1000L);	/* 1ms */
+		pthreadRWLockWriteLock(&gc_sstate->gpu_buffer_lock);
+	}
+	gpuCacheBgWorkerReapVersions(gc_sstate);
+	version = gc_sstate->gpu_curr_version;
+	__gpuCacheBgWorkerReleaseVersion(gc_sstate, version);
+	/* the current version is kept, but not loaded */
+	gc_sstate->gpu_versions[version].in_use = true;
+}
+
+/*
+ * gpuCacheAllocDeviceMemory
+ */
+static CUresult
+gpuCacheAllocDeviceMemory(GpuCacheSharedState *gc_sstate)
+{
+	CUdeviceptr		m_main = 0;
+	CUdeviceptr		m_extra = 0;
+	CUresult		rc;
+	int				grid_sz, block_sz;
+	void		   *kern_args[2];
+	size_t			main_sz = 0;
+	size_t			head_sz;
+
+	if (gc_sstate->gpu_main_devptr != 0UL)
+		return CUDA_SUCCESS;
+
+	/* main portion of the device buffer */
+	main_sz = gpuCacheMainBufferSize(gc_sstate);
+
+	rc = cuMemAlloc(&m_main, main_sz);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuMemAlloc(%zu): %s",
+			 main_sz, errorText(rc));
+		goto error_0;
+	}
+
+	head_sz = KERN_DATA_STORE_HEAD_LENGTH(&gc_sstate->kds_head);
+	rc = cuMemcpyHtoD(m_main, &gc_sstate->kds_head, head_sz);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuMemcpyHtoD: %s", errorText(rc));
+		goto error_1;
+	}
+
+	rc = cuIpcGetMemHandle(&gc_sstate->gpu_main_mhandle, m_main);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuIpcGetMemHandle: %s", errorText(rc));
+		goto error_1;
+	}
 
 	/* extra buffer, if any */
 	if (gc_sstate->kds_extra_sz > 0)
@@ -3059,6 +5314,11 @@ gpuCacheAllocDeviceMemory(GpuCacheSharedState *gc_sstate)
 		elog(LOG, "gpucache: failed on cuStreamSynchronize: %s", errorText(rc));
 		goto error_2;
 	}
+
+	/* empty hash index, if any */
+	rc = gpuCacheBuildColIndex(gc_sstate, m_main);
+	if (rc != CUDA_SUCCESS)
+		goto error_2;
 	
 	elog(LOG, "gpucache: AllocMemory %s:%lx (main_sz=%zu, extra_sz=%zu)",
 		 gc_sstate->table_name,
@@ -3083,7 +5343,7 @@ error_1:
 	cuMemFree(m_main);
 error_0:
 	/* mark as corrupted state */
-	pg_atomic_write_u32(&gc_sstate->gpu_buffer_corrupted, 1);
+	gpuCacheMarkCorrupted(gc_sstate);
 	SpinLockAcquire(&gcache_shared_head->gcache_sstate_lock);
 	gc_sstate->initial_loading = -1;
 	SpinLockRelease(&gcache_shared_head->gcache_sstate_lock);
@@ -3100,23 +5360,38 @@ error_0:
 /*
  * GCACHE_BGWORKER_CMD__COMPACTION command
  *
- * caller must hold exclusive lock on gc_sstate->gpu_buffer_lock
+ * __gpuCacheBgWorkerCompactionCopy copies the varlena values in use to the
+ * new extra buffer. If @m_new_values is valid, the new offsets are written
+ * to the shadow array, so the main buffer and the old extra buffer are kept
+ * as is, and concurrent readers can reference them during the copy.
+ *
+ * Identical varlena values share a location of the new extra buffer using
+ * a dictionary, then the new extra buffer is shrunk to fit if the dictionary
+ * saved enough device memory.
  */
+#define GPUCACHE_DICT_MAX_NSLOTS	(4U << 20)	/* 16MB */
+
 static CUresult
-gpuCacheBgWorkerExecCompactionNoLock(GpuCacheSharedState *gc_sstate)
+__gpuCacheBgWorkerCompactionCopy(GpuCacheSharedState *gc_sstate,
+								 CUdeviceptr m_new_values,
+								 CUdeviceptr *p_new_extra,
+								 CUipcMemHandle *p_new_mhandle,
+								 kern_data_extra *h_extra)
 {
-	kern_data_extra	h_extra;
+	kern_data_store *kds_head = &gc_sstate->kds_head;
 	int				grid_sz, block_sz;
 	size_t			curr_usage;
+	size_t			fit_length;
 	CUdeviceptr		m_try_extra = 0UL;
 	CUdeviceptr		m_new_extra = 0UL;
-	CUdeviceptr		m_temp;
-	CUipcMemHandle	new_mhandle;
+	CUdeviceptr		m_fit_extra = 0UL;
+	CUdeviceptr		m_dict = 0UL;
+	CUdeviceptr		m_null = 0UL;
+	cl_uint			dict_nslots = 0;
+	cl_uint			nitems;
+	int				nvarlena = 0;
 	CUresult		rc;
-	void		   *kern_args[3];
-
-	if (gc_sstate->gpu_extra_devptr == 0UL)
-		return CUDA_SUCCESS;	/* nothing to do, if no extra buffer */
+	void		   *kern_args[6];
 
 	rc = __gpuOptimalBlockSize(&grid_sz,
 							   &block_sz,
@@ -3126,6 +5401,37 @@ gpuCacheBgWorkerExecCompactionNoLock(GpuCacheSharedState *gc_sstate)
 	if (rc != CUDA_SUCCESS)
 		return rc;
 
+	/* allocation of the dictionary, if possible */
+	for (int j=0; j < kds_head->ncols; j++)
+	{
+		kern_colmeta   *cmeta = &kds_head->colmeta[j];
+
+		if (!cmeta->attbyval && cmeta->attlen == -1)
+			nvarlena++;
+	}
+	rc = cuMemcpyDtoH(&nitems, gc_sstate->gpu_main_devptr +
+					  offsetof(kern_data_store, nitems), sizeof(cl_uint));
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemcpyDtoH: %s", errorText(rc));
+	dict_nslots = Min(2 * (uint64)nitems * nvarlena, GPUCACHE_DICT_MAX_NSLOTS);
+	if (dict_nslots > 0)
+	{
+		rc = cuMemAlloc(&m_dict, sizeof(cl_uint) * dict_nslots);
+		if (rc == CUDA_SUCCESS)
+			rc = cuMemsetD32(m_dict, 0, dict_nslots);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(LOG, "gpucache: unable to allocate the dictionary for compaction (%s:%lx): %s",
+				 gc_sstate->table_name,
+				 gc_sstate->signature,
+				 errorText(rc));
+			if (m_dict != 0UL)
+				cuMemFree(m_dict);
+			m_dict = 0UL;
+			dict_nslots = 0;
+		}
+	}
+
 	/*
 	 * phase-1: Estimation of the required device memory. This dummy
 	 * extra buffer is initialized to usage > length, so compaction
@@ -3136,13 +5442,16 @@ gpuCacheBgWorkerExecCompactionNoLock(GpuCacheSharedState *gc_sstate)
 	if (rc != CUDA_SUCCESS)
 		elog(ERROR, "failed on cuMemAllocManaged: %s", errorText(rc));
 
-	memset(&h_extra, 0, offsetof(kern_data_extra, data));
-	h_extra.usage  = offsetof(kern_data_extra, data);
-	memcpy((void *)m_try_extra, &h_extra, offsetof(kern_data_extra, data));
+	memset(h_extra, 0, offsetof(kern_data_extra, data));
+	h_extra->usage  = offsetof(kern_data_extra, data);
+	memcpy((void *)m_try_extra, h_extra, offsetof(kern_data_extra, data));
 
 	kern_args[0] = &gc_sstate->gpu_main_devptr;
 	kern_args[1] = &gc_sstate->gpu_extra_devptr;
 	kern_args[2] = &m_try_extra;
+	kern_args[3] = &m_new_values;
+	kern_args[4] = &m_null;
+	kern_args[5] = &dict_nslots;
 	rc = cuLaunchKernel(gcache_kfunc_compaction,
 						grid_sz, 1, 1,
 						block_sz, 1, 1,
@@ -3159,6 +5468,7 @@ gpuCacheBgWorkerExecCompactionNoLock(GpuCacheSharedState *gc_sstate)
 		elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
 
 	curr_usage = ((kern_data_extra *)m_try_extra)->usage;
+	cuMemFree(m_try_extra);
 
 	/*
 	 * phase-2: Main portion of the compaction. 
@@ -3166,19 +5476,19 @@ gpuCacheBgWorkerExecCompactionNoLock(GpuCacheSharedState *gc_sstate)
 	 *
 	 * XXX: fail of cuMemAlloc() should mark GPU cache corrupted. TODO.
 	 */
-	h_extra.length = Max(curr_usage + (64UL << 20),		/* 64MB margin */
-						 (double)curr_usage * 1.15);	/* 15% margin */
-	h_extra.usage = offsetof(kern_data_extra, data);
-	rc = cuMemAlloc(&m_new_extra, h_extra.length);
+	h_extra->length = Max(curr_usage + (64UL << 20),	/* 64MB margin */
+						  (double)curr_usage * 1.15);	/* 15% margin */
+	h_extra->usage = offsetof(kern_data_extra, data);
+	rc = cuMemAlloc(&m_new_extra, h_extra->length);
 	if (rc != CUDA_SUCCESS)
 		elog(ERROR, "failed on cuMemAlloc(%zu): %s",
-			 h_extra.length, errorText(rc));
+			 h_extra->length, errorText(rc));
 
-	rc = cuIpcGetMemHandle(&new_mhandle, m_new_extra);
+	rc = cuIpcGetMemHandle(p_new_mhandle, m_new_extra);
 	if (rc != CUDA_SUCCESS)
 		elog(ERROR, "failed on cuIpcGetMemHandle: %s", errorText(rc));
 
-	rc = cuMemcpyHtoD(m_new_extra, &h_extra, offsetof(kern_data_extra, data));
+	rc = cuMemcpyHtoD(m_new_extra, h_extra, offsetof(kern_data_extra, data));
 	if (rc != CUDA_SUCCESS)
 		elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
 
@@ -3186,6 +5496,9 @@ gpuCacheBgWorkerExecCompactionNoLock(GpuCacheSharedState *gc_sstate)
 	kern_args[0] = &gc_sstate->gpu_main_devptr;
 	kern_args[1] = &gc_sstate->gpu_extra_devptr;
 	kern_args[2] = &m_new_extra;
+	kern_args[3] = &m_new_values;
+	kern_args[4] = &m_dict;
+	kern_args[5] = &dict_nslots;
 	rc = cuLaunchKernel(gcache_kfunc_compaction,
 						grid_sz, 1, 1,
 						block_sz, 1, 1,
@@ -3201,49 +5514,523 @@ gpuCacheBgWorkerExecCompactionNoLock(GpuCacheSharedState *gc_sstate)
 	if (rc != CUDA_SUCCESS)
 		elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
 
-	rc = cuMemcpyDtoH(&h_extra, m_new_extra, offsetof(kern_data_extra, data));
+	rc = cuMemcpyDtoH(h_extra, m_new_extra, offsetof(kern_data_extra, data));
 	if (rc != CUDA_SUCCESS)
 		elog(ERROR, "failed on cuMemcpyDtoH: %s", errorText(rc));
+	if (m_dict != 0UL)
+		cuMemFree(m_dict);
 
-	elog(LOG, "gpucache: extra compaction (%s:%lx) {length=%zu->%zu, usage=%zu}",
-		 gc_sstate->table_name,
-		 gc_sstate->signature,
-		 gc_sstate->gpu_extra_size, h_extra.length, h_extra.usage);
+	/*
+	 * phase-3: shrink the new extra buffer, if the dictionary saved 25% or
+	 * more device memory from the estimation. The offsets are relative to
+	 * the head of the extra buffer, so the used portion is simply copied.
+	 */
+	fit_length = Max(h_extra->usage + (64UL << 20),		/* 64MB margin */
+					 (double)h_extra->usage * 1.15);	/* 15% margin */
+	if (fit_length < h_extra->length * 3 / 4 &&
+		cuMemAlloc(&m_fit_extra, fit_length) == CUDA_SUCCESS)
+	{
+		rc = cuMemcpyDtoD(m_fit_extra, m_new_extra, h_extra->usage);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuMemcpyDtoD: %s", errorText(rc));
 
-	/* swap buffer */
-	m_temp = gc_sstate->gpu_extra_devptr;
-	gc_sstate->gpu_extra_devptr = m_new_extra;
-	memcpy(&gc_sstate->gpu_extra_mhandle, &new_mhandle, sizeof(CUipcMemHandle));
-	gc_sstate->gpu_extra_size = h_extra.length;
-	m_new_extra = m_temp;
+		rc = cuIpcGetMemHandle(p_new_mhandle, m_fit_extra);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuIpcGetMemHandle: %s", errorText(rc));
 
-	/* ok, release old/temporary buffers */
-	if (m_new_extra != 0UL)
+		h_extra->length = fit_length;
+		rc = cuMemcpyHtoD(m_fit_extra, h_extra, offsetof(kern_data_extra, data));
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
 		cuMemFree(m_new_extra);
-	if (m_try_extra != 0UL)
-		cuMemFree(m_try_extra);
-	return rc;
+		m_new_extra = m_fit_extra;
+	}
+	*p_new_extra = m_new_extra;
+	return CUDA_SUCCESS;
 }
 
-static inline CUresult
+/*
+ * __gpuCacheBgWorkerCompactionSwap
+ *
+ * It switches the extra buffer to the new one, then releases the old one
+ * unless readers still pin the versions that reference it.
+ * Caller must hold exclusive lock on gc_sstate->gpu_buffer_lock.
+ */
+static void
+__gpuCacheBgWorkerCompactionSwap(GpuCacheSharedState *gc_sstate,
+								 CUdeviceptr m_new_extra,
+								 CUipcMemHandle *new_mhandle,
+								 kern_data_extra *h_extra,
+								 bool concurrent,
+								 TimestampTz tv_start)
+{
+	CUdeviceptr		m_old_extra = gc_sstate->gpu_extra_devptr;
+
+	elog(LOG, "gpucache: extra compaction%s (%s:%lx) {length=%zu->%zu, usage=%zu}",
+		 concurrent ? " (concurrent)" : "",
+		 gc_sstate->table_name,
+		 gc_sstate->signature,
+		 gc_sstate->gpu_extra_size, h_extra->length, h_extra->usage);
+
+	gc_sstate->gpu_extra_devptr = m_new_extra;
+	memcpy(&gc_sstate->gpu_extra_mhandle, new_mhandle, sizeof(CUipcMemHandle));
+	gc_sstate->gpu_extra_size = h_extra->length;
+
+	__gpuCacheBgWorkerRetireBuffer(gc_sstate, m_old_extra);
+	gpuCacheStatCompaction(gc_sstate, tv_start);
+}
+
+/*
+ * gpuCacheBgWorkerExecCompactionNoLock
+ *
+ * caller must hold exclusive lock on gc_sstate->gpu_buffer_lock
+ */
+static CUresult
+gpuCacheBgWorkerExecCompactionNoLock(GpuCacheSharedState *gc_sstate)
+{
+	kern_data_extra	h_extra;
+	CUdeviceptr		m_new_extra = 0UL;
+	CUipcMemHandle	new_mhandle;
+	TimestampTz		tv_start = GetCurrentTimestamp();
+	CUresult		rc;
+
+	if (gc_sstate->gpu_extra_devptr == 0UL)
+		return CUDA_SUCCESS;	/* nothing to do, if no extra buffer */
+
+	rc = __gpuCacheBgWorkerCompactionCopy(gc_sstate, 0UL,
+										  &m_new_extra,
+										  &new_mhandle,
+										  &h_extra);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	__gpuCacheBgWorkerCompactionSwap(gc_sstate, m_new_extra,
+									 &new_mhandle, &h_extra, false,
+									 tv_start);
+	return CUDA_SUCCESS;
+}
+
+/*
+ * gpuCacheBgWorkerExecCompaction
+ *
+ * The compaction on demand (or by the idle task) copies the varlena values
+ * under the shared lock, so readers don't need to wait for the whole copy.
+ * Only this bgworker modifies the GPU buffers, so the main buffer is never
+ * updated during the copy. Exclusive lock is acquired to write back the new
+ * offsets from the shadow array, and to switch the extra buffer.
+ * If we cannot allocate the shadow array, it falls back to the compaction
+ * under the exclusive lock.
+ */
+static CUresult
 gpuCacheBgWorkerExecCompaction(GpuCacheSharedState *gc_sstate)
 {
-	CUresult	rc;
+	kern_data_store *kds_head = &gc_sstate->kds_head;
+	kern_data_extra	h_extra;
+	CUdeviceptr		m_new_values = 0UL;
+	CUdeviceptr		m_new_extra = 0UL;
+	CUipcMemHandle	new_mhandle;
+	cl_uint			nitems;
+	int				nvarlena = 0;
+	int				grid_sz, block_sz;
+	void		   *kern_args[2];
+	TimestampTz		tv_start = GetCurrentTimestamp();
+	CUresult		rc;
 
 	rc = gpuCacheLoadCudaModule();
 	if (rc != CUDA_SUCCESS)
 		return rc;
 
-	pthreadRWLockWriteLock(&gc_sstate->gpu_buffer_lock);
+	pthreadRWLockReadLock(&gc_sstate->gpu_buffer_lock);
 	if (pg_atomic_read_u32(&gc_sstate->gpu_buffer_corrupted))
+	{
 		rc = CUDA_ERROR_NOT_READY;
-	else
-		rc = gpuCacheBgWorkerExecCompactionNoLock(gc_sstate);
+		goto out_unlock;
+	}
+	if (gc_sstate->gpu_main_devptr == 0UL ||
+		gc_sstate->gpu_extra_devptr == 0UL)
+		goto out_unlock;		/* nothing to do, if no extra buffer */
+
+	/* allocation of the shadow array of the new offsets */
+	for (int j=0; j < kds_head->ncols; j++)
+	{
+		kern_colmeta   *cmeta = &kds_head->colmeta[j];
+
+		if (!cmeta->attbyval && cmeta->attlen == -1)
+			nvarlena++;
+	}
+	rc = cuMemcpyDtoH(&nitems, gc_sstate->gpu_main_devptr +
+					  offsetof(kern_data_store, nitems), sizeof(cl_uint));
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemcpyDtoH: %s", errorText(rc));
+	if (nitems > 0 && nvarlena > 0)
+	{
+		rc = cuMemAlloc(&m_new_values, sizeof(cl_uint) * nvarlena * nitems);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(LOG, "gpucache: unable to allocate the shadow array for concurrent compaction (%s:%lx): %s",
+				 gc_sstate->table_name,
+				 gc_sstate->signature,
+				 errorText(rc));
+			m_new_values = 0UL;
+		}
+	}
+
+	if (m_new_values == 0UL)
+	{
+		/* fallback; compaction under the exclusive lock */
+		pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+		gpuCacheWriteLock(gc_sstate);
+		if (pg_atomic_read_u32(&gc_sstate->gpu_buffer_corrupted))
+			rc = CUDA_ERROR_NOT_READY;
+		else
+		{
+			gpuCacheBgWorkerPrepareUpdate(gc_sstate);
+			rc = gpuCacheBgWorkerExecCompactionNoLock(gc_sstate);
+			gpuCacheBgWorkerPublishVersion(gc_sstate);
+		}
+		goto out_unlock;
+	}
+
+	/* copy the varlena values, but the main buffer is not updated yet */
+	rc = __gpuCacheBgWorkerCompactionCopy(gc_sstate, m_new_values,
+										  &m_new_extra,
+										  &new_mhandle,
+										  &h_extra);
+	if (rc != CUDA_SUCCESS)
+		goto out_unlock;
 	pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
 
+	/*
+	 * Write back the new offsets, then switch the extra buffer. The main
+	 * buffer shall not be changed during the lock upgrade, because only
+	 * this bgworker modifies the GPU buffers.
+	 */
+	gpuCacheWriteLock(gc_sstate);
+	gpuCacheBgWorkerPrepareUpdate(gc_sstate);
+	rc = __gpuOptimalBlockSize(&grid_sz,
+							   &block_sz,
+							   gcache_kfunc_compaction_commit,
+							   gc_sstate->cuda_dindex,
+							   0, 0);
+	if (rc != CUDA_SUCCESS)
+	{
+		cuMemFree(m_new_extra);
+		goto out_unlock;
+	}
+	grid_sz = Min(grid_sz, (nitems + block_sz - 1) / block_sz);
+
+	kern_args[0] = &gc_sstate->gpu_main_devptr;
+	kern_args[1] = &m_new_values;
+	rc = cuLaunchKernel(gcache_kfunc_compaction_commit,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+
+	__gpuCacheBgWorkerCompactionSwap(gc_sstate, m_new_extra,
+									 &new_mhandle, &h_extra, true,
+									 tv_start);
+	gpuCacheBgWorkerPublishVersion(gc_sstate);
+out_unlock:
+	pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+	if (m_new_values != 0UL)
+		cuMemFree(m_new_values);
 	return rc;
 }
 
+/*
+ * __gpuCacheRelayoutKdsHead
+ *
+ * It re-computes the location of the column arrays on the main buffer for
+ * the new @nrooms, according to the same manner of createGpuCacheSharedState.
+ */
+static void
+__gpuCacheRelayoutKdsHead(kern_data_store *kds, uint32 nrooms)
+{
+	size_t		off = KDS_OFFSET_MAX_SIZE;
+	size_t		sz;
+	int			j;
+
+	/* column arrays begin at the lowest offset */
+	for (j=0; j < kds->nr_colmeta; j++)
+	{
+		kern_colmeta *cmeta = &kds->colmeta[j];
+
+		if (j >= kds->ncols && j < kds->nr_colmeta - 1)
+			continue;	/* sub-fields have no arrays */
+		if (cmeta->nullmap_offset != 0)
+			off = Min(off, __kds_unpack(cmeta->nullmap_offset));
+		if (cmeta->values_offset != 0)
+			off = Min(off, __kds_unpack(cmeta->values_offset));
+	}
+
+	for (j=0; j < kds->ncols; j++)
+	{
+		kern_colmeta *cmeta = &kds->colmeta[j];
+
+		if (cmeta->nullmap_offset != 0)
+		{
+			sz = MAXALIGN(BITMAPLEN(nrooms));
+			cmeta->nullmap_offset = __kds_packed(off);
+			cmeta->nullmap_length = __kds_packed(sz);
+			off += sz;
+		}
+		if (cmeta->attlen > 0)
+			sz = MAXALIGN(TYPEALIGN(cmeta->attalign,
+									cmeta->attlen) * (size_t)nrooms);
+		else
+			sz = MAXALIGN(sizeof(uint32) * (size_t)nrooms);
+		cmeta->values_offset = __kds_packed(off);
+		cmeta->values_length = __kds_packed(sz);
+		off += sz;
+	}
+	/* system column */
+	{
+		kern_colmeta *cmeta = &kds->colmeta[kds->nr_colmeta - 1];
+
+		sz = MAXALIGN(cmeta->attlen * (size_t)nrooms);
+		cmeta->values_offset = __kds_packed(off);
+		cmeta->values_length = __kds_packed(sz);
+		off += sz;
+	}
+	kds->length = off;
+	kds->nrooms = nrooms;
+}
+
+/*
+ * __gpuCacheExpandCopyArray
+ */
+static void
+__gpuCacheExpandCopyArray(CUdeviceptr m_new_main, cl_uint new_offset,
+						  cl_uint new_length,
+						  CUdeviceptr m_old_main, cl_uint old_offset,
+						  cl_uint old_length)
+{
+	CUresult	rc;
+
+	Assert(__kds_unpack(new_length) >= __kds_unpack(old_length));
+	rc = cuMemcpyDtoD(m_new_main + __kds_unpack(new_offset),
+					  m_old_main + __kds_unpack(old_offset),
+					  __kds_unpack(old_length));
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemcpyDtoD: %s", errorText(rc));
+	/* new rows are invalid (or NULL) */
+	rc = cuMemsetD8(m_new_main + __kds_unpack(new_offset) +
+					__kds_unpack(old_length), 0,
+					__kds_unpack(new_length) - __kds_unpack(old_length));
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemsetD8: %s", errorText(rc));
+}
+
+/*
+ * gpuCacheBgWorkerExpandMainBuffer
+ *
+ * It expands the main buffer twice when REDO logs try to allocate more rows
+ * than the current nrooms, instead of marking the GPU cache corrupted.
+ * The new buffer is built by copy of the column arrays and the rowid hash
+ * under the shared lock if the old buffer is a private copy of BgWorker, so
+ * readers can continue to map the published version during the copy.
+ *
+ * Caller must hold exclusive lock on gc_sstate->gpu_buffer_lock, and it is
+ * held on return also. Only this bgworker modifies the GPU buffers, so the
+ * old buffer is never updated during the copy.
+ */
+static CUresult
+gpuCacheBgWorkerExpandMainBuffer(GpuCacheSharedState *gc_sstate)
+{
+	kern_data_store *kds_old = &gc_sstate->kds_head;
+	kern_data_store *kds_new;
+	kern_gpucache_rowhash h_rowhash;
+	CUdeviceptr	m_old_main = gc_sstate->gpu_main_devptr;
+	CUdeviceptr	m_new_main = 0UL;
+	CUipcMemHandle new_mhandle;
+	uint64		new_nrooms;
+	uint32		old_nrooms = kds_old->nrooms;
+	uint32		nitems;
+	size_t		head_sz = KERN_DATA_STORE_HEAD_LENGTH(kds_old);
+	size_t		main_sz;
+	size_t		rowhash_sz;
+	bool		downgrade;
+	int			grid_sz, block_sz;
+	void	   *kern_args[2];
+	CUresult	rc;
+
+	if (m_old_main == 0UL)
+		return CUDA_ERROR_NOT_READY;
+	new_nrooms = Min(2 * (uint64)old_nrooms, (uint64)UINT_MAX - 1);
+	if (new_nrooms <= old_nrooms)
+		return CUDA_ERROR_OUT_OF_MEMORY;
+
+	kds_new = alloca(head_sz);
+	memcpy(kds_new, kds_old, head_sz);
+	__gpuCacheRelayoutKdsHead(kds_new, new_nrooms);
+	if (kds_new->length >= KDS_OFFSET_MAX_SIZE)
+	{
+		elog(LOG, "gpucache: unable to expand main buffer of %s:%lx more (nrooms=%u)",
+			 gc_sstate->table_name,
+			 gc_sstate->signature,
+			 old_nrooms);
+		return CUDA_ERROR_OUT_OF_MEMORY;
+	}
+	main_sz = __gpuCacheMainBufferSize(kds_new, gc_sstate->index_colidx >= 0);
+	rc = cuMemAlloc(&m_new_main, main_sz);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuMemAlloc(%zu): %s",
+			 main_sz, errorText(rc));
+		return rc;
+	}
+	rc = cuIpcGetMemHandle(&new_mhandle, m_new_main);
+	if (rc != CUDA_SUCCESS)
+	{
+		cuMemFree(m_new_main);
+		elog(LOG, "gpucache: failed on cuIpcGetMemHandle: %s", errorText(rc));
+		return rc;
+	}
+
+	/*
+	 * readers can map the published version during the copy, unless the
+	 * REDO logs are applied in place on the published main buffer
+	 */
+	downgrade = (m_old_main != gc_sstate->gpu_versions[gc_sstate->gpu_curr_version].main_devptr);
+	if (downgrade)
+	{
+		pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+		pthreadRWLockReadLock(&gc_sstate->gpu_buffer_lock);
+	}
+
+	rc = cuMemcpyDtoH(&nitems, m_old_main + offsetof(kern_data_store, nitems),
+					  sizeof(uint32));
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemcpyDtoH: %s", errorText(rc));
+	kds_new->nitems = nitems;
+	rc = cuMemcpyHtoD(m_new_main, kds_new, head_sz);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+
+	/* column arrays, including the system column */
+	for (int j=0; j < kds_old->nr_colmeta; j++)
+	{
+		kern_colmeta *cmeta_old = &kds_old->colmeta[j];
+		kern_colmeta *cmeta_new = &kds_new->colmeta[j];
+
+		if (j >= kds_old->ncols && j < kds_old->nr_colmeta - 1)
+			continue;	/* sub-fields have no arrays */
+		if (cmeta_old->nullmap_offset != 0)
+			__gpuCacheExpandCopyArray(m_new_main,
+									  cmeta_new->nullmap_offset,
+									  cmeta_new->nullmap_length,
+									  m_old_main,
+									  cmeta_old->nullmap_offset,
+									  cmeta_old->nullmap_length);
+		if (cmeta_old->values_offset != 0)
+			__gpuCacheExpandCopyArray(m_new_main,
+									  cmeta_new->values_offset,
+									  cmeta_new->values_length,
+									  m_old_main,
+									  cmeta_old->values_offset,
+									  cmeta_old->values_length);
+	}
+
+	/* rowid hash-slot and rowid link list */
+	rowhash_sz = offsetof(kern_gpucache_rowhash, slots[kds_old->nslots]);
+	rc = cuMemcpyDtoD(m_new_main + kds_new->length,
+					  m_old_main + kds_old->length,
+					  rowhash_sz + sizeof(uint32) * old_nrooms);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemcpyDtoD: %s", errorText(rc));
+
+	rc = __gpuOptimalBlockSize(&grid_sz,
+							   &block_sz,
+							   gcache_kfunc_expand_rowmap,
+							   gc_sstate->cuda_dindex,
+							   0, 0);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on __gpuOptimalBlockSize: %s", errorText(rc));
+	grid_sz = Min(grid_sz, (new_nrooms - old_nrooms +
+							block_sz - 1) / block_sz);
+	kern_args[0] = &m_new_main;
+	kern_args[1] = &old_nrooms;
+	rc = cuLaunchKernel(gcache_kfunc_expand_rowmap,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+
+	/* the new rowid are linked to the head of the freelist */
+	rc = cuMemcpyDtoH(&h_rowhash, m_new_main + kds_new->length,
+					  offsetof(kern_gpucache_rowhash, slots));
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemcpyDtoH: %s", errorText(rc));
+	Assert(h_rowhash.magic == KERN_GPUCACHE_ROWHASH_MAGIC);
+	h_rowhash.nrooms = new_nrooms;
+	for (int k=0; k < KERN_GPUCACHE_FREE_WIDTH; k++)
+	{
+		if (old_nrooms + k < new_nrooms)
+			h_rowhash.freelist[k] = old_nrooms + k;
+	}
+	rc = cuMemcpyHtoD(m_new_main + kds_new->length, &h_rowhash,
+					  offsetof(kern_gpucache_rowhash, slots));
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+
+	/* hash index is not valid until rebuild after the REDO logs apply */
+	if (gc_sstate->index_colidx >= 0)
+	{
+		size_t	offset = ((char *)kds_get_gpucache_colindex(kds_new) -
+						  (char *)kds_new);
+
+		rc = cuMemsetD32(m_new_main + offset, 0,
+						 offsetof(kern_gpucache_colindex, slots) / sizeof(uint32));
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuMemsetD32: %s", errorText(rc));
+	}
+
+	/* switch the main buffer */
+	if (downgrade)
+	{
+		pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+		pthreadRWLockWriteLock(&gc_sstate->gpu_buffer_lock);
+	}
+
+	elog(LOG, "gpucache: main buffer expansion (%s:%lx) {nrooms=%u->%lu, length=%zu->%zu}",
+		 gc_sstate->table_name,
+		 gc_sstate->signature,
+		 old_nrooms, new_nrooms,
+		 gc_sstate->gpu_main_size, main_sz);
+
+	memcpy(kds_old, kds_new, head_sz);
+	kds_old->nitems = 0;
+	gc_sstate->max_num_rows = new_nrooms;
+	gc_sstate->gpu_main_devptr = m_new_main;
+	gc_sstate->gpu_main_size = main_sz;
+	memcpy(&gc_sstate->gpu_main_mhandle, &new_mhandle, sizeof(CUipcMemHandle));
+	/* exported IPC handles become stale */
+	SpinLockAcquire(&gc_sstate->redo_lock);
+	gc_sstate->redo_generation =
+		pg_atomic_add_fetch_u64(&gcache_shared_head->gcache_generation, 1);
+	SpinLockRelease(&gc_sstate->redo_lock);
+
+	/* readers may still pin the old buffer */
+	__gpuCacheBgWorkerRetireBuffer(gc_sstate, m_old_main);
+	return CUDA_SUCCESS;
+}
+
 /*
  * GCACHE_BGWORKER_CMD__APPLY_REDO command
  */
@@ -3261,19 +6048,48 @@ __gpuCacheSetupRedoLogBuffer(GpuCacheSharedState *gc_sstate, uint64 end_pos,
 	CUresult		rc;
 
 	SpinLockAcquire(&gc_sstate->redo_lock);
-	if (end_pos <= gc_sstate->redo_read_pos)
+	head_pos = pg_atomic_read_u64(&gc_sstate->redo_read_pos);
+	SpinLockRelease(&gc_sstate->redo_lock);
+	if (end_pos <= head_pos)
 	{
-		SpinLockRelease(&gc_sstate->redo_lock);
 		*p_m_redo = 0UL;		/* nothing to do */
 		return CUDA_SUCCESS;
 	}
-	nitems = (gc_sstate->redo_write_nitems -
-			  gc_sstate->redo_read_nitems);
-	head_pos = gc_sstate->redo_read_pos;
-	tail_pos = gc_sstate->redo_write_pos;
-	Assert(head_pos <= tail_pos);
-	Assert(end_pos <= gc_sstate->redo_write_pos);
-	SpinLockRelease(&gc_sstate->redo_lock);
+	Assert(end_pos <= pg_atomic_read_u64(&gc_sstate->redo_write_pos));
+
+	/*
+	 * Walk on the log items published contiguously from the head. The space
+	 * until @end_pos was already reserved, so writers shall publish them
+	 * very soon, even if not yet. Log items beyond the @end_pos are also
+	 * consumed as long as they are already published.
+	 */
+	nitems = 0;
+	curr_pos = head_pos;
+	for (;;)
+	{
+		GCacheTxLogCommon *tx_log;
+		uint64		__curr_pos = (curr_pos % gc_sstate->redo_buffer_size);
+		cl_uint		type;
+
+		if (curr_pos >= pg_atomic_read_u64(&gc_sstate->redo_write_pos))
+			break;
+		tx_log = (GCacheTxLogCommon *)(base + __curr_pos);
+		type = *((volatile cl_uint *)&tx_log->type);
+		if ((type & 0xffffff00U) != GCACHE_TX_LOG__MAGIC)
+		{
+			if (curr_pos >= end_pos)
+				break;
+			SPIN_DELAY();
+			continue;
+		}
+		pg_read_barrier();
+		Assert(__curr_pos + tx_log->length <= gc_sstate->redo_buffer_size);
+		Assert(tx_log->length == MAXALIGN(tx_log->length));
+		if (type != GCACHE_TX_LOG__PADDING)
+			nitems++;
+		curr_pos += tx_log->length;
+	}
+	tail_pos = curr_pos;
 
 	/*
 	 * allocation of managed memory for kern_gpucache_redolog
@@ -3296,33 +6112,31 @@ __gpuCacheSetupRedoLogBuffer(GpuCacheSharedState *gc_sstate, uint64 end_pos,
 							   log_index[nitems]));
 	index = 0;
 	curr_pos = head_pos;
-	while (curr_pos < tail_pos && index < nitems)
+	while (curr_pos < tail_pos)
 	{
 		GCacheTxLogCommon *tx_log;
 		uint64		__curr_pos = (curr_pos % gc_sstate->redo_buffer_size);
 
 		tx_log = (GCacheTxLogCommon *)(base + __curr_pos);
-		if (__curr_pos + offsetof(GCacheTxLogCommon,
-								  data) > gc_sstate->redo_buffer_size ||
-			(tx_log->type & 0xffffff00U) != GCACHE_TX_LOG__MAGIC)
+		if (tx_log->type != GCACHE_TX_LOG__PADDING)
 		{
-			curr_pos += (gc_sstate->redo_buffer_size - __curr_pos);
-			continue;
+			Assert(index < nitems);
+			memcpy((char *)h_redo + offset, tx_log, tx_log->length);
+			h_redo->log_index[index++] = __kds_packed(offset);
+			offset += tx_log->length;
 		}
-		Assert(__curr_pos + tx_log->length <= gc_sstate->redo_buffer_size);
-		Assert(tx_log->length == MAXALIGN(tx_log->length));
-		memcpy((char *)h_redo + offset, tx_log, tx_log->length);
-		h_redo->log_index[index++] = __kds_packed(offset);
-		offset += tx_log->length;
 		curr_pos += tx_log->length;
 	}
+	/* release the consumed area for the writers */
+	__gpuCacheClearRedoBuffer(gc_sstate, head_pos, tail_pos);
+	pg_write_barrier();
+
 	/* update redo_read_xxxx */
 	SpinLockAcquire(&gc_sstate->redo_lock);
 	gc_sstate->redo_read_nitems += nitems;
-	gc_sstate->redo_read_pos = tail_pos;
-	if (gc_sstate->redo_sync_pos < tail_pos)
-		gc_sstate->redo_sync_pos = tail_pos;
+	pg_atomic_write_u64(&gc_sstate->redo_read_pos, tail_pos);
 	SpinLockRelease(&gc_sstate->redo_lock);
+	__gpuCacheAdvanceRedoSyncPos(gc_sstate, tail_pos);
 
 	if (index == 0)
 	{
@@ -3338,28 +6152,85 @@ __gpuCacheSetupRedoLogBuffer(GpuCacheSharedState *gc_sstate, uint64 end_pos,
 	return CUDA_SUCCESS;
 }
 
-static CUresult
-__gpuCacheLaunchApplyRedoKernel(GpuCacheSharedState *gc_sstate, CUdeviceptr m_redo)
+/*
+ * __gpuCacheLaunchSortRedoKernel
+ *
+ * It sorts the INS/DEL log entries by the rowid using bitonic-sorting, so
+ * the apply phase updates the column arrays in coalesced order, and resolves
+ * the last write for each row without atomic operations.
+ */
+static void
+__gpuCacheLaunchSortRedoKernel(GpuCacheSharedState *gc_sstate,
+							   CUdeviceptr m_sort_keys, uint32 nkeys)
 {
-	kern_gpucache_redolog *h_redo = (kern_gpucache_redolog *)m_redo;
+	int			grid_sz, block_sz;
+	void	   *kern_args[4];
+	uint32		k, j;
+	CUresult	rc;
+
+	rc = __gpuOptimalBlockSize(&grid_sz,
+							   &block_sz,
+							   gcache_kfunc_sort_redo,
+							   gc_sstate->cuda_dindex, 0, 0);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on __gpuOptimalBlockSize: %s", errorText(rc));
+	grid_sz = Max(Min(grid_sz, (nkeys / 2 + block_sz - 1) / block_sz), 1);
+
+	for (k = 2; k <= nkeys; k *= 2)
+	{
+		for (j = k / 2; j > 0; j /= 2)
+		{
+			kern_args[0] = &m_sort_keys;
+			kern_args[1] = &nkeys;
+			kern_args[2] = &k;
+			kern_args[3] = &j;
+			rc = cuLaunchKernel(gcache_kfunc_sort_redo,
+								grid_sz, 1, 1,
+								block_sz, 1, 1,
+								0,
+								CU_STREAM_PER_THREAD,
+								kern_args,
+								NULL);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+		}
+	}
+}
+
+static CUresult
+__gpuCacheLaunchApplyRedoKernel(GpuCacheSharedState *gc_sstate, CUdeviceptr m_redo)
+{
+	kern_gpucache_redolog *h_redo = (kern_gpucache_redolog *)m_redo;
 	int			cuda_dindex = gc_sstate->cuda_dindex;
 	int			grid_sz, block_sz;
 	int			phase;
-	void	   *kern_args[4];
+	void	   *kern_args[5];
+	CUdeviceptr	m_sort_keys = 0UL;
+	uint32		nkeys = (1U << get_next_log2(h_redo->nitems));
 	CUresult	rc;
 
 	rc = __gpuOptimalBlockSize(&grid_sz,
 							   &block_sz,
 							   gcache_kfunc_apply_redo,
 							   cuda_dindex, 0, 0);
-	grid_sz = Min(grid_sz, (h_redo->nitems + block_sz - 1) / block_sz);
+	grid_sz = Min(grid_sz, (nkeys + block_sz - 1) / block_sz);
+
+	/* on allocation failure, INS/DEL log entries are applied in log order */
+	rc = cuMemAlloc(&m_sort_keys, sizeof(uint64) * nkeys);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuMemAlloc(%zu) for the sort keys: %s",
+			 sizeof(uint64) * nkeys, errorText(rc));
+		m_sort_keys = 0UL;
+	}
 retry:
 	for (phase = 0; phase <= 6; phase++)
 	{
 		kern_args[0] = &m_redo;
 		kern_args[1] = &gc_sstate->gpu_main_devptr;
 		kern_args[2] = &gc_sstate->gpu_extra_devptr;
-		kern_args[3] = &phase;
+		kern_args[3] = &m_sort_keys;
+		kern_args[4] = &phase;
 
 		rc = cuLaunchKernel(gcache_kfunc_apply_redo,
 							grid_sz, 1, 1,
@@ -3370,6 +6241,8 @@ retry:
 							NULL);
 		if (rc != CUDA_SUCCESS)
 			elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+		if (phase == 2 && m_sort_keys != 0UL)
+			__gpuCacheLaunchSortRedoKernel(gc_sstate, m_sort_keys, nkeys);
 	}
 
 	/* check status of the above kernel execution */
@@ -3388,11 +6261,24 @@ retry:
 		memset(&h_redo->kerror, 0, sizeof(kern_errorbuf));
 		goto retry;
 	}
+	if (h_redo->kerror.errcode == ERRCODE_STROM_DATASTORE_NOSPACE &&
+		gpuCacheBgWorkerExpandMainBuffer(gc_sstate) == CUDA_SUCCESS)
+	{
+		memset(&h_redo->kerror, 0, sizeof(kern_errorbuf));
+		goto retry;
+	}
+	if (m_sort_keys != 0UL)
+	{
+		rc = cuMemFree(m_sort_keys);
+		if (rc != CUDA_SUCCESS)
+			elog(LOG, "gpucache: failed on cuMemFree: %s", errorText(rc));
+	}
 
 	/*
 	 * On error of the kern_gpucache_apply_redo(), we cannot determine
 	 * whether the GPU cache is still consistent state, or not.
-	 * (Likely, REDO Log tried to use more rows than the max_num_rows)
+	 * (Likely, REDO Log tried to use more rows than the main buffer can
+	 * hold even after the expansion)
 	 * So, we once block the GPU cache until pgstrom.gpucache_apply_redo()
 	 * by manual.
 	 */
@@ -3404,7 +6290,7 @@ retry:
 		 * that takes ShareRowExclusiveLock, so re-initialization process will
 		 * have no concurrent writer.
 		 */
-		pg_atomic_write_u32(&gc_sstate->gpu_buffer_corrupted, 1);
+		gpuCacheMarkCorrupted(gc_sstate);
 
 		ereport(WARNING,
 				(errmsg("gpucache: table [%s:%lx] of database=%u - unable to apply REDO logs to GPU cache, so marked as corrupted.",
@@ -3413,6 +6299,7 @@ retry:
 						gc_sstate->database_oid),
 				 errhint("try pgstrom.gpucache_recovery(regclass) after the fixup of table contents or configuration")));
 
+		gpuCacheBgWorkerUnpublishAll(gc_sstate);
 		if (gc_sstate->gpu_main_devptr != 0UL)
 		{
 			rc = cuMemFree(gc_sstate->gpu_main_devptr);
@@ -3440,6 +6327,11 @@ retry:
 
 		return CUDA_ERROR_NOT_READY;
 	}
+
+	/* rebuild the hash index according to the new contents */
+	rc = gpuCacheBuildColIndex(gc_sstate, gc_sstate->gpu_main_devptr);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuCacheBuildColIndex: %s", errorText(rc));
 	return CUDA_SUCCESS;
 }
 
@@ -3447,13 +6339,14 @@ static CUresult
 gpuCacheBgWorkerApplyRedoLog(GpuCacheSharedState *gc_sstate, uint64 end_pos)
 {
 	CUdeviceptr	m_redo = 0UL;
+	TimestampTz	tv_start = GetCurrentTimestamp();
 	CUresult	rc, __rc;
 
 	rc = gpuCacheLoadCudaModule();
 	if (rc != CUDA_SUCCESS)
 		return rc;
 
-	pthreadRWLockWriteLock(&gc_sstate->gpu_buffer_lock);
+	gpuCacheWriteLock(gc_sstate);
 	PG_TRY();
 	{
 		if (pg_atomic_read_u32(&gc_sstate->gpu_buffer_corrupted))
@@ -3471,18 +6364,27 @@ gpuCacheBgWorkerApplyRedoLog(GpuCacheSharedState *gc_sstate, uint64 end_pos)
 			goto out_unlock;
 		if (m_redo != 0UL)
 		{
+			gpuCacheBgWorkerPrepareUpdate(gc_sstate);
 			rc = __gpuCacheLaunchApplyRedoKernel(gc_sstate, m_redo);
 
 			__rc = cuMemFree(m_redo);
 			if (__rc != CUDA_SUCCESS)
 				elog(LOG, "failed on cuMemFree: %s", errorText(__rc));
 		}
+		if (rc == CUDA_SUCCESS && gpuCacheWindowEvictIsDue(gc_sstate, tv_start))
+		{
+			gpuCacheBgWorkerPrepareUpdate(gc_sstate);
+			rc = gpuCacheBgWorkerEvictWindow(gc_sstate, tv_start);
+		}
+		gpuCacheBgWorkerPublishVersion(gc_sstate);
+		if (m_redo != 0UL && rc == CUDA_SUCCESS)
+			gpuCacheStatApplyRedo(gc_sstate, tv_start);
 	out_unlock:
 		pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
 	}
 	PG_CATCH();
 	{
-		pg_atomic_write_u32(&gc_sstate->gpu_buffer_corrupted, 1);
+		gpuCacheMarkCorrupted(gc_sstate);
 		pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
 		PG_RE_THROW();
 	}
@@ -3494,6 +6396,7 @@ gpuCacheBgWorkerApplyRedoLog(GpuCacheSharedState *gc_sstate, uint64 end_pos)
 static CUresult
 gpuCacheBgWorkerDropUnload(GpuCacheSharedState *gc_sstate)
 {
+	char		fname[MAXPGPATH];
 	CUresult	rc;
 
 	pthreadRWLockWriteLock(&gc_sstate->gpu_buffer_lock);
@@ -3504,6 +6407,7 @@ gpuCacheBgWorkerDropUnload(GpuCacheSharedState *gc_sstate)
 		 gc_sstate->gpu_extra_size);
 	if (gc_sstate->gpu_main_devptr != 0UL || gc_sstate->gpu_extra_devptr != 0UL)
 	{
+		gpuCacheBgWorkerUnpublishAll(gc_sstate);
 		if (gc_sstate->gpu_main_devptr != 0UL)
 		{
 			rc = cuMemFree(gc_sstate->gpu_main_devptr);
@@ -3522,6 +6426,10 @@ gpuCacheBgWorkerDropUnload(GpuCacheSharedState *gc_sstate)
 			gc_sstate->gpu_extra_size = 0;
 			memset(&gc_sstate->gpu_extra_mhandle, 0, sizeof(CUipcMemHandle));
 		}
+		/* checkpoint of the dropped contents is no longer valid */
+		if (gpuCacheCheckpointFileName(fname, sizeof(fname), gc_sstate) &&
+			unlink(fname) != 0 && errno != ENOENT)
+			elog(LOG, "gpucache: failed on unlink('%s'): %m", fname);
 		/* decrement, but shall not become zero here */
 		SpinLockAcquire(&gcache_shared_head->gcache_sstate_lock);
 		Assert(gc_sstate->refcnt >= 4);
@@ -3533,6 +6441,467 @@ gpuCacheBgWorkerDropUnload(GpuCacheSharedState *gc_sstate)
 	return CUDA_SUCCESS;
 }
 
+/*
+ * GCACHE_BGWORKER_CMD__CHECKPOINT command
+ */
+static bool
+__gpuCacheCheckpointWriteDevice(int fdesc, const char *fname,
+								char *hbuf, off_t f_pos,
+								CUdeviceptr m_devptr,
+								size_t dev_sz, size_t file_sz)
+{
+	size_t		offset = 0;
+	CUresult	rc;
+
+	while (offset < file_sz)
+	{
+		size_t	nbytes = Min(file_sz - offset, GPUCACHE_CHECKPOINT_CHUNK_SZ);
+		size_t	ncopy = (offset < dev_sz ? Min(nbytes, dev_sz - offset) : 0);
+
+		if (ncopy > 0)
+		{
+			rc = cuMemcpyDtoH(hbuf, m_devptr + offset, ncopy);
+			if (rc != CUDA_SUCCESS)
+			{
+				elog(LOG, "gpucache: failed on cuMemcpyDtoH: %s", errorText(rc));
+				return false;
+			}
+		}
+		if (ncopy < nbytes)
+			memset(hbuf + ncopy, 0, nbytes - ncopy);
+		if (__pwriteFile(fdesc, hbuf, nbytes, f_pos + offset) != nbytes)
+		{
+			elog(LOG, "gpucache: failed on write('%s'): %m", fname);
+			return false;
+		}
+		offset += nbytes;
+	}
+	return true;
+}
+
+static CUresult
+gpuCacheBgWorkerCheckpoint(GpuCacheSharedState *gc_sstate)
+{
+	GpuCacheCheckpointHeader head;
+	kern_data_extra	h_extra;
+	char		fname[MAXPGPATH];
+	char		tname[MAXPGPATH];
+	char	   *hbuf = NULL;
+	uint64		generation;
+	uint64		end_pos;
+	int			fdesc = -1;
+	bool		is_valid = false;
+	CUresult	rc;
+
+	if (!gc_sstate->checkpoint_enabled ||
+		!gpuCacheCheckpointFileName(fname, sizeof(fname), gc_sstate))
+		return CUDA_SUCCESS;
+	if (RecoveryInProgress())
+		return CUDA_ERROR_NOT_READY;
+
+	/*
+	 * WAL position and the oldest running xid must be taken prior to the
+	 * REDO log position to be applied, because restore process assumes
+	 * any changes on the heap until @checkpoint_lsn are already on the
+	 * checkpoint, unless the tuple is touched by the transactions newer
+	 * than @oldest_xid.
+	 */
+	memset(&head, 0, sizeof(GpuCacheCheckpointHeader));
+	head.magic        = GPUCACHE_CHECKPOINT_MAGIC;
+	head.version      = GPUCACHE_CHECKPOINT_VERSION;
+	head.database_oid = gc_sstate->database_oid;
+	head.table_oid    = gc_sstate->table_oid;
+	head.signature    = gc_sstate->signature;
+	head.oldest_xid   = GetOldestActiveTransactionId();
+	head.checkpoint_lsn = GetXLogInsertRecPtr();
+	head.timestamp    = GetCurrentTimestamp();
+
+	SpinLockAcquire(&gcache_shared_head->gcache_sstate_lock);
+	is_valid = (gc_sstate->initial_loading == 0);
+	SpinLockRelease(&gcache_shared_head->gcache_sstate_lock);
+	if (!is_valid)
+		return CUDA_ERROR_NOT_READY;
+
+	SpinLockAcquire(&gc_sstate->redo_lock);
+	generation = gc_sstate->redo_generation;
+	end_pos = gpuCacheAdvanceSyncPos(gc_sstate, NULL);
+	gc_sstate->checkpoint_timestamp = head.timestamp;
+	SpinLockRelease(&gc_sstate->redo_lock);
+
+	rc = gpuCacheBgWorkerApplyRedoLog(gc_sstate, end_pos);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	/* the checkpoint must not be ahead of WAL after crash */
+	XLogFlush(head.checkpoint_lsn);
+
+	rc = cuMemAllocHost((void **)&hbuf, GPUCACHE_CHECKPOINT_CHUNK_SZ);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuMemAllocHost: %s", errorText(rc));
+		return rc;
+	}
+	if (mkdir(gpucache_checkpoint_dir, pg_dir_create_mode) != 0 &&
+		errno != EEXIST)
+	{
+		elog(LOG, "gpucache: failed on mkdir('%s'): %m",
+			 gpucache_checkpoint_dir);
+		rc = CUDA_ERROR_OPERATING_SYSTEM;
+		goto out;
+	}
+	snprintf(tname, sizeof(tname), "%s.%d.tmp", fname, MyProcPid);
+	fdesc = open(tname, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY,
+				 pg_file_create_mode);
+	if (fdesc < 0)
+	{
+		elog(LOG, "gpucache: failed on open('%s'): %m", tname);
+		rc = CUDA_ERROR_OPERATING_SYSTEM;
+		goto out;
+	}
+
+	is_valid = false;
+	pthreadRWLockReadLock(&gc_sstate->gpu_buffer_lock);
+	if (pg_atomic_read_u32(&gc_sstate->gpu_buffer_corrupted) != 0 ||
+		gc_sstate->gpu_main_devptr == 0UL)
+		rc = CUDA_ERROR_NOT_READY;
+	else
+	{
+		head.main_offset = PAGE_SIZE;
+		head.main_size = gc_sstate->gpu_main_size;
+		if (gc_sstate->gpu_extra_devptr != 0UL)
+		{
+			rc = cuMemcpyDtoH(&h_extra, gc_sstate->gpu_extra_devptr,
+							  offsetof(kern_data_extra, data));
+			if (rc != CUDA_SUCCESS)
+				elog(LOG, "gpucache: failed on cuMemcpyDtoH: %s", errorText(rc));
+			head.extra_offset = head.main_offset + head.main_size;
+			head.extra_size   = PAGE_ALIGN(h_extra.usage);
+			head.extra_length = gc_sstate->gpu_extra_size;
+		}
+		if (rc == CUDA_SUCCESS)
+		{
+			memset(hbuf, 0, PAGE_SIZE);
+			memcpy(hbuf, &head, sizeof(GpuCacheCheckpointHeader));
+			if (__pwriteFile(fdesc, hbuf, PAGE_SIZE, 0) != PAGE_SIZE)
+				elog(LOG, "gpucache: failed on write('%s'): %m", tname);
+			else if (__gpuCacheCheckpointWriteDevice(fdesc, tname, hbuf,
+													 head.main_offset,
+													 gc_sstate->gpu_main_devptr,
+													 head.main_size,
+													 head.main_size) &&
+					 (head.extra_size == 0 ||
+					  __gpuCacheCheckpointWriteDevice(fdesc, tname, hbuf,
+													  head.extra_offset,
+													  gc_sstate->gpu_extra_devptr,
+													  Min(h_extra.usage,
+														  head.extra_length),
+													  head.extra_size)))
+				is_valid = true;
+		}
+	}
+	pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+
+	/* GPU cache might be reloaded during the checkpoint */
+	SpinLockAcquire(&gc_sstate->redo_lock);
+	if (gc_sstate->redo_generation != generation)
+		is_valid = false;
+	SpinLockRelease(&gc_sstate->redo_lock);
+
+	if (!is_valid)
+	{
+		close(fdesc);
+		fdesc = -1;
+		unlink(tname);
+		if (rc == CUDA_SUCCESS)
+			rc = CUDA_ERROR_OPERATING_SYSTEM;
+		goto out;
+	}
+	if (pg_fsync(fdesc) != 0)
+	{
+		elog(LOG, "gpucache: failed on fsync('%s'): %m", tname);
+		close(fdesc);
+		fdesc = -1;
+		unlink(tname);
+		rc = CUDA_ERROR_OPERATING_SYSTEM;
+		goto out;
+	}
+	close(fdesc);
+	fdesc = -1;
+	if (durable_rename(tname, fname, LOG) != 0)
+	{
+		unlink(tname);
+		rc = CUDA_ERROR_OPERATING_SYSTEM;
+		goto out;
+	}
+
+	SpinLockAcquire(&gc_sstate->redo_lock);
+	gc_sstate->checkpoint_generation = generation;
+	gc_sstate->checkpoint_redo_pos = end_pos;
+	SpinLockRelease(&gc_sstate->redo_lock);
+
+	elog(LOG, "gpucache: checkpoint %s:%lx on '%s' (lsn=%X/%X, main_sz=%zu, extra_sz=%zu)",
+		 gc_sstate->table_name,
+		 gc_sstate->signature,
+		 fname,
+		 (uint32)(head.checkpoint_lsn >> 32),
+		 (uint32)(head.checkpoint_lsn),
+		 head.main_size,
+		 head.extra_size);
+out:
+	if (fdesc >= 0)
+		close(fdesc);
+	cuMemFreeHost(hbuf);
+	return rc;
+}
+
+/*
+ * __gpuCacheCheckpointIsRequired
+ *
+ * caller must hold gc_sstate->redo_lock
+ */
+static inline bool
+__gpuCacheCheckpointIsRequired(GpuCacheSharedState *gc_sstate)
+{
+	return (gc_sstate->checkpoint_enabled &&
+			(gc_sstate->checkpoint_generation != gc_sstate->redo_generation ||
+			 gc_sstate->checkpoint_redo_pos != pg_atomic_read_u64(&gc_sstate->redo_write_pos)));
+}
+
+/*
+ * GCACHE_BGWORKER_CMD__RESTORE command
+ */
+static bool
+__gpuCacheRestoreByGPUDirect(const char *fname,
+							 CUdeviceptr m_devptr,
+							 size_t f_pos, size_t length)
+{
+	GPUDirectFileDesc gds_fdesc;
+	strom_io_vector *iovec;
+	volatile unsigned long iomap_handle = 0UL;
+	volatile bool	fdesc_opened = false;
+	MemoryContext	memcxt = CurrentMemoryContext;
+	uint32			nchunks;
+	uint32			i;
+	bool			retval = true;
+	CUresult		rc;
+
+	Assert(f_pos == PAGE_ALIGN(f_pos) && length == PAGE_ALIGN(length));
+	nchunks = (length + GPUCACHE_CHECKPOINT_CHUNK_SZ - 1) / GPUCACHE_CHECKPOINT_CHUNK_SZ;
+	iovec = alloca(offsetof(strom_io_vector, ioc[nchunks]));
+	iovec->nr_chunks = nchunks;
+	for (i=0; i < nchunks; i++)
+	{
+		strom_io_chunk *ioc = &iovec->ioc[i];
+		size_t		offset = (size_t)i * GPUCACHE_CHECKPOINT_CHUNK_SZ;
+
+		ioc->m_offset  = offset;
+		ioc->fchunk_id = (f_pos + offset) / PAGE_SIZE;
+		ioc->nr_pages  = Min(length - offset,
+							 GPUCACHE_CHECKPOINT_CHUNK_SZ) / PAGE_SIZE;
+	}
+
+	PG_TRY();
+	{
+		unsigned long	__iomap_handle;
+
+		gpuDirectFileDescOpenByPath(&gds_fdesc, fname);
+		fdesc_opened = true;
+		rc = gpuDirectMapGpuMemory(m_devptr, length, &__iomap_handle);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuDirectMapGpuMemory: %s", errorText(rc));
+		iomap_handle = __iomap_handle;
+		gpuDirectFileReadIOV(&gds_fdesc, m_devptr, iomap_handle, 0, iovec);
+	}
+	PG_CATCH();
+	{
+		ErrorData  *errdata;
+
+		MemoryContextSwitchTo(memcxt);
+		errdata = CopyErrorData();
+		FlushErrorState();
+		elog(LOG, "gpucache: failed on GPUDirect read of '%s' (%s), try again by read(2)",
+			 fname, errdata->message);
+		FreeErrorData(errdata);
+		retval = false;
+	}
+	PG_END_TRY();
+
+	if (iomap_handle != 0UL)
+	{
+		rc = gpuDirectUnmapGpuMemory(m_devptr, iomap_handle);
+		if (rc != CUDA_SUCCESS)
+			elog(LOG, "gpucache: failed on gpuDirectUnmapGpuMemory: %s",
+				 errorText(rc));
+	}
+	if (fdesc_opened)
+		gpuDirectFileDescClose(&gds_fdesc);
+	return retval;
+}
+
+static bool
+__gpuCacheRestoreByRead(int fdesc, const char *fname, char *hbuf,
+						CUdeviceptr m_devptr,
+						size_t f_pos, size_t length)
+{
+	size_t		offset = 0;
+	CUresult	rc;
+
+	while (offset < length)
+	{
+		size_t	nbytes = Min(length - offset, GPUCACHE_CHECKPOINT_CHUNK_SZ);
+
+		if (__preadFile(fdesc, hbuf, nbytes, f_pos + offset) != nbytes)
+		{
+			elog(LOG, "gpucache: failed on read('%s'): %m", fname);
+			return false;
+		}
+		rc = cuMemcpyHtoD(m_devptr + offset, hbuf, nbytes);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(LOG, "gpucache: failed on cuMemcpyHtoD: %s", errorText(rc));
+			return false;
+		}
+		offset += nbytes;
+	}
+	return true;
+}
+
+static CUresult
+gpuCacheBgWorkerRestore(GpuCacheSharedState *gc_sstate)
+{
+	GpuCacheCheckpointHeader head;
+	CUdeviceptr	m_main = 0UL;
+	CUdeviceptr	m_extra = 0UL;
+	CUipcMemHandle main_mhandle;
+	CUipcMemHandle extra_mhandle;
+	size_t		extra_sz = 0;
+	char		fname[MAXPGPATH];
+	char	   *hbuf = NULL;
+	int			fdesc = -1;
+	bool		use_gpudirect = pgstrom_gpudirect_enabled();
+	CUresult	rc = CUDA_ERROR_INVALID_VALUE;
+
+	if (!gpuCacheCheckpointFileName(fname, sizeof(fname), gc_sstate))
+		return CUDA_ERROR_NOT_FOUND;
+
+	pthreadRWLockWriteLock(&gc_sstate->gpu_buffer_lock);
+	if (gc_sstate->gpu_main_devptr != 0UL ||
+		gc_sstate->gpu_extra_devptr != 0UL)
+	{
+		elog(LOG, "gpucache: %s:%lx is already loaded, so unable to restore",
+			 gc_sstate->table_name,
+			 gc_sstate->signature);
+		goto out;
+	}
+	fdesc = open(fname, O_RDONLY | PG_BINARY);
+	if (fdesc < 0)
+	{
+		elog(LOG, "gpucache: failed on open('%s'): %m", fname);
+		rc = CUDA_ERROR_FILE_NOT_FOUND;
+		goto out;
+	}
+	if (__preadFile(fdesc, &head, sizeof(head), 0) != sizeof(head) ||
+		!gpuCacheCheckpointValidateHeader(gc_sstate, &head))
+	{
+		elog(LOG, "gpucache: checkpoint file '%s' is not valid", fname);
+		goto out;
+	}
+	rc = cuMemAllocHost((void **)&hbuf, GPUCACHE_CHECKPOINT_CHUNK_SZ);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuMemAllocHost: %s", errorText(rc));
+		goto out;
+	}
+
+	/* main buffer */
+	rc = cuMemAlloc(&m_main, head.main_size);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuMemAlloc(%zu): %s",
+			 head.main_size, errorText(rc));
+		goto out;
+	}
+	if ((!use_gpudirect ||
+		 !__gpuCacheRestoreByGPUDirect(fname, m_main,
+									   head.main_offset,
+									   head.main_size)) &&
+		!__gpuCacheRestoreByRead(fdesc, fname, hbuf, m_main,
+								 head.main_offset,
+								 head.main_size))
+	{
+		rc = CUDA_ERROR_OPERATING_SYSTEM;
+		goto out;
+	}
+	rc = cuIpcGetMemHandle(&main_mhandle, m_main);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(LOG, "gpucache: failed on cuIpcGetMemHandle: %s", errorText(rc));
+		goto out;
+	}
+
+	/* extra buffer, if any */
+	if (head.extra_size > 0)
+	{
+		extra_sz = PAGE_ALIGN(head.extra_length);
+		rc = cuMemAlloc(&m_extra, extra_sz);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(LOG, "gpucache: failed on cuMemAlloc(%zu): %s",
+				 extra_sz, errorText(rc));
+			goto out;
+		}
+		if ((!use_gpudirect ||
+			 !__gpuCacheRestoreByGPUDirect(fname, m_extra,
+										   head.extra_offset,
+										   head.extra_size)) &&
+			!__gpuCacheRestoreByRead(fdesc, fname, hbuf, m_extra,
+									 head.extra_offset,
+									 head.extra_size))
+		{
+			rc = CUDA_ERROR_OPERATING_SYSTEM;
+			goto out;
+		}
+		rc = cuIpcGetMemHandle(&extra_mhandle, m_extra);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(LOG, "gpucache: failed on cuIpcGetMemHandle: %s", errorText(rc));
+			goto out;
+		}
+	}
+
+	elog(LOG, "gpucache: Restore %s:%lx from '%s' (main_sz=%zu, extra_sz=%zu%s)",
+		 gc_sstate->table_name,
+		 gc_sstate->signature,
+		 fname,
+		 head.main_size,
+		 head.extra_size,
+		 use_gpudirect ? ", GPUDirect" : "");
+
+	gc_sstate->gpu_main_size = head.main_size;
+	gc_sstate->gpu_extra_size = head.extra_length;
+	gc_sstate->gpu_main_devptr = m_main;
+	gc_sstate->gpu_extra_devptr = m_extra;
+	memcpy(&gc_sstate->gpu_main_mhandle, &main_mhandle, sizeof(CUipcMemHandle));
+	if (m_extra != 0UL)
+		memcpy(&gc_sstate->gpu_extra_mhandle, &extra_mhandle, sizeof(CUipcMemHandle));
+	m_main = m_extra = 0UL;
+	gpuCacheBgWorkerPublishVersion(gc_sstate);
+
+	SpinLockAcquire(&gcache_shared_head->gcache_sstate_lock);
+	gc_sstate->refcnt += 2;
+	SpinLockRelease(&gcache_shared_head->gcache_sstate_lock);
+out:
+	pthreadRWLockUnlock(&gc_sstate->gpu_buffer_lock);
+	if (m_extra != 0UL)
+		cuMemFree(m_extra);
+	if (m_main != 0UL)
+		cuMemFree(m_main);
+	if (hbuf)
+		cuMemFreeHost(hbuf);
+	if (fdesc >= 0)
+		close(fdesc);
+	return rc;
+}
+
 /*
  * gpuCacheBgWorkerBegin
  */
@@ -3575,7 +6944,8 @@ gpuCacheBgWorkerDispatch(int cuda_dindex)
 	SpinLockAcquire(sstate_lock);
 	gc_sstate = lookupGpuCacheSharedState(cmd->database_oid,
 										  cmd->table_oid,
-										  cmd->signature);
+										  cmd->signature,
+										  cmd->shard_id);
 	if (!gc_sstate)
 	{
 		SpinLockRelease(sstate_lock);
@@ -3614,6 +6984,12 @@ gpuCacheBgWorkerDispatch(int cuda_dindex)
 				case GCACHE_BGWORKER_CMD__DROP_UNLOAD:
 					rc = gpuCacheBgWorkerDropUnload(gc_sstate);
 					break;
+				case GCACHE_BGWORKER_CMD__CHECKPOINT:
+					rc = gpuCacheBgWorkerCheckpoint(gc_sstate);
+					break;
+				case GCACHE_BGWORKER_CMD__RESTORE:
+					rc = gpuCacheBgWorkerRestore(gc_sstate);
+					break;
 				default:
 					rc = CUDA_ERROR_INVALID_VALUE;
 					elog(LOG, "Unexpected GpuCache background command: %d",
@@ -3679,6 +7055,7 @@ gpuCacheBgWorkerIdleTask(int cuda_dindex)
 	dlist_head *free_cmds = &gcache_shared_head->bgworker_free_cmds;
 	dlist_head *cmd_queue = &gcache_shared_head->bgworkers[cuda_dindex].cmd_queue;
 	int			hindex;
+	bool		shrink = gpuMemShrinkRequested(cuda_dindex);
 	bool		retval = true;
 
 	for (hindex = 0; hindex < GPUCACHE_SHARED_DESC_NSLOTS; hindex++)
@@ -3691,6 +7068,8 @@ gpuCacheBgWorkerIdleTask(int cuda_dindex)
 		{
 			GpuCacheSharedState *gc_sstate;
 			uint64		timestamp;
+			uint64		write_pos;
+			uint64		sync_pos;
 
 			gc_sstate = dlist_container(GpuCacheSharedState,
 										chain, iter.cur);
@@ -3699,11 +7078,12 @@ gpuCacheBgWorkerIdleTask(int cuda_dindex)
 
 			SpinLockAcquire(&gc_sstate->redo_lock);
 			timestamp = GetCurrentTimestamp();
-			if ((gc_sstate->redo_write_pos > gc_sstate->redo_sync_pos &&
-				 timestamp > (gc_sstate->redo_write_timestamp +
+			write_pos = pg_atomic_read_u64(&gc_sstate->redo_write_pos);
+			sync_pos  = pg_atomic_read_u64(&gc_sstate->redo_sync_pos);
+			if ((write_pos > sync_pos &&
+				 timestamp > (pg_atomic_read_u64(&gc_sstate->redo_write_timestamp) +
 							  gc_sstate->gpu_sync_interval)) ||
-				(gc_sstate->redo_write_pos > (gc_sstate->redo_sync_pos +
-											  gc_sstate->gpu_sync_threshold)))
+				(write_pos > sync_pos + gc_sstate->gpu_sync_threshold))
 			{
 				SpinLockAcquire(cmd_lock);
 				if (!dlist_is_empty(free_cmds))
@@ -3716,26 +7096,118 @@ gpuCacheBgWorkerIdleTask(int cuda_dindex)
 					cmd->database_oid = gc_sstate->database_oid;
 					cmd->table_oid    = gc_sstate->table_oid;
 					cmd->signature    = gc_sstate->signature;
+					cmd->shard_id     = gc_sstate->shard_id;
 					cmd->backend      = NULL;
 					cmd->command      = GCACHE_BGWORKER_CMD__APPLY_REDO;
-					cmd->end_pos      = gc_sstate->redo_write_pos;
+					cmd->end_pos      = write_pos;
 					cmd->retval       = (CUresult) UINT_MAX;
 
 					dlist_push_tail(cmd_queue, &cmd->chain);
 
-					gc_sstate->redo_sync_pos = gc_sstate->redo_write_pos;
+					__gpuCacheAdvanceRedoSyncPos(gc_sstate, write_pos);
 				}
 				SpinLockRelease(cmd_lock);
 				retval = false;
 			}
-			SpinLockRelease(&gc_sstate->redo_lock);
-		}
-		SpinLockRelease(&gcache_shared_head->gcache_sstate_lock);
-	}
-	return retval;
-}
+			else if (gpucache_checkpoint_dir &&
+					 gpucache_checkpoint_dir[0] != '\0' &&
+					 gpucache_checkpoint_interval > 0 &&
+					 gc_sstate->initial_loading == 0 &&
+					 __gpuCacheCheckpointIsRequired(gc_sstate) &&
+					 timestamp > (gc_sstate->checkpoint_timestamp +
+								  (uint64)gpucache_checkpoint_interval * 1000000UL))
+			{
+				SpinLockAcquire(cmd_lock);
+				if (!dlist_is_empty(free_cmds))
+				{
+					GpuCacheBackgroundCommand *cmd
+						= dlist_container(GpuCacheBackgroundCommand, chain,
+										  dlist_pop_head_node(free_cmds));
 
-/*
+					memset(cmd, 0, sizeof(GpuCacheBackgroundCommand));
+					cmd->database_oid = gc_sstate->database_oid;
+					cmd->table_oid    = gc_sstate->table_oid;
+					cmd->signature    = gc_sstate->signature;
+					cmd->shard_id     = gc_sstate->shard_id;
+					cmd->backend      = NULL;
+					cmd->command      = GCACHE_BGWORKER_CMD__CHECKPOINT;
+					cmd->retval       = (CUresult) UINT_MAX;
+
+					dlist_push_tail(cmd_queue, &cmd->chain);
+
+					gc_sstate->checkpoint_timestamp = timestamp;
+				}
+				SpinLockRelease(cmd_lock);
+				retval = false;
+			}
+			else if (gpuCacheHasRetiredVersions(gc_sstate) ||
+					 (gc_sstate->initial_loading == 0 &&
+					  gpuCacheWindowEvictIsDue(gc_sstate, timestamp)))
+			{
+				/*
+				 * APPLY_REDO with no new REDO logs just releases the retired
+				 * versions of the device buffers, and evicts the rows out of
+				 * the cache window.
+				 */
+				SpinLockAcquire(cmd_lock);
+				if (!dlist_is_empty(free_cmds))
+				{
+					GpuCacheBackgroundCommand *cmd
+						= dlist_container(GpuCacheBackgroundCommand, chain,
+										  dlist_pop_head_node(free_cmds));
+
+					memset(cmd, 0, sizeof(GpuCacheBackgroundCommand));
+					cmd->database_oid = gc_sstate->database_oid;
+					cmd->table_oid    = gc_sstate->table_oid;
+					cmd->signature    = gc_sstate->signature;
+					cmd->shard_id     = gc_sstate->shard_id;
+					cmd->backend      = NULL;
+					cmd->command      = GCACHE_BGWORKER_CMD__APPLY_REDO;
+					cmd->end_pos      = sync_pos;
+					cmd->retval       = (CUresult) UINT_MAX;
+
+					dlist_push_tail(cmd_queue, &cmd->chain);
+				}
+				SpinLockRelease(cmd_lock);
+				retval = false;
+			}
+			else if (shrink &&
+					 gc_sstate->initial_loading == 0 &&
+					 gc_sstate->gpu_extra_devptr != 0UL)
+			{
+				/*
+				 * Device memory pressure was reported by the admission
+				 * control; compaction shrinks the extra buffer.
+				 */
+				SpinLockAcquire(cmd_lock);
+				if (!dlist_is_empty(free_cmds))
+				{
+					GpuCacheBackgroundCommand *cmd
+						= dlist_container(GpuCacheBackgroundCommand, chain,
+										  dlist_pop_head_node(free_cmds));
+
+					memset(cmd, 0, sizeof(GpuCacheBackgroundCommand));
+					cmd->database_oid = gc_sstate->database_oid;
+					cmd->table_oid    = gc_sstate->table_oid;
+					cmd->signature    = gc_sstate->signature;
+					cmd->shard_id     = gc_sstate->shard_id;
+					cmd->backend      = NULL;
+					cmd->command      = GCACHE_BGWORKER_CMD__COMPACTION;
+					cmd->retval       = (CUresult) UINT_MAX;
+
+					dlist_push_tail(cmd_queue, &cmd->chain);
+				}
+				SpinLockRelease(cmd_lock);
+				retval = false;
+			}
+			SpinLockRelease(&gc_sstate->redo_lock);
+		}
+		SpinLockRelease(&gcache_shared_head->gcache_sstate_lock);
+	}
+	return retval;
+}
+
+/*
  * pg_strom.gpucache_auto_preload configuration
  */
 typedef struct
@@ -3829,213 +7301,999 @@ __parseGpuCacheAutoPreload(void)
 			!entry->table_name)
 			elog(ERROR, "out of memory");
 	}
-	gpucache_auto_preload_num_entries = nitems;
-
-	/* sort by database_name */
-	if (gpucache_auto_preload_num_entries > 0)
+	gpucache_auto_preload_num_entries = nitems;
+
+	/* sort by database_name */
+	if (gpucache_auto_preload_num_entries > 0)
+	{
+		qsort(gpucache_auto_preload_entries,
+			  gpucache_auto_preload_num_entries,
+			  sizeof(GpuCacheAutoPreloadEntry),
+			  __gpuCacheAutoPreloadEntryComp);
+	}
+}
+
+/*
+ * __gpuCacheAutoPreloadConnectDatabaseAny
+ */
+static int
+__gpuCacheAutoPreloadConnectDatabaseAny(int32 *p_start, int32 *p_end)
+{
+	char	   *database_name;
+	Relation	srel;
+	SysScanDesc	sscan;
+    ScanKeyData	skey;
+	int			nkeys;
+	HeapTuple	tuple;
+	int			nitems = 0;
+	int			nrooms = 0;
+	int			exit_code = 1;	/* restart again */
+
+	if (gcache_shared_head->gcache_auto_preload_count++ == 0)
+	{
+		database_name = "template1";
+		nkeys = 0;
+	}
+	else
+	{
+		database_name = NameStr(gcache_shared_head->gcache_auto_preload_dbname);
+
+		ScanKeyInit(&skey,
+					Anum_pg_database_datname,
+					BTGreaterStrategyNumber, F_NAMEGT,
+					CStringGetDatum(database_name));
+		nkeys = 1;
+	}
+
+	PG_TRY();
+	{
+		BackgroundWorkerInitializeConnection(database_name, NULL, 0);
+	}
+	PG_CATCH();
+	{
+		ErrorData	   *edata;
+
+		MemoryContextSwitchTo(TopMemoryContext);
+		edata = CopyErrorData();
+
+		elog(LOG, "failed to connect database [%s], stop preloading - %s (%s:%d)",
+			 database_name,
+			 edata->message,
+			 edata->filename,
+			 edata->lineno);
+		proc_exit(0);	/* stop to restart bgworker any more */
+	}
+	PG_END_TRY();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	srel = table_open(DatabaseRelationId, AccessShareLock);
+	sscan = systable_beginscan(srel,
+							   DatabaseNameIndexId,
+							   true,
+							   NULL,
+							   nkeys, &skey);
+	while ((tuple = systable_getnext(sscan)) != NULL)
+	{
+		Form_pg_database dat = (Form_pg_database) GETSTRUCT(tuple);
+
+		if (!dat->datistemplate && dat->datallowconn)
+		{
+			/* save the next database */
+			memcpy(&gcache_shared_head->gcache_auto_preload_dbname,
+				   &dat->datname,
+				   sizeof(NameData));
+			break;
+		}
+	}
+	if (!HeapTupleIsValid(tuple))
+		exit_code = 0;	/* stop preloading */
+	systable_endscan(sscan);
+	table_close(srel, AccessShareLock);
+
+	/* build gpucache_auto_preload_entries on this database */
+	database_name = get_database_name(MyDatabaseId);
+	srel = table_open(RelationRelationId, AccessShareLock);
+	sscan = systable_beginscan(srel, InvalidOid, false, NULL, 0, NULL);
+	while ((tuple = systable_getnext(sscan)) != NULL)
+	{
+		GpuCacheAutoPreloadEntry *entry;
+		Form_pg_class	pg_class = (Form_pg_class) GETSTRUCT(tuple);
+		Oid				namespace_oid = pg_class->relnamespace;
+
+		if (namespace_oid == PG_CATALOG_NAMESPACE)
+			continue;
+		if (__gpuCacheTableSignatureSnapshot(tuple, NULL, NULL) == 0)
+			continue;
+
+		while (nitems >= nrooms)
+		{
+			nrooms = 2 * nrooms + 20;
+			gpucache_auto_preload_entries
+				= realloc(gpucache_auto_preload_entries,
+						  sizeof(GpuCacheAutoPreloadEntry) * nrooms);
+			if (!gpucache_auto_preload_entries)
+				elog(ERROR, "out of memory");
+		}
+		entry = &gpucache_auto_preload_entries[nitems++];
+        entry->database_name = strdup(database_name);
+		entry->schema_name = strdup(get_namespace_name(namespace_oid));
+		entry->table_name = strdup(NameStr(pg_class->relname));
+	}
+	gpucache_auto_preload_num_entries = nitems;
+
+	systable_endscan(sscan);
+	table_close(srel, AccessShareLock);
+
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+	
+	*p_start = 0;
+	*p_end   = nitems;
+
+	return exit_code;
+}
+
+/*
+ * gpuCacheAutoPreloadDatabaseName
+ */
+static int
+gpuCacheAutoPreloadConnectDatabase(int32 *p_start, int32 *p_end)
+{
+	GpuCacheAutoPreloadEntry *entry;
+	const char *database_name;
+	int32		start;
+	int32		curr;
+
+	if (!gpucache_auto_preload_entries)
+		return __gpuCacheAutoPreloadConnectDatabaseAny(p_start, p_end);
+
+	start = curr = gcache_shared_head->gcache_auto_preload_count;
+	if (start >= gpucache_auto_preload_num_entries)
+		proc_exit(0);	/* no more preloading */
+
+	database_name = gpucache_auto_preload_entries[start].database_name;
+	while (curr < gpucache_auto_preload_num_entries)
+	{
+		entry = &gpucache_auto_preload_entries[curr];
+
+		if (strcmp(database_name, entry->database_name) != 0)
+			break;
+	}
+	gcache_shared_head->gcache_auto_preload_count = curr;
+
+	BackgroundWorkerInitializeConnection(database_name, NULL, 0);
+
+	*p_start = start;
+	*p_end   = curr;
+
+	return (curr >= gpucache_auto_preload_num_entries ? 0 : 1);
+}
+
+/*
+ * gpuCacheStartupPreloader
+ */
+void
+gpuCacheStartupPreloader(Datum arg)
+{
+	int32		start;
+	int32		end;
+	int32		index;
+	int			exit_code;
+
+	BackgroundWorkerUnblockSignals();
+	shmbufAttachAllSegments();
+
+	exit_code = gpuCacheAutoPreloadConnectDatabase(&start, &end);
+	StartTransactionCommand();
+	GetCurrentTransactionId();
+	for (index=start; index < end; index++)
+	{
+		GpuCacheAutoPreloadEntry *entry = &gpucache_auto_preload_entries[index];
+		RangeVar		rvar;
+		Relation		rel;
+
+		memset(&rvar, 0, sizeof(RangeVar));
+		rvar.type = T_RangeVar;
+		rvar.schemaname = entry->schema_name;
+		rvar.relname = entry->table_name;
+
+		rel = table_openrv(&rvar, AccessShareLock);
+		(void)lookupGpuCacheDesc(rel);
+		table_close(rel, NoLock);
+
+		elog(LOG, "gpucache: auto preload '%s.%s' (DB: %s)",
+			 entry->schema_name,
+			 entry->table_name,
+			 entry->database_name);
+	}
+	CommitTransactionCommand();
+
+	proc_exit(exit_code);
+}
+
+/*
+ * ------------------------------------------------------------
+ *
+ * WAL-sync worker (for sync_mode=wal)
+ *
+ * It reads the WAL records of heap INSERT/UPDATE/DELETE, then writes REDO
+ * logs of the GPU caches in the database, instead of the row trigger.
+ * Logical decoding does not deliver the ctid of tuples, so it directly
+ * reads the heap records using XLogReader; it needs wal_level=logical
+ * to have the entire new tuple on UPDATE.
+ * TRUNCATE and DROP TABLE are still handled by the backend, as usual.
+ *
+ * ------------------------------------------------------------
+ */
+#define GPUCACHE_WAL_SYNC_BATCH_SZ		10000
+
+/*
+ * __gpuCacheWalSyncLookupSlot - caller must hold wal_sync_lock
+ */
+static int
+__gpuCacheWalSyncLookupSlot(Oid database_oid)
+{
+	int		i;
+
+	for (i=0; i < GPUCACHE_WAL_SYNC_NSLOTS; i++)
+	{
+		if (gcache_shared_head->wal_sync[i].database_oid == database_oid)
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * gpuCacheWalSyncLaunch
+ *
+ * It launches the WAL-sync worker of the database on demand, then returns
+ * true if the worker is ready. The worker waits for completion of the
+ * transactions already running at the startup, so we never wait for the
+ * worker here; the caller shall not use GPU cache until it gets ready.
+ */
+static bool
+gpuCacheWalSyncLaunch(Oid database_oid)
+{
+	BackgroundWorker worker;
+	BackgroundWorkerHandle *handle;
+	slock_t	   *lock = &gcache_shared_head->wal_sync_lock;
+	TimestampTz	now = GetCurrentTimestamp();
+	int			index;
+
+	SpinLockAcquire(lock);
+	index = __gpuCacheWalSyncLookupSlot(database_oid);
+	if (index >= 0)
+	{
+		bool	is_ready = gcache_shared_head->wal_sync[index].is_ready;
+
+		/* the worker might fail to start, prior to attach the slot */
+		if (gcache_shared_head->wal_sync[index].pid != 0 ||
+			!TimestampDifferenceExceeds(gcache_shared_head->wal_sync[index].launched_at,
+										now, 10000))
+		{
+			SpinLockRelease(lock);
+			return is_ready;
+		}
+	}
+	else
+	{
+		index = __gpuCacheWalSyncLookupSlot(InvalidOid);
+		if (index < 0)
+		{
+			SpinLockRelease(lock);
+			elog(ERROR, "gpucache: no free slot of WAL-sync worker");
+		}
+	}
+	memset(&gcache_shared_head->wal_sync[index], 0,
+		   sizeof(gcache_shared_head->wal_sync[index]));
+	gcache_shared_head->wal_sync[index].database_oid = database_oid;
+	gcache_shared_head->wal_sync[index].launched_at = now;
+	SpinLockRelease(lock);
+
+	memset(&worker, 0, sizeof(BackgroundWorker));
+	snprintf(worker.bgw_name, sizeof(worker.bgw_name),
+			 "GPUCache WAL-sync worker (db=%u)", database_oid);
+	worker.bgw_flags = (BGWORKER_SHMEM_ACCESS |
+						BGWORKER_BACKEND_DATABASE_CONNECTION);
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = BGW_NEVER_RESTART;
+	snprintf(worker.bgw_library_name, BGW_MAXLEN,
+			 "$libdir/pg_strom");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN,
+			 "gpuCacheWalSyncMain");
+	worker.bgw_main_arg = ObjectIdGetDatum(database_oid);
+	if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+	{
+		SpinLockAcquire(lock);
+		gcache_shared_head->wal_sync[index].database_oid = InvalidOid;
+		SpinLockRelease(lock);
+		ereport(ERROR,
+				(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+				 errmsg("gpucache: could not register WAL-sync worker"),
+				 errhint("You may need to increase max_worker_processes.")));
+	}
+	return false;
+}
+
+/*
+ * __gpuCacheWalSyncResetCaches
+ *
+ * WAL records are not replayed while the WAL-sync worker is not running,
+ * so GPU caches in WAL mode must be reloaded. If a GPU cache is under the
+ * initial-loading, we have no way to reload, so marked as corrupted.
+ */
+static void
+__gpuCacheWalSyncResetCaches(Oid database_oid)
+{
+	int		hindex;
+
+	SpinLockAcquire(&gcache_shared_head->gcache_sstate_lock);
+	for (hindex = 0; hindex < GPUCACHE_SHARED_DESC_NSLOTS; hindex++)
+	{
+		dlist_head *slot = &gcache_shared_head->gcache_sstate_slot[hindex];
+		dlist_iter	iter;
+
+		dlist_foreach(iter, slot)
+		{
+			GpuCacheSharedState *gc_sstate;
+
+			gc_sstate = dlist_container(GpuCacheSharedState,
+										chain, iter.cur);
+			if (gc_sstate->database_oid != database_oid ||
+				gc_sstate->sync_mode != GPUCACHE_SYNC_MODE__WAL ||
+				(gc_sstate->refcnt & 1) == 0)
+				continue;
+			if (gc_sstate->initial_loading == 0)
+				gc_sstate->initial_loading = -1;
+			else if (gc_sstate->initial_loading > 0)
+				gpuCacheMarkCorrupted(gc_sstate);
+		}
+	}
+	SpinLockRelease(&gcache_shared_head->gcache_sstate_lock);
+}
+
+/*
+ * gpuCacheWalSyncOnExit
+ */
+static void
+gpuCacheWalSyncOnExit(int code, Datum arg)
+{
+	int			index = DatumGetInt32(arg);
+	Oid			database_oid = gcache_shared_head->wal_sync[index].database_oid;
+	HASH_SEQ_STATUS	hseq;
+	GpuCacheDesc   *gc_desc;
+
+	/* release GpuCacheSharedState of the transactions in-progress */
+	hash_seq_init(&hseq, gcache_descriptors_htab);
+	while ((gc_desc = hash_seq_search(&hseq)) != NULL)
+	{
+		if (gc_desc->gc_sstate)
+			putGpuCacheSharedState(gc_desc->gc_sstate, false);
+	}
+	__gpuCacheWalSyncResetCaches(database_oid);
+
+	SpinLockAcquire(&gcache_shared_head->wal_sync_lock);
+	memset(&gcache_shared_head->wal_sync[index], 0,
+		   sizeof(gcache_shared_head->wal_sync[index]));
+	SpinLockRelease(&gcache_shared_head->wal_sync_lock);
+}
+
+/*
+ * __gpuCacheWalSyncWaitForRunningXacts
+ *
+ * Heap records prior to the start point are never replayed, so we have to
+ * wait for completion of the transactions already running.
+ */
+static void
+__gpuCacheWalSyncWaitForRunningXacts(void)
+{
+	Snapshot	snapshot = GetLatestSnapshot();
+	TransactionId *xids;
+	int			i, nxids = snapshot->xcnt;
+
+	xids = palloc(sizeof(TransactionId) * Max(nxids, 1));
+	memcpy(xids, snapshot->xip, sizeof(TransactionId) * nxids);
+	for (i=0; i < nxids; i++)
+	{
+		XactLockTableWait(xids[i], NULL, NULL, XLTW_None);
+		CHECK_FOR_INTERRUPTS();
+	}
+	pfree(xids);
+}
+
+/*
+ * __gpuCacheWalSyncAttach
+ *
+ * It attaches GpuCacheSharedState on the GpuCacheDesc, if not yet, then
+ * returns true if GPU cache is ready to write REDO logs. If GPU cache is
+ * under the initial-loading, it waits for the completion, because REDO log
+ * buffer is rewound at the beginning.
+ */
+static bool
+__gpuCacheWalSyncAttach(GpuCacheDesc *gc_desc)
+{
+	GpuCacheSharedState *gc_sstate;
+	int			state;
+	bool		is_alive;
+
+	if (!gc_desc->gc_sstate)
+		gc_desc->gc_sstate = __lookupGpuCacheSharedState(gc_desc, NULL,
+														 NULL, false);
+	gc_sstate = gc_desc->gc_sstate;
+	if (!gc_sstate)
+		return false;
+	for (;;)
+	{
+		SpinLockAcquire(&gcache_shared_head->gcache_sstate_lock);
+		state = __gpuCacheInitialLoadingState(gc_sstate);
+		is_alive = ((gc_sstate->refcnt & 1) != 0);
+		SpinLockRelease(&gcache_shared_head->gcache_sstate_lock);
+		if (state <= 0)
+			break;
+		pg_usleep(5000L);	/* 5ms */
+		CHECK_FOR_INTERRUPTS();
+	}
+	if (!is_alive)
+	{
+		/* release the dropped one; a new GPU cache may be built later */
+		putGpuCacheSharedState(gc_sstate, false);
+		gc_desc->gc_sstate = NULL;
+		return false;
+	}
+	return (state == 0);
+}
+
+/*
+ * __gpuCacheWalSyncLookupDesc
+ *
+ * It returns GpuCacheDesc of the transaction that wrote the heap record,
+ * if the relation has GPU cache in WAL mode. Even if GPU cache is not loaded
+ * yet, we track the ctids modified by the transaction, because the initial-
+ * loading expects that WAL-sync worker writes its XACT logs.
+ */
+static GpuCacheDesc *
+__gpuCacheWalSyncLookupDesc(XLogReaderState *record,
+							Relation *p_rel,
+							BlockNumber *p_blkno,
+							bool *p_is_ready)
+{
+	GpuCacheDesc	hkey;
+	GpuCacheDesc   *gc_desc;
+	GpuCacheOptions	gc_options;
+	RelFileNode		rnode;
+	ForkNumber		forknum;
+	Oid				table_oid;
+	Relation		rel;
+	bool			found;
+
+	if (!XLogRecGetBlockTag(record, 0, &rnode, &forknum, p_blkno) ||
+		rnode.dbNode != MyDatabaseId ||
+		forknum != MAIN_FORKNUM)
+		return NULL;
+	table_oid = RelidByRelfilenode(rnode.spcNode, rnode.relNode);
+	if (!OidIsValid(table_oid))
+		return NULL;
+	/* the lock shall be released at end of the batch */
+	rel = try_relation_open(table_oid, AccessShareLock);
+	if (!rel)
+		return NULL;
+	memset(&hkey, 0, sizeof(GpuCacheDesc));
+	hkey.database_oid = MyDatabaseId;
+	hkey.table_oid = table_oid;
+	hkey.signature = gpuCacheTableSignature(rel, &gc_options);
+	hkey.xid = XLogRecGetXid(record);
+	if (hkey.signature == 0UL ||
+		gc_options.sync_mode != GPUCACHE_SYNC_MODE__WAL ||
+		!TransactionIdIsNormal(hkey.xid))
+	{
+		relation_close(rel, NoLock);
+		return NULL;
+	}
+	gc_desc = hash_search(gcache_descriptors_htab,
+						  &hkey, HASH_ENTER, &found);
+	if (!found)
+	{
+		gc_desc->gc_sstate = NULL;
+		gc_desc->drop_on_rollback = false;
+		gc_desc->drop_on_commit = false;
+		gc_desc->nitems = 0;
+		memset(&gc_desc->buf, 0, sizeof(StringInfoData));
+	}
+	if (!gc_desc->buf.data)
+		initStringInfoContext(&gc_desc->buf, CacheMemoryContext);
+	*p_rel = rel;
+	*p_is_ready = __gpuCacheWalSyncAttach(gc_desc);
+
+	return gc_desc;
+}
+
+/*
+ * __gpuCacheWalSyncMarkCorrupted
+ */
+static void
+__gpuCacheWalSyncMarkCorrupted(GpuCacheDesc *gc_desc, const char *reason)
+{
+	GpuCacheSharedState *gc_sstate = gc_desc->gc_sstate;
+	int			k, nshards;
+
+	if (!gc_sstate)
+		return;
+	nshards = gpuCacheNumShards(gc_sstate);
+	for (k=0; k < nshards; k++)
+	{
+		gpuCacheMarkCorrupted(gpuCacheShard(gc_sstate, k));
+	}
+	elog(WARNING, "gpucache: table [%s:%lx] was marked as corrupted (%s)",
+		 gc_sstate->table_name, gc_sstate->signature, reason);
+}
+
+/*
+ * __gpuCacheWalSyncWriteLog
+ */
+static void
+__gpuCacheWalSyncWriteLog(GpuCacheDesc *gc_desc, Relation rel, bool is_ready,
+						  char tag, BlockNumber blkno, OffsetNumber offnum,
+						  const xl_heap_header *xlhdr,
+						  const char *data, Size datalen)
+{
+	HeapTupleData	tupbuf;
+	HeapTuple		tuple;
+
+	if (!is_ready)
+	{
+		PendingCtidItem	pitem;
+
+		/* track ctid only, for the XACT log after the initial-loading */
+		pitem.tag = tag;
+		ItemPointerSet(&pitem.ctid, blkno, offnum);
+		appendBinaryStringInfo(&gc_desc->buf,
+							   (char *)&pitem,
+							   sizeof(PendingCtidItem));
+		gc_desc->nitems++;
+	}
+	else if (tag == 'D')
+	{
+		memset(&tupbuf, 0, sizeof(HeapTupleData));
+		ItemPointerSet(&tupbuf.t_self, blkno, offnum);
+		__gpuCacheDeleteLog(&tupbuf, gc_desc);
+	}
+	else
+	{
+		HeapTupleHeader	htup;
+
+		Assert(tag == 'I');
+		/* see DecodeXLogTuple() */
+		htup = palloc0(SizeofHeapTupleHeader + datalen);
+		memcpy((char *)htup + SizeofHeapTupleHeader, data, datalen);
+		htup->t_infomask2 = xlhdr->t_infomask2;
+		htup->t_infomask  = xlhdr->t_infomask;
+		htup->t_hoff      = xlhdr->t_hoff;
+
+		memset(&tupbuf, 0, sizeof(HeapTupleData));
+		tupbuf.t_len = SizeofHeapTupleHeader + datalen;
+		ItemPointerSet(&tupbuf.t_self, blkno, offnum);
+		tupbuf.t_tableOid = RelationGetRelid(rel);
+		tupbuf.t_data = htup;
+
+		tuple = __makeFlattenHeapTuple(rel, &tupbuf);
+		if (gpuCacheTupleInWindow(gc_desc->gc_sstate, tuple,
+								  RelationGetDescr(rel)))
+			__gpuCacheInsertLog(tuple, gc_desc);
+		if (tuple != &tupbuf)
+			pfree(tuple);
+		pfree(htup);
+	}
+}
+
+/*
+ * __gpuCacheWalSyncHeapRecord
+ */
+static void
+__gpuCacheWalSyncHeapRecord(XLogReaderState *record)
+{
+	uint8		info = XLogRecGetInfo(record) & XLOG_HEAP_OPMASK;
+	GpuCacheDesc *gc_desc;
+	Relation	rel;
+	BlockNumber	blkno;
+	xl_heap_header xlhdr;
+	char	   *data;
+	Size		datalen;
+	bool		is_ready;
+
+	if (info != XLOG_HEAP_INSERT &&
+		info != XLOG_HEAP_DELETE &&
+		info != XLOG_HEAP_UPDATE &&
+		info != XLOG_HEAP_HOT_UPDATE)
+		return;
+	gc_desc = __gpuCacheWalSyncLookupDesc(record, &rel, &blkno, &is_ready);
+	if (!gc_desc)
+		return;
+
+	if (info == XLOG_HEAP_INSERT)
+	{
+		xl_heap_insert *xlrec = (xl_heap_insert *) XLogRecGetData(record);
+
+		data = XLogRecGetBlockData(record, 0, &datalen);
+		if ((xlrec->flags & XLH_INSERT_CONTAINS_NEW_TUPLE) == 0 ||
+			!data || datalen < SizeOfHeapHeader)
+		{
+			__gpuCacheWalSyncMarkCorrupted(gc_desc, "INSERT record has no tuple");
+		}
+		else
+		{
+			memcpy(&xlhdr, data, SizeOfHeapHeader);
+			__gpuCacheWalSyncWriteLog(gc_desc, rel, is_ready, 'I',
+									  blkno, xlrec->offnum, &xlhdr,
+									  data + SizeOfHeapHeader,
+									  datalen - SizeOfHeapHeader);
+		}
+	}
+	else if (info == XLOG_HEAP_DELETE)
+	{
+		xl_heap_delete *xlrec = (xl_heap_delete *) XLogRecGetData(record);
+
+		__gpuCacheWalSyncWriteLog(gc_desc, rel, is_ready, 'D',
+								  blkno, xlrec->offnum,
+								  NULL, NULL, 0);
+	}
+	else
+	{
+		xl_heap_update *xlrec = (xl_heap_update *) XLogRecGetData(record);
+		BlockNumber		old_blkno = blkno;
+
+		/* the old tuple may be on the different block */
+		if (XLogRecHasBlockRef(record, 1))
+			XLogRecGetBlockTag(record, 1, NULL, NULL, &old_blkno);
+		data = XLogRecGetBlockData(record, 0, &datalen);
+		if ((xlrec->flags & (XLH_UPDATE_PREFIX_FROM_OLD |
+							 XLH_UPDATE_SUFFIX_FROM_OLD)) != 0 ||
+			(xlrec->flags & XLH_UPDATE_CONTAINS_NEW_TUPLE) == 0 ||
+			!data || datalen < SizeOfHeapHeader)
+		{
+			__gpuCacheWalSyncMarkCorrupted(gc_desc, "UPDATE record has no entire tuple");
+		}
+		else
+		{
+			memcpy(&xlhdr, data, SizeOfHeapHeader);
+			__gpuCacheWalSyncWriteLog(gc_desc, rel, is_ready, 'D',
+									  old_blkno, xlrec->old_offnum,
+									  NULL, NULL, 0);
+			__gpuCacheWalSyncWriteLog(gc_desc, rel, is_ready, 'I',
+									  blkno, xlrec->new_offnum, &xlhdr,
+									  data + SizeOfHeapHeader,
+									  datalen - SizeOfHeapHeader);
+		}
+	}
+	relation_close(rel, NoLock);
+}
+
+/*
+ * __gpuCacheWalSyncMultiInsertRecord
+ */
+static void
+__gpuCacheWalSyncMultiInsertRecord(XLogReaderState *record)
+{
+	xl_heap_multi_insert *xlrec;
+	GpuCacheDesc *gc_desc;
+	Relation	rel;
+	BlockNumber	blkno;
+	char	   *data;
+	Size		datalen;
+	bool		is_ready;
+	int			i;
+
+	gc_desc = __gpuCacheWalSyncLookupDesc(record, &rel, &blkno, &is_ready);
+	if (!gc_desc)
+		return;
+	xlrec = (xl_heap_multi_insert *) XLogRecGetData(record);
+	data = XLogRecGetBlockData(record, 0, &datalen);
+	if ((xlrec->flags & XLH_INSERT_CONTAINS_NEW_TUPLE) == 0 || !data)
+	{
+		__gpuCacheWalSyncMarkCorrupted(gc_desc, "MULTI_INSERT record has no tuple");
+		relation_close(rel, NoLock);
+		return;
+	}
+	/* see DecodeMultiInsert() */
+	for (i=0; i < xlrec->ntuples; i++)
 	{
-		qsort(gpucache_auto_preload_entries,
-			  gpucache_auto_preload_num_entries,
-			  sizeof(GpuCacheAutoPreloadEntry),
-			  __gpuCacheAutoPreloadEntryComp);
+		xl_multi_insert_tuple *xlmtup;
+		xl_heap_header	xlhdr;
+		OffsetNumber	offnum;
+
+		if ((XLogRecGetInfo(record) & XLOG_HEAP_INIT_PAGE) != 0)
+			offnum = FirstOffsetNumber + i;
+		else
+			offnum = xlrec->offsets[i];
+		xlmtup = (xl_multi_insert_tuple *) SHORTALIGN(data);
+		data = (char *)xlmtup + SizeOfMultiInsertTuple;
+		xlhdr.t_infomask2 = xlmtup->t_infomask2;
+		xlhdr.t_infomask  = xlmtup->t_infomask;
+		xlhdr.t_hoff      = xlmtup->t_hoff;
+		__gpuCacheWalSyncWriteLog(gc_desc, rel, is_ready, 'I',
+								  blkno, offnum, &xlhdr,
+								  data, xlmtup->datalen);
+		data += xlmtup->datalen;
 	}
+	relation_close(rel, NoLock);
 }
 
 /*
- * __gpuCacheAutoPreloadConnectDatabaseAny
+ * __gpuCacheWalSyncXactRecord
  */
-static int
-__gpuCacheAutoPreloadConnectDatabaseAny(int32 *p_start, int32 *p_end)
+static void
+__gpuCacheWalSyncXactRecord(XLogReaderState *record)
 {
-	char	   *database_name;
-	Relation	srel;
-	SysScanDesc	sscan;
-    ScanKeyData	skey;
-	int			nkeys;
-	HeapTuple	tuple;
-	int			nitems = 0;
-	int			nrooms = 0;
-	int			exit_code = 1;	/* restart again */
+	uint8		info = XLogRecGetInfo(record) & XLOG_XACT_OPMASK;
+	TransactionId xid = XLogRecGetXid(record);
+	TransactionId *subxacts;
+	int			nsubxacts;
+	bool		is_commit;
+	HASH_SEQ_STATUS	hseq;
+	GpuCacheDesc   *gc_desc;
 
-	if (gcache_shared_head->gcache_auto_preload_count++ == 0)
+	if (info == XLOG_XACT_COMMIT ||
+		info == XLOG_XACT_COMMIT_PREPARED)
 	{
-		database_name = "template1";
-		nkeys = 0;
+		xl_xact_parsed_commit parsed;
+
+		ParseCommitRecord(XLogRecGetInfo(record),
+						  (xl_xact_commit *) XLogRecGetData(record),
+						  &parsed);
+		if (info == XLOG_XACT_COMMIT_PREPARED)
+			xid = parsed.twophase_xid;
+		subxacts = parsed.subxacts;
+		nsubxacts = parsed.nsubxacts;
+		is_commit = true;
+	}
+	else if (info == XLOG_XACT_ABORT ||
+			 info == XLOG_XACT_ABORT_PREPARED)
+	{
+		xl_xact_parsed_abort parsed;
+
+		ParseAbortRecord(XLogRecGetInfo(record),
+						 (xl_xact_abort *) XLogRecGetData(record),
+						 &parsed);
+		if (info == XLOG_XACT_ABORT_PREPARED)
+			xid = parsed.twophase_xid;
+		subxacts = parsed.subxacts;
+		nsubxacts = parsed.nsubxacts;
+		is_commit = false;
 	}
 	else
 	{
-		database_name = NameStr(gcache_shared_head->gcache_auto_preload_dbname);
-
-		ScanKeyInit(&skey,
-					Anum_pg_database_datname,
-					BTGreaterStrategyNumber, F_NAMEGT,
-					CStringGetDatum(database_name));
-		nkeys = 1;
+		return;
 	}
+	if (hash_get_num_entries(gcache_descriptors_htab) == 0)
+		return;
 
-	PG_TRY();
+	/*
+	 * The initial-loading checks TransactionIdIsInProgress() to determine
+	 * whether XACT log of the tuple is written by WAL-sync worker, or not.
+	 * If we would write XACT logs prior to the initial-loading, they are
+	 * rewound, but initial-loading may still see the transaction in-progress.
+	 */
+	while (TransactionIdIsInProgress(xid))
 	{
-		BackgroundWorkerInitializeConnection(database_name, NULL, 0);
+		pg_usleep(1000L);	/* 1ms */
+		CHECK_FOR_INTERRUPTS();
 	}
-	PG_CATCH();
-	{
-		ErrorData	   *edata;
-
-		MemoryContextSwitchTo(TopMemoryContext);
-		edata = CopyErrorData();
 
-		elog(LOG, "failed to connect database [%s], stop preloading - %s (%s:%d)",
-			 database_name,
-			 edata->message,
-			 edata->filename,
-			 edata->lineno);
-		proc_exit(0);	/* stop to restart bgworker any more */
-	}
-	PG_END_TRY();
-	StartTransactionCommand();
-	PushActiveSnapshot(GetTransactionSnapshot());
-	srel = table_open(DatabaseRelationId, AccessShareLock);
-	sscan = systable_beginscan(srel,
-							   DatabaseNameIndexId,
-							   true,
-							   NULL,
-							   nkeys, &skey);
-	while ((tuple = systable_getnext(sscan)) != NULL)
+	hash_seq_init(&hseq, gcache_descriptors_htab);
+	while ((gc_desc = hash_seq_search(&hseq)) != NULL)
 	{
-		Form_pg_database dat = (Form_pg_database) GETSTRUCT(tuple);
+		int		i;
 
-		if (!dat->datistemplate && dat->datallowconn)
+		if (gc_desc->xid != xid)
 		{
-			/* save the next database */
-			memcpy(&gcache_shared_head->gcache_auto_preload_dbname,
-				   &dat->datname,
-				   sizeof(NameData));
-			break;
+			for (i=0; i < nsubxacts; i++)
+			{
+				if (gc_desc->xid == subxacts[i])
+					break;
+			}
+			if (i >= nsubxacts)
+				continue;
 		}
+		/* no XACT logs, if GPU cache is not ready */
+		if (!__gpuCacheWalSyncAttach(gc_desc))
+			gc_desc->nitems = 0;
+		releaseGpuCacheDesc(gc_desc, is_commit);
 	}
-	if (!HeapTupleIsValid(tuple))
-		exit_code = 0;	/* stop preloading */
-	systable_endscan(sscan);
-	table_close(srel, AccessShareLock);
+}
 
-	/* build gpucache_auto_preload_entries on this database */
-	database_name = get_database_name(MyDatabaseId);
-	srel = table_open(RelationRelationId, AccessShareLock);
-	sscan = systable_beginscan(srel, InvalidOid, false, NULL, 0, NULL);
-	while ((tuple = systable_getnext(sscan)) != NULL)
-	{
-		GpuCacheAutoPreloadEntry *entry;
-		Form_pg_class	pg_class = (Form_pg_class) GETSTRUCT(tuple);
-		Oid				namespace_oid = pg_class->relnamespace;
+/*
+ * __gpuCacheWalSyncApplyRedo
+ *
+ * It kicks GPU kernel to apply REDO logs written on the batch.
+ * The batch is always terminated by COMMIT or ABORT record, so GPU cache
+ * is transactionally consistent on the boundary.
+ */
+static void
+__gpuCacheWalSyncApplyRedo(void)
+{
+	List	   *gc_sstate_list = NIL;
+	ListCell   *lc;
+	int			hindex;
 
-		if (namespace_oid == PG_CATALOG_NAMESPACE)
-			continue;
-		if (__gpuCacheTableSignatureSnapshot(tuple, NULL, NULL) == 0)
-			continue;
+	SpinLockAcquire(&gcache_shared_head->gcache_sstate_lock);
+	for (hindex = 0; hindex < GPUCACHE_SHARED_DESC_NSLOTS; hindex++)
+	{
+		dlist_head *slot = &gcache_shared_head->gcache_sstate_slot[hindex];
+		dlist_iter	iter;
 
-		while (nitems >= nrooms)
+		dlist_foreach(iter, slot)
 		{
-			nrooms = 2 * nrooms + 20;
-			gpucache_auto_preload_entries
-				= realloc(gpucache_auto_preload_entries,
-						  sizeof(GpuCacheAutoPreloadEntry) * nrooms);
-			if (!gpucache_auto_preload_entries)
-				elog(ERROR, "out of memory");
+			GpuCacheSharedState *gc_sstate;
+
+			gc_sstate = dlist_container(GpuCacheSharedState,
+										chain, iter.cur);
+			if (gc_sstate->database_oid != MyDatabaseId ||
+				gc_sstate->sync_mode != GPUCACHE_SYNC_MODE__WAL ||
+				gc_sstate->initial_loading != 0 ||
+				(gc_sstate->refcnt & 1) == 0)
+				continue;
+			if (pg_atomic_read_u64(&gc_sstate->redo_write_pos) <=
+				pg_atomic_read_u64(&gc_sstate->redo_sync_pos))
+				continue;
+			gc_sstate->refcnt += 2;
+			gc_sstate_list = lappend(gc_sstate_list, gc_sstate);
 		}
-		entry = &gpucache_auto_preload_entries[nitems++];
-        entry->database_name = strdup(database_name);
-		entry->schema_name = strdup(get_namespace_name(namespace_oid));
-		entry->table_name = strdup(NameStr(pg_class->relname));
 	}
-	gpucache_auto_preload_num_entries = nitems;
-
-	systable_endscan(sscan);
-	table_close(srel, AccessShareLock);
+	SpinLockRelease(&gcache_shared_head->gcache_sstate_lock);
 
-	PopActiveSnapshot();
-	CommitTransactionCommand();
-	
-	*p_start = 0;
-	*p_end   = nitems;
+	foreach (lc, gc_sstate_list)
+	{
+		GpuCacheSharedState *gc_sstate = lfirst(lc);
+		uint64		sync_pos;
+		bool		advanced;
 
-	return exit_code;
+		sync_pos = gpuCacheAdvanceSyncPos(gc_sstate, &advanced);
+		if (advanced)
+			gpuCacheInvokeApplyRedo(gc_sstate, sync_pos, true);
+		putGpuCacheSharedState(gc_sstate, false);
+	}
+	list_free(gc_sstate_list);
 }
 
 /*
- * gpuCacheAutoPreloadDatabaseName
+ * __gpuCacheWalSyncReadBatch
  */
-static int
-gpuCacheAutoPreloadConnectDatabase(int32 *p_start, int32 *p_end)
+static XLogRecPtr
+__gpuCacheWalSyncReadBatch(XLogReaderState *reader,
+						   XLogRecPtr next_lsn,
+						   XLogRecPtr end_lsn)
 {
-	GpuCacheAutoPreloadEntry *entry;
-	const char *database_name;
-	int32		start;
-	int32		curr;
-
-	if (!gpucache_auto_preload_entries)
-		return __gpuCacheAutoPreloadConnectDatabaseAny(p_start, p_end);
-
-	start = curr = gcache_shared_head->gcache_auto_preload_count;
-	if (start >= gpucache_auto_preload_num_entries)
-		proc_exit(0);	/* no more preloading */
+	uint32		nrecords = 0;
 
-	database_name = gpucache_auto_preload_entries[start].database_name;
-	while (curr < gpucache_auto_preload_num_entries)
+	while (next_lsn < end_lsn)
 	{
-		entry = &gpucache_auto_preload_entries[curr];
-
-		if (strcmp(database_name, entry->database_name) != 0)
-			break;
-	}
-	gcache_shared_head->gcache_auto_preload_count = curr;
-
-	BackgroundWorkerInitializeConnection(database_name, NULL, 0);
+		XLogRecord *record;
+		char	   *errormsg = NULL;
 
-	*p_start = start;
-	*p_end   = curr;
+#if PG_VERSION_NUM >= 130000
+		record = XLogReadRecord(reader, &errormsg);
+#else
+		record = XLogReadRecord(reader, next_lsn, &errormsg);
+#endif
+		if (!record)
+			elog(ERROR, "gpucache: could not read WAL record at %X/%X: %s",
+				 (uint32)(next_lsn >> 32), (uint32)next_lsn,
+				 errormsg ? errormsg : "unknown reason");
+		next_lsn = reader->EndRecPtr;
 
-	return (curr >= gpucache_auto_preload_num_entries ? 0 : 1);
+		switch (XLogRecGetRmid(reader))
+		{
+			case RM_HEAP_ID:
+				__gpuCacheWalSyncHeapRecord(reader);
+				break;
+			case RM_HEAP2_ID:
+				if ((XLogRecGetInfo(reader) & XLOG_HEAP_OPMASK) == XLOG_HEAP2_MULTI_INSERT)
+					__gpuCacheWalSyncMultiInsertRecord(reader);
+				break;
+			case RM_XACT_ID:
+				__gpuCacheWalSyncXactRecord(reader);
+				if (nrecords >= GPUCACHE_WAL_SYNC_BATCH_SZ)
+					return next_lsn;
+				break;
+			default:
+				break;
+		}
+		nrecords++;
+		CHECK_FOR_INTERRUPTS();
+	}
+	return next_lsn;
 }
 
 /*
- * gpuCacheStartupPreloader
+ * gpuCacheWalSyncMain
  */
 void
-gpuCacheStartupPreloader(Datum arg)
+gpuCacheWalSyncMain(Datum arg)
 {
-	int32		start;
-	int32		end;
-	int32		index;
-	int			exit_code;
+	Oid			database_oid = DatumGetObjectId(arg);
+	XLogReaderState *reader;
+	XLogRecPtr	next_lsn;
+	MemoryContext oldcxt;
+	int			index;
 
 	BackgroundWorkerUnblockSignals();
+	BackgroundWorkerInitializeConnectionByOid(database_oid, InvalidOid, 0);
+	shmbufAttachAllSegments();
 
-	exit_code = gpuCacheAutoPreloadConnectDatabase(&start, &end);
-	StartTransactionCommand();
-	GetCurrentTransactionId();
-	for (index=start; index < end; index++)
+	/* attach the slot, and determine the start point */
+	SpinLockAcquire(&gcache_shared_head->wal_sync_lock);
+	index = __gpuCacheWalSyncLookupSlot(database_oid);
+	if (index < 0 || gcache_shared_head->wal_sync[index].pid != 0)
 	{
-		GpuCacheAutoPreloadEntry *entry = &gpucache_auto_preload_entries[index];
-		RangeVar		rvar;
-		Relation		rel;
+		SpinLockRelease(&gcache_shared_head->wal_sync_lock);
+		elog(ERROR, "gpucache: no slot for WAL-sync worker of database %u",
+			 database_oid);
+	}
+	next_lsn = GetXLogInsertRecPtr();
+	gcache_shared_head->wal_sync[index].pid = MyProcPid;
+	gcache_shared_head->wal_sync[index].start_lsn = next_lsn;
+	SpinLockRelease(&gcache_shared_head->wal_sync_lock);
+	before_shmem_exit(gpuCacheWalSyncOnExit, Int32GetDatum(index));
 
-		memset(&rvar, 0, sizeof(RangeVar));
-		rvar.type = T_RangeVar;
-		rvar.schemaname = entry->schema_name;
-		rvar.relname = entry->table_name;
+	StartTransactionCommand();
+	__gpuCacheWalSyncWaitForRunningXacts();
+	__gpuCacheWalSyncResetCaches(database_oid);
+	elog(LOG, "gpucache: WAL-sync worker of database '%s' started at %X/%X",
+		 get_database_name(database_oid),
+		 (uint32)(next_lsn >> 32), (uint32)next_lsn);
+	CommitTransactionCommand();
 
-		rel = table_openrv(&rvar, AccessShareLock);
-		(void)lookupGpuCacheDesc(rel);
-		table_close(rel, NoLock);
+	oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+#if PG_VERSION_NUM >= 130000
+	reader = XLogReaderAllocate(wal_segment_size, NULL,
+								XL_ROUTINE(.page_read = &read_local_xlog_page,
+										   .segment_open = &wal_segment_open,
+										   .segment_close = &wal_segment_close),
+								NULL);
+#elif PG_VERSION_NUM >= 120000
+	reader = XLogReaderAllocate(wal_segment_size, NULL,
+								read_local_xlog_page, NULL);
+#else
+	reader = XLogReaderAllocate(wal_segment_size,
+								read_local_xlog_page, NULL);
+#endif
+	if (!reader)
+		elog(ERROR, "out of memory");
+#if PG_VERSION_NUM >= 130000
+	XLogBeginRead(reader, next_lsn);
+#endif
+	MemoryContextSwitchTo(oldcxt);
 
-		elog(LOG, "gpucache: auto preload '%s.%s' (DB: %s)",
-			 entry->schema_name,
-			 entry->table_name,
-			 entry->database_name);
-	}
-	CommitTransactionCommand();
+	SpinLockAcquire(&gcache_shared_head->wal_sync_lock);
+	gcache_shared_head->wal_sync[index].is_ready = true;
+	SpinLockRelease(&gcache_shared_head->wal_sync_lock);
 
-	proc_exit(exit_code);
+	for (;;)
+	{
+		XLogRecPtr	flush_lsn = GetFlushRecPtr();
+
+		CHECK_FOR_INTERRUPTS();
+		if (next_lsn >= flush_lsn)
+		{
+			int		ev;
+
+			ev = WaitLatch(MyLatch,
+						   WL_LATCH_SET |
+						   WL_TIMEOUT |
+						   WL_POSTMASTER_DEATH,
+						   100L,
+						   PG_WAIT_EXTENSION);
+			ResetLatch(MyLatch);
+			if (ev & WL_POSTMASTER_DEATH)
+				elog(FATAL, "unexpected postmaster dead");
+			continue;
+		}
+		StartTransactionCommand();
+		PushActiveSnapshot(GetTransactionSnapshot());
+		next_lsn = __gpuCacheWalSyncReadBatch(reader, next_lsn, flush_lsn);
+		__gpuCacheWalSyncApplyRedo();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+	}
 }
 
 /*
@@ -4048,6 +8306,60 @@ gpuCacheBgWorkerEnd(int cuda_dindex)
 	SpinLockAcquire(&gcache_shared_head->bgworker_cmd_lock);
 	gcache_shared_head->bgworkers[cuda_dindex].latch = NULL;
 	SpinLockRelease(&gcache_shared_head->bgworker_cmd_lock);
+
+	/* write out the GPU caches updated since the last checkpoint */
+	if (gpucache_checkpoint_dir && gpucache_checkpoint_dir[0] != '\0')
+	{
+		List	   *gc_sstate_list = NIL;
+		ListCell   *lc;
+		int			hindex;
+
+		SpinLockAcquire(&gcache_shared_head->gcache_sstate_lock);
+		for (hindex = 0; hindex < GPUCACHE_SHARED_DESC_NSLOTS; hindex++)
+		{
+			dlist_head *slot = &gcache_shared_head->gcache_sstate_slot[hindex];
+			dlist_iter	iter;
+
+			dlist_foreach(iter, slot)
+			{
+				GpuCacheSharedState *gc_sstate;
+				bool		is_required;
+
+				gc_sstate = dlist_container(GpuCacheSharedState,
+											chain, iter.cur);
+				if (gc_sstate->cuda_dindex != cuda_dindex ||
+					gc_sstate->initial_loading != 0 ||
+					(gc_sstate->refcnt & 1) == 0)
+					continue;
+				SpinLockAcquire(&gc_sstate->redo_lock);
+				is_required = __gpuCacheCheckpointIsRequired(gc_sstate);
+				SpinLockRelease(&gc_sstate->redo_lock);
+				if (!is_required)
+					continue;
+				gc_sstate->refcnt += 2;
+				gc_sstate_list = lappend(gc_sstate_list, gc_sstate);
+			}
+		}
+		SpinLockRelease(&gcache_shared_head->gcache_sstate_lock);
+
+		foreach (lc, gc_sstate_list)
+		{
+			GpuCacheSharedState *gc_sstate = lfirst(lc);
+
+			PG_TRY();
+			{
+				(void)gpuCacheBgWorkerCheckpoint(gc_sstate);
+			}
+			PG_CATCH();
+			{
+				EmitErrorReport();
+				FlushErrorState();
+			}
+			PG_END_TRY();
+			putGpuCacheSharedState(gc_sstate, false);
+		}
+		list_free(gc_sstate_list);
+	}
 }
 
 /*
@@ -4069,6 +8381,8 @@ pgstrom_startup_gpu_cache(void)
 		elog(ERROR, "Bug? GpuCacheSharedHead already exists");
 	memset(gcache_shared_head, 0, sz);
 	SpinLockInit(&gcache_shared_head->gcache_sstate_lock);
+	pg_atomic_init_u64(&gcache_shared_head->gcache_generation, 0);
+	SpinLockInit(&gcache_shared_head->wal_sync_lock);
 	for (i=0; i < GPUCACHE_SHARED_DESC_NSLOTS; i++)
 	{
 		dlist_init(&gcache_shared_head->gcache_sstate_slot[i]);
@@ -4117,6 +8431,26 @@ pgstrom_init_gpu_cache(void)
 							 PGC_USERSET,
 							 GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
+	/* GUC: pg_strom.gpucache_checkpoint_dir */
+	DefineCustomStringVariable("pg_strom.gpucache_checkpoint_dir",
+							   "directory to save the checkpoint of GPU cache",
+							   "an empty string disables the checkpoint",
+							   &gpucache_checkpoint_dir,
+							   "",
+							   PGC_POSTMASTER,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+	/* GUC: pg_strom.gpucache_checkpoint_interval */
+	DefineCustomIntVariable("pg_strom.gpucache_checkpoint_interval",
+							"interval of the checkpoint of GPU cache",
+							"0 writes the checkpoint only on shutdown",
+							&gpucache_checkpoint_interval,
+							300,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_S,
+							NULL, NULL, NULL);
 	/* setup local hash tables */
 	memset(&hctl, 0, sizeof(HASHCTL));
 	hctl.keysize = offsetof(GpuCacheDesc, xid) + sizeof(TransactionId);
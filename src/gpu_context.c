@@ -31,6 +31,7 @@ typedef struct CudaResource
 /* variables */
 int					pgstrom_max_async_tasks;		/* GUC */
 bool				pgstrom_reuse_cuda_context;	/* GUC */
+static char		   *cuda_mps_pipe_directory = NULL;	/* GUC */
 static CudaResource *cuda_resources_array = NULL;
 static slock_t		activeGpuContextLock;
 static dlist_head	activeGpuContextList;
@@ -510,7 +511,9 @@ ReleaseLocalResources(GpuContext *gcontext, bool normal_exit)
 								__basename(tracker->filename),
 								tracker->lineno);
 					Assert(gcontext->cuda_context != NULL);
-					if (tracker->u.devmem.extra == GPUMEM_DEVICE_RAW_EXTRA)
+					/* cuMemFree() also releases stream-ordered memory */
+					if (tracker->u.devmem.extra == GPUMEM_DEVICE_RAW_EXTRA ||
+						tracker->u.devmem.extra == GPUMEM_DEVICE_POOL_EXTRA)
 					{
 						GPUCONTEXT_PUSH(gcontext);
 						rc = cuMemFree(tracker->u.devmem.ptr);
@@ -581,6 +584,8 @@ ReleaseLocalResources(GpuContext *gcontext, bool normal_exit)
 			free(tracker);
 		}
 	}
+	/* release CUDA graphs cached by the workers */
+	pgstrom_release_gpuscan_cuda_graphs(gcontext);
 	/* unmap GPU device memory segment */
 	pgstrom_gpu_mmgr_cleanup_gpucontext(gcontext);
 
@@ -665,8 +670,180 @@ GpuContextWorkerReportError(int elevel,
 
 /*
  * GpuContextWorkerMain
+ *
+ * Each worker thread has its own copy streams for host-to-device and
+ * device-to-host DMA in addition to CU_STREAM_PER_THREAD for the kernels,
+ * so the pool of worker threads on a GpuContext keeps both copy engines
+ * of the device busy. The copy streams are not synchronized with the per-
+ * thread default stream implicitly; CU_EVENT_HTOD_PER_THREAD chains the
+ * kernel launch to the completion of upload, and the caller synchronizes
+ * the download stream prior to the return of the GpuTask.
  */
 __thread CUevent		CU_EVENT_PER_THREAD = NULL;
+__thread CUstream		CU_STREAM_HTOD_PER_THREAD = NULL;
+__thread CUstream		CU_STREAM_DTOH_PER_THREAD = NULL;
+__thread CUevent		CU_EVENT_HTOD_PER_THREAD = NULL;
+
+/*
+ * gpuTaskStageMark / gpuTaskStageUpdate
+ *
+ * Each worker thread has a timing event per stage of GpuTask. The
+ * cb_process_task callback records the end of a stage by gpuTaskStageMark
+ * (GPUTASK_STAGE__QUEUE means the task is launched on the device), then
+ * gpuTaskStageUpdate accounts the interval between two consecutive marks to
+ * the later stage, on the completion of the commands. Stages not marked are
+ * merged to the next ones.
+ * gpuTaskStageDma also counts the bytes of DMA requests being enqueued, to
+ * be accounted to the task by gpuTaskStageUpdate.
+ * gpuTaskStageElapsed returns the interval of a stage being marked, prior
+ * to gpuTaskStageUpdate; e.g, for the autotuning of the kernel block size.
+ */
+static __thread CUevent	CU_EVENT_STAGE_PER_THREAD[GPUTASK_STAGE__HOST];
+static __thread cl_uint	gpu_task_stage_marks = 0;
+static __thread cl_ulong gpu_task_dma_send_bytes = 0;
+static __thread cl_ulong gpu_task_dma_recv_bytes = 0;
+
+void
+gpuTaskStageMark(int stage, CUstream stream)
+{
+	CUresult	rc;
+
+	Assert(stage >= GPUTASK_STAGE__QUEUE && stage < GPUTASK_STAGE__HOST);
+	if (stage == GPUTASK_STAGE__QUEUE)
+	{
+		gpu_task_stage_marks = 0;
+		gpu_task_dma_send_bytes = 0;
+		gpu_task_dma_recv_bytes = 0;
+	}
+	rc = cuEventRecord(CU_EVENT_STAGE_PER_THREAD[stage], stream);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuEventRecord: %s", errorText(rc));
+	gpu_task_stage_marks |= (1U << stage);
+}
+
+void
+gpuTaskStageUpdate(GpuTask *gtask)
+{
+	int			prev = -1;
+	int			stage;
+	float		elapsed;
+	CUresult	rc;
+
+	for (stage=GPUTASK_STAGE__QUEUE; stage < GPUTASK_STAGE__HOST; stage++)
+	{
+		if ((gpu_task_stage_marks & (1U << stage)) == 0)
+			continue;
+		rc = cuEventSynchronize(CU_EVENT_STAGE_PER_THREAD[stage]);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuEventSynchronize: %s", errorText(rc));
+		if (prev >= 0)
+		{
+			rc = cuEventElapsedTime(&elapsed,
+									CU_EVENT_STAGE_PER_THREAD[prev],
+									CU_EVENT_STAGE_PER_THREAD[stage]);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuEventElapsedTime: %s", errorText(rc));
+			/* stages on the different streams may overlap */
+			if (elapsed > 0.0)
+				gtask->stage_usec[stage] += (cl_ulong)(1000.0 * elapsed);
+		}
+		prev = stage;
+	}
+	gpu_task_stage_marks = 0;
+	gtask->dma_send_bytes += gpu_task_dma_send_bytes;
+	gtask->dma_recv_bytes += gpu_task_dma_recv_bytes;
+	gpu_task_dma_send_bytes = 0;
+	gpu_task_dma_recv_bytes = 0;
+}
+
+float
+gpuTaskStageElapsed(int stage)
+{
+	int			prev;
+	float		elapsed;
+	CUresult	rc;
+
+	Assert(stage > GPUTASK_STAGE__QUEUE && stage < GPUTASK_STAGE__HOST);
+	if ((gpu_task_stage_marks & (1U << stage)) == 0)
+		return -1.0;
+	for (prev = stage - 1; prev >= GPUTASK_STAGE__QUEUE; prev--)
+	{
+		if ((gpu_task_stage_marks & (1U << prev)) != 0)
+			break;
+	}
+	if (prev < GPUTASK_STAGE__QUEUE)
+		return -1.0;
+	rc = cuEventSynchronize(CU_EVENT_STAGE_PER_THREAD[stage]);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuEventSynchronize: %s", errorText(rc));
+	rc = cuEventElapsedTime(&elapsed,
+							CU_EVENT_STAGE_PER_THREAD[prev],
+							CU_EVENT_STAGE_PER_THREAD[stage]);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuEventElapsedTime: %s", errorText(rc));
+	return elapsed;
+}
+
+void
+gpuTaskStageDma(size_t send_bytes, size_t recv_bytes)
+{
+	gpu_task_dma_send_bytes += send_bytes;
+	gpu_task_dma_recv_bytes += recv_bytes;
+}
+
+/*
+ * gpuTaskStageMerge - must be called under the gcontext->worker_mutex
+ *
+ * It accumulates the timing breakdown of the completed GpuTask on the GTS,
+ * including the tasks released by the worker immediately.
+ */
+static void
+gpuTaskStageMerge(GpuTaskState *gts, GpuTask *gtask)
+{
+	int			i;
+
+	if (gtask->tv_submit.tv_sec != 0 &&
+		gtask->tv_launch.tv_sec != 0)
+		gts->stage_usec[GPUTASK_STAGE__QUEUE] += (cl_ulong)
+			(1000.0 * Max(TV_DIFF(gtask->tv_launch, gtask->tv_submit), 0.0));
+	for (i=GPUTASK_STAGE__DMA_SEND; i < GPUTASK_STAGE__HOST; i++)
+		gts->stage_usec[i] += gtask->stage_usec[i];
+	gts->dma_send_bytes += gtask->dma_send_bytes;
+	gts->dma_recv_bytes += gtask->dma_recv_bytes;
+}
+
+/*
+ * GpuContextWorkerCleanup - releases the per-thread streams and events
+ */
+static void
+GpuContextWorkerCleanup(void)
+{
+	int			i;
+
+	for (i=0; i < GPUTASK_STAGE__HOST; i++)
+	{
+		if (CU_EVENT_STAGE_PER_THREAD[i])
+		{
+			cuEventDestroy(CU_EVENT_STAGE_PER_THREAD[i]);
+			CU_EVENT_STAGE_PER_THREAD[i] = NULL;
+		}
+	}
+	if (CU_EVENT_HTOD_PER_THREAD)
+	{
+		cuEventDestroy(CU_EVENT_HTOD_PER_THREAD);
+		CU_EVENT_HTOD_PER_THREAD = NULL;
+	}
+	if (CU_STREAM_DTOH_PER_THREAD)
+	{
+		cuStreamDestroy(CU_STREAM_DTOH_PER_THREAD);
+		CU_STREAM_DTOH_PER_THREAD = NULL;
+	}
+	if (CU_STREAM_HTOD_PER_THREAD)
+	{
+		cuStreamDestroy(CU_STREAM_HTOD_PER_THREAD);
+		CU_STREAM_HTOD_PER_THREAD = NULL;
+	}
+}
 
 static void *
 GpuContextWorkerMain(void *arg)
@@ -674,6 +851,7 @@ GpuContextWorkerMain(void *arg)
 	GpuContext	   *gcontext = arg;
 	dlist_node	   *dnode;
 	GpuTask		   *gtask;
+	int				i;
 	CUresult		rc;
 
 	/* setup worker index */
@@ -689,6 +867,7 @@ GpuContextWorkerMain(void *arg)
 		return NULL;
 	}
 	GpuWorkerCurrentContext = gcontext;
+	gpuNumaBindWorkerThread(gcontext->cuda_dindex);
 
 	STROM_TRY();
 	{
@@ -697,12 +876,34 @@ GpuContextWorkerMain(void *arg)
 						   CU_EVENT_BLOCKING_SYNC);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuEventCreate: %s", errorText(rc));
+		/* setup copy streams and event for the upload */
+		rc = cuStreamCreate(&CU_STREAM_HTOD_PER_THREAD,
+							CU_STREAM_NON_BLOCKING);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuStreamCreate: %s", errorText(rc));
+		rc = cuStreamCreate(&CU_STREAM_DTOH_PER_THREAD,
+							CU_STREAM_NON_BLOCKING);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuStreamCreate: %s", errorText(rc));
+		rc = cuEventCreate(&CU_EVENT_HTOD_PER_THREAD,
+						   CU_EVENT_DISABLE_TIMING);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuEventCreate: %s", errorText(rc));
+		/* setup timing events for the stages of GpuTask */
+		for (i=0; i < GPUTASK_STAGE__HOST; i++)
+		{
+			rc = cuEventCreate(&CU_EVENT_STAGE_PER_THREAD[i],
+							   CU_EVENT_DEFAULT);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuEventCreate: %s", errorText(rc));
+		}
 
 		for (;;)
 		{
 			GpuTaskState *gts;
 			CUmodule	cuda_module;
 			cl_int		retval;
+			cl_ulong	trace_ts;
 			bool		is_wakeup;
 
 			pthreadMutexLock(&gcontext->worker_mutex);
@@ -737,12 +938,14 @@ GpuContextWorkerMain(void *arg)
 			/* ok, dispatch a GpuTask in the head of pending-queue */
 			dnode = dlist_pop_head_node(&gcontext->pending_tasks);
 			gtask = dlist_container(GpuTask, chain, dnode);
+			gpuStatUpdateTasks(gcontext, -1, 1);
 			pthreadMutexUnlock(&gcontext->worker_mutex);
 
 			gts = gtask->gts;
 			if (!gts->cuda_module)
 				werror("No CUDA module is not loaded");
 			cuda_module = gts->cuda_module;
+			gettimeofday(&gtask->tv_launch, NULL);
 
 		retry_gputask:
 			/*
@@ -755,7 +958,9 @@ GpuContextWorkerMain(void *arg)
 			 * <0 : GpuTask gets completed successfully, and the
 			 *      handler wants to release GpuTask immediately.
 			 */
+			gpuTraceTaskBegin(gtask, &trace_ts);
 			retval = gts->cb_process_task(gtask, cuda_module);
+			gpuTraceTaskEnd(gtask, trace_ts);
 			if (retval > 0)
 			{
 				pg_usleep(20000L);		/* 20ms */
@@ -765,6 +970,7 @@ GpuContextWorkerMain(void *arg)
 					/* urgent bailout if GpuContext is shutting down. */
 					dlist_push_tail(&gcontext->pending_tasks,
 									&gtask->chain);
+					gpuStatUpdateTasks(gcontext, 1, -1);
 					gts->num_running_tasks--;
 					pthreadMutexUnlock(&gcontext->worker_mutex);
 					break;
@@ -788,7 +994,10 @@ GpuContextWorkerMain(void *arg)
 			else if (retval == 0)
 			{
 				/* Back GpuTask to GTS */
+				gettimeofday(&gtask->tv_ready, NULL);
 				pthreadMutexLock(&gcontext->worker_mutex);
+				gpuTaskStageMerge(gts, gtask);
+				gpuStatUpdateTasks(gcontext, 0, -1);
 				dlist_push_tail(&gts->ready_tasks,
 								&gtask->chain);
 				gts->num_running_tasks--;
@@ -807,6 +1016,8 @@ GpuContextWorkerMain(void *arg)
 				 * to give the chance to release resources.
 				 */
 				pthreadMutexLock(&gcontext->worker_mutex);
+				gpuTaskStageMerge(gts, gtask);
+				gpuStatUpdateTasks(gcontext, 0, -1);
 				if (--gts->num_running_tasks == 0 &&
 					retval == -2 &&
 					gts->scan_done)
@@ -836,6 +1047,7 @@ GpuContextWorkerMain(void *arg)
 		SetLatch(MyLatch);
 	}
 	STROM_END_TRY();
+	GpuContextWorkerCleanup();
 
 	return NULL;
 }
@@ -979,12 +1191,12 @@ AllocGpuContext(int cuda_dindex,
 	if (!gcontext)
 		elog(ERROR, "out of memory");
 
-	/* choose a device to use, if no preference */
+	/* choose a device to use, if no preference; the nearest NUMA node */
 	if (cuda_dindex < 0)
 	{
-		cuda_dindex = (IsParallelWorker()
-					   ? ParallelWorkerNumber
-					   : MyProc->pgprocno) % numDevAttrs;
+		cuda_dindex = gpuNumaNearestDevice(NULL, 0, (IsParallelWorker()
+													 ? ParallelWorkerNumber
+													 : MyProc->pgprocno));
 	}
 
 	/* setup fields */
@@ -995,6 +1207,8 @@ AllocGpuContext(int cuda_dindex,
 	SpinLockInit(&gcontext->restrack_lock);
 	for (i=0; i < RESTRACK_HASHSIZE; i++)
 		dlist_init(&gcontext->restrack[i]);
+	SpinLockInit(&gcontext->cuda_graph_lock);
+	dlist_init(&gcontext->cuda_graph_list);
 	/* GPU device memory management */
 	pgstrom_gpu_mmgr_init_gpucontext(gcontext);
 	/* error information buffer */
@@ -1236,8 +1450,35 @@ pgstrom_init_gpu_context(void)
 							 GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
 
-	/* force to disable MPS to avoid troubles */
-	if (setenv("CUDA_MPS_PIPE_DIRECTORY", "/dev/null", 1) != 0)
+	DefineCustomStringVariable("pg_strom.cuda_mps_pipe_directory",
+							   "Pipe directory of the CUDA MPS control daemon",
+							   "MPS is not used, if empty",
+							   &cuda_mps_pipe_directory,
+							   NULL,
+							   PGC_POSTMASTER,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+	/*
+	 * Under the CUDA Multi-Process Service (MPS), the MPS server owns the
+	 * only CUDA context per GPU device, and the backends and the parallel
+	 * workers connect to the server as clients. It makes the CUDA context
+	 * construction cheap, and kernels by the concurrent sessions run on the
+	 * device concurrently, without time-slicing. Elsewhere, we force to
+	 * disable MPS to avoid troubles.
+	 */
+	if (cuda_mps_pipe_directory && cuda_mps_pipe_directory[0] != '\0')
+	{
+		char		path[MAXPGPATH];
+		struct stat	stat_buf;
+
+		snprintf(path, sizeof(path), "%s/control", cuda_mps_pipe_directory);
+		if (stat(path, &stat_buf) != 0)
+			elog(WARNING, "CUDA MPS control daemon looks not running at '%s' (%m); start nvidia-cuda-mps-control -d with CUDA_MPS_PIPE_DIRECTORY='%s'",
+				 cuda_mps_pipe_directory, cuda_mps_pipe_directory);
+		if (setenv("CUDA_MPS_PIPE_DIRECTORY", cuda_mps_pipe_directory, 1) != 0)
+			elog(ERROR, "failed on setenv: %m");
+	}
+	else if (setenv("CUDA_MPS_PIPE_DIRECTORY", "/dev/null", 1) != 0)
 		elog(ERROR, "failed on setenv: %m");
 
 	/* initialization of GpuContext List */
@@ -10,6 +10,9 @@
  * it under the terms of the PostgreSQL License.
  */
 #include "pg_strom.h"
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 
 /* variable declarations */
 DevAttributes	   *devAttrs = NULL;
@@ -60,6 +63,10 @@ Datum pgstrom_gpu_pci_id(PG_FUNCTION_ARGS);
 static bool		gpudirect_driver_is_initialized = false;
 static bool		__pgstrom_gpudirect_enabled;	/* GUC */
 static int		__pgstrom_gpudirect_threshold;	/* GUC */
+static bool		pgstrom_numa_aware_placement;	/* GUC */
+static bool		pgstrom_numa_bind_workers;		/* GUC */
+/* NUMA distance map; 0 = not loaded, -1 = unknown */
+static int		numa_distance_map[NUMA_MAX_NODES][NUMA_MAX_NODES];
 
 /*
  * pgstrom_gpudirect_enabled
@@ -324,6 +331,223 @@ pgstrom_collect_gpu_device(void)
 	return false;
 }
 
+/*
+ * numaCurrentNodeId - NUMA node-id where the current thread is running
+ */
+static int
+numaCurrentNodeId(void)
+{
+	unsigned int	cpu;
+	unsigned int	node;
+
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 ||
+		node >= NUMA_MAX_NODES)
+		return -1;
+	return node;
+}
+
+/*
+ * numaNodeDistance - distance between the NUMA nodes, or -1 if unknown
+ *
+ * Note that it can be called by the worker threads, so never use elog().
+ */
+static int
+numaNodeDistance(int from, int to)
+{
+	if (from < 0 || from >= NUMA_MAX_NODES ||
+		to   < 0 || to   >= NUMA_MAX_NODES)
+		return -1;
+	if (numa_distance_map[from][0] == 0)
+	{
+		char	path[MAXPGPATH];
+		char	linebuf[1024];
+		char   *tok, *saveptr;
+		FILE   *filp;
+		int		i = 0;
+
+		snprintf(path, sizeof(path),
+				 "/sys/devices/system/node/node%d/distance", from);
+		filp = fopen(path, "r");
+		if (filp)
+		{
+			if (fgets(linebuf, sizeof(linebuf), filp))
+			{
+				for (tok = strtok_r(linebuf, " \n", &saveptr);
+					 tok != NULL && i < NUMA_MAX_NODES;
+					 tok = strtok_r(NULL, " \n", &saveptr))
+					numa_distance_map[from][i++] = atoi(tok);
+			}
+			fclose(filp);
+		}
+		while (i < NUMA_MAX_NODES)
+			numa_distance_map[from][i++] = -1;
+	}
+	return numa_distance_map[from][to];
+}
+
+/*
+ * gpuNumaNearestDevice
+ *
+ * It chooses a GPU device from the @candidates (or all the devices if NULL)
+ * which is the nearest to the NUMA node where the current thread is running.
+ * If multiple devices have the same distance, @seed chooses one of them.
+ */
+int
+gpuNumaNearestDevice(const int *candidates, int ncandidates, int seed)
+{
+	int	   *nearest;
+	int		nitems = 0;
+	int		min_dist = INT_MAX;
+	int		curr_node;
+	int		i;
+
+	if (!candidates)
+		ncandidates = numDevAttrs;
+	if (ncandidates <= 0)
+		return -1;
+	seed = Abs(seed);
+	curr_node = (pgstrom_numa_aware_placement ? numaCurrentNodeId() : -1);
+	if (curr_node < 0)
+		goto no_preference;
+
+	nearest = alloca(sizeof(int) * ncandidates);
+	for (i=0; i < ncandidates; i++)
+	{
+		int		dindex = (candidates ? candidates[i] : i);
+		int		dist;
+
+		if (dindex < 0 || dindex >= numDevAttrs)
+			continue;
+		dist = numaNodeDistance(curr_node, devAttrs[dindex].NUMA_NODE_ID);
+		if (dist < 0)
+			goto no_preference;
+		if (dist < min_dist)
+		{
+			min_dist = dist;
+			nitems = 0;
+		}
+		if (dist == min_dist)
+			nearest[nitems++] = dindex;
+	}
+	if (nitems > 0)
+		return nearest[seed % nitems];
+no_preference:
+	return (candidates ? candidates[seed % ncandidates] : seed % ncandidates);
+}
+
+/*
+ * gpuNumaPreferLocalMemory
+ *
+ * It changes the memory policy of the current thread to prefer the NUMA
+ * node local to the GPU device, prior to allocation of the pinned host
+ * memory. Pages of the pinned memory are populated at the allocation time,
+ * then never migrated, so the DMA over the inter-socket link can be avoided.
+ * Caller must restore the policy by gpuNumaRestoreMemPolicy().
+ */
+void
+gpuNumaPreferLocalMemory(int cuda_dindex, NumaMemPolicy *saved)
+{
+	unsigned long	nodemask[NUMA_NODEMASK_WORDS];
+	int				node;
+
+	saved->is_valid = false;
+	if (!pgstrom_numa_aware_placement ||
+		cuda_dindex < 0 || cuda_dindex >= numDevAttrs)
+		return;
+	node = devAttrs[cuda_dindex].NUMA_NODE_ID;
+	if (node < 0 || node >= NUMA_MAX_NODES)
+		return;
+	if (syscall(SYS_get_mempolicy,
+				&saved->mode,
+				saved->nodemask,
+				NUMA_MAX_NODES,
+				NULL, 0) != 0)
+		return;
+	memset(nodemask, 0, sizeof(nodemask));
+	nodemask[node / (BITS_PER_BYTE * SIZEOF_LONG)]
+		|= (1UL << (node % (BITS_PER_BYTE * SIZEOF_LONG)));
+	if (syscall(SYS_set_mempolicy,
+				MPOL_PREFERRED,
+				nodemask,
+				NUMA_MAX_NODES) != 0)
+		return;
+	saved->is_valid = true;
+}
+
+/*
+ * gpuNumaRestoreMemPolicy
+ */
+void
+gpuNumaRestoreMemPolicy(NumaMemPolicy *saved)
+{
+	if (saved->is_valid)
+	{
+		syscall(SYS_set_mempolicy,
+				saved->mode,
+				saved->nodemask,
+				NUMA_MAX_NODES);
+		saved->is_valid = false;
+	}
+}
+
+/*
+ * gpuNumaBindWorkerThread
+ *
+ * It binds the current worker thread on the CPUs of the NUMA node local to
+ * the GPU device, if pg_strom.numa_bind_workers is enabled.
+ */
+void
+gpuNumaBindWorkerThread(int cuda_dindex)
+{
+	cpu_set_t	cpuset;
+	char		path[MAXPGPATH];
+	char		linebuf[2048];
+	char	   *tok, *saveptr;
+	FILE	   *filp;
+	int			node;
+	int			count = 0;
+
+	if (!pgstrom_numa_aware_placement ||
+		!pgstrom_numa_bind_workers ||
+		cuda_dindex < 0 || cuda_dindex >= numDevAttrs)
+		return;
+	node = devAttrs[cuda_dindex].NUMA_NODE_ID;
+	if (node < 0)
+		return;
+
+	/* cpulist is a comma separated list of ranges; like '0-15,32-47' */
+	snprintf(path, sizeof(path),
+			 "/sys/devices/system/node/node%d/cpulist", node);
+	filp = fopen(path, "r");
+	if (!filp)
+		return;
+	if (!fgets(linebuf, sizeof(linebuf), filp))
+		linebuf[0] = '\0';
+	fclose(filp);
+
+	CPU_ZERO(&cpuset);
+	for (tok = strtok_r(linebuf, ",\n", &saveptr);
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",\n", &saveptr))
+	{
+		int		lo, hi;
+
+		if (sscanf(tok, "%d-%d", &lo, &hi) != 2)
+		{
+			if (sscanf(tok, "%d", &lo) != 1)
+				continue;
+			hi = lo;
+		}
+		for (; lo <= hi && lo < CPU_SETSIZE; lo++)
+		{
+			CPU_SET(lo, &cpuset);
+			count++;
+		}
+	}
+	if (count > 0)
+		pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+}
+
 /*
  * pgstrom_init_gpu_device
  */
@@ -399,6 +623,24 @@ pgstrom_init_gpu_device(void)
 							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
 							NULL, NULL, NULL);
 
+	/* pg_strom.numa_aware_placement */
+	DefineCustomBoolVariable("pg_strom.numa_aware_placement",
+							 "Enables NUMA aware placement of pinned buffers and GPUs",
+							 NULL,
+							 &pgstrom_numa_aware_placement,
+							 true,
+							 PGC_SUSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.numa_bind_workers */
+	DefineCustomBoolVariable("pg_strom.numa_bind_workers",
+							 "Binds GPU worker threads on the CPUs local to the GPU",
+							 NULL,
+							 &pgstrom_numa_bind_workers,
+							 false,
+							 PGC_SUSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 }
 
 /*
@@ -540,6 +782,64 @@ __gpuOptimalBlockSize(int *p_grid_sz,
 	return CUDA_SUCCESS;
 }
 
+/*
+ * gpuAutotuneBlockSize
+ *
+ * It works like __gpuOptimalBlockSize, however, the block size is picked up
+ * by the autotuning of the program on the device; the candidates not larger
+ * than the one by occupancy calculation are tried on the first launches, then
+ * the fastest one is used later. The grid size follows the occupancy for the
+ * block size (and dynamic shared memory) being chosen. @p_trial returns the
+ * candidate index to be reported by pgstrom_autotune_report, or -1.
+ */
+CUresult
+gpuAutotuneBlockSize(int *p_grid_sz,
+					 int *p_block_sz,
+					 int *p_trial,
+					 CUfunction kern_function,
+					 ProgramId program_id,
+					 const char *kern_fname,
+					 int cuda_dindex,
+					 size_t dynamic_shmem_per_block,
+					 size_t dynamic_shmem_per_thread)
+{
+	cl_int		mp_count = devAttrs[cuda_dindex].MULTIPROCESSOR_COUNT;
+	cl_int		grid_sz;
+	cl_int		block_sz;
+	cl_int		max_multiplicity;
+	size_t		dynamic_shmem_sz;
+	CUresult	rc;
+
+	rc = __gpuOptimalBlockSize(&grid_sz,
+							   &block_sz,
+							   kern_function,
+							   cuda_dindex,
+							   dynamic_shmem_per_block,
+							   dynamic_shmem_per_thread);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	*p_grid_sz = grid_sz;
+	*p_block_sz = pgstrom_autotune_block_size(program_id,
+											  kern_fname,
+											  cuda_dindex,
+											  block_sz,
+											  p_trial);
+	if (*p_block_sz != block_sz)
+	{
+		dynamic_shmem_sz = (dynamic_shmem_per_block +
+							dynamic_shmem_per_thread * (*p_block_sz));
+		rc = cuOccupancyMaxActiveBlocksPerMultiprocessor(&max_multiplicity,
+														 kern_function,
+														 *p_block_sz,
+														 dynamic_shmem_sz);
+		if (rc != CUDA_SUCCESS)
+			return rc;
+		*p_grid_sz = Min(GPUKERNEL_MAX_SM_MULTIPLICITY,
+						 max_multiplicity) * mp_count;
+	}
+	return CUDA_SUCCESS;
+}
+
 /*
  * pgstrom_device_info - SQL function to dump device info
  */
@@ -10,12 +10,23 @@
  * it under the terms of the PostgreSQL License.
  */
 #include "pg_strom.h"
+#include <dlfcn.h>
+#include <nvml.h>
 
 #define GPUMEM_CHUNKSZ_MAX_BIT		30		/* 1GB */
 #define GPUMEM_CHUNKSZ_MIN_BIT		14		/* 16KB */
 #define GPUMEM_CHUNKSZ_MAX			(1UL << GPUMEM_CHUNKSZ_MAX_BIT)
 #define GPUMEM_CHUNKSZ_MIN			(1UL << GPUMEM_CHUNKSZ_MIN_BIT)
 
+/*
+ * Chunks less than or equal to 1MB are cached by GpuContext once released,
+ * and reused without split/merge of the buddy chunks and the segment lock.
+ * A refill picks up multiple chunks from a segment at once.
+ */
+#define GPUMEM_SLAB_MAX_BIT			20		/* 1MB */
+#define GPUMEM_SLAB_REFILL_SIZE		(1UL << 20)		/* 1MB */
+#define GPUMEM_SLAB_CACHE_SIZE		(4UL << 20)		/* 4MB */
+
 typedef enum
 {
 	GpuMemKind__NormalMemory	= (1 << 0),
@@ -24,13 +35,18 @@ typedef enum
 	GpuMemKind__HostMemory		= (1 << 3),
 } GpuMemKind;
 
+struct GpuMemSegment;
+
 typedef struct
 {
 	dlist_node		chain;
 	cl_int			mclass;
-	cl_int			refcnt;
+	cl_int			refcnt;		/* GPUMEMCHUNK_SLAB_CACHED if cached */
+	struct GpuMemSegment *gm_seg;	/* valid only if active or cached */
 } GpuMemChunk;
 
+#define GPUMEMCHUNK_SLAB_CACHED		(-1)
+
 #define GPUMEMCHUNK_IS_FREE(chunk)					\
 	((chunk)->chain.prev != NULL &&					\
 	 (chunk)->chain.next != NULL &&					\
@@ -44,7 +60,7 @@ typedef struct
 	 (chunk)->mclass <= GPUMEM_CHUNKSZ_MAX_BIT &&	 \
 	 (chunk)->refcnt > 0)
 
-typedef struct
+typedef struct GpuMemSegment
 {
 	dlist_node		chain;
 	cl_int			cuda_dindex;
@@ -57,14 +73,38 @@ typedef struct
 	GpuMemChunk		gm_chunks[FLEXIBLE_ARRAY_MEMBER];
 } GpuMemSegment;
 
-/* statistics of GPU memory usage (shared; per device) */
-//to be used for memory release request mechanism
+/*
+ * statistics of GPU memory usage (shared; per device)
+ *
+ * @budget_usage is the total device memory budget reserved by GpuTaskStates
+ * for the admission control. @shrink_requested asks the reclaimable caches
+ * (like GPU cache) to release their device memory, under memory pressure.
+ *
+ * The operational statistics below are shown by the pgstrom.pg_stat_gpu
+ * view. The nvml_* fields are sampled by the GPU memory keeper once a
+ * second, and UINT_MAX means NVML is not available.
+ */
 typedef struct
 {
 	size_t				total_size;
 	pg_atomic_uint64	normal_usage;
 	pg_atomic_uint64	managed_usage;
 	pg_atomic_uint64	iomap_usage;
+	slock_t				budget_lock;
+	size_t				budget_usage;
+	pg_atomic_uint32	shrink_requested;
+	/* operational statistics */
+	pg_atomic_uint32	num_contexts;		/* # of active GpuContexts */
+	pg_atomic_uint32	num_queued_tasks;	/* # of tasks in pending lists */
+	pg_atomic_uint32	num_running_tasks;	/* # of tasks being processed */
+	pg_atomic_uint64	num_gpu_tasks;		/* # of chunks processed by GPU */
+	pg_atomic_uint64	num_cpu_fallbacks;	/* # of chunks fallen back to CPU */
+	pg_atomic_uint32	nvml_sm_util;		/* [%] */
+	pg_atomic_uint32	nvml_mem_util;		/* [%] */
+	pg_atomic_uint32	nvml_pcie_tx;		/* [KB/s] */
+	pg_atomic_uint32	nvml_pcie_rx;		/* [KB/s] */
+	pg_atomic_uint64	nvml_mem_used;		/* [bytes] */
+	pg_atomic_uint64	nvml_sampled_at;	/* TimestampTz, or 0 */
 } GpuMemStatistics;
 
 /*
@@ -116,39 +156,144 @@ static shmem_startup_hook_type shmem_startup_next = NULL;
 static GpuMemStatistics *gm_stat_array = NULL;
 static int			gpu_memory_segment_size_kb;	/* GUC */
 static size_t		gm_segment_sz;	/* bytesize */
+static int			gpu_memory_allocator;		/* GUC */
+static int			gpu_memory_admission_ratio;	/* GUC */
+static int			gpu_memory_admission_timeout;	/* GUC */
+static int			gpu_mempool_release_threshold_kb;	/* GUC */
+bool				pgstrom_gpu_memory_oversubscription;	/* GUC */
+#if CUDA_VERSION >= 11020
+static pthread_mutex_t gm_mempool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static CUmemoryPool *gm_mempool_array = NULL;	/* per device */
+static cuuint64_t  *gm_mempool_threshold = NULL;	/* per device */
+#endif
+
+#define GPUMEM_ALLOCATOR__SEGMENT	0
+#define GPUMEM_ALLOCATOR__MEMPOOL	1
+static const struct config_enum_entry gpu_memory_allocator_options[] = {
+	{"segment",	GPUMEM_ALLOCATOR__SEGMENT, false},
+	{"mempool",	GPUMEM_ALLOCATOR__MEMPOOL, false},
+	{NULL, 0, false},
+};
 
 static bool			gpummgr_bgworker_got_signal = false;
 static GpuMemPreservedHead *gmemp_head = NULL;
 static HTAB		   *gmemp_htab = NULL;	/* for GpuMemPreserved */
 
+/* NVML is opened on demand by the GPU memory keeper */
+static nvmlReturn_t (*p_nvmlInit_v2)(void) = NULL;
+static nvmlReturn_t (*p_nvmlShutdown)(void) = NULL;
+static const char *(*p_nvmlErrorString)(nvmlReturn_t result) = NULL;
+static nvmlReturn_t (*p_nvmlDeviceGetHandleByPciBusId_v2)(
+	const char *pciBusId,
+	nvmlDevice_t *device) = NULL;
+static nvmlReturn_t (*p_nvmlDeviceGetUtilizationRates)(
+	nvmlDevice_t device,
+	nvmlUtilization_t *utilization) = NULL;
+static nvmlReturn_t (*p_nvmlDeviceGetMemoryInfo)(
+	nvmlDevice_t device,
+	nvmlMemory_t *memory) = NULL;
+static nvmlReturn_t (*p_nvmlDeviceGetPcieThroughput)(
+	nvmlDevice_t device,
+	nvmlPcieUtilCounter_t counter,
+	unsigned int *value) = NULL;
+static nvmlDevice_t	gpummgr_nvml_device = NULL;
+static TimestampTz	gpummgr_nvml_last_sampled = 0;
+
 /*
- * gpuMemFreeChunk
+ * gpuMemSlabLookup - returns the slab cache for the memory kind and class
  */
-static CUresult
-gpuMemFreeChunk(GpuContext *gcontext,
-				CUdeviceptr m_deviceptr,
-				GpuMemSegment *gm_seg)
+static inline GpuMemSlabCache *
+gpuMemSlabLookup(GpuContext *gcontext, GpuMemKind gm_kind, cl_int mclass)
 {
-	GpuMemChunk	   *gm_chunk;
-	GpuMemChunk	   *gm_buddy;
-	cl_long			unitsz = GPUMEM_CHUNKSZ_MIN;
-	cl_long			nchunks = gm_segment_sz / unitsz;
-	cl_long			index;
-	cl_long			shift;
+	int		kindex;
 
-	Assert(m_deviceptr >= gm_seg->m_segment &&
-		   m_deviceptr <  gm_seg->m_segment + gm_segment_sz);
-	index = (m_deviceptr - gm_seg->m_segment) / unitsz;
-	Assert(index >= 0 && index < nchunks);
-	gm_chunk = &gm_seg->gm_chunks[index];
-	Assert(GPUMEMCHUNK_IS_ACTIVE(gm_chunk));
-	SpinLockAcquire(&gm_seg->lock);
-	if (--gm_chunk->refcnt > 0)
+	Assert(mclass >= GPUMEM_CHUNKSZ_MIN_BIT &&
+		   mclass <= GPUMEM_SLAB_MAX_BIT);
+	switch (gm_kind)
 	{
-		SpinLockRelease(&gm_seg->lock);
-		return CUDA_SUCCESS;
+		case GpuMemKind__NormalMemory:	kindex = 0; break;
+		case GpuMemKind__ManagedMemory:	kindex = 1; break;
+		case GpuMemKind__IOMapMemory:	kindex = 2; break;
+		case GpuMemKind__HostMemory:	kindex = 3; break;
+		default:
+			return NULL;
+	}
+	return &gcontext->gm_slab[kindex][mclass - GPUMEM_CHUNKSZ_MIN_BIT];
+}
+
+/*
+ * gpuMemSlabPutChunk - keeps the released chunk on the slab cache, if
+ * it has enough room.
+ */
+static bool
+gpuMemSlabPutChunk(GpuContext *gcontext,
+				   GpuMemSegment *gm_seg,
+				   GpuMemChunk *gm_chunk)
+{
+	GpuMemSlabCache *gm_slab;
+	cl_int		max_items;
+
+	gm_slab = gpuMemSlabLookup(gcontext, gm_seg->gm_kind, gm_chunk->mclass);
+	if (!gm_slab)
+		return false;
+	max_items = (GPUMEM_SLAB_CACHE_SIZE >> gm_chunk->mclass);
+	SpinLockAcquire(&gm_slab->lock);
+	if (gm_slab->nitems >= max_items)
+	{
+		SpinLockRelease(&gm_slab->lock);
+		return false;
 	}
+	Assert(gm_chunk->gm_seg == gm_seg);
+	gm_chunk->refcnt = GPUMEMCHUNK_SLAB_CACHED;
+	dlist_push_head(&gm_slab->free_chunks, &gm_chunk->chain);
+	gm_slab->nitems++;
+	SpinLockRelease(&gm_slab->lock);
 
+	return true;
+}
+
+/*
+ * gpuMemSlabGetChunk - picks up a cached chunk, or NULL if empty
+ */
+static GpuMemChunk *
+gpuMemSlabGetChunk(GpuContext *gcontext, GpuMemKind gm_kind, cl_int mclass)
+{
+	GpuMemSlabCache *gm_slab = gpuMemSlabLookup(gcontext, gm_kind, mclass);
+	GpuMemChunk	   *gm_chunk = NULL;
+	dlist_node	   *dnode;
+
+	if (!gm_slab)
+		return NULL;
+	SpinLockAcquire(&gm_slab->lock);
+	if (!dlist_is_empty(&gm_slab->free_chunks))
+	{
+		dnode = dlist_pop_head_node(&gm_slab->free_chunks);
+		gm_chunk = dlist_container(GpuMemChunk, chain, dnode);
+		Assert(gm_chunk->refcnt == GPUMEMCHUNK_SLAB_CACHED &&
+			   gm_chunk->mclass == mclass);
+		memset(&gm_chunk->chain, 0, sizeof(dlist_node));
+		gm_chunk->refcnt = 1;
+		gm_slab->nitems--;
+	}
+	SpinLockRelease(&gm_slab->lock);
+
+	return gm_chunk;
+}
+
+/*
+ * __gpuMemMergeChunk - releases the chunk to the free list of the segment,
+ * with merging the buddy chunks. Caller must hold gm_seg->lock.
+ */
+static void
+__gpuMemMergeChunk(GpuMemSegment *gm_seg, GpuMemChunk *gm_chunk)
+{
+	GpuMemChunk	   *gm_buddy;
+	cl_long			nchunks = gm_segment_sz / GPUMEM_CHUNKSZ_MIN;
+	cl_long			index;
+	cl_long			shift;
+
+	gm_chunk->refcnt = 0;
+	gm_chunk->gm_seg = NULL;
 	/* merge with prev/next free chunks if any */
 	while (gm_chunk->mclass < GPUMEM_CHUNKSZ_MAX_BIT)
 	{
@@ -196,6 +341,103 @@ gpuMemFreeChunk(GpuContext *gcontext,
 	dlist_push_head(&gm_seg->free_chunks[gm_chunk->mclass],
 					&gm_chunk->chain);
 	pg_atomic_fetch_sub_u32(&gm_seg->num_active_chunks, 1);
+}
+
+/*
+ * gpuMemSlabDrain - releases all the cached chunks of the memory kind
+ * (or all the kinds if 0) to the segments
+ */
+static bool
+gpuMemSlabDrain(GpuContext *gcontext, int gm_kinds)
+{
+	static const GpuMemKind gm_kind_array[] = {
+		GpuMemKind__NormalMemory,
+		GpuMemKind__ManagedMemory,
+		GpuMemKind__IOMapMemory,
+		GpuMemKind__HostMemory,
+	};
+	bool		drained = false;
+	int			i, mclass;
+
+	for (i=0; i < lengthof(gm_kind_array); i++)
+	{
+		if (gm_kinds != 0 && (gm_kinds & gm_kind_array[i]) == 0)
+			continue;
+		for (mclass = GPUMEM_CHUNKSZ_MIN_BIT;
+			 mclass <= GPUMEM_SLAB_MAX_BIT;
+			 mclass++)
+		{
+			GpuMemSlabCache *gm_slab;
+			GpuMemChunk *gm_chunk;
+			GpuMemSegment *gm_seg;
+			dlist_head	temp;
+			dlist_node *dnode;
+
+			gm_slab = gpuMemSlabLookup(gcontext, gm_kind_array[i], mclass);
+			SpinLockAcquire(&gm_slab->lock);
+			if (dlist_is_empty(&gm_slab->free_chunks))
+			{
+				SpinLockRelease(&gm_slab->lock);
+				continue;
+			}
+			dlist_init(&temp);
+			while (!dlist_is_empty(&gm_slab->free_chunks))
+			{
+				dnode = dlist_pop_head_node(&gm_slab->free_chunks);
+				dlist_push_tail(&temp, dnode);
+			}
+			gm_slab->nitems = 0;
+			SpinLockRelease(&gm_slab->lock);
+
+			while (!dlist_is_empty(&temp))
+			{
+				dnode = dlist_pop_head_node(&temp);
+				gm_chunk = dlist_container(GpuMemChunk, chain, dnode);
+				Assert(gm_chunk->refcnt == GPUMEMCHUNK_SLAB_CACHED);
+				memset(&gm_chunk->chain, 0, sizeof(dlist_node));
+				gm_seg = gm_chunk->gm_seg;
+				SpinLockAcquire(&gm_seg->lock);
+				__gpuMemMergeChunk(gm_seg, gm_chunk);
+				SpinLockRelease(&gm_seg->lock);
+			}
+			drained = true;
+		}
+	}
+	return drained;
+}
+
+/*
+ * gpuMemFreeChunk
+ */
+static CUresult
+gpuMemFreeChunk(GpuContext *gcontext,
+				CUdeviceptr m_deviceptr,
+				GpuMemSegment *gm_seg)
+{
+	GpuMemChunk	   *gm_chunk;
+	cl_long			unitsz = GPUMEM_CHUNKSZ_MIN;
+	cl_long			nchunks = gm_segment_sz / unitsz;
+	cl_long			index;
+
+	Assert(m_deviceptr >= gm_seg->m_segment &&
+		   m_deviceptr <  gm_seg->m_segment + gm_segment_sz);
+	index = (m_deviceptr - gm_seg->m_segment) / unitsz;
+	Assert(index >= 0 && index < nchunks);
+	gm_chunk = &gm_seg->gm_chunks[index];
+	Assert(GPUMEMCHUNK_IS_ACTIVE(gm_chunk));
+	/* small chunks are kept on the slab cache, if possible */
+	if (gm_chunk->mclass <= GPUMEM_SLAB_MAX_BIT &&
+		gm_chunk->refcnt == 1 &&
+		gpuMemSlabPutChunk(gcontext, gm_seg, gm_chunk))
+		return CUDA_SUCCESS;
+
+	SpinLockAcquire(&gm_seg->lock);
+	if (--gm_chunk->refcnt > 0)
+	{
+		SpinLockRelease(&gm_seg->lock);
+		return CUDA_SUCCESS;
+	}
+	__gpuMemMergeChunk(gm_seg, gm_chunk);
 	SpinLockRelease(&gm_seg->lock);
 
     return CUDA_SUCCESS;
@@ -218,6 +460,10 @@ gpuMemFreeExtra(GpuContext *gcontext,
 		rc = cuMemFree(m_deviceptr);
 	else if (extra == GPUMEM_HOST_RAW_EXTRA)
 		rc = cuMemFreeHost((void *)m_deviceptr);
+#if CUDA_VERSION >= 11020
+	else if (extra == GPUMEM_DEVICE_POOL_EXTRA)
+		rc = cuMemFreeAsync(m_deviceptr, CU_STREAM_PER_THREAD);
+#endif
 	else
 		rc = gpuMemFreeChunk(gcontext, m_deviceptr, (GpuMemSegment *)extra);
 	GPUCONTEXT_POP(gcontext);
@@ -280,6 +526,118 @@ __gpuMemAllocRaw(GpuContext *gcontext,
 	return rc;
 }
 
+#if CUDA_VERSION >= 11020
+/*
+ * gpuMemPoolLookup - returns the stream-ordered memory pool of the device,
+ * or NULL if not available. The pool is shared by all the GpuContexts on
+ * the same device in this process.
+ */
+static CUmemoryPool
+gpuMemPoolLookup(GpuContext *gcontext)
+{
+	cl_int		dindex = gcontext->cuda_dindex;
+	cuuint64_t	threshold = (cuuint64_t)gpu_mempool_release_threshold_kb << 10;
+	CUmemoryPool mempool;
+	CUresult	rc;
+
+	if (!devAttrs[dindex].MEMORY_POOLS_SUPPORTED)
+		return NULL;
+	pthreadMutexLock(&gm_mempool_mutex);
+	if (!gm_mempool_array)
+	{
+		gm_mempool_array = calloc(numDevAttrs, sizeof(CUmemoryPool));
+		gm_mempool_threshold = calloc(numDevAttrs, sizeof(cuuint64_t));
+		if (!gm_mempool_array || !gm_mempool_threshold)
+		{
+			if (gm_mempool_array)
+				free(gm_mempool_array);
+			if (gm_mempool_threshold)
+				free(gm_mempool_threshold);
+			gm_mempool_array = NULL;
+			gm_mempool_threshold = NULL;
+			pthreadMutexUnlock(&gm_mempool_mutex);
+			return NULL;
+		}
+	}
+	mempool = gm_mempool_array[dindex];
+	if (!mempool)
+	{
+		CUmemPoolProps	props;
+
+		memset(&props, 0, sizeof(CUmemPoolProps));
+		props.allocType     = CU_MEM_ALLOCATION_TYPE_PINNED;
+		props.handleTypes   = CU_MEM_HANDLE_TYPE_NONE;
+		props.location.type = CU_MEM_LOCATION_TYPE_DEVICE;
+		props.location.id   = devAttrs[dindex].DEV_ID;
+		rc = cuMemPoolCreate(&mempool, &props);
+		if (rc != CUDA_SUCCESS)
+		{
+			pthreadMutexUnlock(&gm_mempool_mutex);
+			wnotice("failed on cuMemPoolCreate: %s", errorText(rc));
+			return NULL;
+		}
+		gm_mempool_array[dindex] = mempool;
+		gm_mempool_threshold[dindex] = 0;
+	}
+	/* memory more than the threshold is released on synchronization */
+	if (gm_mempool_threshold[dindex] != threshold)
+	{
+		rc = cuMemPoolSetAttribute(mempool,
+								   CU_MEMPOOL_ATTR_RELEASE_THRESHOLD,
+								   &threshold);
+		if (rc == CUDA_SUCCESS)
+			gm_mempool_threshold[dindex] = threshold;
+		else
+			wnotice("failed on cuMemPoolSetAttribute: %s", errorText(rc));
+	}
+	pthreadMutexUnlock(&gm_mempool_mutex);
+
+	return mempool;
+}
+
+/*
+ * __gpuMemAllocPool - stream-ordered device memory allocation
+ *
+ * The device memory is available for the operations on the per-thread
+ * stream of the caller, then gpuMemFree() releases it after completion
+ * of the preceding operations on the stream, without host synchronization.
+ */
+static CUresult
+__gpuMemAllocPool(GpuContext *gcontext,
+				  CUmemoryPool mempool,
+				  CUdeviceptr *p_deviceptr,
+				  size_t bytesize,
+				  const char *filename, int lineno)
+{
+	CUdeviceptr	m_deviceptr;
+	CUresult	rc;
+
+	GPUCONTEXT_PUSH(gcontext);
+	rc = cuMemAllocFromPoolAsync(&m_deviceptr, bytesize, mempool,
+								 CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+	{
+		if (rc != CUDA_ERROR_OUT_OF_MEMORY)
+			wnotice("failed on cuMemAllocFromPoolAsync(%zu): %s",
+					bytesize, errorText(rc));
+	}
+	else if (!trackGpuMem(gcontext, m_deviceptr,
+						  GPUMEM_DEVICE_POOL_EXTRA,
+						  filename, lineno))
+	{
+		cuMemFreeAsync(m_deviceptr, CU_STREAM_PER_THREAD);
+		rc = CUDA_ERROR_OUT_OF_MEMORY;
+	}
+	else
+	{
+		*p_deviceptr = m_deviceptr;
+	}
+	GPUCONTEXT_POP(gcontext);
+
+	return rc;
+}
+#endif	/* CUDA_VERSION >= 11020 */
+
 /*
  * __gpuMemAllocManagedRaw
  */
@@ -324,10 +682,13 @@ __gpuMemAllocHostRaw(GpuContext *gcontext,
 					 const char *filename, int lineno)
 {
 	void	   *hostptr;
+	NumaMemPolicy policy;
 	CUresult	rc;
 
 	GPUCONTEXT_PUSH(gcontext);
+	gpuNumaPreferLocalMemory(gcontext->cuda_dindex, &policy);
 	rc = cuMemAllocHost(&hostptr, bytesize);
+	gpuNumaRestoreMemPolicy(&policy);
 	if (rc != CUDA_SUCCESS)
 		wnotice("failed on cuMemAllocHost(%zu): %s", bytesize, errorText(rc));
 	else if (!trackGpuMem(gcontext, (CUdeviceptr)hostptr,
@@ -455,6 +816,7 @@ gpuMemAllocChunk(GpuMemKind gm_kind,
 	cl_int			i, __mclass;
 	size_t			segment_usage;
 	bool			has_exclusive_lock = false;
+	bool			has_drained_slab = false;
 
 	switch (gm_kind)
 	{
@@ -474,6 +836,29 @@ gpuMemAllocChunk(GpuMemKind gm_kind,
 			return CUDA_ERROR_INVALID_VALUE;
 	}
 
+	/*
+	 * Try to pick up a cached chunk, if small
+	 */
+	if (mclass <= GPUMEM_SLAB_MAX_BIT)
+	{
+		gm_chunk = gpuMemSlabGetChunk(gcontext, gm_kind, mclass);
+		if (gm_chunk)
+		{
+			gm_seg = gm_chunk->gm_seg;
+			i = gm_chunk - gm_seg->gm_chunks;
+			Assert(i >= 0 && i < nchunks);
+			m_deviceptr = gm_seg->m_segment + i * unitsz;
+			if (!trackGpuMem(gcontext, m_deviceptr, gm_seg,
+							 filename, lineno))
+			{
+				gpuMemFreeChunk(gcontext, m_deviceptr, gm_seg);
+				return CUDA_ERROR_OUT_OF_MEMORY;
+			}
+			*p_deviceptr = m_deviceptr;
+			return CUDA_SUCCESS;
+		}
+	}
+
 	/*
 	 * Try to lookup already allocated segment first
 	 */
@@ -496,8 +881,49 @@ retry:
 				   gm_chunk->mclass == mclass);
 			memset(&gm_chunk->chain, 0, sizeof(dlist_node));
 			gm_chunk->refcnt++;
+			gm_chunk->gm_seg = gm_seg;
 			pg_atomic_fetch_add_u32(&gm_seg->num_active_chunks, 1);
-			SpinLockRelease(&gm_seg->lock);
+			/* refill the slab cache in bulk, for small chunks */
+			if (mclass <= GPUMEM_SLAB_MAX_BIT)
+			{
+				GpuMemSlabCache *gm_slab;
+				GpuMemChunk	   *gm_temp;
+				dlist_head		refill;
+				cl_int			nrefill = 0;
+
+				dlist_init(&refill);
+				while (nrefill + 1 < (GPUMEM_SLAB_REFILL_SIZE >> mclass))
+				{
+					if (dlist_is_empty(&gm_seg->free_chunks[mclass]) &&
+						!gpuMemSplitChunk(gm_seg, mclass + 1))
+						break;
+					dnode = dlist_pop_head_node(&gm_seg->free_chunks[mclass]);
+					gm_temp = dlist_container(GpuMemChunk, chain, dnode);
+					Assert(GPUMEMCHUNK_IS_FREE(gm_temp) &&
+						   gm_temp->mclass == mclass);
+					gm_temp->refcnt = GPUMEMCHUNK_SLAB_CACHED;
+					gm_temp->gm_seg = gm_seg;
+					dlist_push_tail(&refill, &gm_temp->chain);
+					pg_atomic_fetch_add_u32(&gm_seg->num_active_chunks, 1);
+					nrefill++;
+				}
+				SpinLockRelease(&gm_seg->lock);
+
+				if (nrefill > 0)
+				{
+					gm_slab = gpuMemSlabLookup(gcontext, gm_kind, mclass);
+					SpinLockAcquire(&gm_slab->lock);
+					while (!dlist_is_empty(&refill))
+					{
+						dnode = dlist_pop_head_node(&refill);
+						dlist_push_tail(&gm_slab->free_chunks, dnode);
+					}
+					gm_slab->nitems += nrefill;
+					SpinLockRelease(&gm_slab->lock);
+				}
+			}
+			else
+				SpinLockRelease(&gm_seg->lock);
 			pthreadRWLockUnlock(&gcontext->gm_rwlock);
 			/* ok, found */
 			Assert(gm_chunk >= gm_seg->gm_chunks &&
@@ -524,6 +950,17 @@ retry:
 		goto retry;
 	}
 
+	/*
+	 * chunks cached by the slab may be merged to the larger one,
+	 * prior to the allocation of a new segment
+	 */
+	if (!has_drained_slab)
+	{
+		has_drained_slab = true;
+		if (gpuMemSlabDrain(gcontext, gm_kind))
+			goto retry;
+	}
+
 	/*
 	 * allocation of a new segment
 	 */
@@ -573,8 +1010,14 @@ retry:
 			break;
 
 		case GpuMemKind__HostMemory:
-			rc = cuMemHostAlloc((void **)&m_segment, gm_segment_sz,
-								CU_MEMHOSTALLOC_PORTABLE);
+			{
+				NumaMemPolicy policy;
+
+				gpuNumaPreferLocalMemory(gcontext->cuda_dindex, &policy);
+				rc = cuMemHostAlloc((void **)&m_segment, gm_segment_sz,
+									CU_MEMHOSTALLOC_PORTABLE);
+				gpuNumaRestoreMemPolicy(&policy);
+			}
 			//wnotice("hostmem m_segment = %p - %p", (void *)m_segment, (void *)(m_segment - gm_segment_sz));
 			break;
 
@@ -588,6 +1031,9 @@ retry:
 	{
 		free(gm_seg);
 		pthreadRWLockUnlock(&gcontext->gm_rwlock);
+		/* ask the reclaimable caches to release device memory */
+		if (rc == CUDA_ERROR_OUT_OF_MEMORY)
+			pg_atomic_write_u32(&gm_stat_array[gcontext->cuda_dindex].shrink_requested, 1);
 		return rc;
 	}
 	/* setup of GpuMemSegment */
@@ -648,6 +1094,17 @@ __gpuMemAlloc(GpuContext *gcontext,
 			  size_t bytesize,
 			  const char *filename, int lineno)
 {
+#if CUDA_VERSION >= 11020
+	if (gpu_memory_allocator == GPUMEM_ALLOCATOR__MEMPOOL)
+	{
+		CUmemoryPool	mempool = gpuMemPoolLookup(gcontext);
+
+		if (mempool)
+			return __gpuMemAllocPool(gcontext, mempool,
+									 p_deviceptr, bytesize,
+									 filename, lineno);
+	}
+#endif
 	if (bytesize <= gm_segment_sz / 2)
 	{
 		cl_int	mclass = Max(get_next_log2(bytesize),
@@ -721,6 +1178,61 @@ __gpuMemAllocManaged(GpuContext *gcontext,
 								   filename, lineno);
 }
 
+/*
+ * gpuMemAdviseManaged
+ *
+ * It gives the access pattern of the managed memory to CUDA driver, then
+ * prefetches the leading @prefetch_sz bytes to the device asynchronously.
+ * If @read_mostly, the device makes read-only copies of the pages on
+ * demand (e.g, inner buffer of GpuJoin); elsewhere, the device is the
+ * preferred location and CPU also maps the pages (e.g, final buffer of
+ * GpuPreAgg). Prefetch is limited to the free device memory, so the rest
+ * of pages are migrated on the page-fault, than the failure.
+ * Caller must have the CUDA context of @gcontext as the current one.
+ */
+CUresult
+gpuMemAdviseManaged(GpuContext *gcontext,
+					CUdeviceptr m_addr, size_t length,
+					size_t prefetch_sz, bool read_mostly,
+					CUstream cuda_stream)
+{
+	CUdevice	cuda_device = gcontext->cuda_device;
+	size_t		free_sz;
+	size_t		total_sz;
+	CUresult	rc;
+
+	if (read_mostly)
+	{
+		rc = cuMemAdvise(m_addr, length,
+						 CU_MEM_ADVISE_SET_READ_MOSTLY,
+						 cuda_device);
+		if (rc != CUDA_SUCCESS)
+			return rc;
+	}
+	else
+	{
+		rc = cuMemAdvise(m_addr, length,
+						 CU_MEM_ADVISE_SET_PREFERRED_LOCATION,
+						 cuda_device);
+		if (rc != CUDA_SUCCESS)
+			return rc;
+		rc = cuMemAdvise(m_addr, length,
+						 CU_MEM_ADVISE_SET_ACCESSED_BY,
+						 CU_DEVICE_CPU);
+		if (rc != CUDA_SUCCESS)
+			return rc;
+	}
+
+	rc = cuMemGetInfo(&free_sz, &total_sz);
+	if (rc != CUDA_SUCCESS)
+		return rc;
+	prefetch_sz = Min(prefetch_sz, Min(length, free_sz));
+	if (prefetch_sz == 0)
+		return CUDA_SUCCESS;
+	return cuMemPrefetchAsync(m_addr, prefetch_sz,
+							  cuda_device, cuda_stream);
+}
+
 /*
  * __gpuMemAllocHost
  */
@@ -904,6 +1416,9 @@ gpuMemReclaimSegment(GpuContext *gcontext)
 	GpuMemSegment  *gm_seg;
 	CUresult		rc;
 
+	/* cached chunks prevent to release the segment */
+	gpuMemSlabDrain(gcontext, 0);
+
 	pthreadRWLockWriteLock(&gcontext->gm_rwlock);
 	if (!dlist_is_empty(dhead_n))
 		dnode_n = dlist_tail_node(dhead_n);
@@ -1008,17 +1523,175 @@ gpuMemReclaimSegment(GpuContext *gcontext)
 	pthreadRWLockUnlock(&gcontext->gm_rwlock);
 }
 
+/*
+ * gpuMemReserveBudget
+ *
+ * It reserves the device memory budget for a GpuTaskState at the executor
+ * initialization; up to @nunits_max concurrent tasks that consume @unit_sz
+ * bytes for each. If the total budget reserved by the concurrent sessions
+ * exceeds pg_strom.gpu_memory_admission_ratio of the device memory, it
+ * waits for the release up to pg_strom.gpu_memory_admission_timeout, then
+ * downgrades the number of concurrent tasks instead of the failure on the
+ * task execution. At least one task is allowed, even if overcommit.
+ * It returns the number of concurrent tasks allowed.
+ */
+cl_int
+gpuMemReserveBudget(GpuContext *gcontext, size_t unit_sz, cl_int nunits_max)
+{
+	GpuMemStatistics *gm_stat = &gm_stat_array[gcontext->cuda_dindex];
+	TimestampTz	tv_timeout;
+	size_t		limit;
+	cl_int		nunits;
+
+	if (gpu_memory_admission_ratio <= 0 || unit_sz == 0 || nunits_max <= 0)
+		return nunits_max;
+	limit = (gm_stat->total_size / 100) * gpu_memory_admission_ratio;
+	tv_timeout = GetCurrentTimestamp() +
+		(TimestampTz)gpu_memory_admission_timeout * 1000L;
+	for (;;)
+	{
+		bool	timeout = (GetCurrentTimestamp() >= tv_timeout);
+		int		ev;
+
+		SpinLockAcquire(&gm_stat->budget_lock);
+		if (gm_stat->budget_usage + unit_sz * nunits_max <= limit)
+			nunits = nunits_max;
+		else if (!timeout)
+			nunits = 0;
+		else
+		{
+			size_t	avail = (gm_stat->budget_usage < limit
+							 ? limit - gm_stat->budget_usage : 0);
+
+			nunits = Max(Min(avail / unit_sz, nunits_max), 1);
+		}
+		if (nunits > 0)
+		{
+			gm_stat->budget_usage += unit_sz * nunits;
+			SpinLockRelease(&gm_stat->budget_lock);
+			break;
+		}
+		SpinLockRelease(&gm_stat->budget_lock);
+
+		/* ask the reclaimable caches to shrink, then wait for a while */
+		pg_atomic_write_u32(&gm_stat->shrink_requested, 1);
+		ev = WaitLatch(MyLatch,
+					   WL_LATCH_SET |
+					   WL_TIMEOUT |
+					   WL_POSTMASTER_DEATH,
+					   20L,
+					   PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+		if (ev & WL_POSTMASTER_DEATH)
+			elog(FATAL, "unexpected postmaster dead");
+		CHECK_FOR_INTERRUPTS();
+	}
+	gcontext->gm_budget += unit_sz * nunits;
+	gcontext->gm_budget_peak = Max(gcontext->gm_budget_peak,
+								   gcontext->gm_budget);
+	if (nunits < nunits_max)
+		elog(DEBUG1, "GPU%d memory budget is downgraded to %d of %d tasks",
+			 gcontext->cuda_dindex, nunits, nunits_max);
+	return nunits;
+}
+
+/*
+ * gpuMemReleaseBudget
+ */
+void
+gpuMemReleaseBudget(GpuContext *gcontext, size_t budget)
+{
+	GpuMemStatistics *gm_stat = &gm_stat_array[gcontext->cuda_dindex];
+
+	Assert(budget <= gcontext->gm_budget);
+	SpinLockAcquire(&gm_stat->budget_lock);
+	Assert(budget <= gm_stat->budget_usage);
+	gm_stat->budget_usage -= budget;
+	SpinLockRelease(&gm_stat->budget_lock);
+	gcontext->gm_budget -= budget;
+}
+
+/*
+ * gpuMemShrinkRequested - checks and clears the shrink request
+ */
+bool
+gpuMemShrinkRequested(cl_int cuda_dindex)
+{
+	GpuMemStatistics *gm_stat = &gm_stat_array[cuda_dindex];
+
+	if (pg_atomic_read_u32(&gm_stat->shrink_requested) == 0)
+		return false;
+	return (pg_atomic_exchange_u32(&gm_stat->shrink_requested, 0) != 0);
+}
+
+/*
+ * gpuStatUpdateTasks - tracks the number of queued/running tasks
+ *
+ * GpuContext also keeps its own share, to revert them on the cleanup.
+ */
+void
+gpuStatUpdateTasks(GpuContext *gcontext, int nqueued, int nrunning)
+{
+	GpuMemStatistics *gm_stat = &gm_stat_array[gcontext->cuda_dindex];
+
+	if (nqueued != 0)
+	{
+		pg_atomic_fetch_add_u32(&gcontext->stat_queued_tasks, nqueued);
+		pg_atomic_fetch_add_u32(&gm_stat->num_queued_tasks, nqueued);
+	}
+	if (nrunning != 0)
+	{
+		pg_atomic_fetch_add_u32(&gcontext->stat_running_tasks, nrunning);
+		pg_atomic_fetch_add_u32(&gm_stat->num_running_tasks, nrunning);
+	}
+}
+
+/*
+ * gpuStatAccumTasks - accumulates the tasks processed by GpuTaskState
+ */
+void
+gpuStatAccumTasks(cl_int cuda_dindex, uint64 ntasks, uint64 nfallbacks)
+{
+	GpuMemStatistics *gm_stat = &gm_stat_array[cuda_dindex];
+
+	if (ntasks > 0)
+		pg_atomic_fetch_add_u64(&gm_stat->num_gpu_tasks, ntasks);
+	if (nfallbacks > 0)
+		pg_atomic_fetch_add_u64(&gm_stat->num_cpu_fallbacks, nfallbacks);
+}
+
 /*
  * pgstrom_gpu_mmgr_init_gpucontext - Per GpuContext initialization
  */
 void
 pgstrom_gpu_mmgr_init_gpucontext(GpuContext *gcontext)
 {
+	int		i, j;
+
+	StaticAssertStmt(GPUMEM_SLAB_NCLASSES ==
+					 GPUMEM_SLAB_MAX_BIT - GPUMEM_CHUNKSZ_MIN_BIT + 1,
+					 "GPUMEM_SLAB_NCLASSES mismatch");
 	pthreadRWLockInit(&gcontext->gm_rwlock);
 	dlist_init(&gcontext->gm_normal_list);
 	dlist_init(&gcontext->gm_iomap_list);
 	dlist_init(&gcontext->gm_managed_list);
 	dlist_init(&gcontext->gm_hostmem_list);
+	gcontext->gm_budget = 0;
+	gcontext->gm_budget_peak = 0;
+	pg_atomic_init_u32(&gcontext->stat_queued_tasks, 0);
+	pg_atomic_init_u32(&gcontext->stat_running_tasks, 0);
+	pg_atomic_fetch_add_u32(&gm_stat_array[gcontext->cuda_dindex].num_contexts, 1);
+	for (i=0; i < GPUMEM_SLAB_NKINDS; i++)
+	{
+		for (j=0; j < GPUMEM_SLAB_NCLASSES; j++)
+		{
+			GpuMemSlabCache *gm_slab = &gcontext->gm_slab[i][j];
+
+			SpinLockInit(&gm_slab->lock);
+			dlist_init(&gm_slab->free_chunks);
+			gm_slab->nitems = 0;
+		}
+	}
 }
 
 /*
@@ -1035,6 +1708,26 @@ pgstrom_gpu_mmgr_cleanup_gpucontext(GpuContext *gcontext)
 	GpuMemSegment  *gm_seg;
 	dlist_node	   *dnode;
 	CUresult		rc;
+	int				i, j;
+
+	/* release the device memory budget not released yet (e.g, abort) */
+	if (gcontext->gm_budget > 0)
+		gpuMemReleaseBudget(gcontext, gcontext->gm_budget);
+	/* tasks not dequeued yet (e.g, abort) */
+	gpuStatUpdateTasks(gcontext,
+					   -(int)pg_atomic_read_u32(&gcontext->stat_queued_tasks),
+					   -(int)pg_atomic_read_u32(&gcontext->stat_running_tasks));
+	pg_atomic_fetch_sub_u32(&gm_stat->num_contexts, 1);
+
+	/* cached chunks are released with the segments below */
+	for (i=0; i < GPUMEM_SLAB_NKINDS; i++)
+	{
+		for (j=0; j < GPUMEM_SLAB_NCLASSES; j++)
+		{
+			dlist_init(&gcontext->gm_slab[i][j].free_chunks);
+			gcontext->gm_slab[i][j].nitems = 0;
+		}
+	}
 
 	while (!dlist_is_empty(&gcontext->gm_normal_list))
 	{
@@ -1166,6 +1859,107 @@ gpummgrHandleFreePreserved(GpuMemPreservedRequest *gmemp_req)
 	return rc;
 }
 
+/*
+ * lookup_nvml_function
+ */
+static void *
+lookup_nvml_function(void *handle, const char *func_name)
+{
+	void   *func_addr = dlsym(handle, func_name);
+
+	if (!func_addr)
+		elog(LOG, "could not find NVML symbol \"%s\" - %s",
+			 func_name, dlerror());
+	return func_addr;
+}
+
+#define LOOKUP_NVML_FUNCTION(func_name)									\
+	(p_##func_name = lookup_nvml_function(handle, #func_name)) != NULL
+
+/*
+ * gpummgrNvmlInit - NVML is optional; statistics are just unavailable
+ */
+static void
+gpummgrNvmlInit(int cuda_dindex)
+{
+	DevAttributes *dattrs = &devAttrs[cuda_dindex];
+	nvmlReturn_t rv;
+	char		pci_bus_id[40];
+	void	   *handle;
+
+	handle = dlopen("libnvidia-ml.so.1", RTLD_NOW | RTLD_LOCAL);
+	if (!handle)
+		handle = dlopen("libnvidia-ml.so", RTLD_NOW | RTLD_LOCAL);
+	if (!handle)
+	{
+		elog(LOG, "failed on open 'libnvidia-ml.so.1' and 'libnvidia-ml.so': %s",
+			 dlerror());
+		return;
+	}
+	if (!LOOKUP_NVML_FUNCTION(nvmlInit_v2) ||
+		!LOOKUP_NVML_FUNCTION(nvmlShutdown) ||
+		!LOOKUP_NVML_FUNCTION(nvmlErrorString) ||
+		!LOOKUP_NVML_FUNCTION(nvmlDeviceGetHandleByPciBusId_v2) ||
+		!LOOKUP_NVML_FUNCTION(nvmlDeviceGetUtilizationRates) ||
+		!LOOKUP_NVML_FUNCTION(nvmlDeviceGetMemoryInfo) ||
+		!LOOKUP_NVML_FUNCTION(nvmlDeviceGetPcieThroughput))
+		return;
+	rv = p_nvmlInit_v2();
+	if (rv != NVML_SUCCESS)
+	{
+		elog(LOG, "failed on nvmlInit: %s", p_nvmlErrorString(rv));
+		return;
+	}
+	snprintf(pci_bus_id, sizeof(pci_bus_id), "%04x:%02x:%02x.0",
+			 dattrs->PCI_DOMAIN_ID,
+			 dattrs->PCI_BUS_ID,
+			 dattrs->PCI_DEVICE_ID);
+	rv = p_nvmlDeviceGetHandleByPciBusId_v2(pci_bus_id, &gpummgr_nvml_device);
+	if (rv != NVML_SUCCESS)
+	{
+		elog(LOG, "failed on nvmlDeviceGetHandleByPciBusId(%s): %s",
+			 pci_bus_id, p_nvmlErrorString(rv));
+		gpummgr_nvml_device = NULL;
+		p_nvmlShutdown();
+	}
+}
+
+/*
+ * gpummgrNvmlSample - samples the device statistics once a second
+ */
+static void
+gpummgrNvmlSample(int cuda_dindex)
+{
+	GpuMemStatistics *gm_stat = &gm_stat_array[cuda_dindex];
+	TimestampTz	now = GetCurrentTimestamp();
+	nvmlUtilization_t util;
+	nvmlMemory_t mem;
+	unsigned int value;
+
+	if (!gpummgr_nvml_device ||
+		now - gpummgr_nvml_last_sampled < USECS_PER_SEC)
+		return;
+	gpummgr_nvml_last_sampled = now;
+
+	if (p_nvmlDeviceGetUtilizationRates(gpummgr_nvml_device,
+										&util) == NVML_SUCCESS)
+	{
+		pg_atomic_write_u32(&gm_stat->nvml_sm_util, util.gpu);
+		pg_atomic_write_u32(&gm_stat->nvml_mem_util, util.memory);
+	}
+	if (p_nvmlDeviceGetMemoryInfo(gpummgr_nvml_device, &mem) == NVML_SUCCESS)
+		pg_atomic_write_u64(&gm_stat->nvml_mem_used, mem.used);
+	if (p_nvmlDeviceGetPcieThroughput(gpummgr_nvml_device,
+									  NVML_PCIE_UTIL_TX_BYTES,
+									  &value) == NVML_SUCCESS)
+		pg_atomic_write_u32(&gm_stat->nvml_pcie_tx, value);
+	if (p_nvmlDeviceGetPcieThroughput(gpummgr_nvml_device,
+									  NVML_PCIE_UTIL_RX_BYTES,
+									  &value) == NVML_SUCCESS)
+		pg_atomic_write_u32(&gm_stat->nvml_pcie_rx, value);
+	pg_atomic_write_u64(&gm_stat->nvml_sampled_at, (uint64)now);
+}
+
 /*
  * gpummgrBgWorker(Begin|Dispatch|End)
  */
@@ -1185,6 +1979,8 @@ gpummgrBgWorkerBegin(int cuda_dindex)
 	SpinLockAcquire(&gmemp_head->lock);
 	gmemp_head->bgworkers[cuda_dindex].gmemp_req_latch = MyLatch;
 	SpinLockRelease(&gmemp_head->lock);
+
+	gpummgrNvmlInit(cuda_dindex);
 }
 
 static bool
@@ -1244,6 +2040,9 @@ gpummgrBgWorkerEnd(int cuda_dindex)
 	SpinLockAcquire(&gmemp_head->lock);
 	gmemp_head->bgworkers[cuda_dindex].gmemp_req_latch = NULL;
 	SpinLockRelease(&gmemp_head->lock);
+
+	if (gpummgr_nvml_device)
+		p_nvmlShutdown();
 }
 
 /*
@@ -1277,9 +2076,12 @@ gpummgrBgWorkerMain(Datum arg)
 	pqsignal(SIGTERM, gpummgrBgWorkerSigTerm);
 	BackgroundWorkerUnblockSignals();
 
-	/* never use MPS */
-	if (setenv("CUDA_MPS_PIPE_DIRECTORY", "/dev/null", 1) != 0)
-		elog(ERROR, "failed on setenv: %m");
+	/*
+	 * MPS configuration (CUDA_MPS_PIPE_DIRECTORY) is inherited from the
+	 * postmaster; see pgstrom_init_gpu_context(). Preserved memory has to
+	 * be allocated on the same side of MPS with the backends, because IPC
+	 * handles are not exchangeable between MPS clients and the others.
+	 */
 
 	/* init CUDA context */
 	Assert(cuda_dindex >= 0 && cuda_dindex < numDevAttrs);
@@ -1303,6 +2105,7 @@ gpummgrBgWorkerMain(Datum arg)
 	 */
 	while (!gpummgr_bgworker_got_signal)
 	{
+		gpummgrNvmlSample(cuda_dindex);
 		if (gpummgrBgWorkerDispatch(cuda_dindex) &
 			gpuCacheBgWorkerDispatch(cuda_dindex))
 		{
@@ -1339,6 +2142,150 @@ pgstrom_device_preserved_meminfo(PG_FUNCTION_ARGS)
 }
 PG_FUNCTION_INFO_V1(pgstrom_device_preserved_meminfo);
 
+/*
+ * pgstrom_gpu_stat - SRF of the pgstrom.pg_stat_gpu view
+ */
+#define GPU_STAT_NATTS		21
+Datum pgstrom_gpu_stat(PG_FUNCTION_ARGS);
+
+Datum
+pgstrom_gpu_stat(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	GpuMemStatistics *gm_stat;
+	Datum		values[GPU_STAT_NATTS];
+	bool		isnull[GPU_STAT_NATTS];
+	HeapTuple	tuple;
+	uint32		value;
+	uint64		ntasks;
+	uint64		nfallbacks;
+	int			builds_pending;
+	int			builds_running;
+	int			dindex;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc	tupdesc;
+		MemoryContext oldcxt;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+		tupdesc = CreateTemplateTupleDesc(GPU_STAT_NATTS);
+		TupleDescInitEntry(tupdesc,  1, "gpu_id",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  2, "gpu_name",
+						   TEXTOID, -1, 0);
+		TupleDescInitEntry(tupdesc,  3, "sm_util",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  4, "mem_util",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  5, "mem_total",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  6, "mem_used",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  7, "mem_normal",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  8, "mem_managed",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  9, "mem_iomap",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 10, "mem_budget",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 11, "active_contexts",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 12, "running_tasks",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 13, "queued_tasks",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 14, "pcie_tx_bytes_per_sec",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 15, "pcie_rx_bytes_per_sec",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 16, "jit_builds_pending",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 17, "jit_builds_running",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 18, "gpu_tasks",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 19, "cpu_fallbacks",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 20, "fallback_ratio",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 21, "sampled_at",
+						   TIMESTAMPTZOID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	dindex = fncxt->call_cntr;
+	if (dindex >= numDevAttrs)
+		SRF_RETURN_DONE(fncxt);
+	gm_stat = &gm_stat_array[dindex];
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = Int32GetDatum(devAttrs[dindex].DEV_ID);
+	values[1] = CStringGetTextDatum(devAttrs[dindex].DEV_NAME);
+	/* sampled by NVML */
+	value = pg_atomic_read_u32(&gm_stat->nvml_sm_util);
+	if (value != UINT_MAX)
+		values[2] = Int32GetDatum(value);
+	else
+		isnull[2] = true;
+	value = pg_atomic_read_u32(&gm_stat->nvml_mem_util);
+	if (value != UINT_MAX)
+		values[3] = Int32GetDatum(value);
+	else
+		isnull[3] = true;
+	values[4] = Int64GetDatum(gm_stat->total_size);
+	if (pg_atomic_read_u64(&gm_stat->nvml_sampled_at) != 0)
+		values[5] = Int64GetDatum(pg_atomic_read_u64(&gm_stat->nvml_mem_used));
+	else
+		isnull[5] = true;
+	/* memory usage by PG-Strom */
+	values[6] = Int64GetDatum(pg_atomic_read_u64(&gm_stat->normal_usage));
+	values[7] = Int64GetDatum(pg_atomic_read_u64(&gm_stat->managed_usage));
+	values[8] = Int64GetDatum(pg_atomic_read_u64(&gm_stat->iomap_usage));
+	SpinLockAcquire(&gm_stat->budget_lock);
+	values[9] = Int64GetDatum(gm_stat->budget_usage);
+	SpinLockRelease(&gm_stat->budget_lock);
+	/* tasks */
+	values[10] = Int32GetDatum(pg_atomic_read_u32(&gm_stat->num_contexts));
+	values[11] = Int32GetDatum(pg_atomic_read_u32(&gm_stat->num_running_tasks));
+	values[12] = Int32GetDatum(pg_atomic_read_u32(&gm_stat->num_queued_tasks));
+	value = pg_atomic_read_u32(&gm_stat->nvml_pcie_tx);
+	if (value != UINT_MAX)
+		values[13] = Int64GetDatum((int64)value * 1024);
+	else
+		isnull[13] = true;
+	value = pg_atomic_read_u32(&gm_stat->nvml_pcie_rx);
+	if (value != UINT_MAX)
+		values[14] = Int64GetDatum((int64)value * 1024);
+	else
+		isnull[14] = true;
+	/* JIT builds are not per device, but shown for each */
+	pgstrom_program_build_count(&builds_pending, &builds_running);
+	values[15] = Int32GetDatum(builds_pending);
+	values[16] = Int32GetDatum(builds_running);
+	ntasks = pg_atomic_read_u64(&gm_stat->num_gpu_tasks);
+	nfallbacks = pg_atomic_read_u64(&gm_stat->num_cpu_fallbacks);
+	values[17] = Int64GetDatum(ntasks);
+	values[18] = Int64GetDatum(nfallbacks);
+	if (ntasks > 0)
+		values[19] = Float8GetDatum((double)nfallbacks / (double)ntasks);
+	else
+		isnull[19] = true;
+	if (pg_atomic_read_u64(&gm_stat->nvml_sampled_at) != 0)
+		values[20] = TimestampTzGetDatum((TimestampTz)
+							pg_atomic_read_u64(&gm_stat->nvml_sampled_at));
+	else
+		isnull[20] = true;
+
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_gpu_stat);
+
 /*
  * pgstrom_startup_gpu_mmgr
  */
@@ -1362,7 +2309,22 @@ pgstrom_startup_gpu_mmgr(void)
 		elog(ERROR, "Bug? GPU Device Memory Statistics exists");
 	memset(gm_stat_array, 0, required);
 	for (i=0; i < numDevAttrs; i++)
+	{
 		gm_stat_array[i].total_size = devAttrs[i].DEV_TOTAL_MEMSZ;
+		SpinLockInit(&gm_stat_array[i].budget_lock);
+		pg_atomic_init_u32(&gm_stat_array[i].shrink_requested, 0);
+		pg_atomic_init_u32(&gm_stat_array[i].num_contexts, 0);
+		pg_atomic_init_u32(&gm_stat_array[i].num_queued_tasks, 0);
+		pg_atomic_init_u32(&gm_stat_array[i].num_running_tasks, 0);
+		pg_atomic_init_u64(&gm_stat_array[i].num_gpu_tasks, 0);
+		pg_atomic_init_u64(&gm_stat_array[i].num_cpu_fallbacks, 0);
+		pg_atomic_init_u32(&gm_stat_array[i].nvml_sm_util, UINT_MAX);
+		pg_atomic_init_u32(&gm_stat_array[i].nvml_mem_util, UINT_MAX);
+		pg_atomic_init_u32(&gm_stat_array[i].nvml_pcie_tx, UINT_MAX);
+		pg_atomic_init_u32(&gm_stat_array[i].nvml_pcie_rx, UINT_MAX);
+		pg_atomic_init_u64(&gm_stat_array[i].nvml_mem_used, 0);
+		pg_atomic_init_u64(&gm_stat_array[i].nvml_sampled_at, 0);
+	}
 
 	/*
 	 * GpuMemPreservedHead
@@ -1418,6 +2380,60 @@ pgstrom_init_gpu_mmgr(void)
 			 (int)(pgstrom_chunk_size() >> 10));
 	gm_segment_sz = (size_t)gpu_memory_segment_size_kb << 10;
 
+	/*
+	 * allocator of the normal device memory
+	 */
+	DefineCustomEnumVariable("pg_strom.gpu_memory_allocator",
+							 "allocator of the GPU device memory",
+							 "'mempool' uses the stream-ordered memory pool of CUDA, if supported",
+							 &gpu_memory_allocator,
+							 GPUMEM_ALLOCATOR__SEGMENT,
+							 gpu_memory_allocator_options,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	DefineCustomBoolVariable("pg_strom.gpu_memory_oversubscription",
+							 "Enables oversubscription of device memory by managed memory",
+							 NULL,
+							 &pgstrom_gpu_memory_oversubscription,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/*
+	 * admission control of the device memory
+	 */
+	DefineCustomIntVariable("pg_strom.gpu_memory_admission_ratio",
+							"ratio of device memory to be reserved by the concurrent queries",
+							"0 disables the admission control",
+							&gpu_memory_admission_ratio,
+							90,
+							0,
+							100,
+							PGC_SUSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	DefineCustomIntVariable("pg_strom.gpu_memory_admission_timeout",
+							"time to wait for the device memory budget before the downgrade",
+							NULL,
+							&gpu_memory_admission_timeout,
+							1000,	/* 1s */
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_MS,
+							NULL, NULL, NULL);
+	DefineCustomIntVariable("pg_strom.gpu_mempool_release_threshold",
+							"amount of the unused device memory kept by the memory pool",
+							NULL,
+							&gpu_mempool_release_threshold_kb,
+							(pgstrom_chunk_size() * 8) >> 10,
+							0,
+							INT_MAX,
+							PGC_SUSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+
 	/*
 	 * Background workers per device, to keep device memory for multi-process
 	 */
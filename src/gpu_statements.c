@@ -0,0 +1,363 @@
+/*
+ * gpu_statements.c
+ *
+ * Per-query accounting of the GPU resources, for the
+ * pgstrom.gpu_stat_statements view.
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include "pg_strom.h"
+
+/*
+ * gpuStatStmtEntry - resource consumption per query fingerprint
+ *
+ * The entries are identified by (userid, dbid, queryid) like
+ * pg_stat_statements, so the view can be joined with it. The slots are
+ * an open-addressing hash table; once a probe window is full, the least
+ * recently executed entry is evicted.
+ */
+#define GPU_STAT_STMT_PROBE_NSLOTS		32
+
+typedef struct
+{
+	Oid			userid;
+	Oid			dbid;
+	uint64		queryid;
+} gpuStatStmtKey;
+
+typedef struct
+{
+	gpuStatStmtKey key;			/* queryid == 0 means an empty slot */
+	uint64		gpu_nodes;			/* # of GPU nodes executed */
+	uint64		gpu_tasks;			/* # of GpuTasks processed by GPU */
+	uint64		kern_exec_usec;		/* time of GPU kernels */
+	uint64		dma_send_usec;		/* time of DMA host-to-device */
+	uint64		dma_recv_usec;		/* time of DMA device-to-host */
+	uint64		dma_send_bytes;		/* bytes of DMA host-to-device */
+	uint64		dma_recv_bytes;		/* bytes of DMA device-to-host */
+	uint64		nvme_read_bytes;	/* bytes loaded by GPUDirect SQL */
+	uint64		gpu_mem_peak;		/* max device memory budget */
+	uint64		jit_build_usec;		/* time of CUDA program build */
+	uint64		cpu_fallbacks;		/* # of chunks by CPU fallback */
+	uint64		cpu_rechecks;		/* # of rows rechecked by CPU */
+	TimestampTz	last_exec;			/* time of the last execution */
+} gpuStatStmtEntry;
+
+typedef struct
+{
+	slock_t		lock;
+	uint64		dealloc;			/* # of evicted entries */
+	gpuStatStmtEntry entries[FLEXIBLE_ARRAY_MEMBER];
+} gpuStatStmtHead;
+
+static int		gpu_stat_statements_max;		/* GUC */
+static gpuStatStmtHead *gpu_stat_stmt_head = NULL;
+static shmem_startup_hook_type shmem_startup_next = NULL;
+
+Datum pgstrom_gpu_stat_statements(PG_FUNCTION_ARGS);
+Datum pgstrom_gpu_stat_statements_reset(PG_FUNCTION_ARGS);
+
+/*
+ * gpuStatStatementsAccum
+ *
+ * It is called on the release of GpuTaskState, to account the resource
+ * consumption of the node to the query. Parallel workers do not account
+ * by themselves, because their statistics are already moved to the leader
+ * process through @gt_rtstat.
+ */
+void
+gpuStatStatementsAccum(GpuTaskState *gts, GpuTaskRuntimeStat *gt_rtstat)
+{
+	EState	   *estate = gts->css.ss.ps.state;
+	gpuStatStmtEntry temp;
+	gpuStatStmtEntry *entry;
+	gpuStatStmtEntry *victim = NULL;
+	uint32		hindex;
+	int			i;
+
+	if (!gpu_stat_stmt_head || IsParallelWorker() ||
+		!estate->es_plannedstmt ||
+		estate->es_plannedstmt->queryId == UINT64CONST(0))
+		return;
+
+	memset(&temp, 0, sizeof(gpuStatStmtEntry));
+	temp.key.userid = GetUserId();
+	temp.key.dbid = MyDatabaseId;
+	temp.key.queryid = estate->es_plannedstmt->queryId;
+	temp.gpu_nodes = 1;
+	temp.gpu_tasks = gts->num_gpu_tasks;
+	temp.kern_exec_usec = gts->stage_usec[GPUTASK_STAGE__KERN_EXEC];
+	temp.dma_send_usec = gts->stage_usec[GPUTASK_STAGE__DMA_SEND];
+	temp.dma_recv_usec = gts->stage_usec[GPUTASK_STAGE__DMA_RECV];
+	temp.dma_send_bytes = gts->dma_send_bytes;
+	temp.dma_recv_bytes = gts->dma_recv_bytes;
+	temp.nvme_read_bytes = (uint64)gts->nvme_count * BLCKSZ;
+	temp.cpu_fallbacks = gts->num_cpu_fallbacks;
+	temp.cpu_rechecks = gts->num_cpu_rechecks;
+	if (gts->gcontext)
+		temp.gpu_mem_peak = gts->gcontext->gm_budget_peak;
+	if (gt_rtstat)
+	{
+		temp.gpu_mem_peak += pg_atomic_read_u64(&gt_rtstat->gpu_mem_peak);
+		/* EXPLAIN ANALYZE already merged the statistics of workers */
+		if (!gts->rtstat_merged)
+		{
+			temp.gpu_tasks
+				+= pg_atomic_read_u64(&gt_rtstat->gpu_task_count);
+			temp.kern_exec_usec
+				+= pg_atomic_read_u64(&gt_rtstat->stage_usec[GPUTASK_STAGE__KERN_EXEC]);
+			temp.dma_send_usec
+				+= pg_atomic_read_u64(&gt_rtstat->stage_usec[GPUTASK_STAGE__DMA_SEND]);
+			temp.dma_recv_usec
+				+= pg_atomic_read_u64(&gt_rtstat->stage_usec[GPUTASK_STAGE__DMA_RECV]);
+			temp.dma_send_bytes
+				+= pg_atomic_read_u64(&gt_rtstat->dma_send_bytes);
+			temp.dma_recv_bytes
+				+= pg_atomic_read_u64(&gt_rtstat->dma_recv_bytes);
+			temp.nvme_read_bytes
+				+= pg_atomic_read_u64(&gt_rtstat->nvme_count) * BLCKSZ;
+			temp.cpu_fallbacks
+				+= pg_atomic_read_u64(&gt_rtstat->fallback_count);
+			temp.cpu_rechecks
+				+= pg_atomic_read_u64(&gt_rtstat->recheck_count);
+		}
+	}
+	temp.jit_build_usec =
+		pgstrom_cuda_program_build_usec(gts->program_id,
+										GetCurrentStatementStartTimestamp());
+	temp.last_exec = GetCurrentTimestamp();
+
+	hindex = DatumGetUInt32(hash_any((unsigned char *)&temp.key,
+									 sizeof(gpuStatStmtKey)));
+	SpinLockAcquire(&gpu_stat_stmt_head->lock);
+	for (i=0; i < Min(GPU_STAT_STMT_PROBE_NSLOTS,
+					  gpu_stat_statements_max); i++)
+	{
+		entry = &gpu_stat_stmt_head->entries[(hindex + i) %
+											 gpu_stat_statements_max];
+		if (entry->key.queryid != UINT64CONST(0) &&
+			memcmp(&entry->key, &temp.key, sizeof(gpuStatStmtKey)) == 0)
+		{
+			entry->gpu_nodes       += temp.gpu_nodes;
+			entry->gpu_tasks       += temp.gpu_tasks;
+			entry->kern_exec_usec  += temp.kern_exec_usec;
+			entry->dma_send_usec   += temp.dma_send_usec;
+			entry->dma_recv_usec   += temp.dma_recv_usec;
+			entry->dma_send_bytes  += temp.dma_send_bytes;
+			entry->dma_recv_bytes  += temp.dma_recv_bytes;
+			entry->nvme_read_bytes += temp.nvme_read_bytes;
+			entry->gpu_mem_peak     = Max(entry->gpu_mem_peak,
+										  temp.gpu_mem_peak);
+			entry->jit_build_usec  += temp.jit_build_usec;
+			entry->cpu_fallbacks   += temp.cpu_fallbacks;
+			entry->cpu_rechecks    += temp.cpu_rechecks;
+			entry->last_exec        = temp.last_exec;
+			SpinLockRelease(&gpu_stat_stmt_head->lock);
+			return;
+		}
+		if (entry->key.queryid == UINT64CONST(0))
+		{
+			if (!victim || victim->key.queryid != UINT64CONST(0))
+				victim = entry;
+		}
+		else if (!victim || (victim->key.queryid != UINT64CONST(0) &&
+							 victim->last_exec > entry->last_exec))
+			victim = entry;
+	}
+	Assert(victim != NULL);
+	if (victim->key.queryid != UINT64CONST(0))
+		gpu_stat_stmt_head->dealloc++;
+	memcpy(victim, &temp, sizeof(gpuStatStmtEntry));
+	SpinLockRelease(&gpu_stat_stmt_head->lock);
+}
+
+/*
+ * pgstrom_gpu_stat_statements - SRF of the pgstrom.gpu_stat_statements view
+ */
+#define GPU_STAT_STATEMENTS_NATTS	17
+typedef struct
+{
+	int			nitems;
+	uint64		dealloc;
+	gpuStatStmtEntry entries[FLEXIBLE_ARRAY_MEMBER];
+} gpuStatStmtSnapshot;
+
+Datum
+pgstrom_gpu_stat_statements(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	gpuStatStmtSnapshot *snap;
+	gpuStatStmtEntry *entry;
+	Datum		values[GPU_STAT_STATEMENTS_NATTS];
+	bool		isnull[GPU_STAT_STATEMENTS_NATTS];
+	HeapTuple	tuple;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc	tupdesc;
+		MemoryContext oldcxt;
+		int			i;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+		tupdesc = CreateTemplateTupleDesc(GPU_STAT_STATEMENTS_NATTS);
+		TupleDescInitEntry(tupdesc,  1, "userid",
+						   OIDOID, -1, 0);
+		TupleDescInitEntry(tupdesc,  2, "dbid",
+						   OIDOID, -1, 0);
+		TupleDescInitEntry(tupdesc,  3, "queryid",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  4, "gpu_nodes",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  5, "gpu_tasks",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  6, "kern_exec_time",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  7, "dma_send_time",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  8, "dma_recv_time",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc,  9, "dma_send_bytes",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 10, "dma_recv_bytes",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 11, "nvme_read_bytes",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 12, "gpu_mem_peak",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 13, "jit_build_time",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 14, "cpu_fallback_chunks",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 15, "cpu_recheck_rows",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 16, "last_exec",
+						   TIMESTAMPTZOID, -1, 0);
+		TupleDescInitEntry(tupdesc, 17, "dealloc",
+						   INT8OID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+
+		/* take a snapshot of the valid entries */
+		snap = palloc(offsetof(gpuStatStmtSnapshot,
+							   entries[gpu_stat_statements_max]));
+		snap->nitems = 0;
+		snap->dealloc = 0;
+		if (gpu_stat_stmt_head)
+		{
+			SpinLockAcquire(&gpu_stat_stmt_head->lock);
+			for (i=0; i < gpu_stat_statements_max; i++)
+			{
+				entry = &gpu_stat_stmt_head->entries[i];
+				if (entry->key.queryid != UINT64CONST(0))
+					memcpy(&snap->entries[snap->nitems++], entry,
+						   sizeof(gpuStatStmtEntry));
+			}
+			snap->dealloc = gpu_stat_stmt_head->dealloc;
+			SpinLockRelease(&gpu_stat_stmt_head->lock);
+		}
+		fncxt->user_fctx = snap;
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	snap = fncxt->user_fctx;
+	if (fncxt->call_cntr >= snap->nitems)
+		SRF_RETURN_DONE(fncxt);
+	entry = &snap->entries[fncxt->call_cntr];
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0]  = ObjectIdGetDatum(entry->key.userid);
+	values[1]  = ObjectIdGetDatum(entry->key.dbid);
+	values[2]  = Int64GetDatum((int64)entry->key.queryid);
+	values[3]  = Int64GetDatum(entry->gpu_nodes);
+	values[4]  = Int64GetDatum(entry->gpu_tasks);
+	values[5]  = Float8GetDatum((double)entry->kern_exec_usec / 1000.0);
+	values[6]  = Float8GetDatum((double)entry->dma_send_usec / 1000.0);
+	values[7]  = Float8GetDatum((double)entry->dma_recv_usec / 1000.0);
+	values[8]  = Int64GetDatum(entry->dma_send_bytes);
+	values[9]  = Int64GetDatum(entry->dma_recv_bytes);
+	values[10] = Int64GetDatum(entry->nvme_read_bytes);
+	values[11] = Int64GetDatum(entry->gpu_mem_peak);
+	values[12] = Float8GetDatum((double)entry->jit_build_usec / 1000.0);
+	values[13] = Int64GetDatum(entry->cpu_fallbacks);
+	values[14] = Int64GetDatum(entry->cpu_rechecks);
+	values[15] = TimestampTzGetDatum(entry->last_exec);
+	values[16] = Int64GetDatum(snap->dealloc);
+
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+PG_FUNCTION_INFO_V1(pgstrom_gpu_stat_statements);
+
+/*
+ * pgstrom_gpu_stat_statements_reset - discard the per-query statistics
+ */
+Datum
+pgstrom_gpu_stat_statements_reset(PG_FUNCTION_ARGS)
+{
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to reset the GPU statement statistics")));
+	if (gpu_stat_stmt_head)
+	{
+		SpinLockAcquire(&gpu_stat_stmt_head->lock);
+		memset(gpu_stat_stmt_head->entries, 0,
+			   sizeof(gpuStatStmtEntry) * gpu_stat_statements_max);
+		gpu_stat_stmt_head->dealloc = 0;
+		SpinLockRelease(&gpu_stat_stmt_head->lock);
+	}
+	PG_RETURN_VOID();
+}
+PG_FUNCTION_INFO_V1(pgstrom_gpu_stat_statements_reset);
+
+/*
+ * pgstrom_startup_gpu_statements
+ */
+static void
+pgstrom_startup_gpu_statements(void)
+{
+	size_t		required;
+	bool		found;
+
+	if (shmem_startup_next)
+		(*shmem_startup_next)();
+
+	required = STROMALIGN(offsetof(gpuStatStmtHead,
+								   entries[gpu_stat_statements_max]));
+	gpu_stat_stmt_head = ShmemInitStruct("GPU Statement Statistics",
+										 required, &found);
+	if (found)
+		elog(ERROR, "Bug? GPU Statement Statistics exists");
+	memset(gpu_stat_stmt_head, 0, required);
+	SpinLockInit(&gpu_stat_stmt_head->lock);
+}
+
+/*
+ * pgstrom_init_gpu_statements
+ */
+void
+pgstrom_init_gpu_statements(void)
+{
+	DefineCustomIntVariable("pg_strom.gpu_stat_statements_max",
+							"Max number of queries tracked by pgstrom.gpu_stat_statements",
+							"0 disables the per-query accounting",
+							&gpu_stat_statements_max,
+							1000,
+							0,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	if (gpu_stat_statements_max > 0)
+	{
+		RequestAddinShmemSpace(STROMALIGN(offsetof(gpuStatStmtHead,
+												   entries[gpu_stat_statements_max])));
+		shmem_startup_next = shmem_startup_hook;
+		shmem_startup_hook = pgstrom_startup_gpu_statements;
+	}
+}
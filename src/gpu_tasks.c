@@ -11,6 +11,137 @@
  */
 #include "pg_strom.h"
 
+/* static variables */
+static bool		enable_cpu_hybrid_execution;	/* GUC */
+static bool		enable_adaptive_chunk_size;		/* GUC */
+
+/* adaptive chunk size; see pgstromChunkAdaptiveUpdate() */
+#define CHUNK_ADAPT_MIN_DIVISOR		16
+#define CHUNK_ADAPT_MIN_SIZE		(1UL << 20)		/* 1MB */
+#define CHUNK_ADAPT_MIN_LATENCY		2.0				/* 2ms */
+#define CHUNK_ADAPT_NVOTES			3
+
+static int		pgstrom_gpu_task_priority;		/* GUC */
+static int		pgstrom_gpu_scheduler_slots;	/* GUC */
+static shmem_startup_hook_type shmem_startup_next = NULL;
+
+/*
+ * GPU task scheduler
+ *
+ * Sessions that are submitting GpuTasks register their weight (by the
+ * pg_strom.gpu_task_priority; usually configured per role) on the device.
+ * If pg_strom.gpu_scheduler_slots is configured, each GpuTaskState can
+ * run the slots of the device in proportion to its weight out of the total
+ * weight of the active sessions. Once a new session with higher priority
+ * arrives, sessions over their share stop the submission at the next task
+ * boundary, until the running tasks get completed.
+ * Time blocked by the scheduler is accumulated per session, to verify the
+ * latency SLOs using the pgstrom.gpu_task_scheduler view.
+ */
+typedef struct
+{
+	slock_t		lock;
+	cl_uint		nr_sessions;	/* # of active sessions */
+	cl_ulong	active_weight;	/* total weight of the active sessions */
+} GpuTaskSchedDevice;
+
+typedef struct
+{
+	int			pid;			/* 0, if unused */
+	cl_int		cuda_dindex;	/* device used at the last */
+	cl_int		weight;			/* last weight */
+	cl_int		fair_share;		/* last share of the device slots */
+	cl_ulong	num_tasks;		/* # of tasks submitted */
+	cl_ulong	wait_usec;		/* total time blocked by the scheduler */
+	cl_ulong	wait_max_usec;	/* max time blocked by the scheduler */
+} GpuTaskSchedSession;
+
+static GpuTaskSchedDevice  *gts_sched_devices = NULL;	/* shmem */
+static GpuTaskSchedSession *gts_sched_sessions = NULL;	/* shmem */
+static int					gts_sched_nsessions = 0;
+static cl_ulong			   *gts_sched_local_weight = NULL; /* per device */
+
+/*
+ * Calibration of the GPU cost model
+ *
+ * The time to build and load the CUDA module, and the time of GPU tasks
+ * (from the launch on the worker thread to the completion) are recorded
+ * on the shared memory per device, once GpuTaskState gets released.
+ * The time of GPU tasks is modelled as:
+ *
+ *   msec_per_task = msec_per_chunk + msec_per_row * nrows_per_task
+ *
+ * then, the least squares over the recent samples (exponentially decayed)
+ * gives both of the coefficients. If pg_strom.gpu_cost_per_msec is not 0,
+ * the planner uses the calibrated values in place of pg_strom.gpu_setup_cost,
+ * pg_strom.gpu_dma_cost and pg_strom.gpu_operator_cost.
+ */
+#define GPU_COST_CALIB_DECAY		0.95
+#define GPU_COST_CALIB_MIN_SAMPLES	8
+
+/*
+ * Saturation point of the device
+ *
+ * Once a GpuTaskState completes the scan, the throughput of the process
+ * (GPU tasks per second) is also recorded by the average number of the
+ * processes that were submitting GPU tasks on the same device. The device
+ * throughput is estimated as the product of them, and the saturation point
+ * is the least number of processes that achieves 90% of the best one.
+ * It is unknown until a larger number of processes are sampled without
+ * throughput improvement.
+ */
+#define GPU_SATURATION_NLEVELS		32
+#define GPU_SATURATION_MIN_SAMPLES	4
+#define GPU_SATURATION_THRESHOLD	0.90
+
+typedef struct
+{
+	slock_t		lock;
+	cl_ulong	setup_nsamples;	/* # of module loads */
+	double		setup_msec;		/* avg time to build/load CUDA module */
+	cl_ulong	exec_nsamples;	/* # of GpuTaskStates sampled */
+	double		exec_w;			/* decayed sum of the weight */
+	double		exec_x;			/* decayed sum of rows per task */
+	double		exec_y;			/* decayed sum of msec per task */
+	double		exec_xx;
+	double		exec_xy;
+	/* throughput per process by the number of concurrent processes */
+	cl_ulong	conc_nsamples[GPU_SATURATION_NLEVELS];
+	double		conc_tasks_per_sec[GPU_SATURATION_NLEVELS];
+} GpuCostCalibDevice;
+
+static double				pgstrom_gpu_cost_per_msec;	/* GUC */
+static bool					pgstrom_gpu_parallel_saturation; /* GUC */
+static GpuCostCalibDevice  *gpu_cost_calib = NULL;		/* shmem */
+
+/*
+ * Fan-out of the Append children across GPUs
+ *
+ * Append runs its children one by one, so partition leaves bound to the
+ * different (NVMe-local) GPUs are usually processed sequentially. Once a
+ * GpuTaskState marked as fan-out candidate starts execution, it submits
+ * the first chunk of the siblings (still not started) on the other GPUs,
+ * so these GPUs scan the partitions concurrently while the Append consumes
+ * the current child. The entries belong to the per-query memory context,
+ * so they are detached on the context reset even if ExecEnd is not called.
+ */
+typedef struct GpuTaskFanout
+{
+	dlist_node		chain;
+	MemoryContextCallback mcb;
+	EState		   *estate;
+	GpuTaskState   *gts;		/* NULL, if already detached */
+} GpuTaskFanout;
+
+static dlist_head	gpu_task_fanout_list;
+
+Datum pgstrom_gpu_task_scheduler(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(pgstrom_gpu_task_scheduler);
+Datum pgstrom_gpu_cost_calibration(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(pgstrom_gpu_cost_calibration);
+Datum pgstrom_gpu_cost_calibration_reset(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(pgstrom_gpu_cost_calibration_reset);
+
 /*
  * see definition at xact.c
  *
@@ -332,7 +463,17 @@ pgstromInitGpuTaskState(GpuTaskState *gts,
 											 outer_refs);
 		}
 		if (RelationHasGpuCache(relation))
-			gts->gc_state = ExecInitGpuCache(&gts->css.ss, eflags, outer_refs);
+		{
+			List	   *outer_quals_raw = outer_quals;
+
+			if (cscan->custom_scan_tlist != NIL)
+				outer_quals_raw = (List *)
+					fixup_varnode_to_origin((Node *)outer_quals,
+											cscan->custom_scan_tlist);
+			gts->gc_state = ExecInitGpuCache(&gts->css.ss, eflags,
+											 outer_quals_raw,
+											 outer_refs);
+		}
 		/* we never use Apache Arrow and GPU Cache simultaneously */
 		Assert(!gts->af_state || !gts->gc_state);
 	}
@@ -350,6 +491,67 @@ pgstromInitGpuTaskState(GpuTaskState *gts,
 	 * be setup only when it is not responsible to partial read.
 	 */
 
+	/*
+	 * Reservation of the device memory budget; a task consumes a source
+	 * chunk and a result buffer at most.
+	 */
+	gts->max_async_tasks = pgstrom_max_async_tasks;
+	gts->gm_budget = 0;
+	gts->sched_weight = 0;
+	gts->sched_wait_start = 0;
+	gts->sched_wait_usec = 0;
+	if ((eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0)
+	{
+		size_t		unit_sz = 2 * pgstrom_chunk_size();
+
+		gts->max_async_tasks = gpuMemReserveBudget(gcontext, unit_sz,
+												   pgstrom_max_async_tasks);
+		gts->gm_budget = unit_sz * gts->max_async_tasks;
+	}
+
+	/*
+	 * Initial size of the adaptive chunk; tables smaller than the chunks
+	 * of max_async_tasks are split to smaller chunks for pipelining.
+	 */
+	gts->chunk_adapt_sz = 0;
+	if (enable_adaptive_chunk_size &&
+		relation &&
+		relation->rd_rel->relkind == RELKIND_RELATION &&
+		!gts->af_state && !gts->gc_state)
+	{
+		size_t		max_sz = pgstrom_chunk_size();
+		size_t		min_sz = Max(max_sz / CHUNK_ADAPT_MIN_DIVISOR,
+								 CHUNK_ADAPT_MIN_SIZE);
+		size_t		rel_sz = (size_t)relation->rd_rel->relpages * BLCKSZ;
+		size_t		init_sz = max_sz;
+
+		if (rel_sz > 0)
+			init_sz = rel_sz / (2 * Max(gts->max_async_tasks, 1));
+		init_sz = Max(Min(init_sz, max_sz), min_sz);
+		gts->chunk_adapt_sz = init_sz;
+		gts->chunk_adapt_min_sz = init_sz;
+		gts->chunk_adapt_max_sz = init_sz;
+	}
+	gts->chunk_adapt_votes = 0;
+	gts->chunk_adapt_nresized = 0;
+	gts->chunk_host_latency = 0.0;
+	gts->chunk_load_latency = 0.0;
+	memset(&gts->chunk_tv_pickup, 0, sizeof(struct timeval));
+	gts->gpu_exec_msec = 0.0;
+	gts->gpu_exec_ntasks = 0;
+	memset(gts->stage_usec, 0, sizeof(gts->stage_usec));
+	gts->dma_send_bytes = 0;
+	gts->dma_recv_bytes = 0;
+	gts->rtstat_merged = false;
+	/* NVTX/CUPTI tracing, if enabled */
+	gts->trace_flags = pgstromGpuTraceFlags();
+	gts->trace_nchunks = 0;
+	snprintf(gts->trace_label, sizeof(gts->trace_label),
+			 "%s node=%d qid=%lu",
+			 gts->css.methods->CustomName,
+			 gts->css.ss.ps.plan->plan_node_id,
+			 (unsigned long)estate->es_plannedstmt->queryId);
+
 	/* callbacks shall be set by the caller */
 	dlist_init(&gts->ready_tasks);
 	gts->num_ready_tasks = 0;
@@ -357,6 +559,782 @@ pgstromInitGpuTaskState(GpuTaskState *gts,
 	gts->pcxt = NULL;
 }
 
+/*
+ * Adaptive chunk size
+ *
+ * Small chunks waste the kernel launches, and large chunks hurt pipelining
+ * and memory. Once a GPU task is picked up, we compare the average latency
+ * of GPU tasks (DMA and kernel; @hybrid_gpu_latency) with the host time to
+ * load and consume a chunk (@chunk_host_latency). While @max_async_tasks
+ * tasks are in-flight, the pipeline is balanced if:
+ *
+ *   gpu_latency ~= max_async_tasks * host_latency
+ *
+ * If GPU is the bottleneck, or the GPU latency is too short to amortize the
+ * launch, the chunk shall be grown to reduce the number of launches. If the
+ * host is the bottleneck, GPU is idle anyway, so the chunk is shrunk to save
+ * the memory. The chunk is resized after CHUNK_ADAPT_NVOTES consecutive
+ * votes, within the range between CHUNK_ADAPT_MIN_SIZE and the chunk buffer
+ * (pg_strom.chunk_size) that is the memory budget.
+ */
+size_t
+pgstromChunkAdaptiveSize(GpuTaskState *gts)
+{
+	if (gts->chunk_adapt_sz == 0)
+		return pgstrom_chunk_size();
+	return gts->chunk_adapt_sz;
+}
+
+static void
+pgstromChunkAdaptiveUpdate(GpuTaskState *gts)
+{
+	double		gpu_latency = gts->hybrid_gpu_latency;
+	double		host_latency = gts->chunk_host_latency;
+	double		nasync = (double)Max(gts->max_async_tasks, 1);
+	size_t		max_sz = pgstrom_chunk_size();
+	size_t		min_sz = Max(max_sz / CHUNK_ADAPT_MIN_DIVISOR,
+							 CHUNK_ADAPT_MIN_SIZE);
+	size_t		new_sz = gts->chunk_adapt_sz;
+
+	if (gts->chunk_adapt_sz == 0 ||
+		gpu_latency <= 0.0 ||
+		host_latency <= 0.0)
+		return;
+
+	if (gpu_latency < CHUNK_ADAPT_MIN_LATENCY ||
+		gpu_latency > 2.0 * nasync * host_latency)
+		gts->chunk_adapt_votes = Max(gts->chunk_adapt_votes, 0) + 1;
+	else if (nasync * host_latency > 2.0 * gpu_latency)
+		gts->chunk_adapt_votes = Min(gts->chunk_adapt_votes, 0) - 1;
+	else
+		gts->chunk_adapt_votes = 0;
+
+	if (gts->chunk_adapt_votes >= CHUNK_ADAPT_NVOTES)
+		new_sz = Min(2 * gts->chunk_adapt_sz, max_sz);
+	else if (gts->chunk_adapt_votes <= -CHUNK_ADAPT_NVOTES)
+		new_sz = Max(gts->chunk_adapt_sz / 2, min_sz);
+	else
+		return;
+
+	gts->chunk_adapt_votes = 0;
+	if (new_sz != gts->chunk_adapt_sz)
+	{
+		gts->chunk_adapt_sz = new_sz;
+		gts->chunk_adapt_min_sz = Min(gts->chunk_adapt_min_sz, new_sz);
+		gts->chunk_adapt_max_sz = Max(gts->chunk_adapt_max_sz, new_sz);
+		gts->chunk_adapt_nresized++;
+		/* latency of the new size shall be measured again */
+		gts->hybrid_gpu_latency = 0.0;
+		gts->chunk_host_latency = 0.0;
+	}
+}
+
+/*
+ * cpu_hybrid_update_latency - update the average latency per chunk, used
+ * to the feedback of CPU/GPU hybrid execution
+ */
+static inline void
+cpu_hybrid_update_latency(double *p_latency, double latency)
+{
+	if (*p_latency <= 0.0)
+		*p_latency = latency;
+	else
+		*p_latency = 0.75 * (*p_latency) + 0.25 * latency;
+}
+
+/*
+ * cpu_hybrid_is_preferable
+ *
+ * It decides whether the backend process should scan the next chunk by
+ * itself, instead of the wait for completion of the GPU tasks, when the
+ * number of concurrent tasks touched the limitation.
+ * If GPU can process @num_running_tasks chunks in @hybrid_gpu_latency,
+ * and CPU can process a chunk in @hybrid_cpu_latency, the expected share
+ * of CPU to balance the throughput is:
+ *
+ *   gpu_latency / (gpu_latency + num_running_tasks * cpu_latency)
+ *
+ * then, we assign the next chunk on CPU if the share by CPU is smaller
+ * than the expected one.
+ */
+static bool
+cpu_hybrid_is_preferable(GpuTaskState *gts)
+{
+	double		cpu_share;
+	double		cpu_expected;
+	cl_long		num_tasks;
+
+	if (!enable_cpu_hybrid_execution || !gts->cb_cpu_hybrid_task)
+		return false;
+	/* no completed GPU task yet, so GPU shall go ahead */
+	if (gts->hybrid_gpu_latency <= 0.0)
+		return false;
+	/* no CPU chunk yet, so try one chunk to measure the latency */
+	if (gts->hybrid_cpu_latency <= 0.0)
+		return (gts->num_cpu_hybrid_tasks == 0);
+
+	num_tasks = gts->num_gpu_tasks + gts->num_cpu_hybrid_tasks;
+	cpu_share = (double)gts->num_cpu_hybrid_tasks / (double)num_tasks;
+	cpu_expected = (gts->hybrid_gpu_latency /
+					(gts->hybrid_gpu_latency +
+					 (double)gts->num_running_tasks * gts->hybrid_cpu_latency));
+	return (cpu_share < cpu_expected);
+}
+
+/*
+ * gpuTaskSchedSession - slot of the current session, if any
+ */
+static inline GpuTaskSchedSession *
+gpuTaskSchedSession(void)
+{
+	if (!MyProc || MyProc->pgprocno < 0 ||
+		MyProc->pgprocno >= gts_sched_nsessions)
+		return NULL;
+	return &gts_sched_sessions[MyProc->pgprocno];
+}
+
+/*
+ * gpuTaskSchedRegister / gpuTaskSchedUnregister
+ */
+static void
+gpuTaskSchedRegister(GpuTaskState *gts)
+{
+	cl_int		dindex = gts->gcontext->cuda_dindex;
+	GpuTaskSchedDevice *gs_dev = &gts_sched_devices[dindex];
+	GpuTaskSchedSession *gs_sess = gpuTaskSchedSession();
+
+	Assert(gts->sched_weight == 0);
+	gts->sched_weight = pgstrom_gpu_task_priority;
+	gettimeofday(&gts->sched_tv_begin, NULL);
+	gts->sched_nprocs_sum = 0;
+	gts->sched_nprocs_count = 0;
+	SpinLockAcquire(&gs_dev->lock);
+	if (gts_sched_local_weight[dindex] == 0)
+		gs_dev->nr_sessions++;
+	gs_dev->active_weight += gts->sched_weight;
+	SpinLockRelease(&gs_dev->lock);
+	gts_sched_local_weight[dindex] += gts->sched_weight;
+
+	if (gs_sess)
+	{
+		gs_sess->cuda_dindex = dindex;
+		gs_sess->weight = gts->sched_weight;
+		gs_sess->pid = MyProcPid;
+	}
+}
+
+static void
+__gpuTaskSchedWaitDone(GpuTaskState *gts)
+{
+	GpuTaskSchedSession *gs_sess = gpuTaskSchedSession();
+	TimestampTz	now;
+	long		secs;
+	int			usecs;
+	cl_ulong	elapsed;
+
+	if (gts->sched_wait_start == 0)
+		return;
+	now = GetCurrentTimestamp();
+	TimestampDifference(gts->sched_wait_start, now, &secs, &usecs);
+	elapsed = (cl_ulong)secs * 1000000UL + (cl_ulong)usecs;
+	gts->sched_wait_usec += elapsed;
+	gts->sched_wait_start = 0;
+	if (gs_sess)
+	{
+		gs_sess->wait_usec += elapsed;
+		gs_sess->wait_max_usec = Max(gs_sess->wait_max_usec, elapsed);
+	}
+}
+
+static void gpuSaturationSample(GpuTaskState *gts);
+static int	gpuDeviceSaturationPoint(cl_int cuda_dindex);
+
+static void
+gpuTaskSchedUnregister(GpuTaskState *gts)
+{
+	cl_int		dindex = gts->gcontext->cuda_dindex;
+	GpuTaskSchedDevice *gs_dev = &gts_sched_devices[dindex];
+
+	if (gts->sched_weight == 0)
+		return;
+	__gpuTaskSchedWaitDone(gts);
+	gpuSaturationSample(gts);
+	Assert(gts_sched_local_weight[dindex] >= gts->sched_weight);
+	gts_sched_local_weight[dindex] -= gts->sched_weight;
+	SpinLockAcquire(&gs_dev->lock);
+	Assert(gs_dev->active_weight >= gts->sched_weight);
+	gs_dev->active_weight -= gts->sched_weight;
+	if (gts_sched_local_weight[dindex] == 0)
+		gs_dev->nr_sessions--;
+	SpinLockRelease(&gs_dev->lock);
+	gts->sched_weight = 0;
+}
+
+/*
+ * gpuTaskSchedAllowed
+ *
+ * It checks whether the GpuTaskState can submit one more task within its
+ * fair share of the device slots. At least one task is always allowed.
+ */
+static bool
+gpuTaskSchedAllowed(GpuTaskState *gts, cl_int num_async_tasks)
+{
+	cl_int		dindex = gts->gcontext->cuda_dindex;
+	GpuTaskSchedDevice *gs_dev = &gts_sched_devices[dindex];
+	GpuTaskSchedSession *gs_sess = gpuTaskSchedSession();
+	cl_ulong	active_weight;
+	cl_int		fair_share;
+
+	if (gts->sched_weight == 0)
+		return true;
+	if (pgstrom_gpu_scheduler_slots <= 0)
+	{
+		/* scheduler is disabled on the fly */
+		__gpuTaskSchedWaitDone(gts);
+		return true;
+	}
+	SpinLockAcquire(&gs_dev->lock);
+	active_weight = gs_dev->active_weight;
+	SpinLockRelease(&gs_dev->lock);
+
+	fair_share = ((cl_ulong)pgstrom_gpu_scheduler_slots *
+				  (cl_ulong)gts->sched_weight) / Max(active_weight, 1);
+	fair_share = Max(fair_share, 1);
+	if (gs_sess)
+		gs_sess->fair_share = fair_share;
+	if (num_async_tasks < fair_share)
+	{
+		__gpuTaskSchedWaitDone(gts);
+		if (gs_sess)
+			gs_sess->num_tasks++;
+		return true;
+	}
+	/* blocked by the scheduler */
+	if (gts->sched_wait_start == 0)
+		gts->sched_wait_start = GetCurrentTimestamp();
+	return false;
+}
+
+/*
+ * gpuTaskSchedLeaveEarly
+ *
+ * A parallel worker stops to pick up the next chunk, if more processes than
+ * the saturation point of the device are submitting GPU tasks; the rest of
+ * the relation shall be scanned by the other processes. Only parallel-aware
+ * GpuTaskState that already has a GPU task (so, inner buffer is also built)
+ * can leave, and the leader process keeps running.
+ */
+static bool
+gpuTaskSchedLeaveEarly(GpuTaskState *gts)
+{
+	cl_int		dindex = gts->gcontext->cuda_dindex;
+	GpuTaskSchedDevice *gs_dev = &gts_sched_devices[dindex];
+	int			saturation;
+	bool		retval = false;
+
+	if (gts->sched_weight == 0)
+		return false;
+	/* sample the number of concurrent processes */
+	gts->sched_nprocs_sum += gs_dev->nr_sessions;
+	gts->sched_nprocs_count++;
+
+	if (!pgstrom_gpu_parallel_saturation ||
+		!IsParallelWorker() ||
+		!gts->css.ss.ps.plan->parallel_aware ||
+		gts->num_gpu_tasks == 0 ||
+		gts_sched_local_weight[dindex] != gts->sched_weight)
+		return false;
+	saturation = gpuDeviceSaturationPoint(dindex);
+	if (saturation <= 0)
+		return false;
+
+	SpinLockAcquire(&gs_dev->lock);
+	if (gs_dev->nr_sessions > saturation)
+	{
+		Assert(gs_dev->active_weight >= gts->sched_weight);
+		gs_dev->active_weight -= gts->sched_weight;
+		gs_dev->nr_sessions--;
+		retval = true;
+	}
+	SpinLockRelease(&gs_dev->lock);
+	if (retval)
+	{
+		__gpuTaskSchedWaitDone(gts);
+		gpuSaturationSample(gts);
+		gts_sched_local_weight[dindex] = 0;
+		gts->sched_weight = 0;
+		elog(DEBUG2, "parallel worker left the scan; %d processes on GPU%d is the saturation point",
+			 saturation, devAttrs[dindex].DEV_ID);
+	}
+	return retval;
+}
+
+/*
+ * gpuTaskSchedXactCallback
+ *
+ * GpuTaskStates never survive across the transaction boundary, so release
+ * the weight of the aborted queries.
+ */
+static void
+gpuTaskSchedXactCallback(XactEvent event, void *arg)
+{
+	int		dindex;
+
+	if (event != XACT_EVENT_COMMIT &&
+		event != XACT_EVENT_ABORT &&
+		event != XACT_EVENT_PARALLEL_COMMIT &&
+		event != XACT_EVENT_PARALLEL_ABORT)
+		return;
+	for (dindex=0; dindex < numDevAttrs; dindex++)
+	{
+		GpuTaskSchedDevice *gs_dev = &gts_sched_devices[dindex];
+		cl_ulong	weight = gts_sched_local_weight[dindex];
+
+		if (weight == 0)
+			continue;
+		SpinLockAcquire(&gs_dev->lock);
+		Assert(gs_dev->active_weight >= weight);
+		gs_dev->active_weight -= weight;
+		gs_dev->nr_sessions--;
+		SpinLockRelease(&gs_dev->lock);
+		gts_sched_local_weight[dindex] = 0;
+	}
+}
+
+/*
+ * gpuTaskSchedOnExit - release the session slot
+ */
+static void
+gpuTaskSchedOnExit(int code, Datum arg)
+{
+	GpuTaskSchedSession *gs_sess = gpuTaskSchedSession();
+
+	if (gs_sess && gs_sess->pid == MyProcPid)
+		memset(gs_sess, 0, sizeof(GpuTaskSchedSession));
+}
+
+/*
+ * gpuCostCalibSetup - record the time to build/load the CUDA module
+ */
+static void
+gpuCostCalibSetup(cl_int cuda_dindex, double msec)
+{
+	GpuCostCalibDevice *calib;
+
+	if (!gpu_cost_calib || cuda_dindex < 0 || cuda_dindex >= numDevAttrs)
+		return;
+	calib = &gpu_cost_calib[cuda_dindex];
+	SpinLockAcquire(&calib->lock);
+	if (calib->setup_nsamples == 0)
+		calib->setup_msec = msec;
+	else
+		calib->setup_msec = (GPU_COST_CALIB_DECAY * calib->setup_msec +
+							 (1.0 - GPU_COST_CALIB_DECAY) * msec);
+	calib->setup_nsamples++;
+	SpinLockRelease(&calib->lock);
+}
+
+/*
+ * gpuCostCalibExec - record the average time of GPU tasks
+ */
+static void
+gpuCostCalibExec(GpuTaskState *gts, GpuTaskRuntimeStat *gt_rtstat)
+{
+	cl_int		cuda_dindex = gts->gcontext->cuda_dindex;
+	GpuCostCalibDevice *calib;
+	double		x, y;
+
+	/*
+	 * Rows in the runtime statistics are shared by the parallel workers,
+	 * and also contain the rows processed by CPU, so skip these cases.
+	 */
+	if (!gpu_cost_calib || !gt_rtstat ||
+		cuda_dindex < 0 || cuda_dindex >= numDevAttrs ||
+		IsParallelWorker() || gts->pcxt != NULL ||
+		gts->gpu_exec_ntasks == 0 ||
+		gts->num_cpu_hybrid_tasks > 0 ||
+		gts->num_cpu_fallbacks > 0)
+		return;
+	x = ((double)pg_atomic_read_u64(&gt_rtstat->source_nitems) /
+		 (double)gts->gpu_exec_ntasks);
+	y = gts->gpu_exec_msec / (double)gts->gpu_exec_ntasks;
+
+	calib = &gpu_cost_calib[cuda_dindex];
+	SpinLockAcquire(&calib->lock);
+	calib->exec_w  = GPU_COST_CALIB_DECAY * calib->exec_w + 1.0;
+	calib->exec_x  = GPU_COST_CALIB_DECAY * calib->exec_x + x;
+	calib->exec_y  = GPU_COST_CALIB_DECAY * calib->exec_y + y;
+	calib->exec_xx = GPU_COST_CALIB_DECAY * calib->exec_xx + x * x;
+	calib->exec_xy = GPU_COST_CALIB_DECAY * calib->exec_xy + x * y;
+	calib->exec_nsamples++;
+	SpinLockRelease(&calib->lock);
+}
+
+/*
+ * gpuSaturationSample - record the throughput of the process
+ */
+static void
+gpuSaturationSample(GpuTaskState *gts)
+{
+	cl_int		cuda_dindex = gts->gcontext->cuda_dindex;
+	GpuCostCalibDevice *calib;
+	struct timeval tv;
+	double		elapsed;
+	double		tasks_per_sec;
+	int			level;
+
+	if (!gpu_cost_calib ||
+		cuda_dindex < 0 || cuda_dindex >= numDevAttrs ||
+		gts->sched_nprocs_count == 0 ||
+		gts->num_gpu_tasks < 2 ||
+		gts->num_cpu_fallbacks > 0)
+		return;
+	gettimeofday(&tv, NULL);
+	elapsed = TV_DIFF(tv, gts->sched_tv_begin);
+	if (elapsed <= 0.0)
+		return;
+	tasks_per_sec = 1000.0 * (double)gts->num_gpu_tasks / elapsed;
+	level = ((double)gts->sched_nprocs_sum /
+			 (double)gts->sched_nprocs_count + 0.5);
+	level = Min(Max(level, 1), GPU_SATURATION_NLEVELS) - 1;
+
+	calib = &gpu_cost_calib[cuda_dindex];
+	SpinLockAcquire(&calib->lock);
+	if (calib->conc_nsamples[level] == 0)
+		calib->conc_tasks_per_sec[level] = tasks_per_sec;
+	else
+		calib->conc_tasks_per_sec[level]
+			= (GPU_COST_CALIB_DECAY * calib->conc_tasks_per_sec[level] +
+			   (1.0 - GPU_COST_CALIB_DECAY) * tasks_per_sec);
+	calib->conc_nsamples[level]++;
+	SpinLockRelease(&calib->lock);
+}
+
+/*
+ * __gpuDeviceSaturationPoint / gpuDeviceSaturationPoint
+ *
+ * It returns the saturation point of the device (number of processes), or 0
+ * if unknown.
+ */
+static int
+__gpuDeviceSaturationPoint(GpuCostCalibDevice *calib)
+{
+	double		best = 0.0;
+	int			best_level = 0;
+	int			max_level = 0;
+	int			i;
+
+	for (i=0; i < GPU_SATURATION_NLEVELS; i++)
+	{
+		double	thpt = (double)(i+1) * calib->conc_tasks_per_sec[i];
+
+		if (calib->conc_nsamples[i] < GPU_SATURATION_MIN_SAMPLES)
+			continue;
+		if (thpt > best)
+		{
+			best = thpt;
+			best_level = i+1;
+		}
+		max_level = i+1;
+	}
+	/* no samples beyond the best one, so saturation is not observed yet */
+	if (best_level == 0 || best_level == max_level)
+		return 0;
+	for (i=0; i < best_level; i++)
+	{
+		double	thpt = (double)(i+1) * calib->conc_tasks_per_sec[i];
+
+		if (calib->conc_nsamples[i] >= GPU_SATURATION_MIN_SAMPLES &&
+			thpt >= GPU_SATURATION_THRESHOLD * best)
+			return i+1;
+	}
+	return best_level;
+}
+
+static int
+gpuDeviceSaturationPoint(cl_int cuda_dindex)
+{
+	GpuCostCalibDevice *calib;
+	GpuCostCalibDevice	temp;
+
+	if (!gpu_cost_calib || cuda_dindex < 0 || cuda_dindex >= numDevAttrs)
+		return 0;
+	calib = &gpu_cost_calib[cuda_dindex];
+	SpinLockAcquire(&calib->lock);
+	memcpy(&temp, calib, sizeof(GpuCostCalibDevice));
+	SpinLockRelease(&calib->lock);
+
+	return __gpuDeviceSaturationPoint(&temp);
+}
+
+/*
+ * pgstrom_gpu_parallel_workers
+ *
+ * It caps the number of parallel workers of GPU paths by the saturation
+ * point of the device (or the largest one across the devices, if not
+ * determined yet), because more processes just make contention on the
+ * device. The leader process is also counted. It returns @parallel_workers
+ * as is, if saturation point is unknown.
+ */
+int
+pgstrom_gpu_parallel_workers(int parallel_workers, int cuda_dindex)
+{
+	int			saturation = 0;
+	int			i;
+
+	if (!pgstrom_gpu_parallel_saturation || parallel_workers <= 1)
+		return parallel_workers;
+	if (cuda_dindex >= 0 && cuda_dindex < numDevAttrs)
+		saturation = gpuDeviceSaturationPoint(cuda_dindex);
+	else
+	{
+		for (i=0; i < numDevAttrs; i++)
+		{
+			int		temp = gpuDeviceSaturationPoint(i);
+
+			if (temp <= 0)
+				return parallel_workers;
+			saturation = Max(saturation, temp);
+		}
+	}
+	if (saturation <= 0)
+		return parallel_workers;
+	return Max(Min(parallel_workers, saturation - 1), 1);
+}
+
+/*
+ * gpuCostCalibSolve
+ *
+ * It solves the coefficients of the model by the least squares. If rows per
+ * task were almost constant (usually, chunks are filled up), the time per
+ * chunk and per row cannot be separated, so @msec_per_chunk is negative and
+ * the whole time is attributed to the rows.
+ */
+static bool
+gpuCostCalibSolve(GpuCostCalibDevice *calib,
+				  double *p_msec_per_chunk,
+				  double *p_msec_per_row)
+{
+	double		w = calib->exec_w;
+	double		x = calib->exec_x;
+	double		y = calib->exec_y;
+	double		det = w * calib->exec_xx - x * x;
+	double		a, b;
+
+	if (calib->exec_nsamples < GPU_COST_CALIB_MIN_SAMPLES || x <= 0.0)
+		return false;
+	if (det > 1.0e-6 * w * calib->exec_xx)
+	{
+		b = (w * calib->exec_xy - x * y) / det;
+		a = (y - b * x) / w;
+		if (b < 0.0)
+		{
+			a = y / w;
+			b = 0.0;
+		}
+		else if (a < 0.0)
+		{
+			a = 0.0;
+			b = y / x;
+		}
+	}
+	else
+	{
+		a = -1.0;
+		b = y / x;
+	}
+	*p_msec_per_chunk = a;
+	*p_msec_per_row = b;
+	return true;
+}
+
+/*
+ * pgstrom_gpu_cost_factors
+ *
+ * It returns the cost factors used by the planner; the calibrated values
+ * averaged over the GPU devices, or the GUC parameters if not available.
+ */
+void
+pgstrom_gpu_cost_factors(double *p_setup_cost,
+						 double *p_dma_cost,
+						 double *p_operator_cost)
+{
+	double		setup_msec = 0.0;
+	double		chunk_msec = 0.0;
+	double		row_msec = 0.0;
+	int			setup_count = 0;
+	int			chunk_count = 0;
+	int			row_count = 0;
+	int			i;
+
+	*p_setup_cost = pgstrom_gpu_setup_cost;
+	*p_dma_cost = pgstrom_gpu_dma_cost;
+	*p_operator_cost = pgstrom_gpu_operator_cost;
+	if (pgstrom_gpu_cost_per_msec <= 0.0 || !gpu_cost_calib)
+		return;
+
+	for (i=0; i < numDevAttrs; i++)
+	{
+		GpuCostCalibDevice *calib = &gpu_cost_calib[i];
+		GpuCostCalibDevice	temp;
+		double		a, b;
+
+		SpinLockAcquire(&calib->lock);
+		memcpy(&temp, calib, sizeof(GpuCostCalibDevice));
+		SpinLockRelease(&calib->lock);
+
+		if (temp.setup_nsamples >= GPU_COST_CALIB_MIN_SAMPLES)
+		{
+			setup_msec += temp.setup_msec;
+			setup_count++;
+		}
+		if (gpuCostCalibSolve(&temp, &a, &b))
+		{
+			if (a >= 0.0)
+			{
+				chunk_msec += a;
+				chunk_count++;
+			}
+			row_msec += b;
+			row_count++;
+		}
+	}
+	if (setup_count > 0)
+		*p_setup_cost = pgstrom_gpu_cost_per_msec * setup_msec / setup_count;
+	if (chunk_count > 0)
+		*p_dma_cost = pgstrom_gpu_cost_per_msec * chunk_msec / chunk_count;
+	if (row_count > 0)
+		*p_operator_cost = pgstrom_gpu_cost_per_msec * row_msec / row_count;
+}
+
+/*
+ * gpuTaskLookupModule - load the CUDA module of GpuTaskState, if not yet
+ */
+static void
+gpuTaskLookupModule(GpuTaskState *gts)
+{
+	struct timeval	tv1, tv2;
+
+	if (gts->cuda_module || gts->program_id == INVALID_PROGRAM_ID)
+		return;
+	gettimeofday(&tv1, NULL);
+	gts->cuda_module = GpuContextLookupModule(gts->gcontext,
+											  gts->program_id);
+	gettimeofday(&tv2, NULL);
+	gpuCostCalibSetup(gts->gcontext->cuda_dindex, TV_DIFF(tv2, tv1));
+}
+
+/*
+ * pgstromRegisterGpuTaskFanout
+ */
+static void
+gpuTaskFanoutResetCallback(void *arg)
+{
+	GpuTaskFanout *fanout = arg;
+
+	if (fanout->gts)
+	{
+		dlist_delete(&fanout->chain);
+		fanout->gts = NULL;
+	}
+}
+
+void
+pgstromRegisterGpuTaskFanout(GpuTaskState *gts)
+{
+	EState	   *estate = gts->css.ss.ps.state;
+	GpuTaskFanout *fanout;
+
+	Assert(gts->cb_fanout_begin != NULL);
+	fanout = MemoryContextAllocZero(estate->es_query_cxt,
+									sizeof(GpuTaskFanout));
+	fanout->estate = estate;
+	fanout->gts = gts;
+	fanout->mcb.func = gpuTaskFanoutResetCallback;
+	fanout->mcb.arg = fanout;
+	MemoryContextRegisterResetCallback(estate->es_query_cxt, &fanout->mcb);
+	dlist_push_tail(&gpu_task_fanout_list, &fanout->chain);
+	gts->fanout = fanout;
+}
+
+static void
+gpuTaskFanoutDetach(GpuTaskState *gts)
+{
+	GpuTaskFanout *fanout = gts->fanout;
+
+	if (fanout)
+	{
+		if (fanout->gts)
+		{
+			dlist_delete(&fanout->chain);
+			fanout->gts = NULL;
+		}
+		gts->fanout = NULL;
+	}
+}
+
+/*
+ * gpuTaskFanoutKick
+ *
+ * It submits the first chunk of the sibling GpuTaskStates, at most one per
+ * GPU device except for the one the current GpuTaskState runs on.
+ */
+static void
+gpuTaskFanoutKick(GpuTaskState *gts)
+{
+	EState	   *estate = gts->css.ss.ps.state;
+	Bitmapset  *kicked = NULL;
+	dlist_iter	iter;
+
+	gpuTaskFanoutDetach(gts);
+	kicked = bms_add_member(kicked, gts->gcontext->cuda_dindex);
+	dlist_foreach(iter, &gpu_task_fanout_list)
+	{
+		GpuTaskFanout *fanout = dlist_container(GpuTaskFanout,
+												chain, iter.cur);
+		GpuTaskState *sibling = fanout->gts;
+		GpuContext *gcontext;
+		GpuTask	   *gtask;
+
+		if (fanout->estate != estate)
+			continue;
+		gcontext = sibling->gcontext;
+		if (bms_is_member(gcontext->cuda_dindex, kicked) ||
+			sibling->scan_done ||
+			sibling->num_gpu_tasks > 0 ||
+			sibling->num_running_tasks > 0 ||
+			sibling->num_ready_tasks > 0)
+			continue;
+		/* setup the sibling as if ExecProcNode() is called */
+		sibling->cb_fanout_begin(sibling);
+		gpuTaskLookupModule(sibling);
+		if (sibling->sched_weight == 0 &&
+			pgstrom_gpu_scheduler_slots > 0)
+			gpuTaskSchedRegister(sibling);
+		if (!gpuTaskSchedAllowed(sibling, 0))
+			continue;
+
+		gtask = sibling->cb_next_task(sibling);
+		pthreadMutexLock(&gcontext->worker_mutex);
+		if (!gtask)
+			sibling->scan_done = true;
+		else
+		{
+			gettimeofday(&gtask->tv_submit, NULL);
+			dlist_push_tail(&gcontext->pending_tasks, &gtask->chain);
+			gpuStatUpdateTasks(gcontext, 1, 0);
+			sibling->num_running_tasks++;
+			sibling->num_gpu_tasks++;
+			pthreadCondSignal(&gcontext->worker_cond);
+		}
+		pthreadMutexUnlock(&gcontext->worker_mutex);
+		if (!gtask)
+			gpuTaskSchedUnregister(sibling);
+		kicked = bms_add_member(kicked, gcontext->cuda_dindex);
+	}
+	bms_free(kicked);
+}
+
 /*
  * fetch_next_gputask
  */
@@ -373,25 +1351,51 @@ fetch_next_gputask(GpuTaskState *gts)
 	Assert(gcontext->worker_is_running);
 	CHECK_FOR_GPUCONTEXT(gcontext);
 
+	/* submit the first chunk of the siblings on the other GPUs */
+	if (gts->fanout)
+		gpuTaskFanoutKick(gts);
+
+	/* register the weight to the GPU task scheduler */
+	if (!gts->scan_done &&
+		gts->sched_weight == 0 &&
+		(pgstrom_gpu_scheduler_slots > 0 ||
+		 pgstrom_gpu_parallel_saturation))
+		gpuTaskSchedRegister(gts);
+
 	pthreadMutexLock(&gcontext->worker_mutex);
 	while (!gts->scan_done)
 	{
 		ResetLatch(MyLatch);
 		num_async_tasks = (gts->num_ready_tasks +
 						   gts->num_running_tasks);
-		if (num_async_tasks < pgstrom_max_async_tasks &&
-			(dlist_is_empty(&gts->ready_tasks) || gts->num_running_tasks == 0))
+		if (num_async_tasks < gts->max_async_tasks &&
+			(dlist_is_empty(&gts->ready_tasks) || gts->num_running_tasks == 0) &&
+			gpuTaskSchedAllowed(gts, num_async_tasks))
 		{
+			struct timeval	tv1, tv2;
+
+			/* GPU is saturated by the other processes? */
+			if (gpuTaskSchedLeaveEarly(gts))
+			{
+				gts->scan_done = true;
+				break;
+			}
 			pthreadMutexUnlock(&gcontext->worker_mutex);
+			gettimeofday(&tv1, NULL);
 			gtask = gts->cb_next_task(gts);
+			gettimeofday(&tv2, NULL);
+			gts->chunk_load_latency = TV_DIFF(tv2, tv1);
 			pthreadMutexLock(&gcontext->worker_mutex);
 			if (!gtask)
 			{
 				gts->scan_done = true;
 				break;
 			}
+			gettimeofday(&gtask->tv_submit, NULL);
 			dlist_push_tail(&gcontext->pending_tasks, &gtask->chain);
+			gpuStatUpdateTasks(gcontext, 1, 0);
 			gts->num_running_tasks++;
+			gts->num_gpu_tasks++;
 			pthreadCondSignal(&gcontext->worker_cond);
 		}
 		else if (!dlist_is_empty(&gts->ready_tasks))
@@ -403,6 +1407,40 @@ fetch_next_gputask(GpuTaskState *gts)
 			 */
 			goto pickup_gputask;
 		}
+		else if (gts->num_running_tasks > 0 &&
+				 cpu_hybrid_is_preferable(gts))
+		{
+			/*
+			 * GPU is already saturated by the running tasks, and nobody
+			 * gets completed yet. Instead of the wait for completion, CPU
+			 * scans the next chunk by itself using the CPU fallback path
+			 * of the GpuTaskState.
+			 */
+			pthreadMutexUnlock(&gcontext->worker_mutex);
+			gtask = gts->cb_next_task(gts);
+			if (!gtask)
+			{
+				pthreadMutexLock(&gcontext->worker_mutex);
+				gts->scan_done = true;
+				break;
+			}
+			if (gts->cb_cpu_hybrid_task(gts, gtask))
+			{
+				gtask->cpu_hybrid = true;
+				pthreadMutexLock(&gcontext->worker_mutex);
+				dlist_push_tail(&gts->ready_tasks, &gtask->chain);
+				gts->num_ready_tasks++;
+				goto pickup_gputask;
+			}
+			/* elsewhere, this chunk has to be processed by GPU */
+			pthreadMutexLock(&gcontext->worker_mutex);
+			gettimeofday(&gtask->tv_submit, NULL);
+			dlist_push_tail(&gcontext->pending_tasks, &gtask->chain);
+			gpuStatUpdateTasks(gcontext, 1, 0);
+			gts->num_running_tasks++;
+			gts->num_gpu_tasks++;
+			pthreadCondSignal(&gcontext->worker_cond);
+		}
 		else if (gts->num_running_tasks > 0)
 		{
 			/*
@@ -438,6 +1476,8 @@ fetch_next_gputask(GpuTaskState *gts)
 		}
 	}
 	pthreadMutexUnlock(&gcontext->worker_mutex);
+	/* no more submission, so unregister from the scheduler */
+	gpuTaskSchedUnregister(gts);
 
 	/*
 	 * Once we exit the above loop, either a completed task was returned,
@@ -474,6 +1514,7 @@ retry:
 					{
 						dlist_push_tail(&gcontext->pending_tasks,
 										&gtask->chain);
+						gpuStatUpdateTasks(gcontext, 1, 0);
 						gts->num_running_tasks++;
 						pthreadCondSignal(&gcontext->worker_cond);
 					}
@@ -509,6 +1550,25 @@ pickup_gputask:
 	gts->num_ready_tasks--;
 	pthreadMutexUnlock(&gcontext->worker_mutex);
 
+	/* feedback for the CPU/GPU hybrid execution */
+	if (!gtask->cpu_hybrid &&
+		gtask->tv_submit.tv_sec != 0 &&
+		gtask->tv_ready.tv_sec != 0)
+	{
+		cpu_hybrid_update_latency(&gts->hybrid_gpu_latency,
+								  TV_DIFF(gtask->tv_ready,
+										  gtask->tv_submit));
+		pgstromChunkAdaptiveUpdate(gts);
+	}
+	/* time of GPU tasks, for the calibration of the cost model */
+	if (!gtask->cpu_hybrid &&
+		gtask->tv_launch.tv_sec != 0 &&
+		gtask->tv_ready.tv_sec != 0)
+	{
+		gts->gpu_exec_msec += TV_DIFF(gtask->tv_ready, gtask->tv_launch);
+		gts->gpu_exec_ntasks++;
+	}
+	gettimeofday(&gts->chunk_tv_pickup, NULL);
 	return gtask;
 }
 
@@ -520,9 +1580,7 @@ pgstromExecGpuTaskState(GpuTaskState *gts)
 {
 	TupleTableSlot *slot = NULL;
 
-	if (!gts->cuda_module && gts->program_id != INVALID_PROGRAM_ID)
-		gts->cuda_module = GpuContextLookupModule(gts->gcontext,
-												  gts->program_id);
+	gpuTaskLookupModule(gts);
 
 	while (!gts->curr_task || !(slot = gts->cb_next_tuple(gts)))
 	{
@@ -531,6 +1589,31 @@ pgstromExecGpuTaskState(GpuTaskState *gts)
 		/* release the current GpuTask object that was already scanned */
 		if (gtask)
 		{
+			if (gtask->cpu_hybrid)
+			{
+				struct timeval	tv_end;
+
+				gettimeofday(&tv_end, NULL);
+				cpu_hybrid_update_latency(&gts->hybrid_cpu_latency,
+										  TV_DIFF(tv_end,
+												  gts->hybrid_tv_begin));
+			}
+			else if (gts->chunk_tv_pickup.tv_sec != 0)
+			{
+				struct timeval	tv_end;
+				double			elapsed;
+
+				/* host time to consume the results of a chunk */
+				gettimeofday(&tv_end, NULL);
+				elapsed = TV_DIFF(tv_end, gts->chunk_tv_pickup);
+				gts->stage_usec[GPUTASK_STAGE__HOST] += (cl_ulong)
+					(1000.0 * elapsed);
+				/* host time to load and consume a chunk */
+				if (gts->chunk_adapt_sz > 0)
+					cpu_hybrid_update_latency(&gts->chunk_host_latency,
+											  elapsed +
+											  gts->chunk_load_latency);
+			}
 			gts->cb_release_task(gtask);
 			gts->curr_task = NULL;
 			gts->curr_index = 0;
@@ -540,7 +1623,12 @@ pgstromExecGpuTaskState(GpuTaskState *gts)
 		gtask = fetch_next_gputask(gts);
 		if (!gtask)
 			return NULL;
-		if (gtask->cpu_fallback)
+		if (gtask->cpu_hybrid)
+		{
+			gts->num_cpu_hybrid_tasks++;
+			gettimeofday(&gts->hybrid_tv_begin, NULL);
+		}
+		else if (gtask->cpu_fallback)
 			gts->num_cpu_fallbacks++;
 		gts->curr_task = gtask;
 		gts->curr_index = 0;
@@ -552,6 +1640,30 @@ pgstromExecGpuTaskState(GpuTaskState *gts)
 	return slot;
 }
 
+/*
+ * pgstromFetchGpuTask
+ *
+ * It returns the next completed GpuTask as is, for the consumer that reads
+ * the results chunk-by-chunk (like GpuSort), instead of the tuples. The
+ * caller shall release the task using gts->cb_release_task.
+ */
+GpuTask *
+pgstromFetchGpuTask(GpuTaskState *gts)
+{
+	GpuTask	   *gtask;
+
+	gpuTaskLookupModule(gts);
+	gtask = fetch_next_gputask(gts);
+	if (gtask)
+	{
+		if (gtask->cpu_hybrid)
+			gts->num_cpu_hybrid_tasks++;
+		else if (gtask->cpu_fallback)
+			gts->num_cpu_fallbacks++;
+	}
+	return gtask;
+}
+
 /*
  * pgstromRescanGpuTaskState
  */
@@ -597,6 +1709,8 @@ pgstromReleaseGpuTaskState(GpuTaskState *gts, GpuTaskRuntimeStat *gt_rtstat)
 		Assert(gts->num_ready_tasks >= 0);
 		gts->cb_release_task(gtask);
 	}
+	/* detach from the fan-out list, if still registered */
+	gpuTaskFanoutDetach(gts);
 	/* cleanup per-query PDS-scan state, if any */
 	PDS_end_heapscan_state(gts);
 	InstrEndLoop(&gts->outer_instrument);
@@ -608,9 +1722,26 @@ pgstromReleaseGpuTaskState(GpuTaskState *gts, GpuTaskRuntimeStat *gt_rtstat)
 		ExecEndArrowFdw(gts->af_state);
 	if (gts->gc_state)
 		ExecEndGpuCache(gts->gc_state);
+	/* per-query statistics for pgstrom.gpu_stat_statements */
+	gpuStatStatementsAccum(gts, gt_rtstat);
 	/* unreference CUDA program */
 	if (gts->program_id != INVALID_PROGRAM_ID)
 		pgstrom_put_cuda_program(gts->gcontext, gts->program_id);
+	/* record the time of GPU tasks for the calibration of the cost model */
+	gpuCostCalibExec(gts, gt_rtstat);
+	/* device statistics for pgstrom.pg_stat_gpu */
+	if (gts->gcontext)
+		gpuStatAccumTasks(gts->gcontext->cuda_dindex,
+						  gts->num_gpu_tasks,
+						  gts->num_cpu_fallbacks);
+	/* unregister from the GPU task scheduler, if still active */
+	gpuTaskSchedUnregister(gts);
+	/* release the device memory budget */
+	if (gts->gm_budget > 0)
+	{
+		gpuMemReleaseBudget(gts->gcontext, gts->gm_budget);
+		gts->gm_budget = 0;
+	}
 	/* unreference GpuContext */
 	PutGpuContext(gts->gcontext);
 }
@@ -670,10 +1801,132 @@ pgstromExplainGpuTaskState(GpuTaskState *gts,
 	else if (es->format != EXPLAIN_FORMAT_TEXT)
 		ExplainPropertyText("NVMe-Strom", "disabled", es);
 
+	/* Number of concurrent tasks, if downgraded by the memory budget */
+	if (es->analyze && gts->max_async_tasks < pgstrom_max_async_tasks)
+		ExplainPropertyInteger("Max Async Tasks (downgraded)",
+							   NULL, gts->max_async_tasks, es);
+
+	/* Chunk sizes chosen by the adaptive chunk size, if any */
+	if (es->analyze && gts->chunk_adapt_sz > 0)
+	{
+		if (gts->chunk_adapt_nresized == 0)
+			snprintf(temp, sizeof(temp), "%s",
+					 format_bytesz(gts->chunk_adapt_sz));
+		else
+		{
+			char   *min_sz = format_bytesz(gts->chunk_adapt_min_sz);
+			char   *max_sz = format_bytesz(gts->chunk_adapt_max_sz);
+
+			snprintf(temp, sizeof(temp), "%s..%s (last: %s, resized: %d)",
+					 min_sz, max_sz,
+					 format_bytesz(gts->chunk_adapt_sz),
+					 gts->chunk_adapt_nresized);
+		}
+		ExplainPropertyText("Chunk Size", temp, es);
+	}
+
+	/* Time blocked by the GPU task scheduler, if any */
+	if (es->analyze && gts->sched_wait_usec > 0)
+		ExplainPropertyFloat("Scheduler Wait", "ms",
+							 (double)gts->sched_wait_usec / 1000.0, 2, es);
+
 	/* Number of CPU fallbacks, if any */
 	if (es->analyze && gts->num_cpu_fallbacks > 0)
 		ExplainPropertyInteger("CPU fallbacks",
 							   NULL, gts->num_cpu_fallbacks, es);
+	/* Number of rows rechecked by CPU individually, if any */
+	if (es->analyze && gts->num_cpu_rechecks > 0)
+		ExplainPropertyInteger("CPU rechecks",
+							   NULL, gts->num_cpu_rechecks, es);
+	/* Share of CPU/GPU hybrid execution, if any */
+	if (es->analyze && gts->num_cpu_hybrid_tasks > 0)
+	{
+		cl_long		num_tasks = (gts->num_gpu_tasks +
+								 gts->num_cpu_hybrid_tasks);
+
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			snprintf(temp, sizeof(temp),
+					 "GPU: %ld chunks (%.1f%%), CPU: %ld chunks (%.1f%%)",
+					 gts->num_gpu_tasks,
+					 100.0 * (double)gts->num_gpu_tasks / (double)num_tasks,
+					 gts->num_cpu_hybrid_tasks,
+					 100.0 * (double)gts->num_cpu_hybrid_tasks / (double)num_tasks);
+			ExplainPropertyText("CPU/GPU Hybrid", temp, es);
+		}
+		else
+		{
+			ExplainPropertyInteger("GPU Chunks", NULL,
+								   gts->num_gpu_tasks, es);
+			ExplainPropertyInteger("CPU Hybrid Chunks", NULL,
+								   gts->num_cpu_hybrid_tasks, es);
+		}
+	}
+	/* Timing breakdown of GPU tasks, if any */
+	if (es->analyze && !pgstrom_regression_test_mode)
+	{
+		static const char *stage_names[GPUTASK_NUM_STAGES] = {
+			"queue", "dma-send", "kernel", "dma-recv", "host",
+		};
+		static const char *stage_labels[GPUTASK_NUM_STAGES] = {
+			"Queue Time", "DMA Send Time", "Kernel Time",
+			"DMA Receive Time", "Host Consume Time",
+		};
+		cl_ulong	total_usec = 0;
+		int			i;
+
+		for (i=0; i < GPUTASK_NUM_STAGES; i++)
+			total_usec += gts->stage_usec[i];
+		if (total_usec > 0 && es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			StringInfoData buf;
+
+			initStringInfo(&buf);
+			for (i=0; i < GPUTASK_NUM_STAGES; i++)
+			{
+				appendStringInfo(&buf, "%s%s: %.2fms (%.1f%%)",
+								 i > 0 ? ", " : "",
+								 stage_names[i],
+								 (double)gts->stage_usec[i] / 1000.0,
+								 100.0 * (double)gts->stage_usec[i] /
+								 (double)total_usec);
+			}
+			ExplainPropertyText("GPU Stages", buf.data, es);
+			pfree(buf.data);
+		}
+		else if (total_usec > 0)
+		{
+			for (i=0; i < GPUTASK_NUM_STAGES; i++)
+				ExplainPropertyFloat(stage_labels[i], "ms",
+									 (double)gts->stage_usec[i] / 1000.0,
+									 2, es);
+		}
+	}
+	/* Usage of the chunk-ring, if any */
+	if (es->analyze && gts->chunk_ring && !pgstrom_regression_test_mode)
+	{
+		pgstromChunkRing *ring = gts->chunk_ring;
+
+		if (es->format == EXPLAIN_FORMAT_TEXT)
+		{
+			snprintf(temp, sizeof(temp),
+					 "peak %d of %d buffers, recycled=%lu, overflow=%lu",
+					 ring->max_usage, ring->nrooms,
+					 ring->nr_recycled, ring->nr_overflow);
+			ExplainPropertyText("Chunk Ring", temp, es);
+		}
+		else
+		{
+			ExplainPropertyInteger("Chunk Ring Size", NULL,
+								   ring->nrooms, es);
+			ExplainPropertyInteger("Chunk Ring Peak Usage", NULL,
+								   ring->max_usage, es);
+			ExplainPropertyInteger("Chunk Ring Recycled", NULL,
+								   ring->nr_recycled, es);
+			ExplainPropertyInteger("Chunk Ring Overflow", NULL,
+								   ring->nr_overflow, es);
+		}
+	}
 	/* Properties of Arrow_Fdw/GpuCache if any */
 	if (gts->af_state)
 		ExplainArrowFdw(gts->af_state, rel, es, dcontext);
@@ -720,6 +1973,8 @@ pgstromEstimateDSMGpuTaskState(GpuTaskState *gts, ParallelContext *pcxt)
 	sz = sizeof(GpuTaskSharedState);
 	if (relation && RELATION_HAS_STORAGE(relation))
 		sz += table_parallelscan_estimate(relation, snapshot);
+	if (gts->af_state)
+		sz = MAXALIGN(sz) + ExecEstimateDSMArrowFdw(gts->af_state, pcxt);
 	return MAXALIGN(sz);
 }
 
@@ -738,7 +1993,12 @@ pgstromInitDSMGpuTaskState(GpuTaskState *gts,
 
 	memset(gtss, 0, offsetof(GpuTaskSharedState, phscan));
 	if (gts->af_state)
-		ExecInitDSMArrowFdw(gts->af_state, gtss);
+	{
+		/* arrow_fdw tables have no storage, thus no phscan */
+		Assert(!relation || !RELATION_HAS_STORAGE(relation));
+		gtss->af_sched_offset = MAXALIGN(sizeof(GpuTaskSharedState));
+		ExecInitDSMArrowFdw(gts->af_state, gtss, pcxt);
+	}
 	if (gts->gc_state)
 		ExecInitDSMGpuCache(gts->gc_state, gtss);
 	if (relation && RELATION_HAS_STORAGE(relation))
@@ -748,6 +2008,7 @@ pgstromInitDSMGpuTaskState(GpuTaskState *gts,
 		SpinLockInit(&gtss->pbs_mutex);
 		gtss->pbs_startblock = InvalidBlockNumber;
 		gtss->pbs_nallocated = 0;
+		gtss->pbs_stripe_nblocks = RelationGetStripeNBlocks(relation);
 		/* import snapshot by the core logic */
 		table_parallelscan_initialize(relation, &gtss->phscan, snapshot);
 	}
@@ -764,6 +2025,7 @@ pgstromInitWorkerGpuTaskState(GpuTaskState *gts, void *coordinate)
 	Relation	relation = gts->css.ss.ss_currentRelation;
 	GpuTaskSharedState *gtss = coordinate;
 
+	shmbufAttachAllSegments();
 	if (gts->af_state)
 		ExecInitWorkerArrowFdw(gts->af_state, gtss);
 	if (gts->gc_state)
@@ -838,6 +2100,248 @@ pgstromInitGpuTask(GpuTaskState *gts, GpuTask *gtask)
 	gtask->program_id   = gts->program_id;
 	gtask->gts          = gts;
 	gtask->cpu_fallback = false;
+	gtask->cpu_hybrid   = false;
+	memset(&gtask->tv_submit, 0, sizeof(struct timeval));
+	memset(&gtask->tv_launch, 0, sizeof(struct timeval));
+	memset(&gtask->tv_ready, 0, sizeof(struct timeval));
+	memset(gtask->stage_usec, 0, sizeof(gtask->stage_usec));
+	gtask->dma_send_bytes = 0;
+	gtask->dma_recv_bytes = 0;
+	gtask->chunk_id     = gts->trace_nchunks++;
+}
+
+/*
+ * pgstrom_gpu_task_scheduler - SRF of the pgstrom.gpu_task_scheduler view
+ */
+#define GPU_TASK_SCHEDULER_NATTS	8
+Datum
+pgstrom_gpu_task_scheduler(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	GpuTaskSchedSession *gs_sess;
+	Datum		values[GPU_TASK_SCHEDULER_NATTS];
+	bool		isnull[GPU_TASK_SCHEDULER_NATTS];
+	HeapTuple	tuple;
+	int		   *p_index;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc	tupdesc;
+		MemoryContext oldcxt;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+		tupdesc = CreateTemplateTupleDesc(GPU_TASK_SCHEDULER_NATTS);
+		TupleDescInitEntry(tupdesc, 1, "pid",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 2, "gpu_id",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 3, "priority",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 4, "fair_share",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 5, "active_sessions",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 6, "num_tasks",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 7, "queue_wait_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 8, "queue_wait_max_ms",
+						   FLOAT8OID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+		fncxt->user_fctx = palloc0(sizeof(int));	/* next slot index */
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	p_index = fncxt->user_fctx;
+	gs_sess = alloca(sizeof(GpuTaskSchedSession));
+	for (;;)
+	{
+		if (*p_index >= gts_sched_nsessions)
+			SRF_RETURN_DONE(fncxt);
+		memcpy(gs_sess, &gts_sched_sessions[(*p_index)++],
+			   sizeof(GpuTaskSchedSession));
+		if (gs_sess->pid != 0 &&
+			gs_sess->cuda_dindex >= 0 &&
+			gs_sess->cuda_dindex < numDevAttrs)
+			break;
+	}
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = Int32GetDatum(gs_sess->pid);
+	values[1] = Int32GetDatum(devAttrs[gs_sess->cuda_dindex].DEV_ID);
+	values[2] = Int32GetDatum(gs_sess->weight);
+	values[3] = Int32GetDatum(gs_sess->fair_share);
+	values[4] = Int32GetDatum(gts_sched_devices[gs_sess->cuda_dindex].nr_sessions);
+	values[5] = Int64GetDatum(gs_sess->num_tasks);
+	values[6] = Float8GetDatum((double)gs_sess->wait_usec / 1000.0);
+	values[7] = Float8GetDatum((double)gs_sess->wait_max_usec / 1000.0);
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+
+/*
+ * pgstrom_gpu_cost_calibration - SRF of the pgstrom.gpu_cost_calibration view
+ */
+#define GPU_COST_CALIBRATION_NATTS	10
+Datum
+pgstrom_gpu_cost_calibration(PG_FUNCTION_ARGS)
+{
+	FuncCallContext *fncxt;
+	GpuCostCalibDevice temp;
+	Datum		values[GPU_COST_CALIBRATION_NATTS];
+	bool		isnull[GPU_COST_CALIBRATION_NATTS];
+	HeapTuple	tuple;
+	double		msec_per_chunk;
+	double		msec_per_row;
+	int			dindex;
+
+	if (SRF_IS_FIRSTCALL())
+	{
+		TupleDesc	tupdesc;
+		MemoryContext oldcxt;
+
+		fncxt = SRF_FIRSTCALL_INIT();
+		oldcxt = MemoryContextSwitchTo(fncxt->multi_call_memory_ctx);
+		tupdesc = CreateTemplateTupleDesc(GPU_COST_CALIBRATION_NATTS);
+		TupleDescInitEntry(tupdesc, 1, "gpu_id",
+						   INT4OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 2, "setup_samples",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 3, "setup_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 4, "exec_samples",
+						   INT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 5, "chunk_ms",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 6, "row_us",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 7, "setup_cost",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 8, "dma_cost",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 9, "operator_cost",
+						   FLOAT8OID, -1, 0);
+		TupleDescInitEntry(tupdesc, 10, "parallel_saturation",
+						   INT4OID, -1, 0);
+		fncxt->tuple_desc = BlessTupleDesc(tupdesc);
+		MemoryContextSwitchTo(oldcxt);
+	}
+	fncxt = SRF_PERCALL_SETUP();
+	dindex = fncxt->call_cntr;
+	if (!gpu_cost_calib || dindex >= numDevAttrs)
+		SRF_RETURN_DONE(fncxt);
+
+	SpinLockAcquire(&gpu_cost_calib[dindex].lock);
+	memcpy(&temp, &gpu_cost_calib[dindex], sizeof(GpuCostCalibDevice));
+	SpinLockRelease(&gpu_cost_calib[dindex].lock);
+
+	memset(isnull, 0, sizeof(isnull));
+	values[0] = Int32GetDatum(devAttrs[dindex].DEV_ID);
+	values[1] = Int64GetDatum(temp.setup_nsamples);
+	if (temp.setup_nsamples > 0)
+		values[2] = Float8GetDatum(temp.setup_msec);
+	else
+		isnull[2] = true;
+	values[3] = Int64GetDatum(temp.exec_nsamples);
+	if (!gpuCostCalibSolve(&temp, &msec_per_chunk, &msec_per_row))
+	{
+		msec_per_chunk = -1.0;
+		isnull[5] = true;
+	}
+	else
+		values[5] = Float8GetDatum(1000.0 * msec_per_row);
+	if (msec_per_chunk >= 0.0)
+		values[4] = Float8GetDatum(msec_per_chunk);
+	else
+		isnull[4] = true;
+	/* calibrated cost factors */
+	if (pgstrom_gpu_cost_per_msec > 0.0 &&
+		temp.setup_nsamples >= GPU_COST_CALIB_MIN_SAMPLES)
+		values[6] = Float8GetDatum(pgstrom_gpu_cost_per_msec *
+								   temp.setup_msec);
+	else
+		isnull[6] = true;
+	if (pgstrom_gpu_cost_per_msec > 0.0 && !isnull[4])
+		values[7] = Float8GetDatum(pgstrom_gpu_cost_per_msec *
+								   msec_per_chunk);
+	else
+		isnull[7] = true;
+	if (pgstrom_gpu_cost_per_msec > 0.0 && !isnull[5])
+		values[8] = Float8GetDatum(pgstrom_gpu_cost_per_msec *
+								   msec_per_row);
+	else
+		isnull[8] = true;
+	/* saturation point of the device */
+	values[9] = Int32GetDatum(__gpuDeviceSaturationPoint(&temp));
+	if (DatumGetInt32(values[9]) <= 0)
+		isnull[9] = true;
+	tuple = heap_form_tuple(fncxt->tuple_desc, values, isnull);
+	SRF_RETURN_NEXT(fncxt, HeapTupleGetDatum(tuple));
+}
+
+/*
+ * pgstrom_gpu_cost_calibration_reset - discard the samples of calibration
+ */
+Datum
+pgstrom_gpu_cost_calibration_reset(PG_FUNCTION_ARGS)
+{
+	int			i;
+
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to reset the GPU cost calibration")));
+	for (i=0; gpu_cost_calib && i < numDevAttrs; i++)
+	{
+		GpuCostCalibDevice *calib = &gpu_cost_calib[i];
+
+		SpinLockAcquire(&calib->lock);
+		memset(&calib->setup_nsamples, 0,
+			   sizeof(GpuCostCalibDevice) -
+			   offsetof(GpuCostCalibDevice, setup_nsamples));
+		SpinLockRelease(&calib->lock);
+	}
+	PG_RETURN_VOID();
+}
+
+/*
+ * pgstrom_startup_gputasks
+ */
+static void
+pgstrom_startup_gputasks(void)
+{
+	size_t		required;
+	bool		found;
+	int			i;
+
+	if (shmem_startup_next)
+		(*shmem_startup_next)();
+
+	required = STROMALIGN(sizeof(GpuTaskSchedDevice) * numDevAttrs);
+	gts_sched_devices = ShmemInitStruct("GPU Task Scheduler Devices",
+										required, &found);
+	if (found)
+		elog(ERROR, "Bug? GPU Task Scheduler Devices exists");
+	memset(gts_sched_devices, 0, required);
+	for (i=0; i < numDevAttrs; i++)
+		SpinLockInit(&gts_sched_devices[i].lock);
+
+	required = STROMALIGN(sizeof(GpuTaskSchedSession) * gts_sched_nsessions);
+	gts_sched_sessions = ShmemInitStruct("GPU Task Scheduler Sessions",
+										 required, &found);
+	if (found)
+		elog(ERROR, "Bug? GPU Task Scheduler Sessions exists");
+	memset(gts_sched_sessions, 0, required);
+
+	required = STROMALIGN(sizeof(GpuCostCalibDevice) * numDevAttrs);
+	gpu_cost_calib = ShmemInitStruct("GPU Cost Model Calibration",
+									 required, &found);
+	if (found)
+		elog(ERROR, "Bug? GPU Cost Model Calibration exists");
+	memset(gpu_cost_calib, 0, required);
+	for (i=0; i < numDevAttrs; i++)
+		SpinLockInit(&gpu_cost_calib[i].lock);
 }
 
 /*
@@ -846,5 +2350,89 @@ pgstromInitGpuTask(GpuTaskState *gts, GpuTask *gtask)
 void
 pgstrom_init_gputasks(void)
 {
-	/* nothing to do */
+	/* pg_strom.cpu_hybrid_execution */
+	DefineCustomBoolVariable("pg_strom.cpu_hybrid_execution",
+							 "Enables CPU to scan chunks when GPU is saturated",
+							 NULL,
+							 &enable_cpu_hybrid_execution,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.adaptive_chunk_size */
+	DefineCustomBoolVariable("pg_strom.adaptive_chunk_size",
+							 "Enables adaptive chunk size of the heap-scan",
+							 NULL,
+							 &enable_adaptive_chunk_size,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpu_task_priority */
+	DefineCustomIntVariable("pg_strom.gpu_task_priority",
+							"Weight of the session on the GPU task scheduler",
+							"usually configured per role by ALTER ROLE ... SET",
+							&pgstrom_gpu_task_priority,
+							100,
+							1,
+							10000,
+							PGC_SUSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	/* pg_strom.gpu_scheduler_slots */
+	DefineCustomIntVariable("pg_strom.gpu_scheduler_slots",
+							"Number of concurrent GPU tasks per device shared by the sessions",
+							"0 disables the fair share scheduling",
+							&pgstrom_gpu_scheduler_slots,
+							0,
+							0,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+
+	/* pg_strom.gpu_cost_per_msec */
+	DefineCustomRealVariable("pg_strom.gpu_cost_per_msec",
+							 "Cost per millisecond of GPU time to apply the calibrated GPU cost model",
+							 "0 disables the calibration; pg_strom.gpu_setup_cost, pg_strom.gpu_dma_cost and pg_strom.gpu_operator_cost are used as is",
+							 &pgstrom_gpu_cost_per_msec,
+							 0.0,
+							 0.0,
+							 DBL_MAX,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/* pg_strom.gpu_parallel_saturation */
+	DefineCustomBoolVariable("pg_strom.gpu_parallel_saturation",
+							 "Adjusts number of parallel workers by the saturation point of GPU devices",
+							 NULL,
+							 &pgstrom_gpu_parallel_saturation,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/*
+	 * Shared memory for the GPU task scheduler; the session slot is indexed
+	 * by pgprocno of the backends and background workers. (MaxBackends is
+	 * not initialized yet at this point.)
+	 */
+	gts_sched_nsessions = (MaxConnections +
+						   autovacuum_max_workers + 1 +
+						   max_worker_processes +
+						   max_wal_senders);
+	RequestAddinShmemSpace(STROMALIGN(sizeof(GpuTaskSchedDevice) * numDevAttrs) +
+						   STROMALIGN(sizeof(GpuTaskSchedSession) * gts_sched_nsessions) +
+						   STROMALIGN(sizeof(GpuCostCalibDevice) * numDevAttrs));
+	shmem_startup_next = shmem_startup_hook;
+	shmem_startup_hook = pgstrom_startup_gputasks;
+
+	gts_sched_local_weight = calloc(Max(numDevAttrs, 1), sizeof(cl_ulong));
+	if (!gts_sched_local_weight)
+		elog(ERROR, "out of memory");
+	RegisterXactCallback(gpuTaskSchedXactCallback, NULL);
+	before_shmem_exit(gpuTaskSchedOnExit, 0);
+
+	dlist_init(&gpu_task_fanout_list);
 }
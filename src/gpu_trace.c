@@ -0,0 +1,670 @@
+/*
+ * gpu_trace.c
+ *
+ * Routines to annotate GpuTasks with NVTX ranges, and to collect the GPU
+ * activities using CUPTI for the per-query trace files.
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include "pg_strom.h"
+#include <dlfcn.h>
+#include <sys/syscall.h>
+
+/*
+ * libnvToolsExt and libcupti are opened on demand, so PG-Strom has no
+ * runtime dependency on them unless the GUC options below are turned on.
+ *
+ * The declarations below are compatible to cupti_activity.h, so the CUPTI
+ * headers are not needed at the build time either. Only the leading fields
+ * of the activity records we reference are declared; CUPTI never changes
+ * their position across the versions of the records.
+ */
+#define CUPTIAPI
+
+typedef enum
+{
+	CUPTI_SUCCESS = 0,
+} CUptiResult;
+
+typedef enum
+{
+	CUPTI_ACTIVITY_KIND_MEMCPY = 1,
+	CUPTI_ACTIVITY_KIND_KERNEL = 3,
+	CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL = 10,
+} CUpti_ActivityKind;
+
+#define CUPTI_ACTIVITY_FLAG_FLUSH_FORCED	(1U << 0)
+
+#define CUPTI_ACTIVITY_MEMCPY_KIND_HTOD		1
+#define CUPTI_ACTIVITY_MEMCPY_KIND_DTOH		2
+#define CUPTI_ACTIVITY_MEMCPY_KIND_DTOD		8
+#define CUPTI_ACTIVITY_MEMCPY_KIND_PTOP		10
+
+typedef struct __attribute__((packed, aligned(8)))
+{
+	CUpti_ActivityKind kind;
+} CUpti_Activity;
+
+typedef struct __attribute__((packed, aligned(8)))
+{
+	CUpti_ActivityKind kind;
+	uint8_t		copyKind;
+	uint8_t		srcKind;
+	uint8_t		dstKind;
+	uint8_t		flags;
+	uint64_t	bytes;
+	uint64_t	start;
+	uint64_t	end;
+	uint32_t	deviceId;
+	uint32_t	contextId;
+	uint32_t	streamId;
+	uint32_t	correlationId;
+} CUpti_ActivityMemcpy;
+
+typedef struct __attribute__((packed, aligned(8)))
+{
+	CUpti_ActivityKind kind;
+	uint8_t		cacheConfig;
+	uint8_t		sharedMemoryConfig;
+	uint16_t	registersPerThread;
+	int32_t		partitionedGlobalCacheRequested;
+	int32_t		partitionedGlobalCacheExecuted;
+	uint64_t	start;
+	uint64_t	end;
+	uint64_t	completed;
+	uint32_t	deviceId;
+	uint32_t	contextId;
+	uint32_t	streamId;
+	int32_t		gridX;
+	int32_t		gridY;
+	int32_t		gridZ;
+	int32_t		blockX;
+	int32_t		blockY;
+	int32_t		blockZ;
+	int32_t		staticSharedMemory;
+	int32_t		dynamicSharedMemory;
+	uint32_t	localMemoryPerThread;
+	uint32_t	localMemoryTotal;
+	uint32_t	correlationId;
+	int64_t		gridId;
+	const char *name;
+} CUpti_ActivityKernel4;
+
+typedef void (CUPTIAPI *CUpti_BuffersCallbackRequestFunc)(
+	uint8_t **buffer,
+	size_t *size,
+	size_t *maxNumRecords);
+typedef void (CUPTIAPI *CUpti_BuffersCallbackCompleteFunc)(
+	CUcontext context,
+	uint32_t streamId,
+	uint8_t *buffer,
+	size_t size,
+	size_t validSize);
+
+static bool		pgstrom_nvtx_annotation;		/* GUC */
+static char	   *pgstrom_gpu_trace_directory;	/* GUC */
+static ExecutorEnd_hook_type executor_end_next = NULL;
+
+static int		(*p_nvtxRangePushA)(const char *message) = NULL;
+static int		(*p_nvtxRangePop)(void) = NULL;
+static bool		nvtx_load_failed = false;
+
+static CUptiResult (*p_cuptiActivityEnable)(CUpti_ActivityKind kind) = NULL;
+static CUptiResult (*p_cuptiActivityDisable)(CUpti_ActivityKind kind) = NULL;
+static CUptiResult (*p_cuptiActivityRegisterCallbacks)(
+	CUpti_BuffersCallbackRequestFunc funcBufferRequested,
+	CUpti_BuffersCallbackCompleteFunc funcBufferCompleted) = NULL;
+static CUptiResult (*p_cuptiActivityGetNextRecord)(
+	uint8_t *buffer,
+	size_t validBufferSizeBytes,
+	CUpti_Activity **record) = NULL;
+static CUptiResult (*p_cuptiActivityFlushAll)(uint32_t flag) = NULL;
+static CUptiResult (*p_cuptiGetTimestamp)(uint64_t *timestamp) = NULL;
+static CUptiResult (*p_cuptiGetResultString)(CUptiResult result,
+											 const char **str) = NULL;
+static bool		cupti_load_failed = false;
+static bool		cupti_activity_enabled = false;
+
+/*
+ * gpu_trace_item - an activity to be written to the trace file
+ *
+ * It is appended by the CUPTI callback or GpuContext worker threads, thus
+ * neither palloc nor elog are available; protected by gpu_trace_mutex.
+ */
+#define GPU_TRACE__HOST_TASK		1
+#define GPU_TRACE__KERNEL			2
+#define GPU_TRACE__MEMCPY			3
+#define GPU_TRACE_MAX_NITEMS		(1UL << 20)
+#define GPU_TRACE_BUFFER_SIZE		(1UL << 20)
+
+typedef struct
+{
+	cl_int		kind;			/* one of GPU_TRACE__* */
+	cl_uint		device_id;		/* unused, if HOST_TASK */
+	cl_uint		stream_id;		/* thread-id, if HOST_TASK */
+	cl_uint		correlation_id;	/* chunk-id, if HOST_TASK */
+	cl_ulong	ts_start;		/* [ns] */
+	cl_ulong	ts_end;			/* [ns] */
+	cl_ulong	nbytes;			/* MEMCPY only */
+	cl_int		copy_kind;		/* MEMCPY only */
+	char	   *label;			/* malloc'ed, if any */
+} gpu_trace_item;
+
+static pthread_mutex_t	gpu_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static gpu_trace_item  *gpu_trace_items = NULL;
+static size_t			gpu_trace_nitems = 0;
+static size_t			gpu_trace_nrooms = 0;
+static size_t			gpu_trace_ndropped = 0;
+static bool				gpu_trace_pending = false;	/* backend only */
+static cl_uint			gpu_trace_seqno = 0;		/* backend only */
+
+/*
+ * gpuTraceAppendItem - must be called under gpu_trace_mutex
+ */
+static void
+gpuTraceAppendItem(gpu_trace_item *item)
+{
+	if (gpu_trace_nitems >= gpu_trace_nrooms)
+	{
+		gpu_trace_item *items_new;
+		size_t		nrooms_new = Max(2 * gpu_trace_nrooms, 4096);
+
+		if (nrooms_new > GPU_TRACE_MAX_NITEMS ||
+			!(items_new = realloc(gpu_trace_items,
+								  sizeof(gpu_trace_item) * nrooms_new)))
+		{
+			if (item->label)
+				free(item->label);
+			gpu_trace_ndropped++;
+			return;
+		}
+		gpu_trace_items = items_new;
+		gpu_trace_nrooms = nrooms_new;
+	}
+	memcpy(&gpu_trace_items[gpu_trace_nitems++], item, sizeof(gpu_trace_item));
+}
+
+/*
+ * CUPTI callbacks; they may be invoked by the CUPTI's internal thread
+ */
+static void CUPTIAPI
+gpuTraceBufferRequested(uint8_t **p_buffer, size_t *p_length,
+						size_t *p_max_nrecords)
+{
+	void	   *buffer = NULL;
+
+	if (posix_memalign(&buffer, 8, GPU_TRACE_BUFFER_SIZE) != 0)
+		buffer = NULL;
+	*p_buffer = buffer;
+	*p_length = (buffer ? GPU_TRACE_BUFFER_SIZE : 0);
+	*p_max_nrecords = 0;
+}
+
+static void CUPTIAPI
+gpuTraceBufferCompleted(CUcontext context, uint32_t stream_id,
+						uint8_t *buffer, size_t length, size_t valid_length)
+{
+	CUpti_Activity *record = NULL;
+
+	pthread_mutex_lock(&gpu_trace_mutex);
+	while (p_cuptiActivityGetNextRecord(buffer, valid_length,
+										&record) == CUPTI_SUCCESS)
+	{
+		gpu_trace_item item;
+
+		memset(&item, 0, sizeof(gpu_trace_item));
+		/*
+		 * NOTE: Newer CUPTI returns the later versions of the kernel and
+		 * memcpy records, however, they keep the fields below in the same
+		 * position, so the oldest layout is sufficient for our purpose.
+		 */
+		if (record->kind == CUPTI_ACTIVITY_KIND_KERNEL ||
+			record->kind == CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL)
+		{
+			CUpti_ActivityKernel4 *kern = (CUpti_ActivityKernel4 *) record;
+
+			item.kind = GPU_TRACE__KERNEL;
+			item.device_id = kern->deviceId;
+			item.stream_id = kern->streamId;
+			item.correlation_id = kern->correlationId;
+			item.ts_start = kern->start;
+			item.ts_end = kern->end;
+			item.label = (kern->name ? strdup(kern->name) : NULL);
+		}
+		else if (record->kind == CUPTI_ACTIVITY_KIND_MEMCPY)
+		{
+			CUpti_ActivityMemcpy *mcpy = (CUpti_ActivityMemcpy *) record;
+
+			item.kind = GPU_TRACE__MEMCPY;
+			item.device_id = mcpy->deviceId;
+			item.stream_id = mcpy->streamId;
+			item.correlation_id = mcpy->correlationId;
+			item.ts_start = mcpy->start;
+			item.ts_end = mcpy->end;
+			item.nbytes = mcpy->bytes;
+			item.copy_kind = mcpy->copyKind;
+		}
+		else
+			continue;
+		gpuTraceAppendItem(&item);
+	}
+	pthread_mutex_unlock(&gpu_trace_mutex);
+	free(buffer);
+}
+
+/*
+ * lookup_gpu_trace_function
+ *
+ * NOTE: tracing is a diagnostic feature, so failures to load the libraries
+ * are reported as WARNING, and the feature is disabled in this session.
+ */
+static void *
+lookup_gpu_trace_function(void *handle, const char *func_name)
+{
+	void   *func_addr = dlsym(handle, func_name);
+
+	if (!func_addr)
+		elog(WARNING, "could not find symbol \"%s\" - %s",
+			 func_name, dlerror());
+	return func_addr;
+}
+
+#define LOOKUP_GPU_TRACE_FUNCTION(func_name)							\
+	(p_##func_name = lookup_gpu_trace_function(handle, #func_name)) != NULL
+
+/*
+ * gpuTraceLoadNvtx
+ */
+static bool
+gpuTraceLoadNvtx(void)
+{
+	void	   *handle;
+
+	if (p_nvtxRangePushA)
+		return true;
+	if (nvtx_load_failed)
+		return false;
+
+	handle = dlopen("libnvToolsExt.so.1", RTLD_NOW | RTLD_LOCAL);
+	if (!handle)
+		handle = dlopen("libnvToolsExt.so", RTLD_NOW | RTLD_LOCAL);
+	if (!handle)
+	{
+		elog(WARNING, "failed on open 'libnvToolsExt.so.1' and 'libnvToolsExt.so': %s",
+			 dlerror());
+		nvtx_load_failed = true;
+		return false;
+	}
+	if (!LOOKUP_GPU_TRACE_FUNCTION(nvtxRangePop) ||
+		!LOOKUP_GPU_TRACE_FUNCTION(nvtxRangePushA))
+	{
+		p_nvtxRangePushA = NULL;
+		nvtx_load_failed = true;
+		return false;
+	}
+	return true;
+}
+
+/*
+ * gpuTraceLoadCupti
+ */
+static bool
+gpuTraceLoadCupti(void)
+{
+	CUresult	rc;
+	CUptiResult	rv;
+	const char *errmsg = "???";
+	int			cuda_version;
+	char		namebuf[MAXPGPATH];
+	void	   *handle;
+
+	if (cupti_activity_enabled)
+		return true;
+	if (cupti_load_failed)
+		return false;
+	if (!p_cuptiActivityEnable)
+	{
+		rc = cuDriverGetVersion(&cuda_version);
+		if (rc != CUDA_SUCCESS)
+		{
+			elog(WARNING, "failed on cuDriverGetVersion: %s", errorText(rc));
+			goto failed;
+		}
+		snprintf(namebuf, sizeof(namebuf),
+				 "libcupti.so.%d.%d",
+				 (cuda_version / 1000),
+				 (cuda_version % 1000) / 10);
+		handle = dlopen(namebuf, RTLD_NOW | RTLD_LOCAL);
+		if (!handle)
+			handle = dlopen("libcupti.so", RTLD_NOW | RTLD_LOCAL);
+		if (!handle)
+		{
+			elog(WARNING, "failed on open '%s' and 'libcupti.so': %s",
+				 namebuf, dlerror());
+			goto failed;
+		}
+		if (!LOOKUP_GPU_TRACE_FUNCTION(cuptiActivityDisable) ||
+			!LOOKUP_GPU_TRACE_FUNCTION(cuptiActivityRegisterCallbacks) ||
+			!LOOKUP_GPU_TRACE_FUNCTION(cuptiActivityGetNextRecord) ||
+			!LOOKUP_GPU_TRACE_FUNCTION(cuptiActivityFlushAll) ||
+			!LOOKUP_GPU_TRACE_FUNCTION(cuptiGetTimestamp) ||
+			!LOOKUP_GPU_TRACE_FUNCTION(cuptiGetResultString))
+			goto failed;
+		rv = p_cuptiActivityRegisterCallbacks(gpuTraceBufferRequested,
+											  gpuTraceBufferCompleted);
+		if (rv != CUPTI_SUCCESS)
+		{
+			p_cuptiGetResultString(rv, &errmsg);
+			elog(WARNING, "failed on cuptiActivityRegisterCallbacks: %s",
+				 errmsg);
+			goto failed;
+		}
+		if (!LOOKUP_GPU_TRACE_FUNCTION(cuptiActivityEnable))
+			goto failed;
+	}
+	if ((rv = p_cuptiActivityEnable(CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL)) != CUPTI_SUCCESS ||
+		(rv = p_cuptiActivityEnable(CUPTI_ACTIVITY_KIND_MEMCPY)) != CUPTI_SUCCESS)
+	{
+		p_cuptiGetResultString(rv, &errmsg);
+		elog(WARNING, "failed on cuptiActivityEnable: %s", errmsg);
+		goto failed;
+	}
+	cupti_activity_enabled = true;
+	return true;
+
+failed:
+	cupti_load_failed = true;
+	return false;
+}
+
+/*
+ * pgstromGpuTraceFlags
+ *
+ * It returns GPUTASK_TRACE__* flags for the GpuTaskState being initialized,
+ * according to the GUC options. The worker threads consult only the flags
+ * of GTS, because libraries must be loaded by the backend.
+ */
+cl_uint
+pgstromGpuTraceFlags(void)
+{
+	cl_uint		trace_flags = 0;
+
+	if (pgstrom_nvtx_annotation && gpuTraceLoadNvtx())
+		trace_flags |= GPUTASK_TRACE__NVTX;
+	if (pgstrom_gpu_trace_directory &&
+		*pgstrom_gpu_trace_directory != '\0' &&
+		gpuTraceLoadCupti())
+	{
+		trace_flags |= GPUTASK_TRACE__CUPTI;
+		gpu_trace_pending = true;
+	}
+	return trace_flags;
+}
+
+/*
+ * gpuTraceTaskBegin / gpuTraceTaskEnd - called by the worker threads
+ */
+void
+gpuTraceTaskBegin(GpuTask *gtask, cl_ulong *p_ts_start)
+{
+	GpuTaskState   *gts = gtask->gts;
+
+	if ((gts->trace_flags & GPUTASK_TRACE__NVTX) != 0)
+	{
+		char		label[NAMEDATALEN + 40];
+
+		snprintf(label, sizeof(label), "%s chunk=%u",
+				 gts->trace_label, gtask->chunk_id);
+		p_nvtxRangePushA(label);
+	}
+	*p_ts_start = 0;
+	if ((gts->trace_flags & GPUTASK_TRACE__CUPTI) != 0)
+		p_cuptiGetTimestamp((uint64_t *)p_ts_start);
+}
+
+void
+gpuTraceTaskEnd(GpuTask *gtask, cl_ulong ts_start)
+{
+	GpuTaskState   *gts = gtask->gts;
+
+	if ((gts->trace_flags & GPUTASK_TRACE__NVTX) != 0)
+		p_nvtxRangePop();
+	if ((gts->trace_flags & GPUTASK_TRACE__CUPTI) != 0 && ts_start != 0)
+	{
+		gpu_trace_item item;
+		char		label[NAMEDATALEN + 40];
+
+		memset(&item, 0, sizeof(gpu_trace_item));
+		item.kind = GPU_TRACE__HOST_TASK;
+		item.stream_id = (cl_uint) syscall(SYS_gettid);
+		item.correlation_id = gtask->chunk_id;
+		item.ts_start = ts_start;
+		p_cuptiGetTimestamp((uint64_t *)&item.ts_end);
+		snprintf(label, sizeof(label), "%s chunk=%u",
+				 gts->trace_label, gtask->chunk_id);
+		item.label = strdup(label);
+
+		pthread_mutex_lock(&gpu_trace_mutex);
+		gpuTraceAppendItem(&item);
+		pthread_mutex_unlock(&gpu_trace_mutex);
+	}
+}
+
+/*
+ * gpuTraceRangePush / gpuTraceRangePop - for the backend context
+ */
+bool
+gpuTraceRangePush(const char *fmt, ...)
+{
+	char		label[256];
+	va_list		ap;
+
+	if (!pgstrom_nvtx_annotation || !gpuTraceLoadNvtx())
+		return false;
+	va_start(ap, fmt);
+	vsnprintf(label, sizeof(label), fmt, ap);
+	va_end(ap);
+	p_nvtxRangePushA(label);
+
+	return true;
+}
+
+void
+gpuTraceRangePop(void)
+{
+	Assert(p_nvtxRangePushA != NULL);
+	p_nvtxRangePop();
+}
+
+/*
+ * gpuTraceCopyKindName
+ */
+static const char *
+gpuTraceCopyKindName(int copy_kind)
+{
+	switch (copy_kind)
+	{
+		case CUPTI_ACTIVITY_MEMCPY_KIND_HTOD:
+			return "memcpy HtoD";
+		case CUPTI_ACTIVITY_MEMCPY_KIND_DTOH:
+			return "memcpy DtoH";
+		case CUPTI_ACTIVITY_MEMCPY_KIND_DTOD:
+			return "memcpy DtoD";
+		case CUPTI_ACTIVITY_MEMCPY_KIND_PTOP:
+			return "memcpy PtoP";
+		default:
+			return "memcpy";
+	}
+}
+
+/*
+ * gpuTraceWriteOut
+ *
+ * It writes out the activities collected during the query execution, in
+ * the Chrome trace event format; chrome://tracing or Perfetto UI can open
+ * them. GPU devices are shown as processes, and CUDA streams as threads.
+ */
+static void
+gpuTraceWriteOut(QueryDesc *queryDesc)
+{
+	gpu_trace_item *items;
+	size_t		nitems;
+	size_t		ndropped;
+	uint64		query_id = 0;
+	Bitmapset  *devices = NULL;
+	StringInfoData buf;
+	char		path[MAXPGPATH];
+	FILE	   *filp;
+	size_t		i;
+	int			k;
+
+	gpu_trace_pending = false;
+	if (p_cuptiActivityFlushAll(CUPTI_ACTIVITY_FLAG_FLUSH_FORCED) != CUPTI_SUCCESS)
+		elog(LOG, "failed on cuptiActivityFlushAll");
+	/* detach the activities collected */
+	pthread_mutex_lock(&gpu_trace_mutex);
+	items = gpu_trace_items;
+	nitems = gpu_trace_nitems;
+	ndropped = gpu_trace_ndropped;
+	gpu_trace_items = NULL;
+	gpu_trace_nitems = 0;
+	gpu_trace_nrooms = 0;
+	gpu_trace_ndropped = 0;
+	pthread_mutex_unlock(&gpu_trace_mutex);
+
+	if (queryDesc->plannedstmt)
+		query_id = queryDesc->plannedstmt->queryId;
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "{\"traceEvents\":[\n"
+					 "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+					 "\"args\":{\"name\":\"PostgreSQL backend %d\"}}",
+					 MyProcPid, MyProcPid);
+	for (i=0; i < nitems; i++)
+	{
+		gpu_trace_item *item = &items[i];
+
+		appendStringInfoString(&buf, ",\n{\"name\":");
+		if (item->kind == GPU_TRACE__MEMCPY)
+			escape_json(&buf, gpuTraceCopyKindName(item->copy_kind));
+		else
+			escape_json(&buf, item->label ? item->label : "???");
+		appendStringInfo(&buf, ",\"cat\":\"%s\",\"ph\":\"X\","
+						 "\"ts\":%.3f,\"dur\":%.3f,",
+						 (item->kind == GPU_TRACE__HOST_TASK ? "task" :
+						  item->kind == GPU_TRACE__KERNEL ? "kernel" :
+						  "memcpy"),
+						 (double)item->ts_start / 1000.0,
+						 (double)(item->ts_end - item->ts_start) / 1000.0);
+		if (item->kind == GPU_TRACE__HOST_TASK)
+			appendStringInfo(&buf, "\"pid\":%d,\"tid\":%u,"
+							 "\"args\":{\"chunk\":%u}}",
+							 MyProcPid,
+							 item->stream_id,
+							 item->correlation_id);
+		else
+		{
+			/* GPU devices are shown as negative pid */
+			appendStringInfo(&buf, "\"pid\":%d,\"tid\":%u,"
+							 "\"args\":{\"correlation\":%u",
+							 -((int)item->device_id + 1),
+							 item->stream_id,
+							 item->correlation_id);
+			if (item->kind == GPU_TRACE__MEMCPY)
+				appendStringInfo(&buf, ",\"bytes\":%lu", item->nbytes);
+			appendStringInfoString(&buf, "}}");
+			devices = bms_add_member(devices, item->device_id);
+		}
+	}
+	k = -1;
+	while ((k = bms_next_member(devices, k)) >= 0)
+		appendStringInfo(&buf, ",\n{\"name\":\"process_name\",\"ph\":\"M\","
+						 "\"pid\":%d,\"args\":{\"name\":\"GPU%d\"}}",
+						 -(k + 1), k);
+	appendStringInfo(&buf, "\n],\n\"displayTimeUnit\":\"ms\",\n"
+					 "\"otherData\":{\"pid\":%d,\"query_id\":\"%lu\","
+					 "\"dropped\":%zu,\"query\":",
+					 MyProcPid, (unsigned long)query_id, ndropped);
+	escape_json(&buf, queryDesc->sourceText ? queryDesc->sourceText : "");
+	appendStringInfoString(&buf, "}}\n");
+
+snprintf(path, sizeof(path), "%s/pg_strom_trace.%d.%u.json",
+			 pgstrom_gpu_trace_directory, MyProcPid, gpu_trace_seqno++);
+	/* trace file is diagnostic; its failure never aborts the query */
+	filp = AllocateFile(path, PG_BINARY_W);
+	if (!filp)
+		elog(WARNING, "could not open file \"%s\": %m", path);
+	else
+	{
+		if (fwrite(buf.data, buf.len, 1, filp) != 1)
+			elog(WARNING, "could not write file \"%s\": %m", path);
+		FreeFile(filp);
+	}
+	pfree(buf.data);
+
+	for (i=0; i < nitems; i++)
+	{
+		if (items[i].label)
+			free(items[i].label);
+	}
+	free(items);
+}
+
+/*
+ * gpuTraceExecutorEnd
+ */
+static void
+gpuTraceExecutorEnd(QueryDesc *queryDesc)
+{
+	if (executor_end_next)
+		executor_end_next(queryDesc);
+	else
+		standard_ExecutorEnd(queryDesc);
+
+	if (gpu_trace_pending)
+	{
+		if (pgstrom_gpu_trace_directory &&
+			*pgstrom_gpu_trace_directory != '\0')
+			gpuTraceWriteOut(queryDesc);
+		gpu_trace_pending = false;
+	}
+	/* stop the collector once the GUC gets disabled */
+	if (cupti_activity_enabled &&
+		(!pgstrom_gpu_trace_directory ||
+		 *pgstrom_gpu_trace_directory == '\0'))
+	{
+		p_cuptiActivityDisable(CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL);
+		p_cuptiActivityDisable(CUPTI_ACTIVITY_KIND_MEMCPY);
+		cupti_activity_enabled = false;
+	}
+}
+
+/*
+ * pgstrom_init_gpu_trace
+ */
+void
+pgstrom_init_gpu_trace(void)
+{
+	DefineCustomBoolVariable("pg_strom.nvtx_annotation",
+							 "Annotates GpuTasks with NVTX ranges",
+							 NULL,
+							 &pgstrom_nvtx_annotation,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	DefineCustomStringVariable("pg_strom.gpu_trace_directory",
+							   "Directory to write out the per-query GPU trace files",
+							   NULL,
+							   &pgstrom_gpu_trace_directory,
+							   "",
+							   PGC_SUSET,
+							   GUC_NOT_IN_SAMPLE,
+							   NULL, NULL, NULL);
+	executor_end_next = ExecutorEnd_hook;
+	ExecutorEnd_hook = gpuTraceExecutorEnd;
+}
@@ -13,6 +13,7 @@
 #include "pg_strom.h"
 #include "cuda_gpuscan.h"
 #include "cuda_gpujoin.h"
+#include "cuda_postgis.h"
 
 /*
  * GpuJoinPath
@@ -32,6 +33,7 @@ typedef struct
 	Cost			inner_cost;		/* cost to setup inner heap/hash */
 	bool			inner_parallel;	/* inner relations support parallel? */
 	cl_int		   *sibling_param_id; /* only if partition-wise join child */
+	cl_int			inner_nparts;	/* # of partitions of the depth-1 hash */
 	struct {
 		JoinType	join_type;		/* one of JOIN_* */
 		double		join_nrows;		/* intermediate nrows in this depth */
@@ -43,6 +45,11 @@ typedef struct
 		AttrNumber	gist_ctid_resno;/* CTID resno on the targetlist */
 		Expr	   *gist_clause;	/* GiST index clause */
 		Selectivity	gist_selectivity; /* GiST index selectivity */
+		Expr	   *grid_clause;	/* grid-index clause */
+		Expr	   *grid_iarg;		/* outer key of grid-index */
+		Expr	   *grid_idist;		/* distance of grid-index, if any */
+		AttrNumber	grid_resno;		/* inner key resno on the targetlist */
+		Selectivity	grid_selectivity; /* grid-index selectivity */
 		Size		ichunk_size;	/* expected inner chunk size */
 	} inners[FLEXIBLE_ARRAY_MEMBER];
 } GpuJoinPath;
@@ -69,6 +76,10 @@ typedef struct
 	/* inner-scan parameters */
 	cl_bool		inner_parallel;
 	cl_int		sibling_param_id;
+	cl_int		inner_nparts;
+	char	   *inner_cache_key;	/* key of the inner buffer cache, if any */
+	cl_int		outer_range_key;	/* index of hash-key to prune outer, or -1 */
+	cl_int		outer_range_param;	/* PARAM_EXEC of the key range (min,max) */
 	/* BRIN-index support */
 	Oid			index_oid;			/* OID of BRIN-index, if any */
 	List	   *index_conds;		/* BRIN-index key conditions */
@@ -96,6 +107,8 @@ typedef struct
 	AttrNumber	gist_index_column;		/* if GiST-index */
 	AttrNumber	gist_index_ctid_resno;	/* if GiST-index */
 	Expr	   *gist_index_clause;		/* if GiST-index */
+	AttrNumber	grid_index_resno;		/* if grid-index */
+	Expr	   *grid_index_clause;		/* if grid-index */
 } GpuJoinInnerInfo;
 
 static inline void
@@ -122,6 +135,11 @@ form_gpujoin_info(CustomScan *cscan, GpuJoinInfo *gj_info)
 	privs = lappend(privs, makeInteger(gj_info->outer_nrows_per_block));
 	privs = lappend(privs, makeInteger(gj_info->inner_parallel));
 	privs = lappend(privs, makeInteger(gj_info->sibling_param_id));
+	privs = lappend(privs, makeInteger(gj_info->inner_nparts));
+	privs = lappend(privs, makeString(pstrdup(gj_info->inner_cache_key ?
+											  gj_info->inner_cache_key : "")));
+	privs = lappend(privs, makeInteger(gj_info->outer_range_key));
+	privs = lappend(privs, makeInteger(gj_info->outer_range_param));
 	privs = lappend(privs, makeInteger(gj_info->index_oid));
 	privs = lappend(privs, gj_info->index_conds);
 	exprs = lappend(exprs, gj_info->index_quals);
@@ -145,6 +163,8 @@ form_gpujoin_info(CustomScan *cscan, GpuJoinInfo *gj_info)
 		p_items = lappend(p_items, makeInteger(i_info->gist_index_column));
 		p_items = lappend(p_items, makeInteger(i_info->gist_index_ctid_resno));
 		e_items = lappend(e_items, i_info->gist_index_clause);
+		p_items = lappend(p_items, makeInteger(i_info->grid_index_resno));
+		e_items = lappend(e_items, i_info->grid_index_clause);
 
 		privs = lappend(privs, p_items);
 		exprs = lappend(exprs, e_items);
@@ -185,6 +205,12 @@ deform_gpujoin_info(CustomScan *cscan)
 	gj_info->outer_nrows_per_block = intVal(list_nth(privs, pindex++));
 	gj_info->inner_parallel = intVal(list_nth(privs, pindex++));
 	gj_info->sibling_param_id = intVal(list_nth(privs, pindex++));
+	gj_info->inner_nparts = intVal(list_nth(privs, pindex++));
+	gj_info->inner_cache_key = strVal(list_nth(privs, pindex++));
+	if (gj_info->inner_cache_key[0] == '\0')
+		gj_info->inner_cache_key = NULL;
+	gj_info->outer_range_key = intVal(list_nth(privs, pindex++));
+	gj_info->outer_range_param = intVal(list_nth(privs, pindex++));
 	gj_info->index_oid = intVal(list_nth(privs, pindex++));
 	gj_info->index_conds = list_nth(privs, pindex++);
 	gj_info->index_quals = list_nth(exprs, eindex++);
@@ -208,6 +234,8 @@ deform_gpujoin_info(CustomScan *cscan)
 		i_info->gist_index_column = (AttrNumber)intVal(list_nth(p_items, 5));
 		i_info->gist_index_ctid_resno = (AttrNumber)intVal(list_nth(p_items, 6));
 		i_info->gist_index_clause = list_nth(e_items, 4);
+		i_info->grid_index_resno = (AttrNumber)intVal(list_nth(p_items, 7));
+		i_info->grid_index_clause = list_nth(e_items, 5);
 
 		gj_info->inner_infos = lappend(gj_info->inner_infos, i_info);
 	}
@@ -253,6 +281,8 @@ typedef struct
 	 */
 	List			   *hash_outer_keys;
 	List			   *hash_inner_keys;
+	cl_long				key_range_min;	/* local range of the join-key */
+	cl_long				key_range_max;	/* to prune outer; only depth=1 */
 
 	/*
 	 * Join properties; GiST index
@@ -260,6 +290,12 @@ typedef struct
 	Relation			gist_irel;
 	AttrNumber			gist_ctid_resno;
 
+	/*
+	 * Join properties; grid index
+	 */
+	AttrNumber			grid_resno;
+	bool				grid_is_range;
+
 	/* CPU Fallback related */
 	AttrNumber		   *inner_dst_resno;
 	AttrNumber			inner_src_anum_min;
@@ -279,9 +315,38 @@ typedef struct
 	kern_multirels *h_kmrels;			/* mmap of host shared memory */
 	CUdeviceptr		m_kmrels;			/* local map of preserved memory */
 	bool			m_kmrels_owner;
+	bool			m_kmrels_managed;	/* m_kmrels is managed memory */
 	bool			inner_parallel;
+	cl_int			inner_nparts;		/* # of partitions at depth=1 */
+	cl_int			inner_curr_part;	/* current partition to be joined */
 	MemoryContext	preload_memcxt;		/* memory context for preloading */
 
+	/*
+	 * Inner buffer cache across queries
+	 */
+	uint64			inner_cache_hash;	/* 0, if not cacheable */
+	uint32			inner_cache_len;
+	struct GpuJoinInnerCacheTracker *inner_cache_tracker; /* if pinned */
+	bool			inner_cache_attached;
+	bool			inner_cache_hit;
+	bool			inner_cache_versioned;	/* all the inners on GPU cache */
+	uint64			inner_cache_generation;
+	uint64			inner_cache_write_pos;
+
+	/*
+	 * Asynchronous load of the inner buffer
+	 */
+	CUstream		inner_load_stream;	/* dedicated stream for HtoD copy */
+	CUevent			inner_load_event;	/* completion of the HtoD copy */
+	void		   *inner_load_hostreg;	/* page-locked host buffer, if any */
+
+	/*
+	 * Skip of the outer record-batches out of the inner join-key range
+	 */
+	cl_int			outer_range_key;	/* index of hash-key, or -1 */
+	cl_int			outer_range_param;	/* PARAM_EXEC of the key range */
+	Oid				outer_range_type;	/* data type of the join-key */
+
 	/*
 	 * Expressions to be used in the CPU fallback path
 	 */
@@ -292,6 +357,9 @@ typedef struct
 	List		   *join_quals;
 	/* result width per tuple for buffer length calculation */
 	int				result_width;
+	/* cardinality feedback from the previous executions */
+	uint64			feedback_signature;	/* 0, if no feedback */
+	double			feedback_ratio;		/* results per source row, or -1 */
 
 	/*
 	 * CPU Fallback
@@ -319,6 +387,19 @@ typedef struct
 #define INNER_PHASE__SETUP_BUFFERS		1
 #define INNER_PHASE__GPUJOIN_EXEC		2
 
+/*
+ * needs_colocation counts the number of GPU devices that have the inner
+ * buffer, with the flag below if CPU fallback updated the host side map.
+ */
+#define GPUJOIN_OJMAPS_FALLBACK			0x80000000U
+
+/*
+ * Partition of the inner hash table at depth=1, chosen by the upper bits of
+ * the hash value, not to correlate with the hash-slot (lower bits).
+ */
+#define GPUJOIN_INNER_PARTITION(hash,nparts)						\
+	((cl_int)(((cl_ulong)(hash) * (cl_ulong)(nparts)) >> 32))
+
 struct GpuJoinSharedState
 {
 	dsm_handle		ss_handle;		/* DSM handle of the SharedState */
@@ -333,6 +414,9 @@ struct GpuJoinSharedState
 	pg_atomic_uint32 outer_scan_done;  /* non-zero, if outer is scanned */
 	pg_atomic_uint32 needs_colocation; /* non-zero, if colocation is needed */
 	cl_int			curr_outer_depth;
+	bool			outer_range_valid;	/* true, if inner key range is built */
+	cl_long			outer_range_min;	/* range of the join-key at depth=1 */
+	cl_long			outer_range_max;
 	struct {
 		int			nr_workers_gpujoin;
 		size_t		bytesize;		/* not zero, if allocated */
@@ -353,6 +437,8 @@ struct GpuJoinRuntimeStat
 		pg_atomic_uint64	inner_nitems;
 		pg_atomic_uint64	inner_nitems2;
 		pg_atomic_uint64	right_nitems;
+		pg_atomic_uint64	heavy_nkeys;	/* # of heavy-hitter hash values */
+		pg_atomic_uint64	heavy_nitems;	/* # of inner rows of them */
 	} jstat[FLEXIBLE_ARRAY_MEMBER];
 };
 typedef struct GpuJoinRuntimeStat	GpuJoinRuntimeStat;
@@ -382,6 +468,76 @@ struct GpuJoinSiblingState
 };
 typedef struct GpuJoinSiblingState	GpuJoinSiblingState;
 
+/*
+ * GpuJoinInnerCacheEntry - inner buffer kept across queries
+ *
+ * Once GpuJoin built an inner buffer from the simple relation scans, its
+ * host shared memory and preserved device memory can be reused by the later
+ * queries that have the same inner relations, qualifiers and hash-keys.
+ * It is valid only when the query runs on the identical MVCC snapshot
+ * (xmin, xmax and in-progress xids) with the one used to build the buffer,
+ * because nobody could commit any modification between them.
+ * If all the inner relations are scanned by GpuScan on GPU cache, the buffer
+ * is identified by the contents version of the GPU caches instead; so it is
+ * valid until the inner relations get modified, regardless of the snapshot.
+ */
+#define GPUJOIN_INNER_CACHE_MAX_XIDS	64
+
+typedef struct
+{
+	TransactionId	xmin;
+	TransactionId	xmax;
+	uint32			xcnt;
+	uint32			subxcnt;
+	TransactionId	xids[GPUJOIN_INNER_CACHE_MAX_XIDS]; /* xip and subxip */
+} GpuJoinInnerCacheSnap;
+
+typedef struct
+{
+	bool			in_use;
+	bool			is_valid;		/* false, if no longer available */
+	int				refcnt;			/* number of pinned GpuJoins */
+	uint64			lru_clock;
+	uint64			key_hash;
+	uint32			key_len;
+	Oid				database_oid;
+	GpuJoinInnerCacheSnap snap;		/* snapshot when buffer was built */
+	bool			versioned;		/* identified by GPU cache version */
+	uint64			generation;		/* sum of the GPU cache generation */
+	uint64			write_pos;		/* sum of the REDO log position */
+	cl_uint			shmem_handle;	/* identifier of host inner-buffer */
+	size_t			shmem_bytesize;	/* length of the host inner-buffer */
+	struct {
+		size_t		bytesize;		/* not zero, if allocated */
+		CUipcMemHandle ipc_mhandle;	/* IPC handle of preserved memory */
+	} pergpu[FLEXIBLE_ARRAY_MEMBER];
+} GpuJoinInnerCacheEntry;
+
+typedef struct
+{
+	slock_t			lock;
+	uint64			lru_clock;
+	int				nslots;
+	size_t			entry_sz;
+	char			data[FLEXIBLE_ARRAY_MEMBER];
+} GpuJoinInnerCacheHead;
+
+#define GPUJOIN_INNER_CACHE_ENTRY(slot_id)							\
+	((GpuJoinInnerCacheEntry *)(gj_icache_head->data +				\
+								(size_t)(slot_id) * gj_icache_head->entry_sz))
+
+/*
+ * GpuJoinInnerCacheTracker - tracks the pinned cache entry to unpin it
+ * on the transaction abort.
+ */
+struct GpuJoinInnerCacheTracker
+{
+	dlist_node		chain;
+	ResourceOwner	owner;
+	int				slot_id;
+};
+typedef struct GpuJoinInnerCacheTracker	GpuJoinInnerCacheTracker;
+
 /*
  * GpuJoinTask - task object of GpuJoin
  */
@@ -404,7 +560,19 @@ static CustomExecMethods	gpujoin_exec_methods;
 static bool					enable_gpunestloop;				/* GUC */
 static bool					enable_gpuhashjoin;				/* GUC */
 static bool					enable_gpugistindex;			/* GUC */
+static bool					enable_gpugridindex;			/* GUC */
 static bool					enable_partitionwise_gpujoin;	/* GUC */
+static int					gpujoin_max_inner_partitions;	/* GUC */
+static bool					gpujoin_inner_p2p_copy;			/* GUC */
+static bool					gpujoin_inner_async_load;		/* GUC */
+static bool					gpujoin_outer_range_pruning;	/* GUC */
+static bool					gpujoin_inner_cache_enabled;	/* GUC */
+static int					gpujoin_inner_cache_nslots;		/* GUC */
+static int					gpujoin_inner_cache_max_size_kb;	/* GUC */
+static shmem_startup_hook_type shmem_startup_next = NULL;
+static GpuJoinInnerCacheHead *gj_icache_head = NULL;
+static dlist_head			gj_icache_tracker_list;
+static HTAB				   *gj_feedback_htab = NULL;
 
 /* static functions */
 static void gpujoin_switch_task(GpuTaskState *gts, GpuTask *gtask);
@@ -428,9 +596,16 @@ static TupleTableSlot *gpujoinNextTupleFallback(GpuTaskState *gts,
 static size_t createGpuJoinSharedState(GpuJoinState *gjs,
 									   ParallelContext *pcxt,
 									   void *coordinate);
+static void resetGpuJoinSharedState(GpuJoinState *gjs);
 static void cleanupGpuJoinSharedStateOnAbort(dsm_segment *segment,
 											 Datum ptr);
 static void gpujoinColocateOuterJoinMapsToHost(GpuJoinState *gjs);
+static void gpujoinColocateOuterJoinMapsOnDevice(GpuJoinState *gjs);
+static bool gpujoinOuterJoinMapsPeerAccessible(void);
+static uint64 gpujoinFeedbackSignature(GpuJoinState *gjs,
+									   GpuJoinInfo *gj_info);
+static double gpujoinFeedbackLookup(GpuJoinState *gjs);
+static void gpujoinFeedbackUpdate(GpuJoinState *gjs);
 
 /*
  * misc declarations
@@ -478,6 +653,18 @@ pgstrom_planstate_is_gpujoin(const PlanState *ps)
 	return false;
 }
 
+/*
+ * pgstrom_planstate_gpujoin_inner_nparts
+ *
+ * returns number of the partitions of the inner hash at depth=1
+ */
+cl_int
+pgstrom_planstate_gpujoin_inner_nparts(const PlanState *ps)
+{
+	Assert(pgstrom_planstate_is_gpujoin(ps));
+	return ((const GpuJoinState *) ps)->inner_nparts;
+}
+
 /*
  * gpujoin_get_optimal_gpu
  */
@@ -549,6 +736,82 @@ __dump_gpujoin_rel(StringInfo buf, PlannerInfo *root, RelOptInfo *rel)
 		appendStringInfo(buf, ")");
 }
 
+/*
+ * gpujoin_grid_index_length
+ *
+ * It returns the length of the grid-index for the supplied number of inner
+ * items, and the number of cells on X-/Y-axis. Each cell usually has
+ * GPUJOIN_GRID_ITEMS_PER_CELL items, if inner geometries are uniformly
+ * distributed. The grid-index on ranges has only one row of the cells.
+ */
+#define GPUJOIN_GRID_ITEMS_PER_CELL		4
+#define GPUJOIN_GRID_MAX_NCELLS_AXIS	2048
+
+static size_t
+gpujoin_grid_index_length(size_t nrooms, bool is_range,
+						  cl_uint *p_nx, cl_uint *p_ny)
+{
+	double		ncells = (double)nrooms / (double)GPUJOIN_GRID_ITEMS_PER_CELL;
+	cl_uint		nx, ny;
+
+	if (is_range)
+	{
+		nx = (cl_uint)Max(ncells, 1.0);
+		nx = Min(nx, GPUJOIN_GRID_MAX_NCELLS_AXIS * GPUJOIN_GRID_MAX_NCELLS_AXIS);
+		ny = 1;
+	}
+	else
+	{
+		nx = (cl_uint)Max(sqrt(ncells), 1.0);
+		nx = Min(nx, GPUJOIN_GRID_MAX_NCELLS_AXIS);
+		ny = nx;
+	}
+	if (p_nx)
+		*p_nx = nx;
+	if (p_ny)
+		*p_ny = ny;
+	return (STROMALIGN(offsetof(kern_gpujoin_grid, cells[nx * ny + 1])) +
+			STROMALIGN(sizeof(kern_gpujoin_grid_item) * nrooms));
+}
+
+/*
+ * gpujoin_grid_is_range
+ *
+ * It checks whether the grid-index clause is a range operator; '&&', '@>'
+ * or '<@', or a network containment operator; '<<', '<<=', '>>', '>>=' or
+ * '&&' on inet/cidr. Otherwise, it is a spatial join clause.
+ */
+static bool
+gpujoin_grid_is_range(Expr *grid_clause)
+{
+	Oid			func_oid;
+
+	if (IsA(grid_clause, OpExpr))
+		func_oid = get_opcode(((OpExpr *) grid_clause)->opno);
+	else if (IsA(grid_clause, FuncExpr))
+		func_oid = ((FuncExpr *) grid_clause)->funcid;
+	else
+		return false;
+
+	switch (func_oid)
+	{
+		case F_RANGE_OVERLAPS:
+		case F_RANGE_CONTAINS:
+		case F_RANGE_CONTAINS_ELEM:
+		case F_RANGE_CONTAINED_BY:
+		case F_ELEM_CONTAINED_BY_RANGE:
+		case F_NETWORK_SUB:
+		case F_NETWORK_SUBEQ:
+		case F_NETWORK_SUP:
+		case F_NETWORK_SUPEQ:
+		case F_NETWORK_OVERLAP:
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
+
 /*
  * estimate_inner_buffersize
  */
@@ -606,6 +869,14 @@ estimate_inner_buffersize(PlannerInfo *root,
 			chunk_size = KDS_ESTIMATE_HASH_LENGTH(ncols,inner_nrows,htup_size);
 		else
 			chunk_size = KDS_ESTIMATE_ROW_LENGTH(ncols,inner_nrows,htup_size);
+		if (gpath->inners[i].grid_clause != NULL)
+		{
+			Expr   *grid_clause = gpath->inners[i].grid_clause;
+
+			chunk_size += gpujoin_grid_index_length(inner_nrows,
+													gpujoin_grid_is_range(grid_clause),
+													NULL, NULL);
+		}
 		gpath->inners[i].ichunk_size = chunk_size;
 		inner_total_sz += chunk_size;
 	}
@@ -630,13 +901,22 @@ cost_gpujoin(PlannerInfo *root,
 	Cost		run_cost = 0.0;
 	Cost		startup_delay;
 	Size		inner_buffer_sz = 0;
-	double		gpu_ratio = pgstrom_gpu_operator_cost / cpu_operator_cost;
+	double		gpu_setup_cost;
+	double		gpu_dma_cost;
+	double		gpu_operator_cost;
+	double		gpu_ratio;
 	double		parallel_divisor = 1.0;
 	double		num_chunks;
 	double		outer_ntuples = outer_path->rows;
+	Cost		outer_run_cost;
 	int			i, num_rels = gpath->num_rels;
 	bool		retval = false;
 
+	pgstrom_gpu_cost_factors(&gpu_setup_cost,
+							 &gpu_dma_cost,
+							 &gpu_operator_cost);
+	gpu_ratio = gpu_operator_cost / cpu_operator_cost;
+
 	/*
 	 * Cost comes from the outer-path
 	 */
@@ -662,15 +942,16 @@ cost_gpujoin(PlannerInfo *root,
 	else
 	{
 		if (pathtree_has_gpupath(outer_path))
-			startup_cost = pgstrom_gpu_setup_cost / 2;
+			startup_cost = gpu_setup_cost / 2;
 		else
-			startup_cost = pgstrom_gpu_setup_cost;
+			startup_cost = gpu_setup_cost;
 		startup_cost = outer_path->startup_cost;
 		run_cost = outer_path->total_cost - outer_path->startup_cost;
 		num_chunks = estimate_num_chunks(outer_path);
 
 		parallel_divisor = get_parallel_divisor(&gpath->cpath.path);
 	}
+	outer_run_cost = run_cost;
 
 	/*
 	 * Estimation of inner hash/heap buffer, and number of internal loop
@@ -704,7 +985,40 @@ cost_gpujoin(PlannerInfo *root,
 		 * In the future version, up to 32GB chunk will be supported using
 		 * least 3bit because row-/hash-item shall be always put on 64bit
 		 * aligned location.
+		 *
+		 * As an exception, INNER hash-join at the depth=1 can split the
+		 * inner hash table into multiple partitions by the hash value.
+		 * Only a partition is loaded at a time, then GpuJoin re-scans
+		 * the outer relation for each partition. Other inner rows that
+		 * belong to the different partition never match with outer rows
+		 * at this pass, because their hash values are different.
 		 */
+		if (ichunk_size >= 0x60000000UL &&
+			i == 0 &&
+			hash_quals != NIL &&
+			gpath->inners[i].join_type == JOIN_INNER &&
+			parallel_nworkers == 0 &&
+			!gpath->cpath.path.parallel_aware &&
+			gpujoin_max_inner_partitions > 1)
+		{
+			int		nparts = (ichunk_size + 0x3fffffffUL) / 0x40000000UL;
+			int		j;
+
+			for (j=1; j < num_rels; j++)
+			{
+				if (gpath->inners[j].join_type == JOIN_RIGHT ||
+					gpath->inners[j].join_type == JOIN_FULL)
+					break;
+			}
+			if (j == num_rels && nparts <= gpujoin_max_inner_partitions)
+			{
+				gpath->inner_nparts = nparts;
+				gpath->inners[i].ichunk_size = ichunk_size / nparts;
+				inner_buffer_sz -= (ichunk_size - ichunk_size / nparts);
+				ichunk_size = ichunk_size / nparts;
+			}
+		}
+
 		if (ichunk_size >= 0x60000000UL)
 		{
 			if (client_min_messages <= DEBUG1 || log_min_messages <= DEBUG1)
@@ -760,7 +1074,7 @@ cost_gpujoin(PlannerInfo *root,
 			inner_cost += cpu_operator_cost * num_hashkeys * scan_path->rows;
 
 			/* cost to comput hash value by GPU */
-			run_cost += (pgstrom_gpu_operator_cost *
+			run_cost += (gpu_operator_cost *
 						 num_hashkeys *
 						 outer_ntuples);
 			/* cost to evaluate join qualifiers */
@@ -790,6 +1104,24 @@ cost_gpujoin(PlannerInfo *root,
 						 outer_ntuples *
 						 gist_selectivity * inner_ntuples);
 		}
+		else if (gpath->inners[i].grid_clause != NULL)
+		{
+			Selectivity	grid_selectivity = gpath->inners[i].grid_selectivity;
+			double		inner_ntuples = scan_path->rows;
+
+			/* cost to preload inner heap tuples, and build the grid by CPU */
+			inner_cost += (cpu_tuple_cost + cpu_operator_cost) * inner_ntuples;
+
+			/* cost to check the items on the nearby cells by GPU */
+			run_cost += (gpu_operator_cost *
+						 9.0 * GPUJOIN_GRID_ITEMS_PER_CELL *
+						 outer_ntuples);
+
+			/* cost to evaluate join qualifiers by GPU */
+			run_cost += (join_quals_cost.per_tuple * gpu_ratio *
+						 outer_ntuples *
+						 grid_selectivity * inner_ntuples);
+		}
 		else
 		{
 			/*
@@ -811,11 +1143,24 @@ cost_gpujoin(PlannerInfo *root,
 		outer_ntuples = join_nrows / parallel_divisor;
 	}
 	/* outer DMA send cost */
-	run_cost += (double)num_chunks * pgstrom_gpu_dma_cost;
+	run_cost += (double)num_chunks * gpu_dma_cost;
 
 	/* inner DMA send cost */
 	inner_cost += ((double)inner_buffer_sz /
-				   (double)pgstrom_chunk_size()) * pgstrom_gpu_dma_cost;
+				   (double)pgstrom_chunk_size()) * gpu_dma_cost;
+
+	/*
+	 * Partitioned inner hash needs to scan the inner relations, and the
+	 * outer relation, for each partition.
+	 */
+	if (gpath->inner_nparts > 1)
+	{
+		int		nloops = gpath->inner_nparts - 1;
+
+		inner_cost += inner_cost * (double)nloops;
+		run_cost += (outer_run_cost +
+					 (double)num_chunks * gpu_dma_cost) * (double)nloops;
+	}
 
 	/* cost for GPU projection */
 	startup_cost += joinrel->reltarget->cost.startup;
@@ -868,7 +1213,9 @@ cost_gpujoin(PlannerInfo *root,
 			appendStringInfo(&buf, " %s%s ",
 							 join_type == JOIN_FULL ? "F" :
 							 join_type == JOIN_LEFT ? "L" :
-							 join_type == JOIN_RIGHT ? "R" : "I",
+							 join_type == JOIN_RIGHT ? "R" :
+							 join_type == JOIN_SEMI ? "S" :
+							 join_type == JOIN_ANTI ? "A" : "I",
 							 is_nestloop ? "NL" : "HJ");
 		}
 		__dump_gpujoin_rel(&buf, root, outer_path->parent);
@@ -893,6 +1240,11 @@ typedef struct
 	AttrNumber	gist_ctid_resno;
 	Expr	   *gist_clause;
 	Selectivity	gist_selectivity;
+	Expr	   *grid_clause;
+	Expr	   *grid_iarg;
+	Expr	   *grid_idist;
+	AttrNumber	grid_resno;
+	Selectivity	grid_selectivity;
 	double		join_nrows;
 } inner_path_item;
 
@@ -923,6 +1275,9 @@ create_gpujoin_path(PlannerInfo *root,
 	}
 	if ((try_outer_parallel | try_inner_parallel) && !parallel_safe)
 		return NULL;
+	if (try_outer_parallel)
+		parallel_nworkers = pgstrom_gpu_parallel_workers(parallel_nworkers,
+									gpujoin_get_optimal_gpu(outer_path));
 
 	gjpath = palloc0(offsetof(GpuJoinPath, inners[num_rels + 1]));
 	NodeSetTag(gjpath, T_CustomPath);
@@ -941,6 +1296,7 @@ create_gpujoin_path(PlannerInfo *root,
 	gjpath->outer_quals = NULL;
 	gjpath->num_rels = num_rels;
 	gjpath->inner_parallel = try_inner_parallel;
+	gjpath->inner_nparts = 1;
 
 	i = 0;
 	foreach (lc, inner_path_items_list)
@@ -969,6 +1325,11 @@ create_gpujoin_path(PlannerInfo *root,
 		gjpath->inners[i].gist_ctid_resno = ip_item->gist_ctid_resno;
 		gjpath->inners[i].gist_clause = ip_item->gist_clause;
 		gjpath->inners[i].gist_selectivity = ip_item->gist_selectivity;
+		gjpath->inners[i].grid_clause = ip_item->grid_clause;
+		gjpath->inners[i].grid_iarg = ip_item->grid_iarg;
+		gjpath->inners[i].grid_idist = ip_item->grid_idist;
+		gjpath->inners[i].grid_resno = ip_item->grid_resno;
+		gjpath->inners[i].grid_selectivity = ip_item->grid_selectivity;
 		gjpath->inners[i].ichunk_size = 0;		/* to be set later */
 		i++;
 	}
@@ -1249,7 +1610,8 @@ fixup_gist_clause_for_device(PlannerInfo *root,
 						  &raw_typid,
 						  &raw_typmod,
 						  &raw_collid);
-	if (dindex->ivar_dtype->type_oid != raw_typid)
+	if (dindex->ivar_dtype->type_oid != raw_typid &&
+		!IsBinaryCoercible(raw_typid, dindex->ivar_dtype->type_oid))
 		return NULL;	/* type mismatch */
 	ivar = makeVar(INDEX_VAR,
 				   indexcol + 1,
@@ -1433,6 +1795,265 @@ extract_gpugistindex_clause(inner_path_item *ip_item,
 	ip_item->gist_selectivity = gist_selectivity;
 }
 
+/*
+ * Grid Index support
+ *
+ * If no GiST index is available for the spatial join clause, GpuJoin can
+ * build a uniform grid on the bounding-box of the inner geometries at the
+ * inner preload, to pick up the candidate inner rows for each outer key.
+ * Join qualifiers are evaluated on the candidates as usual.
+ */
+static bool
+match_clause_to_grid_index(PlannerInfo *root,
+						   RelOptInfo *inner_rel,
+						   PathTarget *inner_target,
+						   FuncExpr *func,
+						   Expr **p_iarg,
+						   Expr **p_idist,
+						   AttrNumber *p_resno)
+{
+	devfunc_info *dfunc;
+	devtype_info *dtype;
+	Expr	   *arg1;
+	Expr	   *arg2;
+	Expr	   *iarg;
+	Var		   *ivar;
+	Expr	   *idist = NULL;
+	AttrNumber	resno = 1;
+	ListCell   *lc;
+
+	if (!IsA(func, FuncExpr))
+		return false;
+	dfunc = pgstrom_devfunc_lookup(func->funcid,
+								   func->funcresulttype,
+								   func->args,
+								   func->inputcollid);
+	if (!dfunc || !dfunc->func_extension ||
+		strcmp(dfunc->func_extension, "postgis") != 0)
+		return false;
+	if (strcmp(dfunc->func_devname, "st_dwithin") == 0 &&
+		list_length(func->args) == 3)
+		idist = lthird(func->args);
+	else if ((strcmp(dfunc->func_devname, "st_contains") != 0 &&
+			  strcmp(dfunc->func_devname, "st_crosses") != 0 &&
+			  strcmp(dfunc->func_devname, "st_intersects") != 0 &&
+			  strcmp(dfunc->func_devname, "st_within") != 0) ||
+			 list_length(func->args) != 2)
+		return false;
+	arg1 = linitial(func->args);
+	arg2 = lsecond(func->args);
+
+	/* one side must be a geometry column of the inner relation */
+	if (IsA(arg1, Var) &&
+		bms_is_member(((Var *)arg1)->varno, inner_rel->relids) &&
+		!bms_overlap(pull_varnos(root, (Node *)arg2), inner_rel->relids))
+	{
+		ivar = (Var *)arg1;
+		iarg = arg2;
+	}
+	else if (IsA(arg2, Var) &&
+			 bms_is_member(((Var *)arg2)->varno, inner_rel->relids) &&
+			 !bms_overlap(pull_varnos(root, (Node *)arg1), inner_rel->relids))
+	{
+		ivar = (Var *)arg2;
+		iarg = arg1;
+	}
+	else
+		return false;
+	if (ivar->varlevelsup != 0 ||
+		(idist && bms_overlap(pull_varnos(root, (Node *)idist), inner_rel->relids)))
+		return false;
+	dtype = pgstrom_devtype_lookup(ivar->vartype);
+	if (!dtype || strcmp(dtype->type_name, "geometry") != 0)
+		return false;
+
+	/* inner key must be on the targetlist */
+	foreach (lc, inner_target->exprs)
+	{
+		if (equal(lfirst(lc), ivar))
+			break;
+		resno++;
+	}
+	if (!lc)
+		return false;
+
+	*p_iarg = iarg;
+	*p_idist = idist;
+	*p_resno = resno;
+	return true;
+}
+
+/*
+ * match_clause_to_range_grid_index
+ *
+ * A range join clause ('&&', '@>' or '<@' on ranges and elements) is also
+ * supported by the grid-index; it has only one row of cells on the interval
+ * of the ranges, so each outer key checks the inner ranges around itself.
+ * Network containment on inet/cidr is handled in the same way, on the
+ * interval of the addresses in the network.
+ */
+static bool
+__match_range_grid_key_type(Oid type_oid)
+{
+	switch (type_oid)
+	{
+		case INT4OID:
+		case INT8OID:
+		case DATEOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		case INT4RANGEOID:
+		case INT8RANGEOID:
+		case DATERANGEOID:
+		case TSRANGEOID:
+		case TSTZRANGEOID:
+		case INETOID:
+		case CIDROID:
+			return (pgstrom_devtype_lookup(type_oid) != NULL);
+		default:
+			break;
+	}
+	return false;
+}
+
+static bool
+match_clause_to_range_grid_index(PlannerInfo *root,
+								 RelOptInfo *inner_rel,
+								 PathTarget *inner_target,
+								 Expr *clause,
+								 Expr **p_iarg,
+								 AttrNumber *p_resno)
+{
+	List	   *args;
+	Expr	   *arg1;
+	Expr	   *arg2;
+	Expr	   *iarg;
+	Var		   *ivar;
+	AttrNumber	resno = 1;
+	ListCell   *lc;
+
+	if (!gpujoin_grid_is_range(clause))
+		return false;
+	if (IsA(clause, OpExpr))
+		args = ((OpExpr *) clause)->args;
+	else
+		args = ((FuncExpr *) clause)->args;
+	if (list_length(args) != 2)
+		return false;
+	arg1 = linitial(args);
+	arg2 = lsecond(args);
+	/* cidr column is relabeled to inet for the network operators */
+	if (IsA(arg1, RelabelType) && IsA(((RelabelType *) arg1)->arg, Var))
+		arg1 = ((RelabelType *) arg1)->arg;
+	if (IsA(arg2, RelabelType) && IsA(((RelabelType *) arg2)->arg, Var))
+		arg2 = ((RelabelType *) arg2)->arg;
+
+	/* one side must be a column of the inner relation */
+	if (IsA(arg1, Var) &&
+		bms_is_member(((Var *)arg1)->varno, inner_rel->relids) &&
+		!bms_overlap(pull_varnos(root, (Node *)arg2), inner_rel->relids))
+	{
+		ivar = (Var *)arg1;
+		iarg = arg2;
+	}
+	else if (IsA(arg2, Var) &&
+			 bms_is_member(((Var *)arg2)->varno, inner_rel->relids) &&
+			 !bms_overlap(pull_varnos(root, (Node *)arg1), inner_rel->relids))
+	{
+		ivar = (Var *)arg2;
+		iarg = arg1;
+	}
+	else
+		return false;
+	if (ivar->varlevelsup != 0 ||
+		!__match_range_grid_key_type(ivar->vartype) ||
+		!__match_range_grid_key_type(exprType((Node *)iarg)))
+		return false;
+
+	/* inner key must be on the targetlist */
+	foreach (lc, inner_target->exprs)
+	{
+		if (equal(lfirst(lc), ivar))
+			break;
+		resno++;
+	}
+	if (!lc)
+		return false;
+
+	*p_iarg = iarg;
+	*p_resno = resno;
+	return true;
+}
+
+static void
+extract_gpugridindex_clause(inner_path_item *ip_item,
+							PlannerInfo *root,
+							JoinType jointype,
+							List *restrict_clauses)
+{
+	Path		   *inner_path = ip_item->inner_path;
+	RelOptInfo	   *inner_rel = inner_path->parent;
+	Expr		   *grid_clause = NULL;
+	Expr		   *grid_iarg = NULL;
+	Expr		   *grid_idist = NULL;
+	AttrNumber		grid_resno = InvalidAttrNumber;
+	Selectivity		grid_selectivity = 1.0;
+	ListCell	   *lc;
+
+	/* skip, if pg_strom.enable_gpugridindex is not set */
+	if (!enable_gpugridindex)
+		return;
+
+	/* GPU Grid Index is used only when neither hash nor GiST is available */
+	Assert(ip_item->hash_quals == NIL && ip_item->gist_index == NULL);
+
+	foreach (lc, restrict_clauses)
+	{
+		RestrictInfo   *rinfo = lfirst(lc);
+		Expr		   *iarg;
+		Expr		   *idist;
+		AttrNumber		resno;
+		Selectivity		curr_selectivity;
+
+		if (rinfo->pseudoconstant || !rinfo->clause)
+			continue;
+		idist = NULL;
+		if (!match_clause_to_grid_index(root,
+										inner_rel,
+										inner_path->pathtarget,
+										(FuncExpr *)rinfo->clause,
+										&iarg, &idist, &resno) &&
+			!match_clause_to_range_grid_index(root,
+											  inner_rel,
+											  inner_path->pathtarget,
+											  rinfo->clause,
+											  &iarg, &resno))
+			continue;
+		if (!pgstrom_device_expression(root, NULL, iarg) ||
+			(idist && !pgstrom_device_expression(root, NULL, idist)))
+			continue;
+
+		curr_selectivity = clauselist_selectivity(root,
+												  list_make1(rinfo),
+												  0,
+												  JOIN_INNER,
+												  NULL);
+		if (!grid_clause || grid_selectivity > curr_selectivity)
+		{
+			grid_clause = rinfo->clause;
+			grid_iarg = iarg;
+			grid_idist = idist;
+			grid_resno = resno;
+			grid_selectivity = curr_selectivity;
+		}
+	}
+	ip_item->grid_clause = grid_clause;
+	ip_item->grid_iarg = grid_iarg;
+	ip_item->grid_idist = grid_idist;
+	ip_item->grid_resno = grid_resno;
+	ip_item->grid_selectivity = grid_selectivity;
+}
+
 #if PG_VERSION_NUM >= 110000
 /*
  * Partition support for GPU-aware custom-plans (GpuJoin, GpuPreAgg)
@@ -1639,10 +2260,17 @@ buildInnerPathItems(PlannerInfo *root,
 														join_type,
 														join_quals);
 		if (ip_item->hash_quals == NIL)
+		{
 			extract_gpugistindex_clause(ip_item,
 										root,
 										join_type,
 										join_quals);
+			if (!ip_item->gist_index)
+				extract_gpugridindex_clause(ip_item,
+											root,
+											join_type,
+											join_quals);
+		}
 		ip_item->join_nrows = join_nrows_curr = join_nrows;
 		results = lappend(results, ip_item);
 
@@ -1707,6 +2335,17 @@ adjustInnerPathItems(List *inner_items_base,
 			adjust_appendrel_attrs(root, (Node *)ip_item_src->gist_clause,
 								   nappinfos, appinfos);
 		ip_item_dst->gist_selectivity = ip_item_src->gist_selectivity;
+		ip_item_dst->grid_clause = (Expr *)
+			adjust_appendrel_attrs(root, (Node *)ip_item_src->grid_clause,
+								   nappinfos, appinfos);
+		ip_item_dst->grid_iarg = (Expr *)
+			adjust_appendrel_attrs(root, (Node *)ip_item_src->grid_iarg,
+								   nappinfos, appinfos);
+		ip_item_dst->grid_idist = (Expr *)
+			adjust_appendrel_attrs(root, (Node *)ip_item_src->grid_idist,
+								   nappinfos, appinfos);
+		ip_item_dst->grid_resno = ip_item_src->grid_resno;
+		ip_item_dst->grid_selectivity = ip_item_src->grid_selectivity;
 		ip_item_dst->join_nrows = ip_item_src->join_nrows * nrows_ratio;
 
 		results = lappend(results, ip_item_dst);
@@ -1743,7 +2382,7 @@ buildPartitionedGpuJoinPaths(PlannerInfo *root,
 	Relids		inner_relids = NULL;
 	double		join_nrows = 0.0;
 	GpuJoinPath *gjpath_leader = NULL;
-	bool		assign_sibling_param_id = true;
+	List	   *sibling_paths = NIL;
 	int			parallel_nworkers = 0;
 
 	inner_items_base = buildInnerPathItems(root,
@@ -1811,6 +2450,11 @@ buildPartitionedGpuJoinPaths(PlannerInfo *root,
 					ip_temp->gist_ctid_resno = gjtemp->inners[i].gist_ctid_resno;
 					ip_temp->gist_clause = gjtemp->inners[i].gist_clause;
 					ip_temp->gist_selectivity = gjtemp->inners[i].gist_selectivity;
+					ip_temp->grid_clause = gjtemp->inners[i].grid_clause;
+					ip_temp->grid_iarg = gjtemp->inners[i].grid_iarg;
+					ip_temp->grid_idist = gjtemp->inners[i].grid_idist;
+					ip_temp->grid_resno = gjtemp->inners[i].grid_resno;
+					ip_temp->grid_selectivity = gjtemp->inners[i].grid_selectivity;
 					ip_temp->join_nrows = gjtemp->inners[i].join_nrows;
 
 					inner_items_leaf = lcons(ip_temp, inner_items_leaf);
@@ -1842,13 +2486,21 @@ buildPartitionedGpuJoinPaths(PlannerInfo *root,
 									 try_inner_parallel);
 		if (!gjpath)
 			return NIL;
-		if (!gjpath_leader)
-			gjpath_leader = gjpath;
-		else
+
+		/*
+		 * The inner buffer can be shared with the leafs that have identical
+		 * inner relations with the leader, even if some other leafs pulled
+		 * up inner relations of the GpuJoin underlying. Partitioned inner
+		 * hash cannot be shared with the siblings.
+		 */
+		if (gjpath->inner_nparts <= 1)
 		{
-			if (gjpath_leader->num_rels != gjpath->num_rels)
-				assign_sibling_param_id = false;
-			else
+			if (!gjpath_leader)
+			{
+				gjpath_leader = gjpath;
+				sibling_paths = lappend(sibling_paths, gjpath);
+			}
+			else if (gjpath_leader->num_rels == gjpath->num_rels)
 			{
 				int		i;
 
@@ -1859,28 +2511,30 @@ buildPartitionedGpuJoinPaths(PlannerInfo *root,
 
 					if (!bms_equal(ipath_l->parent->relids,
 								   ipath_c->parent->relids))
-					{
-						assign_sibling_param_id = false;
 						break;
-					}
 				}
+				if (i == gjpath->num_rels)
+					sibling_paths = lappend(sibling_paths, gjpath);
 			}
 		}
 		parallel_nworkers = Max(parallel_nworkers,
 								gjpath->cpath.path.parallel_workers);
 		results = lappend(results, gjpath);
 	}
-	/* assign sibling_param_id, if any */
-	if (assign_sibling_param_id && list_length(results) > 1)
+	/*
+	 * assign sibling_param_id, if any; only the leader builds the inner
+	 * buffer, so inner cost of the other siblings can be discounted.
+	 */
+	if (list_length(sibling_paths) > 1)
 	{
 		int	   *sibling_param_id = palloc(sizeof(int));
 
 		*sibling_param_id = -1;
-		foreach (lc, results)
+		foreach (lc, sibling_paths)
 		{
 			GpuJoinPath *gjpath = lfirst(lc);
 			gjpath->sibling_param_id = sibling_param_id;
-			if (lc != list_head(append_path->subpaths))
+			if (lc != list_head(sibling_paths))
 				discount_cost += gjpath->inner_cost;
 		}
 	}
@@ -2277,11 +2931,16 @@ try_add_gpujoin_paths(PlannerInfo *root,
 	/* Sanity checks */
 	Assert(try_outer_parallel || !try_inner_parallel);
 
-	/* Quick exit if unsupported join type */
+	/*
+	 * Quick exit if unsupported join type.
+	 * Note that SEMI and ANTI join are supported only by GpuHashJoin.
+	 */
 	if (join_type != JOIN_INNER &&
 		join_type != JOIN_FULL &&
 		join_type != JOIN_RIGHT &&
-		join_type != JOIN_LEFT)
+		join_type != JOIN_LEFT &&
+		join_type != JOIN_SEMI &&
+		join_type != JOIN_ANTI)
 		return;
 
 	/*
@@ -2354,10 +3013,17 @@ try_add_gpujoin_paths(PlannerInfo *root,
 								  join_type,
 								  restrict_clauses);
 	if (ip_item->hash_quals == NIL)
+	{
 		extract_gpugistindex_clause(ip_item,
 									root,
 									join_type,
 									restrict_clauses);
+		if (!ip_item->gist_index)
+			extract_gpugridindex_clause(ip_item,
+										root,
+										join_type,
+										restrict_clauses);
+	}
 	ip_item->join_nrows = joinrel->rows;
 	ip_items_list = list_make1(ip_item);
 
@@ -2406,6 +3072,11 @@ try_add_gpujoin_paths(PlannerInfo *root,
 				ip_temp->gist_ctid_resno = gjtemp->inners[i].gist_ctid_resno;
 				ip_temp->gist_clause = gjtemp->inners[i].gist_clause;
 				ip_temp->gist_selectivity = gjtemp->inners[i].gist_selectivity;
+				ip_temp->grid_clause = gjtemp->inners[i].grid_clause;
+				ip_temp->grid_iarg = gjtemp->inners[i].grid_iarg;
+				ip_temp->grid_idist = gjtemp->inners[i].grid_idist;
+				ip_temp->grid_resno = gjtemp->inners[i].grid_resno;
+				ip_temp->grid_selectivity = gjtemp->inners[i].grid_selectivity;
 				ip_temp->join_nrows = gjtemp->inners[i].join_nrows;
 
 				ip_items_list = lcons(ip_temp, ip_items_list);
@@ -2891,47 +3562,298 @@ build_device_targetlist(PlannerInfo *root,
 }
 
 /*
- * PlanGpuJoinPath
+ * outer_range_key_type_bounds
  *
- * Entrypoint to create CustomScan(GpuJoin) node
+ * It returns the range of data types that are supported by the inner
+ * key range pruning. All of them are compared as signed 64bit integer.
  */
-static Plan *
-PlanGpuJoinPath(PlannerInfo *root,
-				RelOptInfo *rel,
-				CustomPath *best_path,
-				List *tlist,
-				List *clauses,
-				List *custom_plans)
+static bool
+outer_range_key_type_bounds(Oid type_oid, cl_long *p_min, cl_long *p_max)
 {
-	GpuJoinPath	   *gjpath = (GpuJoinPath *) best_path;
-	Index			outer_relid = gjpath->outer_relid;
-	GpuJoinInfo		gj_info;
-	CustomScan	   *cscan;
-	Plan		   *outer_plan;
-	ListCell	   *lc;
-	double			outer_nrows;
-	int				i, k;
+	switch (type_oid)
+	{
+		case INT2OID:
+			*p_min = PG_INT16_MIN;
+			*p_max = PG_INT16_MAX;
+			break;
+		case INT4OID:
+		case DATEOID:
+			*p_min = PG_INT32_MIN;
+			*p_max = PG_INT32_MAX;
+			break;
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			*p_min = PG_INT64_MIN;
+			*p_max = PG_INT64_MAX;
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
 
-	Assert(gjpath->num_rels + 1 == list_length(custom_plans));
-	outer_plan = linitial(custom_plans);
+static inline cl_long
+outer_range_key_datum_to_int64(Oid type_oid, Datum datum)
+{
+	switch (type_oid)
+	{
+		case INT2OID:
+			return DatumGetInt16(datum);
+		case INT4OID:
+			return DatumGetInt32(datum);
+		case DATEOID:
+			return DatumGetDateADT(datum);
+		default:
+			/* int8, timestamp and timestamptz */
+			return DatumGetInt64(datum);
+	}
+}
 
-	cscan = makeNode(CustomScan);
-	cscan->scan.plan.targetlist = tlist;
-	cscan->scan.plan.qual = NIL;
-	cscan->scan.scanrelid = outer_relid;
-	cscan->flags = best_path->flags;
-	cscan->methods = &gpujoin_plan_methods;
-	cscan->custom_plans = list_copy_tail(custom_plans, 1);
-	Assert(list_length(cscan->custom_plans) == gjpath->num_rels);
+static inline Datum
+outer_range_key_int64_to_datum(Oid type_oid, cl_long ival)
+{
+	switch (type_oid)
+	{
+		case INT2OID:
+			return Int16GetDatum((int16) ival);
+		case INT4OID:
+			return Int32GetDatum((int32) ival);
+		case DATEOID:
+			return DateADTGetDatum((DateADT) ival);
+		default:
+			/* int8, timestamp and timestamptz */
+			return Int64GetDatum(ival);
+	}
+}
 
-	memset(&gj_info, 0, sizeof(GpuJoinInfo));
-	gj_info.outer_ratio = 1.0;
-	gj_info.outer_nrows = outer_plan->plan_rows;
-	gj_info.outer_width = outer_plan->plan_width;
-	gj_info.outer_startup_cost = outer_plan->startup_cost;
-	gj_info.outer_total_cost = outer_plan->total_cost;
-	gj_info.num_rels = gjpath->num_rels;
-	gj_info.optimal_gpu = gjpath->optimal_gpu;
+/*
+ * assign_outer_range_pruning
+ *
+ * If outer relation is Apache Arrow file, and the first depth is INNER
+ * hash-join, we can skip the outer record-batches whose min/max statistics
+ * never overlap with the range of the join-key in the inner buffer. It is
+ * very effective when Arrow file is sorted by the join-key, like log data
+ * ordered by timestamp. The range of the join-key is given via a pair of
+ * PARAM_EXEC at run-time, once the inner buffer gets built.
+ */
+static void
+assign_outer_range_pruning(PlannerInfo *root,
+						   GpuJoinPath *gjpath,
+						   GpuJoinInfo *gj_info,
+						   Index outer_relid)
+{
+	GpuJoinInnerInfo *i_info = linitial(gj_info->inner_infos);
+	PlannerGlobal *glob = root->glob;
+	ListCell   *lc1, *lc2;
+	cl_long		dummy;
+	int			key_index = 0;
+
+	/*
+	 * Asymmetric partition-wise join shares the inner buffer with siblings,
+	 * and partitioned inner hash loads only a part of inner rows per pass.
+	 */
+	if (!gpujoin_outer_range_pruning ||
+		gjpath->sibling_param_id != NULL ||
+		gjpath->inner_nparts > 1 ||
+		i_info->join_type != JOIN_INNER ||
+		!baseRelIsArrowFdw(root->simple_rel_array[outer_relid]))
+		return;
+
+	forboth (lc1, i_info->hash_inner_keys,
+			 lc2, i_info->hash_outer_keys)
+	{
+		Node   *i_key = lfirst(lc1);
+		Var	   *o_key = lfirst(lc2);
+
+		if (IsA(o_key, Var) &&
+			o_key->varno == outer_relid &&
+			o_key->varattno > 0 &&
+			exprType(i_key) == o_key->vartype &&
+			outer_range_key_type_bounds(o_key->vartype, &dummy, &dummy))
+		{
+			gj_info->outer_range_key = key_index;
+#if PG_VERSION_NUM < 110000
+			gj_info->outer_range_param = glob->nParamExec;
+			glob->nParamExec += 2;
+#else
+			gj_info->outer_range_param = list_length(glob->paramExecTypes);
+			glob->paramExecTypes = lappend_oid(glob->paramExecTypes,
+											   o_key->vartype);
+			glob->paramExecTypes = lappend_oid(glob->paramExecTypes,
+											   o_key->vartype);
+#endif
+			break;
+		}
+		key_index++;
+	}
+}
+
+/*
+ * build_inner_cache_key
+ *
+ * It builds an identifier of the inner buffer that can be shared with the
+ * later queries, if all the inner relations are simple relation scan without
+ * any query specific parameters. Elsewhere, it returns NULL.
+ */
+static bool
+inner_cache_unshareable_walker(Node *node, void *context)
+{
+	if (!node)
+		return false;
+	if (IsA(node, Param) ||
+		IsA(node, SubPlan) ||
+		IsA(node, AlternativeSubPlan))
+		return true;
+	return expression_tree_walker(node, inner_cache_unshareable_walker,
+								  context);
+}
+
+static char *
+build_inner_cache_key(PlannerInfo *root,
+					  GpuJoinPath *gjpath,
+					  GpuJoinInfo *gj_info,
+					  List *custom_plans)
+{
+	StringInfoData buf;
+	ListCell   *lc1, *lc2;
+	int			depth = 1;
+
+	if (!gpujoin_inner_cache_enabled ||
+		gpujoin_inner_cache_nslots == 0 ||
+		gjpath->cpath.path.parallel_aware ||
+		gjpath->inner_parallel ||
+		gjpath->sibling_param_id != NULL ||
+		gjpath->inner_nparts > 1)
+		return NULL;
+
+	initStringInfo(&buf);
+	foreach (lc1, gj_info->inner_infos)
+	{
+		GpuJoinInnerInfo *i_info = lfirst(lc1);
+		Plan	   *plan = list_nth(custom_plans, depth);
+		Index		scanrelid;
+		RangeTblEntry *rte;
+		List	   *tlist_exprs = NIL;
+		Node	   *expr;
+		char	   *temp, *pos;
+
+		/*
+		 * RIGHT/FULL OUTER JOIN and GiST-index updates the inner buffer,
+		 * and grid-index is built on the inner buffer
+		 */
+		if ((i_info->join_type != JOIN_INNER &&
+			 i_info->join_type != JOIN_LEFT) ||
+			OidIsValid(i_info->gist_index_reloid) ||
+			i_info->grid_index_resno > 0)
+			goto bailout;
+		if ((!IsA(plan, SeqScan) && !pgstrom_plan_is_gpuscan(plan)) ||
+			plan->initPlan != NIL)
+			goto bailout;
+		scanrelid = ((Scan *)plan)->scanrelid;
+		rte = planner_rt_fetch(scanrelid, root);
+		if (rte->rtekind != RTE_RELATION ||
+			(rte->relkind != RELKIND_RELATION &&
+			 rte->relkind != RELKIND_MATVIEW))
+			goto bailout;
+
+		foreach (lc2, plan->targetlist)
+		{
+			TargetEntry *tle = lfirst(lc2);
+
+			tlist_exprs = lappend(tlist_exprs, tle->expr);
+		}
+		if (IsA(plan, SeqScan))
+			expr = (Node *)list_make3(tlist_exprs,
+									  plan->qual,
+									  i_info->hash_inner_keys);
+		else
+		{
+			/* GpuScan also has device quals in the custom_exprs */
+			expr = (Node *)list_make4(tlist_exprs,
+									  plan->qual,
+									  ((CustomScan *)plan)->custom_exprs,
+									  i_info->hash_inner_keys);
+		}
+		if (inner_cache_unshareable_walker(expr, NULL) ||
+			contain_mutable_functions(expr))
+			goto bailout;
+		/* varno depends on the range-table of individual queries */
+		expr = copyObject(expr);
+		ChangeVarNodes(expr, scanrelid, 1, 0);
+
+		appendStringInfo(&buf, "{DEPTH %d :relid %u :join_type %d :%s ",
+						 depth, rte->relid, (int)i_info->join_type,
+						 IsA(plan, SeqScan) ? "seqscan" : "gpuscan");
+		/* token location also depends on the query string */
+		temp = nodeToString(expr);
+		for (pos = temp; *pos != '\0'; pos++)
+		{
+			if (strncmp(pos, " :location ", 11) == 0)
+			{
+				pos += 11;
+				if (*pos == '-')
+					pos++;
+				while (isdigit(*pos))
+					pos++;
+				pos--;
+				continue;
+			}
+			appendStringInfoChar(&buf, *pos);
+		}
+		appendStringInfoChar(&buf, '}');
+		pfree(temp);
+		depth++;
+	}
+	return buf.data;
+
+bailout:
+	pfree(buf.data);
+	return NULL;
+}
+
+/*
+ * PlanGpuJoinPath
+ *
+ * Entrypoint to create CustomScan(GpuJoin) node
+ */
+static Plan *
+PlanGpuJoinPath(PlannerInfo *root,
+				RelOptInfo *rel,
+				CustomPath *best_path,
+				List *tlist,
+				List *clauses,
+				List *custom_plans)
+{
+	GpuJoinPath	   *gjpath = (GpuJoinPath *) best_path;
+	Index			outer_relid = gjpath->outer_relid;
+	GpuJoinInfo		gj_info;
+	CustomScan	   *cscan;
+	Plan		   *outer_plan;
+	ListCell	   *lc;
+	double			outer_nrows;
+	int				i, k;
+
+	Assert(gjpath->num_rels + 1 == list_length(custom_plans));
+	outer_plan = linitial(custom_plans);
+
+	cscan = makeNode(CustomScan);
+	cscan->scan.plan.targetlist = tlist;
+	cscan->scan.plan.qual = NIL;
+	cscan->scan.scanrelid = outer_relid;
+	cscan->flags = best_path->flags;
+	cscan->methods = &gpujoin_plan_methods;
+	cscan->custom_plans = list_copy_tail(custom_plans, 1);
+	Assert(list_length(cscan->custom_plans) == gjpath->num_rels);
+
+	memset(&gj_info, 0, sizeof(GpuJoinInfo));
+	gj_info.outer_ratio = 1.0;
+	gj_info.outer_nrows = outer_plan->plan_rows;
+	gj_info.outer_width = outer_plan->plan_width;
+	gj_info.outer_startup_cost = outer_plan->startup_cost;
+	gj_info.outer_total_cost = outer_plan->total_cost;
+	gj_info.num_rels = gjpath->num_rels;
+	gj_info.optimal_gpu = gjpath->optimal_gpu;
 
 	if (!gjpath->sibling_param_id)
 		gj_info.sibling_param_id = -1;
@@ -2954,6 +3876,9 @@ PlanGpuJoinPath(PlannerInfo *root,
 		gj_info.sibling_param_id = param_id;
 	}
 	gj_info.inner_parallel = gjpath->inner_parallel;
+	gj_info.inner_nparts = gjpath->inner_nparts;
+	gj_info.outer_range_key = -1;
+	gj_info.outer_range_param = -1;
 
 	outer_nrows = outer_plan->plan_rows;
 	for (i=0; i < gjpath->num_rels; i++)
@@ -3033,6 +3958,12 @@ PlanGpuJoinPath(PlannerInfo *root,
 			i_info->gist_index_ctid_resno = gjpath->inners[i].gist_ctid_resno;
 			i_info->gist_index_clause = gjpath->inners[i].gist_clause;
 		}
+		/* GpuGridIndex properties */
+		else if (gjpath->inners[i].grid_clause != NULL)
+		{
+			i_info->grid_index_resno = gjpath->inners[i].grid_resno;
+			i_info->grid_index_clause = gjpath->inners[i].grid_clause;
+		}
 		gj_info.inner_infos = lappend(gj_info.inner_infos, i_info);
 
 		outer_nrows = i_info->plan_nrows_out;
@@ -3072,12 +4003,33 @@ PlanGpuJoinPath(PlannerInfo *root,
 		}
 		gj_info.outer_quals = outer_quals;
 		gj_info.outer_refs = outer_refs;
+
+		/* skip of the outer record-batches by the inner key range */
+		assign_outer_range_pruning(root, gjpath, &gj_info, outer_relid);
 	}
 	else
 	{
+		GpuJoinInnerInfo *i_info = linitial(gj_info.inner_infos);
+
 		outerPlan(cscan) = outer_plan;
 		Assert(gjpath->outer_quals == NIL);
 		Assert(gjpath->index_opt == NULL);
+
+		/*
+		 * If outer-plan node is GpuScan, and the first depth is INNER or
+		 * SEMI hash join, GpuScan can drop the rows that never match with
+		 * the inner hash table using bloom-filter on the device side. It is not
+		 * applicable to the asymmetric partition-wise join, because inner
+		 * buffer is shared with the sibling GpuJoins, and to the partitioned
+		 * inner hash, because each pass loads only a part of inner rows.
+		 */
+		if (!gjpath->sibling_param_id &&
+			gjpath->inner_nparts <= 1 &&
+			(i_info->join_type == JOIN_INNER ||
+			 i_info->join_type == JOIN_SEMI) &&
+			i_info->hash_outer_keys != NIL)
+			pgstrom_gpuscan_add_bloom_filter(root, outer_plan,
+											 i_info->hash_outer_keys);
 	}
 	gj_info.outer_nrows_per_block = gjpath->outer_nrows_per_block;
 
@@ -3095,6 +4047,9 @@ PlanGpuJoinPath(PlannerInfo *root,
 	 */
 	gpujoin_codegen(root, cscan, gjpath, &gj_info);
 
+	/* identifier of the inner buffer to be shared with other queries */
+	gj_info.inner_cache_key = build_inner_cache_key(root, gjpath, &gj_info,
+													custom_plans);
 	form_gpujoin_info(cscan, &gj_info);
 
 	return &cscan->scan.plan;
@@ -3173,6 +4128,89 @@ assign_gpujoin_session_info(StringInfo buf, GpuTaskState *gts)
 		gjs->num_rels);
 }
 
+/*
+ * pgstrom_prebuild_gpujoin_program
+ *
+ * It kicks build of the GPU program on the final GpuJoin plan; that is
+ * equivalent to the one ExecInitGpuJoin() will create.
+ */
+void
+pgstrom_prebuild_gpujoin_program(CustomScan *cscan)
+{
+	GpuJoinInfo	   *gj_info = deform_gpujoin_info(cscan);
+	StringInfoData	kern_define;
+
+	initStringInfo(&kern_define);
+	pgstrom_build_common_session_info(&kern_define, gj_info->extra_flags);
+	appendStringInfo(&kern_define,
+					 "#define GPUJOIN_MAX_DEPTH %u\n",
+					 gj_info->num_rels);
+	pgstrom_prebuild_cuda_program(gj_info->optimal_gpu,
+								  gj_info->extra_flags,
+								  gj_info->extra_bufsz,
+								  gj_info->kern_source,
+								  kern_define.data);
+	pfree(kern_define.data);
+}
+
+/*
+ * build_outer_range_quals
+ *
+ * It makes (OUTER_KEY >= $min AND OUTER_KEY <= $max) for the arrow_fdw
+ * min/max statistics hint. The parameters are set once the inner buffer
+ * gets built, then the outer record-batches out of the range are skipped.
+ */
+static List *
+build_outer_range_quals(GpuJoinInfo *gj_info, Oid *p_type_oid)
+{
+	GpuJoinInnerInfo *i_info = linitial(gj_info->inner_infos);
+	Expr	   *o_key = list_nth(i_info->hash_outer_keys,
+								 gj_info->outer_range_key);
+	Oid			type_oid = exprType((Node *)o_key);
+	Oid			type_coll = exprCollation((Node *)o_key);
+	StrategyNumber strategy[2] = { BTGreaterEqualStrategyNumber,
+								   BTLessEqualStrategyNumber };
+	TypeCacheEntry *tcache;
+	List	   *result = NIL;
+	int			i;
+
+	tcache = lookup_type_cache(type_oid, TYPECACHE_BTREE_OPFAMILY);
+	if (!OidIsValid(tcache->btree_opf))
+		return NIL;
+	for (i=0; i < 2; i++)
+	{
+		Param  *param;
+		Expr   *expr;
+		Oid		opcode = get_opfamily_member(tcache->btree_opf,
+											 type_oid,
+											 type_oid,
+											 strategy[i]);
+		if (!OidIsValid(opcode))
+			return NIL;
+
+		param = makeNode(Param);
+		param->paramkind = PARAM_EXEC;
+		param->paramid = gj_info->outer_range_param + i;
+		param->paramtype = type_oid;
+		param->paramtypmod = -1;
+		param->paramcollid = type_coll;
+		param->location = -1;
+
+		expr = make_opclause(opcode,
+							 BOOLOID,
+							 false,
+							 (Expr *)copyObject(o_key),
+							 (Expr *)param,
+							 InvalidOid,
+							 type_coll);
+		set_opfuncid((OpExpr *)expr);
+		result = lappend(result, expr);
+	}
+	*p_type_oid = type_oid;
+
+	return result;
+}
+
 static Node *
 gpujoin_create_scan_state(CustomScan *node)
 {
@@ -3199,6 +4237,7 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 	TupleDesc		result_tupdesc = planStateResultTupleDesc(&ss->ps);
 	TupleDesc		scan_tupdesc;
 	TupleDesc		junk_tupdesc;
+	List		   *outer_quals = gj_info->outer_quals;
 	List		   *tlist_fallback = NIL;
 	bool			fallback_needs_projection = false;
 	bool			fallback_meets_resjunk = false;
@@ -3221,18 +4260,47 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 	 * Also note that the supplied TupleDesc that contains junk attributes
 	 * are still useful to run CPU fallback code. So, we keep this tuple-
 	 * descriptor to initialize the related stuff.
+	 *
+	 * The GPU kernel writes back the joined results as heap tuples in
+	 * the KDS_FORMAT_ROW buffer, so the scan slot has the fixed heap-tuple
+	 * ops. It allows the host-side projection and the upper nodes to deform
+	 * the attributes on demand, using the deform code specialized to the
+	 * scan tuple-descriptor by LLVM, if JIT (jit_tuple_deforming) is enabled.
 	 */
 	junk_tupdesc = gjs->gts.css.ss.ss_ScanTupleSlot->tts_tupleDescriptor;
 	scan_tupdesc = ExecCleanTypeFromTL(cscan->custom_scan_tlist);
 	ExecInitScanTupleSlot(estate, &gjs->gts.css.ss, scan_tupdesc,
-						  &TTSOpsVirtual);
+						  &TTSOpsHeapTuple);
 	ExecAssignScanProjectionInfoWithVarno(&gjs->gts.css.ss, INDEX_VAR);
 
+	/*
+	 * Range of the join-key on the inner buffer shall be given to the
+	 * min/max statistics hint of arrow_fdw, to skip outer record-batches
+	 * that never match.
+	 */
+	gjs->outer_range_key = -1;
+	gjs->outer_range_param = -1;
+	gjs->outer_range_type = InvalidOid;
+	if (gj_info->outer_range_key >= 0)
+	{
+		List	   *range_quals;
+		Oid			type_oid;
+
+		range_quals = build_outer_range_quals(gj_info, &type_oid);
+		if (range_quals != NIL)
+		{
+			gjs->outer_range_key = gj_info->outer_range_key;
+			gjs->outer_range_param = gj_info->outer_range_param;
+			gjs->outer_range_type = type_oid;
+			outer_quals = list_concat(list_copy(outer_quals), range_quals);
+		}
+	}
+
 	/* Setup common GpuTaskState fields */
 	pgstromInitGpuTaskState(&gjs->gts,
 							gjs->gts.gcontext,
 							GpuTaskKind_GpuJoin,
-							gj_info->outer_quals,
+							outer_quals,
 							gj_info->outer_refs,
 							gj_info->used_params,
 							gj_info->optimal_gpu,
@@ -3249,7 +4317,19 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 	gjs->h_kmrels = NULL;
 	gjs->m_kmrels = 0UL;
 	gjs->m_kmrels_owner = false;
+	gjs->m_kmrels_managed = false;
 	gjs->inner_parallel = gj_info->inner_parallel;
+	gjs->inner_nparts = gj_info->inner_nparts;
+	gjs->inner_curr_part = 0;
+	gjs->inner_cache_hash = 0;
+	gjs->inner_cache_len = 0;
+	gjs->inner_cache_tracker = NULL;
+	gjs->inner_cache_attached = false;
+	gjs->inner_cache_hit = false;
+	gjs->inner_cache_versioned = false;
+	gjs->inner_load_stream = NULL;
+	gjs->inner_load_event = NULL;
+	gjs->inner_load_hostreg = NULL;
 	gjs->preload_memcxt = AllocSetContextCreate(estate->es_query_cxt,
 												"Inner GPU Buffer Preloading",
 												ALLOCSET_DEFAULT_SIZES);
@@ -3376,7 +4456,13 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 	}
 	else
 	{
-		gjs->slot_fallback = ss->ss_ScanTupleSlot;
+		/*
+		 * CPU fallback code builds up the tuple on the tts_values/tts_isnull
+		 * by itself, so it needs a virtual slot apart from the scan slot
+		 * that has heap-tuple ops.
+		 */
+		gjs->slot_fallback = MakeSingleTupleTableSlot(junk_tupdesc,
+													  &TTSOpsVirtual);
 		gjs->proj_fallback = NULL;
 	}
 	ExecStoreAllNullTuple(gjs->slot_fallback);
@@ -3423,6 +4509,8 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 		istate->preload_nitems = 0;
 		istate->preload_usage = 0;
 		slist_init(&istate->preload_tuples);
+		istate->key_range_min = PG_INT64_MAX;
+		istate->key_range_max = PG_INT64_MIN;
 		
 		istate->depth = i + 1;
 		istate->nrows_ratio = i_info->plan_nrows_out / Max(i_info->plan_nrows_in, 1.0);
@@ -3493,6 +4581,30 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 				elog(ERROR, "GPU-GiST: wrong Var-definition for inner ctid");
 			istate->gist_ctid_resno = i_info->gist_index_ctid_resno;
 		}
+		else if (i_info->grid_index_resno > 0)
+		{
+			Expr	   *grid_clause = i_info->grid_index_clause;
+			TargetEntry	*tle;
+
+			if (i_info->grid_index_resno > list_length(inner_plan->targetlist))
+				elog(ERROR, "GPU-Grid: inner key is out of range");
+			tle = list_nth(inner_plan->targetlist,
+						   i_info->grid_index_resno - 1);
+			if (!IsA(tle->expr, Var))
+				elog(ERROR, "GPU-Grid: wrong Var-definition for inner key");
+			if (gpujoin_grid_is_range(grid_clause))
+			{
+				/* inner key is either of range or element */
+				istate->grid_is_range = true;
+			}
+			else if (exprType((Node *)tle->expr) !=
+					 exprType(linitial(((FuncExpr *)grid_clause)->args)))
+			{
+				/* all the arguments but distance are geometry */
+				elog(ERROR, "GPU-Grid: wrong Var-definition for inner key");
+			}
+			istate->grid_resno = i_info->grid_index_resno;
+		}
 
 		/*
 		 * CPU fallback setup for INNER reference
@@ -3545,6 +4657,38 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 		gjs->gts.css.custom_ps = lappend(gjs->gts.css.custom_ps,
 										 istate->state);
 	}
+
+	/*
+	 * Identifier of the inner buffer cache, if inner buffer is shareable.
+	 * Layout of the inner tuples also depends on the flatten attributes.
+	 */
+	if (gj_info->inner_cache_key)
+	{
+		StringInfoData	buf;
+
+		initStringInfo(&buf);
+		appendStringInfo(&buf, "%s :database %u",
+						 gj_info->inner_cache_key, MyDatabaseId);
+		for (i=0; i < gjs->num_rels; i++)
+		{
+			Bitmapset  *flatten_attrs = gjs->inners[i].preload_flatten_attrs;
+
+			appendStringInfo(&buf, " :flatten%d (", i+1);
+			for (j = bms_next_member(flatten_attrs, -1);
+				 j >= 0;
+				 j = bms_next_member(flatten_attrs, j))
+				appendStringInfo(&buf, " %d", j);
+			appendStringInfoChar(&buf, ')');
+		}
+		gjs->inner_cache_hash =
+			DatumGetUInt64(hash_any_extended((unsigned char *)buf.data,
+											 buf.len, 0));
+		if (gjs->inner_cache_hash == 0)
+			gjs->inner_cache_hash = 1;		/* 0 means not cacheable */
+		gjs->inner_cache_len = buf.len;
+		pfree(buf.data);
+	}
+
 	initStringInfo(&kern_define);
 	pgstrom_build_session_info(&kern_define,
 							   &gjs->gts,
@@ -3565,6 +4709,10 @@ ExecInitGpuJoin(CustomScanState *node, EState *estate, int eflags)
 						  t_bits[BITMAPLEN(result_tupdesc->natts)]) +
 				 (tupleDescHasOid(result_tupdesc) ? sizeof(Oid) : 0)) +
 		MAXALIGN(cscan->scan.plan.plan_width);	/* average width */
+
+	/* join results per source row observed by the previous executions */
+	gjs->feedback_signature = gpujoinFeedbackSignature(gjs, gj_info);
+	gjs->feedback_ratio = gpujoinFeedbackLookup(gjs);
 }
 
 /*
@@ -3583,6 +4731,34 @@ ExecReCheckGpuJoin(CustomScanState *node, TupleTableSlot *slot)
 	return true;
 }
 
+/*
+ * gpujoinSwitchInnerPartition
+ *
+ * It releases the current inner buffer, then rewinds the inner and outer
+ * relations to load the specified partition of the inner hash table.
+ */
+static void
+gpujoinSwitchInnerPartition(GpuJoinState *gjs, cl_int next_part)
+{
+	int		i;
+
+	Assert(gjs->inner_nparts > 1 && next_part < gjs->inner_nparts);
+	/* wait for completion of any asynchronous GpuTask */
+	SynchronizeGpuContext(gjs->gts.gcontext);
+	/* release the current inner buffer */
+	GpuJoinInnerUnload(&gjs->gts, true);
+	resetGpuJoinSharedState(gjs);
+	/* rewind the inner/outer relations */
+	for (i=0; i < gjs->num_rels; i++)
+		ExecReScan(gjs->inners[i].state);
+	if (outerPlanState(gjs))
+		ExecReScan(outerPlanState(gjs));
+	gjs->gts.scan_overflow = NULL;
+	pgstromRescanGpuTaskState(&gjs->gts);
+	gjs->gts.scan_done = false;
+	gjs->inner_curr_part = next_part;
+}
+
 /*
  * ExecGpuJoin
  */
@@ -3590,13 +4766,62 @@ static TupleTableSlot *
 ExecGpuJoin(CustomScanState *node)
 {
 	GpuJoinState *gjs = (GpuJoinState *) node;
+	TupleTableSlot *slot;
 
 	ActivateGpuContext(gjs->gts.gcontext);
-	if (!GpuJoinInnerPreload(&gjs->gts, NULL))
-		return NULL;
-	return ExecScan(&node->ss,
-					(ExecScanAccessMtd) pgstromExecGpuTaskState,
-					(ExecScanRecheckMtd) ExecReCheckGpuJoin);
+	for (;;)
+	{
+		if (!GpuJoinInnerPreload(&gjs->gts, NULL))
+			slot = NULL;
+		else
+			slot = ExecScan(&node->ss,
+							(ExecScanAccessMtd) pgstromExecGpuTaskState,
+							(ExecScanRecheckMtd) ExecReCheckGpuJoin);
+		if (!TupIsNull(slot) ||
+			gjs->inner_curr_part + 1 >= gjs->inner_nparts)
+			break;
+		/*
+		 * Switch to the next partition of the inner hash table, then
+		 * re-scan the inner and outer relations.
+		 */
+		gpujoinSwitchInnerPartition(gjs, gjs->inner_curr_part + 1);
+	}
+	return slot;
+}
+
+/*
+ * GpuJoinExecResultChunk
+ *
+ * It returns the next GpuJoinTask for the consumer that reads the results
+ * chunk-by-chunk (like GpuSort), instead of ExecGpuJoin. *p_pds_dst is the
+ * result buffer of the task, or NULL if CPU fallback; its tuples shall be
+ * fetched by cb_next_tuple then, prior to the next call because it may
+ * switch the partition of the inner hash table.
+ */
+GpuTask *
+GpuJoinExecResultChunk(GpuTaskState *gts, pgstrom_data_store **p_pds_dst)
+{
+	GpuJoinState   *gjs = (GpuJoinState *) gts;
+	GpuJoinTask	   *pgjoin;
+
+	ActivateGpuContext(gjs->gts.gcontext);
+	for (;;)
+	{
+		if (GpuJoinInnerPreload(&gjs->gts, NULL))
+		{
+			pgjoin = (GpuJoinTask *) pgstromFetchGpuTask(&gjs->gts);
+			if (pgjoin)
+			{
+				*p_pds_dst = (!pgjoin->task.cpu_fallback
+							  ? pgjoin->pds_dst : NULL);
+				return &pgjoin->task;
+			}
+		}
+		if (gjs->inner_curr_part + 1 >= gjs->inner_nparts)
+			break;
+		gpujoinSwitchInnerPartition(gjs, gjs->inner_curr_part + 1);
+	}
+	return NULL;
 }
 
 static void
@@ -3621,8 +4846,13 @@ ExecEndGpuJoin(CustomScanState *node)
 	}
 	/* then other private resources */
 	GpuJoinInnerUnload(&gjs->gts, false);
+	/* save the cardinality feedback for the later executions */
+	gpujoinFeedbackUpdate(gjs);
 	/* shutdown the common portion */
-	pgstromReleaseGpuTaskState(&gjs->gts, NULL);
+	pgstromReleaseGpuTaskState(&gjs->gts,
+							   gjs->gj_sstate
+							   ? &GPUJOIN_RUNTIME_STAT(gjs->gj_sstate)->c
+							   : NULL);
 }
 
 static void
@@ -3650,11 +4880,27 @@ ExecReScanGpuJoin(CustomScanState *node)
 
 			UpdateChangedParamSet(gjs->inners[i].state,
 								  gjs->gts.css.ss.ps.chgParam);
-			if (istate->state->chgParam != NULL)
+			if (istate->state->chgParam != NULL ||
+				gjs->inner_curr_part > 0)
 				ExecReScan(istate->state);
 		}
 		/* rewind the inner hash/heap buffer */
 		GpuJoinInnerUnload(&gjs->gts, true);
+		if (gjs->inner_nparts > 1)
+			resetGpuJoinSharedState(gjs);
+	}
+	else if (gjs->inner_curr_part > 0)
+	{
+		/* inner buffer keeps the last partition; reload the first one */
+		for (i=0; i < gjs->num_rels; i++)
+			ExecReScan(gjs->inners[i].state);
+		GpuJoinInnerUnload(&gjs->gts, true);
+		resetGpuJoinSharedState(gjs);
+	}
+	if (gjs->inner_nparts > 1)
+	{
+		gjs->gts.scan_done = false;
+		gjs->inner_curr_part = 0;
 	}
 	/* common rescan handling */
 	pgstromRescanGpuTaskState(&gjs->gts);
@@ -3732,6 +4978,18 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 		ExplainPropertyInteger("Inner sibling-id", NULL,
 							   gj_info->sibling_param_id, es);
 	}
+	/* number of partitions of the inner hash table at depth=1 */
+	if (gj_info->inner_nparts > 1)
+	{
+		ExplainPropertyInteger("Inner Partitions", NULL,
+							   gj_info->inner_nparts, es);
+	}
+	/* whether the inner buffer was reused from the cache */
+	if (gj_info->inner_cache_key && es->analyze && gjs->inner_cache_hash)
+	{
+		ExplainPropertyText("Inner Buffer Cache",
+							gjs->inner_cache_hit ? "hit" : "miss", es);
+	}
 
 	/* join-qualifiers */
 	depth = 1;
@@ -3745,8 +5003,10 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 		List	   *hash_outer_keys = i_info->hash_outer_keys;
 		Oid			gist_index_reloid = i_info->gist_index_reloid;
 		Expr	   *gist_index_clause = i_info->gist_index_clause;
+		Expr	   *grid_index_clause = i_info->grid_index_clause;
 		kern_data_store *kds_in = NULL;
 		kern_data_store *kds_gist = NULL;
+		kern_gpujoin_grid *grid = NULL;
 		int			indent_width;
 		double		exec_nrows_in = 0.0;
 		double		exec_nrows_out1 = 0.0;	/* by INNER JOIN */
@@ -3757,6 +5017,7 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 		{
 			kds_in = KERN_MULTIRELS_INNER_KDS(gjs->h_kmrels, depth);
 			kds_gist = KERN_MULTIRELS_GIST_INDEX(gjs->h_kmrels, depth);
+			grid = KERN_MULTIRELS_GRID_INDEX(gjs->h_kmrels, depth);
 		}
 
 		/* fetch number of rows */
@@ -3778,21 +5039,36 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 			appendStringInfo(&str, "GpuHash%sJoin",
 							 join_type == JOIN_FULL ? "Full" :
 							 join_type == JOIN_LEFT ? "Left" :
-							 join_type == JOIN_RIGHT ? "Right" : "");
+							 join_type == JOIN_RIGHT ? "Right" :
+							 join_type == JOIN_SEMI ? "Semi" :
+							 join_type == JOIN_ANTI ? "Anti" : "");
 		}
 		else if (i_info->gist_index_clause != NULL)
 		{
 			appendStringInfo(&str, "GpuGiST%sJoin",
 							 join_type == JOIN_FULL ? "Full" :
 							 join_type == JOIN_LEFT ? "Left" :
-							 join_type == JOIN_RIGHT ? "Right" : "");
+							 join_type == JOIN_RIGHT ? "Right" :
+							 join_type == JOIN_SEMI ? "Semi" :
+							 join_type == JOIN_ANTI ? "Anti" : "");
+		}
+		else if (i_info->grid_index_clause != NULL)
+		{
+			appendStringInfo(&str, "GpuGrid%sJoin",
+							 join_type == JOIN_FULL ? "Full" :
+							 join_type == JOIN_LEFT ? "Left" :
+							 join_type == JOIN_RIGHT ? "Right" :
+							 join_type == JOIN_SEMI ? "Semi" :
+							 join_type == JOIN_ANTI ? "Anti" : "");
 		}
 		else
 		{
 			appendStringInfo(&str, "GpuNestLoop%s",
 							 join_type == JOIN_FULL ? "Full" :
 							 join_type == JOIN_LEFT ? "Left" :
-							 join_type == JOIN_RIGHT ? "Right" : "");
+							 join_type == JOIN_RIGHT ? "Right" :
+							 join_type == JOIN_SEMI ? "Semi" :
+							 join_type == JOIN_ANTI ? "Anti" : "");
 		}
 		snprintf(qlabel, sizeof(qlabel), "Depth%2d", depth);
 		indent_width = es->indent * 2 + strlen(qlabel) + 2;
@@ -3844,6 +5120,11 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 					appendStringInfo(es->str, ", IndexSize: %s",
 									 format_bytesz(kds_gist->length));
 				}
+				if (grid)
+				{
+					appendStringInfo(es->str, ", Grid: %ux%u cells",
+									 grid->nx, grid->ny);
+				}
 				appendStringInfoChar(es->str, '\n');
 			}
 		}
@@ -3894,6 +5175,13 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 							 "Depth% 2d Index Size", depth);
 					ExplainPropertyInteger(qlabel, NULL, kds_gist->length, es);
 				}
+				if (grid)
+				{
+					snprintf(qlabel, sizeof(qlabel),
+							 "Depth% 2d Grid Cells", depth);
+					ExplainPropertyInteger(qlabel, NULL,
+										   grid->nx * grid->ny, es);
+				}
 			}
 		}
 
@@ -3916,6 +5204,34 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 				ExplainPropertyText(qlabel, temp, es);
 			}
 		}
+		/*
+		 * Heavy-hitters of the inner hash table, if any
+		 */
+		if (hash_outer_keys && gj_rtstat && es->analyze)
+		{
+			uint64	heavy_nkeys = pg_atomic_read_u64(&gj_rtstat->jstat[depth].heavy_nkeys);
+			uint64	heavy_nitems = pg_atomic_read_u64(&gj_rtstat->jstat[depth].heavy_nitems);
+
+			if (heavy_nkeys > 0)
+			{
+				if (es->format == EXPLAIN_FORMAT_TEXT)
+				{
+					appendStringInfoSpaces(es->str, indent_width);
+					appendStringInfo(es->str,
+									 "Heavy Hitters: %lu keys (%lu rows)\n",
+									 heavy_nkeys, heavy_nitems);
+				}
+				else
+				{
+					snprintf(qlabel, sizeof(qlabel),
+							 "Depth% 2d Heavy Hitter Keys", depth);
+					ExplainPropertyInteger(qlabel, NULL, heavy_nkeys, es);
+					snprintf(qlabel, sizeof(qlabel),
+							 "Depth% 2d Heavy Hitter Rows", depth);
+					ExplainPropertyInteger(qlabel, NULL, heavy_nitems, es);
+				}
+			}
+		}
 		/*
 		 * GiST Index, if any
 		 */
@@ -3958,29 +5274,63 @@ ExplainGpuJoin(CustomScanState *node, List *ancestors, ExplainState *es)
 			}
 		}
 		/*
-		 * JoinQuals, if any
+		 * Grid Index, if any
 		 */
-		if (join_quals)
+		if (grid_index_clause != NULL)
 		{
-			temp = deparse_expression((Node *)join_quals, dcontext,
-									  true, false);
+			temp = deparse_expression((Node *)grid_index_clause,
+									  dcontext, true, false);
 			if (es->format == EXPLAIN_FORMAT_TEXT)
 			{
 				appendStringInfoSpaces(es->str, indent_width);
-				appendStringInfo(es->str, "JoinQuals: %s\n", temp);
+				appendStringInfo(es->str, "GridFilter: %s\n", temp);
 			}
 			else
 			{
 				snprintf(qlabel, sizeof(qlabel),
-						 "Depth% 2d JoinQuals", depth);
+						 "Depth% 2d Grid Filter", depth);
 				ExplainPropertyText(qlabel, temp, es);
 			}
-		}
 
-		/*
-		 * OtherQuals, if any
-		 */
-		if (other_quals)
+			if (es->analyze)
+			{
+				if (es->format == EXPLAIN_FORMAT_TEXT)
+				{
+					appendStringInfoSpaces(es->str, indent_width);
+					appendStringInfo(es->str, "Rows Fetched by Grid: %lu\n",
+									 exec_nrows_gist);
+				}
+				else
+				{
+					ExplainPropertyInteger("Rows Fetched by Grid", NULL,
+										   exec_nrows_gist, es);
+				}
+			}
+		}
+		/*
+		 * JoinQuals, if any
+		 */
+		if (join_quals)
+		{
+			temp = deparse_expression((Node *)join_quals, dcontext,
+									  true, false);
+			if (es->format == EXPLAIN_FORMAT_TEXT)
+			{
+				appendStringInfoSpaces(es->str, indent_width);
+				appendStringInfo(es->str, "JoinQuals: %s\n", temp);
+			}
+			else
+			{
+				snprintf(qlabel, sizeof(qlabel),
+						 "Depth% 2d JoinQuals", depth);
+				ExplainPropertyText(qlabel, temp, es);
+			}
+		}
+
+		/*
+		 * OtherQuals, if any
+		 */
+		if (other_quals)
 		{
 			temp = deparse_expression((Node *)other_quals, dcontext,
 									  es->verbose, false);
@@ -4776,7 +6126,9 @@ gpujoin_codegen_gist_index_quals(StringInfo source,
 	appendStringInfo(
 		&decl,
 		"  pg_%s_t KVAR_%u;\n",
-		dtype->type_name, i_var->varattnosyn);
+		dindex->index_keytype ? dindex->index_keytype : dtype->type_name,
+		i_var->varattnosyn);
+	context->extra_flags |= dtype->type_flags;
 
 	appendStringInfoString(
 		&body,
@@ -4833,6 +6185,176 @@ gpujoin_codegen_gist_index_quals(StringInfo source,
 	pfree(unalias.data);
 }
 
+/*
+ * gpujoin_codegen_grid_index_keys
+ *
+ * It generates the function to load the outer key of the grid-index; its
+ * bounding-box expanded by the distance, if st_dwithin().
+ */
+static void
+gpujoin_codegen_grid_index_keys(StringInfo source,
+								GpuJoinInfo *gj_info,
+								GpuJoinPath *gj_path,
+								int depth,
+								codegen_context *context)
+{
+	Expr		   *grid_iarg = gj_path->inners[depth-1].grid_iarg;
+	Expr		   *grid_idist = gj_path->inners[depth-1].grid_idist;
+	List		   *kvars_list = NIL;
+	List		   *kvars_orig = NIL;
+	devtype_info   *dtype;
+	StringInfoData	body;
+	StringInfoData	decl;
+	ListCell	   *cell;
+
+	initStringInfo(&body);
+	initStringInfo(&decl);
+
+	kvars_orig = pull_var_clause((Node *)grid_iarg, 0);
+	if (grid_idist)
+		kvars_orig = list_concat_unique(kvars_orig,
+										pull_var_clause((Node *)grid_idist, 0));
+
+	dtype = pgstrom_devtype_lookup(exprType((Node *)grid_iarg));
+	if (!dtype)
+		elog(ERROR, "device type \"%s\" not found",
+			 format_type_be(exprType((Node *)grid_iarg)));
+	appendStringInfo(
+		source,
+		"/* ------------------------------------------------\n"
+		" *\n"
+		" * Grid-Index support routines (depth=%u)\n"
+		" *\n"
+		" * ------------------------------------------------ */\n"
+		"typedef struct GpuJoinGiSTKeysDepth%u_s {\n"
+		"  kern_gpujoin_grid_key INDEX_KEY;\n"
+		"  pg_%s_t INDEX_ARG;\n"
+		"  pg_float8_t INDEX_DIST;\n"
+		"} GpuJoinGiSTKeysDepth%u_t;\n",
+		depth,
+		depth, dtype->type_name,
+		depth);
+	context->extra_bufsz += MAXALIGN(dtype->extra_sz);
+
+	foreach (cell, kvars_orig)
+	{
+		Var		   *kvar = lfirst(cell);
+		bool		found = false;
+		ListCell   *lc1, *lc2, *lc3;
+
+		dtype = pgstrom_devtype_lookup(kvar->vartype);
+		if (!dtype)
+			elog(ERROR, "device type \"%s\" not found",
+				 format_type_be(kvar->vartype));
+
+		forthree (lc1, context->pseudo_tlist,
+				  lc2, gj_info->ps_src_depth,
+				  lc3, gj_info->ps_src_resno)
+		{
+			TargetEntry *tle = lfirst(lc1);
+			int		src_depth = lfirst_int(lc2);
+			int		src_resno = lfirst_int(lc3);
+			Var	   *varnode;
+
+			if (equal(tle->expr, kvar))
+			{
+				varnode = makeVar(src_depth,
+								  src_resno,
+								  kvar->vartype,
+								  kvar->vartypmod,
+								  kvar->varcollid,
+								  kvar->varlevelsup);
+				varnode->varattnosyn = tle->resno;
+				if (src_depth < 0 || src_depth >= depth)
+					elog(ERROR, "Bug? device varnode out of range");
+				kvars_list = lappend(kvars_list, varnode);
+				appendStringInfo(&decl,
+								 "  pg_%s_t  KVAR_%u;\n",
+								 dtype->type_name,
+								 tle->resno);
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			elog(ERROR, "Bug? device varnode was not on the ps_tlist: %s",
+				 nodeToString(kvar));
+	}
+	__gpujoin_codegen_decl_variables(&body, depth, kvars_list);
+
+	context->used_vars = NIL;
+	appendStringInfo(
+		&body,
+		"  keys->INDEX_ARG = %s;\n",
+		pgstrom_codegen_expression((Node *)grid_iarg, context));
+	if (grid_idist)
+		appendStringInfo(
+			&body,
+			"  keys->INDEX_DIST = %s;\n",
+			pgstrom_codegen_expression((Node *)grid_idist, context));
+	else
+		appendStringInfoString(
+			&body,
+			"  keys->INDEX_DIST.isnull = false;\n"
+			"  keys->INDEX_DIST.value = 0.0;\n");
+	if (gpujoin_grid_is_range(gj_path->inners[depth-1].grid_clause))
+	{
+		/* 1D bounding-box of the range */
+		appendStringInfoString(
+			&body,
+			"  keys->INDEX_KEY.isnull =\n"
+			"    !pgindex_grid_range_bbox(kcxt, keys->INDEX_ARG,\n"
+			"                             &keys->INDEX_KEY.xmin,\n"
+			"                             &keys->INDEX_KEY.xmax);\n"
+			"  keys->INDEX_KEY.ymin = 0.0;\n"
+			"  keys->INDEX_KEY.ymax = 0.0;\n");
+	}
+	else
+	{
+		appendStringInfoString(
+			&decl,
+			"  geom_bbox_2d bbox;\n");
+		appendStringInfoString(
+			&body,
+			"  keys->INDEX_KEY.isnull =\n"
+			"    !pgindex_grid_geometry_bbox(kcxt, &bbox,\n"
+			"                                keys->INDEX_ARG,\n"
+			"                                keys->INDEX_DIST);\n"
+			"  keys->INDEX_KEY.xmin = bbox.xmin;\n"
+			"  keys->INDEX_KEY.xmax = bbox.xmax;\n"
+			"  keys->INDEX_KEY.ymin = bbox.ymin;\n"
+			"  keys->INDEX_KEY.ymax = bbox.ymax;\n");
+	}
+
+	appendStringInfo(
+		source,
+		"\n"
+		"STATIC_FUNCTION(cl_bool)\n"
+		"gpujoin_gist_load_keys_depth%d(kern_context *kcxt,\n"
+		"                              kern_multirels *kmrels,\n"
+		"                              kern_data_store *kds,\n"
+		"                              kern_data_extra *extra,\n"
+		"                              cl_uint *o_buffer,\n"
+		"                              void *__keys)\n"
+		"{\n"
+		"  GpuJoinGiSTKeysDepth%u_t *keys = (GpuJoinGiSTKeysDepth%u_t *)__keys;\n"
+		"  HeapTupleHeaderData *htup  __attribute__((unused));\n"
+		"  kern_data_store *kds_in    __attribute__((unused));\n"
+		"  void *datum                __attribute__((unused));\n"
+		"  cl_uint offset             __attribute__((unused));\n"
+		"%s\n%s"
+		"  return (kcxt->errcode == ERRCODE_STROM_SUCCESS);\n"
+		"}\n\n",
+		depth,
+		depth, depth,
+		decl.data,
+		body.data);
+
+	/* cleanup */
+	pfree(decl.data);
+	pfree(body.data);
+}
+
 /*
  * gpujoin_codegen_projection
  *
@@ -5412,8 +6934,9 @@ gpujoin_codegen(PlannerInfo *root,
 		sz = sizeof(cl_uint) * (depth+1) * GPUJOIN_PSEUDO_STACK_NROOMS;
 		pstack->ps_offset[depth] = off;
 		off += sz;
-		/* GiST-index support needs extra pseudo-stack */
-		if (depth > 0 && gj_path->inners[depth-1].gist_clause != NULL)
+		/* GiST-/Grid-index support needs extra pseudo-stack */
+		if (depth > 0 && (gj_path->inners[depth-1].gist_clause != NULL ||
+						  gj_path->inners[depth-1].grid_clause != NULL))
 			off += sz;
 	}
 	pstack->ps_unitsz = off;
@@ -5554,6 +7077,18 @@ gpujoin_codegen(PlannerInfo *root,
 										 &context);
 		extra_bufsz = Max(extra_bufsz, context.extra_bufsz);
 	}
+	for (depth=0; depth < gj_path->num_rels; depth++)
+	{
+		if (!gj_path->inners[depth].grid_clause)
+			continue;
+		context.extra_bufsz = 0;
+		gpujoin_codegen_grid_index_keys(&source,
+										gj_info,
+										gj_path,
+										depth+1,
+										&context);
+		extra_bufsz = Max(extra_bufsz, context.extra_bufsz);
+	}
 
 	appendStringInfoString(
 		 &source,
@@ -5567,7 +7102,8 @@ gpujoin_codegen(PlannerInfo *root,
 		 "{\n");
 	for (depth=0; depth < gj_path->num_rels; depth++)
 	{
-		if (!gj_path->inners[depth].gist_index)
+		if (!gj_path->inners[depth].gist_index &&
+			!gj_path->inners[depth].grid_clause)
 			continue;
 		appendStringInfo(
 			&source,
@@ -5689,6 +7225,42 @@ GpuJoinSetupTask(struct kern_gpujoin *kgjoin, GpuTaskState *gts,
 			mp_count * suspend_sz);
 }
 
+/*
+ * gpujoin_result_buffer_length
+ *
+ * It estimates the length of the result buffer for the source chunk, by the
+ * number of join results per source row. Too small buffer makes the kernel
+ * suspend and resume repeatedly, so the buffer is expanded up to
+ * GPUJOIN_RESULT_BUFFER_MAX_EXPANSION times of the chunk size.
+ */
+#define GPUJOIN_RESULT_BUFFER_MAX_EXPANSION		4
+
+static size_t
+gpujoin_result_buffer_length(GpuJoinState *gjs,
+							 pgstrom_data_store *pds_src)
+{
+	size_t		chunk_sz = pgstrom_chunk_size();
+	double		nrows;
+	double		length;
+
+	if (!pds_src)
+		return chunk_sz;
+	if (pds_src->kds.format != KDS_FORMAT_BLOCK)
+		nrows = pds_src->kds.nitems;
+	else if (gjs->gts.outer_nrows_per_block > 0)
+		nrows = (double)pds_src->kds.nitems * gjs->gts.outer_nrows_per_block;
+	else
+		return chunk_sz;
+
+	length = (1.2 * nrows * GpuJoinEstimateResultRatio(&gjs->gts) *
+			  (double)(MAXALIGN(offsetof(kern_tupitem, htup) +
+								gjs->result_width) + sizeof(cl_uint)));
+	if (length <= (double)chunk_sz)
+		return chunk_sz;
+	return (size_t)Min(length, (double)(GPUJOIN_RESULT_BUFFER_MAX_EXPANSION *
+										 chunk_sz));
+}
+
 /*
  * gpujoin_create_task
  */
@@ -5722,7 +7294,8 @@ gpujoin_create_task(GpuJoinState *gjs,
 	pgjoin->pds_src = pds_src;
 	pgjoin->pds_dst = PDS_create_row(gcontext,
 									 scan_tupdesc,
-									 pgstrom_chunk_size());
+									 gpujoin_result_buffer_length(gjs,
+																  pds_src));
 	pgjoin->outer_depth = outer_depth;
 
 	/* Is NVMe-Strom available to run this GpuJoin? */
@@ -5846,6 +7419,10 @@ gpujoinNextRightOuterJoinIfAny(GpuTaskState *gts)
 	int				i, dindex = gcontext->cuda_dindex;
 	int				depth = -1;
 	uint32			needs_colocation;
+	uint32			ngpus;
+	bool			peer_merge;
+	bool			host_merge;
+	bool			is_first = false;
 
 	if (gjs->sibling)
 	{
@@ -5890,17 +7467,17 @@ gpujoinNextRightOuterJoinIfAny(GpuTaskState *gts)
 	/*
 	 * In case when RIGHT/FULL OUTER JOIN was processed on multiple
 	 * GPU devices, or CPU fallback happen, we must collocate the
-	 * outer-join-map once.
+	 * outer-join-map once. If all the GPU devices can access each
+	 * other by P2P, the last player merges the outer-join-map of
+	 * other devices on its own device. Elsewhere, they are merged
+	 * on the host buffer.
 	 */
 	needs_colocation = pg_atomic_read_u32(&gj_sstate->needs_colocation);
-	if (needs_colocation > 1)
-		gpujoinColocateOuterJoinMapsToHost(gjs);
+	ngpus = (needs_colocation & ~GPUJOIN_OJMAPS_FALLBACK);
+	peer_merge = (ngpus > 1 && gpujoinOuterJoinMapsPeerAccessible());
+	host_merge = ((needs_colocation & GPUJOIN_OJMAPS_FALLBACK) != 0 ||
+				  (ngpus > 1 && !peer_merge));
 
-	/*
-	 * If this process is exactly the last player for the RIGHT/FULL
-	 * OUTER JOIN, we suggest to kick GpuJoin kernel with NULL outer
-	 * buffer from a particular depth.
-	 */
 	Assert(gj_sstate->pergpu[dindex].nr_workers_gpujoin == 1);
 	for (i=0; i < numDevAttrs; i++)
 	{
@@ -5909,10 +7486,28 @@ gpujoinNextRightOuterJoinIfAny(GpuTaskState *gts)
 		if (gj_sstate->pergpu[i].nr_workers_gpujoin > 0)
 			break;
 	}
-	if (i >= numDevAttrs)
+	if (i < numDevAttrs)
+	{
+		/*
+		 * GpuJoin is still running on the other GPU devices, so the last
+		 * player there shall process RIGHT/FULL OUTER JOIN. Outer-join-map
+		 * of this device is written back to the host, unless it is merged
+		 * using P2P access.
+		 */
+		if (!peer_merge)
+			gpujoinColocateOuterJoinMapsToHost(gjs);
+		gj_sstate->pergpu[dindex].nr_workers_gpujoin--;
+	}
+	else
 	{
+		/*
+		 * This process is exactly the last player for the RIGHT/FULL
+		 * OUTER JOIN, we suggest to kick GpuJoin kernel with NULL outer
+		 * buffer from a particular depth.
+		 */
 		int		__depth;
 
+		is_first = (gj_sstate->curr_outer_depth < 1);
 		for (__depth = Max(gj_sstate->curr_outer_depth + 1, 1);
 			 __depth <= gjs->num_rels;
 			 __depth++)
@@ -5924,26 +7519,37 @@ gpujoinNextRightOuterJoinIfAny(GpuTaskState *gts)
 				break;
 			}
 		}
-		/*
-		 * Once colocation happened, outer-join-map at the GPU device
-		 * memory is not latest. So, refresh it.
-		 */
-		if (depth >= 0 && needs_colocation > 1)
+	}
+	SpinLockRelease(&gj_sstate->mutex);
+
+	/*
+	 * No other processes touch the outer-join-map any more, so we can
+	 * colocate them without the lock.
+	 */
+	if (depth > 0)
+	{
+		if (is_first && peer_merge)
+			gpujoinColocateOuterJoinMapsOnDevice(gjs);
+		if (host_merge)
 		{
 			size_t		offset = h_kmrels->kmrels_length;
 			size_t		length = MAXALIGN(h_kmrels->ojmaps_length);
 			CUresult	rc;
 
+			gpujoinColocateOuterJoinMapsToHost(gjs);
+			/*
+			 * Once colocation happened, outer-join-map at the GPU device
+			 * memory is not latest. So, refresh it.
+			 */
 			rc = cuMemcpyHtoD(gjs->m_kmrels + offset,
 							  (char *)h_kmrels + offset,
 							  length);
 			if (rc != CUDA_SUCCESS)
-			{
-				 SpinLockRelease(&gj_sstate->mutex);
-				 elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
-			}
+				elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
 		}
 	}
+	return depth;
+
 out_unlock:
 	SpinLockRelease(&gj_sstate->mutex);
 	return depth;
@@ -6173,6 +7779,15 @@ gpujoinFallbackHashJoin(int depth, GpuJoinState *gjs)
 	cl_uint			hash;
 	bool			retval;
 
+	/*
+	 * SEMI join emits the outer row only once, and ANTI join never emits
+	 * the outer row that has any matched inner rows.
+	 */
+	if (istate->fallback_inner_matched &&
+		(istate->join_type == JOIN_SEMI ||
+		 istate->join_type == JOIN_ANTI))
+		return depth-1;
+
 	do {
 		if (istate->fallback_inner_index == 0)
 		{
@@ -6219,6 +7834,9 @@ gpujoinFallbackHashJoin(int depth, GpuJoinState *gjs)
 	/* update outer join map */
 	if (ojmaps)
 		ojmaps[khitem->t.rowid] = 1;
+	istate->fallback_inner_matched = true;
+	if (istate->join_type == JOIN_ANTI)
+		return depth-1;
 	/* rewind the next depth */
 	if (depth < gjs->num_rels)
 	{
@@ -6231,7 +7849,8 @@ gpujoinFallbackHashJoin(int depth, GpuJoinState *gjs)
 end:
 	if (!istate->fallback_inner_matched &&
 		(istate->join_type == JOIN_LEFT ||
-		 istate->join_type == JOIN_FULL))
+		 istate->join_type == JOIN_FULL ||
+		 istate->join_type == JOIN_ANTI))
 	{
 		istate->fallback_inner_matched = true;
 		gpujoin_fallback_tuple_extract(gjs->slot_fallback,
@@ -6607,7 +8226,20 @@ lnext:
 			cl_bool		matched = sb->pd[depth+1].matched[local_id];
 
 			kds_in = KERN_MULTIRELS_INNER_KDS(h_kmrels, depth+1);
-			if (kds_in->format == KDS_FORMAT_HASH)
+			if (KERN_MULTIRELS_GRID_INDEX(h_kmrels, depth+1))
+			{
+				/* l_state is a position on the grid-index, not on the KDS */
+				if (l_state == 0)
+					istate->fallback_inner_index = 0;
+				else if (l_state == UINT_MAX)
+				{
+					gjs->fallback_thread_count = (thread_index + 1) << 10;
+					goto lnext;
+				}
+				else
+					elog(ERROR, "CPU fallback cannot resume the grid-index search at depth %d", depth+1);
+			}
+			else if (kds_in->format == KDS_FORMAT_HASH)
 			{
 				if (l_state == 0)
 				{
@@ -6704,9 +8336,9 @@ gpujoinNextTupleFallback(GpuTaskState *gts,
 		/*
 		 * Once CPU fallback happen, RIGHT/FULL OUTER JOIN map must
 		 * be colocated, regardless of the number of GPU devices.
-		 * So, we ensure colocation by setting number larger than 1.
 		 */
-		pg_atomic_write_u32(&gj_sstate->needs_colocation, 123);
+		pg_atomic_fetch_or_u32(&gj_sstate->needs_colocation,
+							   GPUJOIN_OJMAPS_FALLBACK);
 		
 		depth = outer_depth;
 	}
@@ -6745,6 +8377,19 @@ gpujoinNextTupleFallback(GpuTaskState *gts,
 			/* projection? */
 			if (gjs->proj_fallback)
 				slot = ExecProject(gjs->proj_fallback);
+			else
+			{
+				TupleTableSlot *scan_slot = gjs->gts.css.ss.ss_ScanTupleSlot;
+				int			natts = scan_slot->tts_tupleDescriptor->natts;
+
+				/* all the attributes are already valid, like ExecProject */
+				ExecClearTuple(scan_slot);
+				memcpy(scan_slot->tts_values, slot->tts_values,
+					   sizeof(Datum) * natts);
+				memcpy(scan_slot->tts_isnull, slot->tts_isnull,
+					   sizeof(bool) * natts);
+				slot = ExecStoreVirtualTuple(scan_slot);
+			}
 			Assert(slot == gjs->gts.css.ss.ss_ScanTupleSlot);
 			return slot;
 		}
@@ -6850,49 +8495,216 @@ gpujoin_release_task(GpuTask *gtask)
 	gpuMemFree(gts->gcontext, (CUdeviceptr)pgjoin);
 }
 
-void
-gpujoinUpdateRunTimeStat(GpuTaskState *gts, kern_gpujoin *kgjoin)
+/*
+ * GpuJoinEstimateResultRatio
+ *
+ * It returns number of the join results per source row; by the run-time
+ * statistics once enough rows were processed, by the feedback from the
+ * previous executions of the same plan, or by the planner estimation.
+ * Combined GpuPreAgg uses this ratio to size its intermediate buffer, and
+ * GpuJoin also uses it to size the result buffer.
+ */
+double
+GpuJoinEstimateResultRatio(GpuTaskState *gts)
 {
 	GpuJoinState	   *gjs = (GpuJoinState *)gts;
-	GpuJoinRuntimeStat *gj_rtstat = GPUJOIN_RUNTIME_STAT(gjs->gj_sstate);
-	cl_int		i;
+	GpuJoinRuntimeStat *gj_rtstat;
+	uint64		source_nitems;
+	uint64		result_nitems;
 
-	pg_atomic_fetch_add_u64(&gj_rtstat->c.source_nitems,
-							kgjoin->source_nitems);
-	pg_atomic_fetch_add_u64(&gj_rtstat->c.nitems_filtered,
-							kgjoin->source_nitems -
-							kgjoin->outer_nitems);
-	pg_atomic_fetch_add_u64(&gj_rtstat->jstat[0].inner_nitems,
-							kgjoin->outer_nitems);
-	for (i=0; i < gjs->num_rels; i++)
-	{
-		pg_atomic_fetch_add_u64(&gj_rtstat->jstat[i+1].inner_nitems,
-								kgjoin->stat[i].nitems);
-		pg_atomic_fetch_add_u64(&gj_rtstat->jstat[i+1].inner_nitems2,
-								kgjoin->stat[i].nitems2);
-	}
-	/* debug counters if any */
-	if (kgjoin->debug_counter0 != 0)
-		pg_atomic_fetch_add_u64(&gj_rtstat->c.debug_counter0, kgjoin->debug_counter0);
-	if (kgjoin->debug_counter1 != 0)
-		pg_atomic_fetch_add_u64(&gj_rtstat->c.debug_counter1, kgjoin->debug_counter1);
-	if (kgjoin->debug_counter2 != 0)
-		pg_atomic_fetch_add_u64(&gj_rtstat->c.debug_counter2, kgjoin->debug_counter2);
-	if (kgjoin->debug_counter3 != 0)
-		pg_atomic_fetch_add_u64(&gj_rtstat->c.debug_counter3, kgjoin->debug_counter3);
-	
-	/* reset counters (may be reused by the resumed kernel) */
-	kgjoin->source_nitems = 0;
-	kgjoin->outer_nitems  = 0;
-	for (i=0; i < gjs->num_rels; i++)
+	if (gjs->gj_sstate)
 	{
-		kgjoin->stat[i].nitems = 0;
-		kgjoin->stat[i].nitems2 = 0;
-	}
+		gj_rtstat = GPUJOIN_RUNTIME_STAT(gjs->gj_sstate);
+		source_nitems = pg_atomic_read_u64(&gj_rtstat->c.source_nitems);
+		result_nitems = (pg_atomic_read_u64(&gj_rtstat->jstat[gjs->num_rels].inner_nitems) +
+						 pg_atomic_read_u64(&gj_rtstat->jstat[gjs->num_rels].right_nitems));
+		if (source_nitems >= 10000)
+			return (double)result_nitems / (double)source_nitems;
+	}
+	if (gjs->feedback_ratio >= 0.0)
+		return gjs->feedback_ratio;
+	if (gjs->outer_nrows > 0.0)
+		return gjs->gts.css.ss.ps.plan->plan_rows / gjs->outer_nrows;
+	return 1.0;
 }
 
 /*
- * gpujoin_throw_partial_result
+ * Cardinality feedback of GpuJoin
+ *
+ * Once GpuJoin gets completed, the number of rows per depth in the run-time
+ * statistics are saved per plan signature; hash of the GPU kernel source and
+ * the outer relation. The later executions of the same plan (usually,
+ * prepared statements or cached plans) use the selectivity of the outer
+ * quals and the fan-out for each depth, instead of the planner estimation,
+ * to size the result buffer prior to the run-time statistics get enough.
+ * The entries are local to the backend, like the plan cache.
+ */
+#define GPUJOIN_FEEDBACK_MAX_ENTRIES	1024
+#define GPUJOIN_FEEDBACK_MIN_NITEMS		1000
+
+typedef struct
+{
+	uint64		signature;		/* hash key */
+	int			num_rels;
+	cl_uint		nloops;			/* # of executions merged */
+	double	   *ratios;			/* [0]: selectivity of the outer quals,
+								 * [depth]: fan-out of the depth */
+} gpujoinFeedbackEntry;
+
+static uint64
+gpujoinFeedbackSignature(GpuJoinState *gjs, GpuJoinInfo *gj_info)
+{
+	Relation	outer_rel = gjs->gts.css.ss.ss_currentRelation;
+	const char *source = gj_info->kern_source;
+	uint64		seed = (outer_rel ? RelationGetRelid(outer_rel) : 0);
+	uint64		signature;
+
+	if (!source)
+		return 0;
+	signature = DatumGetUInt64(hash_any_extended((const unsigned char *)source,
+												 strlen(source), seed));
+	return (signature != 0 ? signature : 1);	/* 0 means no feedback */
+}
+
+static double
+gpujoinFeedbackLookup(GpuJoinState *gjs)
+{
+	gpujoinFeedbackEntry *entry;
+	double		ratio;
+	int			depth;
+
+	if (!gj_feedback_htab || gjs->feedback_signature == 0)
+		return -1.0;
+	entry = hash_search(gj_feedback_htab,
+						&gjs->feedback_signature,
+						HASH_FIND, NULL);
+	if (!entry || entry->num_rels != gjs->num_rels)
+		return -1.0;
+	ratio = 1.0;
+	for (depth=0; depth <= entry->num_rels; depth++)
+		ratio *= entry->ratios[depth];
+	return ratio;
+}
+
+static void
+gpujoinFeedbackUpdate(GpuJoinState *gjs)
+{
+	GpuJoinRuntimeStat *gj_rtstat;
+	gpujoinFeedbackEntry *entry;
+	uint64		source_nitems;
+	uint64		nitems_prev;
+	uint64		nitems;
+	bool		found;
+	int			depth;
+
+	if (gjs->feedback_signature == 0 ||
+		!gjs->gj_sstate ||
+		IsParallelWorker())
+		return;
+	gj_rtstat = GPUJOIN_RUNTIME_STAT(gjs->gj_sstate);
+	source_nitems = pg_atomic_read_u64(&gj_rtstat->c.source_nitems);
+	if (source_nitems < GPUJOIN_FEEDBACK_MIN_NITEMS)
+		return;
+
+	if (!gj_feedback_htab)
+	{
+		HASHCTL		hctl;
+
+		memset(&hctl, 0, sizeof(HASHCTL));
+		hctl.keysize = sizeof(uint64);
+		hctl.entrysize = sizeof(gpujoinFeedbackEntry);
+		hctl.hcxt = TopMemoryContext;
+		gj_feedback_htab = hash_create("GpuJoin cardinality feedback",
+									   256, &hctl,
+									   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+	entry = hash_search(gj_feedback_htab,
+						&gjs->feedback_signature,
+						HASH_FIND, NULL);
+	if (!entry)
+	{
+		if (hash_get_num_entries(gj_feedback_htab) >= GPUJOIN_FEEDBACK_MAX_ENTRIES)
+			return;
+		entry = hash_search(gj_feedback_htab,
+							&gjs->feedback_signature,
+							HASH_ENTER, &found);
+		Assert(!found);
+		entry->num_rels = gjs->num_rels;
+		entry->nloops = 0;
+		entry->ratios = MemoryContextAllocZero(TopMemoryContext,
+											   sizeof(double) *
+											   (gjs->num_rels + 1));
+	}
+	else if (entry->num_rels != gjs->num_rels)
+		return;		/* hash collision? */
+
+	nitems_prev = source_nitems;
+	for (depth=0; depth <= gjs->num_rels; depth++)
+	{
+		double		ratio;
+
+		nitems = pg_atomic_read_u64(&gj_rtstat->jstat[depth].inner_nitems);
+		if (depth > 0)
+			nitems += pg_atomic_read_u64(&gj_rtstat->jstat[depth].right_nitems);
+		ratio = (nitems_prev > 0 ? (double)nitems / (double)nitems_prev : 0.0);
+		/* the latest execution has the same weight with the history */
+		if (entry->nloops == 0)
+			entry->ratios[depth] = ratio;
+		else
+			entry->ratios[depth] = 0.5 * (entry->ratios[depth] + ratio);
+		nitems_prev = nitems;
+	}
+	entry->nloops++;
+}
+
+void
+gpujoinUpdateRunTimeStat(GpuTaskState *gts, kern_gpujoin *kgjoin)
+{
+	GpuJoinState	   *gjs = (GpuJoinState *)gts;
+	GpuJoinRuntimeStat *gj_rtstat = GPUJOIN_RUNTIME_STAT(gjs->gj_sstate);
+	cl_int		i;
+
+	pg_atomic_fetch_add_u64(&gj_rtstat->c.source_nitems,
+							kgjoin->source_nitems);
+	pg_atomic_fetch_add_u64(&gj_rtstat->c.nitems_filtered,
+							kgjoin->source_nitems -
+							kgjoin->outer_nitems);
+	pg_atomic_fetch_add_u64(&gj_rtstat->jstat[0].inner_nitems,
+							kgjoin->outer_nitems);
+	for (i=0; i < gjs->num_rels; i++)
+	{
+		pg_atomic_fetch_add_u64(&gj_rtstat->jstat[i+1].inner_nitems,
+								kgjoin->stat[i].nitems);
+		pg_atomic_fetch_add_u64(&gj_rtstat->jstat[i+1].inner_nitems2,
+								kgjoin->stat[i].nitems2);
+	}
+	/* debug counters if any */
+	if (kgjoin->debug_counter0 != 0)
+		pg_atomic_fetch_add_u64(&gj_rtstat->c.debug_counter0, kgjoin->debug_counter0);
+	if (kgjoin->debug_counter1 != 0)
+		pg_atomic_fetch_add_u64(&gj_rtstat->c.debug_counter1, kgjoin->debug_counter1);
+	if (kgjoin->debug_counter2 != 0)
+		pg_atomic_fetch_add_u64(&gj_rtstat->c.debug_counter2, kgjoin->debug_counter2);
+	if (kgjoin->debug_counter3 != 0)
+		pg_atomic_fetch_add_u64(&gj_rtstat->c.debug_counter3, kgjoin->debug_counter3);
+	
+	/* reset counters (may be reused by the resumed kernel) */
+	kgjoin->source_nitems = 0;
+	kgjoin->outer_nitems  = 0;
+	for (i=0; i < gjs->num_rels; i++)
+	{
+		kgjoin->stat[i].nitems = 0;
+		kgjoin->stat[i].nitems2 = 0;
+	}
+}
+
+/*
+ * gpujoin_throw_partial_result
+ *
+ * It returns the result buffer filled up by the kernel, then assigns a new
+ * empty one to resume the kernel. The new buffer is twice larger than the
+ * previous one (up to GPUJOIN_RESULT_BUFFER_MAX_EXPANSION times of the
+ * chunk size), so explosive joins don't repeat suspend/resume many times.
  */
 static void
 gpujoin_throw_partial_result(GpuJoinTask *pgjoin)
@@ -6900,13 +8712,21 @@ gpujoin_throw_partial_result(GpuJoinTask *pgjoin)
 	GpuContext	   *gcontext = GpuWorkerCurrentContext;
 	GpuTaskState   *gts = pgjoin->task.gts;
 	pgstrom_data_store *pds_dst = pgjoin->pds_dst;
-	pgstrom_data_store *pds_new = PDS_clone(pds_dst);
+	pgstrom_data_store *pds_new;
+	size_t			length_max = (GPUJOIN_RESULT_BUFFER_MAX_EXPANSION *
+								  (size_t)pgstrom_chunk_size());
 	cl_int			num_rels = pgjoin->kern.num_rels;
 	GpuJoinTask	   *gresp;
 	size_t			head_sz;
 	size_t			param_sz;
 	CUresult		rc;
 
+	if (pds_dst->kds.length < length_max)
+		pds_new = PDS_clone_row(pds_dst, Min(2 * pds_dst->kds.length,
+											 length_max));
+	else
+		pds_new = PDS_clone(pds_dst);
+
 	/* async prefetch kds_dst; which should be on the device memory */
 	rc = cuMemPrefetchAsync((CUdeviceptr) &pds_dst->kds,
 							pds_dst->kds.length,
@@ -6981,6 +8801,137 @@ gpujoinColocateOuterJoinMapsToHost(GpuJoinState *gjs)
 	}
 }
 
+/*
+ * gpujoinOuterJoinMapsPeerAccessible
+ *
+ * It checks whether all the GPU devices can access each other by P2P,
+ * to merge the outer-join-map on the device memory.
+ */
+static bool
+gpujoinOuterJoinMapsPeerAccessible(void)
+{
+	static int		peer_accessible = -1;	/* unknown */
+	CUdevice		device_i;
+	CUdevice		device_j;
+	CUresult		rc;
+	int				i, j, can_access;
+
+	if (peer_accessible >= 0)
+		return (peer_accessible > 0);
+
+	for (i=0; i < numDevAttrs; i++)
+	{
+		rc = cuDeviceGet(&device_i, devAttrs[i].DEV_ID);
+		if (rc != CUDA_SUCCESS)
+			goto not_accessible;
+		for (j=0; j < numDevAttrs; j++)
+		{
+			if (i == j)
+				continue;
+			rc = cuDeviceGet(&device_j, devAttrs[j].DEV_ID);
+			if (rc != CUDA_SUCCESS)
+				goto not_accessible;
+			rc = cuDeviceCanAccessPeer(&can_access, device_i, device_j);
+			if (rc != CUDA_SUCCESS || !can_access)
+				goto not_accessible;
+		}
+	}
+	peer_accessible = 1;
+	return true;
+
+not_accessible:
+	peer_accessible = 0;
+	return false;
+}
+
+/*
+ * gpujoinColocateOuterJoinMapsOnDevice
+ *
+ * It merges outer-join-map on the other GPU devices to the one on the
+ * current device, by P2P access. Like gpujoinColocateOuterJoinMapsToHost,
+ * no GPU kernel shall be working on the peer devices when it is called.
+ */
+static void
+gpujoinColocateOuterJoinMapsOnDevice(GpuJoinState *gjs)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
+	CUmodule		cuda_module;
+	CUfunction		kern_colocate;
+	CUdeviceptr		m_peer;
+	CUresult		rc;
+	void		   *kern_args[2];
+	cl_int			grid_sz;
+	cl_int			block_sz;
+	int				peer, dindex = gcontext->cuda_dindex;
+
+	GPUCONTEXT_PUSH(gcontext);
+	cuda_module = GpuContextLookupModule(gcontext, gjs->gts.program_id);
+	rc = cuModuleGetFunction(&kern_colocate,
+							 cuda_module,
+							 "gpujoin_colocate_outer_join_map");
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_colocate,
+							 gcontext->cuda_device,
+							 0, 0);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
+
+	for (peer=0; peer < numDevAttrs; peer++)
+	{
+		if (peer == dindex || gj_sstate->pergpu[peer].bytesize == 0)
+			continue;
+		rc = gpuIpcOpenMemHandle(gcontext,
+								 &m_peer,
+								 gj_sstate->pergpu[peer].ipc_mhandle,
+								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+
+		kern_args[0] = &gjs->m_kmrels;
+		kern_args[1] = &m_peer;
+		rc = cuLaunchKernel(kern_colocate,
+							grid_sz, 1, 1,
+							block_sz, 1, 1,
+							0,
+							CU_STREAM_PER_THREAD,
+							kern_args,
+							NULL);
+		if (rc == CUDA_SUCCESS)
+			rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+		if (gpuIpcCloseMemHandle(gcontext, m_peer) != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuIpcCloseMemHandle");
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on outer-join-map colocation (GPU%d->GPU%d): %s",
+				 peer, dindex, errorText(rc));
+	}
+	GPUCONTEXT_POP(gcontext);
+}
+
+/*
+ * gpujoin_writeback_result
+ *
+ * It kicks the download of the final result buffer prior to the return of
+ * the task, instead of the page faults on the backend's access.
+ */
+static void
+gpujoin_writeback_result(pgstrom_data_store *pds_dst)
+{
+	CUresult	rc;
+
+	rc = cuMemPrefetchAsync((CUdeviceptr) &pds_dst->kds,
+							pds_dst->kds.length,
+							CU_DEVICE_CPU,
+							CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+	gpuTaskStageDma(0, pds_dst->kds.length);
+	gpuTaskStageMark(GPUTASK_STAGE__DMA_RECV, CU_STREAM_PER_THREAD);
+}
+
 static cl_int
 gpujoin_process_inner_join(GpuJoinTask *pgjoin, CUmodule cuda_module)
 {
@@ -7071,6 +9022,7 @@ gpujoin_process_inner_join(GpuJoinTask *pgjoin, CUmodule cuda_module)
 	/*
 	 * OK, kick a series of GpuJoin invocations
 	 */
+	gpuTaskStageMark(GPUTASK_STAGE__QUEUE, CU_STREAM_PER_THREAD);
 	if (pgjoin->with_nvme_strom)
 	{
 		gpuMemCopyFromSSD(m_kds_src, pds_src);
@@ -7083,6 +9035,7 @@ gpujoin_process_inner_join(GpuJoinTask *pgjoin, CUmodule cuda_module)
 							   CU_STREAM_PER_THREAD);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemcpyHtoD: %s", errorText(rc));
+		gpuTaskStageDma(pds_src->kds.length, 0);
 
 	}
 	else if (pds_src->kds.format != KDS_FORMAT_COLUMN)
@@ -7093,7 +9046,10 @@ gpujoin_process_inner_join(GpuJoinTask *pgjoin, CUmodule cuda_module)
 								CU_STREAM_PER_THREAD);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		gpuTaskStageDma(pds_src->kds.length, 0);
 	}
+	/* inner buffer may be still under the asynchronous copy */
+	GpuJoinInnerSyncDeviceBuffer(&gjs->gts);
 
 	/* Launch:
 	 * KERNEL_FUNCTION(void)
@@ -7113,6 +9069,7 @@ gpujoin_process_inner_join(GpuJoinTask *pgjoin, CUmodule cuda_module)
 		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
 	pgjoin->kern.grid_sz	= grid_sz;
 	pgjoin->kern.block_sz	= block_sz;
+	gpuTaskStageMark(GPUTASK_STAGE__DMA_SEND, CU_STREAM_PER_THREAD);
 
 resume_kernel:
 	m_kds_dst = (CUdeviceptr)&pds_dst->kds;
@@ -7132,6 +9089,7 @@ resume_kernel:
 						NULL);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuLaunchKernel: %s", errorText(rc));
+	gpuTaskStageMark(GPUTASK_STAGE__KERN_EXEC, CU_STREAM_PER_THREAD);
 
 	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
 	if (rc != CUDA_SUCCESS)
@@ -7161,11 +9119,15 @@ resume_kernel:
 			//fprintf(stderr, "suspend / resume\n");
 			/* renew buffer and restart */
 			pds_dst = pgjoin->pds_dst;
+			gpuTaskStageUpdate(&pgjoin->task);
+			gpuTaskStageMark(GPUTASK_STAGE__DMA_SEND, CU_STREAM_PER_THREAD);
 			goto resume_kernel;
 		}
 		gpujoinUpdateRunTimeStat(&gjs->gts, &pgjoin->kern);
 		/* return task if any result rows */
 		retval = (pds_dst->kds.nitems > 0 ? 0 : -1);
+		if (retval == 0)
+			gpujoin_writeback_result(pds_dst);
 	}
 	else if (pgstrom_cpu_fallback_enabled &&
 			 (pgjoin->kern.kerror.errcode & ERRCODE_FLAGS_CPU_FALLBACK) != 0)
@@ -7206,6 +9168,7 @@ resume_kernel:
 		retval = 0;
 	}
 out_of_resource:
+	gpuTaskStageUpdate(&pgjoin->task);
 	if (m_kds_src_release)
 		gpuMemFree(gcontext, m_kds_src);
 	return retval;
@@ -7233,8 +9196,10 @@ gpujoin_process_right_outer(GpuJoinTask *pgjoin, CUmodule cuda_module)
 	Assert(pds_dst->kds.format == KDS_FORMAT_ROW);
 	Assert(outer_depth > 0 && outer_depth <= gjs->num_rels);
 
-	/* Co-location of the outer join map */
-	//gpujoinColocateOuterJoinMaps(&gjs->gts, cuda_module);
+	/*
+	 * Outer join map is already colocated by the backend prior to the task
+	 * creation; see gpujoinNextRightOuterJoinIfAny().
+	 */
 
 	/* Lookup GPU kernel function */
 	rc = cuModuleGetFunction(&kern_gpujoin_main,
@@ -7258,6 +9223,7 @@ gpujoin_process_right_outer(GpuJoinTask *pgjoin, CUmodule cuda_module)
 							 0, sizeof(cl_int));
 	if (rc != CUDA_SUCCESS)
 		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	gpuTaskStageMark(GPUTASK_STAGE__QUEUE, CU_STREAM_PER_THREAD);
 resume_kernel:
 	m_kds_dst = (CUdeviceptr)&pds_dst->kds;
 	kern_args[0] = &m_kgjoin;
@@ -7275,6 +9241,7 @@ resume_kernel:
 						NULL);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuLaunchKernel: %s", errorText(rc));
+	gpuTaskStageMark(GPUTASK_STAGE__KERN_EXEC, CU_STREAM_PER_THREAD);
 
 	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
 	if (rc != CUDA_SUCCESS)
@@ -7303,11 +9270,15 @@ resume_kernel:
 			memcpy(last_suspend,
 				   KERN_GPUJOIN_SUSPEND_CONTEXT(&pgjoin->kern, 0),
 				   pgjoin->kern.suspend_size);
+			gpuTaskStageUpdate(&pgjoin->task);
+			gpuTaskStageMark(GPUTASK_STAGE__DMA_SEND, CU_STREAM_PER_THREAD);
 			goto resume_kernel;
 		}
 		gpujoinUpdateRunTimeStat(&gjs->gts, &pgjoin->kern);
 		/* return task if any result rows */
 		retval = (pds_dst->kds.nitems > 0 ? 0 : -1);
+		if (retval == 0)
+			gpujoin_writeback_result(pds_dst);
 	}
 	else if (pgstrom_cpu_fallback_enabled &&
 			 (pgjoin->task.kerror.errcode & ERRCODE_FLAGS_CPU_FALLBACK) != 0)
@@ -7328,6 +9299,7 @@ resume_kernel:
 		/* raise an error */
 		retval = 0;
 	}
+	gpuTaskStageUpdate(&pgjoin->task);
 	return retval;
 }
 
@@ -7496,8 +9468,37 @@ innerPreloadExecOneDepth(GpuJoinState *leader, innerState *istate)
 			 */
 			hash = get_tuple_hashvalue(istate, true, slot, &isnull);
 			if (isnull && (istate->join_type == JOIN_INNER ||
-						   istate->join_type == JOIN_LEFT))
+						   istate->join_type == JOIN_LEFT ||
+						   istate->join_type == JOIN_SEMI ||
+						   istate->join_type == JOIN_ANTI))
+				continue;
+			/*
+			 * In case of partitioned inner hash, rows in the other
+			 * partitions shall be loaded at the later pass.
+			 */
+			if (depth == 1 && leader->inner_nparts > 1 &&
+				GPUJOIN_INNER_PARTITION(hash, leader->inner_nparts) !=
+				leader->inner_curr_part)
 				continue;
+			/*
+			 * Track the range of join-key, to skip outer record-batches
+			 * out of the range.
+			 */
+			if (depth == 1 && leader->outer_range_key >= 0)
+			{
+				ExprState  *kstate = list_nth(istate->hash_inner_keys,
+											  leader->outer_range_key);
+				cl_long		ival;
+
+				datum = ExecEvalExpr(kstate, istate->econtext, &isnull);
+				if (!isnull)
+				{
+					ival = outer_range_key_datum_to_int64(leader->outer_range_type,
+														  datum);
+					istate->key_range_min = Min(istate->key_range_min, ival);
+					istate->key_range_max = Max(istate->key_range_max, ival);
+				}
+			}
 		}
 		else if (istate->gist_irel)
 		{
@@ -7592,6 +9593,11 @@ restart:
 				init_kernel_data_store(kds, tupdesc, nbytes,
 									   KDS_FORMAT_HASH, nrooms);
 				kds->nslots = __KDS_NSLOTS(nrooms);
+				/*
+				 * Only one process builds the hash table unless inner
+				 * parallel, then items with same hash value are adjacent.
+				 */
+				h_kmrels->chunks[i].hash_grouped = !leader->inner_parallel;
 			}
 		}
 		else if (istate->gist_irel != NULL)
@@ -7628,6 +9634,35 @@ restart:
 			}
 			nbytes += gist_length;
 		}
+		else if (istate->grid_resno > 0)
+		{
+			size_t		grid_length;
+			cl_uint		nx, ny;
+
+			nbytes += (STROMALIGN(sizeof(cl_uint) * nrooms) +
+					   STROMALIGN(usage));
+			/* portion of grid-index */
+			grid_length = gpujoin_grid_index_length(nrooms,
+													istate->grid_is_range,
+													&nx, &ny);
+			if (h_kmrels)
+			{
+				kern_gpujoin_grid *grid;
+
+				/* KDS-Row portion */
+				init_kernel_data_store(kds, tupdesc, nbytes,
+									   KDS_FORMAT_ROW, nrooms);
+				/* grid-index portion; built by __innerPreloadSetupGridIndex */
+				h_kmrels->chunks[i].grid_offset = (kmrels_ofs + nbytes);
+				grid = (kern_gpujoin_grid *)
+					((char *)h_kmrels + h_kmrels->chunks[i].grid_offset);
+				memset(grid, 0, offsetof(kern_gpujoin_grid, cells));
+				grid->nrooms = nrooms;
+				grid->nx = nx;
+				grid->ny = ny;
+			}
+			nbytes += grid_length;
+		}
 		else
 		{
 			nbytes += (STROMALIGN(sizeof(cl_uint) * nrooms) +
@@ -7657,6 +9692,10 @@ restart:
 			if (h_kmrels)
 				h_kmrels->chunks[i].left_outer = true;
 		}
+		if (istate->join_type == JOIN_SEMI && h_kmrels)
+			h_kmrels->chunks[i].semi_join = true;
+		if (istate->join_type == JOIN_ANTI && h_kmrels)
+			h_kmrels->chunks[i].anti_join = true;
 	}
 
 	/*
@@ -7733,28 +9772,116 @@ __innerPreloadSetupHeapBuffer(kern_data_store *kds,
 	Assert(istate->preload_usage == (tail_pos - curr_pos));
 }
 
+/*
+ * __innerPreloadSetupHashBuffer
+ *
+ * NOTE: the inner tuples are put on the hash buffer in order of the hash
+ * slot, so items on the same hash chain are located on the adjacent address
+ * each other. It allows GPU kernel to walk on the hash chain with sequential
+ * memory access, instead of random access to the whole inner buffer.
+ * Items with same hash value are also adjacent on the hash chain, and the
+ * heavy-hitters (hash values that have very large number of items) are put
+ * on the tail of the chain, not to block the walk for the other keys.
+ */
+#define GPUJOIN_HEAVY_HITTER_MIN_NITEMS		256
+
+typedef struct
+{
+	cl_uint		hindex;		/* index of the hash slot */
+	cl_uint		hash;		/* hash value */
+	size_t		nitems;		/* number of items with same hash value */
+	tupleEntry *entry;
+} hashEntryOrder;
+
+static int
+__compareHashEntryOrder(const void *__a, const void *__b)
+{
+	const hashEntryOrder *a = __a;
+	const hashEntryOrder *b = __b;
+
+	if (a->hindex < b->hindex)
+		return 1;
+	if (a->hindex > b->hindex)
+		return -1;
+	/* larger group is put first, to be the tail of chain */
+	if (a->nitems < b->nitems)
+		return 1;
+	if (a->nitems > b->nitems)
+		return -1;
+	if (a->hash < b->hash)
+		return -1;
+	if (a->hash > b->hash)
+		return 1;
+	return 0;
+}
+
 static void
 __innerPreloadSetupHashBuffer(kern_data_store *kds,
 							  innerState *istate,
+							  GpuJoinRuntimeStat *gj_rtstat,
 							  cl_uint base_nitems,
 							  cl_uint base_usage)
 {
 	cl_uint	   *row_index = KERN_DATA_STORE_ROWINDEX(kds);
 	cl_uint	   *hash_slot = KERN_DATA_STORE_HASHSLOT(kds);
 	size_t		rowid = base_nitems;
+	hashEntryOrder *horder;
+	size_t		i, j, k, nitems = 0;
+	size_t		heavy_threshold;
+	uint64		heavy_nkeys = 0;
+	uint64		heavy_nitems = 0;
 	char	   *tail_pos;
 	char	   *curr_pos;
 	slist_iter	iter;
-	
-	tail_pos = (char *)kds + kds->length - __kds_unpack(base_usage);
-	curr_pos = tail_pos;
+
+	if (istate->preload_nitems == 0)
+		return;
+	horder = MemoryContextAllocHuge(CurrentMemoryContext,
+									sizeof(hashEntryOrder) *
+									istate->preload_nitems);
 	slist_foreach (iter, &istate->preload_tuples)
 	{
 		tupleEntry *entry = slist_container(tupleEntry, chain, iter.cur);
+
+		Assert(nitems < istate->preload_nitems);
+		horder[nitems].hindex = entry->hash % kds->nslots;
+		horder[nitems].hash = entry->hash;
+		horder[nitems].nitems = 0;
+		horder[nitems].entry = entry;
+		nitems++;
+	}
+	Assert(nitems == istate->preload_nitems);
+	/*
+	 * Items are put from the tail to the head of the buffer, and the last
+	 * item becomes the head of the hash chain. So, descending order by
+	 * the hash slot makes the hash chain towards the upper address.
+	 * The 1st sort makes groups of same hash value, then the 2nd sort
+	 * reorders the groups by its number of items.
+	 */
+	qsort(horder, nitems, sizeof(hashEntryOrder), __compareHashEntryOrder);
+	heavy_threshold = Max(GPUJOIN_HEAVY_HITTER_MIN_NITEMS, nitems / 1000);
+	for (i=0; i < nitems; i = j)
+	{
+		for (j=i+1; j < nitems && horder[j].hash == horder[i].hash; j++);
+		if (j - i >= heavy_threshold)
+		{
+			heavy_nkeys++;
+			heavy_nitems += (j - i);
+		}
+		for (k=i; k < j; k++)
+			horder[k].nitems = (j - i);
+	}
+	qsort(horder, nitems, sizeof(hashEntryOrder), __compareHashEntryOrder);
+
+	tail_pos = (char *)kds + kds->length - __kds_unpack(base_usage);
+	curr_pos = tail_pos;
+	for (i=0; i < nitems; i++)
+	{
+		tupleEntry *entry = horder[i].entry;
 		size_t		sz = MAXALIGN(offsetof(kern_hashitem,
 										   t.htup) + entry->titem.t_len);
 		kern_hashitem *hitem = (kern_hashitem *)(curr_pos - sz);
-		size_t		hindex = entry->hash % kds->nslots;
+		size_t		hindex = horder[i].hindex;
 		cl_uint		next, self;
 
 		self = __kds_packed((char *)hitem - (char *)kds);
@@ -7769,8 +9896,18 @@ __innerPreloadSetupHashBuffer(kern_data_store *kds,
 
 		curr_pos -= sz;
 	}
+	pfree(horder);
 	Assert(istate->preload_nitems == (rowid - base_nitems));
 	Assert(istate->preload_usage == (tail_pos - curr_pos));
+
+	/* statistics of the heavy-hitters */
+	if (heavy_nkeys > 0)
+	{
+		pg_atomic_add_fetch_u64(&gj_rtstat->jstat[istate->depth].heavy_nkeys,
+								heavy_nkeys);
+		pg_atomic_add_fetch_u64(&gj_rtstat->jstat[istate->depth].heavy_nitems,
+								heavy_nitems);
+	}
 }
 
 static void
@@ -7842,62 +9979,434 @@ __innerPreloadSetupGiSTIndexBuffer(innerState *istate,
 									   InvalidOffsetNumber);
 }
 
-static kern_multirels *
-innerPreloadMmapHostBuffer(GpuJoinState *leader, GpuJoinState *gjs)
+/*
+ * __innerPreloadGridItemBBox
+ *
+ * It fetches the 2D bounding-box of the serialized geometry. If geometry has
+ * no stored bounding-box (usually, points), it is calculated only for point;
+ * others have infinite bounding-box, so they are put on the oversized items.
+ * It returns false if geometry is empty, so never matches.
+ */
+static bool
+__innerPreloadGridItemBBox(Datum datum, geom_bbox_2d *bbox)
 {
-	GpuJoinSharedState *gj_sstate = leader->gj_sstate;
-	kern_multirels *h_kmrels;
-	char		name[200];
-	int			fdesc;
-	struct stat	stat_buf;
-
-	/* already mapped? */
-	if (gjs->h_kmrels)
-		return gjs->h_kmrels;
-
-	/* already mapped by the siblings? */
-	if (leader->h_kmrels)
-	{
-		gjs->h_kmrels = leader->h_kmrels;
-		return gjs->h_kmrels;
+	struct varlena *vl = pg_detoast_datum_packed((struct varlena *)
+												 DatumGetPointer(datum));
+	__GSERIALIZED *gs = (__GSERIALIZED *) VARDATA_ANY(vl);
+	char	   *rawdata = gs->data;
+	cl_uint		gs_flags = 0;
+	cl_uint		gs_type;
+	cl_uint		nitems;
+	bool		retval = true;
+
+	if ((gs->gflags & G2FLAG_VER_0) != 0)
+	{
+		/* GSERIALIZED v2 */
+		if ((gs->gflags & G2FLAG_Z) != 0)
+			gs_flags |= GEOM_FLAG__Z;
+		if ((gs->gflags & G2FLAG_M) != 0)
+			gs_flags |= GEOM_FLAG__M;
+		if ((gs->gflags & G2FLAG_BBOX) != 0)
+			gs_flags |= GEOM_FLAG__BBOX;
+		if ((gs->gflags & G2FLAG_GEODETIC) != 0)
+			gs_flags |= GEOM_FLAG__GEODETIC;
+		if ((gs->gflags & G2FLAG_EXTENDED) != 0)
+			rawdata += sizeof(cl_ulong);
 	}
-
-	/* mmap host buffer */
-	snprintf(name, sizeof(name), "gpujoin_kmrels.%u.%08x.buf",
-			 PostPortNumber, gj_sstate->shmem_handle);
-	fdesc = shm_open(name, O_RDWR, 0);
-	if (fdesc < 0)
-		elog(ERROR, "failed on shm_open('%s'): %m", name);
-	if (fstat(fdesc, &stat_buf) != 0)
+	else
 	{
-		close(fdesc);
-		elog(ERROR, "failed on fstat('%s'): %m", name);
+		/* GSERIALIZED v1 */
+		if ((gs->gflags & G1FLAG_Z) != 0)
+			gs_flags |= GEOM_FLAG__Z;
+		if ((gs->gflags & G1FLAG_M) != 0)
+			gs_flags |= GEOM_FLAG__M;
+		if ((gs->gflags & G1FLAG_BBOX) != 0)
+			gs_flags |= GEOM_FLAG__BBOX;
+		if ((gs->gflags & G1FLAG_GEODETIC) != 0)
+			gs_flags |= GEOM_FLAG__GEODETIC;
+	}
+
+	if ((gs_flags & GEOM_FLAG__BBOX) != 0 &&
+		(gs_flags & GEOM_FLAG__GEODETIC) == 0)
+	{
+		memcpy(bbox, rawdata, sizeof(geom_bbox_2d));
+		goto out;
+	}
+	if ((gs_flags & GEOM_FLAG__BBOX) != 0)
+		rawdata += geometry_bbox_size(gs_flags);
+	memcpy(&gs_type, rawdata, sizeof(cl_uint));
+	memcpy(&nitems, rawdata + sizeof(cl_uint), sizeof(cl_uint));
+	if (nitems == 0)
+		retval = false;		/* empty geometry */
+	else if (gs_type == GEOM_POINTTYPE &&
+			 (gs_flags & GEOM_FLAG__GEODETIC) == 0)
+	{
+		double		x, y;
+
+		memcpy(&x, rawdata + 2 * sizeof(cl_uint), sizeof(double));
+		memcpy(&y, rawdata + 2 * sizeof(cl_uint) + sizeof(double),
+			   sizeof(double));
+		/* round outward, like the bounding-box of PostGIS */
+		bbox->xmin = bbox->xmax = (float)x;
+		if ((double)bbox->xmin > x)
+			bbox->xmin = nextafterf(bbox->xmin, -FLT_MAX);
+		if ((double)bbox->xmax < x)
+			bbox->xmax = nextafterf(bbox->xmax,  FLT_MAX);
+		bbox->ymin = bbox->ymax = (float)y;
+		if ((double)bbox->ymin > y)
+			bbox->ymin = nextafterf(bbox->ymin, -FLT_MAX);
+		if ((double)bbox->ymax < y)
+			bbox->ymax = nextafterf(bbox->ymax,  FLT_MAX);
 	}
-	Assert(stat_buf.st_size == gj_sstate->shmem_bytesize);
-
-	h_kmrels = __mmapFile(NULL, TYPEALIGN(PAGE_SIZE, stat_buf.st_size),
-						  PROT_READ | PROT_WRITE,
-						  MAP_SHARED,
-						  fdesc, 0);
-	if (h_kmrels == MAP_FAILED)
+	else
 	{
-		close(fdesc);
-		elog(ERROR, "failed on mmap('%s'): %m", name);
+		bbox->xmin = bbox->ymin = -get_float4_infinity();
+		bbox->xmax = bbox->ymax =  get_float4_infinity();
 	}
-	close(fdesc);
-
-	/* simple sanity checks */
-	if (h_kmrels->kmrels_length +
-		h_kmrels->ojmaps_length > stat_buf.st_size)
-		elog(ERROR, "Bug? filesize of '%s' is smaller than host buffer", name);
-	leader->h_kmrels = gjs->h_kmrels = h_kmrels;
-
-	return h_kmrels;
+out:
+	if ((Pointer) vl != DatumGetPointer(datum))
+		pfree(vl);
+	return retval;
 }
 
-static void
-__innerPreloadInitGiSTIndex(GpuJoinState *gjs, CUdeviceptr m_kmrels)
-{
+/*
+ * __innerPreloadGridRangeBBox
+ *
+ * It returns the interval of the range (or element) as 1D bounding-box,
+ * rounded outward to float; equivalent to pgindex_grid_range_bbox() on the
+ * device. Empty range is contained by any ranges, so it has infinite
+ * bounding-box. inet/cidr has the interval of the addresses in the network.
+ */
+static double
+__innerPreloadGridRangeValue(Datum datum, Oid type_oid)
+{
+	switch (type_oid)
+	{
+		case INT4OID:
+		case DATEOID:
+			if (DatumGetInt32(datum) == PG_INT32_MIN)
+				return -get_float8_infinity();
+			if (DatumGetInt32(datum) == PG_INT32_MAX)
+				return get_float8_infinity();
+			return (double) DatumGetInt32(datum);
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			if (DatumGetInt64(datum) == PG_INT64_MIN)
+				return -get_float8_infinity();
+			if (DatumGetInt64(datum) == PG_INT64_MAX)
+				return get_float8_infinity();
+			return (double) DatumGetInt64(datum);
+		default:
+			elog(ERROR, "GPU-Grid: unexpected range element type: %s",
+				 format_type_be(type_oid));
+	}
+	return 0.0;		/* not reachable */
+}
+
+static float
+__innerPreloadGridInetBound(uint64 ival, bool upper)
+{
+	float		fval = (float) ival;
+
+	if (fval >= 18446744073709551616.0f)
+		return (upper ? fval : nextafterf(fval, 0.0));
+	if (upper ? (uint64) fval < ival : (uint64) fval > ival)
+		fval = nextafterf(fval, upper ? FLT_MAX : 0.0);
+	return fval;
+}
+
+static void
+__innerPreloadGridRangeBBox(Datum datum, Oid type_oid, geom_bbox_2d *bbox)
+{
+	double		lval, uval;
+
+	if (type_oid == INETOID || type_oid == CIDROID)
+	{
+		/*
+		 * inet/cidr has an interval of the addresses in the network; IPv6
+		 * is mapped by the upper 64bits, on the same axis of IPv4.
+		 */
+		inet	   *ip = DatumGetInetPP(datum);
+		int			nbytes = (ip_family(ip) == PGSQL_AF_INET ? 4 : 8);
+		int			nbits = Min(ip_bits(ip), nbytes * 8);
+		uint64		width = (nbytes < 8 ? 0xffffffffUL : ~0UL);
+		uint64		addr = 0;
+		uint64		mask;
+		int			i;
+
+		for (i=0; i < nbytes; i++)
+			addr = (addr << 8) | ip_addr(ip)[i];
+		mask = (nbits == 0 ? 0 : (~0UL << (nbytes * 8 - nbits)) & width);
+		bbox->xmin = __innerPreloadGridInetBound(addr & mask, false);
+		bbox->xmax = __innerPreloadGridInetBound((addr & mask) |
+												 (~mask & width), true);
+		bbox->ymin = bbox->ymax = 0.0;
+		return;
+	}
+
+	if (type_is_range(type_oid))
+	{
+		TypeCacheEntry *typcache;
+		RangeType  *range = DatumGetRangeTypeP(datum);
+		RangeBound	lower;
+		RangeBound	upper;
+		bool		empty;
+
+		typcache = lookup_type_cache(type_oid, TYPECACHE_RANGE_INFO);
+		range_deserialize(typcache, range, &lower, &upper, &empty);
+		if (empty)
+		{
+			lval = -get_float8_infinity();
+			uval =  get_float8_infinity();
+		}
+		else
+		{
+			Oid		subtype = typcache->rngelemtype->type_id;
+
+			lval = (lower.infinite
+					? -get_float8_infinity()
+					: __innerPreloadGridRangeValue(lower.val, subtype));
+			uval = (upper.infinite
+					?  get_float8_infinity()
+					: __innerPreloadGridRangeValue(upper.val, subtype));
+		}
+	}
+	else
+	{
+		lval = uval = __innerPreloadGridRangeValue(datum, type_oid);
+	}
+	bbox->xmin = (float) lval;
+	if ((double) bbox->xmin > lval)
+		bbox->xmin = nextafterf(bbox->xmin, -FLT_MAX);
+	bbox->xmax = (float) uval;
+	if ((double) bbox->xmax < uval)
+		bbox->xmax = nextafterf(bbox->xmax,  FLT_MAX);
+	bbox->ymin = bbox->ymax = 0.0;
+}
+
+/*
+ * __innerPreloadSetupGridIndex
+ *
+ * It builds the grid-index on the inner KDS-Row buffer loaded. The cell size
+ * is not less than the median size of the items, so most of items are not
+ * oversized; it may reduce the number of cells than the ones allocated.
+ */
+static int
+__compareGridItemSize(const void *__a, const void *__b)
+{
+	float		a = *((const float *) __a);
+	float		b = *((const float *) __b);
+
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return 0;
+}
+
+static void
+__innerPreloadSetupGridIndex(innerState *istate,
+							 kern_data_store *kds,
+							 kern_gpujoin_grid *grid)
+{
+	TupleDesc	tupdesc = planStateResultTupleDesc(istate->state);
+	kern_gpujoin_grid_item *temp;
+	kern_gpujoin_grid_item *items;
+	float	   *width;
+	float	   *height;
+	cl_uint	   *count;
+	cl_uint		ncells;
+	cl_uint		nitems = 0;
+	cl_uint		nregulars = 0;
+	double		xmin = DBL_MAX, xmax = -DBL_MAX;
+	double		ymin = DBL_MAX, ymax = -DBL_MAX;
+	cl_uint		i, cx, cy;
+
+	Assert(kds->format == KDS_FORMAT_ROW && kds->nitems <= grid->nrooms);
+	temp = palloc_huge(sizeof(kern_gpujoin_grid_item) * (kds->nitems + 1));
+	width = palloc_huge(sizeof(float) * (kds->nitems + 1));
+	height = palloc_huge(sizeof(float) * (kds->nitems + 1));
+	for (i=0; i < kds->nitems; i++)
+	{
+		kern_tupitem *titem = KERN_DATA_STORE_TUPITEM(kds, i);
+		kern_gpujoin_grid_item *gitem = &temp[nitems];
+		HeapTupleData tuple;
+		geom_bbox_2d bbox;
+		Datum		datum;
+		bool		isnull;
+
+		tuple.t_len = titem->t_len;
+		ItemPointerSetInvalid(&tuple.t_self);
+		tuple.t_tableOid = InvalidOid;
+		tuple.t_data = &titem->htup;
+		datum = heap_getattr(&tuple, istate->grid_resno, tupdesc, &isnull);
+		if (isnull)
+			continue;	/* never matches */
+		if (istate->grid_is_range)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc,
+												   istate->grid_resno - 1);
+			__innerPreloadGridRangeBBox(datum, attr->atttypid, &bbox);
+		}
+		else if (!__innerPreloadGridItemBBox(datum, &bbox))
+			continue;	/* never matches */
+		gitem->t_off = __kds_packed((char *)&titem->htup - (char *)kds);
+		gitem->xmin = bbox.xmin;
+		gitem->xmax = bbox.xmax;
+		gitem->ymin = bbox.ymin;
+		gitem->ymax = bbox.ymax;
+		if (isinf(bbox.xmin) || isinf(bbox.xmax) ||
+			isinf(bbox.ymin) || isinf(bbox.ymax))
+			gitem->cell = UINT_MAX;
+		else
+		{
+			gitem->cell = 0;
+			xmin = Min(xmin, (double) bbox.xmin);
+			xmax = Max(xmax, (double) bbox.xmax);
+			ymin = Min(ymin, (double) bbox.ymin);
+			ymax = Max(ymax, (double) bbox.ymax);
+			width[nregulars] = bbox.xmax - bbox.xmin;
+			height[nregulars] = bbox.ymax - bbox.ymin;
+			nregulars++;
+		}
+		nitems++;
+	}
+
+	/* size of the cells */
+	if (nregulars == 0)
+	{
+		grid->nx = grid->ny = 1;
+		grid->base_x = grid->base_y = 0.0;
+		grid->cell_w = grid->cell_h = 1.0;
+	}
+	else
+	{
+		qsort(width, nregulars, sizeof(float), __compareGridItemSize);
+		qsort(height, nregulars, sizeof(float), __compareGridItemSize);
+		grid->base_x = xmin;
+		grid->base_y = ymin;
+		grid->cell_w = Max((xmax - xmin) / (double) grid->nx,
+						   (double) width[nregulars / 2]);
+		grid->cell_h = Max((ymax - ymin) / (double) grid->ny,
+						   (double) height[nregulars / 2]);
+		if (grid->cell_w <= 0.0)
+			grid->cell_w = 1.0;
+		if (grid->cell_h <= 0.0)
+			grid->cell_h = 1.0;
+		grid->nx = Min(grid->nx, (cl_uint)
+					   ceil((xmax - xmin) / grid->cell_w) + 1);
+		grid->ny = Min(grid->ny, (cl_uint)
+					   ceil((ymax - ymin) / grid->cell_h) + 1);
+	}
+	ncells = grid->nx * grid->ny;
+
+	/* assign the cell for each item */
+	count = palloc0(sizeof(cl_uint) * (ncells + 1));
+	for (i=0; i < nitems; i++)
+	{
+		kern_gpujoin_grid_item *gitem = &temp[i];
+		double		pos;
+
+		if (gitem->cell == UINT_MAX ||
+			gitem->xmax - gitem->xmin > grid->cell_w ||
+			gitem->ymax - gitem->ymin > grid->cell_h)
+		{
+			gitem->cell = UINT_MAX;
+			count[ncells]++;
+			continue;
+		}
+		pos = ((double) gitem->xmin + (double) gitem->xmax) / 2.0;
+		cx = (cl_uint) Max(floor((pos - grid->base_x) / grid->cell_w), 0.0);
+		cx = Min(cx, grid->nx - 1);
+		pos = ((double) gitem->ymin + (double) gitem->ymax) / 2.0;
+		cy = (cl_uint) Max(floor((pos - grid->base_y) / grid->cell_h), 0.0);
+		cy = Min(cy, grid->ny - 1);
+		gitem->cell = cy * grid->nx + cx;
+		count[gitem->cell]++;
+	}
+	/* cells[] is the first item of the cell; oversized items at the tail */
+	grid->cells[0] = 0;
+	for (i=0; i < ncells; i++)
+	{
+		grid->cells[i+1] = grid->cells[i] + count[i];
+		count[i] = grid->cells[i];
+	}
+	count[ncells] = grid->cells[ncells];
+	items = KERN_GPUJOIN_GRID_ITEMS(grid);
+	for (i=0; i < nitems; i++)
+	{
+		kern_gpujoin_grid_item *gitem = &temp[i];
+		cl_uint		index = (gitem->cell == UINT_MAX
+							 ? count[ncells]++
+							 : count[gitem->cell]++);
+		memcpy(&items[index], gitem, sizeof(kern_gpujoin_grid_item));
+	}
+	Assert(count[ncells] == nitems);
+	grid->nitems = nitems;
+
+	pfree(count);
+	pfree(height);
+	pfree(width);
+	pfree(temp);
+}
+
+static kern_multirels *
+innerPreloadMmapHostBuffer(GpuJoinState *leader, GpuJoinState *gjs)
+{
+	GpuJoinSharedState *gj_sstate = leader->gj_sstate;
+	kern_multirels *h_kmrels;
+	char		name[200];
+	int			fdesc;
+	struct stat	stat_buf;
+
+	/* already mapped? */
+	if (gjs->h_kmrels)
+		return gjs->h_kmrels;
+
+	/* already mapped by the siblings? */
+	if (leader->h_kmrels)
+	{
+		gjs->h_kmrels = leader->h_kmrels;
+		return gjs->h_kmrels;
+	}
+
+	/* mmap host buffer */
+	snprintf(name, sizeof(name), "gpujoin_kmrels.%u.%08x.buf",
+			 PostPortNumber, gj_sstate->shmem_handle);
+	fdesc = shm_open(name, O_RDWR, 0);
+	if (fdesc < 0)
+		elog(ERROR, "failed on shm_open('%s'): %m", name);
+	if (fstat(fdesc, &stat_buf) != 0)
+	{
+		close(fdesc);
+		elog(ERROR, "failed on fstat('%s'): %m", name);
+	}
+	Assert(stat_buf.st_size == gj_sstate->shmem_bytesize);
+
+	h_kmrels = __mmapFile(NULL, TYPEALIGN(PAGE_SIZE, stat_buf.st_size),
+						  PROT_READ | PROT_WRITE,
+						  MAP_SHARED,
+						  fdesc, 0);
+	if (h_kmrels == MAP_FAILED)
+	{
+		close(fdesc);
+		elog(ERROR, "failed on mmap('%s'): %m", name);
+	}
+	close(fdesc);
+
+	/* simple sanity checks */
+	if (h_kmrels->kmrels_length +
+		h_kmrels->ojmaps_length > stat_buf.st_size)
+		elog(ERROR, "Bug? filesize of '%s' is smaller than host buffer", name);
+	leader->h_kmrels = gjs->h_kmrels = h_kmrels;
+
+	return h_kmrels;
+}
+
+static void
+__innerPreloadInitGiSTIndex(GpuJoinState *gjs, CUdeviceptr m_kmrels)
+{
 	GpuContext	   *gcontext = gjs->gts.gcontext;
 	CUmodule		cuda_module = NULL;
 	CUfunction		f_prep_gistindex = NULL;
@@ -7907,124 +10416,954 @@ __innerPreloadInitGiSTIndex(GpuJoinState *gjs, CUdeviceptr m_kmrels)
 	cl_int			block_sz;
 	cl_int			depth;
 
-	for (depth=1; depth <= gjs->num_rels; depth++)
+	for (depth=1; depth <= gjs->num_rels; depth++)
+	{
+		if (!gjs->inners[depth-1].gist_irel)
+			continue;
+		/* load the CUDA module and function */
+		if (!cuda_module)
+		{
+			cuda_module = GpuContextLookupModule(gcontext,
+												 gjs->gts.program_id);
+           rc = cuModuleGetFunction(&f_prep_gistindex,
+                                    cuda_module,
+                                    "gpujoin_prep_gistindex");
+           if (rc != CUDA_SUCCESS)
+               elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
+           rc = gpuOptimalBlockSize(&grid_sz,
+                                    &block_sz,
+                                    f_prep_gistindex,
+                                    gcontext->cuda_device,
+                                    0, 0);
+          if (rc != CUDA_SUCCESS)
+               elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
+       }
+       /* launch kern_gpujoin_prep_gistindex */
+       kern_args[0] = &m_kmrels;
+       kern_args[1] = &depth;
+
+       rc = cuLaunchKernel(f_prep_gistindex,
+                           grid_sz, 1, 1,
+                           block_sz, 1, 1,
+                           0,
+                           CU_STREAM_PER_THREAD,
+                           kern_args,
+                           NULL);
+       if (rc != CUDA_SUCCESS)
+           elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
+   }
+
+   if (cuda_module)
+   {
+       rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+       if (rc != CUDA_SUCCESS)
+           elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
+   }
+}
+
+/*
+ * __innerPreloadCopyFromPeerDevice
+ *
+ * It tries to copy the inner buffer already loaded on the other device,
+ * using peer-to-peer DMA, instead of the host-to-device copy. Outer-join
+ * map is not copied because it is updated by the GpuJoin on the peer.
+ */
+static bool
+__innerPreloadCopyFromPeerDevice(GpuJoinState *leader,
+								 GpuJoinState *gjs,
+								 CUdeviceptr m_kmrels)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	GpuJoinSharedState *gj_sstate = leader->gj_sstate;
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	int				i, peer, dindex = gcontext->cuda_dindex;
+	CUdevice		peer_device;
+	CUdeviceptr		m_peer;
+	CUresult		rc;
+	int				can_access;
+
+	if (!gpujoin_inner_p2p_copy)
+		return false;
+	/* GiST-index is already modified on the peer device */
+	for (i=0; i < leader->num_rels; i++)
+	{
+		if (leader->inners[i].gist_irel)
+			return false;
+	}
+
+	for (peer=0; peer < numDevAttrs; peer++)
+	{
+		if (peer == dindex || gj_sstate->pergpu[peer].bytesize == 0)
+			continue;
+		rc = cuDeviceGet(&peer_device, devAttrs[peer].DEV_ID);
+		if (rc != CUDA_SUCCESS)
+			continue;
+		rc = cuDeviceCanAccessPeer(&can_access,
+								   gcontext->cuda_device,
+								   peer_device);
+		if (rc != CUDA_SUCCESS || !can_access)
+			continue;
+		rc = gpuIpcOpenMemHandle(gcontext,
+								 &m_peer,
+								 gj_sstate->pergpu[peer].ipc_mhandle,
+								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+		if (rc != CUDA_SUCCESS)
+			continue;
+		rc = cuMemcpyDtoD(m_kmrels, m_peer, h_kmrels->kmrels_length);
+		if (rc == CUDA_SUCCESS && h_kmrels->ojmaps_length > 0)
+			rc = cuMemcpyHtoD(m_kmrels + h_kmrels->kmrels_length,
+							  (char *)h_kmrels + h_kmrels->kmrels_length,
+							  h_kmrels->ojmaps_length);
+		if (gpuIpcCloseMemHandle(gcontext, m_peer) != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuIpcCloseMemHandle");
+		if (rc == CUDA_SUCCESS)
+			return true;
+		elog(DEBUG1, "GpuJoin: failed on P2P copy of inner buffer (GPU%d->GPU%d): %s",
+			 peer, dindex, errorText(rc));
+	}
+	return false;
+}
+
+/*
+ * __innerPreloadAsyncCopyHtoD
+ *
+ * It kicks copy of the inner buffer on a dedicated stream, instead of the
+ * synchronous copy, then GpuJoin tasks wait for its completion event prior
+ * to the kernel launch. It allows the backend to start the outer scan while
+ * the inner buffer is transferred. Host buffer is page-locked if possible,
+ * to run DMA without the staging copy by CUDA driver.
+ * Only the local inner buffer (neither shared with parallel workers nor
+ * sibling GpuJoins) without GiST-index and outer-join map is applicable.
+ */
+static bool
+__innerPreloadAsyncCopyHtoD(GpuJoinState *leader,
+							GpuJoinState *gjs,
+							CUdeviceptr m_kmrels,
+							size_t bytesize)
+{
+	GpuJoinSharedState *gj_sstate = leader->gj_sstate;
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	CUstream		stream = NULL;
+	CUevent			event = NULL;
+	void		   *hostreg = NULL;
+	CUresult		rc;
+	int				i;
+
+	if (!gpujoin_inner_async_load ||
+		leader != gjs ||
+		gjs->sibling != NULL ||
+		IsParallelWorker() ||
+		gj_sstate->ss_handle != UINT_MAX ||
+		h_kmrels->ojmaps_length > 0)
+		return false;
+	for (i=0; i < gjs->num_rels; i++)
+	{
+		if (gjs->inners[i].gist_irel)
+			return false;
+	}
+	Assert(!gjs->inner_load_event);
+
+	rc = cuStreamCreate(&stream, CU_STREAM_NON_BLOCKING);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(DEBUG1, "failed on cuStreamCreate: %s", errorText(rc));
+		return false;
+	}
+	rc = cuEventCreate(&event, CU_EVENT_DISABLE_TIMING);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(DEBUG1, "failed on cuEventCreate: %s", errorText(rc));
+		goto bailout;
+	}
+	rc = cuMemHostRegister(h_kmrels, bytesize, 0);
+	if (rc == CUDA_SUCCESS)
+		hostreg = h_kmrels;
+	else
+		elog(DEBUG1, "failed on cuMemHostRegister: %s", errorText(rc));
+
+	rc = cuMemcpyHtoDAsync(m_kmrels, h_kmrels, bytesize, stream);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(DEBUG1, "failed on cuMemcpyHtoDAsync: %s", errorText(rc));
+		goto bailout;
+	}
+	rc = cuEventRecord(event, stream);
+	if (rc != CUDA_SUCCESS)
+	{
+		elog(DEBUG1, "failed on cuEventRecord: %s", errorText(rc));
+		goto bailout;
+	}
+	gjs->inner_load_stream = stream;
+	gjs->inner_load_event = event;
+	gjs->inner_load_hostreg = hostreg;
+	return true;
+
+bailout:
+	/* falls back to the synchronous copy */
+	(void) cuStreamSynchronize(stream);
+	if (hostreg)
+		(void) cuMemHostUnregister(hostreg);
+	if (event)
+		(void) cuEventDestroy(event);
+	(void) cuStreamDestroy(stream);
+	return false;
+}
+
+/*
+ * __innerPreloadWaitAsyncCopy
+ *
+ * It waits for completion of the asynchronous copy of the inner buffer, if
+ * any, then releases the related resources.
+ */
+static void
+__innerPreloadWaitAsyncCopy(GpuJoinState *gjs)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	CUresult		rc;
+
+	if (!gjs->inner_load_event)
+		return;
+	GPUCONTEXT_PUSH(gcontext);
+	rc = cuEventSynchronize(gjs->inner_load_event);
+	if (rc != CUDA_SUCCESS)
+		elog(WARNING, "failed on cuEventSynchronize: %s", errorText(rc));
+	if (gjs->inner_load_hostreg)
+	{
+		rc = cuMemHostUnregister(gjs->inner_load_hostreg);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on cuMemHostUnregister: %s", errorText(rc));
+	}
+	rc = cuEventDestroy(gjs->inner_load_event);
+	if (rc != CUDA_SUCCESS)
+		elog(WARNING, "failed on cuEventDestroy: %s", errorText(rc));
+	rc = cuStreamDestroy(gjs->inner_load_stream);
+	if (rc != CUDA_SUCCESS)
+		elog(WARNING, "failed on cuStreamDestroy: %s", errorText(rc));
+	GPUCONTEXT_POP(gcontext);
+
+	gjs->inner_load_stream = NULL;
+	gjs->inner_load_event = NULL;
+	gjs->inner_load_hostreg = NULL;
+}
+
+/*
+ * GpuJoinInnerSyncDeviceBuffer
+ *
+ * It makes the current stream wait for completion of the asynchronous copy
+ * of the inner buffer. Called by the worker thread prior to kernel launch.
+ */
+void
+GpuJoinInnerSyncDeviceBuffer(GpuTaskState *gts)
+{
+	GpuJoinState   *gjs = (GpuJoinState *) gts;
+	CUresult		rc;
+
+	if (gjs->inner_load_event)
+	{
+		rc = cuStreamWaitEvent(CU_STREAM_PER_THREAD,
+							   gjs->inner_load_event, 0);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuStreamWaitEvent: %s", errorText(rc));
+	}
+}
+
+/*
+ * __innerPreloadLoadManagedBuffer
+ *
+ * It loads the inner buffer onto the managed memory, if the preserved device
+ * memory is not available under pg_strom.gpu_memory_oversubscription. GPU
+ * kernel never updates the inner buffer except for the outer-join-map, so
+ * the device makes read-only copies of the pages on demand, and the leading
+ * portion is prefetched. Unlike the preserved memory, it is not shared with
+ * the parallel workers, so it is available only if no outer-join-map.
+ */
+static bool
+__innerPreloadLoadManagedBuffer(GpuJoinState *gjs, size_t bytesize)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	CUdeviceptr		m_kmrels;
+	CUresult		rc;
+
+	if (!pgstrom_gpu_memory_oversubscription || h_kmrels->ojmaps_length > 0)
+		return false;
+	rc = gpuMemAllocManagedRaw(gcontext,
+							   &m_kmrels,
+							   bytesize,
+							   CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		return false;
+	memcpy((void *)m_kmrels, h_kmrels, bytesize);
+
+	GPUCONTEXT_PUSH(gcontext);
+	__innerPreloadInitGiSTIndex(gjs, m_kmrels);
+	rc = gpuMemAdviseManaged(gcontext, m_kmrels, bytesize,
+							 bytesize, true, CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		elog(DEBUG1, "failed on gpuMemAdviseManaged: %s", errorText(rc));
+	GPUCONTEXT_POP(gcontext);
+
+	elog(DEBUG1, "GpuJoin inner buffer (%zu bytes) is loaded on the managed memory",
+		 bytesize);
+	gjs->m_kmrels = m_kmrels;
+	gjs->m_kmrels_owner = true;
+	gjs->m_kmrels_managed = true;
+	if (gjs->sibling)
+		gjs->sibling->pergpu[gcontext->cuda_dindex].m_kmrels = m_kmrels;
+	return true;
+}
+
+static void
+innerPreloadLoadDeviceBuffer(GpuJoinState *leader,
+							 GpuJoinState *gjs)
+{
+	GpuContext	   *gcontext = gjs->gts.gcontext;
+	GpuJoinSiblingState *sibling = gjs->sibling;
+	GpuJoinSharedState *gj_sstate = leader->gj_sstate;
+	kern_multirels *h_kmrels = gjs->h_kmrels;
+	int				dindex = gcontext->cuda_dindex;
+
+	Assert(leader->sibling == gjs->sibling);	
+	if (sibling && sibling->pergpu[dindex].m_kmrels != 0UL)
+	{
+		/*
+		 * In case of asymmetric partition-wise join, any of siblings
+		 * might already setup device buffer. Please note that leader
+		 * GpuJoinState prefers different GPU device from the current one.
+		 */
+		gjs->m_kmrels = sibling->pergpu[dindex].m_kmrels;
+		gjs->m_kmrels_owner = false;
+	}
+	else if (gj_sstate->pergpu[dindex].bytesize == 0)
+	{
+		CUdeviceptr		m_kmrels;
+		CUresult		rc;
+		size_t	bytesize = (h_kmrels->kmrels_length +
+							h_kmrels->ojmaps_length);
+
+		rc = gpuMemAllocPreserved(dindex,
+								  &gj_sstate->pergpu[dindex].ipc_mhandle,
+								  bytesize);
+		if (rc == CUDA_ERROR_OUT_OF_MEMORY &&
+			__innerPreloadLoadManagedBuffer(gjs, bytesize))
+			return;
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuMemAllocPreserved: %s", errorText(rc));
+		gj_sstate->pergpu[dindex].bytesize = bytesize;
+
+		rc = gpuIpcOpenMemHandle(gcontext,
+								 &m_kmrels,
+								 gj_sstate->pergpu[dindex].ipc_mhandle,
+								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+
+		GPUCONTEXT_PUSH(gcontext);
+		if (!__innerPreloadCopyFromPeerDevice(leader, gjs, m_kmrels) &&
+			!__innerPreloadAsyncCopyHtoD(leader, gjs, m_kmrels, bytesize))
+		{
+			rc = cuMemcpyHtoD(m_kmrels, h_kmrels, bytesize);
+			if (rc != CUDA_SUCCESS)
+				elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+			__innerPreloadInitGiSTIndex(gjs, m_kmrels);
+		}
+		GPUCONTEXT_POP(gcontext);
+
+		gjs->m_kmrels = m_kmrels;
+		gjs->m_kmrels_owner = true;
+		if (sibling)
+			sibling->pergpu[dindex].m_kmrels = m_kmrels;
+		/* add colocation count for each GPU device */
+		pg_atomic_fetch_add_u32(&gj_sstate->needs_colocation, 1);
+		gj_sstate->curr_outer_depth = -1;
+	}
+	else
+	{
+		CUdeviceptr		m_kmrels;
+		CUresult		rc;
+
+		rc = gpuIpcOpenMemHandle(gcontext,
+								 &m_kmrels,
+								 gj_sstate->pergpu[dindex].ipc_mhandle,
+								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+
+		gjs->m_kmrels = m_kmrels;
+		gjs->m_kmrels_owner = true;
+		if (sibling)
+			sibling->pergpu[dindex].m_kmrels = m_kmrels;
+	}
+}
+
+/*
+ * __gpujoinInnerCacheSnapshot
+ *
+ * It extracts the snapshot properties to identify the inner buffer. If
+ * current transaction has its own xid, the inner buffer may contain the
+ * uncommitted modification, so it is not shareable with others.
+ */
+static int
+__xid_comparator(const void *arg1, const void *arg2)
+{
+	TransactionId	xid1 = *((const TransactionId *) arg1);
+	TransactionId	xid2 = *((const TransactionId *) arg2);
+
+	if (xid1 < xid2)
+		return -1;
+	if (xid1 > xid2)
+		return 1;
+	return 0;
+}
+
+static bool
+__gpujoinInnerCacheSnapshot(GpuJoinState *gjs, GpuJoinInnerCacheSnap *snap)
+{
+	Snapshot	snapshot = gjs->gts.css.ss.ps.state->es_snapshot;
+
+	if (!snapshot ||
+		!IsMVCCSnapshot(snapshot) ||
+		snapshot->suboverflowed ||
+		snapshot->takenDuringRecovery ||
+		snapshot->xcnt + snapshot->subxcnt > GPUJOIN_INNER_CACHE_MAX_XIDS ||
+		TransactionIdIsValid(GetTopTransactionIdIfAny()))
+		return false;
+
+	memset(snap, 0, sizeof(GpuJoinInnerCacheSnap));
+	snap->xmin = snapshot->xmin;
+	snap->xmax = snapshot->xmax;
+	snap->xcnt = snapshot->xcnt;
+	snap->subxcnt = snapshot->subxcnt;
+	if (snapshot->xcnt > 0)
+	{
+		memcpy(snap->xids, snapshot->xip,
+			   sizeof(TransactionId) * snapshot->xcnt);
+		qsort(snap->xids, snapshot->xcnt,
+			  sizeof(TransactionId), __xid_comparator);
+	}
+	if (snapshot->subxcnt > 0)
+	{
+		memcpy(snap->xids + snapshot->xcnt, snapshot->subxip,
+			   sizeof(TransactionId) * snapshot->subxcnt);
+		qsort(snap->xids + snapshot->xcnt, snapshot->subxcnt,
+			  sizeof(TransactionId), __xid_comparator);
+	}
+	return true;
+}
+
+/*
+ * __gpujoinInnerCacheContentsVersion
+ *
+ * It returns the sum of the contents version of the GPU caches, if all the
+ * inner relations are scanned by GpuScan on GPU cache. Results of GPU cache
+ * scan are determined by the REDO logs applied, not the MVCC snapshot.
+ * @p_has_gpucache tells whether any inner relation is scanned on GPU cache.
+ */
+static bool
+__gpujoinInnerCacheContentsVersion(GpuJoinState *gjs, bool *p_has_gpucache,
+								   uint64 *p_generation, uint64 *p_write_pos)
+{
+	uint64		generation = 0;
+	uint64		write_pos = 0;
+	bool		has_gpucache = false;
+	bool		versioned = true;
+	int			i;
+
+	for (i=0; i < gjs->num_rels; i++)
+	{
+		PlanState  *ps = gjs->inners[i].state;
+		GpuTaskState *gts = (GpuTaskState *)ps;
+		uint64		__generation;
+		uint64		__write_pos;
+
+		if (!pgstrom_planstate_is_gpuscan(ps) || !gts->gc_state)
+		{
+			versioned = false;
+			continue;
+		}
+		has_gpucache = true;
+		if (!gpuCacheContentsVersion(gts->gc_state,
+									 &__generation,
+									 &__write_pos))
+		{
+			versioned = false;
+			continue;
+		}
+		generation += __generation;
+		write_pos  += __write_pos;
+	}
+	*p_has_gpucache = has_gpucache;
+	*p_generation   = generation;
+	*p_write_pos    = write_pos;
+
+	return versioned;
+}
+
+/*
+ * __gpujoinInnerCacheFreeBuffer
+ *
+ * It releases the host/device buffer of the (copy of) cache entry being
+ * already detached from the shared cache.
+ */
+static void
+__gpujoinInnerCacheFreeBuffer(GpuJoinInnerCacheEntry *entry)
+{
+	char		name[200];
+	int			dindex;
+	CUresult	rc;
+
+	for (dindex=0; dindex < numDevAttrs; dindex++)
+	{
+		if (entry->pergpu[dindex].bytesize == 0)
+			continue;
+		rc = gpuMemFreePreserved(dindex, entry->pergpu[dindex].ipc_mhandle);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuMemFreePreserved: %s",
+				 errorText(rc));
+	}
+	if (entry->shmem_handle != UINT_MAX)
+	{
+		snprintf(name, sizeof(name), "gpujoin_kmrels.%u.%08x.buf",
+				 PostPortNumber, entry->shmem_handle);
+		if (shm_unlink(name) != 0)
+			elog(WARNING, "failed on shm_unlink('%s'): %m", name);
+	}
+}
+
+/*
+ * __gpujoinInnerCacheUnpin
+ */
+static void
+__gpujoinInnerCacheUnpin(GpuJoinInnerCacheTracker *tracker)
+{
+	GpuJoinInnerCacheEntry *entry = GPUJOIN_INNER_CACHE_ENTRY(tracker->slot_id);
+	GpuJoinInnerCacheEntry *victim = palloc(gj_icache_head->entry_sz);
+
+	victim->in_use = false;
+	SpinLockAcquire(&gj_icache_head->lock);
+	Assert(entry->in_use && entry->refcnt > 0);
+	if (--entry->refcnt == 0 && !entry->is_valid)
+	{
+		memcpy(victim, entry, gj_icache_head->entry_sz);
+		entry->in_use = false;
+	}
+	SpinLockRelease(&gj_icache_head->lock);
+
+	dlist_delete(&tracker->chain);
+	pfree(tracker);
+	if (victim->in_use)
+		__gpujoinInnerCacheFreeBuffer(victim);
+	pfree(victim);
+}
+
+/*
+ * gpujoinInnerCacheLookup
+ *
+ * It looks up the inner buffer cache built on the same snapshot. If found,
+ * GpuJoin skips the inner preloading and uses the cached buffer instead.
+ */
+static void
+gpujoinInnerCacheLookup(GpuJoinState *gjs)
+{
+	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
+	GpuJoinInnerCacheEntry *entry;
+	GpuJoinInnerCacheEntry *victim;
+	GpuJoinInnerCacheTracker *tracker;
+	GpuJoinInnerCacheSnap snap;
+	uint64		generation;
+	uint64		write_pos;
+	bool		versioned;
+	bool		has_gpucache;
+	char		name[200];
+	int			i, dindex;
+
+	gjs->inner_cache_versioned = false;
+	if (!gpujoin_inner_cache_enabled ||
+		!gj_icache_head ||
+		gjs->inner_cache_hash == 0 ||
+		gjs->inner_cache_tracker != NULL ||
+		gjs->sibling != NULL ||
+		IsParallelWorker() ||
+		gj_sstate->ss_handle != UINT_MAX ||
+		gj_sstate->shmem_handle == UINT_MAX ||
+		!__gpujoinInnerCacheSnapshot(gjs, &snap))
+		return;
+	versioned = __gpujoinInnerCacheContentsVersion(gjs, &has_gpucache,
+												   &generation, &write_pos);
+	/* results of GPU cache scan are not identified by the snapshot */
+	if (!versioned && has_gpucache)
+		return;
+	gjs->inner_cache_versioned = versioned;
+	gjs->inner_cache_generation = generation;
+	gjs->inner_cache_write_pos = write_pos;
+
+	tracker = MemoryContextAllocZero(TopMemoryContext,
+									 sizeof(GpuJoinInnerCacheTracker));
+	tracker->slot_id = -1;
+	victim = palloc(gj_icache_head->entry_sz);
+	victim->in_use = false;
+
+	SpinLockAcquire(&gj_icache_head->lock);
+	for (i=0; i < gj_icache_head->nslots; i++)
+	{
+		entry = GPUJOIN_INNER_CACHE_ENTRY(i);
+		if (!entry->in_use)
+			continue;
+		if (entry->is_valid)
+		{
+			bool	same_key = (entry->key_hash == gjs->inner_cache_hash &&
+								entry->key_len  == gjs->inner_cache_len &&
+								entry->database_oid == MyDatabaseId);
+			bool	same_version;
+
+			if (entry->versioned)
+				same_version = (versioned &&
+								entry->generation == generation &&
+								entry->write_pos  == write_pos);
+			else
+				same_version = (!versioned &&
+								memcmp(&entry->snap, &snap,
+									   sizeof(GpuJoinInnerCacheSnap)) == 0);
+			if (same_key && same_version)
+			{
+				if (tracker->slot_id < 0)
+				{
+					entry->refcnt++;
+					entry->lru_clock = ++gj_icache_head->lru_clock;
+					tracker->slot_id = i;
+				}
+				continue;
+			}
+			/*
+			 * Buffer built on the older snapshot (or older contents of
+			 * the GPU cache) shall not be used by the later queries any more.
+			 */
+			if (entry->versioned)
+			{
+				if (same_key && versioned)
+					entry->is_valid = false;
+			}
+			else if (TransactionIdPrecedes(entry->snap.xmax, snap.xmin) ||
+					 (same_key && !TransactionIdFollows(entry->snap.xmax,
+														snap.xmax)))
+				entry->is_valid = false;
+		}
+		/* release one invalid entry per lookup */
+		if (!entry->is_valid && entry->refcnt == 0 && !victim->in_use)
+		{
+			memcpy(victim, entry, gj_icache_head->entry_sz);
+			entry->in_use = false;
+		}
+	}
+
+	if (tracker->slot_id >= 0)
+	{
+		entry = GPUJOIN_INNER_CACHE_ENTRY(tracker->slot_id);
+
+		/* replace the host buffer by the cached one */
+		snprintf(name, sizeof(name), "gpujoin_kmrels.%u.%08x.buf",
+				 PostPortNumber, gj_sstate->shmem_handle);
+		if (shm_unlink(name) != 0)
+			elog(WARNING, "failed on shm_unlink('%s'): %m", name);
+		gj_sstate->shmem_handle = entry->shmem_handle;
+		gj_sstate->shmem_bytesize = entry->shmem_bytesize;
+		for (dindex=0; dindex < numDevAttrs; dindex++)
+		{
+			gj_sstate->pergpu[dindex].bytesize
+				= entry->pergpu[dindex].bytesize;
+			memcpy(&gj_sstate->pergpu[dindex].ipc_mhandle,
+				   &entry->pergpu[dindex].ipc_mhandle,
+				   sizeof(CUipcMemHandle));
+		}
+	}
+	SpinLockRelease(&gj_icache_head->lock);
+
+	if (victim->in_use)
+		__gpujoinInnerCacheFreeBuffer(victim);
+	pfree(victim);
+
+	if (tracker->slot_id < 0)
+		pfree(tracker);
+	else
+	{
+		tracker->owner = CurrentResourceOwner;
+		dlist_push_head(&gj_icache_tracker_list, &tracker->chain);
+		gjs->inner_cache_tracker = tracker;
+		gjs->inner_cache_hit = true;
+		/* no need to run the inner preloading */
+		gj_sstate->phase = INNER_PHASE__GPUJOIN_EXEC;
+	}
+}
+
+/*
+ * gpujoinInnerCacheAttach
+ *
+ * It registers the inner buffer just built to the cache, or adds the device
+ * memory loaded on the current GPU to the cache entry already pinned.
+ */
+static void
+gpujoinInnerCacheAttach(GpuJoinState *gjs)
+{
+	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
+	GpuJoinInnerCacheEntry *entry;
+	GpuJoinInnerCacheEntry *victim;
+	GpuJoinInnerCacheTracker *tracker;
+	GpuJoinInnerCacheSnap snap;
+	uint64		generation;
+	uint64		write_pos;
+	bool		versioned;
+	bool		has_gpucache;
+	int			i, slot_id = -1;
+	int			dindex = gjs->gts.gcontext->cuda_dindex;
+
+	if (gjs->inner_cache_attached)
+		return;
+	gjs->inner_cache_attached = true;
+
+	/* other queries may use the device buffer immediately */
+	__innerPreloadWaitAsyncCopy(gjs);
+
+	if (gjs->inner_cache_tracker)
+	{
+		tracker = gjs->inner_cache_tracker;
+		entry = GPUJOIN_INNER_CACHE_ENTRY(tracker->slot_id);
+
+		SpinLockAcquire(&gj_icache_head->lock);
+		if (entry->is_valid &&
+			entry->pergpu[dindex].bytesize == 0 &&
+			gj_sstate->pergpu[dindex].bytesize != 0)
+		{
+			entry->pergpu[dindex].bytesize
+				= gj_sstate->pergpu[dindex].bytesize;
+			memcpy(&entry->pergpu[dindex].ipc_mhandle,
+				   &gj_sstate->pergpu[dindex].ipc_mhandle,
+				   sizeof(CUipcMemHandle));
+		}
+		SpinLockRelease(&gj_icache_head->lock);
+		return;
+	}
+
+	if (!gpujoin_inner_cache_enabled ||
+		!gj_icache_head ||
+		gjs->inner_cache_hash == 0 ||
+		gjs->sibling != NULL ||
+		gj_sstate->ss_handle != UINT_MAX ||
+		IsParallelWorker() ||
+		gj_sstate->phase != INNER_PHASE__GPUJOIN_EXEC ||
+		gj_sstate->shmem_handle == UINT_MAX ||
+		gj_sstate->shmem_bytesize > ((size_t)gpujoin_inner_cache_max_size_kb
+									 << 10) ||
+		!__gpujoinInnerCacheSnapshot(gjs, &snap))
+		return;
+	/*
+	 * GPU cache must not be updated during the inner preloading, because
+	 * the buffer is identified by the version prior to the preloading.
+	 */
+	versioned = __gpujoinInnerCacheContentsVersion(gjs, &has_gpucache,
+												   &generation, &write_pos);
+	if (versioned != gjs->inner_cache_versioned ||
+		(!versioned && has_gpucache) ||
+		(versioned && (generation != gjs->inner_cache_generation ||
+					   write_pos  != gjs->inner_cache_write_pos)))
+		return;
+
+	tracker = MemoryContextAllocZero(TopMemoryContext,
+									 sizeof(GpuJoinInnerCacheTracker));
+	victim = palloc(gj_icache_head->entry_sz);
+	victim->in_use = false;
+
+	SpinLockAcquire(&gj_icache_head->lock);
+	for (i=0; i < gj_icache_head->nslots; i++)
+	{
+		entry = GPUJOIN_INNER_CACHE_ENTRY(i);
+		if (!entry->in_use)
+		{
+			if (slot_id < 0 || GPUJOIN_INNER_CACHE_ENTRY(slot_id)->in_use)
+				slot_id = i;
+			continue;
+		}
+		/* someone already registered the equivalent buffer */
+		if (entry->is_valid &&
+			entry->key_hash == gjs->inner_cache_hash &&
+			entry->key_len  == gjs->inner_cache_len &&
+			entry->database_oid == MyDatabaseId &&
+			entry->versioned == versioned &&
+			(versioned
+			 ? (entry->generation == generation &&
+				entry->write_pos  == write_pos)
+			 : memcmp(&entry->snap, &snap, sizeof(GpuJoinInnerCacheSnap)) == 0))
+		{
+			slot_id = -1;
+			break;
+		}
+		/* elsewhere, release the least recently used entry */
+		if (entry->refcnt == 0 &&
+			(slot_id < 0 ||
+			 (GPUJOIN_INNER_CACHE_ENTRY(slot_id)->in_use &&
+			  GPUJOIN_INNER_CACHE_ENTRY(slot_id)->lru_clock > entry->lru_clock)))
+			slot_id = i;
+	}
+
+	if (slot_id >= 0)
+	{
+		entry = GPUJOIN_INNER_CACHE_ENTRY(slot_id);
+		if (entry->in_use)
+			memcpy(victim, entry, gj_icache_head->entry_sz);
+		memset(entry, 0, gj_icache_head->entry_sz);
+		entry->in_use = true;
+		entry->is_valid = true;
+		entry->refcnt = 1;
+		entry->lru_clock = ++gj_icache_head->lru_clock;
+		entry->key_hash = gjs->inner_cache_hash;
+		entry->key_len = gjs->inner_cache_len;
+		entry->database_oid = MyDatabaseId;
+		memcpy(&entry->snap, &snap, sizeof(GpuJoinInnerCacheSnap));
+		entry->versioned = versioned;
+		entry->generation = generation;
+		entry->write_pos = write_pos;
+		entry->shmem_handle = gj_sstate->shmem_handle;
+		entry->shmem_bytesize = gj_sstate->shmem_bytesize;
+		for (i=0; i < numDevAttrs; i++)
+		{
+			entry->pergpu[i].bytesize = gj_sstate->pergpu[i].bytesize;
+			memcpy(&entry->pergpu[i].ipc_mhandle,
+				   &gj_sstate->pergpu[i].ipc_mhandle,
+				   sizeof(CUipcMemHandle));
+		}
+	}
+	SpinLockRelease(&gj_icache_head->lock);
+
+	if (victim->in_use)
+		__gpujoinInnerCacheFreeBuffer(victim);
+	pfree(victim);
+
+	if (slot_id < 0)
+		pfree(tracker);
+	else
+	{
+		tracker->owner = CurrentResourceOwner;
+		tracker->slot_id = slot_id;
+		dlist_push_head(&gj_icache_tracker_list, &tracker->chain);
+		gjs->inner_cache_tracker = tracker;
+	}
+}
+
+/*
+ * gpujoinInnerCacheRelease
+ *
+ * It unpins the cache entry. Host/device buffers owned by the cache entry
+ * are detached from the GpuJoinSharedState, not to be released by the
+ * GpuJoinInnerUnload().
+ */
+static void
+gpujoinInnerCacheRelease(GpuJoinState *gjs)
+{
+	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
+	GpuJoinInnerCacheTracker *tracker = gjs->inner_cache_tracker;
+	GpuJoinInnerCacheEntry *entry;
+	int			dindex;
+
+	gjs->inner_cache_tracker = NULL;
+	gjs->inner_cache_attached = false;
+	if (!tracker)
+		return;
+	entry = GPUJOIN_INNER_CACHE_ENTRY(tracker->slot_id);
+	if (gj_sstate)
 	{
-		if (!gjs->inners[depth-1].gist_irel)
-			continue;
-		/* load the CUDA module and function */
-		if (!cuda_module)
+		SpinLockAcquire(&gj_icache_head->lock);
+		if (gj_sstate->shmem_handle == entry->shmem_handle)
 		{
-			cuda_module = GpuContextLookupModule(gcontext,
-												 gjs->gts.program_id);
-           rc = cuModuleGetFunction(&f_prep_gistindex,
-                                    cuda_module,
-                                    "gpujoin_prep_gistindex");
-           if (rc != CUDA_SUCCESS)
-               elog(ERROR, "failed on cuModuleGetFunction: %s", errorText(rc));
-           rc = gpuOptimalBlockSize(&grid_sz,
-                                    &block_sz,
-                                    f_prep_gistindex,
-                                    gcontext->cuda_device,
-                                    0, 0);
-          if (rc != CUDA_SUCCESS)
-               elog(ERROR, "failed on gpuOptimalBlockSize: %s", errorText(rc));
-       }
-       /* launch kern_gpujoin_prep_gistindex */
-       kern_args[0] = &m_kmrels;
-       kern_args[1] = &depth;
+			gj_sstate->shmem_handle = UINT_MAX;
+			gj_sstate->shmem_bytesize = 0;
+		}
+		for (dindex=0; dindex < numDevAttrs; dindex++)
+		{
+			if (gj_sstate->pergpu[dindex].bytesize != 0 &&
+				entry->pergpu[dindex].bytesize != 0 &&
+				memcmp(&gj_sstate->pergpu[dindex].ipc_mhandle,
+					   &entry->pergpu[dindex].ipc_mhandle,
+					   sizeof(CUipcMemHandle)) == 0)
+				gj_sstate->pergpu[dindex].bytesize = 0;
+		}
+		SpinLockRelease(&gj_icache_head->lock);
+	}
+	__gpujoinInnerCacheUnpin(tracker);
+}
 
-       rc = cuLaunchKernel(f_prep_gistindex,
-                           grid_sz, 1, 1,
-                           block_sz, 1, 1,
-                           0,
-                           CU_STREAM_PER_THREAD,
-                           kern_args,
-                           NULL);
-       if (rc != CUDA_SUCCESS)
-           elog(ERROR, "failed on cuLaunchKernel: %s", errorText(rc));
-   }
+/*
+ * gpujoinInnerCacheCleanup - unpin the cache entries on abort
+ */
+static void
+gpujoinInnerCacheCleanup(ResourceReleasePhase phase,
+						 bool isCommit,
+						 bool isTopLevel,
+						 void *arg)
+{
+	dlist_mutable_iter	iter;
 
-   if (cuda_module)
-   {
-       rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
-       if (rc != CUDA_SUCCESS)
-           elog(ERROR, "failed on cuStreamSynchronize: %s", errorText(rc));
-   }
+	if (phase != RESOURCE_RELEASE_BEFORE_LOCKS)
+		return;
+	dlist_foreach_modify(iter, &gj_icache_tracker_list)
+	{
+		GpuJoinInnerCacheTracker *tracker
+			= dlist_container(GpuJoinInnerCacheTracker, chain, iter.cur);
+
+		if (tracker->owner == CurrentResourceOwner)
+			__gpujoinInnerCacheUnpin(tracker);
+	}
 }
 
+/*
+ * gpujoinSetupOuterRangeParams
+ */
 static void
-innerPreloadLoadDeviceBuffer(GpuJoinState *leader,
-							 GpuJoinState *gjs)
+gpujoinSetupOuterRangeParams(GpuJoinState *gjs)
 {
-	GpuContext	   *gcontext = gjs->gts.gcontext;
-	GpuJoinSiblingState *sibling = gjs->sibling;
-	GpuJoinSharedState *gj_sstate = leader->gj_sstate;
-	kern_multirels *h_kmrels = gjs->h_kmrels;
-	int				dindex = gcontext->cuda_dindex;
+	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
+	EState		   *estate = gjs->gts.css.ss.ps.state;
+	ParamExecData  *prm_min;
+	ParamExecData  *prm_max;
+	cl_long			range_min;
+	cl_long			range_max;
 
-	Assert(leader->sibling == gjs->sibling);	
-	if (sibling && sibling->pergpu[dindex].m_kmrels != 0UL)
+	Assert(!gjs->sibling);
+	SpinLockAcquire(&gj_sstate->mutex);
+	if (gj_sstate->outer_range_valid)
+	{
+		range_min = gj_sstate->outer_range_min;
+		range_max = gj_sstate->outer_range_max;
+	}
+	else
 	{
 		/*
-		 * In case of asymmetric partition-wise join, any of siblings
-		 * might already setup device buffer. Please note that leader
-		 * GpuJoinState prefers different GPU device from the current one.
+		 * The inner buffer was not built by this query (e.g, reused from
+		 * the inner buffer cache), so we cannot skip any record-batches.
 		 */
-		gjs->m_kmrels = sibling->pergpu[dindex].m_kmrels;
-		gjs->m_kmrels_owner = false;
+		outer_range_key_type_bounds(gjs->outer_range_type,
+									&range_min, &range_max);
 	}
-	else if (gj_sstate->pergpu[dindex].bytesize == 0)
-	{
-		CUdeviceptr		m_kmrels;
-		CUresult		rc;
-		size_t	bytesize = (h_kmrels->kmrels_length +
-							h_kmrels->ojmaps_length);
-
-		rc = gpuMemAllocPreserved(dindex,
-								  &gj_sstate->pergpu[dindex].ipc_mhandle,
-								  bytesize);
-		if (rc != CUDA_SUCCESS)
-			elog(ERROR, "failed on gpuMemAllocPreserved: %s", errorText(rc));
-		gj_sstate->pergpu[dindex].bytesize = bytesize;
-
-		rc = gpuIpcOpenMemHandle(gcontext,
-								 &m_kmrels,
-								 gj_sstate->pergpu[dindex].ipc_mhandle,
-								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
-		if (rc != CUDA_SUCCESS)
-			elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
-
-		GPUCONTEXT_PUSH(gcontext);
-		rc = cuMemcpyHtoD(m_kmrels, h_kmrels, bytesize);
-		if (rc != CUDA_SUCCESS)
-			elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
-		__innerPreloadInitGiSTIndex(gjs, m_kmrels);
-		GPUCONTEXT_POP(gcontext);
+	SpinLockRelease(&gj_sstate->mutex);
 
-		gjs->m_kmrels = m_kmrels;
-		gjs->m_kmrels_owner = true;
-		if (sibling)
-			sibling->pergpu[dindex].m_kmrels = m_kmrels;
-		/* add colocation count for each GPU device */
-		pg_atomic_fetch_add_u32(&gj_sstate->needs_colocation, 1);
-		gj_sstate->curr_outer_depth = -1;
+	prm_min = &estate->es_param_exec_vals[gjs->outer_range_param];
+	prm_max = &estate->es_param_exec_vals[gjs->outer_range_param + 1];
+	prm_min->execPlan = NULL;
+	prm_max->execPlan = NULL;
+	if (range_min > range_max)
+	{
+		/* no valid join-keys on the inner side, so nothing will match */
+		prm_min->value = 0;
+		prm_min->isnull = true;
+		prm_max->value = 0;
+		prm_max->isnull = true;
 	}
 	else
 	{
-		CUdeviceptr		m_kmrels;
-		CUresult		rc;
-
-		rc = gpuIpcOpenMemHandle(gcontext,
-								 &m_kmrels,
-								 gj_sstate->pergpu[dindex].ipc_mhandle,
-								 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
-		if (rc != CUDA_SUCCESS)
-			elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
-
-		gjs->m_kmrels = m_kmrels;
-		gjs->m_kmrels_owner = true;
-		if (sibling)
-			sibling->pergpu[dindex].m_kmrels = m_kmrels;
+		prm_min->value = outer_range_key_int64_to_datum(gjs->outer_range_type,
+														range_min);
+		prm_min->isnull = false;
+		prm_max->value = outer_range_key_int64_to_datum(gjs->outer_range_type,
+														range_max);
+		prm_max->isnull = false;
 	}
 }
 
@@ -8064,6 +11403,12 @@ GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels)
 		leader = gjs;
 	gj_sstate = leader->gj_sstate;
 
+	/*
+	 * Reuse the inner buffer built by other queries, if any
+	 */
+	if (gj_sstate->phase == INNER_PHASE__SCAN_RELATIONS)
+		gpujoinInnerCacheLookup(gjs);
+
 	/*
 	 * Inner PreLoad State Machine
 	 */
@@ -8091,6 +11436,18 @@ GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels)
 				 * to prevent other worker try to start inner scan.
 				 */
 				SpinLockAcquire(&gj_sstate->mutex);
+				if (leader->outer_range_key >= 0)
+				{
+					innerState *istate = &leader->inners[0];
+
+					gj_sstate->outer_range_min = Min(gj_sstate->outer_range_min,
+													 istate->key_range_min);
+					gj_sstate->outer_range_max = Max(gj_sstate->outer_range_max,
+													 istate->key_range_max);
+					gj_sstate->outer_range_valid = true;
+					istate->key_range_min = PG_INT64_MAX;
+					istate->key_range_max = PG_INT64_MIN;
+				}
 				if (gj_sstate->phase == INNER_PHASE__SCAN_RELATIONS)
 					gj_sstate->phase = INNER_PHASE__SETUP_BUFFERS;
 				else
@@ -8163,6 +11520,7 @@ GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels)
 												  usage_base);
 				else if (kds->format == KDS_FORMAT_HASH)
 					__innerPreloadSetupHashBuffer(kds, istate,
+												  GPUJOIN_RUNTIME_STAT(gj_sstate),
 												  nitems_base,
 												  usage_base);
 				else
@@ -8197,6 +11555,19 @@ GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels)
 						((char *)h_kmrels + h_kmrels->chunks[i].gist_offset);
 					__innerPreloadSetupGiSTIndexBuffer(istate, kds_gist);
 				}
+				/* build grid index, if any */
+				for (i=0; i < leader->num_rels; i++)
+				{
+					innerState *istate = &leader->inners[i];
+					kern_data_store *kds_in;
+					kern_gpujoin_grid *grid;
+
+					if (istate->grid_resno == 0)
+						continue;
+					kds_in = KERN_MULTIRELS_INNER_KDS(h_kmrels, i+1);
+					grid = KERN_MULTIRELS_GRID_INDEX(h_kmrels, i+1);
+					__innerPreloadSetupGridIndex(istate, kds_in, grid);
+				}
 				gj_sstate->phase = INNER_PHASE__GPUJOIN_EXEC;
 				ConditionVariableBroadcast(&gj_sstate->cond);
 			}
@@ -8245,6 +11616,31 @@ GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels)
 	}
 	SpinLockRelease(&gj_sstate->mutex);
 
+	/*
+	 * Give the range of join-key to skip the outer record-batches
+	 */
+	if (gjs->m_kmrels != 0UL && gjs->outer_range_param >= 0)
+		gpujoinSetupOuterRangeParams(gjs);
+
+	/*
+	 * Register the inner buffer to the cache, for the later queries
+	 */
+	if (gjs->m_kmrels != 0UL && gjs->inner_cache_hash != 0)
+		gpujoinInnerCacheAttach(gjs);
+
+	/*
+	 * If outer GpuScan has bloom-filter, it shall be built from the hash
+	 * values of the inner hash table at depth=1.
+	 */
+	if (gjs->m_kmrels != 0UL && gjs->h_kmrels != NULL)
+	{
+		PlanState  *outer_ps = outerPlanState(gjs);
+
+		if (outer_ps && pgstrom_planstate_is_gpuscan(outer_ps))
+			pgstromGpuScanSetupBloomFilter(outer_ps,
+				KERN_MULTIRELS_INNER_KDS(gjs->h_kmrels, 1));
+	}
+
 	/*
 	 * Any backend or worker process, that tried to fetch the inner buffer
 	 * after the 'phase' is switched to INNER_PHASE__GPUJOIN_CLOSING, shall
@@ -8268,17 +11664,40 @@ GpuJoinInnerUnload(GpuTaskState *gts, bool is_rescan)
 	CUresult		rc;
 	int				dindex;
 
+	/* inner buffer may be still under the asynchronous copy */
+	__innerPreloadWaitAsyncCopy(gjs);
+
 	if (gjs->m_kmrels)
 	{
 		if (gjs->m_kmrels_owner)
 		{
-			rc = gpuIpcCloseMemHandle(gcontext, gjs->m_kmrels);
-			if (rc != CUDA_SUCCESS)
-				elog(WARNING, "failed on gpuIpcCloseMemHandle: %s",
-					 errorText(rc));
+			if (gjs->m_kmrels_managed)
+			{
+				rc = gpuMemFree(gcontext, gjs->m_kmrels);
+				if (rc != CUDA_SUCCESS)
+					elog(WARNING, "failed on gpuMemFree: %s", errorText(rc));
+				gjs->m_kmrels_managed = false;
+			}
+			else
+			{
+				rc = gpuIpcCloseMemHandle(gcontext, gjs->m_kmrels);
+				if (rc != CUDA_SUCCESS)
+					elog(WARNING, "failed on gpuIpcCloseMemHandle: %s",
+						 errorText(rc));
+			}
+			/* siblings must not reference the device buffer any more */
+			if (gjs->sibling)
+			{
+				dindex = gcontext->cuda_dindex;
+				if (gjs->sibling->pergpu[dindex].m_kmrels == gjs->m_kmrels)
+					gjs->sibling->pergpu[dindex].m_kmrels = 0UL;
+			}
 		}
 		gjs->m_kmrels = 0UL;
 	}
+	/* the next inner buffer shall be processed by the siblings again */
+	if (gjs->sibling && gjs->sibling->leader == gjs)
+		gjs->sibling->nr_processed = 0;
 
 	if (gjs->h_kmrels)
 	{
@@ -8290,6 +11709,9 @@ GpuJoinInnerUnload(GpuTaskState *gts, bool is_rescan)
 		gjs->h_kmrels = NULL;
 	}
 
+	/* buffers owned by the inner buffer cache shall not be released */
+	gpujoinInnerCacheRelease(gjs);
+
 	if (gj_sstate && !IsParallelWorker())
 	{
 		char		name[200];
@@ -8318,32 +11740,22 @@ GpuJoinInnerUnload(GpuTaskState *gts, bool is_rescan)
 	gjs->h_kmrels = NULL;
 	gjs->m_kmrels = 0UL;
 	gjs->m_kmrels_owner = false;
+	gjs->m_kmrels_managed = false;
 }
 
 /*
- * createGpuJoinSharedState
+ * __createGpuJoinShmemBuffer
  *
- * It construct an empty inner multi-relations buffer. It can be shared with
- * multiple backends, and referenced by CPU/GPU.
+ * creation of the host inner buffer, but fallocate(2) and mmap(2) shall be
+ * done after the inner-preloading.
  */
-static size_t
-createGpuJoinSharedState(GpuJoinState *gjs,
-						 ParallelContext *pcxt,
-						 void *dsm_addr)
+static cl_uint
+__createGpuJoinShmemBuffer(void)
 {
-	EState	   *estate = gjs->gts.css.ss.ps.state;
-	GpuJoinSharedState *gj_sstate;
-	GpuJoinRuntimeStat *gj_rtstat;
 	cl_uint		shmem_handle;
 	int			fdesc = -1;
 	char		name[200];
-	size_t		ss_length;
 
-	Assert(!IsParallelWorker());
-	/*
-	 * creation of the host inner buffer, but fallocate(2) and mmap(2)
-	 * shall be done after the inner-preloading.
-	 */
 	while (fdesc < 0)
 	{
 		shmem_handle = random();
@@ -8357,6 +11769,29 @@ createGpuJoinSharedState(GpuJoinState *gjs,
 	}
 	close(fdesc);
 
+	return shmem_handle;
+}
+
+/*
+ * createGpuJoinSharedState
+ *
+ * It construct an empty inner multi-relations buffer. It can be shared with
+ * multiple backends, and referenced by CPU/GPU.
+ */
+static size_t
+createGpuJoinSharedState(GpuJoinState *gjs,
+						 ParallelContext *pcxt,
+						 void *dsm_addr)
+{
+	EState	   *estate = gjs->gts.css.ss.ps.state;
+	GpuJoinSharedState *gj_sstate;
+	GpuJoinRuntimeStat *gj_rtstat;
+	cl_uint		shmem_handle;
+	size_t		ss_length;
+
+	Assert(!IsParallelWorker());
+	shmem_handle = __createGpuJoinShmemBuffer();
+
 	/* allocation of the GpuJoinSharedState */
 	ss_length = (MAXALIGN(offsetof(GpuJoinSharedState,
 								   pergpu[numDevAttrs])) +
@@ -8377,6 +11812,9 @@ createGpuJoinSharedState(GpuJoinState *gjs,
 	gj_sstate->nr_workers_setup = 0;
 	pg_atomic_init_u32(&gj_sstate->outer_scan_done, 0);
 	pg_atomic_init_u32(&gj_sstate->needs_colocation, 0);
+	gj_sstate->outer_range_valid = false;
+	gj_sstate->outer_range_min = PG_INT64_MAX;
+	gj_sstate->outer_range_max = PG_INT64_MIN;
 
 	gj_rtstat = GPUJOIN_RUNTIME_STAT(gj_sstate);
 	SpinLockInit(&gj_rtstat->c.lock);
@@ -8386,6 +11824,47 @@ createGpuJoinSharedState(GpuJoinState *gjs,
 	return ss_length;
 }
 
+/*
+ * resetGpuJoinSharedState
+ *
+ * It rewinds the shared-state to the initial phase, after the inner buffer
+ * is released by GpuJoinInnerUnload(), to load the next partition of the
+ * inner hash table. Only single process execution can reach here.
+ */
+static void
+resetGpuJoinSharedState(GpuJoinState *gjs)
+{
+	GpuJoinSharedState *gj_sstate = gjs->gj_sstate;
+	GpuJoinRuntimeStat *gj_rtstat;
+	int			i;
+
+	Assert(!IsParallelWorker() && !gjs->sibling);
+	if (!gj_sstate)
+		return;
+	if (gj_sstate->shmem_handle == UINT_MAX)
+		gj_sstate->shmem_handle = __createGpuJoinShmemBuffer();
+	gj_sstate->shmem_bytesize = 0;
+	gj_sstate->phase = INNER_PHASE__SCAN_RELATIONS;
+	gj_sstate->nr_workers_scanning = 0;
+	gj_sstate->nr_workers_setup = 0;
+	pg_atomic_write_u32(&gj_sstate->outer_scan_done, 0);
+	pg_atomic_write_u32(&gj_sstate->needs_colocation, 0);
+	gj_sstate->curr_outer_depth = 0;
+	gj_sstate->outer_range_valid = false;
+	gj_sstate->outer_range_min = PG_INT64_MAX;
+	gj_sstate->outer_range_max = PG_INT64_MIN;
+	for (i=0; i < numDevAttrs; i++)
+		gj_sstate->pergpu[i].nr_workers_gpujoin = 0;
+
+	/* inner buffer shall be sized according to the next partition */
+	gj_rtstat = GPUJOIN_RUNTIME_STAT(gj_sstate);
+	for (i=0; i <= gjs->num_rels; i++)
+	{
+		pg_atomic_write_u64(&gj_rtstat->jstat[i].inner_nrooms, 0);
+		pg_atomic_write_u64(&gj_rtstat->jstat[i].inner_usage, 0);
+	}
+}
+
 /*
  * cleanupGpuJoinSharedStateOnAbort
  */
@@ -8419,6 +11898,33 @@ cleanupGpuJoinSharedStateOnAbort(dsm_segment *seg, Datum ptr)
 	}
 }
 
+/*
+ * pgstrom_startup_gpujoin
+ */
+static void
+pgstrom_startup_gpujoin(void)
+{
+	size_t		entry_sz;
+	size_t		length;
+	bool		found;
+
+	if (shmem_startup_next)
+		(*shmem_startup_next)();
+
+	entry_sz = MAXALIGN(offsetof(GpuJoinInnerCacheEntry,
+								 pergpu[numDevAttrs]));
+	length = offsetof(GpuJoinInnerCacheHead,
+					  data[entry_sz * gpujoin_inner_cache_nslots]);
+	gj_icache_head = ShmemInitStruct("GpuJoin Inner Buffer Cache",
+									 length, &found);
+	if (found)
+		elog(ERROR, "Bug? shared memory for GpuJoin inner buffer cache already exists");
+	memset(gj_icache_head, 0, length);
+	SpinLockInit(&gj_icache_head->lock);
+	gj_icache_head->nslots = gpujoin_inner_cache_nslots;
+	gj_icache_head->entry_sz = entry_sz;
+}
+
 /*
  * pgstrom_init_gpujoin
  *
@@ -8454,6 +11960,15 @@ pgstrom_init_gpujoin(void)
 							 PGC_USERSET,
 							 GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
+	/* turn on/off gpugridindex */
+	DefineCustomBoolVariable("pg_strom.enable_gpugridindex",
+							 "Enables the use of GpuGridIndex logic",
+							 NULL,
+							 &enable_gpugridindex,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 #if PG_VERSION_NUM >= 110000
 	/* turn on/off partition wise gpujoin */
 	DefineCustomBoolVariable("pg_strom.enable_partitionwise_gpujoin",
@@ -8467,6 +11982,89 @@ pgstrom_init_gpujoin(void)
 #else
 	enable_partitionwise_gpujoin = false;
 #endif
+	/* turn on/off asynchronous copy of the inner buffer */
+	DefineCustomBoolVariable("pg_strom.gpujoin_inner_async_load",
+							 "Enables asynchronous copy of inner buffer, overlapped with outer scan",
+							 NULL,
+							 &gpujoin_inner_async_load,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* turn on/off skip of outer record-batches by the inner key range */
+	DefineCustomBoolVariable("pg_strom.gpujoin_outer_range_pruning",
+							 "Enables to skip outer Arrow record-batches out of the inner join-key range",
+							 NULL,
+							 &gpujoin_outer_range_pruning,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* turn on/off P2P copy of the inner buffer across GPU devices */
+	DefineCustomBoolVariable("pg_strom.gpujoin_inner_p2p_copy",
+							 "Enables P2P copy of inner buffer from other GPU device",
+							 NULL,
+							 &gpujoin_inner_p2p_copy,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* max number of partitions of the inner hash table */
+	DefineCustomIntVariable("pg_strom.gpujoin_max_inner_partitions",
+							"Max number of partitions of the inner hash table "
+							"that is larger than the limitation",
+							NULL,
+							&gpujoin_max_inner_partitions,
+							16,
+							1,
+							1024,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	/* turn on/off inner buffer cache across queries */
+	DefineCustomBoolVariable("pg_strom.gpujoin_inner_cache",
+							 "Enables to reuse inner buffer of GpuJoin by the later queries",
+							 NULL,
+							 &gpujoin_inner_cache_enabled,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* number of inner buffers kept in the cache */
+	DefineCustomIntVariable("pg_strom.gpujoin_inner_cache_nslots",
+							"Number of inner buffers of GpuJoin kept in the cache",
+							NULL,
+							&gpujoin_inner_cache_nslots,
+							32,
+							0,
+							4096,
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	/* max size of the inner buffer to be cached */
+	DefineCustomIntVariable("pg_strom.gpujoin_inner_cache_max_size",
+							"Max size of the inner buffer of GpuJoin to be cached",
+							NULL,
+							&gpujoin_inner_cache_max_size_kb,
+							256 * 1024,		/* 256MB */
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+	/* shared memory for the inner buffer cache */
+	if (gpujoin_inner_cache_nslots > 0)
+	{
+		RequestAddinShmemSpace(MAXALIGN(offsetof(GpuJoinInnerCacheHead, data)) +
+							   MAXALIGN(offsetof(GpuJoinInnerCacheEntry,
+												 pergpu[numDevAttrs])) *
+							   gpujoin_inner_cache_nslots);
+		shmem_startup_next = shmem_startup_hook;
+		shmem_startup_hook = pgstrom_startup_gpujoin;
+	}
+	dlist_init(&gj_icache_tracker_list);
+	RegisterResourceReleaseCallback(gpujoinInnerCacheCleanup, NULL);
+
 	/* setup path methods */
 	gpujoin_path_methods.CustomName				= "GpuJoin";
 	gpujoin_path_methods.PlanCustomPath			= PlanGpuJoinPath;
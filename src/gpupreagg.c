@@ -10,6 +10,7 @@
  * it under the terms of the PostgreSQL License.
  */
 #include "pg_strom.h"
+#include "cuda_numeric.h"
 #include "cuda_gpuscan.h"
 #include "cuda_gpujoin.h"
 #include "cuda_gpupreagg.h"
@@ -21,7 +22,12 @@ static CustomExecMethods	gpupreagg_exec_methods;
 static bool					enable_gpupreagg;				/* GUC */
 static bool					enable_pullup_outer_join;		/* GUC */
 static bool					enable_partitionwise_gpupreagg;	/* GUC */
+static bool					enable_partitionwise_shared_final; /* GUC */
+static bool					enable_parallel_shared_final;	/* GUC */
+static bool					enable_hll_device_estimation;	/* GUC */
 static bool					enable_numeric_aggfuncs; 		/* GUC */
+static bool					enable_sorted_gpupreagg;		/* GUC */
+static int					gpupreagg_result_cache_size;	/* GUC (kB) */
 static double				gpupreagg_reduction_threshold;	/* GUC */
 int							pgstrom_hll_register_bits;		/* GUC */
 
@@ -33,6 +39,9 @@ typedef struct
 	cl_int			accum_extra_bufsz;/* size of accumulation extra buffer */
 	double			plan_ngroups;	/* planned number of groups */
 	cl_int			plan_nchunks;	/* planned number of chunks */
+	bool			sorted_reduction; /* input is clustered by the keys */
+	cl_int			shared_final_id;  /* final buffer shared with the sibling
+									   * leafs under Append, if non-zero */
 	Cost			outer_startup_cost; /* copy of @startup_cost in outer */
 	Cost			outer_total_cost; /* copy of @total_cost in outer path */
 	double			outer_nrows;	/* number of estimated outer nrows */
@@ -64,6 +73,8 @@ form_gpupreagg_info(CustomScan *cscan, GpuPreAggInfo *gpa_info)
 	privs = lappend(privs, makeInteger(gpa_info->accum_extra_bufsz));
 	privs = lappend(privs, pmakeFloat(gpa_info->plan_ngroups));
 	privs = lappend(privs, makeInteger(gpa_info->plan_nchunks));
+	privs = lappend(privs, makeInteger(gpa_info->sorted_reduction));
+	privs = lappend(privs, makeInteger(gpa_info->shared_final_id));
 	privs = lappend(privs, pmakeFloat(gpa_info->outer_startup_cost));
 	privs = lappend(privs, pmakeFloat(gpa_info->outer_total_cost));
 	privs = lappend(privs, pmakeFloat(gpa_info->outer_nrows));
@@ -101,6 +112,8 @@ deform_gpupreagg_info(CustomScan *cscan)
 	gpa_info->accum_extra_bufsz = intVal(list_nth(privs, pindex++));
 	gpa_info->plan_ngroups = floatVal(list_nth(privs, pindex++));
 	gpa_info->plan_nchunks = intVal(list_nth(privs, pindex++));
+	gpa_info->sorted_reduction = intVal(list_nth(privs, pindex++));
+	gpa_info->shared_final_id = intVal(list_nth(privs, pindex++));
 	gpa_info->outer_startup_cost = floatVal(list_nth(privs, pindex++));
 	gpa_info->outer_total_cost = floatVal(list_nth(privs, pindex++));
 	gpa_info->outer_nrows = floatVal(list_nth(privs, pindex++));
@@ -135,6 +148,7 @@ typedef struct
 	struct GpuPreAggRuntimeStat *gpa_rtstat;
 	cl_bool			combined_gpujoin;
 	cl_bool			terminator_done;
+	cl_bool			sorted_reduction;	/* segmented reduction */
 	cl_int			num_group_keys;
 	cl_int			num_accum_values;	/* __GPUPREAGG_NUM_ACCUM_VALUES */
 	cl_int			accum_extra_bufsz;	/* __GPUPREAGG_ACCUM_EXTRA_BUFSZ */
@@ -153,12 +167,114 @@ typedef struct
 	size_t			f_hash_nslots;
 	size_t			f_hash_length;
 	pthread_mutex_t	f_mutex;
+	/* -- flush of the final buffer (protected by f_mutex) -- */
+	pthread_cond_t	f_cond;
+	size_t			f_nrooms_max;	/* max # of groups in the final buffer */
+	size_t			f_nrooms_running; /* # of rows under reduction */
+	cl_int			f_nr_running;	/* # of tasks under reduction */
+	/* columns of hll_count() to be compacted prior to the emission */
+	cl_int			hll_compact_natts;
+	cl_int		   *hll_compact_attnums;
 
 	size_t			plan_nrows_per_chunk;	/* planned nrows/chunk */
 	size_t			plan_nrows_in;	/* num of outer rows planned */
 	size_t			plan_ngroups;	/* num of groups planned */
+	/* set by GPU worker threads, then referenced by the later tasks */
+	volatile cl_bool local_bypass_hint;
+
+	/* result cache over GpuCache (see gpupreagg_setup_result_cache) */
+	char		   *rcache_key;		/* identifier of the GpuPreAgg, if any */
+	bool			rcache_checked;	/* true, if already set up */
+	struct GpuPreAggResultCache *rcache_replay;	/* entry to read, or */
+	struct GpuPreAggResultCache *rcache_build;	/* entry to be built */
+	cl_uint			rcache_index;	/* current position of replay */
+	cl_uint			rcache_nreplay;	/* # of tuples to be replayed from the
+									 * rcache_build, prior to the scan */
+	cl_uint			rcache_nbatches; /* # of record batches replayed */
+
+	/* aggregation by min/max statistics of arrow_fdw */
+	bool			stats_agg;		/* true, if arrow_fdw aggregates */
+	bool			stats_agg_done;	/* true, if already emitted */
+
+	/* final buffer shared with the sibling leafs (partition-wise) */
+	struct GpuPreAggSharedFinal *shared_final;
+	bool			shared_final_done; /* true, if counted as done */
+
+	/* final buffer on the device shared by the parallel workers */
+	CUdeviceptr		m_sf_kds;		/* kds_final mapped by CUDA IPC, if any */
+	CUdeviceptr		m_sf_fhash;		/* final hash-slot next to the kds_final */
+	bool			sf_owner;		/* true, if this process allocated it */
+	volatile bool	sf_attached;	/* true, if counted as attached */
+	volatile bool	sf_no_space;	/* true, if no more space for us */
+	bool			sf_done;		/* true, if counted as done */
+	cl_int			sf_nattached;	/* # of processes attached (EXPLAIN) */
 } GpuPreAggState;
 
+/*
+ * GpuPreAggSharedFinal
+ *
+ * Partition-wise GpuPreAgg under the Append node runs the leafs one by one.
+ * If groups may appear on multiple partitions, each leaf shall emit almost
+ * same groups, then CPU has to merge them again. So, a leaf hands over its
+ * final buffer to the next one at the end of the scan, instead of the
+ * emission. The last leaf emits the final buffer that contains the partial
+ * results of all the leafs. It is valid only if all the leafs share the
+ * same GpuContext, because the final buffer belongs to the GpuContext.
+ */
+typedef struct GpuPreAggSharedFinal
+{
+	dlist_node		chain;
+	EState		   *estate;			/* owner of this entry */
+	cl_int			shared_final_id; /* see GpuPreAggInfo */
+	cl_int			nleafs_init;	/* # of the leafs initialized */
+	cl_int			nleafs_done;	/* # of the leafs completed */
+	bool			disabled;		/* true, if GpuContext is not common */
+	GpuContext	   *gcontext;		/* GpuContext of the leafs */
+	/* final buffer being handed over to the next leaf */
+	pgstrom_data_store *pds_final;
+	CUdeviceptr		m_fhash;
+	CUevent			ev_init_fhash;
+	size_t			f_hash_nslots;
+	size_t			f_hash_length;
+	size_t			f_nrooms_max;
+	MemoryContextCallback callback;
+} GpuPreAggSharedFinal;
+
+static dlist_head	gpupreagg_shared_final_list;
+
+/*
+ * GpuPreAggResultCache
+ *
+ * Partial aggregation results over a GpuCache, kept per backend. Dashboard
+ * like workloads repeat the same GROUP BY queries, however, the results are
+ * identical as long as no REDO logs are added to the GpuCache. So, we save
+ * the results with the version of the GpuCache contents, and replay them
+ * without GPU kernel invocations if the version is not changed.
+ *
+ * Over arrow_fdw, the results are saved with the identifiers of the record
+ * batches. Because the partial results are merged by the final aggregation
+ * anyway, GpuPreAgg replays the results of the cached record batches, then
+ * processes only the record batches appended later.
+ */
+typedef struct GpuPreAggResultCache
+{
+	dlist_node		chain;			/* LRU list of the result cache */
+	char		   *key;
+	uint32			hash;
+	uint64			generation;		/* version of the GpuCache contents */
+	uint64			write_pos;		/* version of the GpuCache contents */
+	cl_uint			nbatches;		/* # of record batches (arrow_fdw) */
+	ArrowFdwBatchId *batches;		/* record batches of the results */
+	MemoryContext	memcxt;
+	cl_uint			nitems;
+	cl_uint			nrooms;
+	HeapTuple	   *tuples;			/* array of the partial results */
+	Size			usage;
+} GpuPreAggResultCache;
+
+static dlist_head	gpupreagg_result_cache_list;
+static Size			gpupreagg_result_cache_usage = 0;
+
 struct GpuPreAggRuntimeStat
 {
 	GpuTaskRuntimeStat	c;		/* common statistics */
@@ -170,9 +286,25 @@ struct GpuPreAggSharedState
 	dsm_handle		ss_handle;	/* DSM handle of the SharedState */
 	cl_uint			ss_length;	/* Length of the SharedState */
 	GpuPreAggRuntimeStat gpa_rtstat;	/* Run-time statistics */
+	/* final buffer on the device shared by the parallel workers */
+	pthread_mutex_t	sf_mutex;
+	cl_int			sf_state;		/* one of GPUPREAGG_SHARED_FINAL__* */
+	cl_int			sf_cuda_dindex;	/* device where the buffer is located */
+	cl_int			sf_nattached;	/* # of processes attached */
+	cl_int			sf_ndone;		/* # of processes completed */
+	CUipcMemHandle	sf_ipc_mhandle;	/* IPC handle of the preserved memory */
+	size_t			sf_kds_length;	/* length of the kds_final */
+	size_t			sf_fhash_offset; /* offset of the hash-slot, or 0 */
+	size_t			sf_nrooms_max;	/* max # of groups in the buffer */
+	size_t			sf_nitems;		/* # of groups by completed reductions */
+	size_t			sf_nrooms_running; /* # of rows under reduction */
 };
 typedef struct GpuPreAggSharedState	GpuPreAggSharedState;
 
+#define GPUPREAGG_SHARED_FINAL__DISABLED	0
+#define GPUPREAGG_SHARED_FINAL__READY		1
+#define GPUPREAGG_SHARED_FINAL__CLOSED		2	/* emission in progress */
+
 /*
  * GpuPreAggTask
  *
@@ -202,6 +334,11 @@ typedef struct
 	kern_gpujoin	   *kgjoin;		/* kern_gpujoin, if combined mode */
 	CUdeviceptr			m_kmrels;	/* kern_multirels, if combined mode */
 	cl_int				outer_depth;/* RIGHT OUTER depth, if combined mode */
+	bool				sorted_reduction; /* segmented reduction, if any */
+	bool				hll_compaction;	/* compacts HLL sketches only */
+	bool				sf_attached;	/* reduction onto the final buffer
+										 * shared by the parallel workers */
+	pgstrom_data_store *pds_final;	/* flushed final buffer, if any */
 	kern_gpupreagg		kern;
 } GpuPreAggTask;
 
@@ -212,6 +349,7 @@ static bool		gpupreagg_build_path_target(PlannerInfo *root,
 											PathTarget *target_partial,
 											Path       *input_path,
 											Node      **p_havingQual,
+											List      **p_distinct_keys,
 											bool       *p_can_pullup_outerscan,
 											AggClauseCosts *p_final_clause_costs);
 static void		gpupreagg_codegen(PlannerInfo *root,
@@ -224,6 +362,10 @@ static size_t createGpuPreAggSharedState(GpuPreAggState *gpas,
 										 void *dsm_addr);
 static void releaseGpuPreAggSharedState(GpuPreAggState *gpas);
 static void resetGpuPreAggSharedState(GpuPreAggState *gpas);
+static void gpupreagg_setup_parallel_final(GpuPreAggState *gpas,
+										   ParallelContext *pcxt);
+static void gpupreagg_release_parallel_final(dsm_segment *segment,
+											 Datum arg);
 
 static GpuTask *gpupreagg_next_task(GpuTaskState *gts);
 static GpuTask *gpupreagg_terminator_task(GpuTaskState *gts,
@@ -246,6 +388,8 @@ static TupleTableSlot *gpupreagg_next_tuple(GpuTaskState *gts);
 #define ALTFUNC_EXPR_PCOV_Y2		109	/* PCOV_Y2(X,Y) */
 #define ALTFUNC_EXPR_PCOV_XY		110	/* PCOV_XY(X,Y) */
 #define ALTFUNC_EXPR_HLL_HASH		111	/* HLL_HASH(X) */
+#define ALTFUNC_EXPR_QSKETCH		112	/* QSKETCH_NEW(X) */
+#define ALTFUNC_EXPR_NSUM			113	/* NSUM_NEW(X,SCALE) */
 
 /*
  * XXX - GpuPreAgg with Numeric arguments are problematic because
@@ -272,6 +416,18 @@ __aggfunc_property_extra_sz__hll_count(void)
 	return MAXALIGN(VARHDRSZ + (1U << pgstrom_hll_register_bits));
 }
 
+static size_t
+__aggfunc_property_extra_sz__quantile_sketch(void)
+{
+	return MAXALIGN(QSKETCH_LENGTH);
+}
+
+static size_t
+__aggfunc_property_extra_sz__numeric_sum(void)
+{
+	return MAXALIGN(NSUM_LENGTH);
+}
+
 /*
  * List of supported aggregate functions
  */
@@ -330,6 +486,17 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	  NULL, 0, false
 	},
 #ifdef GPUPREAGG_SUPPORT_NUMERIC
+	/*
+	 * AVG(X) = EX_AVG_NUMERIC_FIXED(NSUM_NEW(X,SCALE)), if X has bounded
+	 * scale; see make_altfunc_nsum_expr()
+	 */
+	{ "avg",	1, {NUMERICOID},
+	  "s:favg_numeric_fixed", BYTEAOID,
+	  "varref", 1, {BYTEAOID},
+	  {ALTFUNC_EXPR_NSUM},
+	  __aggfunc_property_extra_sz__numeric_sum,
+	  0, true
+	},
 	{ "avg",	1, {NUMERICOID},
 	  "s:favg_numeric", FLOAT8ARRAYOID,
 	  "s:pavg", 2, {INT8OID, FLOAT8OID},
@@ -353,28 +520,28 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	/* HLL_COUNT(KEY) */
 	{ "hll_count", 1, {INT1OID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
 	},
 	{ "hll_count", 1, {INT2OID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
 	},
 	{ "hll_count", 1, {INT4OID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
 	},
 	{ "hll_count", 1, {INT8OID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
@@ -382,7 +549,7 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 #ifdef GPUPREAGG_SUPPORT_NUMERIC
 	{ "hll_count", 1, {NUMERICOID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, true
@@ -390,56 +557,56 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 #endif
  	{ "hll_count", 1, {DATEOID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
 	},
  	{ "hll_count", 1, {TIMEOID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
 	},
  	{ "hll_count", 1, {TIMETZOID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
 	},
  	{ "hll_count", 1, {TIMESTAMPOID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
 	},
  	{ "hll_count", 1, {TIMESTAMPTZOID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
 	},
  	{ "hll_count", 1, {BPCHAROID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
 	},
  	{ "hll_count", 1, {TEXTOID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
 	},
 	{ "hll_count", 1, {UUIDOID},
 	  "c:hll_merge", BYTEAOID,
-	  "s:hll_sketch_new", 1, {INT8OID},
+	  "s:hll_count_new", 1, {INT8OID},
 	  {ALTFUNC_EXPR_HLL_HASH},
 	  __aggfunc_property_extra_sz__hll_count,
 	  0, false
@@ -538,6 +705,14 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
       __aggfunc_property_extra_sz__hll_count,
       0, false
     },
+	/* QUANTILE_SKETCH(X) = QUANTILE_SKETCH_COMBINE(QSKETCH_NEW(X)) */
+	{ "quantile_sketch", 1, {FLOAT8OID},
+	  "c:quantile_sketch_combine", BYTEAOID,
+	  "varref", 1, {BYTEAOID},
+	  {ALTFUNC_EXPR_QSKETCH},
+	  __aggfunc_property_extra_sz__quantile_sketch,
+	  0, false
+	},
 	/* MAX(X) = MAX(PMAX(X)) */
 	{ "max",    1, {INT2OID},
 	  "s:fmax_int2", INT4OID,
@@ -709,6 +884,14 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	  NULL, 0, false
 	},
 #ifdef GPUPREAGG_SUPPORT_NUMERIC
+	/* SUM(X) = EX_SUM_NUMERIC_FIXED(NSUM_NEW(X,SCALE)), if bounded scale */
+	{ "sum",    1, {NUMERICOID},
+	  "s:fsum_numeric_fixed", BYTEAOID,
+	  "varref", 1, {BYTEAOID},
+	  {ALTFUNC_EXPR_NSUM},
+	  __aggfunc_property_extra_sz__numeric_sum,
+	  0, true
+	},
 	{ "sum",    1, {NUMERICOID},
 	  "s:fsum_numeric", FLOAT8OID,
 	  "varref", 1, {FLOAT8OID},
@@ -1179,9 +1362,40 @@ static aggfunc_catalog_t  aggfunc_catalog[] = {
 	},
 };
 
+/*
+ * numeric_fixed_scale
+ *
+ * It returns the scale of the fixed-point accumulator if the argument of
+ * the numeric aggregation has bounded precision and scale, or -1.
+ */
+static int
+numeric_fixed_scale(Aggref *aggref)
+{
+	TargetEntry *tle;
+	int32		typmod;
+	int			precision;
+	int			scale;
+
+	if (list_length(aggref->args) != 1)
+		return -1;
+	tle = linitial(aggref->args);
+	Assert(IsA(tle, TargetEntry));
+	if (exprType((Node *)tle->expr) != NUMERICOID)
+		return -1;
+	typmod = exprTypmod((Node *)tle->expr);
+	if (typmod < (int32) VARHDRSZ)
+		return -1;
+	precision = ((typmod - VARHDRSZ) >> 16) & 0xffff;
+	scale     = ((typmod - VARHDRSZ) & 0xffff);
+	if (precision > NSUM_MAX_PRECISION || scale > precision)
+		return -1;
+	return scale;
+}
+
 static const aggfunc_catalog_t *
-aggfunc_lookup_by_oid(Oid aggfnoid)
+aggfunc_lookup_by_aggref(Aggref *aggref)
 {
+	Oid				aggfnoid = aggref->aggfnoid;
 	Form_pg_proc	proc;
 	HeapTuple		htup;
 	int				i;
@@ -1205,6 +1419,10 @@ aggfunc_lookup_by_oid(Oid aggfnoid)
 				/* Is NUMERIC with GpuPreAgg acceptable? */
 				if (catalog->numeric_aware && !enable_numeric_aggfuncs)
 					continue;
+				/* Is fixed-point accumulator available? */
+				if (catalog->partfn_argexprs[0] == ALTFUNC_EXPR_NSUM &&
+					numeric_fixed_scale(aggref) < 0)
+					continue;
 				/* all ok */
 				ReleaseSysCache(htup);
 				return catalog;
@@ -1215,6 +1433,84 @@ aggfunc_lookup_by_oid(Oid aggfnoid)
 	return NULL;
 }
 
+/*
+ * gpupreagg_input_is_clustered
+ *
+ * It checks whether rows of the input stream are delivered in the order of
+ * the grouping keys (or almost), so the rows in a same group shall be packed
+ * on the adjacent positions of kds_slot. In this case, device kernel can run
+ * segmented reduction that merges the runs of identical keys, without any
+ * hash-tables.
+ * We can make this decision if the input path is already sorted by the
+ * grouping keys, or the only grouping key is a column of the base relation
+ * physically correlated to the storage order.
+ */
+#define GPUPREAGG_CLUSTERED_CORRELATION		0.95
+
+static bool
+gpupreagg_input_is_clustered(PlannerInfo *root,
+							 Path *input_path,
+							 PathTarget *target_partial,
+							 int num_group_keys)
+{
+	RelOptInfo *baserel = input_path->parent;
+	Expr	   *group_key = NULL;
+	VariableStatData vardata;
+	double		correlation = 0.0;
+	ListCell   *lc;
+	int			j = 0;
+
+	if (!enable_sorted_gpupreagg ||
+		num_group_keys == 0 ||
+		root->parse->groupingSets != NIL)
+		return false;
+	/* GpuJoin shall not keep the order of the rows */
+	if (pgstrom_path_is_gpujoin(input_path))
+		return false;
+
+	/* input path is already sorted by the grouping keys */
+	if (root->group_pathkeys != NIL &&
+		num_group_keys <= list_length(root->group_pathkeys) &&
+		pathkeys_contained_in(root->group_pathkeys, input_path->pathkeys))
+		return true;
+
+	/* only one grouping key correlated to the physical order */
+	if (num_group_keys != 1 ||
+		(baserel->reloptkind != RELOPT_BASEREL &&
+		 baserel->reloptkind != RELOPT_OTHER_MEMBER_REL))
+		return false;
+	foreach (lc, target_partial->exprs)
+	{
+		if (get_pathtarget_sortgroupref(target_partial, j++))
+		{
+			group_key = (Expr *)lfirst(lc);
+			break;
+		}
+	}
+	if (!group_key || !IsA(group_key, Var) ||
+		((Var *)group_key)->varno != baserel->relid)
+		return false;
+
+	examine_variable(root, (Node *)group_key, 0, &vardata);
+	if (HeapTupleIsValid(vardata.statsTuple))
+	{
+		AttStatsSlot	sslot;
+
+		if (get_attstatsslot(&sslot, vardata.statsTuple,
+							 STATISTIC_KIND_CORRELATION,
+							 InvalidOid,
+							 ATTSTATSSLOT_NUMBERS))
+		{
+			if (sslot.nnumbers > 0)
+				correlation = Abs(sslot.numbers[0]);
+			free_attstatsslot(&sslot);
+		}
+	}
+	ReleaseVariableStats(vardata);
+
+	return (correlation >= GPUPREAGG_CLUSTERED_CORRELATION);
+}
+
 /*
  * cost_gpupreagg
  *
@@ -1232,12 +1528,20 @@ cost_gpupreagg(PlannerInfo *root,
 			   List *index_quals,
 			   cl_long index_nblocks)
 {
-	double		gpu_cpu_ratio = pgstrom_gpu_operator_cost / cpu_operator_cost;
+	double		gpu_setup_cost;
+	double		gpu_dma_cost;
+	double		gpu_operator_cost;
+	double		gpu_cpu_ratio;
 	Cost		startup_cost;
 	Cost		run_cost;
 	int			num_group_keys = 0;
 	int			j, ncols;
 
+	pgstrom_gpu_cost_factors(&gpu_setup_cost,
+							 &gpu_dma_cost,
+							 &gpu_operator_cost);
+	gpu_cpu_ratio = gpu_operator_cost / cpu_operator_cost;
+
 	/* Cost come from the underlying path */
 	if (gpa_info->outer_scanrelid == 0)
 	{
@@ -1259,9 +1563,9 @@ cost_gpupreagg(PlannerInfo *root,
 						cpu_tuple_cost * input_path->rows);
 		}
 		else if (pathtree_has_gpupath(input_path))
-			outer_total += pgstrom_gpu_setup_cost / 2;
+			outer_total += gpu_setup_cost / 2;
 		else
-			outer_total += pgstrom_gpu_setup_cost;
+			outer_total += gpu_setup_cost;
 
 		gpa_info->outer_startup_cost = Max(outer_startup - discount, 0.0);
 		gpa_info->outer_total_cost   = Max(outer_total - discount, 0.0);
@@ -1312,11 +1616,17 @@ cost_gpupreagg(PlannerInfo *root,
 	}
 	if (num_group_keys == 0)
 		num_groups = 1.0;	/* AGG_PLAIN */
-
-	/* Cost estimation for grouping */
-	startup_cost += (pgstrom_gpu_operator_cost *
+	gpa_info->sorted_reduction = gpupreagg_input_is_clustered(root,
+															  input_path,
+															  target_partial,
+															  num_group_keys);
+	/*
+	 * Cost estimation for grouping; segmented reduction compares the keys
+	 * with the previous row only, and needs no hash-value calculation.
+	 */
+	startup_cost += (gpu_operator_cost *
 					 num_group_keys *
-					 input_path->rows);
+					 input_path->rows) * (gpa_info->sorted_reduction ? 0.5 : 1.0);
 	/* Cost estimation for aggregate function */
 	startup_cost += (target_partial->cost.per_tuple * input_path->rows +
 					 target_partial->cost.startup) * gpu_cpu_ratio;
@@ -1409,7 +1719,9 @@ make_gpupreagg_path(PlannerInfo *root,
 	/* Number of workers if parallel */
 	if (group_rel->consider_parallel &&
 		input_path->parallel_safe)
-		parallel_nworkers = input_path->parallel_workers;
+		parallel_nworkers = pgstrom_gpu_parallel_workers(
+								input_path->parallel_workers,
+								gpa_info->optimal_gpu);
 
 	/* cost estimation */
 	if (!cost_gpupreagg(root,
@@ -1531,6 +1843,21 @@ prepend_gpupreagg_path(PlannerInfo *root,
 	return partial_path;
 }
 
+/*
+ * has_distinct_aggref_walker
+ *
+ * Agg node with DISTINCT aggregates must be sorted, not hashed.
+ */
+static bool
+has_distinct_aggref_walker(Node *node, void *context)
+{
+	if (!node)
+		return false;
+	if (IsA(node, Aggref) && ((Aggref *)node)->aggdistinct != NIL)
+		return true;
+	return expression_tree_walker(node, has_distinct_aggref_walker, context);
+}
+
 /*
  * try_add_final_aggregation_paths
  */
@@ -1553,7 +1880,9 @@ try_add_final_aggregation_paths(PlannerInfo *root,
 	can_sort = grouping_is_sortable(parse->groupClause);
 	can_hash = (parse->groupClause != NIL &&
 				parse->groupingSets == NIL &&
-				grouping_is_hashable(parse->groupClause));
+				grouping_is_hashable(parse->groupClause) &&
+				!has_distinct_aggref_walker((Node *)target_final->exprs, NULL) &&
+				!has_distinct_aggref_walker((Node *)havingQuals, NULL));
 
 	/* make a final grouping path (nogroup) */
 	if (!parse->groupClause)
@@ -1695,6 +2024,87 @@ try_add_final_aggregation_paths(PlannerInfo *root,
 	}
 }
 
+/*
+ * gpupreagg_groupkeys_cover_partkeys
+ *
+ * It checks whether the grouping keys contain all the partition keys; if so,
+ * every group belongs to one partition, and no need to merge the results of
+ * the partition leafs.
+ */
+static bool
+gpupreagg_groupkeys_cover_partkeys(RelOptInfo *parent_rel,
+								   PathTarget *target_partial)
+{
+	int			i, j;
+
+	if (!parent_rel->part_scheme || !parent_rel->partexprs)
+		return false;
+	for (i=0; i < parent_rel->part_scheme->partnatts; i++)
+	{
+		bool		found = false;
+		ListCell   *lc1, *lc2;
+
+		foreach (lc1, parent_rel->partexprs[i])
+		{
+			Expr   *part_expr = lfirst(lc1);
+
+			j = 0;
+			foreach (lc2, target_partial->exprs)
+			{
+				Expr   *expr = lfirst(lc2);
+
+				if (get_pathtarget_sortgroupref(target_partial, j++) &&
+					equal(part_expr, expr))
+				{
+					found = true;
+					break;
+				}
+			}
+			if (found)
+				break;
+		}
+		if (!found)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * gpupreagg_runtime_prunable
+ *
+ * It checks whether Append may skip some of the leafs at run-time, because
+ * of the scan qualifiers depending on Params or non-immutable functions.
+ */
+static bool
+__gpupreagg_contain_param_walker(Node *node, void *context)
+{
+	if (!node)
+		return false;
+	if (IsA(node, Param))
+		return true;
+	return expression_tree_walker(node, __gpupreagg_contain_param_walker,
+								  context);
+}
+
+static bool
+gpupreagg_runtime_prunable(Path *input_path)
+{
+	RelOptInfo *parent_rel = input_path->parent;
+	ListCell   *lc;
+
+	if (input_path->param_info)
+		return true;
+	foreach (lc, parent_rel->baserestrictinfo)
+	{
+		RestrictInfo *rinfo = lfirst(lc);
+
+		if (contain_mutable_functions((Node *)rinfo->clause) ||
+			__gpupreagg_contain_param_walker((Node *)rinfo->clause, NULL))
+			return true;
+	}
+	return false;
+}
+
 /*
  * try_add_gpupreagg_append_paths
  */
@@ -1706,6 +2116,7 @@ try_add_gpupreagg_append_paths(PlannerInfo *root,
 							   Path *input_path,
 							   List *havingQual,
 							   double num_groups,
+							   double num_partial_groups,
 							   AggClauseCosts *agg_final_costs,
 							   bool can_pullup_outerscan,
 							   bool try_outer_parallel)
@@ -1718,7 +2129,9 @@ try_add_gpupreagg_append_paths(PlannerInfo *root,
 	AppendPath *append_path;
 	Cost		discount_cost;
 	Path	   *partial_path;
+	cl_int		shared_final_id = 0;
 	ListCell   *lc;
+	static cl_int shared_final_seq = 0;
 
 retry:
 	sub_paths_list = extract_partitionwise_pathlist(root,
@@ -1735,6 +2148,25 @@ retry:
 	else
 		discount_cost = 0.0;
 
+	/*
+	 * If Append runs the leafs one by one, and groups may appear on multiple
+	 * partitions, the leaf GpuPreAggs reduce into a single final buffer,
+	 * then the last leaf emits the partial results at once. Run-time
+	 * partition pruning should not skip the leafs, because someone has to
+	 * emit the final buffer.
+	 */
+	if (enable_partitionwise_shared_final &&
+		!try_outer_parallel &&
+		list_length(sub_paths_list) > 1 &&
+		!gpupreagg_groupkeys_cover_partkeys(input_path->parent,
+											target_partial) &&
+		!gpupreagg_runtime_prunable(input_path))
+	{
+		if (++shared_final_seq <= 0)
+			shared_final_seq = 1;
+		shared_final_id = shared_final_seq;
+	}
+
 	foreach (lc, sub_paths_list)
 	{
 		Path	   *sub_path = (Path *) lfirst(lc);
@@ -1755,11 +2187,20 @@ retry:
 											  group_rel,
 											  curr_partial,
 											  sub_path,
-											  num_groups,
+											  num_partial_groups,
 											  can_pullup_outerscan,
 											  false);
 		if (!partial_path)
 			return;
+		if (shared_final_id > 0)
+		{
+			GpuPreAggInfo *gpa_info;
+
+			Assert(pgstrom_path_is_gpupreagg(partial_path) &&
+				   !partial_path->parallel_aware);
+			gpa_info = linitial(((CustomPath *)partial_path)->custom_private);
+			gpa_info->shared_final_id = shared_final_id;
+		}
 		partial_path->total_cost -= discount_cost;
 		append_paths_list = lappend(append_paths_list, partial_path);
 	}
@@ -1836,7 +2277,9 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 	PathTarget	   *target_partial	= create_empty_pathtarget();
 	Path		   *partial_path;
 	Node		   *havingQual;
+	List		   *distinct_keys = NIL;
 	double			num_groups;
+	double			num_partial_groups;
 	double			reduction_ratio;
 	bool			can_pullup_outerscan = true;
 	AggClauseCosts	final_clause_costs;
@@ -1860,13 +2303,6 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 
 		num_groups = Max(pathnode->rows, 1.0);
 	}
-	reduction_ratio = input_path->rows / num_groups;
-	if (reduction_ratio < gpupreagg_reduction_threshold)
-	{
-		elog(DEBUG2, "GpuPreAgg: %.0f -> %.0f reduction ratio (%.2f) is bad",
-			 input_path->rows, num_groups, reduction_ratio);
-		return;
-	}
 
 	/* construction of the target-list for each level */
 	if (!gpupreagg_build_path_target(root,
@@ -1875,10 +2311,44 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 									 target_partial,
 									 input_path,
 									 &havingQual,
+									 &distinct_keys,
 									 &can_pullup_outerscan,
 									 &final_clause_costs))
 		return;
 
+	/*
+	 * In case of GROUPING SETS, ROLLUP or CUBE, GpuPreAgg runs partial
+	 * aggregation by the union of all the grouping-keys at once, then
+	 * the upper GroupingSetsPath produces every subtotals from the partial
+	 * results. So, number of the partial groups is the number of distinct
+	 * combinations of all the grouping-keys, not a sum of the groups for
+	 * each grouping-set.
+	 * Arguments of DISTINCT aggregates are also grouping-keys of GpuPreAgg.
+	 */
+	num_partial_groups = num_groups;
+	if ((parse->groupingSets && parse->groupClause) || distinct_keys != NIL)
+	{
+		List   *group_exprs = get_sortgrouplist_exprs(parse->groupClause,
+													  parse->targetList);
+		group_exprs = list_concat(group_exprs, distinct_keys);
+		num_partial_groups = estimate_num_groups(root,
+												 group_exprs,
+												 input_path->rows,
+												 NULL
+#if PG_VERSION_NUM >= 140000
+												 ,NULL
+#endif
+			);
+		num_partial_groups = Max(num_partial_groups, 1.0);
+	}
+	reduction_ratio = input_path->rows / num_partial_groups;
+	if (reduction_ratio < gpupreagg_reduction_threshold)
+	{
+		elog(DEBUG2, "GpuPreAgg: %.0f -> %.0f reduction ratio (%.2f) is bad",
+			 input_path->rows, num_partial_groups, reduction_ratio);
+		return;
+	}
+
 	if (enable_partitionwise_gpupreagg)
 		try_add_gpupreagg_append_paths(root,
 									   group_rel,
@@ -1887,6 +2357,7 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 									   input_path,
 									   (List *) havingQual,
 									   num_groups,
+									   num_partial_groups,
 									   &final_clause_costs,
 									   can_pullup_outerscan,
 									   try_parallel_path);
@@ -1895,7 +2366,7 @@ try_add_gpupreagg_paths(PlannerInfo *root,
 										  group_rel,
 										  target_partial,
 										  input_path,
-										  num_groups,
+										  num_partial_groups,
 										  can_pullup_outerscan,
 										  try_parallel_path);
 	if (!partial_path ||
@@ -2040,11 +2511,22 @@ is_altfunc_expression(Node *node, int *p_extra_sz)
 		{
 			retval = true;
 		}
-		else if (strcmp(NameStr(form_proc->proname), "hll_sketch_new") == 0)
+		else if (strcmp(NameStr(form_proc->proname), "hll_sketch_new") == 0 ||
+				 strcmp(NameStr(form_proc->proname), "hll_count_new") == 0)
 		{
 			extra_sz = __aggfunc_property_extra_sz__hll_count();
 			retval = true;
 		}
+		else if (strcmp(NameStr(form_proc->proname), "qsketch_new") == 0)
+		{
+			extra_sz = __aggfunc_property_extra_sz__quantile_sketch();
+			retval = true;
+		}
+		else if (strcmp(NameStr(form_proc->proname), "nsum_new") == 0)
+		{
+			extra_sz = __aggfunc_property_extra_sz__numeric_sum();
+			retval = true;
+		}
 	}
 	ReleaseSysCache(tuple);
 
@@ -2395,6 +2877,65 @@ make_altfunc_hll_hash(Aggref *aggref)
 	return func;
 }
 
+/*
+ * make_altfunc_qsketch_expr - constructor of a quantile sketch
+ */
+static FuncExpr *
+make_altfunc_qsketch_expr(Aggref *aggref)
+{
+	TargetEntry	   *tle;
+	Expr		   *expr;
+
+	Assert(list_length(aggref->args) == 1);
+	tle = linitial(aggref->args);
+	Assert(IsA(tle, TargetEntry));
+
+	/* cast to float8, if mismatch */
+	expr = make_expr_typecast(tle->expr, FLOAT8OID);
+	/* NULL is not counted, if aggref has any filter */
+	expr = make_expr_conditional(expr, aggref->aggfilter, false);
+
+	return make_altfunc_simple_expr("qsketch_new", expr);
+}
+
+/*
+ * make_altfunc_nsum_expr - constructor of a fixed-point numeric accumulator
+ */
+static FuncExpr *
+make_altfunc_nsum_expr(Aggref *aggref)
+{
+	TargetEntry	   *tle;
+	Expr		   *expr;
+	Oid				argtypes[2] = {NUMERICOID, INT4OID};
+	Oid				func_oid;
+	int				scale = numeric_fixed_scale(aggref);
+
+	/* should be checked at aggfunc_lookup_by_aggref() */
+	Assert(scale >= 0);
+	tle = linitial(aggref->args);
+	Assert(IsA(tle, TargetEntry));
+	/* NULL is not accumulated, if aggref has any filter */
+	expr = make_expr_conditional(tle->expr, aggref->aggfilter, false);
+
+	func_oid = get_function_oid("nsum_new",
+								buildoidvector(argtypes, 2),
+								get_namespace_oid("pgstrom", false),
+								false);
+	return makeFuncExpr(func_oid,
+						BYTEAOID,
+						list_make2(expr,
+								   makeConst(INT4OID,
+											 -1,
+											 InvalidOid,
+											 sizeof(int32),
+											 Int32GetDatum(scale),
+											 false,
+											 true)),
+						InvalidOid,
+						InvalidOid,
+						COERCE_EXPLICIT_CALL);
+}
+
 /*
  * __update_aggfunc_clause_cost
  */
@@ -2424,7 +2965,7 @@ __update_aggfunc_clause_cost(PlannerInfo *root,
 	if (OidIsValid(agg_form->aggfinalfn))
 		add_function_cost(root, agg_form->aggfinalfn, NULL,
 						  &final_costs->finalCost);
-	if (aggfn_cat->partfn_extra_sz)
+	if (aggfn_cat && aggfn_cat->partfn_extra_sz)
 		final_costs->transitionSpace += aggfn_cat->partfn_extra_sz();
 #endif
 }
@@ -2472,7 +3013,7 @@ make_alternative_aggref(PlannerInfo *root,
 	/*
 	 * Lookup properties of aggregate function
 	 */
-	aggfn_cat = aggfunc_lookup_by_oid(aggref->aggfnoid);
+	aggfn_cat = aggfunc_lookup_by_aggref(aggref);
 	if (!aggfn_cat)
 	{
 		elog(DEBUG2, "Aggregate function is not device executable: %s",
@@ -2529,6 +3070,12 @@ make_alternative_aggref(PlannerInfo *root,
 			case ALTFUNC_EXPR_HLL_HASH:	/* HLL_HASH(X) */
 				pfunc = make_altfunc_hll_hash(aggref);
 				break;
+			case ALTFUNC_EXPR_QSKETCH:	/* QSKETCH_NEW(X) */
+				pfunc = make_altfunc_qsketch_expr(aggref);
+				break;
+			case ALTFUNC_EXPR_NSUM:		/* NSUM_NEW(X,SCALE) */
+				pfunc = make_altfunc_nsum_expr(aggref);
+				break;
 			default:
 				elog(ERROR, "unknown alternative function code: %d", action);
 				break;
@@ -2661,52 +3208,155 @@ typedef struct
 	RelOptInfo *input_rel;
 	Bitmapset  *__pfunc_bitmap__;
 	List	   *groupby_keys;
+	List	   *distinct_keys;
+	Index		sortgroupref_max;
 	AggClauseCosts final_clause_costs;
 } gpupreagg_build_path_target_context;
 
-static Node *
-replace_expression_by_altfunc(Node *node,
-							  gpupreagg_build_path_target_context *con)
+/*
+ * gpupreagg_check_groupkey_type
+ *
+ * Type of the grouping-key must have device hash and equality function
+ */
+static bool
+gpupreagg_check_groupkey_type(Expr *expr)
 {
-	PathTarget *target_input = con->target_input;
-	ListCell   *lc;
+	devtype_info   *dtype;
+	Oid				coll_oid;
 
-	if (!node)
-		return NULL;
-	if (IsA(node, Aggref))
+	dtype = pgstrom_devtype_lookup(exprType((Node *)expr));
+	if (!dtype || !dtype->hash_func)
 	{
-		Node   *aggfn = make_alternative_aggref(con->root,
-												(Aggref *)node,
-												con->target_partial,
-												con->target_input,
-												con->input_rel,
-												&con->final_clause_costs);
-		if (!aggfn)
-			con->device_executable = false;
-		return aggfn;
+		elog(DEBUG2, "GROUP BY contains unsupported type (%s): %s",
+			 format_type_be(exprType((Node *)expr)),
+			 nodeToString((Node *)expr));
+		return false;
 	}
-
-	foreach (lc, target_input->exprs)
+	coll_oid = exprCollation((Node *)expr);
+	if (!pgstrom_devfunc_lookup_type_equal(dtype, coll_oid))
 	{
-		Expr   *expr_in = lfirst(lc);
-
-		if (equal(node, expr_in))
-		{
-			add_new_column_to_pathtarget(con->target_partial,
-										 copyObject(expr_in));
-			return copyObject(node);
-		}
+		elog(DEBUG2, "GROUP BY contains unsupported type (%s): %s",
+			 format_type_be(exprType((Node *)expr)),
+			 nodeToString((Node *)expr));
+		return false;
 	}
-	if (IsA(node, Var) || IsA(node, PlaceHolderVar))
-		elog(ERROR, "Bug? referenced variable is neither grouping-key nor its dependent key: %s",
-			 nodeToString(node));
-	return expression_tree_mutator(node, replace_expression_by_altfunc, con);
+	return true;
 }
 
 /*
- * gpupreagg_build_path_target
- *
- *
+ * gpupreagg_add_distinct_keys
+ *
+ * DISTINCT aggregate is not replaced by the alternative functions. Instead,
+ * GpuPreAgg adds its arguments to the grouping-keys, to deduplicate the
+ * pair of (grouping-keys, distinct arguments) on the device. Then, the upper
+ * Agg node runs the original DISTINCT aggregate on the deduplicated rows.
+ * Any other aggregates are still correct, because their partial results are
+ * merged again by the upper Agg node.
+ */
+static Node *
+gpupreagg_add_distinct_keys(Aggref *aggref,
+							gpupreagg_build_path_target_context *con)
+{
+	PathTarget *target_partial = con->target_partial;
+	Aggref	   *aggref_new;
+	ListCell   *lc;
+	int			i;
+
+	if (aggref->aggorder != NIL ||
+		aggref->aggfilter != NULL ||
+		aggref->aggkind != AGGKIND_NORMAL)
+	{
+		elog(DEBUG2, "DISTINCT aggregate with ORDER BY/FILTER is not supported: %s",
+			 nodeToString(aggref));
+		return NULL;
+	}
+
+	foreach (lc, aggref->args)
+	{
+		TargetEntry *tle = lfirst(lc);
+		Expr	   *expr = tle->expr;
+
+		Assert(IsA(tle, TargetEntry));
+		if (tle->resjunk)
+			continue;
+		if (!gpupreagg_check_groupkey_type(expr))
+			return NULL;
+		if (!pgstrom_device_expression(con->root, con->input_rel, expr))
+		{
+			elog(DEBUG2, "DISTINCT argument is not device executable: %s",
+				 nodeToString(expr));
+			return NULL;
+		}
+		/* skip, if it is already a grouping-key */
+		for (i=0; i < list_length(target_partial->exprs); i++)
+		{
+			if (get_pathtarget_sortgroupref(target_partial, i) != 0 &&
+				equal(expr, list_nth(target_partial->exprs, i)))
+				break;
+		}
+		if (i < list_length(target_partial->exprs))
+			continue;
+		add_column_to_pathtarget(target_partial, copyObject(expr),
+								 ++con->sortgroupref_max);
+		con->distinct_keys = lappend(con->distinct_keys, expr);
+	}
+	aggref_new = copyObject(aggref);
+	aggref_new->aggsplit = AGGSPLIT_SIMPLE;
+
+	return (Node *)aggref_new;
+}
+
+static Node *
+replace_expression_by_altfunc(Node *node,
+							  gpupreagg_build_path_target_context *con)
+{
+	PathTarget *target_input = con->target_input;
+	ListCell   *lc;
+
+	if (!node)
+		return NULL;
+	if (IsA(node, Aggref) && ((Aggref *)node)->aggdistinct != NIL)
+	{
+		Node   *aggfn = gpupreagg_add_distinct_keys((Aggref *)node, con);
+
+		if (!aggfn)
+			con->device_executable = false;
+		return aggfn;
+	}
+	if (IsA(node, Aggref))
+	{
+		Node   *aggfn = make_alternative_aggref(con->root,
+												(Aggref *)node,
+												con->target_partial,
+												con->target_input,
+												con->input_rel,
+												&con->final_clause_costs);
+		if (!aggfn)
+			con->device_executable = false;
+		return aggfn;
+	}
+
+	foreach (lc, target_input->exprs)
+	{
+		Expr   *expr_in = lfirst(lc);
+
+		if (equal(node, expr_in))
+		{
+			add_new_column_to_pathtarget(con->target_partial,
+										 copyObject(expr_in));
+			return copyObject(node);
+		}
+	}
+	if (IsA(node, Var) || IsA(node, PlaceHolderVar))
+		elog(ERROR, "Bug? referenced variable is neither grouping-key nor its dependent key: %s",
+			 nodeToString(node));
+	return expression_tree_mutator(node, replace_expression_by_altfunc, con);
+}
+
+/*
+ * gpupreagg_build_path_target
+ *
+ *
  *
  */
 static bool
@@ -2716,6 +3366,7 @@ gpupreagg_build_path_target(PlannerInfo *root,			/* in */
 							PathTarget *target_partial,	/* out */
 							Path       *input_path,     /* in */
 							Node **p_havingQual,		/* out */
+							List **p_distinct_keys,		/* out */
 							bool *p_can_pullup_outerscan, /* out */
 							AggClauseCosts *p_final_clause_costs) /* out */
 {
@@ -2735,6 +3386,15 @@ gpupreagg_build_path_target(PlannerInfo *root,			/* in */
 	con.target_input	= target_input;
 	con.input_rel       = input_rel;
 	con.groupby_keys    = NIL;
+	con.distinct_keys   = NIL;
+	/* sortgroupref of the distinct keys must not conflict */
+	foreach (lc, parse->targetList)
+	{
+		TargetEntry *tle = lfirst(lc);
+
+		con.sortgroupref_max = Max(con.sortgroupref_max,
+								   tle->ressortgroupref);
+	}
 
 	/*
 	 * NOTE: Not to inject unnecessary projection on the sub-path node,
@@ -2751,28 +3411,11 @@ gpupreagg_build_path_target(PlannerInfo *root,			/* in */
 			get_sortgroupref_clause_noerr(sortgroupref,
 										  parse->groupClause) != NULL)
 		{
-			devtype_info   *dtype;
-			Oid				coll_oid;
-
 			/*
 			 * Type of the grouping-key must have device equality-function
 			 */
-			dtype = pgstrom_devtype_lookup(exprType((Node *)expr));
-			if (!dtype || !dtype->hash_func)
-			{
-				elog(DEBUG2, "GROUP BY contains unsupported type (%s): %s",
-					 format_type_be(exprType((Node *)expr)),
-					 nodeToString((Node *)expr));
-				return false;
-			}
-			coll_oid = exprCollation((Node *)expr);
-			if (!pgstrom_devfunc_lookup_type_equal(dtype, coll_oid))
-			{
-				elog(DEBUG2, "GROUP BY contains unsupported type (%s): %s",
-					 format_type_be(exprType((Node *)expr)),
-					 nodeToString((Node *)expr));
+			if (!gpupreagg_check_groupkey_type(expr))
 				return false;
-			}
 
 			/*
 			 * If expression cannot execute on device, unable to pull up
@@ -2818,6 +3461,7 @@ gpupreagg_build_path_target(PlannerInfo *root,			/* in */
 		}
 	}
 	*p_havingQual = havingQual;
+	*p_distinct_keys = con.distinct_keys;
 	memcpy(p_final_clause_costs, &con.final_clause_costs,
 		   sizeof(AggClauseCosts));
 
@@ -3371,7 +4015,8 @@ codegen_projection_partial_funcion(FuncExpr *f, codegen_context *context)
 		Assert(exprType((Node *)filter) == BOOLOID);
 		expr = make_expr_conditional(expr, filter, true);
 	}
-	else if (strcmp(proc_name, "hll_sketch_new") == 0)
+	else if (strcmp(proc_name, "hll_sketch_new") == 0 ||
+			 strcmp(proc_name, "hll_count_new") == 0)
 	{
 		FuncExpr   *hfunc;
 		char	   *hfunc_name;
@@ -3384,8 +4029,8 @@ codegen_projection_partial_funcion(FuncExpr *f, codegen_context *context)
 		hfunc_namespace = get_func_namespace(hfunc->funcid);
 		if (strcmp(hfunc_name, "hll_hash") != 0 ||
 			hfunc_namespace != get_namespace_oid("pgstrom", false))
-			elog(ERROR, "Bug? hll_sketch_new() is invoked with %s",
-				 format_procedure(hfunc->funcid));
+			elog(ERROR, "Bug? %s() is invoked with %s",
+				 proc_name, format_procedure(hfunc->funcid));
 		pfree(hfunc_name);
 
 		dfunc = pgstrom_devfunc_lookup(hfunc->funcid,
@@ -3399,6 +4044,28 @@ codegen_projection_partial_funcion(FuncExpr *f, codegen_context *context)
 
 		expr = (Expr *)hfunc;
 	}
+	else if (strcmp(proc_name, "qsketch_new") == 0)
+	{
+		Assert(list_length(f->args) == 1);
+		expr = linitial(f->args);
+		dtype = pgstrom_devtype_lookup_and_track(exprType((Node *)expr),
+												 context);
+		if (!dtype || dtype->type_oid != FLOAT8OID)
+			elog(ERROR, "Bug? qsketch_new() is invoked with %s",
+				 format_type_be(exprType((Node *)expr)));
+	}
+	else if (strcmp(proc_name, "nsum_new") == 0)
+	{
+		/* scale is a constant for aggcalc_init_nsum() */
+		Assert(list_length(f->args) == 2 &&
+			   IsA(lsecond(f->args), Const));
+		expr = linitial(f->args);
+		dtype = pgstrom_devtype_lookup_and_track(exprType((Node *)expr),
+												 context);
+		if (!dtype || dtype->type_oid != NUMERICOID)
+			elog(ERROR, "Bug? nsum_new() is invoked with %s",
+				 format_type_be(exprType((Node *)expr)));
+	}
 	else
 	{
 		elog(ERROR, "Bug? unexpected partial aggregate function: %s",
@@ -3674,6 +4341,8 @@ gpupreagg_codegen_projection(StringInfo kern,
 	 * Execute expression and store the value on dst_values/dst_isnull
 	 */
 setup_expressions:
+	/* common sub-expressions in the grouping keys and aggregate arguments */
+	pgstrom_codegen_cse_setup(context, tlist_part);
 	resetStringInfo(&temp);
 	foreach (lc, tlist_part)
 	{
@@ -3754,6 +4423,7 @@ setup_expressions:
 
 	/* const/params and temporary variable */
 	pgstrom_union_type_declarations(&decl, "temp", type_oid_list);
+	pgstrom_codegen_cse_declarations(&decl, context);
 
 	/* writeout kernel functions */
 	appendStringInfo(
@@ -4080,7 +4750,8 @@ gpupreagg_codegen_common_calc(TargetEntry *tle,
 			 strcmp(func_name, "pcov_y2") == 0 ||
 			 strcmp(func_name, "pcov_xy") == 0)
 		aggcalc_ops = "add";
-	else if (strcmp(func_name, "hll_sketch_new") == 0)
+	else if (strcmp(func_name, "hll_sketch_new") == 0 ||
+			 strcmp(func_name, "hll_count_new") == 0)
 	{
 		pfree(func_name);
 		/* HLL registers are always bytea */
@@ -4089,6 +4760,24 @@ gpupreagg_codegen_common_calc(TargetEntry *tle,
 				 aggcalc_mode);
 		return sbuffer;
 	}
+	else if (strcmp(func_name, "qsketch_new") == 0)
+	{
+		pfree(func_name);
+		/* quantile sketch is also bytea */
+		snprintf(sbuffer, sizeof(sbuffer),
+				 "aggcalc_%s_qsketch",
+				 aggcalc_mode);
+		return sbuffer;
+	}
+	else if (strcmp(func_name, "nsum_new") == 0)
+	{
+		pfree(func_name);
+		/* fixed-point numeric accumulator is also bytea */
+		snprintf(sbuffer, sizeof(sbuffer),
+				 "aggcalc_%s_nsum",
+				 aggcalc_mode);
+		return sbuffer;
+	}
 	else
 		elog(ERROR, "Bug? unexpected partial function expression: %s",
 			 nodeToString(f));
@@ -4190,22 +4879,38 @@ gpupreagg_codegen_init_slot(StringInfo kern,
 		}
 		else
 		{
+			char		extra_args[64] = "";
+			FuncExpr   *f = (FuncExpr *)tle->expr;
+
+			/* fixed-point numeric accumulator takes its scale */
+			if (f->funcresulttype == BYTEAOID &&
+				list_length(f->args) == 2 &&
+				IsA(lsecond(f->args), Const))
+			{
+				Const  *con = lsecond(f->args);
+
+				Assert(con->consttype == INT4OID && !con->constisnull);
+				snprintf(extra_args, sizeof(extra_args),
+						 ", %d", DatumGetInt32(con->constvalue));
+			}
 			label = gpupreagg_codegen_common_calc(tle, context, "init");
 			appendStringInfo(
 				&fbuf,
-				"  %s(&dst_dclass[%d], &dst_values[%d], dst_extras);\n"
+				"  %s(&dst_dclass[%d], &dst_values[%d], dst_extras%s);\n"
 				"  dst_extras += %u;\n",
 				label,
 				count1 + count2,
 				count1 + count2,
+				extra_args,
 				extra_sz);
 			appendStringInfo(
 				&lbuf,
-				"  %s(&dst_dclass[%d], &dst_values[%d], dst_extras);\n"
+				"  %s(&dst_dclass[%d], &dst_values[%d], dst_extras%s);\n"
 				"  dst_extras += %u;\n",
 				label,
 				count1,
 				count1,
+				extra_args,
 				extra_sz);
 			extra_total += extra_sz;
 			count1++;
@@ -4537,25 +5242,40 @@ gpupreagg_post_planner(PlannedStmt *pstmt, CustomScan *cscan)
 }
 
 /*
- * assign_gpupreagg_session_info
+ * gpupreagg_local_hash_nrooms
+ *
+ * NOTE: groupby reduction tries to use 45kB of shared memory per SM
+ * for the local hash area. Number of the local hash items depends on
+ * the memory consumption for each row. It can be zero, if unit size
+ * of the shared memory consumption is too large.
  */
-void
-assign_gpupreagg_session_info(StringInfo buf, GpuTaskState *gts)
+static cl_int
+gpupreagg_local_hash_nrooms(int num_accum_values, int accum_extra_bufsz)
 {
-	GpuPreAggState *gpas = (GpuPreAggState *) gts;
-
-	Assert(pgstrom_plan_is_gpupreagg(gpas->gts.css.ss.ps.plan));
+	return ((45 * 1024 - sizeof(preagg_local_hashtable))
+			/ (sizeof(preagg_hash_item) +
+			   sizeof(cl_char) * num_accum_values +
+			   sizeof(Datum)   * num_accum_values +
+			   accum_extra_bufsz));
+}
 
+static void
+__assign_gpupreagg_session_info(StringInfo buf,
+								int num_accum_values,
+								int accum_extra_bufsz,
+								int local_hash_nrooms,
+								bool combined_gpujoin)
+{
 	/*
 	 * struct __preagg_accum_item is a local buffer to save a cumulative sum
 	 * for accumulation values.
 	 */
 	appendStringInfo(buf, "#define __GPUPREAGG_NUM_ACCUM_VALUES %u\n",
-					 gpas->num_accum_values);
+					 num_accum_values);
 	appendStringInfo(buf, "#define __GPUPREAGG_ACCUM_EXTRA_BUFSZ %u\n",
-					 gpas->accum_extra_bufsz);
+					 accum_extra_bufsz);
 	appendStringInfo(buf, "#define __GPUPREAGG_LOCAL_HASH_NROOMS %u\n",
-					 gpas->local_hash_nrooms);
+					 local_hash_nrooms);
 	appendStringInfo(buf, "#define __GPUPREAGG_HLL_REGISTER_BITS %u\n",
 					 pgstrom_hll_register_bits);
 
@@ -4564,10 +5284,61 @@ assign_gpupreagg_session_info(StringInfo buf, GpuTaskState *gts)
 	 * of gpupreagg_projection_slot() in cuda_gpujoin.h, and switch to
 	 * use the auto-generated one for initial projection of GpuPreAgg.
 	 */
-	if (gpas->combined_gpujoin)
+	if (combined_gpujoin)
 		appendStringInfo(buf, "#define GPUPREAGG_COMBINED_JOIN 1\n");
 }
 
+/*
+ * assign_gpupreagg_session_info
+ */
+void
+assign_gpupreagg_session_info(StringInfo buf, GpuTaskState *gts)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gts;
+
+	Assert(pgstrom_plan_is_gpupreagg(gpas->gts.css.ss.ps.plan));
+	__assign_gpupreagg_session_info(buf,
+									gpas->num_accum_values,
+									gpas->accum_extra_bufsz,
+									gpas->local_hash_nrooms,
+									gpas->combined_gpujoin);
+}
+
+/*
+ * pgstrom_prebuild_gpupreagg_program
+ *
+ * It kicks build of the GPU program on the final GpuPreAgg plan; that is
+ * equivalent to the one ExecInitGpuPreAgg() will create. The combined
+ * GpuJoin is determined at the executor initialization, so GpuPreAgg on
+ * the outer GpuJoin is not a target of prebuild.
+ */
+void
+pgstrom_prebuild_gpupreagg_program(CustomScan *cscan)
+{
+	GpuPreAggInfo  *gpa_info = deform_gpupreagg_info(cscan);
+	StringInfoData	kern_define;
+	cl_int			local_hash_nrooms;
+
+	if (outerPlan(cscan) && pgstrom_plan_is_gpujoin(outerPlan(cscan)))
+		return;
+	local_hash_nrooms
+		= gpupreagg_local_hash_nrooms(gpa_info->num_accum_values,
+									  gpa_info->accum_extra_bufsz);
+	initStringInfo(&kern_define);
+	pgstrom_build_common_session_info(&kern_define, gpa_info->extra_flags);
+	__assign_gpupreagg_session_info(&kern_define,
+									gpa_info->num_accum_values,
+									gpa_info->accum_extra_bufsz,
+									local_hash_nrooms,
+									false);
+	pgstrom_prebuild_cuda_program(gpa_info->optimal_gpu,
+								  gpa_info->extra_flags,
+								  gpa_info->extra_bufsz,
+								  gpa_info->kern_source,
+								  kern_define.data);
+	pfree(kern_define.data);
+}
+
 /*
  * build_cpu_fallback_tlist
  */
@@ -4621,6 +5392,84 @@ build_cpu_fallback_tlist(List *tlist_part, CustomScan *cscan)
 	return tlist_part;
 }
 
+/*
+ * gpupreagg_setup_arrow_stats_agg
+ *
+ * If GpuPreAgg has no grouping keys, and all the partial aggregations are
+ * NROWS(), NROWS(X IS NOT NULL), PMIN(X) or PMAX(X) on the columns of
+ * arrow_fdw, the record-batches whose rows all satisfy the scan quals can
+ * be aggregated by the min/max statistics without loading. The result is
+ * emitted as an extra partial tuple at the end of the scan.
+ */
+static void
+gpupreagg_setup_arrow_stats_agg(GpuPreAggState *gpas,
+								List *tlist_fallback,
+								List *outer_quals)
+{
+	Index		scanrelid = ((Scan *)gpas->gts.css.ss.ps.plan)->scanrelid;
+	Oid			namespace_oid = get_namespace_oid("pgstrom", false);
+	List	   *agg_kinds = NIL;
+	List	   *agg_attnums = NIL;
+	ListCell   *lc;
+
+	foreach (lc, tlist_fallback)
+	{
+		TargetEntry *tle = lfirst(lc);
+		FuncExpr   *f = (FuncExpr *) tle->expr;
+		const char *func_name;
+		Var		   *var = NULL;
+		int			kind;
+
+		if (!IsA(f, FuncExpr) ||
+			get_func_namespace(f->funcid) != namespace_oid)
+			return;
+		func_name = get_func_name(f->funcid);
+		if (strcmp(func_name, "nrows") == 0)
+		{
+			kind = ARROW_STATS_AGG__NROWS;
+			if (list_length(f->args) == 1)
+			{
+				NullTest   *ntest = linitial(f->args);
+
+				if (!IsA(ntest, NullTest) ||
+					ntest->nulltesttype != IS_NOT_NULL ||
+					ntest->argisrow)
+					return;
+				var = (Var *) ntest->arg;
+			}
+			else if (f->args != NIL)
+				return;
+		}
+		else if (strcmp(func_name, "pmin") == 0 ||
+				 strcmp(func_name, "pmax") == 0)
+		{
+			kind = (strcmp(func_name, "pmin") == 0
+					? ARROW_STATS_AGG__MIN
+					: ARROW_STATS_AGG__MAX);
+			if (list_length(f->args) != 1)
+				return;
+			var = linitial(f->args);
+			/* no type cast is allowed */
+			if (IsA(var, Var) && var->vartype != f->funcresulttype)
+				return;
+		}
+		else
+			return;
+
+		if (var && (!IsA(var, Var) ||
+					var->varno != scanrelid ||
+					var->varattno <= 0))
+			return;
+		agg_kinds = lappend_int(agg_kinds, kind);
+		agg_attnums = lappend_int(agg_attnums, var ? var->varattno : 0);
+	}
+	gpas->stats_agg = ExecInitArrowStatsAgg(gpas->gts.af_state,
+											&gpas->gts.css.ss,
+											outer_quals,
+											agg_kinds,
+											agg_attnums);
+}
+
 /*
  * CreateGpuPreAggScanState - constructor of GpuPreAggState
  */
@@ -4644,6 +5493,134 @@ CreateGpuPreAggScanState(CustomScan *cscan)
 	return (Node *) gpas;
 }
 
+/*
+ * gpupreagg_setup_hll_compaction
+ *
+ * It picks up the columns of hll_count() partial results, because GPU can
+ * compact the HLL sketches of them with the estimated cardinality. It is
+ * not applied to hll_sketch(), because its result is exposed to users.
+ */
+static void
+gpupreagg_setup_hll_compaction(GpuPreAggState *gpas, List *tlist_part)
+{
+	ListCell   *lc;
+
+	foreach (lc, tlist_part)
+	{
+		TargetEntry *tle = lfirst(lc);
+		FuncExpr   *f = (FuncExpr *) tle->expr;
+		char	   *func_name;
+
+		if (tle->resjunk || !IsA(f, FuncExpr))
+			continue;
+		func_name = get_func_name(f->funcid);
+		if (func_name && strcmp(func_name, "hll_count_new") == 0)
+		{
+			if (!gpas->hll_compact_attnums)
+				gpas->hll_compact_attnums =
+					palloc0(sizeof(cl_int) * list_length(tlist_part));
+			gpas->hll_compact_attnums[gpas->hll_compact_natts++]
+				= tle->resno - 1;
+		}
+		if (func_name)
+			pfree(func_name);
+	}
+}
+
+/*
+ * gpupreagg_attach_shared_final
+ *
+ * It looks up (or creates) the final buffer shared by the leafs under the
+ * same Append, then registers the GpuPreAgg as a leaf.
+ */
+static void
+gpupreagg_cleanup_shared_final(void *arg)
+{
+	GpuPreAggSharedFinal *sfinal = arg;
+
+	dlist_delete(&sfinal->chain);
+}
+
+static GpuPreAggSharedFinal *
+gpupreagg_attach_shared_final(GpuPreAggState *gpas,
+							  EState *estate, cl_int shared_final_id)
+{
+	GpuPreAggSharedFinal *sfinal;
+	dlist_iter	iter;
+
+	dlist_foreach(iter, &gpupreagg_shared_final_list)
+	{
+		sfinal = dlist_container(GpuPreAggSharedFinal, chain, iter.cur);
+		if (sfinal->estate == estate &&
+			sfinal->shared_final_id == shared_final_id)
+		{
+			if (sfinal->gcontext != gpas->gts.gcontext)
+				sfinal->disabled = true;
+			sfinal->nleafs_init++;
+			return sfinal;
+		}
+	}
+	sfinal = MemoryContextAllocZero(estate->es_query_cxt,
+									sizeof(GpuPreAggSharedFinal));
+	sfinal->estate = estate;
+	sfinal->shared_final_id = shared_final_id;
+	sfinal->nleafs_init = 1;
+	sfinal->gcontext = gpas->gts.gcontext;
+	sfinal->callback.func = gpupreagg_cleanup_shared_final;
+	sfinal->callback.arg = sfinal;
+	MemoryContextRegisterResetCallback(estate->es_query_cxt,
+									   &sfinal->callback);
+	dlist_push_head(&gpupreagg_shared_final_list, &sfinal->chain);
+
+	return sfinal;
+}
+
+/*
+ * gpupreagg_result_cache_key
+ *
+ * It makes an identifier of the GpuPreAgg for the result cache. Equivalent
+ * GPU code with equivalent Const values on the same table shall produce
+ * the same results, as long as GpuCache contents are not changed.
+ */
+static char *
+gpupreagg_result_cache_key(GpuPreAggState *gpas,
+						   GpuPreAggInfo *gpa_info,
+						   const char *kern_define)
+{
+	Relation	scan_rel = gpas->gts.css.ss.ss_currentRelation;
+	kern_parambuf *kparams = gpas->gts.kern_params;
+	StringInfoData buf;
+	ListCell   *lc;
+	cl_uint		i;
+
+	if (gpupreagg_result_cache_size <= 0 || !scan_rel)
+		return NULL;
+	/*
+	 * PARAM_EXEC shall be different for each execution, but PARAM_EXTERN
+	 * is identified by the values in the kern_parambuf below.
+	 */
+	foreach (lc, gpa_info->used_params)
+	{
+		Param  *param = lfirst(lc);
+
+		if (!IsA(param, Const) &&
+			!(IsA(param, Param) && param->paramkind == PARAM_EXTERN))
+			return NULL;
+	}
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "%u:%u:%u\n%s\n",
+					 MyDatabaseId,
+					 RelationGetRelid(scan_rel),
+					 gpa_info->extra_flags,
+					 nodeToString(gpa_info->used_params));
+	for (i=0; kparams && i < kparams->length; i++)
+		appendStringInfo(&buf, "%02x", ((cl_uchar *)kparams)[i]);
+	appendStringInfo(&buf, "\n%s\n%s",
+					 kern_define,
+					 gpa_info->kern_source);
+	return buf.data;
+}
+
 /*
  * ExecInitGpuPreAgg
  */
@@ -4686,18 +5663,15 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 	gpas->num_group_keys		= gpa_info->num_group_keys;
 	gpas->num_accum_values		= gpa_info->num_accum_values;
 	gpas->accum_extra_bufsz		= gpa_info->accum_extra_bufsz;
-	/*
-	 * NOTE: groupby reduction tries to use 45kB of shared memory per SM
-	 * for the local hash area. Number of the local hash items depends on
-	 * the memory consumption for each row. It can be zero, if unit size
-	 * of the shared memory consumption is too large.
-	 */
+	gpas->sorted_reduction		= gpa_info->sorted_reduction;
+	if (gpa_info->shared_final_id > 0 && !explain_only)
+		gpas->shared_final = gpupreagg_attach_shared_final(gpas, estate,
+												gpa_info->shared_final_id);
 	gpas->local_hash_nrooms
-		= ((45 * 1024 - sizeof(preagg_local_hashtable))
-		   / (sizeof(preagg_hash_item) +
-			  sizeof(cl_char) * gpas->num_accum_values +
-			  sizeof(Datum)   * gpas->num_accum_values +
-			  gpas->accum_extra_bufsz));
+		= gpupreagg_local_hash_nrooms(gpas->num_accum_values,
+									  gpas->accum_extra_bufsz);
+	gpas->local_bypass_hint = false;
+	pthreadCondInit(&gpas->f_cond, 0);
 
 	/* initialization of the outer relation */
 	if (outerPlan(cscan))
@@ -4708,8 +5682,15 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 		Assert(!scan_rel);
 		Assert(!gpa_info->outer_quals );
 		outer_ps = ExecInitNode(outer_plan, estate, eflags);
+		/*
+		 * Combined GpuJoin runs only a single pass of the outer scan, so
+		 * it is not applicable if the inner hash table at depth=1 is split
+		 * into multiple partitions; GpuJoin has to re-scan the outer
+		 * relation for each partition by itself.
+		 */
 		if (enable_pullup_outer_join &&
 			pgstrom_planstate_is_gpujoin(outer_ps) &&
+			pgstrom_planstate_gpujoin_inner_nparts(outer_ps) <= 1 &&
 			!outer_ps->ps_ProjInfo)
 		{
 			gpas->combined_gpujoin = true;
@@ -4736,6 +5717,8 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 	part_tupdesc = ExecCleanTypeFromTL(gpa_info->tlist_part);
 	gpas->part_slot = MakeSingleTupleTableSlot(part_tupdesc,
 											   &TTSOpsVirtual);
+	if (enable_hll_device_estimation)
+		gpupreagg_setup_hll_compaction(gpas, gpa_info->tlist_part);
 	prep_tupdesc = ExecCleanTypeFromTL(gpa_info->tlist_prep);
 	gpas->prep_slot = MakeSingleTupleTableSlot(prep_tupdesc,
 											   &TTSOpsVirtual);
@@ -4752,6 +5735,9 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 						  part_tupdesc,
 						  &TTSOpsVirtual);
 	ExecAssignScanProjectionInfoWithVarno(&gpas->gts.css.ss, INDEX_VAR);
+	if (gpas->gts.af_state && gpas->num_group_keys == 0)
+		gpupreagg_setup_arrow_stats_agg(gpas, tlist_fallback,
+										gpa_info->outer_quals);
 
 	/* Template of kds_slot */
 	length = KDS_calculateHeadSize(prep_tupdesc);
@@ -4794,37 +5780,303 @@ ExecInitGpuPreAgg(CustomScanState *node, EState *estate, int eflags)
 												 kern_define.data,
 												 false,
 												 explain_only);
+		if ((gpas->gts.gc_state || gpas->gts.af_state) && !gpas->shared_final)
+			gpas->rcache_key = gpupreagg_result_cache_key(gpas, gpa_info,
+														  kern_define.data);
 		pfree(kern_define.data);
 	}
 	gpas->gts.program_id = program_id;
 }
 
 /*
- * ExecReCheckGpuPreAgg
+ * gpupreagg_release_result_cache
  */
-static bool
-ExecReCheckGpuPreAgg(CustomScanState *node, TupleTableSlot *slot)
+static void
+gpupreagg_release_result_cache(GpuPreAggResultCache *rcache)
 {
-	/*
-	 * GpuPreAgg shall be never located under the LockRows, so we don't
-	 * expect that we need to have valid EPQ recheck here.
-	 */
-	return true;
+	MemoryContextDelete(rcache->memcxt);
 }
 
 /*
- * ExecGpuPreAgg
+ * gpupreagg_setup_result_cache
+ *
+ * It looks up the result cache; if valid entry exists, GpuPreAgg replays
+ * the results. Elsewhere, it starts to build a new entry. If the entry
+ * over arrow_fdw covers a part of the record batches, it replays the
+ * results, then builds a new entry with the results of the other ones.
  */
-static TupleTableSlot *
-ExecGpuPreAgg(CustomScanState *node)
+static void
+gpupreagg_setup_result_cache(GpuPreAggState *gpas)
 {
-	GpuPreAggState *gpas = (GpuPreAggState *) node;
-
-	ActivateGpuContext(gpas->gts.gcontext);
-	if (!gpas->gpa_sstate)
-		createGpuPreAggSharedState(gpas, NULL, NULL);
-	return ExecScan(&node->ss,
-					(ExecScanAccessMtd) pgstromExecGpuTaskState,
+	GpuPreAggResultCache *rcache;
+	GpuPreAggResultCache *rcache_prev = NULL;
+	MemoryContext	memcxt;
+	uint64			generation = 0;
+	uint64			write_pos = 0;
+	ArrowFdwBatchId *batches = NULL;
+	uint32			nbatches = 0;
+	uint32			hash;
+	cl_uint			i;
+	dlist_mutable_iter iter;
+
+	gpas->rcache_checked = true;
+	if (!gpas->rcache_key ||
+		gpas->gts.pcxt != NULL ||
+		IsParallelWorker() ||
+		gpupreagg_result_cache_size <= 0)
+		return;
+	if (gpas->gts.gc_state)
+	{
+		if (!gpuCacheContentsVersion(gpas->gts.gc_state,
+									 &generation,
+									 &write_pos))
+			return;
+	}
+	else if (gpas->gts.af_state)
+	{
+		batches = ExecArrowFdwBatchIds(gpas->gts.af_state, &nbatches);
+		if (!batches)
+			return;
+	}
+	else
+		return;
+
+	hash = hash_any((unsigned char *)gpas->rcache_key,
+					strlen(gpas->rcache_key));
+	if (!gpupreagg_result_cache_list.head.next)
+		dlist_init(&gpupreagg_result_cache_list);
+	dlist_foreach_modify(iter, &gpupreagg_result_cache_list)
+	{
+		rcache = dlist_container(GpuPreAggResultCache, chain, iter.cur);
+		if (rcache->hash != hash ||
+			strcmp(rcache->key, gpas->rcache_key) != 0)
+			continue;
+		if (gpas->gts.gc_state
+			? (rcache->generation == generation &&
+			   rcache->write_pos == write_pos)
+			: (rcache->nbatches == nbatches &&
+			   ExecArrowFdwExcludeBatches(gpas->gts.af_state,
+										  rcache->batches,
+										  rcache->nbatches)))
+		{
+			/* move to the head of LRU, then replay */
+			dlist_delete(&rcache->chain);
+			dlist_push_head(&gpupreagg_result_cache_list, &rcache->chain);
+			gpas->rcache_replay = rcache;
+			gpas->rcache_index = 0;
+			if (batches)
+				pfree(batches);
+			return;
+		}
+		dlist_delete(&rcache->chain);
+		gpupreagg_result_cache_usage -= rcache->usage;
+		/* record batches are appended, if cached ones are still valid */
+		if (gpas->gts.af_state &&
+			ExecArrowFdwExcludeBatches(gpas->gts.af_state,
+									   rcache->batches,
+									   rcache->nbatches))
+			rcache_prev = rcache;
+		else
+			gpupreagg_release_result_cache(rcache);
+		break;
+	}
+	/* start to build a new entry */
+	memcxt = AllocSetContextCreate(TopMemoryContext,
+								   "GpuPreAgg Result Cache",
+								   ALLOCSET_DEFAULT_SIZES);
+	rcache = MemoryContextAllocZero(memcxt, sizeof(GpuPreAggResultCache));
+	rcache->key = MemoryContextStrdup(memcxt, gpas->rcache_key);
+	rcache->hash = hash;
+	rcache->generation = generation;
+	rcache->write_pos = write_pos;
+	rcache->memcxt = memcxt;
+	rcache->nrooms = 100;
+	if (rcache_prev)
+		rcache->nrooms = Max(rcache->nrooms, 2 * rcache_prev->nitems);
+	rcache->tuples = MemoryContextAlloc(memcxt, sizeof(HeapTuple) *
+										rcache->nrooms);
+	rcache->usage = (strlen(rcache->key) + sizeof(GpuPreAggResultCache));
+	if (batches)
+	{
+		rcache->nbatches = nbatches;
+		rcache->batches = MemoryContextAlloc(memcxt, sizeof(ArrowFdwBatchId) *
+											 Max(nbatches, 1));
+		memcpy(rcache->batches, batches, sizeof(ArrowFdwBatchId) * nbatches);
+		rcache->usage += sizeof(ArrowFdwBatchId) * nbatches;
+		pfree(batches);
+	}
+	if (rcache_prev)
+	{
+		MemoryContext	oldcxt = MemoryContextSwitchTo(memcxt);
+
+		/* carry over the results of the cached record batches */
+		for (i=0; i < rcache_prev->nitems; i++)
+		{
+			HeapTuple	tuple = rcache_prev->tuples[i];
+
+			rcache->tuples[i] = heap_copytuple(tuple);
+			rcache->usage += HEAPTUPLESIZE + tuple->t_len + sizeof(HeapTuple);
+		}
+		MemoryContextSwitchTo(oldcxt);
+		rcache->nitems = rcache_prev->nitems;
+		gpas->rcache_nreplay = rcache_prev->nitems;
+		gpas->rcache_nbatches = rcache_prev->nbatches;
+		gpupreagg_release_result_cache(rcache_prev);
+	}
+	gpas->rcache_build = rcache;
+}
+
+/*
+ * gpupreagg_append_result_cache
+ */
+static void
+gpupreagg_append_result_cache(GpuPreAggState *gpas, TupleTableSlot *slot)
+{
+	GpuPreAggResultCache *rcache = gpas->rcache_build;
+	MemoryContext	oldcxt;
+	HeapTuple		tuple;
+
+	if (rcache->nitems >= rcache->nrooms)
+	{
+		rcache->nrooms = 2 * rcache->nrooms;
+		rcache->tuples = repalloc(rcache->tuples, sizeof(HeapTuple) *
+								  rcache->nrooms);
+	}
+	oldcxt = MemoryContextSwitchTo(rcache->memcxt);
+	tuple = ExecCopySlotHeapTuple(slot);
+	MemoryContextSwitchTo(oldcxt);
+	rcache->tuples[rcache->nitems++] = tuple;
+	rcache->usage += HEAPTUPLESIZE + tuple->t_len + sizeof(HeapTuple);
+
+	/* too large results to be cached */
+	if (rcache->usage > (Size)gpupreagg_result_cache_size * 1024L)
+	{
+		gpupreagg_release_result_cache(rcache);
+		gpas->rcache_build = NULL;
+	}
+}
+
+/*
+ * gpupreagg_commit_result_cache
+ */
+static void
+gpupreagg_commit_result_cache(GpuPreAggState *gpas)
+{
+	GpuPreAggResultCache *rcache = gpas->rcache_build;
+	Size		limit = (Size)gpupreagg_result_cache_size * 1024L;
+
+	/* evict the least recently used entries */
+	while (!dlist_is_empty(&gpupreagg_result_cache_list) &&
+		   gpupreagg_result_cache_usage + rcache->usage > limit)
+	{
+		GpuPreAggResultCache *victim
+			= dlist_container(GpuPreAggResultCache, chain,
+							  dlist_pop_head_node(&gpupreagg_result_cache_list));
+		gpupreagg_result_cache_usage -= victim->usage;
+		gpupreagg_release_result_cache(victim);
+	}
+	dlist_push_head(&gpupreagg_result_cache_list, &rcache->chain);
+	gpupreagg_result_cache_usage += rcache->usage;
+	gpas->rcache_build = NULL;
+}
+
+/*
+ * ExecScanGpuPreAggChunk
+ *
+ * It returns the partial aggregation by GPU, then the one by the min/max
+ * statistics of arrow_fdw, if any.
+ */
+static TupleTableSlot *
+ExecScanGpuPreAggChunk(GpuPreAggState *gpas)
+{
+	TupleTableSlot *slot = pgstromExecGpuTaskState(&gpas->gts);
+
+	if (TupIsNull(slot) && gpas->stats_agg && !gpas->stats_agg_done)
+	{
+		gpas->stats_agg_done = true;
+		slot = gpas->part_slot;
+		ExecClearTuple(slot);
+		if (ExecFetchArrowStatsAgg(gpas->gts.af_state,
+								   slot->tts_values,
+								   slot->tts_isnull))
+			ExecStoreVirtualTuple(slot);
+	}
+	return slot;
+}
+
+/*
+ * ExecScanGpuPreAggResultCache
+ */
+static TupleTableSlot *
+ExecScanGpuPreAggResultCache(GpuPreAggState *gpas)
+{
+	TupleTableSlot *slot;
+
+	if (gpas->rcache_replay)
+	{
+		GpuPreAggResultCache *rcache = gpas->rcache_replay;
+
+		slot = gpas->part_slot;
+		if (gpas->rcache_index >= rcache->nitems)
+			return ExecClearTuple(slot);
+		ExecForceStoreHeapTuple(rcache->tuples[gpas->rcache_index++],
+								slot, false);
+		return slot;
+	}
+	if (gpas->rcache_index < gpas->rcache_nreplay)
+	{
+		/* results of the cached record batches, prior to the new ones */
+		Assert(gpas->rcache_build != NULL);
+		slot = gpas->part_slot;
+		ExecForceStoreHeapTuple(gpas->rcache_build->tuples[gpas->rcache_index++],
+								slot, false);
+		return slot;
+	}
+	slot = ExecScanGpuPreAggChunk(gpas);
+	if (gpas->rcache_build)
+	{
+		if (!TupIsNull(slot))
+			gpupreagg_append_result_cache(gpas, slot);
+		else
+			gpupreagg_commit_result_cache(gpas);
+	}
+	return slot;
+}
+
+/*
+ * ExecReCheckGpuPreAgg
+ */
+static bool
+ExecReCheckGpuPreAgg(CustomScanState *node, TupleTableSlot *slot)
+{
+	/*
+	 * GpuPreAgg shall be never located under the LockRows, so we don't
+	 * expect that we need to have valid EPQ recheck here.
+	 */
+	return true;
+}
+
+/*
+ * ExecGpuPreAgg
+ */
+static TupleTableSlot *
+ExecGpuPreAgg(CustomScanState *node)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) node;
+
+	ActivateGpuContext(gpas->gts.gcontext);
+	if (!gpas->gpa_sstate)
+		createGpuPreAggSharedState(gpas, NULL, NULL);
+	if (gpas->rcache_key)
+	{
+		if (!gpas->rcache_checked)
+			gpupreagg_setup_result_cache(gpas);
+		return ExecScan(&node->ss,
+						(ExecScanAccessMtd) ExecScanGpuPreAggResultCache,
+						(ExecScanRecheckMtd) ExecReCheckGpuPreAgg);
+	}
+	return ExecScan(&node->ss,
+					(ExecScanAccessMtd) ExecScanGpuPreAggChunk,
 					(ExecScanRecheckMtd) ExecReCheckGpuPreAgg);
 }
 
@@ -4861,6 +6113,27 @@ ExecEndGpuPreAgg(CustomScanState *node)
 		PDS_release(gpas->pds_final);
 	if (gpas->m_fhash)
 		gpuMemFree(gcontext, gpas->m_fhash);
+	/* final buffer shared by the parallel workers, if any */
+	if (gpas->m_sf_kds)
+	{
+		rc = gpuIpcCloseMemHandle(gcontext, gpas->m_sf_kds);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuIpcCloseMemHandle: %s",
+				 errorText(rc));
+	}
+	/* shared final buffer not adopted by any leafs, if any */
+	if (gpas->shared_final)
+	{
+		GpuPreAggSharedFinal *sfinal = gpas->shared_final;
+
+		if (sfinal->pds_final)
+			PDS_release(sfinal->pds_final);
+		if (sfinal->m_fhash)
+			gpuMemFree(sfinal->gcontext, sfinal->m_fhash);
+		sfinal->pds_final = NULL;
+		sfinal->m_fhash = 0UL;
+		sfinal->ev_init_fhash = NULL;
+	}
 
 	/* release any other resources */
 	if (gpas->part_slot)
@@ -4869,6 +6142,9 @@ ExecEndGpuPreAgg(CustomScanState *node)
 		ExecDropSingleTupleTableSlot(gpas->prep_slot);
 	if (gpas->outer_slot)
 		ExecDropSingleTupleTableSlot(gpas->outer_slot);
+	/* incomplete result cache, if any */
+	if (gpas->rcache_build)
+		gpupreagg_release_result_cache(gpas->rcache_build);
 	releaseGpuPreAggSharedState(gpas);
 	pgstromReleaseGpuTaskState(&gpas->gts, gt_rtstat);
 }
@@ -4892,6 +6168,21 @@ ExecReScanGpuPreAgg(CustomScanState *node)
 	pgstromRescanGpuTaskState(&gpas->gts);
 	/* reset other stuff */
 	gpas->terminator_done = false;
+	if (gpas->shared_final_done)
+	{
+		Assert(gpas->shared_final->nleafs_done > 0);
+		gpas->shared_final->nleafs_done--;
+		gpas->shared_final_done = false;
+	}
+	if (gpas->rcache_build)
+		gpupreagg_release_result_cache(gpas->rcache_build);
+	gpas->rcache_checked = false;
+	gpas->rcache_replay = NULL;
+	gpas->rcache_build = NULL;
+	gpas->rcache_index = 0;
+	gpas->rcache_nreplay = 0;
+	gpas->rcache_nbatches = 0;
+	gpas->stats_agg_done = false;
 }
 
 /*
@@ -4918,11 +6209,16 @@ ExecGpuPreAggInitDSM(CustomScanState *node,
 
 	/* save ParallelContext */
 	gpas->gts.pcxt = pcxt;
+	/* called after the synchronization below */
+	on_dsm_detach(pcxt->seg,
+				  gpupreagg_release_parallel_final,
+				  PointerGetDatum(coordinate));
 	on_dsm_detach(pcxt->seg,
 				  SynchronizeGpuContextOnDSMDetach,
 				  PointerGetDatum(gpas->gts.gcontext));
 	/* allocation of shared state */
 	len = createGpuPreAggSharedState(gpas, pcxt, coordinate);
+	gpupreagg_setup_parallel_final(gpas, pcxt);
 	coordinate = (char *)coordinate + len;
 	if (gpas->gts.outer_index_state)
 	{
@@ -4970,6 +6266,14 @@ static void
 ExecGpuPreAggReInitializeDSM(CustomScanState *node,
 							 ParallelContext *pcxt, void *coordinate)
 {
+	GpuPreAggState *gpas = (GpuPreAggState *) node;
+
+	/*
+	 * The final buffer shared by the parallel workers is already emitted,
+	 * so rescan shall use the final buffer of each process.
+	 */
+	if (gpas->gpa_sstate)
+		gpas->gpa_sstate->sf_state = GPUPREAGG_SHARED_FINAL__DISABLED;
 	pgstromReInitializeDSMGpuTaskState((GpuTaskState *) node);
 }
 
@@ -5003,6 +6307,20 @@ ExecShutdownGpuPreAgg(CustomScanState *node)
 			   gpa_rtstat_old,
 			   sizeof(GpuPreAggRuntimeStat));
 		gpas->gpa_rtstat = gpa_rtstat_new;
+		/* DSM shall be detached soon, with the shared final buffer */
+		if (gpas->gpa_sstate)
+			gpas->sf_nattached = gpas->gpa_sstate->sf_nattached;
+		if (gpas->m_sf_kds)
+		{
+			CUresult	rc;
+
+			rc = gpuIpcCloseMemHandle(gpas->gts.gcontext, gpas->m_sf_kds);
+			if (rc != CUDA_SUCCESS)
+				elog(WARNING, "failed on gpuIpcCloseMemHandle: %s",
+					 errorText(rc));
+			gpas->m_sf_kds = 0UL;
+			gpas->m_sf_fhash = 0UL;
+		}
 	}
 	pgstromShutdownDSMGpuTaskState(&gpas->gts);
 }
@@ -5073,7 +6391,9 @@ ExplainGpuPreAgg(CustomScanState *node, List *ancestors, ExplainState *es)
 	else
 	{
 		Assert(group_keys != 0);
-		if (gpas->local_hash_nrooms == 0)
+		if (gpas->sorted_reduction && !gpas->combined_gpujoin)
+			ExplainPropertyText("Reduction", "GroupBy (Sorted)", es);
+		else if (gpas->local_hash_nrooms == 0)
 			ExplainPropertyText("Reduction", "GroupBy (Global Only)", es);
 		else
 		{
@@ -5099,7 +6419,31 @@ ExplainGpuPreAgg(CustomScanState *node, List *ancestors, ExplainState *es)
 		ExplainPropertyText("Combined GpuJoin", "enabled", es);
 	else if (es->format != EXPLAIN_FORMAT_TEXT)
 		ExplainPropertyText("Combined GpuJoin", "disabled", es);
+	/* final buffer shared with the sibling leafs? */
+	if (gpa_info->shared_final_id > 0)
+		ExplainPropertyText("Final buffer", "shared", es);
+	else if (gpas->sf_owner && es->analyze)
+	{
+		snprintf(buf, sizeof(buf),
+				 "shared by parallel workers (GPU%d, %d processes)",
+				 gpas->gts.gcontext->cuda_dindex,
+				 gpas->sf_nattached);
+		ExplainPropertyText("Final buffer", buf, es);
+	}
 	/* other common fields */
+	if (gpas->rcache_key && es->analyze)
+	{
+		if (gpas->rcache_replay)
+			ExplainPropertyText("Result Cache", "hit", es);
+		else if (gpas->rcache_nreplay > 0)
+		{
+			snprintf(buf, sizeof(buf), "partial hit (%u record batches)",
+					 gpas->rcache_nbatches);
+			ExplainPropertyText("Result Cache", buf, es);
+		}
+		else
+			ExplainPropertyText("Result Cache", "miss", es);
+	}
 	pgstromExplainGpuTaskState(&gpas->gts, es, dcontext);
 	/* other run-time statistics, if any */
 	if (gpa_rtstat)
@@ -5136,6 +6480,9 @@ createGpuPreAggSharedState(GpuPreAggState *gpas,
 
 	gpa_rtstat = &gpa_sstate->gpa_rtstat;
 	SpinLockInit(&gpa_rtstat->c.lock);
+	pthreadMutexInit(&gpa_sstate->sf_mutex, 1);
+	gpa_sstate->sf_state = GPUPREAGG_SHARED_FINAL__DISABLED;
+	gpa_sstate->sf_cuda_dindex = -1;
 
 	gpas->gpa_sstate = gpa_sstate;
 	gpas->gpa_rtstat = gpa_rtstat;
@@ -5161,6 +6508,191 @@ resetGpuPreAggSharedState(GpuPreAggState *gpas)
 	/* nothing to do */
 }
 
+/*
+ * gpupreagg_setup_parallel_final
+ *
+ * Parallel workers usually return the partial results from their own final
+ * buffer, then the upper Agg merges the groups which appear on multiple
+ * workers again. If workers run on the same GPU device, they can reduce
+ * onto a final buffer on the device memory shared by CUDA IPC, and only
+ * the process that completes last downloads it.
+ * The buffer is mapped at different addresses for each process, so it is
+ * available only if all the columns are pass-by-value; no pointers are
+ * written on the final buffer.
+ */
+static void
+gpupreagg_setup_parallel_final(GpuPreAggState *gpas, ParallelContext *pcxt)
+{
+	GpuContext	   *gcontext = gpas->gts.gcontext;
+	GpuPreAggSharedState *gpa_sstate = gpas->gpa_sstate;
+	TupleDesc		part_tupdesc = gpas->part_slot->tts_tupleDescriptor;
+	kern_data_store *kds_head;
+	kern_global_hashslot f_hash_head;
+	CUdeviceptr		m_sf_kds;
+	size_t			nrooms;
+	size_t			unitsz;
+	size_t			kds_length;
+	size_t			f_hash_nslots = 0;
+	size_t			f_hash_offset = 0;
+	size_t			f_hash_length = 0;
+	size_t			sf_length;
+	cl_int			dindex = gcontext->cuda_dindex;
+	cl_int			j;
+	CUresult		rc;
+
+	if (!enable_parallel_shared_final ||
+		pcxt->nworkers == 0 ||
+		gpas->shared_final ||
+		gpas->rcache_key ||
+		gpas->hll_compact_natts > 0 ||
+		gpas->accum_extra_bufsz > 0)
+		return;
+	for (j=0; j < part_tupdesc->natts; j++)
+	{
+		if (!TupleDescAttr(part_tupdesc, j)->attbyval)
+			return;
+	}
+
+	/*
+	 * Unlike the managed memory, the final buffer and hash-slot on the
+	 * preserved device memory consume physical memory at the allocation,
+	 * so we size them by the planned number of groups with some margin.
+	 * Once the buffer gets full, processes go back to their own buffer.
+	 */
+	unitsz = MAXALIGN((sizeof(Datum) + sizeof(char)) * part_tupdesc->natts);
+	if (gpas->num_group_keys == 0)
+		nrooms = 1;
+	else
+	{
+		nrooms = Max(2 * gpas->plan_ngroups, 65536);
+		f_hash_nslots = Max(gpas->plan_ngroups, 16384);
+	}
+	kds_length = STROMALIGN(KDS_calculateHeadSize(part_tupdesc) +
+							unitsz * nrooms);
+	if (f_hash_nslots > 0)
+	{
+		f_hash_offset = GPUMEMALIGN(kds_length);
+		f_hash_length = (STROMALIGN(offsetof(kern_global_hashslot,
+											 slots[f_hash_nslots])) +
+						 32 * nrooms);
+	}
+	sf_length = (f_hash_length > 0 ? f_hash_offset + f_hash_length : kds_length);
+	if (sf_length > devAttrs[dindex].DEV_TOTAL_MEMSZ / 4)
+		return;
+
+	rc = gpuMemAllocPreserved(dindex,
+							  &gpa_sstate->sf_ipc_mhandle,
+							  sf_length);
+	if (rc == CUDA_ERROR_OUT_OF_MEMORY)
+		return;
+	else if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocPreserved: %s", errorText(rc));
+	gpa_sstate->sf_cuda_dindex = dindex;
+	gpas->sf_owner = true;
+
+	ActivateGpuContextNoWorkers(gcontext);
+	rc = gpuIpcOpenMemHandle(gcontext,
+							 &m_sf_kds,
+							 gpa_sstate->sf_ipc_mhandle,
+							 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+	gpas->m_sf_kds = m_sf_kds;
+
+	/* init the kds_final and the final hash-slot */
+	kds_head = palloc(KDS_calculateHeadSize(part_tupdesc));
+	init_kernel_data_store(kds_head, part_tupdesc, kds_length,
+						   KDS_FORMAT_SLOT, nrooms);
+	GPUCONTEXT_PUSH(gcontext);
+	rc = cuMemcpyHtoD(m_sf_kds, kds_head,
+					  KERN_DATA_STORE_HEAD_LENGTH(kds_head));
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+	if (f_hash_length > 0)
+	{
+		gpas->m_sf_fhash = m_sf_kds + f_hash_offset;
+
+		memset(&f_hash_head, 0, sizeof(kern_global_hashslot));
+		f_hash_head.length = f_hash_length;
+		f_hash_head.nslots = f_hash_nslots;
+		rc = cuMemcpyHtoD(gpas->m_sf_fhash, &f_hash_head,
+						  offsetof(kern_global_hashslot, slots));
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuMemcpyHtoD: %s", errorText(rc));
+		/* see HASHITEM_EMPTY */
+		rc = cuMemsetD32(gpas->m_sf_fhash + offsetof(kern_global_hashslot,
+													 slots),
+						 0xffffffffU, f_hash_nslots);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuMemsetD32: %s", errorText(rc));
+	}
+	GPUCONTEXT_POP(gcontext);
+	pfree(kds_head);
+
+	gpa_sstate->sf_kds_length = kds_length;
+	gpa_sstate->sf_fhash_offset = f_hash_offset;
+	gpa_sstate->sf_nrooms_max = (f_hash_length > 0
+								 ? Min(nrooms, f_hash_length / 32)
+								 : nrooms);
+	gpa_sstate->sf_state = GPUPREAGG_SHARED_FINAL__READY;
+}
+
+/*
+ * gpupreagg_release_parallel_final
+ *
+ * It releases the final buffer shared by the parallel workers on detach of
+ * the DSM segment, after the synchronization of the GpuContext.
+ */
+static void
+gpupreagg_release_parallel_final(dsm_segment *segment, Datum arg)
+{
+	GpuPreAggSharedState *gpa_sstate = (GpuPreAggSharedState *)
+		DatumGetPointer(arg);
+	CUresult	rc;
+
+	if (gpa_sstate->sf_cuda_dindex >= 0)
+	{
+		rc = gpuMemFreePreserved(gpa_sstate->sf_cuda_dindex,
+								 gpa_sstate->sf_ipc_mhandle);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuMemFreePreserved: %s",
+				 errorText(rc));
+		gpa_sstate->sf_cuda_dindex = -1;
+	}
+}
+
+/*
+ * gpupreagg_attach_parallel_final
+ *
+ * It maps the final buffer allocated by the leader process, if the worker
+ * runs on the same GPU device.
+ */
+static void
+gpupreagg_attach_parallel_final(GpuPreAggState *gpas)
+{
+	GpuContext	   *gcontext = gpas->gts.gcontext;
+	GpuPreAggSharedState *gpa_sstate = gpas->gpa_sstate;
+	CUresult		rc;
+
+	if (gpas->m_sf_kds != 0UL ||
+		gpas->sf_no_space ||
+		gpa_sstate->sf_state != GPUPREAGG_SHARED_FINAL__READY)
+		return;
+	if (gpa_sstate->sf_cuda_dindex != gcontext->cuda_dindex)
+	{
+		gpas->sf_no_space = true;
+		return;
+	}
+	rc = gpuIpcOpenMemHandle(gcontext,
+							 &gpas->m_sf_kds,
+							 gpa_sstate->sf_ipc_mhandle,
+							 CU_IPC_MEM_LAZY_ENABLE_PEER_ACCESS);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuIpcOpenMemHandle: %s", errorText(rc));
+	if (gpa_sstate->sf_fhash_offset > 0)
+		gpas->m_sf_fhash = gpas->m_sf_kds + gpa_sstate->sf_fhash_offset;
+}
+
 /*
  * gpupreagg_alloc_final_buffer
  */
@@ -5180,6 +6712,27 @@ gpupreagg_alloc_final_buffer(GpuPreAggState *gpas)
 	if (gpas->pds_final)
 		return;
 
+	/* adopt the final buffer handed over by the previous leaf, if any */
+	if (gpas->shared_final && gpas->shared_final->pds_final)
+	{
+		GpuPreAggSharedFinal *sfinal = gpas->shared_final;
+
+		Assert(sfinal->gcontext == gcontext &&
+			   sfinal->pds_final->kds.ncols == part_tupdesc->natts);
+		gpas->pds_final		= sfinal->pds_final;
+		gpas->m_fhash		= sfinal->m_fhash;
+		gpas->ev_init_fhash	= sfinal->ev_init_fhash;
+		gpas->f_hash_nslots	= sfinal->f_hash_nslots;
+		gpas->f_hash_length	= sfinal->f_hash_length;
+		gpas->f_nrooms_max	= sfinal->f_nrooms_max;
+		gpas->f_nrooms_running = 0;
+		gpas->f_nr_running	= 0;
+		sfinal->pds_final	= NULL;
+		sfinal->m_fhash		= 0UL;
+		sfinal->ev_init_fhash = NULL;
+		return;
+	}
+
 	/* final buffer allocation */
 	if (gpas->num_group_keys == 0)
 		f_length = 0x00ffe000UL;		/* almost 16MB managed */
@@ -5224,6 +6777,18 @@ gpupreagg_alloc_final_buffer(GpuPreAggState *gpas)
 	gpas->ev_init_fhash	= NULL;
 	gpas->f_hash_nslots	= f_hash_nslots;
 	gpas->f_hash_length = f_hash_length;
+	/*
+	 * Max number of groups the final buffer can hold; the final hash-slot
+	 * consumes about 32 bytes per group when GPU kernel expands it.
+	 */
+	gpas->f_nrooms_max	= pds_final->kds.nrooms;
+	if (gpas->accum_extra_bufsz > 0)
+		gpas->f_nrooms_max = Min(gpas->f_nrooms_max,
+								 pds_final->kds.length / gpas->accum_extra_bufsz);
+	if (f_hash_length > 0)
+		gpas->f_nrooms_max = Min(gpas->f_nrooms_max, f_hash_length / 32);
+	gpas->f_nrooms_running = 0;
+	gpas->f_nr_running = 0;
 }
 
 /*
@@ -5253,6 +6818,8 @@ gpupreagg_create_task(GpuPreAggState *gpas,
 	/* allocation of the final-buffer on demand */
 	if (!gpas->pds_final)
 		gpupreagg_alloc_final_buffer(gpas);
+	/* also maps the final buffer shared by the parallel workers, if any */
+	gpupreagg_attach_parallel_final(gpas);
 
 	/* rough estimation of the result buffer */
 	if (pds_src)
@@ -5285,6 +6852,21 @@ gpupreagg_create_task(GpuPreAggState *gpas,
 		{
 			with_nvme_strom = true;
 		}
+		/*
+		 * Combined GpuJoin writes the join results to kds_slot, then
+		 * suspends the kernel and goes back to the host for the reduction
+		 * once it gets full. So, kds_slot is sized according to the number
+		 * of join results per source row, not the source rows, to avoid
+		 * the suspend/resume round-trips as possible as we can.
+		 */
+		if (gpas->combined_gpujoin)
+		{
+			GpuTaskState   *outer_gts = (GpuTaskState *) outerPlanState(gpas);
+			double			ratio = GpuJoinEstimateResultRatio(outer_gts);
+
+			ratio = Min(Max(1.2 * ratio, 0.05), 32.0);
+			__nrooms = Min((double)__nrooms * ratio, (double)INT_MAX);
+		}
 		/* Extra buffer for suspend resume */
 		sm_count = devAttrs[gcontext->cuda_dindex].MULTIPROCESSOR_COUNT;
 		suspend_sz = STROMALIGN(sizeof(gpuscanSuspendContext) *
@@ -5294,6 +6876,8 @@ gpupreagg_create_task(GpuPreAggState *gpas,
 		kds_slot_length = (KERN_DATA_STORE_HEAD_LENGTH(kds_slot) +
 						   unitsz * __nrooms);
 		kds_slot_length = Max(kds_slot_length, 16<<20);
+		if (gpas->combined_gpujoin)
+			kds_slot_length = Min(kds_slot_length, (size_t)1 << 30);
 	}
 	else
 	{
@@ -5328,6 +6912,9 @@ gpupreagg_create_task(GpuPreAggState *gpas,
 	gpreagg->kds_slot = NULL;
 	gpreagg->kds_slot_nrooms = kds_slot_nrooms;
 	gpreagg->kds_slot_length = kds_slot_length;
+	/* GpuJoin does not keep the order of the outer rows */
+	gpreagg->sorted_reduction = (gpas->sorted_reduction &&
+								 !gpas->combined_gpujoin);
 	if (gpas->combined_gpujoin)
 	{
 		GpuTaskState   *outer_gts = (GpuTaskState *) outerPlanState(gpas);
@@ -5428,6 +7015,56 @@ gpupreagg_next_task(GpuTaskState *gts)
 	return gtask;
 }
 
+/*
+ * gpupreagg_download_parallel_final
+ *
+ * The process that completes last downloads the final buffer shared by the
+ * parallel workers, as a partial result to be returned.
+ */
+static GpuTask *
+gpupreagg_download_parallel_final(GpuPreAggState *gpas)
+{
+	GpuContext	   *gcontext = gpas->gts.gcontext;
+	GpuPreAggSharedState *gpa_sstate = gpas->gpa_sstate;
+	TupleDesc		part_tupdesc = gpas->part_slot->tts_tupleDescriptor;
+	GpuPreAggTask  *gpreagg;
+	pgstrom_data_store *pds;
+	size_t			head_sz;
+	size_t			length;
+	cl_uint			nitems;
+	CUresult		rc;
+
+	pds = PDS_create_slot(gcontext, part_tupdesc,
+						  STROMALIGN(offsetof(pgstrom_data_store, kds) +
+									 gpa_sstate->sf_kds_length));
+	head_sz = KERN_DATA_STORE_HEAD_LENGTH(&pds->kds);
+
+	GPUCONTEXT_PUSH(gcontext);
+	rc = cuMemcpyDtoH(&nitems,
+					  gpas->m_sf_kds + offsetof(kern_data_store, nitems),
+					  sizeof(cl_uint));
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on cuMemcpyDtoH: %s", errorText(rc));
+	length = KERN_DATA_STORE_SLOT_LENGTH(&pds->kds, nitems);
+	if (length > pds->kds.length)
+		elog(ERROR, "GpuPreAgg: shared final buffer is corrupted");
+	if (length > head_sz)
+	{
+		rc = cuMemcpyDtoH((char *)&pds->kds + head_sz,
+						  gpas->m_sf_kds + head_sz,
+						  length - head_sz);
+		if (rc != CUDA_SUCCESS)
+			elog(ERROR, "failed on cuMemcpyDtoH: %s", errorText(rc));
+	}
+	GPUCONTEXT_POP(gcontext);
+	pds->kds.nitems = nitems;
+
+	gpreagg = (GpuPreAggTask *) gpupreagg_create_task(gpas, NULL, 0UL, -1);
+	gpreagg->pds_final = pds;
+
+	return &gpreagg->task;
+}
+
 /*
  * gpupreagg_terminator_task
  */
@@ -5435,6 +7072,7 @@ static GpuTask *
 gpupreagg_terminator_task(GpuTaskState *gts, cl_bool *task_is_ready)
 {
 	GpuPreAggState *gpas = (GpuPreAggState *) gts;
+	GpuTask		   *gtask;
 
 	if (gpas->terminator_done)
 		return NULL;
@@ -5454,10 +7092,65 @@ gpupreagg_terminator_task(GpuTaskState *gts, cl_bool *task_is_ready)
 			GpuJoinInnerPreload(outer_gts, &m_kmrels))
 			return gpupreagg_create_task(gpas, NULL, m_kmrels, outer_depth);
 	}
+	/*
+	 * Hand over the final buffer to the next leaf, unless this leaf is
+	 * the last one under the Append.
+	 */
+	if (gpas->shared_final && !gpas->shared_final_done)
+	{
+		GpuPreAggSharedFinal *sfinal = gpas->shared_final;
+
+		sfinal->nleafs_done++;
+		gpas->shared_final_done = true;
+		if (!sfinal->disabled &&
+			sfinal->nleafs_done < sfinal->nleafs_init &&
+			!sfinal->pds_final)
+		{
+			sfinal->pds_final		= gpas->pds_final;
+			sfinal->m_fhash			= gpas->m_fhash;
+			sfinal->ev_init_fhash	= gpas->ev_init_fhash;
+			sfinal->f_hash_nslots	= gpas->f_hash_nslots;
+			sfinal->f_hash_length	= gpas->f_hash_length;
+			sfinal->f_nrooms_max	= gpas->f_nrooms_max;
+			gpas->pds_final			= NULL;
+			gpas->m_fhash			= 0UL;
+			gpas->ev_init_fhash		= NULL;
+			gpas->terminator_done	= true;
+			return NULL;
+		}
+	}
+	/*
+	 * The process that completes last among the parallel workers returns
+	 * the final buffer shared by them, prior to its own final buffer.
+	 */
+	if (gpas->sf_attached && !gpas->sf_done)
+	{
+		GpuPreAggSharedState *gpa_sstate = gpas->gpa_sstate;
+		bool		is_last;
+
+		pthreadMutexLock(&gpa_sstate->sf_mutex);
+		gpa_sstate->sf_ndone++;
+		is_last = (gpa_sstate->sf_ndone == gpa_sstate->sf_nattached);
+		if (is_last)
+			gpa_sstate->sf_state = GPUPREAGG_SHARED_FINAL__CLOSED;
+		pthreadMutexUnlock(&gpa_sstate->sf_mutex);
+		gpas->sf_done = true;
+		if (is_last)
+		{
+			*task_is_ready = true;
+			return gpupreagg_download_parallel_final(gpas);
+		}
+	}
 	/* setup a terminator task */
 	gpas->terminator_done = true;
-	*task_is_ready = true;
-	return gpupreagg_create_task(gpas, NULL, 0UL, -1);
+	gtask = gpupreagg_create_task(gpas, NULL, 0UL, -1);
+	/* HLL sketches in the final buffer shall be compacted by GPU */
+	if (gpas->hll_compact_natts > 0 &&
+		gpas->pds_final->kds.nitems > 0)
+		((GpuPreAggTask *) gtask)->hll_compaction = true;
+	else
+		*task_is_ready = true;
+	return gtask;
 }
 
 /*
@@ -5524,6 +7217,10 @@ gpupreagg_next_tuple(GpuTaskState *gts)
 	pgstrom_data_store *pds_final = gpas->pds_final;
 	TupleTableSlot	   *slot = NULL;
 
+	/* final buffer flushed in the middle */
+	if (gpreagg->pds_final)
+		pds_final = gpreagg->pds_final;
+
 	if (gpreagg->task.cpu_fallback)
 	{
 		slot = gpupreagg_next_tuple_fallback(gpas, gpreagg);
@@ -5554,9 +7251,10 @@ gpupreagg_init_final_hash(GpuPreAggTask *gpreagg,
 
 	/*
 	 * NoGroup reduction does not have final-hash buffer, thus
-	 * no need to initialize this.
+	 * no need to initialize this. The final buffer shared by the
+	 * parallel workers is already initialized by the leader.
 	 */
-	if (gpas->m_fhash == 0UL)
+	if (gpas->m_fhash == 0UL || gpreagg->sf_attached)
 		return;
 
 	pthreadMutexLock(&gpas->f_mutex);
@@ -5575,6 +7273,33 @@ gpupreagg_init_final_hash(GpuPreAggTask *gpreagg,
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuEventCreate: %s", errorText(rc));
 
+			/*
+			 * Under the oversubscription mode, the final buffer and
+			 * hash-slot may be larger than the device memory. Prefetch
+			 * hints the portion to be touched by the GPU kernel first.
+			 */
+			if (pgstrom_gpu_memory_oversubscription)
+			{
+				pgstrom_data_store *pds_final = gpas->pds_final;
+
+				rc = gpuMemAdviseManaged(GpuWorkerCurrentContext,
+										 gpas->m_fhash,
+										 gpas->f_hash_length,
+										 offsetof(kern_global_hashslot,
+												  slots[gpas->f_hash_nslots]),
+										 false,
+										 CU_STREAM_PER_THREAD);
+				if (rc == CUDA_SUCCESS)
+					rc = gpuMemAdviseManaged(GpuWorkerCurrentContext,
+											 (CUdeviceptr)&pds_final->kds,
+											 pds_final->kds.length,
+											 KERN_DATA_STORE_HEAD_LENGTH(&pds_final->kds),
+											 false,
+											 CU_STREAM_PER_THREAD);
+				if (rc != CUDA_SUCCESS)
+					wnotice("failed on gpuMemAdviseManaged: %s", errorText(rc));
+			}
+
 			rc = gpuOptimalBlockSize(&grid_sz,
 									 &block_sz,
 									 kern_init_fhash,
@@ -5640,6 +7365,31 @@ gpupreaggUpdateRunTimeStat(GpuTaskState *gts, kern_gpupreagg *kgpreagg)
 	//TODO: other statistics
 }
 
+/*
+ * gpupreaggSetupLocalBypassHint / gpupreaggUpdateLocalBypassHint
+ *
+ * If more than half of the blocks of the last reduction kernel skipped the
+ * local reduction, the next kernel tells the blocks to decide it by the
+ * first batch; it shall be cleared once groups get low-cardinality again.
+ */
+static void
+gpupreaggSetupLocalBypassHint(GpuPreAggTask *gpreagg)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+
+	gpreagg->kern.local_bypass_hint = gpas->local_bypass_hint;
+	gpreagg->kern.nr_local_bypass = 0;
+}
+
+static void
+gpupreaggUpdateLocalBypassHint(GpuPreAggTask *gpreagg, cl_int grid_sz)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+
+	if (gpreagg->kern.num_group_keys > 0)
+		gpas->local_bypass_hint = (2 * gpreagg->kern.nr_local_bypass > grid_sz);
+}
+
 /*
  * gpupreagg_throw_partial_result
  */
@@ -5694,6 +7444,260 @@ gpupreagg_throw_partial_result(GpuPreAggTask *gpreagg,
 	SetLatch(MyLatch);
 }
 
+/*
+ * gpupreagg_compact_final_buffer
+ *
+ * It launches the GPU kernel to rewrite the HLL sketches of hll_count() in
+ * the final buffer to the sparse form with the estimated cardinality, prior
+ * to the emission. It reduces the amount of DMA to the host, and CPU does
+ * not need to run the estimation unless multiple partial results are merged.
+ */
+static void
+gpupreagg_compact_final_buffer(GpuPreAggState *gpas,
+							   pgstrom_data_store *pds_final,
+							   CUmodule cuda_module)
+{
+	CUfunction	kern_hll_compaction;
+	CUdeviceptr	m_kds_final = (CUdeviceptr)&pds_final->kds;
+	CUresult	rc;
+	cl_int		grid_sz;
+	cl_int		block_sz;
+	cl_int		i, colidx;
+	void	   *kern_args[2];
+
+	if (gpas->hll_compact_natts == 0 || pds_final->kds.nitems == 0)
+		return;
+
+	rc = cuModuleGetFunction(&kern_hll_compaction,
+							 cuda_module,
+							 "kern_gpupreagg_hll_compaction");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction: %s", errorText(rc));
+
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_hll_compaction,
+							 CU_DEVICE_PER_THREAD,
+							 0, sizeof(cl_uint));
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	grid_sz = Min(grid_sz, pds_final->kds.nitems);
+
+	for (i=0; i < gpas->hll_compact_natts; i++)
+	{
+		colidx = gpas->hll_compact_attnums[i];
+		kern_args[0] = &m_kds_final;
+		kern_args[1] = &colidx;
+		rc = cuLaunchKernel(kern_hll_compaction,
+							grid_sz, 1, 1,
+							block_sz, 1, 1,
+							sizeof(cl_uint) * block_sz,	/* for StairlikeSum */
+							CU_STREAM_PER_THREAD,
+							kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuLaunchKernel: %s", errorText(rc));
+	}
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuStreamSynchronize: %s", errorText(rc));
+}
+
+/*
+ * gpupreagg_flush_final_buffer
+ *
+ * It returns the final buffer to the backend as a partial result, then
+ * assigns a new empty one. Because the upper Agg node combines the partial
+ * aggregates, groups which appear on multiple final buffers are merged by
+ * the CPU. The final hash-slot is re-initialized by the next task.
+ * Caller must hold f_mutex, and no reduction must be running.
+ */
+static void
+gpupreagg_flush_final_buffer(GpuPreAggTask *gpreagg, CUmodule cuda_module)
+{
+	GpuContext	   *gcontext = GpuWorkerCurrentContext;
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+	GpuTaskState   *gts = &gpas->gts;
+	pgstrom_data_store *pds_final = gpas->pds_final;
+	GpuPreAggTask  *gresp;		/* responder task */
+	CUresult		rc;
+
+	Assert(gpas->f_nr_running == 0);
+	rc = gpuMemAllocManaged(gcontext,
+							(CUdeviceptr *)&gresp,
+							offsetof(GpuPreAggTask, kern.kparams),
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuMemAllocManaged: %s", errorText(rc));
+	memset(gresp, 0, offsetof(GpuPreAggTask, kern.kparams));
+	gresp->task.task_kind	= gpreagg->task.task_kind;
+	gresp->task.program_id	= gpreagg->task.program_id;
+	gresp->task.cpu_fallback= false;
+	gresp->task.gts			= gts;
+	gresp->pds_final		= pds_final;
+	gpupreagg_compact_final_buffer(gpas, pds_final, cuda_module);
+
+	/* assign a new final buffer, and re-initialize the final hash-slot */
+	gpas->pds_final = PDS_create_slot(gcontext,
+									  gpas->part_slot->tts_tupleDescriptor,
+									  pds_final->kds.length);
+	if (gpas->ev_init_fhash)
+	{
+		rc = cuEventDestroy(gpas->ev_init_fhash);
+		if (rc != CUDA_SUCCESS)
+			wnotice("failed on cuEventDestroy: %s", errorText(rc));
+		gpas->ev_init_fhash = NULL;
+	}
+
+	/* async prefetch kds_final; which should be on the device memory */
+	rc = cuMemPrefetchAsync((CUdeviceptr) &pds_final->kds,
+							pds_final->kds.length,
+							CU_DEVICE_CPU,
+							CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+
+	/* Back GpuTask to GTS */
+	pthreadMutexLock(&gcontext->worker_mutex);
+	dlist_push_tail(&gts->ready_tasks,
+					&gresp->task.chain);
+	gts->num_ready_tasks++;
+	pthreadMutexUnlock(&gcontext->worker_mutex);
+
+	SetLatch(MyLatch);
+}
+
+/*
+ * gpupreagg_attach_final_buffer / gpupreagg_detach_final_buffer
+ *
+ * GpuTask attaches the final buffer prior to the reduction. If the final
+ * buffer may not have enough space for the groups of this task, it waits
+ * for completion of the concurrent reductions, then flushes the final
+ * buffer, instead of the NoDataSpace error in GPU kernel.
+ * The final buffer shared by the parallel workers is preferred, if any.
+ * It cannot be flushed in the middle, so the process goes back to its own
+ * final buffer once the shared one has no space for the task.
+ */
+static bool
+gpupreagg_attach_shared_final_buffer(GpuPreAggTask *gpreagg)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+	GpuPreAggSharedState *gpa_sstate = gpas->gpa_sstate;
+	size_t			nrooms = gpreagg->kds_slot_nrooms;
+	bool			retval = false;
+
+	if (gpas->m_sf_kds == 0UL || gpas->sf_no_space)
+		return false;
+
+	pthreadMutexLock(&gpa_sstate->sf_mutex);
+	if (gpa_sstate->sf_state == GPUPREAGG_SHARED_FINAL__READY)
+	{
+		if (gpas->num_group_keys > 0 &&
+			gpa_sstate->sf_nitems +
+			gpa_sstate->sf_nrooms_running + nrooms > gpa_sstate->sf_nrooms_max)
+		{
+			gpas->sf_no_space = true;
+		}
+		else
+		{
+			if (!gpas->sf_attached)
+			{
+				gpa_sstate->sf_nattached++;
+				gpas->sf_attached = true;
+			}
+			if (gpas->num_group_keys > 0)
+				gpa_sstate->sf_nrooms_running += nrooms;
+			retval = true;
+		}
+	}
+	pthreadMutexUnlock(&gpa_sstate->sf_mutex);
+
+	return retval;
+}
+
+static void
+gpupreagg_attach_final_buffer(GpuPreAggTask *gpreagg, CUmodule cuda_module)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+	size_t			nrooms = gpreagg->kds_slot_nrooms;
+
+	if (gpupreagg_attach_shared_final_buffer(gpreagg))
+	{
+		gpreagg->sf_attached = true;
+		return;
+	}
+	if (gpas->num_group_keys == 0)
+		return;
+
+	pthreadMutexLock(&gpas->f_mutex);
+	STROM_TRY();
+	{
+		for (;;)
+		{
+			kern_data_store *kds_final = &gpas->pds_final->kds;
+			size_t		nitems = *((volatile cl_uint *)&kds_final->nitems);
+
+			if (nitems == 0 ||
+				nitems + gpas->f_nrooms_running + nrooms <= gpas->f_nrooms_max)
+				break;
+			if (gpas->f_nr_running == 0)
+				gpupreagg_flush_final_buffer(gpreagg, cuda_module);
+			else
+				pthreadCondWait(&gpas->f_cond, &gpas->f_mutex);
+		}
+		gpas->f_nr_running++;
+		gpas->f_nrooms_running += nrooms;
+	}
+	STROM_CATCH();
+	{
+		pthreadMutexUnlock(&gpas->f_mutex);
+		STROM_RE_THROW();
+	}
+	STROM_END_TRY();
+	pthreadMutexUnlock(&gpas->f_mutex);
+}
+
+static void
+gpupreagg_detach_final_buffer(GpuPreAggTask *gpreagg)
+{
+	GpuPreAggState *gpas = (GpuPreAggState *) gpreagg->task.gts;
+
+	if (gpreagg->sf_attached)
+	{
+		GpuPreAggSharedState *gpa_sstate = gpas->gpa_sstate;
+		cl_uint		nitems = 0;
+		CUresult	rc;
+
+		gpreagg->sf_attached = false;
+		if (gpas->num_group_keys == 0)
+			return;
+		/* groups by the completed reduction are visible to others */
+		rc = cuMemcpyDtoH(&nitems,
+						  gpas->m_sf_kds + offsetof(kern_data_store, nitems),
+						  sizeof(cl_uint));
+		if (rc != CUDA_SUCCESS)
+			wnotice("failed on cuMemcpyDtoH: %s", errorText(rc));
+		pthreadMutexLock(&gpa_sstate->sf_mutex);
+		Assert(gpa_sstate->sf_nrooms_running >= gpreagg->kds_slot_nrooms);
+		gpa_sstate->sf_nrooms_running -= gpreagg->kds_slot_nrooms;
+		if (rc != CUDA_SUCCESS)
+			gpa_sstate->sf_nitems = gpa_sstate->sf_nrooms_max;
+		else
+			gpa_sstate->sf_nitems = Max(gpa_sstate->sf_nitems, nitems);
+		pthreadMutexUnlock(&gpa_sstate->sf_mutex);
+		return;
+	}
+	if (gpas->num_group_keys == 0)
+		return;
+
+	pthreadMutexLock(&gpas->f_mutex);
+	Assert(gpas->f_nr_running > 0);
+	gpas->f_nr_running--;
+	gpas->f_nrooms_running -= gpreagg->kds_slot_nrooms;
+	pthreadCondBroadcast(&gpas->f_cond);
+	pthreadMutexUnlock(&gpas->f_mutex);
+}
+
 /*
  * gpupreagg_process_reduction_task
  *
@@ -5715,8 +7719,12 @@ gpupreagg_process_reduction_task(GpuPreAggTask *gpreagg,
 	CUdeviceptr		m_kds_src = 0UL;
 	CUdeviceptr		m_kds_extra = 0UL;
 	CUdeviceptr		m_kds_slot = 0UL;
-	CUdeviceptr		m_kds_final = (CUdeviceptr)&pds_final->kds;
-	CUdeviceptr		m_fhash = gpas->m_fhash;
+	CUdeviceptr		m_kds_final = (gpreagg->sf_attached
+									   ? gpas->m_sf_kds
+									   : (CUdeviceptr)&pds_final->kds);
+	CUdeviceptr		m_fhash = (gpreagg->sf_attached
+								   ? gpas->m_sf_fhash
+								   : gpas->m_fhash);
 	bool			m_kds_src_release = false;
 	cl_int			grid_sz;
 	cl_int			block_sz;
@@ -5761,6 +7769,8 @@ gpupreagg_process_reduction_task(GpuPreAggTask *gpreagg,
 							 cuda_module,
 							 gpreagg->kern.num_group_keys == 0
 							 ? "kern_gpupreagg_nogroup_reduction"
+							 : gpreagg->sorted_reduction
+							 ? "kern_gpupreagg_sorted_reduction"
 							 : "kern_gpupreagg_groupby_reduction");
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuModuleGetFunction: %s", errorText(rc));
@@ -5837,6 +7847,7 @@ gpupreagg_process_reduction_task(GpuPreAggTask *gpreagg,
 	/*
 	 * OK, kick a series of GpuPreAgg invocations
 	 */
+	gpuTaskStageMark(GPUTASK_STAGE__QUEUE, CU_STREAM_PER_THREAD);
 
 	/* source data to be reduced */
 	if (gpreagg->with_nvme_strom)
@@ -5851,6 +7862,7 @@ gpupreagg_process_reduction_task(GpuPreAggTask *gpreagg,
 							   CU_STREAM_PER_THREAD);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemcpyHtoD: %s", errorText(rc));
+		gpuTaskStageDma(pds_src->kds.length, 0);
 	}
 	else if (pds_src->kds.format != KDS_FORMAT_COLUMN)
 	{
@@ -5860,6 +7872,7 @@ gpupreagg_process_reduction_task(GpuPreAggTask *gpreagg,
 								CU_STREAM_PER_THREAD);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		gpuTaskStageDma(pds_src->kds.length, 0);
 	}
 
 	/*
@@ -5877,6 +7890,7 @@ gpupreagg_process_reduction_task(GpuPreAggTask *gpreagg,
 		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
 	gpreagg->kern.grid_sz = grid_sz;
 	gpreagg->kern.block_sz = block_sz;
+	gpuTaskStageMark(GPUTASK_STAGE__DMA_SEND, CU_STREAM_PER_THREAD);
 resume_kernel:
 	/* make kds_slot empty */
 	((kern_data_store *)m_kds_slot)->nitems = 0;
@@ -5912,6 +7926,7 @@ resume_kernel:
 							 0, sizeof(int));
 	if (rc != CUDA_SUCCESS)
 		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	gpupreaggSetupLocalBypassHint(gpreagg);
 	kern_args[0] = &m_gpreagg;
 	kern_args[1] = &m_nullptr;
 	kern_args[2] = &m_kds_slot;
@@ -5926,6 +7941,7 @@ resume_kernel:
 						NULL);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuLaunchKernel: %s", errorText(rc));
+	gpuTaskStageMark(GPUTASK_STAGE__KERN_EXEC, CU_STREAM_PER_THREAD);
 
 	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
 	if (rc != CUDA_SUCCESS)
@@ -5935,6 +7951,7 @@ resume_kernel:
 	rc = cuEventSynchronize(CU_EVENT_PER_THREAD);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuEventSynchronize: %s", errorText(rc));
+	gpupreaggUpdateLocalBypassHint(gpreagg, grid_sz);
 
 	/*
 	 * XXX - Even though we speculatively allocate large virtual device
@@ -5966,6 +7983,8 @@ resume_kernel:
 				last_suspend = alloca(gpreagg->kern.suspend_size);
 			temp = KERN_GPUPREAGG_SUSPEND_CONTEXT(&gpreagg->kern, 0);
 			memcpy(last_suspend, temp, gpreagg->kern.suspend_size);
+			gpuTaskStageUpdate(&gpreagg->task);
+			gpuTaskStageMark(GPUTASK_STAGE__DMA_SEND, CU_STREAM_PER_THREAD);
 			goto resume_kernel;
 		}
 		gpupreaggUpdateRunTimeStat(gpreagg->task.gts, &gpreagg->kern);
@@ -6033,6 +8052,7 @@ resume_kernel:
 									CU_STREAM_PER_THREAD);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+			gpuTaskStageDma(0, gpreagg->kds_slot_length);
 			gpreagg->kds_slot = (kern_data_store *) m_kds_slot;
 			m_kds_slot = 0UL;
 		}
@@ -6045,6 +8065,7 @@ resume_kernel:
 		retval = 0;
 	}
 out_of_resource:
+	gpuTaskStageUpdate(&gpreagg->task);
 	if (m_kds_src_release)
 		gpuMemFree(gcontext, m_kds_src);
 	if (m_kds_slot != 0UL)
@@ -6073,8 +8094,12 @@ gpupreagg_process_combined_task(GpuPreAggTask *gpreagg, CUmodule cuda_module)
 	CUdeviceptr		m_kds_src = 0UL;
 	CUdeviceptr		m_kds_extra = 0UL;
 	CUdeviceptr		m_kds_slot = 0UL;
-	CUdeviceptr		m_kds_final = (CUdeviceptr)&pds_final->kds;
-	CUdeviceptr		m_fhash = gpas->m_fhash;
+	CUdeviceptr		m_kds_final = (gpreagg->sf_attached
+									   ? gpas->m_sf_kds
+									   : (CUdeviceptr)&pds_final->kds);
+	CUdeviceptr		m_fhash = (gpreagg->sf_attached
+								   ? gpas->m_sf_fhash
+								   : gpas->m_fhash);
 	CUdeviceptr		m_kparams = ((CUdeviceptr)&gpreagg->kern +
 								 offsetof(kern_gpupreagg, kparams));
 	CUresult		rc;
@@ -6108,6 +8133,8 @@ gpupreagg_process_combined_task(GpuPreAggTask *gpreagg, CUmodule cuda_module)
 							 cuda_module,
 							 gpreagg->kern.num_group_keys == 0
 							 ? "kern_gpupreagg_nogroup_reduction"
+							 : gpreagg->sorted_reduction
+							 ? "kern_gpupreagg_sorted_reduction"
 							 : "kern_gpupreagg_groupby_reduction");
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuModuleGetFunction: %s", errorText(rc));
@@ -6184,6 +8211,7 @@ gpupreagg_process_combined_task(GpuPreAggTask *gpreagg, CUmodule cuda_module)
 	/*
 	 * OK, kick a series of GpuPreAgg invocations
 	 */
+	gpuTaskStageMark(GPUTASK_STAGE__QUEUE, CU_STREAM_PER_THREAD);
 	if (pds_src)
 	{
 		if (gpreagg->with_nvme_strom)
@@ -6198,6 +8226,7 @@ gpupreagg_process_combined_task(GpuPreAggTask *gpreagg, CUmodule cuda_module)
 								   CU_STREAM_PER_THREAD);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemcpyHtoDAsync: %s", errorText(rc));
+			gpuTaskStageDma(pds_src->kds.length, 0);
 		}
 		else if (pds_src->kds.format != KDS_FORMAT_COLUMN)
 		{
@@ -6207,8 +8236,12 @@ gpupreagg_process_combined_task(GpuPreAggTask *gpreagg, CUmodule cuda_module)
 									CU_STREAM_PER_THREAD);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+			gpuTaskStageDma(pds_src->kds.length, 0);
 		}
 	}
+	/* inner buffer may be still under the asynchronous copy */
+	GpuJoinInnerSyncDeviceBuffer((GpuTaskState *) outerPlanState(gpas));
+	gpuTaskStageMark(GPUTASK_STAGE__DMA_SEND, CU_STREAM_PER_THREAD);
 resume_kernel:
 	/* make kds_slot empty again */
 	((kern_data_store *)m_kds_slot)->nitems = 0;
@@ -6284,6 +8317,7 @@ resume_kernel:
 	if (rc != CUDA_SUCCESS)
 		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
 
+	gpupreaggSetupLocalBypassHint(gpreagg);
 	kern_args[0] = &m_gpreagg;
 	kern_args[1] = &m_kgjoin;
 	kern_args[2] = &m_kds_slot;
@@ -6298,6 +8332,7 @@ resume_kernel:
 						NULL);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuLaunchKernel: %s", errorText(rc));
+	gpuTaskStageMark(GPUTASK_STAGE__KERN_EXEC, CU_STREAM_PER_THREAD);
 
 	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
 	if (rc != CUDA_SUCCESS)
@@ -6307,6 +8342,7 @@ resume_kernel:
 	rc = cuEventSynchronize(CU_EVENT_PER_THREAD);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuEventSynchronize: %s", errorText(rc));
+	gpupreaggUpdateLocalBypassHint(gpreagg, grid_sz);
 
 	if (kgjoin->kerror.errcode != ERRCODE_STROM_SUCCESS)
 	{
@@ -6391,6 +8427,9 @@ resume_kernel:
 					last_suspend = alloca(kgjoin->suspend_size);
 				temp = KERN_GPUJOIN_SUSPEND_CONTEXT(kgjoin, 0);
 				memcpy(last_suspend, temp, kgjoin->suspend_size);
+				gpuTaskStageUpdate(&gpreagg->task);
+				gpuTaskStageMark(GPUTASK_STAGE__DMA_SEND,
+								 CU_STREAM_PER_THREAD);
 				goto resume_kernel;
 			}
 			else
@@ -6401,6 +8440,7 @@ resume_kernel:
 										CU_STREAM_PER_THREAD);
 				if (rc != CUDA_SUCCESS)
 					werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+				gpuTaskStageDma(0, gpreagg->kds_slot_length);
 				gpreagg->task.cpu_fallback = true;
 				gpreagg->kds_slot = (kern_data_store *) m_kds_slot;
 				m_kds_slot = 0UL;
@@ -6429,6 +8469,8 @@ resume_kernel:
 			memcpy(last_suspend,
 				   KERN_GPUJOIN_SUSPEND_CONTEXT(kgjoin, 0),
 				   kgjoin->suspend_size);
+			gpuTaskStageUpdate(&gpreagg->task);
+			gpuTaskStageMark(GPUTASK_STAGE__DMA_SEND, CU_STREAM_PER_THREAD);
 			goto resume_kernel;
 		}
 		gpujoinUpdateRunTimeStat(gjs, gpreagg->kgjoin);
@@ -6436,6 +8478,7 @@ resume_kernel:
 		retval = -1;
 	}
 out_of_resource:
+	gpuTaskStageUpdate(&gpreagg->task);
 	if (m_kds_src_release)
 		gpuMemFree(gcontext, m_kds_src);
 	if (m_kds_slot)
@@ -6455,6 +8498,15 @@ gpupreagg_process_task(GpuTask *gtask, CUmodule cuda_module)
 	int				retval;
 	CUresult		rc;
 
+	/* terminator task which compacts the final buffer only */
+	if (gpreagg->hll_compaction)
+	{
+		GpuPreAggState *gpas = (GpuPreAggState *) gtask->gts;
+
+		gpupreagg_compact_final_buffer(gpas, gpas->pds_final, cuda_module);
+		return 0;
+	}
+	gpupreagg_attach_final_buffer(gpreagg, cuda_module);
 	STROM_TRY();
 	{
 		/*
@@ -6479,11 +8531,13 @@ gpupreagg_process_task(GpuTask *gtask, CUmodule cuda_module)
 	{
 		if (gcache_mapped)
 			gpuCacheUnmapDeviceMemory(GpuWorkerCurrentContext, pds_src);
+		gpupreagg_detach_final_buffer(gpreagg);
 		STROM_RE_THROW();
 	}
 	STROM_END_TRY();
 	if (gcache_mapped)
 		gpuCacheUnmapDeviceMemory(GpuWorkerCurrentContext, pds_src);
+	gpupreagg_detach_final_buffer(gpreagg);
 	return retval;
 }
 
@@ -6498,6 +8552,8 @@ gpupreagg_release_task(GpuTask *gtask)
 
 	if (gpreagg->pds_src)
 		PDS_release(gpreagg->pds_src);
+	if (gpreagg->pds_final)
+		PDS_release(gpreagg->pds_final);
 	if (gpreagg->kds_slot)
 		gpuMemFree(gcontext, (CUdeviceptr)gpreagg->kds_slot);
 	gpuMemFree(gcontext, (CUdeviceptr)gpreagg);
@@ -6536,6 +8592,33 @@ pgstrom_init_gpupreagg(void)
 							 PGC_USERSET,
                              GUC_NOT_IN_SAMPLE,
                              NULL, NULL, NULL);
+	/* pg_strom.enable_hll_device_estimation */
+	DefineCustomBoolVariable("pg_strom.enable_hll_device_estimation",
+							 "Enables GPU to compact HLL sketches of hll_count() with the estimated cardinality",
+							 NULL,
+							 &enable_hll_device_estimation,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.enable_partitionwise_gpupreagg_shared */
+	DefineCustomBoolVariable("pg_strom.enable_partitionwise_gpupreagg_shared",
+							 "Enables a final buffer shared by partition-wise GpuPreAgg",
+							 NULL,
+							 &enable_partitionwise_shared_final,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.enable_gpupreagg_parallel_shared */
+	DefineCustomBoolVariable("pg_strom.enable_gpupreagg_parallel_shared",
+							 "Enables a final buffer on the device shared by parallel workers",
+							 NULL,
+							 &enable_parallel_shared_final,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
 	/* pg_strom.enable_numeric_aggfuncs */
 	DefineCustomBoolVariable("pg_strom.enable_numeric_aggfuncs",
 							 "Enables aggregate functions on numeric type",
@@ -6545,6 +8628,28 @@ pgstrom_init_gpupreagg(void)
 							 PGC_USERSET,
 							 GUC_NO_SHOW_ALL | GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
+	/* pg_strom.enable_sorted_gpupreagg */
+	DefineCustomBoolVariable("pg_strom.enable_sorted_gpupreagg",
+							 "Enables segmented reduction of GpuPreAgg for pre-clustered inputs",
+							 NULL,
+							 &enable_sorted_gpupreagg,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpupreagg_result_cache_size */
+	DefineCustomIntVariable("pg_strom.gpupreagg_result_cache_size",
+							"Size of GpuPreAgg result cache over GpuCache per backend",
+							NULL,
+							&gpupreagg_result_cache_size,
+							0,
+							0,
+							MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
+	dlist_init(&gpupreagg_result_cache_list);
+	dlist_init(&gpupreagg_shared_final_list);
 	/* pg_strom.hll_registers_bits */
 	DefineCustomIntVariable("pg_strom.hll_registers_bits",
 							"Accuracy of HyperLogLog COUNT(distinct ...) estimation",
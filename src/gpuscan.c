@@ -19,6 +19,15 @@ static CustomScanMethods	gpuscan_plan_methods;
 static CustomExecMethods	gpuscan_exec_methods;
 bool						enable_gpuscan;		/* GUC */
 static bool					enable_pullup_outer_scan;
+static bool					enable_gpuscan_late_materialization;
+static bool					enable_gpuscan_selection_vector;
+static bool					enable_gpuscan_topn;
+static bool					enable_gpuscan_cuda_graph;
+static bool					enable_gpuscan_adaptive_quals;
+static bool					enable_gpuscan_bloom_filter;
+static bool					enable_gpuscan_simple_kernel;
+static bool					enable_append_gpu_fanout;
+static int					gpuscan_batch_size_kb;		/* GUC */
 
 /*
  * form/deform interface of private field of CustomScan(GpuScan)
@@ -35,6 +44,22 @@ typedef struct {
 	Oid			index_oid;		/* OID of BRIN-index, if any */
 	List	   *index_conds;	/* BRIN-index key conditions */
 	List	   *index_quals;	/* original BRIN-index qualifier */
+	bool		late_materialization; /* 2-phase projection on BLOCK */
+	bool		selection_vector; /* returns positions of the source rows */
+	cl_uint		nrows_limit;	/* LIMIT hint, or 0 if unlimited */
+	cl_uint		topn_nrows;		/* N of device top-N, or 0 if not used */
+	List	   *topn_colidx;	/* column index of the top-N sort keys */
+	List	   *topn_kind;		/* GPUSCAN_TOPN_KEY__* of the sort keys */
+	List	   *topn_desc;		/* true, if DESC */
+	List	   *topn_nulls_first;	/* true, if NULLS FIRST */
+	List	   *dev_qual_costs;	/* static cost of the adaptive quals, or NIL */
+	char	   *bloom_source;	/* source of the bloom-filter evaluation */
+	List	   *bloom_keys;		/* join keys of the bloom-filter, or NIL */
+	AttrNumber	gcache_index_attnum; /* column of the GPU cache hash index */
+	Expr	   *gcache_index_key;	/* key of the GPU cache hash index lookup */
+	cl_int		simple_pindex;	/* gpuscanSimpleDesc in used_params, or -1 */
+	List	   *zmap_conds;		/* conditions to be checked on the zone-map */
+	bool		append_fanout;	/* fan-out across GPUs under the Append */
 } GpuScanInfo;
 
 static inline void
@@ -54,6 +79,22 @@ form_gpuscan_info(CustomScan *cscan, GpuScanInfo *gs_info)
 	privs = lappend(privs, makeInteger(gs_info->index_oid));
 	privs = lappend(privs, gs_info->index_conds);
 	exprs = lappend(exprs, gs_info->index_quals);
+	privs = lappend(privs, makeInteger(gs_info->late_materialization));
+	privs = lappend(privs, makeInteger(gs_info->selection_vector));
+	privs = lappend(privs, makeInteger(gs_info->nrows_limit));
+	privs = lappend(privs, makeInteger(gs_info->topn_nrows));
+	privs = lappend(privs, gs_info->topn_colidx);
+	privs = lappend(privs, gs_info->topn_kind);
+	privs = lappend(privs, gs_info->topn_desc);
+	privs = lappend(privs, gs_info->topn_nulls_first);
+	privs = lappend(privs, gs_info->dev_qual_costs);
+	privs = lappend(privs, makeString(gs_info->bloom_source));
+	exprs = lappend(exprs, gs_info->bloom_keys);
+	privs = lappend(privs, makeInteger(gs_info->gcache_index_attnum));
+	exprs = lappend(exprs, gs_info->gcache_index_key);
+	privs = lappend(privs, makeInteger(gs_info->simple_pindex));
+	privs = lappend(privs, gs_info->zmap_conds);
+	privs = lappend(privs, makeInteger(gs_info->append_fanout));
 
 	cscan->custom_private = privs;
 	cscan->custom_exprs = exprs;
@@ -79,12 +120,31 @@ deform_gpuscan_info(CustomScan *cscan)
 	gs_info->index_oid = intVal(list_nth(privs, pindex++));
 	gs_info->index_conds = list_nth(privs, pindex++);
 	gs_info->index_quals = list_nth(exprs, eindex++);
+	gs_info->late_materialization = intVal(list_nth(privs, pindex++));
+	gs_info->selection_vector = intVal(list_nth(privs, pindex++));
+	gs_info->nrows_limit = intVal(list_nth(privs, pindex++));
+	gs_info->topn_nrows = intVal(list_nth(privs, pindex++));
+	gs_info->topn_colidx = list_nth(privs, pindex++);
+	gs_info->topn_kind = list_nth(privs, pindex++);
+	gs_info->topn_desc = list_nth(privs, pindex++);
+	gs_info->topn_nulls_first = list_nth(privs, pindex++);
+	gs_info->dev_qual_costs = list_nth(privs, pindex++);
+	gs_info->bloom_source = strVal(list_nth(privs, pindex++));
+	gs_info->bloom_keys = list_nth(exprs, eindex++);
+	gs_info->gcache_index_attnum = intVal(list_nth(privs, pindex++));
+	gs_info->gcache_index_key = list_nth(exprs, eindex++);
+	gs_info->simple_pindex = intVal(list_nth(privs, pindex++));
+	gs_info->zmap_conds = list_nth(privs, pindex++);
+	gs_info->append_fanout = intVal(list_nth(privs, pindex++));
 
 	return gs_info;
 }
 
 typedef struct {
 	GpuTaskRuntimeStat	c;		/* common statistics */
+	/* statistics of the adaptive device quals */
+	pg_atomic_uint64	qual_nitems_in[GPUSCAN_MAX_ADAPTIVE_QUALS];
+	pg_atomic_uint64	qual_nitems_out[GPUSCAN_MAX_ADAPTIVE_QUALS];
 } GpuScanRuntimeStat;
 
 typedef struct {
@@ -98,18 +158,53 @@ typedef struct {
 	GpuScanSharedState *gs_sstate;
 	GpuScanRuntimeStat *gs_rtstat;
 	ExprState	   *dev_quals;		/* quals to be run on the device */
+	bool			late_materialization;	/* 2-phase projection on BLOCK */
+	bool			selection_vector;	/* returns positions of the rows */
+	bool			cuda_graph;			/* launch kernels by CUDA graph */
+	cl_uint			nrows_limit;		/* LIMIT hint, or 0 if unlimited */
+	cl_ulong		nrows_limit_base;	/* # of rows at the (re-)scan start */
+	cl_uint			topn_nrows;			/* N of device top-N, or 0 */
+	cl_uint			topn_nkeys;			/* # of the top-N sort keys */
+	gpuscanTopNKey	topn_keys[GPUSCAN_TOPN_MAX_KEYS];
+	cl_uint			nquals;				/* # of adaptive quals, or 0 */
+	cl_int			qual_costs[GPUSCAN_MAX_ADAPTIVE_QUALS];
+	bool			bloom_filter;		/* bloom-filter from parent GpuJoin */
+	CUdeviceptr		m_bloom_bitmap;		/* bitmap of the bloom-filter */
+	cl_uint			bloom_nbits;		/* # of bits, or 0 if not ready */
+	AttrNumber		gcache_index_attnum; /* hash index column of GPU cache */
+	ExprState	   *gcache_index_key;	/* key of the hash index lookup */
+	cl_int			simple_pindex;		/* precompiled kernel, if >= 0 */
 	/* resource for CPU fallback */
 	cl_uint			fallback_group_id;
 	cl_uint			fallback_local_id;
+	cl_uint			recheck_index;		/* next row of the recheck buffer */
 	TupleTableSlot *base_slot;
 	ProjectionInfo *base_proj;
 } GpuScanState;
 
+/*
+ * Max number of the source chunks (record-batches of Arrow_Fdw) to be
+ * coalesced into a GpuScanTask.
+ */
+#define GPUSCAN_MAX_BATCH_CHUNKS	32
+
 typedef struct
 {
 	GpuTask				task;
 	bool				with_nvme_strom;
 	bool				with_projection;
+	bool				with_late_materialization;
+	bool				with_selection_vector;
+	bool				with_cuda_graph;
+	/* batch of the source chunks, if any */
+	cl_int				nr_batch;		/* # of chunks in the batch */
+	cl_int				curr_batch;		/* index of the current chunk */
+	pgstrom_data_store *pds_batch[GPUSCAN_MAX_BATCH_CHUNKS];
+	pgstrom_data_store *batch_pds_dst;	/* kds_dst at the chunk start */
+	cl_uint				batch_dst_nitems;	/* nitems at the chunk start */
+	cl_uint				batch_dst_usage;	/* usage at the chunk start */
+	/* WAL insert position before the chunk build, for zone-map */
+	XLogRecPtr			zmap_lsn;
 	/* DMA buffers */
 	pgstrom_data_store *pds_src;
 	pgstrom_data_store *pds_dst;
@@ -124,11 +219,16 @@ static TupleTableSlot *gpuscan_next_tuple(GpuTaskState *gts);
 static void gpuscan_switch_task(GpuTaskState *gts, GpuTask *gtask);
 static int gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module);
 static void gpuscan_release_task(GpuTask *gtask);
+static void gpuscan_throw_partial_result(GpuScanTask *gscan,
+										 pgstrom_data_store *pds_dst);
+static bool gpuscan_cpu_hybrid_task(GpuTaskState *gts, GpuTask *gtask);
+static void gpuscan_fanout_begin(GpuTaskState *gts);
 
 static void createGpuScanSharedState(GpuScanState *gss,
 									 ParallelContext *pcxt,
 									 void *dsm_addr);
 static void resetGpuScanSharedState(GpuScanState *gss);
+static cl_ulong gpuscan_nrows_returned(GpuScanState *gss);
 
 /*
  * cost_for_dma_receive - cost estimation for DMA receive (GPU->host)
@@ -139,14 +239,20 @@ cost_for_dma_receive(RelOptInfo *rel, double ntuples)
 	PathTarget *reltarget = rel->reltarget;
 	cl_int		nattrs = list_length(reltarget->exprs);
 	cl_int		width_per_tuple;
+	double		gpu_setup_cost;
+	double		gpu_dma_cost;
+	double		gpu_operator_cost;
 
+	pgstrom_gpu_cost_factors(&gpu_setup_cost,
+							 &gpu_dma_cost,
+							 &gpu_operator_cost);
 	if (ntuples < 0.0)
 		ntuples = rel->rows;
 	width_per_tuple = offsetof(kern_tupitem, htup) +
 		MAXALIGN(offsetof(HeapTupleHeaderData,
 						  t_bits[BITMAPLEN(nattrs)])) +
 		MAXALIGN(reltarget->width);
-	return pgstrom_gpu_dma_cost *
+	return gpu_dma_cost *
 		(((double)width_per_tuple * ntuples) / (double)pgstrom_chunk_size());
 }
 
@@ -347,9 +453,11 @@ gpuscan_add_scan_path(PlannerInfo *root,
 									  baserel->pages, -1.0,
 									  max_parallel_workers_per_gather);
 		/*
-		 * XXX - Do we need a something specific logic for GpuScan to adjust
-		 * parallel_workers.
+		 * More workers than the saturation point of the device just make
+		 * contention on the GPU.
 		 */
+		parallel_nworkers = pgstrom_gpu_parallel_workers(parallel_nworkers,
+									GetOptimalGpuForRelation(root, baserel));
 		if (parallel_nworkers <= 0)
 			return;
 
@@ -371,14 +479,19 @@ gpuscan_add_scan_path(PlannerInfo *root,
 
 /*
  * reorder_devqual_clauses
+ *
+ * It sorts the device quals by the static cost; the list of costs is also
+ * replaced by the sorted one.
  */
 static List *
-reorder_devqual_clauses(PlannerInfo *root, List *dev_quals, List *dev_costs)
+reorder_devqual_clauses(PlannerInfo *root, List *dev_quals, List **p_dev_costs)
 {
+	List	   *dev_costs = *p_dev_costs;
 	ListCell   *lc1, *lc2;
 	int			nitems;
 	int			i, j, k;
 	List	   *results = NIL;
+	List	   *results_costs = NIL;
 	struct {
 		Node   *qual;
 		int		cost;
@@ -413,40 +526,139 @@ reorder_devqual_clauses(PlannerInfo *root, List *dev_quals, List *dev_costs)
 			items[k] = temp;
 		}
 		results = lappend(results, items[i].qual);
+		results_costs = lappend_int(results_costs, items[i].cost);
 	}
 	pfree(items);
+	*p_dev_costs = results_costs;
 
 	return results;
 }
 
 /*
  * Code generator for GpuScan's qualifier
+ *
+ * If 'adaptive' is true, each qualifier is evaluated individually in the
+ * order given by kern_gpuscan->qual_order[], and number of the evaluated
+ * and survived rows are counted per qualifier. It is valid only for GpuScan
+ * because the generated code references kern_gpuscan via kern_context.
+ *
+ * If 'bloom_keys' is not NIL, the hash value of the keys is checked by the
+ * bloom-filter pushed down from the parent GpuJoin. It is also valid only
+ * for GpuScan by the same reason.
  */
-void
-codegen_gpuscan_quals(StringInfo kern, codegen_context *context,
-					  const char *component,
-					  Index scanrelid, List *dev_quals_list)
+static void
+__codegen_gpuscan_quals(StringInfo kern, codegen_context *context,
+						const char *component,
+						Index scanrelid, List *dev_quals_list,
+						bool adaptive, List *bloom_keys)
 {
 	devtype_info   *dtype;
 	StringInfoData	tfunc;
 	StringInfoData	afunc;
 	StringInfoData  cfunc;
 	StringInfoData	temp;
+	StringInfoData	qcode;
 	Node		   *dev_quals;
 	Var			   *var;
-	char		   *expr_code = NULL;
+	char		   *expr_code;
 	ListCell	   *lc;
 
 	initStringInfo(&tfunc);		/* = ROW/BLOCK */
 	initStringInfo(&afunc);		/* = ARROW */
 	initStringInfo(&cfunc);		/* = COLUMN */
 	initStringInfo(&temp);
+	initStringInfo(&qcode);
 
-	if (scanrelid == 0 || dev_quals_list == NIL)
+	if (scanrelid == 0 || (dev_quals_list == NIL && bloom_keys == NIL))
 		goto output;
+	/* common sub-expressions in the qualifiers and bloom keys */
+	pgstrom_codegen_cse_setup(context, list_concat(list_copy(dev_quals_list),
+												   list_copy(bloom_keys)));
 	/* Let's walk on the device expression tree */
-	dev_quals = (Node *)make_flat_ands_explicit(dev_quals_list);
-	expr_code = pgstrom_codegen_expression(dev_quals, context);
+	if (dev_quals_list == NIL)
+		;
+	else if (!adaptive)
+	{
+		dev_quals = (Node *)make_flat_ands_explicit(dev_quals_list);
+		appendStringInfo(
+			&qcode,
+			"  if (!EVAL(%s))\n"
+			"    return false;\n",
+			pgstrom_codegen_expression(dev_quals, context));
+	}
+	else
+	{
+		int				qual_index = 0;
+
+		Assert(list_length(dev_quals_list) <= GPUSCAN_MAX_ADAPTIVE_QUALS);
+		appendStringInfo(
+			&qcode,
+			"  kern_gpuscan *kgpuscan = KERN_GPUSCAN_FROM_CONTEXT(kcxt);\n"
+			"  pg_bool_t status;\n"
+			"  cl_uint i, qual_index;\n"
+			"\n"
+			"  for (i=0; i < %d; i++)\n"
+			"  {\n"
+			"    qual_index = kgpuscan->qual_order[i];\n"
+			"    switch (qual_index)\n"
+			"    {\n",
+			list_length(dev_quals_list));
+		foreach (lc, dev_quals_list)
+		{
+			appendStringInfo(
+				&qcode,
+				"      case %d:\n"
+				"        status = %s;\n"
+				"        break;\n",
+				qual_index++,
+				pgstrom_codegen_expression(lfirst(lc), context));
+		}
+		appendStringInfoString(
+			&qcode,
+			"      default:\n"
+			"        status.isnull = true;\n"
+			"        status.value = false;\n"
+			"        break;\n"
+			"    }\n"
+			"    gpuscan_update_qual_stat(kcxt, qual_index, EVAL(status));\n"
+			"    if (!EVAL(status))\n"
+			"      return false;\n"
+			"  }\n");
+	}
+
+	/*
+	 * Bloom-filter by the hash value of the join keys; same manner to
+	 * gpujoin_hash_value(), and rows with all-NULL keys never match.
+	 */
+	if (bloom_keys != NIL)
+	{
+		Assert(list_length(bloom_keys) <= GPUSCAN_BLOOM_MAX_KEYS);
+		appendStringInfoString(
+			&qcode,
+			"  {\n"
+			"    cl_uint hash = 0xffffffffU;\n"
+			"    cl_bool is_null_keys = true;\n"
+			"\n");
+		foreach (lc, bloom_keys)
+		{
+			char   *key_code = pgstrom_codegen_expression(lfirst(lc), context);
+
+			appendStringInfo(
+				&qcode,
+				"    if (!%s.isnull)\n"
+				"      is_null_keys = false;\n"
+				"    hash ^= pg_comp_hash(kcxt, %s);\n",
+				key_code,
+				key_code);
+		}
+		appendStringInfoString(
+			&qcode,
+			"    hash ^= 0xffffffffU;\n"
+			"    if (is_null_keys || !gpuscan_bloom_filter_check(kcxt, hash))\n"
+			"      return false;\n"
+			"  }\n");
+	}
+
 	/* Sanity check of used_vars */
 	foreach (lc, context->used_vars)
 	{
@@ -578,10 +790,14 @@ codegen_gpuscan_quals(StringInfo kern, codegen_context *context,
 			"  EXTRACT_HEAP_TUPLE_END();\n");
 	}
 output:
-	if (!expr_code)
-		expr_code = pstrdup("true");
-	else
-		expr_code = psprintf("EVAL(%s)", expr_code);
+	appendStringInfoString(&qcode, "  return true;\n");
+	expr_code = qcode.data;
+
+	resetStringInfo(&temp);
+	pgstrom_codegen_cse_declarations(&temp, context);
+	appendStringInfoString(&tfunc, temp.data);
+	appendStringInfoString(&afunc, temp.data);
+	appendStringInfoString(&cfunc, temp.data);
 
 	appendStringInfo(
 		kern,
@@ -593,7 +809,7 @@ output:
 		"{\n"
 		"  void *addr __attribute__((unused));\n"
 		"%s\n"
-		"  return %s;\n"
+		"%s"
 		"}\n\n"
 		"DEVICE_FUNCTION(cl_bool)\n"
 		"%s_quals_eval_arrow(kern_context *kcxt,\n"
@@ -602,7 +818,7 @@ output:
 		"{\n"
 		"  void *addr __attribute__((unused));\n"
 		"%s\n"
-		"  return %s;\n"
+		"%s"
 		"}\n\n"
 		"DEVICE_FUNCTION(cl_bool)\n"
 		"%s_quals_eval_column(kern_context *kcxt,\n"
@@ -612,7 +828,7 @@ output:
 		"{\n"
 		"  void *addr __attribute__((unused));\n"
 		"%s\n"
-		"  return %s;\n"
+		"%s"
 		"}\n\n",
 		component, tfunc.data, expr_code,
 		component, afunc.data, expr_code,
@@ -625,6 +841,47 @@ output:
 	pfree(expr_code);
 }
 
+void
+codegen_gpuscan_quals(StringInfo kern, codegen_context *context,
+					  const char *component,
+					  Index scanrelid, List *dev_quals_list)
+{
+	__codegen_gpuscan_quals(kern, context, component,
+							scanrelid, dev_quals_list, false, NIL);
+}
+
+/*
+ * codegen_gpuscan_bloom_quals
+ *
+ * It generates gpuscan_bloom_quals_eval(_arrow|_column) to check the
+ * bloom-filter pushed down from the parent GpuJoin. If no bloom keys,
+ * these functions always return true, but never called actually.
+ */
+static char *
+codegen_gpuscan_bloom_quals(PlannerInfo *root,
+							RelOptInfo *baserel,
+							List *bloom_keys,
+							cl_uint *p_extra_flags,
+							cl_uint *p_extra_bufsz)
+{
+	StringInfoData	kern;
+	codegen_context	context;
+
+	initStringInfo(&kern);
+	pgstrom_init_codegen_context(&context, root, baserel);
+	__codegen_gpuscan_quals(&kern, &context, "gpuscan_bloom",
+							baserel->relid, NIL, false, bloom_keys);
+	if (context.decl.len > 0)
+		appendStringInfoChar(&context.decl, '\n');
+	appendStringInfoString(&context.decl, kern.data);
+	pfree(kern.data);
+
+	*p_extra_flags |= context.extra_flags;
+	*p_extra_bufsz = Max(*p_extra_bufsz, context.extra_bufsz);
+
+	return context.decl.data;
+}
+
 /*
  * Code generator for GpuScan's projection
  */
@@ -948,6 +1205,7 @@ codegen_gpuscan_projection(StringInfo kern,
 	/*
 	 * step.5 - execution of expression node, then store the result.
 	 */
+	pgstrom_codegen_cse_setup(context, tlist_dev);
 	resetStringInfo(&temp);
 	foreach (lc, tlist_dev)
 	{
@@ -986,6 +1244,7 @@ codegen_gpuscan_projection(StringInfo kern,
 	appendStringInfoString(&tbody, temp.data);
 	appendStringInfoString(&abody, temp.data);
 	appendStringInfoString(&cbody, temp.data);
+	pgstrom_codegen_cse_declarations(&decl, context);
 
 	/*
 	 * step.6 - put decl/body on the function body
@@ -1290,6 +1549,646 @@ no_gpu_projection:
 	return tlist_dev;
 }
 
+/*
+ * gpuscan_limit_hint
+ *
+ * It returns the number of rows required by the LIMIT clause, if GpuScan is
+ * the only relation of the query level, and no other operations are applied
+ * on the scan result except for ORDER BY and LIMIT/OFFSET. Elsewhere, it
+ * returns 0. Caller has to check whether ORDER BY clause exists.
+ */
+static cl_uint
+gpuscan_limit_hint(PlannerInfo *root, RelOptInfo *baserel)
+{
+	Query	   *parse = root->parse;
+
+	if (root->limit_tuples <= 0.0 ||
+		root->limit_tuples >= (double)INT_MAX)
+		return 0;
+	if (parse->hasAggs ||
+		parse->hasWindowFuncs ||
+		parse->hasTargetSRFs ||
+		parse->groupClause != NIL ||
+		parse->groupingSets != NIL ||
+		parse->havingQual != NULL ||
+		parse->distinctClause != NIL ||
+		parse->rowMarks != NIL ||
+		parse->setOperations != NULL)
+		return 0;
+	if (bms_membership(root->all_baserels) != BMS_SINGLETON)
+		return 0;
+	return (cl_uint) root->limit_tuples;
+}
+
+/*
+ * gpuscan_build_topn_keys
+ *
+ * It checks whether the ORDER BY clause consists of simple references to the
+ * columns of fixed-length numeric types, and set up the sort keys of the
+ * device top-N on the GpuScanInfo, if available.
+ */
+static bool
+gpuscan_build_topn_keys(PlannerInfo *root,
+						RelOptInfo *baserel,
+						List *tlist_dev,
+						GpuScanInfo *gs_info)
+{
+	Query	   *parse = root->parse;
+	List	   *topn_colidx = NIL;
+	List	   *topn_kind = NIL;
+	List	   *topn_desc = NIL;
+	List	   *topn_nulls_first = NIL;
+	ListCell   *lc1, *lc2;
+
+	if (list_length(parse->sortClause) > GPUSCAN_TOPN_MAX_KEYS)
+		return false;
+	foreach (lc1, parse->sortClause)
+	{
+		SortGroupClause *sgc = lfirst(lc1);
+		TargetEntry *tle = get_sortgroupclause_tle(sgc, parse->targetList);
+		Var		   *var = (Var *) tle->expr;
+		TypeCacheEntry *tcache;
+		int			colidx = -1;
+		int			kind;
+
+		if (!IsA(var, Var) ||
+			var->varno != baserel->relid ||
+			var->varlevelsup != 0 ||
+			var->varattno <= 0)
+			return false;
+		switch (var->vartype)
+		{
+			case INT2OID:
+				kind = GPUSCAN_TOPN_KEY__INT16;
+				break;
+			case INT4OID:
+			case DATEOID:
+				kind = GPUSCAN_TOPN_KEY__INT32;
+				break;
+			case INT8OID:
+			case TIMEOID:
+			case TIMESTAMPOID:
+			case TIMESTAMPTZOID:
+				kind = GPUSCAN_TOPN_KEY__INT64;
+				break;
+			case FLOAT4OID:
+				kind = GPUSCAN_TOPN_KEY__FLOAT32;
+				break;
+			case FLOAT8OID:
+				kind = GPUSCAN_TOPN_KEY__FLOAT64;
+				break;
+			default:
+				return false;
+		}
+		/* only default btree ordering is supported */
+		tcache = lookup_type_cache(var->vartype,
+								   TYPECACHE_LT_OPR | TYPECACHE_GT_OPR);
+		if (sgc->sortop != tcache->lt_opr &&
+			sgc->sortop != tcache->gt_opr)
+			return false;
+		/* lookup the column on the destination buffer */
+		if (tlist_dev == NIL)
+			colidx = var->varattno - 1;
+		else
+		{
+			foreach (lc2, tlist_dev)
+			{
+				TargetEntry *tle_dev = lfirst(lc2);
+
+				if (equal(tle_dev->expr, var))
+				{
+					colidx = tle_dev->resno - 1;
+					break;
+				}
+			}
+			if (colidx < 0)
+				return false;
+		}
+		topn_colidx = lappend_int(topn_colidx, colidx);
+		topn_kind = lappend_int(topn_kind, kind);
+		topn_desc = lappend_int(topn_desc, sgc->sortop == tcache->gt_opr);
+		topn_nulls_first = lappend_int(topn_nulls_first, sgc->nulls_first);
+	}
+	gs_info->topn_colidx = topn_colidx;
+	gs_info->topn_kind = topn_kind;
+	gs_info->topn_desc = topn_desc;
+	gs_info->topn_nulls_first = topn_nulls_first;
+
+	return true;
+}
+
+/*
+ * gpuscan_gcache_index_key
+ *
+ * It picks up the key of equality qualifier on the column that has hash
+ * index on the GPU cache, like 'KEY = Const' or 'KEY = $1'. The index
+ * gives only candidate rows, so the qualifier is still evaluated on GPU.
+ */
+static Expr *
+gpuscan_gcache_index_key(List *dev_quals, Index scanrelid, AttrNumber attnum)
+{
+	ListCell   *lc;
+
+	foreach (lc, dev_quals)
+	{
+		OpExpr	   *op = lfirst(lc);
+		TypeCacheEntry *tcache;
+		Var		   *var;
+		Expr	   *key;
+
+		if (!IsA(op, OpExpr) || list_length(op->args) != 2)
+			continue;
+		var = linitial(op->args);
+		key = lsecond(op->args);
+		if (!IsA(var, Var))
+		{
+			Node   *temp = (Node *)var;
+
+			var = (Var *)key;
+			key = (Expr *)temp;
+			if (!IsA(var, Var))
+				continue;
+		}
+		if (var->varno != scanrelid ||
+			var->varattno != attnum ||
+			var->varlevelsup != 0 ||
+			exprType((Node *)key) != var->vartype)
+			continue;
+		if (IsA(key, Const))
+		{
+			if (((Const *)key)->constisnull)
+				continue;
+		}
+		else if (!IsA(key, Param) ||
+				 ((Param *)key)->paramkind != PARAM_EXTERN)
+			continue;
+
+		tcache = lookup_type_cache(var->vartype, TYPECACHE_EQ_OPR);
+		if (!OidIsValid(tcache->eq_opr) || op->opno != tcache->eq_opr)
+			continue;
+		return key;
+	}
+	return NULL;
+}
+
+/*
+ * gpuscan_simple_typlen
+ *
+ * It returns width of the types that precompiled GpuScan kernel can handle
+ * as a signed integer, or 0 if not supported.
+ */
+static int
+gpuscan_simple_typlen(Oid type_oid, bool *p_is_integer)
+{
+	*p_is_integer = false;
+	switch (type_oid)
+	{
+		case INT1OID:
+			*p_is_integer = true;
+			return sizeof(int8);
+		case INT2OID:
+			*p_is_integer = true;
+			return sizeof(int16);
+		case INT4OID:
+			*p_is_integer = true;
+			return sizeof(int32);
+		case INT8OID:
+			*p_is_integer = true;
+			return sizeof(int64);
+		case DATEOID:
+			return sizeof(DateADT);
+		case TIMEOID:
+			return sizeof(TimeADT);
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return sizeof(Timestamp);
+		case FLOAT2OID:
+			return sizeof(int16);	/* float2 */
+		default:
+			break;
+	}
+	return 0;
+}
+
+/*
+ * gpuscan_simple_strategy
+ *
+ * It returns the B-tree strategy number of the operator on the supplied
+ * pair of types, or InvalidStrategy.
+ */
+static int
+gpuscan_simple_strategy(Oid opcode, Oid ltype, Oid rtype)
+{
+	CatCList   *catlist;
+	int			strategy = InvalidStrategy;
+	int			i;
+
+	catlist = SearchSysCacheList1(AMOPOPID, ObjectIdGetDatum(opcode));
+	for (i=0; i < catlist->n_members; i++)
+	{
+		HeapTuple	tuple = &catlist->members[i]->tuple;
+		Form_pg_amop amop = (Form_pg_amop) GETSTRUCT(tuple);
+
+		if (amop->amopmethod == BTREE_AM_OID &&
+			amop->amoplefttype == ltype &&
+			amop->amoprighttype == rtype)
+		{
+			strategy = amop->amopstrategy;
+			break;
+		}
+	}
+	ReleaseSysCacheList(catlist);
+
+	return strategy;
+}
+
+static int
+gpuscan_simple_item_comp(const void *__a, const void *__b)
+{
+	cl_long		a = *((const cl_long *)__a);
+	cl_long		b = *((const cl_long *)__b);
+
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return 0;
+}
+
+static cl_long
+gpuscan_simple_item_value(Datum datum, int typlen)
+{
+	switch (typlen)
+	{
+		case sizeof(int8):
+			return (int8) DatumGetChar(datum);
+		case sizeof(int16):
+			return DatumGetInt16(datum);
+		case sizeof(int32):
+			return DatumGetInt32(datum);
+		case sizeof(int64):
+			return DatumGetInt64(datum);
+		default:
+			elog(ERROR, "Bug? unexpected type length: %d", typlen);
+	}
+	return 0;	/* not reachable */
+}
+
+/*
+ * build_gpuscan_simple_desc
+ *
+ * If all the device qualifiers are simple enough, and the device projection
+ * references the columns of the base relation only, the precompiled GpuScan
+ * kernel (cuda_gpuscan_simple.fatbin) can run the scan without run-time
+ * compilation. It constructs a gpuscanSimpleDesc and adds it on the
+ * @used_params as a bytea constant, then returns its index, or -1 if not
+ * applicable.
+ */
+static int
+build_gpuscan_simple_desc(Index scanrelid,
+						  Relation relation,
+						  List *dev_quals,
+						  List *tlist_dev,
+						  List **p_used_params)
+{
+	gpuscanSimpleDesc *sdesc;
+	List	   *used_params;
+	cl_long		items[GPUSCAN_SIMPLE_MAX_ITEMS];
+	cl_uint		nitems = 0;
+	size_t		length;
+	ListCell   *lc;
+
+	if (!enable_gpuscan_simple_kernel ||
+		relation->rd_rel->relkind == RELKIND_FOREIGN_TABLE ||
+		list_length(dev_quals) > GPUSCAN_SIMPLE_MAX_QUALS)
+		return -1;
+
+	used_params = list_copy(*p_used_params);
+	sdesc = palloc0(offsetof(gpuscanSimpleDesc, items));
+	foreach (lc, dev_quals)
+	{
+		Node	   *clause = lfirst(lc);
+		gpuscanSimpleQual *squal = &sdesc->quals[sdesc->nquals++];
+		Var		   *var;
+		Node	   *arg;
+		Oid			opcode;
+		int			strategy;
+		int			collen;
+		int			arglen;
+		bool		var_is_integer;
+		bool		arg_is_integer;
+
+		if (IsA(clause, OpExpr))
+		{
+			OpExpr	   *op = (OpExpr *) clause;
+
+			if (list_length(op->args) != 2)
+				return -1;
+			var = linitial(op->args);
+			arg = lsecond(op->args);
+			opcode = op->opno;
+			if (!IsA(var, Var))
+			{
+				/* ARG <OPER> VAR form */
+				var = lsecond(op->args);
+				arg = linitial(op->args);
+				opcode = get_commutator(op->opno);
+			}
+		}
+		else if (IsA(clause, ScalarArrayOpExpr))
+		{
+			ScalarArrayOpExpr *saop = (ScalarArrayOpExpr *) clause;
+
+			if (!saop->useOr || list_length(saop->args) != 2)
+				return -1;
+			var = linitial(saop->args);
+			arg = lsecond(saop->args);
+			opcode = saop->opno;
+		}
+		else
+			return -1;
+
+		if (!IsA(var, Var) ||
+			var->varno != scanrelid ||
+			var->varattno <= 0 ||
+			var->varlevelsup != 0 ||
+			!OidIsValid(opcode))
+			return -1;
+		collen = gpuscan_simple_typlen(var->vartype, &var_is_integer);
+		if (collen == 0)
+			return -1;
+		squal->colidx = var->varattno - 1;
+		squal->collen = collen;
+		squal->pindex = -1;
+		squal->is_float2 = (var->vartype == FLOAT2OID);
+
+		if (IsA(clause, ScalarArrayOpExpr))
+		{
+			Const	   *con = (Const *) arg;
+			ArrayType  *array;
+			Oid			elemtype;
+			int16		elemlen;
+			bool		elembyval;
+			char		elemalign;
+			Datum	   *elem_values;
+			bool	   *elem_isnull;
+			int			i, nelems;
+
+			if (!IsA(con, Const) || con->constisnull)
+				return -1;
+			array = DatumGetArrayTypeP(con->constvalue);
+			elemtype = ARR_ELEMTYPE(array);
+			arglen = gpuscan_simple_typlen(elemtype, &arg_is_integer);
+			if (arglen == 0 ||
+				(elemtype != var->vartype &&
+				 (!var_is_integer || !arg_is_integer)) ||
+				gpuscan_simple_strategy(opcode, var->vartype,
+										elemtype) != BTEqualStrategyNumber)
+				return -1;
+			get_typlenbyvalalign(elemtype, &elemlen, &elembyval, &elemalign);
+			deconstruct_array(array, elemtype, elemlen, elembyval, elemalign,
+							  &elem_values, &elem_isnull, &nelems);
+			squal->opcode = GPUSCAN_SIMPLE_OP__IN;
+			squal->item_index = nitems;
+			for (i=0; i < nelems; i++)
+			{
+				/* NULL element never makes the qualifier true */
+				if (elem_isnull[i])
+					continue;
+				if (nitems >= GPUSCAN_SIMPLE_MAX_ITEMS)
+					return -1;
+				items[nitems] = gpuscan_simple_item_value(elem_values[i],
+														  arglen);
+				if (squal->is_float2)
+					items[nitems] = gpuscan_simple_float2_key(items[nitems]);
+				nitems++;
+			}
+			squal->nitems = nitems - squal->item_index;
+			qsort(items + squal->item_index,
+				  squal->nitems,
+				  sizeof(cl_long),
+				  gpuscan_simple_item_comp);
+			continue;
+		}
+
+		/* VAR <OPER> ARG form */
+		arglen = gpuscan_simple_typlen(exprType(arg), &arg_is_integer);
+		if (arglen == 0 ||
+			(exprType(arg) != var->vartype &&
+			 (!var_is_integer || !arg_is_integer)))
+			return -1;
+		strategy = gpuscan_simple_strategy(opcode, var->vartype,
+										   exprType(arg));
+		switch (strategy)
+		{
+			case BTLessStrategyNumber:
+				squal->opcode = GPUSCAN_SIMPLE_OP__LT;
+				break;
+			case BTLessEqualStrategyNumber:
+				squal->opcode = GPUSCAN_SIMPLE_OP__LE;
+				break;
+			case BTEqualStrategyNumber:
+				squal->opcode = GPUSCAN_SIMPLE_OP__EQ;
+				break;
+			case BTGreaterEqualStrategyNumber:
+				squal->opcode = GPUSCAN_SIMPLE_OP__GE;
+				break;
+			case BTGreaterStrategyNumber:
+				squal->opcode = GPUSCAN_SIMPLE_OP__GT;
+				break;
+			default:
+				/* '<>' operator is not a member of B-tree */
+				opcode = get_negator(opcode);
+				if (!OidIsValid(opcode) ||
+					gpuscan_simple_strategy(opcode, var->vartype,
+											exprType(arg)) != BTEqualStrategyNumber)
+					return -1;
+				squal->opcode = GPUSCAN_SIMPLE_OP__NE;
+				break;
+		}
+
+		if (IsA(arg, Const))
+		{
+			Const	   *con = (Const *) arg;
+
+			if (con->constisnull ||
+				nitems >= GPUSCAN_SIMPLE_MAX_ITEMS)
+				return -1;
+			squal->item_index = nitems;
+			squal->nitems = 1;
+			items[nitems] = gpuscan_simple_item_value(con->constvalue,
+													  arglen);
+			if (squal->is_float2)
+				items[nitems] = gpuscan_simple_float2_key(items[nitems]);
+			nitems++;
+		}
+		else if (IsA(arg, Param) &&
+				 ((Param *) arg)->paramkind == PARAM_EXTERN)
+		{
+			ListCell   *cell;
+			int			pindex = 0;
+
+			foreach (cell, used_params)
+			{
+				if (equal(arg, lfirst(cell)))
+					break;
+				pindex++;
+			}
+			if (!cell)
+				used_params = lappend(used_params, copyObject(arg));
+			if (pindex > SHRT_MAX)
+				return -1;
+			squal->pindex = pindex;
+			squal->paramlen = arglen;
+		}
+		else
+			return -1;
+	}
+
+	/*
+	 * Device projection must be simple column references; equivalent to
+	 * the whole row of the relation, if no device projection.
+	 */
+	if (tlist_dev == NIL)
+	{
+		int		j, natts = RelationGetNumberOfAttributes(relation);
+
+		if (natts > GPUSCAN_SIMPLE_MAX_PROJS)
+			return -1;
+		for (j=0; j < natts; j++)
+			sdesc->projs[j] = j;
+		sdesc->nprojs = natts;
+	}
+	else
+	{
+		if (list_length(tlist_dev) > GPUSCAN_SIMPLE_MAX_PROJS)
+			return -1;
+		foreach (lc, tlist_dev)
+		{
+			TargetEntry *tle = lfirst(lc);
+			Var		   *var = (Var *) tle->expr;
+
+			Assert(tle->resno > 0 && tle->resno <= list_length(tlist_dev));
+			if (IsA(var, Var) &&
+				var->varno == scanrelid &&
+				var->varattno > 0 &&
+				var->varlevelsup == 0)
+				sdesc->projs[tle->resno - 1] = var->varattno - 1;
+			else if (tle->resjunk)
+				sdesc->projs[tle->resno - 1] = -1;		/* always NULL */
+			else
+				return -1;
+		}
+		sdesc->nprojs = list_length(tlist_dev);
+	}
+
+	/* OK, construct the descriptor as a bytea constant */
+	length = offsetof(gpuscanSimpleDesc, items[nitems]);
+	sdesc = repalloc(sdesc, length);
+	memcpy(sdesc->items, items, sizeof(cl_long) * nitems);
+	SET_VARSIZE(sdesc, length);
+
+	used_params = lappend(used_params,
+						  makeConst(BYTEAOID,
+									-1,
+									InvalidOid,
+									-1,
+									PointerGetDatum(sdesc),
+									false,
+									false));
+	*p_used_params = used_params;
+
+	return list_length(used_params) - 1;
+}
+
+/*
+ * build_gpuscan_zonemap_conds
+ *
+ * It picks up the 'VAR <OPER> CONST' form device qualifiers on the
+ * integer-like columns, to be checked towards the zone-map of the heap
+ * table. Each element is a triple of attnum, B-tree strategy and the key
+ * in int8 Const. Up to GPUSCAN_ZONEMAP_MAX_COLS columns are used.
+ */
+static List *
+build_gpuscan_zonemap_conds(Index scanrelid,
+							Relation relation,
+							List *dev_quals)
+{
+	List	   *zmap_conds = NIL;
+	Bitmapset  *zmap_attrs = NULL;
+	ListCell   *lc;
+
+	if (!pgstrom_enable_zonemap ||
+		relation->rd_rel->relkind != RELKIND_RELATION ||
+		!RelationNeedsWAL(relation))
+		return NIL;
+
+	foreach (lc, dev_quals)
+	{
+		OpExpr	   *op = lfirst(lc);
+		Var		   *var;
+		Const	   *con;
+		Oid			opcode;
+		int			strategy;
+		int			collen;
+		int			conlen;
+		bool		var_is_integer;
+		bool		con_is_integer;
+
+		if (!IsA(op, OpExpr) || list_length(op->args) != 2)
+			continue;
+		var = linitial(op->args);
+		con = lsecond(op->args);
+		opcode = op->opno;
+		if (!IsA(var, Var))
+		{
+			/* CONST <OPER> VAR form */
+			var = lsecond(op->args);
+			con = linitial(op->args);
+			opcode = get_commutator(op->opno);
+		}
+		if (!IsA(var, Var) ||
+			var->varno != scanrelid ||
+			var->varattno <= 0 ||
+			var->varlevelsup != 0 ||
+			var->vartype == FLOAT2OID ||
+			!IsA(con, Const) ||
+			con->constisnull ||
+			!OidIsValid(opcode))
+			continue;
+		collen = gpuscan_simple_typlen(var->vartype, &var_is_integer);
+		conlen = gpuscan_simple_typlen(con->consttype, &con_is_integer);
+		if (collen == 0 || conlen == 0 ||
+			(con->consttype != var->vartype &&
+			 (!var_is_integer || !con_is_integer)))
+			continue;
+		strategy = gpuscan_simple_strategy(opcode, var->vartype,
+										   con->consttype);
+		if (strategy < BTLessStrategyNumber ||
+			strategy > BTGreaterStrategyNumber)
+			continue;
+		if (!bms_is_member(var->varattno, zmap_attrs))
+		{
+			if (bms_num_members(zmap_attrs) >= GPUSCAN_ZONEMAP_MAX_COLS)
+				continue;
+			zmap_attrs = bms_add_member(zmap_attrs, var->varattno);
+		}
+		zmap_conds = lappend(zmap_conds,
+							 list_make3(makeInteger(var->varattno),
+										makeInteger(strategy),
+										makeConst(INT8OID,
+												  -1,
+												  InvalidOid,
+												  sizeof(int64),
+												  Int64GetDatum(gpuscan_simple_item_value(con->constvalue, conlen)),
+												  false,
+												  FLOAT8PASSBYVAL)));
+	}
+	bms_free(zmap_attrs);
+
+	return zmap_conds;
+}
+
 /*
  * PlanGpuScanPath - construction of a new GpuScan plan node
  */
@@ -1312,6 +2211,7 @@ PlanGpuScanPath(PlannerInfo *root,
 	List		   *tlist_dev = NIL;
 	List		   *outer_refs = NIL;
 	ListCell	   *cell;
+	ListCell	   *lc;
 	Bitmapset	   *varattnos = NULL;
 	cl_int			qual_extra_sz = 0;
 	cl_int			i, j;
@@ -1350,9 +2250,42 @@ PlanGpuScanPath(PlannerInfo *root,
 	}
 	/* Reduce RestrictInfo list to bare expressions; ignore pseudoconstants */
 	host_quals = extract_actual_clauses(host_quals, false);
-	dev_quals = reorder_devqual_clauses(root, dev_quals, dev_costs);
+	dev_quals = reorder_devqual_clauses(root, dev_quals, &dev_costs);
+	/*
+	 * Device quals may be reordered at run-time according to the observed
+	 * selectivity, if number of the quals is reasonable.
+	 */
+	if (enable_gpuscan_adaptive_quals)
+	{
+		List	   *qual_costs = NIL;
+
+		forboth (cell, dev_quals,
+				 lc, dev_costs)
+		{
+			RestrictInfo *rinfo = lfirst(cell);
+
+			if (!rinfo->pseudoconstant)
+				qual_costs = lappend_int(qual_costs, lfirst_int(lc));
+		}
+		if (list_length(qual_costs) > 1 &&
+			list_length(qual_costs) <= GPUSCAN_MAX_ADAPTIVE_QUALS)
+			gs_info->dev_qual_costs = qual_costs;
+	}
 	dev_quals = extract_actual_clauses(dev_quals, false);
 	index_quals = extract_actual_clauses(gs_info->index_quals, false);
+	/* jsonb key references to the shredded columns, if any */
+	host_quals = pgstrom_rewrite_shredded_jsonb(root, baserel, host_quals);
+	dev_quals = pgstrom_rewrite_shredded_jsonb(root, baserel, dev_quals);
+	/* equality lookup on the hash index of GPU cache, if any */
+	gs_info->gcache_index_attnum = baseRelGpuCacheIndexAttnum(root, baserel);
+	if (gs_info->gcache_index_attnum != InvalidAttrNumber)
+	{
+		gs_info->gcache_index_key =
+			gpuscan_gcache_index_key(dev_quals, baserel->relid,
+									 gs_info->gcache_index_attnum);
+		if (!gs_info->gcache_index_key)
+			gs_info->gcache_index_attnum = InvalidAttrNumber;
+	}
 
 	/*
 	 * Code construction for the CUDA kernel code
@@ -1362,8 +2295,9 @@ PlanGpuScanPath(PlannerInfo *root,
 
 	initStringInfo(&kern);
 	pgstrom_init_codegen_context(&context, root, baserel);
-	codegen_gpuscan_quals(&kern, &context, "gpuscan",
-						  baserel->relid, dev_quals);
+	__codegen_gpuscan_quals(&kern, &context, "gpuscan",
+							baserel->relid, dev_quals,
+							gs_info->dev_qual_costs != NIL, NIL);
 	qual_extra_sz = context.extra_bufsz;
 	context.extra_bufsz = 0;
 	tlist_dev = build_gpuscan_projection(root,
@@ -1379,20 +2313,98 @@ PlanGpuScanPath(PlannerInfo *root,
 					   baserel->relid, &varattnos);
 	pull_varattnos((Node *)host_quals, baserel->relid, &varattnos);
 
-	codegen_gpuscan_projection(&kern,
-							   &context,
-							   baserel,
-							   relation,
-							   tlist_dev,
-							   varattnos);
-	table_close(relation, NoLock);
-	/* merge declaration */
-	if (context.decl.len > 0)
-		appendStringInfoChar(&context.decl, '\n');
-	appendStringInfoString(&context.decl, kern.data);
+	/*
+	 * LIMIT hint allows GPU kernel to terminate the scan when enough rows
+	 * are already qualified, and ORDER BY with LIMIT allows GPU kernel to
+	 * pick up the top-N rows of the chunk prior to write back; Sort node
+	 * on the host side makes the final merge. Both are valid only if no
+	 * host quals.
+	 */
+	if (host_quals == NIL)
+	{
+		cl_uint		nrows_limit = gpuscan_limit_hint(root, baserel);
+
+		if (nrows_limit == 0)
+			;
+		else if (root->parse->sortClause == NIL)
+			gs_info->nrows_limit = nrows_limit;
+		else if (enable_gpuscan_topn &&
+				 nrows_limit <= GPUSCAN_TOPN_MAX_NROWS &&
+				 gpuscan_build_topn_keys(root, baserel, tlist_dev, gs_info))
+			gs_info->topn_nrows = nrows_limit;
+	}
 
-	/* save the outer_refs for columnar optimization */
-	pull_varattnos((Node *)dev_quals, baserel->relid, &varattnos);
+	/*
+	 * Late materialization makes sense only if projection references
+	 * columns that are not referenced by the device qualifiers, because
+	 * the 1st phase kernel deforms the columns of qualifiers only, then
+	 * the 2nd phase kernel deforms the remaining columns of the tuples
+	 * which survived.
+	 * Only heap tables (KDS_FORMAT_BLOCK) can perform this mode.
+	 */
+	if (enable_gpuscan_late_materialization &&
+		dev_quals != NIL &&
+		rte->relkind != RELKIND_FOREIGN_TABLE)
+	{
+		Bitmapset  *qual_varattnos = NULL;
+
+		pull_varattnos((Node *)dev_quals, baserel->relid, &qual_varattnos);
+		if (!bms_is_subset(varattnos, qual_varattnos))
+			gs_info->late_materialization = true;
+		bms_free(qual_varattnos);
+	}
+
+	/*
+	 * If device projection is a simple reference to the columns of the base
+	 * relation, GPU kernel does not need to copy the tuples survived; it
+	 * writes back the position of the rows on the source chunk instead,
+	 * then host side fetches the tuples from the source buffer directly.
+	 * Not applicable to foreign-tables (Arrow_Fdw) because its chunk is
+	 * not a set of heap tuples.
+	 */
+	if (enable_gpuscan_selection_vector &&
+		gs_info->topn_nrows == 0 &&
+		rte->relkind != RELKIND_FOREIGN_TABLE)
+	{
+		gs_info->selection_vector = true;
+		foreach (cell, tlist_dev)
+		{
+			TargetEntry *tle = lfirst(cell);
+
+			if (!IsA(tle->expr, Var))
+			{
+				gs_info->selection_vector = false;
+				break;
+			}
+		}
+		if (gs_info->selection_vector)
+			gs_info->late_materialization = false;
+	}
+
+	codegen_gpuscan_projection(&kern,
+							   &context,
+							   baserel,
+							   relation,
+							   tlist_dev,
+							   varattnos);
+	/* precompiled kernel instead of the run-time compilation, if simple */
+	gs_info->simple_pindex = build_gpuscan_simple_desc(baserel->relid,
+													   relation,
+													   dev_quals,
+													   tlist_dev,
+													   &context.used_params);
+	/* zone-map of the heap table, if qualifiers are simple enough */
+	gs_info->zmap_conds = build_gpuscan_zonemap_conds(baserel->relid,
+													  relation,
+													  dev_quals);
+	table_close(relation, NoLock);
+	/* merge declaration */
+	if (context.decl.len > 0)
+		appendStringInfoChar(&context.decl, '\n');
+	appendStringInfoString(&context.decl, kern.data);
+
+	/* save the outer_refs for columnar optimization */
+	pull_varattnos((Node *)dev_quals, baserel->relid, &varattnos);
 	for (i = bms_next_member(varattnos, -1);
 		 i >= 0;
 		 i = bms_next_member(varattnos, i))
@@ -1418,6 +2430,10 @@ PlanGpuScanPath(PlannerInfo *root,
 	gs_info->kern_source = context.decl.data;
 	gs_info->extra_flags = context.extra_flags | DEVKERNEL_NEEDS_GPUSCAN;
 	gs_info->extra_bufsz = Max(qual_extra_sz, context.extra_bufsz);
+	/* bloom-filter may be added by the parent GpuJoin later */
+	gs_info->bloom_source = codegen_gpuscan_bloom_quals(root, baserel, NIL,
+														&gs_info->extra_flags,
+														&gs_info->extra_bufsz);
 	gs_info->outer_refs = outer_refs;
 	gs_info->used_params = context.used_params;
 	gs_info->dev_quals = dev_quals;
@@ -1427,6 +2443,62 @@ PlanGpuScanPath(PlannerInfo *root,
 	return &cscan->scan.plan;
 }
 
+/*
+ * pgstrom_gpuscan_add_bloom_filter
+ *
+ * It tries to add a bloom-filter on the GpuScan plan, built from the inner
+ * hash table of the parent GpuJoin. The GpuScan kernel can drop the rows
+ * which never match with any inner rows prior to write back, to reduce
+ * DMA transfer and GpuJoin's workload. The join keys must be simple
+ * references to the columns of the scan relation.
+ */
+bool
+pgstrom_gpuscan_add_bloom_filter(PlannerInfo *root,
+								 Plan *plan,
+								 List *hash_keys)
+{
+	CustomScan	   *cscan = (CustomScan *) plan;
+	GpuScanInfo	   *gs_info;
+	RelOptInfo	   *baserel;
+	Index			scanrelid;
+	ListCell	   *lc;
+
+	if (!enable_gpuscan_bloom_filter || !pgstrom_plan_is_gpuscan(plan))
+		return false;
+	if (hash_keys == NIL || list_length(hash_keys) > GPUSCAN_BLOOM_MAX_KEYS)
+		return false;
+	scanrelid = cscan->scan.scanrelid;
+	foreach (lc, hash_keys)
+	{
+		Var	   *var = lfirst(lc);
+
+		if (!IsA(var, Var) ||
+			var->varno != scanrelid ||
+			var->varattno <= 0 ||
+			var->varlevelsup > 0 ||
+			!pgstrom_devtype_lookup(var->vartype))
+			return false;
+		/* bloom keys must be a part of the device projection */
+		if (cscan->custom_scan_tlist != NIL &&
+			!tlist_member((Expr *) var, cscan->custom_scan_tlist))
+			return false;
+	}
+	gs_info = deform_gpuscan_info(cscan);
+	if (gs_info->bloom_keys != NIL)
+		return false;		/* already added */
+	baserel = root->simple_rel_array[scanrelid];
+	gs_info->bloom_source = codegen_gpuscan_bloom_quals(root, baserel,
+														hash_keys,
+														&gs_info->extra_flags,
+														&gs_info->extra_bufsz);
+	gs_info->bloom_keys = copyObject(hash_keys);
+	/* precompiled kernel has no bloom-filter support */
+	gs_info->simple_pindex = -1;
+	form_gpuscan_info(cscan, gs_info);
+
+	return true;
+}
+
 /*
  * pgstrom_pullup_outer_scan - pull up outer_path if it is a simple relation
  * scan with device executable qualifiers.
@@ -1491,7 +2563,7 @@ pgstrom_pullup_outer_scan(PlannerInfo *root,
 		outer_quals = lappend(outer_quals, rinfo);
 		outer_costs = lappend_int(outer_costs, devcost);
 	}
-	outer_quals = reorder_devqual_clauses(root, outer_quals, outer_costs);
+	outer_quals = reorder_devqual_clauses(root, outer_quals, &outer_costs);
 	outer_quals = extract_actual_clauses(outer_quals, false);
 
 	/* target entry has to be */
@@ -1589,11 +2661,9 @@ pgstrom_copy_gpuscan_path(const Path *pathnode)
 /*
  * assign_gpuscan_session_info
  */
-void
-assign_gpuscan_session_info(StringInfo buf, GpuTaskState *gts)
+static void
+__assign_gpuscan_session_info(StringInfo buf, CustomScan *cscan)
 {
-	CustomScan *cscan = (CustomScan *)gts->css.ss.ps.plan;
-
 	appendStringInfo(
 		buf,
 		"/* GpuScan session info */\n"
@@ -1601,6 +2671,95 @@ assign_gpuscan_session_info(StringInfo buf, GpuTaskState *gts)
 		cscan->custom_scan_tlist != NIL ? 1 : 0);
 }
 
+void
+assign_gpuscan_session_info(StringInfo buf, GpuTaskState *gts)
+{
+	__assign_gpuscan_session_info(buf, (CustomScan *)gts->css.ss.ps.plan);
+}
+
+/*
+ * pgstrom_prebuild_gpuscan_program
+ *
+ * It kicks build of the GPU program on the final GpuScan plan; that is
+ * equivalent to the one ExecInitGpuScan() will create.
+ */
+void
+pgstrom_prebuild_gpuscan_program(CustomScan *cscan)
+{
+	GpuScanInfo	   *gs_info = deform_gpuscan_info(cscan);
+	StringInfoData	kern_define;
+	char		   *kern_source;
+
+	/* precompiled kernel needs no build */
+	if (gs_info->simple_pindex >= 0)
+		return;
+	initStringInfo(&kern_define);
+	pgstrom_build_common_session_info(&kern_define, gs_info->extra_flags);
+	__assign_gpuscan_session_info(&kern_define, cscan);
+	kern_source = psprintf("%s\n%s",
+						   gs_info->kern_source,
+						   gs_info->bloom_source);
+	pgstrom_prebuild_cuda_program(gs_info->optimal_gpu,
+								  gs_info->extra_flags,
+								  gs_info->extra_bufsz,
+								  kern_source,
+								  kern_define.data);
+	pfree(kern_define.data);
+	pfree(kern_source);
+}
+
+/*
+ * pgstrom_assign_gpuscan_fanout
+ *
+ * It marks GpuScan children of the Append to fan-out across GPUs, if they
+ * are bound to two or more different GPUs (usually, partition leaves on
+ * the tablespaces close to the individual GPUs). Parallel Append already
+ * distributes the children to the workers, so it is not a target. Append
+ * with run-time partition pruning is also skipped, because pruned children
+ * shall not be executed.
+ */
+void
+pgstrom_assign_gpuscan_fanout(Append *aplan)
+{
+	List	   *candidates = NIL;
+	Bitmapset  *devices = NULL;
+	ListCell   *lc;
+
+	if (!enable_append_gpu_fanout || aplan->plan.parallel_aware)
+		return;
+	/* run-time pruned children may not be executed at all */
+	if (aplan->part_prune_info != NULL)
+		return;
+	foreach (lc, aplan->appendplans)
+	{
+		Plan	   *plan = lfirst(lc);
+		GpuScanInfo *gs_info;
+
+		if (!pgstrom_plan_is_gpuscan(plan) || plan->parallel_aware)
+			continue;
+		gs_info = deform_gpuscan_info((CustomScan *) plan);
+		/* LIMIT hint prefers the sequential consumption */
+		if (gs_info->optimal_gpu < 0 || gs_info->nrows_limit > 0)
+			continue;
+		devices = bms_add_member(devices, gs_info->optimal_gpu);
+		candidates = lappend(candidates, plan);
+	}
+
+	if (bms_num_members(devices) > 1)
+	{
+		foreach (lc, candidates)
+		{
+			CustomScan *cscan = lfirst(lc);
+			GpuScanInfo *gs_info = deform_gpuscan_info(cscan);
+
+			gs_info->append_fanout = true;
+			form_gpuscan_info(cscan, gs_info);
+		}
+	}
+	bms_free(devices);
+	list_free(candidates);
+}
+
 /*
  * gpuscan_create_scan_state - allocation of GpuScanState
  */
@@ -1632,12 +2791,17 @@ ExecInitGpuScan(CustomScanState *node, EState *estate, int eflags)
 	GpuScanInfo	   *gs_info = deform_gpuscan_info(cscan);
 	GpuContext	   *gcontext;
 	TupleDesc		scan_tupdesc;
+	TupleDesc		scan_desc;
+	const TupleTableSlotOps *scan_ops;
+	const TupleTableSlotOps *base_ops;
 	bool			explain_only = ((eflags & EXEC_FLAG_EXPLAIN_ONLY) != 0);
 	List		   *dev_tlist = NIL;
 	List		   *dev_quals_raw;
 	ListCell	   *lc;
+	ListCell	   *lc1, *lc2, *lc3, *lc4;
 	StringInfoData	kern_define;
 	ProgramId		program_id;
+	char		   *kern_source;
 
 	/* gpuscan should not have inner/outer plan right now */
 	Assert(scan_rel != NULL);
@@ -1675,12 +2839,45 @@ ExecInitGpuScan(CustomScanState *node, EState *estate, int eflags)
 	gss->gts.cb_switch_task = gpuscan_switch_task;
 	gss->gts.cb_process_task = gpuscan_process_task;
 	gss->gts.cb_release_task = gpuscan_release_task;
+	gss->gts.cb_cpu_hybrid_task = gpuscan_cpu_hybrid_task;
 
 	/* initialize device qualifiers/projection stuff, for CPU fallback */
 	dev_quals_raw = (List *)
 		fixup_varnode_to_origin((Node *)gs_info->dev_quals,
 								cscan->custom_scan_tlist);
-	gss->dev_quals = ExecInitQual(dev_quals_raw, &gss->gts.css.ss.ps);
+	gss->late_materialization = gs_info->late_materialization;
+	gss->selection_vector = gs_info->selection_vector;
+	gss->cuda_graph = enable_gpuscan_cuda_graph;
+	gss->bloom_filter = (gs_info->bloom_keys != NIL);
+	gss->m_bloom_bitmap = 0UL;
+	gss->bloom_nbits = 0;
+	gss->gcache_index_attnum = gs_info->gcache_index_attnum;
+	gss->simple_pindex = gs_info->simple_pindex;
+	if (gs_info->gcache_index_key)
+		gss->gcache_index_key = ExecInitExpr(gs_info->gcache_index_key,
+											 &gss->gts.css.ss.ps);
+	gss->nquals = 0;
+	foreach (lc, gs_info->dev_qual_costs)
+	{
+		Assert(gss->nquals < GPUSCAN_MAX_ADAPTIVE_QUALS);
+		gss->qual_costs[gss->nquals++] = lfirst_int(lc);
+	}
+	gss->nrows_limit = gs_info->nrows_limit;
+	gss->topn_nrows = gs_info->topn_nrows;
+	gss->topn_nkeys = 0;
+	forfour (lc1, gs_info->topn_colidx,
+			 lc2, gs_info->topn_kind,
+			 lc3, gs_info->topn_desc,
+			 lc4, gs_info->topn_nulls_first)
+	{
+		gpuscanTopNKey *tkey = &gss->topn_keys[gss->topn_nkeys++];
+
+		Assert(gss->topn_nkeys <= GPUSCAN_TOPN_MAX_KEYS);
+		tkey->colidx = lfirst_int(lc1);
+		tkey->kind = lfirst_int(lc2);
+		tkey->descending = lfirst_int(lc3);
+		tkey->nulls_first = lfirst_int(lc4);
+	}
 	foreach (lc, cscan->custom_scan_tlist)
 	{
 		TargetEntry	   *tle = lfirst(lc);
@@ -1689,34 +2886,81 @@ ExecInitGpuScan(CustomScanState *node, EState *estate, int eflags)
 			break;
 		dev_tlist = lappend(dev_tlist, tle);
 	}
-	/* initialize resource for CPU fallback */
+	/*
+	 * initialize resource for CPU fallback and selection-vector mode
+	 *
+	 * The base_slot always keeps heap tuples of the relation unless it is
+	 * Arrow_Fdw or GPU Cache, so dev_quals and base_proj are built with
+	 * the descriptor and heap-tuple ops of the base_slot, not of the scan
+	 * slot. It allows to deform the attributes on demand, using the deform
+	 * code specialized to the relation by LLVM, if JIT is enabled.
+	 */
+	base_ops = (!gss->gts.af_state &&
+				!gss->gts.gc_state ? &TTSOpsHeapTuple : &TTSOpsVirtual);
 	gss->base_slot = MakeSingleTupleTableSlot(RelationGetDescr(scan_rel),
-											  &TTSOpsVirtual);
+											  base_ops);
+	scan_desc = gss->gts.css.ss.ps.scandesc;
+	scan_ops = gss->gts.css.ss.ps.scanops;
+	gss->gts.css.ss.ps.scandesc = RelationGetDescr(scan_rel);
+	gss->gts.css.ss.ps.scanops = base_ops;
+
+	gss->dev_quals = ExecInitQual(dev_quals_raw, &gss->gts.css.ss.ps);
 	gss->base_proj = ExecBuildProjectionInfo(dev_tlist,
 											 gss->gts.css.ss.ps.ps_ExprContext,
 											 gss->gts.css.ss.ss_ScanTupleSlot,
 											 &gss->gts.css.ss.ps,
 											 RelationGetDescr(scan_rel));
+	gss->gts.css.ss.ps.scandesc = scan_desc;
+	gss->gts.css.ss.ps.scanops = scan_ops;
 	/* init BRIN-index support, if any */
 	pgstromExecInitBrinIndexMap(&gss->gts,
 								gs_info->index_oid,
 								gs_info->index_conds,
 								gs_info->index_quals);
+	/* init zone-map support, if any */
+	pgstromExecInitZoneMap(&gss->gts, gs_info->zmap_conds);
+	/* fan-out across GPUs under the Append, if any */
+	if (gs_info->append_fanout && !explain_only)
+	{
+		gss->gts.cb_fanout_begin = gpuscan_fanout_begin;
+		pgstromRegisterGpuTaskFanout(&gss->gts);
+	}
 
 	/* Get CUDA program and async build if any */
+	if (gss->simple_pindex >= 0)
+	{
+		/*
+		 * Precompiled kernel needs neither source nor session info; it
+		 * is linked with the libraries equivalent to the generated code.
+		 */
+		program_id = pgstrom_create_cuda_program(gcontext,
+												 gs_info->extra_flags |
+												 DEVKERNEL_GPUSCAN_SIMPLE,
+												 GPUSCAN_SIMPLE_VARLENA_BUFSZ,
+												 "",
+												 "",
+												 false,
+												 explain_only);
+		gss->gts.program_id = program_id;
+		return;
+	}
 	initStringInfo(&kern_define);
 	pgstrom_build_session_info(&kern_define,
 							   &gss->gts,
 							   gs_info->extra_flags);
+	kern_source = psprintf("%s\n%s",
+						   gs_info->kern_source,
+						   gs_info->bloom_source);
 	program_id = pgstrom_create_cuda_program(gcontext,
 											 gs_info->extra_flags,
 											 gs_info->extra_bufsz,
-											 gs_info->kern_source,
+											 kern_source,
 											 kern_define.data,
 											 false,
 											 explain_only);
 	gss->gts.program_id = program_id;
 	pfree(kern_define.data);
+	pfree(kern_source);
 }
 
 /*
@@ -1777,6 +3021,47 @@ ExecGpuScan(CustomScanState *node)
 					(ExecScanRecheckMtd) ExecReCheckGpuScan);
 }
 
+/*
+ * GpuScanExecResultChunk
+ *
+ * It returns the next GpuScanTask for the consumer that reads the results
+ * chunk-by-chunk (like GpuSort), instead of ExecGpuScan. *p_pds_dst is the
+ * result buffer of the task, or NULL if the task has no buffer to be read
+ * as is (CPU fallback or selection-vector mode); its tuples shall be
+ * fetched by cb_next_tuple then.
+ */
+GpuTask *
+GpuScanExecResultChunk(GpuTaskState *gts, pgstrom_data_store **p_pds_dst)
+{
+	GpuScanState   *gss = (GpuScanState *) gts;
+	GpuScanTask	   *gscan;
+
+	ActivateGpuContext(gss->gts.gcontext);
+	if (!gss->gs_sstate)
+		createGpuScanSharedState(gss, NULL, NULL);
+	gscan = (GpuScanTask *) pgstromFetchGpuTask(&gss->gts);
+	if (!gscan)
+		return NULL;
+	*p_pds_dst = (!gscan->task.cpu_fallback ? gscan->pds_dst : NULL);
+	return &gscan->task;
+}
+
+/*
+ * gpuscan_fanout_begin
+ *
+ * Setup of GpuScanState prior to the first ExecGpuScan, when a sibling
+ * under the Append submits the first chunk on behalf of us.
+ */
+static void
+gpuscan_fanout_begin(GpuTaskState *gts)
+{
+	GpuScanState   *gss = (GpuScanState *) gts;
+
+	ActivateGpuContext(gss->gts.gcontext);
+	if (!gss->gs_sstate)
+		createGpuScanSharedState(gss, NULL, NULL);
+}
+
 /*
  * ExecEndGpuScan
  */
@@ -1790,12 +3075,90 @@ ExecEndGpuScan(CustomScanState *node)
 	SynchronizeGpuContext(gss->gts.gcontext);
 	/* close index related stuff if any */
 	pgstromExecEndBrinIndexMap(&gss->gts);
+	pgstromExecEndZoneMap(&gss->gts);
+	/* release the bloom-filter, if any */
+	if (gss->m_bloom_bitmap)
+		gpuMemFree(gss->gts.gcontext, gss->m_bloom_bitmap);
 	/* reset fallback resources */
 	if (gss->base_slot)
 		ExecDropSingleTupleTableSlot(gss->base_slot);
 	pgstromReleaseGpuTaskState(&gss->gts, gt_rtstat);
 }
 
+/*
+ * pgstromGpuScanSetupBloomFilter
+ *
+ * It builds the bloom-filter of the GpuScan from the hash values of the
+ * inner hash table, once the parent GpuJoin preloaded the inner buffer.
+ * Hash values are already computed by the same manner as the device side,
+ * so we don't need to touch the tuples. If inner hash table is too large,
+ * the bloom-filter is skipped because of too much false positive rate.
+ */
+#define GPUSCAN_BLOOM_BITS_PER_ITEM		10
+#define GPUSCAN_BLOOM_MIN_NBITS			(1U << 12)
+#define GPUSCAN_BLOOM_MAX_NBITS			(1U << 28)
+
+void
+pgstromGpuScanSetupBloomFilter(PlanState *ps, kern_data_store *kds_hash)
+{
+	GpuScanState   *gss = (GpuScanState *) ps;
+	GpuContext	   *gcontext = gss->gts.gcontext;
+	CUdeviceptr		m_bitmap;
+	cl_uint		   *bitmap;
+	size_t			nbits;
+	size_t			length;
+	cl_uint			i, k;
+	CUresult		rc;
+
+	Assert(pgstrom_planstate_is_gpuscan(ps));
+	if (!gss->bloom_filter)
+		return;
+	/* release the bloom-filter of the previous scan, if any */
+	if (gss->m_bloom_bitmap)
+	{
+		rc = gpuMemFree(gcontext, gss->m_bloom_bitmap);
+		if (rc != CUDA_SUCCESS)
+			elog(WARNING, "failed on gpuMemFree: %s", errorText(rc));
+		gss->m_bloom_bitmap = 0UL;
+		gss->bloom_nbits = 0;
+	}
+	if (kds_hash->format != KDS_FORMAT_HASH)
+		return;
+	nbits = (size_t)kds_hash->nitems * GPUSCAN_BLOOM_BITS_PER_ITEM;
+	nbits = Max(nbits, GPUSCAN_BLOOM_MIN_NBITS);
+	if (nbits > GPUSCAN_BLOOM_MAX_NBITS)
+		return;
+	nbits = (1UL << get_next_log2(nbits));
+	length = nbits / BITS_PER_BYTE;
+
+	rc = gpuMemAllocManaged(gcontext,
+							&m_bitmap,
+							length,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	bitmap = (cl_uint *) m_bitmap;
+	memset(bitmap, 0, length);
+	for (i=0; i < kds_hash->nitems; i++)
+	{
+		kern_tupitem   *tupitem = KERN_DATA_STORE_TUPITEM(kds_hash, i);
+		kern_hashitem  *khitem;
+		cl_uint			pos;
+
+		if (!tupitem)
+			continue;
+		khitem = (kern_hashitem *)
+			((char *)tupitem - offsetof(kern_hashitem, t));
+		for (k=0; k < GPUSCAN_BLOOM_NHASHES; k++)
+		{
+			pos = GPUSCAN_BLOOM_BITPOS(khitem->hash, k, nbits);
+			bitmap[pos >> 5] |= (1U << (pos & 31));
+		}
+	}
+	gss->m_bloom_bitmap = m_bitmap;
+	gss->bloom_nbits = nbits;
+}
+
 /*
  * ExecReScanGpuScan
  */
@@ -1808,6 +3171,8 @@ ExecReScanGpuScan(CustomScanState *node)
 	SynchronizeGpuContext(gss->gts.gcontext);
 	/* reset shared state */
 	resetGpuScanSharedState(gss);
+	/* reset the LIMIT hint */
+	gss->nrows_limit_base = gpuscan_nrows_returned(gss);
 	/* common rescan handling */
 	pgstromRescanGpuTaskState(&gss->gts);
 }
@@ -1977,6 +3342,73 @@ ExplainGpuScan(CustomScanState *node, List *ancestors, ExplainState *es)
 			ExplainPropertyInteger("Rows Removed by GPU Filter", NULL,
 								   gss->gts.outer_instrument.nfiltered1 /
 								   gss->gts.outer_instrument.nloops, es);
+
+		/* observed selectivity of the adaptive device quals */
+		if (es->analyze && gs_rtstat && gss->nquals > 0 &&
+			!pgstrom_regression_test_mode)
+		{
+			StringInfoData	buf;
+			cl_uint			i = 0;
+
+			initStringInfo(&buf);
+			foreach (lc, gs_info->dev_quals)
+			{
+				cl_ulong	nitems_in;
+				cl_ulong	nitems_out;
+
+				if (i >= gss->nquals)
+					break;
+				nitems_in = pg_atomic_read_u64(&gs_rtstat->qual_nitems_in[i]);
+				nitems_out = pg_atomic_read_u64(&gs_rtstat->qual_nitems_out[i]);
+				exprstr = deparse_expression(lfirst(lc), dcontext,
+											 es->verbose, false);
+				resetStringInfo(&buf);
+				if (nitems_in > 0)
+					appendStringInfo(&buf, "%s: %.2f%% (%lu of %lu rows)",
+									 exprstr,
+									 100.0 * (double)nitems_out /
+									 (double)nitems_in,
+									 nitems_out, nitems_in);
+				else
+					appendStringInfo(&buf, "%s: not evaluated", exprstr);
+				ExplainPropertyText("GPU Filter Selectivity", buf.data, es);
+				i++;
+			}
+			pfree(buf.data);
+		}
+	}
+	/* GpuScan specific execution modes, if any */
+	if (!pgstrom_regression_test_mode)
+	{
+		if (gs_info->late_materialization)
+			ExplainPropertyText("Late Materialization", "on", es);
+		if (gs_info->selection_vector)
+			ExplainPropertyText("Selection Vector", "on", es);
+		if (gs_info->nrows_limit > 0)
+			ExplainPropertyInteger("LIMIT hint", NULL,
+								   gs_info->nrows_limit, es);
+		if (gs_info->topn_nrows > 0)
+			ExplainPropertyInteger("Top-N", NULL,
+								   gs_info->topn_nrows, es);
+		if (gss->cuda_graph)
+			ExplainPropertyText("CUDA Graph", "on", es);
+		if (gs_info->simple_pindex >= 0)
+			ExplainPropertyText("Precompiled Kernel", "on", es);
+		if (gs_info->bloom_keys != NIL)
+		{
+			exprstr = deparse_expression((Node *)gs_info->bloom_keys,
+										 dcontext, es->verbose, false);
+			if (es->analyze)
+				exprstr = psprintf("%s (%u bits)", exprstr,
+								   gss->bloom_nbits);
+			ExplainPropertyText("Bloom Filter", exprstr, es);
+		}
+		if (gs_info->gcache_index_key)
+		{
+			exprstr = deparse_expression((Node *)gs_info->gcache_index_key,
+										 dcontext, es->verbose, false);
+			ExplainPropertyText("GPU Cache Index Key", exprstr, es);
+		}
 	}
 	/* BRIN-index properties */
 	pgstromExplainBrinIndexMap(&gss->gts, es, dcontext);
@@ -2021,6 +3453,65 @@ resetGpuScanSharedState(GpuScanState *gss)
 	/* do nothing */
 }
 
+/*
+ * gpuscan_nrows_returned - # of rows returned by the completed tasks
+ */
+static cl_ulong
+gpuscan_nrows_returned(GpuScanState *gss)
+{
+	GpuScanRuntimeStat *gs_rtstat = gss->gs_rtstat;
+
+	if (!gs_rtstat)
+		return 0;
+	return (pg_atomic_read_u64(&gs_rtstat->c.source_nitems) -
+			pg_atomic_read_u64(&gs_rtstat->c.nitems_filtered));
+}
+
+/*
+ * gpuscan_setup_qual_order
+ *
+ * It decides the order of the device quals to be evaluated by the next task,
+ * according to the selectivity observed by the prior tasks. The quals are
+ * sorted by the classic rank metric: cost / (1 - selectivity); so cheap and
+ * selective quals are evaluated first. Until enough rows are evaluated, we
+ * assume the default selectivity, so the static order is kept.
+ * Note that the selectivity is conditional on the quals evaluated prior to
+ * them, however, it is enough accurate to detect the drift.
+ */
+#define GPUSCAN_ADAPTIVE_QUALS_MIN_SAMPLES		10000
+
+static void
+gpuscan_setup_qual_order(GpuScanState *gss, kern_gpuscan *kgpuscan)
+{
+	GpuScanRuntimeStat *gs_rtstat = gss->gs_rtstat;
+	double		rank[GPUSCAN_MAX_ADAPTIVE_QUALS];
+	cl_uint		i, j;
+
+	Assert(gss->nquals <= GPUSCAN_MAX_ADAPTIVE_QUALS);
+	for (i=0; i < gss->nquals; i++)
+	{
+		cl_ulong	nitems_in = 0;
+		cl_ulong	nitems_out = 0;
+		double		selectivity = 0.5;
+
+		if (gs_rtstat)
+		{
+			nitems_in = pg_atomic_read_u64(&gs_rtstat->qual_nitems_in[i]);
+			nitems_out = pg_atomic_read_u64(&gs_rtstat->qual_nitems_out[i]);
+		}
+		if (nitems_in >= GPUSCAN_ADAPTIVE_QUALS_MIN_SAMPLES)
+			selectivity = (double)nitems_out / (double)nitems_in;
+		rank[i] = (double)Max(gss->qual_costs[i], 1) /
+			Max(1.0 - selectivity, 1.0e-6);
+
+		/* insertion sort; it keeps the static order on tie */
+		for (j=i; j > 0 && rank[kgpuscan->qual_order[j-1]] > rank[i]; j--)
+			kgpuscan->qual_order[j] = kgpuscan->qual_order[j-1];
+		kgpuscan->qual_order[j] = i;
+	}
+	kgpuscan->nquals = gss->nquals;
+}
+
 /*
  * gpuscan_create_task - constructor of GpuScanTask
  */
@@ -2036,6 +3527,11 @@ gpuscan_create_task(GpuScanState *gss,
 	cl_int			sm_count = 0;
 	size_t			suspend_sz = 0;
 	size_t			result_index_sz = 0;
+	size_t			recheck_sz = 0;
+	cl_uint			recheck_nrooms = 0;
+	size_t			zmap_items_sz = 0;
+	const AttrNumber *zmap_attnums = NULL;
+	int				zmap_ncols = 0;
 	size_t			length;
 	CUdeviceptr		m_deviceptr;
 	CUresult		rc;
@@ -2047,13 +3543,68 @@ gpuscan_create_task(GpuScanState *gss,
 	 * is no problem, and allocation of identical length has another benefit
 	 * because gpu_mmgr.c caches the recently released buffer.
 	 */
-	pds_dst = PDS_create_slot(gcontext,
-							  scan_tupdesc,
-							  pgstrom_chunk_size());
-
+	if (gss->selection_vector &&
+		pds_src->kds.format == KDS_FORMAT_ROW)
+	{
+		/* selection-vector mode needs no destination buffer */
+		result_index_sz = offsetof(gpuscanResultIndex,
+								   results[pds_src->kds.nitems]);
+	}
+	else if (gss->selection_vector &&
+			 pds_src->kds.format == KDS_FORMAT_BLOCK &&
+			 pds_src->nblocks_uncached == 0)
+	{
+		/*
+		 * Also, KDS_FORMAT_BLOCK can use selection-vector mode unless
+		 * blocks are not loaded by NVMe-Strom; host cannot fetch tuples
+		 * from the source buffer on the device memory.
+		 */
+		result_index_sz = offsetof(gpuscanResultIndex,
+								   results[pds_src->kds.nitems *
+										   MaxHeapTuplesPerPage]);
+	}
+	else
+	{
+		pds_dst = PDS_create_slot(gcontext,
+								  scan_tupdesc,
+								  pgstrom_chunk_size());
+		/*
+		 * Result index buffer for the late materialization; the 1st phase
+		 * kernel writes back the position of the qualified rows here.
+		 */
+		if (gss->late_materialization &&
+			pds_src->kds.format == KDS_FORMAT_BLOCK)
+			result_index_sz = offsetof(gpuscanResultIndex,
+									   results[pds_src->kds.nitems *
+											   MaxHeapTuplesPerPage]);
+	}
 	sm_count = devAttrs[gcontext->cuda_dindex].MULTIPROCESSOR_COUNT;
 	suspend_sz = STROMALIGN(sizeof(gpuscanSuspendContext) *
 							GPUKERNEL_MAX_SM_MULTIPLICITY * sm_count);
+	/*
+	 * row-level recheck buffer; rows that raised CpuReCheck are evaluated
+	 * by CPU individually, instead of the whole chunk.
+	 */
+	if (pgstrom_cpu_fallback_enabled &&
+		(pds_src->kds.format == KDS_FORMAT_ROW ||
+		 pds_src->kds.format == KDS_FORMAT_BLOCK))
+	{
+		recheck_nrooms = Min(pds_src->kds.format == KDS_FORMAT_ROW
+							 ? pds_src->kds.nitems
+							 : pds_src->kds.nitems * MaxHeapTuplesPerPage,
+							 GPUSCAN_RECHECK_MAX_NROWS);
+		recheck_sz = sizeof(cl_uint) * recheck_nrooms;
+	}
+	/*
+	 * min/max items of the zone-map, if any. LIMIT hint may terminate
+	 * the kernel prior to the scan of all the blocks.
+	 */
+	if (pds_src->kds.format == KDS_FORMAT_BLOCK && gss->nrows_limit == 0)
+	{
+		zmap_ncols = pgstromZoneMapColumns(&gss->gts, &zmap_attnums);
+		Assert(zmap_ncols <= GPUSCAN_ZONEMAP_MAX_COLS);
+		zmap_items_sz = sizeof(cl_long) * 2 * zmap_ncols * pds_src->kds.nitems;
+	}
 
 	/*
 	 * allocation of pgstrom_gpuscan
@@ -2061,7 +3612,9 @@ gpuscan_create_task(GpuScanState *gss,
 	length = (STROMALIGN(offsetof(GpuScanTask, kern.kparams)) +
 			  STROMALIGN(gss->gts.kern_params->length) +
 			  STROMALIGN(suspend_sz) +
-			  STROMALIGN(result_index_sz));
+			  STROMALIGN(result_index_sz) +
+			  STROMALIGN(recheck_sz) +
+			  STROMALIGN(zmap_items_sz));
 	rc = gpuMemAllocManaged(gcontext,
 							&m_deviceptr,
 							length,
@@ -2076,9 +3629,86 @@ gpuscan_create_task(GpuScanState *gss,
 		(pds_src->kds.format == KDS_FORMAT_ARROW &&
 		 pds_src->iovec != NULL))
 		gscan->with_nvme_strom = true;
+	gscan->with_late_materialization = (pds_dst != NULL &&
+										result_index_sz > 0);
+	gscan->with_selection_vector = (pds_dst == NULL);
+	gscan->with_cuda_graph = gss->cuda_graph;
 	gscan->pds_src = pds_src;
 	gscan->pds_dst = pds_dst;
 	gscan->kern.suspend_sz = suspend_sz;
+	gscan->kern.nrows_limit = gss->nrows_limit;
+	gscan->kern.simple_pindex = gss->simple_pindex;
+	if (pds_dst && gss->topn_nrows > 0)
+	{
+		gscan->kern.topn_nrows = gss->topn_nrows;
+		gscan->kern.topn_nkeys = gss->topn_nkeys;
+		memcpy(gscan->kern.topn_keys, gss->topn_keys,
+			   sizeof(gpuscanTopNKey) * gss->topn_nkeys);
+	}
+	if (gss->nquals > 0)
+		gpuscan_setup_qual_order(gss, &gscan->kern);
+	if (gss->bloom_nbits > 0)
+	{
+		gscan->kern.bloom_bitmap = (cl_ulong) gss->m_bloom_bitmap;
+		gscan->kern.bloom_nbits = gss->bloom_nbits;
+	}
+	/* MVCC snapshot for the blocks read by GPUDirect SQL, if any */
+	if (pds_src->kds.format == KDS_FORMAT_BLOCK &&
+		gss->gts.nvme_sstate != NULL)
+		gscan->kern.mvcc_snapshot = (cl_ulong)
+			gss->gts.nvme_sstate->mvcc_snapshot;
+	/* recheck buffer, if any */
+	if (recheck_nrooms > 0)
+	{
+		gscan->kern.recheck_nrooms = recheck_nrooms;
+		gscan->kern.recheck_items = (cl_ulong)
+			((char *)gscan + length - STROMALIGN(zmap_items_sz)
+			 - STROMALIGN(recheck_sz));
+	}
+	/* zone-map to be gathered, if any */
+	if (zmap_items_sz > 0)
+	{
+		cl_long	   *items = (cl_long *)
+			((char *)gscan + length - STROMALIGN(zmap_items_sz));
+		cl_uint		i;
+
+		gscan->kern.zmap_ncols = zmap_ncols;
+		for (i=0; i < zmap_ncols; i++)
+		{
+			gscan->kern.zmap_colidx[i] = zmap_attnums[i] - 1;
+			gscan->kern.zmap_collen[i] =
+				pds_src->kds.colmeta[zmap_attnums[i] - 1].attlen;
+		}
+		for (i=0; i < 2 * zmap_ncols * pds_src->kds.nitems; i+=2)
+		{
+			items[i]   = LONG_MAX;
+			items[i+1] = LONG_MIN;
+		}
+		gscan->kern.zmap_items = (cl_ulong) items;
+	}
+	/* candidate rows by the hash index of GPU cache, if any */
+	if (gss->gcache_index_key &&
+		pds_src->kds.format == KDS_FORMAT_COLUMN &&
+		gpuCacheIndexAttnum(pds_src) == gss->gcache_index_attnum)
+	{
+		ExprContext *econtext = gss->gts.css.ss.ps.ps_ExprContext;
+		Datum		key;
+		bool		isnull;
+		int16		typlen;
+
+		typlen = get_typlen(exprType((Node *)gss->gcache_index_key->expr));
+		key = ExecEvalExpr(gss->gcache_index_key, econtext, &isnull);
+		if (!isnull && typlen > 0 && typlen <= sizeof(cl_ulong))
+		{
+			cl_ulong	ival = DatumGetUInt64(key);
+
+			/* device side reads the key as a zero-extended integer */
+			if (typlen < sizeof(cl_ulong))
+				ival &= ((1UL << (BITS_PER_BYTE * typlen)) - 1);
+			gscan->kern.gcache_index_enabled = true;
+			gscan->kern.gcache_index_key = ival;
+		}
+	}
 	/* kern_parambuf */
 	memcpy(KERN_GPUSCAN_PARAMBUF(&gscan->kern),
 		   gss->gts.kern_params,
@@ -2090,9 +3720,24 @@ static void
 gpuscan_switch_task(GpuTaskState *gts, GpuTask *gtask)
 {
 	GpuScanState   *gss = (GpuScanState *) gts;
+	GpuScanTask	   *gscan = (GpuScanTask *) gtask;
 
 	gss->fallback_group_id = 0;
 	gss->fallback_local_id = 0;
+	gss->recheck_index = 0;
+
+	/*
+	 * merge the min/max gathered by GPU kernel into the zone-map, unless
+	 * CPU processed a part of the chunk.
+	 */
+	if (gscan->kern.zmap_ncols > 0 &&
+		gscan->pds_src != NULL &&
+		!gtask->cpu_fallback &&
+		gscan->kern.recheck_nitems == 0 &&
+		gtask->kerror.errcode == ERRCODE_STROM_SUCCESS)
+		pgstromZoneMapUpdate(gts, gscan->pds_src,
+							 (cl_long *)gscan->kern.zmap_items,
+							 gscan->zmap_lsn);
 }
 
 /*
@@ -2104,20 +3749,129 @@ gpuscan_next_task(GpuTaskState *gts)
 	GpuScanState	   *gss = (GpuScanState *) gts;
 	GpuScanTask		   *gscan;
 	pgstrom_data_store *pds;
+	XLogRecPtr			zmap_lsn = InvalidXLogRecPtr;
+
+	/*
+	 * No more chunks are needed, if the completed tasks already returned
+	 * the rows required by the LIMIT clause.
+	 */
+	if (gss->nrows_limit > 0 &&
+		(gpuscan_nrows_returned(gss) -
+		 gss->nrows_limit_base) >= gss->nrows_limit)
+		return NULL;
 
 	if (gss->gts.af_state)
 		pds = ExecScanChunkArrowFdw(gts);
 	else if (gss->gts.gc_state)
 		pds = ExecScanChunkGpuCache(gts);
 	else
+	{
+		/* zone-map is valid only if VM is not updated since here */
+		if (gss->gts.outer_zmap_state)
+			zmap_lsn = GetXLogInsertRecPtr();
 		pds = pgstromExecScanChunk(gts);
+	}
 	if (!pds)
 		return NULL;
 	gscan = gpuscan_create_task(gss, pds);
+	gscan->zmap_lsn = zmap_lsn;
 
+	/*
+	 * Arrow_Fdw processes a record-batch per chunk, so a larger number of
+	 * short GpuTasks are launched if record-batches are small. In this case,
+	 * we coalesce the following record-batches into this GpuScanTask, up to
+	 * pg_strom.gpuscan_batch_size, to amortize the cost of task setup.
+	 */
+	if (gpuscan_batch_size_kb > 0 &&
+		gss->gts.af_state != NULL &&
+		pds->kds.format == KDS_FORMAT_ARROW)
+	{
+		size_t		batch_sz = (size_t)gpuscan_batch_size_kb << 10;
+		size_t		total_sz = pds->kds.length;
+
+		gscan->pds_batch[0] = pds;
+		gscan->nr_batch = 1;
+		gscan->curr_batch = 0;
+		while (total_sz < batch_sz &&
+			   gscan->nr_batch < GPUSCAN_MAX_BATCH_CHUNKS)
+		{
+			pds = ExecScanChunkArrowFdw(gts);
+			if (!pds)
+				break;
+			Assert(pds->kds.format == KDS_FORMAT_ARROW);
+			gscan->pds_batch[gscan->nr_batch++] = pds;
+			total_sz += pds->kds.length;
+		}
+	}
 	return &gscan->task;
 }
 
+/*
+ * gpuscan_switch_batch_chunk - moves to the next chunk in the batch
+ */
+static void
+gpuscan_switch_batch_chunk(GpuScanTask *gscan)
+{
+	pgstrom_data_store *pds_src;
+
+	Assert(gscan->curr_batch + 1 < gscan->nr_batch);
+	PDS_release(gscan->pds_src);
+	gscan->pds_batch[gscan->curr_batch++] = NULL;
+	pds_src = gscan->pds_batch[gscan->curr_batch];
+
+	gscan->pds_src = pds_src;
+	gscan->with_nvme_strom = (pds_src->kds.format == KDS_FORMAT_ARROW &&
+							  pds_src->iovec != NULL);
+	/* reset the kernel state */
+	memset(&gscan->task.kerror, 0, sizeof(kern_errorbuf));
+	memset(&gscan->kern.kerror, 0, sizeof(kern_errorbuf));
+	gscan->kern.resume_context = false;
+	/* save the position of kds_dst at the start of this chunk */
+	gscan->batch_pds_dst = gscan->pds_dst;
+	if (gscan->pds_dst)
+	{
+		gscan->batch_dst_nitems = gscan->pds_dst->kds.nitems;
+		gscan->batch_dst_usage  = gscan->pds_dst->kds.usage;
+	}
+}
+
+/*
+ * gpuscan_cpu_hybrid_task
+ *
+ * It prepares the supplied GpuScanTask to be processed by CPU, using the
+ * CPU fallback path, when GPU is saturated by the concurrent tasks.
+ */
+static bool
+gpuscan_cpu_hybrid_task(GpuTaskState *gts, GpuTask *gtask)
+{
+	GpuScanTask		   *gscan = (GpuScanTask *) gtask;
+	pgstrom_data_store *pds_src = gscan->pds_src;
+
+	if (pds_src->kds.format == KDS_FORMAT_BLOCK)
+	{
+		/* blocks to be loaded by NVMe-Strom must be read by CPU */
+		if (pds_src->nblocks_uncached > 0)
+			PDS_fillup_blocks(pds_src);
+	}
+	else if (pds_src->kds.format == KDS_FORMAT_ARROW)
+	{
+		if (pds_src->iovec != NULL)
+		{
+			gscan->pds_src = PDS_fillup_arrow(pds_src);
+			PDS_release(pds_src);
+		}
+	}
+	else if (pds_src->kds.format != KDS_FORMAT_ROW)
+	{
+		/* GPU cache (KDS_FORMAT_COLUMN) is not visible to CPU */
+		return false;
+	}
+	gscan->with_nvme_strom = false;
+	gscan->task.cpu_fallback = true;
+
+	return true;
+}
+
 /*
  * gpuscan_next_tuple_suspended_tuple
  */
@@ -2228,6 +3982,9 @@ gpuscan_next_tuple_suspended_block(GpuScanState *gss, GpuScanTask *gscan)
 				tuple->t_tableOid = pds_src->kds.table_oid;
 				tuple->t_data = (HeapTupleHeader)((char *)hpage +
 												  ItemIdGetOffset(lpp));
+				if (!pgstromMvccTupleIsVisible(&gss->gts, hpage,
+											   tuple->t_data))
+					continue;
 				ExecForceStoreHeapTuple(tuple, gss->base_slot, false);
 
 				return true;
@@ -2253,6 +4010,77 @@ gpuscan_next_tuple_suspended_block(GpuScanState *gss, GpuScanTask *gscan)
 	return false;
 }
 
+/*
+ * gpuscan_next_tuple_suspended_selection
+ *
+ * It fetches the tuples qualified by the 1st phase of the late
+ * materialization, but not returned by the 2nd phase kernel yet.
+ */
+static bool
+gpuscan_next_tuple_suspended_selection(GpuScanState *gss, GpuScanTask *gscan)
+{
+	pgstrom_data_store *pds_src = gscan->pds_src;
+	gpuscanResultIndex *gs_results = KERN_GPUSCAN_RESULT_INDEX(&gscan->kern);
+	gpuscanSuspendContext *con;
+	cl_uint		window_sz = gscan->kern.block_sz * gscan->kern.grid_sz;
+	cl_uint		group_id;
+	cl_uint		local_id;
+	cl_uint		part_index;
+	size_t		base_index;
+
+	while (gss->fallback_group_id < gscan->kern.grid_sz)
+	{
+		cl_uint		code;
+		cl_uint		part_id;
+		cl_uint		line_no;
+		PageHeader	hpage;
+		ItemId		lpp;
+		HeapTuple	tuple = &gss->gts.curr_tuple;
+
+		group_id = gss->fallback_group_id;
+		local_id = gss->fallback_local_id;
+
+		con = KERN_GPUSCAN_SUSPEND_CONTEXT(&gscan->kern, group_id);
+		part_index = con->part_index;
+
+		base_index = (part_index * window_sz +
+					  group_id * gscan->kern.block_sz);
+		if (base_index >= gs_results->nitems)
+		{
+			gss->fallback_group_id++;
+			gss->fallback_local_id = 0;
+			continue;
+		}
+
+		if (++gss->fallback_local_id >= gscan->kern.block_sz)
+		{
+			con->part_index++;
+			gss->fallback_local_id = 0;
+		}
+		if (base_index + local_id >= gs_results->nitems)
+			continue;
+
+		code = gs_results->results[base_index + local_id];
+		part_id = GPUSCAN_BLOCK_RESULT_PART_ID(code);
+		line_no = GPUSCAN_BLOCK_RESULT_LINE_NO(code);
+		Assert(part_id < pds_src->kds.nitems);
+		hpage = KERN_DATA_STORE_BLOCK_PGPAGE(&pds_src->kds, part_id);
+		lpp = &hpage->pd_linp[line_no];
+		Assert(ItemIdIsNormal(lpp));
+
+		tuple->t_len = ItemIdGetLength(lpp);
+		BlockIdSet(&tuple->t_self.ip_blkid,
+				   KERN_DATA_STORE_BLOCK_BLCKNR(&pds_src->kds, part_id));
+		tuple->t_self.ip_posid = line_no + 1;
+		tuple->t_tableOid = pds_src->kds.table_oid;
+		tuple->t_data = (HeapTupleHeader)((char *)hpage +
+										  ItemIdGetOffset(lpp));
+		ExecForceStoreHeapTuple(tuple, gss->base_slot, false);
+		return true;
+	}
+	return false;
+}
+
 /*
  * gpuscan_next_tuple_fallback - GPU fallback case
  */
@@ -2273,7 +4101,12 @@ retry_next:
 			 pds_src->kds.format == KDS_FORMAT_ARROW)
 		status = gpuscan_next_tuple_suspended_tuple(gss, gscan);
 	else if (pds_src->kds.format == KDS_FORMAT_BLOCK)
-		status = gpuscan_next_tuple_suspended_block(gss, gscan);
+	{
+		if (gscan->with_late_materialization)
+			status = gpuscan_next_tuple_suspended_selection(gss, gscan);
+		else
+			status = gpuscan_next_tuple_suspended_block(gss, gscan);
+	}
 	else
 		elog(ERROR, "Bug? unexpected KDS format: %d", pds_src->kds.format);
 	if (!status)
@@ -2308,6 +4141,76 @@ retry_next:
 	return slot;
 }
 
+/*
+ * gpuscan_next_tuple_recheck
+ *
+ * It evaluates the rows recorded on the recheck buffer, because they raised
+ * CpuReCheck error on the device. Other rows in the chunk were already
+ * processed by GPU.
+ */
+static TupleTableSlot *
+gpuscan_next_tuple_recheck(GpuScanState *gss, GpuScanTask *gscan)
+{
+	pgstrom_data_store *pds_src = gscan->pds_src;
+	GpuScanRuntimeStat *gs_rtstat = gss->gs_rtstat;
+	ExprContext		   *econtext = gss->gts.css.ss.ps.ps_ExprContext;
+	HeapTuple			tuple = &gss->gts.curr_tuple;
+	cl_uint			   *items = (cl_uint *)gscan->kern.recheck_items;
+	cl_uint				nitems = Min(gscan->kern.recheck_nitems,
+									 gscan->kern.recheck_nrooms);
+
+	while (gss->recheck_index < nitems)
+	{
+		cl_uint		code = items[gss->recheck_index++];
+
+		gss->gts.num_cpu_rechecks++;
+
+		if (pds_src->kds.format == KDS_FORMAT_ROW)
+		{
+			tuple->t_data = KDS_ROW_REF_HTUP(&pds_src->kds,
+											 code,
+											 &tuple->t_self,
+											 &tuple->t_len);
+		}
+		else
+		{
+			cl_uint		part_id = GPUSCAN_BLOCK_RESULT_PART_ID(code);
+			cl_uint		line_no = GPUSCAN_BLOCK_RESULT_LINE_NO(code);
+			PageHeader	hpage;
+			ItemId		lpp;
+
+			Assert(pds_src->kds.format == KDS_FORMAT_BLOCK);
+			Assert(part_id < pds_src->kds.nitems);
+			hpage = KERN_DATA_STORE_BLOCK_PGPAGE(&pds_src->kds, part_id);
+			lpp = &hpage->pd_linp[line_no];
+			if (!ItemIdIsNormal(lpp))
+				continue;
+			tuple->t_len = ItemIdGetLength(lpp);
+			BlockIdSet(&tuple->t_self.ip_blkid,
+					   KERN_DATA_STORE_BLOCK_BLCKNR(&pds_src->kds, part_id));
+			tuple->t_self.ip_posid = line_no + 1;
+			tuple->t_data = (HeapTupleHeader)((char *)hpage +
+											  ItemIdGetOffset(lpp));
+			if (!pgstromMvccTupleIsVisible(&gss->gts, hpage, tuple->t_data))
+				continue;
+		}
+		tuple->t_tableOid = pds_src->kds.table_oid;
+		ExecForceStoreHeapTuple(tuple, gss->base_slot, false);
+
+		ResetExprContext(econtext);
+		econtext->ecxt_scantuple = gss->base_slot;
+		if (gss->dev_quals && !ExecQual(gss->dev_quals, econtext))
+			continue;
+		/* kernel already counted the row as filtered */
+		pg_atomic_sub_fetch_u64(&gs_rtstat->c.nitems_filtered, 1);
+
+		if (!gss->base_proj)
+			return gss->base_slot;
+		return ExecProject(gss->base_proj);
+	}
+	return NULL;
+}
+
 /*
  * gpuscan_next_tuple
  */
@@ -2319,7 +4222,27 @@ gpuscan_next_tuple(GpuTaskState *gts)
 	TupleTableSlot	   *slot = NULL;
 
 	if (gscan->task.cpu_fallback)
-		slot = gpuscan_next_tuple_fallback(gss, gscan);
+	{
+		while (!(slot = gpuscan_next_tuple_fallback(gss, gscan)) &&
+			   gscan->curr_batch + 1 < gscan->nr_batch)
+		{
+			pgstrom_data_store *pds_src;
+
+			/* the rest of chunks in the batch are also processed by CPU */
+			gpuscan_switch_batch_chunk(gscan);
+			pds_src = gscan->pds_src;
+			if (pds_src->kds.format == KDS_FORMAT_ARROW &&
+				pds_src->iovec != NULL)
+			{
+				gscan->pds_src = PDS_fillup_arrow(pds_src);
+				PDS_release(pds_src);
+			}
+			gscan->with_nvme_strom = false;
+			gss->gts.curr_index = 0;
+			gss->gts.curr_lp_index = 0;
+			gpuscan_switch_task(&gss->gts, &gscan->task);
+		}
+	}
 	else if (gscan->pds_dst)
 	{
 		pgstrom_data_store *pds_dst = gscan->pds_dst;
@@ -2334,22 +4257,56 @@ gpuscan_next_tuple(GpuTaskState *gts)
 		pgstrom_data_store *pds_src = gscan->pds_src;
 		gpuscanResultIndex *gs_results
 			= KERN_GPUSCAN_RESULT_INDEX(&gscan->kern);
+		ExprContext		   *econtext = gss->gts.css.ss.ps.ps_ExprContext;
 
-		Assert(pds_src->kds.format == KDS_FORMAT_ROW);
+		/*
+		 * Selection-vector mode; fetch the tuple from the source buffer
+		 * directly, then makes projection to the scan slot.
+		 */
+		Assert(gscan->with_selection_vector);
 		if (gss->gts.curr_index < gs_results->nitems)
 		{
 			HeapTuple	tuple = &gss->gts.curr_tuple;
-			cl_uint		kds_offset;
+			cl_uint		code;
 
-			kds_offset = gs_results->results[gss->gts.curr_index++];
-			tuple->t_data = KDS_ROW_REF_HTUP(&pds_src->kds,
-											 kds_offset,
-											 &tuple->t_self,
-											 &tuple->t_len);
-			slot = gss->gts.css.ss.ss_ScanTupleSlot;
-			ExecForceStoreHeapTuple(tuple, slot, false);
+			code = gs_results->results[gss->gts.curr_index++];
+			if (pds_src->kds.format == KDS_FORMAT_ROW)
+			{
+				tuple->t_data = KDS_ROW_REF_HTUP(&pds_src->kds,
+												 code,
+												 &tuple->t_self,
+												 &tuple->t_len);
+			}
+			else
+			{
+				cl_uint		part_id = GPUSCAN_BLOCK_RESULT_PART_ID(code);
+				cl_uint		line_no = GPUSCAN_BLOCK_RESULT_LINE_NO(code);
+				PageHeader	hpage;
+				ItemId		lpp;
+
+				Assert(pds_src->kds.format == KDS_FORMAT_BLOCK);
+				hpage = KERN_DATA_STORE_BLOCK_PGPAGE(&pds_src->kds, part_id);
+				lpp = &hpage->pd_linp[line_no];
+				Assert(ItemIdIsNormal(lpp));
+				tuple->t_len = ItemIdGetLength(lpp);
+				BlockIdSet(&tuple->t_self.ip_blkid,
+						   KERN_DATA_STORE_BLOCK_BLCKNR(&pds_src->kds,
+														part_id));
+				tuple->t_self.ip_posid = line_no + 1;
+				tuple->t_data = (HeapTupleHeader)((char *)hpage +
+												  ItemIdGetOffset(lpp));
+			}
+			tuple->t_tableOid = pds_src->kds.table_oid;
+			ExecForceStoreHeapTuple(tuple, gss->base_slot, false);
+
+			ResetExprContext(econtext);
+			econtext->ecxt_scantuple = gss->base_slot;
+			slot = ExecProject(gss->base_proj);
 		}
 	}
+	/* rows to be rechecked by CPU, if any */
+	if (!slot && gscan->kern.recheck_nitems > 0)
+		slot = gpuscan_next_tuple_recheck(gss, gscan);
 	return slot;
 }
 
@@ -2402,6 +4359,248 @@ gpuscan_throw_partial_result(GpuScanTask *gscan, pgstrom_data_store *pds_dst)
 /*
  * gpuscan_process_task
  */
+/*
+ * gpuscan_merge_qual_stat
+ *
+ * It moves the per-qual counters of the adaptive device quals to the shared
+ * run-time statistics, then clears them for the next kernel invocation.
+ */
+static void
+gpuscan_merge_qual_stat(GpuScanTask *gscan, GpuScanRuntimeStat *gs_rtstat)
+{
+	cl_uint		i;
+
+	for (i=0; i < gscan->kern.nquals; i++)
+	{
+		pg_atomic_add_fetch_u64(&gs_rtstat->qual_nitems_in[i],
+								gscan->kern.qual_nitems_in[i]);
+		pg_atomic_add_fetch_u64(&gs_rtstat->qual_nitems_out[i],
+								gscan->kern.qual_nitems_out[i]);
+		gscan->kern.qual_nitems_in[i] = 0;
+		gscan->kern.qual_nitems_out[i] = 0;
+	}
+}
+
+/*
+ * gpuscan_launch_cuda_graph
+ *
+ * It launches the GpuScan kernel (and the top-N kernel, if any) using the
+ * CUDA graph cached in the GpuContext for each pair of program_id and
+ * worker thread. The graph is built on the first call and instantiated
+ * once, then the following calls just update the kernel arguments of the
+ * nodes. If kernel functions or launch configuration are different from
+ * the cached one, the graph shall be rebuilt.
+ * The cached graphs are released with the GpuContext; see
+ * pgstrom_release_gpuscan_cuda_graphs().
+ */
+typedef struct {
+	dlist_node		chain;
+	ProgramId		program_id;
+	int				worker_index;
+	CUfunction		kern_quals;
+	CUfunction		kern_topn;
+	cl_int			grid_sz;
+	cl_int			block_sz;
+	cl_int			topn_block_sz;
+	CUgraph			graph;
+	CUgraphExec		graph_exec;
+	CUgraphNode		quals_node;
+	CUgraphNode		topn_node;
+} gpuscanCudaGraph;
+
+static gpuscanCudaGraph *
+lookup_gpuscan_cuda_graph(GpuContext *gcontext, ProgramId program_id)
+{
+	gpuscanCudaGraph *cgraph;
+	dlist_iter	iter;
+
+	SpinLockAcquire(&gcontext->cuda_graph_lock);
+	dlist_foreach(iter, &gcontext->cuda_graph_list)
+	{
+		cgraph = dlist_container(gpuscanCudaGraph, chain, iter.cur);
+		if (cgraph->program_id == program_id &&
+			cgraph->worker_index == GpuWorkerIndex)
+		{
+			SpinLockRelease(&gcontext->cuda_graph_lock);
+			return cgraph;
+		}
+	}
+	SpinLockRelease(&gcontext->cuda_graph_lock);
+
+	cgraph = calloc(1, sizeof(gpuscanCudaGraph));
+	if (!cgraph)
+		werror("out of memory");
+	cgraph->program_id = program_id;
+	cgraph->worker_index = GpuWorkerIndex;
+
+	SpinLockAcquire(&gcontext->cuda_graph_lock);
+	dlist_push_tail(&gcontext->cuda_graph_list, &cgraph->chain);
+	SpinLockRelease(&gcontext->cuda_graph_lock);
+
+	return cgraph;
+}
+
+static void
+gpuscan_launch_cuda_graph(GpuContext *gcontext,
+						  ProgramId program_id,
+						  CUfunction kern_quals,
+						  cl_int grid_sz,
+						  cl_int block_sz,
+						  void **quals_args,
+						  CUfunction kern_topn,
+						  cl_int topn_block_sz,
+						  void **topn_args)
+{
+	gpuscanCudaGraph *cgraph = lookup_gpuscan_cuda_graph(gcontext,
+														 program_id);
+	CUDA_KERNEL_NODE_PARAMS	qparams;
+	CUDA_KERNEL_NODE_PARAMS	tparams;
+	CUresult		rc;
+
+	memset(&qparams, 0, sizeof(CUDA_KERNEL_NODE_PARAMS));
+	qparams.func = kern_quals;
+	qparams.gridDimX = grid_sz;
+	qparams.gridDimY = 1;
+	qparams.gridDimZ = 1;
+	qparams.blockDimX = block_sz;
+	qparams.blockDimY = 1;
+	qparams.blockDimZ = 1;
+	qparams.sharedMemBytes = sizeof(cl_int) * 1024;
+	qparams.kernelParams = quals_args;
+
+	memset(&tparams, 0, sizeof(CUDA_KERNEL_NODE_PARAMS));
+	tparams.func = kern_topn;
+	tparams.gridDimX = 1;
+	tparams.gridDimY = 1;
+	tparams.gridDimZ = 1;
+	tparams.blockDimX = topn_block_sz;
+	tparams.blockDimY = 1;
+	tparams.blockDimZ = 1;
+	tparams.sharedMemBytes = 0;
+	tparams.kernelParams = topn_args;
+
+	/* release the cached graph, if it has different shape */
+	if (cgraph->graph_exec &&
+		(cgraph->kern_quals != kern_quals ||
+		 cgraph->kern_topn != kern_topn ||
+		 cgraph->grid_sz != grid_sz ||
+		 cgraph->block_sz != block_sz ||
+		 cgraph->topn_block_sz != topn_block_sz))
+	{
+		rc = cuGraphExecDestroy(cgraph->graph_exec);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuGraphExecDestroy: %s", errorText(rc));
+		rc = cuGraphDestroy(cgraph->graph);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuGraphDestroy: %s", errorText(rc));
+		cgraph->graph = NULL;
+		cgraph->graph_exec = NULL;
+	}
+
+	if (!cgraph->graph_exec)
+	{
+		/* graph may be left by the previous failure of instantiation */
+		if (cgraph->graph)
+		{
+			rc = cuGraphDestroy(cgraph->graph);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuGraphDestroy: %s", errorText(rc));
+			cgraph->graph = NULL;
+		}
+		rc = cuGraphCreate(&cgraph->graph, 0);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuGraphCreate: %s", errorText(rc));
+		rc = cuGraphAddKernelNode(&cgraph->quals_node,
+								  cgraph->graph,
+								  NULL, 0,
+								  &qparams);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuGraphAddKernelNode: %s", errorText(rc));
+		if (kern_topn)
+		{
+			rc = cuGraphAddKernelNode(&cgraph->topn_node,
+									  cgraph->graph,
+									  &cgraph->quals_node, 1,
+									  &tparams);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuGraphAddKernelNode: %s", errorText(rc));
+		}
+		rc = cuGraphInstantiateWithFlags(&cgraph->graph_exec,
+										 cgraph->graph, 0);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuGraphInstantiateWithFlags: %s",
+				   errorText(rc));
+		cgraph->kern_quals = kern_quals;
+		cgraph->kern_topn = kern_topn;
+		cgraph->grid_sz = grid_sz;
+		cgraph->block_sz = block_sz;
+		cgraph->topn_block_sz = topn_block_sz;
+	}
+	else
+	{
+		/* only kernel arguments are updated */
+		rc = cuGraphExecKernelNodeSetParams(cgraph->graph_exec,
+											cgraph->quals_node,
+											&qparams);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuGraphExecKernelNodeSetParams: %s",
+				   errorText(rc));
+		if (kern_topn)
+		{
+			rc = cuGraphExecKernelNodeSetParams(cgraph->graph_exec,
+												cgraph->topn_node,
+												&tparams);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuGraphExecKernelNodeSetParams: %s",
+					   errorText(rc));
+		}
+	}
+	rc = cuGraphLaunch(cgraph->graph_exec, CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuGraphLaunch: %s", errorText(rc));
+}
+
+/*
+ * pgstrom_release_gpuscan_cuda_graphs
+ *
+ * It releases the CUDA graphs cached in the GpuContext. The worker threads
+ * have to be terminated already.
+ */
+void
+pgstrom_release_gpuscan_cuda_graphs(GpuContext *gcontext)
+{
+	gpuscanCudaGraph *cgraph;
+	dlist_node *dnode;
+	CUresult	rc;
+
+	Assert(!gcontext->worker_is_running);
+	while (!dlist_is_empty(&gcontext->cuda_graph_list))
+	{
+		dnode = dlist_pop_head_node(&gcontext->cuda_graph_list);
+		cgraph = dlist_container(gpuscanCudaGraph, chain, dnode);
+		if (cgraph->graph_exec || cgraph->graph)
+		{
+			Assert(gcontext->cuda_context != NULL);
+			GPUCONTEXT_PUSH(gcontext);
+			if (cgraph->graph_exec)
+			{
+				rc = cuGraphExecDestroy(cgraph->graph_exec);
+				if (rc != CUDA_SUCCESS)
+					wnotice("failed on cuGraphExecDestroy: %s",
+							errorText(rc));
+			}
+			if (cgraph->graph)
+			{
+				rc = cuGraphDestroy(cgraph->graph);
+				if (rc != CUDA_SUCCESS)
+					wnotice("failed on cuGraphDestroy: %s", errorText(rc));
+			}
+			GPUCONTEXT_POP(gcontext);
+		}
+		free(cgraph);
+	}
+}
+
 static int
 __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 {
@@ -2410,6 +4609,8 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 	pgstrom_data_store *pds_src = gscan->pds_src;
 	pgstrom_data_store *pds_dst = gscan->pds_dst;
 	CUfunction		kern_gpuscan_quals;
+	CUfunction		kern_gpuscan_selection = NULL;
+	CUfunction		kern_gpuscan_topn = NULL;
 	CUdeviceptr		m_gpuscan = (CUdeviceptr)&gscan->kern;
 	CUdeviceptr		m_kds_src = 0UL;
 	CUdeviceptr		m_kds_extra = 0UL;
@@ -2417,11 +4618,15 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 	bool			m_kds_src_release = false;
 	const char	   *kern_fname;
 	void		   *kern_args[5];
+	void		   *topn_args[2];
 	void		   *last_suspend = NULL;
+	cl_uint			last_recheck_nitems = 0;
 	size_t			offset;
 	size_t			length;
 	cl_int			grid_sz;
 	cl_int			block_sz;
+	cl_int			topn_block_sz = 0;
+	int				autotune_trial = -1;
 	size_t			nitems_in;
 	size_t			nitems_out;
 	CUresult		rc;
@@ -2430,10 +4635,33 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 	/*
 	 * Lookup GPU kernel functions
 	 */
-	if (pds_src->kds.format == KDS_FORMAT_ROW)
+	if (gscan->with_selection_vector)
+	{
+		if (pds_src->kds.format == KDS_FORMAT_ROW)
+			kern_fname = "kern_gpuscan_quals_row";
+		else if (pds_src->kds.format == KDS_FORMAT_BLOCK)
+			kern_fname = "kern_gpuscan_quals_block";
+		else
+			werror("GpuScan: unexpected PDS format for selection-vector: %d",
+				   pds_src->kds.format);
+	}
+	else if (pds_src->kds.format == KDS_FORMAT_ROW)
 		kern_fname = "kern_gpuscan_main_row";
 	else if (pds_src->kds.format == KDS_FORMAT_BLOCK)
-		kern_fname = "kern_gpuscan_main_block";
+	{
+		if (gscan->with_late_materialization)
+		{
+			rc = cuModuleGetFunction(&kern_gpuscan_selection,
+									 cuda_module,
+									 "kern_gpuscan_quals_block");
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuModuleGetFunction('%s'): %s",
+					   "kern_gpuscan_quals_block", errorText(rc));
+			kern_fname = "kern_gpuscan_projection_block";
+		}
+		else
+			kern_fname = "kern_gpuscan_main_block";
+	}
 	else if (pds_src->kds.format == KDS_FORMAT_ARROW)
 		kern_fname = "kern_gpuscan_main_arrow";
 	else if (pds_src->kds.format == KDS_FORMAT_COLUMN)
@@ -2448,6 +4676,26 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 		werror("failed on cuModuleGetFunction('%s'): %s",
 			   kern_fname, errorText(rc));
 
+	if (pds_dst && gscan->kern.topn_nrows > 0)
+	{
+		cl_int		__grid_sz;
+
+		rc = cuModuleGetFunction(&kern_gpuscan_topn,
+								 cuda_module,
+								 "kern_gpuscan_topn_slot");
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuModuleGetFunction('%s'): %s",
+				   "kern_gpuscan_topn_slot", errorText(rc));
+		rc = gpuOptimalBlockSize(&__grid_sz,
+								 &topn_block_sz,
+								 kern_gpuscan_topn,
+								 CU_DEVICE_PER_THREAD,
+								 0, 0);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+		topn_block_sz = Min(topn_block_sz, GPUSCAN_TOPN_TILE_SZ / 2);
+	}
+
 	/*
 	 * Allocation of device memory
 	 *
@@ -2506,6 +4754,7 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 	/*
 	 * OK, enqueue a series of requests
 	 */
+	gpuTaskStageMark(GPUTASK_STAGE__QUEUE, CU_STREAM_PER_THREAD);
 	length = KERN_GPUSCAN_DMASEND_LENGTH(&gscan->kern);
 	rc = cuMemPrefetchAsync((CUdeviceptr)&gscan->kern,
 							length,
@@ -2513,6 +4762,7 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 							CU_STREAM_PER_THREAD);
 	if (rc != CUDA_SUCCESS)
 		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+	gpuTaskStageDma(length, 0);
 
 	/* kern_data_store *kds_src */
 	if (gscan->with_nvme_strom)
@@ -2521,12 +4771,22 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 	}
 	else if (pds_src->kds.format == KDS_FORMAT_BLOCK)
 	{
+		/* upload on the copy stream, then kernel waits for the event */
 		rc = cuMemcpyHtoDAsync(m_kds_src,
 							   &pds_src->kds,
 							   pds_src->kds.length,
-							   CU_STREAM_PER_THREAD);
+							   CU_STREAM_HTOD_PER_THREAD);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemcpyHtoDAsync: %s", errorText(rc));
+		gpuTaskStageDma(pds_src->kds.length, 0);
+		rc = cuEventRecord(CU_EVENT_HTOD_PER_THREAD,
+						   CU_STREAM_HTOD_PER_THREAD);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuEventRecord: %s", errorText(rc));
+		rc = cuStreamWaitEvent(CU_STREAM_PER_THREAD,
+							   CU_EVENT_HTOD_PER_THREAD, 0);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuStreamWaitEvent: %s", errorText(rc));
 	}
 	else if (pds_src->kds.format != KDS_FORMAT_COLUMN)
 	{
@@ -2536,6 +4796,7 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 								CU_STREAM_PER_THREAD);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		gpuTaskStageDma(pds_src->kds.length, 0);
 	}
 
 	/* head of the kds_dst, if any */
@@ -2548,6 +4809,7 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 								CU_STREAM_PER_THREAD);
 		if (rc != CUDA_SUCCESS)
 			werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+		gpuTaskStageDma(length, 0);
 	}
 
 	/*
@@ -2555,16 +4817,116 @@ __gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 	 * gpuscan_exec_quals_XXXX(kern_gpuscan *kgpuscan,
 	 *                         kern_data_store *kds_src,
 	 *                         kern_data_store *kds_dst)
+	 *
+	 * Block size of the kernel is autotuned on the first launches, unless
+	 * the 1st phase kernel of the late materialization runs together.
 	 */
-	rc = gpuOptimalBlockSize(&grid_sz,
-							 &block_sz,
-							 kern_gpuscan_quals,
-							 CU_DEVICE_PER_THREAD,
-							 0, sizeof(cl_int));
+	if (kern_gpuscan_selection)
+		rc = gpuOptimalBlockSize(&grid_sz,
+								 &block_sz,
+								 kern_gpuscan_quals,
+								 CU_DEVICE_PER_THREAD,
+								 0, sizeof(cl_int));
+	else
+		rc = gpuAutotuneBlockSize(&grid_sz,
+								  &block_sz,
+								  &autotune_trial,
+								  kern_gpuscan_quals,
+								  gscan->task.program_id,
+								  kern_fname,
+								  gcontext->cuda_dindex,
+								  0, sizeof(cl_int));
 	if (rc != CUDA_SUCCESS)
 		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
 	gscan->kern.grid_sz = grid_sz;
 	gscan->kern.block_sz = block_sz;
+	gscan->kern.recheck_nitems = 0;
+	/* kernel waits for the upload of kds_src, if any */
+	gpuTaskStageMark(GPUTASK_STAGE__DMA_SEND, CU_STREAM_PER_THREAD);
+
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpuscan_quals_block(kern_gpuscan *kgpuscan,
+	 *                          kern_data_store *kds_src,
+	 *                          kern_data_extra *__not_valid__,
+	 *                          kern_data_store *__not_valid__)
+	 *
+	 * 1st phase of the late materialization; it builds the result index
+	 * of the qualified rows, then the 2nd phase kernel makes projection
+	 * on the selected rows only.
+	 */
+	if (kern_gpuscan_selection)
+	{
+		gpuscanResultIndex *gs_results
+			= KERN_GPUSCAN_RESULT_INDEX(&gscan->kern);
+		cl_int		__grid_sz;
+		cl_int		__block_sz;
+
+		rc = gpuOptimalBlockSize(&__grid_sz,
+								 &__block_sz,
+								 kern_gpuscan_selection,
+								 CU_DEVICE_PER_THREAD,
+								 0, sizeof(cl_int));
+		if (rc != CUDA_SUCCESS)
+			werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+
+		gs_results->nitems = 0;
+		gscan->kern.nitems_in = 0;
+		gscan->kern.nitems_out = 0;
+		kern_args[0] = &m_gpuscan;
+		kern_args[1] = &m_kds_src;
+		kern_args[2] = &m_kds_extra;
+		kern_args[3] = &m_kds_dst;
+
+		rc = cuLaunchKernel(kern_gpuscan_selection,
+							__grid_sz, 1, 1,
+							__block_sz, 1, 1,
+							sizeof(cl_int) * 1024,
+							CU_STREAM_PER_THREAD,
+							kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuLaunchKernel: %s", errorText(rc));
+
+		rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuEventRecord: %s", errorText(rc));
+
+		/* Point of synchronization */
+		rc = cuEventSynchronize(CU_EVENT_PER_THREAD);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuEventSynchronize: %s", errorText(rc));
+
+		memcpy(&gscan->task.kerror,
+			   &((kern_gpuscan *)m_gpuscan)->kerror, sizeof(kern_errorbuf));
+		if (gscan->task.kerror.errcode != ERRCODE_STROM_SUCCESS)
+		{
+			retval = 0;
+			goto kernel_error;
+		}
+		else
+		{
+			GpuScanState	   *gss = (GpuScanState *)gscan->task.gts;
+			GpuScanRuntimeStat *gs_rtstat = gss->gs_rtstat;
+
+			/* update stat; 2nd phase kernel never filters rows */
+			nitems_in  = gscan->kern.nitems_in;
+			nitems_out = gscan->kern.nitems_out;
+			Assert(nitems_out == gs_results->nitems);
+			pg_atomic_add_fetch_u64(&gs_rtstat->c.source_nitems,
+									nitems_in);
+			pg_atomic_add_fetch_u64(&gs_rtstat->c.nitems_filtered,
+									nitems_in - nitems_out);
+			gpuscan_merge_qual_stat(gscan, gs_rtstat);
+		}
+	}
+	else if (gscan->with_selection_vector)
+	{
+		gpuscanResultIndex *gs_results
+			= KERN_GPUSCAN_RESULT_INDEX(&gscan->kern);
+
+		gs_results->nitems = 0;
+	}
 resume_kernel:
 	gscan->kern.nitems_in = 0;
 	gscan->kern.nitems_out = 0;
@@ -2574,16 +4936,54 @@ resume_kernel:
 	kern_args[1] = &m_kds_src;
 	kern_args[2] = &m_kds_extra;
 	kern_args[3] = &m_kds_dst;
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpuscan_topn_slot(kern_gpuscan *kgpuscan,
+	 *                        kern_data_store *kds_dst)
+	 *
+	 * It reduces the destination buffer to the top-N rows using a single
+	 * thread-block, prior to write back.
+	 */
+	topn_args[0] = &m_gpuscan;
+	topn_args[1] = &m_kds_dst;
 
-	rc = cuLaunchKernel(kern_gpuscan_quals,
-						grid_sz, 1, 1,
-						block_sz, 1, 1,
-						sizeof(cl_int) * 1024,
-						CU_STREAM_PER_THREAD,
-						kern_args,
-						NULL);
-	if (rc != CUDA_SUCCESS)
-		werror("failed on cuLaunchKernel: %s", errorText(rc));
+	if (gscan->with_cuda_graph)
+	{
+		gpuscan_launch_cuda_graph(gcontext,
+								  gscan->task.program_id,
+								  kern_gpuscan_quals,
+								  grid_sz, block_sz,
+								  kern_args,
+								  kern_gpuscan_topn,
+								  topn_block_sz,
+								  topn_args);
+	}
+	else
+	{
+		rc = cuLaunchKernel(kern_gpuscan_quals,
+							grid_sz, 1, 1,
+							block_sz, 1, 1,
+							sizeof(cl_int) * 1024,
+							CU_STREAM_PER_THREAD,
+							kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+			werror("failed on cuLaunchKernel: %s", errorText(rc));
+
+		if (kern_gpuscan_topn)
+		{
+			rc = cuLaunchKernel(kern_gpuscan_topn,
+								1, 1, 1,
+								topn_block_sz, 1, 1,
+								0,
+								CU_STREAM_PER_THREAD,
+								topn_args,
+								NULL);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuLaunchKernel: %s", errorText(rc));
+		}
+	}
+	gpuTaskStageMark(GPUTASK_STAGE__KERN_EXEC, CU_STREAM_PER_THREAD);
 
 	rc = cuEventRecord(CU_EVENT_PER_THREAD, CU_STREAM_PER_THREAD);
 	if (rc != CUDA_SUCCESS)
@@ -2608,14 +5008,35 @@ resume_kernel:
 		GpuScanState	   *gss = (GpuScanState *)gscan->task.gts;
 		GpuScanRuntimeStat *gs_rtstat = gss->gs_rtstat;
 
-		/* update stat */
-		pg_atomic_add_fetch_u64(&gs_rtstat->c.source_nitems,
-								nitems_in);
-		pg_atomic_add_fetch_u64(&gs_rtstat->c.nitems_filtered,
-								nitems_in - nitems_out);
+		/*
+		 * Report the kernel time to the autotuning of the block size, if
+		 * the whole chunk is processed by a launch.
+		 */
+		if (autotune_trial >= 0 &&
+			!gscan->kern.resume_context &&
+			gscan->kern.suspend_count == 0)
+		{
+			pgstrom_autotune_report(gscan->task.program_id,
+									kern_fname,
+									gcontext->cuda_dindex,
+									autotune_trial,
+									pds_src->kds.nitems,
+									gpuTaskStageElapsed(GPUTASK_STAGE__KERN_EXEC));
+		}
+
+		/* update stat, if not counted at the 1st phase */
+		if (!kern_gpuscan_selection)
+		{
+			pg_atomic_add_fetch_u64(&gs_rtstat->c.source_nitems,
+									nitems_in);
+			pg_atomic_add_fetch_u64(&gs_rtstat->c.nitems_filtered,
+									nitems_in - nitems_out);
+			gpuscan_merge_qual_stat(gscan, gs_rtstat);
+		}
 		if (!pds_dst)
 		{
-			/* may not use this code path no longer */
+			/* selection-vector mode; only positions of the rows */
+			Assert(gscan->with_selection_vector);
 			Assert(gscan->kern.extra_size == 0);
 
 			rc = cuMemPrefetchAsync((CUdeviceptr)
@@ -2626,16 +5047,28 @@ resume_kernel:
 									CU_STREAM_PER_THREAD);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+			gpuTaskStageDma(0, offsetof(gpuscanResultIndex,
+										results[nitems_out]));
 		}
 		else if (nitems_out > 0)
 		{
-			length = KERN_DATA_STORE_SLOT_LENGTH(&pds_dst->kds, nitems_out);
+			/*
+			 * Write back on the copy stream; the kernel is already done,
+			 * so the download of the partial result overlaps with the
+			 * resumed kernel below.
+			 */
+			length = KERN_DATA_STORE_SLOT_LENGTH(&pds_dst->kds,
+												 kern_gpuscan_topn
+												 ? Min(nitems_out,
+													   gscan->kern.topn_nrows)
+												 : nitems_out);
 			rc = cuMemPrefetchAsync((CUdeviceptr)&pds_dst->kds,
 									length,
 									CU_DEVICE_CPU,
-									CU_STREAM_PER_THREAD);
+									CU_STREAM_DTOH_PER_THREAD);
 			if (rc != CUDA_SUCCESS)
 				werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+			gpuTaskStageDma(0, length);
 
 			if (pds_dst->kds.usage > 0)
 			{
@@ -2644,12 +5077,22 @@ resume_kernel:
 				rc = cuMemPrefetchAsync((CUdeviceptr)(&pds_dst->kds) + offset,
 										length,
 										CU_DEVICE_CPU,
-										CU_STREAM_PER_THREAD);
+										CU_STREAM_DTOH_PER_THREAD);
 				if (rc != CUDA_SUCCESS)
 					werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+				gpuTaskStageDma(0, length);
 			}
 		}
 
+		/* no need to resume the kernel, if LIMIT hint is satisfied */
+		if (gscan->kern.suspend_count > 0 &&
+			gscan->kern.nrows_limit > 0)
+		{
+			if (nitems_out >= gscan->kern.nrows_limit)
+				gscan->kern.suspend_count = 0;
+			else
+				gscan->kern.nrows_limit -= nitems_out;
+		}
 		/* resume gpuscan kernel, if suspended */
 		if (gscan->kern.suspend_count > 0)
 		{
@@ -2664,6 +5107,14 @@ resume_kernel:
 			gscan->kern.resume_context = true;
 			gscan->pds_dst = pds_dst;
 			m_kds_dst = (CUdeviceptr)&pds_dst->kds;
+			/*
+			 * results of the prior chunks in the batch, if any, are also
+			 * returned by the partial result above; so the new buffer has
+			 * no rows that should be kept on CPU fallback.
+			 */
+			gscan->batch_pds_dst = pds_dst;
+			gscan->batch_dst_nitems = 0;
+			gscan->batch_dst_usage = 0;
 			/*
 			 * MEMO: current suspended context must be saved, because
 			 * resumed kernel invocation may return CpuReCheck error.
@@ -2675,11 +5126,38 @@ resume_kernel:
 				last_suspend = alloca(gscan->kern.suspend_sz);
 			temp = KERN_GPUSCAN_SUSPEND_CONTEXT(&gscan->kern, 0);
 			memcpy(last_suspend, temp, gscan->kern.suspend_sz);
+			last_recheck_nitems = gscan->kern.recheck_nitems;
+			/*
+			 * download of the partial result overlaps with the resumed
+			 * kernel, so only the kernel time is measured.
+			 */
+			gpuTaskStageUpdate(&gscan->task);
+			gpuTaskStageMark(GPUTASK_STAGE__DMA_SEND, CU_STREAM_PER_THREAD);
 			goto resume_kernel;
 		}
+		gpuTaskStageMark(GPUTASK_STAGE__DMA_RECV,
+						 pds_dst ? CU_STREAM_DTOH_PER_THREAD
+								 : CU_STREAM_PER_THREAD);
+
+		/*
+		 * Rows to be rechecked by CPU are fetched from the host buffer,
+		 * so the blocks loaded by NVMe-Strom must be written back.
+		 */
+		if (gscan->kern.recheck_nitems > 0 &&
+			pds_src->kds.format == KDS_FORMAT_BLOCK &&
+			pds_src->nblocks_uncached > 0)
+		{
+			rc = cuMemcpyDtoH(&pds_src->kds,
+							  m_kds_src,
+							  pds_src->kds.length);
+			if (rc != CUDA_SUCCESS)
+				werror("failed on cuMemcpyDtoH: %s", errorText(rc));
+			pds_src->nblocks_uncached = 0;
+		}
 	}
 	else
 	{
+	kernel_error:
 		if (pgstrom_cpu_fallback_enabled &&
 			(gscan->task.kerror.errcode & ERRCODE_FLAGS_CPU_FALLBACK) != 0)
 		{
@@ -2714,9 +5192,22 @@ resume_kernel:
 
 				memcpy(temp, last_suspend, gscan->kern.suspend_sz);
 			}
+			/*
+			 * rows recorded prior to the last suspend are still rechecked;
+			 * the fallback restarts from the suspended point.
+			 */
+			gscan->kern.recheck_nitems = last_recheck_nitems;
 		}
 	}
 out_of_resource:
+	/* ensure the write back of the results, and the upload being completed */
+	rc = cuStreamSynchronize(CU_STREAM_DTOH_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuStreamSynchronize: %s", errorText(rc));
+	rc = cuStreamSynchronize(CU_STREAM_HTOD_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuStreamSynchronize: %s", errorText(rc));
+	gpuTaskStageUpdate(&gscan->task);
 	if (m_kds_src_release)
 		gpuMemFree(gcontext, m_kds_src);
 	return retval;
@@ -2752,6 +5243,33 @@ gpuscan_process_task(GpuTask *gtask, CUmodule cuda_module)
 			gcache_mapped = true;
 		}
 		retval = __gpuscan_process_task(gtask, cuda_module);
+		/* run the following chunks in the batch, if any */
+		while (retval == 0 &&
+			   gscan->curr_batch + 1 < gscan->nr_batch &&
+			   gscan->task.kerror.errcode == ERRCODE_STROM_SUCCESS &&
+			   !gscan->task.cpu_fallback)
+		{
+			CHECK_WORKER_TERMINATION();
+			gpuscan_switch_batch_chunk(gscan);
+			retval = __gpuscan_process_task(gtask, cuda_module);
+		}
+		/*
+		 * In case of CPU fallback on the middle of the batch, the results
+		 * of the prior chunks are returned as a partial result, then CPU
+		 * fallback runs on the rest of chunks.
+		 */
+		if (gscan->task.cpu_fallback &&
+			gscan->curr_batch > 0 &&
+			gscan->batch_dst_nitems > 0)
+		{
+			pgstrom_data_store *pds_dst = gscan->pds_dst;
+
+			Assert(pds_dst != NULL && pds_dst == gscan->batch_pds_dst);
+			pds_dst->kds.nitems = gscan->batch_dst_nitems;
+			pds_dst->kds.usage  = gscan->batch_dst_usage;
+			gscan->pds_dst = PDS_clone(pds_dst);
+			gpuscan_throw_partial_result(gscan, pds_dst);
+		}
 	}
 	STROM_CATCH();
     {
@@ -2775,10 +5293,18 @@ gpuscan_release_task(GpuTask *gtask)
 	GpuScanTask	   *gscan = (GpuScanTask *) gtask;
 	GpuTaskState   *gts = gscan->task.gts;
 
+	cl_int			i;
+
 	if (gscan->pds_src)
 		PDS_release(gscan->pds_src);
 	if (gscan->pds_dst)
 		PDS_release(gscan->pds_dst);
+	/* chunks in the batch not processed yet, if any */
+	for (i = gscan->curr_batch + 1; i < gscan->nr_batch; i++)
+	{
+		if (gscan->pds_batch[i])
+			PDS_release(gscan->pds_batch[i]);
+	}
 	gpuMemFree(gts->gcontext, (CUdeviceptr) gscan);
 }
 
@@ -2797,6 +5323,89 @@ pgstrom_init_gpuscan(void)
 							 PGC_USERSET,
 							 GUC_NOT_IN_SAMPLE,
 							 NULL, NULL, NULL);
+	/* pg_strom.gpuscan_late_materialization */
+	DefineCustomBoolVariable("pg_strom.gpuscan_late_materialization",
+							 "Enables the 2-phase projection of GpuScan on heap tables",
+							 NULL,
+							 &enable_gpuscan_late_materialization,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpuscan_selection_vector */
+	DefineCustomBoolVariable("pg_strom.gpuscan_selection_vector",
+							 "Enables GpuScan to return positions of the rows, if no device projection",
+							 NULL,
+							 &enable_gpuscan_selection_vector,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpuscan_topn */
+	DefineCustomBoolVariable("pg_strom.gpuscan_topn",
+							 "Enables GpuScan to pick up the top-N rows on the device for ORDER BY with LIMIT",
+							 NULL,
+							 &enable_gpuscan_topn,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpuscan_cuda_graph */
+	DefineCustomBoolVariable("pg_strom.gpuscan_cuda_graph",
+							 "Enables GpuScan to launch the GPU kernels using CUDA graph",
+							 NULL,
+							 &enable_gpuscan_cuda_graph,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpuscan_adaptive_quals */
+	DefineCustomBoolVariable("pg_strom.gpuscan_adaptive_quals",
+							 "Enables GpuScan to reorder device qualifiers according to the observed selectivity",
+							 NULL,
+							 &enable_gpuscan_adaptive_quals,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpuscan_bloom_filter */
+	DefineCustomBoolVariable("pg_strom.gpuscan_bloom_filter",
+							 "Enables GpuScan to use bloom-filter pushed down from the parent GpuJoin",
+							 NULL,
+							 &enable_gpuscan_bloom_filter,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpuscan_simple_kernel */
+	DefineCustomBoolVariable("pg_strom.gpuscan_simple_kernel",
+							 "Enables GpuScan to use the precompiled GPU kernel for simple scan qualifiers",
+							 NULL,
+							 &enable_gpuscan_simple_kernel,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.append_gpu_fanout */
+	DefineCustomBoolVariable("pg_strom.append_gpu_fanout",
+							 "Enables GpuScan children of Append to run concurrently on their own GPUs",
+							 NULL,
+							 &enable_append_gpu_fanout,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpuscan_batch_size */
+	DefineCustomIntVariable("pg_strom.gpuscan_batch_size",
+							"Size target of the source chunks per GpuScan task",
+							"Small record-batches of Arrow_Fdw are coalesced into a GpuScan task up to this size (0 = disabled)",
+							&gpuscan_batch_size_kb,
+							0,
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE | GUC_UNIT_KB,
+							NULL, NULL, NULL);
 	/* pg_strom.pullup_outer_scan */
 	DefineCustomBoolVariable("pg_strom.pullup_outer_scan",
 							 "Enables to pull up simple outer scan",
@@ -0,0 +1,1198 @@
+/*
+ * gpusort.c
+ *
+ * GPU accelerated sorting for ORDER BY clause
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include "pg_strom.h"
+#include "lib/binaryheap.h"
+#include "cuda_gpusort.h"
+
+/*
+ * GpuSort sorts the rows of the outer input chunk-by-chunk using the radix
+ * sort kernels on GPU (cuda_gpusort_radix.fatbin), then merges the sorted
+ * chunks on the host by the normalized keys built by GPU. The keys must be
+ * fixed-length and pass-by-value columns, ordered by the default btree
+ * operator class.
+ * If outer node is GpuScan or GpuJoin, GpuSort reads their result buffers
+ * as is, without any tuple-by-tuple copy. Elsewhere, the rows are copied
+ * to the row-format buffers.
+ * Note that all the chunks are kept until end of the scan; GpuSort never
+ * spills out the chunks to the temporary files, unlike tuplesort.
+ */
+static create_upper_paths_hook_type create_upper_paths_next = NULL;
+static CustomPathMethods	gpusort_path_methods;
+static CustomScanMethods	gpusort_scan_methods;
+static CustomExecMethods	gpusort_exec_methods;
+static bool					enable_gpusort;		/* GUC */
+
+/*
+ * GpuSortInfo - private information of GpuSort plan
+ */
+typedef struct
+{
+	List	   *sort_colidx;		/* column index of the keys */
+	List	   *sort_kind;			/* one of GPUSORT_KEY__* */
+	List	   *sort_desc;			/* true, if DESC */
+	List	   *sort_nulls_first;	/* true, if NULLS FIRST */
+	List	   *sort_keys;			/* expression of the keys (for EXPLAIN) */
+} GpuSortInfo;
+
+static inline void
+form_gpusort_info(CustomScan *cscan, GpuSortInfo *gsort_info)
+{
+	List	   *privs = NIL;
+	List	   *exprs = NIL;
+
+	privs = lappend(privs, gsort_info->sort_colidx);
+	privs = lappend(privs, gsort_info->sort_kind);
+	privs = lappend(privs, gsort_info->sort_desc);
+	privs = lappend(privs, gsort_info->sort_nulls_first);
+	exprs = lappend(exprs, gsort_info->sort_keys);
+
+	cscan->custom_private = privs;
+	cscan->custom_exprs = exprs;
+}
+
+static inline GpuSortInfo *
+deform_gpusort_info(CustomScan *cscan)
+{
+	GpuSortInfo *gsort_info = palloc0(sizeof(GpuSortInfo));
+	List	   *privs = cscan->custom_private;
+	List	   *exprs = cscan->custom_exprs;
+	int			pindex = 0;
+	int			eindex = 0;
+
+	gsort_info->sort_colidx = list_nth(privs, pindex++);
+	gsort_info->sort_kind = list_nth(privs, pindex++);
+	gsort_info->sort_desc = list_nth(privs, pindex++);
+	gsort_info->sort_nulls_first = list_nth(privs, pindex++);
+	gsort_info->sort_keys = list_nth(exprs, eindex++);
+
+	return gsort_info;
+}
+
+/*
+ * GpuSortTask - a sorted chunk
+ */
+typedef struct
+{
+	GpuTask			task;
+	GpuTask		   *outer_task;	/* outer task that owns pds_src, if any */
+	pgstrom_data_store *pds_src;
+	cl_uint			curr_pos;	/* current position of the merge */
+	kern_gpusort_radix kern;
+} GpuSortTask;
+
+/*
+ * GpuSortState - execution state of GpuSort
+ */
+typedef struct
+{
+	GpuTaskState	gts;
+	cl_uint			nkeys;
+	gpusortRadixKey	keys[GPUSORT_RADIX_MAX_KEYS];
+	/* outer input */
+	GpuTaskState   *outer_gts;		/* GpuScan/GpuJoin to read chunks */
+	bool			outer_done;
+	pgstrom_data_store *pds_curr;	/* row buffer being filled */
+	List		   *pds_pending;	/* row buffers already filled */
+	/* sorted chunks */
+	bool			sort_done;
+	cl_int			num_chunks;
+	cl_int			max_chunks;
+	GpuSortTask	  **chunks;
+	binaryheap	   *merge_heap;
+	bool			merge_ready;
+} GpuSortState;
+
+/*
+ * gpusort_build_sort_keys
+ *
+ * It checks whether the sort keys are references to the columns of the
+ * input target, with fixed-length numeric types and the default ordering.
+ */
+static bool
+gpusort_build_sort_keys(PlannerInfo *root,
+						PathTarget *target,
+						GpuSortInfo *gsort_info,
+						int *p_num_passes)
+{
+	int			num_passes = 0;
+	ListCell   *lc1, *lc2, *lc3;
+
+	if (list_length(root->sort_pathkeys) > GPUSORT_RADIX_MAX_KEYS)
+		return false;
+	foreach (lc1, root->sort_pathkeys)
+	{
+		PathKey	   *pkey = lfirst(lc1);
+		EquivalenceClass *ec = pkey->pk_eclass;
+		TypeCacheEntry *tcache;
+		Expr	   *key = NULL;
+		Oid			type_oid;
+		int			colidx = -1;
+		int			kind;
+
+		if (ec->ec_has_volatile)
+			return false;
+		foreach (lc2, ec->ec_members)
+		{
+			EquivalenceMember *em = lfirst(lc2);
+			int			i = 0;
+
+			if (em->em_is_const)
+				continue;
+			foreach (lc3, target->exprs)
+			{
+				if (equal(em->em_expr, lfirst(lc3)))
+				{
+					key = em->em_expr;
+					colidx = i;
+					break;
+				}
+				i++;
+			}
+			if (key)
+				break;
+		}
+		if (!key)
+			return false;
+
+		type_oid = exprType((Node *)key);
+		switch (type_oid)
+		{
+			case INT2OID:
+				kind = GPUSORT_KEY__INT16;
+				break;
+			case INT4OID:
+			case DATEOID:
+				kind = GPUSORT_KEY__INT32;
+				break;
+			case INT8OID:
+			case TIMEOID:
+			case TIMESTAMPOID:
+			case TIMESTAMPTZOID:
+				kind = GPUSORT_KEY__INT64;
+				break;
+			case FLOAT4OID:
+				kind = GPUSORT_KEY__FLOAT32;
+				break;
+			case FLOAT8OID:
+				kind = GPUSORT_KEY__FLOAT64;
+				break;
+			default:
+				return false;
+		}
+		/* only default btree ordering is supported */
+		tcache = lookup_type_cache(type_oid, TYPECACHE_LT_OPR);
+		if (get_opfamily_member(pkey->pk_opfamily,
+								type_oid, type_oid,
+								BTLessStrategyNumber) != tcache->lt_opr)
+			return false;
+
+		gsort_info->sort_colidx = lappend_int(gsort_info->sort_colidx, colidx);
+		gsort_info->sort_kind = lappend_int(gsort_info->sort_kind, kind);
+		gsort_info->sort_desc = lappend_int(gsort_info->sort_desc,
+											pkey->pk_strategy ==
+											BTGreaterStrategyNumber);
+		gsort_info->sort_nulls_first = lappend_int(gsort_info->sort_nulls_first,
+												   pkey->pk_nulls_first);
+		gsort_info->sort_keys = lappend(gsort_info->sort_keys, key);
+		/* byte-wise passes of the key, and a pass for NULLs */
+		num_passes += gpusort_radix_key_nbytes(kind) + 1;
+	}
+	*p_num_passes = num_passes;
+
+	return true;
+}
+
+/*
+ * gpusort_add_ordered_paths
+ */
+static void
+gpusort_add_ordered_paths(PlannerInfo *root,
+						  UpperRelationKind stage,
+						  RelOptInfo *input_rel,
+						  RelOptInfo *ordered_rel,
+						  void *extra)
+{
+	Path	   *input_path;
+	Path	   *sort_path;
+	PathTarget *final_target;
+	CustomPath *cpath;
+	GpuSortInfo *gsort_info;
+	double		ntuples;
+	cl_uint		num_chunks;
+	int			num_passes;
+	double		gpu_setup_cost;
+	double		gpu_dma_cost;
+	double		gpu_operator_cost;
+	Cost		startup_cost;
+
+	if (create_upper_paths_next)
+		(*create_upper_paths_next)(root, stage, input_rel, ordered_rel, extra);
+
+	if (stage != UPPERREL_ORDERED)
+		return;
+
+	if (!pgstrom_enabled || !enable_gpusort)
+		return;
+
+	/* CREATE EXTENSION pg_strom; was not executed */
+	if (get_namespace_oid("pgstrom", true) == InvalidOid)
+		return;
+
+	input_path = input_rel->cheapest_total_path;
+	if (pathkeys_contained_in(root->sort_pathkeys, input_path->pathkeys))
+		return;
+	gsort_info = palloc0(sizeof(GpuSortInfo));
+	if (!gpusort_build_sort_keys(root, input_path->pathtarget,
+								 gsort_info, &num_passes))
+		return;
+
+	/*
+	 * Estimation of the cost; radix sort on GPU is linear to the number of
+	 * rows and passes, then the host merges the sorted chunks.
+	 */
+	pgstrom_gpu_cost_factors(&gpu_setup_cost,
+							 &gpu_dma_cost,
+							 &gpu_operator_cost);
+	ntuples = input_path->rows;
+	num_chunks = estimate_num_chunks(input_path);
+	startup_cost = (input_path->total_cost +
+					gpu_setup_cost +
+					gpu_dma_cost * num_chunks +
+					gpu_operator_cost * ntuples * num_passes);
+	if (num_chunks > 1)
+		startup_cost += 2.0 * cpu_operator_cost * ntuples * log2(num_chunks);
+	if (!pgstrom_path_is_gpuscan(input_path) &&
+		!pgstrom_path_is_gpujoin(input_path))
+		startup_cost += cpu_tuple_cost * ntuples;	/* copy to the buffer */
+
+	cpath = makeNode(CustomPath);
+	cpath->path.pathtype = T_CustomScan;
+	cpath->path.parent = ordered_rel;
+	cpath->path.pathtarget = input_path->pathtarget;
+	cpath->path.param_info = NULL;
+	cpath->path.parallel_aware = false;
+	cpath->path.parallel_safe = false;
+	cpath->path.parallel_workers = 0;
+	cpath->path.rows = ntuples;
+	cpath->path.startup_cost = startup_cost;
+	cpath->path.total_cost = startup_cost + cpu_tuple_cost * ntuples;
+	cpath->path.pathkeys = root->sort_pathkeys;
+	cpath->flags = 0;
+	cpath->custom_paths = list_make1(input_path);
+	cpath->custom_private = list_make1(gsort_info);
+	cpath->methods = &gpusort_path_methods;
+
+	sort_path = &cpath->path;
+	final_target = root->upper_targets[UPPERREL_FINAL];
+	if (final_target && sort_path->pathtarget != final_target)
+		sort_path = (Path *) apply_projection_to_path(root, ordered_rel,
+													  sort_path,
+													  final_target);
+	add_path(ordered_rel, sort_path);
+}
+
+/*
+ * PlanGpuSortPath
+ */
+static Plan *
+PlanGpuSortPath(PlannerInfo *root,
+				RelOptInfo *rel,
+				CustomPath *best_path,
+				List *tlist,
+				List *clauses,
+				List *custom_plans)
+{
+	CustomScan	   *cscan = makeNode(CustomScan);
+	GpuSortInfo	   *gsort_info;
+	Plan		   *outer_plan;
+	List		   *scan_tlist = NIL;
+	ListCell	   *lc;
+
+	Assert(list_length(best_path->custom_private) == 1);
+	gsort_info = linitial(best_path->custom_private);
+	Assert(list_length(custom_plans) == 1);
+	outer_plan = linitial(custom_plans);
+
+	/* scan tuple has the same layout with the outer tuple */
+	foreach (lc, outer_plan->targetlist)
+	{
+		TargetEntry *tle = lfirst(lc);
+
+		scan_tlist = lappend(scan_tlist,
+							 makeTargetEntry(copyObject(tle->expr),
+											 list_length(scan_tlist) + 1,
+											 tle->resname ? pstrdup(tle->resname) : NULL,
+											 false));
+	}
+	/* setup CustomScan node */
+	cscan->scan.plan.targetlist = tlist;
+	cscan->scan.plan.qual = NIL;
+	outerPlan(cscan) = outer_plan;
+	cscan->scan.scanrelid = 0;
+	cscan->flags = best_path->flags;
+	cscan->methods = &gpusort_scan_methods;
+	cscan->custom_scan_tlist = scan_tlist;
+	form_gpusort_info(cscan, gsort_info);
+
+	return &cscan->scan.plan;
+}
+
+/*
+ * pgstrom_plan_is_gpusort - returns true if GpuSort
+ */
+bool
+pgstrom_plan_is_gpusort(const Plan *plan)
+{
+	if (IsA(plan, CustomScan) &&
+		((CustomScan *) plan)->methods == &gpusort_scan_methods)
+		return true;
+	return false;
+}
+
+/*
+ * pgstrom_planstate_is_gpusort - returns true if GpuSortState
+ */
+bool
+pgstrom_planstate_is_gpusort(const PlanState *ps)
+{
+	if (IsA(ps, CustomScanState) &&
+		((CustomScanState *) ps)->methods == &gpusort_exec_methods)
+		return true;
+	return false;
+}
+
+/*
+ * CreateGpuSortScanState
+ */
+static Node *
+CreateGpuSortScanState(CustomScan *cscan)
+{
+	/*
+	 * NOTE: GpuSortState is allocated on CurTransactionContext, like other
+	 * GpuTaskState, because worker threads may reference it.
+	 */
+	GpuSortState   *gss = MemoryContextAllocZero(CurTransactionContext,
+												 sizeof(GpuSortState));
+	/* Set tag and executor callbacks */
+	NodeSetTag(gss, T_CustomScanState);
+	gss->gts.css.flags = cscan->flags;
+	gss->gts.css.methods = &gpusort_exec_methods;
+
+	return (Node *) gss;
+}
+
+/*
+ * gpusort_insert_tuple
+ *
+ * It copies the tuple to the row buffer; the buffer filled up is returned,
+ * if any.
+ */
+static pgstrom_data_store *
+gpusort_insert_tuple(GpuSortState *gss, TupleTableSlot *slot)
+{
+	pgstrom_data_store *pds_full;
+
+	if (gss->pds_curr && PDS_insert_tuple(gss->pds_curr, slot))
+		return NULL;
+	pds_full = gss->pds_curr;
+	gss->pds_curr = PDS_create_row(gss->gts.gcontext,
+								   gss->gts.css.ss.ss_ScanTupleSlot->tts_tupleDescriptor,
+								   pgstrom_chunk_size());
+	if (!PDS_insert_tuple(gss->pds_curr, slot))
+		elog(ERROR, "GpuSort: tuple is too large to store in a chunk");
+	return pds_full;
+}
+
+/*
+ * gpusort_fetch_outer_chunk
+ *
+ * It returns the next chunk of the outer input. *p_outer_task is set, if
+ * the chunk is the result buffer of the outer task that must be kept.
+ */
+static pgstrom_data_store *
+gpusort_fetch_outer_chunk(GpuSortState *gss, GpuTask **p_outer_task)
+{
+	PlanState	   *outer_ps = outerPlanState(gss);
+	GpuTaskState   *outer_gts = gss->outer_gts;
+	TupleTableSlot *slot;
+	pgstrom_data_store *pds;
+
+	*p_outer_task = NULL;
+	while (gss->pds_pending == NIL && !gss->outer_done)
+	{
+		if (outer_gts)
+		{
+			GpuTask	   *gtask;
+			pgstrom_data_store *pds_dst = NULL;
+
+			if (outer_ps->instrument)
+				InstrStartNode(outer_ps->instrument);
+			if (pgstrom_planstate_is_gpuscan(outer_ps))
+				gtask = GpuScanExecResultChunk(outer_gts, &pds_dst);
+			else
+				gtask = GpuJoinExecResultChunk(outer_gts, &pds_dst);
+			if (!gtask)
+			{
+				if (outer_ps->instrument)
+					InstrStopNode(outer_ps->instrument, 0.0);
+				gss->outer_done = true;
+				break;
+			}
+			outer_gts->curr_task = gtask;
+			outer_gts->curr_index = 0;
+			outer_gts->curr_lp_index = 0;
+			if (outer_gts->cb_switch_task)
+				outer_gts->cb_switch_task(outer_gts, gtask);
+
+			if (pds_dst)
+			{
+				/* read the result buffer as is */
+				outer_gts->curr_task = NULL;
+				if (outer_ps->instrument)
+					InstrStopNode(outer_ps->instrument,
+								  (double) pds_dst->kds.nitems);
+				if (pds_dst->kds.nitems == 0)
+				{
+					outer_gts->cb_release_task(gtask);
+					continue;
+				}
+				pds = PDS_retain(pds_dst);
+				/*
+				 * KDS_FORMAT_SLOT may reference the source buffer by the
+				 * varlena datum, so the outer task is kept.
+				 */
+				if (pds->kds.format == KDS_FORMAT_ROW)
+					outer_gts->cb_release_task(gtask);
+				else
+					*p_outer_task = gtask;
+				return pds;
+			}
+			/* elsewhere, rows are fetched by the outer node (CPU fallback) */
+			while ((slot = outer_gts->cb_next_tuple(outer_gts)) != NULL)
+			{
+				if (outer_ps->instrument)
+					outer_ps->instrument->tuplecount += 1.0;
+				pds = gpusort_insert_tuple(gss, slot);
+				if (pds)
+					gss->pds_pending = lappend(gss->pds_pending, pds);
+			}
+			outer_gts->cb_release_task(gtask);
+			outer_gts->curr_task = NULL;
+			if (outer_ps->instrument)
+				InstrStopNode(outer_ps->instrument, 0.0);
+		}
+		else
+		{
+			slot = ExecProcNode(outer_ps);
+			if (TupIsNull(slot))
+			{
+				gss->outer_done = true;
+				break;
+			}
+			pds = gpusort_insert_tuple(gss, slot);
+			if (pds)
+				gss->pds_pending = lappend(gss->pds_pending, pds);
+		}
+	}
+
+	if (gss->pds_pending != NIL)
+	{
+		pds = linitial(gss->pds_pending);
+		gss->pds_pending = list_delete_first(gss->pds_pending);
+		return pds;
+	}
+	/* the last row buffer being filled */
+	Assert(gss->outer_done);
+	pds = gss->pds_curr;
+	gss->pds_curr = NULL;
+	if (pds && pds->kds.nitems == 0)
+	{
+		PDS_release(pds);
+		pds = NULL;
+	}
+	return pds;
+}
+
+/*
+ * gpusort_next_task
+ */
+static GpuTask *
+gpusort_next_task(GpuTaskState *gts)
+{
+	GpuSortState   *gss = (GpuSortState *) gts;
+	GpuContext	   *gcontext = gss->gts.gcontext;
+	GpuSortTask	   *gsort;
+	GpuTask		   *outer_task;
+	pgstrom_data_store *pds_src;
+	kern_gpusort_radix *kradix;
+	CUdeviceptr		m_deviceptr;
+	cl_uint			nitems;
+	cl_uint			ntiles;
+	size_t			head_sz;
+	size_t			keys_sz;
+	size_t			index_sz;
+	size_t			hist_sz;
+	CUresult		rc;
+
+	pds_src = gpusort_fetch_outer_chunk(gss, &outer_task);
+	if (!pds_src)
+		return NULL;
+	Assert(pds_src->kds.format == KDS_FORMAT_ROW ||
+		   pds_src->kds.format == KDS_FORMAT_SLOT);
+	nitems = pds_src->kds.nitems;
+	ntiles = GPUSORT_RADIX_NTILES(nitems);
+
+	/*
+	 * allocation of GpuSortTask; normalized keys, row index x2 and histogram
+	 */
+	head_sz = STROMALIGN(offsetof(GpuSortTask, kern) +
+						 sizeof(kern_gpusort_radix));
+	keys_sz = STROMALIGN(sizeof(cl_ulong) * (gss->nkeys + 1) * nitems);
+	index_sz = STROMALIGN(sizeof(cl_uint) * nitems);
+	hist_sz = STROMALIGN(sizeof(cl_uint) * GPUSORT_RADIX_NBINS * ntiles);
+	rc = gpuMemAllocManaged(gcontext,
+							&m_deviceptr,
+							head_sz + keys_sz + 2 * index_sz + hist_sz,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	gsort = (GpuSortTask *) m_deviceptr;
+	memset(gsort, 0, head_sz);
+	pgstromInitGpuTask(&gss->gts, &gsort->task);
+	gsort->outer_task = outer_task;
+	gsort->pds_src = pds_src;
+	gsort->curr_pos = 0;
+
+	kradix = &gsort->kern;
+	kradix->nitems = nitems;
+	kradix->ntiles = ntiles;
+	kradix->nkeys = gss->nkeys;
+	kradix->curr = 0;
+	kradix->pass_skip = true;
+	memcpy(kradix->keys, gss->keys, sizeof(gpusortRadixKey) * gss->nkeys);
+	kradix->keys_offset = head_sz - offsetof(GpuSortTask, kern);
+	kradix->index_offset[0] = kradix->keys_offset + keys_sz;
+	kradix->index_offset[1] = kradix->index_offset[0] + index_sz;
+	kradix->hist_offset = kradix->index_offset[1] + index_sz;
+
+	return &gsort->task;
+}
+
+/*
+ * __gpusort_radix_pass
+ */
+static void
+__gpusort_radix_pass(CUfunction kern_histogram,
+					 CUfunction kern_prefix,
+					 CUfunction kern_scatter,
+					 cl_int prefix_block_sz,
+					 CUdeviceptr m_kradix,
+					 cl_uint ntiles,
+					 cl_uint word, cl_uint shift, cl_uint mask)
+{
+	void	   *kern_args[4];
+	CUresult	rc;
+
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpusort_radix_histogram(kern_gpusort_radix *kradix,
+	 *                              cl_uint word, cl_uint shift, cl_uint mask)
+	 */
+	kern_args[0] = &m_kradix;
+	kern_args[1] = &word;
+	kern_args[2] = &shift;
+	kern_args[3] = &mask;
+	rc = cuLaunchKernel(kern_histogram,
+						ntiles, 1, 1,
+						GPUSORT_RADIX_BLOCKSZ, 1, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuLaunchKernel: %s", errorText(rc));
+
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpusort_radix_prefix(kern_gpusort_radix *kradix)
+	 */
+	rc = cuLaunchKernel(kern_prefix,
+						1, 1, 1,
+						prefix_block_sz, 1, 1,
+						sizeof(cl_uint) * prefix_block_sz,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuLaunchKernel: %s", errorText(rc));
+
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpusort_radix_scatter(kern_gpusort_radix *kradix,
+	 *                            cl_uint word, cl_uint shift, cl_uint mask)
+	 */
+	rc = cuLaunchKernel(kern_scatter,
+						ntiles, 1, 1,
+						GPUSORT_RADIX_BLOCKSZ, 1, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuLaunchKernel: %s", errorText(rc));
+}
+
+/*
+ * gpusort_process_task
+ */
+static int
+gpusort_process_task(GpuTask *gtask, CUmodule cuda_module)
+{
+	GpuSortTask	   *gsort = (GpuSortTask *) gtask;
+	kern_gpusort_radix *kradix = &gsort->kern;
+	pgstrom_data_store *pds_src = gsort->pds_src;
+	CUfunction		kern_setup;
+	CUfunction		kern_histogram;
+	CUfunction		kern_prefix;
+	CUfunction		kern_scatter;
+	CUdeviceptr		m_kradix = (CUdeviceptr) kradix;
+	CUdeviceptr		m_kds_src = (CUdeviceptr) &pds_src->kds;
+	void		   *kern_args[2];
+	cl_int			grid_sz;
+	cl_int			block_sz;
+	cl_int			prefix_block_sz;
+	cl_int			i, j, nbytes;
+	CUresult		rc;
+
+	/*
+	 * Lookup GPU kernel functions
+	 */
+	rc = cuModuleGetFunction(&kern_setup, cuda_module,
+							 "kern_gpusort_radix_setup");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction('%s'): %s",
+			   "kern_gpusort_radix_setup", errorText(rc));
+	rc = cuModuleGetFunction(&kern_histogram, cuda_module,
+							 "kern_gpusort_radix_histogram");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction('%s'): %s",
+			   "kern_gpusort_radix_histogram", errorText(rc));
+	rc = cuModuleGetFunction(&kern_prefix, cuda_module,
+							 "kern_gpusort_radix_prefix");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction('%s'): %s",
+			   "kern_gpusort_radix_prefix", errorText(rc));
+	rc = cuModuleGetFunction(&kern_scatter, cuda_module,
+							 "kern_gpusort_radix_scatter");
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuModuleGetFunction('%s'): %s",
+			   "kern_gpusort_radix_scatter", errorText(rc));
+
+	/*
+	 * OK, enqueue a series of requests
+	 */
+	rc = cuMemPrefetchAsync(m_kradix,
+							sizeof(kern_gpusort_radix),
+							CU_DEVICE_PER_THREAD,
+							CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+	rc = cuMemPrefetchAsync(m_kds_src,
+							pds_src->kds.length,
+							CU_DEVICE_PER_THREAD,
+							CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+
+	/*
+	 * KERNEL_FUNCTION(void)
+	 * kern_gpusort_radix_setup(kern_gpusort_radix *kradix,
+	 *                          kern_data_store *kds_src)
+	 */
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &block_sz,
+							 kern_setup,
+							 CU_DEVICE_PER_THREAD,
+							 0, 0);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+	kern_args[0] = &m_kradix;
+	kern_args[1] = &m_kds_src;
+	rc = cuLaunchKernel(kern_setup,
+						grid_sz, 1, 1,
+						block_sz, 1, 1,
+						0,
+						CU_STREAM_PER_THREAD,
+						kern_args,
+						NULL);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuLaunchKernel: %s", errorText(rc));
+
+	rc = gpuOptimalBlockSize(&grid_sz,
+							 &prefix_block_sz,
+							 kern_prefix,
+							 CU_DEVICE_PER_THREAD,
+							 0, sizeof(cl_uint));
+	if (rc != CUDA_SUCCESS)
+		werror("failed on gpuOptimalBlockSize: %s", errorText(rc));
+
+	/*
+	 * LSD radix sort; from the least significant key, a byte-wise pass for
+	 * each byte of the normalized key, then a pass for NULLs.
+	 */
+	for (i = kradix->nkeys - 1; i >= 0; i--)
+	{
+		nbytes = gpusort_radix_key_nbytes(kradix->keys[i].kind);
+		for (j=0; j < nbytes; j++)
+		{
+			__gpusort_radix_pass(kern_histogram,
+								 kern_prefix,
+								 kern_scatter,
+								 prefix_block_sz,
+								 m_kradix,
+								 kradix->ntiles,
+								 i, j * GPUSORT_RADIX_BITS,
+								 GPUSORT_RADIX_NBINS - 1);
+		}
+		__gpusort_radix_pass(kern_histogram,
+							 kern_prefix,
+							 kern_scatter,
+							 prefix_block_sz,
+							 m_kradix,
+							 kradix->ntiles,
+							 kradix->nkeys, i, 1);
+	}
+
+	/* Point of synchronization */
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuStreamSynchronize: %s", errorText(rc));
+
+	/* write back the sorted index and the keys for the host merge */
+	rc = cuMemPrefetchAsync((CUdeviceptr)KERN_GPUSORT_RADIX_RESULT(kradix),
+							sizeof(cl_uint) * kradix->nitems,
+							CU_DEVICE_CPU,
+							CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+	rc = cuMemPrefetchAsync((CUdeviceptr)KERN_GPUSORT_RADIX_KEYS(kradix),
+							sizeof(cl_ulong) * KERN_GPUSORT_RADIX_NWORDS(kradix)
+							* kradix->nitems,
+							CU_DEVICE_CPU,
+							CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuMemPrefetchAsync: %s", errorText(rc));
+	rc = cuStreamSynchronize(CU_STREAM_PER_THREAD);
+	if (rc != CUDA_SUCCESS)
+		werror("failed on cuStreamSynchronize: %s", errorText(rc));
+
+	return 0;
+}
+
+/*
+ * gpusort_release_task
+ */
+static void
+gpusort_release_task(GpuTask *gtask)
+{
+	GpuSortTask	   *gsort = (GpuSortTask *) gtask;
+	GpuTaskState   *gts = gsort->task.gts;
+
+	if (gsort->pds_src)
+		PDS_release(gsort->pds_src);
+	if (gsort->outer_task)
+		gsort->outer_task->gts->cb_release_task(gsort->outer_task);
+	gpuMemFree(gts->gcontext, (CUdeviceptr) gsort);
+}
+
+/*
+ * gpusort_release_chunks
+ */
+static void
+gpusort_release_chunks(GpuSortState *gss)
+{
+	ListCell   *lc;
+	int			i;
+
+	for (i=0; i < gss->num_chunks; i++)
+		gpusort_release_task(&gss->chunks[i]->task);
+	gss->num_chunks = 0;
+	foreach (lc, gss->pds_pending)
+		PDS_release((pgstrom_data_store *) lfirst(lc));
+	gss->pds_pending = NIL;
+	if (gss->pds_curr)
+		PDS_release(gss->pds_curr);
+	gss->pds_curr = NULL;
+	gss->outer_done = false;
+	gss->sort_done = false;
+	gss->merge_ready = false;
+}
+
+/*
+ * gpusort_merge_compare - comparator of the binary heap
+ */
+static inline cl_ulong *
+gpusort_merge_curr_keys(GpuSortTask *gsort)
+{
+	kern_gpusort_radix *kradix = &gsort->kern;
+	cl_uint		row_index = KERN_GPUSORT_RADIX_RESULT(kradix)[gsort->curr_pos];
+
+	return (KERN_GPUSORT_RADIX_KEYS(kradix) +
+			(size_t)row_index * KERN_GPUSORT_RADIX_NWORDS(kradix));
+}
+
+static int
+gpusort_merge_compare(Datum a, Datum b, void *arg)
+{
+	GpuSortState   *gss = (GpuSortState *) arg;
+	cl_int			x = DatumGetInt32(a);
+	cl_int			y = DatumGetInt32(b);
+	cl_int			comp;
+
+	comp = gpusort_radix_compare(gpusort_merge_curr_keys(gss->chunks[x]),
+								 gpusort_merge_curr_keys(gss->chunks[y]),
+								 gss->nkeys);
+	if (comp == 0)
+		comp = (x < y ? -1 : (x > y ? 1 : 0));
+	/* binaryheap is max-heap, so invert the comparison */
+	return -comp;
+}
+
+/*
+ * gpusort_run_sort
+ *
+ * It sorts all the chunks of the outer input, then sets up the merge.
+ */
+static void
+gpusort_run_sort(GpuSortState *gss)
+{
+	GpuTask	   *gtask;
+
+	while ((gtask = pgstromFetchGpuTask(&gss->gts)) != NULL)
+	{
+		if (gss->num_chunks == gss->max_chunks)
+		{
+			gss->max_chunks = Max(2 * gss->max_chunks, 32);
+			if (!gss->chunks)
+				gss->chunks = palloc(sizeof(GpuSortTask *) *
+									 gss->max_chunks);
+			else
+				gss->chunks = repalloc(gss->chunks,
+									   sizeof(GpuSortTask *) *
+									   gss->max_chunks);
+		}
+		gss->chunks[gss->num_chunks++] = (GpuSortTask *) gtask;
+	}
+	if (gss->merge_heap)
+		binaryheap_free(gss->merge_heap);
+	gss->merge_heap = binaryheap_allocate(Max(gss->num_chunks, 1),
+										  gpusort_merge_compare,
+										  gss);
+	gss->merge_ready = false;
+	gss->sort_done = true;
+}
+
+/*
+ * gpusort_next_tuple
+ */
+static TupleTableSlot *
+gpusort_next_tuple(GpuSortState *gss)
+{
+	TupleTableSlot *slot = gss->gts.css.ss.ss_ScanTupleSlot;
+	binaryheap	   *heap = gss->merge_heap;
+	GpuSortTask	   *gsort;
+	kern_data_store *kds;
+	cl_uint			row_index;
+	cl_int			i;
+
+	if (!gss->merge_ready)
+	{
+		binaryheap_reset(heap);
+		for (i=0; i < gss->num_chunks; i++)
+		{
+			gss->chunks[i]->curr_pos = 0;
+			binaryheap_add_unordered(heap, Int32GetDatum(i));
+		}
+		binaryheap_build(heap);
+		gss->merge_ready = true;
+	}
+	else if (!binaryheap_empty(heap))
+	{
+		/* advance the chunk that returned the last row */
+		i = DatumGetInt32(binaryheap_first(heap));
+		gsort = gss->chunks[i];
+		if (++gsort->curr_pos < gsort->kern.nitems)
+			binaryheap_replace_first(heap, Int32GetDatum(i));
+		else
+			(void) binaryheap_remove_first(heap);
+	}
+	if (binaryheap_empty(heap))
+		return ExecClearTuple(slot);
+
+	i = DatumGetInt32(binaryheap_first(heap));
+	gsort = gss->chunks[i];
+	kds = &gsort->pds_src->kds;
+	row_index = KERN_GPUSORT_RADIX_RESULT(&gsort->kern)[gsort->curr_pos];
+	if (kds->format == KDS_FORMAT_ROW)
+		KDS_fetch_tuple_row(slot, kds, &gss->gts.curr_tuple, row_index);
+	else
+		KDS_fetch_tuple_slot(slot, kds, row_index);
+	return slot;
+}
+
+/*
+ * ExecInitGpuSort
+ */
+static void
+ExecInitGpuSort(CustomScanState *node, EState *estate, int eflags)
+{
+	GpuSortState   *gss = (GpuSortState *) node;
+	CustomScan	   *cscan = (CustomScan *) node->ss.ps.plan;
+	GpuSortInfo	   *gsort_info = deform_gpusort_info(cscan);
+	GpuContext	   *gcontext;
+	PlanState	   *outer_ps;
+	bool			explain_only = ((eflags & EXEC_FLAG_EXPLAIN_ONLY) != 0);
+	cl_int			cuda_dindex = -1;
+	cl_int			i;
+	ListCell	   *lc1, *lc2, *lc3, *lc4;
+
+	Assert(cscan->scan.scanrelid == 0 && outerPlan(cscan) != NULL);
+	/* setup the outer node */
+	outer_ps = ExecInitNode(outerPlan(cscan), estate, eflags);
+	outerPlanState(gss) = outer_ps;
+	/*
+	 * GpuScan/GpuJoin that returns the tuples as is; GpuSort reads their
+	 * result buffers on the same GPU device.
+	 */
+	if ((pgstrom_planstate_is_gpuscan(outer_ps) ||
+		 pgstrom_planstate_is_gpujoin(outer_ps)) &&
+		!outer_ps->ps_ProjInfo &&
+		!outer_ps->qual)
+	{
+		gss->outer_gts = (GpuTaskState *) outer_ps;
+		cuda_dindex = gss->outer_gts->gcontext->cuda_dindex;
+	}
+	gcontext = AllocGpuContext(cuda_dindex, false, false);
+	gss->gts.gcontext = gcontext;
+
+	/* setup common GpuTaskState fields */
+	pgstromInitGpuTaskState(&gss->gts,
+							gcontext,
+							GpuTaskKind_GpuSort,
+							NIL,
+							NIL,
+							NIL,
+							cuda_dindex,
+							0,
+							eflags);
+	gss->gts.cb_next_task       = gpusort_next_task;
+	gss->gts.cb_process_task    = gpusort_process_task;
+	gss->gts.cb_release_task    = gpusort_release_task;
+
+	/* sort keys */
+	i = 0;
+	forfour (lc1, gsort_info->sort_colidx,
+			 lc2, gsort_info->sort_kind,
+			 lc3, gsort_info->sort_desc,
+			 lc4, gsort_info->sort_nulls_first)
+	{
+		gpusortRadixKey *rkey = &gss->keys[i++];
+
+		rkey->colidx = lfirst_int(lc1);
+		rkey->kind = lfirst_int(lc2);
+		rkey->descending = lfirst_int(lc3);
+		rkey->nulls_first = lfirst_int(lc4);
+	}
+	gss->nkeys = i;
+
+	/* Get CUDA program; precompiled kernel needs no source */
+	gss->gts.program_id = pgstrom_create_cuda_program(gcontext,
+													  DEVKERNEL_GPUSORT_RADIX,
+													  0,
+													  "",
+													  "",
+													  false,
+													  explain_only);
+}
+
+/*
+ * ExecReCheckGpuSort
+ */
+static bool
+ExecReCheckGpuSort(GpuSortState *gss, TupleTableSlot *slot)
+{
+	/*
+	 * GpuSort shall be never located under the LockRows, so we don't
+	 * expect that we need to have any special handling for EPQ.
+	 */
+	return true;
+}
+
+/*
+ * ExecGpuSort
+ */
+static TupleTableSlot *
+ExecGpuSort(CustomScanState *node)
+{
+	GpuSortState   *gss = (GpuSortState *) node;
+
+	ActivateGpuContext(gss->gts.gcontext);
+	if (!gss->sort_done)
+		gpusort_run_sort(gss);
+	return ExecScan(&node->ss,
+					(ExecScanAccessMtd) gpusort_next_tuple,
+					(ExecScanRecheckMtd) ExecReCheckGpuSort);
+}
+
+/*
+ * ExecEndGpuSort
+ */
+static void
+ExecEndGpuSort(CustomScanState *node)
+{
+	GpuSortState   *gss = (GpuSortState *) node;
+
+	/* wait for completion of any asynchronous GpuTask */
+	SynchronizeGpuContext(gss->gts.gcontext);
+	/* release the chunks prior to the outer tasks being kept */
+	gpusort_release_chunks(gss);
+	if (gss->merge_heap)
+		binaryheap_free(gss->merge_heap);
+	/* shutdown outer subtree */
+	ExecEndNode(outerPlanState(node));
+	/* then, common portion */
+	pgstromReleaseGpuTaskState(&gss->gts, NULL);
+}
+
+/*
+ * ExecReScanGpuSort
+ */
+static void
+ExecReScanGpuSort(CustomScanState *node)
+{
+	GpuSortState   *gss = (GpuSortState *) node;
+	PlanState	   *outer_ps = outerPlanState(node);
+
+	/* no need to sort again, if outer input is not changed */
+	if (gss->sort_done && outer_ps->chgParam == NULL)
+	{
+		gss->merge_ready = false;
+		return;
+	}
+	/* wait for completion of any asynchronous GpuTask */
+	SynchronizeGpuContext(gss->gts.gcontext);
+	gpusort_release_chunks(gss);
+	/* common rescan handling */
+	pgstromRescanGpuTaskState(&gss->gts);
+	gss->gts.scan_done = false;
+	/*
+	 * Outer GpuScan/GpuJoin is not kicked by ExecProcNode, so rescan the
+	 * outer node by ourself even if chgParam is set.
+	 */
+	ExecReScan(outer_ps);
+}
+
+/*
+ * ExplainGpuSort
+ */
+static void
+ExplainGpuSort(CustomScanState *node, List *ancestors, ExplainState *es)
+{
+	GpuSortState   *gss = (GpuSortState *) node;
+	CustomScan	   *cscan = (CustomScan *) node->ss.ps.plan;
+	GpuSortInfo	   *gsort_info = deform_gpusort_info(cscan);
+	List		   *dcontext;
+	StringInfoData	buf;
+	ListCell	   *lc1, *lc2, *lc3;
+
+	/* Set up deparsing context */
+	dcontext = set_deparse_context_planstate(es->deparse_cxt,
+											 (Node *)&gss->gts.css.ss.ps,
+											 ancestors);
+	/* Show sort keys */
+	initStringInfo(&buf);
+	forthree (lc1, gsort_info->sort_keys,
+			  lc2, gsort_info->sort_desc,
+			  lc3, gsort_info->sort_nulls_first)
+	{
+		bool	sort_desc = lfirst_int(lc2);
+		bool	nulls_first = lfirst_int(lc3);
+
+		if (buf.len > 0)
+			appendStringInfoString(&buf, ", ");
+		appendStringInfoString(&buf, deparse_expression(lfirst(lc1),
+														dcontext,
+														es->verbose,
+														false));
+		if (sort_desc)
+			appendStringInfoString(&buf, " DESC");
+		if (nulls_first && !sort_desc)
+			appendStringInfoString(&buf, " NULLS FIRST");
+		else if (!nulls_first && sort_desc)
+			appendStringInfoString(&buf, " NULLS LAST");
+	}
+	ExplainPropertyText("GPU Sort Keys", buf.data, es);
+	pfree(buf.data);
+
+	if (!pgstrom_regression_test_mode)
+	{
+		ExplainPropertyText("Outer Input",
+							gss->outer_gts ? "result buffer" : "tuples",
+							es);
+		if (es->analyze)
+			ExplainPropertyInteger("Sorted Chunks", NULL,
+								   gss->num_chunks, es);
+	}
+	/* common portion of EXPLAIN */
+	pgstromExplainGpuTaskState(&gss->gts, es, dcontext);
+}
+
+/*
+ * pgstrom_init_gpusort
+ */
+void
+pgstrom_init_gpusort(void)
+{
+	/* pg_strom.enable_gpusort */
+	DefineCustomBoolVariable("pg_strom.enable_gpusort",
+							 "Enables the use of GPU accelerated sorting",
+							 NULL,
+							 &enable_gpusort,
+							 false,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+
+	/* initialization of path method table */
+	memset(&gpusort_path_methods, 0, sizeof(CustomPathMethods));
+	gpusort_path_methods.CustomName          = "GpuSort";
+	gpusort_path_methods.PlanCustomPath      = PlanGpuSortPath;
+
+	/* initialization of plan method table */
+	memset(&gpusort_scan_methods, 0, sizeof(CustomScanMethods));
+	gpusort_scan_methods.CustomName          = "GpuSort";
+	gpusort_scan_methods.CreateCustomScanState = CreateGpuSortScanState;
+	RegisterCustomScanMethods(&gpusort_scan_methods);
+
+	/* initialization of exec method table */
+	memset(&gpusort_exec_methods, 0, sizeof(CustomExecMethods));
+	gpusort_exec_methods.CustomName          = "GpuSort";
+	gpusort_exec_methods.BeginCustomScan     = ExecInitGpuSort;
+	gpusort_exec_methods.ExecCustomScan      = ExecGpuSort;
+	gpusort_exec_methods.EndCustomScan       = ExecEndGpuSort;
+	gpusort_exec_methods.ReScanCustomScan    = ExecReScanGpuSort;
+	gpusort_exec_methods.ExplainCustomScan   = ExplainGpuSort;
+
+	/* hook registration */
+	create_upper_paths_next = create_upper_paths_hook;
+	create_upper_paths_hook = gpusort_add_ordered_paths;
+}
@@ -454,6 +454,63 @@ pgstrom_removal_dummy_plans(PlannedStmt *pstmt, Plan **p_plan)
 		pgstrom_removal_dummy_plans(pstmt, &plan->righttree);
 }
 
+/*
+ * pgstrom_prebuild_gpu_programs
+ *
+ * It walks on the final plan tree to kick builds of GPU programs in the
+ * background, prior to the executor initialization. GpuScan children of
+ * the Append are also marked to fan-out across GPUs, if any.
+ */
+static void
+pgstrom_prebuild_gpu_programs(Plan *plan)
+{
+	ListCell   *lc;
+
+	if (!plan)
+		return;
+	switch (nodeTag(plan))
+	{
+		case T_Append:
+			pgstrom_assign_gpuscan_fanout((Append *) plan);
+			foreach (lc, ((Append *) plan)->appendplans)
+				pgstrom_prebuild_gpu_programs((Plan *) lfirst(lc));
+			break;
+		case T_MergeAppend:
+			foreach (lc, ((MergeAppend *) plan)->mergeplans)
+				pgstrom_prebuild_gpu_programs((Plan *) lfirst(lc));
+			break;
+		case T_BitmapAnd:
+			foreach (lc, ((BitmapAnd *) plan)->bitmapplans)
+				pgstrom_prebuild_gpu_programs((Plan *) lfirst(lc));
+			break;
+		case T_BitmapOr:
+			foreach (lc, ((BitmapOr *) plan)->bitmapplans)
+				pgstrom_prebuild_gpu_programs((Plan *) lfirst(lc));
+			break;
+		case T_SubqueryScan:
+			pgstrom_prebuild_gpu_programs(((SubqueryScan *) plan)->subplan);
+			break;
+		case T_CustomScan:
+			{
+				CustomScan *cscan = (CustomScan *) plan;
+
+				if (pgstrom_plan_is_gpuscan(plan))
+					pgstrom_prebuild_gpuscan_program(cscan);
+				else if (pgstrom_plan_is_gpujoin(plan))
+					pgstrom_prebuild_gpujoin_program(cscan);
+				else if (pgstrom_plan_is_gpupreagg(plan))
+					pgstrom_prebuild_gpupreagg_program(cscan);
+				foreach (lc, cscan->custom_plans)
+					pgstrom_prebuild_gpu_programs((Plan *) lfirst(lc));
+			}
+			break;
+		default:
+			break;
+	}
+	pgstrom_prebuild_gpu_programs(plan->lefttree);
+	pgstrom_prebuild_gpu_programs(plan->righttree);
+}
+
 /*
  * pgstrom_post_planner
  */
@@ -510,6 +567,11 @@ pgstrom_post_planner(Query *parse,
 	foreach (lc, pstmt->subplans)
 		pgstrom_removal_dummy_plans(pstmt, (Plan **)&lfirst(lc));
 
+	/* kick GPU program builds prior to the execution */
+	pgstrom_prebuild_gpu_programs(pstmt->planTree);
+	foreach (lc, pstmt->subplans)
+		pgstrom_prebuild_gpu_programs((Plan *) lfirst(lc));
+
 	return pstmt;
 }
 
@@ -592,9 +654,12 @@ _PG_init(void)
 	pgstrom_init_gpuscan();
 	pgstrom_init_gpujoin();
 	pgstrom_init_gpupreagg();
+	pgstrom_init_gpusort();
 	pgstrom_init_relscan();
 	pgstrom_init_arrow_fdw();
 	pgstrom_init_gpu_cache();
+	pgstrom_init_gpu_trace();
+	pgstrom_init_gpu_statements();
 
 	/* dummy custom-scan node */
 	memset(&pgstrom_dummy_path_methods, 0, sizeof(CustomPathMethods));
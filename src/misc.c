@@ -884,6 +884,44 @@ errorText(int errcode)
 	return buffer;
 }
 
+/*
+ * ----------------------------------------------------------------
+ *
+ * SQL functions of checksum; device implementation is in cuda_misclib.cu
+ *
+ * ----------------------------------------------------------------
+ */
+Datum pgstrom_crc32(PG_FUNCTION_ARGS);
+Datum pgstrom_crc32c(PG_FUNCTION_ARGS);
+
+Datum
+pgstrom_crc32(PG_FUNCTION_ARGS)
+{
+	struct varlena *datum = PG_GETARG_VARLENA_PP(0);
+	pg_crc32	crc;
+
+	INIT_TRADITIONAL_CRC32(crc);
+	COMP_TRADITIONAL_CRC32(crc, VARDATA_ANY(datum), VARSIZE_ANY_EXHDR(datum));
+	FIN_TRADITIONAL_CRC32(crc);
+
+	PG_RETURN_INT64((int64)crc);
+}
+PG_FUNCTION_INFO_V1(pgstrom_crc32);
+
+Datum
+pgstrom_crc32c(PG_FUNCTION_ARGS)
+{
+	struct varlena *datum = PG_GETARG_VARLENA_PP(0);
+	pg_crc32c	crc;
+
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, VARDATA_ANY(datum), VARSIZE_ANY_EXHDR(datum));
+	FIN_CRC32C(crc);
+
+	PG_RETURN_INT64((int64)crc);
+}
+PG_FUNCTION_INFO_V1(pgstrom_crc32c);
+
 /*
  * ----------------------------------------------------------------
  *
@@ -0,0 +1,1829 @@
+/*
+ * parquet_read.c
+ *
+ * Routines to read Apache Parquet files on behalf of arrow_fdw.
+ * A parquet file is presented to arrow_fdw as an equivalent Arrow schema,
+ * and each row-group is decoded to the KDS_FORMAT_ARROW layout.
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include "pg_strom.h"
+#include "arrow_ipc.h"
+
+#define PARQUET_SIGNATURE			"PAR1"
+#define PARQUET_SIGNATURE_SZ		4
+
+/*
+ * Parquet physical types
+ */
+#define PQ_TYPE__BOOLEAN				0
+#define PQ_TYPE__INT32					1
+#define PQ_TYPE__INT64					2
+#define PQ_TYPE__INT96					3
+#define PQ_TYPE__FLOAT					4
+#define PQ_TYPE__DOUBLE					5
+#define PQ_TYPE__BYTE_ARRAY				6
+#define PQ_TYPE__FIXED_LEN_BYTE_ARRAY	7
+
+/*
+ * Parquet converted types (legacy logical types)
+ */
+#define PQ_CONVERTED__UTF8				0
+#define PQ_CONVERTED__ENUM				4
+#define PQ_CONVERTED__DECIMAL			5
+#define PQ_CONVERTED__DATE				6
+#define PQ_CONVERTED__TIME_MILLIS		7
+#define PQ_CONVERTED__TIME_MICROS		8
+#define PQ_CONVERTED__TIMESTAMP_MILLIS	9
+#define PQ_CONVERTED__TIMESTAMP_MICROS	10
+#define PQ_CONVERTED__UINT_8			11
+#define PQ_CONVERTED__UINT_16			12
+#define PQ_CONVERTED__INT_8				15
+#define PQ_CONVERTED__INT_16			16
+#define PQ_CONVERTED__JSON				19
+
+/*
+ * Parquet logical types (field-id of the LogicalType union)
+ */
+#define PQ_LOGICAL__STRING				1
+#define PQ_LOGICAL__ENUM				4
+#define PQ_LOGICAL__DECIMAL				5
+#define PQ_LOGICAL__DATE				6
+#define PQ_LOGICAL__TIME				7
+#define PQ_LOGICAL__TIMESTAMP			8
+#define PQ_LOGICAL__INTEGER				10
+#define PQ_LOGICAL__JSON				12
+
+/*
+ * Parquet compression codecs
+ */
+#define PQ_CODEC__UNCOMPRESSED			0
+#define PQ_CODEC__SNAPPY				1
+#define PQ_CODEC__ZSTD					6
+#define PQ_CODEC__LZ4_RAW				7
+
+/*
+ * Parquet page types and encodings
+ */
+#define PQ_PAGE__DATA_PAGE				0
+#define PQ_PAGE__INDEX_PAGE				1
+#define PQ_PAGE__DICTIONARY_PAGE		2
+#define PQ_PAGE__DATA_PAGE_V2			3
+
+#define PQ_ENCODING__PLAIN				0
+#define PQ_ENCODING__PLAIN_DICTIONARY	2
+#define PQ_ENCODING__RLE				3
+#define PQ_ENCODING__RLE_DICTIONARY		8
+
+/*
+ * Conversion from the parquet values to the arrow layout
+ */
+#define PQ_CONV__PLAIN					0	/* copy as is */
+#define PQ_CONV__BOOL					1	/* bitmap */
+#define PQ_CONV__VARLENA				2	/* offset + extra */
+#define PQ_CONV__INT8					3	/* INT32 -> int8 */
+#define PQ_CONV__INT16					4	/* INT32 -> int16 */
+#define PQ_CONV__INT96_TIMESTAMP		5	/* INT96 -> Timestamp[us] */
+#define PQ_CONV__DECIMAL32				6	/* INT32 -> int128 */
+#define PQ_CONV__DECIMAL64				7	/* INT64 -> int128 */
+#define PQ_CONV__DECIMAL_FIXED			8	/* big-endian bytes -> int128 */
+
+/* ------------------------------------------------
+ *
+ * Thrift compact protocol reader
+ *
+ * ------------------------------------------------
+ */
+#define THRIFT_TYPE__STOP			0
+#define THRIFT_TYPE__BOOL_TRUE		1
+#define THRIFT_TYPE__BOOL_FALSE		2
+#define THRIFT_TYPE__BYTE			3
+#define THRIFT_TYPE__I16			4
+#define THRIFT_TYPE__I32			5
+#define THRIFT_TYPE__I64			6
+#define THRIFT_TYPE__DOUBLE			7
+#define THRIFT_TYPE__BINARY			8
+#define THRIFT_TYPE__LIST			9
+#define THRIFT_TYPE__SET			10
+#define THRIFT_TYPE__MAP			11
+#define THRIFT_TYPE__STRUCT			12
+
+typedef struct
+{
+	const char *pos;
+	const char *end;
+} thriftReader;
+
+static inline uint8
+thrift_read_byte(thriftReader *r)
+{
+	if (r->pos >= r->end)
+		elog(ERROR, "parquet: metadata is truncated");
+	return (uint8)*r->pos++;
+}
+
+static uint64
+thrift_read_varint(thriftReader *r)
+{
+	uint64		value = 0;
+	int			shift = 0;
+	uint8		c;
+
+	do {
+		if (shift >= 64)
+			elog(ERROR, "parquet: corrupted varint in metadata");
+		c = thrift_read_byte(r);
+		value |= ((uint64)(c & 0x7f)) << shift;
+		shift += 7;
+	} while ((c & 0x80) != 0);
+
+	return value;
+}
+
+static inline int64
+thrift_read_zigzag(thriftReader *r)
+{
+	uint64		value = thrift_read_varint(r);
+
+	return (int64)(value >> 1) ^ -((int64)(value & 1));
+}
+
+static const char *
+thrift_read_binary(thriftReader *r, int *p_length)
+{
+	uint64		len = thrift_read_varint(r);
+	const char *pos = r->pos;
+
+	if (len > r->end - r->pos)
+		elog(ERROR, "parquet: metadata is truncated");
+	r->pos += len;
+	*p_length = len;
+	return pos;
+}
+
+static char *
+thrift_read_string(thriftReader *r)
+{
+	const char *str;
+	int			len;
+
+	str = thrift_read_binary(r, &len);
+	return pnstrdup(str, len);
+}
+
+/*
+ * thrift_read_field - returns false on the end of struct
+ */
+static bool
+thrift_read_field(thriftReader *r, int *p_last_id,
+				  int *p_field_id, int *p_field_type)
+{
+	uint8		c = thrift_read_byte(r);
+	int			delta;
+
+	if (c == THRIFT_TYPE__STOP)
+		return false;
+	delta = (c >> 4);
+	if (delta == 0)
+		*p_field_id = (int16)thrift_read_zigzag(r);
+	else
+		*p_field_id = *p_last_id + delta;
+	*p_field_type = (c & 0x0f);
+	*p_last_id = *p_field_id;
+
+	return true;
+}
+
+static int
+thrift_read_list(thriftReader *r, int *p_elem_type)
+{
+	uint8		c = thrift_read_byte(r);
+	uint64		count = (c >> 4);
+
+	if (count == 15)
+		count = thrift_read_varint(r);
+	if (count > INT_MAX)
+		elog(ERROR, "parquet: too large list in metadata");
+	*p_elem_type = (c & 0x0f);
+	return (int)count;
+}
+
+static void
+thrift_skip(thriftReader *r, int field_type)
+{
+	int			i, count, elem_type;
+	int			last_id = 0;
+	int			field_id;
+
+	check_stack_depth();
+	switch (field_type)
+	{
+		case THRIFT_TYPE__BOOL_TRUE:
+		case THRIFT_TYPE__BOOL_FALSE:
+			break;
+		case THRIFT_TYPE__BYTE:
+			thrift_read_byte(r);
+			break;
+		case THRIFT_TYPE__I16:
+		case THRIFT_TYPE__I32:
+		case THRIFT_TYPE__I64:
+			thrift_read_varint(r);
+			break;
+		case THRIFT_TYPE__DOUBLE:
+			if (r->end - r->pos < sizeof(double))
+				elog(ERROR, "parquet: metadata is truncated");
+			r->pos += sizeof(double);
+			break;
+		case THRIFT_TYPE__BINARY:
+			thrift_read_binary(r, &count);
+			break;
+		case THRIFT_TYPE__LIST:
+		case THRIFT_TYPE__SET:
+			count = thrift_read_list(r, &elem_type);
+			for (i=0; i < count; i++)
+			{
+				/* bool elements in list are encoded with a byte */
+				if (elem_type == THRIFT_TYPE__BOOL_TRUE ||
+					elem_type == THRIFT_TYPE__BOOL_FALSE)
+					thrift_read_byte(r);
+				else
+					thrift_skip(r, elem_type);
+			}
+			break;
+		case THRIFT_TYPE__MAP:
+			count = thrift_read_varint(r);
+			if (count > 0)
+			{
+				uint8	c = thrift_read_byte(r);
+
+				for (i=0; i < count; i++)
+				{
+					thrift_skip(r, (c >> 4));
+					thrift_skip(r, (c & 0x0f));
+				}
+			}
+			break;
+		case THRIFT_TYPE__STRUCT:
+			while (thrift_read_field(r, &last_id, &field_id, &field_type))
+				thrift_skip(r, field_type);
+			break;
+		default:
+			elog(ERROR, "parquet: unknown thrift type (%d)", field_type);
+	}
+}
+
+static inline bool
+thrift_read_bool(int field_type)
+{
+	return (field_type == THRIFT_TYPE__BOOL_TRUE);
+}
+
+/* ------------------------------------------------
+ *
+ * Routines to read parquet FileMetaData
+ *
+ * ------------------------------------------------
+ */
+typedef struct
+{
+	char	   *name;
+	int			type;
+	int			type_length;
+	int			repetition_type;
+	int			num_children;
+	int			converted_type;
+	int			scale;
+	int			precision;
+	/* LogicalType */
+	int			logical_type;
+	int			logical_scale;
+	int			logical_precision;
+	int			logical_unit;		/* ArrowTimeUnit */
+	bool		logical_adjusted;	/* isAdjustedToUTC */
+	int			logical_bitwidth;
+	bool		logical_signed;
+} pqSchemaElement;
+
+typedef struct
+{
+	int			type;
+	int			codec;
+	int64		num_values;
+	int64		total_compressed_size;
+	int64		data_page_offset;
+	int64		dictionary_page_offset;
+	/* statistics */
+	const char *min_value;
+	int			min_len;
+	const char *max_value;
+	int			max_len;
+	bool		legacy_stats;
+} pqColumnMetaData;
+
+static int
+__readParquetTimeUnit(thriftReader *r)
+{
+	int			last_id = 0;
+	int			field_id;
+	int			field_type;
+	int			unit = -1;
+
+	while (thrift_read_field(r, &last_id, &field_id, &field_type))
+	{
+		if (field_id == 1)
+			unit = ArrowTimeUnit__MilliSecond;
+		else if (field_id == 2)
+			unit = ArrowTimeUnit__MicroSecond;
+		else if (field_id == 3)
+			unit = ArrowTimeUnit__NanoSecond;
+		thrift_skip(r, field_type);
+	}
+	return unit;
+}
+
+static void
+__readParquetLogicalType(thriftReader *r, pqSchemaElement *elem)
+{
+	int			last_id = 0;
+	int			field_id;
+	int			field_type;
+
+	while (thrift_read_field(r, &last_id, &field_id, &field_type))
+	{
+		int		__last_id = 0;
+		int		__field_id;
+		int		__field_type;
+
+		if (field_type != THRIFT_TYPE__STRUCT)
+		{
+			thrift_skip(r, field_type);
+			continue;
+		}
+		elem->logical_type = field_id;
+		while (thrift_read_field(r, &__last_id, &__field_id, &__field_type))
+		{
+			switch (field_id)
+			{
+				case PQ_LOGICAL__DECIMAL:
+					if (__field_id == 1)
+						elem->logical_scale = thrift_read_zigzag(r);
+					else if (__field_id == 2)
+						elem->logical_precision = thrift_read_zigzag(r);
+					else
+						thrift_skip(r, __field_type);
+					break;
+				case PQ_LOGICAL__TIME:
+				case PQ_LOGICAL__TIMESTAMP:
+					if (__field_id == 1)
+						elem->logical_adjusted = thrift_read_bool(__field_type);
+					else if (__field_id == 2)
+						elem->logical_unit = __readParquetTimeUnit(r);
+					else
+						thrift_skip(r, __field_type);
+					break;
+				case PQ_LOGICAL__INTEGER:
+					if (__field_id == 1)
+						elem->logical_bitwidth = (int8)thrift_read_byte(r);
+					else if (__field_id == 2)
+						elem->logical_signed = thrift_read_bool(__field_type);
+					else
+						thrift_skip(r, __field_type);
+					break;
+				default:
+					thrift_skip(r, __field_type);
+					break;
+			}
+		}
+	}
+}
+
+static void
+__readParquetSchemaElement(thriftReader *r, pqSchemaElement *elem)
+{
+	int			last_id = 0;
+	int			field_id;
+	int			field_type;
+
+	memset(elem, 0, sizeof(pqSchemaElement));
+	elem->type = -1;
+	elem->repetition_type = 0;		/* REQUIRED */
+	elem->converted_type = -1;
+	elem->logical_type = -1;
+	elem->logical_unit = -1;
+	elem->logical_signed = true;
+	while (thrift_read_field(r, &last_id, &field_id, &field_type))
+	{
+		switch (field_id)
+		{
+			case 1:		/* type */
+				elem->type = thrift_read_zigzag(r);
+				break;
+			case 2:		/* type_length */
+				elem->type_length = thrift_read_zigzag(r);
+				break;
+			case 3:		/* repetition_type */
+				elem->repetition_type = thrift_read_zigzag(r);
+				break;
+			case 4:		/* name */
+				elem->name = thrift_read_string(r);
+				break;
+			case 5:		/* num_children */
+				elem->num_children = thrift_read_zigzag(r);
+				break;
+			case 6:		/* converted_type */
+				elem->converted_type = thrift_read_zigzag(r);
+				break;
+			case 7:		/* scale */
+				elem->scale = thrift_read_zigzag(r);
+				break;
+			case 8:		/* precision */
+				elem->precision = thrift_read_zigzag(r);
+				break;
+			case 10:	/* logicalType */
+				__readParquetLogicalType(r, elem);
+				break;
+			default:
+				thrift_skip(r, field_type);
+				break;
+		}
+	}
+}
+
+static void
+__readParquetStatistics(thriftReader *r, pqColumnMetaData *cmeta)
+{
+	int			last_id = 0;
+	int			field_id;
+	int			field_type;
+	const char *min_legacy = NULL;
+	const char *max_legacy = NULL;
+	int			min_legacy_len = 0;
+	int			max_legacy_len = 0;
+
+	while (thrift_read_field(r, &last_id, &field_id, &field_type))
+	{
+		switch (field_id)
+		{
+			case 1:		/* max (deprecated) */
+				max_legacy = thrift_read_binary(r, &max_legacy_len);
+				break;
+			case 2:		/* min (deprecated) */
+				min_legacy = thrift_read_binary(r, &min_legacy_len);
+				break;
+			case 5:		/* max_value */
+				cmeta->max_value = thrift_read_binary(r, &cmeta->max_len);
+				break;
+			case 6:		/* min_value */
+				cmeta->min_value = thrift_read_binary(r, &cmeta->min_len);
+				break;
+			default:
+				thrift_skip(r, field_type);
+				break;
+		}
+	}
+	if ((!cmeta->min_value || !cmeta->max_value) && min_legacy && max_legacy)
+	{
+		cmeta->min_value = min_legacy;
+		cmeta->min_len   = min_legacy_len;
+		cmeta->max_value = max_legacy;
+		cmeta->max_len   = max_legacy_len;
+		cmeta->legacy_stats = true;
+	}
+}
+
+static void
+__readParquetColumnMetaData(thriftReader *r, pqColumnMetaData *cmeta)
+{
+	int			last_id = 0;
+	int			field_id;
+	int			field_type;
+
+	while (thrift_read_field(r, &last_id, &field_id, &field_type))
+	{
+		switch (field_id)
+		{
+			case 1:		/* type */
+				cmeta->type = thrift_read_zigzag(r);
+				break;
+			case 4:		/* codec */
+				cmeta->codec = thrift_read_zigzag(r);
+				break;
+			case 5:		/* num_values */
+				cmeta->num_values = thrift_read_zigzag(r);
+				break;
+			case 7:		/* total_compressed_size */
+				cmeta->total_compressed_size = thrift_read_zigzag(r);
+				break;
+			case 9:		/* data_page_offset */
+				cmeta->data_page_offset = thrift_read_zigzag(r);
+				break;
+			case 11:	/* dictionary_page_offset */
+				cmeta->dictionary_page_offset = thrift_read_zigzag(r);
+				break;
+			case 12:	/* statistics */
+				__readParquetStatistics(r, cmeta);
+				break;
+			default:
+				thrift_skip(r, field_type);
+				break;
+		}
+	}
+}
+
+static void
+__readParquetColumnChunk(thriftReader *r, pqColumnMetaData *cmeta)
+{
+	int			last_id = 0;
+	int			field_id;
+	int			field_type;
+	bool		has_meta = false;
+
+	memset(cmeta, 0, sizeof(pqColumnMetaData));
+	while (thrift_read_field(r, &last_id, &field_id, &field_type))
+	{
+		switch (field_id)
+		{
+			case 1:		/* file_path */
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("parquet: column chunks in external files are not supported")));
+				break;
+			case 3:		/* meta_data */
+				__readParquetColumnMetaData(r, cmeta);
+				has_meta = true;
+				break;
+			default:
+				thrift_skip(r, field_type);
+				break;
+		}
+	}
+	if (!has_meta)
+		elog(ERROR, "parquet: ColumnChunk has no metadata");
+}
+
+/*
+ * __parquetSetupArrowField
+ *
+ * It assigns an equivalent Arrow type on the parquet column, and determines
+ * how to convert the parquet values to the arrow layout.
+ */
+static void
+__parquetSetupArrowField(ArrowField *field, pqSchemaElement *elem,
+						 ParquetChunkInfo *pq_chunk)
+{
+	ArrowType  *t = &field->type;
+	int			ctype = elem->converted_type;
+	int			ltype = elem->logical_type;
+
+	initArrowNode(field, Field);
+	field->name = elem->name;
+	field->_name_len = strlen(elem->name);
+	field->nullable = (elem->repetition_type != 0);
+
+	pq_chunk->physical_type = elem->type;
+	pq_chunk->type_length = elem->type_length;
+	pq_chunk->max_def_level = (elem->repetition_type == 0 ? 0 : 1);
+	pq_chunk->conv = PQ_CONV__PLAIN;
+
+	switch (elem->type)
+	{
+		case PQ_TYPE__BOOLEAN:
+			initArrowNode(t, Bool);
+			pq_chunk->conv = PQ_CONV__BOOL;
+			break;
+
+		case PQ_TYPE__INT32:
+			if (ltype == PQ_LOGICAL__DECIMAL || ctype == PQ_CONVERTED__DECIMAL)
+			{
+				initArrowNode(t, Decimal);
+				t->Decimal.precision = (ltype == PQ_LOGICAL__DECIMAL
+										? elem->logical_precision
+										: elem->precision);
+				t->Decimal.scale = (ltype == PQ_LOGICAL__DECIMAL
+									? elem->logical_scale
+									: elem->scale);
+				t->Decimal.bitWidth = 128;
+				pq_chunk->conv = PQ_CONV__DECIMAL32;
+			}
+			else if (ltype == PQ_LOGICAL__DATE || ctype == PQ_CONVERTED__DATE)
+			{
+				initArrowNode(t, Date);
+				t->Date.unit = ArrowDateUnit__Day;
+			}
+			else if ((ltype == PQ_LOGICAL__TIME &&
+					  elem->logical_unit == ArrowTimeUnit__MilliSecond) ||
+					 ctype == PQ_CONVERTED__TIME_MILLIS)
+			{
+				initArrowNode(t, Time);
+				t->Time.unit = ArrowTimeUnit__MilliSecond;
+				t->Time.bitWidth = 32;
+			}
+			else
+			{
+				initArrowNode(t, Int);
+				t->Int.bitWidth = 32;
+				t->Int.is_signed = true;
+				bool	is_signed = true;
+				int		bitwidth = 32;
+
+				if (ltype == PQ_LOGICAL__INTEGER)
+				{
+					is_signed = elem->logical_signed;
+					bitwidth = elem->logical_bitwidth;
+				}
+				else if (ctype == PQ_CONVERTED__INT_8)
+					bitwidth = 8;
+				else if (ctype == PQ_CONVERTED__INT_16)
+					bitwidth = 16;
+				else if (ctype == PQ_CONVERTED__UINT_8)
+				{
+					is_signed = false;
+					bitwidth = 8;
+				}
+				else if (ctype == PQ_CONVERTED__UINT_16)
+				{
+					is_signed = false;
+					bitwidth = 16;
+				}
+				/* unsigned values are widened to the signed type */
+				if (!is_signed && bitwidth < 32)
+					bitwidth *= 2;
+				if (bitwidth == 8)
+				{
+					t->Int.bitWidth = 8;
+					pq_chunk->conv = PQ_CONV__INT8;
+				}
+				else if (bitwidth == 16)
+				{
+					t->Int.bitWidth = 16;
+					pq_chunk->conv = PQ_CONV__INT16;
+				}
+			}
+			break;
+
+		case PQ_TYPE__INT64:
+			if (ltype == PQ_LOGICAL__DECIMAL || ctype == PQ_CONVERTED__DECIMAL)
+			{
+				initArrowNode(t, Decimal);
+				t->Decimal.precision = (ltype == PQ_LOGICAL__DECIMAL
+										? elem->logical_precision
+										: elem->precision);
+				t->Decimal.scale = (ltype == PQ_LOGICAL__DECIMAL
+									? elem->logical_scale
+									: elem->scale);
+				t->Decimal.bitWidth = 128;
+				pq_chunk->conv = PQ_CONV__DECIMAL64;
+			}
+			else if (ltype == PQ_LOGICAL__TIMESTAMP ||
+					 ctype == PQ_CONVERTED__TIMESTAMP_MILLIS ||
+					 ctype == PQ_CONVERTED__TIMESTAMP_MICROS)
+			{
+				initArrowNode(t, Timestamp);
+				if (ltype == PQ_LOGICAL__TIMESTAMP)
+					t->Timestamp.unit = elem->logical_unit;
+				else if (ctype == PQ_CONVERTED__TIMESTAMP_MILLIS)
+					t->Timestamp.unit = ArrowTimeUnit__MilliSecond;
+				else
+					t->Timestamp.unit = ArrowTimeUnit__MicroSecond;
+				/* converted types imply isAdjustedToUTC = true */
+				if (ltype != PQ_LOGICAL__TIMESTAMP || elem->logical_adjusted)
+				{
+					t->Timestamp.timezone = "UTC";
+					t->Timestamp._timezone_len = 3;
+				}
+			}
+			else if (ltype == PQ_LOGICAL__TIME ||
+					 ctype == PQ_CONVERTED__TIME_MICROS)
+			{
+				initArrowNode(t, Time);
+				t->Time.unit = (ltype == PQ_LOGICAL__TIME
+								? elem->logical_unit
+								: ArrowTimeUnit__MicroSecond);
+				t->Time.bitWidth = 64;
+			}
+			else
+			{
+				initArrowNode(t, Int);
+				t->Int.bitWidth = 64;
+				t->Int.is_signed = true;
+			}
+			break;
+
+		case PQ_TYPE__INT96:
+			/* legacy timestamp by Impala/Spark */
+			initArrowNode(t, Timestamp);
+			t->Timestamp.unit = ArrowTimeUnit__MicroSecond;
+			pq_chunk->conv = PQ_CONV__INT96_TIMESTAMP;
+			break;
+
+		case PQ_TYPE__FLOAT:
+			initArrowNode(t, FloatingPoint);
+			t->FloatingPoint.precision = ArrowPrecision__Single;
+			break;
+
+		case PQ_TYPE__DOUBLE:
+			initArrowNode(t, FloatingPoint);
+			t->FloatingPoint.precision = ArrowPrecision__Double;
+			break;
+
+		case PQ_TYPE__BYTE_ARRAY:
+			if (ltype == PQ_LOGICAL__STRING ||
+				ltype == PQ_LOGICAL__ENUM ||
+				ltype == PQ_LOGICAL__JSON ||
+				ctype == PQ_CONVERTED__UTF8 ||
+				ctype == PQ_CONVERTED__ENUM ||
+				ctype == PQ_CONVERTED__JSON)
+				initArrowNode(t, Utf8);
+			else if (ltype == PQ_LOGICAL__DECIMAL ||
+					 ctype == PQ_CONVERTED__DECIMAL)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("parquet: decimal on BYTE_ARRAY is not supported (column \"%s\")",
+								elem->name)));
+			else
+				initArrowNode(t, Binary);
+			pq_chunk->conv = PQ_CONV__VARLENA;
+			break;
+
+		case PQ_TYPE__FIXED_LEN_BYTE_ARRAY:
+			if (elem->type_length <= 0)
+				elog(ERROR, "parquet: wrong FIXED_LEN_BYTE_ARRAY length (column \"%s\")",
+					 elem->name);
+			if (ltype == PQ_LOGICAL__DECIMAL || ctype == PQ_CONVERTED__DECIMAL)
+			{
+				if (elem->type_length > sizeof(int128_t))
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("parquet: decimal wider than 128bit is not supported (column \"%s\")",
+									elem->name)));
+				initArrowNode(t, Decimal);
+				t->Decimal.precision = (ltype == PQ_LOGICAL__DECIMAL
+										? elem->logical_precision
+										: elem->precision);
+				t->Decimal.scale = (ltype == PQ_LOGICAL__DECIMAL
+									? elem->logical_scale
+									: elem->scale);
+				t->Decimal.bitWidth = 128;
+				pq_chunk->conv = PQ_CONV__DECIMAL_FIXED;
+			}
+			else
+			{
+				initArrowNode(t, FixedSizeBinary);
+				t->FixedSizeBinary.byteWidth = elem->type_length;
+			}
+			break;
+
+		default:
+			elog(ERROR, "parquet: unknown physical type (%d) of column \"%s\"",
+				 elem->type, elem->name);
+	}
+
+	if ((t->node.tag == ArrowNodeTag__Time ||
+		 t->node.tag == ArrowNodeTag__Timestamp) &&
+		(int)t->Time.unit < 0)
+		elog(ERROR, "parquet: unknown time unit of column \"%s\"",
+			 elem->name);
+}
+
+static int	__parquetPhysicalUnitSize(const ParquetChunkInfo *pq_chunk);
+static int	__parquetArrowUnitSize(const ParquetChunkInfo *pq_chunk);
+
+/*
+ * __parquetConvertValue
+ *
+ * It converts a parquet value of the fixed-length physical type to the
+ * arrow layout; conv must not be PQ_CONV__BOOL or PQ_CONV__VARLENA.
+ */
+static inline void
+__parquetConvertValue(const ParquetChunkInfo *pq_chunk,
+					  char *dest, const char *src)
+{
+	switch (pq_chunk->conv)
+	{
+		case PQ_CONV__INT8:
+			{
+				int32	ival;
+
+				memcpy(&ival, src, sizeof(int32));
+				*((int8 *)dest) = (int8)ival;
+			}
+			break;
+		case PQ_CONV__INT16:
+			{
+				int32	ival;
+
+				memcpy(&ival, src, sizeof(int32));
+				*((int16 *)dest) = (int16)ival;
+			}
+			break;
+		case PQ_CONV__INT96_TIMESTAMP:
+			{
+				int64	nanos;
+				int32	jday;
+				int64	ts;
+
+				memcpy(&nanos, src, sizeof(int64));
+				memcpy(&jday, src + sizeof(int64), sizeof(int32));
+				ts = ((int64)(jday - UNIX_EPOCH_JDATE) * USECS_PER_DAY +
+					  nanos / 1000L);
+				memcpy(dest, &ts, sizeof(int64));
+			}
+			break;
+		case PQ_CONV__DECIMAL32:
+			{
+				int32	ival;
+				int128_t dval;
+
+				memcpy(&ival, src, sizeof(int32));
+				dval = ival;
+				memcpy(dest, &dval, sizeof(int128_t));
+			}
+			break;
+		case PQ_CONV__DECIMAL64:
+			{
+				int64	ival;
+				int128_t dval;
+
+				memcpy(&ival, src, sizeof(int64));
+				dval = ival;
+				memcpy(dest, &dval, sizeof(int128_t));
+			}
+			break;
+		case PQ_CONV__DECIMAL_FIXED:
+			{
+				const uint8 *bytes = (const uint8 *)src;
+				uint128_t uval = ((bytes[0] & 0x80) != 0 ? ~((uint128_t)0) : 0);
+				int		i;
+
+				/* big-endian two's complement */
+				for (i=0; i < pq_chunk->type_length; i++)
+					uval = (uval << 8) | bytes[i];
+				memcpy(dest, &uval, sizeof(uint128_t));
+			}
+			break;
+		default:
+			Assert(pq_chunk->conv == PQ_CONV__PLAIN);
+			memcpy(dest, src, __parquetArrowUnitSize(pq_chunk));
+			break;
+	}
+}
+
+/*
+ * __parquetPhysicalUnitSize - width of the fixed-length physical type
+ */
+static int
+__parquetPhysicalUnitSize(const ParquetChunkInfo *pq_chunk)
+{
+	switch (pq_chunk->physical_type)
+	{
+		case PQ_TYPE__INT32:
+		case PQ_TYPE__FLOAT:
+			return sizeof(int32);
+		case PQ_TYPE__INT64:
+		case PQ_TYPE__DOUBLE:
+			return sizeof(int64);
+		case PQ_TYPE__INT96:
+			return 12;
+		case PQ_TYPE__FIXED_LEN_BYTE_ARRAY:
+			return pq_chunk->type_length;
+		default:
+			elog(ERROR, "parquet: physical type (%d) has no fixed width",
+				 pq_chunk->physical_type);
+	}
+	return -1;	/* not reached */
+}
+
+/*
+ * __parquetArrowUnitSize - width of the values in the arrow layout
+ */
+static int
+__parquetArrowUnitSize(const ParquetChunkInfo *pq_chunk)
+{
+	switch (pq_chunk->conv)
+	{
+		case PQ_CONV__INT8:
+			return sizeof(int8);
+		case PQ_CONV__INT16:
+			return sizeof(int16);
+		case PQ_CONV__INT96_TIMESTAMP:
+			return sizeof(int64);
+		case PQ_CONV__DECIMAL32:
+		case PQ_CONV__DECIMAL64:
+		case PQ_CONV__DECIMAL_FIXED:
+			return sizeof(int128_t);
+		case PQ_CONV__PLAIN:
+			return __parquetPhysicalUnitSize(pq_chunk);
+		default:
+			break;
+	}
+	return 0;	/* bool or varlena */
+}
+
+/*
+ * __parquetSetupStatistics
+ *
+ * It converts min/max statistics to the layout of SQLstat__datum, for the
+ * types that arrow_fdw can use for the min/max hint.
+ */
+static void
+__parquetSetupStatistics(ParquetColumnChunk *pq_column,
+						 pqColumnMetaData *cmeta)
+{
+	ParquetChunkInfo *pq_chunk = &pq_column->info;
+	int			width;
+
+	pq_column->stat_isnull = true;
+	if (!cmeta->min_value || !cmeta->max_value)
+		return;
+	switch (pq_chunk->physical_type)
+	{
+		case PQ_TYPE__INT32:
+		case PQ_TYPE__INT64:
+		case PQ_TYPE__FLOAT:
+		case PQ_TYPE__DOUBLE:
+			break;
+		case PQ_TYPE__FIXED_LEN_BYTE_ARRAY:
+			/* legacy min/max has undefined sort order */
+			if (pq_chunk->conv != PQ_CONV__DECIMAL_FIXED ||
+				cmeta->legacy_stats)
+				return;
+			break;
+		default:
+			return;
+	}
+	width = __parquetPhysicalUnitSize(pq_chunk);
+	if (cmeta->min_len != width || cmeta->max_len != width)
+		return;
+	StaticAssertStmt(sizeof(SQLstat__datum) <= sizeof(pq_column->stat_min),
+					 "unexpected size of SQLstat__datum");
+	memset(pq_column->stat_min, 0, sizeof(pq_column->stat_min));
+	memset(pq_column->stat_max, 0, sizeof(pq_column->stat_max));
+	__parquetConvertValue(pq_chunk, pq_column->stat_min, cmeta->min_value);
+	__parquetConvertValue(pq_chunk, pq_column->stat_max, cmeta->max_value);
+	pq_column->stat_isnull = false;
+}
+
+static int
+__parquetCodecToArrow(int codec)
+{
+	switch (codec)
+	{
+		case PQ_CODEC__UNCOMPRESSED:
+			return -1;
+		case PQ_CODEC__SNAPPY:
+			return __ArrowCompressionType__SNAPPY;
+		case PQ_CODEC__ZSTD:
+			return ArrowCompressionType__ZSTD;
+		case PQ_CODEC__LZ4_RAW:
+			return __ArrowCompressionType__LZ4_RAW;
+		default:
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("parquet: compression codec (%d) is not supported",
+							codec),
+					 errhint("UNCOMPRESSED, SNAPPY, ZSTD and LZ4_RAW are supported")));
+	}
+	return -1;	/* not reached */
+}
+
+static void
+__readParquetRowGroup(thriftReader *r, ParquetFileInfo *pq_info,
+					  ParquetChunkInfo *templates, ParquetRowGroup *rgroup)
+{
+	int			last_id = 0;
+	int			field_id;
+	int			field_type;
+	int			nfields = pq_info->schema._num_fields;
+
+	memset(rgroup, 0, sizeof(ParquetRowGroup));
+	while (thrift_read_field(r, &last_id, &field_id, &field_type))
+	{
+		if (field_id == 1)		/* columns */
+		{
+			int		i, count, elem_type;
+
+			count = thrift_read_list(r, &elem_type);
+			if (count != nfields || elem_type != THRIFT_TYPE__STRUCT)
+				elog(ERROR, "parquet: RowGroup has %d columns, but %d expected",
+					 count, nfields);
+			rgroup->columns = palloc0(sizeof(ParquetColumnChunk) * nfields);
+			for (i=0; i < count; i++)
+			{
+				ParquetColumnChunk *pq_column = &rgroup->columns[i];
+				ParquetChunkInfo *pq_chunk = &pq_column->info;
+				pqColumnMetaData cmeta;
+
+				__readParquetColumnChunk(r, &cmeta);
+				memcpy(pq_chunk, &templates[i], sizeof(ParquetChunkInfo));
+				if (cmeta.type != pq_chunk->physical_type)
+					elog(ERROR, "parquet: ColumnChunk type mismatch");
+				pq_chunk->codec = __parquetCodecToArrow(cmeta.codec);
+				if (cmeta.dictionary_page_offset > 0 &&
+					cmeta.dictionary_page_offset < cmeta.data_page_offset)
+					pq_chunk->chunk_offset = cmeta.dictionary_page_offset;
+				else
+					pq_chunk->chunk_offset = cmeta.data_page_offset;
+				if (cmeta.total_compressed_size < 0 ||
+					pq_chunk->chunk_offset < 0 ||
+					(pq_chunk->chunk_offset +
+					 cmeta.total_compressed_size) > pq_info->stat_buf.st_size)
+					elog(ERROR, "parquet: ColumnChunk is out of the file");
+				pq_chunk->chunk_length = cmeta.total_compressed_size;
+				__parquetSetupStatistics(pq_column, &cmeta);
+				rgroup->total_length += pq_chunk->chunk_length;
+			}
+		}
+		else if (field_id == 3)	/* num_rows */
+			rgroup->num_rows = thrift_read_zigzag(r);
+		else
+			thrift_skip(r, field_type);
+	}
+	if (!rgroup->columns)
+		elog(ERROR, "parquet: RowGroup has no columns");
+	if (rgroup->num_rows < 0 || rgroup->num_rows > UINT_MAX)
+		elog(ERROR, "parquet: RowGroup has too many rows (%ld)",
+			 rgroup->num_rows);
+}
+
+/*
+ * parquetFileDescIsValid - checks signature of the parquet file
+ */
+bool
+parquetFileDescIsValid(int fdesc)
+{
+	struct stat	stat_buf;
+	char		buf[PARQUET_SIGNATURE_SZ];
+
+	if (fstat(fdesc, &stat_buf) != 0 ||
+		stat_buf.st_size < 2 * PARQUET_SIGNATURE_SZ + sizeof(int32))
+		return false;
+	if (__preadFile(fdesc, buf, PARQUET_SIGNATURE_SZ, 0) != PARQUET_SIGNATURE_SZ ||
+		memcmp(buf, PARQUET_SIGNATURE, PARQUET_SIGNATURE_SZ) != 0)
+		return false;
+	if (__preadFile(fdesc, buf, PARQUET_SIGNATURE_SZ,
+					stat_buf.st_size -
+					PARQUET_SIGNATURE_SZ) != PARQUET_SIGNATURE_SZ ||
+		memcmp(buf, PARQUET_SIGNATURE, PARQUET_SIGNATURE_SZ) != 0)
+		return false;
+	return true;
+}
+
+/*
+ * readParquetFileDesc
+ */
+void
+readParquetFileDesc(int fdesc, ParquetFileInfo *pq_info)
+{
+	char		tail[sizeof(int32) + PARQUET_SIGNATURE_SZ];
+	uint32		meta_len;
+	char	   *meta_buf;
+	thriftReader r;
+	int			last_id = 0;
+	int			field_id;
+	int			field_type;
+	ParquetChunkInfo *templates = NULL;
+
+	memset(pq_info, 0, sizeof(ParquetFileInfo));
+	if (fstat(fdesc, &pq_info->stat_buf) != 0)
+		elog(ERROR, "failed on fstat: %m");
+	if (!parquetFileDescIsValid(fdesc))
+		elog(ERROR, "file is not Apache Parquet format");
+	if (__preadFile(fdesc, tail, sizeof(tail),
+					pq_info->stat_buf.st_size - sizeof(tail)) != sizeof(tail))
+		elog(ERROR, "failed on pread(2): %m");
+	memcpy(&meta_len, tail, sizeof(uint32));
+	if (meta_len > pq_info->stat_buf.st_size - sizeof(tail) - PARQUET_SIGNATURE_SZ)
+		elog(ERROR, "parquet: FileMetaData length is corrupted");
+	meta_buf = palloc(meta_len);
+	if (__preadFile(fdesc, meta_buf, meta_len,
+					pq_info->stat_buf.st_size -
+					sizeof(tail) - meta_len) != meta_len)
+		elog(ERROR, "failed on pread(2): %m");
+
+	initArrowNode(&pq_info->schema, Schema);
+	r.pos = meta_buf;
+	r.end = meta_buf + meta_len;
+	while (thrift_read_field(&r, &last_id, &field_id, &field_type))
+	{
+		int		i, count, elem_type;
+
+		if (field_id == 2)			/* schema */
+		{
+			pqSchemaElement root;
+
+			count = thrift_read_list(&r, &elem_type);
+			if (count < 1 || elem_type != THRIFT_TYPE__STRUCT)
+				elog(ERROR, "parquet: FileMetaData has no schema");
+			__readParquetSchemaElement(&r, &root);
+			if (root.num_children != count - 1)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("parquet: nested schema is not supported")));
+			pq_info->schema.fields = palloc0(sizeof(ArrowField) * root.num_children);
+			pq_info->schema._num_fields = root.num_children;
+			templates = palloc0(sizeof(ParquetChunkInfo) * root.num_children);
+			for (i=0; i < root.num_children; i++)
+			{
+				pqSchemaElement elem;
+
+				__readParquetSchemaElement(&r, &elem);
+				if (elem.num_children > 0 || !elem.name)
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("parquet: nested schema is not supported")));
+				if (elem.repetition_type == 2)		/* REPEATED */
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("parquet: repeated column \"%s\" is not supported",
+									elem.name)));
+				__parquetSetupArrowField(&pq_info->schema.fields[i],
+										 &elem, &templates[i]);
+			}
+		}
+		else if (field_id == 4)		/* row_groups */
+		{
+			if (!templates)
+				elog(ERROR, "parquet: RowGroup appeared prior to the schema");
+			count = thrift_read_list(&r, &elem_type);
+			if (elem_type != THRIFT_TYPE__STRUCT && count > 0)
+				elog(ERROR, "parquet: FileMetaData is corrupted");
+			pq_info->row_groups = palloc0(sizeof(ParquetRowGroup) * Max(count,1));
+			pq_info->num_row_groups = count;
+			for (i=0; i < count; i++)
+				__readParquetRowGroup(&r, pq_info, templates,
+									  &pq_info->row_groups[i]);
+		}
+		else
+			thrift_skip(&r, field_type);
+	}
+	if (!templates)
+		elog(ERROR, "parquet: FileMetaData has no schema");
+	pfree(templates);
+	pfree(meta_buf);
+}
+
+/* ------------------------------------------------
+ *
+ * Routines to decode parquet pages
+ *
+ * ------------------------------------------------
+ */
+
+/*
+ * RLE / Bit-packing hybrid decoder
+ */
+typedef struct
+{
+	const uint8 *pos;
+	const uint8 *end;
+	int			bit_width;
+	uint32		rle_count;		/* remaining values in the RLE run */
+	uint32		rle_value;
+	uint32		bp_count;		/* remaining values in the bit-packed run */
+	uint32		bp_index;		/* current index in the bit-packed run */
+	const uint8 *bp_head;		/* head of the bit-packed run */
+	const uint8 *bp_tail;		/* tail of the bit-packed run */
+} pqRleDecoder;
+
+static void
+__pqRleInit(pqRleDecoder *rle, const char *pos, const char *end, int bit_width)
+{
+	if (bit_width < 0 || bit_width > 32)
+		elog(ERROR, "parquet: wrong bit width (%d) for RLE", bit_width);
+	memset(rle, 0, sizeof(pqRleDecoder));
+	rle->pos = (const uint8 *)pos;
+	rle->end = (const uint8 *)end;
+	rle->bit_width = bit_width;
+}
+
+static uint64
+__pqRleVarint(pqRleDecoder *rle)
+{
+	uint64		value = 0;
+	int			shift = 0;
+	uint8		c;
+
+	do {
+		if (rle->pos >= rle->end || shift >= 64)
+			elog(ERROR, "parquet: RLE data is truncated");
+		c = *rle->pos++;
+		value |= ((uint64)(c & 0x7f)) << shift;
+		shift += 7;
+	} while ((c & 0x80) != 0);
+
+	return value;
+}
+
+static uint32
+__pqRleNext(pqRleDecoder *rle)
+{
+	uint64		bits;
+	size_t		bpos;
+	size_t		avail;
+	uint32		value;
+
+	while (rle->rle_count == 0 && rle->bp_count == 0)
+	{
+		uint64		header = __pqRleVarint(rle);
+
+		if ((header & 1) != 0)
+		{
+			/* bit-packed run; a multiple of 8 values */
+			uint64	ngroups = (header >> 1);
+
+			if (ngroups > (rle->end - rle->pos))
+				elog(ERROR, "parquet: bit-packed run is truncated");
+			rle->bp_head = rle->pos;
+			rle->bp_count = ngroups * 8;
+			rle->bp_index = 0;
+			avail = Min(ngroups * rle->bit_width, rle->end - rle->pos);
+			rle->pos += avail;
+			rle->bp_tail = rle->pos;
+		}
+		else
+		{
+			/* RLE run */
+			int		nbytes = (rle->bit_width + 7) / 8;
+			int		i;
+
+			if (nbytes > (rle->end - rle->pos))
+				elog(ERROR, "parquet: RLE run is truncated");
+			rle->rle_count = (header >> 1);
+			rle->rle_value = 0;
+			for (i=0; i < nbytes; i++)
+				rle->rle_value |= ((uint32)rle->pos[i]) << (8 * i);
+			rle->pos += nbytes;
+		}
+	}
+
+	if (rle->rle_count > 0)
+	{
+		rle->rle_count--;
+		return rle->rle_value;
+	}
+	/* fetch a value from the bit-packed run */
+	bpos = (size_t)rle->bp_index * rle->bit_width;
+	if (rle->bp_head + bpos / 8 >= rle->bp_tail)
+	{
+		if (rle->bit_width > 0)
+			elog(ERROR, "parquet: bit-packed run is truncated");
+		bits = 0;
+	}
+	else
+	{
+		avail = Min(sizeof(uint64), rle->bp_tail - (rle->bp_head + bpos / 8));
+		bits = 0;
+		memcpy(&bits, rle->bp_head + bpos / 8, avail);
+	}
+	value = (uint32)((bits >> (bpos % 8)) &
+					 ((rle->bit_width == 32 ? 0 : (1UL << rle->bit_width)) - 1));
+	rle->bp_index++;
+	rle->bp_count--;
+
+	return value;
+}
+
+/*
+ * pqDecodeState - state of the column chunk decoding
+ */
+typedef struct
+{
+	const ParquetChunkInfo *pq_chunk;
+	int64		nitems;
+	int64		row_index;		/* next row to be written */
+	int			unitsz;			/* arrow unit size, 0 if bool/varlena */
+	/* output buffers */
+	uint8	   *nullmap;
+	bool		has_null;
+	char	   *values;
+	char	   *extra;
+	size_t		extra_len;
+	size_t		extra_size;
+	/* dictionary */
+	int			dict_nitems;
+	char	   *dict_buffer;		/* decompressed dictionary page */
+	const char **dict_values;		/* pointer to the values */
+	uint32	   *dict_length;		/* length of the varlena values */
+} pqDecodeState;
+
+static char *
+__parquetPageImage(pqDecodeState *dstate,
+				   const char *page, size_t page_len,
+				   size_t raw_len, bool compressed)
+{
+	char	   *image;
+
+	if (!compressed || dstate->pq_chunk->codec < 0)
+	{
+		if (page_len != raw_len)
+			elog(ERROR, "parquet: uncompressed page length mismatch");
+		return (char *)page;
+	}
+	image = MemoryContextAllocHuge(CurrentMemoryContext, raw_len + 1);
+	arrowFdwDecompressBuffer(dstate->pq_chunk->codec,
+							 image, raw_len, page, page_len);
+	return image;
+}
+
+static void
+__parquetAppendExtra(pqDecodeState *dstate, const char *data, uint32 len)
+{
+	if (dstate->extra_len + len > dstate->extra_size)
+	{
+		size_t	sz = Max(dstate->extra_size * 2,
+						 dstate->extra_len + len + BLCKSZ);
+
+		if (sz > UINT_MAX)
+			sz = UINT_MAX;
+		if (dstate->extra_len + len > sz)
+			elog(ERROR, "parquet: variable length values are too large");
+		if (!dstate->extra)
+			dstate->extra = MemoryContextAllocHuge(CurrentMemoryContext, sz);
+		else
+			dstate->extra = repalloc_huge(dstate->extra, sz);
+		dstate->extra_size = sz;
+	}
+	memcpy(dstate->extra + dstate->extra_len, data, len);
+	dstate->extra_len += len;
+}
+
+/*
+ * __parquetSetValue / __parquetSetNull - write out a row
+ */
+static inline void
+__parquetSetNull(pqDecodeState *dstate)
+{
+	int64		i = dstate->row_index++;
+
+	dstate->has_null = true;
+	if (dstate->pq_chunk->conv == PQ_CONV__VARLENA)
+		((uint32 *)dstate->values)[i+1] = dstate->extra_len;
+}
+
+static inline void
+__parquetSetValid(pqDecodeState *dstate, int64 i)
+{
+	if (dstate->nullmap)
+		dstate->nullmap[i>>3] |= (1 << (i & 7));
+}
+
+static void
+__parquetDecodeDictionaryPage(pqDecodeState *dstate,
+							  char *image, size_t length,
+							  int num_values)
+{
+	const ParquetChunkInfo *pq_chunk = dstate->pq_chunk;
+	const char *pos = image;
+	const char *end = image + length;
+	int			i;
+
+	if (num_values < 0)
+		elog(ERROR, "parquet: DictionaryPage is corrupted");
+	dstate->dict_buffer = image;
+	dstate->dict_nitems = num_values;
+	dstate->dict_values = palloc(sizeof(char *) * Max(num_values, 1));
+	if (pq_chunk->conv == PQ_CONV__VARLENA)
+	{
+		dstate->dict_length = palloc(sizeof(uint32) * Max(num_values, 1));
+		for (i=0; i < num_values; i++)
+		{
+			uint32	len;
+
+			if (end - pos < sizeof(uint32))
+				elog(ERROR, "parquet: DictionaryPage is truncated");
+			memcpy(&len, pos, sizeof(uint32));
+			pos += sizeof(uint32);
+			if (len > end - pos)
+				elog(ERROR, "parquet: DictionaryPage is truncated");
+			dstate->dict_values[i] = pos;
+			dstate->dict_length[i] = len;
+			pos += len;
+		}
+	}
+	else if (pq_chunk->conv == PQ_CONV__BOOL)
+	{
+		elog(ERROR, "parquet: dictionary encoding on BOOLEAN is not valid");
+	}
+	else
+	{
+		int		width = __parquetPhysicalUnitSize(pq_chunk);
+
+		if ((size_t)width * num_values > length)
+			elog(ERROR, "parquet: DictionaryPage is truncated");
+		for (i=0; i < num_values; i++)
+			dstate->dict_values[i] = pos + width * i;
+	}
+}
+
+/*
+ * __parquetDecodeValues
+ *
+ * It decodes the values of a data page. 'levels' is the decoder of the
+ * definition levels, or NULL if REQUIRED column.
+ */
+static void
+__parquetDecodeValues(pqDecodeState *dstate,
+					  pqRleDecoder *levels,
+					  int num_values,
+					  int encoding,
+					  const char *pos, const char *end)
+{
+	const ParquetChunkInfo *pq_chunk = dstate->pq_chunk;
+	pqRleDecoder indexes;
+	bool		is_dict = false;
+	int			width = 0;
+	int64		bool_index = 0;
+	int			k;
+
+	if (dstate->row_index + num_values > dstate->nitems)
+		elog(ERROR, "parquet: ColumnChunk has more values than num_rows");
+	if (encoding == PQ_ENCODING__PLAIN_DICTIONARY ||
+		encoding == PQ_ENCODING__RLE_DICTIONARY)
+	{
+		if (!dstate->dict_values)
+			elog(ERROR, "parquet: dictionary-encoded page without DictionaryPage");
+		if (pos >= end)
+		{
+			/* all values are NULL; no bit-width byte */
+			__pqRleInit(&indexes, pos, end, 0);
+		}
+		else
+		{
+			__pqRleInit(&indexes, pos + 1, end, *((const uint8 *)pos));
+		}
+		is_dict = true;
+	}
+	else if (encoding != PQ_ENCODING__PLAIN)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("parquet: page encoding (%d) is not supported",
+						encoding),
+				 errhint("PLAIN and dictionary encodings are supported")));
+	else if (pq_chunk->conv != PQ_CONV__BOOL &&
+			 pq_chunk->conv != PQ_CONV__VARLENA)
+		width = __parquetPhysicalUnitSize(pq_chunk);
+
+	for (k=0; k < num_values; k++)
+	{
+		int64		i = dstate->row_index;
+		const char *src;
+		uint32		len = 0;
+
+		if (levels && __pqRleNext(levels) < pq_chunk->max_def_level)
+		{
+			__parquetSetNull(dstate);
+			continue;
+		}
+
+		if (is_dict)
+		{
+			uint32	index = __pqRleNext(&indexes);
+
+			if (index >= dstate->dict_nitems)
+				elog(ERROR, "parquet: dictionary index is out of range");
+			src = dstate->dict_values[index];
+			if (dstate->dict_length)
+				len = dstate->dict_length[index];
+		}
+		else if (pq_chunk->conv == PQ_CONV__BOOL)
+		{
+			if ((bool_index >> 3) >= end - pos)
+				elog(ERROR, "parquet: data page is truncated");
+			if ((pos[bool_index >> 3] & (1 << (bool_index & 7))) != 0)
+				dstate->values[i>>3] |= (1 << (i & 7));
+			bool_index++;
+			__parquetSetValid(dstate, i);
+			dstate->row_index++;
+			continue;
+		}
+		else if (pq_chunk->conv == PQ_CONV__VARLENA)
+		{
+			if (end - pos < sizeof(uint32))
+				elog(ERROR, "parquet: data page is truncated");
+			memcpy(&len, pos, sizeof(uint32));
+			pos += sizeof(uint32);
+			if (len > end - pos)
+				elog(ERROR, "parquet: data page is truncated");
+			src = pos;
+			pos += len;
+		}
+		else
+		{
+			if (width > end - pos)
+				elog(ERROR, "parquet: data page is truncated");
+			src = pos;
+			pos += width;
+		}
+
+		if (pq_chunk->conv == PQ_CONV__VARLENA)
+		{
+			__parquetAppendExtra(dstate, src, len);
+			((uint32 *)dstate->values)[i+1] = dstate->extra_len;
+		}
+		else
+		{
+			__parquetConvertValue(pq_chunk,
+								  dstate->values + (size_t)dstate->unitsz * i,
+								  src);
+		}
+		__parquetSetValid(dstate, i);
+		dstate->row_index++;
+	}
+}
+
+typedef struct
+{
+	int			type;
+	int			uncompressed_page_size;
+	int			compressed_page_size;
+	int			num_values;
+	int			encoding;
+	int			def_level_encoding;
+	/* only DATA_PAGE_V2 */
+	int			num_nulls;
+	int			def_levels_length;
+	int			rep_levels_length;
+	bool		is_compressed;
+} pqPageHeader;
+
+static void
+__readParquetDataPageHeader(thriftReader *r, pqPageHeader *phead, bool is_v2)
+{
+	int			last_id = 0;
+	int			field_id;
+	int			field_type;
+
+	while (thrift_read_field(r, &last_id, &field_id, &field_type))
+	{
+		if (field_id == 1)
+			phead->num_values = thrift_read_zigzag(r);
+		else if (!is_v2 && field_id == 2)
+			phead->encoding = thrift_read_zigzag(r);
+		else if (!is_v2 && field_id == 3)
+			phead->def_level_encoding = thrift_read_zigzag(r);
+		else if (is_v2 && field_id == 2)
+			phead->num_nulls = thrift_read_zigzag(r);
+		else if (is_v2 && field_id == 4)
+			phead->encoding = thrift_read_zigzag(r);
+		else if (is_v2 && field_id == 5)
+			phead->def_levels_length = thrift_read_zigzag(r);
+		else if (is_v2 && field_id == 6)
+			phead->rep_levels_length = thrift_read_zigzag(r);
+		else if (is_v2 && field_id == 7)
+			phead->is_compressed = thrift_read_bool(field_type);
+		else
+			thrift_skip(r, field_type);
+	}
+}
+
+static void
+__readParquetPageHeader(thriftReader *r, pqPageHeader *phead)
+{
+	int			last_id = 0;
+	int			field_id;
+	int			field_type;
+
+	memset(phead, 0, sizeof(pqPageHeader));
+	phead->type = -1;
+	phead->def_level_encoding = PQ_ENCODING__RLE;
+	phead->is_compressed = true;
+	while (thrift_read_field(r, &last_id, &field_id, &field_type))
+	{
+		switch (field_id)
+		{
+			case 1:		/* type */
+				phead->type = thrift_read_zigzag(r);
+				break;
+			case 2:		/* uncompressed_page_size */
+				phead->uncompressed_page_size = thrift_read_zigzag(r);
+				break;
+			case 3:		/* compressed_page_size */
+				phead->compressed_page_size = thrift_read_zigzag(r);
+				break;
+			case 5:		/* data_page_header */
+				__readParquetDataPageHeader(r, phead, false);
+				break;
+			case 7:		/* dictionary_page_header */
+				{
+					int		__last_id = 0;
+					int		__field_id;
+					int		__field_type;
+
+					while (thrift_read_field(r, &__last_id,
+											 &__field_id, &__field_type))
+					{
+						if (__field_id == 1)
+							phead->num_values = thrift_read_zigzag(r);
+						else if (__field_id == 2)
+							phead->encoding = thrift_read_zigzag(r);
+						else
+							thrift_skip(r, __field_type);
+					}
+				}
+				break;
+			case 8:		/* data_page_header_v2 */
+				__readParquetDataPageHeader(r, phead, true);
+				break;
+			default:
+				thrift_skip(r, field_type);
+				break;
+		}
+	}
+	if (phead->uncompressed_page_size < 0 ||
+		phead->compressed_page_size < 0 ||
+		phead->num_values < 0 ||
+		phead->def_levels_length < 0 ||
+		phead->rep_levels_length < 0)
+		elog(ERROR, "parquet: PageHeader is corrupted");
+}
+
+/*
+ * parquetReadColumnChunk
+ *
+ * It reads a column chunk and decodes its pages to the arrow layout; the
+ * nullmap, values and extra buffers are allocated on CurrentMemoryContext.
+ */
+void
+parquetReadColumnChunk(int fdesc,
+					   const ParquetChunkInfo *pq_chunk,
+					   int64 nitems,
+					   char **p_nullmap, size_t *p_nullmap_len,
+					   char **p_values, size_t *p_values_len,
+					   char **p_extra, size_t *p_extra_len)
+{
+	pqDecodeState dstate;
+	char	   *cbuf;
+	const char *pos;
+	const char *end;
+	size_t		values_len;
+	int			level_width = (pq_chunk->max_def_level > 0 ? 1 : 0);
+
+	cbuf = MemoryContextAllocHuge(CurrentMemoryContext,
+								  pq_chunk->chunk_length + 1);
+	if (__preadFile(fdesc, cbuf, pq_chunk->chunk_length,
+					pq_chunk->chunk_offset) != pq_chunk->chunk_length)
+		elog(ERROR, "failed on pread(2): %m");
+
+	memset(&dstate, 0, sizeof(pqDecodeState));
+	dstate.pq_chunk = pq_chunk;
+	dstate.nitems = nitems;
+	dstate.unitsz = __parquetArrowUnitSize(pq_chunk);
+	if (pq_chunk->conv == PQ_CONV__BOOL)
+		values_len = BITMAPLEN(nitems);
+	else if (pq_chunk->conv == PQ_CONV__VARLENA)
+		values_len = sizeof(uint32) * (nitems + 1);
+	else
+		values_len = (size_t)dstate.unitsz * nitems;
+	dstate.values = MemoryContextAllocHuge(CurrentMemoryContext, values_len);
+	memset(dstate.values, 0, values_len);
+	if (pq_chunk->max_def_level > 0)
+		dstate.nullmap = palloc0(BITMAPLEN(nitems));
+
+	pos = cbuf;
+	end = cbuf + pq_chunk->chunk_length;
+	while (pos < end && dstate.row_index < nitems)
+	{
+		pqPageHeader phead;
+		thriftReader r;
+		const char *page;
+		char	   *image;
+		pqRleDecoder levels;
+
+		CHECK_FOR_INTERRUPTS();
+		r.pos = pos;
+		r.end = end;
+		__readParquetPageHeader(&r, &phead);
+		page = r.pos;
+		if (phead.compressed_page_size > end - page)
+			elog(ERROR, "parquet: page is out of the ColumnChunk");
+		pos = page + phead.compressed_page_size;
+
+		switch (phead.type)
+		{
+			case PQ_PAGE__DICTIONARY_PAGE:
+				if (dstate.dict_values)
+					elog(ERROR, "parquet: ColumnChunk has multiple DictionaryPages");
+				if (phead.encoding != PQ_ENCODING__PLAIN &&
+					phead.encoding != PQ_ENCODING__PLAIN_DICTIONARY)
+					elog(ERROR, "parquet: unknown DictionaryPage encoding (%d)",
+						 phead.encoding);
+				image = __parquetPageImage(&dstate, page,
+										   phead.compressed_page_size,
+										   phead.uncompressed_page_size,
+										   true);
+				__parquetDecodeDictionaryPage(&dstate, image,
+											  phead.uncompressed_page_size,
+											  phead.num_values);
+				break;
+
+			case PQ_PAGE__DATA_PAGE:
+				image = __parquetPageImage(&dstate, page,
+										   phead.compressed_page_size,
+										   phead.uncompressed_page_size,
+										   true);
+				{
+					const char *vpos = image;
+					const char *vend = image + phead.uncompressed_page_size;
+
+					if (pq_chunk->max_def_level > 0)
+					{
+						uint32	len;
+
+						if (phead.def_level_encoding != PQ_ENCODING__RLE)
+							ereport(ERROR,
+									(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+									 errmsg("parquet: definition level encoding (%d) is not supported",
+											phead.def_level_encoding)));
+						if (vend - vpos < sizeof(uint32))
+							elog(ERROR, "parquet: data page is truncated");
+						memcpy(&len, vpos, sizeof(uint32));
+						vpos += sizeof(uint32);
+						if (len > vend - vpos)
+							elog(ERROR, "parquet: data page is truncated");
+						__pqRleInit(&levels, vpos, vpos + len, level_width);
+						vpos += len;
+					}
+					__parquetDecodeValues(&dstate,
+										  pq_chunk->max_def_level > 0 ? &levels : NULL,
+										  phead.num_values,
+										  phead.encoding,
+										  vpos, vend);
+				}
+				if (image != page)
+					pfree(image);
+				break;
+
+			case PQ_PAGE__DATA_PAGE_V2:
+				{
+					size_t	lv_len = ((size_t)phead.def_levels_length +
+									  (size_t)phead.rep_levels_length);
+					const char *lpos = page + phead.rep_levels_length;
+
+					if (phead.rep_levels_length > 0)
+						ereport(ERROR,
+								(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+								 errmsg("parquet: repetition levels are not supported")));
+					if (lv_len > phead.compressed_page_size ||
+						lv_len > phead.uncompressed_page_size)
+						elog(ERROR, "parquet: data page is corrupted");
+					/* levels are never compressed */
+					image = __parquetPageImage(&dstate,
+											   page + lv_len,
+											   phead.compressed_page_size - lv_len,
+											   phead.uncompressed_page_size - lv_len,
+											   phead.is_compressed);
+					if (pq_chunk->max_def_level > 0)
+						__pqRleInit(&levels, lpos,
+									lpos + phead.def_levels_length,
+									level_width);
+					__parquetDecodeValues(&dstate,
+										  pq_chunk->max_def_level > 0 ? &levels : NULL,
+										  phead.num_values,
+										  phead.encoding,
+										  image,
+										  image + (phead.uncompressed_page_size - lv_len));
+					if (image != page + lv_len)
+						pfree(image);
+				}
+				break;
+
+			case PQ_PAGE__INDEX_PAGE:
+			default:
+				/* skip unknown pages */
+				break;
+		}
+	}
+	if (dstate.row_index != nitems)
+		elog(ERROR, "parquet: ColumnChunk has %ld rows, but %ld expected",
+			 dstate.row_index, nitems);
+
+	if (dstate.nullmap && dstate.has_null)
+	{
+		*p_nullmap = (char *)dstate.nullmap;
+		*p_nullmap_len = BITMAPLEN(nitems);
+	}
+	else
+	{
+		if (dstate.nullmap)
+			pfree(dstate.nullmap);
+		*p_nullmap = NULL;
+		*p_nullmap_len = 0;
+	}
+	*p_values = dstate.values;
+	*p_values_len = values_len;
+	*p_extra = dstate.extra;
+	*p_extra_len = dstate.extra_len;
+	if (dstate.dict_buffer &&
+		(dstate.dict_buffer < cbuf ||
+		 dstate.dict_buffer >= cbuf + pq_chunk->chunk_length))
+		pfree(dstate.dict_buffer);
+	if (dstate.dict_values)
+		pfree(dstate.dict_values);
+	if (dstate.dict_length)
+		pfree(dstate.dict_length);
+	pfree(cbuf);
+}
@@ -0,0 +1,841 @@
+/*
+ * partial_exchange.c
+ *
+ * Routines to export the partial aggregation states produced by GpuPreAgg
+ * (or the results of GpuJoin) in Apache Arrow format, and to build the
+ * query to merge them with the final aggregate functions. It allows to
+ * run the GPU portion of a query on multiple nodes over their local
+ * Arrow or gpu_cache data, then merge the exported files on a coordinator
+ * node through arrow_fdw.
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include "pg_strom.h"
+#include "arrow_ipc.h"
+
+/*
+ * Custom metadata of the exported Arrow files
+ *
+ * The merge query is kept in the schema of the file, as a target-list, a
+ * GROUP BY clause and a HAVING clause that reference the exported columns
+ * by their names (p<resno> of the partial results). The original query is
+ * also kept to identify the source of the file.
+ */
+#define PARTIAL_EXCHANGE_KEY__QUERY			"pg_strom.partial_exchange.query"
+#define PARTIAL_EXCHANGE_KEY__TARGET		"pg_strom.partial_exchange.target"
+#define PARTIAL_EXCHANGE_KEY__GROUP_BY		"pg_strom.partial_exchange.group_by"
+#define PARTIAL_EXCHANGE_KEY__HAVING		"pg_strom.partial_exchange.having"
+
+/*
+ * partialExchangeDest - DestReceiver to write out the tuples
+ */
+typedef struct
+{
+	DestReceiver	pub;
+	const char	   *filename;
+	File			filp;
+	bool			rename_columns;	/* true, if p<resno> naming */
+	ArrowKeyValue  *custom_metadata;
+	int				num_custom_metadata;
+	SQLtable	   *table;
+	MemoryContext	memcxt;
+	int64			nitems;
+} partialExchangeDest;
+
+/*
+ * __deparse_* - deparse the final expression referencing the partial
+ * results by OUTER_VAR. Only the expressions constructed by the final
+ * aggregation of GpuPreAgg are supported; others raise an error.
+ */
+static void __deparse_expr(StringInfo buf, Node *node);
+
+static char *
+__deparse_column_name(AttrNumber resno)
+{
+	return psprintf("p%d", resno);
+}
+
+static char *
+__deparse_type_name(Oid type_oid, int32 typmod)
+{
+#if PG_VERSION_NUM < 110000
+	return format_type_with_typemod_qualified(type_oid, typmod);
+#else
+	return format_type_extended(type_oid, typmod,
+								FORMAT_TYPE_TYPEMOD_GIVEN |
+								FORMAT_TYPE_FORCE_QUALIFY);
+#endif
+}
+
+static char *
+__deparse_func_name(Oid func_oid)
+{
+	Oid			namespace_oid = get_func_namespace(func_oid);
+	char	   *func_name = get_func_name(func_oid);
+
+	if (!func_name)
+		elog(ERROR, "cache lookup failed for function %u", func_oid);
+	return quote_qualified_identifier(get_namespace_name(namespace_oid),
+									  func_name);
+}
+
+static void
+__deparse_operator_name(StringInfo buf, Oid opno)
+{
+	HeapTuple	tup;
+	Form_pg_operator oprForm;
+
+	tup = SearchSysCache1(OPEROID, ObjectIdGetDatum(opno));
+	if (!HeapTupleIsValid(tup))
+		elog(ERROR, "cache lookup failed for operator %u", opno);
+	oprForm = (Form_pg_operator) GETSTRUCT(tup);
+	appendStringInfo(buf, "OPERATOR(%s.%s)",
+					 quote_identifier(get_namespace_name(oprForm->oprnamespace)),
+					 NameStr(oprForm->oprname));
+	ReleaseSysCache(tup);
+}
+
+static void
+__deparse_expr_list(StringInfo buf, List *args, bool funcvariadic)
+{
+	ListCell   *lc;
+	int			count = 0;
+
+	foreach (lc, args)
+	{
+		if (count++ > 0)
+			appendStringInfoString(buf, ", ");
+		if (funcvariadic && count == list_length(args))
+			appendStringInfoString(buf, "VARIADIC ");
+		__deparse_expr(buf, lfirst(lc));
+	}
+}
+
+static void
+__deparse_aggref(StringInfo buf, Aggref *aggref)
+{
+	ListCell   *lc;
+	int			count = 0;
+
+	if (aggref->aggdirectargs != NIL ||
+		(aggref->aggorder != NIL && aggref->aggdistinct == NIL))
+		elog(ERROR, "partial_exchange: ordered aggregate is not supported");
+	appendStringInfo(buf, "%s(", __deparse_func_name(aggref->aggfnoid));
+	if (aggref->aggstar)
+		appendStringInfoChar(buf, '*');
+	else
+	{
+		if (aggref->aggdistinct != NIL)
+			appendStringInfoString(buf, "DISTINCT ");
+		foreach (lc, aggref->args)
+		{
+			TargetEntry *tle = lfirst(lc);
+
+			if (tle->resjunk)
+				continue;
+			if (count++ > 0)
+				appendStringInfoString(buf, ", ");
+			if (aggref->aggvariadic && count == list_length(aggref->args))
+				appendStringInfoString(buf, "VARIADIC ");
+			__deparse_expr(buf, (Node *)tle->expr);
+		}
+	}
+	appendStringInfoChar(buf, ')');
+	if (aggref->aggfilter)
+	{
+		appendStringInfoString(buf, " FILTER (WHERE ");
+		__deparse_expr(buf, (Node *)aggref->aggfilter);
+		appendStringInfoChar(buf, ')');
+	}
+}
+
+static void
+__deparse_typecast(StringInfo buf, Node *arg, Oid type_oid, int32 typmod)
+{
+	appendStringInfoChar(buf, '(');
+	__deparse_expr(buf, arg);
+	appendStringInfo(buf, ")::%s", __deparse_type_name(type_oid, typmod));
+}
+
+static void
+__deparse_expr(StringInfo buf, Node *node)
+{
+	ListCell   *lc;
+
+	if (!node)
+		return;
+	switch (nodeTag(node))
+	{
+		case T_Var:
+			{
+				Var	   *var = (Var *) node;
+
+				if (var->varno != OUTER_VAR)
+					elog(ERROR, "partial_exchange: unexpected Var-node: %s",
+						 nodeToString(var));
+				appendStringInfoString(buf, quote_identifier(
+										   __deparse_column_name(var->varattno)));
+			}
+			break;
+
+		case T_Const:
+			{
+				Const  *con = (Const *) node;
+				Oid		typoutput;
+				bool	typisvarlena;
+
+				if (con->constisnull)
+					appendStringInfoString(buf, "NULL");
+				else
+				{
+					getTypeOutputInfo(con->consttype,
+									  &typoutput,
+									  &typisvarlena);
+					appendStringInfoString(buf, quote_literal_cstr(
+											   OidOutputFunctionCall(typoutput,
+																	 con->constvalue)));
+				}
+				appendStringInfo(buf, "::%s",
+								 __deparse_type_name(con->consttype,
+													 con->consttypmod));
+			}
+			break;
+
+		case T_Aggref:
+			__deparse_aggref(buf, (Aggref *) node);
+			break;
+
+		case T_FuncExpr:
+			{
+				FuncExpr   *f = (FuncExpr *) node;
+
+				if (f->funcformat == COERCE_EXPLICIT_CAST ||
+					f->funcformat == COERCE_IMPLICIT_CAST)
+				{
+					int32	typmod;
+
+					if (!exprIsLengthCoercion(node, &typmod))
+						typmod = -1;
+					__deparse_typecast(buf, linitial(f->args),
+									   f->funcresulttype, typmod);
+				}
+				else
+				{
+					appendStringInfo(buf, "%s(",
+									 __deparse_func_name(f->funcid));
+					__deparse_expr_list(buf, f->args, f->funcvariadic);
+					appendStringInfoChar(buf, ')');
+				}
+			}
+			break;
+
+		case T_OpExpr:
+			{
+				OpExpr	   *op = (OpExpr *) node;
+
+				appendStringInfoChar(buf, '(');
+				if (list_length(op->args) == 2)
+				{
+					__deparse_expr(buf, linitial(op->args));
+					appendStringInfoChar(buf, ' ');
+					__deparse_operator_name(buf, op->opno);
+					appendStringInfoChar(buf, ' ');
+					__deparse_expr(buf, lsecond(op->args));
+				}
+				else if (list_length(op->args) == 1)
+				{
+					__deparse_operator_name(buf, op->opno);
+					appendStringInfoChar(buf, ' ');
+					__deparse_expr(buf, linitial(op->args));
+				}
+				else
+					elog(ERROR, "Bug? operator with %d arguments",
+						 list_length(op->args));
+				appendStringInfoChar(buf, ')');
+			}
+			break;
+
+		case T_BoolExpr:
+			{
+				BoolExpr   *b = (BoolExpr *) node;
+
+				appendStringInfoChar(buf, '(');
+				if (b->boolop == NOT_EXPR)
+				{
+					appendStringInfoString(buf, "NOT ");
+					__deparse_expr(buf, linitial(b->args));
+				}
+				else
+				{
+					foreach (lc, b->args)
+					{
+						if (lc != list_head(b->args))
+							appendStringInfoString(buf, (b->boolop == AND_EXPR
+														 ? " AND "
+														 : " OR "));
+						__deparse_expr(buf, lfirst(lc));
+					}
+				}
+				appendStringInfoChar(buf, ')');
+			}
+			break;
+
+		case T_NullTest:
+			{
+				NullTest   *nt = (NullTest *) node;
+
+				appendStringInfoChar(buf, '(');
+				__deparse_expr(buf, (Node *)nt->arg);
+				appendStringInfoString(buf, (nt->nulltesttype == IS_NULL
+											 ? " IS NULL)"
+											 : " IS NOT NULL)"));
+			}
+			break;
+
+		case T_CoalesceExpr:
+			{
+				CoalesceExpr *c = (CoalesceExpr *) node;
+
+				appendStringInfoString(buf, "COALESCE(");
+				__deparse_expr_list(buf, c->args, false);
+				appendStringInfoChar(buf, ')');
+			}
+			break;
+
+		case T_RelabelType:
+			{
+				RelabelType *r = (RelabelType *) node;
+
+				__deparse_typecast(buf, (Node *)r->arg,
+								   r->resulttype, r->resulttypmod);
+			}
+			break;
+
+		case T_CoerceViaIO:
+			{
+				CoerceViaIO *c = (CoerceViaIO *) node;
+
+				__deparse_typecast(buf, (Node *)c->arg, c->resulttype, -1);
+			}
+			break;
+
+		default:
+			elog(ERROR, "partial_exchange: expression is not supported in the merge query: %s",
+				 nodeToString(node));
+	}
+}
+
+/*
+ * __lookup_final_aggregation
+ *
+ * It walks down the top of the plan tree to the final aggregation; Sort
+ * and Limit above the final aggregation (by ORDER BY and LIMIT clause)
+ * are skipped, because they shall be applied on the merge query.
+ */
+static Plan *
+__lookup_final_aggregation(Plan *plan)
+{
+	while (IsA(plan, Sort) ||
+#if PG_VERSION_NUM >= 130000
+		   IsA(plan, IncrementalSort) ||
+#endif
+		   IsA(plan, Limit))
+	{
+		plan = outerPlan(plan);
+	}
+	return plan;
+}
+
+/*
+ * __plan_produces_partial_states
+ *
+ * It checks whether the subtree below the final aggregation delivers
+ * partial states built by GpuPreAgg only.
+ */
+static bool
+__plan_produces_partial_states(Plan *plan)
+{
+	ListCell   *lc;
+
+	if (pgstrom_plan_is_gpupreagg(plan))
+		return true;
+	switch (nodeTag(plan))
+	{
+		case T_Sort:
+		case T_Gather:
+		case T_GatherMerge:
+			return __plan_produces_partial_states(outerPlan(plan));
+		case T_Append:
+			foreach (lc, ((Append *) plan)->appendplans)
+			{
+				if (!__plan_produces_partial_states(lfirst(lc)))
+					return false;
+			}
+			return true;
+		case T_MergeAppend:
+			foreach (lc, ((MergeAppend *) plan)->mergeplans)
+			{
+				if (!__plan_produces_partial_states(lfirst(lc)))
+					return false;
+			}
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
+
+static bool
+__plan_has_aggregation(Plan *plan)
+{
+	ListCell   *lc;
+
+	if (!plan)
+		return false;
+	if (IsA(plan, Agg) || IsA(plan, Group) || IsA(plan, WindowAgg))
+		return true;
+	if (IsA(plan, Append))
+	{
+		foreach (lc, ((Append *) plan)->appendplans)
+		{
+			if (__plan_has_aggregation(lfirst(lc)))
+				return true;
+		}
+	}
+	else if (IsA(plan, MergeAppend))
+	{
+		foreach (lc, ((MergeAppend *) plan)->mergeplans)
+		{
+			if (__plan_has_aggregation(lfirst(lc)))
+				return true;
+		}
+	}
+	else if (IsA(plan, SubqueryScan))
+		return __plan_has_aggregation(((SubqueryScan *) plan)->subplan);
+	else if (IsA(plan, CustomScan))
+	{
+		foreach (lc, ((CustomScan *) plan)->custom_plans)
+		{
+			if (__plan_has_aggregation(lfirst(lc)))
+				return true;
+		}
+	}
+	return (__plan_has_aggregation(outerPlan(plan)) ||
+			__plan_has_aggregation(innerPlan(plan)));
+}
+
+static void
+__append_custom_metadata(partialExchangeDest *pxdest,
+						 const char *key, const char *value)
+{
+	ArrowKeyValue *kv;
+	int			index = pxdest->num_custom_metadata++;
+
+	if (!pxdest->custom_metadata)
+		pxdest->custom_metadata = palloc(sizeof(ArrowKeyValue));
+	else
+		pxdest->custom_metadata = repalloc(pxdest->custom_metadata,
+										   sizeof(ArrowKeyValue) * (index+1));
+	kv = &pxdest->custom_metadata[index];
+	initArrowNode(kv, KeyValue);
+	kv->key = pstrdup(key);
+	kv->_key_len = strlen(key);
+	kv->value = pstrdup(value);
+	kv->_value_len = strlen(value);
+}
+
+/*
+ * setup_partial_exchange_plan
+ *
+ * It replaces the top of the plan tree by the subtree that produces the
+ * partial states of GpuPreAgg, then saves the merge query in the custom
+ * metadata. If query has no aggregation, the query results are exported
+ * as is; e.g, results of GpuJoin to be merged by UNION ALL.
+ */
+static PlannedStmt *
+setup_partial_exchange_plan(PlannedStmt *pstmt,
+							const char *query_string,
+							partialExchangeDest *pxdest)
+{
+	PlannedStmt *result = copyObject(pstmt);
+	Plan	   *final = __lookup_final_aggregation(result->planTree);
+	Plan	   *partial;
+	StringInfoData buf;
+	ListCell   *lc;
+	int			i, count;
+
+	__append_custom_metadata(pxdest, PARTIAL_EXCHANGE_KEY__QUERY,
+							 query_string);
+	if (!IsA(final, Agg) && !IsA(final, Group))
+	{
+		if (__plan_has_aggregation(final))
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("partial_exchange: aggregation of the query is not the top of the plan"),
+					 errhint("Results of aggregation below the top of query are not mergeable across nodes.")));
+		__append_custom_metadata(pxdest, PARTIAL_EXCHANGE_KEY__TARGET, "*");
+		result->planTree = final;
+		pxdest->rename_columns = false;
+		return result;
+	}
+
+	if (IsA(final, Agg))
+	{
+		Agg	   *agg = (Agg *) final;
+
+		if (agg->aggsplit != AGGSPLIT_SIMPLE || agg->groupingSets != NIL)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("partial_exchange: aggregation is not run by GpuPreAgg"),
+					 errhint("Only simple GROUP BY (without GROUPING SETS) is supported.")));
+	}
+	partial = outerPlan(final);
+	if (!__plan_produces_partial_states(partial))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("partial_exchange: aggregation is not run by GpuPreAgg"),
+				 errhint("Check EXPLAIN of the query whether GpuPreAgg is chosen.")));
+	/* sorting by the final aggregation is not necessary */
+	while (IsA(partial, Sort))
+		partial = outerPlan(partial);
+
+	/* target-list of the merge query */
+	initStringInfo(&buf);
+	count = 0;
+	foreach (lc, final->targetlist)
+	{
+		TargetEntry *tle = lfirst(lc);
+
+		if (tle->resjunk)
+			continue;
+		if (count++ > 0)
+			appendStringInfoString(&buf, ", ");
+		__deparse_expr(&buf, (Node *)tle->expr);
+		if (tle->resname)
+			appendStringInfo(&buf, " AS %s", quote_identifier(tle->resname));
+	}
+	__append_custom_metadata(pxdest, PARTIAL_EXCHANGE_KEY__TARGET, buf.data);
+
+	/* GROUP BY clause of the merge query */
+	if (IsA(final, Agg) ? ((Agg *) final)->numCols > 0
+						: ((Group *) final)->numCols > 0)
+	{
+		AttrNumber *grpColIdx;
+		int			numCols;
+
+		if (IsA(final, Agg))
+		{
+			grpColIdx = ((Agg *) final)->grpColIdx;
+			numCols = ((Agg *) final)->numCols;
+		}
+		else
+		{
+			grpColIdx = ((Group *) final)->grpColIdx;
+			numCols = ((Group *) final)->numCols;
+		}
+		resetStringInfo(&buf);
+		for (i=0; i < numCols; i++)
+		{
+			if (i > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfoString(&buf, quote_identifier(
+									   __deparse_column_name(grpColIdx[i])));
+		}
+		__append_custom_metadata(pxdest, PARTIAL_EXCHANGE_KEY__GROUP_BY,
+								 buf.data);
+	}
+
+	/* HAVING clause of the merge query */
+	if (final->qual != NIL)
+	{
+		resetStringInfo(&buf);
+		foreach (lc, final->qual)
+		{
+			if (lc != list_head(final->qual))
+				appendStringInfoString(&buf, " AND ");
+			__deparse_expr(&buf, lfirst(lc));
+		}
+		__append_custom_metadata(pxdest, PARTIAL_EXCHANGE_KEY__HAVING,
+								 buf.data);
+	}
+	pfree(buf.data);
+
+	/*
+	 * All the partial results are referenced by the final aggregation by
+	 * their resno, so none of them are junk here.
+	 */
+	foreach (lc, partial->targetlist)
+	{
+		TargetEntry *tle = lfirst(lc);
+
+		tle->resjunk = false;
+	}
+	result->planTree = partial;
+	pxdest->rename_columns = true;
+
+	return result;
+}
+
+/*
+ * DestReceiver callbacks
+ */
+static void
+partialExchangeStartup(DestReceiver *self, int operation, TupleDesc typeinfo)
+{
+	partialExchangeDest *pxdest = (partialExchangeDest *) self;
+	TupleDesc	tupdesc = CreateTupleDescCopy(typeinfo);
+	SQLtable   *table;
+	int			j;
+
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+
+		if (pxdest->rename_columns)
+			namestrcpy(&attr->attname, __deparse_column_name(j+1));
+		else if (NameStr(attr->attname)[0] == '\0')
+			snprintf(NameStr(attr->attname), NAMEDATALEN, "col%d", j+1);
+	}
+	pxdest->filp = PathNameOpenFilePerm(pxdest->filename,
+										O_RDWR | O_CREAT | O_EXCL | PG_BINARY,
+										0600);
+	if (pxdest->filp < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m",
+						pxdest->filename)));
+	table = palloc0(offsetof(SQLtable, columns[tupdesc->natts]));
+	setupArrowSQLbufferSchema(table, tupdesc, NULL);
+	table->filename = pxdest->filename;
+	table->fdesc = FileGetRawDesc(pxdest->filp);
+	table->customMetadata = pxdest->custom_metadata;
+	table->numCustomMetadata = pxdest->num_custom_metadata;
+	arrowFileWrite(table, "ARROW1\0\0", 8);
+	writeArrowSchema(table);
+
+	pxdest->table = table;
+	pxdest->memcxt = AllocSetContextCreate(CurrentMemoryContext,
+										   "partial exchange buffer",
+										   ALLOCSET_DEFAULT_SIZES);
+}
+
+static bool
+partialExchangeReceive(TupleTableSlot *slot, DestReceiver *self)
+{
+	partialExchangeDest *pxdest = (partialExchangeDest *) self;
+	SQLtable   *table = pxdest->table;
+	TupleDesc	tupdesc = slot->tts_tupleDescriptor;
+	MemoryContext oldcxt;
+	size_t		usage = 0;
+	int			j;
+
+	slot_getallattrs(slot);
+	oldcxt = MemoryContextSwitchTo(pxdest->memcxt);
+	for (j=0; j < tupdesc->natts; j++)
+	{
+		Form_pg_attribute attr = tupleDescAttr(tupdesc, j);
+		SQLfield   *column = &table->columns[j];
+		Datum		datum = slot->tts_values[j];
+
+		if (slot->tts_isnull[j])
+			usage += sql_field_put_value(column, NULL, 0);
+		else if (attr->attbyval)
+			usage += sql_field_put_value(column, (char *)&datum, attr->attlen);
+		else if (attr->attlen == -1)
+		{
+			struct varlena *vl = pg_detoast_datum_packed((struct varlena *)
+														 DatumGetPointer(datum));
+			usage += sql_field_put_value(column, VARDATA_ANY(vl),
+										 VARSIZE_ANY_EXHDR(vl));
+		}
+		else
+			usage += sql_field_put_value(column, DatumGetPointer(datum),
+										 attr->attlen);
+	}
+	table->usage = usage;
+	table->nitems++;
+	pxdest->nitems++;
+	MemoryContextSwitchTo(oldcxt);
+
+	if (usage > table->segment_sz)
+	{
+		writeArrowRecordBatch(table);
+		sql_table_clear(table);
+		MemoryContextReset(pxdest->memcxt);
+	}
+	return true;
+}
+
+static void
+partialExchangeShutdown(DestReceiver *self)
+{
+	partialExchangeDest *pxdest = (partialExchangeDest *) self;
+	SQLtable   *table = pxdest->table;
+
+	if (table->nitems > 0)
+	{
+		writeArrowRecordBatch(table);
+		sql_table_clear(table);
+	}
+	writeArrowFooter(table);
+	FileClose(pxdest->filp);
+	pxdest->filp = -1;
+	MemoryContextDelete(pxdest->memcxt);
+}
+
+static void
+partialExchangeDestroy(DestReceiver *self)
+{
+	/* nothing to do */
+}
+
+/*
+ * pgstrom_partial_export
+ *
+ * pgstrom.partial_export(query text, filename text) returns bigint
+ *
+ * It runs the query by the end of GpuPreAgg, then writes out the partial
+ * states to the Arrow file. The final aggregation is saved as the merge
+ * query in the custom metadata, to be built by partial_merge_query().
+ */
+Datum
+pgstrom_partial_export(PG_FUNCTION_ARGS)
+{
+	char	   *query_string = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char	   *filename = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	partialExchangeDest *pxdest;
+	List	   *raw_parsetree_list;
+	List	   *query_list;
+	Query	   *query;
+	PlannedStmt *pstmt;
+	QueryDesc  *qdesc;
+
+	if (!superuser())
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("must be superuser to export partial states to a file")));
+
+	raw_parsetree_list = pg_parse_query(query_string);
+	if (list_length(raw_parsetree_list) != 1)
+		elog(ERROR, "partial_export: query must be a single SELECT statement");
+	query_list = pg_analyze_and_rewrite(linitial(raw_parsetree_list),
+										query_string,
+										NULL, 0, NULL);
+	if (list_length(query_list) != 1)
+		elog(ERROR, "partial_export: query must be a single SELECT statement");
+	query = linitial(query_list);
+	if (query->commandType != CMD_SELECT ||
+		query->utilityStmt != NULL ||
+		query->rowMarks != NIL)
+		elog(ERROR, "partial_export: query must be a single SELECT statement");
+	pstmt = pg_plan_query(query, query_string, CURSOR_OPT_PARALLEL_OK, NULL);
+
+	pxdest = palloc0(sizeof(partialExchangeDest));
+	pxdest->pub.receiveSlot = partialExchangeReceive;
+	pxdest->pub.rStartup    = partialExchangeStartup;
+	pxdest->pub.rShutdown   = partialExchangeShutdown;
+	pxdest->pub.rDestroy    = partialExchangeDestroy;
+	pxdest->pub.mydest      = DestNone;
+	pxdest->filename = filename;
+	pxdest->filp = -1;
+	pstmt = setup_partial_exchange_plan(pstmt, query_string, pxdest);
+
+	PG_TRY();
+	{
+		qdesc = CreateQueryDesc(pstmt,
+								query_string,
+								GetActiveSnapshot(),
+								InvalidSnapshot,
+								(DestReceiver *)pxdest,
+								NULL,
+								NULL,
+								0);
+		ExecutorStart(qdesc, 0);
+		ExecutorRun(qdesc, ForwardScanDirection, 0L, true);
+		ExecutorFinish(qdesc);
+		ExecutorEnd(qdesc);
+		FreeQueryDesc(qdesc);
+	}
+	PG_CATCH();
+	{
+		/* remove the half-written file */
+		if (pxdest->filp >= 0)
+		{
+			FileClose(pxdest->filp);
+			if (unlink(filename) != 0)
+				elog(WARNING, "failed on unlink('%s'): %m", filename);
+		}
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	PG_RETURN_INT64(pxdest->nitems);
+}
+PG_FUNCTION_INFO_V1(pgstrom_partial_export);
+
+/*
+ * pgstrom_partial_merge_query
+ *
+ * pgstrom.partial_merge_query(filename text, relname regclass) returns text
+ *
+ * It builds the query to merge the exported partial states, on the foreign
+ * table (usually arrow_fdw that maps the exported files).
+ */
+Datum
+pgstrom_partial_merge_query(PG_FUNCTION_ARGS)
+{
+	char	   *filename = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	Oid			relid = PG_GETARG_OID(1);
+	char	   *relname = get_rel_name(relid);
+	const char *target = NULL;
+	const char *group_by = NULL;
+	const char *having = NULL;
+	ArrowFileInfo af_info;
+	ArrowSchema *schema;
+	StringInfoData buf;
+	File		filp;
+	int			i;
+
+	if (!relname)
+		elog(ERROR, "cache lookup failed for relation %u", relid);
+	filp = PathNameOpenFile(filename, O_RDONLY | PG_BINARY);
+	if (filp < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\": %m", filename)));
+	readArrowFileDesc(FileGetRawDesc(filp), &af_info);
+	FileClose(filp);
+
+	schema = &af_info.footer.schema;
+	for (i=0; i < schema->_num_custom_metadata; i++)
+	{
+		ArrowKeyValue *kv = &schema->custom_metadata[i];
+
+		if (strcmp(kv->key, PARTIAL_EXCHANGE_KEY__TARGET) == 0)
+			target = kv->value;
+		else if (strcmp(kv->key, PARTIAL_EXCHANGE_KEY__GROUP_BY) == 0)
+			group_by = kv->value;
+		else if (strcmp(kv->key, PARTIAL_EXCHANGE_KEY__HAVING) == 0)
+			having = kv->value;
+	}
+	if (!target)
+		elog(ERROR, "Arrow file '%s' is not exported by partial_export()",
+			 filename);
+
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "SELECT %s FROM %s",
+					 target,
+					 quote_qualified_identifier(get_namespace_name(get_rel_namespace(relid)),
+												relname));
+	if (group_by)
+		appendStringInfo(&buf, " GROUP BY %s", group_by);
+	if (having)
+		appendStringInfo(&buf, " HAVING %s", having);
+
+	PG_RETURN_TEXT_P(cstring_to_text(buf.data));
+}
+PG_FUNCTION_INFO_V1(pgstrom_partial_merge_query);
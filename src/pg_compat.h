@@ -359,6 +359,13 @@ add_function_cost(PlannerInfo *root, Oid funcid, Node *node,
 	set_deparse_context_plan((deparse_cxt),((PlanState *)(planstate))->plan,ancestors)
 #endif
 
+/*
+ * MEMO: PG13 added 'query_string' argument to pg_plan_query()
+ */
+#if PG_VERSION_NUM < 130000
+#define pg_plan_query(a,b,c,d)			pg_plan_query((a),(c),(d))
+#endif
+
 /*
  * PG14 changed API to pick up var-nodes from the expression.
  */
@@ -42,6 +42,9 @@
 #include "access/twophase.h"
 #include "access/visibilitymap.h"
 #include "access/xact.h"
+#include "access/xlog.h"
+#include "access/xlogreader.h"
+#include "access/xlogutils.h"
 #include "catalog/catalog.h"
 #include "catalog/dependency.h"
 #include "catalog/heap.h"
@@ -87,12 +90,14 @@
 #include "commands/typecmds.h"
 #include "commands/variable.h"
 #include "common/base64.h"
+#include "common/file_perm.h"
 #if PG_VERSION_NUM >= 130000
 #include "common/hashfn.h"
 #endif
 #include "common/int.h"
 #include "common/md5.h"
 #include "executor/executor.h"
+#include "executor/functions.h"
 #include "executor/nodeAgg.h"
 #include "executor/nodeIndexscan.h"
 #include "executor/nodeCustom.h"
@@ -141,6 +146,7 @@
 #if PG_VERSION_NUM < 120000
 #include "optimizer/var.h"
 #endif
+#include "parser/analyze.h"
 #include "parser/parse_coerce.h"
 #include "parser/parsetree.h"
 #include "parser/parse_func.h"
@@ -148,8 +154,13 @@
 #include "parser/scansup.h"
 #include "pgstat.h"
 #include "port/atomics.h"
+#include "port/pg_crc32c.h"
+#include "postmaster/autovacuum.h"
 #include "postmaster/bgworker.h"
 #include "postmaster/postmaster.h"
+#include "replication/walsender.h"
+#include "rewrite/rewriteHandler.h"
+#include "rewrite/rewriteManip.h"
 #include "storage/buf.h"
 #include "storage/buf_internals.h"
 #include "storage/ipc.h"
@@ -166,6 +177,7 @@
 #include "storage/shmem.h"
 #include "storage/smgr.h"
 #include "storage/spin.h"
+#include "tcop/tcopprot.h"
 #include "utils/array.h"
 #include "utils/arrayaccess.h"
 #include "utils/builtins.h"
@@ -181,6 +193,9 @@
 #include "utils/guc.h"
 #include "utils/json.h"
 #include "utils/jsonb.h"
+#if PG_VERSION_NUM >= 120000
+#include "utils/jsonpath.h"
+#endif
 #include "utils/inet.h"
 #include "utils/int8.h"
 #include "utils/inval.h"
@@ -192,6 +207,7 @@
 #include "utils/rangetypes.h"
 #include "utils/regproc.h"
 #include "utils/rel.h"
+#include "utils/relfilenodemap.h"
 #include "utils/resowner.h"
 #include "utils/ruleutils.h"
 #include "utils/selfuncs.h"
@@ -262,6 +278,20 @@
 #include "pg_compat.h"
 
 #define RESTRACK_HASHSIZE		53
+
+/*
+ * GpuMemSlabCache - per GpuContext cache of small device memory chunks for
+ * each memory kind and size class (16KB ... 1MB); see gpu_mmgr.c
+ */
+#define GPUMEM_SLAB_NKINDS		4
+#define GPUMEM_SLAB_NCLASSES	7
+typedef struct
+{
+	slock_t			lock;
+	dlist_head		free_chunks;
+	cl_int			nitems;
+} GpuMemSlabCache;
+
 typedef struct GpuContext
 {
 	dlist_node		chain;
@@ -280,6 +310,15 @@ typedef struct GpuContext
 	dlist_head		gm_iomap_list;		/* list of I/O map memory segments */
 	dlist_head		gm_managed_list;	/* list of managed memory segments */
 	dlist_head		gm_hostmem_list;	/* list of Host memory segments */
+	GpuMemSlabCache	gm_slab[GPUMEM_SLAB_NKINDS][GPUMEM_SLAB_NCLASSES];
+	size_t			gm_budget;			/* device memory budget reserved */
+	size_t			gm_budget_peak;		/* high-water mark of gm_budget */
+	/* share of the queued/running tasks; see gpuStatUpdateTasks() */
+	pg_atomic_uint32 stat_queued_tasks;
+	pg_atomic_uint32 stat_running_tasks;
+	/* CUDA graphs cached by GpuScan; see gpuscan_launch_cuda_graph() */
+	slock_t			cuda_graph_lock;
+	dlist_head		cuda_graph_list;
 	/* error information buffer */
 	pg_atomic_uint32 error_level;
 	int				error_code;
@@ -318,6 +357,16 @@ typedef enum {
 	GpuTaskKind_PL_CUDA,
 } GpuTaskKind;
 
+/*
+ * Stages of GpuTask, for the timing breakdown in EXPLAIN ANALYZE
+ */
+#define GPUTASK_STAGE__QUEUE		0	/* wait for the worker thread */
+#define GPUTASK_STAGE__DMA_SEND		1	/* host-to-device DMA */
+#define GPUTASK_STAGE__KERN_EXEC	2	/* GPU kernel execution */
+#define GPUTASK_STAGE__DMA_RECV		3	/* device-to-host DMA */
+#define GPUTASK_STAGE__HOST			4	/* consumption of the results */
+#define GPUTASK_NUM_STAGES			5
+
 typedef struct GpuTask				GpuTask;
 typedef struct GpuTaskState			GpuTaskState;
 typedef struct GpuTaskSharedState	GpuTaskSharedState;
@@ -331,6 +380,7 @@ typedef struct GpuCacheState		GpuCacheState;
  */
 struct NVMEScanState;
 struct GpuTaskSharedState;
+struct pgstromChunkRing;
 
 struct GpuTaskState
 {
@@ -358,6 +408,10 @@ struct GpuTaskState
 
 	IndexScanDesc	outer_brin_index;	/* brin index of outer scan, if any */
 	long			outer_brin_count;	/* # of blocks skipped by index */
+	cl_uint			outer_prefetch_ahead; /* # of blocks prefetched ahead */
+	/* zone-map support on outer relation, if any */
+	struct pgstromZoneMapState *outer_zmap_state;
+	long			outer_zmap_count;	/* # of blocks skipped by zone-map */
 
 	ArrowFdwState  *af_state;			/* for GpuTask on Arrow_Fdw */
 	GpuCacheState  *gc_state;			/* for GpuTask on GpuCache */
@@ -369,6 +423,9 @@ struct GpuTaskState
 	struct NVMEScanState *nvme_sstate;
 	long			nvme_count;			/* # of blocks loaded by SSD2GPU */
 
+	/* ring of the chunk buffers to be recycled, for heap-scan */
+	struct pgstromChunkRing *chunk_ring;
+
 	/*
 	 * fields to fetch rows from the current task
 	 *
@@ -394,13 +451,54 @@ struct GpuTaskState
 	int			  (*cb_process_task)(GpuTask *gtask,
 									 CUmodule cuda_module);
 	void		  (*cb_release_task)(GpuTask *gtask);
+	bool		  (*cb_cpu_hybrid_task)(GpuTaskState *gts, GpuTask *gtask);
+	void		  (*cb_fanout_begin)(GpuTaskState *gts);
 	/* list of GpuTasks (protexted with GpuContext->mutex) */
 	dlist_head		ready_tasks;	/* list of tasks already processed */
 	cl_uint			num_running_tasks;	/* # of running tasks */
 	cl_uint			num_ready_tasks;	/* # of ready tasks */
+	cl_int			max_async_tasks;	/* # of tasks allowed by the budget */
+	size_t			gm_budget;			/* device memory budget reserved */
+	cl_int			sched_weight;		/* weight registered to scheduler */
+	TimestampTz		sched_wait_start;	/* start time of the scheduler wait */
+	cl_ulong		sched_wait_usec;	/* total time of the scheduler wait */
+	struct timeval	sched_tv_begin;		/* time of the registration */
+	cl_ulong		sched_nprocs_sum;	/* sum of the concurrent processes */
+	cl_ulong		sched_nprocs_count;	/* # of samples of the above */
+	struct GpuTaskFanout *fanout;		/* entry of the Append fan-out */
 
 	/* misc fields */
 	cl_long			num_cpu_fallbacks;	/* # of CPU fallback chunks */
+	cl_long			num_cpu_rechecks;	/* # of rows rechecked by CPU */
+	cl_long			num_gpu_tasks;		/* # of chunks processed by GPU */
+	cl_long			num_cpu_hybrid_tasks; /* # of chunks processed by CPU */
+
+	/* feedback of the CPU/GPU hybrid execution */
+	double			hybrid_gpu_latency;	/* avg latency of GPU tasks [ms] */
+	double			hybrid_cpu_latency;	/* avg latency of CPU chunks [ms] */
+	struct timeval	hybrid_tv_begin;	/* start time of the CPU chunk */
+
+	/* adaptive chunk size of the heap-scan (KDS_FORMAT_ROW) */
+	size_t			chunk_adapt_sz;		/* current size, or 0 if fixed */
+	size_t			chunk_adapt_min_sz;	/* min size chosen */
+	size_t			chunk_adapt_max_sz;	/* max size chosen */
+	cl_int			chunk_adapt_votes;	/* >0 to grow, <0 to shrink */
+	cl_int			chunk_adapt_nresized; /* # of resizing */
+	double			chunk_host_latency;	/* avg host time per chunk [ms] */
+	double			chunk_load_latency;	/* host time to load the last chunk [ms] */
+	struct timeval	chunk_tv_pickup;	/* pickup time of the current task */
+	/* time of GPU tasks, for the calibration of the cost model */
+	double			gpu_exec_msec;		/* total time of GPU tasks [ms] */
+	cl_long			gpu_exec_ntasks;	/* # of GPU tasks measured */
+	/* timing breakdown of GPU tasks; GPUTASK_STAGE__* */
+	cl_ulong		stage_usec[GPUTASK_NUM_STAGES];
+	cl_ulong		dma_send_bytes;		/* bytes sent to the device */
+	cl_ulong		dma_recv_bytes;		/* bytes written back to the host */
+	bool			rtstat_merged;		/* runtime stat is already merged */
+	/* NVTX/CUPTI tracing; see gpu_trace.c */
+	cl_uint			trace_flags;		/* GPUTASK_TRACE__* */
+	cl_uint			trace_nchunks;		/* # of tasks created */
+	char			trace_label[NAMEDATALEN]; /* plan node and query-id */
 	uint64			debug_counter0;
 	uint64			debug_counter1;
 	uint64			debug_counter2;
@@ -411,6 +509,16 @@ struct GpuTaskState
 	ParallelContext	*pcxt;			/* Parallel context of PostgreSQL */
 };
 
+/*
+ * ArrowFdwIoStats - I/O statistics of arrow_fdw scan
+ */
+typedef struct
+{
+	pg_atomic_uint64 nr_reads;		/* # of issued read requests */
+	pg_atomic_uint64 read_bytes;	/* total length actually read */
+	pg_atomic_uint64 used_bytes;	/* total length of referenced buffers */
+} ArrowFdwIoStats;
+
 /*
  * GpuTaskSharedState
  */
@@ -420,6 +528,10 @@ struct GpuTaskSharedState
 	pg_atomic_uint32 af_rbatch_index;
 	pg_atomic_uint32 af_rbatch_nload; /* # of loaded record-batches */
 	pg_atomic_uint32 af_rbatch_nskip; /* # of skipped record-batches */
+	pg_atomic_uint32 af_rbatch_nstats; /* # of record-batches aggregated
+										* by the min/max statistics */
+	ArrowFdwIoStats	af_io_stats;
+	Size			af_sched_offset; /* offset to the record-batch scheduler */
 	/* for gpu_cache file scan  */
 	pg_atomic_uint32 gc_fetch_count;
 	/* for block-based regular table scan */
@@ -427,6 +539,7 @@ struct GpuTaskSharedState
 	slock_t			pbs_mutex;		/* lock of the fields below */
 	BlockNumber		pbs_startblock;	/* starting block number */
 	BlockNumber		pbs_nallocated;	/* # of blocks allocated to workers */
+	BlockNumber		pbs_stripe_nblocks; /* stripe width of md-raid0, or 0 */
 
 	/* common parallel table scan descriptor */
 	ParallelTableScanDescData phscan;
@@ -443,7 +556,15 @@ typedef struct
 	pg_atomic_uint64	nitems_filtered;
 	pg_atomic_uint64	nvme_count;
 	pg_atomic_uint64	brin_count;
+	pg_atomic_uint64	zmap_count;
 	pg_atomic_uint64	fallback_count;
+	pg_atomic_uint64	recheck_count;
+	pg_atomic_uint64	gpu_task_count;
+	pg_atomic_uint64	cpu_hybrid_count;
+	pg_atomic_uint64	stage_usec[GPUTASK_NUM_STAGES];
+	pg_atomic_uint64	dma_send_bytes;
+	pg_atomic_uint64	dma_recv_bytes;
+	pg_atomic_uint64	gpu_mem_peak;
 	/* debug counter */
 	pg_atomic_uint64	debug_counter0;
 	pg_atomic_uint64	debug_counter1;
@@ -455,6 +576,8 @@ static inline void
 mergeGpuTaskRuntimeStatParallelWorker(GpuTaskState *gts,
 									  GpuTaskRuntimeStat *gt_rtstat)
 {
+	int		i;
+
 	Assert(IsParallelWorker());
 	if (!gt_rtstat)
 		return;
@@ -464,8 +587,23 @@ mergeGpuTaskRuntimeStatParallelWorker(GpuTaskState *gts,
 	SpinLockRelease(&gt_rtstat->lock);
 	pg_atomic_add_fetch_u64(&gt_rtstat->nvme_count, gts->nvme_count);
 	pg_atomic_add_fetch_u64(&gt_rtstat->brin_count, gts->outer_brin_count);
+	pg_atomic_add_fetch_u64(&gt_rtstat->zmap_count, gts->outer_zmap_count);
 	pg_atomic_add_fetch_u64(&gt_rtstat->fallback_count,
 							gts->num_cpu_fallbacks);
+	pg_atomic_add_fetch_u64(&gt_rtstat->recheck_count,
+							gts->num_cpu_rechecks);
+	pg_atomic_add_fetch_u64(&gt_rtstat->gpu_task_count,
+							gts->num_gpu_tasks);
+	pg_atomic_add_fetch_u64(&gt_rtstat->cpu_hybrid_count,
+							gts->num_cpu_hybrid_tasks);
+	for (i=0; i < GPUTASK_NUM_STAGES; i++)
+		pg_atomic_add_fetch_u64(&gt_rtstat->stage_usec[i],
+								gts->stage_usec[i]);
+	pg_atomic_add_fetch_u64(&gt_rtstat->dma_send_bytes, gts->dma_send_bytes);
+	pg_atomic_add_fetch_u64(&gt_rtstat->dma_recv_bytes, gts->dma_recv_bytes);
+	if (gts->gcontext)
+		pg_atomic_add_fetch_u64(&gt_rtstat->gpu_mem_peak,
+								gts->gcontext->gm_budget_peak);
 	/* debug counter */
 	if (gts->debug_counter0 != 0)
 		pg_atomic_add_fetch_u64(&gt_rtstat->debug_counter0, gts->debug_counter0);
@@ -481,6 +619,8 @@ static inline void
 mergeGpuTaskRuntimeStat(GpuTaskState *gts,
 						GpuTaskRuntimeStat *gt_rtstat)
 {
+	int		i;
+
 	InstrAggNode(&gts->outer_instrument,
 				 &gt_rtstat->outer_instrument);
 	gts->outer_instrument.tuplecount = (double)
@@ -489,7 +629,16 @@ mergeGpuTaskRuntimeStat(GpuTaskState *gts,
 		pg_atomic_read_u64(&gt_rtstat->nitems_filtered);
 	gts->nvme_count += pg_atomic_read_u64(&gt_rtstat->nvme_count);
 	gts->outer_brin_count += pg_atomic_read_u64(&gt_rtstat->brin_count);
+	gts->outer_zmap_count += pg_atomic_read_u64(&gt_rtstat->zmap_count);
 	gts->num_cpu_fallbacks += pg_atomic_read_u64(&gt_rtstat->fallback_count);
+	gts->num_cpu_rechecks += pg_atomic_read_u64(&gt_rtstat->recheck_count);
+	gts->num_gpu_tasks += pg_atomic_read_u64(&gt_rtstat->gpu_task_count);
+	gts->num_cpu_hybrid_tasks += pg_atomic_read_u64(&gt_rtstat->cpu_hybrid_count);
+	for (i=0; i < GPUTASK_NUM_STAGES; i++)
+		gts->stage_usec[i] += pg_atomic_read_u64(&gt_rtstat->stage_usec[i]);
+	gts->dma_send_bytes += pg_atomic_read_u64(&gt_rtstat->dma_send_bytes);
+	gts->dma_recv_bytes += pg_atomic_read_u64(&gt_rtstat->dma_recv_bytes);
+	gts->rtstat_merged = true;
 
 	gts->debug_counter0 += pg_atomic_read_u64(&gt_rtstat->debug_counter0);
 	gts->debug_counter1 += pg_atomic_read_u64(&gt_rtstat->debug_counter1);
@@ -516,17 +665,32 @@ struct GpuTask
 	ProgramId		program_id;		/* same with GTS's one */
 	GpuTaskState   *gts;			/* GTS reference in the backend */
 	bool			cpu_fallback;	/* true, if task needs CPU fallback */
+	bool			cpu_hybrid;		/* true, if task is processed by CPU */
+	struct timeval	tv_submit;		/* time when task is enqueued */
+	struct timeval	tv_launch;		/* time when worker launches the task */
+	struct timeval	tv_ready;		/* time when task gets completed */
+	cl_ulong		stage_usec[GPUTASK_NUM_STAGES];	/* measured by worker */
+	cl_ulong		dma_send_bytes;	/* bytes sent to the device */
+	cl_ulong		dma_recv_bytes;	/* bytes written back to the host */
+	cl_uint			chunk_id;		/* sequence number in the GTS */
 };
 
 /*
  * State structure of NVMe-Strom per GpuTaskState
  */
+#define NVME_COLD_PROBE_NBLOCKS		1024
 typedef struct NVMEScanState
 {
 	cl_uint			nrows_per_block;
 	cl_uint			nblocks_per_chunk;
 	BlockNumber		curr_segno;
 	Buffer			curr_vmbuffer;
+	/* window of the blocks that are all-visible and not on shared buffers */
+	BlockNumber		cold_base;
+	cl_uint			cold_nblocks;
+	bits8			cold_map[NVME_COLD_PROBE_NBLOCKS / BITS_PER_BYTE];
+	/* MVCC snapshot for the device side visibility checks, if any */
+	kern_mvcc_snapshot *mvcc_snapshot;	/* managed memory */
 	BlockNumber		nr_segs;
 	GPUDirectFileDesc files[FLEXIBLE_ARRAY_MEMBER];
 } NVMEScanState;
@@ -543,6 +707,9 @@ typedef struct pgstrom_data_store
 	/* reference counter */
 	pg_atomic_uint32	refcnt;
 
+	/* chunk-ring to be returned on release, if any */
+	struct pgstromChunkRing *chunk_ring;
+
 	/*
 	 * NOTE: Extra information for KDS_FORMAT_BLOCK.
 	 * @nblocks_uncached is number of PostgreSQL blocks, to be processed
@@ -556,23 +723,49 @@ typedef struct pgstrom_data_store
 	 * If NULL, KDS is preliminary loaded by CPU and filesystem, and
 	 * PDS is also allocated on managed memory area. So, worker don't
 	 * need to kick DMA operations explicitly.
+	 * If @mmap_holder is valid, PDS is the head of an anonymous mapping,
+	 * and the RecordBatch is mapped on the tail of the region; thus, KDS
+	 * refers the page cache directly, and it is released by munmap(2).
 	 *
 	 * NOTE: Extra information for KDS_FORMAT_COLUMN
 	 * @gc_sstate points the GpuCacheShareState for reference IPC handle
-	 * of the main/extra buffer on the device. This IPC handle is only
-	 * valid under the read lock.
+	 * of the main/extra buffer on the device. The mapped buffers are kept
+	 * until unmapping, because @gc_version pins them.
 	 */
 	cl_uint				nblocks_uncached;	/* for KDS_FORMAT_BLOCK */
 	GPUDirectFileDesc	filedesc;
 	strom_io_vector	   *iovec;				/* for KDS_FORMAT_ARROW */
+	void			   *mmap_holder;		/* for KDS_FORMAT_ARROW */
 	/* for KDS_FORMAT_COLUMN */
 	void			   *gc_sstate;
+	cl_int				gc_version;		/* version of the mapped buffers */
 	CUdeviceptr			m_kds_main;
 	CUdeviceptr			m_kds_extra;
 	/* data chunk in kernel portion */
 	kern_data_store kds	__attribute__ ((aligned (STROMALIGN_LEN)));
 } pgstrom_data_store;
 
+/*
+ * pgstromChunkRing
+ *
+ * A ring of the chunk buffers for heap-scan. Buffers are recycled once
+ * PDS_release() dropped the reference counter, instead of the release
+ * and re-allocation per chunk. It is protected by the spinlock, because
+ * buffers may be released by the worker threads.
+ */
+typedef struct pgstromChunkRing
+{
+	slock_t				lock;
+	cl_int				nrooms;		/* max number of the buffers */
+	cl_int				nbuffers;	/* number of the buffers allocated */
+	cl_int				nfree;		/* number of the free buffers */
+	cl_int				max_usage;	/* peak number of the buffers in use */
+	cl_ulong			nr_recycled;/* # of chunks on the recycled buffer */
+	cl_ulong			nr_overflow;/* # of chunks allocated out of ring */
+	pgstrom_data_store **free_list;	/* stack of the free buffers */
+	pgstrom_data_store *buffers[FLEXIBLE_ARRAY_MEMBER];
+} pgstromChunkRing;
+
 /* --------------------------------------------------------------------
  *
  * PG-Strom GUC variables
@@ -624,6 +817,21 @@ extern cl_uint			devBaselineMaxThreadsPerBlock;
 #define cpu_only_mode()		(numDevAttrs == 0)
 extern void pgstrom_init_gpu_device(void);
 
+#define NUMA_MAX_NODES			64
+#define NUMA_NODEMASK_WORDS		(NUMA_MAX_NODES / (BITS_PER_BYTE * SIZEOF_LONG))
+typedef struct
+{
+	bool		is_valid;
+	int			mode;
+	unsigned long nodemask[NUMA_NODEMASK_WORDS];
+} NumaMemPolicy;
+
+extern int	gpuNumaNearestDevice(const int *candidates,
+								 int ncandidates, int seed);
+extern void gpuNumaPreferLocalMemory(int cuda_dindex, NumaMemPolicy *saved);
+extern void gpuNumaRestoreMemPolicy(NumaMemPolicy *saved);
+extern void gpuNumaBindWorkerThread(int cuda_dindex);
+
 #define GPUKERNEL_MAX_SM_MULTIPLICITY		4
 
 extern CUresult gpuOccupancyMaxPotentialBlockSize(int *p_min_grid_sz,
@@ -643,12 +851,22 @@ extern CUresult __gpuOptimalBlockSize(int *p_grid_sz,
 									  int cuda_dindex,
 									  size_t dyn_shmem_per_block,
 									  size_t dyn_shmem_per_thread);
+extern CUresult gpuAutotuneBlockSize(int *p_grid_sz,
+									 int *p_block_sz,
+									 int *p_trial,
+									 CUfunction kern_function,
+									 ProgramId program_id,
+									 const char *kern_fname,
+									 int cuda_dindex,
+									 size_t dyn_shmem_per_block,
+									 size_t dyn_shmem_per_thread);
 /*
  * shmbuf.c
  */
 extern void	   *shmbufAlloc(size_t sz);
 extern void	   *shmbufAllocZero(size_t sz);
 extern void		shmbufFree(void *addr);
+extern void		shmbufAttachAllSegments(void);
 extern void		pgstrom_init_shmbuf(void);
 extern MemoryContext TopSharedMemoryContext;
 
@@ -730,10 +948,23 @@ extern CUresult gpuIpcCloseMemHandle(GpuContext *gcontext,
 #define gpuIpcOpenMemHandle(a,b,c,d)		\
 	__gpuIpcOpenMemHandle((a),(b),(c),(d),__FILE__,__LINE__)
 
+extern CUresult gpuMemAdviseManaged(GpuContext *gcontext,
+									CUdeviceptr m_addr, size_t length,
+									size_t prefetch_sz, bool read_mostly,
+									CUstream cuda_stream);
 extern void gpuMemReclaimSegment(GpuContext *gcontext);
+extern cl_int gpuMemReserveBudget(GpuContext *gcontext,
+								  size_t unit_sz, cl_int nunits_max);
+extern void gpuMemReleaseBudget(GpuContext *gcontext, size_t budget);
+extern bool gpuMemShrinkRequested(cl_int cuda_dindex);
+extern void gpuStatUpdateTasks(GpuContext *gcontext,
+							   int nqueued, int nrunning);
+extern void gpuStatAccumTasks(cl_int cuda_dindex,
+							  uint64 ntasks, uint64 nfallbacks);
 
 extern void gpuMemCopyFromSSD(CUdeviceptr m_kds, pgstrom_data_store *pds);
 
+extern bool		pgstrom_gpu_memory_oversubscription;	/* GUC */
 extern void pgstrom_gpu_mmgr_init_gpucontext(GpuContext *gcontext);
 extern void pgstrom_gpu_mmgr_cleanup_gpucontext(GpuContext *gcontext);
 extern void pgstrom_init_gpu_mmgr(void);
@@ -753,6 +984,13 @@ extern __thread int				GpuWorkerIndex;
 	(GpuWorkerCurrentContext->cuda_dindex)
 
 extern __thread CUevent			CU_EVENT_PER_THREAD;
+extern __thread CUstream		CU_STREAM_HTOD_PER_THREAD;
+extern __thread CUstream		CU_STREAM_DTOH_PER_THREAD;
+extern __thread CUevent			CU_EVENT_HTOD_PER_THREAD;
+extern void gpuTaskStageMark(int stage, CUstream stream);
+extern void gpuTaskStageUpdate(GpuTask *gtask);
+extern float gpuTaskStageElapsed(int stage);
+extern void gpuTaskStageDma(size_t send_bytes, size_t recv_bytes);
 
 extern void GpuContextWorkerReportError(int elevel,
 										int errcode,
@@ -800,6 +1038,7 @@ extern void SynchronizeGpuContextOnDSMDetach(dsm_segment *seg, Datum arg);
 
 #define GPUMEM_DEVICE_RAW_EXTRA		((void *)(~0L))
 #define GPUMEM_HOST_RAW_EXTRA		((void *)(~1L))
+#define GPUMEM_DEVICE_POOL_EXTRA	((void *)(~2L))
 
 extern bool trackCudaProgram(GpuContext *gcontext, ProgramId program_id,
 							 const char *filename, int lineno);
@@ -918,7 +1157,9 @@ extern void pgstromInitGpuTaskState(GpuTaskState *gts,
 									cl_int optimal_gpu,
 									cl_uint outer_nrows_per_block,
 									cl_int eflags);
+extern void pgstromRegisterGpuTaskFanout(GpuTaskState *gts);
 extern TupleTableSlot *pgstromExecGpuTaskState(GpuTaskState *gts);
+extern GpuTask *pgstromFetchGpuTask(GpuTaskState *gts);
 extern void pgstromRescanGpuTaskState(GpuTaskState *gts);
 extern void pgstromReleaseGpuTaskState(GpuTaskState *gts,
 									   GpuTaskRuntimeStat *gt_rtstat);
@@ -936,8 +1177,34 @@ extern void pgstromReInitializeDSMGpuTaskState(GpuTaskState *gts);
 extern void pgstromShutdownDSMGpuTaskState(GpuTaskState *gts);
 
 extern void pgstromInitGpuTask(GpuTaskState *gts, GpuTask *gtask);
+extern size_t pgstromChunkAdaptiveSize(GpuTaskState *gts);
+extern void pgstrom_gpu_cost_factors(double *p_setup_cost,
+									 double *p_dma_cost,
+									 double *p_operator_cost);
+extern int	pgstrom_gpu_parallel_workers(int parallel_workers,
+										 int cuda_dindex);
 extern void pgstrom_init_gputasks(void);
 
+/*
+ * gpu_trace.c
+ */
+#define GPUTASK_TRACE__NVTX			0x0001	/* NVTX ranges per task */
+#define GPUTASK_TRACE__CUPTI		0x0002	/* activities to trace file */
+extern cl_uint	pgstromGpuTraceFlags(void);
+extern void		gpuTraceTaskBegin(GpuTask *gtask, cl_ulong *p_ts_start);
+extern void		gpuTraceTaskEnd(GpuTask *gtask, cl_ulong ts_start);
+extern bool		gpuTraceRangePush(const char *fmt, ...)
+	pg_attribute_printf(1,2);
+extern void		gpuTraceRangePop(void);
+extern void		pgstrom_init_gpu_trace(void);
+
+/*
+ * gpu_statements.c
+ */
+extern void		gpuStatStatementsAccum(GpuTaskState *gts,
+									   GpuTaskRuntimeStat *gt_rtstat);
+extern void		pgstrom_init_gpu_statements(void);
+
 /*
  * cuda_program.c
  */
@@ -956,13 +1223,35 @@ extern ProgramId __pgstrom_create_cuda_program(GpuContext *gcontext,
 extern CUmodule pgstrom_load_cuda_program(ProgramId program_id);
 extern void pgstrom_put_cuda_program(GpuContext *gcontext,
 									 ProgramId program_id);
+extern void pgstrom_prebuild_cuda_program(int cuda_dindex,
+										  cl_uint extra_flags,
+										  cl_uint varlena_bufsz,
+										  const char *kern_source,
+										  const char *kern_define);
+extern void pgstrom_build_common_session_info(StringInfo str,
+											  cl_uint extra_flags);
 extern void pgstrom_build_session_info(StringInfo str,
 									   GpuTaskState *gts,
 									   cl_uint extra_flags);
+extern bytea *pgstrom_timezone_table(const char *tzname);
 
 extern char *pgstrom_cuda_source_string(ProgramId program_id);
 extern const char *pgstrom_cuda_source_file(ProgramId program_id);
 extern const char *pgstrom_cuda_binary_file(ProgramId program_id);
+extern void pgstrom_program_build_count(int *p_pending, int *p_running);
+extern int pgstrom_autotune_block_size(ProgramId program_id,
+									   const char *kern_fname,
+									   int cuda_dindex,
+									   int max_block_sz,
+									   int *p_trial);
+extern void pgstrom_autotune_report(ProgramId program_id,
+									const char *kern_fname,
+									int cuda_dindex,
+									int trial,
+									size_t nitems,
+									float elapsed_ms);
+extern uint64 pgstrom_cuda_program_build_usec(ProgramId program_id,
+											  TimestampTz since);
 extern void pgstrom_init_cuda_program(void);
 
 /*
@@ -980,7 +1269,12 @@ typedef struct codegen_context {
 	List	   *pseudo_tlist;	/* pseudo tlist expression, if any */
 	uint32_t	extra_flags;	/* external libraries to be included */
 	uint32_t	extra_bufsz;	/* required size of temporary varlena buffer */
+	bool		vlbuf_decompress; /* buffer is reserved for decompression */
 	int			devcost;	/* relative device cost */
+	List	   *cse_exprs;	/* common sub-expressions in the scope */
+	Bitmapset  *cse_refs;	/* cse_exprs being referenced */
+	Node	   *cse_current;	/* cse_exprs under code generation */
+	int			inline_depth;	/* depth of inlined SQL functions */
 } codegen_context;
 
 extern size_t pgstrom_codegen_extra_devtypes(char *buf, size_t bufsz,
@@ -1005,6 +1299,10 @@ extern bool pgstrom_devtype_can_relabel(Oid src_type_oid,
 extern devindex_info *pgstrom_devindex_lookup(Oid opcode,
 											  Oid opfamily);
 extern char *pgstrom_codegen_expression(Node *expr, codegen_context *context);
+extern void pgstrom_codegen_cse_setup(codegen_context *context,
+									  List *exprs_list);
+extern void pgstrom_codegen_cse_declarations(StringInfo buf,
+											 codegen_context *context);
 extern void pgstrom_union_type_declarations(StringInfo buf,
 											const char *name,
 											List *type_oid_list);
@@ -1024,6 +1322,9 @@ extern bool __pgstrom_device_expression(PlannerInfo *root,
 	__pgstrom_device_expression((a),(b),(c),NULL,(d),	\
 								__FILE__,__LINE__)
 
+extern List *pgstrom_rewrite_shredded_jsonb(PlannerInfo *root,
+											RelOptInfo *baserel,
+											List *quals);
 extern void pgstrom_init_codegen_context(codegen_context *context,
 										 PlannerInfo *root,
 										 RelOptInfo *baserel);
@@ -1050,6 +1351,9 @@ extern kern_data_store *__KDS_clone(GpuContext *gcontext,
 									const char *filename, int lineno);
 extern pgstrom_data_store *__PDS_clone(pgstrom_data_store *pds,
 									   const char *filename, int lineno);
+extern pgstrom_data_store *__PDS_clone_row(pgstrom_data_store *pds,
+										   size_t bytesize,
+										   const char *filename, int lineno);
 extern pgstrom_data_store *PDS_retain(pgstrom_data_store *pds);
 extern void PDS_release(pgstrom_data_store *pds);
 
@@ -1086,10 +1390,19 @@ extern pgstrom_data_store *__PDS_create_block(GpuContext *gcontext,
 	__PDS_create_slot((a),(b),(c),__FILE__,__LINE__)
 #define PDS_create_block(a,b,c)					\
 	__PDS_create_block((a),(b),(c),__FILE__,__LINE__)
+extern pgstrom_data_store *__PDS_create_chunk(GpuTaskState *gts,
+											  TupleDesc tupdesc,
+											  const char *fname, int lineno);
+#define PDS_create_chunk(a,b)					\
+	__PDS_create_chunk((a),(b),__FILE__,__LINE__)
+extern void PDS_init_chunk_ring(GpuTaskState *gts);
+extern void PDS_end_chunk_ring(GpuTaskState *gts);
 #define KDS_clone(a,b)							\
 	__KDS_clone((a),(b),__FILE__,__LINE__)
 #define PDS_clone(a)							\
 	__PDS_clone((a),__FILE__,__LINE__)
+#define PDS_clone_row(a,b)						\
+	__PDS_clone_row((a),(b),__FILE__,__LINE__)
 
 extern void KDS_dump_schema(kern_data_store *kds);
 
@@ -1148,6 +1461,7 @@ extern int	GetOptimalGpuForRelation(PlannerInfo *root,
 extern bool ScanPathWillUseNvmeStrom(PlannerInfo *root,
 									 RelOptInfo *baserel);
 extern bool RelationCanUseNvmeStrom(Relation relation);
+extern BlockNumber RelationGetStripeNBlocks(Relation relation);
 
 extern void pgstromExecInitBrinIndexMap(GpuTaskState *gts,
 										Oid index_oid,
@@ -1161,6 +1475,23 @@ extern void pgstromExplainBrinIndexMap(GpuTaskState *gts,
 									   ExplainState *es,
 									   List *dcontext);
 
+/* number of the heap blocks per zone; never across the VM pages */
+#define PGSTROM_ZONEMAP_NBLOCKS		32
+extern bool		pgstrom_enable_zonemap;		/* GUC */
+extern void pgstromExecInitZoneMap(GpuTaskState *gts, List *zmap_conds);
+extern int	pgstromZoneMapColumns(GpuTaskState *gts,
+								  const AttrNumber **p_attnums);
+extern void pgstromZoneMapUpdate(GpuTaskState *gts,
+								 pgstrom_data_store *pds,
+								 const cl_long *items,
+								 XLogRecPtr build_lsn);
+extern void pgstromExecEndZoneMap(GpuTaskState *gts);
+extern void pgstromExecRewindZoneMap(GpuTaskState *gts);
+
+extern kern_mvcc_snapshot *pgstromSetupMvccSnapshot(GpuTaskState *gts);
+extern bool pgstromMvccTupleIsVisible(GpuTaskState *gts,
+									  PageHeader hpage,
+									  HeapTupleHeader htup);
 extern pgstrom_data_store *pgstromExecScanChunk(GpuTaskState *gts);
 extern void pgstromRewindScanChunk(GpuTaskState *gts);
 
@@ -1199,7 +1530,17 @@ extern bool pgstrom_path_is_gpuscan(const Path *path);
 extern bool pgstrom_plan_is_gpuscan(const Plan *plan);
 extern bool pgstrom_planstate_is_gpuscan(const PlanState *ps);
 extern Path *pgstrom_copy_gpuscan_path(const Path *pathnode);
+extern bool pgstrom_gpuscan_add_bloom_filter(PlannerInfo *root,
+											 Plan *plan,
+											 List *hash_keys);
+extern void pgstromGpuScanSetupBloomFilter(PlanState *ps,
+										   kern_data_store *kds_hash);
 extern void assign_gpuscan_session_info(StringInfo buf, GpuTaskState *gts);
+extern void pgstrom_prebuild_gpuscan_program(CustomScan *cscan);
+extern void pgstrom_assign_gpuscan_fanout(Append *aplan);
+extern GpuTask *GpuScanExecResultChunk(GpuTaskState *gts,
+									   pgstrom_data_store **p_pds_dst);
+extern void pgstrom_release_gpuscan_cuda_graphs(GpuContext *gcontext);
 extern void pgstrom_init_gpuscan(void);
 
 /*
@@ -1211,6 +1552,7 @@ struct kern_gpujoin;
 extern bool pgstrom_path_is_gpujoin(const Path *pathnode);
 extern bool pgstrom_plan_is_gpujoin(const Plan *plannode);
 extern bool pgstrom_planstate_is_gpujoin(const PlanState *ps);
+extern cl_int pgstrom_planstate_gpujoin_inner_nparts(const PlanState *ps);
 extern Path *pgstrom_copy_gpujoin_path(const Path *pathnode);
 extern cl_int gpujoin_get_optimal_gpu(const Path *pathnode);
 
@@ -1227,6 +1569,7 @@ extern int	gpujoin_process_task(GpuTask *gtask, CUmodule cuda_module);
 extern void	gpujoin_release_task(GpuTask *gtask);
 extern void assign_gpujoin_session_info(StringInfo buf,
 										GpuTaskState *gts);
+extern void pgstrom_prebuild_gpujoin_program(CustomScan *cscan);
 extern void	pgstrom_init_gpujoin(void);
 
 extern Size GpuJoinSetupTask(struct kern_gpujoin *kgjoin,
@@ -1240,7 +1583,10 @@ extern ProgramId GpuJoinCreateCombinedProgram(PlanState *node,
 											  bool explain_only);
 extern bool GpuJoinInnerPreload(GpuTaskState *gts, CUdeviceptr *p_m_kmrels);
 extern void GpuJoinInnerUnload(GpuTaskState *gts, bool is_rescan);
+extern void GpuJoinInnerSyncDeviceBuffer(GpuTaskState *gts);
 extern pgstrom_data_store *GpuJoinExecOuterScanChunk(GpuTaskState *gts);
+extern GpuTask *GpuJoinExecResultChunk(GpuTaskState *gts,
+									   pgstrom_data_store **p_pds_dst);
 extern int  gpujoinNextRightOuterJoinIfAny(GpuTaskState *gts);
 extern TupleTableSlot *gpujoinNextTupleFallbackUpper(GpuTaskState *gts,
 													 struct kern_gpujoin *kgjoin,
@@ -1248,6 +1594,7 @@ extern TupleTableSlot *gpujoinNextTupleFallbackUpper(GpuTaskState *gts,
 													 cl_int outer_depth);
 extern void gpujoinUpdateRunTimeStat(GpuTaskState *gts,
 									 struct kern_gpujoin *kgjoin);
+extern double GpuJoinEstimateResultRatio(GpuTaskState *gts);
 
 /*
  * gpupreagg.c
@@ -1260,8 +1607,16 @@ extern Path *pgstrom_copy_gpupreagg_path(const Path *pathnode);
 extern void gpupreagg_post_planner(PlannedStmt *pstmt, CustomScan *cscan);
 extern void assign_gpupreagg_session_info(StringInfo buf,
 										  GpuTaskState *gts);
+extern void pgstrom_prebuild_gpupreagg_program(CustomScan *cscan);
 extern void pgstrom_init_gpupreagg(void);
 
+/*
+ * gpusort.c
+ */
+extern bool pgstrom_plan_is_gpusort(const Plan *plan);
+extern bool pgstrom_planstate_is_gpusort(const PlanState *ps);
+extern void pgstrom_init_gpusort(void);
+
 /*
  * arrow_fdw.c and arrow_read.c
  */
@@ -1272,17 +1627,47 @@ extern cl_int GetOptimalGpuForArrowFdw(PlannerInfo *root,
 extern bool KDS_fetch_tuple_arrow(TupleTableSlot *slot,
 								  kern_data_store *kds,
 								  size_t row_index);
+extern void setupArrowSQLbufferSchema(struct SQLtable *table,
+									  TupleDesc tupdesc,
+									  ArrowFileInfo *af_info);
 
 extern ArrowFdwState *ExecInitArrowFdw(ScanState *ss,
 									   GpuContext *gcontext,
 									   List *outer_quals,
 									   Bitmapset *outer_refs);
 extern pgstrom_data_store *ExecScanChunkArrowFdw(GpuTaskState *gts);
+typedef struct
+{
+	dev_t		st_dev;		/* identifier of the file */
+	ino_t		st_ino;
+	int			rb_index;	/* index of the RecordBatch in the file */
+	off_t		rb_offset;
+	size_t		rb_length;
+	int64		rb_nitems;
+} ArrowFdwBatchId;
+extern ArrowFdwBatchId *ExecArrowFdwBatchIds(ArrowFdwState *af_state,
+											 uint32 *p_nbatches);
+extern bool ExecArrowFdwExcludeBatches(ArrowFdwState *af_state,
+									   const ArrowFdwBatchId *batches,
+									   uint32 nbatches);
+#define ARROW_STATS_AGG__NROWS		1	/* number of rows (non-null values) */
+#define ARROW_STATS_AGG__MIN		2	/* min value of the column */
+#define ARROW_STATS_AGG__MAX		3	/* max value of the column */
+extern bool ExecInitArrowStatsAgg(ArrowFdwState *af_state,
+								  ScanState *ss,
+								  List *outer_quals,
+								  List *agg_kinds,
+								  List *agg_attnums);
+extern bool ExecFetchArrowStatsAgg(ArrowFdwState *af_state,
+								   Datum *values, bool *isnull);
 extern void ExecReScanArrowFdw(ArrowFdwState *af_state);
 extern void ExecEndArrowFdw(ArrowFdwState *af_state);
 
+extern Size ExecEstimateDSMArrowFdw(ArrowFdwState *af_state,
+									ParallelContext *pcxt);
 extern void ExecInitDSMArrowFdw(ArrowFdwState *af_state,
-								GpuTaskSharedState *gtss);
+								GpuTaskSharedState *gtss,
+								ParallelContext *pcxt);
 extern void ExecReInitDSMArrowFdw(ArrowFdwState *af_state);
 extern void ExecInitWorkerArrowFdw(ArrowFdwState *af_state,
 								   GpuTaskSharedState *gtss);
@@ -1292,6 +1677,60 @@ extern void ExplainArrowFdw(ArrowFdwState *af_state,
 							ExplainState *es,
 							List *dcontext);
 extern void pgstrom_init_arrow_fdw(void);
+extern void arrowFdwReleaseMmapPDS(pgstrom_data_store *pds);
+extern void arrowFdwDecompressBuffer(int codec,
+									 char *dst, size_t dst_size,
+									 const char *src, size_t src_size);
+
+/*
+ * parquet_read.c
+ */
+/* compression codecs used by the parquet files only */
+#define __ArrowCompressionType__SNAPPY		100
+#define __ArrowCompressionType__LZ4_RAW		101
+
+typedef struct
+{
+	int			physical_type;	/* parquet physical type */
+	int			type_length;	/* length of FIXED_LEN_BYTE_ARRAY */
+	int			max_def_level;	/* 0 if REQUIRED, 1 if OPTIONAL */
+	int			conv;			/* PQ_CONV__* */
+	int			codec;			/* ArrowCompressionType, or -1 */
+	off_t		chunk_offset;	/* head of the column chunk */
+	size_t		chunk_length;	/* length of the column chunk */
+} ParquetChunkInfo;
+
+typedef struct
+{
+	ParquetChunkInfo info;
+	bool		stat_isnull;
+	char		stat_min[16];	/* layout of SQLstat__datum */
+	char		stat_max[16];
+} ParquetColumnChunk;
+
+typedef struct
+{
+	int64		num_rows;
+	size_t		total_length;
+	ParquetColumnChunk *columns;
+} ParquetRowGroup;
+
+typedef struct
+{
+	struct stat	stat_buf;
+	ArrowSchema	schema;			/* equivalent arrow schema */
+	int			num_row_groups;
+	ParquetRowGroup *row_groups;
+} ParquetFileInfo;
+
+extern bool parquetFileDescIsValid(int fdesc);
+extern void readParquetFileDesc(int fdesc, ParquetFileInfo *pq_info);
+extern void parquetReadColumnChunk(int fdesc,
+								   const ParquetChunkInfo *pq_chunk,
+								   int64 nitems,
+								   char **p_nullmap, size_t *p_nullmap_len,
+								   char **p_values, size_t *p_values_len,
+								   char **p_extra, size_t *p_extra_len);
 
 /*
  * gpu_cache.c
@@ -1299,9 +1738,16 @@ extern void pgstrom_init_arrow_fdw(void);
 extern bool baseRelHasGpuCache(PlannerInfo *root,
 							   RelOptInfo *baserel);
 extern bool RelationHasGpuCache(Relation rel);
+extern AttrNumber baseRelGpuCacheIndexAttnum(PlannerInfo *root,
+											 RelOptInfo *baserel);
+extern AttrNumber gpuCacheIndexAttnum(pgstrom_data_store *pds);
 extern GpuCacheState *ExecInitGpuCache(ScanState *ss, int eflags,
+									   List *outer_quals,
 									   Bitmapset *outer_refs);
 extern pgstrom_data_store *ExecScanChunkGpuCache(GpuTaskState *gts);
+extern bool gpuCacheContentsVersion(GpuCacheState *gcache_state,
+									uint64 *p_generation,
+									uint64 *p_write_pos);
 extern void ExecReScanGpuCache(GpuCacheState *gcache_state);
 extern void ExecEndGpuCache(GpuCacheState *gcache_state);
 
@@ -1423,6 +1869,17 @@ extern ssize_t extraSysfsPrintNvmeInfo(int index, char *buffer, ssize_t buffer_s
 #define INT1OID			606
 #endif
 
+/*
+ * collation.c
+ */
+extern bytea   *pgstrom_collation_table(Oid collid);
+
+/*
+ * regexp_dfa.c
+ */
+extern bytea   *pgstrom_regexp_compile_dfa(text *pattern, bool icase,
+										   Oid collid);
+
 /*
  * main.c
  */
@@ -1851,6 +2308,16 @@ pthreadRWLockWriteLock(pthread_rwlock_t *rwlock)
 		wfatal("failed on pthread_rwlock_wrlock: %m");
 }
 
+static inline bool
+pthreadRWLockReadTryLock(pthread_rwlock_t *rwlock)
+{
+	if ((errno = pthread_rwlock_tryrdlock(rwlock)) == 0)
+		return true;
+	if (errno != EBUSY)
+		wfatal("failed on pthread_rwlock_tryrdlock: %m");
+	return false;
+}
+
 static inline bool
 pthreadRWLockWriteTryLock(pthread_rwlock_t *rwlock)
 {
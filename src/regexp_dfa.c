@@ -0,0 +1,975 @@
+/*
+ * regexp_dfa.c
+ *
+ * Compiler of regular expression patterns into DFA for device side matching
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include "pg_strom.h"
+#include "mb/pg_wchar.h"
+#include "cuda_textlib.h"
+
+/*
+ * A sub-set of the POSIX ARE (advanced regular expression) is compiled into
+ * a DFA on the byte stream; literals, '.', bracket expressions, class
+ * escapes, groups, alternatives and quantifiers. Patterns that need the
+ * full regex engine (back-references, lookahead, word boundaries, embedded
+ * options, anchors in the middle, ...) are reported as not supported, then
+ * the expression runs on CPU as usual.
+ */
+#define REGEXP_NFA_MAX_STATES	8192
+#define REGEXP_DFA_MAX_STATES	2048
+#define REGEXP_DFA_MAX_NBYTES	(128U << 10)
+#define REGEXP_MAX_REPEAT		255		/* DUPMAX of the PostgreSQL regex */
+
+#define __RegexpError(fmt, ...)							\
+	ereport(ERROR,										\
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),	\
+			 errmsg("regexp: " fmt, ##__VA_ARGS__)))
+
+typedef enum
+{
+	RENODE_SET,			/* one byte out of the set */
+	RENODE_SEQ,			/* concatenation of the children */
+	RENODE_ALT,			/* alternatives of the children */
+	RENODE_REPEAT,		/* repeat of the child */
+} regexp_node_type;
+
+typedef struct
+{
+	regexp_node_type type;
+	bits8		set[32];		/* RENODE_SET */
+	int			min;			/* RENODE_REPEAT */
+	int			max;			/* RENODE_REPEAT (-1 = infinite) */
+	List	   *children;
+} regexp_node;
+
+typedef struct
+{
+	const char *head;
+	const char *pos;
+	const char *end;
+	bool		icase;			/* case insensitive (ASCII only) */
+	bool		is_c_ctype;		/* character classes are C/POSIX */
+	bool		is_utf8;		/* UTF-8, elsewhere single-byte encoding */
+	int			depth;			/* nest level of the groups */
+} regexp_parser;
+
+typedef struct
+{
+	bits8		set[32];		/* bytes to move to @next */
+	int			next;			/* -1, if no byte transition */
+	int			eps[2];			/* epsilon transitions, or -1 */
+} regexp_nfa_state;
+
+typedef struct
+{
+	regexp_nfa_state *states;
+	int			nstates;
+	int			nrooms;
+} regexp_nfa;
+
+/* single entry cache of the last compiled pattern */
+static text	   *regexp_cache_pattern = NULL;
+static int		regexp_cache_flags = 0;
+static bytea   *regexp_cache_dfa = NULL;
+
+#define SET_HAS(set,c)		(((set)[(c) >> 3] & (1 << ((c) & 7))) != 0)
+#define SET_ADD(set,c)		((set)[(c) >> 3] |= (1 << ((c) & 7)))
+
+/* ----------------------------------------------------------------
+ *
+ * Parser of the regular expression
+ *
+ * ---------------------------------------------------------------- */
+static regexp_node *parse_regexp_alter(regexp_parser *p);
+
+static regexp_node *
+make_regexp_node(regexp_node_type type)
+{
+	regexp_node *node = palloc0(sizeof(regexp_node));
+
+	node->type = type;
+	return node;
+}
+
+static void
+regexp_set_add_byte(regexp_parser *p, bits8 *set, int c)
+{
+	SET_ADD(set, c);
+	if (p->icase)
+	{
+		if (c >= 'a' && c <= 'z')
+			SET_ADD(set, c - 'a' + 'A');
+		else if (c >= 'A' && c <= 'Z')
+			SET_ADD(set, c - 'A' + 'a');
+	}
+}
+
+/*
+ * regexp_set_add_class - add a character class by the name
+ */
+static void
+regexp_set_add_class(regexp_parser *p, bits8 *set, const char *name, int len)
+{
+	int		(*check)(int) = NULL;
+	int		c;
+
+#define __CHECK_CLASS(NAME)							\
+	if (len == strlen(#NAME) &&						\
+		strncmp(name, #NAME, len) == 0)				\
+		check = is##NAME
+	__CHECK_CLASS(alnum);
+	else __CHECK_CLASS(alpha);
+	else __CHECK_CLASS(blank);
+	else __CHECK_CLASS(cntrl);
+	else __CHECK_CLASS(digit);
+	else __CHECK_CLASS(graph);
+	else __CHECK_CLASS(lower);
+	else __CHECK_CLASS(print);
+	else __CHECK_CLASS(punct);
+	else __CHECK_CLASS(space);
+	else __CHECK_CLASS(upper);
+	else __CHECK_CLASS(xdigit);
+	else
+		__RegexpError("unknown character class [:%.*s:]", len, name);
+#undef __CHECK_CLASS
+	/*
+	 * Digits are ASCII only regardless of the locale, but other classes
+	 * contain non-ASCII characters unless C/POSIX ctype.
+	 */
+	if (!p->is_c_ctype && check != isdigit && check != isxdigit)
+		__RegexpError("character class [:%.*s:] is locale dependent",
+					  len, name);
+	for (c=1; c < 128; c++)
+	{
+		if (check(c))
+			regexp_set_add_byte(p, set, c);
+	}
+}
+
+/*
+ * make_regexp_anychar - any character except for the ASCII bytes in @excl
+ */
+static regexp_node *
+make_regexp_anychar(regexp_parser *p, const bits8 *excl)
+{
+	regexp_node *node;
+	regexp_node *ascii = make_regexp_node(RENODE_SET);
+	int			c, i, j;
+
+	for (c=1; c < (p->is_utf8 ? 128 : 256); c++)
+	{
+		if (!excl || !SET_HAS(excl, c))
+			SET_ADD(ascii->set, c);
+	}
+	if (!p->is_utf8)
+		return ascii;
+
+	/* multi-bytes characters in UTF-8 */
+	node = make_regexp_node(RENODE_ALT);
+	node->children = list_make1(ascii);
+	for (i=1; i <= 3; i++)
+	{
+		regexp_node *seq = make_regexp_node(RENODE_SEQ);
+		regexp_node *lead = make_regexp_node(RENODE_SET);
+		int		lead_lo = (i == 1 ? 0xc2 : i == 2 ? 0xe0 : 0xf0);
+		int		lead_hi = (i == 1 ? 0xdf : i == 2 ? 0xef : 0xf4);
+
+		for (c=lead_lo; c <= lead_hi; c++)
+			SET_ADD(lead->set, c);
+		seq->children = list_make1(lead);
+		for (j=0; j < i; j++)
+		{
+			regexp_node *cont = make_regexp_node(RENODE_SET);
+
+			for (c=0x80; c <= 0xbf; c++)
+				SET_ADD(cont->set, c);
+			seq->children = lappend(seq->children, cont);
+		}
+		node->children = lappend(node->children, seq);
+	}
+	return node;
+}
+
+/*
+ * parse_regexp_escape_class - \d \s \w and their negations
+ */
+static bool
+parse_regexp_escape_class(regexp_parser *p, int c, bits8 *set, bool *negative)
+{
+	int		lc = tolower(c);
+
+	if (lc != 'd' && lc != 's' && lc != 'w')
+		return false;
+	if (lc == 'd')
+		regexp_set_add_class(p, set, "digit", 5);
+	else if (lc == 's')
+		regexp_set_add_class(p, set, "space", 5);
+	else
+	{
+		regexp_set_add_class(p, set, "alnum", 5);
+		regexp_set_add_byte(p, set, '_');
+	}
+	*negative = (c != lc);
+	return true;
+}
+
+/*
+ * parse_regexp_escape_char - character-entry escapes
+ */
+static int
+parse_regexp_escape_char(regexp_parser *p, int c)
+{
+	switch (c)
+	{
+		case 'a':	return '\a';
+		case 'e':	return '\033';
+		case 'f':	return '\f';
+		case 'n':	return '\n';
+		case 'r':	return '\r';
+		case 't':	return '\t';
+		case 'v':	return '\v';
+		default:
+			break;
+	}
+	if (isdigit(c))
+		__RegexpError("back-reference is not supported");
+	if (isalpha(c))
+		__RegexpError("escape \\%c is not supported", c);
+	if (IS_HIGHBIT_SET(c))
+		__RegexpError("escape of non-ASCII character is not supported");
+	return c;
+}
+
+/*
+ * parse_regexp_bracket - [...] expression
+ */
+static regexp_node *
+parse_regexp_bracket(regexp_parser *p)
+{
+	bits8		set[32];
+	bool		negative = false;
+	bool		first = true;
+
+	memset(set, 0, sizeof(set));
+	Assert(*p->pos == '[');
+	p->pos++;
+	if (p->pos < p->end && *p->pos == '^')
+	{
+		negative = true;
+		p->pos++;
+	}
+	for (;;)
+	{
+		int		c, c2;
+
+		if (p->pos >= p->end)
+			__RegexpError("unterminated bracket expression");
+		c = (unsigned char) *p->pos;
+		if (c == ']' && !first)
+		{
+			p->pos++;
+			break;
+		}
+		first = false;
+
+		if (c == '[' && p->pos + 1 < p->end &&
+			(p->pos[1] == '.' || p->pos[1] == '='))
+			__RegexpError("collating element is not supported");
+		if (c == '[' && p->pos + 1 < p->end && p->pos[1] == ':')
+		{
+			const char *name = p->pos + 2;
+			const char *tail;
+
+			for (tail = name; tail + 1 < p->end; tail++)
+			{
+				if (tail[0] == ':' && tail[1] == ']')
+					break;
+			}
+			if (tail + 1 >= p->end)
+				__RegexpError("unterminated character class");
+			regexp_set_add_class(p, set, name, tail - name);
+			p->pos = tail + 2;
+			continue;
+		}
+		if (c == '\\')
+		{
+			bool	class_negative;
+
+			if (++p->pos >= p->end)
+				__RegexpError("invalid escape at end of pattern");
+			c = (unsigned char) *p->pos;
+			if (parse_regexp_escape_class(p, c, set, &class_negative))
+			{
+				if (class_negative)
+					__RegexpError("negated class escape in bracket");
+				p->pos++;
+				continue;
+			}
+			c = parse_regexp_escape_char(p, c);
+		}
+		if (IS_HIGHBIT_SET(c) && (p->is_utf8 || p->icase))
+			__RegexpError("non-ASCII character in bracket expression");
+		p->pos++;
+
+		/* range expression */
+		if (p->pos + 1 < p->end && p->pos[0] == '-' && p->pos[1] != ']')
+		{
+			c2 = (unsigned char) p->pos[1];
+			if (c2 == '[' || c2 == '\\')
+				__RegexpError("complicated range expression");
+			if (IS_HIGHBIT_SET(c2) && (p->is_utf8 || p->icase))
+				__RegexpError("non-ASCII character in bracket expression");
+			if (c2 < c)
+				__RegexpError("invalid range expression");
+			p->pos += 2;
+			for (; c <= c2; c++)
+				regexp_set_add_byte(p, set, c);
+		}
+		else
+		{
+			regexp_set_add_byte(p, set, c);
+		}
+	}
+
+	if (negative)
+		return make_regexp_anychar(p, set);
+	else
+	{
+		regexp_node *node = make_regexp_node(RENODE_SET);
+
+		memcpy(node->set, set, sizeof(set));
+		return node;
+	}
+}
+
+/*
+ * parse_regexp_atom
+ */
+static regexp_node *
+parse_regexp_atom(regexp_parser *p)
+{
+	regexp_node *node;
+	int			c = (unsigned char) *p->pos;
+
+	switch (c)
+	{
+		case '(':
+			p->pos++;
+			if (p->pos < p->end && *p->pos == '?')
+			{
+				if (p->pos + 1 < p->end && p->pos[1] == ':')
+					p->pos += 2;
+				else
+					__RegexpError("lookahead constraint or embedded option is not supported");
+			}
+			p->depth++;
+			node = parse_regexp_alter(p);
+			p->depth--;
+			if (p->pos >= p->end || *p->pos != ')')
+				__RegexpError("parentheses () not balanced");
+			p->pos++;
+			return node;
+
+		case '.':
+			p->pos++;
+			return make_regexp_anychar(p, NULL);
+
+		case '[':
+			return parse_regexp_bracket(p);
+
+		case '^':
+		case '$':
+			__RegexpError("anchor in the middle of pattern is not supported");
+
+		case '*':
+		case '+':
+		case '?':
+			__RegexpError("quantifier operand invalid");
+
+		case '\\':
+			{
+				bits8	set[32];
+				bool	negative;
+
+				if (++p->pos >= p->end)
+					__RegexpError("invalid escape at end of pattern");
+				c = (unsigned char) *p->pos++;
+				memset(set, 0, sizeof(set));
+				if (parse_regexp_escape_class(p, c, set, &negative))
+				{
+					if (negative)
+						return make_regexp_anychar(p, set);
+					node = make_regexp_node(RENODE_SET);
+					memcpy(node->set, set, sizeof(set));
+					return node;
+				}
+				node = make_regexp_node(RENODE_SET);
+				regexp_set_add_byte(p, node->set,
+									parse_regexp_escape_char(p, c));
+				return node;
+			}
+
+		default:
+			if (IS_HIGHBIT_SET(c) && p->is_utf8)
+			{
+				int		i, len = pg_utf_mblen((const unsigned char *)p->pos);
+
+				if (p->icase)
+					__RegexpError("case insensitive match of non-ASCII character");
+				if (p->pos + len > p->end)
+					__RegexpError("invalid multibyte character");
+				node = make_regexp_node(RENODE_SEQ);
+				for (i=0; i < len; i++)
+				{
+					regexp_node *byte = make_regexp_node(RENODE_SET);
+
+					SET_ADD(byte->set, (unsigned char) p->pos[i]);
+					node->children = lappend(node->children, byte);
+				}
+				p->pos += len;
+				return node;
+			}
+			if (IS_HIGHBIT_SET(c) && p->icase)
+				__RegexpError("case insensitive match of non-ASCII character");
+			node = make_regexp_node(RENODE_SET);
+			regexp_set_add_byte(p, node->set, c);
+			p->pos++;
+			return node;
+	}
+}
+
+/*
+ * parse_regexp_bound - {m}, {m,}, {m,n}
+ */
+static int
+parse_regexp_bound_number(regexp_parser *p)
+{
+	int		val = 0;
+
+	if (p->pos >= p->end || !isdigit((unsigned char) *p->pos))
+		__RegexpError("invalid repetition count(s)");
+	while (p->pos < p->end && isdigit((unsigned char) *p->pos))
+	{
+		val = val * 10 + (*p->pos++ - '0');
+		if (val > REGEXP_MAX_REPEAT)
+			__RegexpError("invalid repetition count(s)");
+	}
+	return val;
+}
+
+static regexp_node *
+parse_regexp_piece(regexp_parser *p)
+{
+	regexp_node *atom = parse_regexp_atom(p);
+
+	while (p->pos < p->end)
+	{
+		regexp_node *node;
+		int		c = *p->pos;
+		int		min, max;
+
+		if (c == '*')
+		{
+			min = 0;
+			max = -1;
+			p->pos++;
+		}
+		else if (c == '+')
+		{
+			min = 1;
+			max = -1;
+			p->pos++;
+		}
+		else if (c == '?')
+		{
+			min = 0;
+			max = 1;
+			p->pos++;
+		}
+		else if (c == '{' && p->pos + 1 < p->end &&
+				 isdigit((unsigned char) p->pos[1]))
+		{
+			p->pos++;
+			min = max = parse_regexp_bound_number(p);
+			if (p->pos < p->end && *p->pos == ',')
+			{
+				p->pos++;
+				if (p->pos < p->end && *p->pos == '}')
+					max = -1;
+				else
+					max = parse_regexp_bound_number(p);
+			}
+			if (p->pos >= p->end || *p->pos != '}')
+				__RegexpError("invalid repetition count(s)");
+			if (max >= 0 && max < min)
+				__RegexpError("invalid repetition count(s)");
+			p->pos++;
+		}
+		else
+			break;
+		/* non-greedy quantifier has no effect on the boolean match */
+		if (p->pos < p->end && *p->pos == '?')
+			p->pos++;
+
+		node = make_regexp_node(RENODE_REPEAT);
+		node->min = min;
+		node->max = max;
+		node->children = list_make1(atom);
+		atom = node;
+	}
+	return atom;
+}
+
+static regexp_node *
+parse_regexp_branch(regexp_parser *p)
+{
+	regexp_node *node = make_regexp_node(RENODE_SEQ);
+
+	while (p->pos < p->end && *p->pos != '|' && *p->pos != ')')
+		node->children = lappend(node->children, parse_regexp_piece(p));
+	return node;
+}
+
+static regexp_node *
+parse_regexp_alter(regexp_parser *p)
+{
+	regexp_node *node = parse_regexp_branch(p);
+
+	if (p->pos < p->end && *p->pos == '|')
+	{
+		regexp_node *alt = make_regexp_node(RENODE_ALT);
+
+		alt->children = list_make1(node);
+		while (p->pos < p->end && *p->pos == '|')
+		{
+			p->pos++;
+			alt->children = lappend(alt->children, parse_regexp_branch(p));
+		}
+		node = alt;
+	}
+	if (p->depth == 0 && p->pos < p->end)
+		__RegexpError("parentheses () not balanced");
+	return node;
+}
+
+/* ----------------------------------------------------------------
+ *
+ * Thompson's construction of NFA
+ *
+ * ---------------------------------------------------------------- */
+static int
+regexp_nfa_new_state(regexp_nfa *nfa)
+{
+	regexp_nfa_state *state;
+
+	if (nfa->nstates >= nfa->nrooms)
+	{
+		if (nfa->nrooms >= REGEXP_NFA_MAX_STATES)
+			__RegexpError("pattern is too complicated");
+		nfa->nrooms = Min(2 * nfa->nrooms, REGEXP_NFA_MAX_STATES);
+		nfa->states = repalloc(nfa->states,
+							   sizeof(regexp_nfa_state) * nfa->nrooms);
+	}
+	state = &nfa->states[nfa->nstates];
+	memset(state->set, 0, sizeof(state->set));
+	state->next = -1;
+	state->eps[0] = -1;
+	state->eps[1] = -1;
+
+	return nfa->nstates++;
+}
+
+/*
+ * regexp_nfa_build - it returns the start state; *p_end is the last state
+ * that has no outgoing transition yet.
+ */
+static int
+regexp_nfa_build(regexp_nfa *nfa, regexp_node *node, int *p_end)
+{
+	ListCell   *lc;
+	int			head, tail;
+	int			s, e, i;
+	int			__head, __tail;
+
+	switch (node->type)
+	{
+		case RENODE_SET:
+			head = regexp_nfa_new_state(nfa);
+			tail = regexp_nfa_new_state(nfa);
+			memcpy(nfa->states[head].set, node->set, sizeof(node->set));
+			nfa->states[head].next = tail;
+			break;
+
+		case RENODE_SEQ:
+			head = tail = regexp_nfa_new_state(nfa);
+			foreach (lc, node->children)
+			{
+				s = regexp_nfa_build(nfa, lfirst(lc), &e);
+				nfa->states[tail].eps[0] = s;
+				tail = e;
+			}
+			break;
+
+		case RENODE_ALT:
+			tail = regexp_nfa_new_state(nfa);
+			head = -1;
+			foreach (lc, node->children)
+			{
+				s = regexp_nfa_build(nfa, lfirst(lc), &e);
+				nfa->states[e].eps[0] = tail;
+				if (head < 0)
+					head = s;
+				else
+				{
+					int		fork = regexp_nfa_new_state(nfa);
+
+					nfa->states[fork].eps[0] = head;
+					nfa->states[fork].eps[1] = s;
+					head = fork;
+				}
+			}
+			break;
+
+		case RENODE_REPEAT:
+			head = tail = regexp_nfa_new_state(nfa);
+			for (i=0; i < node->min; i++)
+			{
+				s = regexp_nfa_build(nfa, linitial(node->children), &e);
+				nfa->states[tail].eps[0] = s;
+				tail = e;
+			}
+			if (node->max < 0)
+			{
+				/* tail -> (child)* -> new tail */
+				s = regexp_nfa_build(nfa, linitial(node->children), &e);
+				__tail = regexp_nfa_new_state(nfa);
+				nfa->states[tail].eps[0] = s;
+				nfa->states[tail].eps[1] = __tail;
+				nfa->states[e].eps[0] = s;
+				nfa->states[e].eps[1] = __tail;
+				tail = __tail;
+			}
+			else
+			{
+				for (i=node->min; i < node->max; i++)
+				{
+					/* tail -> (child)? -> new tail */
+					s = regexp_nfa_build(nfa, linitial(node->children), &e);
+					__tail = regexp_nfa_new_state(nfa);
+					__head = tail;
+					nfa->states[__head].eps[0] = s;
+					nfa->states[__head].eps[1] = __tail;
+					nfa->states[e].eps[0] = __tail;
+					tail = __tail;
+				}
+			}
+			break;
+
+		default:
+			elog(ERROR, "Bug? unknown regexp node type: %d", (int)node->type);
+	}
+	*p_end = tail;
+	return head;
+}
+
+/* ----------------------------------------------------------------
+ *
+ * Subset construction of DFA
+ *
+ * ---------------------------------------------------------------- */
+static void
+regexp_nfa_closure(regexp_nfa *nfa, uint64 *bitmap, int *stack)
+{
+	int		i, k, depth = 0;
+
+	for (i=0; i < nfa->nstates; i++)
+	{
+		if ((bitmap[i / 64] & (UINT64CONST(1) << (i % 64))) != 0)
+			stack[depth++] = i;
+	}
+	while (depth > 0)
+	{
+		regexp_nfa_state *state = &nfa->states[stack[--depth]];
+
+		for (k=0; k < 2; k++)
+		{
+			int		j = state->eps[k];
+
+			if (j >= 0 && (bitmap[j / 64] & (UINT64CONST(1) << (j % 64))) == 0)
+			{
+				bitmap[j / 64] |= (UINT64CONST(1) << (j % 64));
+				stack[depth++] = j;
+			}
+		}
+	}
+}
+
+static bytea *
+regexp_dfa_build(regexp_nfa *nfa, int nfa_start, int nfa_accept,
+				 bool anchored_start, bool anchored_end)
+{
+	int			nwords = (nfa->nstates + 63) / 64;
+	size_t		keysz = sizeof(uint64) * nwords;
+	uint64	  **dfa_states;
+	int			dfa_nstates = 0;
+	int			dfa_nrooms = 64;
+	uint64	   *start_bitmap;
+	uint64	   *temp;
+	int		   *stack;
+	cl_uchar	classmap[256];
+	int			classrep[256];
+	int			nclasses = 1;
+	cl_ushort  *trans;
+	cl_uchar   *accepts;
+	HTAB	   *htab;
+	HASHCTL		hctl;
+	kern_regexp_dfa *kdfa;
+	size_t		length;
+	int			i, j, k;
+
+	/* equivalent classes of the bytes */
+	memset(classmap, 0, sizeof(classmap));
+	for (i=0; i < nfa->nstates; i++)
+	{
+		regexp_nfa_state *state = &nfa->states[i];
+		int		newmap[512];
+		int		count = 0;
+		int		c;
+
+		if (state->next < 0)
+			continue;
+		for (c=0; c < 512; c++)
+			newmap[c] = -1;
+		for (c=0; c < 256; c++)
+		{
+			int		key = 2 * classmap[c] + (SET_HAS(state->set, c) ? 1 : 0);
+
+			if (newmap[key] < 0)
+				newmap[key] = count++;
+			classmap[c] = newmap[key];
+		}
+		nclasses = count;
+	}
+	for (k=0; k < nclasses; k++)
+		classrep[k] = -1;
+	for (i=0; i < 256; i++)
+	{
+		if (classrep[classmap[i]] < 0)
+			classrep[classmap[i]] = i;
+	}
+
+	/*
+	 * hash table to lookup DFA states by NFA state set; an entry consists of
+	 * the bitmap of NFA states (key) and the DFA state-id.
+	 */
+	memset(&hctl, 0, sizeof(HASHCTL));
+	hctl.keysize = keysz;
+	hctl.entrysize = keysz + sizeof(int);
+	hctl.hcxt = CurrentMemoryContext;
+	htab = hash_create("regexp DFA states", 256, &hctl,
+					   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	dfa_states = palloc(sizeof(uint64 *) * dfa_nrooms);
+	trans = palloc0(sizeof(cl_ushort) * nclasses * REGEXP_DFA_MAX_STATES);
+	accepts = palloc0(sizeof(cl_uchar) * REGEXP_DFA_MAX_STATES);
+	stack = palloc(sizeof(int) * (nfa->nstates + 1));
+	temp = palloc(keysz);
+
+	/* DFA state 0 is the dead state (empty set) */
+	start_bitmap = palloc0(keysz);
+	for (k=0; k < 2; k++)
+	{
+		bool	found;
+		char   *entry;
+
+		if (k == 1)
+		{
+			start_bitmap[nfa_start / 64] |= (UINT64CONST(1) << (nfa_start % 64));
+			regexp_nfa_closure(nfa, start_bitmap, stack);
+		}
+		entry = hash_search(htab, start_bitmap, HASH_ENTER, &found);
+		Assert(!found);
+		*((int *)(entry + keysz)) = dfa_nstates;
+		dfa_states[dfa_nstates++] = (uint64 *) entry;
+	}
+
+	for (i=1; i < dfa_nstates; i++)
+	{
+		uint64	   *curr = dfa_states[i];
+
+		if ((curr[nfa_accept / 64] & (UINT64CONST(1) << (nfa_accept % 64))) != 0)
+		{
+			accepts[i] = 1;
+			/* device side returns true immediately */
+			if (!anchored_end)
+			{
+				for (k=0; k < nclasses; k++)
+					trans[i * nclasses + k] = i;
+				continue;
+			}
+		}
+
+		for (k=0; k < nclasses; k++)
+		{
+			int		c = classrep[k];
+			bool	found;
+			char   *entry;
+
+			memset(temp, 0, keysz);
+			for (j=0; j < nfa->nstates; j++)
+			{
+				regexp_nfa_state *state = &nfa->states[j];
+
+				if ((curr[j / 64] & (UINT64CONST(1) << (j % 64))) != 0 &&
+					state->next >= 0 &&
+					SET_HAS(state->set, c))
+					temp[state->next / 64] |= (UINT64CONST(1) << (state->next % 64));
+			}
+			regexp_nfa_closure(nfa, temp, stack);
+			/* unanchored search restarts the match at every position */
+			if (!anchored_start)
+			{
+				for (j=0; j < nwords; j++)
+					temp[j] |= start_bitmap[j];
+			}
+			entry = hash_search(htab, temp, HASH_ENTER, &found);
+			if (!found)
+			{
+				if (dfa_nstates >= REGEXP_DFA_MAX_STATES ||
+					(size_t)(dfa_nstates + 1) * nclasses *
+					sizeof(cl_ushort) > REGEXP_DFA_MAX_NBYTES)
+					__RegexpError("DFA is too large");
+				if (dfa_nstates >= dfa_nrooms)
+				{
+					dfa_nrooms *= 2;
+					dfa_states = repalloc(dfa_states,
+										  sizeof(uint64 *) * dfa_nrooms);
+				}
+				*((int *)(entry + keysz)) = dfa_nstates;
+				dfa_states[dfa_nstates++] = (uint64 *) entry;
+			}
+			curr = dfa_states[i];	/* entry is never moved by dynahash */
+			trans[i * nclasses + k] = *((int *)(entry + keysz));
+		}
+	}
+
+	/* construct kern_regexp_dfa */
+	length = (offsetof(kern_regexp_dfa, trans) +
+			  sizeof(cl_ushort) * dfa_nstates * nclasses +
+			  sizeof(cl_uchar) * dfa_nstates);
+	kdfa = palloc0(length);
+	SET_VARSIZE(kdfa, length);
+	kdfa->magic = KERN_REGEXP_DFA_MAGIC;
+	kdfa->nstates = dfa_nstates;
+	kdfa->nclasses = nclasses;
+	kdfa->flags = (anchored_end ? KERN_REGEXP_DFA__ANCHORED_END : 0);
+	memcpy(kdfa->classmap, classmap, sizeof(classmap));
+	memcpy(kdfa->trans, trans, sizeof(cl_ushort) * dfa_nstates * nclasses);
+	memcpy((char *)(kdfa->trans + dfa_nstates * nclasses),
+		   accepts, sizeof(cl_uchar) * dfa_nstates);
+
+	hash_destroy(htab);
+	pfree(dfa_states);
+	pfree(trans);
+	pfree(accepts);
+	pfree(stack);
+	pfree(temp);
+	pfree(start_bitmap);
+
+	return (bytea *) kdfa;
+}
+
+/*
+ * pgstrom_regexp_compile_dfa
+ *
+ * It compiles the regular expression pattern into kern_regexp_dfa in bytea
+ * form. It raises an error with ERRCODE_FEATURE_NOT_SUPPORTED, if pattern
+ * is not supported by the device matcher.
+ */
+bytea *
+pgstrom_regexp_compile_dfa(text *pattern, bool icase, Oid collid)
+{
+	regexp_parser p;
+	regexp_nfa	nfa;
+	regexp_node *node;
+	const char *head = VARDATA_ANY(pattern);
+	const char *tail = head + VARSIZE_ANY_EXHDR(pattern);
+	bool		anchored_start = false;
+	bool		anchored_end = false;
+	int			flags;
+	int			nfa_start;
+	int			nfa_accept;
+	bytea	   *result;
+	MemoryContext oldcxt;
+
+	memset(&p, 0, sizeof(regexp_parser));
+	p.icase = icase;
+	p.is_c_ctype = (OidIsValid(collid) && lc_ctype_is_c(collid));
+	if (GetDatabaseEncoding() == PG_UTF8)
+		p.is_utf8 = true;
+	else if (pg_database_encoding_max_length() != 1)
+		__RegexpError("multi-byte encoding except for UTF-8");
+
+	/* lookup the cache first */
+	flags = ((icase ? 0x01 : 0) |
+			 (p.is_c_ctype ? 0x02 : 0) |
+			 (p.is_utf8 ? 0x04 : 0));
+	if (regexp_cache_pattern &&
+		regexp_cache_flags == flags &&
+		VARSIZE_ANY_EXHDR(regexp_cache_pattern) == tail - head &&
+		memcmp(VARDATA_ANY(regexp_cache_pattern), head, tail - head) == 0)
+		return regexp_cache_dfa;
+
+	if (tail - head >= 3 && strncmp(head, "***", 3) == 0)
+		__RegexpError("director prefix is not supported");
+	if (head < tail && *head == '^')
+	{
+		anchored_start = true;
+		head++;
+	}
+	if (head < tail && tail[-1] == '$')
+	{
+		const char *pos;
+		int			nbackslash = 0;
+
+		for (pos = tail - 2; pos >= head && *pos == '\\'; pos--)
+			nbackslash++;
+		if (nbackslash % 2 == 0)
+		{
+			anchored_end = true;
+			tail--;
+		}
+	}
+	p.head = p.pos = head;
+	p.end = tail;
+	node = parse_regexp_alter(&p);
+	if (node->type == RENODE_ALT && (anchored_start || anchored_end))
+		__RegexpError("anchor with top-level alternatives is not supported");
+
+	memset(&nfa, 0, sizeof(regexp_nfa));
+	nfa.nrooms = 256;
+	nfa.states = palloc(sizeof(regexp_nfa_state) * nfa.nrooms);
+	nfa_start = regexp_nfa_build(&nfa, node, &nfa_accept);
+	result = regexp_dfa_build(&nfa, nfa_start, nfa_accept,
+							  anchored_start, anchored_end);
+	pfree(nfa.states);
+
+	/* save the result on the cache */
+	oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+	if (regexp_cache_pattern)
+		pfree(regexp_cache_pattern);
+	if (regexp_cache_dfa)
+		pfree(regexp_cache_dfa);
+	regexp_cache_pattern = (text *) pg_detoast_datum_copy((struct varlena *)pattern);
+	regexp_cache_flags = flags;
+	regexp_cache_dfa = (bytea *) pg_detoast_datum_copy((struct varlena *)result);
+	MemoryContextSwitchTo(oldcxt);
+
+	return result;
+}
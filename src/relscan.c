@@ -19,8 +19,18 @@ typedef struct
 	List	   *indexclauses[INDEX_MAX_KEYS];
 } IndexClauseSet;
 
+/* max number of BRIN-indexes to be ANDed on a scan */
+#define PGSTROM_BRIN_MAX_INDEXES	4
+
 /*--- static variables ---*/
 static bool		pgstrom_enable_brin;
+static bool		pgstrom_nvme_bulk_cold_scan;	/* GUC */
+static bool		pgstrom_gpu_mvcc_visibility;	/* GUC */
+static int		pgstrom_gpu_mvcc_max_xids;		/* GUC */
+static int		pgstrom_heapscan_prefetch_chunks;	/* GUC */
+static bool		pgstrom_nvme_stripe_aware;		/* GUC */
+bool			pgstrom_enable_zonemap;			/* GUC */
+static int		pgstrom_zonemap_nslots;			/* GUC */
 
 /*
  * simple_match_clause_to_indexcol
@@ -346,6 +356,11 @@ pgstrom_tryfind_brinindex(PlannerInfo *root,
 	cl_long			indexNBlocks = LONG_MAX;
 	IndexOptInfo   *indexOpt = NULL;
 	List		   *indexQuals = NIL;
+	IndexOptInfo   *candOpts[PGSTROM_BRIN_MAX_INDEXES];
+	List		   *candQuals[PGSTROM_BRIN_MAX_INDEXES];
+	cl_long			candNBlocks[PGSTROM_BRIN_MAX_INDEXES];
+	int				ncands = 0;
+	int				i, j;
 	ListCell	   *cell;
 
 	/* skip if GUC disables BRIN-index */
@@ -387,25 +402,59 @@ pgstrom_tryfind_brinindex(PlannerInfo *root,
 			continue;
 
 		/*
-		 * In case when multiple BRIN-indexes are configured,
-		 * the one with minimal selectivity is the best choice.
+		 * In case when multiple BRIN-indexes are configured, the candidates
+		 * are kept in order of the selectivity; the one with minimal
+		 * selectivity is the primary index.
 		 */
  		nblocks = estimate_brinindex_scan_nblocks(root, baserel,
 												  index,
 												  &clauseset,
 												  &temp);
-		if (indexNBlocks > nblocks)
+		if (baserel->pages > 0 && nblocks >= baserel->pages)
+			continue;	/* never skip any blocks */
+		for (i=0; i < ncands && candNBlocks[i] <= nblocks; i++);
+		if (i >= PGSTROM_BRIN_MAX_INDEXES)
+			continue;
+		for (j = Min(ncands, PGSTROM_BRIN_MAX_INDEXES - 1); j > i; j--)
 		{
-			indexOpt = index;
-			indexQuals = temp;
-			indexNBlocks = nblocks;
+			candOpts[j] = candOpts[j-1];
+			candQuals[j] = candQuals[j-1];
+			candNBlocks[j] = candNBlocks[j-1];
 		}
+		candOpts[i] = index;
+		candQuals[i] = temp;
+		candNBlocks[i] = nblocks;
+		if (ncands < PGSTROM_BRIN_MAX_INDEXES)
+			ncands++;
 	}
 
-	if (indexOpt)
+	if (ncands > 0)
 	{
+		List	   *indexConds = NIL;
+		double		frac = 1.0;
+
+		/*
+		 * Block ranges are skipped if any of the BRIN-indexes are
+		 * inconsistent, so selectivity of the indexes are multiplied
+		 * on the assumption of independence.
+		 */
+		indexOpt = candOpts[0];
+		for (i=0; i < ncands; i++)
+		{
+			List	   *conds;
+
+			conds = extract_index_conditions(candQuals[i], candOpts[i]);
+			indexConds = lappend(indexConds,
+								 lcons(makeInteger(candOpts[i]->indexoid),
+									   conds));
+			indexQuals = list_concat_unique_ptr(indexQuals, candQuals[i]);
+			if (baserel->pages > 0)
+				frac *= (double) candNBlocks[i] / (double) baserel->pages;
+		}
+		indexNBlocks = (cl_long)(frac * (double) baserel->pages);
+
 		if (p_indexConds)
-			*p_indexConds = extract_index_conditions(indexQuals, indexOpt);
+			*p_indexConds = indexConds;
 		if (p_indexQuals)
 			*p_indexQuals = indexQuals;
 		if (p_indexNBlocks)
@@ -437,7 +486,10 @@ pgstrom_common_relscan_cost(PlannerInfo *root,
 	Cost		run_cost = 0.0;
 	Cost		index_scan_cost = 0.0;
 	Cost		disk_scan_cost = 0.0;
-	double		gpu_ratio = pgstrom_gpu_operator_cost / cpu_operator_cost;
+	double		gpu_setup_cost;
+	double		gpu_dma_cost;
+	double		gpu_operator_cost;
+	double		gpu_ratio;
 	double		parallel_divisor;
 	double		ntuples = scan_rel->tuples;
 	double		nblocks = scan_rel->pages;
@@ -451,6 +503,11 @@ pgstrom_common_relscan_cost(PlannerInfo *root,
 	QualCost	qcost;
 	ListCell   *lc;
 
+	pgstrom_gpu_cost_factors(&gpu_setup_cost,
+							 &gpu_dma_cost,
+							 &gpu_operator_cost);
+	gpu_ratio = gpu_operator_cost / cpu_operator_cost;
+
 	Assert((scan_rel->reloptkind == RELOPT_BASEREL ||
 			scan_rel->reloptkind == RELOPT_OTHER_MEMBER_REL) &&
 		   scan_rel->relid > 0 &&
@@ -537,13 +594,13 @@ pgstrom_common_relscan_cost(PlannerInfo *root,
 		 * be shared with all the worker process, so we can discount the
 		 * cost by parallel_divisor.
 		 */
-		startup_cost += pgstrom_gpu_setup_cost / 2
-			+ (pgstrom_gpu_setup_cost / (2 * parallel_divisor));
+		startup_cost += gpu_setup_cost / 2
+			+ (gpu_setup_cost / (2 * parallel_divisor));
 	}
 	else
 	{
 		parallel_divisor = 1.0;
-		startup_cost += pgstrom_gpu_setup_cost;
+		startup_cost += gpu_setup_cost;
 	}
 	/*
 	 * Cost discount for more efficient I/O with multiplexing.
@@ -598,7 +655,7 @@ pgstrom_common_relscan_cost(PlannerInfo *root,
 	ntuples *= selectivity;
 
 	/* Cost for DMA transfer (host/storage --> GPU) */
-	run_cost += pgstrom_gpu_dma_cost * nchunks;
+	run_cost += gpu_dma_cost * nchunks;
 
 	*p_parallel_divisor = parallel_divisor;
 	*p_scan_ntuples = ntuples / parallel_divisor;
@@ -832,6 +889,82 @@ RelationCanUseNvmeStrom(Relation relation)
 			cuda_dindex <  numDevAttrs);
 }
 
+/*
+ * __read_sysfs_block_attr - read an attribute of md device from sysfs
+ */
+static long
+__read_sysfs_block_attr(dev_t st_dev, const char *attr, char *buf, size_t bufsz)
+{
+	const char *fmt[] = {"/sys/dev/block/%u:%u/md/%s",
+						 "/sys/dev/block/%u:%u/../md/%s"};	/* partition */
+	char		path[MAXPGPATH];
+	FILE	   *filp;
+	int			i;
+
+	for (i=0; i < lengthof(fmt); i++)
+	{
+		snprintf(path, sizeof(path), fmt[i],
+				 major(st_dev), minor(st_dev), attr);
+		filp = fopen(path, "r");
+		if (!filp)
+			continue;
+		if (!fgets(buf, bufsz, filp))
+			buf[0] = '\0';
+		fclose(filp);
+		return strlen(buf);
+	}
+	return -1;
+}
+
+/*
+ * RelationGetStripeNBlocks
+ *
+ * It returns the stripe width (chunk size x number of member drives) in
+ * blocks, if the relation is stored on md-raid0 volume. Elsewhere, it
+ * returns 0. The parallel scan assigns the blocks to workers by the unit of
+ * the stripe width, so concurrent reads of a worker are spread across all
+ * the member drives, not only a particular one.
+ */
+BlockNumber
+RelationGetStripeNBlocks(Relation relation)
+{
+	struct stat	stat_buf;
+	char	   *path;
+	char		buf[80];
+	long		chunk_sz;
+	long		raid_disks;
+	BlockNumber	nblocks;
+
+	if (!pgstrom_nvme_stripe_aware ||
+		RelationUsesLocalBuffers(relation))
+		return 0;
+	path = relpathperm(relation->rd_node, MAIN_FORKNUM);
+	if (stat(path, &stat_buf) != 0)
+	{
+		pfree(path);
+		return 0;
+	}
+	pfree(path);
+
+	if (__read_sysfs_block_attr(stat_buf.st_dev, "level",
+								buf, sizeof(buf)) <= 0 ||
+		strncmp(buf, "raid0", 5) != 0)
+		return 0;
+	if (__read_sysfs_block_attr(stat_buf.st_dev, "chunk_size",
+								buf, sizeof(buf)) <= 0 ||
+		(chunk_sz = atol(buf)) < BLCKSZ)
+		return 0;
+	if (__read_sysfs_block_attr(stat_buf.st_dev, "raid_disks",
+								buf, sizeof(buf)) <= 0 ||
+		(raid_disks = atol(buf)) < 2)
+		return 0;
+	nblocks = (chunk_sz / BLCKSZ) * raid_disks;
+	/* too large stripe width makes unbalanced load of the workers */
+	if (nblocks > RELSEG_SIZE / 16)
+		return 0;
+	return nblocks;
+}
+
 /*
  * ScanPathWillUseNvmeStrom - Optimizer Hint
  */
@@ -918,10 +1051,16 @@ typedef struct pgstromIndexState
 	int			num_runtime_keys;
 	bool		runtime_key_ready;
 	ExprContext *runtime_econtext;
+	/* next BRIN-index to be ANDed, if any */
+	struct pgstromIndexState *next;
 } pgstromIndexState;
 
 /*
  * pgstromExecInitBrinIndexMap
+ *
+ * @index_conds is a list of the conditions per BRIN-index; each of them
+ * begins with the OID of the index. The first one is @index_oid, and its
+ * range size is the unit of the block map.
  */
 void
 pgstromExecInitBrinIndexMap(GpuTaskState *gts,
@@ -930,15 +1069,17 @@ pgstromExecInitBrinIndexMap(GpuTaskState *gts,
 							List *index_quals)
 {
 	pgstromIndexState *pi_state = NULL;
+	pgstromIndexState **p_next = &gts->outer_index_state;
 	Relation	relation = gts->css.ss.ss_currentRelation;
 	EState	   *estate = gts->css.ss.ps.state;
 	Index		scanrelid;
 	LOCKMODE	lockmode = NoLock;
+	ListCell   *lc;
 
+	gts->outer_index_state = NULL;
 	if (!OidIsValid(index_oid))
 	{
 		Assert(index_conds == NIL);
-		gts->outer_index_state = NULL;
 		return;
 	}
 	Assert(relation != NULL);
@@ -946,36 +1087,44 @@ pgstromExecInitBrinIndexMap(GpuTaskState *gts,
 	if (!ExecRelationIsTargetRelation(estate, scanrelid))
 		lockmode = AccessShareLock;
 
-	pi_state = palloc0(sizeof(pgstromIndexState));
-	pi_state->index_oid = index_oid;
-	pi_state->index_rel = index_open(index_oid, lockmode);
-	pi_state->index_quals = (Node *)make_ands_explicit(index_quals);
-	ExecIndexBuildScanKeys(&gts->css.ss.ps,
-						   pi_state->index_rel,
-						   index_conds,
-						   false,
-						   &pi_state->scan_keys,
-						   &pi_state->num_scan_keys,
-						   &pi_state->runtime_keys_info,
-						   &pi_state->num_runtime_keys,
-						   NULL,
-						   NULL);
-
-	/* ExprContext to evaluate runtime keys, if any */
-	if (pi_state->num_runtime_keys != 0)
-		pi_state->runtime_econtext = CreateExprContext(estate);
-	else
-		pi_state->runtime_econtext = NULL;
-
-	/* BRIN index specific initialization */
-	pi_state->nblocks = RelationGetNumberOfBlocks(relation);
-	pi_state->brin_revmap = brinRevmapInitialize(pi_state->index_rel,
-												 &pi_state->range_sz,
-												 estate->es_snapshot);
-	pi_state->brin_desc = brin_build_desc(pi_state->index_rel);
+	foreach (lc, index_conds)
+	{
+		List	   *conds = lfirst(lc);
+
+		pi_state = palloc0(sizeof(pgstromIndexState));
+		pi_state->index_oid = intVal(linitial(conds));
+		Assert(lc != list_head(index_conds) ||
+			   pi_state->index_oid == index_oid);
+		pi_state->index_rel = index_open(pi_state->index_oid, lockmode);
+		pi_state->index_quals = (Node *)make_ands_explicit(index_quals);
+		ExecIndexBuildScanKeys(&gts->css.ss.ps,
+							   pi_state->index_rel,
+							   list_copy_tail(conds, 1),
+							   false,
+							   &pi_state->scan_keys,
+							   &pi_state->num_scan_keys,
+							   &pi_state->runtime_keys_info,
+							   &pi_state->num_runtime_keys,
+							   NULL,
+							   NULL);
 
-	/* save the state */
-	gts->outer_index_state = pi_state;
+		/* ExprContext to evaluate runtime keys, if any */
+		if (pi_state->num_runtime_keys != 0)
+			pi_state->runtime_econtext = CreateExprContext(estate);
+		else
+			pi_state->runtime_econtext = NULL;
+
+		/* BRIN index specific initialization */
+		pi_state->nblocks = RelationGetNumberOfBlocks(relation);
+		pi_state->brin_revmap = brinRevmapInitialize(pi_state->index_rel,
+													 &pi_state->range_sz,
+													 estate->es_snapshot);
+		pi_state->brin_desc = brin_build_desc(pi_state->index_rel);
+
+		/* save the state */
+		*p_next = pi_state;
+		p_next = &pi_state->next;
+	}
 }
 
 /*
@@ -1003,9 +1152,9 @@ pgstromSizeOfBrinIndexMap(GpuTaskState *gts)
  * Also see bringetbitmap
  */
 static void
-__pgstromExecGetBrinIndexMap(pgstromIndexState *pi_state,
-							 Bitmapset *brin_map,
-							 Snapshot snapshot)
+__pgstromExecBuildBrinIndexMap(pgstromIndexState *pi_state,
+							   bitmapword *words, int nwords,
+							   Snapshot snapshot)
 {
 	BrinDesc	   *bdesc = pi_state->brin_desc;
 	TupleDesc		bd_tupdesc = bdesc->bd_tupdesc;
@@ -1018,10 +1167,41 @@ __pgstromExecGetBrinIndexMap(pgstromIndexState *pi_state,
 	BrinMemTuple   *dtup;
 	BrinTuple	   *btup	__attribute__((unused)) = NULL;
 	Size			btupsz	__attribute__((unused)) = 0;
-	int				nranges;
-	int				nwords;
 	MemoryContext	oldcxt;
 	MemoryContext	perRangeCxt;
+#if PG_VERSION_NUM >= 140000
+	ScanKey		  **keys;
+	int			   *nkeys;
+	bool		   *nullkeys;
+	int				keyno;
+	AttrNumber		attno;
+
+	/*
+	 * Scan keys are grouped by the indexed column, because the consistent
+	 * functions with 4 arguments (like bloom or minmax-multi opclasses)
+	 * take all the scan keys on the column at once.
+	 */
+	keys = palloc0(sizeof(ScanKey *) * bd_tupdesc->natts);
+	nkeys = palloc0(sizeof(int) * bd_tupdesc->natts);
+	nullkeys = palloc0(sizeof(bool) * bd_tupdesc->natts);
+	for (keyno = 0; keyno < pi_state->num_scan_keys; keyno++)
+	{
+		ScanKey		key = &pi_state->scan_keys[keyno];
+
+		attno = key->sk_attno;
+		Assert(attno > 0 && attno <= bd_tupdesc->natts);
+		/* strict operator never matches with NULL */
+		if ((key->sk_flags & SK_ISNULL) != 0)
+		{
+			nullkeys[attno - 1] = true;
+			continue;
+		}
+		if (!keys[attno - 1])
+			keys[attno - 1] = palloc0(sizeof(ScanKey) *
+									  pi_state->num_scan_keys);
+		keys[attno - 1][nkeys[attno - 1]++] = key;
+	}
+#endif
 
 	/* rooms for the consistent support procedures of indexed columns */
 	consistentFn = palloc0(sizeof(FmgrInfo) * bd_tupdesc->natts);
@@ -1034,11 +1214,7 @@ __pgstromExecGetBrinIndexMap(pgstromIndexState *pi_state,
 										ALLOCSET_DEFAULT_SIZES);
 	oldcxt = MemoryContextSwitchTo(perRangeCxt);
 
-	nranges = (pi_state->nblocks +
-			   pi_state->range_sz - 1) / pi_state->range_sz;
-	nwords = (nranges + BITS_PER_BITMAPWORD - 1) / BITS_PER_BITMAPWORD;
-	Assert(brin_map->nwords < 0);
-	memset(brin_map->words, 0, sizeof(bitmapword) * nwords);
+	memset(words, 0, sizeof(bitmapword) * nwords);
 	/*
 	 * Now scan the revmap.  We start by querying for heap page 0,
 	 * incrementing by the number of pages per range; this gives us a full
@@ -1051,7 +1227,9 @@ __pgstromExecGetBrinIndexMap(pgstromIndexState *pi_state,
 		BrinTuple  *tup;
 		OffsetNumber off;
 		Size		size;
+#if PG_VERSION_NUM < 140000
 		int			keyno;
+#endif
 
 		CHECK_FOR_INTERRUPTS();
 
@@ -1067,6 +1245,76 @@ __pgstromExecGetBrinIndexMap(pgstromIndexState *pi_state,
 
 			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
 			dtup = brin_deform_tuple(bdesc, btup, dtup);
+#if PG_VERSION_NUM >= 140000
+			if (!dtup->bt_placeholder)
+			{
+				for (attno = 1; attno <= bd_tupdesc->natts; attno++)
+				{
+					BrinValues *bval = &dtup->bt_columns[attno - 1];
+					FmgrInfo   *fn_cons = &consistentFn[attno - 1];
+					bool		addrange = true;
+
+					if (nkeys[attno - 1] == 0 && !nullkeys[attno - 1])
+						continue;
+					if (nullkeys[attno - 1] || bval->bv_allnulls)
+						addrange = false;
+					else
+					{
+						/* First time this column? look up consistent function */
+						if (fn_cons->fn_oid == InvalidOid)
+						{
+							FmgrInfo   *tmp;
+
+							tmp = index_getprocinfo(pi_state->index_rel, attno,
+													BRIN_PROCNUM_CONSISTENT);
+							fmgr_info_copy(fn_cons, tmp,
+										   CurrentMemoryContext);
+						}
+
+						if (fn_cons->fn_nargs >= 4)
+						{
+							Datum	rv;
+
+							rv = FunctionCall4Coll(fn_cons,
+												   keys[attno - 1][0]->sk_collation,
+												   PointerGetDatum(bdesc),
+												   PointerGetDatum(bval),
+												   PointerGetDatum(keys[attno - 1]),
+												   Int32GetDatum(nkeys[attno - 1]));
+							addrange = DatumGetBool(rv);
+						}
+						else
+						{
+							for (keyno = 0; keyno < nkeys[attno - 1]; keyno++)
+							{
+								ScanKey	key = keys[attno - 1][keyno];
+								Datum	rv;
+
+								rv = FunctionCall3Coll(fn_cons,
+													   key->sk_collation,
+													   PointerGetDatum(bdesc),
+													   PointerGetDatum(bval),
+													   PointerGetDatum(key));
+								addrange = DatumGetBool(rv);
+								if (!addrange)
+									break;
+							}
+						}
+					}
+					/*
+					 * If the scan keys are not consistent with the page range
+					 * values, pages in the range shall be skipped on the scan.
+					 */
+					if (!addrange)
+					{
+						if (index / BITS_PER_BITMAPWORD < nwords)
+							words[index / BITS_PER_BITMAPWORD]
+								|= (1U << (index % BITS_PER_BITMAPWORD));
+						break;
+					}
+				}
+			}
+#else
 			if (!dtup->bt_placeholder)
 			{
 				for (keyno = 0; keyno < pi_state->num_scan_keys; keyno++)
@@ -1104,12 +1352,13 @@ __pgstromExecGetBrinIndexMap(pgstromIndexState *pi_state,
 					if (!DatumGetBool(rv))
 					{
 						if (index / BITS_PER_BITMAPWORD < nwords)
-							brin_map->words[index / BITS_PER_BITMAPWORD]
+							words[index / BITS_PER_BITMAPWORD]
 								|= (1U << (index % BITS_PER_BITMAPWORD));
 						break;
 					}
 				}
 			}
+#endif
 		}
 	}
 	MemoryContextSwitchTo(oldcxt);
@@ -1117,6 +1366,57 @@ __pgstromExecGetBrinIndexMap(pgstromIndexState *pi_state,
 
 	if (buf != InvalidBuffer)
 		ReleaseBuffer(buf);
+}
+
+static void
+__pgstromExecGetBrinIndexMap(pgstromIndexState *pi_state,
+							 Bitmapset *brin_map,
+							 Snapshot snapshot)
+{
+	pgstromIndexState *curr;
+	BlockNumber	range_sz = pi_state->range_sz;
+	int			nranges;
+	int			nwords;
+
+	nranges = (pi_state->nblocks + range_sz - 1) / range_sz;
+	nwords = (nranges + BITS_PER_BITMAPWORD - 1) / BITS_PER_BITMAPWORD;
+	Assert(brin_map->nwords < 0);
+	__pgstromExecBuildBrinIndexMap(pi_state, brin_map->words, nwords,
+								   snapshot);
+	/*
+	 * The other BRIN-indexes are ANDed. A range of the primary index is
+	 * skipped, if all the overlapping ranges of the other index are
+	 * inconsistent with the scan keys.
+	 */
+	for (curr = pi_state->next; curr != NULL; curr = curr->next)
+	{
+		bitmapword *temp;
+		int			temp_nranges;
+		int			temp_nwords;
+		int			i, k;
+
+		temp_nranges = (curr->nblocks + curr->range_sz - 1) / curr->range_sz;
+		temp_nwords = (temp_nranges + BITS_PER_BITMAPWORD - 1) / BITS_PER_BITMAPWORD;
+		temp = palloc(sizeof(bitmapword) * Max(temp_nwords, 1));
+		__pgstromExecBuildBrinIndexMap(curr, temp, temp_nwords, snapshot);
+		for (i=0; i < nranges; i++)
+		{
+			BlockNumber	head = i * range_sz;
+			BlockNumber	tail = Min(head + range_sz, pi_state->nblocks) - 1;
+
+			for (k = head / curr->range_sz; k <= tail / curr->range_sz; k++)
+			{
+				if (k >= temp_nranges ||
+					(temp[k / BITS_PER_BITMAPWORD] &
+					 (1U << (k % BITS_PER_BITMAPWORD))) == 0)
+					break;
+			}
+			if (k > tail / curr->range_sz)
+				brin_map->words[i / BITS_PER_BITMAPWORD]
+					|= (1U << (i % BITS_PER_BITMAPWORD));
+		}
+		pfree(temp);
+	}
 	/* mark this bitmapset is ready */
 	pg_memory_barrier();
 	brin_map->nwords = nwords;
@@ -1207,10 +1507,12 @@ pgstromExecEndBrinIndexMap(GpuTaskState *gts)
 {
 	pgstromIndexState *pi_state = gts->outer_index_state;
 
-	if (!pi_state)
-		return;
-	brinRevmapTerminate(pi_state->brin_revmap);
-	index_close(pi_state->index_rel, NoLock);
+	while (pi_state)
+	{
+		brinRevmapTerminate(pi_state->brin_revmap);
+		index_close(pi_state->index_rel, NoLock);
+		pi_state = pi_state->next;
+	}
 }
 
 void
@@ -1257,6 +1559,410 @@ pgstromExplainBrinIndexMap(GpuTaskState *gts,
 	}
 }
 
+/*
+ * Zone-map of heap tables
+ *
+ * GpuScan kernel on KDS_FORMAT_BLOCK gathers min/max of the integer-like
+ * columns referenced by the simple qualifiers for each block, as a side
+ * effect of the scan. They are merged into the zone-map on the shared
+ * memory per PGSTROM_ZONEMAP_NBLOCKS blocks (zone), then the later scans
+ * skip the zones where no rows can match, without BRIN-index.
+ * The zone-map is valid only if all the blocks in the zone are all-visible,
+ * and the visibility-map page is not updated since then. Any update of the
+ * block clears the all-visible bit, and the bit shall be set again with
+ * a new LSN of the visibility-map page.
+ */
+typedef struct
+{
+	RelFileNode	rnode;
+	BlockNumber	zone_no;		/* block number / PGSTROM_ZONEMAP_NBLOCKS */
+	AttrNumber	attnum;			/* InvalidAttrNumber, if free entry */
+	uint32		observed;		/* bitmap of the blocks already gathered */
+	XLogRecPtr	vm_lsn;			/* LSN of the VM page at the gathering */
+	int64		min_key;
+	int64		max_key;
+} pgstromZoneMapEntry;
+
+#define PGSTROM_ZONEMAP_NWAYS		4
+typedef struct
+{
+	slock_t		lock;
+	pgstromZoneMapEntry entries[PGSTROM_ZONEMAP_NWAYS];
+} pgstromZoneMapSlot;
+
+/*
+ * pgstromZoneMapState - runtime status of zone-map for relation scan
+ */
+typedef struct pgstromZoneMapState
+{
+	RelFileNode	rnode;
+	int			ncols;
+	AttrNumber *attnums;		/* columns to be gathered */
+	List	   *conds;			/* (attnum, strategy, key) triples */
+	Buffer		vmbuffer;		/* VM page pinned, if any */
+	BlockNumber	curr_zone;		/* zone of the last check */
+	bool		curr_skip;		/* result of the last check */
+} pgstromZoneMapState;
+
+static pgstromZoneMapSlot *zonemap_slots = NULL;
+static shmem_startup_hook_type shmem_startup_next = NULL;
+
+static pgstromZoneMapSlot *
+__zonemap_lookup_slot(const RelFileNode *rnode,
+					  BlockNumber zone_no,
+					  AttrNumber attnum)
+{
+	struct {
+		RelFileNode	rnode;
+		BlockNumber	zone_no;
+		int32		attnum;
+	}		hkey;
+	uint32	hash;
+
+	memset(&hkey, 0, sizeof(hkey));
+	hkey.rnode = *rnode;
+	hkey.zone_no = zone_no;
+	hkey.attnum = attnum;
+	hash = hash_any((unsigned char *)&hkey, sizeof(hkey));
+
+	return &zonemap_slots[hash % pgstrom_zonemap_nslots];
+}
+
+static inline bool
+__zonemap_entry_matched(pgstromZoneMapEntry *entry,
+						const RelFileNode *rnode,
+						BlockNumber zone_no,
+						AttrNumber attnum)
+{
+	return (entry->attnum == attnum &&
+			entry->zone_no == zone_no &&
+			RelFileNodeEquals(entry->rnode, *rnode));
+}
+
+/*
+ * pgstromExecInitZoneMap
+ *
+ * @zmap_conds is a list of (attnum, strategy, key) triples built by the
+ * planner; the key is an int8 Const.
+ */
+void
+pgstromExecInitZoneMap(GpuTaskState *gts, List *zmap_conds)
+{
+	Relation	relation = gts->css.ss.ss_currentRelation;
+	pgstromZoneMapState *zm_state;
+	ListCell   *lc;
+	int			i;
+
+	gts->outer_zmap_state = NULL;
+	if (zmap_conds == NIL ||
+		!zonemap_slots ||
+		!relation ||
+		!RelationNeedsWAL(relation) ||
+		RecoveryInProgress())
+		return;
+
+	zm_state = palloc0(sizeof(pgstromZoneMapState));
+	zm_state->rnode = relation->rd_node;
+	zm_state->attnums = palloc0(sizeof(AttrNumber) * list_length(zmap_conds));
+	foreach (lc, zmap_conds)
+	{
+		AttrNumber	attnum = intVal(linitial(lfirst(lc)));
+
+		for (i=0; i < zm_state->ncols; i++)
+		{
+			if (zm_state->attnums[i] == attnum)
+				break;
+		}
+		if (i == zm_state->ncols)
+			zm_state->attnums[zm_state->ncols++] = attnum;
+	}
+	zm_state->conds = zmap_conds;
+	zm_state->vmbuffer = InvalidBuffer;
+	zm_state->curr_zone = InvalidBlockNumber;
+
+	gts->outer_zmap_state = zm_state;
+}
+
+/*
+ * pgstromZoneMapColumns
+ *
+ * It returns number of the columns to be gathered by GPU kernel, or 0 if
+ * zone-map is not used.
+ */
+int
+pgstromZoneMapColumns(GpuTaskState *gts, const AttrNumber **p_attnums)
+{
+	pgstromZoneMapState *zm_state = gts->outer_zmap_state;
+
+	if (!zm_state)
+		return 0;
+	*p_attnums = zm_state->attnums;
+	return zm_state->ncols;
+}
+
+/*
+ * __zonemap_merge_entry
+ */
+static void
+__zonemap_merge_entry(const RelFileNode *rnode,
+					  BlockNumber blknum,
+					  AttrNumber attnum,
+					  XLogRecPtr vm_lsn,
+					  int64 min_key,
+					  int64 max_key)
+{
+	BlockNumber	zone_no = blknum / PGSTROM_ZONEMAP_NBLOCKS;
+	pgstromZoneMapSlot *zm_slot;
+	pgstromZoneMapEntry *entry = NULL;
+	pgstromZoneMapEntry *victim = NULL;
+	int			i;
+
+	zm_slot = __zonemap_lookup_slot(rnode, zone_no, attnum);
+	SpinLockAcquire(&zm_slot->lock);
+	for (i=0; i < PGSTROM_ZONEMAP_NWAYS; i++)
+	{
+		pgstromZoneMapEntry *curr = &zm_slot->entries[i];
+
+		if (__zonemap_entry_matched(curr, rnode, zone_no, attnum))
+		{
+			entry = curr;
+			break;
+		}
+		/* free entry, or the entry with less blocks gathered */
+		if (!victim ||
+			(victim->attnum != InvalidAttrNumber &&
+			 (curr->attnum == InvalidAttrNumber ||
+			  __builtin_popcount(curr->observed) <
+			  __builtin_popcount(victim->observed))))
+			victim = curr;
+	}
+	if (!entry)
+	{
+		entry = victim;
+		entry->rnode = *rnode;
+		entry->zone_no = zone_no;
+		entry->attnum = attnum;
+		entry->observed = 0;
+		entry->vm_lsn = vm_lsn;
+		entry->min_key = LONG_MAX;
+		entry->max_key = LONG_MIN;
+	}
+	else if (entry->vm_lsn != vm_lsn)
+	{
+		/* visibility-map page was updated, so restart to gather */
+		entry->observed = 0;
+		entry->vm_lsn = vm_lsn;
+		entry->min_key = LONG_MAX;
+		entry->max_key = LONG_MIN;
+	}
+	entry->observed |= (1U << (blknum % PGSTROM_ZONEMAP_NBLOCKS));
+	entry->min_key = Min(entry->min_key, min_key);
+	entry->max_key = Max(entry->max_key, max_key);
+	SpinLockRelease(&zm_slot->lock);
+}
+
+/*
+ * pgstromZoneMapUpdate
+ *
+ * It merges min/max of the blocks gathered by GPU kernel into the zone-map.
+ * @items is an array of (min, max) pairs per column per block of @pds.
+ * @build_lsn is the WAL insert position before the chunk was built; only
+ * the blocks being all-visible and whose visibility-map page is not updated
+ * since then are merged, because GPU kernel gathered only visible tuples.
+ */
+void
+pgstromZoneMapUpdate(GpuTaskState *gts,
+					 pgstrom_data_store *pds,
+					 const cl_long *items,
+					 XLogRecPtr build_lsn)
+{
+	pgstromZoneMapState *zm_state = gts->outer_zmap_state;
+	Relation	relation = gts->css.ss.ss_currentRelation;
+	cl_uint		i, j;
+
+	Assert(zm_state != NULL && pds->kds.format == KDS_FORMAT_BLOCK);
+	for (i=0; i < pds->kds.nitems; i++)
+	{
+		BlockNumber	blknum = KERN_DATA_STORE_BLOCK_BLCKNR(&pds->kds, i);
+		const cl_long *vals = items + 2 * zm_state->ncols * i;
+		XLogRecPtr	vm_lsn;
+
+		if ((visibilitymap_get_status(relation, blknum,
+									  &zm_state->vmbuffer) &
+			 VISIBILITYMAP_ALL_VISIBLE) == 0)
+			continue;
+		vm_lsn = BufferGetLSNAtomic(zm_state->vmbuffer);
+		if (vm_lsn > build_lsn)
+			continue;
+		for (j=0; j < zm_state->ncols; j++)
+		{
+			__zonemap_merge_entry(&zm_state->rnode, blknum,
+								  zm_state->attnums[j], vm_lsn,
+								  vals[2*j], vals[2*j+1]);
+		}
+	}
+	/* zone-map might be changed */
+	zm_state->curr_zone = InvalidBlockNumber;
+}
+
+/*
+ * pgstromZoneMapCanSkip
+ *
+ * It checks whether the zone of @blknum has no rows that match with the
+ * qualifiers. The result is cached per zone, because the heap scan walks
+ * on the blocks in the zone continuously.
+ */
+static bool
+pgstromZoneMapCanSkip(GpuTaskState *gts,
+					  HeapScanDesc hscan,
+					  BlockNumber blknum)
+{
+	pgstromZoneMapState *zm_state = gts->outer_zmap_state;
+	Relation	relation = gts->css.ss.ss_currentRelation;
+	BlockNumber	zone_no = blknum / PGSTROM_ZONEMAP_NBLOCKS;
+	BlockNumber	base = zone_no * PGSTROM_ZONEMAP_NBLOCKS;
+	BlockNumber	nblocks;
+	uint32		mask;
+	XLogRecPtr	vm_lsn;
+	ListCell   *lc;
+	int			i;
+
+	if (zm_state->curr_zone == zone_no)
+		return zm_state->curr_skip;
+	zm_state->curr_zone = zone_no;
+	zm_state->curr_skip = false;
+
+	Assert(blknum < hscan->rs_nblocks);
+	nblocks = Min(hscan->rs_nblocks - base, PGSTROM_ZONEMAP_NBLOCKS);
+	mask = (nblocks < 32 ? (1U << nblocks) - 1 : ~0U);
+	/* all the blocks in the zone must be all-visible right now */
+	for (i=0; i < nblocks; i++)
+	{
+		if ((visibilitymap_get_status(relation, base + i,
+									  &zm_state->vmbuffer) &
+			 VISIBILITYMAP_ALL_VISIBLE) == 0)
+			return false;
+	}
+	vm_lsn = BufferGetLSNAtomic(zm_state->vmbuffer);
+
+	foreach (lc, zm_state->conds)
+	{
+		List	   *cond = lfirst(lc);
+		AttrNumber	attnum = intVal(linitial(cond));
+		int			strategy = intVal(lsecond(cond));
+		int64		key = DatumGetInt64(((Const *)lthird(cond))->constvalue);
+		pgstromZoneMapSlot *zm_slot;
+		bool		found = false;
+		int64		min_key = 0;
+		int64		max_key = 0;
+
+		zm_slot = __zonemap_lookup_slot(&zm_state->rnode, zone_no, attnum);
+		SpinLockAcquire(&zm_slot->lock);
+		for (i=0; i < PGSTROM_ZONEMAP_NWAYS; i++)
+		{
+			pgstromZoneMapEntry *entry = &zm_slot->entries[i];
+
+			if (__zonemap_entry_matched(entry, &zm_state->rnode,
+										zone_no, attnum))
+			{
+				if ((entry->observed & mask) == mask &&
+					entry->vm_lsn == vm_lsn)
+				{
+					min_key = entry->min_key;
+					max_key = entry->max_key;
+					found = true;
+				}
+				break;
+			}
+		}
+		SpinLockRelease(&zm_slot->lock);
+		if (!found)
+			continue;
+
+		switch (strategy)
+		{
+			case BTLessStrategyNumber:
+				zm_state->curr_skip = (min_key >= key);
+				break;
+			case BTLessEqualStrategyNumber:
+				zm_state->curr_skip = (min_key > key);
+				break;
+			case BTEqualStrategyNumber:
+				zm_state->curr_skip = (key < min_key || key > max_key);
+				break;
+			case BTGreaterEqualStrategyNumber:
+				zm_state->curr_skip = (max_key < key);
+				break;
+			case BTGreaterStrategyNumber:
+				zm_state->curr_skip = (max_key <= key);
+				break;
+			default:
+				elog(ERROR, "Bug? unexpected strategy: %d", strategy);
+		}
+		if (zm_state->curr_skip)
+			break;
+	}
+	return zm_state->curr_skip;
+}
+
+void
+pgstromExecEndZoneMap(GpuTaskState *gts)
+{
+	pgstromZoneMapState *zm_state = gts->outer_zmap_state;
+
+	if (zm_state && BufferIsValid(zm_state->vmbuffer))
+	{
+		ReleaseBuffer(zm_state->vmbuffer);
+		zm_state->vmbuffer = InvalidBuffer;
+	}
+}
+
+void
+pgstromExecRewindZoneMap(GpuTaskState *gts)
+{
+	pgstromZoneMapState *zm_state = gts->outer_zmap_state;
+
+	if (zm_state)
+		zm_state->curr_zone = InvalidBlockNumber;
+}
+
+/*
+ * pgstromExplainZoneMap
+ */
+static void
+pgstromExplainZoneMap(GpuTaskState *gts, ExplainState *es)
+{
+	if (!gts->outer_zmap_state || !es->analyze)
+		return;
+	ExplainPropertyInteger("Zone-map skipped", NULL,
+						   gts->outer_zmap_count, es);
+}
+
+/*
+ * pgstrom_startup_relscan
+ */
+static void
+pgstrom_startup_relscan(void)
+{
+	bool		found;
+	int			i;
+
+	if (shmem_startup_next)
+		(*shmem_startup_next)();
+
+	zonemap_slots = ShmemInitStruct("PG-Strom Zone-Map",
+									MAXALIGN(sizeof(pgstromZoneMapSlot) *
+											 pgstrom_zonemap_nslots),
+									&found);
+	if (!IsUnderPostmaster)
+	{
+		memset(zonemap_slots, 0, sizeof(pgstromZoneMapSlot) *
+			   pgstrom_zonemap_nslots);
+		for (i=0; i < pgstrom_zonemap_nslots; i++)
+			SpinLockInit(&zonemap_slots[i].lock);
+	}
+}
+
 /*
  * PDS_exec_heapscan_block - PDS scan for KDS_FORMAT_BLOCK format
  */
@@ -1322,6 +2028,260 @@ mergePDSHeapScanBlockState(pgstrom_data_store *pds,
 									   ioc[iovec->nr_chunks]));
 }
 
+/*
+ * nvmeProbeColdBlocks
+ *
+ * It builds a bitmap of the cold blocks; that are all-visible and not
+ * loaded on the shared buffers, in the window starting from @base.
+ * The buffer mapping table is probed by the partitions, so we acquire
+ * each partition lock once per window, not per block.
+ * Like the per-block probe, a block may be loaded to the shared buffer
+ * after the probe, however, it is harmless because all-visible blocks
+ * have the same contents on the storage.
+ */
+static void
+nvmeProbeColdBlocks(GpuTaskState *gts, BlockNumber base)
+{
+	Relation		relation = gts->css.ss.ss_currentRelation;
+	HeapScanDesc	hscan = (HeapScanDesc)gts->css.ss.ss_currentScanDesc;
+	NVMEScanState  *nvme_sstate = gts->nvme_sstate;
+	SMgrRelation	smgr = relation->rd_smgr;
+	uint32			hashes[NVME_COLD_PROBE_NBLOCKS];
+	uint16			order[NVME_COLD_PROBE_NBLOCKS];
+	uint16			part_start[NUM_BUFFER_PARTITIONS + 1];
+	cl_uint			nblocks;
+	cl_uint			ncandidates = 0;
+	cl_uint			i, j, part;
+
+	nblocks = Min(NVME_COLD_PROBE_NBLOCKS, hscan->rs_nblocks - base);
+	if (hscan->rs_numblocks != InvalidBlockNumber)
+		nblocks = Min(nblocks, hscan->rs_numblocks);
+	nvme_sstate->cold_base = base;
+	nvme_sstate->cold_nblocks = nblocks;
+	memset(nvme_sstate->cold_map, 0, sizeof(nvme_sstate->cold_map));
+	if (!RelationCanUseNvmeStrom(relation))
+		return;
+
+	/* 1st pass: visibility map, and hash of the candidate blocks */
+	memset(part_start, 0, sizeof(part_start));
+	for (i=0; i < nblocks; i++)
+	{
+		BufferTag	tag;
+
+		if (!nvme_sstate->mvcc_snapshot &&
+			!VM_ALL_VISIBLE(relation, base + i,
+							&nvme_sstate->curr_vmbuffer))
+			continue;
+		INIT_BUFFERTAG(tag, smgr->smgr_rnode.node, MAIN_FORKNUM, base + i);
+		hashes[i] = BufTableHashCode(&tag);
+		part_start[BufTableHashPartition(hashes[i]) + 1]++;
+		nvme_sstate->cold_map[i / BITS_PER_BYTE] |= (1 << (i % BITS_PER_BYTE));
+		ncandidates++;
+	}
+	if (ncandidates == 0)
+		return;
+
+	/* sort the candidates by the partition (counting sort) */
+	for (part=0; part < NUM_BUFFER_PARTITIONS; part++)
+		part_start[part+1] += part_start[part];
+	{
+		uint16		part_pos[NUM_BUFFER_PARTITIONS];
+
+		memcpy(part_pos, part_start, sizeof(part_pos));
+		for (i=0; i < nblocks; i++)
+		{
+			if ((nvme_sstate->cold_map[i / BITS_PER_BYTE] &
+				 (1 << (i % BITS_PER_BYTE))) != 0)
+				order[part_pos[BufTableHashPartition(hashes[i])]++] = i;
+		}
+	}
+
+	/* 2nd pass: buffer mapping table, by the partition */
+	for (part=0; part < NUM_BUFFER_PARTITIONS; part++)
+	{
+		LWLock	   *partitionLock;
+
+		if (part_start[part] == part_start[part+1])
+			continue;
+		partitionLock = BufMappingPartitionLock(hashes[order[part_start[part]]]);
+		LWLockAcquire(partitionLock, LW_SHARED);
+		for (j = part_start[part]; j < part_start[part+1]; j++)
+		{
+			BufferTag	tag;
+
+			i = order[j];
+			INIT_BUFFERTAG(tag, smgr->smgr_rnode.node, MAIN_FORKNUM, base + i);
+			if (BufTableLookup(&tag, hashes[i]) >= 0)
+				nvme_sstate->cold_map[i / BITS_PER_BYTE] &= ~(1 << (i % BITS_PER_BYTE));
+		}
+		LWLockRelease(partitionLock);
+	}
+}
+
+/*
+ * __mvcc_xid_comparator - wrap-around aware comparison of xids
+ */
+static int
+__mvcc_xid_comparator(const void *a, const void *b)
+{
+	TransactionId	xid1 = *((const TransactionId *) a);
+	TransactionId	xid2 = *((const TransactionId *) b);
+
+	if (xid1 == xid2)
+		return 0;
+	return (TransactionIdPrecedes(xid1, xid2) ? -1 : 1);
+}
+
+/*
+ * pgstromSetupMvccSnapshot
+ *
+ * It builds kern_mvcc_snapshot of the current scan, to check visibility of
+ * the tuples on the non-all-visible blocks by GPU kernel. Once it is built,
+ * the blocks that are not on the shared buffers are read by GPUDirect SQL
+ * regardless of the visibility map.
+ * It returns NULL, if the device side check is not available; like the
+ * case when the transaction may have its own (sub-)transactions, or the
+ * serializable isolation level needs predicate locks per tuple.
+ */
+kern_mvcc_snapshot *
+pgstromSetupMvccSnapshot(GpuTaskState *gts)
+{
+	GpuContext	   *gcontext = gts->gcontext;
+	Relation		relation = gts->css.ss.ss_currentRelation;
+	Snapshot		snapshot = gts->css.ss.ps.state->es_snapshot;
+	kern_mvcc_snapshot *snap;
+	TransactionId  *xip;
+	TransactionId	xid_base;
+	TransactionId	xid;
+	CUdeviceptr		m_snapshot;
+	CUresult		rc;
+	cl_uint			nxids;
+	cl_uint			nwords;
+	cl_uint			nxip;
+	size_t			length;
+
+	if (!pgstrom_gpu_mvcc_visibility ||
+		gts->task_kind != GpuTaskKind_GpuScan ||
+		!IsMVCCSnapshot(snapshot) ||
+		snapshot->takenDuringRecovery ||
+		snapshot->suboverflowed ||
+		TransactionIdIsValid(GetTopTransactionIdIfAny()) ||
+		IsolationIsSerializable())
+		return NULL;
+	xid_base = relation->rd_rel->relfrozenxid;
+	if (!TransactionIdIsNormal(xid_base))
+		return NULL;
+	if (TransactionIdPrecedes(snapshot->xmin, xid_base))
+		xid_base = snapshot->xmin;
+	nxids = snapshot->xmax - xid_base;
+	if (nxids > pgstrom_gpu_mvcc_max_xids)
+		return NULL;
+	nwords = (nxids + 31) / 32;
+	nxip = snapshot->xcnt + snapshot->subxcnt;
+
+	length = offsetof(kern_mvcc_snapshot, values[nwords + nxip]);
+	rc = gpuMemAllocManaged(gcontext,
+							&m_snapshot,
+							length,
+							CU_MEM_ATTACH_GLOBAL);
+	if (rc != CUDA_SUCCESS)
+		elog(ERROR, "failed on gpuMemAllocManaged: %s", errorText(rc));
+	snap = (kern_mvcc_snapshot *) m_snapshot;
+	memset(snap, 0, length);
+	snap->length = length;
+	snap->xid_base = xid_base;
+	snap->xmin = snapshot->xmin;
+	snap->xmax = snapshot->xmax;
+	snap->nxip = nxip;
+	snap->nwords = nwords;
+
+	/* sorted array of the in-progress transactions */
+	xip = KERN_MVCC_SNAPSHOT_XIP(snap);
+	memcpy(xip, snapshot->xip,
+		   sizeof(TransactionId) * snapshot->xcnt);
+	memcpy(xip + snapshot->xcnt, snapshot->subxip,
+		   sizeof(TransactionId) * snapshot->subxcnt);
+	qsort(xip, nxip, sizeof(TransactionId), __mvcc_xid_comparator);
+
+	/* commit status of the transactions in [xid_base, xmax) */
+	for (xid = xid_base; xid != snapshot->xmax; xid++)
+	{
+		cl_uint		pos = xid - xid_base;
+
+		if (!TransactionIdIsNormal(xid))
+			continue;
+		if (bsearch(&xid, xip, nxip, sizeof(TransactionId),
+					__mvcc_xid_comparator) != NULL)
+			continue;
+		if (TransactionIdDidCommit(xid))
+			snap->values[pos >> 5] |= (1U << (pos & 31));
+	}
+	return snap;
+}
+
+/*
+ * pgstromMvccTupleIsVisible
+ *
+ * CPU version of the visibility checks on the blocks loaded by GPUDirect SQL;
+ * used by the CPU fallback. Unlike the device code, it can resolve the
+ * update xid of MultiXact.
+ */
+bool
+pgstromMvccTupleIsVisible(GpuTaskState *gts,
+						  PageHeader hpage,
+						  HeapTupleHeader htup)
+{
+	NVMEScanState  *nvme_sstate = gts->nvme_sstate;
+	kern_mvcc_snapshot *snap;
+	TransactionId	xid;
+	int				rv;
+
+	if (PageIsAllVisible(hpage))
+		return true;
+	Assert(nvme_sstate != NULL && nvme_sstate->mvcc_snapshot != NULL);
+	snap = nvme_sstate->mvcc_snapshot;
+	rv = kern_mvcc_check_visibility(snap, htup);
+	if (rv >= 0)
+		return (rv > 0);
+	if ((htup->t_infomask & HEAP_MOVED) != 0)
+		elog(ERROR, "pg_strom: tuple moved by old VACUUM FULL is not supported");
+	/* elsewhere, xmin is visible and xmax is MultiXact */
+	Assert((htup->t_infomask & HEAP_XMAX_IS_MULTI) != 0);
+	xid = HeapTupleGetUpdateXid(htup);
+	if (!TransactionIdIsValid(xid))
+		return true;
+	return !kern_mvcc_xid_is_visible(snap, xid);
+}
+
+/*
+ * __PDS_exec_heapscan_cold_block - put a block to be read by GPUDirect SQL
+ */
+static inline bool
+__PDS_exec_heapscan_cold_block(NVMEScanState *nvme_sstate,
+							   pgstrom_data_store *pds,
+							   PDSHeapScanBlockState *bstate,
+							   BlockNumber blknum)
+{
+	BlockNumber	segno = blknum / RELSEG_SIZE;
+	GPUDirectFileDesc *dfile;
+
+	Assert(segno < nvme_sstate->nr_segs);
+	/*
+	 * We cannot mix up multiple source files in a single PDS chunk.
+	 * If heapscan_block comes across segment boundary, rest of the
+	 * blocks must be read on the next PDS chunk.
+	 */
+	dfile = &nvme_sstate->files[segno];
+	if (pds->filedesc.rawfd >= 0 &&
+		pds->filedesc.rawfd != dfile->rawfd)
+		return false;
+	if (pds->filedesc.rawfd < 0)
+		memcpy(&pds->filedesc, dfile, sizeof(GPUDirectFileDesc));
+	updatePDSHeapScanBlockState(pds, bstate, blknum);
+	pds->kds.nitems++;
+	return true;
+}
+
 static bool
 PDS_exec_heapscan_block(GpuTaskState *gts,
 						pgstrom_data_store *pds,
@@ -1348,14 +2308,36 @@ PDS_exec_heapscan_block(GpuTaskState *gts,
 	/* array of block numbers */
 	block_nums = (BlockNumber *)KERN_DATA_STORE_BODY(&pds->kds);
 
+	/*
+	 * In the bulk cold mode, all-visible and non-resident blocks are probed
+	 * in batch, then they are read by GPUDirect SQL with no buffer lookup
+	 * per block. The per-block path below is only for the dirty or resident
+	 * blocks.
+	 */
+	if (pgstrom_nvme_bulk_cold_scan)
+	{
+		cl_uint		i;
+
+		if (nvme_sstate->cold_base == InvalidBlockNumber ||
+			blknum <  nvme_sstate->cold_base ||
+			blknum >= nvme_sstate->cold_base + nvme_sstate->cold_nblocks)
+			nvmeProbeColdBlocks(gts, blknum);
+		i = blknum - nvme_sstate->cold_base;
+		if ((nvme_sstate->cold_map[i / BITS_PER_BYTE] &
+			 (1 << (i % BITS_PER_BYTE))) != 0)
+			return __PDS_exec_heapscan_cold_block(nvme_sstate, pds,
+												  bstate, blknum);
+	}
 	/*
 	 * NVMe-Strom can be applied only when filesystem supports the feature,
-	 * and the current source block is all-visible.
+	 * and the current source block is all-visible, or GPU kernel checks
+	 * visibility of the tuples by the MVCC snapshot.
 	 * Elsewhere, we will go fallback with synchronized buffer scan.
 	 */
-	if (RelationCanUseNvmeStrom(relation) &&
-		VM_ALL_VISIBLE(relation, blknum,
-					   &nvme_sstate->curr_vmbuffer))
+	else if (RelationCanUseNvmeStrom(relation) &&
+			 (nvme_sstate->mvcc_snapshot != NULL ||
+			  VM_ALL_VISIBLE(relation, blknum,
+							 &nvme_sstate->curr_vmbuffer)))
 	{
 		BufferTag	newTag;
 		uint32		newHash;
@@ -1374,27 +2356,8 @@ PDS_exec_heapscan_block(GpuTaskState *gts,
 		buf_id = BufTableLookup(&newTag, newHash);
 		if (buf_id < 0)
 		{
-			BlockNumber	segno = blknum / RELSEG_SIZE;
-			GPUDirectFileDesc *dfile;
-
-			Assert(segno < nvme_sstate->nr_segs);
-			/*
-			 * We cannot mix up multiple source files in a single PDS chunk.
-			 * If heapscan_block comes across segment boundary, rest of the
-			 * blocks must be read on the next PDS chunk.
-			 */
-			dfile = &nvme_sstate->files[segno];
-			if (pds->filedesc.rawfd >= 0 &&
-				pds->filedesc.rawfd != dfile->rawfd)
-				retval = false;
-			else
-			{
-				if (pds->filedesc.rawfd < 0)
-					memcpy(&pds->filedesc, dfile, sizeof(GPUDirectFileDesc));
-				updatePDSHeapScanBlockState(pds, bstate, blknum);
-				pds->kds.nitems++;
-				retval = true;
-			}
+			retval = __PDS_exec_heapscan_cold_block(nvme_sstate, pds,
+													bstate, blknum);
 			LWLockRelease(newPartitionLock);
 			return retval;
 		}
@@ -1587,6 +2550,46 @@ heapscan_report_location(HeapScanDesc hscan)
 #endif
 }
 
+/*
+ * heapscan_prefetch_blocks
+ *
+ * It issues asynchronous read-ahead of the heap blocks in front of the
+ * current block, for the synchronous buffer reads without GPUDirect SQL.
+ * PrefetchBuffer() skips the blocks already on the shared buffers, so only
+ * the blocks to be read from the storage are requested. The prefetch is
+ * refilled when less than half of the distance is left, to avoid a system
+ * call per block. @nblocks_left is the number of blocks to be scanned by
+ * this process after the current block.
+ */
+static void
+heapscan_prefetch_blocks(GpuTaskState *gts,
+						 HeapScanDesc hscan,
+						 BlockNumber nblocks_left)
+{
+#ifdef USE_PREFETCH
+	Relation	relation = gts->css.ss.ss_currentRelation;
+	cl_uint		distance;
+	BlockNumber	blknum;
+
+	if (gts->outer_prefetch_ahead > 0)
+		gts->outer_prefetch_ahead--;
+	if (pgstrom_heapscan_prefetch_chunks <= 0)
+		return;
+	distance = Min((cl_ulong)pgstrom_heapscan_prefetch_chunks *
+				   (pgstrom_chunk_size() / BLCKSZ), hscan->rs_nblocks);
+	distance = Min(distance, nblocks_left);
+	if (gts->outer_prefetch_ahead >= distance / 2)
+		return;
+	while (gts->outer_prefetch_ahead < distance)
+	{
+		blknum = (hscan->rs_cblock + 1 +
+				  gts->outer_prefetch_ahead) % hscan->rs_nblocks;
+		PrefetchBuffer(relation, MAIN_FORKNUM, blknum);
+		gts->outer_prefetch_ahead++;
+	}
+#endif
+}
+
 /*
  * pgstromExecHeapScanChunkParallel - read the heap relation by parallel scan
  */
@@ -1627,6 +2630,7 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 		if (hscan->rs_numblocks == 0)
 		{
 			NVMEScanState *nvme_sstate = gts->nvme_sstate;
+			BlockNumber	stripe_sz = gtss->pbs_stripe_nblocks;
 			BlockNumber	sync_startpage = InvalidBlockNumber;
 			cl_long		nr_allocated;
 			cl_long		startblock;
@@ -1646,8 +2650,13 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 			 * i/o stack will be able to load storage blocks with minimum
 			 * number of DMA requests.
 			 */
+			/*
+			 * On md-raid0 volume, the blocks are assigned by the unit of the
+			 * stripe width, to spread the reads of a worker across all the
+			 * member drives.
+			 */
 			if (!nvme_sstate)
-				nr_blocks = 8;
+				nr_blocks = (stripe_sz > 0 ? stripe_sz : 8);
 			else if (pds)
 			{
 				if (pds->kds.nitems >= pds->kds.nrooms)
@@ -1655,7 +2664,11 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 				nr_blocks = pds->kds.nrooms - pds->kds.nitems;
 			}
 			else
+			{
 				nr_blocks = nvme_sstate->nblocks_per_chunk;
+				if (stripe_sz > 0 && nr_blocks > stripe_sz)
+					nr_blocks -= (nr_blocks % stripe_sz);
+			}
 
 		retry_lock:
 			SpinLockAcquire(&gtss->pbs_mutex);
@@ -1677,7 +2690,12 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 				if (!ptscan->phs_syncscan)
 					gtss->pbs_startblock = 0;
 				else if (sync_startpage != InvalidBlockNumber)
+				{
+					/* start from the stripe boundary */
+					if (stripe_sz > 0)
+						sync_startpage -= (sync_startpage % stripe_sz);
 					gtss->pbs_startblock = sync_startpage;
+				}
 				else
 				{
 					SpinLockRelease(&gtss->pbs_mutex);
@@ -1764,17 +2782,25 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 
 			hscan->rs_cblock = page;
 			hscan->rs_numblocks = nr_blocks;
+			gts->outer_prefetch_ahead = 0;
 			continue;
 		}
+		/* skip the block, if zone-map says no rows can match */
+		if (gts->outer_zmap_state &&
+			pgstromZoneMapCanSkip(gts, hscan, hscan->rs_cblock))
+		{
+			gts->outer_zmap_count++;
+			if (gts->outer_prefetch_ahead > 0)
+				gts->outer_prefetch_ahead--;
+			goto next;
+		}
 		/* scan next block */
 		if (gts->nvme_sstate)
 		{
 			/* KDS_FORMAT_BLOCK */
 			if (!pds)
 			{
-				pds = PDS_create_block(gts->gcontext,
-									   RelationGetDescr(relation),
-									   gts->nvme_sstate);
+				pds = PDS_create_chunk(gts, RelationGetDescr(relation));
 				pds->kds.table_oid = RelationGetRelid(relation);
 				initPDSHeapScanBlockState(pds, bstate);
 			}
@@ -1786,14 +2812,14 @@ pgstromExecHeapScanChunkParallel(GpuTaskState *gts,
 			/* KDS_FORMAT_ROW */
 			if (!pds)
 			{
-				pds = PDS_create_row(gts->gcontext,
-									 RelationGetDescr(relation),
-									 pgstrom_chunk_size());
+				pds = PDS_create_chunk(gts, RelationGetDescr(relation));
 				pds->kds.table_oid = RelationGetRelid(relation);
 			}
+			heapscan_prefetch_blocks(gts, hscan, hscan->rs_numblocks - 1);
 			if (!PDS_exec_heapscan_row(gts, pds))
 				break;
 		}
+	next:
 		/* move to the next block */
 		hscan->rs_numblocks--;
 		hscan->rs_cblock++;
@@ -1864,17 +2890,26 @@ pgstromExecHeapScanChunk(GpuTaskState *gts,
 				else
 					hscan->rs_cblock = 0;
 				gts->outer_brin_count += (page - prev);
+				gts->outer_prefetch_ahead = 0;
 				goto skip;
 			}
 		}
+		/* also skip the block, if zone-map says no rows can match */
+		if (gts->outer_zmap_state &&
+			pgstromZoneMapCanSkip(gts, hscan, page))
+		{
+			gts->outer_zmap_count++;
+			if (gts->outer_prefetch_ahead > 0)
+				gts->outer_prefetch_ahead--;
+			hscan->rs_cblock++;
+			goto skip;
+		}
 		/* scan the next block */
 		if (gts->nvme_sstate)
 		{
 			if (!pds)
 			{
-				pds =  PDS_create_block(gts->gcontext,
-										RelationGetDescr(rel),
-										gts->nvme_sstate);
+				pds = PDS_create_chunk(gts, RelationGetDescr(rel));
 				pds->kds.table_oid = RelationGetRelid(rel);
 				initPDSHeapScanBlockState(pds, bstate);
 			}
@@ -1885,11 +2920,13 @@ pgstromExecHeapScanChunk(GpuTaskState *gts,
 		{
 			if (!pds)
 			{
-				pds = PDS_create_row(gts->gcontext,
-									 RelationGetDescr(rel),
-									 pgstrom_chunk_size());
+				pds = PDS_create_chunk(gts, RelationGetDescr(rel));
 				pds->kds.table_oid = RelationGetRelid(rel);
 			}
+			heapscan_prefetch_blocks(gts, hscan,
+									 (hscan->rs_startblock +
+									  hscan->rs_nblocks -
+									  hscan->rs_cblock - 1) % hscan->rs_nblocks);
 			if (!PDS_exec_heapscan_row(gts, pds))
 				break;
 		}
@@ -2014,6 +3051,8 @@ pgstromRewindScanChunk(GpuTaskState *gts)
 	TableScanDesc		tscan = gts->css.ss.ss_currentScanDesc;
 
 	InstrEndLoop(&gts->outer_instrument);
+	gts->outer_prefetch_ahead = 0;
+	pgstromExecRewindZoneMap(gts);
 	if (tscan)
 	{
 		table_rescan(tscan, NULL);
@@ -2188,6 +3227,8 @@ pgstromExplainOuterScan(GpuTaskState *gts,
 	}
 	/* properties of BRIN-index */
 	pgstromExplainBrinIndexMap(gts, es, deparse_context);
+	/* properties of zone-map */
+	pgstromExplainZoneMap(gts, es);
 }
 
 /*
@@ -2209,6 +3250,86 @@ pgstrom_init_relscan(void)
 							 PGC_USERSET,
                              GUC_NOT_IN_SAMPLE,
                              NULL, NULL, NULL);
+	/* pg_strom.nvme_bulk_cold_scan */
+	DefineCustomBoolVariable("pg_strom.nvme_bulk_cold_scan",
+							 "Enables batched probe of cold blocks for GPUDirect SQL",
+							 NULL,
+							 &pgstrom_nvme_bulk_cold_scan,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpu_mvcc_visibility */
+	DefineCustomBoolVariable("pg_strom.gpu_mvcc_visibility",
+							 "Enables GPU kernel to check visibility of the tuples on non-all-visible blocks",
+							 NULL,
+							 &pgstrom_gpu_mvcc_visibility,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.gpu_mvcc_max_xids */
+	DefineCustomIntVariable("pg_strom.gpu_mvcc_max_xids",
+							"Max number of transactions in the commit-status snapshot for GPU",
+							NULL,
+							&pgstrom_gpu_mvcc_max_xids,
+							1000000,
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	/* pg_strom.heapscan_prefetch_chunks */
+	DefineCustomIntVariable("pg_strom.heapscan_prefetch_chunks",
+							"Number of chunks to be prefetched ahead on heap scan without GPUDirect SQL",
+							NULL,
+							&pgstrom_heapscan_prefetch_chunks,
+							2,
+							0,
+							64,
+							PGC_USERSET,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	/* pg_strom.nvme_stripe_aware */
+	DefineCustomBoolVariable("pg_strom.nvme_stripe_aware",
+							 "Enables stripe-aware block assignment on parallel scan over md-raid0 volume",
+							 NULL,
+							 &pgstrom_nvme_stripe_aware,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.enable_zonemap */
+	DefineCustomBoolVariable("pg_strom.enable_zonemap",
+							 "Enables to skip heap blocks by the zone-map gathered by GpuScan",
+							 NULL,
+							 &pgstrom_enable_zonemap,
+							 true,
+							 PGC_USERSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	/* pg_strom.zonemap_nslots */
+	DefineCustomIntVariable("pg_strom.zonemap_nslots",
+							"Number of the hash slots of the zone-map on the shared memory",
+							NULL,
+							&pgstrom_zonemap_nslots,
+							16384,
+							0,
+							INT_MAX / sizeof(pgstromZoneMapSlot),
+							PGC_POSTMASTER,
+							GUC_NOT_IN_SAMPLE,
+							NULL, NULL, NULL);
+	/* a zone never crosses the boundary of visibility-map pages */
+	StaticAssertStmt(((BLCKSZ - MAXALIGN(SizeOfPageHeaderData)) * 4) %
+					 PGSTROM_ZONEMAP_NBLOCKS == 0,
+					 "PGSTROM_ZONEMAP_NBLOCKS must divide heap blocks per VM page");
+	if (pgstrom_zonemap_nslots > 0)
+	{
+		RequestAddinShmemSpace(MAXALIGN(sizeof(pgstromZoneMapSlot) *
+										pgstrom_zonemap_nslots));
+		shmem_startup_next = shmem_startup_hook;
+		shmem_startup_hook = pgstrom_startup_relscan;
+	}
 	/*
 	 * pg_strom.nvme_distance_map
 	 *
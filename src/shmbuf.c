@@ -11,6 +11,9 @@
  */
 #include "pg_strom.h"
 #include "nodes/memnodes.h"
+#include <mntent.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 
 #define SHMBUF_CHUNK_MAGIC_CODE		0xdeadbeaf
 #define SHMBUF_CHUNKSZ_MIN_BIT		7		/* 128B */
@@ -79,6 +82,28 @@ typedef struct
 	char			namebuf[FLEXIBLE_ARRAY_MEMBER];
 } shmBufferContext;
 
+/* huge page backing of the segments */
+#define SHMBUF_HUGE_PAGES__OFF		0		/* in MB */
+#define SHMBUF_HUGE_PAGES__2MB		2
+#define SHMBUF_HUGE_PAGES__1GB		1024
+
+static const struct config_enum_entry shmbuf_huge_pages_options[] = {
+	{"off",	SHMBUF_HUGE_PAGES__OFF, false},
+	{"2MB",	SHMBUF_HUGE_PAGES__2MB, false},
+	{"1GB",	SHMBUF_HUGE_PAGES__1GB, false},
+	{NULL, 0, false},
+};
+
+/* NUMA policy of the segments */
+#define SHMBUF_NUMA_POLICY__LOCAL		0
+#define SHMBUF_NUMA_POLICY__INTERLEAVE	1
+
+static const struct config_enum_entry shmbuf_numa_policy_options[] = {
+	{"local",		SHMBUF_NUMA_POLICY__LOCAL, false},
+	{"interleave",	SHMBUF_NUMA_POLICY__INTERLEAVE, false},
+	{NULL, 0, false},
+};
+
 /* -------- static variables -------- */
 static shmem_startup_hook_type shmem_startup_next = NULL;
 static struct sigaction sigaction_orig_sigsegv;
@@ -86,6 +111,10 @@ static struct sigaction sigaction_orig_sigbus;
 static size_t	shmbuf_segment_size;
 static int		shmbuf_segment_size_kb;		/* GUC */
 static int		shmbuf_num_logical_segment;	/* GUC */
+static int		shmbuf_huge_pages_mb;		/* GUC */
+static int		shmbuf_numa_policy;			/* GUC */
+static bool		shmbuf_eager_attach;		/* GUC */
+static char	   *shmbuf_hugetlbfs_dir = NULL;	/* mount point of hugetlbfs */
 static shmBufferSegmentHead *shmBufSegHead = NULL;	/* shared memory */
 static shmBufferLocalMap *shmBufLocalMaps = NULL;
 static char	   *shmbuf_segment_vaddr_head = NULL;
@@ -129,6 +158,76 @@ shmBufferSegmentFromChunk(shmBufferChunk *chunk)
 	snprintf((namebuf),NAMEDATALEN,"/.pg_shmbuf_%u.%u:%u",	\
 			 PostPortNumber,(segment_id),(revision)>>1)
 
+/*
+ * shmBufferOpenFile / shmBufferUnlinkFile
+ *
+ * The segment files are created on the POSIX shared memory (/dev/shm), or
+ * on the hugetlbfs if shmbuf.huge_pages is configured. Note that these are
+ * also called in the signal handler, so never use elog() here.
+ */
+static int
+shmBufferOpenFile(const char *namebuf, int flags)
+{
+	char		path[MAXPGPATH];
+
+	if (!shmbuf_hugetlbfs_dir)
+		return shm_open(namebuf, flags, 0600);
+	snprintf(path, sizeof(path), "%s%s", shmbuf_hugetlbfs_dir, namebuf);
+	return open(path, flags, 0600);
+}
+
+static int
+shmBufferUnlinkFile(const char *namebuf)
+{
+	char		path[MAXPGPATH];
+
+	if (!shmbuf_hugetlbfs_dir)
+		return shm_unlink(namebuf);
+	snprintf(path, sizeof(path), "%s%s", shmbuf_hugetlbfs_dir, namebuf);
+	return unlink(path);
+}
+
+/*
+ * shmBufferFallocate
+ *
+ * It assigns physical pages of the segment according to shmbuf.numa_policy.
+ * Because the pages are allocated at the fallocate(2) time, the memory
+ * policy of the caller process is switched during the allocation.
+ */
+static int
+shmBufferFallocate(int fdesc)
+{
+	unsigned long nodemask[NUMA_NODEMASK_WORDS];
+	bool		policy_changed = false;
+	int			rv;
+
+	if (shmbuf_numa_policy == SHMBUF_NUMA_POLICY__INTERLEAVE)
+	{
+		/* nodes not available are ignored by the kernel */
+		memset(nodemask, 0xff, sizeof(nodemask));
+		if (syscall(SYS_set_mempolicy,
+					MPOL_INTERLEAVE,
+					nodemask,
+					NUMA_MAX_NODES) == 0)
+			policy_changed = true;
+		else
+			elog(DEBUG1, "failed on set_mempolicy(MPOL_INTERLEAVE): %m");
+	}
+	while ((rv = fallocate(fdesc, 0, 0, shmbuf_segment_size)) != 0)
+	{
+		if (errno != EINTR)
+			break;
+	}
+	if (policy_changed)
+	{
+		int		errno_saved = errno;
+
+		syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0);
+		errno = errno_saved;
+	}
+	return rv;
+}
+
 /*
  * shmBufferAttachSegmentOnDemand
  *
@@ -213,7 +312,7 @@ shmBufferAttachSegmentOnDemand(int signum, siginfo_t *siginfo, void *unused)
 		 * Open an "existing" shared memory segment
 		 */
 		SHMBUF_SEGMENT_FILENAME(namebuf, segment_id, revision);
-		fdesc = shm_open(namebuf, O_RDWR, 0600);
+		fdesc = shmBufferOpenFile(namebuf, O_RDWR);
 		if (fdesc < 0)
 		{
 			SpinLockRelease(&lmap->mutex);
@@ -231,7 +330,7 @@ shmBufferAttachSegmentOnDemand(int signum, siginfo_t *siginfo, void *unused)
 				 fdesc, 0) != mmap_ptr)
 		{
 			close(fdesc);
-			shm_unlink(namebuf);
+			shmBufferUnlinkFile(namebuf);
 			SpinLockRelease(&lmap->mutex);
 			fprintf(stderr, "pid=%u: %s on %p (seg_id=%u,rev=%u) - "
 					"failed on mmap('%s'): %m",
@@ -338,16 +437,24 @@ shmBufferCreateSegment(void)
 	/*
 	 * Create a new shared memory segment
 	 */
-	fdesc = shm_open(namebuf, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	fdesc = shmBufferOpenFile(namebuf, O_RDWR | O_CREAT | O_TRUNC);
 	if (fdesc < 0)
 		elog(ERROR, "failed on shm_open('%s'): %m", namebuf);
 
-	while (fallocate(fdesc, 0, 0, shmbuf_segment_size) != 0)
+	if (shmBufferFallocate(fdesc) != 0)
 	{
-		if (errno == EINTR)
-			continue;
+		int		errno_saved = errno;
+
 		close(fdesc);
-		shm_unlink(namebuf);
+		shmBufferUnlinkFile(namebuf);
+		errno = errno_saved;
+		if (shmbuf_hugetlbfs_dir)
+			ereport(ERROR,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("failed on fallocate('%s%s'): %m",
+							shmbuf_hugetlbfs_dir, namebuf),
+					 errhint("check vm.nr_hugepages of %s pages",
+							 shmbuf_huge_pages_mb == SHMBUF_HUGE_PAGES__1GB ? "1GB" : "2MB")));
 		elog(ERROR, "failed on fallocate('%s'): %m", namebuf);
 	}
 
@@ -357,7 +464,7 @@ shmBufferCreateSegment(void)
 			 fdesc, 0) != mmap_ptr)
 	{
 		close(fdesc);
-		shm_unlink(namebuf);
+		shmBufferUnlinkFile(namebuf);
 		elog(ERROR, "failed on mmap('%s'): %m", namebuf);
 	}
 	close(fdesc);
@@ -439,15 +546,74 @@ shmBufferDropSegment(shmBufferSegment *seg)
 	 * exception, and signal handler unmap the segment at other processes also.
 	 */
 	SHMBUF_SEGMENT_FILENAME(namebuf, segment_id, revision);
-	fdesc = shm_open(namebuf, O_RDWR | O_TRUNC, 0600);
+	fdesc = shmBufferOpenFile(namebuf, O_RDWR | O_TRUNC);
 	if (fdesc < 0)
 		elog(FATAL, "failed on shm_opem('%s') with O_TRUNC: %m", namebuf);
 	close(fdesc);
 
-	if (shm_unlink(namebuf) < 0)
+	if (shmBufferUnlinkFile(namebuf) < 0)
 		elog(FATAL, "failed on shm_unlink('%s'): %m", namebuf);
 }
 
+/*
+ * shmbufAttachAllSegments
+ *
+ * It maps all the existing segments on the private address space at once,
+ * with pre-faulting of the pages, if shmbuf.eager_attach is enabled. It is
+ * called at the beginning of worker processes, to avoid the SIGSEGV and
+ * page-faults on the first references to the segments.
+ * Segments created later are attached on demand, as usual.
+ */
+void
+shmbufAttachAllSegments(void)
+{
+	uint32		i;
+
+	if (!shmbuf_eager_attach || !shmBufSegHead)
+		return;
+
+	for (i=0; i < shmbuf_num_logical_segment; i++)
+	{
+		shmBufferSegment *seg = &shmBufSegHead->segments[i];
+		shmBufferLocalMap *lmap = &shmBufLocalMaps[i];
+		char	   *mmap_ptr = shmBufferSegmentMmapPtr(seg);
+		uint32		revision = pg_atomic_read_u32(&seg->revision);
+		char		namebuf[NAMEDATALEN];
+		int			fdesc;
+
+		if (!SHMBUF_SEGMENT_EXISTS(revision))
+			continue;
+
+		SpinLockAcquire(&lmap->mutex);
+		if (lmap->is_attached && lmap->revision == revision)
+		{
+			SpinLockRelease(&lmap->mutex);
+			continue;
+		}
+		SHMBUF_SEGMENT_FILENAME(namebuf, i, revision);
+		fdesc = shmBufferOpenFile(namebuf, O_RDWR);
+		if (fdesc < 0)
+		{
+			/* concurrently dropped? */
+			SpinLockRelease(&lmap->mutex);
+			continue;
+		}
+		if (mmap(mmap_ptr, shmbuf_segment_size,
+				 PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_FIXED | MAP_POPULATE,
+				 fdesc, 0) != mmap_ptr)
+		{
+			close(fdesc);
+			SpinLockRelease(&lmap->mutex);
+			elog(FATAL, "failed on mmap('%s'): %m", namebuf);
+		}
+		close(fdesc);
+		lmap->is_attached = true;
+		lmap->revision = revision;
+		SpinLockRelease(&lmap->mutex);
+	}
+}
+
 /*
  * shmBufferSplitChunk
  *
@@ -643,9 +809,12 @@ shmBufferCleanupOnPostmasterExit(int code, Datum arg)
 {
 	if (MyProcPid == PostmasterPid)
 	{
-		DIR			   *dir = opendir("/dev/shm");
+		DIR			   *dir = opendir(shmbuf_hugetlbfs_dir
+									  ? shmbuf_hugetlbfs_dir
+									  : "/dev/shm");
 		struct dirent  *dentry;
 		char			namebuf[NAMEDATALEN];
+		char			pathbuf[NAMEDATALEN + 1];
 		size_t			namelen;
 
 		namelen = snprintf(namebuf, sizeof(namebuf),
@@ -658,7 +827,8 @@ shmBufferCleanupOnPostmasterExit(int code, Datum arg)
 				continue;
 			if (strncmp(dentry->d_name, namebuf, namelen) == 0)
 			{
-				if (shm_unlink(dentry->d_name) != 0)
+				snprintf(pathbuf, sizeof(pathbuf), "/%s", dentry->d_name);
+				if (shmBufferUnlinkFile(pathbuf) != 0)
 					elog(LOG, "failed on shm_unlink('%s'): %m",
 						 dentry->d_name);
 				else
@@ -1445,6 +1615,74 @@ pgstrom_startup_shmbuf(void)
 		(*shmem_startup_next)();
 }
 
+/*
+ * lookup_hugetlbfs_mount - lookup the mount point of hugetlbfs with
+ * the supplied page size
+ */
+static char *
+lookup_hugetlbfs_mount(size_t page_sz)
+{
+	FILE	   *filp;
+	char		linebuf[2048];
+	size_t		default_sz = 0;
+	char	   *result = NULL;
+
+	/* default page size of hugetlbfs */
+	filp = fopen("/proc/meminfo", "r");
+	if (filp)
+	{
+		while (fgets(linebuf, sizeof(linebuf), filp) != NULL)
+		{
+			unsigned long	kb;
+
+			if (sscanf(linebuf, "Hugepagesize: %lu kB", &kb) == 1)
+			{
+				default_sz = (size_t)kb << 10;
+				break;
+			}
+		}
+		fclose(filp);
+	}
+
+	filp = setmntent("/proc/mounts", "r");
+	if (!filp)
+		elog(ERROR, "failed on setmntent('/proc/mounts'): %m");
+	for (;;)
+	{
+		struct mntent *mnt = getmntent(filp);
+		char	   *opt;
+		size_t		sz = default_sz;
+
+		if (!mnt)
+			break;
+		if (strcmp(mnt->mnt_type, "hugetlbfs") != 0)
+			continue;
+		opt = hasmntopt(mnt, "pagesize");
+		if (opt)
+		{
+			char   *end;
+
+			sz = strtoul(opt + 9, &end, 10);
+			if (*end == 'K' || *end == 'k')
+				sz <<= 10;
+			else if (*end == 'M' || *end == 'm')
+				sz <<= 20;
+			else if (*end == 'G' || *end == 'g')
+				sz <<= 30;
+		}
+		if (sz == page_sz)
+		{
+			result = strdup(mnt->mnt_dir);
+			if (!result)
+				elog(ERROR, "out of memory");
+			break;
+		}
+	}
+	endmntent(filp);
+
+	return result;
+}
+
 /*
  * pgstrom_init_shmbuf
  */
@@ -1485,14 +1723,64 @@ pgstrom_init_shmbuf(void)
 							PGC_POSTMASTER,
 							GUC_NOT_IN_SAMPLE,
 							NULL, NULL, NULL);
-	/* preserver private address space but no physical memory assignment */
+
+	DefineCustomEnumVariable("shmbuf.huge_pages",
+							 "Page size of the hugetlbfs to back the shared memory segment",
+							 NULL,
+							 &shmbuf_huge_pages_mb,
+							 SHMBUF_HUGE_PAGES__OFF,
+							 shmbuf_huge_pages_options,
+							 PGC_POSTMASTER,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	DefineCustomEnumVariable("shmbuf.numa_policy",
+							 "NUMA policy of the shared memory segment",
+							 NULL,
+							 &shmbuf_numa_policy,
+							 SHMBUF_NUMA_POLICY__LOCAL,
+							 shmbuf_numa_policy_options,
+							 PGC_SUSET,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	DefineCustomBoolVariable("shmbuf.eager_attach",
+							 "Attach all the shared memory segments on startup of worker processes",
+							 NULL,
+							 &shmbuf_eager_attach,
+							 false,
+							 PGC_SIGHUP,
+							 GUC_NOT_IN_SAMPLE,
+							 NULL, NULL, NULL);
+	if (shmbuf_huge_pages_mb != SHMBUF_HUGE_PAGES__OFF)
+	{
+		size_t	page_sz = ((size_t)shmbuf_huge_pages_mb) << 20;
+
+		if (shmbuf_segment_size % page_sz != 0)
+			elog(ERROR, "shmbuf.segment_size (%dkB) must be multiple of the huge page size (%zukB)",
+				 shmbuf_segment_size_kb, page_sz >> 10);
+		shmbuf_hugetlbfs_dir = lookup_hugetlbfs_mount(page_sz);
+		if (!shmbuf_hugetlbfs_dir)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("no hugetlbfs is mounted with pagesize=%zuMB",
+							page_sz >> 20),
+					 errhint("mount hugetlbfs with pagesize option, or set shmbuf.huge_pages = off")));
+		elog(LOG, "shmbuf: shared memory segments are backed by %zuMB huge pages on '%s'",
+			 page_sz >> 20, shmbuf_hugetlbfs_dir);
+	}
+
+	/*
+	 * preserver private address space but no physical memory assignment;
+	 * it has to be aligned to the segment size for huge pages.
+	 */
 	length = shmbuf_segment_size * shmbuf_num_logical_segment;
-	shmbuf_segment_vaddr_head = mmap(NULL, length,
+	shmbuf_segment_vaddr_head = mmap(NULL, length + shmbuf_segment_size,
 									 PROT_NONE,
 									 MAP_PRIVATE | MAP_ANONYMOUS,
 									 -1, 0);
 	if (shmbuf_segment_vaddr_head == MAP_FAILED)
 		elog(ERROR, "failed on mmap(2): %m");
+	shmbuf_segment_vaddr_head = (char *)
+		TYPEALIGN(shmbuf_segment_size, shmbuf_segment_vaddr_head);
 	shmbuf_segment_vaddr_tail = shmbuf_segment_vaddr_head + length;
 
 	/* allocation of static shared memory */
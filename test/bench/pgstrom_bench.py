@@ -0,0 +1,397 @@
+#!/usr/bin/env python3
+#
+# pgstrom_bench.py - benchmark harness of SSBM / TPC-H for PG-Strom
+#
+# It sets up the benchmark database with heap, Arrow_Fdw and GPU Cache
+# variants, runs the queries in CPU-only and GPU modes with warm and cold
+# caches, then writes out the latencies and the EXPLAIN stage breakdown
+# as a JSON file. The 'compare' command flags the regressions between two
+# results; usually, the one of the previous commit and the current one.
+#
+# Only the python3 standard library and psql are required.
+#
+# Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+# Copyright 2014-2021 (C) PG-Strom Developers Team
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the PostgreSQL License.
+#
+import argparse
+import datetime
+import json
+import os
+import re
+import statistics
+import subprocess
+import sys
+
+STROM_BUILD_ROOT = os.path.abspath(
+    os.path.join(os.path.dirname(__file__), '..', '..'))
+
+#
+# Definition of the benchmark suites
+#
+# 'tables' is a list of (table name, table code of dbgen), and 'fact' is
+# the table to be replaced by Arrow_Fdw or GPU Cache variant. The dimension
+# tables are always referenced from the heap schema.
+#
+SUITES = {
+    'ssbm': {
+        'dbgen': 'dbgen-ssbm',
+        'ddl': os.path.join(STROM_BUILD_ROOT, 'test/ssbm/ssbm-ddl.sql'),
+        'tables': [('customer', 'c'), ('date1', 'd'), ('part', 'p'),
+                   ('supplier', 's'), ('lineorder', 'l')],
+        'fact': 'lineorder',
+    },
+    'tpch': {
+        'dbgen': 'dbgen-tpch',
+        'ddl': os.path.join(STROM_BUILD_ROOT, 'deadcode/dbt3-sql/dbt3-ddl.sql'),
+        'tables': [('nation', 'n'), ('region', 'r'), ('supplier', 's'),
+                   ('part', 'P'), ('partsupp', 'S'), ('customer', 'c'),
+                   ('orders', 'O'), ('lineitem', 'L')],
+        'fact': 'lineitem',
+    },
+}
+VARIANTS = ('heap', 'arrow', 'gpucache')
+MODES = ('cpu', 'gpu')
+CACHES = ('warm', 'cold')
+
+# substitution parameters of the TPC-H queries (validation values by spec)
+TPCH_PARAMS = {
+    1: {'1': '90'},
+    20: {'3': 'CANADA'},
+}
+
+def error(msg):
+    print('pgstrom_bench: ' + msg, file=sys.stderr)
+    sys.exit(2)
+
+def psql(args, script, extra_env=None, check=True):
+    env = dict(os.environ)
+    if extra_env:
+        env.update(extra_env)
+    cmd = ['psql', '-X', '-q', '-v', 'ON_ERROR_STOP=1', '-d', args.dbname]
+    proc = subprocess.run(cmd, input=script, env=env,
+                          stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                          universal_newlines=True)
+    if check and proc.returncode != 0:
+        error('psql failed:\n' + proc.stderr)
+    return proc
+
+def schema_name(suite, variant):
+    return '%s_%s' % (suite, variant)
+
+def search_path(suite, variant):
+    if variant == 'heap':
+        return schema_name(suite, 'heap')
+    return '%s,%s' % (schema_name(suite, variant), schema_name(suite, 'heap'))
+
+#
+# Query sets
+#
+def split_statements(sql):
+    """split a SQL script into statements; comments and psql meta-commands
+    are removed. It does not care about semicolons in the literals."""
+    lines = []
+    for line in sql.splitlines():
+        if line.startswith('\\'):
+            continue
+        line = re.sub(r'--.*$', '', line)
+        lines.append(line)
+    return [s.strip() for s in '\n'.join(lines).split(';') if s.strip()]
+
+def load_queries(suite):
+    """returns a list of (name, setup statements, query, teardown statements)"""
+    queries = []
+    if suite == 'ssbm':
+        fname = os.path.join(STROM_BUILD_ROOT, 'test/ssbm/ssbm-all-strom.sql')
+        with open(fname) as f:
+            blocks = re.split(r'^--(Q\d+_\d+)\s*$', f.read(), flags=re.M)
+        # blocks = [header, name, body, name, body, ...]
+        for name, body in zip(blocks[1::2], blocks[2::2]):
+            stmts = [s for s in split_statements(body)
+                     if not s.lower().startswith('explain')]
+            queries.append((name, [], stmts[-1], []))
+    elif suite == 'tpch':
+        for i in range(1, 23):
+            fname = os.path.join(STROM_BUILD_ROOT,
+                                 'deadcode/dbt3-sql/dbt3-%02d.sql' % i)
+            with open(fname) as f:
+                sql = f.read()
+            for k, v in TPCH_PARAMS.get(i, {}).items():
+                sql = sql.replace(':' + k, v)
+            # some query files are EXPLAIN only; run the query itself
+            stmts = [re.sub(r'^explain\s+', '', x, flags=re.I)
+                     for x in split_statements(sql)]
+            main = max(j for j, s in enumerate(stmts)
+                       if s.lower().startswith('select'))
+            queries.append(('Q%d' % i, stmts[:main], stmts[main],
+                            stmts[main+1:]))
+    return queries
+
+#
+# setup command
+#
+def cmd_setup(args):
+    suite = SUITES[args.suite]
+    heap = schema_name(args.suite, 'heap')
+    with open(suite['ddl']) as f:
+        ddl = f.read()
+
+    # heap tables
+    script = ('DROP SCHEMA IF EXISTS %s CASCADE;\n'
+              'CREATE SCHEMA %s;\n'
+              'SET search_path = %s;\n' % (heap, heap, heap))
+    script += ddl + '\n'
+    for tname, tcode in suite['tables']:
+        script += ("\\copy %s FROM PROGRAM '%s -q -s%d -X -T%s' "
+                   "DELIMITER '|'\n" % (tname, suite['dbgen'],
+                                        args.scale, tcode))
+    script += 'VACUUM ANALYZE;\n'
+    print('loading %s (scale=%d) into %s ...' % (args.suite, args.scale, heap))
+    psql(args, script)
+
+    fact = suite['fact']
+    if 'arrow' in args.variants:
+        schema = schema_name(args.suite, 'arrow')
+        fname = os.path.join(os.path.abspath(args.arrow_dir),
+                             '%s_%s.arrow' % (args.suite, fact))
+        print('writing %s ...' % fname)
+        proc = subprocess.run(['pg2arrow', '-d', args.dbname,
+                               '-c', 'SELECT * FROM %s.%s' % (heap, fact),
+                               '-o', fname])
+        if proc.returncode != 0:
+            error('pg2arrow failed')
+        psql(args, ('DROP SCHEMA IF EXISTS %s CASCADE;\n'
+                    'CREATE SCHEMA %s;\n'
+                    'IMPORT FOREIGN SCHEMA %s FROM SERVER arrow_fdw\n'
+                    '  INTO %s OPTIONS (file \'%s\');\n'
+                    'ANALYZE %s.%s;\n' % (schema, schema, fact,
+                                          schema, fname, schema, fact)))
+    if 'gpucache' in args.variants:
+        schema = schema_name(args.suite, 'gpucache')
+        proc = psql(args, 'SELECT count(*) FROM %s.%s' % (heap, fact))
+        nrows = int(re.findall(r'\d+', proc.stdout)[-1])
+        options = 'max_num_rows=%d' % int(nrows * 1.25 + 10000)
+        psql(args, ('DROP SCHEMA IF EXISTS %s CASCADE;\n'
+                    'CREATE SCHEMA %s;\n'
+                    'CREATE TABLE %s.%s AS SELECT * FROM %s.%s;\n'
+                    'CREATE TRIGGER %s_gpucache AFTER INSERT OR UPDATE OR DELETE\n'
+                    '  ON %s.%s FOR ROW\n'
+                    '  EXECUTE FUNCTION pgstrom.gpucache_sync_trigger(\'%s\');\n'
+                    'ALTER TABLE %s.%s ENABLE ALWAYS TRIGGER %s_gpucache;\n'
+                    'CREATE TRIGGER %s_gpucache_trunc BEFORE TRUNCATE\n'
+                    '  ON %s.%s FOR STATEMENT\n'
+                    '  EXECUTE FUNCTION pgstrom.gpucache_sync_trigger();\n'
+                    'VACUUM ANALYZE %s.%s;\n' %
+                    (schema, schema, schema, fact, heap, fact,
+                     fact, schema, fact, options, schema, fact, fact,
+                     fact, schema, fact, schema, fact)))
+
+#
+# run command
+#
+def collect_stages(plan, results):
+    """collects the properties of PG-Strom's custom nodes"""
+    if plan.get('Node Type') == 'Custom Scan':
+        node = {'node': plan.get('Custom Plan Provider'),
+                'total_ms': plan.get('Actual Total Time')}
+        for key in ('Queue Time', 'DMA Send Time', 'Kernel Time',
+                    'DMA Receive Time', 'Host Consume Time',
+                    'GPU Chunks', 'CPU Hybrid Chunks'):
+            if key in plan:
+                node[key] = plan[key]
+        results.append(node)
+    for child in plan.get('Plans', []):
+        collect_stages(child, results)
+    return results
+
+def session_script(args, suite, variant, mode):
+    return ('SET search_path = %s;\n'
+            'SET pg_strom.enabled = %s;\n'
+            'SET max_parallel_workers_per_gather = %d;\n' %
+            (search_path(suite, variant),
+             'on' if mode == 'gpu' else 'off',
+             args.parallel_workers))
+
+def run_query(args, variant, mode, cache, query):
+    """runs the query @repeat times, then EXPLAIN ANALYZE once. For the warm
+    cache, a preliminary run is executed prior to the measurement; for the
+    cold cache, only the first run is measured."""
+    name, setup, main, teardown = query
+    head = session_script(args, args.suite, variant, mode)
+    head += ''.join(s + ';\n' for s in setup)
+    tail = ''.join(s + ';\n' for s in teardown)
+
+    script = head + '\\o /dev/null\n'
+    if cache == 'warm':
+        script += main + ';\n'
+    script += '\\timing on\n'
+    script += (main + ';\n') * (args.repeat if cache == 'warm' else 1)
+    script += '\\o\n\\timing off\n' + tail
+    proc = psql(args, script, check=False)
+    if proc.returncode != 0:
+        return None, None, proc.stderr.strip()
+    latencies = [float(x) for x in
+                 re.findall(r'^Time: ([0-9.]+) ms', proc.stdout, flags=re.M)]
+
+    script = head + '\\pset tuples_only on\n\\pset format unaligned\n'
+    script += 'EXPLAIN (ANALYZE, VERBOSE, FORMAT JSON) ' + main + ';\n' + tail
+    proc = psql(args, script, check=False)
+    if proc.returncode != 0:
+        return latencies, None, proc.stderr.strip()
+    text = proc.stdout[proc.stdout.find('['):]
+    plan = json.loads(text)[0]['Plan']
+    return latencies, collect_stages(plan, []), None
+
+def git_commit():
+    try:
+        proc = subprocess.run(['git', '-C', STROM_BUILD_ROOT,
+                               'rev-parse', 'HEAD'],
+                              stdout=subprocess.PIPE, stderr=subprocess.DEVNULL,
+                              universal_newlines=True)
+        return proc.stdout.strip() or None
+    except OSError:
+        return None
+
+def cmd_run(args):
+    queries = load_queries(args.suite)
+    if args.queries:
+        queries = [q for q in queries if q[0] in args.queries]
+    proc = psql(args, 'SELECT version();')
+    output = {
+        'suite': args.suite,
+        'dbname': args.dbname,
+        'git_commit': git_commit(),
+        'timestamp': datetime.datetime.now().isoformat(),
+        'server_version': proc.stdout.strip().splitlines()[-1].strip(),
+        'repeat': args.repeat,
+        'results': [],
+    }
+    for variant in args.variants:
+        for mode in args.modes:
+            for cache in args.caches:
+                for query in queries:
+                    if cache == 'cold' and \
+                       subprocess.run(args.cold_cmd, shell=True).returncode != 0:
+                        error('failed on cold cache command: ' + args.cold_cmd)
+                    latencies, stages, err = run_query(args, variant, mode,
+                                                       cache, query)
+                    item = {
+                        'variant': variant,
+                        'mode': mode,
+                        'cache': cache,
+                        'query': query[0],
+                        'latencies_ms': latencies,
+                        'median_ms': statistics.median(latencies) if latencies else None,
+                        'min_ms': min(latencies) if latencies else None,
+                        'stages': stages,
+                        'error': err,
+                    }
+                    output['results'].append(item)
+                    print('%-9s %-4s %-5s %-6s %s' %
+                          (variant, mode, cache, query[0],
+                           '%.2fms' % item['median_ms']
+                           if item['median_ms'] is not None else 'ERROR'))
+    with open(args.output, 'w') as f:
+        json.dump(output, f, indent=2)
+    print('results are written to ' + args.output)
+
+#
+# compare command
+#
+def cmd_compare(args):
+    with open(args.base) as f:
+        base = json.load(f)
+    with open(args.new) as f:
+        new = json.load(f)
+    def key(r):
+        return (r['variant'], r['mode'], r['cache'], r['query'])
+    base_map = {key(r): r for r in base['results']}
+    nregress = 0
+    print('base: %s (%s)' % (args.base, base.get('git_commit')))
+    print('new:  %s (%s)' % (args.new, new.get('git_commit')))
+    print('%-9s %-4s %-5s %-6s %12s %12s %8s' %
+          ('variant', 'mode', 'cache', 'query', 'base[ms]', 'new[ms]', 'ratio'))
+    for r in new['results']:
+        b = base_map.get(key(r))
+        if not b or b['median_ms'] is None:
+            continue
+        if r['median_ms'] is None:
+            status = 'ERROR'
+            nregress += 1
+            ratio = float('nan')
+        else:
+            ratio = r['median_ms'] / max(b['median_ms'], 0.001)
+            delta = r['median_ms'] - b['median_ms']
+            status = ''
+            if ratio > 1.0 + args.threshold and delta > args.min_delta:
+                status = 'REGRESSION'
+                nregress += 1
+            elif ratio < 1.0 - args.threshold and -delta > args.min_delta:
+                status = 'improved'
+        print('%-9s %-4s %-5s %-6s %12.2f %12s %8.3f %s' %
+              (r['variant'], r['mode'], r['cache'], r['query'],
+               b['median_ms'],
+               '%.2f' % r['median_ms'] if r['median_ms'] is not None else '-',
+               ratio, status))
+    print('%d regression(s) found' % nregress)
+    return 1 if nregress > 0 else 0
+
+def list_arg(choices):
+    def parse(value):
+        items = [x.strip() for x in value.split(',') if x.strip()]
+        for x in items:
+            if x not in choices:
+                raise argparse.ArgumentTypeError(
+                    'unknown "%s"; one of %s' % (x, ', '.join(choices)))
+        return items
+    return parse
+
+def main():
+    parser = argparse.ArgumentParser(description='PG-Strom benchmark harness')
+    sub = parser.add_subparsers(dest='command')
+
+    p = sub.add_parser('setup', help='generate and load the benchmark data')
+    p.add_argument('--suite', choices=SUITES.keys(), default='ssbm')
+    p.add_argument('--scale', type=int, default=10)
+    p.add_argument('--dbname', default='pgstrom_bench')
+    p.add_argument('--variants', type=list_arg(VARIANTS), default=list(VARIANTS))
+    p.add_argument('--arrow-dir', default='.',
+                   help='directory to write the Arrow files')
+
+    p = sub.add_parser('run', help='run the benchmark queries')
+    p.add_argument('--suite', choices=SUITES.keys(), default='ssbm')
+    p.add_argument('--dbname', default='pgstrom_bench')
+    p.add_argument('--variants', type=list_arg(VARIANTS), default=list(VARIANTS))
+    p.add_argument('--modes', type=list_arg(MODES), default=list(MODES))
+    p.add_argument('--caches', type=list_arg(CACHES), default=list(CACHES))
+    p.add_argument('--queries', type=lambda x: x.split(','), default=None,
+                   help='comma separated query names (e.g, Q1_1,Q2_1)')
+    p.add_argument('--repeat', type=int, default=3)
+    p.add_argument('--parallel-workers', type=int, default=2)
+    p.add_argument('--cold-cmd', default='sudo sysctl -w vm.drop_caches=1',
+                   help='shell command to drop the caches before cold runs')
+    p.add_argument('--output', default='bench.json')
+
+    p = sub.add_parser('compare', help='compare two results')
+    p.add_argument('base')
+    p.add_argument('new')
+    p.add_argument('--threshold', type=float, default=0.10,
+                   help='ratio of the slowdown to be flagged')
+    p.add_argument('--min-delta', type=float, default=5.0,
+                   help='ignores differences less than this [ms]')
+
+    args = parser.parse_args()
+    if args.command == 'setup':
+        cmd_setup(args)
+    elif args.command == 'run':
+        cmd_run(args)
+    elif args.command == 'compare':
+        sys.exit(cmd_compare(args))
+    else:
+        parser.print_help()
+        sys.exit(2)
+
+if __name__ == '__main__':
+    main()
@@ -85,6 +85,166 @@ SELECT id,z INTO test03p FROM regtest_data
 (SELECT * FROM test03g EXCEPT SELECT * FROM test03p);
 (SELECT * FROM test03p EXCEPT SELECT * FROM test03g);
 
+-- ScalarArrayOp on constant arrays above the threshold of binary search
+CREATE TABLE regtest_scalar (
+  id    int,
+  a     int,
+  b     int8,
+  d     date,
+  ts    timestamp
+);
+INSERT INTO regtest_scalar (
+  SELECT x, pgstrom.random_int(2,0,1000),
+            pgstrom.random_int(2,-500,500),
+            pgstrom.random_date(2,'2022-01-01','2022-03-01'),
+            date_trunc('hour', pgstrom.random_timestamp(2,'2022-01-01',
+                                                          '2022-01-03'))
+    FROM generate_series(1,5000) x
+);
+
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id,a INTO test04g FROM regtest_scalar
+ WHERE a IN (
+              11, 48, 85, 122, 159, 196, 233, 270, 307, 344, 381, 418,
+              455, 492, 529, 566, 603, 640, 677, 714, 751, 788, 825,
+              862, 899, 936, 973, 10, 47, 84, 121, 158, 195, 232, 269,
+              306, 343, 380, 417, 454, 491, 528, 565, 602, 639, 676,
+              713, 750);
+SELECT id,a INTO test04g FROM regtest_scalar
+ WHERE a IN (
+              11, 48, 85, 122, 159, 196, 233, 270, 307, 344, 381, 418,
+              455, 492, 529, 566, 603, 640, 677, 714, 751, 788, 825,
+              862, 899, 936, 973, 10, 47, 84, 121, 158, 195, 232, 269,
+              306, 343, 380, 417, 454, 491, 528, 565, 602, 639, 676,
+              713, 750);
+SET pg_strom.enabled = off;
+SELECT id,a INTO test04p FROM regtest_scalar
+ WHERE a IN (
+              11, 48, 85, 122, 159, 196, 233, 270, 307, 344, 381, 418,
+              455, 492, 529, 566, 603, 640, 677, 714, 751, 788, 825,
+              862, 899, 936, 973, 10, 47, 84, 121, 158, 195, 232, 269,
+              306, 343, 380, 417, 454, 491, 528, 565, 602, 639, 676,
+              713, 750);
+(SELECT * FROM test04g EXCEPT SELECT * FROM test04p);
+(SELECT * FROM test04p EXCEPT SELECT * FROM test04g);
+
+-- NULL elements; not-found results NULL instead of false
+SET pg_strom.enabled = on;
+SELECT id,b INTO test05g FROM regtest_scalar
+ WHERE (b = ANY (ARRAY[
+                 -493, -486, -479, -440, -433, -426, -387, -380, -334,
+                 -327, -281, -274, -228, -221, -175, -168, -122, -115,
+                 -69, -62, NULL, -16, -9, 37, 44, 90, 97, 143, 150,
+                 196, 203, 249, 256, 302, 309, 355, 362, 408, 415, 461,
+                 468]::int8[])) IS NULL;
+SET pg_strom.enabled = off;
+SELECT id,b INTO test05p FROM regtest_scalar
+ WHERE (b = ANY (ARRAY[
+                 -493, -486, -479, -440, -433, -426, -387, -380, -334,
+                 -327, -281, -274, -228, -221, -175, -168, -122, -115,
+                 -69, -62, NULL, -16, -9, 37, 44, 90, 97, 143, 150,
+                 196, 203, 249, 256, 302, 309, 355, 362, 408, 415, 461,
+                 468]::int8[])) IS NULL;
+(SELECT * FROM test05g EXCEPT SELECT * FROM test05p);
+(SELECT * FROM test05p EXCEPT SELECT * FROM test05g);
+
+SET pg_strom.enabled = on;
+SELECT id,b INTO test06g FROM regtest_scalar
+ WHERE b = ANY (ARRAY[
+                 -493, -486, -479, -440, -433, -426, -387, -380, -334,
+                 -327, -281, -274, -228, -221, -175, -168, -122, -115,
+                 -69, -62, NULL, -16, -9, 37, 44, 90, 97, 143, 150,
+                 196, 203, 249, 256, 302, 309, 355, 362, 408, 415, 461,
+                 468]::int8[]);
+SET pg_strom.enabled = off;
+SELECT id,b INTO test06p FROM regtest_scalar
+ WHERE b = ANY (ARRAY[
+                 -493, -486, -479, -440, -433, -426, -387, -380, -334,
+                 -327, -281, -274, -228, -221, -175, -168, -122, -115,
+                 -69, -62, NULL, -16, -9, 37, 44, 90, 97, 143, 150,
+                 196, 203, 249, 256, 302, 309, 355, 362, 408, 415, 461,
+                 468]::int8[]);
+(SELECT * FROM test06g EXCEPT SELECT * FROM test06p);
+(SELECT * FROM test06p EXCEPT SELECT * FROM test06g);
+
+-- '<> ALL' is not built into the sorted array
+SET pg_strom.enabled = on;
+SELECT id,a INTO test07g FROM regtest_scalar
+ WHERE a <> ALL (ARRAY[
+                 3, 64, 125, 186, 247, 308, 369, 430, 491, 552, 613,
+                 674, 735, 796, 857, 918, 979, 40, 101, 162, 223, 284,
+                 345, 406, 467, 528, 589, 650, 711, 772, 833, 894, 955,
+                 16, 77, 138]::int[]);
+SET pg_strom.enabled = off;
+SELECT id,a INTO test07p FROM regtest_scalar
+ WHERE a <> ALL (ARRAY[
+                 3, 64, 125, 186, 247, 308, 369, 430, 491, 552, 613,
+                 674, 735, 796, 857, 918, 979, 40, 101, 162, 223, 284,
+                 345, 406, 467, 528, 589, 650, 711, 772, 833, 894, 955,
+                 16, 77, 138]::int[]);
+(SELECT * FROM test07g EXCEPT SELECT * FROM test07p);
+(SELECT * FROM test07p EXCEPT SELECT * FROM test07g);
+
+SET pg_strom.enabled = on;
+SELECT id,a INTO test08g FROM regtest_scalar
+ WHERE (a <> ALL (ARRAY[
+                  3, 64, 125, 186, 247, 308, 369, 430, 491, 552, 613,
+                  674, 735, 796, 857, 918, 979, 40, NULL, 101, 162,
+                  223, 284, 345, 406, 467, 528, 589, 650, 711, 772,
+                  833, 894, 955, 16, 77, 138]::int[])) IS NOT FALSE;
+SET pg_strom.enabled = off;
+SELECT id,a INTO test08p FROM regtest_scalar
+ WHERE (a <> ALL (ARRAY[
+                  3, 64, 125, 186, 247, 308, 369, 430, 491, 552, 613,
+                  674, 735, 796, 857, 918, 979, 40, NULL, 101, 162,
+                  223, 284, 345, 406, 467, 528, 589, 650, 711, 772,
+                  833, 894, 955, 16, 77, 138]::int[])) IS NOT FALSE;
+(SELECT * FROM test08g EXCEPT SELECT * FROM test08p);
+(SELECT * FROM test08p EXCEPT SELECT * FROM test08g);
+
+-- date and timestamp
+SET pg_strom.enabled = on;
+SELECT id,d,ts INTO test09g FROM regtest_scalar
+ WHERE d IN (
+              '2022-01-01', '2022-01-03', '2022-01-05', '2022-01-07',
+              '2022-01-09', '2022-01-11', '2022-01-13', '2022-01-15',
+              '2022-01-17', '2022-01-19', '2022-01-21', '2022-01-23',
+              '2022-01-25', '2022-01-27', '2022-01-29', '2022-01-31',
+              '2022-02-02', '2022-02-05', '2022-02-08', '2022-02-11',
+              '2022-02-14', '2022-02-17', '2022-02-20', '2022-02-23',
+              '2022-02-26')
+    OR ts IN (
+               '2022-01-01 00:00:00', '2022-01-01 03:00:00',
+               '2022-01-01 06:00:00', '2022-01-01 09:00:00',
+               '2022-01-01 12:00:00', '2022-01-01 15:00:00',
+               '2022-01-01 18:00:00', '2022-01-01 21:00:00',
+               '2022-01-02 00:00:00', '2022-01-02 03:00:00',
+               '2022-01-02 06:00:00', '2022-01-02 09:00:00',
+               '2022-01-02 12:00:00', '2022-01-02 15:00:00',
+               '2022-01-02 18:00:00', '2022-01-02 21:00:00');
+SET pg_strom.enabled = off;
+SELECT id,d,ts INTO test09p FROM regtest_scalar
+ WHERE d IN (
+              '2022-01-01', '2022-01-03', '2022-01-05', '2022-01-07',
+              '2022-01-09', '2022-01-11', '2022-01-13', '2022-01-15',
+              '2022-01-17', '2022-01-19', '2022-01-21', '2022-01-23',
+              '2022-01-25', '2022-01-27', '2022-01-29', '2022-01-31',
+              '2022-02-02', '2022-02-05', '2022-02-08', '2022-02-11',
+              '2022-02-14', '2022-02-17', '2022-02-20', '2022-02-23',
+              '2022-02-26')
+    OR ts IN (
+               '2022-01-01 00:00:00', '2022-01-01 03:00:00',
+               '2022-01-01 06:00:00', '2022-01-01 09:00:00',
+               '2022-01-01 12:00:00', '2022-01-01 15:00:00',
+               '2022-01-01 18:00:00', '2022-01-01 21:00:00',
+               '2022-01-02 00:00:00', '2022-01-02 03:00:00',
+               '2022-01-02 06:00:00', '2022-01-02 09:00:00',
+               '2022-01-02 12:00:00', '2022-01-02 15:00:00',
+               '2022-01-02 18:00:00', '2022-01-02 21:00:00');
+(SELECT * FROM test09g EXCEPT SELECT * FROM test09p);
+(SELECT * FROM test09p EXCEPT SELECT * FROM test09g);
+
 -- TODO: array operation on fdw_arrow
 
 -- should be empty result
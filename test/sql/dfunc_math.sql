@@ -196,6 +196,53 @@ SELECT g.*, p.*
     OR @(g.atan  - p.atan)  > 0.000001
     OR @(g.atan2 - p.atan2) > 0.000001;
 
+-- hash and cryptographic functions
+-- input length 0, less than 55, 55-64 and longer than 64 bytes cover the
+-- empty input, single block and multi-block paths of md5/sha2 padding
+CREATE TABLE rt_hash (
+  id   int,
+  t    text COLLATE "C",
+  tj   text COLLATE "en_US",
+  b    bytea
+);
+INSERT INTO rt_hash (
+  SELECT x, v, v, convert_to(v, 'UTF8')
+    FROM (SELECT x, substring(repeat('0123456789abcdef', 16), 1, x) v
+            FROM generate_series(0,200) x) s
+);
+INSERT INTO rt_hash (
+  SELECT x, v, v, convert_to(v, 'UTF8')
+    FROM (SELECT x, pgstrom.random_text_len(1, 400) v
+            FROM generate_series(1001,3000) x) s
+);
+VACUUM ANALYZE rt_hash;
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id, md5(t) v1, md5(b) v2, sha224(b) v3, sha256(b) v4,
+           pgstrom.crc32(t) v5, pgstrom.crc32(b) v6,
+           pgstrom.crc32c(t) v7, pgstrom.crc32c(b) v8,
+           hashtext(t) v9, hashtext(tj) v10
+  INTO test07g
+  FROM rt_hash
+ WHERE id >= 0;
+SELECT id, md5(t) v1, md5(b) v2, sha224(b) v3, sha256(b) v4,
+           pgstrom.crc32(t) v5, pgstrom.crc32(b) v6,
+           pgstrom.crc32c(t) v7, pgstrom.crc32c(b) v8,
+           hashtext(t) v9, hashtext(tj) v10
+  INTO test07g
+  FROM rt_hash
+ WHERE id >= 0;
+SET pg_strom.enabled = off;
+SELECT id, md5(t) v1, md5(b) v2, sha224(b) v3, sha256(b) v4,
+           pgstrom.crc32(t) v5, pgstrom.crc32(b) v6,
+           pgstrom.crc32c(t) v7, pgstrom.crc32c(b) v8,
+           hashtext(t) v9, hashtext(tj) v10
+  INTO test07p
+  FROM rt_hash
+ WHERE id >= 0;
+(SELECT * FROM test07g EXCEPT ALL SELECT * FROM test07p) order by id;
+(SELECT * FROM test07p EXCEPT ALL SELECT * FROM test07g) order by id;
+
 -- cleanup temporary resource
 SET client_min_messages = error;
 DROP SCHEMA regtest_dfunc_math_temp CASCADE;
@@ -234,6 +234,128 @@ SELECT id, ((v)->>'num1')::numeric + ((v)->'comp'->>'ival')::numeric v1,
 (SELECT * FROM test06g EXCEPT SELECT * FROM test06p) ORDER BY id;
 (SELECT * FROM test06p EXCEPT SELECT * FROM test06g) ORDER BY id;
 
+-- containment, key existence and jsonpath operators
+-- on nested arrays / objects, duplicate keys and raw scalars
+CREATE TABLE rt_jsonb_x (
+  id  int,
+  v   jsonb
+);
+INSERT INTO rt_jsonb_x VALUES
+  ( 1, '{"a":1, "b":[1,2,[3,4]], "c":{"d":"x", "e":[{"f":1},{"f":2}]}}'),
+  ( 2, '{"a":1, "a":2, "b":"x"}'),
+  ( 3, '[1, 2, [3, 4], {"a":1}]'),
+  ( 4, '"a"'),
+  ( 5, '1'),
+  ( 6, '["a", "b", "c"]'),
+  ( 7, '[["a"], ["b", "c"]]'),
+  ( 8, '{"a":{"b":{"c":{"d":[1,2,3]}}}}'),
+  ( 9, '[]'),
+  (10, '{}'),
+  (11, 'null'),
+  (12, NULL),
+  (13, '[1, 1, 2, 2, "a", "a"]'),
+  (14, '{"a":[1,[2,[3]]], "b":1, "b":[1,2]}'),
+  (15, '{"b":"a", "c":["a","d"]}');
+INSERT INTO rt_jsonb_x (SELECT id + 1000, v FROM rt_jsonb_a WHERE id <= 2000);
+INSERT INTO rt_jsonb_x (SELECT id + 5000, v FROM rt_jsonb_c WHERE id <= 2000);
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id, v @> '{"a":1}' v1,
+           v @> '{"b":[1,[3]]}' v2,
+           v @> '[[3]]' v3,
+           v @> '"a"' v4,
+           v @> '["a"]' v5,
+           v <@ '{"a":1, "b":[1,2,[3,4]], "c":{"d":"x"}}' v6,
+           v @> '{"c":{"e":[{"f":2}]}}' v7,
+           v <@ '[1, 2, [3, 4], {"a":1}, "a"]' v8
+  INTO test10g
+  FROM rt_jsonb_x
+ WHERE id > 0;
+SELECT id, v @> '{"a":1}' v1,
+           v @> '{"b":[1,[3]]}' v2,
+           v @> '[[3]]' v3,
+           v @> '"a"' v4,
+           v @> '["a"]' v5,
+           v <@ '{"a":1, "b":[1,2,[3,4]], "c":{"d":"x"}}' v6,
+           v @> '{"c":{"e":[{"f":2}]}}' v7,
+           v <@ '[1, 2, [3, 4], {"a":1}, "a"]' v8
+  INTO test10g
+  FROM rt_jsonb_x
+ WHERE id > 0;
+SET pg_strom.enabled = off;
+SELECT id, v @> '{"a":1}' v1,
+           v @> '{"b":[1,[3]]}' v2,
+           v @> '[[3]]' v3,
+           v @> '"a"' v4,
+           v @> '["a"]' v5,
+           v <@ '{"a":1, "b":[1,2,[3,4]], "c":{"d":"x"}}' v6,
+           v @> '{"c":{"e":[{"f":2}]}}' v7,
+           v <@ '[1, 2, [3, 4], {"a":1}, "a"]' v8
+  INTO test10p
+  FROM rt_jsonb_x
+ WHERE id > 0;
+(SELECT * FROM test10g EXCEPT SELECT * FROM test10p) ORDER BY id;
+(SELECT * FROM test10p EXCEPT SELECT * FROM test10g) ORDER BY id;
+
+-- key existence matches top-level keys and string elements of arrays
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id, v ? 'a' v1, v ? 'b' v2, v ? 'd' v3,
+           v ?| array['a','x'] v4, v ?| array['d','e'] v5,
+           v ?& array['a','b'] v6, v ?& array['b','c'] v7
+  INTO test11g
+  FROM rt_jsonb_x
+ WHERE id > 0;
+SELECT id, v ? 'a' v1, v ? 'b' v2, v ? 'd' v3,
+           v ?| array['a','x'] v4, v ?| array['d','e'] v5,
+           v ?& array['a','b'] v6, v ?& array['b','c'] v7
+  INTO test11g
+  FROM rt_jsonb_x
+ WHERE id > 0;
+SET pg_strom.enabled = off;
+SELECT id, v ? 'a' v1, v ? 'b' v2, v ? 'd' v3,
+           v ?| array['a','x'] v4, v ?| array['d','e'] v5,
+           v ?& array['a','b'] v6, v ?& array['b','c'] v7
+  INTO test11p
+  FROM rt_jsonb_x
+ WHERE id > 0;
+(SELECT * FROM test11g EXCEPT SELECT * FROM test11p) ORDER BY id;
+(SELECT * FROM test11p EXCEPT SELECT * FROM test11g) ORDER BY id;
+
+-- jsonpath; strict mode is not supported on the device, so runs on CPU
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id, jsonb_path_exists(v, '$.a') v1,
+           jsonb_path_exists(v, '$.b[*] ? (@ > 1)') v2,
+           jsonb_path_exists(v, '$.c.e[*].f ? (@ == 2)') v3,
+           v @? '$[*] ? (@ == "a")' v4,
+           v @? '$.a.b.c.d[2]' v5,
+           jsonb_path_exists(v, 'strict $.a') v6
+  INTO test12g
+  FROM rt_jsonb_x
+ WHERE id > 0;
+SELECT id, jsonb_path_exists(v, '$.a') v1,
+           jsonb_path_exists(v, '$.b[*] ? (@ > 1)') v2,
+           jsonb_path_exists(v, '$.c.e[*].f ? (@ == 2)') v3,
+           v @? '$[*] ? (@ == "a")' v4,
+           v @? '$.a.b.c.d[2]' v5,
+           jsonb_path_exists(v, 'strict $.a') v6
+  INTO test12g
+  FROM rt_jsonb_x
+ WHERE id > 0;
+SET pg_strom.enabled = off;
+SELECT id, jsonb_path_exists(v, '$.a') v1,
+           jsonb_path_exists(v, '$.b[*] ? (@ > 1)') v2,
+           jsonb_path_exists(v, '$.c.e[*].f ? (@ == 2)') v3,
+           v @? '$[*] ? (@ == "a")' v4,
+           v @? '$.a.b.c.d[2]' v5,
+           jsonb_path_exists(v, 'strict $.a') v6
+  INTO test12p
+  FROM rt_jsonb_x
+ WHERE id > 0;
+(SELECT * FROM test12g EXCEPT SELECT * FROM test12p) ORDER BY id;
+(SELECT * FROM test12p EXCEPT SELECT * FROM test12g) ORDER BY id;
+
 -- cleanup temporary resource
 SET client_min_messages = error;
 DROP SCHEMA regtest_dtype_jsonb_temp CASCADE;
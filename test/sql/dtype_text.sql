@@ -306,6 +306,103 @@ SELECT id, length(tc1) v1,
 (SELECT * FROM test32g EXCEPT SELECT * FROM test32p) ORDER BY id;
 (SELECT * FROM test32p EXCEPT SELECT * FROM test32g) ORDER BY id;
 
+-- regular expression match on the DFA (C collation)
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id, tc1 ~ 'ab.*cd' v1,
+           tc2 ~ '^[A-Z][a-z]' v2,
+           tc1 ~ '[0-9]{2,3}$' v3,
+           tc2 !~ '(ab|cd|ef)+' v4,
+           vc1 ~ '^[[:alpha:]]+[[:digit:]]{1,2}' v5,
+           vc2 !~ '\d\d' v6
+  INTO test40g
+  FROM rt_text
+ WHERE id > 0;
+SELECT id, tc1 ~ 'ab.*cd' v1,
+           tc2 ~ '^[A-Z][a-z]' v2,
+           tc1 ~ '[0-9]{2,3}$' v3,
+           tc2 !~ '(ab|cd|ef)+' v4,
+           vc1 ~ '^[[:alpha:]]+[[:digit:]]{1,2}' v5,
+           vc2 !~ '\d\d' v6
+  INTO test40g
+  FROM rt_text
+ WHERE id > 0;
+SET pg_strom.enabled = off;
+SELECT id, tc1 ~ 'ab.*cd' v1,
+           tc2 ~ '^[A-Z][a-z]' v2,
+           tc1 ~ '[0-9]{2,3}$' v3,
+           tc2 !~ '(ab|cd|ef)+' v4,
+           vc1 ~ '^[[:alpha:]]+[[:digit:]]{1,2}' v5,
+           vc2 !~ '\d\d' v6
+  INTO test40p
+  FROM rt_text
+ WHERE id > 0;
+(SELECT * FROM test40g EXCEPT SELECT * FROM test40p) ORDER BY id;
+(SELECT * FROM test40p EXCEPT SELECT * FROM test40g) ORDER BY id;
+
+-- case insensitive match is valid only C collation, like ILIKE
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id, tc1 ~* 'ab[c-f]' v1,
+           tc2 ~* '^a.{2,4}z' v2,
+           vc1 ~* '(xy|zw){1,3}$' v3,
+           tc2 !~* 'q[[:digit:]]?0' v4
+  INTO test41g
+  FROM rt_text
+ WHERE id > 0;
+SELECT id, tc1 ~* 'ab[c-f]' v1,
+           tc2 ~* '^a.{2,4}z' v2,
+           vc1 ~* '(xy|zw){1,3}$' v3,
+           tc2 !~* 'q[[:digit:]]?0' v4
+  INTO test41g
+  FROM rt_text
+ WHERE id > 0;
+SET pg_strom.enabled = off;
+SELECT id, tc1 ~* 'ab[c-f]' v1,
+           tc2 ~* '^a.{2,4}z' v2,
+           vc1 ~* '(xy|zw){1,3}$' v3,
+           tc2 !~* 'q[[:digit:]]?0' v4
+  INTO test41p
+  FROM rt_text
+ WHERE id > 0;
+(SELECT * FROM test41g EXCEPT SELECT * FROM test41p) ORDER BY id;
+(SELECT * FROM test41p EXCEPT SELECT * FROM test41g) ORDER BY id;
+
+-- back-reference, lookahead, anchor in the middle and non-C collation
+-- are not supported by the DFA, so these run on CPU
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id, tc1 ~ '([a-z])\1' v1,
+           tc2 ~ 'a(?=b)' v2,
+           tc1 !~ 'ab(?!c)' v3,
+           tj1 ~* 'ab[0-9]' v4,
+           tc2 ~ 'x|^y' v5,
+           tc2 ~ 'ab\d' v6
+  INTO test42g
+  FROM rt_text
+ WHERE id > 0;
+SELECT id, tc1 ~ '([a-z])\1' v1,
+           tc2 ~ 'a(?=b)' v2,
+           tc1 !~ 'ab(?!c)' v3,
+           tj1 ~* 'ab[0-9]' v4,
+           tc2 ~ 'x|^y' v5,
+           tc2 ~ 'ab\d' v6
+  INTO test42g
+  FROM rt_text
+ WHERE id > 0;
+SET pg_strom.enabled = off;
+SELECT id, tc1 ~ '([a-z])\1' v1,
+           tc2 ~ 'a(?=b)' v2,
+           tc1 !~ 'ab(?!c)' v3,
+           tj1 ~* 'ab[0-9]' v4,
+           tc2 ~ 'x|^y' v5,
+           tc2 ~ 'ab\d' v6
+  INTO test42p
+  FROM rt_text
+ WHERE id > 0;
+(SELECT * FROM test42g EXCEPT SELECT * FROM test42p) ORDER BY id;
+(SELECT * FROM test42p EXCEPT SELECT * FROM test42g) ORDER BY id;
+
 -- cleanup temporary resource
 SET client_min_messages = error;
 DROP SCHEMA regtest_dtype_text_temp CASCADE;
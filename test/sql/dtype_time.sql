@@ -922,6 +922,135 @@ SELECT * FROM test45g AS a, test45p AS b WHERE a.id=b.id AND
   OR ABS(a.v12 - b.v12) > 0.1
 ) LIMIT 5;
 
+-- timezone aware truncation / bucketing around the DST transitions
+-- (US: 2021-03-14 and 2021-11-07, UK: 2021-03-28 and 2021-10-31),
+-- and origins prior to 2000-01-01 (negative timestamp value)
+SET timezone = 'America/New_York';
+CREATE TABLE rt_dst (
+  id      int,
+  ts      timestamp,
+  tsz     timestamptz,
+  ots     timestamp,
+  otsz    timestamptz
+);
+INSERT INTO rt_dst (id, tsz) (
+  SELECT x, '2021-03-13 00:00:00-05'::timestamptz + x * interval '7 minutes'
+    FROM generate_series(0,599) x);
+INSERT INTO rt_dst (id, tsz) (
+  SELECT x + 1000, '2021-11-06 00:00:00-04'::timestamptz + x * interval '7 minutes'
+    FROM generate_series(0,599) x);
+INSERT INTO rt_dst (id, tsz) (
+  SELECT x + 2000, '2021-03-27 12:00:00+00'::timestamptz + x * interval '7 minutes'
+    FROM generate_series(0,599) x);
+INSERT INTO rt_dst (id, tsz) (
+  SELECT x + 3000, '2021-10-30 12:00:00+00'::timestamptz + x * interval '7 minutes'
+    FROM generate_series(0,599) x);
+INSERT INTO rt_dst (id, tsz) (
+  SELECT x + 4000, '1969-12-30 00:00:00+00'::timestamptz + x * interval '37 minutes'
+    FROM generate_series(0,599) x);
+INSERT INTO rt_dst (id, tsz) (
+  SELECT id + 10000, tsz1 FROM rt_datetime);
+UPDATE rt_dst
+   SET ts = tsz::timestamp,
+       otsz = '1960-01-01 00:00:00+00'::timestamptz
+              + (id % 5) * interval '16 years 3 hours 17 minutes';
+UPDATE rt_dst SET ots = otsz::timestamp;
+VACUUM ANALYZE rt_dst;
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id, date_trunc('hour', tsz) v1, date_trunc('day', tsz) v2,
+           date_trunc('week', tsz) v3, date_trunc('month', tsz) v4,
+           date_trunc('day', ts) v5, date_trunc('hour', ts) v6
+  INTO test50g
+  FROM rt_dst
+ WHERE id >= 0;
+SELECT id, date_trunc('hour', tsz) v1, date_trunc('day', tsz) v2,
+           date_trunc('week', tsz) v3, date_trunc('month', tsz) v4,
+           date_trunc('day', ts) v5, date_trunc('hour', ts) v6
+  INTO test50g
+  FROM rt_dst
+ WHERE id >= 0;
+SET pg_strom.enabled = off;
+SELECT id, date_trunc('hour', tsz) v1, date_trunc('day', tsz) v2,
+           date_trunc('week', tsz) v3, date_trunc('month', tsz) v4,
+           date_trunc('day', ts) v5, date_trunc('hour', ts) v6
+  INTO test50p
+  FROM rt_dst
+ WHERE id >= 0;
+(SELECT * FROM test50g EXCEPT SELECT * FROM test50p) ORDER BY id;
+(SELECT * FROM test50p EXCEPT SELECT * FROM test50g) ORDER BY id;
+
+-- AT TIME ZONE with a constant zone name
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id, tsz AT TIME ZONE 'Europe/London' v1,
+           ts  AT TIME ZONE 'Europe/London' v2,
+           date_trunc('day',  tsz AT TIME ZONE 'America/New_York') v3,
+           date_trunc('hour', ts  AT TIME ZONE 'Europe/London') v4
+  INTO test51g
+  FROM rt_dst
+ WHERE id >= 0;
+SELECT id, tsz AT TIME ZONE 'Europe/London' v1,
+           ts  AT TIME ZONE 'Europe/London' v2,
+           date_trunc('day',  tsz AT TIME ZONE 'America/New_York') v3,
+           date_trunc('hour', ts  AT TIME ZONE 'Europe/London') v4
+  INTO test51g
+  FROM rt_dst
+ WHERE id >= 0;
+SET pg_strom.enabled = off;
+SELECT id, tsz AT TIME ZONE 'Europe/London' v1,
+           ts  AT TIME ZONE 'Europe/London' v2,
+           date_trunc('day',  tsz AT TIME ZONE 'America/New_York') v3,
+           date_trunc('hour', ts  AT TIME ZONE 'Europe/London') v4
+  INTO test51p
+  FROM rt_dst
+ WHERE id >= 0;
+(SELECT * FROM test51g EXCEPT SELECT * FROM test51p) ORDER BY id;
+(SELECT * FROM test51p EXCEPT SELECT * FROM test51g) ORDER BY id;
+
+-- date_bin() is new at PostgreSQL v14; origins are spread over
+-- 1960-2024, so both of negative and positive timestamp values appear
+SELECT current_setting('server_version_num')::int >= 140000 AS has_date_bin \gset
+\if :has_date_bin
+SET pg_strom.enabled = on;
+EXPLAIN (costs off, verbose)
+SELECT id, date_bin('15 minutes', tsz, otsz) v1,
+           date_bin('1 hour 7 minutes', tsz, otsz) v2,
+           date_bin('2 days', tsz, otsz) v3,
+           date_bin('25 minutes', ts, ots) v4,
+           date_bin('3 hours', ts, ots) v5
+  INTO test52g
+  FROM rt_dst
+ WHERE id >= 0;
+SELECT id, date_bin('15 minutes', tsz, otsz) v1,
+           date_bin('1 hour 7 minutes', tsz, otsz) v2,
+           date_bin('2 days', tsz, otsz) v3,
+           date_bin('25 minutes', ts, ots) v4,
+           date_bin('3 hours', ts, ots) v5
+  INTO test52g
+  FROM rt_dst
+ WHERE id >= 0;
+SET pg_strom.enabled = off;
+SELECT id, date_bin('15 minutes', tsz, otsz) v1,
+           date_bin('1 hour 7 minutes', tsz, otsz) v2,
+           date_bin('2 days', tsz, otsz) v3,
+           date_bin('25 minutes', ts, ots) v4,
+           date_bin('3 hours', ts, ots) v5
+  INTO test52p
+  FROM rt_dst
+ WHERE id >= 0;
+(SELECT * FROM test52g EXCEPT SELECT * FROM test52p) ORDER BY id;
+(SELECT * FROM test52p EXCEPT SELECT * FROM test52g) ORDER BY id;
+-- negative stride and stride with months raise an error on both sides
+SET pg_strom.enabled = on;
+SELECT id, date_bin('-15 minutes', tsz, otsz) FROM rt_dst WHERE id >= 0;
+SELECT id, date_bin('1 month', ts, ots) FROM rt_dst WHERE id >= 0;
+SET pg_strom.enabled = off;
+SELECT id, date_bin('-15 minutes', tsz, otsz) FROM rt_dst WHERE id >= 0;
+SELECT id, date_bin('1 month', ts, ots) FROM rt_dst WHERE id >= 0;
+\endif
+RESET timezone;
+
 -- cleanup temporary resource
 SET client_min_messages = error;
 DROP SCHEMA regtest_dtype_time_temp CASCADE;
@@ -141,3 +141,152 @@ SELECT * INTO test12p
 (SELECT * FROM test12g EXCEPT SELECT * FROM test12p) ORDER BY id;
 (SELECT * FROM test12p EXCEPT SELECT * FROM test12g) ORDER BY id;
 RESET pg_strom.cpu_fallback;
+
+-- GpuJoin with SEMI / ANTI join; inner keys have NULLs and duplications
+SELECT CASE WHEN x % 10 = 0 THEN NULL ELSE x % 1500 END aid, x w
+  INTO test20s
+  FROM generate_series(1,6000) x;
+-- EXPLAIN shows the join type at each depth
+CREATE FUNCTION pg_temp.explain_lines(query text,
+                                      options text = 'verbose, costs off')
+RETURNS SETOF text AS $$
+DECLARE
+  ln  text;
+BEGIN
+  FOR ln IN EXECUTE 'EXPLAIN (' || options || ') ' || query
+  LOOP
+    RETURN NEXT ln;
+  END LOOP;
+END;
+$$ LANGUAGE plpgsql;
+SET pg_strom.enabled = on;
+SELECT trim(ln) plan FROM pg_temp.explain_lines('SELECT id, aid, x
+  FROM fallback_data d
+ WHERE EXISTS (SELECT 1 FROM fallback_enlarge l
+                WHERE l.aid = d.aid AND l.z > 0)') ln
+ WHERE ln ~ 'Depth';
+SELECT id, aid, x INTO test20g
+  FROM fallback_data d
+ WHERE EXISTS (SELECT 1 FROM fallback_enlarge l
+                WHERE l.aid = d.aid AND l.z > 0);
+SET pg_strom.enabled = off;
+SELECT id, aid, x INTO test20p
+  FROM fallback_data d
+ WHERE EXISTS (SELECT 1 FROM fallback_enlarge l
+                WHERE l.aid = d.aid AND l.z > 0);
+(SELECT * FROM test20g EXCEPT ALL SELECT * FROM test20p) ORDER BY id;
+(SELECT * FROM test20p EXCEPT ALL SELECT * FROM test20g) ORDER BY id;
+SET pg_strom.enabled = on;
+SELECT trim(ln) plan FROM pg_temp.explain_lines('SELECT id, aid, x
+  FROM fallback_data d
+ WHERE EXISTS (SELECT 1 FROM test20s s WHERE s.aid = d.aid)') ln
+ WHERE ln ~ 'Depth';
+SELECT id, aid, x INTO test21g
+  FROM fallback_data d
+ WHERE EXISTS (SELECT 1 FROM test20s s WHERE s.aid = d.aid);
+SET pg_strom.enabled = off;
+SELECT id, aid, x INTO test21p
+  FROM fallback_data d
+ WHERE EXISTS (SELECT 1 FROM test20s s WHERE s.aid = d.aid);
+(SELECT * FROM test21g EXCEPT ALL SELECT * FROM test21p) ORDER BY id;
+(SELECT * FROM test21p EXCEPT ALL SELECT * FROM test21g) ORDER BY id;
+-- outer rows with NULL keys survive NOT EXISTS
+SET pg_strom.enabled = on;
+SELECT trim(ln) plan FROM pg_temp.explain_lines('SELECT id, aid, x
+  FROM fallback_data d
+ WHERE NOT EXISTS (SELECT 1 FROM test20s s WHERE s.aid = d.aid)') ln
+ WHERE ln ~ 'Depth';
+SELECT id, aid, x INTO test22g
+  FROM fallback_data d
+ WHERE NOT EXISTS (SELECT 1 FROM test20s s WHERE s.aid = d.aid);
+SET pg_strom.enabled = off;
+SELECT id, aid, x INTO test22p
+  FROM fallback_data d
+ WHERE NOT EXISTS (SELECT 1 FROM test20s s WHERE s.aid = d.aid);
+(SELECT * FROM test22g EXCEPT ALL SELECT * FROM test22p) ORDER BY id;
+(SELECT * FROM test22p EXCEPT ALL SELECT * FROM test22g) ORDER BY id;
+SET pg_strom.enabled = on;
+SELECT trim(ln) plan FROM pg_temp.explain_lines('SELECT id, aid, x
+  FROM fallback_data d
+ WHERE NOT EXISTS (SELECT 1 FROM fallback_enlarge l
+                    WHERE l.aid = d.aid AND l.z > -500)') ln
+ WHERE ln ~ 'Depth';
+SELECT id, aid, x INTO test23g
+  FROM fallback_data d
+ WHERE NOT EXISTS (SELECT 1 FROM fallback_enlarge l
+                    WHERE l.aid = d.aid AND l.z > -500);
+SET pg_strom.enabled = off;
+SELECT id, aid, x INTO test23p
+  FROM fallback_data d
+ WHERE NOT EXISTS (SELECT 1 FROM fallback_enlarge l
+                    WHERE l.aid = d.aid AND l.z > -500);
+(SELECT * FROM test23g EXCEPT ALL SELECT * FROM test23p) ORDER BY id;
+(SELECT * FROM test23p EXCEPT ALL SELECT * FROM test23g) ORDER BY id;
+-- NOT IN
+SET pg_strom.enabled = on;
+SELECT id, aid, x INTO test24g
+  FROM fallback_data d
+ WHERE aid NOT IN (SELECT aid FROM fallback_enlarge WHERE z > 0);
+SET pg_strom.enabled = off;
+SELECT id, aid, x INTO test24p
+  FROM fallback_data d
+ WHERE aid NOT IN (SELECT aid FROM fallback_enlarge WHERE z > 0);
+(SELECT * FROM test24g EXCEPT ALL SELECT * FROM test24p) ORDER BY id;
+(SELECT * FROM test24p EXCEPT ALL SELECT * FROM test24g) ORDER BY id;
+-- NOT IN with NULL in the sub-query returns no rows
+SET pg_strom.enabled = on;
+SELECT count(*) FROM fallback_data d
+ WHERE aid NOT IN (SELECT aid FROM test20s);
+SET pg_strom.enabled = off;
+SELECT count(*) FROM fallback_data d
+ WHERE aid NOT IN (SELECT aid FROM test20s);
+RESET pg_strom.enabled;
+
+-- GpuPreAgg on GpuJoin with partitioned inner hash; GpuJoin re-scans the
+-- outer relation per partition, so it should not be combined to GpuPreAgg
+SELECT x id, x % 2000 aid INTO test30o FROM generate_series(1,200000) x;
+SELECT x aid, x % 11 w, md5(x::text) pad INTO test30i
+  FROM generate_series(1,4000) x;
+ANALYZE test30o;
+ANALYZE test30i;
+-- pretend large relations to split the inner hash table
+UPDATE pg_class SET reltuples = reltuples * 10000
+ WHERE oid IN ('test30o'::regclass, 'test30i'::regclass);
+SET pg_strom.enabled = on;
+SELECT bool_or(ln ~ 'GpuPreAgg') gpupreagg,
+       bool_or(ln ~ 'Inner Partitions') partitioned,
+       bool_or(ln ~ 'Combined GpuJoin') combined
+  FROM pg_temp.explain_lines('SELECT w, count(*), sum(id)
+                                FROM test30o o NATURAL JOIN test30i i
+                               GROUP BY w') ln;
+SELECT w, count(*), sum(id) INTO test30g
+  FROM test30o o NATURAL JOIN test30i i
+ GROUP BY w;
+SET pg_strom.enabled = off;
+SELECT w, count(*), sum(id) INTO test30p
+  FROM test30o o NATURAL JOIN test30i i
+ GROUP BY w;
+(SELECT * FROM test30g EXCEPT ALL SELECT * FROM test30p) ORDER BY w;
+(SELECT * FROM test30p EXCEPT ALL SELECT * FROM test30g) ORDER BY w;
+RESET pg_strom.enabled;
+
+-- GpuJoin on the inner hash table with heavy-hitter join key
+SELECT CASE WHEN x <= 5000 THEN 1 ELSE x END aid, x v
+  INTO test40i
+  FROM generate_series(1,20000) x;
+SELECT x id, x % 20000 aid INTO test40o FROM generate_series(1,100000) x;
+SET pg_strom.enabled = on;
+SELECT trim(ln) plan
+  FROM pg_temp.explain_lines('SELECT o.id, o.aid, i.v
+                                FROM test40o o JOIN test40i i ON o.aid = i.aid',
+                             'analyze, costs off, timing off, summary off') ln
+ WHERE ln ~ 'Depth|Heavy Hitters';
+SELECT o.id, o.aid, i.v INTO test40g
+  FROM test40o o JOIN test40i i ON o.aid = i.aid;
+SET pg_strom.enabled = off;
+SELECT o.id, o.aid, i.v INTO test40p
+  FROM test40o o JOIN test40i i ON o.aid = i.aid;
+SELECT count(*) FROM test40g WHERE aid = 1;
+(SELECT * FROM test40g EXCEPT ALL SELECT * FROM test40p) ORDER BY id, v;
+(SELECT * FROM test40p EXCEPT ALL SELECT * FROM test40g) ORDER BY id, v;
+RESET pg_strom.enabled;
@@ -0,0 +1,974 @@
+/*
+ * gpu_microbench.cu
+ *
+ * Kernel-level microbenchmark of the device function libraries.
+ *
+ * It links the fatbin images of the device function libraries (built by
+ * the same rules of the extension) with cuda_microbench.fatbin, then runs
+ * the kernels that apply a particular pgfn_* function on the synthetic
+ * KDS_FORMAT_COLUMN / KDS_FORMAT_ARROW inputs. It reports the number of
+ * rows processed per second and the achieved device memory bandwidth,
+ * so we can evaluate the optimization of device functions independently
+ * from the planner and the data loading stuff.
+ *
+ * NOTE: This file contains only host code, but built by nvcc to use the
+ * definitions in cuda_common.h without PostgreSQL's server headers.
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cuda.h>
+#include "cuda_common.h"
+#include "cuda_microbench.h"
+
+#ifndef MICROBENCH_LIBDIR
+#define MICROBENCH_LIBDIR	"."
+#endif
+
+/*
+ * command line options
+ */
+static int			device_id = 0;
+static size_t		num_rows = 10000000;
+static int			num_loops = 10;
+static int			bench_formats = 0;
+static const char  *libdir = MICROBENCH_LIBDIR;
+static double		null_ratio = 0.0;
+static const char  *like_pattern = "%strom%";
+static cl_ulong		random_seed = 20210401;
+static int			machine_format = 0;
+
+#define BENCH_FORMAT__COLUMN	0x0001
+#define BENCH_FORMAT__ARROW		0x0002
+
+static const char *
+cuErrorName(CUresult error_code)
+{
+	const char *error_name;
+
+	if (cuGetErrorName(error_code, &error_name) != CUDA_SUCCESS)
+		error_name = "unknown error";
+	return error_name;
+}
+
+#define elog(fmt,...)								\
+	do {											\
+		fprintf(stderr, "gpu_microbench:%d  " fmt "\n",	\
+				__LINE__, ##__VA_ARGS__);			\
+		exit(1);									\
+	} while(0)
+
+/*
+ * Data types of the synthetic inputs
+ */
+typedef enum
+{
+	BENCH_TYPE__NONE = 0,
+	BENCH_TYPE__INT4,
+	BENCH_TYPE__INT8,
+	BENCH_TYPE__FLOAT8,
+	BENCH_TYPE__NUMERIC,
+	BENCH_TYPE__TEXT,
+	BENCH_TYPE__TIMESTAMP,
+} BenchType;
+
+/*
+ * Catalog of the microbenchmark kernels; must be in sync with the list
+ * in cuda_microbench.cu
+ */
+static struct {
+	const char *fname;			/* pgfn_<fname>, kern_microbench_<fname> */
+	const char *libname;		/* device library that has the function */
+	BenchType	atypes[2];		/* type of the column arguments */
+	BenchType	ctype;			/* type of the constant argument, if any */
+} bench_catalog[] = {
+	{ "int4pl",         "cuda_primitive",
+	  { BENCH_TYPE__INT4,      BENCH_TYPE__INT4 },    BENCH_TYPE__NONE },
+	{ "int8pl",         "cuda_primitive",
+	  { BENCH_TYPE__INT8,      BENCH_TYPE__INT8 },    BENCH_TYPE__NONE },
+	{ "int8mul",        "cuda_primitive",
+	  { BENCH_TYPE__INT8,      BENCH_TYPE__INT8 },    BENCH_TYPE__NONE },
+	{ "float8pl",       "cuda_primitive",
+	  { BENCH_TYPE__FLOAT8,    BENCH_TYPE__FLOAT8 },  BENCH_TYPE__NONE },
+	{ "float8mul",      "cuda_primitive",
+	  { BENCH_TYPE__FLOAT8,    BENCH_TYPE__FLOAT8 },  BENCH_TYPE__NONE },
+	{ "float8div",      "cuda_primitive",
+	  { BENCH_TYPE__FLOAT8,    BENCH_TYPE__FLOAT8 },  BENCH_TYPE__NONE },
+	{ "numeric_add",    "cuda_numeric",
+	  { BENCH_TYPE__NUMERIC,   BENCH_TYPE__NUMERIC }, BENCH_TYPE__NONE },
+	{ "numeric_mul",    "cuda_numeric",
+	  { BENCH_TYPE__NUMERIC,   BENCH_TYPE__NUMERIC }, BENCH_TYPE__NONE },
+	{ "numeric_lt",     "cuda_numeric",
+	  { BENCH_TYPE__NUMERIC,   BENCH_TYPE__NUMERIC }, BENCH_TYPE__NONE },
+	{ "texteq",         "cuda_textlib",
+	  { BENCH_TYPE__TEXT,      BENCH_TYPE__TEXT },    BENCH_TYPE__NONE },
+	{ "text_lt",        "cuda_textlib",
+	  { BENCH_TYPE__TEXT,      BENCH_TYPE__TEXT },    BENCH_TYPE__NONE },
+	{ "textlike",       "cuda_textlib",
+	  { BENCH_TYPE__TEXT,      BENCH_TYPE__NONE },    BENCH_TYPE__TEXT },
+	{ "timestamp_date", "cuda_timelib",
+	  { BENCH_TYPE__TIMESTAMP, BENCH_TYPE__NONE },    BENCH_TYPE__NONE },
+	{ NULL, NULL, { BENCH_TYPE__NONE, BENCH_TYPE__NONE }, BENCH_TYPE__NONE },
+};
+
+/* libraries to be linked, in addition to the cuda_microbench */
+static const char *bench_libraries[] = {
+	"cuda_common",
+	"cuda_numeric",
+	"cuda_primitive",
+	"cuda_textlib",
+	"cuda_timelib",
+	"cuda_microbench",
+	NULL,
+};
+
+/*
+ * A column of the synthetic input
+ */
+typedef struct
+{
+	kern_colmeta cmeta;		/* offsets are not packed yet */
+	char	   *nullmap;
+	size_t		nullmap_len;
+	char	   *values;
+	size_t		values_len;
+	char	   *extra;
+	size_t		extra_len;
+} BenchColumn;
+
+/*
+ * Random number generator (splitmix64); the input is determined by the
+ * seed, the column index and the row index only.
+ */
+static inline cl_ulong
+bench_random(cl_ulong seed, cl_ulong index)
+{
+	cl_ulong	z = seed + (index + 1) * 0x9e3779b97f4a7c15UL;
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+	return z ^ (z >> 31);
+}
+
+static void *
+bench_malloc(size_t sz)
+{
+	void   *ptr = calloc(1, Max(sz, 1));
+
+	if (!ptr)
+		elog("out of memory");
+	return ptr;
+}
+
+/*
+ * bench_make_text - makes a random string of 8-40 characters, and ~10% of
+ * them contain the token "strom" to be matched with the default pattern.
+ */
+static int
+bench_make_text(char *buf, cl_ulong rnd)
+{
+	static const char *alphabet = "abcdefghijklmnopqrstuvwxyz0123456789 ";
+	int		len = 8 + (rnd % 33);
+	int		i;
+
+	rnd >>= 6;
+	for (i=0; i < len; i++)
+	{
+		buf[i] = alphabet[rnd % 37];
+		rnd = bench_random(rnd, i);
+	}
+	if (rnd % 10 == 0)
+		memcpy(buf + (rnd >> 8) % (len - 4), "strom", 5);
+	return len;
+}
+
+/*
+ * bench_text_seed - odd rows of the second text column are different
+ */
+static inline cl_ulong
+bench_text_seed(cl_ulong seed, int colidx, size_t rowidx)
+{
+	return (colidx > 0 && (rowidx & 1) != 0 ? seed ^ 0x5555UL : seed);
+}
+
+/*
+ * bench_make_numeric - makes a numeric varlena of PostgreSQL from the
+ * unscaled value with 2 digits after the decimal point.
+ */
+#define BENCH_NBASE						10000
+#define BENCH_NUMERIC_SHORT				0x8000
+#define BENCH_NUMERIC_SHORT_SIGN_MASK	0x2000
+#define BENCH_NUMERIC_SHORT_DSCALE_SHIFT 7
+#define BENCH_NUMERIC_SHORT_DSCALE_MASK	0x1F80
+#define BENCH_NUMERIC_SHORT_WEIGHT_SIGN	0x0040
+#define BENCH_NUMERIC_SHORT_WEIGHT_MASK	0x003F
+
+static int
+bench_make_numeric(char *buf, cl_long value)
+{
+	cl_ushort	digits[8];
+	cl_ushort	n_header;
+	cl_ulong	ival = (value < 0 ? -value : value) / 100;
+	cl_uint		fval = (value < 0 ? -value : value) % 100;
+	int			ndigits = 0;
+	int			weight = -1;
+	int			i, len;
+
+	/* integer part; most significant digit first */
+	while (ival > 0)
+	{
+		memmove(digits + 1, digits, sizeof(cl_ushort) * ndigits);
+		digits[0] = ival % BENCH_NBASE;
+		ival /= BENCH_NBASE;
+		ndigits++;
+		weight++;
+	}
+	/* fractional part (2 digits are at the top of NBASE digit) */
+	if (fval != 0)
+		digits[ndigits++] = fval * 100;
+	/* strip trailing zeroes (PostgreSQL never stores them) */
+	while (ndigits > 0 && digits[ndigits-1] == 0)
+		ndigits--;
+	if (ndigits == 0)
+		weight = 0;
+
+	n_header = (BENCH_NUMERIC_SHORT |
+				(value < 0 ? BENCH_NUMERIC_SHORT_SIGN_MASK : 0) |
+				((2 << BENCH_NUMERIC_SHORT_DSCALE_SHIFT)
+				 & BENCH_NUMERIC_SHORT_DSCALE_MASK) |
+				(weight < 0 ? BENCH_NUMERIC_SHORT_WEIGHT_SIGN : 0) |
+				(weight & BENCH_NUMERIC_SHORT_WEIGHT_MASK));
+	len = VARHDRSZ + sizeof(cl_ushort) * (1 + ndigits);
+	SET_VARSIZE(buf, len);
+	memcpy(buf + VARHDRSZ, &n_header, sizeof(cl_ushort));
+	for (i=0; i < ndigits; i++)
+		memcpy(buf + VARHDRSZ + sizeof(cl_ushort) * (i+1),
+			   &digits[i], sizeof(cl_ushort));
+	return len;
+}
+
+/*
+ * bench_setup_column - generates a synthetic column
+ */
+static void
+bench_setup_column(BenchColumn *bcol, BenchType btype,
+				   int format, int colidx, cl_ulong seed)
+{
+	kern_colmeta *cmeta = &bcol->cmeta;
+	size_t		i, unitsz = 0;
+	char		temp[64];
+
+	memset(bcol, 0, sizeof(BenchColumn));
+	cmeta->attnum = colidx + 1;
+	cmeta->attcacheoff = -1;
+	cmeta->atttypmod = -1;
+	cmeta->atttypkind = TYPE_KIND__BASE;
+	/*
+	 * text columns share the seed, because texteq and text_lt want half
+	 * of the rows are identical to c0; see bench_text_seed().
+	 */
+	if (btype != BENCH_TYPE__TEXT)
+		seed ^= (cl_ulong)colidx << 32;
+	snprintf(cmeta->attname.data, NAMEDATALEN, "c%d", colidx);
+
+	/* nullmap */
+	if (null_ratio > 0.0)
+	{
+		bcol->nullmap_len = MAXALIGN(BITMAPLEN(num_rows));
+		bcol->nullmap = (char *)bench_malloc(bcol->nullmap_len);
+		for (i=0; i < num_rows; i++)
+		{
+			cl_ulong	rnd = bench_random(seed ^ 0xdeadbeafUL, i);
+
+			if ((double)(rnd % 1000000) / 1000000.0 >= null_ratio)
+				bcol->nullmap[i>>3] |= (1 << (i & 7));
+		}
+	}
+
+	switch (btype)
+	{
+		case BENCH_TYPE__INT4:
+			cmeta->attbyval = true;
+			cmeta->attalign = sizeof(cl_int);
+			cmeta->attlen = sizeof(cl_int);
+			unitsz = sizeof(cl_int);
+			break;
+		case BENCH_TYPE__INT8:
+		case BENCH_TYPE__FLOAT8:
+		case BENCH_TYPE__TIMESTAMP:
+			cmeta->attbyval = true;
+			cmeta->attalign = sizeof(cl_long);
+			cmeta->attlen = sizeof(cl_long);
+			unitsz = sizeof(cl_long);
+			if (btype == BENCH_TYPE__TIMESTAMP)
+				cmeta->attopts.timestamp.unit = ArrowTimeUnit__MicroSecond;
+			break;
+		case BENCH_TYPE__NUMERIC:
+			cmeta->attbyval = false;
+			cmeta->attalign = sizeof(cl_int);
+			cmeta->attlen = -1;
+			cmeta->attopts.decimal.precision = 18;
+			cmeta->attopts.decimal.scale = 2;
+			/* Arrow::Decimal128 is a fixed-length value */
+			if (format == KDS_FORMAT_ARROW)
+				unitsz = 2 * sizeof(cl_ulong);
+			break;
+		case BENCH_TYPE__TEXT:
+			cmeta->attbyval = false;
+			cmeta->attalign = sizeof(cl_int);
+			cmeta->attlen = -1;
+			break;
+		default:
+			elog("unexpected benchmark type: %d", (int)btype);
+	}
+
+	if (unitsz > 0)
+	{
+		/* fixed-length values */
+		bcol->values_len = MAXALIGN(unitsz * num_rows);
+		bcol->values = (char *)bench_malloc(bcol->values_len);
+		for (i=0; i < num_rows; i++)
+		{
+			cl_ulong	rnd = bench_random(seed, i);
+			char	   *addr = bcol->values + unitsz * i;
+
+			switch (btype)
+			{
+				case BENCH_TYPE__INT4:
+					*((cl_int *)addr) = (cl_int)(rnd % 2000001) - 1000000;
+					break;
+				case BENCH_TYPE__INT8:
+					*((cl_long *)addr) = (cl_long)(rnd % 2000001) - 1000000;
+					break;
+				case BENCH_TYPE__FLOAT8:
+					/* never zero, for float8div */
+					*((cl_double *)addr) = 1.0 + (double)(rnd % 1000000) / 1000.0;
+					break;
+				case BENCH_TYPE__TIMESTAMP:
+					/* 2000-01-01 ... 2030-12-31 */
+					*((cl_long *)addr) = (cl_long)(rnd % (11323 * USECS_PER_DAY));
+					if (format == KDS_FORMAT_ARROW)
+						*((cl_long *)addr) += ((POSTGRES_EPOCH_JDATE -
+												UNIX_EPOCH_JDATE) * USECS_PER_DAY);
+					break;
+				case BENCH_TYPE__NUMERIC:
+					/* Decimal128; unscaled value with sign extension */
+					((cl_long *)addr)[0] = (cl_long)(rnd % 200000001) - 100000000;
+					((cl_long *)addr)[1] = (((cl_long *)addr)[0] < 0 ? -1 : 0);
+					break;
+				default:
+					elog("unexpected benchmark type: %d", (int)btype);
+			}
+		}
+	}
+	else if (format == KDS_FORMAT_ARROW)
+	{
+		/* Arrow::Utf8 - offset array and the body of strings */
+		cl_uint	   *offsets;
+		cl_ulong	rnd;
+		size_t		usage = 0;
+
+		bcol->values_len = MAXALIGN(sizeof(cl_uint) * (num_rows + 1));
+		bcol->values = (char *)bench_malloc(bcol->values_len);
+		bcol->extra = (char *)bench_malloc(40 * num_rows);
+		offsets = (cl_uint *)bcol->values;
+		for (i=0; i < num_rows; i++)
+		{
+			offsets[i] = usage;
+			rnd = bench_random(bench_text_seed(seed, colidx, i), i);
+			usage += bench_make_text(bcol->extra + usage, rnd);
+		}
+		offsets[num_rows] = usage;
+		bcol->extra_len = MAXALIGN(usage);
+	}
+	else
+	{
+		/*
+		 * varlena of KDS_FORMAT_COLUMN; values has packed offset from the
+		 * head of kern_data_extra. It is adjusted by bench_setup_buffer().
+		 */
+		cl_uint	   *offsets;
+		cl_ulong	rnd;
+		size_t		usage = 0;
+
+		bcol->values_len = MAXALIGN(sizeof(cl_uint) * num_rows);
+		bcol->values = (char *)bench_malloc(bcol->values_len);
+		bcol->extra = (char *)bench_malloc(MAXALIGN(VARHDRSZ + 40) * num_rows);
+		offsets = (cl_uint *)bcol->values;
+		for (i=0; i < num_rows; i++)
+		{
+			char   *vl = bcol->extra + usage;
+			int		len;
+
+			if (btype == BENCH_TYPE__NUMERIC)
+			{
+				rnd = bench_random(seed, i);
+				len = bench_make_numeric(vl, (cl_long)(rnd % 200000001)
+										 - 100000000);
+			}
+			else
+			{
+				rnd = bench_random(bench_text_seed(seed, colidx, i), i);
+				len = bench_make_text(temp, rnd);
+				SET_VARSIZE(vl, VARHDRSZ + len);
+				memcpy(vl + VARHDRSZ, temp, len);
+				len += VARHDRSZ;
+			}
+			offsets[i] = usage;
+			usage += MAXALIGN(len);
+		}
+		bcol->extra_len = usage;
+	}
+}
+
+/*
+ * bench_setup_buffer - assembles the KDS (and the extra buffer) for the
+ * supplied columns, then returns the number of bytes to be scanned.
+ */
+static size_t
+bench_setup_buffer(BenchColumn *bcols, int ncols, int format,
+				   kern_data_store **p_kds, size_t *p_kds_len,
+				   kern_data_extra **p_extra, size_t *p_extra_len)
+{
+	kern_data_store *kds;
+	kern_data_extra *extra = NULL;
+	size_t		head_sz = STROMALIGN(offsetof(kern_data_store,
+											  colmeta[ncols]));
+	size_t		kds_len = head_sz;
+	size_t		extra_len = 0;
+	size_t		scan_sz = 0;
+	size_t		pos;
+	int			j;
+
+	for (j=0; j < ncols; j++)
+	{
+		kds_len += bcols[j].nullmap_len + bcols[j].values_len;
+		if (format == KDS_FORMAT_ARROW)
+			kds_len += bcols[j].extra_len;
+		else
+			extra_len += bcols[j].extra_len;
+	}
+	if (extra_len > 0)
+		extra_len += offsetof(kern_data_extra, data);
+	if (kds_len >= KDS_OFFSET_MAX_SIZE || extra_len >= KDS_OFFSET_MAX_SIZE)
+		elog("too large input buffer, reduce the number of rows");
+
+	kds = (kern_data_store *)bench_malloc(kds_len);
+	kds->length = kds_len;
+	kds->nitems = num_rows;
+	kds->nrooms = num_rows;
+	kds->ncols = ncols;
+	kds->format = format;
+	kds->tdtypmod = -1;
+	kds->nr_colmeta = ncols;
+	if (extra_len > 0)
+	{
+		extra = (kern_data_extra *)bench_malloc(extra_len);
+		extra->length = extra_len;
+		extra->usage = offsetof(kern_data_extra, data);
+	}
+
+	pos = head_sz;
+	for (j=0; j < ncols; j++)
+	{
+		BenchColumn *bcol = &bcols[j];
+		kern_colmeta *cmeta = &kds->colmeta[j];
+
+		memcpy(cmeta, &bcol->cmeta, sizeof(kern_colmeta));
+		if (bcol->nullmap_len > 0)
+		{
+			memcpy((char *)kds + pos, bcol->nullmap, bcol->nullmap_len);
+			cmeta->nullmap_offset = (pos >> MAXIMUM_ALIGNOF_SHIFT);
+			cmeta->nullmap_length = (bcol->nullmap_len >> MAXIMUM_ALIGNOF_SHIFT);
+			pos += bcol->nullmap_len;
+		}
+		if (format == KDS_FORMAT_COLUMN && bcol->extra_len > 0)
+		{
+			cl_uint	   *offsets = (cl_uint *)bcol->values;
+			size_t		i;
+
+			for (i=0; i < num_rows; i++)
+				offsets[i] = (extra->usage + offsets[i]) >> MAXIMUM_ALIGNOF_SHIFT;
+			memcpy((char *)extra + extra->usage, bcol->extra, bcol->extra_len);
+			extra->usage += bcol->extra_len;
+			kds->has_varlena = true;
+		}
+		memcpy((char *)kds + pos, bcol->values, bcol->values_len);
+		cmeta->values_offset = (pos >> MAXIMUM_ALIGNOF_SHIFT);
+		cmeta->values_length = (bcol->values_len >> MAXIMUM_ALIGNOF_SHIFT);
+		pos += bcol->values_len;
+		if (format == KDS_FORMAT_ARROW && bcol->extra_len > 0)
+		{
+			memcpy((char *)kds + pos, bcol->extra, bcol->extra_len);
+			cmeta->extra_offset = (pos >> MAXIMUM_ALIGNOF_SHIFT);
+			cmeta->extra_length = (bcol->extra_len >> MAXIMUM_ALIGNOF_SHIFT);
+			pos += bcol->extra_len;
+			kds->has_varlena = true;
+		}
+		scan_sz += bcol->nullmap_len + bcol->values_len + bcol->extra_len;
+	}
+	assert(pos == kds_len);
+	kds->usage = ((kds_len - head_sz) >> MAXIMUM_ALIGNOF_SHIFT);
+
+	*p_kds = kds;
+	*p_kds_len = kds_len;
+	*p_extra = extra;
+	*p_extra_len = extra_len;
+
+	return scan_sz;
+}
+
+/*
+ * bench_setup_control - builds kern_microbench with the constant argument
+ */
+static kern_microbench *
+bench_setup_control(BenchType ctype, size_t *p_length)
+{
+	kern_microbench *kmbench;
+	size_t		plen = STROMALIGN(offsetof(kern_parambuf, poffset[1]));
+	size_t		vlen = 0;
+	size_t		length;
+
+	if (ctype == BENCH_TYPE__TEXT)
+		vlen = MAXALIGN(VARHDRSZ + strlen(like_pattern));
+	else if (ctype != BENCH_TYPE__NONE)
+		elog("unexpected type of the constant argument: %d", (int)ctype);
+
+	length = offsetof(kern_microbench, kparams) + plen + vlen;
+	kmbench = (kern_microbench *)bench_malloc(length);
+	kmbench->kparams.length = plen + vlen;
+	kmbench->kparams.nparams = 1;
+	if (vlen > 0)
+	{
+		char   *vl = (char *)&kmbench->kparams + plen;
+
+		SET_VARSIZE(vl, VARHDRSZ + strlen(like_pattern));
+		memcpy(vl + VARHDRSZ, like_pattern, strlen(like_pattern));
+		kmbench->kparams.poffset[0] = plen;
+	}
+	assert(KERN_MICROBENCH_LENGTH(kmbench) == STROMALIGN(length));
+	*p_length = length;
+
+	return kmbench;
+}
+
+/*
+ * bench_link_module - links the device libraries and cuda_microbench
+ */
+static CUmodule
+bench_link_module(void)
+{
+	CUlinkState	lstate;
+	CUjit_option jit_options[2];
+	void	   *jit_option_values[2];
+	char		log_buffer[16384];
+	char		pathname[1024];
+	void	   *bin_image;
+	size_t		bin_length;
+	CUmodule	cuda_module;
+	CUresult	rc;
+	int			i;
+
+	jit_options[0] = CU_JIT_ERROR_LOG_BUFFER;
+	jit_option_values[0] = (void *)log_buffer;
+	jit_options[1] = CU_JIT_ERROR_LOG_BUFFER_SIZE_BYTES;
+	jit_option_values[1] = (void *)sizeof(log_buffer);
+
+	rc = cuLinkCreate(2, jit_options, jit_option_values, &lstate);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuLinkCreate: %s", cuErrorName(rc));
+	for (i=0; bench_libraries[i] != NULL; i++)
+	{
+		snprintf(pathname, sizeof(pathname), "%s/%s.fatbin",
+				 libdir, bench_libraries[i]);
+		rc = cuLinkAddFile(lstate, CU_JIT_INPUT_FATBINARY,
+						   pathname, 0, NULL, NULL);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuLinkAddFile(\"%s\"): %s",
+				 pathname, cuErrorName(rc));
+	}
+	rc = cuLinkComplete(lstate, &bin_image, &bin_length);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuLinkComplete: %s\nLog: %s",
+			 cuErrorName(rc), log_buffer);
+	rc = cuModuleLoadData(&cuda_module, bin_image);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuModuleLoadData: %s", cuErrorName(rc));
+	rc = cuLinkDestroy(lstate);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuLinkDestroy: %s", cuErrorName(rc));
+
+	return cuda_module;
+}
+
+/*
+ * bench_run - runs a microbenchmark kernel on the supplied format
+ */
+static void
+bench_run(CUmodule cuda_module, int index, int format, double peak_bw)
+{
+	const char *fname = bench_catalog[index].fname;
+	BenchColumn	bcols[2];
+	int			ncols = 0;
+	kern_data_store *kds;
+	kern_data_extra *extra;
+	kern_microbench *kmbench;
+	size_t		kds_len;
+	size_t		extra_len;
+	size_t		kmbench_len;
+	size_t		scan_sz;
+	char		kfunc_name[200];
+	CUfunction	kern_function;
+	CUdeviceptr	m_kds;
+	CUdeviceptr	m_extra = 0UL;
+	CUdeviceptr	m_kmbench;
+	CUevent		ev_start;
+	CUevent		ev_stop;
+	int			min_grid_sz;
+	int			max_block_sz;
+	float		elapsed_ms;
+	double		rows_per_sec;
+	double		bandwidth;
+	void	   *kern_args[3];
+	CUresult	rc;
+	int			i, j;
+
+	snprintf(kfunc_name, sizeof(kfunc_name), "kern_microbench_%s", fname);
+	rc = cuModuleGetFunction(&kern_function, cuda_module, kfunc_name);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuModuleGetFunction('%s'): %s",
+			 kfunc_name, cuErrorName(rc));
+
+	/* setup the synthetic inputs */
+	for (j=0; j < 2; j++)
+	{
+		if (bench_catalog[index].atypes[j] == BENCH_TYPE__NONE)
+			break;
+		bench_setup_column(&bcols[j], bench_catalog[index].atypes[j],
+						   format, j, random_seed);
+		ncols++;
+	}
+	scan_sz = bench_setup_buffer(bcols, ncols, format,
+								 &kds, &kds_len,
+								 &extra, &extra_len);
+	kmbench = bench_setup_control(bench_catalog[index].ctype, &kmbench_len);
+
+	/* move them to the device memory */
+	rc = cuMemAlloc(&m_kds, kds_len);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	rc = cuMemcpyHtoD(m_kds, kds, kds_len);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemcpyHtoD: %s", cuErrorName(rc));
+	if (extra)
+	{
+		rc = cuMemAlloc(&m_extra, extra_len);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+		rc = cuMemcpyHtoD(m_extra, extra, extra_len);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuMemcpyHtoD: %s", cuErrorName(rc));
+	}
+	rc = cuMemAlloc(&m_kmbench, kmbench_len);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+
+	rc = cuOccupancyMaxPotentialBlockSize(&min_grid_sz,
+										  &max_block_sz,
+										  kern_function,
+										  0, 0, 0);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuOccupancyMaxPotentialBlockSize: %s",
+			 cuErrorName(rc));
+	kern_args[0] = &m_kmbench;
+	kern_args[1] = &m_kds;
+	kern_args[2] = &m_extra;
+
+	if ((rc = cuEventCreate(&ev_start, CU_EVENT_DEFAULT)) != CUDA_SUCCESS ||
+		(rc = cuEventCreate(&ev_stop, CU_EVENT_DEFAULT)) != CUDA_SUCCESS)
+		elog("failed on cuEventCreate: %s", cuErrorName(rc));
+
+	/* the first round is a warm-up, not measured */
+	for (i=0; i <= num_loops; i++)
+	{
+		rc = cuMemcpyHtoD(m_kmbench, kmbench, kmbench_len);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuMemcpyHtoD: %s", cuErrorName(rc));
+		if (i == 1)
+		{
+			rc = cuEventRecord(ev_start, NULL);
+			if (rc != CUDA_SUCCESS)
+				elog("failed on cuEventRecord: %s", cuErrorName(rc));
+		}
+		rc = cuLaunchKernel(kern_function,
+							min_grid_sz, 1, 1,
+							max_block_sz, 1, 1,
+							0, NULL,
+							kern_args,
+							NULL);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuLaunchKernel: %s", cuErrorName(rc));
+	}
+	rc = cuEventRecord(ev_stop, NULL);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventRecord: %s", cuErrorName(rc));
+	rc = cuEventSynchronize(ev_stop);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventSynchronize: %s", cuErrorName(rc));
+	rc = cuEventElapsedTime(&elapsed_ms, ev_start, ev_stop);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuEventElapsedTime: %s", cuErrorName(rc));
+
+	/* check the results of the last round */
+	rc = cuMemcpyDtoH(kmbench, m_kmbench, offsetof(kern_microbench, kparams));
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemcpyDtoH: %s", cuErrorName(rc));
+	if (kmbench->kerror.errcode != ERRCODE_STROM_SUCCESS)
+		elog("pgfn_%s: %s (code=%d, %s:%d at %s)",
+			 fname,
+			 kmbench->kerror.message,
+			 kmbench->kerror.errcode,
+			 kmbench->kerror.filename,
+			 kmbench->kerror.lineno,
+			 kmbench->kerror.funcname);
+
+	rows_per_sec = ((double)num_rows * (double)num_loops /
+					((double)elapsed_ms / 1000.0));
+	bandwidth = ((double)scan_sz * (double)num_loops /
+				 ((double)elapsed_ms / 1000.0));
+	if (machine_format)
+		printf("%s,%s,%zu,%d,%.3f,%.0f,%.3f,%.1f,%lu\n",
+			   fname,
+			   format == KDS_FORMAT_ARROW ? "arrow" : "column",
+			   num_rows, num_loops,
+			   elapsed_ms / (double)num_loops,
+			   rows_per_sec,
+			   bandwidth / 1.0e9,
+			   100.0 * bandwidth / peak_bw,
+			   (unsigned long)kmbench->nvalids);
+	else
+		printf("%-16s %-7s %10.3f %10.2f %9.2f %6.1f%% %12lu\n",
+			   fname,
+			   format == KDS_FORMAT_ARROW ? "arrow" : "column",
+			   elapsed_ms / (double)num_loops,
+			   rows_per_sec / 1.0e6,
+			   bandwidth / 1.0e9,
+			   100.0 * bandwidth / peak_bw,
+			   (unsigned long)kmbench->nvalids);
+
+	/* cleanup */
+	cuEventDestroy(ev_start);
+	cuEventDestroy(ev_stop);
+	cuMemFree(m_kmbench);
+	if (m_extra)
+		cuMemFree(m_extra);
+	cuMemFree(m_kds);
+	for (j=0; j < ncols; j++)
+	{
+		free(bcols[j].nullmap);
+		free(bcols[j].values);
+		free(bcols[j].extra);
+	}
+	free(kmbench);
+	free(extra);
+	free(kds);
+}
+
+static void
+usage(const char *argv0, int exitcode)
+{
+	int		i;
+
+	fprintf(stderr,
+			"usage: %s [OPTIONS] [<function> ...]\n"
+			"\n"
+			"Options:\n"
+			"  -d, --device=DEVICE_ID   GPU device to run (default: 0)\n"
+			"  -n, --nrows=NROWS        number of rows (default: 10000000)\n"
+			"  -l, --loops=LOOPS        number of measured loops (default: 10)\n"
+			"  -f, --format=FORMAT      'column', 'arrow' or 'all' (default: all)\n"
+			"  -L, --libdir=DIR         directory of *.fatbin (default: %s)\n"
+			"  -N, --null-ratio=RATIO   ratio of NULLs in 0.0-1.0 (default: 0.0)\n"
+			"  -P, --pattern=PATTERN    pattern of textlike (default: '%%strom%%')\n"
+			"  -s, --seed=SEED          seed of the synthetic inputs\n"
+			"  -m, --machine-format     print results in CSV\n"
+			"  -h, --help               print this message\n"
+			"\n"
+			"Functions:\n ",
+			argv0, MICROBENCH_LIBDIR);
+	for (i=0; bench_catalog[i].fname != NULL; i++)
+		fprintf(stderr, " %s", bench_catalog[i].fname);
+	fprintf(stderr, "\n");
+	exit(exitcode);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static struct option long_options[] = {
+		{"device",         required_argument, NULL, 'd'},
+		{"nrows",          required_argument, NULL, 'n'},
+		{"loops",          required_argument, NULL, 'l'},
+		{"format",         required_argument, NULL, 'f'},
+		{"libdir",         required_argument, NULL, 'L'},
+		{"null-ratio",     required_argument, NULL, 'N'},
+		{"pattern",        required_argument, NULL, 'P'},
+		{"seed",           required_argument, NULL, 's'},
+		{"machine-format", no_argument,       NULL, 'm'},
+		{"help",           no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	CUdevice	cuda_device;
+	CUcontext	cuda_context;
+	CUmodule	cuda_module;
+	CUresult	rc;
+	char		dev_name[256];
+	int			mem_clock;
+	int			mem_width;
+	double		peak_bw;
+	char	   *end;
+	int			c, i, j;
+
+	while ((c = getopt_long(argc, argv, "d:n:l:f:L:N:P:s:mh",
+							long_options, NULL)) >= 0)
+	{
+		switch (c)
+		{
+			case 'd':
+				device_id = strtol(optarg, &end, 10);
+				if (*end != '\0' || device_id < 0)
+					elog("invalid device id: %s", optarg);
+				break;
+			case 'n':
+				num_rows = strtoul(optarg, &end, 10);
+				if (*end != '\0' || num_rows == 0 || num_rows > UINT_MAX)
+					elog("invalid number of rows: %s", optarg);
+				break;
+			case 'l':
+				num_loops = strtol(optarg, &end, 10);
+				if (*end != '\0' || num_loops <= 0)
+					elog("invalid number of loops: %s", optarg);
+				break;
+			case 'f':
+				if (strcmp(optarg, "column") == 0)
+					bench_formats |= BENCH_FORMAT__COLUMN;
+				else if (strcmp(optarg, "arrow") == 0)
+					bench_formats |= BENCH_FORMAT__ARROW;
+				else if (strcmp(optarg, "all") == 0)
+					bench_formats |= (BENCH_FORMAT__COLUMN |
+									  BENCH_FORMAT__ARROW);
+				else
+					elog("unknown format: %s", optarg);
+				break;
+			case 'L':
+				libdir = optarg;
+				break;
+			case 'N':
+				null_ratio = strtod(optarg, &end);
+				if (*end != '\0' || null_ratio < 0.0 || null_ratio > 1.0)
+					elog("invalid ratio of NULLs: %s", optarg);
+				break;
+			case 'P':
+				like_pattern = optarg;
+				break;
+			case 's':
+				random_seed = strtoul(optarg, &end, 10);
+				if (*end != '\0')
+					elog("invalid seed: %s", optarg);
+				break;
+			case 'm':
+				machine_format = 1;
+				break;
+			case 'h':
+				usage(argv[0], 0);
+				break;
+			default:
+				usage(argv[0], 1);
+				break;
+		}
+	}
+	if (bench_formats == 0)
+		bench_formats = (BENCH_FORMAT__COLUMN | BENCH_FORMAT__ARROW);
+	/* validation of the function names */
+	for (j=optind; j < argc; j++)
+	{
+		for (i=0; bench_catalog[i].fname != NULL; i++)
+		{
+			if (strcmp(argv[j], bench_catalog[i].fname) == 0)
+				break;
+		}
+		if (!bench_catalog[i].fname)
+			elog("unknown function: %s", argv[j]);
+	}
+
+	/* init CUDA context */
+	rc = cuInit(0);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuInit: %s", cuErrorName(rc));
+	rc = cuDeviceGet(&cuda_device, device_id);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGet: %s", cuErrorName(rc));
+	rc = cuDeviceGetName(dev_name, sizeof(dev_name), cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGetName: %s", cuErrorName(rc));
+	rc = cuDeviceGetAttribute(&mem_clock,
+							  CU_DEVICE_ATTRIBUTE_MEMORY_CLOCK_RATE,
+							  cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGetAttribute: %s", cuErrorName(rc));
+	rc = cuDeviceGetAttribute(&mem_width,
+							  CU_DEVICE_ATTRIBUTE_GLOBAL_MEMORY_BUS_WIDTH,
+							  cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGetAttribute: %s", cuErrorName(rc));
+	/* theoretical peak; memory clock is in kHz, DDR */
+	peak_bw = 2.0 * (double)mem_clock * 1000.0 * (double)(mem_width / 8);
+
+	rc = cuCtxCreate(&cuda_context, CU_CTX_SCHED_AUTO, cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuCtxCreate: %s", cuErrorName(rc));
+	cuda_module = bench_link_module();
+
+	if (machine_format)
+		printf("function,format,nrows,loops,time_ms,rows_per_sec,"
+			   "bandwidth_gbps,peak_ratio,nvalids\n");
+	else
+	{
+		printf("GPU%d %s (peak memory bandwidth: %.1fGB/s), "
+			   "nrows=%zu, loops=%d, null-ratio=%.2f\n",
+			   device_id, dev_name, peak_bw / 1.0e9,
+			   num_rows, num_loops, null_ratio);
+		printf("%-16s %-7s %10s %10s %9s %7s %12s\n",
+			   "function", "format", "time[ms]", "Mrows/s",
+			   "GB/s", "peak", "nvalids");
+	}
+	for (i=0; bench_catalog[i].fname != NULL; i++)
+	{
+		if (optind < argc)
+		{
+			for (j=optind; j < argc; j++)
+			{
+				if (strcmp(argv[j], bench_catalog[i].fname) == 0)
+					break;
+			}
+			if (j == argc)
+				continue;
+		}
+		if ((bench_formats & BENCH_FORMAT__COLUMN) != 0)
+			bench_run(cuda_module, i, KDS_FORMAT_COLUMN, peak_bw);
+		if ((bench_formats & BENCH_FORMAT__ARROW) != 0)
+			bench_run(cuda_module, i, KDS_FORMAT_ARROW, peak_bw);
+	}
+	cuModuleUnload(cuda_module);
+	cuCtxDestroy(cuda_context);
+
+	return 0;
+}
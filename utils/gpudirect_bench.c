@@ -0,0 +1,1274 @@
+/*
+ * gpudirect_bench.c
+ *
+ * Utility program to benchmark the I/O paths from the storage to the GPU
+ * device memory; GPUDirect SQL (by HeteroDB Extra module), the buffered
+ * read, the direct read (O_DIRECT) and io_uring, with various chunk sizes,
+ * queue depths and file layouts. It reports the throughput and the CPU
+ * cost of each configuration, then recommends the configuration of
+ * pg_strom.gpudirect_threshold and pg_strom.gpu_memory_segment_size for
+ * the host.
+ *
+ * NOTE: Like gpuinfo, this program is launched separately from PostgreSQL
+ * processes; it does not touch the database itself, so run it on the
+ * files on the tablespace to be evaluated (e.g, segment files of the heap
+ * table, or Apache Arrow files).
+ * ----
+ * Copyright 2011-2021 (C) KaiGai Kohei <kaigai@kaigai.gr.jp>
+ * Copyright 2014-2021 (C) PG-Strom Developers Team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the PostgreSQL License.
+ */
+#define _GNU_SOURCE
+#include <assert.h>
+#include <ctype.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <cuda.h>
+#include <pg_config.h>
+#include <heterodb_extra.h>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING	1
+#endif
+#endif
+
+#define lengthof(array)			(sizeof (array) / sizeof ((array)[0]))
+#define Max(a,b)				((a) > (b) ? (a) : (b))
+#define Min(a,b)				((a) < (b) ? (a) : (b))
+#define BLCKSZ_ALIGN(x)			(((x) / BLCKSZ) * BLCKSZ)
+/* see pgstrom_chunk_size() */
+#define PGSTROM_CHUNK_SIZE		(65534UL << 10)
+/* see GPUMEM_CHUNKSZ_MAX in gpu_mmgr.c */
+#define GPU_SEGMENT_SIZE_MAX	(1UL << 30)
+
+#define elog(fmt,...)								\
+	do {											\
+		fprintf(stderr, "gpudirect_bench:%d  " fmt "\n",	\
+				__LINE__, ##__VA_ARGS__);			\
+		exit(1);									\
+	} while(0)
+
+static const char *
+cuErrorName(CUresult error_code)
+{
+	const char *error_name;
+
+	if (cuGetErrorName(error_code, &error_name) != CUDA_SUCCESS)
+		error_name = "unknown error";
+	return error_name;
+}
+
+/*
+ * I/O methods to be evaluated
+ */
+#define IOMETHOD__GPUDIRECT		0	/* GPUDirect SQL (HeteroDB Extra) */
+#define IOMETHOD__BUFFERED		1	/* pread(2) + cuMemcpyHtoD, cold cache */
+#define IOMETHOD__CACHED		2	/* pread(2) + cuMemcpyHtoD, warm cache */
+#define IOMETHOD__DIRECT		3	/* pread(2) with O_DIRECT + cuMemcpyHtoD */
+#define IOMETHOD__IO_URING		4	/* io_uring with O_DIRECT + cuMemcpyHtoD */
+#define NUM_IOMETHODS			5
+
+static const char *iomethod_names[] = {
+	"gpudirect",
+	"buffered",
+	"cached",
+	"direct",
+	"io_uring",
+};
+
+/*
+ * command line options
+ */
+static int			device_id = 0;
+static int			iomethod_mask = 0;
+static size_t		chunk_sizes[32];
+static int			num_chunk_sizes = 0;
+static int			queue_depths[32];
+static int			num_queue_depths = 0;
+static int			arrow_layout = 0;		/* 0 = heap, 1 = arrow */
+static int			arrow_ncols_read = 4;
+static int			arrow_ncols_total = 16;
+static size_t		total_read_limit = (8UL << 30);
+static size_t		shared_buffers_sz = 0;		/* 0 = 25% of RAM */
+static int			machine_format = 0;
+
+/*
+ * Input files
+ */
+typedef struct
+{
+	const char *pathname;
+	int			fdesc;			/* for the buffered read */
+	int			fdesc_direct;	/* with O_DIRECT */
+	size_t		filesize;		/* aligned to BLCKSZ */
+	GPUDirectFileDesc gds_fdesc;
+	int			gds_opened;
+} BenchFile;
+
+static BenchFile   *bench_files = NULL;
+static int			num_bench_files = 0;
+
+/*
+ * I/O requests; a request reads a chunk, which consists of one or more
+ * fragments. A fragment of the heap layout is the whole chunk, and a chunk
+ * of the arrow layout consists of the fragments of the referenced columns
+ * in a record-batch.
+ */
+#define MAX_FRAGMENTS	64
+typedef struct
+{
+	int			findex;
+	int			nfrags;
+	struct {
+		off_t	f_pos;			/* offset from the head of file */
+		off_t	d_pos;			/* offset from the head of the buffer */
+		size_t	len;
+	} frags[MAX_FRAGMENTS];
+} BenchRequest;
+
+static BenchRequest *bench_requests = NULL;
+static size_t		num_bench_requests = 0;
+static size_t		bench_request_index;	/* atomic */
+static size_t		bench_request_bytes;	/* bytes per request */
+static size_t		system_page_size;
+
+/*
+ * Results of the benchmark
+ */
+typedef struct
+{
+	int			iomethod;
+	size_t		chunk_sz;
+	int			qdepth;
+	size_t		nbytes;
+	double		elapsed;		/* sec */
+	double		cpu_time;		/* sec (user + sys) */
+	double		bandwidth;		/* GB/s */
+} BenchResult;
+
+static BenchResult *bench_results = NULL;
+static int			num_bench_results = 0;
+
+/*
+ * HeteroDB Extra module (GPUDirect SQL)
+ */
+static heterodb_extra_error_info *p_heterodb_extra_error_data = NULL;
+static char *(*p_heterodb_extra_module_init)(unsigned int pg_version_num) = NULL;
+static int	(*p_gpudirect_init_driver)(void) = NULL;
+static int	(*p_gpudirect_file_desc_open_by_path)(
+	GPUDirectFileDesc *gds_fdesc,
+	const char *pathname) = NULL;
+static void	(*p_gpudirect_file_desc_close)(
+	const GPUDirectFileDesc *gds_fdesc) = NULL;
+static CUresult (*p_gpudirect_map_gpu_memory)(
+	CUdeviceptr m_segment,
+	size_t m_segment_sz,
+	unsigned long *p_iomap_handle) = NULL;
+static CUresult (*p_gpudirect_unmap_gpu_memory)(
+	CUdeviceptr m_segment,
+	unsigned long iomap_handle) = NULL;
+static int	(*p_gpudirect_file_read_iov)(
+	const GPUDirectFileDesc *gds_fdesc,
+	CUdeviceptr m_segment,
+	unsigned long iomap_handle,
+	off_t m_offset,
+	strom_io_vector *iovec) = NULL;
+static const char *gpudirect_driver_name = NULL;
+
+static const char *
+heterodbExtraErrorMessage(void)
+{
+	if (!p_heterodb_extra_error_data)
+		return "unknown error";
+	return p_heterodb_extra_error_data->message;
+}
+
+static void *
+__lookup_gpudirect_function(void *handle, const char *func_name)
+{
+	char	symbol[128];
+
+	snprintf(symbol, sizeof(symbol), "%s__%s",
+			 gpudirect_driver_name, func_name);
+	return dlsym(handle, symbol);
+}
+#define LOOKUP_GPUDIRECT_FUNCTION(func_name)						\
+	((p_gpudirect_##func_name =										\
+	  __lookup_gpudirect_function(handle, #func_name)) != NULL)
+
+/*
+ * gpudirect_open_extra - loads the HeteroDB Extra module, then returns
+ * 0 if GPUDirect SQL is available.
+ */
+static int
+gpudirect_open_extra(void)
+{
+	void	   *handle;
+	char	   *info;
+	char	   *tok, *pos;
+
+	handle = dlopen(HETERODB_EXTRA_FILENAME, RTLD_NOW | RTLD_LOCAL);
+	if (!handle)
+	{
+		handle = dlopen(HETERODB_EXTRA_PATHNAME, RTLD_NOW | RTLD_LOCAL);
+		if (!handle)
+			return -1;
+	}
+	p_heterodb_extra_error_data = dlsym(handle, "heterodb_extra_error_data");
+	p_heterodb_extra_module_init = dlsym(handle, "heterodb_extra_module_init");
+	if (!p_heterodb_extra_error_data || !p_heterodb_extra_module_init)
+		goto error;
+	info = p_heterodb_extra_module_init(PG_VERSION_NUM);
+	if (!info)
+		goto error;
+	/* same as pg_strom.gpudirect_driver default */
+	info = strdup(info);
+	for (tok = strtok_r(info, ",", &pos);
+		 tok != NULL;
+		 tok = strtok_r(NULL, ",", &pos))
+	{
+		if (strcmp(tok, "nvme_strom=on") == 0 && !gpudirect_driver_name)
+			gpudirect_driver_name = "nvme_strom";
+		else if (strcmp(tok, "cufile=on") == 0)
+			gpudirect_driver_name = "cufile";
+	}
+	free(info);
+	if (!gpudirect_driver_name)
+		goto error;
+	if (!LOOKUP_GPUDIRECT_FUNCTION(init_driver) ||
+		!LOOKUP_GPUDIRECT_FUNCTION(file_desc_open_by_path) ||
+		!LOOKUP_GPUDIRECT_FUNCTION(file_desc_close) ||
+		!LOOKUP_GPUDIRECT_FUNCTION(map_gpu_memory) ||
+		!LOOKUP_GPUDIRECT_FUNCTION(unmap_gpu_memory) ||
+		!LOOKUP_GPUDIRECT_FUNCTION(file_read_iov))
+		goto error;
+	if (p_gpudirect_init_driver() != 0)
+	{
+		fprintf(stderr, "failed on gpudirect init_driver: %s\n",
+				heterodbExtraErrorMessage());
+		goto error;
+	}
+	return 0;
+
+error:
+	gpudirect_driver_name = NULL;
+	p_gpudirect_file_read_iov = NULL;
+	dlclose(handle);
+	return -1;
+}
+
+/*
+ * io_uring - we use the system call directly, not to depend on liburing
+ */
+#ifdef HAVE_IO_URING
+typedef struct
+{
+	int			fdesc;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+	unsigned int nr_entries;
+} BenchUring;
+
+static void
+bench_uring_setup(BenchUring *ring, unsigned int nr_entries)
+{
+	struct io_uring_params params;
+	char	   *sq_ptr;
+	char	   *cq_ptr;
+	size_t		sq_len;
+	size_t		cq_len;
+
+	memset(ring, 0, sizeof(BenchUring));
+	memset(&params, 0, sizeof(params));
+	ring->fdesc = syscall(__NR_io_uring_setup, nr_entries, &params);
+	if (ring->fdesc < 0)
+		elog("failed on io_uring_setup: %m");
+	sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	sq_ptr = mmap(NULL, sq_len, PROT_READ | PROT_WRITE,
+				  MAP_SHARED | MAP_POPULATE, ring->fdesc, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED)
+		elog("failed on mmap(IORING_OFF_SQ_RING): %m");
+	cq_ptr = mmap(NULL, cq_len, PROT_READ | PROT_WRITE,
+				  MAP_SHARED | MAP_POPULATE, ring->fdesc, IORING_OFF_CQ_RING);
+	if (cq_ptr == MAP_FAILED)
+		elog("failed on mmap(IORING_OFF_CQ_RING): %m");
+	ring->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+					  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					  ring->fdesc, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		elog("failed on mmap(IORING_OFF_SQES): %m");
+	ring->sq_head  = (unsigned int *)(sq_ptr + params.sq_off.head);
+	ring->sq_tail  = (unsigned int *)(sq_ptr + params.sq_off.tail);
+	ring->sq_mask  = (unsigned int *)(sq_ptr + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(sq_ptr + params.sq_off.array);
+	ring->cq_head  = (unsigned int *)(cq_ptr + params.cq_off.head);
+	ring->cq_tail  = (unsigned int *)(cq_ptr + params.cq_off.tail);
+	ring->cq_mask  = (unsigned int *)(cq_ptr + params.cq_off.ring_mask);
+	ring->cqes     = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+	ring->nr_entries = params.sq_entries;
+}
+
+static void
+bench_uring_push(BenchUring *ring, int fdesc, void *buf,
+				 size_t len, off_t f_pos, unsigned long user_data)
+{
+	unsigned int tail = *ring->sq_tail;
+	unsigned int index = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = fdesc;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = len;
+	sqe->off = f_pos;
+	sqe->user_data = user_data;
+	ring->sq_array[index] = index;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void
+bench_uring_enter(BenchUring *ring, unsigned int to_submit,
+				  unsigned int min_complete)
+{
+	int		rv;
+
+	do {
+		rv = syscall(__NR_io_uring_enter, ring->fdesc, to_submit,
+					 min_complete, IORING_ENTER_GETEVENTS, NULL, 0);
+	} while (rv < 0 && errno == EINTR);
+	if (rv < 0)
+		elog("failed on io_uring_enter: %m");
+}
+
+static int
+bench_uring_reap(BenchUring *ring, unsigned long *p_user_data)
+{
+	unsigned int head = *ring->cq_head;
+	struct io_uring_cqe *cqe;
+
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return 0;
+	cqe = &ring->cqes[head & *ring->cq_mask];
+	if (cqe->res < 0)
+		elog("failed on io_uring read: %s", strerror(-cqe->res));
+	*p_user_data = cqe->user_data;
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+#endif	/* HAVE_IO_URING */
+
+/*
+ * parse_size - parses a size string with k/m/g suffix
+ */
+static size_t
+parse_size(const char *str)
+{
+	char	   *end;
+	double		val = strtod(str, &end);
+
+	if (end == str || val < 0.0)
+		elog("invalid size: %s", str);
+	if (strcasecmp(end, "k") == 0 || strcasecmp(end, "kb") == 0)
+		val *= 1024.0;
+	else if (strcasecmp(end, "m") == 0 || strcasecmp(end, "mb") == 0)
+		val *= 1048576.0;
+	else if (strcasecmp(end, "g") == 0 || strcasecmp(end, "gb") == 0)
+		val *= 1073741824.0;
+	else if (*end != '\0')
+		elog("invalid size: %s", str);
+	return (size_t)val;
+}
+
+static char *
+format_size(char *buf, size_t len, size_t sz)
+{
+	if (sz >= (1UL << 30) && sz % (1UL << 30) == 0)
+		snprintf(buf, len, "%zuGB", sz >> 30);
+	else if (sz >= (1UL << 20) && sz % (1UL << 20) == 0)
+		snprintf(buf, len, "%zuMB", sz >> 20);
+	else
+		snprintf(buf, len, "%zukB", sz >> 10);
+	return buf;
+}
+
+static double
+get_time_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1.0e9;
+}
+
+static double
+get_cpu_time_sec(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		elog("failed on getrusage: %m");
+	return ((double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1.0e6 +
+			(double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec / 1.0e6);
+}
+
+/*
+ * setup_requests - builds the I/O requests to read up to total_read_limit
+ * for the supplied chunk size.
+ */
+static void
+setup_requests(size_t chunk_sz)
+{
+	size_t		nbytes = 0;
+	size_t		nrooms = 0;
+	size_t		batch_sz;
+	size_t		frag_sz;
+	int			i, j;
+
+	if (!arrow_layout)
+	{
+		frag_sz = chunk_sz;
+		batch_sz = chunk_sz;
+	}
+	else
+	{
+		/*
+		 * a record-batch has arrow_ncols_total column chunks with the same
+		 * size, and the scan reads arrow_ncols_read of them.
+		 */
+		frag_sz = BLCKSZ_ALIGN(chunk_sz / arrow_ncols_read);
+		if (frag_sz == 0)
+			elog("chunk size %zu is too small for %d columns",
+				 chunk_sz, arrow_ncols_read);
+		batch_sz = frag_sz * arrow_ncols_total;
+	}
+	for (i=0; i < num_bench_files; i++)
+		nrooms += bench_files[i].filesize / batch_sz;
+	nrooms = Min(nrooms, total_read_limit / (frag_sz * (arrow_layout
+														? arrow_ncols_read
+														: 1)) + 1);
+	free(bench_requests);
+	bench_requests = calloc(Max(nrooms, 1), sizeof(BenchRequest));
+	if (!bench_requests)
+		elog("out of memory");
+	num_bench_requests = 0;
+	bench_request_bytes = 0;
+
+	for (i=0; i < num_bench_files && nbytes < total_read_limit; i++)
+	{
+		BenchFile  *bfile = &bench_files[i];
+		off_t		f_pos;
+
+		for (f_pos = 0;
+			 f_pos + batch_sz <= bfile->filesize &&
+			 nbytes < total_read_limit &&
+			 num_bench_requests < nrooms;
+			 f_pos += batch_sz)
+		{
+			BenchRequest *breq = &bench_requests[num_bench_requests++];
+			size_t		d_pos = 0;
+
+			breq->findex = i;
+			if (!arrow_layout)
+			{
+				breq->nfrags = 1;
+				breq->frags[0].f_pos = f_pos;
+				breq->frags[0].d_pos = 0;
+				breq->frags[0].len = chunk_sz;
+				d_pos = chunk_sz;
+			}
+			else
+			{
+				/* referenced columns are distributed evenly */
+				breq->nfrags = arrow_ncols_read;
+				for (j=0; j < arrow_ncols_read; j++)
+				{
+					int		cindex = (j * arrow_ncols_total) / arrow_ncols_read;
+
+					breq->frags[j].f_pos = f_pos + frag_sz * cindex;
+					breq->frags[j].d_pos = d_pos;
+					breq->frags[j].len = frag_sz;
+					d_pos += frag_sz;
+				}
+			}
+			bench_request_bytes = Max(bench_request_bytes, d_pos);
+			nbytes += d_pos;
+		}
+	}
+	if (num_bench_requests == 0)
+		elog("input files are too small for chunk size %zu", chunk_sz);
+}
+
+static void
+drop_page_caches(void)
+{
+	int		i;
+
+	for (i=0; i < num_bench_files; i++)
+	{
+		fdatasync(bench_files[i].fdesc);
+		posix_fadvise(bench_files[i].fdesc, 0, 0, POSIX_FADV_DONTNEED);
+	}
+}
+
+static void
+prime_page_caches(void)
+{
+	char   *buffer = malloc(4UL << 20);
+	int		i;
+
+	if (!buffer)
+		elog("out of memory");
+	for (i=0; i < num_bench_files; i++)
+	{
+		BenchFile  *bfile = &bench_files[i];
+		size_t		f_pos = 0;
+		ssize_t		nbytes;
+
+		while (f_pos < Min(bfile->filesize, total_read_limit))
+		{
+			nbytes = pread(bfile->fdesc, buffer, 4UL << 20, f_pos);
+			if (nbytes <= 0)
+				break;
+			f_pos += nbytes;
+		}
+	}
+	free(buffer);
+}
+
+/*
+ * Worker threads
+ */
+typedef struct
+{
+	pthread_t	thread;
+	int			iomethod;
+	int			qdepth;		/* only io_uring */
+	CUcontext	cuda_context;
+	CUdeviceptr	m_segment;	/* base of the device memory segment */
+	off_t		m_offset;	/* offset of this worker in the segment */
+	unsigned long iomap_handle;
+	size_t		nbytes;
+} BenchWorker;
+
+static BenchRequest *
+fetch_next_request(void)
+{
+	size_t		index = __atomic_fetch_add(&bench_request_index, 1,
+										   __ATOMIC_SEQ_CST);
+	if (index >= num_bench_requests)
+		return NULL;
+	return &bench_requests[index];
+}
+
+static void
+bench_read_gpudirect(BenchWorker *bw)
+{
+	strom_io_vector *iovec;
+	BenchRequest *breq;
+	int			i;
+
+	iovec = alloca(offsetof(strom_io_vector, ioc[MAX_FRAGMENTS]));
+	while ((breq = fetch_next_request()) != NULL)
+	{
+		BenchFile  *bfile = &bench_files[breq->findex];
+
+		iovec->nr_chunks = breq->nfrags;
+		for (i=0; i < breq->nfrags; i++)
+		{
+			strom_io_chunk *ioc = &iovec->ioc[i];
+
+			ioc->m_offset  = breq->frags[i].d_pos;
+			ioc->fchunk_id = breq->frags[i].f_pos / system_page_size;
+			ioc->nr_pages  = breq->frags[i].len / system_page_size;
+			bw->nbytes += breq->frags[i].len;
+		}
+		if (p_gpudirect_file_read_iov(&bfile->gds_fdesc,
+									  bw->m_segment,
+									  bw->iomap_handle,
+									  bw->m_offset,
+									  iovec) != 0)
+			elog("failed on gpudirect file_read_iov('%s'): %s",
+				 bfile->pathname, heterodbExtraErrorMessage());
+	}
+}
+
+static void
+bench_read_pread(BenchWorker *bw, char *h_buffer, CUstream cuda_stream)
+{
+	BenchRequest *breq;
+	CUresult	rc;
+	int			i;
+
+	while ((breq = fetch_next_request()) != NULL)
+	{
+		BenchFile  *bfile = &bench_files[breq->findex];
+		int			fdesc = (bw->iomethod == IOMETHOD__DIRECT
+							 ? bfile->fdesc_direct
+							 : bfile->fdesc);
+		size_t		d_len = 0;
+
+		for (i=0; i < breq->nfrags; i++)
+		{
+			char	   *dest = h_buffer + breq->frags[i].d_pos;
+			off_t		f_pos = breq->frags[i].f_pos;
+			size_t		remained = breq->frags[i].len;
+			ssize_t		nbytes;
+
+			while (remained > 0)
+			{
+				nbytes = pread(fdesc, dest, remained, f_pos);
+				if (nbytes < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					elog("failed on pread('%s'): %m", bfile->pathname);
+				}
+				else if (nbytes == 0)
+					elog("unexpected EOF at '%s'", bfile->pathname);
+				dest += nbytes;
+				f_pos += nbytes;
+				remained -= nbytes;
+			}
+			d_len = Max(d_len, breq->frags[i].d_pos + breq->frags[i].len);
+			bw->nbytes += breq->frags[i].len;
+		}
+		rc = cuMemcpyHtoDAsync(bw->m_segment + bw->m_offset,
+							   h_buffer, d_len, cuda_stream);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuMemcpyHtoDAsync: %s", cuErrorName(rc));
+		rc = cuStreamSynchronize(cuda_stream);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on cuStreamSynchronize: %s", cuErrorName(rc));
+	}
+}
+
+#ifdef HAVE_IO_URING
+/*
+ * bench_read_io_uring - a single thread keeps qdepth requests in flight,
+ * then moves the chunk to the device memory on completion of all the
+ * fragments.
+ */
+static void
+bench_read_io_uring(BenchWorker *bw, char *h_buffer, CUstream cuda_stream)
+{
+	BenchUring	ring;
+	BenchRequest **slot_req;
+	int		   *slot_nwaits;
+	int			nr_inflight = 0;
+	int			i, k;
+	CUresult	rc;
+
+	bench_uring_setup(&ring, bw->qdepth * MAX_FRAGMENTS);
+	if (ring.nr_entries < bw->qdepth * MAX_FRAGMENTS)
+		elog("io_uring has only %u entries", ring.nr_entries);
+	slot_req = calloc(bw->qdepth, sizeof(BenchRequest *));
+	slot_nwaits = calloc(bw->qdepth, sizeof(int));
+	if (!slot_req || !slot_nwaits)
+		elog("out of memory");
+
+	for (;;)
+	{
+		unsigned int to_submit = 0;
+		unsigned long user_data;
+
+		/* fill up the vacant slots */
+		for (k=0; k < bw->qdepth; k++)
+		{
+			BenchRequest *breq;
+			BenchFile  *bfile;
+			char	   *dest = h_buffer + bench_request_bytes * k;
+
+			if (slot_req[k] || (breq = fetch_next_request()) == NULL)
+				continue;
+			bfile = &bench_files[breq->findex];
+			for (i=0; i < breq->nfrags; i++)
+			{
+				bench_uring_push(&ring, bfile->fdesc_direct,
+								 dest + breq->frags[i].d_pos,
+								 breq->frags[i].len,
+								 breq->frags[i].f_pos, k);
+				bw->nbytes += breq->frags[i].len;
+			}
+			slot_req[k] = breq;
+			slot_nwaits[k] = breq->nfrags;
+			to_submit += breq->nfrags;
+			nr_inflight++;
+		}
+		if (nr_inflight == 0)
+			break;
+		bench_uring_enter(&ring, to_submit, 1);
+		while (bench_uring_reap(&ring, &user_data))
+		{
+			k = (int)user_data;
+			assert(k >= 0 && k < bw->qdepth && slot_req[k]);
+			if (--slot_nwaits[k] > 0)
+				continue;
+			rc = cuMemcpyHtoDAsync(bw->m_segment + bw->m_offset +
+								   bench_request_bytes * k,
+								   h_buffer + bench_request_bytes * k,
+								   bench_request_bytes,
+								   cuda_stream);
+			if (rc != CUDA_SUCCESS)
+				elog("failed on cuMemcpyHtoDAsync: %s", cuErrorName(rc));
+			slot_req[k] = NULL;
+			nr_inflight--;
+		}
+	}
+	rc = cuStreamSynchronize(cuda_stream);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuStreamSynchronize: %s", cuErrorName(rc));
+	free(slot_req);
+	free(slot_nwaits);
+	close(ring.fdesc);
+}
+#endif	/* HAVE_IO_URING */
+
+static void *
+bench_worker_main(void *__priv)
+{
+	BenchWorker *bw = __priv;
+	CUstream	cuda_stream = NULL;
+	char	   *h_buffer = NULL;
+	size_t		h_buffer_sz;
+	CUresult	rc;
+
+	rc = cuCtxSetCurrent(bw->cuda_context);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuCtxSetCurrent: %s", cuErrorName(rc));
+	if (bw->iomethod == IOMETHOD__GPUDIRECT)
+	{
+		bench_read_gpudirect(bw);
+		return NULL;
+	}
+	/* pinned host buffer is page aligned, so usable for O_DIRECT */
+	h_buffer_sz = bench_request_bytes * Max(bw->qdepth, 1);
+	rc = cuMemAllocHost((void **)&h_buffer, h_buffer_sz);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAllocHost: %s", cuErrorName(rc));
+	rc = cuStreamCreate(&cuda_stream, CU_STREAM_NON_BLOCKING);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuStreamCreate: %s", cuErrorName(rc));
+#ifdef HAVE_IO_URING
+	if (bw->iomethod == IOMETHOD__IO_URING)
+		bench_read_io_uring(bw, h_buffer, cuda_stream);
+	else
+#endif
+		bench_read_pread(bw, h_buffer, cuda_stream);
+	cuStreamDestroy(cuda_stream);
+	cuMemFreeHost(h_buffer);
+
+	return NULL;
+}
+
+/*
+ * run_benchmark - runs a configuration of the benchmark
+ */
+static void
+run_benchmark(CUcontext cuda_context, int iomethod,
+			  size_t chunk_sz, int qdepth)
+{
+	BenchWorker *workers;
+	BenchResult *bres;
+	CUdeviceptr	m_segment;
+	unsigned long iomap_handle = 0;
+	int			nworkers = (iomethod == IOMETHOD__IO_URING ? 1 : qdepth);
+	size_t		m_segment_sz;
+	double		tv1, tv2, cpu1, cpu2;
+	char		temp[64];
+	CUresult	rc;
+	int			i;
+
+	setup_requests(chunk_sz);
+	bench_request_index = 0;
+
+	/* device memory to be written; qdepth x chunks */
+	m_segment_sz = bench_request_bytes * qdepth;
+	rc = cuMemAlloc(&m_segment, m_segment_sz);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuMemAlloc: %s", cuErrorName(rc));
+	if (iomethod == IOMETHOD__GPUDIRECT)
+	{
+		rc = p_gpudirect_map_gpu_memory(m_segment, m_segment_sz,
+										&iomap_handle);
+		if (rc != CUDA_SUCCESS)
+			elog("failed on gpudirect map_gpu_memory: %s",
+				 heterodbExtraErrorMessage());
+	}
+
+	if (iomethod == IOMETHOD__CACHED)
+		prime_page_caches();
+	else
+		drop_page_caches();
+
+	workers = calloc(nworkers, sizeof(BenchWorker));
+	if (!workers)
+		elog("out of memory");
+	tv1 = get_time_sec();
+	cpu1 = get_cpu_time_sec();
+	for (i=0; i < nworkers; i++)
+	{
+		BenchWorker *bw = &workers[i];
+
+		bw->iomethod = iomethod;
+		bw->qdepth = (iomethod == IOMETHOD__IO_URING ? qdepth : 1);
+		bw->cuda_context = cuda_context;
+		bw->m_segment = m_segment;
+		bw->m_offset = bench_request_bytes * i;
+		bw->iomap_handle = iomap_handle;
+		errno = pthread_create(&bw->thread, NULL, bench_worker_main, bw);
+		if (errno != 0)
+			elog("failed on pthread_create: %m");
+	}
+	bres = &bench_results[num_bench_results++];
+	memset(bres, 0, sizeof(BenchResult));
+	for (i=0; i < nworkers; i++)
+	{
+		errno = pthread_join(workers[i].thread, NULL);
+		if (errno != 0)
+			elog("failed on pthread_join: %m");
+		bres->nbytes += workers[i].nbytes;
+	}
+	tv2 = get_time_sec();
+	cpu2 = get_cpu_time_sec();
+	free(workers);
+
+	if (iomethod == IOMETHOD__GPUDIRECT)
+		p_gpudirect_unmap_gpu_memory(m_segment, iomap_handle);
+	cuMemFree(m_segment);
+
+	bres->iomethod = iomethod;
+	bres->chunk_sz = chunk_sz;
+	bres->qdepth = qdepth;
+	bres->elapsed = tv2 - tv1;
+	bres->cpu_time = cpu2 - cpu1;
+	bres->bandwidth = (double)bres->nbytes / bres->elapsed / 1.0e9;
+
+	if (machine_format)
+		printf("%s,%s,%zu,%d,%zu,%.3f,%.3f,%.3f,%.1f\n",
+			   iomethod_names[iomethod],
+			   arrow_layout ? "arrow" : "heap",
+			   chunk_sz, qdepth,
+			   bres->nbytes,
+			   bres->elapsed,
+			   bres->bandwidth,
+			   bres->cpu_time / ((double)bres->nbytes / 1.0e9),
+			   100.0 * bres->cpu_time / bres->elapsed);
+	else
+		printf("%-10s %-6s %8s %5d %9.2f %9.1f%% %10.3f\n",
+			   iomethod_names[iomethod],
+			   arrow_layout ? "arrow" : "heap",
+			   format_size(temp, sizeof(temp), chunk_sz),
+			   qdepth,
+			   bres->bandwidth,
+			   100.0 * bres->cpu_time / bres->elapsed,
+			   bres->cpu_time / ((double)bres->nbytes / 1.0e9));
+	fflush(stdout);
+}
+
+/*
+ * print_recommendation
+ */
+static BenchResult *
+lookup_best_result(int iomethod)
+{
+	BenchResult *best = NULL;
+	int			i;
+
+	for (i=0; i < num_bench_results; i++)
+	{
+		BenchResult *bres = &bench_results[i];
+
+		if (bres->iomethod == iomethod &&
+			(!best || best->bandwidth < bres->bandwidth))
+			best = bres;
+	}
+	return best;
+}
+
+static void
+print_recommendation(void)
+{
+	BenchResult *best_gds = lookup_best_result(IOMETHOD__GPUDIRECT);
+	BenchResult *best_cached = lookup_best_result(IOMETHOD__CACHED);
+	BenchResult *best_host = NULL;
+	size_t		ram_sz = sysconf(_SC_PAGESIZE) * sysconf(_SC_PHYS_PAGES);
+	size_t		sbuf_sz = (shared_buffers_sz > 0 ? shared_buffers_sz : ram_sz / 4);
+	size_t		threshold;
+	size_t		segment_sz;
+	size_t		min_chunk_sz = 0;
+	char		temp[64];
+	int			i, nchunks;
+
+	for (i=IOMETHOD__BUFFERED; i < NUM_IOMETHODS; i++)
+	{
+		BenchResult *bres = lookup_best_result(i);
+
+		if (i != IOMETHOD__CACHED && bres &&
+			(!best_host || best_host->bandwidth < bres->bandwidth))
+			best_host = bres;
+	}
+
+	printf("\nRecommendation:\n");
+	if (!best_gds)
+	{
+		if ((iomethod_mask & (1 << IOMETHOD__GPUDIRECT)) != 0)
+			printf("  GPUDirect SQL is not available on this host\n"
+				   "  pg_strom.gpudirect_enabled = off\n");
+		return;
+	}
+	if (best_host)
+		printf("  GPUDirect SQL %.2fGB/s (%s, qd=%d) vs %s %.2fGB/s (%s, qd=%d)\n",
+			   best_gds->bandwidth,
+			   format_size(temp, sizeof(temp), best_gds->chunk_sz),
+			   best_gds->qdepth,
+			   iomethod_names[best_host->iomethod],
+			   best_host->bandwidth,
+			   format_size(temp + 32, sizeof(temp) - 32, best_host->chunk_sz),
+			   best_host->qdepth);
+	if (best_host && best_gds->bandwidth < best_host->bandwidth * 1.05)
+	{
+		printf("  GPUDirect SQL did not outperform the host I/O path\n"
+			   "  pg_strom.gpudirect_enabled = off\n");
+		return;
+	}
+
+	/*
+	 * pg_strom.gpudirect_threshold
+	 *
+	 * If GPUDirect SQL is faster than the page cache, it is worth even for
+	 * the tables that fit in the RAM. Elsewhere, the default logic (see
+	 * pgstrom_init_gpu_device) is right; it applies GPUDirect SQL only
+	 * for the tables that cannot be cached.
+	 */
+	if (best_cached && best_gds->bandwidth >= best_cached->bandwidth)
+		threshold = 256UL << 20;
+	else
+		threshold = (ram_sz > sbuf_sz / 2 ? ram_sz - sbuf_sz / 2 : 0) + sbuf_sz;
+	printf("  pg_strom.gpudirect_threshold = %zuMB%s\n",
+		   threshold >> 20,
+		   (best_cached && best_gds->bandwidth >= best_cached->bandwidth
+			? "    # faster than the page cache"
+			: shared_buffers_sz == 0
+			? "    # assumes shared_buffers = 25% of RAM"
+			: ""));
+
+	/*
+	 * pg_strom.gpu_memory_segment_size
+	 *
+	 * The device memory segment should keep the chunks of the best queue
+	 * depth in flight; 8 chunks at least (default).
+	 */
+	nchunks = Max(8, best_gds->qdepth);
+	while (nchunks > 1 && PGSTROM_CHUNK_SIZE * nchunks > GPU_SEGMENT_SIZE_MAX)
+		nchunks--;
+	segment_sz = PGSTROM_CHUNK_SIZE * nchunks;
+	printf("  pg_strom.gpu_memory_segment_size = %zukB\n", segment_sz >> 10);
+
+	/* the smallest chunk size to earn 90% of the best throughput */
+	for (i=0; i < num_bench_results; i++)
+	{
+		BenchResult *bres = &bench_results[i];
+
+		if (bres->iomethod == IOMETHOD__GPUDIRECT &&
+			bres->bandwidth >= 0.9 * best_gds->bandwidth &&
+			(min_chunk_sz == 0 || bres->chunk_sz < min_chunk_sz))
+			min_chunk_sz = bres->chunk_sz;
+	}
+	printf("  # I/O size less than %s loses the throughput of GPUDirect SQL;\n"
+		   "  # consider it on the layout of files (e.g, record-batch size of Arrow)\n",
+		   format_size(temp, sizeof(temp), min_chunk_sz));
+}
+
+static void
+usage(const char *argv0, int exitcode)
+{
+	fprintf(stderr,
+			"usage: %s [OPTIONS] <file> [<file> ...]\n"
+			"\n"
+			"Options:\n"
+			"  -d, --device=DEVICE_ID      GPU device to be used (default: 0)\n"
+			"  -m, --method=METHOD[,...]   gpudirect, buffered, cached, direct, io_uring\n"
+			"                              (default: all the available methods)\n"
+			"  -c, --chunk-size=SIZE[,...] I/O size per request (default: 256k,1m,8m,64m)\n"
+			"  -q, --queue-depth=N[,...]   number of concurrent requests (default: 1,4,16)\n"
+			"  -l, --layout=LAYOUT         heap or arrow (default: heap)\n"
+			"  -a, --arrow-columns=N/M     arrow layout reads N of M columns (default: 4/16)\n"
+			"  -s, --size=SIZE             bytes to read per run (default: 8GB)\n"
+			"  -b, --shared-buffers=SIZE   shared_buffers for the recommendation\n"
+			"                              (default: 25%% of RAM)\n"
+			"      --machine-format        print results in CSV\n"
+			"  -h, --help                  print this message\n",
+			argv0);
+	exit(exitcode);
+}
+
+int
+main(int argc, char *argv[])
+{
+	static struct option long_options[] = {
+		{"device",         required_argument, NULL, 'd'},
+		{"method",         required_argument, NULL, 'm'},
+		{"chunk-size",     required_argument, NULL, 'c'},
+		{"queue-depth",    required_argument, NULL, 'q'},
+		{"layout",         required_argument, NULL, 'l'},
+		{"arrow-columns",  required_argument, NULL, 'a'},
+		{"size",           required_argument, NULL, 's'},
+		{"shared-buffers", required_argument, NULL, 'b'},
+		{"machine-format", no_argument,       NULL, 1000},
+		{"help",           no_argument,       NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	CUdevice	cuda_device;
+	CUcontext	cuda_context;
+	CUresult	rc;
+	char		dev_name[256];
+	char	   *tok, *pos, *end;
+	int			has_gpudirect;
+	int			c, i, j, k;
+
+	while ((c = getopt_long(argc, argv, "d:m:c:q:l:a:s:b:h",
+							long_options, NULL)) >= 0)
+	{
+		switch (c)
+		{
+			case 'd':
+				device_id = strtol(optarg, &end, 10);
+				if (*end != '\0' || device_id < 0)
+					elog("invalid device id: %s", optarg);
+				break;
+			case 'm':
+				for (tok = strtok_r(optarg, ",", &pos);
+					 tok != NULL;
+					 tok = strtok_r(NULL, ",", &pos))
+				{
+					for (i=0; i < NUM_IOMETHODS; i++)
+					{
+						if (strcmp(tok, iomethod_names[i]) == 0)
+							break;
+					}
+					if (i == NUM_IOMETHODS)
+						elog("unknown I/O method: %s", tok);
+					iomethod_mask |= (1 << i);
+				}
+				break;
+			case 'c':
+				for (tok = strtok_r(optarg, ",", &pos);
+					 tok != NULL;
+					 tok = strtok_r(NULL, ",", &pos))
+				{
+					size_t	sz = parse_size(tok);
+
+					if (sz < BLCKSZ || sz % BLCKSZ != 0)
+						elog("chunk size must be multiple of %u: %s",
+							 BLCKSZ, tok);
+					if (num_chunk_sizes >= lengthof(chunk_sizes))
+						elog("too many chunk sizes");
+					chunk_sizes[num_chunk_sizes++] = sz;
+				}
+				break;
+			case 'q':
+				for (tok = strtok_r(optarg, ",", &pos);
+					 tok != NULL;
+					 tok = strtok_r(NULL, ",", &pos))
+				{
+					int		qd = strtol(tok, &end, 10);
+
+					if (*end != '\0' || qd < 1 || qd > 256)
+						elog("invalid queue depth: %s", tok);
+					if (num_queue_depths >= lengthof(queue_depths))
+						elog("too many queue depths");
+					queue_depths[num_queue_depths++] = qd;
+				}
+				break;
+			case 'l':
+				if (strcmp(optarg, "heap") == 0)
+					arrow_layout = 0;
+				else if (strcmp(optarg, "arrow") == 0)
+					arrow_layout = 1;
+				else
+					elog("unknown layout: %s", optarg);
+				break;
+			case 'a':
+				if (sscanf(optarg, "%d/%d",
+						   &arrow_ncols_read,
+						   &arrow_ncols_total) != 2 ||
+					arrow_ncols_read < 1 ||
+					arrow_ncols_read > MAX_FRAGMENTS ||
+					arrow_ncols_read > arrow_ncols_total)
+					elog("invalid arrow columns: %s", optarg);
+				break;
+			case 's':
+				total_read_limit = parse_size(optarg);
+				break;
+			case 'b':
+				shared_buffers_sz = parse_size(optarg);
+				break;
+			case 1000:
+				machine_format = 1;
+				break;
+			case 'h':
+				usage(argv[0], 0);
+				break;
+			default:
+				usage(argv[0], 1);
+				break;
+		}
+	}
+	if (optind >= argc)
+		usage(argv[0], 1);
+	if (num_chunk_sizes == 0)
+	{
+		chunk_sizes[num_chunk_sizes++] = (256UL << 10);
+		chunk_sizes[num_chunk_sizes++] = (1UL << 20);
+		chunk_sizes[num_chunk_sizes++] = (8UL << 20);
+		chunk_sizes[num_chunk_sizes++] = (64UL << 20);
+	}
+	if (num_queue_depths == 0)
+	{
+		queue_depths[num_queue_depths++] = 1;
+		queue_depths[num_queue_depths++] = 4;
+		queue_depths[num_queue_depths++] = 16;
+	}
+	system_page_size = sysconf(_SC_PAGESIZE);
+
+	/* check availability of the I/O methods */
+	has_gpudirect = (gpudirect_open_extra() == 0);
+	if (iomethod_mask == 0)
+	{
+		iomethod_mask = ((1 << IOMETHOD__BUFFERED) |
+						 (1 << IOMETHOD__CACHED) |
+						 (1 << IOMETHOD__DIRECT));
+		if (has_gpudirect)
+			iomethod_mask |= (1 << IOMETHOD__GPUDIRECT);
+#ifdef HAVE_IO_URING
+		iomethod_mask |= (1 << IOMETHOD__IO_URING);
+#endif
+	}
+#ifndef HAVE_IO_URING
+	if ((iomethod_mask & (1 << IOMETHOD__IO_URING)) != 0)
+		elog("io_uring is not supported in this build");
+#endif
+
+	/* init CUDA context */
+	rc = cuInit(0);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuInit: %s", cuErrorName(rc));
+	rc = cuDeviceGet(&cuda_device, device_id);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGet: %s", cuErrorName(rc));
+	rc = cuDeviceGetName(dev_name, sizeof(dev_name), cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuDeviceGetName: %s", cuErrorName(rc));
+	rc = cuCtxCreate(&cuda_context, CU_CTX_SCHED_AUTO, cuda_device);
+	if (rc != CUDA_SUCCESS)
+		elog("failed on cuCtxCreate: %s", cuErrorName(rc));
+
+	/* open the input files */
+	num_bench_files = argc - optind;
+	bench_files = calloc(num_bench_files, sizeof(BenchFile));
+	if (!bench_files)
+		elog("out of memory");
+	for (i=0; i < num_bench_files; i++)
+	{
+		BenchFile  *bfile = &bench_files[i];
+		struct stat	stat_buf;
+
+		bfile->pathname = argv[optind + i];
+		bfile->fdesc = open(bfile->pathname, O_RDONLY);
+		if (bfile->fdesc < 0)
+			elog("failed to open '%s': %m", bfile->pathname);
+		if (fstat(bfile->fdesc, &stat_buf) != 0)
+			elog("failed on fstat('%s'): %m", bfile->pathname);
+		bfile->filesize = BLCKSZ_ALIGN(stat_buf.st_size);
+		bfile->fdesc_direct = open(bfile->pathname, O_RDONLY | O_DIRECT);
+		if (bfile->fdesc_direct < 0 &&
+			(iomethod_mask & ((1 << IOMETHOD__DIRECT) |
+							  (1 << IOMETHOD__IO_URING))) != 0)
+			elog("failed to open '%s' with O_DIRECT: %m", bfile->pathname);
+		if ((iomethod_mask & (1 << IOMETHOD__GPUDIRECT)) != 0)
+		{
+			if (!has_gpudirect)
+				elog("GPUDirect SQL is not available on this host");
+			if (p_gpudirect_file_desc_open_by_path(&bfile->gds_fdesc,
+												   bfile->pathname) != 0)
+				elog("failed on gpudirect file_desc_open_by_path('%s'): %s",
+					 bfile->pathname, heterodbExtraErrorMessage());
+			bfile->gds_opened = 1;
+		}
+	}
+
+	bench_results = calloc(NUM_IOMETHODS * num_chunk_sizes * num_queue_depths,
+						   sizeof(BenchResult));
+	if (!bench_results)
+		elog("out of memory");
+	if (machine_format)
+		printf("method,layout,chunk_size,queue_depth,nbytes,elapsed,"
+			   "bandwidth_gbps,cpu_sec_per_gb,cpu_usage\n");
+	else
+	{
+		printf("GPU%d %s, GPUDirect SQL driver: %s, layout: %s",
+			   device_id, dev_name,
+			   gpudirect_driver_name ? gpudirect_driver_name : "none",
+			   arrow_layout ? "arrow" : "heap");
+		if (arrow_layout)
+			printf(" (%d/%d columns)", arrow_ncols_read, arrow_ncols_total);
+		printf("\n%-10s %-6s %8s %5s %9s %10s %10s\n",
+			   "method", "layout", "chunk", "qd", "GB/s", "CPU", "CPU-s/GB");
+	}
+	for (i=0; i < NUM_IOMETHODS; i++)
+	{
+		if ((iomethod_mask & (1 << i)) == 0)
+			continue;
+		for (j=0; j < num_chunk_sizes; j++)
+		{
+			for (k=0; k < num_queue_depths; k++)
+				run_benchmark(cuda_context, i,
+							  chunk_sizes[j],
+							  queue_depths[k]);
+		}
+	}
+	if (!machine_format)
+		print_recommendation();
+
+	/* cleanup */
+	for (i=0; i < num_bench_files; i++)
+	{
+		BenchFile  *bfile = &bench_files[i];
+
+		if (bfile->gds_opened)
+			p_gpudirect_file_desc_close(&bfile->gds_fdesc);
+		if (bfile->fdesc_direct >= 0)
+			close(bfile->fdesc_direct);
+		close(bfile->fdesc);
+	}
+	cuCtxDestroy(cuda_context);
+
+	return 0;
+}
@@ -1,6 +1,8 @@
 #include <Python.h>
+#include <structmember.h>
 #include <cuda_runtime_api.h>
 #include "cuda_common.h"
+#include "cuda_gcache.h"
 
 /* supported data types */
 #define BOOLOID 16
@@ -10,443 +12,468 @@
 #define FLOAT4OID 700
 #define FLOAT8OID 701
 
-static PyObject *
-create_ndarray_normal(cl_uint type_oid, cl_ulong nitems, cl_ulong nattrs)
+/*
+ * IpcMapping - device memory of the GPU cache opened by cudaIpcOpenMemHandle
+ *
+ * It is referenced by DeviceArray objects; the device memory is closed
+ * when the last DeviceArray (and the consumer which holds it, like a cupy
+ * ndarray or a torch tensor) is released.
+ */
+typedef struct
 {
-	PyObject   *mod_cupy = NULL;
-	PyObject   *mod_core = NULL;
-	PyObject   *mod_dtype = NULL;
-	PyObject   *dtype = NULL;
-	PyObject   *result = NULL;
-	const char *type_code;
-
-	switch (type_oid)
-	{
-		case BOOLOID:
-			type_code = "?";
-			break;
-		case INT2OID:
-			type_code = "h";
-			break;
-		case INT4OID:
-			type_code = "i";
-			break;
-		case INT8OID:
-			type_code = "l";
-			break;
-		case FLOAT4OID:
-			type_code = "f";
-			break;
-		case FLOAT8OID:
-			type_code = "d";
-			break;
-		default:
-			PyErr_Format(PyExc_SystemError, "unknown element data type");
-			return NULL;
-	}
+	PyObject_HEAD
+	int			device_id;
+	void	   *m_devptr;
+} IpcMappingObject;
 
-	mod_cupy = PyImport_ImportModule("cupy");
-	if (!mod_cupy)
-	{
-		PyErr_Format(PyExc_SystemError, "could not import 'cupy' module");
-		goto bailout;
-	}
-	mod_core = PyObject_GetAttrString(mod_cupy, "core");
-	if (!mod_core)
-	{
-		PyErr_Format(PyExc_SystemError, "cupy.core was not found");
-		goto bailout;
-	}
-	mod_dtype = PyObject_GetAttrString(mod_core, "_dtype");
-	if (!mod_dtype)
+static void
+IpcMapping_dealloc(IpcMappingObject *self)
+{
+	if (self->m_devptr)
 	{
-		PyErr_Format(PyExc_SystemError,
-					 "cupy.core._dtype was not found");
-		goto bailout;
+		int		prev_id;
+
+		if (cudaGetDevice(&prev_id) == cudaSuccess &&
+			cudaSetDevice(self->device_id) == cudaSuccess)
+		{
+			cudaIpcCloseMemHandle(self->m_devptr);
+			cudaSetDevice(prev_id);
+		}
 	}
-	dtype = PyObject_CallMethod(mod_dtype, "get_dtype",
-								"(s)", type_code);
-	if (!dtype)
-		goto bailout;
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
 
-	result = PyObject_CallMethod(mod_core, "ndarray",
-								 "(k k) O O s",
-								 nitems, nattrs,
-								 dtype,
-								 Py_None,
-								 "F");
-bailout:
-	if (dtype)
-		Py_DECREF(dtype);
-	if (mod_core)
-		Py_DECREF(mod_core);
-	if (mod_cupy)
-		Py_DECREF(mod_cupy);
-	return result;
+static PyTypeObject IpcMappingType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "pystrom.IpcMapping",
+	.tp_basicsize = sizeof(IpcMappingObject),
+	.tp_dealloc = (destructor)IpcMapping_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "device memory of GPU cache opened by CUDA IPC",
+};
+
+/*
+ * DeviceArray - a column of the GPU cache with __cuda_array_interface__
+ *
+ * It does not copy anything; consumers like cupy.asarray(),
+ * torch.as_tensor() or numba.cuda.as_cuda_array() reference the GPU cache
+ * directly.
+ */
+typedef struct
+{
+	PyObject_HEAD
+	PyObject   *owner;		/* IpcMappingObject */
+	PyObject   *name;
+	const char *typestr;
+	char	   *ptr;
+	Py_ssize_t	nitems;
+	Py_ssize_t	itemsz;
+	Py_ssize_t	stride;
+} DeviceArrayObject;
+
+static void
+DeviceArray_dealloc(DeviceArrayObject *self)
+{
+	Py_XDECREF(self->name);
+	Py_XDECREF(self->owner);
+	Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
-static int
-setup_ndarray_from_kds(PyObject *ndarray,
-					   const char *m_kds,		/* device pointer */
-					   kern_data_store *kds,	/* host buffer */
-					   cl_uint type_oid, cl_int nattrs, cl_int *attIndex)
+static PyObject *
+DeviceArray_repr(DeviceArrayObject *self)
 {
-	cl_long		nitems = kds->nitems;
-	cl_long		ndarray_sz;
-	PyObject   *devmem = NULL;
-	PyObject   *devptr = NULL;
-	PyObject   *temp;
-	char	   *dest;
-	size_t		type_len;
-	int			i, retval = 1;
-
-	/* check size of ndarray */
-	temp = PyObject_GetAttrString(ndarray, "size");
-	if (!temp)
-	{
-		PyErr_Format(PyExc_SystemError, "'size' not found in ndarray");
-		goto bailout;
-	}
-	ndarray_sz = PyLong_AsLong(temp);
-	Py_DECREF(temp);
-	if (ndarray_sz != nattrs * nitems)
+	return PyUnicode_FromFormat("<pystrom.DeviceArray '%U' typestr='%s' nitems=%zd>",
+								self->name, self->typestr, self->nitems);
+}
+
+static Py_ssize_t
+DeviceArray_length(DeviceArrayObject *self)
+{
+	return self->nitems;
+}
+
+static PyObject *
+DeviceArray_get_cuda_array_interface(DeviceArrayObject *self, void *closure)
+{
+	PyObject   *strides;
+
+	/* C-contiguous array is described with strides = None */
+	if (self->stride == self->itemsz)
 	{
-		PyErr_Format(PyExc_SystemError, "Wrong ndarray size");
-		goto bailout;
+		Py_INCREF(Py_None);
+		strides = Py_None;
 	}
-	/* get device memory pointer */
-	devmem = PyObject_GetAttrString(ndarray, "data");
-	if (!devmem)
+	else
 	{
-		PyErr_Format(PyExc_SystemError, "'data' not found in ndarray");
-		goto bailout;
+		strides = Py_BuildValue("(n)", self->stride);
+		if (!strides)
+			return NULL;
 	}
-	devptr = PyObject_GetAttrString(devmem, "ptr");
-	if (!devptr)
+	/*
+	 * The data is marked as readonly, because any writes on the GPU cache
+	 * by the consumer will break consistency with the table.
+	 */
+	return Py_BuildValue("{s:(n),s:s,s:(KO),s:N,s:i}",
+						 "shape", self->nitems,
+						 "typestr", self->typestr,
+						 "data", (unsigned long long)self->ptr, Py_True,
+						 "strides", strides,
+						 "version", 2);
+}
+
+static PyMemberDef DeviceArray_members[] = {
+	{"name", T_OBJECT, offsetof(DeviceArrayObject, name), READONLY,
+	 "column name"},
+	{"nitems", T_PYSSIZET, offsetof(DeviceArrayObject, nitems), READONLY,
+	 "number of items"},
+	{NULL},
+};
+
+static PyGetSetDef DeviceArray_getset[] = {
+	{"__cuda_array_interface__",
+	 (getter)DeviceArray_get_cuda_array_interface, NULL,
+	 "CUDA Array Interface (version 2)", NULL},
+	{NULL},
+};
+
+static PySequenceMethods DeviceArray_as_sequence = {
+	.sq_length = (lenfunc)DeviceArray_length,
+};
+
+static PyTypeObject DeviceArrayType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	.tp_name = "pystrom.DeviceArray",
+	.tp_basicsize = sizeof(DeviceArrayObject),
+	.tp_dealloc = (destructor)DeviceArray_dealloc,
+	.tp_repr = (reprfunc)DeviceArray_repr,
+	.tp_as_sequence = &DeviceArray_as_sequence,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "a column of GPU cache with __cuda_array_interface__",
+	.tp_members = DeviceArray_members,
+	.tp_getset = DeviceArray_getset,
+};
+
+static PyObject *
+create_device_array(PyObject *owner, const char *name, const char *typestr,
+					char *ptr, size_t nitems, size_t itemsz, size_t stride)
+{
+	DeviceArrayObject *darray;
+
+	darray = PyObject_New(DeviceArrayObject, &DeviceArrayType);
+	if (!darray)
+		return NULL;
+	darray->name = PyUnicode_FromString(name);
+	if (!darray->name)
 	{
-		PyErr_Format(PyExc_SystemError, "'devptr' not found in MemoryPointer");
-		goto bailout;
+		darray->owner = NULL;
+		Py_DECREF(darray);
+		return NULL;
 	}
-	dest = (char *)PyLong_AsLong(devptr);
+	Py_INCREF(owner);
+	darray->owner   = owner;
+	darray->typestr = typestr;
+	darray->ptr     = ptr;
+	darray->nitems  = nitems;
+	darray->itemsz  = itemsz;
+	darray->stride  = stride;
+
+	return (PyObject *)darray;
+}
 
-	/* copy from Gstore_fdw to ndarray buffer */
-	switch (type_oid)
+static const char *
+column_typestr(kern_colmeta *cmeta)
+{
+	switch (cmeta->atttypid)
 	{
 		case BOOLOID:
-			type_len = sizeof(cl_bool);
-			break;
+			return (cmeta->attlen == sizeof(cl_bool) ? "|b1" : NULL);
 		case INT2OID:
-			type_len = sizeof(cl_short);
-			break;
+			return (cmeta->attlen == sizeof(cl_short) ? "<i2" : NULL);
 		case INT4OID:
-			type_len = sizeof(cl_int);
-			break;
+			return (cmeta->attlen == sizeof(cl_int) ? "<i4" : NULL);
 		case INT8OID:
-			type_len = sizeof(cl_long);
-			break;
+			return (cmeta->attlen == sizeof(cl_long) ? "<i8" : NULL);
 		case FLOAT4OID:
-			type_len = sizeof(cl_float);
-			break;
+			return (cmeta->attlen == sizeof(cl_float) ? "<f4" : NULL);
 		case FLOAT8OID:
-			type_len = sizeof(cl_double);
-			break;
+			return (cmeta->attlen == sizeof(cl_double) ? "<f8" : NULL);
 		default:
-			PyErr_Format(PyExc_ValueError, "unknown data type");
-			goto bailout;
-	}
-
-	for (i=0; i < nattrs; i++)
-	{
-		kern_colmeta   *cmeta = &kds->colmeta[attIndex[i]];
-		size_t			offset;
-		size_t			length;
-		size_t			nbytes;
-		cudaError_t		rc;
-
-		assert(cmeta->atttypid == type_oid &&
-			   cmeta->attlen == type_len);
-		offset = __kds_unpack(cmeta->va_offset);
-		length = __kds_unpack(cmeta->va_length);
-		nbytes = type_len * nitems;
-		if (length < nbytes)
-		{
-			cudaStreamSynchronize(0);
-			PyErr_Format(PyExc_SystemError,
-						 "Bug? values array of Gstore_fdw is too short");
-			goto bailout;
-		}
-		rc = cudaMemcpyAsync(dest, m_kds + offset, nbytes,
-							 cudaMemcpyDeviceToDevice, 0);
-		if (rc != cudaSuccess)
-		{
-			cudaStreamSynchronize(0);
-			PyErr_Format(PyExc_SystemError,
-						 "failed on cudaMemcpyAsync: %s",
-						 cudaGetErrorString(rc));
-			goto bailout;
-		}
-		dest += nbytes;
+			break;
 	}
-	cudaStreamSynchronize(0);
-	retval = 0;
-bailout:
-	if (devptr)
-		Py_DECREF(devptr);
-	if (devmem)
-		Py_DECREF(devmem);
-	return retval;
+	return NULL;
 }
 
 static int
-check_ndarray_column(kern_colmeta *cmeta, size_t nitems,
-					 NameData *cname, cl_uint *p_type_oid)
+check_device_column(kern_colmeta *cmeta, const char **p_typestr)
 {
-	cl_uint		type_oid = *p_type_oid;
-	size_t		va_offset = __kds_unpack(cmeta->va_offset);
-	size_t		va_length = __kds_unpack(cmeta->va_length);
-	size_t		dataLen;
-
-	/* check data type consistency */
-	if (type_oid == 0)
-		type_oid = cmeta->atttypid;
-	else if (type_oid != cmeta->atttypid)
-	{
-		PyErr_Format(PyExc_ValueError, "Data types are not consistent");
-		return 1;
-	}
-	if (type_oid != BOOLOID &&
-		type_oid != INT2OID &&
-		type_oid != INT4OID &&
-		type_oid != INT8OID &&
-		type_oid != FLOAT4OID &&
-		type_oid != FLOAT8OID)
+	const char *typestr = column_typestr(cmeta);
+
+	if (!typestr || !cmeta->attbyval || cmeta->attnum <= 0)
 	{
 		PyErr_Format(PyExc_ValueError,
-					 "Data type (oid: %u) is not supported", type_oid);
+					 "column '%s' (type oid: %u) is not supported",
+					 cmeta->attname.data, cmeta->atttypid);
 		return 1;
 	}
-	*p_type_oid = type_oid;
-
-	/* other sanity checks */
-	if (va_offset == 0)
+	if (cmeta->nullmap_offset != 0)
 	{
 		PyErr_Format(PyExc_ValueError,
-					 "column '%s' contains no data", cname->data);
+					 "column '%s' is nullable; only NOT NULL columns can be referenced",
+					 cmeta->attname.data);
 		return 1;
 	}
-
-	if (!cmeta->attbyval ||
-		cmeta->attlen <= 0 ||
-		cmeta->attnum <= 0)
+	if (cmeta->values_offset == 0)
 	{
 		PyErr_Format(PyExc_ValueError,
-					 "column '%s' is not fixed length numeric values",
-					 cname->data);
+					 "column '%s' contains no data", cmeta->attname.data);
 		return 1;
 	}
+	*p_typestr = typestr;
+	return 0;
+}
 
-	dataLen = MAXALIGN(cmeta->attlen * nitems);
-	if (va_length < dataLen)
+/*
+ * append_device_column
+ *
+ * 'xmin' and 'xmax' are pseudo columns on the system attribute; a row is
+ * valid if xmin == FrozenTransactionId (2) and xmax == InvalidTransactionId
+ * (0). Elsewhere, the row is removed or not committed.
+ */
+static int
+append_device_column(PyObject *results, PyObject *owner,
+					 char *m_kds, kern_data_store *kds,
+					 const char *aname)
+{
+	kern_colmeta   *cmeta;
+	const char	   *typestr;
+	PyObject	   *darray;
+	char		   *ptr;
+	size_t			itemsz;
+	size_t			stride;
+	int				j, rv;
+
+	if (strcmp(aname, "xmin") == 0 || strcmp(aname, "xmax") == 0)
 	{
-		PyErr_Format(PyExc_ValueError,
-					 "Bug? column '%s' is shorter than expected length",
-					 cname->data);
-		return 1;
+		cmeta = &kds->colmeta[kds->nr_colmeta - 1];
+		if (cmeta->attlen != sizeof(GpuCacheSysattr) ||
+			cmeta->values_offset == 0)
+		{
+			PyErr_Format(PyExc_SystemError,
+						 "Bug? GPU cache has no system attribute");
+			return 1;
+		}
+		ptr = m_kds + __kds_unpack(cmeta->values_offset);
+		if (strcmp(aname, "xmin") == 0)
+			ptr += offsetof(GpuCacheSysattr, xmin);
+		else
+			ptr += offsetof(GpuCacheSysattr, xmax);
+		typestr = "<u4";
+		itemsz = sizeof(cl_uint);
+		stride = sizeof(GpuCacheSysattr);
 	}
-	if (va_length > dataLen)
+	else
 	{
-		PyErr_Format(PyExc_ValueError,
-					 "column '%s' contains NULLs",
-					 cname->data);
-		return 1;
+		for (j=0; j < kds->ncols; j++)
+		{
+			cmeta = &kds->colmeta[j];
+			if (cmeta->attnum > 0 &&
+				strcmp(cmeta->attname.data, aname) == 0)
+				break;
+		}
+		if (j == kds->ncols)
+		{
+			PyErr_Format(PyExc_ValueError,
+						 "Specified column '%s' was not found", aname);
+			return 1;
+		}
+		if (check_device_column(cmeta, &typestr))
+			return 1;
+		ptr = m_kds + __kds_unpack(cmeta->values_offset);
+		itemsz = cmeta->attlen;
+		stride = cmeta->attlen;
 	}
-	return 0;
-}
+	darray = create_device_array(owner, aname, typestr, ptr,
+								 kds->nitems, itemsz, stride);
+	if (!darray)
+		return 1;
+	rv = PyDict_SetItemString(results, aname, darray);
+	Py_DECREF(darray);
 
+	return (rv != 0 ? 1 : 0);
+}
 
+/*
+ * pystrom_gpucache_import
+ *
+ * gpucache_import(token [, colnames]) returns a dict of DeviceArray objects
+ * keyed by the column name. If no column names are given, all the supported
+ * columns and 'xmin', 'xmax' pseudo columns are returned.
+ */
 static PyObject *
-pystrom_ipc_import(PyObject *self, PyObject *args)
+pystrom_gpucache_import(PyObject *self, PyObject *args)
 {
 	Py_buffer		ipc_token;
-	gstoreIpcHandle gs_handle;
+	GpuCacheIpcHandle gc_handle;
 	cudaIpcMemHandle_t ipc_handle;
 	PyObject	   *attnameList = NULL;
+	IpcMappingObject *owner = NULL;
+	PyObject	   *results = NULL;
 	cudaError_t		rc;
-	void		   *m_devptr;
-	char			__buffer[KDS_LEAST_LENGTH];
-	char		   *buffer = __buffer;
-	size_t			length = KDS_LEAST_LENGTH;
-	kern_data_store *kds;
-	NameData	   *attNames;
-	cl_int		   *attIndex = NULL;
-	cl_uint			i, j, nattrs = 0;
-	cl_uint			type_oid = 0;
-	PyObject	   *ndarray = NULL;
-
-	if(!PyArg_ParseTuple(args, "y*|O!",
-						 &ipc_token,
-						 &PyList_Type,
-						 &attnameList))
-		Py_RETURN_NONE;
-
-	/*
-	 * Import GPU device memory using IPC memory handle
-	 */
-	if (ipc_token.len != sizeof(gstoreIpcHandle))
+	kern_data_store	kds_head;
+	kern_data_store *kds = NULL;
+	size_t			length;
+	int				prev_id;
+	Py_ssize_t		i;
+	cl_uint			j;
+
+	if (!PyArg_ParseTuple(args, "y*|O!",
+						  &ipc_token,
+						  &PyList_Type,
+						  &attnameList))
+		return NULL;
+
+	if (ipc_token.len != sizeof(GpuCacheIpcHandle))
 	{
 		PyErr_Format(PyExc_ValueError,
-					 "IPC token length mismatch: %d of %d",
-					 ipc_token.len, sizeof(gstoreIpcHandle));
-		Py_RETURN_NONE;
+					 "IPC token length mismatch: %zd of %zu",
+					 ipc_token.len, sizeof(GpuCacheIpcHandle));
+		PyBuffer_Release(&ipc_token);
+		return NULL;
 	}
-	memcpy(&gs_handle, ipc_token.buf, ipc_token.len);
-	if (VARSIZE(&gs_handle) != sizeof(gs_handle) ||
-		gs_handle.magic != GSTORE_IPC_HANDLE_MAGIC)
+	memcpy(&gc_handle, ipc_token.buf, ipc_token.len);
+	PyBuffer_Release(&ipc_token);
+	if (VARSIZE(&gc_handle) != sizeof(GpuCacheIpcHandle) ||
+		gc_handle.magic != GPUCACHE_IPC_HANDLE_MAGIC)
 	{
 		PyErr_Format(PyExc_ValueError,
-					 "IPC token corruption (vl_len: %d, magic: %08x)",
-					 VARSIZE(&gs_handle), gs_handle.magic);
-		Py_RETURN_NONE;
+					 "IPC token corruption (vl_len: %u, magic: %08x)",
+					 VARSIZE(&gc_handle), gc_handle.magic);
+		return NULL;
+	}
+
+	/*
+	 * Open the GPU cache on the device where PostgreSQL keeps it
+	 */
+	owner = PyObject_New(IpcMappingObject, &IpcMappingType);
+	if (!owner)
+		return NULL;
+	owner->device_id = gc_handle.device_id;
+	owner->m_devptr = NULL;
+
+	rc = cudaGetDevice(&prev_id);
+	if (rc == cudaSuccess)
+		rc = cudaSetDevice(gc_handle.device_id);
+	if (rc != cudaSuccess)
+	{
+		PyErr_Format(PyExc_SystemError,
+					 "Failed on cudaSetDevice(%d): %s",
+					 gc_handle.device_id, cudaGetErrorString(rc));
+		goto bailout;
 	}
-	memcpy(&ipc_handle, gs_handle.ipc_handle, sizeof(cudaIpcMemHandle_t));
-	rc = cudaIpcOpenMemHandle(&m_devptr, ipc_handle,
+	memcpy(&ipc_handle, gc_handle.main_mhandle, sizeof(cudaIpcMemHandle_t));
+	rc = cudaIpcOpenMemHandle(&owner->m_devptr, ipc_handle,
 							  cudaIpcMemLazyEnablePeerAccess);
 	if (rc != cudaSuccess)
 	{
+		owner->m_devptr = NULL;
 		PyErr_Format(PyExc_SystemError,
 					 "Failed on cudaIpcOpenMemHandle: %s",
 					 cudaGetErrorString(rc));
-		Py_RETURN_NONE;
+		goto bailout_restore;
 	}
 
-memcpy_retry:
-	rc = cudaMemcpy(buffer, m_devptr, length,
+	/*
+	 * Only the KDS header is copied to the host, to pick up nitems and
+	 * the locations of the columns.
+	 */
+	rc = cudaMemcpy(&kds_head, owner->m_devptr,
+					offsetof(kern_data_store, colmeta),
 					cudaMemcpyDeviceToHost);
 	if (rc != cudaSuccess)
 	{
 		PyErr_Format(PyExc_SystemError,
-					 "Failed on cudaMemcpy: %s",
-					 cudaGetErrorString(rc));
-		goto bailout;
+					 "Failed on cudaMemcpy: %s", cudaGetErrorString(rc));
+		goto bailout_restore;
 	}
-
-	kds = (kern_data_store *)buffer;
-	if (length < KERN_DATA_STORE_HEAD_LENGTH(kds))
+	length = KERN_DATA_STORE_HEAD_LENGTH(&kds_head);
+	if (kds_head.format != KDS_FORMAT_COLUMN ||
+		length > gc_handle.main_size)
 	{
-		length = KERN_DATA_STORE_HEAD_LENGTH(kds);
-		buffer = malloc(length);
-		if (!buffer)
-		{
-			PyErr_Format(PyExc_SystemError, "Out of memory: %m");
-			goto bailout;
-		}
-		goto memcpy_retry;
+		PyErr_Format(PyExc_SystemError, "Bug? GPU cache is corrupted");
+		goto bailout_restore;
 	}
-
-	attNames = KERN_DATA_STORE_ATTNAMES(kds);
-	if (!attNames)
+	kds = malloc(length);
+	if (!kds)
+	{
+		PyErr_NoMemory();
+		goto bailout_restore;
+	}
+	rc = cudaMemcpy(kds, owner->m_devptr, length,
+					cudaMemcpyDeviceToHost);
+	if (rc != cudaSuccess)
 	{
 		PyErr_Format(PyExc_SystemError,
-					 "Bug? Gstore_fdw has no attribute names");
-		goto bailout;
+					 "Failed on cudaMemcpy: %s", cudaGetErrorString(rc));
+		goto bailout_restore;
 	}
 
+	results = PyDict_New();
+	if (!results)
+		goto bailout_restore;
 	if (attnameList)
 	{
-		nattrs = PyList_Size(attnameList);
-		attIndex = calloc(nattrs, sizeof(cl_int));
-		if (!attIndex)
+		for (i=0; i < PyList_Size(attnameList); i++)
 		{
-			PyErr_Format(PyExc_SystemError, "Out of memory: %m");
-			goto bailout;
-		}
-		for (i=0; i < nattrs; i++)
-		{
-			PyObject	   *aname = PyList_GetItem(attnameList, i);
-			kern_colmeta   *cmeta = NULL;
-
-			for (j=0; j < kds->ncols; j++)
-			{
-				PyObject   *cname = PyUnicode_FromString(attNames[j].data);
-				if (PyUnicode_Compare(aname, cname) == 0)
-				{
-					cmeta = &kds->colmeta[j];
-					Py_DecRef(cname);
-					break;
-				}
-				Py_DecRef(cname);
-			}
-			if (!cmeta)
-			{
-				PyErr_Format(PyExc_ValueError,
-							 "Specified column '%s' was not found",
-							 PyUnicode_AsUTF8(aname));
-				goto bailout;
-			}
-			if (check_ndarray_column(cmeta, kds->nitems,
-									 &attNames[j], &type_oid))
-				goto bailout;
-
-			attIndex[i] = j;
+			PyObject   *aname = PyList_GetItem(attnameList, i);
+			const char *cname = PyUnicode_AsUTF8(aname);
+
+			if (!cname ||
+				append_device_column(results, (PyObject *)owner,
+									 owner->m_devptr, kds, cname))
+				goto bailout_restore;
 		}
 	}
 	else
 	{
-		attIndex = calloc(kds->ncols, sizeof(cl_int));
-		if (!attIndex)
-		{
-			PyErr_Format(PyExc_SystemError, "Out of memory: %m");
-			goto bailout;
-		}
-		for (i=0, j=0; j < kds->ncols; j++)
+		for (j=0; j < kds->ncols; j++)
 		{
 			kern_colmeta   *cmeta = &kds->colmeta[j];
 
-			/* skip system column */
-			if (cmeta->attnum < 0)
+			/* skip unsupported columns silently */
+			if (cmeta->attnum <= 0 ||
+				cmeta->nullmap_offset != 0 ||
+				!column_typestr(cmeta))
 				continue;
-
-			if (check_ndarray_column(cmeta, kds->nitems,
-									 &attNames[j], &type_oid))
-				goto bailout;
-
-			attIndex[i++] = j;
+			if (append_device_column(results, (PyObject *)owner,
+									 owner->m_devptr, kds,
+									 cmeta->attname.data))
+				goto bailout_restore;
 		}
-		nattrs = i;
-	}
-	/* creation of ndarray */
-	ndarray = create_ndarray_normal(type_oid, kds->nitems, nattrs);
-	if (!ndarray)
-		goto bailout;
-	/* copy from the Gstore_fdw */
-	if (setup_ndarray_from_kds(ndarray, m_devptr,
-							   kds, type_oid, nattrs, attIndex))
-	{
-		Py_DECREF(ndarray);
-		ndarray = NULL;
-		goto bailout;
+		if (append_device_column(results, (PyObject *)owner,
+								 owner->m_devptr, kds, "xmin") ||
+			append_device_column(results, (PyObject *)owner,
+								 owner->m_devptr, kds, "xmax"))
+			goto bailout_restore;
 	}
+	cudaSetDevice(prev_id);
+	free(kds);
+	Py_DECREF(owner);
 
-	/* ok, release temporary resources */
-bailout:
-	if (attIndex)
-		free(attIndex);
-	if (buffer != __buffer)
-		free(buffer);
+	return results;
 
-	rc = cudaIpcCloseMemHandle(m_devptr);
-	if (rc != cudaSuccess)
-	{
-		PyErr_Format(PyExc_SystemError, "failed on cudaIpcCloseMemHandle: %s",
-					 cudaGetErrorString(rc));
-	}
-	if (!ndarray)
-		Py_RETURN_NONE;
-	return ndarray;
+bailout_restore:
+	cudaSetDevice(prev_id);
+bailout:
+	if (kds)
+		free(kds);
+	Py_XDECREF(results);
+	Py_DECREF(owner);
+	return NULL;
 }
 
 static PyMethodDef pystrom_methods[] = {
-	{"ipc_import", (PyCFunction)pystrom_ipc_import, METH_VARARGS, "Import Gstore_fdw as cupy.core.ndarray"},
+	{"gpucache_import", (PyCFunction)pystrom_gpucache_import, METH_VARARGS,
+	 "Import GPU cache columns as objects with __cuda_array_interface__"},
 	{NULL, NULL, 0, NULL},
 };
 
@@ -461,5 +488,21 @@ static struct PyModuleDef pystrom_module = {
 
 PyMODINIT_FUNC PyInit_pystrom(void)
 {
-	return PyModule_Create(&pystrom_module);
+	PyObject   *module;
+
+	if (PyType_Ready(&IpcMappingType) < 0 ||
+		PyType_Ready(&DeviceArrayType) < 0)
+		return NULL;
+	module = PyModule_Create(&pystrom_module);
+	if (!module)
+		return NULL;
+	Py_INCREF(&DeviceArrayType);
+	if (PyModule_AddObject(module, "DeviceArray",
+						   (PyObject *)&DeviceArrayType) < 0)
+	{
+		Py_DECREF(&DeviceArrayType);
+		Py_DECREF(module);
+		return NULL;
+	}
+	return module;
 }
@@ -7,7 +7,7 @@ pgsql_include_path = subprocess.check_output(['pg_config','--includedir-server']
 
 setup(name='pystrom',
       author='KaiGai Kohei',
-      version='0.2',
+      version='0.3',
       ext_modules=[Extension('pystrom',
                              sources=['pystrom.c'],
                              include_dirs=[cuda_path + '/include',
@@ -1,14 +1,19 @@
 import psycopg2
+import cupy
 import pystrom
 
 conn = psycopg2.connect("host=localhost dbname=postgres")
 curr = conn.cursor()
-curr.execute("select gstore_export_ipchandle('ft')::bytea")
+curr.execute("select pgstrom.gpucache_export_ipchandle('mytest')")
 row = curr.fetchone()
 conn.close()
 
-X = pystrom.ipc_import(row[0],['x','y','z'])
-Y = pystrom.ipc_import(row[0],['id'])
+cols = pystrom.gpucache_import(row[0], ['x', 'y', 'xmin', 'xmax'])
 
-print(X)
-print(Y)
+# no data copy; cupy references the GPU cache directly
+X = cupy.asarray(cols['x'])
+Y = cupy.asarray(cols['y'])
+live = (cupy.asarray(cols['xmin']) == 2) & (cupy.asarray(cols['xmax']) == 0)
+
+print(X[live])
+print(Y[live])